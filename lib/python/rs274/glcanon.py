@@ -67,6 +67,8 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         self.blocks = []; self.blocks_append = self.blocks.append
         self.block_start = None
         self.highlight_mode = 'line'
+        # linuxcnc.preview_lines made from the lists above, by list and geometry
+        self.previews = {}
         self.selected_block = None
         self.block_pos = []
         self.block_feed = 0
@@ -149,8 +151,16 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         self.state = st
         self.lineno = self.state.sequence_number
 
+    def preview_lines(self, lines, geometry=None):
+        geometry = geometry or self.geometry
+        key = id(lines), geometry
+        p = self.previews.get(key)
+        if p is None or p.count != len(lines):
+            p = self.previews[key] = linuxcnc.preview_lines(geometry, lines)
+        return p
+
     def draw_lines(self, lines, for_selection, j=0, geometry=None):
-        return linuxcnc.draw_lines(geometry or self.geometry, lines, for_selection)
+        return self.preview_lines(lines, geometry).draw(for_selection)
 
     def colored_lines(self, color, lines, for_selection, j=0):
         if self.is_foam:
@@ -575,24 +585,9 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         glLineWidth(3)
         c = self.colors['selected']
         glColor3f(*c)
-        glBegin(GL_LINES)
         coords = []
-        for line in self.traverse:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.arcfeed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.feed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        glEnd()
+        for lines in self.traverse, self.arcfeed, self.feed:
+            coords.extend(self.preview_lines(lines, geometry).highlight(lineno))
         for line in self.dwells:
             if line[0] != lineno: continue
             self.draw_dwells([(line[0], c) + line[2:]], 2, 0)
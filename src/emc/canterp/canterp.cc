@@ -47,17 +47,27 @@
   which typically come out of one of Tom Kramer's interpreters.
   The first two columns are ignored, the rest is converted to
   equivalent canonical calls.
+
+  A binary trace, as written by rs274 -C or by task with
+  EMC_CANON_TRACE set (see canon_trace.h), is recognized by its
+  header, mapped into memory, and replayed a record at a time with
+  no parsing at all.
 */
 
 #include <stdio.h>		// FILE, fopen(), fclose()
 #include <string.h>		// strcpy()
 #include <ctype.h>		// isspace()
 #include <limits.h>
+#include <unistd.h>		// close()
+#include <fcntl.h>		// open()
+#include <sys/mman.h>		// mmap()
+#include <sys/stat.h>		// fstat()
 #include <algorithm>
 #include "config.h"
 #include "emc/nml_intf/interp_return.hh"
 #include "emc/nml_intf/canon.hh"
 #include "emc/rs274ngc/interp_base.hh"
+#include "emc/nml_intf/canon_trace.h"
 
 static char the_command[LINELEN] = { 0 };	// our current command
 static char the_command_name[LINELEN] = { 0 };	// just the name part
@@ -65,7 +75,7 @@ static char the_command_args[LINELEN] = { 0 };	// just the args part
 
 class Canterp : public InterpBase {
 public:
-    Canterp () : f(0) {}
+    Canterp () : f(0), map(0), map_len(0), map_pos(0), rec(0) {}
     char *error_text(int errcode, char *buf, size_t buflen);
     char *stack_name(int index, char *buf, size_t buflen);
     char *line_text(char *buf, size_t buflen);
@@ -93,8 +103,13 @@ public:
     void active_m_codes(int active_mcodes[ACTIVE_M_CODES]);
     void active_settings(double active_settings[ACTIVE_SETTINGS]);
     void set_loglevel(int level);
+    int execute_record();
+    void unmap();
     FILE *f;
     char filename[PATH_MAX];
+    const char *map;		// a binary trace, if that is what was opened
+    size_t map_len, map_pos;
+    const canon_trace_record_t *rec;	// the record read() last got
 };
 
 char *Canterp::error_text(int errcode, char *buf, size_t buflen) {
@@ -240,6 +255,10 @@ int Canterp::read(const char *line) {
 
 int Canterp::read() {
     char buf[LINELEN];
+    if(map) {
+	rec = canon_trace_next(map, map_len, &map_pos);
+	return rec ? INTERP_OK : INTERP_ENDFILE;
+    }
     if(!f) return INTERP_ERROR;
     if(!fgets(buf, sizeof(buf), f)) return INTERP_ENDFILE;
     return canterp_parse(buf);
@@ -670,14 +689,172 @@ int Canterp::execute(const char *line, int line_number) {
 }
 
 int Canterp::execute() {
+    if(map) return execute_record();
     return execute(0);
 }
 
+#define ARG(i) canon_trace_arg(rec, i)
+
+// unknown record types are newer calls, and are skipped
+int Canterp::execute_record() {
+    int ln;
+
+    if(!rec) return INTERP_OK;
+    ln = rec->line;
+    switch(rec->type) {
+    case CANON_TRACE_INIT_CANON:
+	INIT_CANON();
+	break;
+    case CANON_TRACE_STRAIGHT_TRAVERSE:
+	STRAIGHT_TRAVERSE(ln, ARG(0), ARG(1), ARG(2), ARG(3), ARG(4), ARG(5),
+			  ARG(6), ARG(7), ARG(8));
+	break;
+    case CANON_TRACE_STRAIGHT_FEED:
+	STRAIGHT_FEED(ln, ARG(0), ARG(1), ARG(2), ARG(3), ARG(4), ARG(5),
+		      ARG(6), ARG(7), ARG(8));
+	break;
+    case CANON_TRACE_ARC_FEED:
+	ARC_FEED(ln, ARG(0), ARG(1), ARG(2), ARG(3), (int) ARG(4), ARG(5),
+		 ARG(6), ARG(7), ARG(8), ARG(9), ARG(10), ARG(11));
+	break;
+    case CANON_TRACE_STRAIGHT_PROBE:
+	STRAIGHT_PROBE(ln, ARG(0), ARG(1), ARG(2), ARG(3), ARG(4), ARG(5),
+		       ARG(6), ARG(7), ARG(8), (unsigned char) ARG(9));
+	break;
+    case CANON_TRACE_SET_FEED_RATE:
+	SET_FEED_RATE(ARG(0));
+	break;
+    case CANON_TRACE_SET_FEED_REFERENCE:
+	SET_FEED_REFERENCE((CANON_FEED_REFERENCE) ARG(0));
+	break;
+    case CANON_TRACE_SELECT_PLANE:
+	SELECT_PLANE((CANON_PLANE) ARG(0));
+	break;
+    case CANON_TRACE_SET_MOTION_CONTROL_MODE:
+	SET_MOTION_CONTROL_MODE((CANON_MOTION_MODE) ARG(0), ARG(1));
+	break;
+    case CANON_TRACE_USE_LENGTH_UNITS:
+	USE_LENGTH_UNITS((CANON_UNITS) ARG(0));
+	break;
+    case CANON_TRACE_DWELL:
+	DWELL(ARG(0));
+	break;
+    case CANON_TRACE_SET_SPINDLE_SPEED:
+	SET_SPINDLE_SPEED(ARG(0));
+	break;
+    case CANON_TRACE_START_SPINDLE_CLOCKWISE:
+	START_SPINDLE_CLOCKWISE(ln);
+	break;
+    case CANON_TRACE_START_SPINDLE_COUNTERCLOCKWISE:
+	START_SPINDLE_COUNTERCLOCKWISE(ln);
+	break;
+    case CANON_TRACE_STOP_SPINDLE_TURNING:
+	STOP_SPINDLE_TURNING();
+	break;
+    case CANON_TRACE_ORIENT_SPINDLE:
+	ORIENT_SPINDLE(ARG(0), (int) ARG(1));
+	break;
+    case CANON_TRACE_START_SPEED_FEED_SYNCH:
+	START_SPEED_FEED_SYNCH(ARG(0), ARG(1) != 0);
+	break;
+    case CANON_TRACE_STOP_SPEED_FEED_SYNCH:
+	STOP_SPEED_FEED_SYNCH();
+	break;
+    case CANON_TRACE_SELECT_POCKET:
+	SELECT_POCKET((int) ARG(0), (int) ARG(1));
+	break;
+    case CANON_TRACE_CHANGE_TOOL:
+	CHANGE_TOOL((int) ARG(0));
+	break;
+    case CANON_TRACE_MIST_ON:
+	MIST_ON();
+	break;
+    case CANON_TRACE_MIST_OFF:
+	MIST_OFF();
+	break;
+    case CANON_TRACE_FLOOD_ON:
+	FLOOD_ON();
+	break;
+    case CANON_TRACE_FLOOD_OFF:
+	FLOOD_OFF();
+	break;
+    case CANON_TRACE_ENABLE_FEED_OVERRIDE:
+	ENABLE_FEED_OVERRIDE();
+	break;
+    case CANON_TRACE_DISABLE_FEED_OVERRIDE:
+	DISABLE_FEED_OVERRIDE();
+	break;
+    case CANON_TRACE_ENABLE_SPEED_OVERRIDE:
+	ENABLE_SPEED_OVERRIDE();
+	break;
+    case CANON_TRACE_DISABLE_SPEED_OVERRIDE:
+	DISABLE_SPEED_OVERRIDE();
+	break;
+    case CANON_TRACE_TURN_PROBE_ON:
+	TURN_PROBE_ON();
+	break;
+    case CANON_TRACE_TURN_PROBE_OFF:
+	TURN_PROBE_OFF();
+	break;
+    case CANON_TRACE_PROGRAM_STOP:
+	PROGRAM_STOP();
+	break;
+    case CANON_TRACE_OPTIONAL_PROGRAM_STOP:
+	OPTIONAL_PROGRAM_STOP();
+	break;
+    case CANON_TRACE_PROGRAM_END:
+	PROGRAM_END();
+	break;
+    case CANON_TRACE_PALLET_SHUTTLE:
+	PALLET_SHUTTLE();
+	break;
+    case CANON_TRACE_COMMENT:
+	COMMENT(canon_trace_text(rec));
+	break;
+    case CANON_TRACE_MESSAGE:
+	snprintf(the_command_args, sizeof(the_command_args), "%s",
+		 canon_trace_text(rec));
+	MESSAGE(the_command_args);
+	break;
+    }
+    return INTERP_OK;
+}
+
+#undef ARG
+
+void Canterp::unmap() {
+    if(map) munmap((void *) map, map_len);
+    map = 0;
+    map_len = map_pos = 0;
+    rec = 0;
+}
+
 int Canterp::open(const char *newfilename) {
+    struct stat st;
+    void *p;
+    int fd;
+
     if(f) fclose(f);
-    f = fopen(newfilename, "r");
-    if(f) snprintf(filename, sizeof(filename), "%s", newfilename);
-    return f ? INTERP_OK : INTERP_ERROR;
+    f = 0;
+    unmap();
+    fd = ::open(newfilename, O_RDONLY);
+    if(fd < 0) return INTERP_ERROR;
+    if(fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(canon_trace_header_t)) {
+	p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(p != MAP_FAILED && canon_trace_check(p, st.st_size)) {
+	    madvise(p, st.st_size, MADV_SEQUENTIAL);
+	    map = (const char *) p;
+	    map_len = st.st_size;
+	    map_pos = ((const canon_trace_header_t *) p)->header_size;
+	} else if(p != MAP_FAILED) {
+	    munmap(p, st.st_size);
+	}
+    }
+    if(!map) f = fdopen(fd, "r");
+    else ::close(fd);
+    if(map || f) snprintf(filename, sizeof(filename), "%s", newfilename);
+    else ::close(fd);
+    return map || f ? INTERP_OK : INTERP_ERROR;
 }
 
 int Canterp::close() {
@@ -716,7 +893,7 @@ size_t Canterp::line_length() {
    return 0;
 }
 int Canterp::sequence_number() {
-   return -1;
+   return rec ? rec->line : -1;
 }
 int Canterp::init() { return INTERP_OK; }
 void Canterp::active_g_codes(int gees[]) { std::fill(gees, gees + ACTIVE_G_CODES, 0); }
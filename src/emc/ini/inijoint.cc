@@ -50,6 +50,7 @@
   HOME_USE_INDEX <bool>        use index pulse when homing
   HOME_IGNORE_LIMITS <bool>    ignore limit switches when homing
   COMP_FILE <filename>         file of joint compensation points
+  COMP_FILE_2D <filename>      file of a 2D joint compensation map
 
   calls:
 
@@ -89,6 +90,7 @@ static int loadJoint(int joint, EmcIniFile *jointIniFile)
     int sequence;
     int volatile_home;
     int locking_indexer;
+    int home_overlap;
     int comp_file_type; //type for the compensation file. type==0 means nom, forw, rev. 
     double maxVelocity;
     double maxAcceleration;
@@ -174,10 +176,13 @@ static int loadJoint(int joint, EmcIniFile *jointIniFile)
         jointIniFile->Find(&volatile_home, "VOLATILE_HOME", jointString);
         locking_indexer = false;
         jointIniFile->Find(&locking_indexer, "LOCKING_INDEXER", jointString);
+        home_overlap = false;
+        jointIniFile->Find(&home_overlap, "HOME_OVERLAP", jointString);
         // issue NML message to set all params
         if (0 != emcJointSetHomingParams(joint, home, offset, final_vel, search_vel,
                                         latch_vel, (int)use_index, (int)ignore_limits,
-                                        (int)is_shared, sequence, volatile_home, locking_indexer)) {
+                                        (int)is_shared, sequence, volatile_home, locking_indexer,
+                                        home_overlap)) {
             return -1;
         }
 
@@ -207,6 +212,11 @@ static int loadJoint(int joint, EmcIniFile *jointIniFile)
                 return -1;
             }
         }
+        if (NULL != (inistring = jointIniFile->Find("COMP_FILE_2D", jointString))) {
+            if (0 != emcJointLoadComp(joint, inistring, 2)) {
+                return -1;
+            }
+        }
 
         disable_jog = false;	        // default to enable jogging
         jointIniFile->Find(&disable_jog, "DISABLE_JOG", jointString);
@@ -68,6 +68,8 @@ static int loadKins(EmcIniFile *trajInifile)
   MAX_LINEAR_VELOCITY <float>     max linear velocity
   DEFAULT_LINEAR_ACCEL <float>    default linear acceleration
   MAX_LINEAR_ACCEL <float>        max linear acceleration
+  RAPID_BLEND_TOLERANCE <float>   traverse blend tolerance, 0 is off
+  ARC_BLEND <int>                 round G64 corners with arcs if not 0
 
   calls:
 
@@ -77,6 +79,8 @@ static int loadKins(EmcIniFile *trajInifile)
   emcTrajSetAcceleration(double acc);
   emcTrajSetMaxVelocity(double vel);
   emcTrajSetMaxAcceleration(double acc);
+  emcTrajSetRapidTolerance(double tolerance);
+  emcTrajSetArcBlend(int on);
   */
 
 static int loadTraj(EmcIniFile *trajInifile)
@@ -86,6 +90,7 @@ static int loadTraj(EmcIniFile *trajInifile)
     double vel;
     double acc;
     double jerk;
+    double tolerance;
 
     trajInifile->EnableExceptions(EmcIniFile::ERR_CONVERSION);
 
@@ -212,6 +217,24 @@ static int loadTraj(EmcIniFile *trajInifile)
             }
             return -1;
         }
+
+        tolerance = 0;
+        trajInifile->Find(&tolerance, "RAPID_BLEND_TOLERANCE", "TRAJ");
+        if (0 != emcTrajSetRapidTolerance(tolerance)) {
+            if (emc_debug & EMC_DEBUG_CONFIG) {
+                rcs_print("bad return value from emcTrajSetRapidTolerance\n");
+            }
+            return -1;
+        }
+
+        int arc_blend = 0;
+        trajInifile->Find(&arc_blend, "ARC_BLEND", "TRAJ");
+        if (0 != emcTrajSetArcBlend(arc_blend)) {
+            if (emc_debug & EMC_DEBUG_CONFIG) {
+                rcs_print("bad return value from emcTrajSetArcBlend\n");
+            }
+            return -1;
+        }
     }
 
     catch (EmcIniFile::Exception &e) {
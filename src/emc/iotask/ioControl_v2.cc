@@ -89,6 +89,11 @@ typedef enum {
 } version_t;
 static int proto = V2;
 
+// [EMCIO] WAKE_POLL: if > 0, instead of sleeping out CYCLE_TIME, look
+// this often for a new command or a change on an input pin, and start
+// the next cycle as soon as one shows up
+static double io_wake_poll = 0.0;
+
 // extend  EMC_IO_ABORT_REASON_ENUM from emc.hh
 enum {
     EMC_ABORT_BY_TOOLCHANGER_FAULT = EMC_ABORT_USER + 1
@@ -338,74 +343,14 @@ static int iniLoad(const char *filename)
 
     inifile.Find(&random_toolchanger, "RANDOM_TOOLCHANGER", "EMCIO");
 
-    // close it
-    inifile.Close();
-
-    return 0;
-}
-
-/********************************************************************
- *
- * Description: saveToolTable(const char *filename, CANON_TOOL_TABLE toolTable[])
- *		Saves the tool table from toolTable[] array into file filename.
- *		  Array is CANON_TOOL_MAX + 1 entries, since 0 is included.
- *
- * Return Value: Zero on success or -1 if file not found.
- *
- * Side Effects: Default setting used if the parameter not found in
- *		the ini file.
- *
- * Called By: main()
- *
- ********************************************************************/
-static int saveToolTable(const char *filename,
-			 CANON_TOOL_TABLE toolTable[])
-{
-    int pocket;
-    FILE *fp;
-    const char *name;
-    int start_pocket;
-
-    // check filename
-    if (filename[0] == 0) {
-	name = tool_table_file;
-    } else {
-	// point to name provided
-	name = filename;
-    }
-
-    // open tool table file
-    if (NULL == (fp = fopen(name, "w"))) {
-	// can't open file
-	return -1;
+    if (inifile.Find(&io_wake_poll, 0.0, 1.0, "WAKE_POLL", "EMCIO") == IniFile::ERR_LIMITS) {
+	io_wake_poll = 0.0;
+	rtapi_print("invalid [EMCIO] WAKE_POLL in %s; not using it\n", filename);
     }
 
-    if(random_toolchanger) {
-	start_pocket = 0;
-    } else {
-	start_pocket = 1;
-    }
-    for (pocket = start_pocket; pocket < CANON_POCKETS_MAX; pocket++) {
-	if (toolTable[pocket].toolno != -1) {
-	    fprintf(fp, "T%d P%d", toolTable[pocket].toolno, random_toolchanger? pocket: fms[pocket]);
-	    if (toolTable[pocket].diameter) fprintf(fp, " D%f", toolTable[pocket].diameter);
-	    if (toolTable[pocket].offset.tran.x) fprintf(fp, " X%+f", toolTable[pocket].offset.tran.x);
-	    if (toolTable[pocket].offset.tran.y) fprintf(fp, " Y%+f", toolTable[pocket].offset.tran.y);
-	    if (toolTable[pocket].offset.tran.z) fprintf(fp, " Z%+f", toolTable[pocket].offset.tran.z);
-	    if (toolTable[pocket].offset.a) fprintf(fp, " A%+f", toolTable[pocket].offset.a);
-	    if (toolTable[pocket].offset.b) fprintf(fp, " B%+f", toolTable[pocket].offset.b);
-	    if (toolTable[pocket].offset.c) fprintf(fp, " C%+f", toolTable[pocket].offset.c);
-	    if (toolTable[pocket].offset.u) fprintf(fp, " U%+f", toolTable[pocket].offset.u);
-	    if (toolTable[pocket].offset.v) fprintf(fp, " V%+f", toolTable[pocket].offset.v);
-	    if (toolTable[pocket].offset.w) fprintf(fp, " W%+f", toolTable[pocket].offset.w);
-	    if (toolTable[pocket].frontangle) fprintf(fp, " I%+f", toolTable[pocket].frontangle);
-	    if (toolTable[pocket].backangle) fprintf(fp, " J%+f", toolTable[pocket].backangle);
-	    if (toolTable[pocket].orientation) fprintf(fp, " Q%d", toolTable[pocket].orientation);
-	    fprintf(fp, " ;%s\n", ttcomments[pocket]);
-	}
-    }
+    // close it
+    inifile.Close();
 
-    fclose(fp);
     return 0;
 }
 
@@ -556,7 +501,8 @@ void load_tool(int pocket) {
 	ttcomments[0] = ttcomments[pocket];
 	ttcomments[pocket] = comment_temp;
 
-	if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable))
+	if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable,
+				 fms, ttcomments, random_toolchanger))
 	    emcioStatus.status = RCS_ERROR;
     } else if (pocket == 0) {
 	// magic T0 = pocket 0 = no tool
@@ -601,6 +547,64 @@ static char *str_input(int status)
     if (status & TI_START_CHANGE_ACKED) strcat(seen," TI_START_CHANGE_ACKED");
     return seen;
 }
+/********************************************************************
+ *
+ * Description: input_pins(void)
+ *			Collects the input pin values read_inputs() acts on
+ *
+ * Returns:	a bitmask, one bit per pin
+ *
+ * Called By: io_wait
+ ********************************************************************/
+
+static unsigned input_pins(void)
+{
+    unsigned pins = 0;
+
+    pins |= *iocontrol_data->emc_enable_in ? 0x01 : 0;
+    pins |= *iocontrol_data->lube_level ? 0x02 : 0;
+    pins |= *iocontrol_data->tool_prepared ? 0x04 : 0;
+    pins |= *iocontrol_data->tool_changed ? 0x08 : 0;
+    if (proto > V1) {
+	pins |= *iocontrol_data->emc_abort_ack ? 0x10 : 0;
+	pins |= *iocontrol_data->toolchanger_fault ? 0x20 : 0;
+	pins |= *iocontrol_data->toolchanger_clear_fault ? 0x40 : 0;
+	pins |= *iocontrol_data->start_change_ack ? 0x80 : 0;
+    }
+    return pins;
+}
+
+/********************************************************************
+ *
+ * Description: io_wait(void)
+ *			Waits out the rest of the cycle. With WAKE_POLL set,
+ *			returns early once a command arrives or an input
+ *			pin changes, so handshakes don't each cost a cycle
+ *
+ * Called By: main every CYCLE
+ ********************************************************************/
+
+static void io_wait(void)
+{
+    if (io_wake_poll <= 0.0 || emc_io_cycle_time <= io_wake_poll) {
+	esleep(emc_io_cycle_time);
+	return;
+    }
+
+    int count = emcioCommandBuffer->get_msg_count();
+    unsigned pins = input_pins();
+    double end = etime() + emc_io_cycle_time;
+    double left;
+
+    while ((left = end - etime()) > 0.0) {
+	esleep(left < io_wake_poll ? left : io_wake_poll);
+	if (emcioCommandBuffer->get_msg_count() != count ||
+	    input_pins() != pins) {
+	    return;
+	}
+    }
+}
+
 /********************************************************************
  *
  * Description: read_inputs(void)
@@ -932,7 +936,7 @@ int main(int argc, char *argv[])
 	/* read NML, run commands */
 	if (-1 == emcioCommandBuffer->read()) {
 	    /* bad command, wait until next cycle */
-	    esleep(emc_io_cycle_time);
+	    io_wait();
 	    /* and repeat */
 	    continue;
 	}
@@ -941,7 +945,7 @@ int main(int argc, char *argv[])
 	    0 == emcioCommand->type ||	// bad command type
 	    emcioCommand->serial_number == emcioStatus.echo_serial_number) {	// command already finished
 	    /* wait until next cycle */
-	    esleep(emc_io_cycle_time);
+	    io_wait();
 	    /* and repeat */
 	    continue;
 	}
@@ -1117,6 +1121,7 @@ int main(int argc, char *argv[])
 			    " frontangle=%lf, backangle=%lf, orientation=%d\n",
 			    p, t, offs.tran.z, offs.tran.x, d, f, b, o);
 
+	    CANON_TOOL_TABLE was = emcioStatus.tool.toolTable[p];
 	    emcioStatus.tool.toolTable[p].toolno = t;
 	    emcioStatus.tool.toolTable[p].offset = offs;
 	    emcioStatus.tool.toolTable[p].diameter = d;
@@ -1127,8 +1132,12 @@ int main(int argc, char *argv[])
 	    if (emcioStatus.tool.toolInSpindle == t) {
 		emcioStatus.tool.toolTable[0] = emcioStatus.tool.toolTable[p];
 	    }
+	    // touching off again to the same values leaves the file be
+	    if (toolTableEntryEqual(&was, &emcioStatus.tool.toolTable[p]))
+		break;
 	}
-	if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable))
+	if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable,
+				 fms, ttcomments, random_toolchanger))
 	    emcioStatus.status = RCS_ERROR;
 	break;
 
@@ -1222,7 +1231,7 @@ int main(int argc, char *argv[])
 	emcioStatus.reason = toolchanger_reason;  // always piggyback current fault code
 	emcioStatusBuffer->write(&emcioStatus);
 
-	esleep(emc_io_cycle_time);
+	io_wait();
 	/* clear reset line to allow for a later rising edge */
 	*(iocontrol_data->user_request_enable) = 0;
 
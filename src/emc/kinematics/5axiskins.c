@@ -37,47 +37,86 @@ static PmCartesian s2r(double r, double t, double p) {
     return c;
 }
 
-int kinematicsForward(const double *joints,
-		      EmcPose * pos,
-		      const KINEMATICS_FORWARD_FLAGS * fflags,
-		      KINEMATICS_INVERSE_FLAGS * iflags)
+static void forward(double pivot, const double *joints, EmcPose * pos)
 {
-    PmCartesian r = s2r(*(haldata->pivot_length) + joints[8], joints[5], 180.0 - joints[4]);
+    PmCartesian r = s2r(pivot + joints[8], joints[5], 180.0 - joints[4]);
 
     pos->tran.x = joints[0] + r.x;
     pos->tran.y = joints[1] + r.y;
-    pos->tran.z = joints[2] + *(haldata->pivot_length) + r.z;
+    pos->tran.z = joints[2] + pivot + r.z;
     pos->a = joints[3];
     pos->b = joints[4];
     pos->c = joints[5];
     pos->u = joints[6];
     pos->v = joints[7];
     pos->w = joints[8];
-
-    return 0;
 }
 
-int kinematicsInverse(const EmcPose * pos,
-		      double *joints,
-		      const KINEMATICS_INVERSE_FLAGS * iflags,
-		      KINEMATICS_FORWARD_FLAGS * fflags)
+static void inverse(double pivot, const EmcPose * pos, double *joints)
 {
-
-    PmCartesian r = s2r(*(haldata->pivot_length) + pos->w, pos->c, 180.0 - pos->b);
+    PmCartesian r = s2r(pivot + pos->w, pos->c, 180.0 - pos->b);
 
     joints[0] = pos->tran.x - r.x;
     joints[1] = pos->tran.y - r.y;
-    joints[2] = pos->tran.z - *(haldata->pivot_length) - r.z;
+    joints[2] = pos->tran.z - pivot - r.z;
     joints[3] = pos->a;
     joints[4] = pos->b;
     joints[5] = pos->c;
     joints[6] = pos->u;
     joints[7] = pos->v;
     joints[8] = pos->w;
+}
 
+int kinematicsForward(const double *joints,
+		      EmcPose * pos,
+		      const KINEMATICS_FORWARD_FLAGS * fflags,
+		      KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    forward(*(haldata->pivot_length), joints, pos);
     return 0;
 }
 
+int kinematicsInverse(const EmcPose * pos,
+		      double *joints,
+		      const KINEMATICS_INVERSE_FLAGS * iflags,
+		      KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    inverse(*(haldata->pivot_length), pos, joints);
+    return 0;
+}
+
+/* the batch functions read the pivot length pin once for the whole
+   batch, so it can't change part way through a toolpath */
+int kinematicsForwardBatch(const double *joints,
+			   EmcPose * pos,
+			   int n, int stride,
+			   const KINEMATICS_FORWARD_FLAGS * fflags,
+			   KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    double pivot = *(haldata->pivot_length);
+    int i;
+
+    for (i = 0; i < n; i++) {
+	forward(pivot, joints + i * stride, &pos[i]);
+    }
+    return n;
+}
+
+int kinematicsInverseBatch(const EmcPose * pos,
+			   double *joints,
+			   int n, int stride,
+			   const KINEMATICS_INVERSE_FLAGS * iflags,
+			   KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    double pivot = *(haldata->pivot_length);
+    int i;
+
+    for (i = 0; i < n; i++) {
+	inverse(pivot, &pos[i], joints + i * stride);
+    }
+    return n;
+}
+
 /* implemented for these kinematics as giving joints preference */
 int kinematicsHome(EmcPose * world,
 		   double *joint,
@@ -102,6 +141,8 @@ KINEMATICS_TYPE kinematicsType()
 EXPORT_SYMBOL(kinematicsType);
 EXPORT_SYMBOL(kinematicsForward);
 EXPORT_SYMBOL(kinematicsInverse);
+EXPORT_SYMBOL(kinematicsForwardBatch);
+EXPORT_SYMBOL(kinematicsInverseBatch);
 MODULE_LICENSE("GPL");
 
 int comp_id;
@@ -16,6 +16,7 @@
 #include "posemath.h"
 #include "cubic.h"
 #include "rtapi_math.h"
+#include "rtapi_string.h"
 
 #define SEGMENT_TIME_SET 0x01
 #define INTERPOLATION_RATE_SET 0x02
@@ -55,6 +56,67 @@ static CUBIC_COEFF cubicCoeff(double x0, double v0,
     return retval;
 }
 
+/*
+   quinticCoeff calculates the coefficients of the quintic fit to the
+   values of x, v and a at 0 and deltaT.  With v and a taken from the
+   neighbouring points (see velPoint() and accelPoint()), neighbouring
+   segments share them, so the joined quintics are C2 continuous and,
+   unlike the cubic way points, pass through the points themselves.
+*/
+static QUINTIC_COEFF quinticCoeff(double x0, double v0, double a0,
+				  double xn, double vn, double an,
+				  double deltaT)
+{
+    QUINTIC_COEFF retval;
+    double t2 = deltaT * deltaT;
+    double dx = xn - x0;
+
+    retval.q[0] = x0;
+    retval.q[1] = v0;
+    retval.q[2] = 0.5 * a0;
+    retval.q[3] = (20.0 * dx - (8.0 * vn + 12.0 * v0) * deltaT
+		   - (3.0 * a0 - an) * t2) / (2.0 * t2 * deltaT);
+    retval.q[4] = (-30.0 * dx + (14.0 * vn + 16.0 * v0) * deltaT
+		   + (3.0 * a0 - 2.0 * an) * t2) / (2.0 * t2 * t2);
+    retval.q[5] = (12.0 * dx - 6.0 * (vn + v0) * deltaT
+		   - (a0 - an) * t2) / (2.0 * t2 * t2 * deltaT);
+
+    return retval;
+}
+
+/*
+   Interpolate position, velocity, acceleration and jerk along a
+   quintic, given t and quintic params
+*/
+static double interpolateQuintic(QUINTIC_COEFF coeff, double t)
+{
+    const double *q = coeff.q;
+
+    return q[0] + t * (q[1] + t * (q[2] + t * (q[3] + t * (q[4] + t * q[5]))));
+}
+
+static double interpolateQuinticVel(QUINTIC_COEFF coeff, double t)
+{
+    const double *q = coeff.q;
+
+    return q[1] + t * (2.0 * q[2] + t * (3.0 * q[3] + t * (4.0 * q[4]
+						       + t * 5.0 * q[5])));
+}
+
+static double interpolateQuinticAccel(QUINTIC_COEFF coeff, double t)
+{
+    const double *q = coeff.q;
+
+    return 2.0 * q[2] + t * (6.0 * q[3] + t * (12.0 * q[4] + t * 20.0 * q[5]));
+}
+
+static double interpolateQuinticJerk(QUINTIC_COEFF coeff, double t)
+{
+    const double *q = coeff.q;
+
+    return 6.0 * q[3] + t * (24.0 * q[4] + t * 60.0 * q[5]);
+}
+
 /*
    Interpolate points along a cubic, given t and cubic params
 */
@@ -113,6 +175,20 @@ static double velPoint(double xMinus1, double xPlus1, double deltaT)
     }
 }
 
+/*
+   Calculate the acceleration at a point, given the point and its
+   previous and successive neighbors
+*/
+static double accelPoint(double xMinus1, double x, double xPlus1,
+			 double deltaT)
+{
+    if (deltaT <= 0.0) {
+	return 0.0;
+    } else {
+	return (xMinus1 - 2.0 * x + xPlus1) / (deltaT * deltaT);
+    }
+}
+
 int cubicInit(CUBIC_STRUCT * ci)
 {
     if (0 == ci) {
@@ -120,6 +196,7 @@ int cubicInit(CUBIC_STRUCT * ci)
     }
 
     ci->configured = 0;
+    ci->order = 3;
     ci->segmentTime = 0.0;
     ci->interpolationRate = 0;
     ci->interpolationIncrement = 0.0;
@@ -178,6 +255,37 @@ int cubicGetInterpolationRate(CUBIC_STRUCT * ci)
     return ci->interpolationRate;
 }
 
+/*
+   cubicSetOrder(CUBIC_STRUCT * ci, int order)
+
+   Choose what is fitted between the points.  3, the default, is the
+   cubic spline through the way points, which smooths the points but
+   cuts inside them.  5 is a quintic through the points themselves,
+   with the velocity and acceleration at each point taken from its
+   neighbors, for coarse trajectory rates where the cubic's error
+   would show.  Both use the same four points, so the delay is the
+   same.  Takes effect with the next point added.
+*/
+int cubicSetOrder(CUBIC_STRUCT * ci, int order)
+{
+    if (0 == ci || (order != 3 && order != 5)) {
+	return -1;
+    }
+
+    ci->order = order;
+
+    return 0;
+}
+
+int cubicGetOrder(CUBIC_STRUCT * ci)
+{
+    if (0 == ci) {
+	return 0;
+    }
+
+    return ci->order;
+}
+
 double cubicGetInterpolationIncrement(CUBIC_STRUCT * ci)
 {
     if (0 == ci || ci->configured != ALL_SET) {
@@ -245,8 +353,16 @@ int cubicAddPoint(CUBIC_STRUCT * ci, double point)
     ci->wp1 = wayPoint(ci->x1, ci->x2, ci->x3);
     ci->velp0 = velPoint(ci->x0, ci->x2, ci->segmentTime);
     ci->velp1 = velPoint(ci->x1, ci->x3, ci->segmentTime);
-    ci->coeff = cubicCoeff(ci->wp0, ci->velp0, ci->wp1,
-			   ci->velp1, ci->segmentTime);
+    if (ci->order == 5) {
+	ci->quintic = quinticCoeff(ci->x1, ci->velp0,
+	    accelPoint(ci->x0, ci->x1, ci->x2, ci->segmentTime),
+	    ci->x2, ci->velp1,
+	    accelPoint(ci->x1, ci->x2, ci->x3, ci->segmentTime),
+	    ci->segmentTime);
+    } else {
+	ci->coeff = cubicCoeff(ci->wp0, ci->velp0, ci->wp1,
+			       ci->velp1, ci->segmentTime);
+    }
     ci->interpolationTime = 0.0;
     ci->needNextPoint = 0;
 
@@ -280,6 +396,7 @@ int cubicOffset(CUBIC_STRUCT * ci, double offset)
 
     /* only the D coeff is affected, so we can change this directly */
     ci->coeff.d += offset;
+    ci->quintic.q[0] += offset;
 
     return 0;
 }
@@ -307,20 +424,34 @@ double cubicInterpolate(CUBIC_STRUCT * ci,
 	cubicAddPoint(ci, ci->x3);
     }
 
-    retval = interpolateCubic(ci->coeff, ci->interpolationTime);
-
-    /* do optional ones */
-    if (x != 0) {
-	*x = retval;
-    }
-    if (v != 0) {
-	*v = interpolateVel(ci->coeff, ci->interpolationTime);
-    }
-    if (a != 0) {
-	*a = interpolateAccel(ci->coeff, ci->interpolationTime);
-    }
-    if (j != 0) {
-	*j = interpolateJerk(ci->coeff, ci->interpolationTime);
+    if (ci->order == 5) {
+	retval = interpolateQuintic(ci->quintic, ci->interpolationTime);
+	if (x != 0) {
+	    *x = retval;
+	}
+	if (v != 0) {
+	    *v = interpolateQuinticVel(ci->quintic, ci->interpolationTime);
+	}
+	if (a != 0) {
+	    *a = interpolateQuinticAccel(ci->quintic, ci->interpolationTime);
+	}
+	if (j != 0) {
+	    *j = interpolateQuinticJerk(ci->quintic, ci->interpolationTime);
+	}
+    } else {
+	retval = interpolateCubic(ci->coeff, ci->interpolationTime);
+	if (x != 0) {
+	    *x = retval;
+	}
+	if (v != 0) {
+	    *v = interpolateVel(ci->coeff, ci->interpolationTime);
+	}
+	if (a != 0) {
+	    *a = interpolateAccel(ci->coeff, ci->interpolationTime);
+	}
+	if (j != 0) {
+	    *j = interpolateJerk(ci->coeff, ci->interpolationTime);
+	}
     }
 
     ci->interpolationTime += ci->interpolationIncrement;
@@ -351,6 +482,7 @@ int cubicDrain(CUBIC_STRUCT * ci)
     ci->coeff.b = 0.0;
     ci->coeff.c = 0.0;
     ci->coeff.d = 0.0;
+    memset(&ci->quintic, 0, sizeof(ci->quintic));
 
     return 0;
 }
@@ -358,9 +490,10 @@ int cubicDrain(CUBIC_STRUCT * ci)
 #ifdef MAIN
 
 #include <stdio.h>
+#include <stdlib.h>
 
 /*
-  syntax: testcubic <segment time> <interpolation rate>
+  syntax: testcubic <segment time> <interpolation rate> [<order>]
 */
 int main(int argc, char *argv[])
 {
@@ -371,8 +504,9 @@ int main(int argc, char *argv[])
     double xout;
     double time = 0.0;
 
-    if (argc != 3) {
-	fprintf(stderr, "syntax: %s <segment time> <interpolation rate>\n",
+    if (argc != 3 && argc != 4) {
+	fprintf(stderr,
+		"syntax: %s <segment time> <interpolation rate> [<order>]\n",
 		argv[0]);
 	return 1;
     }
@@ -403,6 +537,11 @@ int main(int argc, char *argv[])
 	return 1;
     }
 
+    if (argc == 4 && 0 != cubicSetOrder(&cubic, atoi(argv[3]))) {
+	fprintf(stderr, "invalid order %s, must be 3 or 5\n", argv[3]);
+	return 1;
+    }
+
     while (!feof(stdin)) {
 	if (cubicNeedNextPoint(&cubic)) {
 	    if (1 != scanf("%lf", &xin)) {
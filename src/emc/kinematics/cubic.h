@@ -26,8 +26,17 @@ typedef struct {
     double d;
 } CUBIC_COEFF;
 
+/*
+   Coefficients of a quintic polynomial, q[0] + q[1] * x + ... + q[5] * x^5
+*/
+
+typedef struct {
+    double q[6];
+} QUINTIC_COEFF;
+
 typedef struct {
     int configured;
+    int order;			/* 3 or 5, see cubicSetOrder() */
     double segmentTime;
     int interpolationRate;
     double interpolationTime;
@@ -38,6 +47,7 @@ typedef struct {
     int filled;
     int needNextPoint;
     CUBIC_COEFF coeff;
+    QUINTIC_COEFF quintic;
 } CUBIC_STRUCT;
 
 extern int cubicInit(CUBIC_STRUCT * ci);
@@ -45,6 +55,8 @@ extern int cubicSetSegmentTime(CUBIC_STRUCT * ci, double time);
 extern double cubicGetSegmentTime(CUBIC_STRUCT * ci);
 extern int cubicSetInterpolationRate(CUBIC_STRUCT * ci, int rate);
 extern int cubicGetInterpolationRate(CUBIC_STRUCT * ci);
+extern int cubicSetOrder(CUBIC_STRUCT * ci, int order);
+extern int cubicGetOrder(CUBIC_STRUCT * ci);
 extern int cubicAddPoint(CUBIC_STRUCT * ci, double point);
 extern int cubicOffset(CUBIC_STRUCT * ci, double offset);
 extern double cubicGetInterpolationIncrement(CUBIC_STRUCT * ci);
@@ -57,85 +57,96 @@
 /******************************* MatInvert() ***************************/
 
 /*-----------------------------------------------------------------------------
- This is a function that inverts a 6x6 matrix.
+ This is a function that inverts a 6x6 matrix, by Gauss-Jordan elimination
+ with partial pivoting.  Returns -1 if the matrix is singular.
 -----------------------------------------------------------------------------*/
 
 static int MatInvert(double J[][NUM_STRUTS], double InvJ[][NUM_STRUTS])
 {
-  double JAug[NUM_STRUTS][12], m, temp;
-  int j, k, n;
+  double A[NUM_STRUTS][NUM_STRUTS], m, temp;
+  int j, k, n, p;
 
-  /* This function determines the inverse of a 6x6 matrix using
-     Gauss-Jordan elimination */
-
-  /* Augment the Identity matrix to the Jacobian matrix */
-
-  for (j=0; j<=5; ++j){
-    for (k=0; k<=5; ++k){     /* Assign J matrix to first 6 columns of AugJ */
-      JAug[j][k] = J[j][k];
-    }
-    for(k=6; k<=11; ++k){    /* Assign I matrix to last six columns of AugJ */
-      if (k-6 == j){
-        JAug[j][k]=1;
-      }
-      else{
-        JAug[j][k]=0;
-      }
+  for (j = 0; j < NUM_STRUTS; j++) {
+    for (k = 0; k < NUM_STRUTS; k++) {
+      A[j][k] = J[j][k];
+      InvJ[j][k] = (j == k) ? 1.0 : 0.0;
     }
   }
 
-  /* Perform Gauss elimination */
-  for (k=0; k<=4; ++k){               /* Pivot        */
-    if ((JAug[k][k]< 0.01) && (JAug[k][k] > -0.01)){
-      for (j=k+1;j<=5; ++j){
-        if ((JAug[j][k]>0.01) || (JAug[j][k]<-0.01)){
-          for (n=0; n<=11;++n){
-            temp = JAug[k][n];
-            JAug[k][n] = JAug[j][n];
-            JAug[j][n] = temp;
-          }
-          break;
-        }
+  for (k = 0; k < NUM_STRUTS; k++) {
+    /* pivot on the largest entry left in column k */
+    p = k;
+    for (j = k + 1; j < NUM_STRUTS; j++) {
+      if (fabs(A[j][k]) > fabs(A[p][k])) {
+        p = j;
       }
     }
-    for (j=k+1; j<=5; ++j){            /* Pivot */
-      m = -JAug[j][k] / JAug[k][k];
-      for (n=0; n<=11; ++n){
-        JAug[j][n]=JAug[j][n] + m*JAug[k][n];   /* (Row j) + m * (Row k) */
-        if ((JAug[j][n] < 0.000001) && (JAug[j][n] > -0.000001)){
-          JAug[j][n] = 0;
-        }
+    if (fabs(A[p][k]) < 1e-12) {
+      return -1;
+    }
+    if (p != k) {
+      for (n = 0; n < NUM_STRUTS; n++) {
+        temp = A[k][n]; A[k][n] = A[p][n]; A[p][n] = temp;
+        temp = InvJ[k][n]; InvJ[k][n] = InvJ[p][n]; InvJ[p][n] = temp;
       }
     }
-  }
 
-  /* Normalization of Diagonal Terms */
-  for (j=0; j<=5; ++j){
-    m=1/JAug[j][j];
-    for(k=0; k<=11; ++k){
-      JAug[j][k] = m * JAug[j][k];
+    /* normalize row k, then clear column k from the other rows */
+    m = 1.0 / A[k][k];
+    for (n = 0; n < NUM_STRUTS; n++) {
+      A[k][n] *= m;
+      InvJ[k][n] *= m;
     }
-  }
-
-  /* Perform Gauss Jordan Steps */
-  for (k=5; k>=0; --k){
-    for(j=k-1; j>=0; --j){
-      m = -JAug[j][k]/JAug[k][k];
-      for (n=0; n<=11; ++n){
-        JAug[j][n] = JAug[j][n] + m * JAug[k][n];
+    for (j = 0; j < NUM_STRUTS; j++) {
+      if (j == k || A[j][k] == 0.0) {
+        continue;
+      }
+      m = A[j][k];
+      for (n = 0; n < NUM_STRUTS; n++) {
+        A[j][n] -= m * A[k][n];
+        InvJ[j][n] -= m * InvJ[k][n];
       }
     }
   }
 
-  /* Assign last 6 columns of JAug to InvJ */
-  for (j=0; j<=5; ++j){
-    for (k=0; k<=5; ++k){
-      InvJ[j][k] = JAug[j][k+6];
+  return 0;
+}
+
+/***************************** BroydenUpdate() ******************************/
+
+/*-----------------------------------------------------------------------------
+  Broyden's update of an approximate Jacobian J, taking pose steps to strut
+  length differences: after the step s changed the differences by y,
+  J += (s - J y) (s' J) / (s' J y), which makes J y = s.  Skipped when
+  s' J y is too small to divide by.
+  ---------------------------------------------------------------------------*/
+
+static void BroydenUpdate(double J[][NUM_STRUTS], const double s[],
+			  const double y[])
+{
+  double Jy[NUM_STRUTS], sJ[NUM_STRUTS], sJy = 0.0, m;
+  int j, k;
 
+  for (j = 0; j < NUM_STRUTS; j++) {
+    Jy[j] = 0.0;
+    sJ[j] = 0.0;
+    for (k = 0; k < NUM_STRUTS; k++) {
+      Jy[j] += J[j][k] * y[k];
+      sJ[j] += s[k] * J[k][j];
+    }
+  }
+  for (j = 0; j < NUM_STRUTS; j++) {
+    sJy += s[j] * Jy[j];
+  }
+  if (fabs(sJy) < 1e-30) {
+    return;
+  }
+  for (j = 0; j < NUM_STRUTS; j++) {
+    m = (s[j] - Jy[j]) / sJy;
+    for (k = 0; k < NUM_STRUTS; k++) {
+      J[j][k] += m * sJ[k];
     }
   }
-
-  return 0;			/* FIXME-- check divisors for 0 above */
 }
 
 /******************************** MatMult() *********************************/
@@ -328,11 +339,18 @@ int jacobianForward(const double * joints,
    flags are set to indicate their value appropriate to the world coordinates
    passed in. */
 
+/* The iteration starts from the pose passed in, which for motion is the
+   last solution.  The Jacobian of the last solution is kept, and as long
+   as the platform moves little it stays good enough to start from: it is
+   refined by Broyden updates, without rebuilding and inverting the
+   inverse Jacobian.  If the strut errors stop shrinking, or take more
+   than BROYDEN_ITERATIONS, the iteration goes back to full Newton steps. */
+#define BROYDEN_ITERATIONS 8
+static double LastJacobian[NUM_STRUTS][NUM_STRUTS];
+static int have_last_jacobian = 0;
+
 static int iteration = 0;	/* global so we can report it */
-int kinematicsForward(const double * joints,
-                      EmcPose * pos,
-                      const KINEMATICS_FORWARD_FLAGS * fflags,
-                      KINEMATICS_INVERSE_FLAGS * iflags)
+static int genhexForward(const double * joints, EmcPose * pos)
 {
   PmCartesian aw;
   PmCartesian InvKinStrutVect,InvKinStrutVectUnit;
@@ -341,14 +359,15 @@ int kinematicsForward(const double * joints,
   double Jacobian[NUM_STRUTS][NUM_STRUTS];
   double InverseJacobian[NUM_STRUTS][NUM_STRUTS];
   double InvKinStrutLength, StrutLengthDiff[NUM_STRUTS];
-  double delta[NUM_STRUTS];
-  double conv_err = 1.0;
+  double delta[NUM_STRUTS], LastDiff[NUM_STRUTS], DiffChange[NUM_STRUTS];
+  double conv_err = 1.0, last_conv_err = 0.0;
 
   PmRotationMatrix RMatrix;
   PmRpy q_RPY;
 
   int iterate = 1;
-  int i;
+  int broyden = have_last_jacobian;
+  int i, j;
   int retval = 0;
 
 #define HIGH_CONV_CRITERION   (1e-12)
@@ -361,6 +380,13 @@ int kinematicsForward(const double * joints,
   double conv_criterion = HIGH_CONV_CRITERION;
 
   iteration = 0;
+  if (broyden) {
+    for (i = 0; i < NUM_STRUTS; i++) {
+      for (j = 0; j < NUM_STRUTS; j++) {
+	Jacobian[i][j] = LastJacobian[i][j];
+      }
+    }
+  }
 
   /* abort on obvious problems, like joints <= 0 */
   /* FIXME-- should check against triangle inequality, so that joints
@@ -428,11 +454,14 @@ int kinematicsForward(const double * joints,
       pmMatCartMult(RMatrix, a[i], &RMatrix_a);
       pmCartCartAdd(q_trans, RMatrix_a, &aw);
       pmCartCartSub(aw,b[i], &InvKinStrutVect);
+      pmCartMag(InvKinStrutVect, &InvKinStrutLength);
+      StrutLengthDiff[i] = InvKinStrutLength - joints[i];
+      if (broyden) {
+	continue;
+      }
       if (0 != pmCartUnit(InvKinStrutVect, &InvKinStrutVectUnit)) {
 	return -1;
       }
-      pmCartMag(InvKinStrutVect, &InvKinStrutLength);
-      StrutLengthDiff[i] = InvKinStrutLength - joints[i];
 
       /* Determine RMatrix_a_cross_strut */
       pmCartCartCross(RMatrix_a, InvKinStrutVectUnit, &RMatrix_a_cross_Strut);
@@ -446,11 +475,40 @@ int kinematicsForward(const double * joints,
       InverseJacobian[i][5] = RMatrix_a_cross_Strut.z;
     }
 
-    /* invert Inverse Jacobian */
-    MatInvert(InverseJacobian, Jacobian);
+    /* determine value of conv_error (used to determine if no convergence) */
+    conv_err = 0.0;
+    for (i = 0; i < NUM_STRUTS; i++) {
+      conv_err += fabs(StrutLengthDiff[i]);
+    }
+
+    if (broyden) {
+      if (iteration > BROYDEN_ITERATIONS ||
+	  (iteration > 1 && conv_err >= last_conv_err)) {
+	/* not converging fast enough, redo this step with Newton */
+	broyden = 0;
+	continue;
+      }
+      if (iteration > 1) {
+	/* the last step was -delta */
+	for (i = 0; i < NUM_STRUTS; i++) {
+	  delta[i] = -delta[i];
+	  DiffChange[i] = StrutLengthDiff[i] - LastDiff[i];
+	}
+	BroydenUpdate(Jacobian, delta, DiffChange);
+      }
+    } else {
+      /* invert Inverse Jacobian */
+      if (0 != MatInvert(InverseJacobian, Jacobian)) {
+	return -1;
+      }
+    }
 
     /* multiply Jacobian by LegLengthDiff */
     MatMult(Jacobian, StrutLengthDiff, delta);
+    for (i = 0; i < NUM_STRUTS; i++) {
+      LastDiff[i] = StrutLengthDiff[i];
+    }
+    last_conv_err = conv_err;
 
     /* subtract delta from last iterations pos values */
     q_trans.x -= delta[0];
@@ -460,12 +518,6 @@ int kinematicsForward(const double * joints,
     q_RPY.p   -= delta[4];
     q_RPY.y   -= delta[5];
 
-    /* determine value of conv_error (used to determine if no convergence) */
-    conv_err = 0.0;
-    for (i = 0; i < NUM_STRUTS; i++) {
-      conv_err += fabs(StrutLengthDiff[i]);
-    }
-
     /* enter loop to determine if a strut needs another iteration */
     iterate = 0;			/*assume iteration is done */
     for (i = 0; i < NUM_STRUTS; i++) {
@@ -485,6 +537,44 @@ int kinematicsForward(const double * joints,
   pos->tran.y = q_trans.y;
   pos->tran.z = q_trans.z;
 
+  for (i = 0; i < NUM_STRUTS; i++) {
+    for (j = 0; j < NUM_STRUTS; j++) {
+      LastJacobian[i][j] = Jacobian[i][j];
+    }
+  }
+  have_last_jacobian = 1;
+
+  return retval;
+}
+
+#ifdef RTAPI
+#include "hal.h"
+
+static struct haldata {
+  hal_s32_t *last_iterations;	/* iterations of the last forward kins */
+  hal_s32_t *max_iterations;	/* most iterations so far, can be reset */
+} *haldata = 0;
+#endif
+
+int kinematicsForward(const double * joints,
+                      EmcPose * pos,
+                      const KINEMATICS_FORWARD_FLAGS * fflags,
+                      KINEMATICS_INVERSE_FLAGS * iflags)
+{
+  int retval = genhexForward(joints, pos);
+
+  if (retval != 0) {
+    /* don't start the next call from a Jacobian that failed */
+    have_last_jacobian = 0;
+  }
+#ifdef RTAPI
+  if (haldata) {
+    *(haldata->last_iterations) = iteration;
+    if (iteration > *(haldata->max_iterations)) {
+      *(haldata->max_iterations) = iteration;
+    }
+  }
+#endif
   return retval;
 }
 
@@ -888,7 +978,6 @@ int main(int argc, char *argv[])
 #ifdef RTAPI
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "rtapi_app.h"		/* RTAPI realtime module decls */
-#include "hal.h"
 
 EXPORT_SYMBOL(kinematicsType);
 EXPORT_SYMBOL(kinematicsForward);
@@ -900,12 +989,27 @@ MODULE_LICENSE("GPL");
 
 int comp_id;
 int rtapi_app_main(void) {
+    int res = 0;
+
     comp_id = hal_init("genhexkins");
-    if(comp_id > 0) {
-	hal_ready(comp_id);
-	return 0;
-    }
-    return comp_id;
+    if(comp_id < 0) return comp_id;
+
+    haldata = hal_malloc(sizeof(*haldata));
+    if (!haldata) goto error;
+    if((res = hal_pin_s32_new("genhexkins.last-iterations", HAL_OUT,
+	    &(haldata->last_iterations), comp_id)) < 0) goto error;
+    if((res = hal_pin_s32_new("genhexkins.max-iterations", HAL_IO,
+	    &(haldata->max_iterations), comp_id)) < 0) goto error;
+    *(haldata->last_iterations) = 0;
+    *(haldata->max_iterations) = 0;
+
+    hal_ready(comp_id);
+    return 0;
+
+error:
+    haldata = 0;
+    hal_exit(comp_id);
+    return res;
 }
 
 void rtapi_app_exit(void) { hal_exit(comp_id); }
@@ -34,6 +34,7 @@
 #include "rtapi_math.h"
 #include "gotypes.h"		/* go_result, go_integer */
 #include "gomath.h"		/* go_pose */
+#include "sincos.h"		/* sincos */
 #include "genserkins.h"		/* these decls */
 #include "kinematics.h"
 
@@ -226,6 +227,115 @@ static int compute_jinv(go_matrix * Jfwd, go_matrix * Jinv)
     return GO_RESULT_OK;
 }
 
+/* The rest of genserkins works for any number of links.  For the usual
+   six, the inverse kinematics below use these fixed size versions of
+   compute_jfwd() and compute_jinv() instead.  jfwd6() chains the link
+   transforms as rotation matrices, which gives every joint axis and
+   origin in {0} in one pass, and takes the Jacobian columns directly
+   from them: z x (p_end - p) and z for a revolute joint, z and 0 for a
+   prismatic one.  That is the same Jacobian as compute_jfwd(), and the
+   end of the chain is the forward kinematics, so the Newton loop needs
+   no separate genser_kin_fwd().  solve6() then solves J dj = dvw by LU
+   decomposition, which is cheaper than forming the inverse. */
+
+static int jfwd6(const go_link * link_params, go_real J[6][6], go_pose * T_L_0)
+{
+    go_hom T, h;
+    go_mat rot;
+    go_cart tran, z[6], p[6], r;
+    go_pose pose;
+    int i;
+
+    T.tran.x = T.tran.y = T.tran.z = 0;
+    T.rot.x.x = 1, T.rot.y.x = 0, T.rot.z.x = 0;
+    T.rot.x.y = 0, T.rot.y.y = 1, T.rot.z.y = 0;
+    T.rot.x.z = 0, T.rot.y.z = 0, T.rot.z.z = 1;
+
+    for (i = 0; i < 6; i++) {
+	if (GO_LINK_DH == link_params[i].type) {
+	    const go_dh *dh = &link_params[i].u.dh;
+	    go_real sth, cth, sal, cal;
+
+	    sincos(dh->theta, &sth, &cth);
+	    sincos(dh->alpha, &sal, &cal);
+	    h.rot.x.x = cth, h.rot.y.x = -sth, h.rot.z.x = 0.0;
+	    h.rot.x.y = sth * cal, h.rot.y.y = cth * cal, h.rot.z.y = -sal;
+	    h.rot.x.z = sth * sal, h.rot.y.z = cth * sal, h.rot.z.z = cal;
+	    h.tran.x = dh->a;
+	    h.tran.y = -sal * dh->d;
+	    h.tran.z = cal * dh->d;
+	} else if (GO_LINK_PP == link_params[i].type) {
+	    pose = link_params[i].u.pp.pose;
+	    go_pose_hom_convert(&pose, &h);
+	} else {
+	    return GO_RESULT_IMPL_ERROR;
+	}
+	/* T_0_i = T_0_im1 * T_im1_i */
+	go_mat_cart_mult(&T.rot, &h.tran, &tran);
+	go_cart_cart_add(&T.tran, &tran, &T.tran);
+	go_mat_mat_mult(&T.rot, &h.rot, &rot);
+	T.rot = rot;
+	z[i] = T.rot.z;
+	p[i] = T.tran;
+    }
+
+    for (i = 0; i < 6; i++) {
+	if (GO_QUANTITY_LENGTH == link_params[i].quantity) {
+	    J[0][i] = z[i].x, J[1][i] = z[i].y, J[2][i] = z[i].z;
+	    J[3][i] = 0, J[4][i] = 0, J[5][i] = 0;
+	} else {
+	    go_cart_cart_sub(&T.tran, &p[i], &r);
+	    go_cart_cart_cross(&z[i], &r, &r);
+	    J[0][i] = r.x, J[1][i] = r.y, J[2][i] = r.z;
+	    J[3][i] = z[i].x, J[4][i] = z[i].y, J[5][i] = z[i].z;
+	}
+    }
+
+    return go_hom_pose_convert(&T, T_L_0);
+}
+
+/* solve J x = b in place of b, destroying J */
+static int solve6(go_real J[6][6], go_real b[6])
+{
+    go_real eps = go_get_singular_epsilon();
+    go_real big, t;
+    int row, col, k, pivot;
+
+    for (col = 0; col < 6; col++) {
+	/* partial pivoting */
+	pivot = col;
+	big = fabs(J[col][col]);
+	for (row = col + 1; row < 6; row++) {
+	    if (fabs(J[row][col]) > big) {
+		big = fabs(J[row][col]);
+		pivot = row;
+	    }
+	}
+	if (big < eps)
+	    return GO_RESULT_SINGULAR;
+	if (pivot != col) {
+	    for (k = col; k < 6; k++) {
+		t = J[col][k], J[col][k] = J[pivot][k], J[pivot][k] = t;
+	    }
+	    t = b[col], b[col] = b[pivot], b[pivot] = t;
+	}
+	for (row = col + 1; row < 6; row++) {
+	    t = J[row][col] / J[col][col];
+	    for (k = col + 1; k < 6; k++)
+		J[row][k] -= t * J[col][k];
+	    b[row] -= t * b[col];
+	}
+    }
+    for (row = 5; row >= 0; row--) {
+	t = b[row];
+	for (k = row + 1; k < 6; k++)
+	    t -= J[row][k] * b[k];
+	b[row] = t / J[row][row];
+    }
+
+    return GO_RESULT_OK;
+}
+
 int genser_kin_jac_inv(void *kins,
     const go_pose * pos,
     const go_screw * vel, const go_real * joints, go_real * jointvels)
@@ -406,6 +516,7 @@ int kinematicsInverse(const EmcPose * world,
     go_rvec rvec;
     go_cart cart;
     go_link linkout[GENSER_MAX_JOINTS];
+    go_real J6[6][6];
     int link;
     int smalls;
     int retval;
@@ -425,6 +536,10 @@ int kinematicsInverse(const EmcPose * world,
     haldata->pos->tran.y = world->tran.y;
     haldata->pos->tran.z = world->tran.z;
 
+    /* the fixed size path doesn't call genser_kin_fwd(), so pick up
+       the link pins here */
+    genser_kin_init();
+
     go_matrix_init(Jfwd, Jfwd_stg, 6, genser->link_num);
     go_matrix_init(Jinv, Jinv_stg, genser->link_num, 6);
 
@@ -439,20 +554,29 @@ int kinematicsInverse(const EmcPose * world,
 	for (link = 0; link < genser->link_num; link++) {
 	    go_link_joint_set(&genser->links[link], jest[link], &linkout[link]);
 	}
-	retval = compute_jfwd(linkout, genser->link_num, &Jfwd, &T_L_0);
-	if (GO_RESULT_OK != retval) {
-	    rtapi_print("ERR kI - compute_jfwd (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
-	    return retval;
-	}
-	retval = compute_jinv(&Jfwd, &Jinv);
-	if (GO_RESULT_OK != retval) {
-	    rtapi_print("ERR kI - compute_jinv (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
-	    return retval;
-	}
+	if (genser->link_num == 6) {
+	    /* fixed size Jacobian, whose chain is also the forward kins */
+	    retval = jfwd6(linkout, J6, &pest);
+	    if (GO_RESULT_OK != retval) {
+		rtapi_print("ERR kI - jfwd6 (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
+		return retval;
+	    }
+	} else {
+	    retval = compute_jfwd(linkout, genser->link_num, &Jfwd, &T_L_0);
+	    if (GO_RESULT_OK != retval) {
+		rtapi_print("ERR kI - compute_jfwd (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
+		return retval;
+	    }
+	    retval = compute_jinv(&Jfwd, &Jinv);
+	    if (GO_RESULT_OK != retval) {
+		rtapi_print("ERR kI - compute_jinv (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
+		return retval;
+	    }
 
-	/* pest is the resulting pose estimate given joint estimate */
-	genser_kin_fwd(KINS_PTR, jest, &pest);
-//	printf("jest: %f %f %f %f %f %f\n",jest[0],jest[1],jest[2],jest[3],jest[4],jest[5]);
+	    /* pest is the resulting pose estimate given joint estimate */
+	    genser_kin_fwd(KINS_PTR, jest, &pest);
+//	    printf("jest: %f %f %f %f %f %f\n",jest[0],jest[1],jest[2],jest[3],jest[4],jest[5]);
+	}
 	/* pestinv is its inverse */
 	go_pose_inv(&pest, &pestinv);
 	/*
@@ -492,7 +616,17 @@ int kinematicsInverse(const EmcPose * world,
         dvw[5] = cart.z;
 
 	/* push the Cartesian velocity vector through the inverse Jacobian */
-	go_matrix_vector_mult(&Jinv, dvw, dj);
+	if (genser->link_num == 6) {
+	    for (link = 0; link < 6; link++)
+		dj[link] = dvw[link];
+	    retval = solve6(J6, dj);
+	    if (GO_RESULT_OK != retval) {
+		rtapi_print("ERR kI - solve6 (joints: %f %f %f %f %f %f), (iterations=%d)\n", joints[0],joints[1],joints[2],joints[3],joints[4],joints[5], genser->iterations);
+		return retval;
+	    }
+	} else {
+	    go_matrix_vector_mult(&Jinv, dvw, dj);
+	}
 
 	/* check for small joint increments, if so we're done */
 	for (link = 0, smalls = 0; link < genser->link_num; link++) {
@@ -560,6 +694,52 @@ int kinematicsHome(EmcPose * world,
     return kinematicsForward(joint, world, fflags, iflags);
 }
 
+int kinematicsForwardBatch(const double *joint,
+    EmcPose * world, int n, int stride,
+    const KINEMATICS_FORWARD_FLAGS * fflags, KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+	if (kinematicsForward(joint + i * stride, &world[i], fflags, iflags) != 0)
+	    break;
+    }
+    return i;
+}
+
+/* Along a toolpath the joints move smoothly, so the estimate for each
+   pose is the straight line through the last two solutions rather than
+   just the last one, which saves Newton iterations.  Where the line
+   overshoots (a corner, a flip) the pose is retried from the last
+   solution, so a batch converges wherever a run of single calls would. */
+int kinematicsInverseBatch(const EmcPose * world,
+    double *joints, int n, int stride,
+    const KINEMATICS_INVERSE_FLAGS * iflags, KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    genser_struct *genser = KINS_PTR;
+    double *q, *q1, *q2;
+    int i, link;
+
+    for (i = 0; i < n; i++) {
+	q = joints + i * stride;
+	q1 = q - stride;
+	q2 = q1 - stride;
+	if (i >= 2) {
+	    for (link = 0; link < genser->link_num; link++)
+		q[link] = 2 * q1[link] - q2[link];
+	    if (kinematicsInverse(&world[i], q, iflags, fflags) == GO_RESULT_OK)
+		continue;
+	}
+	if (i >= 1) {
+	    for (link = 0; link < genser->link_num; link++)
+		q[link] = q1[link];
+	}
+	if (kinematicsInverse(&world[i], q, iflags, fflags) != GO_RESULT_OK)
+	    break;
+    }
+    return i;
+}
+
 KINEMATICS_TYPE kinematicsType()
 {
     return KINEMATICS_BOTH;
@@ -570,6 +750,8 @@ KINEMATICS_TYPE kinematicsType()
 EXPORT_SYMBOL(kinematicsType);
 EXPORT_SYMBOL(kinematicsForward);
 EXPORT_SYMBOL(kinematicsInverse);
+EXPORT_SYMBOL(kinematicsForwardBatch);
+EXPORT_SYMBOL(kinematicsInverseBatch);
 MODULE_LICENSE("GPL");
 
 int comp_id;
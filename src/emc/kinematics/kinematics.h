@@ -88,6 +88,30 @@ extern int kinematicsInverse(const struct EmcPose * world,
 			     const KINEMATICS_INVERSE_FLAGS * iflags,
 			     KINEMATICS_FORWARD_FLAGS * fflags);
 
+/* the batch kinematics convert n poses in one call, for userspace
+   callers such as preview limit checks that have a whole toolpath to
+   convert.  Pose i uses joint[i * stride] through joint[i * stride +
+   stride - 1], so stride is at least the number of joints the
+   kinematics write (EMCMOT_MAX_JOINTS is always enough).  The flags
+   are carried from one pose to the next as in a run of single calls.
+   Before each pose, the previous result is copied in as the starting
+   estimate for iterative kinematics; the caller fills in the estimate
+   for the first pose.  Both return the number of poses
+   converted, which is less than n if a pose failed.  Kinematics without
+   their own batch functions link kinsbatch.c, which loops over the
+   single pose calls. */
+extern int kinematicsForwardBatch(const double *joint,
+				  struct EmcPose * world,
+				  int n, int stride,
+				  const KINEMATICS_FORWARD_FLAGS * fflags,
+				  KINEMATICS_INVERSE_FLAGS * iflags);
+
+extern int kinematicsInverseBatch(const struct EmcPose * world,
+				  double *joint,
+				  int n, int stride,
+				  const KINEMATICS_INVERSE_FLAGS * iflags,
+				  KINEMATICS_FORWARD_FLAGS * fflags);
+
 /* the home kinematics function sets all its arguments to their proper
    values at the known home position. When called, these should be set,
    when known, to initial values, e.g., from an INI file. If the home
@@ -0,0 +1,62 @@
+/********************************************************************
+* Description: kinsbatch.c
+*   Batch kinematics for modules without their own, by looping
+*   over the single pose kinematicsForward() and kinematicsInverse()
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+
+#include "kinematics.h"		/* these decls */
+#include "rtapi_string.h"
+
+int kinematicsForwardBatch(const double *joints,
+			   EmcPose * pos,
+			   int n, int stride,
+			   const KINEMATICS_FORWARD_FLAGS * fflags,
+			   KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+	if (i > 0) {
+	    /* iterative forwards start from the last pose */
+	    pos[i] = pos[i - 1];
+	}
+	if (kinematicsForward(joints + i * stride, &pos[i], fflags, iflags) != 0) {
+	    break;
+	}
+    }
+    return i;
+}
+
+int kinematicsInverseBatch(const EmcPose * pos,
+			   double *joints,
+			   int n, int stride,
+			   const KINEMATICS_INVERSE_FLAGS * iflags,
+			   KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+	if (i > 0) {
+	    /* iterative inverses start from the last solution */
+	    memcpy(joints + i * stride, joints + (i - 1) * stride,
+		   stride * sizeof(double));
+	}
+	if (kinematicsInverse(&pos[i], joints + i * stride, iflags, fflags) != 0) {
+	    break;
+	}
+    }
+    return i;
+}
+
+#ifdef RTAPI
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+
+EXPORT_SYMBOL(kinematicsForwardBatch);
+EXPORT_SYMBOL(kinematicsInverseBatch);
+#endif
@@ -27,14 +27,11 @@ struct haldata {
     hal_float_t *pivot_length;
 } *haldata;
 
-int kinematicsForward(const double *joints,
-		      EmcPose * pos,
-		      const KINEMATICS_FORWARD_FLAGS * fflags,
-		      KINEMATICS_INVERSE_FLAGS * iflags)
+static void forward(double pivot, const double *joints, EmcPose * pos)
 {
     // B correction
-    double zb = (*(haldata->pivot_length) + joints[8]) * cos(d2r(joints[4]));
-    double xb = (*(haldata->pivot_length) + joints[8]) * sin(d2r(joints[4]));
+    double zb = (pivot + joints[8]) * cos(d2r(joints[4]));
+    double xb = (pivot + joints[8]) * sin(d2r(joints[4]));
         
     // C correction
     double xyr = hypot(joints[0], joints[1]);
@@ -48,7 +45,7 @@ int kinematicsForward(const double *joints,
 
     pos->tran.x = xyr * cos(xytheta) + xb - xv;
     pos->tran.y = xyr * sin(xytheta) - joints[7];
-    pos->tran.z = joints[2] - zb + zv + *(haldata->pivot_length);
+    pos->tran.z = joints[2] - zb + zv + pivot;
 
     pos->a = joints[3];
     pos->b = joints[4];
@@ -56,18 +53,13 @@ int kinematicsForward(const double *joints,
     pos->u = joints[6];
     pos->v = joints[7];
     pos->w = joints[8];
-
-    return 0;
 }
 
-int kinematicsInverse(const EmcPose * pos,
-		      double *joints,
-		      const KINEMATICS_INVERSE_FLAGS * iflags,
-		      KINEMATICS_FORWARD_FLAGS * fflags)
+static void inverse(double pivot, const EmcPose * pos, double *joints)
 {
     // B correction
-    double zb = (*(haldata->pivot_length) + pos->w) * cos(d2r(pos->b));
-    double xb = (*(haldata->pivot_length) + pos->w) * sin(d2r(pos->b));
+    double zb = (pivot + pos->w) * cos(d2r(pos->b));
+    double xb = (pivot + pos->w) * sin(d2r(pos->b));
         
     // C correction
     double xyr = hypot(pos->tran.x, pos->tran.y);
@@ -81,7 +73,7 @@ int kinematicsInverse(const EmcPose * pos,
 
     joints[0] = xyr * cos(xytheta) - xb + xv;
     joints[1] = xyr * sin(xytheta) + pos->v;
-    joints[2] = pos->tran.z + zb + zv - *(haldata->pivot_length);
+    joints[2] = pos->tran.z + zb + zv - pivot;
 
     joints[3] = pos->a;
     joints[4] = pos->b;
@@ -89,10 +81,58 @@ int kinematicsInverse(const EmcPose * pos,
     joints[6] = pos->u;
     joints[7] = pos->v;
     joints[8] = pos->w;
+}
+
+int kinematicsForward(const double *joints,
+		      EmcPose * pos,
+		      const KINEMATICS_FORWARD_FLAGS * fflags,
+		      KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    forward(*(haldata->pivot_length), joints, pos);
+    return 0;
+}
 
+int kinematicsInverse(const EmcPose * pos,
+		      double *joints,
+		      const KINEMATICS_INVERSE_FLAGS * iflags,
+		      KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    inverse(*(haldata->pivot_length), pos, joints);
     return 0;
 }
 
+/* the batch functions read the pivot length pin once for the whole
+   batch, so it can't change part way through a toolpath */
+int kinematicsForwardBatch(const double *joints,
+			   EmcPose * pos,
+			   int n, int stride,
+			   const KINEMATICS_FORWARD_FLAGS * fflags,
+			   KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    double pivot = *(haldata->pivot_length);
+    int i;
+
+    for (i = 0; i < n; i++) {
+	forward(pivot, joints + i * stride, &pos[i]);
+    }
+    return n;
+}
+
+int kinematicsInverseBatch(const EmcPose * pos,
+			   double *joints,
+			   int n, int stride,
+			   const KINEMATICS_INVERSE_FLAGS * iflags,
+			   KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    double pivot = *(haldata->pivot_length);
+    int i;
+
+    for (i = 0; i < n; i++) {
+	inverse(pivot, &pos[i], joints + i * stride);
+    }
+    return n;
+}
+
 KINEMATICS_TYPE kinematicsType()
 {
     return KINEMATICS_BOTH;
@@ -104,6 +144,8 @@ KINEMATICS_TYPE kinematicsType()
 EXPORT_SYMBOL(kinematicsType);
 EXPORT_SYMBOL(kinematicsInverse);
 EXPORT_SYMBOL(kinematicsForward);
+EXPORT_SYMBOL(kinematicsForwardBatch);
+EXPORT_SYMBOL(kinematicsInverseBatch);
 MODULE_LICENSE("GPL");
 
 int comp_id;
@@ -27,6 +27,7 @@
 #endif
 
 #include "rtapi.h"		/* rtapi_print_msg */
+#include "rtapi_math.h"
 #include "posemath.h"
 #include "emcpos.h"
 #include "tc.h"
@@ -68,15 +69,8 @@ void nurbs_basisfun(int i, double u, int p,
 {
   int j,r;
   double saved, temp;
-
-#ifndef RTAPI
-  double *left = (double*)malloc(sizeof(double)*(p+1));
-  double *right = (double*)malloc(sizeof(double)*(p+1));
-#else
-  #warning "to implement rtai_kmalloc() or static memory chunk for left[] and right[]"
-  double left[4096];
-  double right[4096];
-#endif
+  double left[NURBS_MAX_ORDER + 1];
+  double right[NURBS_MAX_ORDER + 1];
 
   N[0] = 1.0;
   for (j = 1; j <= p; j++)
@@ -95,13 +89,167 @@ void nurbs_basisfun(int i, double u, int p,
       N[j] = saved;
 
     }
-#ifndef RTAPI
-  free(left);
-  free(right);
-#else
-  #warning "to implement rtai_kmalloc() or static memory chunk for left[] and right[]"
-#endif
+}
+
+// Span coefficients.
+//
+// Same recurrence as nurbs_basisfun(), but carried out on polynomials in
+// t = u - U[i], so the basis functions of span i come out as polynomial
+// coefficients.  The denominators of Algorithm A2.2 do not depend on u.
+// These are then combined with the control points of the span into one
+// polynomial per NURBS_CH_* channel, so evaluating the curve anywhere on
+// the span is one Horner pass over all channels.
+//
+// INPUT:
+//
+//   i - knot span  ( from FindSpan() )
+//   p - spline degree
+//   U - knot sequence
+//   ctrl_pts - control points, premultiplied by their weights
+//
+// OUTPUT:
+//
+//   coef - coef[k * NURBS_CHANNELS + ch] is the t^k coefficient of
+//          channel ch, k = 0..p
+void nurbs_span_coef(int i, int p, double *U,
+                     CONTROL_POINT *ctrl_pts, double *coef)
+{
+  int j, r, k, ch;
+  double a = U[i], den, lc, rc;
+  double N[NURBS_MAX_ORDER + 1][NURBS_MAX_ORDER + 1]; // N[r][k]: t^k of N_r
+  double saved[NURBS_MAX_ORDER + 1], temp[NURBS_MAX_ORDER + 1];
+  CONTROL_POINT *cp;
+
+  for (r = 0; r <= p; r++)
+    for (k = 0; k <= p; k++)
+      N[r][k] = 0.0;
+  N[0][0] = 1.0;
+
+  for (j = 1; j <= p; j++)
+    {
+      for (k = 0; k <= j; k++)
+        saved[k] = 0.0;
 
+      for (r = 0; r < j; r++)
+        {
+          // right[r+1] = rc - t, left[j-r] = t + lc
+          rc = U[i+r+1] - a;
+          lc = a - U[i+1+r-j];
+          den = rc + lc;
+          for (k = 0; k < j; k++)
+            temp[k] = (den != 0.0) ? N[r][k] / den : 0.0;
+          // N[r] = saved + right[r+1] * temp
+          N[r][0] = saved[0] + rc * temp[0];
+          for (k = 1; k <= j; k++)
+            N[r][k] = saved[k] + rc * (k < j ? temp[k] : 0.0) - temp[k-1];
+          // saved = left[j-r] * temp
+          saved[0] = lc * temp[0];
+          for (k = 1; k <= j; k++)
+            saved[k] = lc * (k < j ? temp[k] : 0.0) + temp[k-1];
+        }
+
+      for (k = 0; k <= j; k++)
+        N[j][k] = saved[k];
+    }
+
+  for (k = 0; k <= p; k++)
+    for (ch = 0; ch < NURBS_CHANNELS; ch++)
+      coef[k * NURBS_CHANNELS + ch] = 0.0;
+
+  for (r = 0; r <= p; r++)
+    {
+      double *c = coef;
+      cp = &ctrl_pts[i - p + r];
+      for (k = 0; k <= p; k++, c += NURBS_CHANNELS)
+        {
+          double n = N[r][k];
+          c[NURBS_CH_X] += n * cp->X;
+          c[NURBS_CH_Y] += n * cp->Y;
+          c[NURBS_CH_Z] += n * cp->Z;
+          c[NURBS_CH_A] += n * cp->A;
+          c[NURBS_CH_B] += n * cp->B;
+          c[NURBS_CH_C] += n * cp->C;
+          c[NURBS_CH_U] += n * cp->U;
+          c[NURBS_CH_V] += n * cp->V;
+          c[NURBS_CH_W] += n * cp->W;
+          c[NURBS_CH_R] += n * cp->R;
+          c[NURBS_CH_D] += n * cp->D;
+        }
+    }
+}
+
+// Arc length to curve parameter.
+//
+// INPUT:
+//
+//   arclen - arc length table, see nurbs_block_t
+//   n - number of table nodes (at least 2)
+//   len - curve length the table spans
+//   s - arc length along the curve
+//
+// OUTPUT:
+//
+//   returns u at s, by cubic Hermite interpolation between the two
+//   nodes around s, clamped to the u range of those nodes
+double nurbs_arclen_u(const double *arclen, int n, double len, double s)
+{
+  int j;
+  double h, x, t, t2, t3, u;
+  const double *a, *b;
+
+  if (s <= 0.0)
+    return arclen[0];
+  if (s >= len)
+    return arclen[NURBS_ARCLEN_STRIDE * (n - 1)];
+
+  h = len / (n - 1);
+  x = s / h;
+  j = (int) x;
+  if (j > n - 2)
+    j = n - 2;
+  t = x - j;
+  t2 = t * t;
+  t3 = t2 * t;
+  a = &arclen[NURBS_ARCLEN_STRIDE * j];
+  b = a + NURBS_ARCLEN_STRIDE;
+
+  u = (2 * t3 - 3 * t2 + 1) * a[0] + (t3 - 2 * t2 + t) * h * a[1] +
+    (3 * t2 - 2 * t3) * b[0] + (t3 - t2) * h * b[1];
+
+  // the cubic may overshoot where du/ds changes fast, keep u monotonic
+  if (u < a[0])
+    return a[0];
+  if (u > b[0])
+    return b[0];
+  return u;
+}
+
+// Feed profile at an arc length.
+//
+// INPUT:
+//
+//   arclen, n, len - as for nurbs_arclen_u()
+//   s - arc length along the curve
+//
+// OUTPUT:
+//
+//   returns the lower feed profile value of the two nodes around s, so
+//   the requested velocity only changes from one node to the next
+double nurbs_arclen_vmax(const double *arclen, int n, double len, double s)
+{
+  int j;
+  const double *a;
+
+  if (s <= 0.0)
+    j = 0;
+  else if (s >= len)
+    j = n - 2;
+  else
+    j = (int) (s * (n - 1) / len);
+  if (j > n - 2)
+    j = n - 2;
+  a = &arclen[NURBS_ARCLEN_STRIDE * j];
+  return a[2] < a[NURBS_ARCLEN_STRIDE + 2] ? a[2] : a[NURBS_ARCLEN_STRIDE + 2];
 }
 
 PmCartesian tcGetStartingUnitVector(TC_STRUCT *tc) {
@@ -169,10 +317,87 @@ EmcPose tcGetPos(TC_STRUCT * tc) {
     return tcGetPosReal(tc, 0);
 }
 
+/* the end of a rigid tap moves when it reverses; every other kind of
+   tc keeps the endpoint the tpAdd function stored, so tpRunCycle
+   doesn't evaluate the curve at its end every cycle */
 EmcPose tcGetEndpoint(TC_STRUCT * tc) {
-    return tcGetPosReal(tc, 1);
+    if (tc->motion_type == TC_RIGIDTAP) {
+        return tcGetPosReal(tc, 1);
+    }
+    return tc->endpoint;
+}
+
+
+/* tcGetPos is called each cycle with the angle a little past the one
+   before, so the cos and sin of the angle are found by rotating the
+   last ones through the difference, whose own cos and sin are short
+   series, instead of calling cos() and sin().  The step has to be
+   small enough for the series, and every TC_ARC_RESYNC rotations the
+   exact values are taken again so rounding can't build up. */
+#define TC_ARC_MAX_STEP 0.05
+#define TC_ARC_RESYNC 64
+
+static void tcArcCosSin(PmArcStep *st, double angle, double *c, double *s)
+{
+    double d, d2, cd, sd;
+
+    d = angle - st->angle;
+    if (st->valid && st->steps < TC_ARC_RESYNC && fabs(d) <= TC_ARC_MAX_STEP) {
+        // the terms left out are below 1e-15 for |d| <= 0.05
+        d2 = d * d;
+        cd = 1.0 - d2 / 2.0 * (1.0 - d2 / 12.0 * (1.0 - d2 / 30.0));
+        sd = d * (1.0 - d2 / 6.0 * (1.0 - d2 / 20.0 * (1.0 - d2 / 42.0)));
+        *c = st->c * cd - st->s * sd;
+        *s = st->s * cd + st->c * sd;
+        st->steps++;
+    } else {
+        *c = cos(angle);
+        *s = sin(angle);
+        st->steps = 0;
+    }
+    st->angle = angle;
+    st->c = *c;
+    st->s = *s;
+    st->valid = 1;
+}
+
+/* pmCirclePoint, with the cos and sin from tcArcCosSin.  The radius
+   vector is rTan cos + rPerp sin, whose length is the radius, so the
+   spiral term needs no pmCartUnit. */
+static void tcArcPoint(PmCircle9 *circle, double angle, PmCartesian *p)
+{
+    PmCircle *xyz = &circle->xyz;
+    double c, s, scale, k;
+
+    if (xyz->angle == 0.0 || xyz->radius == 0.0) {
+        PmPose pose;
+        pmCirclePoint(xyz, angle, &pose);
+        *p = pose.tran;
+        return;
+    }
+    tcArcCosSin(&circle->step, angle, &c, &s);
+    scale = angle / xyz->angle;
+    k = 1.0 + scale * xyz->spiral / xyz->radius;
+    p->x = xyz->center.x + (xyz->rTan.x * c + xyz->rPerp.x * s) * k
+        + xyz->rHelix.x * scale;
+    p->y = xyz->center.y + (xyz->rTan.y * c + xyz->rPerp.y * s) * k
+        + xyz->rHelix.y * scale;
+    p->z = xyz->center.z + (xyz->rTan.z * c + xyz->rPerp.z * s) * k
+        + xyz->rHelix.z * scale;
 }
 
+/* the translation pmLinePoint would give; the abc and uvw lines of a
+   tc have no rotation part to work out */
+static void tcLineTran(PmLine *line, double len, PmCartesian *p)
+{
+    if (line->tmag_zero) {
+        *p = line->end.tran;
+    } else {
+        p->x = line->start.tran.x + line->uVec.x * len;
+        p->y = line->start.tran.y + line->uVec.y * len;
+        p->z = line->start.tran.z + line->uVec.z * len;
+    }
+}
 
 EmcPose tcGetPosReal(TC_STRUCT * tc, int of_endpoint)
 {
@@ -225,133 +450,115 @@ EmcPose tcGetPosReal(TC_STRUCT * tc, int of_endpoint)
         // progress is always along the xyz circle.  This simplification
         // is possible since zero-radius arcs are not allowed by the interp.
 
-        pmCirclePoint(&tc->coords.circle.xyz,
-                      progress * tc->coords.circle.xyz.angle / tc->target,
-                      &xyz);
+        // the endpoint is worked out once, exactly, and mustn't move
+        // the place tcGetPos rotates on from
+        if (of_endpoint) {
+            pmCirclePoint(&tc->coords.circle.xyz,
+                          progress * tc->coords.circle.xyz.angle / tc->target,
+                          &xyz);
+        } else {
+            tcArcPoint(&tc->coords.circle,
+                       progress * tc->coords.circle.xyz.angle / tc->target,
+                       &xyz.tran);
+        }
         // abc moves proportionally in order to end at the same time as the
         // circular xyz move.
-        pmLinePoint(&tc->coords.circle.abc,
-                    progress * tc->coords.circle.abc.tmag / tc->target,
-                    &abc);
+        tcLineTran(&tc->coords.circle.abc,
+                   progress * tc->coords.circle.abc.tmag / tc->target,
+                   &abc.tran);
         // same for uvw
-        pmLinePoint(&tc->coords.circle.uvw,
-                    progress * tc->coords.circle.uvw.tmag / tc->target,
-                    &uvw);
+        tcLineTran(&tc->coords.circle.uvw,
+                   progress * tc->coords.circle.uvw.tmag / tc->target,
+                   &uvw.tran);
 
     } else {
-        int s, tmp1,i;
-        double       u,*N,R, X, Y, Z, A, B, C, U, V, W, F, D;
+        int s, k, ch, p, n;
+        double       u, t, *U, *c, R, F, D;
+        double       val[NURBS_CHANNELS];
         double       curve_accel;
 #if(TRACE != 0)
         double delta_l, delta_u, delta_d, delta_x, delta_y, delta_z, delta_a;
 #endif
-        N = tc->nurbs_block.N;
-//        NL = tc->nurbs_block.NL;
         assert(tc->motion_type == TC_NURBS);
 
-        u = progress / tc->target;
+        if (tc->coords.nurbs.nr_of_arclen) {
+            u = progress < tc->target ?
+                nurbs_arclen_u(tc->coords.nurbs.arclen_ptr,
+                               tc->coords.nurbs.nr_of_arclen,
+                               tc->target, progress) : 1.0;
+        } else {
+            u = progress / tc->target;
+        }
         if (u<1) {
-
-            s = nurbs_findspan(tc->nurbs_block.nr_of_ctrl_pts-1,  tc->nurbs_block.order - 1,
-                                u, tc->nurbs_block.knots_ptr);  //return span index of u_i
-            nurbs_basisfun(s, u, tc->nurbs_block.order - 1 , tc->nurbs_block.knots_ptr , N);    // input: s:knot span index u:u_0 d:B-Spline degree  k:Knots
-                           // output: N:basis functions
-            // refer to bspeval.cc::line(70) of octave
-            // refer to opennurbs_evaluate_nurbs.cpp::line(985) of openNurbs
-            // refer to ON_NurbsCurve::Evaluate() for ...
-            // refer to opennurbs_knot.cpp::ON_NurbsSpanIndex()
-            // http://www.rhino3d.com/nurbs.htm (What is NURBS?)
-            //    Some modelers that use older algorithms for NURBS
-            //    evaluation require two extra knot values for a total of
-            //    degree+N+1 knots. When Rhino is exporting and importing
-            //    NURBS geometry, it automatically adds and removes these
-            //    two superfluous knots as the situation requires.
-            tmp1 = s - tc->nurbs_block.order + 1;
-            assert(tmp1 >= 0);
-            assert(tmp1 < tc->nurbs_block.nr_of_ctrl_pts);
-
-            R = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1 ; i++) {
-
-                R += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].R;
-            }
-
-            X = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    X += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].X;
-
-            }
-            X = X/R;
-            xyz.tran.x = X;
-
-            Y = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    Y += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].Y;
-            }
-            Y = Y/R;
-            xyz.tran.y = Y;
-
-            Z = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    Z += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].Z;
-            }
-            Z = Z/R;
-            xyz.tran.z = Z;
-
-            A = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    A += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].A;
-            }
-            A = A/R;
-            abc.tran.x = A;
-
-            B = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    B += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].B;
-            }
-            B = B/R;
-            abc.tran.y = B;
-
-            C = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    C += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].C;
+            p = tc->coords.nurbs.order - 1;
+            n = tc->coords.nurbs.nr_of_ctrl_pts - 1;
+            U = tc->coords.nurbs.knots_ptr;
+
+            // progress only moves forward between ticks, so the span of u
+            // is nearly always the cached one or the next; only search the
+            // whole knot vector when there is no cache or u went back.
+            s = tc->coords.nurbs.span;
+            if (s < 0 || u < U[s]) {
+                s = nurbs_findspan(n, p, u, U);  //return span index of u_i
+            } else {
+                while (s < n && u >= U[s+1]) {
+                    s++;
+                }
             }
-            C = C/R;
-            abc.tran.z = C;
-
-            U = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    U += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].U;
+            if (s != tc->coords.nurbs.span) {
+                // refer to bspeval.cc::line(70) of octave
+                // refer to opennurbs_evaluate_nurbs.cpp::line(985) of openNurbs
+                nurbs_span_coef(s, p, U, tc->coords.nurbs.ctrl_pts_ptr,
+                                tc->coords.nurbs.span_coef);
+                tc->coords.nurbs.span = s;
             }
-            U = U/R;
-            uvw.tran.x = U;
-
-            V = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    V += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].V;
+            assert(s - p >= 0);
+            assert(s - p < tc->coords.nurbs.nr_of_ctrl_pts);
+
+            // one Horner pass over all channels of the span polynomial
+            t = u - U[s];
+            c = tc->coords.nurbs.span_coef + p * NURBS_CHANNELS;
+            for (ch = 0; ch < NURBS_CHANNELS; ch++) {
+                val[ch] = c[ch];
             }
-            V = V/R;
-            uvw.tran.y = V;
-
-            W = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    W += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].W;
+            for (k = p - 1; k >= 0; k--) {
+                c -= NURBS_CHANNELS;
+                for (ch = 0; ch < NURBS_CHANNELS; ch++) {
+                    val[ch] = val[ch] * t + c[ch];
+                }
             }
-            W = W/R;
-            uvw.tran.z = W;
 
-            F = 0.0;
-            F = tc->nurbs_block.ctrl_pts_ptr[tmp1].F;
+            R = val[NURBS_CH_R];
+            xyz.tran.x = val[NURBS_CH_X] / R;
+            xyz.tran.y = val[NURBS_CH_Y] / R;
+            xyz.tran.z = val[NURBS_CH_Z] / R;
+            abc.tran.x = val[NURBS_CH_A] / R;
+            abc.tran.y = val[NURBS_CH_B] / R;
+            abc.tran.z = val[NURBS_CH_C] / R;
+            uvw.tran.x = val[NURBS_CH_U] / R;
+            uvw.tran.y = val[NURBS_CH_V] / R;
+            uvw.tran.z = val[NURBS_CH_W] / R;
+
+            F = tc->coords.nurbs.ctrl_pts_ptr[s - p].F;
             tc->reqvel = F;
 
-            D = 0.0;
-            for (i=0; i<=tc->nurbs_block.order -1; i++) {
-                    D += N[i]*tc->nurbs_block.ctrl_pts_ptr[tmp1+i].D;
-            }
-            D = D/R;
-
-            // compute allowed feed
-            if(!of_endpoint) {
+            D = val[NURBS_CH_D] / R;
+
+            // compute allowed feed: the profile planned with the arc
+            // length table, which is for the path, whatever the feed
+            // override, or else the curvature radius of the control
+            // points as we get there
+            if (tc->coords.nurbs.nr_of_arclen) {
+                double vmax = nurbs_arclen_vmax(tc->coords.nurbs.arclen_ptr,
+                                                tc->coords.nurbs.nr_of_arclen,
+                                                tc->target, progress);
+                if (tc->feed_override > 1.0) {
+                    vmax /= tc->feed_override;
+                }
+                if (tc->reqvel > vmax) {
+                    tc->reqvel = vmax;
+                }
+            } else if(!of_endpoint) {
                 curve_accel = (tc->cur_vel * tc->cur_vel)/D;
                 if(curve_accel > tc->maxaccel) {
                     // modify req_vel
@@ -398,16 +605,16 @@ EmcPose tcGetPosReal(TC_STRUCT * tc, int of_endpoint)
 #endif // (TRACE != 0)
 
         }else {
-            xyz.tran.x = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].X;
-            xyz.tran.y = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].Y;
-            xyz.tran.z = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].Z;
-            uvw.tran.x = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].U;
-            uvw.tran.y = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].V;
-            uvw.tran.z = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].W;
-            abc.tran.x = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].A;
-            abc.tran.y = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].B;
-            abc.tran.z = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].C;
-           // R = tc->nurbs_block.ctrl_pts_ptr[tc->nurbs_block.nr_of_ctrl_pts-1].R;
+            xyz.tran.x = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].X;
+            xyz.tran.y = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].Y;
+            xyz.tran.z = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].Z;
+            uvw.tran.x = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].U;
+            uvw.tran.y = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].V;
+            uvw.tran.z = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].W;
+            abc.tran.x = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].A;
+            abc.tran.y = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].B;
+            abc.tran.z = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].C;
+           // R = tc->coords.nurbs.ctrl_pts_ptr[tc->coords.nurbs.nr_of_ctrl_pts-1].R;
         }
     }
     //DP ("GetEndPoint?(%d) R(%.2f) X(%.2f) Y(%.2f) Z(%.2f) A(%.2f)\n",of_endpoint, R, X, Y, Z, A);
@@ -439,6 +646,250 @@ EmcPose tcGetPosReal(TC_STRUCT * tc, int of_endpoint)
 }
 
 
+/*!
+ * \subsection TC velocity limits
+ * These work in the units of the TC, per cycle, and model a change
+ * of velocity the way tcRunCycle() estimates its braking distance: it
+ * starts and ends at zero accel, ramps accel with tc->jerk and holds
+ * it at tc->maxaccel if it gets there.  Such a profile is symmetric,
+ * so it covers its distance at the mean of the two velocities.
+ */
+
+/* time, in cycles, to change velocity by dv */
+static double tcVelChangeTime(TC_STRUCT * tc, double dv)
+{
+    if (dv <= tc->maxaccel * tc->maxaccel / tc->jerk) {
+        return 2.0 * sqrt(dv / tc->jerk);
+    }
+    return dv / tc->maxaccel + tc->maxaccel / tc->jerk;
+}
+
+/*! tcStopDist() function
+ *
+ * \brief distance needed to stop from velocity vel
+ */
+double tcStopDist(TC_STRUCT * tc, double vel)
+{
+    if (vel <= 0) {
+        return 0;
+    }
+    return 0.5 * vel * tcVelChangeTime(tc, vel);
+}
+
+/*! tcStopVel() function
+ *
+ * \brief highest velocity from which tc can stop within dist,
+ * the inverse of tcStopDist()
+ */
+double tcStopVel(TC_STRUCT * tc, double dist)
+{
+    double a = tc->maxaccel;
+    double j = tc->jerk;
+    double vel;
+
+    if (dist <= 0) {
+        return 0;
+    }
+    // dist = vel * sqrt(vel / j) while accel stays below its limit
+    vel = pow(dist * dist * j, 1.0 / 3.0);
+    if (vel <= a * a / j) {
+        return vel;
+    }
+    // dist = vel^2 / 2a + vel * a / 2j
+    return 0.5 * a * (sqrt(a * a / (j * j) + 8.0 * dist / a) - a / j);
+}
+
+/*! tcReachVel() function
+ *
+ * \brief highest velocity tc can reach within dist, starting at vel
+ */
+double tcReachVel(TC_STRUCT * tc, double vel, double dist)
+{
+    double a = tc->maxaccel;
+    double j = tc->jerk;
+    double q, r, u, w, s, dv, b, c;
+
+    if (dist <= 0) {
+        return vel;
+    }
+    // below the accel limit, dist = (2 vel + dv) sqrt(dv / j);
+    // with s = sqrt(dv) that is s^3 + 2 vel s - dist sqrt(j) = 0
+    q = 0.5 * dist * sqrt(j);
+    r = sqrt(q * q + 8.0 / 27.0 * vel * vel * vel);
+    u = pow(q + r, 1.0 / 3.0);
+    w = r - q;
+    w = w > 0 ? pow(w, 1.0 / 3.0) : 0;
+    s = u - w;
+    dv = s * s;
+    if (dv > a * a / j) {
+        // dist = (2 vel + dv) / 2 * (dv / a + a / j)
+        b = a * a / j + 2.0 * vel;
+        c = 2.0 * a * (vel * a / j - dist);
+        dv = 0.5 * (sqrt(b * b - 4.0 * c) - b);
+    }
+    return vel + dv;
+}
+
+/*! tcPlanProfile() function
+ *
+ * \brief work out the parts of the velocity profile of a new tc that
+ * tcRunCycle() would otherwise recompute every cycle
+ */
+void tcPlanProfile(TC_STRUCT * tc)
+{
+    tc->decel_t1 = ceil(tc->maxaccel / tc->jerk);
+    tc->final_dist = tcStopDist(tc, tc->final_vel);
+    tc->profile.valid = 0;
+    tc->profile.vc = -1;    // so that tcRunCycle() plans one
+}
+
+/* distance covered changing velocity from v0 to v1 */
+static double tcVelChangeDist(TC_STRUCT * tc, double v0, double v1)
+{
+    return 0.5 * (v0 + v1) * tcVelChangeTime(tc, fabs(v1 - v0));
+}
+
+/* append the three phases that change vel to v1, starting at zero accel */
+static int tcProfileVelChange(TC_STRUCT * tc, int k, double v1)
+{
+    TC_PROFILE *prof = &tc->profile;
+    double a = tc->maxaccel;
+    double j = tc->jerk;
+    double dv, tj, ta, s;
+    double dt[3], jk[3];
+    int i;
+
+    dv = v1 - prof->v0[k];
+    s = dv < 0 ? -1.0 : 1.0;
+    dv = fabs(dv);
+    if (dv >= a * a / j) {
+        tj = a / j;
+        ta = dv / a - tj;
+    } else {
+        tj = sqrt(dv / j);
+        ta = 0;
+    }
+    dt[0] = tj;     jk[0] = s * j;
+    dt[1] = ta;     jk[1] = 0;
+    dt[2] = tj;     jk[2] = -s * j;
+    for (i = 0; i < 3; i++, k++) {
+        prof->j[k] = jk[i];
+        // S0..S2 when speeding up, S4..S6 when slowing down
+        prof->state[k] = (s > 0 ? ACCEL_S0 : ACCEL_S4) + i;
+        prof->t0[k + 1] = prof->t0[k] + dt[i];
+        prof->p0[k + 1] = prof->p0[k] + prof->v0[k] * dt[i]
+                        + 0.5 * prof->a0[k] * dt[i] * dt[i]
+                        + 1.0 / 6.0 * jk[i] * dt[i] * dt[i] * dt[i];
+        prof->v0[k + 1] = prof->v0[k] + prof->a0[k] * dt[i]
+                        + 0.5 * jk[i] * dt[i] * dt[i];
+        prof->a0[k + 1] = prof->a0[k] + jk[i] * dt[i];
+    }
+    // end the change exactly where it was meant to
+    prof->v0[k] = v1;
+    prof->a0[k] = 0;
+    return k;
+}
+
+/*! tcProfilePlan() function
+ *
+ * \brief plan a closed-form profile from the current progress and
+ * velocity of tc, with zero accel, to the end of the segment
+ *
+ * The profile goes as near vc as it can and ends at target with
+ * velocity ve, ve <= vc.  Returns 0 and sets profile.valid if there
+ * is such a profile, -1 if the segment is too short for it, for
+ * example to slow down to ve from where tc is now.
+ */
+int tcProfilePlan(TC_STRUCT * tc, double vc, double ve)
+{
+    TC_PROFILE *prof = &tc->profile;
+    double v0 = tc->cur_vel;
+    double dist = tc->target - tc->progress;
+    double vp, lo, hi;
+    int i, k;
+
+    prof->valid = 0;
+    prof->vc = vc;
+    prof->ve = ve;
+    if (dist <= 0 || v0 < 0 || ve > vc) {
+        return -1;
+    }
+
+    // highest vp <= vc that leaves some distance at vp; the distance
+    // grows with vp from max(v0, ve) up
+    vp = vc;
+    if (tcVelChangeDist(tc, v0, vp) + tcVelChangeDist(tc, vp, ve) > dist) {
+        lo = v0 > ve ? v0 : ve;
+        if (lo > vc ||
+            tcVelChangeDist(tc, v0, lo) + tcVelChangeDist(tc, lo, ve) > dist) {
+            return -1;
+        }
+        hi = vc;
+        for (i = 0; i < 40; i++) {
+            vp = 0.5 * (lo + hi);
+            if (tcVelChangeDist(tc, v0, vp) + tcVelChangeDist(tc, vp, ve) > dist) {
+                hi = vp;
+            } else {
+                lo = vp;
+            }
+        }
+        vp = lo;
+    }
+
+    prof->t0[0] = 0;
+    prof->p0[0] = tc->progress;
+    prof->v0[0] = v0;
+    prof->a0[0] = 0;
+    k = tcProfileVelChange(tc, 0, vp);
+
+    // hold vp for what is left
+    prof->j[k] = 0;
+    prof->state[k] = ACCEL_S3;
+    prof->t0[k + 1] = prof->t0[k];
+    if (vp > 0) {
+        prof->t0[k + 1] += (dist - tcVelChangeDist(tc, v0, vp)
+                            - tcVelChangeDist(tc, vp, ve)) / vp;
+    }
+    prof->p0[k + 1] = prof->p0[k] + vp * (prof->t0[k + 1] - prof->t0[k]);
+    prof->v0[k + 1] = vp;
+    prof->a0[k + 1] = 0;
+    k = tcProfileVelChange(tc, k + 1, ve);
+
+    // and then stay at ve, from exactly the end of the segment
+    prof->j[k] = 0;
+    prof->state[k] = ACCEL_S3;
+    prof->p0[k] = tc->target;
+
+    prof->t = 0;
+    prof->phase = 0;
+    prof->valid = 1;
+    return 0;
+}
+
+/*! tcProfileStep() function
+ *
+ * \brief advance tc by one cycle along its closed-form profile
+ */
+void tcProfileStep(TC_STRUCT * tc)
+{
+    TC_PROFILE *prof = &tc->profile;
+    double dt;
+    int k = prof->phase;
+
+    prof->t += 1.0;
+    while (k < TC_PROFILE_PHASES - 1 && prof->t >= prof->t0[k + 1]) {
+        k++;
+    }
+    prof->phase = k;
+    dt = prof->t - prof->t0[k];
+    tc->progress = prof->p0[k] + prof->v0[k] * dt
+                 + 0.5 * prof->a0[k] * dt * dt
+                 + 1.0 / 6.0 * prof->j[k] * dt * dt * dt;
+    tc->cur_vel = prof->v0[k] + prof->a0[k] * dt + 0.5 * prof->j[k] * dt * dt;
+    tc->cur_accel = prof->a0[k] + prof->j[k] * dt;
+    tc->accel_state = prof->state[k];
+}
+
 /*!
  * \subsection TC queue functions
  * These following functions implement the motion queue that
@@ -591,7 +1042,6 @@ int tcqPut(TC_QUEUE_STRUCT * tcq, TC_STRUCT tc)
  */   
 int tcqRemove(TC_QUEUE_STRUCT * tcq, int n)
 {
-    int i;
     if (n <= 0) {
 	    return 0;		/* okay to remove 0 or fewer */
     }
@@ -602,19 +1052,6 @@ int tcqRemove(TC_QUEUE_STRUCT * tcq, int n)
 	    return -1;
     }
 
-#ifndef RTAPI
-    /* for NURBS only */
-    for(i=tcq->start;i<(tcq->start+n);i++){
-        if(tcq->queue[i].motion_type == TC_NURBS) {
-            //fprintf(stderr,"Remove TCNURBS PARAM\n");
-            free(tcq->queue[i].nurbs_block.knots_ptr);
-            free(tcq->queue[i].nurbs_block.ctrl_pts_ptr);
-            free(tcq->queue[i].nurbs_block.N);
-
-        }
-    }
-#endif //RTAPI
-
     /* update start ptr and reset allFull flag and len */
     tcq->start = (tcq->start + n) % tcq->size;
     tcq->allFull = 0;
@@ -663,12 +1100,6 @@ TC_STRUCT *tcqItem(TC_QUEUE_STRUCT * tcq, int n, long period)
     return t;
 }
 
-/*! 
- * \def TC_QUEUE_MARGIN
- * sets up a margin at the end of the queue, to reduce effects of race conditions
- */
-#define TC_QUEUE_MARGIN 10
-
 /*! tcqFull() function
  *
  * \brief get the full status of the queue 
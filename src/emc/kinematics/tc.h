@@ -35,10 +35,20 @@ typedef struct {
     PmLine uvw;
 } PmLine9;
 
+/* where tcGetPos last was on an arc, so the next point can be had by
+   rotating from there instead of from the start of the arc */
+typedef struct {
+    int valid;              // c and s are the cos and sin of angle
+    int steps;              // rotations since they were last exact
+    double angle;
+    double c, s;
+} PmArcStep;
+
 typedef struct {
     PmCircle xyz;
     PmLine abc;
     PmLine uvw;
+    PmArcStep step;         // only tcGetPos uses and updates it
 } PmCircle9;
 
 typedef enum {
@@ -86,34 +96,51 @@ enum smlblnd_type {
   SMLBLND_DISABLE   // 2
 };
 
+/* a closed-form jerk-limited velocity profile: up to 7 phases of
+   constant jerk taking the velocity from its start to vp, holding vp
+   and then going on to ve, and a last phase that stays at ve.  Times
+   are in cycles from when the profile was planned. */
+#define TC_PROFILE_PHASES 8
+
+typedef struct {
+    int valid;              // tcRunCycle follows it instead of stepping
+    int phase;              // phase the last evaluation was in
+    double t;               // cycles since it was planned
+    double vc;              // requested vel it was planned for
+    double ve;              // end vel it was planned for
+    double t0[TC_PROFILE_PHASES];   // start of each phase
+    double p0[TC_PROFILE_PHASES];   // progress, vel and accel at
+    double v0[TC_PROFILE_PHASES];   // the start of each phase
+    double a0[TC_PROFILE_PHASES];
+    double j[TC_PROFILE_PHASES];    // jerk during each phase
+    enum state_type state[TC_PROFILE_PHASES];
+} TC_PROFILE;
+
 typedef struct {
     double cycle_time;
     double progress;        // where are we in the segment?  0..target
     double target;          // segment length
     double distance_to_go;  // distance to go for target target..0
-    int    motion_param_set;
-    double ori_reqvel;      // track of original reqvel in this tc
-    double ori_feed_override; // track of original feed override
     double reqvel;          // vel requested by F word, calc'd by task
+    double queue_time;      // target / reqvel, counted in tp->queueTime
     double maxaccel;        // accel calc'd by task
     double jerk;            // the accelrate of accel
     double feed_override;   // feed override requested by user
     double maxvel;          // max possible vel (feed override stops here)
     double cur_vel;         // keep track of current step (vel * cycle_time)
     double cur_accel;       // keep track of current acceleration
-    double accel_dist;      // keep track of acceleration distance
-    double decel_dist;      // distance to start deceleration
-    double accel_time;      // keep track of acceleration time
-    double vel_from;        // track velocity before speed change
-    double target_vel;
-    double dist_comp;
-    int    on_feed_change;
-    int    prev_state;
-    nurbs_block_t nurbs_block; // nurbs command block
-    double *N;                  // nurbs basis function buffer
+    int nurbs_slice_end;        // end of our slice of the TP NURBS pool
+    int nurbs_slice_len;        // doubles to give back to the pool on retire
     enum state_type accel_state;
     enum smlblnd_type seamless_blend_mode;
-    double nexttc_target;
+    double blend_vel;       // highest vel at the junction with the next tc
+    double stop_vel;        // highest final vel from which the rest of
+                            // the queue can still stop in time
+    double final_vel;       // planned vel at the end of this tc, what
+                            // tcRunCycle follows when blending seamlessly
+    double final_dist;      // tcStopDist() of final_vel, kept with it
+    double decel_t1;        // cycles to ramp accel to maxaccel, rounded up
+    TC_PROFILE profile;     // closed-form profile, when there is one
     
     int id;                 // segment's serial number
 
@@ -121,11 +148,13 @@ typedef struct {
         PmLine9 line;
         PmCircle9 circle;
         PmRigidTap rigidtap;
+        nurbs_block_t nurbs;    // points into the TP NURBS pool
     } coords;
 
     char motion_type;       // TC_LINEAR (coords.line) or 
                             // TC_CIRCULAR (coords.circle) or
-                            // TC_RIGIDTAP (coords.rigidtap)
+                            // TC_RIGIDTAP (coords.rigidtap) or
+                            // TC_NURBS (coords.nurbs)
     char active;            // this motion is being executed
     int canon_motion_type;  // this motion is due to which canon function?
     int blend_with_next;    // gcode requests continuous feed at the end of 
@@ -141,11 +170,15 @@ typedef struct {
     int sync_accel;         // we're accelerating up to sync with the spindle
     unsigned char enables;  // Feed scale, etc, enable bits for this move
     char atspeed;           // wait for the spindle to be at-speed before starting this move
-    syncdio_t syncdio;      // synched DIO's for this move. what to turn on/off
+    int syncdio_slot;       // synched DIO's for this move, what to turn
+                            // on/off, in the TP pool; -1 if none
     int indexrotary;        // which rotary axis to unlock to make this move, -1 for none
+    double arc_trim;        // length cut off the start of this line for
+                            // the blend arc before it, see tpSetArcBlend()
 
     PmCartesian utvIn;      // unit tangent vector inward
     PmCartesian utvOut;     // unit tangent vector outward
+    EmcPose endpoint;       // tcGetPosReal(tc, 1), worked out when queued
 } TC_STRUCT;
 
 /* TC_STRUCT functions */
@@ -155,9 +188,21 @@ extern EmcPose tcGetPos(TC_STRUCT * tc);
 EmcPose tcGetPosReal(TC_STRUCT * tc, int of_endpoint);
 PmCartesian tcGetEndingUnitVector(TC_STRUCT *tc);
 PmCartesian tcGetStartingUnitVector(TC_STRUCT *tc);
+double tcStopDist(TC_STRUCT * tc, double vel);
+double tcStopVel(TC_STRUCT * tc, double dist);
+double tcReachVel(TC_STRUCT * tc, double vel, double dist);
+void tcPlanProfile(TC_STRUCT * tc);
+int tcProfilePlan(TC_STRUCT * tc, double vc, double ve);
+void tcProfileStep(TC_STRUCT * tc);
 
 /* queue of TC_STRUCT elements*/
 
+/*! 
+ * \def TC_QUEUE_MARGIN
+ * sets up a margin at the end of the queue, to reduce effects of race conditions
+ */
+#define TC_QUEUE_MARGIN 10
+
 typedef struct {
     TC_STRUCT *queue;		/* ptr to the tcs */
     int size;			/* size of queue */
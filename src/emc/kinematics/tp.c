@@ -30,6 +30,7 @@
 #include "../motion/motion.h"
 #include "hal.h"
 #include "../motion/mot_priv.h"
+#include "motion_types.h"
 #include "motion_debug.h"
 
 // #undef SMLBLND       // turn off seamless blending
@@ -67,6 +68,10 @@ int tpCreate(TP_STRUCT * tp, int _queueSize, TC_STRUCT * tcSpace)
 	return -1;
     }
 
+    /* no NURBS storage until tpSetNurbsPool() */
+    tp->nurbs_pool.space = 0;
+    tp->nurbs_pool.size = 0;
+
 #if (TRACE!=0)
     if (!dptrace) {
         dptrace = fopen("tp.log", "w");
@@ -104,6 +109,143 @@ int tpClearDIOs() {
     return 0;
 }
 
+static void tpNurbsPoolReset(TP_NURBS_POOL * pool)
+{
+    pool->start = 0;
+    pool->end = 0;
+    pool->used = 0;
+}
+
+/* doubles of pool storage a NURBS curve needs: control points, knots,
+   arc length table, the basis function buffer and the span coefficient
+   cache */
+static int tpNurbsSliceSize(int nr_of_ctrl_pts, int nr_of_knots,
+                            int nr_of_arclen, int order)
+{
+    return nr_of_ctrl_pts * (sizeof(CONTROL_POINT) / sizeof(double)) +
+        nr_of_knots + NURBS_ARCLEN_STRIDE * nr_of_arclen + order + 1 + order * NURBS_CHANNELS;
+}
+
+/* takes n doubles from the end of the pool, wrapping around to the start
+   if they do not fit in front of the end of the pool memory */
+static double *tpNurbsPoolAlloc(TP_NURBS_POOL * pool, int n, TC_STRUCT * tc)
+{
+    int pos, skip = 0;
+
+    if (0 == pool->space) {
+        return 0;
+    }
+    pos = pool->end;
+    if (pool->size - pos < n) {
+        skip = pool->size - pos;
+        pos = 0;
+    }
+    if (pool->used + skip + n > pool->size) {
+        return 0;
+    }
+    pool->end = pos + n;
+    pool->used += skip + n;
+    tc->nurbs_slice_end = pool->end;
+    tc->nurbs_slice_len = skip + n;
+    return &pool->space[pos];
+}
+
+/* gives the slice of a retiring segment back; segments retire in queue
+   order, so this is always the oldest slice */
+static void tpNurbsPoolRetire(TP_NURBS_POOL * pool, TC_STRUCT * tc)
+{
+    if (tc->motion_type != TC_NURBS || 0 == pool->space) {
+        return;
+    }
+    pool->start = tc->nurbs_slice_end;
+    pool->used -= tc->nurbs_slice_len;
+    if (pool->used <= 0) {
+        tpNurbsPoolReset(pool);
+    }
+}
+
+int tpSetNurbsPool(TP_STRUCT * tp, double *space, int size)
+{
+    if (0 == tp || size < 0) {
+        return -1;
+    }
+    tp->nurbs_pool.space = space;
+    tp->nurbs_pool.size = space ? size : 0;
+    tpNurbsPoolReset(&tp->nurbs_pool);
+    return 0;
+}
+
+/* the pool counts as full once the largest curve the NURBS arena can
+   carry might not fit any more, so task holds back like for a full queue */
+int tpNurbsPoolFull(TP_STRUCT * tp)
+{
+    TP_NURBS_POOL *pool = &tp->nurbs_pool;
+    int reserve;
+
+    if (0 == pool->space) {
+        return 0;
+    }
+    reserve = tpNurbsSliceSize(EMCMOT_NURBS_ARENA_SIZE,
+                               EMCMOT_NURBS_ARENA_SIZE,
+                               EMCMOT_NURBS_ARENA_SIZE / 2, NURBS_MAX_ORDER);
+    if (reserve > pool->size / 2) {
+        reserve = pool->size / 2;
+    }
+    return pool->size - pool->used < reserve;
+}
+
+static void tpSyncdioPoolReset(TP_SYNCDIO_POOL * pool)
+{
+    pool->start = 0;
+    pool->used = 0;
+}
+
+/* moves the synched I/O recorded since the last move, if any, into a
+   record of its own for tc */
+static int tpSyncdioPoolAlloc(TP_STRUCT * tp, TC_STRUCT * tc)
+{
+    TP_SYNCDIO_POOL *pool = &tp->syncdio_pool;
+
+    tc->syncdio_slot = -1;
+    if (syncdio.anychanged == 0 && syncdio.sync_input_triggered == 0) {
+        return 0;
+    }
+    if (pool->used >= TP_SYNCDIO_POOL_SIZE) {
+        return -1;
+    }
+    tc->syncdio_slot = (pool->start + pool->used) % TP_SYNCDIO_POOL_SIZE;
+    pool->used++;
+    pool->dio[tc->syncdio_slot] = syncdio; //enqueue the list of DIOs that need toggling
+    tpClearDIOs(); // clear out the list, in order to prepare for the next time we need to use it
+    return 0;
+}
+
+/* undoes tpSyncdioPoolAlloc() for a segment that did not get queued */
+static void tpSyncdioPoolDrop(TP_STRUCT * tp, TC_STRUCT * tc)
+{
+    if (tc->syncdio_slot < 0) {
+        return;
+    }
+    syncdio = tp->syncdio_pool.dio[tc->syncdio_slot];
+    tp->syncdio_pool.used--;
+    tc->syncdio_slot = -1;
+}
+
+/* segments retire in queue order, so a retiring record is the oldest */
+static void tpSyncdioPoolRetire(TP_SYNCDIO_POOL * pool, TC_STRUCT * tc)
+{
+    if (tc->syncdio_slot < 0) {
+        return;
+    }
+    pool->start = (pool->start + 1) % TP_SYNCDIO_POOL_SIZE;
+    pool->used--;
+}
+
+int tpSyncdioPoolFull(TP_STRUCT * tp)
+{
+    return tp->syncdio_pool.used >= TP_SYNCDIO_POOL_SIZE;
+}
+
 /*
   tpClear() is a "soft init" in the sense that the TP_STRUCT configuration
   parameters (cycleTime, vMax, and aMax) are left alone, but the queue is
@@ -116,6 +258,8 @@ int tpClearDIOs() {
 int tpClear(TP_STRUCT * tp)
 {
     tcqInit(&tp->queue);
+    tpNurbsPoolReset(&tp->nurbs_pool);
+    tpSyncdioPoolReset(&tp->syncdio_pool);
     tp->queueSize = 0;
     tp->goalPos = tp->currentPos;
     tp->nextId = 0;
@@ -125,6 +269,7 @@ int tpClear(TP_STRUCT * tp)
     tp->tolerance = 0.0;
     tp->done = 1;
     tp->depth = tp->activeDepth = 0;
+    tp->queueTime = 0.0;
     tp->aborting = 0;
     tp->pausing = 0;
     tp->vScale = emcmotStatus->net_feed_scale;
@@ -150,6 +295,8 @@ int tpInit(TP_STRUCT * tp)
     tp->ini_maxvel = 0.0;
     tp->wMax = 0.0;
     tp->wDotMax = 0.0;
+    tp->rapidTolerance = 0.0;
+    tp->arcBlend = 0;
 
     ZERO_EMC_POSE(tp->currentPos);
     
@@ -264,6 +411,42 @@ int tpSetTermCond(TP_STRUCT * tp, int cond, double tolerance)
     return 0;
 }
 
+/*
+  tpSetRapidTolerance(tp, tolerance) lets a traverse blend into the
+  traverse queued after it, within tolerance, whatever the termination
+  condition, so a retract, traverse and plunge don't stop at each
+  corner.  Into a feed move it only blends if the feed was queued to
+  blend as well, within the smaller of the two tolerances, so G61
+  still arrives at the start of the cut exactly.  0 turns it off.
+  */
+int tpSetRapidTolerance(TP_STRUCT * tp, double tolerance)
+{
+    if (0 == tp || tolerance < 0.0) {
+	return -1;
+    }
+
+    tp->rapidTolerance = tolerance;
+
+    return 0;
+}
+
+/*
+  tpSetArcBlend(tp, on) makes tpAddLine() round the corner between two
+  feed lines that blend with a G64 P tolerance with a tangent arc of its
+  own, see tpAddBlendArc(), instead of overlapping the end of one with
+  the start of the other.  It applies to lines queued after.
+  */
+int tpSetArcBlend(TP_STRUCT * tp, int on)
+{
+    if (0 == tp) {
+	return -1;
+    }
+
+    tp->arcBlend = on != 0;
+
+    return 0;
+}
+
 // Used to tell the tp the initial position.  It sets
 // the current position AND the goal position to be the same.  
 // Used only at TP initialization and when switching modes.
@@ -280,6 +463,153 @@ int tpSetPos(TP_STRUCT * tp, EmcPose pos)
     return 0;
 }
 
+/* Gives a traverse that has not started yet the rapid blend tolerance
+   once the segment after it is known, see tpSetRapidTolerance().  It
+   runs before the look-ahead decides on seamless blending, so that
+   plans the velocity through the corner as for any other blend. */
+static void tpRapidBlend(TP_STRUCT * tp)
+{
+    TC_STRUCT *tc, *prevtc;
+    double tolerance = tp->rapidTolerance;
+    int len;
+
+    len = tcqLen(&tp->queue);
+    if (tolerance <= 0.0 || len < 2) {
+        return;
+    }
+    tc = tcqItem(&tp->queue, len - 1, 0);
+    prevtc = tcqItem(&tp->queue, len - 2, 0);
+    if (prevtc->active || prevtc->motion_type != TC_LINEAR ||
+        prevtc->canon_motion_type != EMC_MOTION_TYPE_TRAVERSE ||
+        prevtc->seamless_blend_mode != SMLBLND_INIT) {
+        return;
+    }
+
+    if (tc->canon_motion_type != EMC_MOTION_TYPE_TRAVERSE) {
+        // into a feed only where the feed itself blends, and no
+        // further from its start than it may stray from its path
+        if (tc->canon_motion_type != EMC_MOTION_TYPE_FEED &&
+            tc->canon_motion_type != EMC_MOTION_TYPE_ARC) {
+            return;
+        }
+        if (!tc->blend_with_next || tc->synchronized || tc->atspeed) {
+            return;
+        }
+        if (tc->tolerance > 0.0 && tc->tolerance < tolerance) {
+            tolerance = tc->tolerance;
+        }
+    }
+    prevtc->blend_with_next = 1;
+    prevtc->tolerance = tolerance;
+    DPS("rapid blend: id(%d) tolerance(%f)\n", prevtc->id, tolerance);
+}
+
+/* Look-ahead, run each time a segment is added to the queue.
+
+   First it decides whether the previous tail can blend seamlessly into
+   the new one, which used to be decided in tpRunCycle once the tail was
+   running.  Then a backward pass walks from the tail towards the head
+   and gives each seamless segment a stop_vel: the highest velocity it
+   may end with such that every following segment can still stop by the
+   end of the queue.  The new tail has no successor yet, so it ends at
+   0.  The pass stops at a segment that does not blend seamlessly, after
+   TP_LOOKAHEAD_DEPTH segments, or where stop_vel comes out unchanged,
+   because then nothing before it changes either.  A forward pass then
+   lowers each final_vel to what can actually be reached from the end
+   of the segment before.  tcRunCycle plans to stop final_vel's braking
+   distance past the end of the segment, so it passes the end at about
+   final_vel, and the queue can keep programmed feed over many short
+   segments instead of planning to stop at the end of the next one.
+
+   Appending segments only ever raises stop_vel, so segments beyond the
+   depth limit keep a lower, still safe, value. */
+static void tpLookahead(TP_STRUCT * tp)
+{
+    tpRapidBlend(tp);
+#ifdef SMLBLND
+    TC_STRUCT *tc, *prevtc, *nexttc;
+    int len, i, first;
+    double dot, rv, vel;
+
+    len = tcqLen(&tp->queue);
+    if (len < 2) {
+        return;
+    }
+    tc = tcqItem(&tp->queue, len - 1, 0);
+    prevtc = tcqItem(&tp->queue, len - 2, 0);
+
+    if (prevtc->seamless_blend_mode == SMLBLND_INIT) {
+        // the same conditions tpRunCycle uses to stop at the end of
+        // prevtc instead of blending
+        int this_synch_pos = prevtc->synchronized && !prevtc->velocity_mode;
+        int next_synch_pos = tc->synchronized && !tc->velocity_mode;
+
+        prevtc->seamless_blend_mode = SMLBLND_DISABLE;
+        if (prevtc->blend_with_next && tc->maxaccel && !tc->atspeed &&
+            !(!this_synch_pos && next_synch_pos) &&
+            prevtc->motion_type != TC_NURBS && tc->motion_type != TC_NURBS) {
+            rv = prevtc->reqvel * tp->cycleTime;
+            if (rv > prevtc->maxvel) {
+                rv = prevtc->maxvel;
+            }
+            // allow seamless blending if the centripetal acceleration
+            // of turning the corner within one cycle is acceptable
+            pmCartCartDot(prevtc->utvOut, tc->utvIn, &dot);
+            if (dot > 1.0) {
+                dot = 1.0;
+            }
+            if (acos(dot) * rv < prevtc->maxaccel) {
+                prevtc->seamless_blend_mode = SMLBLND_ENABLE;
+                prevtc->blend_vel = prevtc->maxvel < tc->maxvel ?
+                                    prevtc->maxvel : tc->maxvel;
+            }
+        }
+        DPS("lookahead: id(%d) seamless(%d)\n",
+            prevtc->id, prevtc->seamless_blend_mode);
+    }
+
+    // backward pass
+    first = len - 1;
+    for (i = len - 2; i >= 0 && i >= len - 1 - TP_LOOKAHEAD_DEPTH; i--) {
+        tc = tcqItem(&tp->queue, i, 0);
+        if (tc->seamless_blend_mode != SMLBLND_ENABLE) {
+            break;
+        }
+        nexttc = tcqItem(&tp->queue, i + 1, 0);
+        vel = tcStopVel(nexttc, nexttc->target + nexttc->final_dist);
+        if (vel > tc->blend_vel) {
+            vel = tc->blend_vel;
+        }
+        if (vel == tc->stop_vel) {
+            break;
+        }
+        tc->stop_vel = vel;
+        first = i;
+    }
+
+    // forward pass, from the first segment the backward pass changed;
+    // the active head segment is left alone, its velocity is live
+    for (i = first; i < len - 1; i++) {
+        tc = tcqItem(&tp->queue, i, 0);
+        tc->final_vel = tc->stop_vel;
+        if (i > 0 || !tc->active) {
+            vel = 0;
+            if (i > 0) {
+                prevtc = tcqItem(&tp->queue, i - 1, 0);
+                if (prevtc->seamless_blend_mode == SMLBLND_ENABLE) {
+                    vel = prevtc->final_vel;
+                }
+            }
+            vel = tcReachVel(tc, vel, tc->target);
+            if (vel < tc->final_vel) {
+                tc->final_vel = vel;
+            }
+        }
+        tc->final_dist = tcStopDist(tc, tc->final_vel);
+    }
+#endif // SMLBLND
+}
+
 int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel, 
                   double ini_maxvel, double acc, 
                   double jerk, unsigned char enables) 
@@ -355,7 +685,9 @@ int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel,
     tc.blend_with_next = 0;
     tc.tolerance = tp->tolerance;
     tc.seamless_blend_mode = SMLBLND_DISABLE;
-    tc.nexttc_target = 0;
+    tc.blend_vel = 0;
+    tc.stop_vel = 0;
+    tc.final_vel = 0;
 
     if(!tp->synchronized) {
         rtapi_print_msg(RTAPI_MSG_ERR, "Cannot add unsynchronized rigid tap move.\n");
@@ -368,17 +700,19 @@ int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel,
     tc.velocity_mode = tp->velocity_mode;
     tc.enables = enables;
     tc.indexrotary = -1;
+    tc.arc_trim = 0;
 
-    if ((syncdio.anychanged != 0) || (syncdio.sync_input_triggered != 0)) {
-	tc.syncdio = syncdio; //enqueue the list of DIOs that need toggling
-	tpClearDIOs(); // clear out the list, in order to prepare for the next time we need to use it
-    } else {
-	tc.syncdio.anychanged = 0;
-        tc.syncdio.sync_input_triggered = 0;
+    if (tpSyncdioPoolAlloc(tp, &tc) == -1) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "synched I/O pool full\n");
+        return -1;
     }
 
+    tcPlanProfile(&tc);
+    tc.endpoint = tcGetPosReal(&tc, 1);
+    tc.queue_time = tc.reqvel > 0.0 ? tc.target / tc.reqvel : 0.0;
     if (tcqPut(&tp->queue, tc) == -1) {
         rtapi_print_msg(RTAPI_MSG_ERR, "tcqPut failed.\n");
+        tpSyncdioPoolDrop(tp, &tc);
 	return -1;
     }
     
@@ -387,11 +721,131 @@ int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel,
 
     tp->done = 0;
     tp->depth = tcqLen(&tp->queue);
+    tp->queueTime += tc.queue_time;
     tp->nextId++;
+    tpLookahead(tp);
 
     return 0;
 }
 
+/* Moves the end of a queued line that has not started to end, and
+   what depends on its length with it. */
+static void tpSetLineEnd(TP_STRUCT * tp, TC_STRUCT * tc, PmCartesian end)
+{
+    PmPose pose;
+
+    pose = tc->coords.line.xyz.end;
+    pose.tran = end;
+    pmLineInit(&tc->coords.line.xyz, tc->coords.line.xyz.start, pose);
+    tc->target = tc->distance_to_go = tc->coords.line.xyz.tmag;
+    tp->queueTime -= tc->queue_time;
+    tc->queue_time = tc->reqvel > 0.0 ? tc->target / tc->reqvel : 0.0;
+    tp->queueTime += tc->queue_time;
+    tcPlanProfile(tc);
+    tc->endpoint = tcGetPosReal(tc, 1);
+}
+
+/* Corner arcs, see tpSetArcBlend().  tpAddLine() calls this before it
+   queues a feed line along line_xyz from the end of the queue.  If the
+   tail is a feed line that blends into it, the tail's end and the new
+   line's start are both cut back by d and a tangent arc is queued in
+   between, as a segment of its own, whose middle is no further from the
+   corner than the smaller G64 tolerance.  d is held to 0.4 of the
+   shorter line as programmed, so each keeps a straight part for the
+   corner at its other end.  The arc is held to the speed at which the
+   centripetal accel stays within acc, and that accel is reached, going
+   onto the arc, within ini_maxjerk; the look-ahead then blends
+   seamlessly into and out of it.  The arc gets the id of the new line.
+   Returns d, or 0 if no arc was queued. */
+static double tpAddBlendArc(TP_STRUCT * tp, PmLine * line_xyz, int type,
+        double vel, double ini_maxvel, double acc, double ini_maxjerk,
+        unsigned char enables)
+{
+    TC_STRUCT *prevtc;
+    PmCartesian u1, u2, corner, start, end, center, bisect, normal, v;
+    EmcPose arc_end;
+    double dot, h, tolerance, r, d, max_d, prev_len, prev_acc, max_vel;
+    int len, id;
+
+    len = tcqLen(&tp->queue);
+    if (len < 1 || tcqFull(&tp->queue)) {
+        return 0;
+    }
+    prevtc = tcqItem(&tp->queue, len - 1, 0);
+    if (prevtc->active || prevtc->motion_type != TC_LINEAR ||
+        prevtc->canon_motion_type != EMC_MOTION_TYPE_FEED ||
+        !prevtc->blend_with_next || prevtc->tolerance <= 0.0 ||
+        prevtc->synchronized || prevtc->seamless_blend_mode != SMLBLND_INIT ||
+        prevtc->coords.line.xyz.tmag_zero ||
+        !prevtc->coords.line.uvw.tmag_zero ||
+        !prevtc->coords.line.abc.tmag_zero) {
+        return 0;
+    }
+
+    u1 = prevtc->coords.line.xyz.uVec;
+    u2 = line_xyz->uVec;
+    pmCartCartDot(u1, u2, &dot);
+    // nearly straight on is left to seamless blending, and a reversal
+    // has no arc
+    if (dot > TP_ARC_BLEND_MAX_DOT || dot < -TP_ARC_BLEND_MAX_DOT) {
+        return 0;
+    }
+    h = acos(dot) / 2.0;
+    tolerance = prevtc->tolerance < tp->tolerance ?
+                prevtc->tolerance : tp->tolerance;
+    r = tolerance * cos(h) / (1.0 - cos(h));
+    d = r * tan(h);
+    prev_len = prevtc->target + prevtc->arc_trim;
+    max_d = 0.4 * (prev_len < line_xyz->tmag ? prev_len : line_xyz->tmag);
+    if (d > max_d) {
+        d = max_d;
+        r = d / tan(h);
+    }
+
+    prev_acc = prevtc->maxaccel / (tp->cycleTime * tp->cycleTime);
+    if (prev_acc < acc) {
+        acc = prev_acc;
+    }
+    max_vel = pmSqrt(acc * r);
+    if (pow(ini_maxjerk * r * r, 1.0 / 3.0) < max_vel) {
+        max_vel = pow(ini_maxjerk * r * r, 1.0 / 3.0);
+    }
+    if (vel > max_vel) {
+        vel = max_vel;
+    }
+    if (ini_maxvel > max_vel) {
+        ini_maxvel = max_vel;
+    }
+
+    corner = line_xyz->start.tran;
+    pmCartScalMult(u1, -d, &v);
+    pmCartCartAdd(corner, v, &start);
+    pmCartScalMult(u2, d, &v);
+    pmCartCartAdd(corner, v, &end);
+    pmCartCartSub(u2, u1, &bisect);
+    pmCartUnit(bisect, &bisect);
+    pmCartScalMult(bisect, r / cos(h), &v);
+    pmCartCartAdd(corner, v, &center);
+    pmCartCartCross(u1, u2, &normal);
+    pmCartUnit(normal, &normal);
+
+    tpSetLineEnd(tp, prevtc, start);
+    tp->goalPos.tran = start;
+    arc_end = tp->goalPos;
+    arc_end.tran = end;
+    id = tp->nextId;
+    if (tpAddCircle(tp, arc_end, center, normal, 0, type, vel, ini_maxvel,
+                    acc, ini_maxjerk, enables, 0) != 0) {
+        tpSetLineEnd(tp, prevtc, corner);
+        tp->goalPos.tran = corner;
+        return 0;
+    }
+    tp->nextId = id;
+    DPS("arc blend: id(%d) r(%f) d(%f) vel(%f)\n", id, r, d, vel);
+
+    return d;
+}
+
 // Add a straight line to the tc queue.  This is a coordinated
 // move in any or all of the six axes.  it goes from the end
 // of the previous move to the new end specified here at the
@@ -408,6 +862,7 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel,
     PmPose start_uvw, end_uvw;
     PmPose start_abc, end_abc;
     PmQuaternion identity_quat = { 1.0, 0.0, 0.0, 0.0 };
+    double arc_trim = 0;
 
     if (ini_maxjerk == 0) {
         rtapi_print_msg(RTAPI_MSG_ERR, "jerk is not provided or jerk is 0\n");
@@ -450,6 +905,18 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel,
     pmLineInit(&line_uvw, start_uvw, end_uvw);
     pmLineInit(&line_abc, start_abc, end_abc);
 
+    if (tp->arcBlend && tp->termCond == TC_TERM_COND_BLEND &&
+        tp->tolerance > 0.0 && type == EMC_MOTION_TYPE_FEED && !atspeed &&
+        !tp->synchronized && !line_xyz.tmag_zero &&
+        line_uvw.tmag_zero && line_abc.tmag_zero) {
+        arc_trim = tpAddBlendArc(tp, &line_xyz, type, vel, ini_maxvel, acc,
+                                 ini_maxjerk, enables);
+        if (arc_trim > 0) {
+            start_xyz.tran = tp->goalPos.tran;
+            pmLineInit(&line_xyz, start_xyz, end_xyz);
+        }
+    }
+
     tc.sync_accel = 0;
     tc.cycle_time = tp->cycleTime;
 
@@ -484,7 +951,9 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel,
     tc.blend_with_next = tp->termCond == TC_TERM_COND_BLEND;
     tc.tolerance = tp->tolerance;
     tc.seamless_blend_mode = SMLBLND_INIT;
-    tc.nexttc_target = 0;
+    tc.blend_vel = 0;
+    tc.stop_vel = 0;
+    tc.final_vel = 0;
 
     tc.synchronized = tp->synchronized;
     tc.velocity_mode = tp->velocity_mode;
@@ -492,20 +961,22 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel,
     tc.css_progress_cmd = 0;
     tc.enables = enables;
     tc.indexrotary = indexrotary;
+    tc.arc_trim = arc_trim;
 
-    if ((syncdio.anychanged != 0) || (syncdio.sync_input_triggered != 0)) {
-	tc.syncdio = syncdio; //enqueue the list of DIOs that need toggling
-	tpClearDIOs(); // clear out the list, in order to prepare for the next time we need to use it
-    } else {
-	tc.syncdio.anychanged = 0;
-        tc.syncdio.sync_input_triggered = 0;
+    if (tpSyncdioPoolAlloc(tp, &tc) == -1) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "synched I/O pool full\n");
+        return -1;
     }
     
     tc.utvIn = line_xyz.uVec;
     tc.utvOut = line_xyz.uVec;
     
+    tcPlanProfile(&tc);
+    tc.endpoint = tcGetPosReal(&tc, 1);
+    tc.queue_time = tc.reqvel > 0.0 ? tc.target / tc.reqvel : 0.0;
     if (tcqPut(&tp->queue, tc) == -1) {
         rtapi_print_msg(RTAPI_MSG_ERR, "tcqPut failed.\n");
+        tpSyncdioPoolDrop(tp, &tc);
 	return -1;
     }
 
@@ -513,7 +984,9 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel,
                             // the start of the next one.
     tp->done = 0;
     tp->depth = tcqLen(&tp->queue);
+    tp->queueTime += tc.queue_time;
     tp->nextId++;
+    tpLookahead(tp);
 
     return 0;
 }
@@ -602,12 +1075,15 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end, PmCartesian center,
     tc.coords.circle.xyz = circle;
     tc.coords.circle.uvw = line_uvw;
     tc.coords.circle.abc = line_abc;
+    tc.coords.circle.step.valid = 0;
     tc.motion_type = TC_CIRCULAR;
     tc.canon_motion_type = type;
     tc.blend_with_next = tp->termCond == TC_TERM_COND_BLEND;
     tc.tolerance = tp->tolerance;
     tc.seamless_blend_mode = SMLBLND_INIT;
-    tc.nexttc_target = 0;
+    tc.blend_vel = 0;
+    tc.stop_vel = 0;
+    tc.final_vel = 0;
 
     tc.synchronized = tp->synchronized;
     tc.velocity_mode = tp->velocity_mode;
@@ -615,53 +1091,47 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end, PmCartesian center,
     tc.css_progress_cmd = 0;
     tc.enables = enables;
     tc.indexrotary = -1;
+    tc.arc_trim = 0;
     
-    if ((syncdio.anychanged != 0) || (syncdio.sync_input_triggered != 0)) {
-	tc.syncdio = syncdio; //enqueue the list of DIOs that need toggling
-	tpClearDIOs(); // clear out the list, in order to prepare for the next time we need to use it
-    } else {
-	tc.syncdio.anychanged = 0;
-        tc.syncdio.sync_input_triggered = 0;
+    if (tpSyncdioPoolAlloc(tp, &tc) == -1) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "synched I/O pool full\n");
+        return -1;
     }
 
     tc.utvIn = circle.utvIn;
     tc.utvOut = circle.utvOut;
     
+    tcPlanProfile(&tc);
+    tc.endpoint = tcGetPosReal(&tc, 1);
+    tc.queue_time = tc.reqvel > 0.0 ? tc.target / tc.reqvel : 0.0;
     if (tcqPut(&tp->queue, tc) == -1) {
+        tpSyncdioPoolDrop(tp, &tc);
 	return -1;
     }
 
     tp->goalPos = end;
     tp->done = 0;
     tp->depth = tcqLen(&tp->queue);
+    tp->queueTime += tc.queue_time;
     tp->nextId++;
+    tpLookahead(tp);
 
     return 0;
 }
 
-// likewise, this adds a NURBS circular (circle, arc, helix) move from
-// the end of the last move to this new position.  end is the
-// xyzabc of the destination, center/normal/turn specify the arc
-// in a way that makes sense to pmCircleInit (we don't care about
-// the details here.)  Note that degenerate arcs/circles are not
-// allowed; we are guaranteed to have a move in xyz so target is
-// always the circle/arc/helical length.
-
-#ifdef RTAPI
-#warning "implement rtai_kmalloc() for nurbs"
-static CONTROL_POINT ctrl_pts_array[8192];
-static double knots_array[8192];
-static double N_array[8192];
-#endif
+// likewise, this adds a NURBS move from the end of the last move along
+// the curve in nurbs_block.  The control points and knots are copied into
+// a slice of the TP NURBS pool, which the segment owns until it retires.
 
 int tpAddNURBS(TP_STRUCT *tp, int type, nurbs_block_t nurbs_block, EmcPose pos,
         unsigned char enables, double vel, double ini_maxvel,
         double ini_maxacc, double ini_maxjerk) 
 {
-    static TC_STRUCT tc;
-    static uint32_t knots_todo = 0, order = 0,
-            nr_of_ctrl_pts = 0, nr_of_knots = 0;
-    nurbs_block_t *nurbs_to_tc = &tc.nurbs_block;//EmcPose* control_points;
+    TC_STRUCT tc;
+    uint32_t order, nr_of_ctrl_pts, nr_of_knots, nr_of_arclen;
+    double *space;
+    int pool_end, pool_used;
+    nurbs_block_t *nurbs_to_tc = &tc.coords.nurbs;//EmcPose* control_points;
     if (ini_maxjerk == 0) {
         rtapi_print_msg(RTAPI_MSG_ERR, "jerk is not provided or jerk is 0\n");
         assert(ini_maxjerk > 0);
@@ -675,141 +1145,178 @@ int tpAddNURBS(TP_STRUCT *tp, int type, nurbs_block_t nurbs_block, EmcPose pos,
         return -1;
     }
 
-    if (0 == knots_todo) {
-        //        fprintf(stderr,"TC_NURBS PARAM INIT\n");
-        knots_todo = nurbs_block.nr_of_knots;
-        order = nurbs_block.order;
+    // the whole curve comes in at once, nurbs_block points at the
+    // control points and knots in the NURBS arena
+    memset(&tc, 0, sizeof(tc));
+    order = nurbs_block.order;
+    nr_of_ctrl_pts = nurbs_block.nr_of_ctrl_pts;
+    nr_of_knots = nurbs_block.nr_of_knots;
+    nr_of_arclen = nurbs_block.nr_of_arclen;
+    if (nr_of_ctrl_pts < 2 || nr_of_knots < nr_of_ctrl_pts ||
+        nr_of_knots > EMCMOT_NURBS_ARENA_SIZE || order > nr_of_ctrl_pts ||
+        order < 2 || order > NURBS_MAX_ORDER ||
+        nr_of_arclen == 1 || NURBS_ARCLEN_STRIDE * nr_of_arclen > EMCMOT_NURBS_ARENA_SIZE ||
+        !(nurbs_block.curve_len > 0.0) ||
+        !nurbs_block.ctrl_pts_ptr || !nurbs_block.knots_ptr ||
+        (nr_of_arclen && !nurbs_block.arclen_ptr)) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "bad NURBS block: order(%d) ctrl_pts(%d) knots(%d) arclen(%d)\n",
+                        order, nr_of_ctrl_pts, nr_of_knots, nr_of_arclen);
+        return -1;
+    }
 
-        nr_of_ctrl_pts = nurbs_block.nr_of_ctrl_pts;
-        nr_of_knots = nurbs_block.nr_of_knots;
+    pool_end = tp->nurbs_pool.end;
+    pool_used = tp->nurbs_pool.used;
+    space = tpNurbsPoolAlloc(&tp->nurbs_pool,
+            tpNurbsSliceSize(nr_of_ctrl_pts, nr_of_knots, nr_of_arclen, order),
+            &tc);
+    if (0 == space) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "NURBS pool full (%d of %d used)\n",
+                        tp->nurbs_pool.used, tp->nurbs_pool.size);
+        return -1;
+    }
+    nurbs_to_tc->ctrl_pts_ptr = (CONTROL_POINT *) space;
+    space += nr_of_ctrl_pts * (sizeof(CONTROL_POINT) / sizeof(double));
+    nurbs_to_tc->knots_ptr = space;
+    space += nr_of_knots;
+    nurbs_to_tc->arclen_ptr = space;
+    space += NURBS_ARCLEN_STRIDE * nr_of_arclen;
+    nurbs_to_tc->N = space;
+    space += order + 1;
+    nurbs_to_tc->span_coef = space;
+    nurbs_to_tc->span = -1;
+    nurbs_to_tc->axis_mask = nurbs_block.axis_mask;
+    memcpy(nurbs_to_tc->ctrl_pts_ptr, nurbs_block.ctrl_pts_ptr,
+           sizeof(CONTROL_POINT) * nr_of_ctrl_pts);
+    memcpy(nurbs_to_tc->knots_ptr, nurbs_block.knots_ptr,
+           sizeof(double) * nr_of_knots);
+    if (nr_of_arclen) {
+        memcpy(nurbs_to_tc->arclen_ptr, nurbs_block.arclen_ptr,
+               sizeof(double) * NURBS_ARCLEN_STRIDE * nr_of_arclen);
+    }
 
-#ifdef RTAPI
-#warning "implement rtai_kmalloc() for nurbs"
-	nurbs_to_tc->ctrl_pts_ptr = ctrl_pts_array;
-	nurbs_to_tc->knots_ptr = knots_array;
-	nurbs_to_tc->N = N_array;
-#else
-	// SIM
-        nurbs_to_tc->ctrl_pts_ptr = (CONTROL_POINT*) malloc(
-                sizeof(CONTROL_POINT) * nurbs_block.nr_of_ctrl_pts);
-        nurbs_to_tc->knots_ptr = (double*) malloc(sizeof(double)
-                * nurbs_block.nr_of_knots);
-        nurbs_to_tc->N = (double*) malloc(sizeof(double) * (order + 1));
+#if 0 //dump control points and knots info
+    uint32_t i=0;
+    //fprintf(stderr,"tp.c tpAddNURBS() \n");
+    for(i=0;i<nr_of_ctrl_pts;i++) {
+        fprintf(stderr,"index [%d] = knots=%f cp(%f,%f,%f %f) weight = %f \n",i,
+                nurbs_to_tc->knots_ptr[i],
+                nurbs_to_tc->ctrl_pts_ptr[i].X,
+                nurbs_to_tc->ctrl_pts_ptr[i].Y,
+                nurbs_to_tc->ctrl_pts_ptr[i].Z,
+                nurbs_to_tc->ctrl_pts_ptr[i].A,
+                nurbs_to_tc->ctrl_pts_ptr[i].R);
+    }
+    for(;i<nr_of_knots;i++) {
+        fprintf(stderr,"index [%d] = knots=%f \n",i,nurbs_to_tc->knots_ptr[i]);
+    }
 #endif
-        nurbs_to_tc->axis_mask = nurbs_block.axis_mask;
+    // process tc , tp
 
+    tc.sync_accel = 0;
+    tc.cycle_time = tp->cycleTime;
 
+    tc.target = nurbs_block.curve_len;
 
-    }
-    if (knots_todo > 0) {
-        if (knots_todo > (nr_of_knots - nr_of_ctrl_pts)) { // this part add ctrl pts and knots
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].X = pos.tran.x;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].Y = pos.tran.y;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].Z = pos.tran.z;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].A = pos.a;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].B = pos.b;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].C = pos.c;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].U = pos.u;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].V = pos.v;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].W = pos.w;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].R = nurbs_block.weight;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].D = nurbs_block.curvature;
-            nurbs_to_tc->ctrl_pts_ptr[nr_of_knots - knots_todo].F = vel; // requested feedrate for this cp
-            nurbs_to_tc->knots_ptr[nr_of_knots - knots_todo] = nurbs_block.knot;
+    tc.progress = 0.0;
+    tc.accel_state = ACCEL_S3;
+    tc.distance_to_go = tc.target;
+    // tc.accel_time = 0.0;
+    tc.reqvel = nurbs_to_tc->ctrl_pts_ptr[0].F;// the first feedrate for first cp for reqvel//vel;
+    tc.maxvel = ini_maxvel * tp->cycleTime;
+    tc.maxaccel = ini_maxacc * tp->cycleTime * tp->cycleTime;
+    tc.jerk = ini_maxjerk * tp->cycleTime * tp->cycleTime * tp->cycleTime;
 
-        } else {
-            nurbs_to_tc->knots_ptr[nr_of_knots - knots_todo] = nurbs_block.knot;
+    tc.feed_override = 0.0;
+    tc.id = tp->nextId;
+    tc.active = 0;
+    tc.atspeed = 0;//atspeed;  // FIXME-eric(L)
 
-        }
-        knots_todo -= 1;
-    }
+    tc.coords.nurbs.curve_len = nurbs_block.curve_len;
+    tc.coords.nurbs.order = nurbs_block.order;
+    tc.coords.nurbs.nr_of_ctrl_pts = nurbs_block.nr_of_ctrl_pts;
+    tc.coords.nurbs.nr_of_knots = nurbs_block.nr_of_knots;
+    tc.coords.nurbs.nr_of_arclen = nurbs_block.nr_of_arclen;
 
+    tc.cur_accel = 0.0;
+    tc.cur_vel = 0.0;
 
-    if ((0 == knots_todo)) {
-        // knots == 0 means all NURBS collected
-#if 0 //dump control points and knots info
-        uint32_t i=0;
-        //fprintf(stderr,"tp.c tpAddNURBS() \n");
-        for(i=0;i<nr_of_ctrl_pts;i++) {
-            fprintf(stderr,"index [%d] = knots=%f cp(%f,%f,%f %f) weight = %f \n",i,
-                    nurbs_to_tc->knots_ptr[i],
-                    nurbs_to_tc->ctrl_pts_ptr[i].X,
-                    nurbs_to_tc->ctrl_pts_ptr[i].Y,
-                    nurbs_to_tc->ctrl_pts_ptr[i].Z,
-                    nurbs_to_tc->ctrl_pts_ptr[i].A,
-                    nurbs_to_tc->ctrl_pts_ptr[i].R);
-        }
-        for(;i<nr_of_knots;i++) {
-            fprintf(stderr,"index [%d] = knots=%f \n",i,nurbs_to_tc->knots_ptr[i]);
-        }
-#endif
-        // process tc , tp
-
-        tc.sync_accel = 0;
-        tc.cycle_time = tp->cycleTime;
-
-        tc.target = nurbs_block.curve_len;
-
-        tc.progress = 0.0;
-        tc.accel_state = ACCEL_S3;
-        tc.distance_to_go = tc.target;
-        // tc.accel_time = 0.0;
-        tc.reqvel = nurbs_to_tc->ctrl_pts_ptr[0].F;// the first feedrate for first cp for reqvel//vel;
-        tc.maxvel = ini_maxvel * tp->cycleTime;
-        tc.maxaccel = ini_maxacc * tp->cycleTime * tp->cycleTime;
-        tc.jerk = ini_maxjerk * tp->cycleTime * tp->cycleTime * tp->cycleTime;
-
-        tc.feed_override = 0.0;
-        tc.id = tp->nextId;
-        tc.active = 0;
-        tc.atspeed = 0;//atspeed;  // FIXME-eric(L)
-
-        tc.nurbs_block.curve_len = nurbs_block.curve_len;
-        tc.nurbs_block.order = nurbs_block.order;
-        tc.nurbs_block.nr_of_ctrl_pts = nurbs_block.nr_of_ctrl_pts;
-        tc.nurbs_block.nr_of_knots = nurbs_block.nr_of_knots;
-
-        tc.cur_accel = 0.0;
-        tc.cur_vel = 0.0;
-
-        tc.motion_type = TC_NURBS;
-        tc.canon_motion_type = type;
-        tc.blend_with_next = tp->termCond == TC_TERM_COND_BLEND;
-        tc.tolerance = tp->tolerance;
-        tc.seamless_blend_mode = SMLBLND_INIT;
-        tc.nexttc_target = 0;
-
-        tc.synchronized = tp->synchronized;
-        tc.velocity_mode = tp->velocity_mode;
-        tc.uu_per_rev = tp->uu_per_rev;
-        tc.css_progress_cmd = 0;
-        tc.enables = enables;
-        tc.indexrotary = -1;
-        if ((syncdio.anychanged != 0) || (syncdio.sync_input_triggered != 0)) {
-            tc.syncdio = syncdio; //enqueue the list of DIOs that need toggling
-            tpClearDIOs(); // clear out the list, in order to prepare for the next time we need to use it
-        } else {
-            tc.syncdio.anychanged = 0;
-            tc.syncdio.sync_input_triggered = 0;
-        }
-    
-        //TODO: tc.utvIn = nurbs...;
-        //TODO: tc.utvOut = nurbs...;
-        
-        if (tcqPut(&tp->queue, tc) == -1) {
-            rtapi_print_msg(RTAPI_MSG_ERR, "tcqPut failed.\n");
-            return -1;
-        }
+    tc.motion_type = TC_NURBS;
+    tc.canon_motion_type = type;
+    tc.blend_with_next = tp->termCond == TC_TERM_COND_BLEND;
+    tc.tolerance = tp->tolerance;
+    tc.seamless_blend_mode = SMLBLND_INIT;
+    tc.blend_vel = 0;
+    tc.stop_vel = 0;
+    tc.final_vel = 0;
 
-        tp->goalPos = pos; // remember the end of this move, ie. last control point
-        // the start of the next one.
-        tp->done = 0;
-        tp->depth = tcqLen(&tp->queue);
-        tp->nextId++;
+    tc.synchronized = tp->synchronized;
+    tc.velocity_mode = tp->velocity_mode;
+    tc.uu_per_rev = tp->uu_per_rev;
+    tc.css_progress_cmd = 0;
+    tc.enables = enables;
+    tc.indexrotary = -1;
+    tc.arc_trim = 0;
+    if (tpSyncdioPoolAlloc(tp, &tc) == -1) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "synched I/O pool full\n");
+        tp->nurbs_pool.end = pool_end;
+        tp->nurbs_pool.used = pool_used;
+        return -1;
+    }
+
+    //TODO: tc.utvIn = nurbs...;
+    //TODO: tc.utvOut = nurbs...;
+    
+    tcPlanProfile(&tc);
+    // evaluating the end sets the span cache and reqvel for u = 1,
+    // put them back for the start of the curve
+    tc.endpoint = tcGetPosReal(&tc, 1);
+    tc.reqvel = nurbs_to_tc->ctrl_pts_ptr[0].F;
+    if (nr_of_arclen &&
+        tc.reqvel > nurbs_arclen_vmax(nurbs_to_tc->arclen_ptr, nr_of_arclen,
+                                      tc.target, 0.0)) {
+        tc.reqvel = nurbs_arclen_vmax(nurbs_to_tc->arclen_ptr, nr_of_arclen,
+                                      tc.target, 0.0);
+    }
+    tc.coords.nurbs.span = -1;
+    tc.queue_time = tc.reqvel > 0.0 ? tc.target / tc.reqvel : 0.0;
+    if (tcqPut(&tp->queue, tc) == -1) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "tcqPut failed.\n");
+        tpSyncdioPoolDrop(tp, &tc);
+        // hand the slice back, nobody owns it
+        tp->nurbs_pool.end = pool_end;
+        tp->nurbs_pool.used = pool_used;
+        return -1;
     }
+
+    tp->goalPos = pos; // remember the end of this move, ie. last control point
+    // the start of the next one.
+    tp->done = 0;
+    tp->depth = tcqLen(&tp->queue);
+    tp->queueTime += tc.queue_time;
+    tp->nextId++;
+    tpLookahead(tp);
+
     return 0;
 }
 
+/* distance to stop from vel at zero accel, S4 -> (S5) -> S6, counted
+   the way the accelerating states below predict it */
+static inline double tcDecelDist(TC_STRUCT * tc, double vel)
+{
+    double t, v1, t1;
+
+    t = ceil(sqrt(vel / tc->jerk));
+    t1 = tc->decel_t1;                  // max time for S4
+    if (t > t1) {
+        // t: time for S5
+        t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
+        v1 = vel - 0.5 * tc->jerk * t1 * t1;
+        // dist of (S4 + S6), then PT = P0 + V0T + 1/2A0T^2 for S5
+        return t1 * vel + v1 * t - 0.5 * tc->maxaccel * t * t;
+    }
+    return t * vel;                     // dist of (S4 + S6)
+}
+
 /*
  Continuous form
  PT = P0 + V0T + 1/2A0T2 + 1/6JT3
@@ -833,11 +1340,46 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
     double tc_target;
     
     if(tc->seamless_blend_mode == SMLBLND_ENABLE) {
-        tc_target = tc->target + tc->nexttc_target;
+        // plan to stop far enough past the end to leave at final_vel
+        tc_target = tc->target + tc->final_dist;
     } else {
         tc_target = tc->target;
     }
 
+    // follow a closed-form profile, planned whenever the requested or
+    // the end velocity changes while accel is zero; in between, and
+    // for spindle synchronized motion, step the states below
+    if (!tc->synchronized && tc->motion_type != TC_RIGIDTAP) {
+        double end_vel;
+
+        req_vel = tc->reqvel * tc->feed_override * tc->cycle_time;
+        if (req_vel > tc->maxvel) {
+            req_vel = tc->maxvel;
+        }
+        if (req_vel < 0) {
+            req_vel = 0;
+        }
+        end_vel = 0;
+        if (tc->seamless_blend_mode == SMLBLND_ENABLE) {
+            end_vel = tc->final_vel < req_vel ? tc->final_vel : req_vel;
+        }
+        if (req_vel != tc->profile.vc || end_vel != tc->profile.ve) {
+            tc->profile.valid = 0;
+            if (tc->accel_state == ACCEL_S3) {
+                tcProfilePlan(tc, req_vel, end_vel);
+            }
+        }
+        if (tc->profile.valid) {
+            tcProfileStep(tc);
+            // blending at largest velocity for G64 w/o P<tolerance>
+            if (tc->profile.phase > 3 && !tc->tolerance) {
+                tc->tolerance = tc->target - tc->progress;
+            }
+            tc->distance_to_go = tc->target - tc->progress;
+            return;
+        }
+    }
+
     immediate_state = 0;
     do {
         switch (tc->accel_state) {
@@ -884,26 +1426,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
             // distance for S3
             dist += (vel);
             
-            /* 
-            0.5 * vel = vel + 0 * t1 - 0.5 * j * t1 * t1;
-            t1 = sqrt(vel/j)
-            */
-            t = ceil(sqrt(vel/tc->jerk));
-            // AT = AT + JT
-            t1 = ceil(tc->maxaccel / tc->jerk);   // max time for S4
-            if (t > t1) {
-                // S4 -> S5 -> S6
-                dist += t1 * vel;    // dist of (S4 + S6)
-                // calc decel.dist for ACCEL_S5
-                // t: time for S5
-                t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
-                v1 = vel - 0.5 * tc->jerk * t1 * t1;
-                // PT = P0 + V0T + 1/2A0T^2 + 1/6JT^3
-                dist += (v1 * t - 0.5 * tc->maxaccel * t * t);
-            } else {
-                // S4 -> S6
-                dist += t * vel;    // dist of (S4 + S6)
-            }
+            dist += tcDecelDist(tc, vel);
 
             if (tc_target < dist) {
                 tc->accel_state = ACCEL_S2;
@@ -945,26 +1468,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
             // distance for S3
             dist += (vel);
             
-            /* 
-            0.5 * vel = vel + 0 * t1 - 0.5 * j * t1 * t1;
-            t1 = sqrt(vel/j)
-            */
-            t = ceil(sqrt(vel/tc->jerk));
-            // AT = AT + JT
-            t1 = ceil(tc->maxaccel / tc->jerk);   // max time for S4
-            if (t > t1) {
-                // S4 -> S5 -> S6
-                dist += t1 * vel;    // dist of (S4 + S6)
-                // calc decel.dist for ACCEL_S5
-                // t: time for S5
-                t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
-                v1 = vel - 0.5 * tc->jerk * t1 * t1;
-                // PT = P0 + V0T + 1/2A0T^2 + 1/6JT^3
-                dist += (v1 * t - 0.5 * tc->maxaccel * t * t);
-            } else {
-                // S4 -> S6
-                dist += t * vel;    // dist of (S4 + S6)
-            }
+            dist += tcDecelDist(tc, vel);
 
             if (tc_target < dist) {
                 tc->accel_state = ACCEL_S2;
@@ -1011,26 +1515,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
             // distance for S3
             dist = tc->progress + (vel);
             
-            /* 
-            0.5 * vel = vel + 0 * t1 - 0.5 * j * t1 * t1;
-            t1 = sqrt(vel/j)
-            */
-            t = ceil(sqrt(vel/tc->jerk));
-            // AT = AT + JT
-            t1 = ceil(tc->maxaccel / tc->jerk);   // max time for S4
-            if (t > t1) {
-                // S4 -> S5 -> S6
-                dist += t1 * vel;    // dist of (S4 + S6)
-                // calc decel.dist for ACCEL_S5
-                // t: time for S5
-                t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
-                v1 = vel - 0.5 * tc->jerk * t1 * t1;
-                // PT = P0 + V0T + 1/2A0T^2 + 1/6JT^3
-                dist += (v1 * t - 0.5 * tc->maxaccel * t * t);
-            } else {
-                // S4 -> S6
-                dist += t * vel;    // dist of (S4 + S6)
-            }
+            dist += tcDecelDist(tc, vel);
 
             if (tc_target < dist) {
                 tc->accel_state = ACCEL_S3;
@@ -1139,26 +1624,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
             vel = tc->cur_vel + tc->cur_accel * t + 0.5 * tc->jerk * t * t;
             
             if (vel > 0) {    
-                /* 
-                0.5 * vel = vel + 0 * t1 - 0.5 * j * t1 * t1;
-                t1 = sqrt(vel/j)
-                */
-                t = ceil(sqrt(vel/tc->jerk));
-                // AT = AT + JT
-                t1 = ceil(tc->maxaccel / tc->jerk);   // max time for S4
-                if (t > t1) {
-                    // S4 -> S5 -> S6
-                    dist += t1 * vel;    // dist of (S4 + S6)
-                    // calc decel.dist for ACCEL_S5
-                    // t: time for S5
-                    t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
-                    v1 = vel - 0.5 * tc->jerk * t1 * t1;
-                    // PT = P0 + V0T + 1/2A0T^2 + 1/6JT^3
-                    dist += (v1 * t - 0.5 * tc->maxaccel * t * t);
-                } else {
-                    // S4 -> S6
-                    dist += t * vel;    // dist of (S4 + S6)
-                }
+                dist += tcDecelDist(tc, vel);
             }
 
             // check if dist would be greater than tc_target at next cycle
@@ -1208,26 +1674,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
             
             if (vel > 0) { 
                 /* S6 -> S3 -> S4 -> S5(maybe) -> S6 */
-                /* 
-                0.5 * vel = vel + 0 * t1 - 0.5 * j * t1 * t1;
-                t1 = sqrt(vel/j)
-                */
-                t = ceil(sqrt(vel/tc->jerk));
-                // AT = AT + JT
-                t1 = ceil(tc->maxaccel / tc->jerk);   // max time for S4
-                if (t > t1) {
-                    // S4 -> S5 -> S6
-                    dist += t1 * vel;    // dist of (S4 + S6)
-                    // calc decel.dist for ACCEL_S5
-                    // t: time for S5
-                    t = (vel - tc->jerk * t1 * t1) / tc->maxaccel;
-                    v1 = vel - 0.5 * tc->jerk * t1 * t1;
-                    // PT = P0 + V0T + 1/2A0T^2 + 1/6JT^3
-                    dist += (v1 * t - 0.5 * tc->maxaccel * t * t);
-                } else {
-                    // S4 -> S6
-                    dist += t * vel;    // dist of (S4 + S6)
-                }
+                dist += tcDecelDist(tc, vel);
             }
             
             // check if dist would be greater than tc_target at next cycle
@@ -1299,25 +1746,35 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc)
     //      assert (tc->cur_vel >= 0);
 }
 
-void tpToggleDIOs(TC_STRUCT * tc) 
+/* 'when' is how far, in seconds, into this period's move the path
+   reaches the start of tc, where its outputs belong; it goes out on
+   the -time pins for drivers that can time an output within the servo
+   period */
+void tpToggleDIOs(TP_STRUCT * tp, TC_STRUCT * tc, double when) 
 {
+    syncdio_t *dio;
     int i = 0;
-    if (tc->syncdio.anychanged != 0) { // we have DIO's to turn on or off
+
+    if (tc->syncdio_slot < 0) {
+        return;
+    }
+    dio = &tp->syncdio_pool.dio[tc->syncdio_slot];
+    if (dio->anychanged != 0) { // we have DIO's to turn on or off
 	for (i=0; i < emcmotConfig->numDIO; i++) {
-            if (!(tc->syncdio.dio_mask & (1 << i))) continue;
-	    if (tc->syncdio.dios[i] > 0) emcmotDioWrite(i, 1); // turn DIO[i] on
-	    if (tc->syncdio.dios[i] < 0) emcmotDioWrite(i, 0); // turn DIO[i] off
+            if (!(dio->dio_mask & (1 << i))) continue;
+	    if (dio->dios[i] > 0) emcmotDioWrite(i, 1, when); // turn DIO[i] on
+	    if (dio->dios[i] < 0) emcmotDioWrite(i, 0, when); // turn DIO[i] off
 	}
 	for (i=0; i < emcmotConfig->numAIO; i++) {
-            if (!(tc->syncdio.aio_mask & (1 << i))) continue;
-	    emcmotAioWrite(i, tc->syncdio.aios[i]); // set AIO[i]
+            if (!(dio->aio_mask & (1 << i))) continue;
+	    emcmotAioWrite(i, dio->aios[i], when); // set AIO[i]
         }
-	tc->syncdio.anychanged = 0; //we have turned them all on/off, nothing else to do for this TC the next time
+	dio->anychanged = 0; //we have turned them all on/off, nothing else to do for this TC the next time
     }
 
-    if (tc->syncdio.sync_input_triggered != 0) {
-        emcmotSyncInputWrite(tc->syncdio.sync_in, tc->syncdio.timeout, tc->syncdio.wait_type);
-        tc->syncdio.sync_input_triggered = 0; //we have turned them all on/off, nothing else to do for this TC the next time
+    if (dio->sync_input_triggered != 0) {
+        emcmotSyncInputWrite(dio->sync_in, dio->timeout, dio->wait_type);
+        dio->sync_input_triggered = 0; //we have turned them all on/off, nothing else to do for this TC the next time
     }
 }
 
@@ -1353,6 +1810,8 @@ int tpRunCycle(TP_STRUCT * tp, long period)
     static int waiting_for_atspeed = MOTION_INVALID_ID;
     static double revs;
     EmcPose target;
+    double progress_before;
+    double dio_when = 0.0;      // see tpToggleDIOs()
 
     emcmotStatus->tcqlen = tcqLen(&tp->queue);
     emcmotStatus->requested_vel = 0.0;
@@ -1362,9 +1821,12 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         // the end of the program OR QUEUE STARVATION.  In either case,
         // I want to stop.  Some may not agree that's what it should do.
         tcqInit(&tp->queue);
+        tpNurbsPoolReset(&tp->nurbs_pool);
+        tpSyncdioPoolReset(&tp->syncdio_pool);
         tp->goalPos = tp->currentPos;
         tp->done = 1;
         tp->depth = tp->activeDepth = 0;
+        tp->queueTime = 0.0;
         tp->aborting = 0;
         tp->execId = 0;
         tp->motionType = 0;
@@ -1394,8 +1856,13 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         }
 
         // done with this move
+        tpNurbsPoolRetire(&tp->nurbs_pool, tc);
+        tpSyncdioPoolRetire(&tp->syncdio_pool, tc);
+        tp->queueTime -= tc->queue_time;
         tcqRemove(&tp->queue, 1);
         tp->depth = tcqLen(&tp->queue);
+        if (0 == tp->depth)
+            tp->queueTime = 0.0;    // don't let rounding accumulate
 
         // so get next move
         tc = tcqItem(&tp->queue, 0, period);
@@ -1435,9 +1902,12 @@ int tpRunCycle(TP_STRUCT * tp, long period)
             (tc->cur_vel == 0.0 && !nexttc) || 
             (tc->cur_vel == 0.0 && nexttc && nexttc->cur_vel == 0.0) ) {
             tcqInit(&tp->queue);
+            tpNurbsPoolReset(&tp->nurbs_pool);
+            tpSyncdioPoolReset(&tp->syncdio_pool);
             tp->goalPos = tp->currentPos;
             tp->done = 1;
             tp->depth = tp->activeDepth = 0;
+            tp->queueTime = 0.0;
             tp->aborting = 0;
             tp->execId = 0;
             tp->motionType = 0;
@@ -1542,7 +2012,7 @@ int tpRunCycle(TP_STRUCT * tp, long period)
 
     if (tc->motion_type == TC_RIGIDTAP) {
         static double old_spindlepos;
-        double new_spindlepos = emcmotStatus->spindleRevs;
+        double new_spindlepos = emcmotStatus->spindleRevsLead;
         if (emcmotStatus->spindle.direction < 0) new_spindlepos = -new_spindlepos;
 
         switch (tc->coords.rigidtap.state) {
@@ -1620,7 +2090,7 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         // for CSS and TC_RIGIDTAP
         double css_progress_cmd;
         double pos_error;
-        double new_spindlepos = emcmotStatus->spindleRevs;
+        double new_spindlepos = emcmotStatus->spindleRevsLead;
 
         tc->feed_override = 1.0;
 
@@ -1676,63 +2146,18 @@ int tpRunCycle(TP_STRUCT * tp, long period)
 	}
     }
 
-    // calculate the approximate peak velocity the nexttc will hit.
-    // we know to start blending it in when the current tc goes below
-    // this velocity...
-    if(nexttc && nexttc->maxaccel) {
-
 #ifdef SMLBLND
-        /**
-         * TODO: 
-         * G64 Q[01] seamless blending:
-         * where Q1 means "enable seamless blending";
-         *       Q0 means "disable seamless blending"
-         **/
-        if (tc->seamless_blend_mode == SMLBLND_INIT) {
-            double dot;
-            double k;   /* curvature */
-            double ca;  /* centripetal acceleration */
-            double rv;  /* request velocity per cycleTime */
-            rv = tc->reqvel * tp->cycleTime;
-            if (rv > tc->maxvel) {
-                rv = tc->maxvel;
-            }
-            // pmCartCartDisp(tc->utvOut, nexttc->utvIn, &k);
-            pmCartCartDot(tc->utvOut, nexttc->utvIn, &dot);
-            k = acos(dot)/rv;
-            ca = k * rv * rv;
-            if (ca < tc->maxaccel) {
-                // allow seamless blending, SMLBLND
-                // also, (nexttc->atspeed == 0)
-                tc->seamless_blend_mode = SMLBLND_ENABLE;
-                tc->nexttc_target = nexttc->target;
-            } else {
-                tc->seamless_blend_mode = SMLBLND_DISABLE;
-            }
-            DPS("tc->utvOut: x(%f) y(%f) z(%f)\n",
-                tc->utvOut.x,
-                tc->utvOut.y,
-                tc->utvOut.z);
-            DPS("nexttc->utvIn: x(%f) y(%f) z(%f)\n",
-                nexttc->utvIn.x,
-                nexttc->utvIn.y,
-                nexttc->utvIn.z);
-            DPS("k(%f) rv(%f) ca(%f) tc.maxaccel(%f) tc.jerk(%f)\n",
-                 k,
-                 rv * 1000000,
-                 ca * 1000000,
-                 tc->maxaccel * 1000000,
-                 tc->jerk * 1000000);
-            if (tc->seamless_blend_mode == SMLBLND_ENABLE) {
-                DPS("SMLBLND_ENABLE\n");
-            } else {
-                DPS("SMLBLND_DISABLE\n");
-            }
-        }
-#endif // SMLBLND
+    // tpLookahead() only lets tc end at speed with a segment queued
+    // behind it; when that segment is held back (e.g. stepping), stop
+    if (!nexttc && tc->seamless_blend_mode == SMLBLND_ENABLE) {
+        tc->seamless_blend_mode = SMLBLND_DISABLE;
+        tc->final_vel = 0;
+        tc->final_dist = 0;
     }
+#endif // SMLBLND
         
     primary_before = tcGetPos(tc);
+    progress_before = tc->progress;
     tcRunCycle(tp, tc);
 
 #ifdef SMLBLND
@@ -1748,6 +2173,12 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         next_accel = tc->cur_accel;
         next_accel_state = tc->accel_state;
         next_progress = tc->progress - tc->target;
+        // the path went through the end of tc part way into this
+        // period's move; the next tc's outputs belong there
+        if (next_progress > 0.0) {
+            dio_when = tp->cycleTime * (tc->target - progress_before)
+                / (tc->target - progress_before + next_progress);
+        }
 
         // if we're synced, and this move is ending, save the
         // spindle position so the next synced move can be in
@@ -1757,8 +2188,13 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         else
             spindleoffset = 0.0;
         
+        tpNurbsPoolRetire(&tp->nurbs_pool, tc);
+        tpSyncdioPoolRetire(&tp->syncdio_pool, tc);
+        tp->queueTime -= tc->queue_time;
         tcqRemove(&tp->queue, 1);
         tp->depth = tcqLen(&tp->queue);
+        if (0 == tp->depth)
+            tp->queueTime = 0.0;    // don't let rounding accumulate
 
         // so get next move
         tc = tcqItem(&tp->queue, 0, period);
@@ -1812,7 +2248,7 @@ int tpRunCycle(TP_STRUCT * tp, long period)
 	    tp->execId = tc->id;
             emcmotStatus->requested_vel = tc->reqvel;
         } else {
-	    tpToggleDIOs(nexttc); //check and do DIO changes
+	    tpToggleDIOs(tp, nexttc, 0.0); //check and do DIO changes
             target = tcGetEndpoint(nexttc);
             tp->motionType = nexttc->canon_motion_type;
 	    emcmotStatus->distance_to_go = nexttc->target - nexttc->progress;
@@ -1851,7 +2287,7 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         tp->currentPos.w += primary_displacement.w + secondary_displacement.w;
     } else {
         // not blending
-	tpToggleDIOs(tc); //check and do DIO changes
+	tpToggleDIOs(tp, tc, dio_when); //check and do DIO changes
         target = tcGetEndpoint(tc);
         tp->motionType = tc->canon_motion_type;
 	emcmotStatus->distance_to_go = tc->target - tc->progress;
@@ -1954,6 +2390,17 @@ int tpQueueDepth(TP_STRUCT * tp)
     return tp->depth;
 }
 
+/* seconds the queued motions take at their requested velocities,
+   ignoring feed override and counting the active one in full */
+double tpQueueTime(TP_STRUCT * tp)
+{
+    if (0 == tp) {
+	return 0.0;
+    }
+
+    return tp->queueTime;
+}
+
 int tpActiveDepth(TP_STRUCT * tp)
 {
     if (0 == tp) {
@@ -26,8 +26,40 @@
 #define TP_VEL_EPSILON 1e-6
 #define TP_ACCEL_EPSILON 1e-6
 
+/* how many queued segments back tpLookahead() replans when a segment
+   is added */
+#define TP_LOOKAHEAD_DEPTH 200
+
+/* corners between lines closer to straight than this cosine get no
+   blend arc, they blend seamlessly as they are */
+#define TP_ARC_BLEND_MAX_DOT 0.99999
+
+/* NURBS storage pool.  Segments retire in queue order, so the pool is a
+   ring: every queued TC_NURBS gets a contiguous slice at the end, and the
+   start moves up as segments are removed from the queue. */
+typedef struct {
+    double *space;		/* pool memory, NULL if none */
+    int size;			/* pool size, in doubles */
+    int start;			/* start of the oldest slice in use */
+    int end;			/* next free double */
+    int used;			/* doubles in use, including skipped tails */
+} TP_NURBS_POOL;
+
+/* synched I/O pool.  Few segments come with synched DIO/AIO changes,
+   so instead of each TC carrying a syncdio_t they take a record from
+   this ring as they are queued, and give it back in queue order. */
+#define TP_SYNCDIO_POOL_SIZE 64
+
+typedef struct {
+    syncdio_t dio[TP_SYNCDIO_POOL_SIZE];
+    int start;			/* oldest record in use */
+    int used;			/* records in use */
+} TP_SYNCDIO_POOL;
+
 typedef struct {
     TC_QUEUE_STRUCT queue;
+    TP_NURBS_POOL nurbs_pool;
+    TP_SYNCDIO_POOL syncdio_pool;
     int queueSize;
     double cycleTime;
     double vMax;		/* vel for subsequent moves */
@@ -47,12 +79,18 @@ typedef struct {
     int done;
     int depth;			/* number of total queued motions */
     int activeDepth;		/* number of motions blending */
+    double queueTime;		/* seconds of queued motion, see tpQueueTime() */
     int aborting;
     int pausing;
     int motionType;
     double tolerance;           /* for subsequent motions, stay within this
                                    distance of the programmed path during
                                    blends */
+    double rapidTolerance;      /* traverses blend within this distance
+                                   into a following traverse, see
+                                   tpSetRapidTolerance(); 0 is off */
+    int arcBlend;               /* round G64 corners between feed lines
+                                   with arcs, see tpSetArcBlend() */
     int synchronized;       // spindle sync required for this move
     int velocity_mode; 	        /* TRUE if spindle sync is in velocity mode,
 				   FALSE if in position mode */
@@ -63,6 +101,9 @@ extern int tpCreate(TP_STRUCT * tp, int _queueSize, TC_STRUCT * tcSpace);
 extern int tpClear(TP_STRUCT * tp);
 extern int tpInit(TP_STRUCT * tp);
 extern int tpClearDIOs(void);
+extern int tpSetNurbsPool(TP_STRUCT * tp, double *space, int size);
+extern int tpNurbsPoolFull(TP_STRUCT * tp);
+extern int tpSyncdioPoolFull(TP_STRUCT * tp);
 extern int tpSetPosCompEnWrite(TP_STRUCT *tp, int en_flag, int pos_comp_ref);
 extern int tpSetCycleTime(TP_STRUCT * tp, double secs);
 extern int tpSetVmax(TP_STRUCT * tp, double vmax, double ini_maxvel);
@@ -71,6 +112,8 @@ extern int tpSetVlimit(TP_STRUCT * tp, double limit);
 extern int tpSetId(TP_STRUCT * tp, int id);
 extern int tpGetExecId(TP_STRUCT * tp);
 extern int tpSetTermCond(TP_STRUCT * tp, int cond, double tolerance);
+extern int tpSetRapidTolerance(TP_STRUCT * tp, double tolerance);
+extern int tpSetArcBlend(TP_STRUCT * tp, int on);
 extern int tpSetPos(TP_STRUCT * tp, EmcPose pos);
 extern int tpAddRigidTap(TP_STRUCT * tp, EmcPose end, double vel, 
                          double ini_maxvel, double acc, double jerk, 
@@ -89,10 +132,11 @@ extern int tpAbort(TP_STRUCT * tp);
 extern EmcPose tpGetPos(TP_STRUCT * tp);
 extern int tpIsDone(TP_STRUCT * tp);
 extern int tpQueueDepth(TP_STRUCT * tp);
+extern double tpQueueTime(TP_STRUCT * tp);
 extern int tpActiveDepth(TP_STRUCT * tp);
 extern int tpGetMotionType(TP_STRUCT * tp);
 extern int tpSetSpindleSync(TP_STRUCT * tp, double sync, int wait);
-extern void tpToggleDIOs(TC_STRUCT * tc); //gets called when a new tc is taken from the queue. it checks and toggles all needed DIO's
+extern void tpToggleDIOs(TP_STRUCT * tp, TC_STRUCT * tc, double when); //gets called when a new tc is taken from the queue. it checks and toggles all needed DIO's
 
 extern int tpSetAout(TP_STRUCT * tp, unsigned char index, double start, double end);
 extern int tpSetDout(TP_STRUCT * tp, int index, unsigned char start, unsigned char end); //gets called to place DIO toggles on the TC queue
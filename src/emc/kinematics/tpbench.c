@@ -0,0 +1,527 @@
+/********************************************************************
+* Description: tpbench.c
+*   Runs the trajectory planner offline, on a canon stream, and
+*   reports how fast it plans and what feed it achieves
+*
+*   syntax: tpbench [-p period] [-v maxvel] [-a maxacc] [-j maxjerk]
+*                   [-t tolerance] [-r rapid tolerance] [-b]
+*                   [-q queue size] [file]
+*
+*   Reads the canonical commands rs274 prints (STRAIGHT_TRAVERSE,
+*   STRAIGHT_FEED, ARC_FEED, SET_FEED_RATE, SET_MOTION_CONTROL_MODE,
+*   SELECT_PLANE) from file, or stdin, queues them with tpAddLine() and
+*   tpAddCircle() the way motion does and runs tpRunCycle() back to back
+*   until the program is done.  tp.c and tc.c are linked in as they are;
+*   the bits of motion they use are faked here.
+*
+*   rs274 -g prog.ngc | tpbench -v 25 -a 250 -j 5000
+*
+*   A binary canon trace (rs274 -C, see canon_trace.h) is taken as well,
+*   and read in whole before the planner starts, so none of the run is
+*   spent parsing:
+*
+*   rs274 -g -C prog.trace prog.ngc /dev/null; tpbench prog.trace
+*
+*   -r and -b are [TRAJ] RAPID_BLEND_TOLERANCE and ARC_BLEND.
+*
+*   prints one "name value" line for each of: the number of segments,
+*   of them that ended in a blend or went seamlessly into the next one,
+*   and of ticks, the planner's time per segment, the time each
+*   tpRunCycle() took (percentiles and max), the program time at the
+*   given period, and the average feed of the whole program and of its
+*   feed moves, in units per minute.  Everything but the times comes
+*   out the same on every run, so tests can hold it to a bound.
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "rtapi.h"
+#include "posemath.h"
+#include "tc.h"
+#include "tp.h"
+#include "motion.h"
+#include "hal.h"
+#include "mot_priv.h"
+#include "motion_types.h"
+#include "canon_trace.h"
+
+/* what tp.c and tc.c use of motion */
+static emcmot_status_t status;
+static emcmot_config_t config;
+static emcmot_debug_t debug;
+emcmot_status_t *emcmotStatus = &status;
+emcmot_config_t *emcmotConfig = &config;
+emcmot_debug_t *emcmotDebug = &debug;
+
+void emcmotDioWrite(int index, char value, double when)
+{
+}
+
+void emcmotAioWrite(int index, double value, double when)
+{
+}
+
+void emcmotSyncInputWrite(int index, double timeout, int wait_type)
+{
+}
+
+void emcmotSetRotaryUnlock(int axis, int unlock)
+{
+}
+
+int emcmotGetRotaryIsUnlocked(int axis)
+{
+    return 1;
+}
+
+static TP_STRUCT tp;
+static long period = 1000000;	/* nsecs */
+static double max_vel = 1.0, max_acc = 10.0, max_jerk = 100.0;
+static double feed_rate;	/* units per second */
+static int plane = 1;		/* 1 XY, 2 YZ, 3 XZ */
+static EmcPose pos;		/* end of the last move queued */
+static int next_id = 1;
+
+/* results */
+static unsigned int *tick_ns;
+static int ticks, max_ticks;
+static int segments, blends, seamless;
+static int head_id, head_end;	/* 1 blending, 2 seamless */
+static double plan_secs;
+static double path_len, feed_len;
+static int feed_ticks;
+static EmcPose last_pos;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_cycle(void)
+{
+    TC_STRUCT *tc;
+    EmcPose p;
+    double t0, t1, d;
+    int type;
+
+    t0 = now();
+    tpRunCycle(&tp, period);
+    t1 = now();
+    if (ticks == max_ticks) {
+	max_ticks = max_ticks ? 2 * max_ticks : 65536;
+	tick_ns = realloc(tick_ns, max_ticks * sizeof(*tick_ns));
+	if (tick_ns == 0) {
+	    fprintf(stderr, "tpbench: out of memory\n");
+	    exit(1);
+	}
+    }
+    tick_ns[ticks++] = (t1 - t0) * 1e9;
+
+    p = tpGetPos(&tp);
+    d = sqrt((p.tran.x - last_pos.tran.x) * (p.tran.x - last_pos.tran.x)
+	+ (p.tran.y - last_pos.tran.y) * (p.tran.y - last_pos.tran.y)
+	+ (p.tran.z - last_pos.tran.z) * (p.tran.z - last_pos.tran.z));
+    last_pos = p;
+    path_len += d;
+    type = tpGetMotionType(&tp);
+    if (type == EMC_MOTION_TYPE_FEED || type == EMC_MOTION_TYPE_ARC) {
+	feed_len += d;
+	feed_ticks++;
+    }
+    /* count how each segment went into the next one, once it is done */
+    tc = tcqItem(&tp.queue, 0, period);
+    if (tc == 0 || tc->id != head_id) {
+	if (head_end == 1) {
+	    blends++;
+	} else if (head_end == 2) {
+	    seamless++;
+	}
+	head_id = tc ? tc->id : 0;
+	head_end = 0;
+    }
+    if (tc != 0) {
+	if (tc->blending) {
+	    head_end = 1;
+	} else if (head_end != 1) {
+	    head_end = tc->seamless_blend_mode == SMLBLND_ENABLE ? 2 : 0;
+	}
+    }
+}
+
+/* the arguments of a canon call, up to n numbers; returns how many */
+static int get_args(const char *s, double *arg, int n)
+{
+    char *end;
+    int i = 0;
+
+    while (i < n) {
+	arg[i] = strtod(s, &end);
+	if (end == s) {
+	    break;
+	}
+	i++;
+	s = end;
+	while (*s == ' ' || *s == ',') {
+	    s++;
+	}
+    }
+    return i;
+}
+
+static void add_line(const double *arg, int type, double vel)
+{
+    EmcPose end = pos;
+    double t0;
+
+    end.tran.x = arg[0];
+    end.tran.y = arg[1];
+    end.tran.z = arg[2];
+    end.a = arg[3];
+    end.b = arg[4];
+    end.c = arg[5];
+    while (tcqFull(&tp.queue)) {
+	run_cycle();
+    }
+    tpSetId(&tp, next_id++);
+    t0 = now();
+    if (tpAddLine(&tp, end, type, vel, max_vel, max_acc, max_jerk,
+		  0, 0, -1) == 0) {
+	segments++;
+    }
+    plan_secs += now() - t0;
+    pos = end;
+}
+
+static void add_arc(const double *arg)
+{
+    EmcPose end = pos;
+    PmCartesian center, normal;
+    double radius, vel, t0;
+    int rotation = arg[4];
+
+    center = pos.tran;
+    normal.x = normal.y = normal.z = 0;
+    switch (plane) {
+    default:
+	end.tran.x = arg[0];
+	end.tran.y = arg[1];
+	end.tran.z = arg[5];
+	center.x = arg[2];
+	center.y = arg[3];
+	center.z = end.tran.z;
+	normal.z = 1;
+	break;
+    case 2:
+	end.tran.y = arg[0];
+	end.tran.z = arg[1];
+	end.tran.x = arg[5];
+	center.y = arg[2];
+	center.z = arg[3];
+	center.x = end.tran.x;
+	normal.x = 1;
+	break;
+    case 3:
+	end.tran.z = arg[0];
+	end.tran.x = arg[1];
+	end.tran.y = arg[5];
+	center.z = arg[2];
+	center.x = arg[3];
+	center.y = end.tran.y;
+	normal.y = 1;
+	break;
+    }
+    end.a = arg[6];
+    end.b = arg[7];
+    end.c = arg[8];
+    /* as in emccanon.cc, keep the centripetal accel within bounds */
+    radius = sqrt((pos.tran.x - center.x) * (pos.tran.x - center.x)
+	+ (pos.tran.y - center.y) * (pos.tran.y - center.y)
+	+ (pos.tran.z - center.z) * (pos.tran.z - center.z));
+    vel = feed_rate;
+    if (vel > sqrt(max_acc * radius)) {
+	vel = sqrt(max_acc * radius);
+    }
+    while (tcqFull(&tp.queue)) {
+	run_cycle();
+    }
+    tpSetId(&tp, next_id++);
+    t0 = now();
+    if (tpAddCircle(&tp, end, center, normal,
+		    rotation > 0 ? rotation - 1 : rotation,
+		    EMC_MOTION_TYPE_ARC, vel, max_vel, max_acc, max_jerk,
+		    0, 0) == 0) {
+	segments++;
+    }
+    plan_secs += now() - t0;
+    pos = end;
+}
+
+static void set_mode(int mode, double tolerance)
+{
+    if (mode == 3) {		/* CANON_CONTINUOUS */
+	tpSetTermCond(&tp, TC_TERM_COND_BLEND, tolerance);
+    } else if (mode == 2) {	/* CANON_EXACT_PATH */
+	tpSetTermCond(&tp, TC_TERM_COND_BLEND, 0);
+    } else {
+	tpSetTermCond(&tp, TC_TERM_COND_STOP, 0);
+    }
+}
+
+static void do_record(const canon_trace_record_t *r, double tolerance)
+{
+    double arg[9];
+    int i;
+
+    for (i = 0; i < 9; i++) {
+	arg[i] = canon_trace_arg(r, i);
+    }
+    switch (r->type) {
+    case CANON_TRACE_STRAIGHT_TRAVERSE:
+	add_line(arg, EMC_MOTION_TYPE_TRAVERSE, max_vel);
+	break;
+    case CANON_TRACE_STRAIGHT_FEED:
+	add_line(arg, EMC_MOTION_TYPE_FEED, feed_rate);
+	break;
+    case CANON_TRACE_ARC_FEED:
+	add_arc(arg);
+	break;
+    case CANON_TRACE_SET_FEED_RATE:
+	feed_rate = arg[0] / 60.0;
+	break;
+    case CANON_TRACE_SELECT_PLANE:
+	plane = arg[0] == 2 || arg[0] == 3 ? arg[0] : 1;
+	break;
+    case CANON_TRACE_SET_MOTION_CONTROL_MODE:
+	set_mode(arg[0], arg[1] > 0 ? arg[1] : tolerance);
+	break;
+    }
+}
+
+/* a trace is read whole, so the planner is timed on its own */
+static void do_trace(FILE *in, double tolerance)
+{
+    const canon_trace_record_t *r;
+    char *buf;
+    size_t n, len, size, pos;
+
+    size = 1 << 20;
+    buf = malloc(size);
+    if (buf == 0) {
+	fprintf(stderr, "tpbench: out of memory\n");
+	exit(1);
+    }
+    len = 0;
+    while ((n = fread(buf + len, 1, size - len, in)) > 0) {
+	len += n;
+	if (len == size) {
+	    size *= 2;
+	    buf = realloc(buf, size);
+	    if (buf == 0) {
+		fprintf(stderr, "tpbench: out of memory\n");
+		exit(1);
+	    }
+	}
+    }
+    if (!canon_trace_check(buf, len)) {
+	fprintf(stderr, "tpbench: not a canon trace tpbench can read\n");
+	exit(1);
+    }
+    pos = ((canon_trace_header_t *) buf)->header_size;
+    while ((r = canon_trace_next(buf, len, &pos)) != 0) {
+	do_record(r, tolerance);
+    }
+    if (pos != len) {
+	fprintf(stderr, "tpbench: canon trace damaged at byte %lu\n",
+	    (unsigned long) pos);
+    }
+    free(buf);
+}
+
+static void do_line(char *line, double tolerance)
+{
+    double arg[9];
+    char *s, *name;
+
+    s = strchr(line, '(');
+    if (s == 0) {
+	return;
+    }
+    *s++ = 0;
+    /* the call name is the last word before the '(' */
+    name = strrchr(line, ' ');
+    name = name ? name + 1 : line;
+
+    memset(arg, 0, sizeof(arg));
+    if (strcmp(name, "STRAIGHT_TRAVERSE") == 0) {
+	get_args(s, arg, 6);
+	add_line(arg, EMC_MOTION_TYPE_TRAVERSE, max_vel);
+    } else if (strcmp(name, "STRAIGHT_FEED") == 0) {
+	get_args(s, arg, 6);
+	add_line(arg, EMC_MOTION_TYPE_FEED, feed_rate);
+    } else if (strcmp(name, "ARC_FEED") == 0) {
+	if (get_args(s, arg, 9) >= 6) {
+	    add_arc(arg);
+	}
+    } else if (strcmp(name, "SET_FEED_RATE") == 0) {
+	get_args(s, arg, 1);
+	feed_rate = arg[0] / 60.0;
+    } else if (strcmp(name, "SELECT_PLANE") == 0) {
+	if (strstr(s, "YZ")) {
+	    plane = 2;
+	} else if (strstr(s, "XZ")) {
+	    plane = 3;
+	} else {
+	    plane = 1;
+	}
+    } else if (strcmp(name, "SET_MOTION_CONTROL_MODE") == 0) {
+	if (strstr(s, "CANON_CONTINUOUS")) {
+	    s = strchr(s, ',');
+	    if (s && get_args(s + 1, arg, 1) == 1 && arg[0] > 0) {
+		tolerance = arg[0];
+	    }
+	    set_mode(3, tolerance);
+	} else if (strstr(s, "CANON_EXACT_PATH")) {
+	    set_mode(2, 0);
+	} else {
+	    set_mode(1, 0);
+	}
+    }
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report(void)
+{
+    double secs = ticks * period * 1e-9;
+    static const double pct[] = { 50, 90, 99, 99.9 };
+    unsigned int i;
+
+    printf("segments %d\n", segments);
+    printf("blends %d\n", blends);
+    printf("seamless %d\n", seamless);
+    printf("ticks %d\n", ticks);
+    printf("plan-us-per-segment %.3f\n",
+	segments ? plan_secs * 1e6 / segments : 0.0);
+    if (ticks > 0) {
+	qsort(tick_ns, ticks, sizeof(*tick_ns), cmp_uint);
+	for (i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+	    printf("tick-ns-p%g %u\n", pct[i],
+		tick_ns[(int) (pct[i] / 100.0 * (ticks - 1))]);
+	}
+	printf("tick-ns-max %u\n", tick_ns[ticks - 1]);
+    }
+    printf("program-secs %.6f\n", secs);
+    printf("avg-feed %.4f\n", secs > 0 ? path_len / secs * 60.0 : 0.0);
+    printf("avg-cutting-feed %.4f\n",
+	feed_ticks ? feed_len / (feed_ticks * period * 1e-9) * 60.0 : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+    char line[1024];
+    double tolerance = 0, rapid_tolerance = 0;
+    int queue_size = 2000, arc_blend = 0, c;
+    TC_STRUCT *tc_space;
+
+    while ((c = getopt(argc, argv, "p:v:a:j:t:r:bq:")) != -1) {
+	switch (c) {
+	case 'p':
+	    period = atol(optarg);
+	    break;
+	case 'v':
+	    max_vel = atof(optarg);
+	    break;
+	case 'a':
+	    max_acc = atof(optarg);
+	    break;
+	case 'j':
+	    max_jerk = atof(optarg);
+	    break;
+	case 't':
+	    tolerance = atof(optarg);
+	    break;
+	case 'r':
+	    rapid_tolerance = atof(optarg);
+	    break;
+	case 'b':
+	    arc_blend = 1;
+	    break;
+	case 'q':
+	    queue_size = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "syntax: %s [-p period] [-v maxvel] [-a maxacc]"
+		" [-j maxjerk] [-t tolerance] [-r rapid tolerance] [-b]"
+		" [-q queue size] [file]\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (optind < argc) {
+	in = fopen(argv[optind], "r");
+	if (in == 0) {
+	    perror(argv[optind]);
+	    return 1;
+	}
+    }
+    if (period <= 0 || max_vel <= 0 || max_acc <= 0 || max_jerk <= 0
+	|| rapid_tolerance < 0 || queue_size <= TC_QUEUE_MARGIN) {
+	fprintf(stderr, "tpbench: bad period, limits or queue size\n");
+	return 1;
+    }
+    rtapi_set_msg_level(RTAPI_MSG_ERR);
+
+    status.net_feed_scale = 1.0;
+    status.spindle_is_atspeed = 1;
+    config.numDIO = 0;
+    config.numAIO = 0;
+    tc_space = calloc(queue_size, sizeof(TC_STRUCT));
+    if (tc_space == 0 || tpCreate(&tp, queue_size, tc_space) != 0) {
+	fprintf(stderr, "tpbench: can't create the planner\n");
+	return 1;
+    }
+    tpSetCycleTime(&tp, period * 1e-9);
+    tpSetVmax(&tp, max_vel, max_vel);
+    tpSetVlimit(&tp, max_vel);
+    tpSetTermCond(&tp, TC_TERM_COND_BLEND, tolerance);
+    tpSetRapidTolerance(&tp, rapid_tolerance);
+    tpSetArcBlend(&tp, arc_blend);
+    memset(&pos, 0, sizeof(pos));
+    tpSetPos(&tp, pos);
+    last_pos = pos;
+    feed_rate = max_vel;
+
+    /* printed canon lines start with the call number, a trace with
+       its magic */
+    c = getc(in);
+    ungetc(c, in);
+    if (c == CANON_TRACE_MAGIC[0]) {
+	do_trace(in, tolerance);
+    } else {
+	while (fgets(line, sizeof(line), in)) {
+	    do_line(line, tolerance);
+	}
+    }
+    while (!tpIsDone(&tp) || tpQueueDepth(&tp) > 0) {
+	run_cycle();
+    }
+    report();
+    return 0;
+}
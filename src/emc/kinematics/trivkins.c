@@ -52,6 +52,52 @@ int kinematicsInverse(const EmcPose * pos,
     return 0;
 }
 
+/* nothing to estimate, so the batch functions skip the copy that
+   kinsbatch.c makes between poses */
+int kinematicsForwardBatch(const double *joints,
+			   EmcPose * pos,
+			   int n, int stride,
+			   const KINEMATICS_FORWARD_FLAGS * fflags,
+			   KINEMATICS_INVERSE_FLAGS * iflags)
+{
+    int i;
+
+    for (i = 0; i < n; i++, joints += stride, pos++) {
+	pos->tran.x = joints[0];
+	pos->tran.y = joints[1];
+	pos->tran.z = joints[2];
+	pos->a = joints[3];
+	pos->b = joints[4];
+	pos->c = joints[5];
+	pos->u = joints[6];
+	pos->v = joints[7];
+	pos->w = joints[8];
+    }
+    return n;
+}
+
+int kinematicsInverseBatch(const EmcPose * pos,
+			   double *joints,
+			   int n, int stride,
+			   const KINEMATICS_INVERSE_FLAGS * iflags,
+			   KINEMATICS_FORWARD_FLAGS * fflags)
+{
+    int i;
+
+    for (i = 0; i < n; i++, joints += stride, pos++) {
+	joints[0] = pos->tran.x;
+	joints[1] = pos->tran.y;
+	joints[2] = pos->tran.z;
+	joints[3] = pos->a;
+	joints[4] = pos->b;
+	joints[5] = pos->c;
+	joints[6] = pos->u;
+	joints[7] = pos->v;
+	joints[8] = pos->w;
+    }
+    return n;
+}
+
 /* implemented for these kinematics as giving joints preference */
 int kinematicsHome(EmcPose * world,
 		   double *joint,
@@ -76,6 +122,8 @@ KINEMATICS_TYPE kinematicsType()
 EXPORT_SYMBOL(kinematicsType);
 EXPORT_SYMBOL(kinematicsForward);
 EXPORT_SYMBOL(kinematicsInverse);
+EXPORT_SYMBOL(kinematicsForwardBatch);
+EXPORT_SYMBOL(kinematicsInverseBatch);
 MODULE_LICENSE("GPL");
 
 int comp_id;
@@ -72,6 +72,7 @@
 #include "emcmotglb.h"
 #include "mot_priv.h"
 #include "rtapi_math.h"
+#include "rtapi_string.h"       /* memset */
 #include "motion_types.h"
 #include "sync_cmd.h"
 // Mark strings for translation, but defer translation to userspace
@@ -90,7 +91,7 @@ int checkAllHomed(void)
 	if (emcmotDebug->allHomed) return 1;
     }
 
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 	/* point to joint data */
 	joint = &joints[joint_num];
 	if (!GET_JOINT_ACTIVE_FLAG(joint)) {
@@ -117,7 +118,7 @@ static int limits_ok(void)
     int joint_num;
     emcmot_joint_t *joint;
 
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 	/* point to joint data */
 	joint = &joints[joint_num];
 	if (!GET_JOINT_ACTIVE_FLAG(joint)) {
@@ -153,7 +154,7 @@ static int jog_ok(int joint_num, double vel)
 	   we skip the following tests... */
 	return 1;
     }
-    if (joint_num < 0 || joint_num >= emcmotConfig->numJoints) {
+    if (joint_num < 0 || joint_num >= NUM_JOINTS) {
 	reportError(_("Can't jog invalid joint number %d."), joint_num);
 	return 0;
     }
@@ -214,14 +215,14 @@ static int inRange(EmcPose pos, int id, char *move_type)
     int in_range = 1;
 
     /* fill in all joints with 0 */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 	joint_pos[joint_num] = 0.0;
     }
 
     /* now fill in with real values, for joints that are used */
     kinematicsInverse(&pos, joint_pos, &iflags, &fflags);
 
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 	/* point to joint data */
 	joint = &joints[joint_num];
 
@@ -258,7 +259,7 @@ void clearHomes(int joint_num)
 
     if (emcmotConfig->kinType == KINEMATICS_INVERSE_ONLY) {
 	if (rehomeAll) {
-	    for (n = 0; n < emcmotConfig->numJoints; n++) {
+	    for (n = 0; n < NUM_JOINTS; n++) {
 		/* point at joint data */
 		joint = &(joints[n]);
 		/* clear flag */
@@ -291,9 +292,11 @@ int emcmotGetRotaryIsUnlocked(int axis) {
   pins get exported at runtime
   
   index is valid from 0 to emcmotConfig->num_dio <= EMCMOT_MAX_DIO, defined in emcmotcfg.h
+
+  when, in seconds into this period's move, goes out on the -time pin
   
 */
-void emcmotDioWrite(int index, char value)
+void emcmotDioWrite(int index, char value, double when)
 {
     if ((index >= emcmotConfig->numDIO) || (index < 0)) {
 	rtapi_print_msg(RTAPI_MSG_ERR, "ERROR: index out of range, %d not in [0..%d] (increase num_dio/EMCMOT_MAX_DIO=%d)\n", index, emcmotConfig->numDIO, EMCMOT_MAX_DIO);
@@ -303,6 +306,7 @@ void emcmotDioWrite(int index, char value)
 	} else {
 	    *(emcmot_hal_data->synch_do[index])=0;
 	}
+	*(emcmot_hal_data->synch_do_time[index]) = when;
     }
 }
 
@@ -334,14 +338,17 @@ void emcmotSyncInputWrite(int index, double timeout, int wait_type)
   pins get exported at runtime
   
   index is valid from 0 to emcmotConfig->num_aio <= EMCMOT_MAX_AIO, defined in emcmotcfg.h
+
+  when is as for emcmotDioWrite()
   
 */
-void emcmotAioWrite(int index, double value)
+void emcmotAioWrite(int index, double value, double when)
 {
     if ((index >= emcmotConfig->numAIO) || (index < 0)) {
 	rtapi_print_msg(RTAPI_MSG_ERR, "ERROR: index out of range, %d not in [0..%d] (increase num_aio/EMCMOT_MAX_AIO=%d)\n", index, emcmotConfig->numAIO, EMCMOT_MAX_AIO);
     } else {
         *(emcmot_hal_data->analog_output[index]) = value;
+        *(emcmot_hal_data->analog_output_time[index]) = when;
     }
 }
 
@@ -362,10 +369,10 @@ static int is_feed_type(int motion_type)
 }
 
 /*
-  emcmotCommandHandler() is called each main cycle to read the
-  shared memory buffer
+  handle_commands() reads the commands from the shared memory command
+  ring and carries them out
   */
-void emcmotCommandHandler(void *arg, long period)
+static void handle_commands(void *arg, long period)
 {
     int joint_num, axis_num;
     int n;
@@ -374,6 +381,7 @@ void emcmotCommandHandler(void *arg, long period)
     double tmp1;
     emcmot_comp_entry_t *comp_entry;
     char issue_atspeed = 0;
+    nurbs_block_t nurbs_block;
     int msg_level_before = rtapi_get_msg_level();
     //DEBUG: int msg_level_now = msg_level_before | RTAPI_MSG_DBG;
     int msg_level_now = msg_level_before;
@@ -382,12 +390,15 @@ void emcmotCommandHandler(void *arg, long period)
     counter = counter+1;
     check_stuff ( "before command_handler()" );
 
-    /* check for split read */
-    if (emcmotCommand->head != emcmotCommand->tail) {
-	emcmotDebug->split++;
-	return;			/* not really an error */
-    }
-    if (emcmotCommand->commandNum != emcmotStatus->commandNumEcho) {
+    /* take every command task has put into the ring, oldest first */
+    while (emcmotCommandRing->tail != emcmotCommandRing->head) {
+	/* copy the slot out before giving it back to task */
+	EMCMOT_MB();
+	*emcmotCommand = emcmotCommandRing->slot[emcmotCommandRing->tail %
+	    EMCMOT_COMMAND_RING_SIZE];
+	EMCMOT_MB();
+	emcmotCommandRing->tail++;
+
 	/* increment head count-- we'll be modifying emcmotStatus */
 	emcmotStatus->head++;
 	emcmotDebug->head++;
@@ -407,7 +418,7 @@ void emcmotCommandHandler(void *arg, long period)
 	   to point to the joint data.  All the individual commands need to do
 	   is verify that "joint" is non-zero. */
 	joint_num = emcmotCommand->joint;
-	if (joint_num >= 0 && joint_num < emcmotConfig->numJoints) {
+	if (joint_num >= 0 && joint_num < NUM_JOINTS) {
 	    /* valid joint, point to it's data */
 	    joint = &joints[joint_num];
 	} else {
@@ -441,6 +452,8 @@ void emcmotCommandHandler(void *arg, long period)
 	       planners which stops joint motion */
 	    rtapi_print_msg(RTAPI_MSG_DBG, "ABORT");
 	    rtapi_print_msg(RTAPI_MSG_DBG, " %d", joint_num);
+	    motTrace(emcmotTrace, MOT_TRACE_ABORT, emcmotStatus->id,
+		     emcmotStatus->motion_state, 0, 0, 0);
 	    /* check for coord or free space motion active */
 	    if (GET_MOTION_TELEOP_FLAG()) {
                 ZERO_EMC_POSE(emcmotDebug->teleop_data.desiredVel);
@@ -453,7 +466,7 @@ void emcmotCommandHandler(void *arg, long period)
 	    } else if (GET_MOTION_COORD_FLAG()) {
 		tpAbort(&emcmotDebug->coord_tp);
 	    } else {
-		for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+		for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 		    /* point to joint struct */
 		    joint = &joints[joint_num];
 		    /* tell joint planner to stop */
@@ -466,7 +479,7 @@ void emcmotCommandHandler(void *arg, long period)
 	    }
             SET_MOTION_ERROR_FLAG(0);
 	    /* clear joint errors (regardless of mode) */
-	    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+	    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 		/* point to joint struct */
 		joint = &joints[joint_num];
 		/* update status flags */
@@ -569,6 +582,14 @@ void emcmotCommandHandler(void *arg, long period)
 		( emcmotCommand->joint > EMCMOT_MAX_JOINTS )) {
 		break;
 	    }
+#ifdef EMCMOT_FIXED_JOINTS
+	    if ( emcmotCommand->joint != EMCMOT_FIXED_JOINTS ) {
+		reportError(_("this motmod is built for %d joints"),
+		    EMCMOT_FIXED_JOINTS);
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_PARAMS;
+		break;
+	    }
+#endif
 	    emcmotConfig->numJoints = emcmotCommand->joint;
 	    break;
 
@@ -607,7 +628,7 @@ void emcmotCommandHandler(void *arg, long period)
 	    } else {
 		rtapi_print_msg(RTAPI_MSG_DBG, "override on");
 		emcmotStatus->overrideLimitMask = 0;
-		for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+		for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 		    /* point at joint data */
 		    joint = &joints[joint_num];
 		    /* only override limits that are currently tripped */
@@ -620,7 +641,7 @@ void emcmotCommandHandler(void *arg, long period)
 		}
 	    }
 	    emcmotDebug->overriding = 0;
-	    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+	    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 		/* point at joint data */
 		joint = &joints[joint_num];
 		/* clear joint errors */
@@ -753,8 +774,9 @@ void emcmotCommandHandler(void *arg, long period)
 	        }
 	        /* set velocity of jog */
 	        joint->free_tp.max_vel = fabs(emcmotCommand->vel);
-	        /* use max joint accel */
+	        /* use max joint accel and jerk */
 	        joint->free_tp.max_acc = joint->acc_limit;
+	        joint->free_tp.max_jerk = joint->jerk_limit;
 	        /* lock out other jog sources */
 	        joint->kb_jog_active = 1;
 	        /* and let it go */
@@ -850,8 +872,9 @@ void emcmotCommandHandler(void *arg, long period)
 	        joint->free_tp.pos_cmd = tmp1;
 	        /* set velocity of jog */
 	        joint->free_tp.max_vel = fabs(emcmotCommand->vel);
-	        /* use max joint accel */
+	        /* use max joint accel and jerk */
 	        joint->free_tp.max_acc = joint->acc_limit;
+	        joint->free_tp.max_jerk = joint->jerk_limit;
 	        /* lock out other jog sources */
 	        joint->kb_jog_active = 1;
 	        /* and let it go */
@@ -940,8 +963,9 @@ void emcmotCommandHandler(void *arg, long period)
 	    }
 	    /* set velocity of jog */
 	    joint->free_tp.max_vel = fabs(emcmotCommand->vel);
-	    /* use max joint accel */
+	    /* use max joint accel and jerk */
 	    joint->free_tp.max_acc = joint->acc_limit;
+	    joint->free_tp.max_jerk = joint->jerk_limit;
 	    /* lock out other jog sources */
 	    joint->kb_jog_active = 1;
 	    /* and let it go */
@@ -961,18 +985,55 @@ void emcmotCommandHandler(void *arg, long period)
 	    tpSetTermCond(&emcmotDebug->coord_tp, emcmotCommand->termCond, emcmotCommand->tolerance);
 	    break;
 
+	case EMCMOT_SET_RAPID_TOLERANCE:
+	    /* can do it at any time, applies to traverses queued after */
+	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_RAPID_TOLERANCE");
+	    if (tpSetRapidTolerance(&emcmotDebug->coord_tp,
+		    emcmotCommand->tolerance) != 0) {
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_PARAMS;
+	    }
+	    break;
+
+	case EMCMOT_SET_ARC_BLEND:
+	    /* can do it at any time, applies to lines queued after */
+	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_ARC_BLEND");
+	    tpSetArcBlend(&emcmotDebug->coord_tp, emcmotCommand->mode);
+	    break;
+
         case EMCMOT_SET_SPINDLESYNC:
             tpSetSpindleSync(&emcmotDebug->coord_tp, emcmotCommand->spindlesync, emcmotCommand->flags);
             break;
 
         case EMCMOT_SET_NURBS:
+            /* the whole curve is in the NURBS arena, the command only
+               carries its offsets and lengths */
+            rtapi_print_msg(RTAPI_MSG_DBG, "SET_NURBS");
+            nurbs_block = emcmotCommand->nurbs_block;
+            if (nurbs_block.ctrl_pts_offset + nurbs_block.nr_of_ctrl_pts > EMCMOT_NURBS_ARENA_SIZE ||
+                nurbs_block.knots_offset + nurbs_block.nr_of_knots > EMCMOT_NURBS_ARENA_SIZE ||
+                nurbs_block.arclen_offset + NURBS_ARCLEN_STRIDE * nurbs_block.nr_of_arclen > EMCMOT_NURBS_ARENA_SIZE) {
+                reportError(_("NURBS block outside of the NURBS arena"));
+                emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_PARAMS;
+                break;
+            }
+            nurbs_block.ctrl_pts_ptr =
+                &emcmotStruct->nurbs_arena.ctrl_pts[nurbs_block.ctrl_pts_offset];
+            nurbs_block.knots_ptr =
+                &emcmotStruct->nurbs_arena.knots[nurbs_block.knots_offset];
+            nurbs_block.arclen_ptr =
+                &emcmotStruct->nurbs_arena.arclen[nurbs_block.arclen_offset];
             //TODO: have to consider several condition
-            tpAddNURBS(&emcmotDebug->coord_tp, emcmotCommand->motion_type,
-                       emcmotCommand->nurbs_block, emcmotCommand->pos,
+            if (-1 == tpAddNURBS(&emcmotDebug->coord_tp, emcmotCommand->motion_type,
+                       nurbs_block, emcmotCommand->pos,
                        emcmotStatus->enables_new, emcmotCommand->vel,
                        emcmotCommand->ini_maxvel,
                        emcmotCommand->ini_maxacc,
-                       emcmotCommand->ini_maxjerk);
+                       emcmotCommand->ini_maxjerk)) {
+                reportError(_("can't add NURBS move"));
+                emcmotStatus->commandStatus = EMCMOT_COMMAND_BAD_EXEC;
+                tpAbort(&emcmotDebug->coord_tp);
+                SET_MOTION_ERROR_FLAG(1);
+            }
             break;
 	case EMCMOT_SET_LINE:
 	    /* emcmotDebug->coord_tp up a linear move */
@@ -1381,7 +1442,7 @@ void emcmotCommandHandler(void *arg, long period)
                 /* we want all or none, so these checks need to all be done first.
                  * but, let's only report the first error.  There might be several,
                  * for instance if a homing sequence is running. */
-                for (n = 0; n < emcmotConfig->numJoints; n++) {
+                for (n = 0; n < NUM_JOINTS; n++) {
                     joint = &joints[n];
                     if(GET_JOINT_ACTIVE_FLAG(joint)) {
                         if (GET_JOINT_HOMING_FLAG(joint)) {
@@ -1395,7 +1456,7 @@ void emcmotCommandHandler(void *arg, long period)
                     }
                 }
                 /* we made it through the checks, so unhome them all */
-                for (n = 0; n < emcmotConfig->numJoints; n++) {
+                for (n = 0; n < NUM_JOINTS; n++) {
                     joint = &joints[n];
                     if(GET_JOINT_ACTIVE_FLAG(joint)) {
                         /* if -2, only unhome the volatile_home joints */
@@ -1404,7 +1465,7 @@ void emcmotCommandHandler(void *arg, long period)
                         }
                     }
                 }
-            } else if (joint_num < emcmotConfig->numJoints) {
+            } else if (joint_num < NUM_JOINTS) {
                 /* request was for only one joint */
                 if(GET_JOINT_ACTIVE_FLAG(joint)) {
                     if (GET_JOINT_HOMING_FLAG(joint)) {
@@ -1421,7 +1482,7 @@ void emcmotCommandHandler(void *arg, long period)
                 }
             } else {
                 /* invalid joint number specified */
-                reportError(_("Cannot unhome invalid joint %d (max %d)"), joint_num, (emcmotConfig->numJoints-1));
+                reportError(_("Cannot unhome invalid joint %d (max %d)"), joint_num, (NUM_JOINTS-1));
                 return;
             }
 
@@ -1615,11 +1676,21 @@ void emcmotCommandHandler(void *arg, long period)
 	    emcmot_config_change();
 	    break;
 
+	case EMCMOT_RESET_TIMING:
+	    rtapi_print_msg(RTAPI_MSG_DBG, "RESET_TIMING");
+	    for (n = 0; n < EMCMOT_NUM_PHASES; n++) {
+		emcmotDebug->timing[n].max = 0;
+		memset(emcmotDebug->timing[n].hist, 0,
+		    sizeof(emcmotDebug->timing[n].hist));
+		emcmot_hal_data->timing_max[n] = 0;
+	    }
+	    break;
+
 	/* needed for synchronous I/O */
 	case EMCMOT_SET_AOUT:
 	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_AOUT");
 	    if (emcmotCommand->now) { //we set it right away
-		emcmotAioWrite(emcmotCommand->out, emcmotCommand->minLimit);
+		emcmotAioWrite(emcmotCommand->out, emcmotCommand->minLimit, 0.0);
 	    } else { // we put it on the TP queue, warning: only room for one in there, any new ones will overwrite
 		tpSetAout(&emcmotDebug->coord_tp, emcmotCommand->out,
 		    emcmotCommand->minLimit, emcmotCommand->maxLimit);
@@ -1629,7 +1700,7 @@ void emcmotCommandHandler(void *arg, long period)
 	case EMCMOT_SET_DOUT:
 	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_DOUT");
 	    if (emcmotCommand->now) { //we set it right away
-		emcmotDioWrite(emcmotCommand->out, emcmotCommand->start);
+		emcmotDioWrite(emcmotCommand->out, emcmotCommand->start, 0.0);
 	    } else { // we put it on the TP queue, warning: only room for one in there, any new ones will overwrite
 		tpSetDout(&emcmotDebug->coord_tp, emcmotCommand->out,
 		    emcmotCommand->start, emcmotCommand->end);
@@ -1778,6 +1849,62 @@ void emcmotCommandHandler(void *arg, long period)
 		comp_entry[0].rev_trim = comp_entry[1].rev_trim;
 	    }
 	    joint->comp.entries++;
+	    /* an evenly spaced table is indexed directly, see
+	       compute_screw_comp() */
+	    tmp1 = comp_entry[1].nominal - comp_entry[0].nominal;
+	    if (joint->comp.entries == 2) {
+		joint->comp.step = tmp1;
+	    } else if (fabs(tmp1 - joint->comp.step) > 1e-6 * joint->comp.step) {
+		joint->comp.step = 0.0;
+	    }
+	    break;
+
+	case EMCMOT_SET_JOINT_COMP_2D:
+	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_JOINT_COMP_2D for joint %d", joint_num);
+	    if (joint == 0) {
+		break;
+	    }
+	    if (emcmotCommand->comp_other < 0
+		|| emcmotCommand->comp_other >= NUM_JOINTS
+		|| emcmotCommand->comp_other == joint_num) {
+		reportError(_("joint %d: bad joint %d for 2D compensation"),
+		    joint_num, emcmotCommand->comp_other);
+		joint->comp_2d.other = -1;
+		break;
+	    }
+	    if (emcmotCommand->comp_index < 0) {
+		/* a new grid, the values follow */
+		if (emcmotCommand->comp_count[0] < 2 || emcmotCommand->comp_count[1] < 2
+		    || emcmotCommand->comp_count[0] * emcmotCommand->comp_count[1]
+			> EMCMOT_COMP_2D_SIZE
+		    || emcmotCommand->comp_step[0] <= 0.0
+		    || emcmotCommand->comp_step[1] <= 0.0) {
+		    reportError(_("joint %d: bad 2D compensation grid"), joint_num);
+		    joint->comp_2d.other = -1;
+		    break;
+		}
+		/* off until the values are in */
+		joint->comp_2d.other = -1;
+		for (n = 0; n < 2; n++) {
+		    joint->comp_2d.count[n] = emcmotCommand->comp_count[n];
+		    joint->comp_2d.start[n] = emcmotCommand->comp_start[n];
+		    joint->comp_2d.step_inv[n] = 1.0 / emcmotCommand->comp_step[n];
+		}
+		for (n = 0; n < EMCMOT_COMP_2D_SIZE; n++) {
+		    joint->comp_2d.corr[n] = 0.0;
+		}
+		break;
+	    }
+	    n = joint->comp_2d.count[0] * joint->comp_2d.count[1];
+	    if (emcmotCommand->comp_index >= n) {
+		reportError(_("joint %d: too many 2D compensation values"), joint_num);
+		break;
+	    }
+	    joint->comp_2d.corr[emcmotCommand->comp_index] = emcmotCommand->comp_forward;
+	    if (emcmotCommand->comp_index == n - 1) {
+		/* the last value turns the map on */
+		joint->comp_2d.other = emcmotCommand->comp_other;
+	    }
 	    break;
 
         case EMCMOT_SET_OFFSET:
@@ -1851,8 +1978,22 @@ void emcmotCommandHandler(void *arg, long period)
 	emcmotDebug->tail = emcmotDebug->head;
 
     }
-    /* end of: if-new-command */
+    /* end of: while-new-command */
     check_stuff ( "after command_handler()" );
     rtapi_set_msg_level(msg_level_before);
     return;
 }
+
+/*
+  emcmotCommandHandler() is called each main cycle to read the
+  shared memory command ring
+  */
+void emcmotCommandHandler(void *arg, long period)
+{
+    /* debug struct readers hold off while commands change it */
+    emcmotDebug->seq++;
+    EMCMOT_MB();
+    handle_commands(arg, period);
+    EMCMOT_MB();
+    emcmotDebug->seq++;
+}
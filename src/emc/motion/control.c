@@ -148,6 +148,14 @@ static double servo_period;
  */
 static void process_inputs(void);
 
+/* 'track_spindle()' estimates the spindle velocity and acceleration
+   from the spindle-revs samples, and extrapolates the position to the
+   time the outputs of this period take effect, so spindle synced moves
+   don't lag the spindle by a servo period.  A driver that timestamps
+   its position samples reports their age on motion.spindle-revs-age.
+ */
+static void track_spindle(void);
+
 /* 'do forward kins()' takes the position feedback in joint coords
    and applies the forward kinematics to it to generate feedback
    in Cartesean coordinates.  It has code to handle machines that
@@ -242,8 +250,18 @@ static void output_to_hal(void);
  */
 static void update_status(void);
 
+/* publish_status() hands a snapshot of the status of this period to user
+   space, see emcmot_status_pub_t */
+static void publish_status(void);
+
 static void handle_special_cmd(void);
 
+/* 'end_phase()' charges the clocks since *t to the given phase of the
+   controller, in emcmotDebug->timing and the motion.timing.* params,
+   and sets *t to now for the next phase.
+ */
+static void end_phase(int phase, long long int *t);
+
 /***********************************************************************
  *                        PUBLIC FUNCTION CODE                          *
  ************************************************************************/
@@ -281,6 +299,7 @@ void emcmotController(void *arg, long period)
 
     long long int now = rtapi_get_clocks();
     long int this_run = (long int)(now - last);
+    long long int phase_start;
     emcmot_hal_data->last_period = this_run;
 #ifdef HAVE_CPU_KHZ
     emcmot_hal_data->last_period_ns = this_run * 1e6 / cpu_khz;
@@ -306,6 +325,8 @@ void emcmotController(void *arg, long period)
         for(i=0; i<CYCLE_HISTORY; i++) {
             if (this_run > 1.2 * cycles[i]) {
                 emcmot_hal_data->overruns++;
+                motTrace(emcmotTrace, MOT_TRACE_OVERRUN, 0,
+                         this_run, cycles[i], 0, 0);
                 // print message on first overrun only
                 if(emcmot_hal_data->overruns == 1) {
                     int saved_level = rtapi_get_msg_level();
@@ -344,6 +365,10 @@ void emcmotController(void *arg, long period)
 
     // end of overrun detection
 
+    /* debug struct readers hold off until we are done */
+    emcmotDebug->seq++;
+    EMCMOT_MB();
+
     /* calculate servo period as a double - period is in integer nsec */
     servo_period = period * 0.000000001;
 
@@ -360,40 +385,56 @@ void emcmotController(void *arg, long period)
     /* here begins the core of the controller */
 
     check_stuff ( "before process_inputs()" );
+    phase_start = rtapi_get_clocks();
     process_inputs();
+    end_phase(EMCMOT_PHASE_INPUTS, &phase_start);
     check_stuff ( "after process_inputs()" );
     do_forward_kins();
+    end_phase(EMCMOT_PHASE_FORWARD_KINS, &phase_start);
     check_stuff ( "after do_forward_kins()" );
     process_probe_inputs();
     handle_special_cmd();
+    end_phase(EMCMOT_PHASE_PROBE, &phase_start);
     check_stuff ( "after process_probe_inputs()" );
     check_for_faults();
+    end_phase(EMCMOT_PHASE_FAULTS, &phase_start);
     check_stuff ( "after check_for_faults()" );
     set_operating_mode();
+    end_phase(EMCMOT_PHASE_MODE, &phase_start);
     check_stuff ( "after set_operating_mode()" );
     handle_jogwheels();
+    end_phase(EMCMOT_PHASE_JOGWHEELS, &phase_start);
     check_stuff ( "after handle_jogwheels()" );
     do_homing_sequence();
     check_stuff ( "after do_homing_sequence()" );
     do_homing();
+    end_phase(EMCMOT_PHASE_HOMING, &phase_start);
     check_stuff ( "after do_homing()" );
     if (*(emcmot_hal_data->usb_busy) == 0) {
         get_pos_cmds(period);
     }
+    end_phase(EMCMOT_PHASE_POS_CMDS, &phase_start);
     check_stuff ( "after get_pos_cmds()" );
     compute_screw_comp();
+    end_phase(EMCMOT_PHASE_SCREW_COMP, &phase_start);
     check_stuff ( "after compute_screw_comp()" );
     output_to_hal();
+    end_phase(EMCMOT_PHASE_OUTPUT, &phase_start);
     check_stuff ( "after output_to_hal()" );
     update_status();
+    end_phase(EMCMOT_PHASE_STATUS, &phase_start);
     check_stuff ( "after update_status()" );
     /* here ends the core of the controller */
     emcmotStatus->heartbeat++;
     /* set tail to head, to indicate work complete */
     emcmotStatus->tail = emcmotStatus->head;
+    publish_status();
     /* clear init flag */
     first_pass = 0;
 
+    EMCMOT_MB();
+    emcmotDebug->seq++;
+
     /* end of controller function */
 }
 
@@ -406,6 +447,64 @@ void emcmotController(void *arg, long period)
    prototypes"
  */
 
+/* alpha-beta-gamma tracker gains: alpha 0.5 with beta and gamma from
+   Kalata's relations, about a 50 period settling time */
+#define SPINDLE_ALPHA 0.5
+#define SPINDLE_BETA 0.1716
+#define SPINDLE_GAMMA 0.0294
+
+static void track_spindle(void)
+{
+    static double pos, vel, acc, last_age;
+    static int primed = 0;
+    double revs = emcmotStatus->spindleRevs;
+    double age = *emcmot_hal_data->spindle_revs_age;
+    double dt, pred, r, lead;
+
+    /* time between this sample and the last */
+    dt = servo_period + last_age - age;
+    last_age = age;
+    pred = pos + vel * dt + 0.5 * acc * dt * dt;
+    r = revs - pred;
+    if (!primed || dt <= 0.0 || fabs(r) > 0.5) {
+	/* first sample, or revs jumped, e.g. reset by the index */
+	pos = revs;
+	if (!primed) {
+	    vel = acc = 0.0;
+	}
+	primed = 1;
+    } else {
+	pos = pred + SPINDLE_ALPHA * r;
+	vel = vel + acc * dt + SPINDLE_BETA * r / dt;
+	acc = acc + 2.0 * SPINDLE_GAMMA * r / (dt * dt);
+    }
+    emcmotStatus->spindleRevsVel = vel;
+    /* the measured position is exact up to the encoder resolution, only
+       extrapolate from it */
+    lead = age + emcmot_hal_data->spindle_lead_time;
+    emcmotStatus->spindleRevsLead = revs + vel * lead + 0.5 * acc * lead * lead;
+}
+
+static void end_phase(int phase, long long int *t)
+{
+    emcmot_phase_timing_t *timing = &emcmotDebug->timing[phase];
+    long long int now = rtapi_get_clocks();
+    unsigned int clocks = (unsigned int) (now - *t);
+    int bin;
+
+    *t = now;
+    timing->last = clocks;
+    if (clocks > timing->max) {
+	timing->max = clocks;
+    }
+    for (bin = 0; clocks > 1 && bin < EMCMOT_TIMING_BINS - 1; bin++) {
+	clocks >>= 1;
+    }
+    timing->hist[bin]++;
+    emcmot_hal_data->timing_last[phase] = timing->last;
+    emcmot_hal_data->timing_max[phase] = timing->max;
+}
+
 static void process_inputs(void)
 {
     int joint_num;
@@ -419,6 +518,7 @@ static void process_inputs(void)
 
     /* read spindle angle (for threading, etc) */
     emcmotStatus->spindleRevs = *emcmot_hal_data->spindle_revs;
+    track_spindle();
     emcmotStatus->spindleSpeedIn = *emcmot_hal_data->spindle_speed_in;
     emcmotStatus->spindle_is_atspeed = *emcmot_hal_data->spindle_is_atspeed;
     /* compute net feed and spindle scale factors */
@@ -462,7 +562,7 @@ static void process_inputs(void)
     emcmotStatus->net_spindle_scale = scale;
 
     /* read and process per-joint inputs */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint HAL data */
         joint_data = &(emcmot_hal_data->joint[joint_num]);
         /* point to joint data */
@@ -504,6 +604,11 @@ static void process_inputs(void)
 
 #ifndef MOTION_OVER_USB
         if (abs_ferror > joint->ferror_limit) {
+            if (!GET_JOINT_FERROR_FLAG(joint)) {
+                motTrace(emcmotTrace, MOT_TRACE_FERROR, joint_num,
+                         joint->pos_cmd, joint->pos_fb, joint->ferror,
+                         joint->ferror_limit);
+            }
             SET_JOINT_FERROR_FLAG(joint, 1);
         } else {
             SET_JOINT_FERROR_FLAG(joint, 0);
@@ -619,9 +724,14 @@ static void do_forward_kins(void)
     double joint_pos[EMCMOT_MAX_JOINTS] = {0,};
     int joint_num, result;
     emcmot_joint_t *joint;
+    /* joints the last good KINEMATICS_BOTH solution was for */
+    static double solved_pos[EMCMOT_MAX_JOINTS];
+    static int solved = 0;
+    double eps;
+    int moved;
 
     /* copy joint position feedback to local array */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint struct */
         joint = &joints[joint_num];
         /* copy feedback */
@@ -642,6 +752,26 @@ static void do_forward_kins(void)
 
     case KINEMATICS_BOTH:
         if (checkAllHomed()) {
+            /* the iterative kins (genhexkins, genserkins) cost a lot
+               for no new answer while the joints stand still, so with
+               motion.fk-epsilon 0 or more the last solution is kept
+               until some joint moves further than that from where it
+               was solved.  A change of the kins' own parameters is not
+               seen, which is why it is off (-1) unless asked for. */
+            eps = emcmot_hal_data->fk_epsilon;
+            if (solved && emcmotStatus->carte_pos_fb_ok && eps >= 0.0) {
+                moved = 0;
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
+                    if (fabs(joint_pos[joint_num] - solved_pos[joint_num]) > eps) {
+                        moved = 1;
+                        break;
+                    }
+                }
+                if (!moved) {
+                    emcmot_hal_data->fk_cache_hits++;
+                    break;
+                }
+            }
             /* is previous value suitable for use as initial guess? */
             if (!emcmotStatus->carte_pos_fb_ok) {
                 /* no, use home position as initial guess */
@@ -655,12 +785,18 @@ static void do_forward_kins(void)
             if (result < 0) {
                 /* error during kinematics calculations */
                 emcmotStatus->carte_pos_fb_ok = 0;
+                solved = 0;
             } else {
                 /* it worked! */
                 emcmotStatus->carte_pos_fb_ok = 1;
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
+                    solved_pos[joint_num] = joint_pos[joint_num];
+                }
+                solved = 1;
             }
         } else {
             emcmotStatus->carte_pos_fb_ok = 0;
+            solved = 0;
         }
         break;
 
@@ -682,6 +818,37 @@ static void do_forward_kins(void)
 }
 
 #define PROBE_CMD_TYPE 0x0001
+/* cartesian feedback of the previous servo period, for probe_latch() */
+static EmcPose probe_prev_fb;
+/* set when probe_latch() has filled in probedPos for the current probe */
+static int probe_soft_latched = 0;
+
+/* latch the position where the probe fired, 'ago' seconds before this
+   period's feedback was sampled, interpolating between the feedback of
+   this period and the last one */
+static void probe_latch(double ago)
+{
+    EmcPose *fb = &emcmotStatus->carte_pos_fb;
+    EmcPose *pos = &emcmotStatus->probedPos;
+    double f;
+
+    f = ago / servo_period;
+    if (f < 0.0) {
+	f = 0.0;
+    } else if (f > 1.0) {
+	f = 1.0;
+    }
+    pos->tran.x = fb->tran.x - f * (fb->tran.x - probe_prev_fb.tran.x);
+    pos->tran.y = fb->tran.y - f * (fb->tran.y - probe_prev_fb.tran.y);
+    pos->tran.z = fb->tran.z - f * (fb->tran.z - probe_prev_fb.tran.z);
+    pos->a = fb->a - f * (fb->a - probe_prev_fb.a);
+    pos->b = fb->b - f * (fb->b - probe_prev_fb.b);
+    pos->c = fb->c - f * (fb->c - probe_prev_fb.c);
+    pos->u = fb->u - f * (fb->u - probe_prev_fb.u);
+    pos->v = fb->v - f * (fb->v - probe_prev_fb.v);
+    pos->w = fb->w - f * (fb->w - probe_prev_fb.w);
+}
+
 static void process_probe_inputs(void)
 {
     unsigned char probe_type = emcmotStatus->probe_type;
@@ -725,16 +892,38 @@ static void process_probe_inputs(void)
         break;
 
     case USB_STATUS_READY: // PROBE STATUS Clean
+        // no board latches the probe when motion.probe-input-time is
+        // driven (>= 0): watch the input here instead, and take the
+        // position where it fired from the feedback before and after
+        if (emcmotStatus->probing &&
+            (emcmotStatus->probe_cmd != USB_CMD_STATUS_ACK) &&
+            (*emcmot_hal_data->probe_input_time >= 0.0))
+        {
+            if (emcmotStatus->probeVal != !!probe_whenclears)
+            {
+                probe_latch(*emcmot_hal_data->probe_input_time);
+                probe_soft_latched = 1;
+                emcmotStatus->probeTripped = 1;
+                emcmotStatus->probe_cmd = USB_CMD_STATUS_ACK;
+            } else if (GET_MOTION_INPOS_FLAG() && tpQueueDepth(&emcmotDebug->coord_tp) == 0)
+            {
+                emcmotStatus->probeTripped = 0;
+                emcmotStatus->probe_cmd = USB_CMD_STATUS_ACK;
+            }
+        }
         // deal with PROBE related status only
         if ((emcmotStatus->probe_cmd == USB_CMD_STATUS_ACK) /*(*emcmot_hal_data->update_pos_req)*/ && emcmotStatus->probing)
         {
-            if (emcmotStatus->probeTripped == 1)
+            if (emcmotStatus->probeTripped == 1 && probe_soft_latched)
+            {
+                /* probedPos is already set */
+            } else if (emcmotStatus->probeTripped == 1)
             {
                 int32_t joint_num;
                 emcmot_joint_t *joint;
                 /* update probed pos */
                 double joint_pos[EMCMOT_MAX_JOINTS] = {0,};
-                for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++)
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++)
                 {
                     joint = &joints[joint_num];
                     joint_pos[joint_num] =  joint->probed_pos - (joint->backlash_filt + joint->motor_offset);
@@ -760,6 +949,7 @@ static void process_probe_inputs(void)
             DP("emcmotStatus->depth(%d) paused(%d) probe_cmd(%d)\n", emcmotStatus->depth, emcmotStatus->paused, emcmotStatus->probe_cmd);
             tpAbort(&emcmotDebug->coord_tp);
             emcmotStatus->probing = 0;
+            probe_soft_latched = 0;
         }
 
         if ((*emcmot_hal_data->update_pos_req == 0) &&
@@ -773,6 +963,7 @@ static void process_probe_inputs(void)
     default:
         break;
     }
+    probe_prev_fb = emcmotStatus->carte_pos_fb;
 }
 
 static int update_current_pos = 0;
@@ -800,7 +991,7 @@ static void handle_special_cmd(void)
 
         *emcmot_hal_data->rcmd_seq_num_ack = *emcmot_hal_data->rcmd_seq_num_req;
 
-        for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+        for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
             /* point to joint struct */
             joint = &joints[joint_num];
             /* copy risc_pos_cmd feedback */
@@ -849,11 +1040,12 @@ static void check_for_faults(void)
         for (n = 0; n < num_dio; n++)
         {
             *(emcmot_hal_data->synch_do[n]) = 0;
+            *(emcmot_hal_data->synch_do_time[n]) = 0.0;
         }
     }
 
     /* check for various joint fault conditions */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint data */
         joint = &joints[joint_num];
         /* only check active, enabled axes */
@@ -928,12 +1120,13 @@ static void set_operating_mode(void)
     emcmot_joint_t *joint;
     emcmot_axis_t *axis;
     double positions[EMCMOT_MAX_JOINTS];
+    int old_state;
 
     /* check for disabling */
     if (!emcmotDebug->enabling && GET_MOTION_ENABLE_FLAG()) {
         /* clear out the motion emcmotDebug->coord_tp and interpolators */
         tpClear(&emcmotDebug->coord_tp);
-        for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+        for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
             /* point to joint data */
             joint = &joints[joint_num];
             /* disable free mode planner */
@@ -967,7 +1160,7 @@ static void set_operating_mode(void)
     /* check for emcmotDebug->enabling */
     if (emcmotDebug->enabling && !GET_MOTION_ENABLE_FLAG()) {
         tpSetPos(&emcmotDebug->coord_tp, emcmotStatus->carte_pos_cmd);
-        for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+        for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
             /* point to joint data */
             joint = &joints[joint_num];
 
@@ -993,7 +1186,7 @@ static void set_operating_mode(void)
             /* update coordinated emcmotDebug->coord_tp position */
             tpSetPos(&emcmotDebug->coord_tp, emcmotStatus->carte_pos_cmd);
             /* drain the cubics so they'll synch up */
-            for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+            for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                 /* point to joint data */
                 joint = &joints[joint_num];
                 cubicDrain(&(joint->cubic));
@@ -1020,7 +1213,7 @@ static void set_operating_mode(void)
             if (!emcmotDebug->teleoperating && GET_MOTION_TELEOP_FLAG()) {
                 SET_MOTION_TELEOP_FLAG(0);
                 if (!emcmotDebug->coordinating) {
-                    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+                    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                         /* point to joint data */
                         joint = &joints[joint_num];
                         /* update free planner positions */
@@ -1036,7 +1229,7 @@ static void set_operating_mode(void)
                 /* preset traj planner to current position */
                 tpSetPos(&emcmotDebug->coord_tp, emcmotStatus->carte_pos_cmd);
                 /* drain the cubics so they'll synch up */
-                for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                     /* point to joint data */
                     joint = &joints[joint_num];
                     cubicDrain(&(joint->cubic));
@@ -1056,7 +1249,7 @@ static void set_operating_mode(void)
         /* check entering free space mode */
         if (!emcmotDebug->coordinating && GET_MOTION_COORD_FLAG()) {
             if (GET_MOTION_INPOS_FLAG()) {
-                for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                     /* point to joint data */
                     joint = &joints[joint_num];
                     /* set joint planner curr_pos to current location */
@@ -1076,6 +1269,7 @@ static void set_operating_mode(void)
     /*! \todo FIXME - this code is temporary - eventually this function will be
        cleaned up and simplified, and 'motion_state' will become the master
        for this info, instead of having to gather it from several flags */
+    old_state = emcmotStatus->motion_state;
     if (!GET_MOTION_ENABLE_FLAG()) {
         emcmotStatus->motion_state = EMCMOT_MOTION_DISABLED;
     } else if (GET_MOTION_TELEOP_FLAG()) {
@@ -1085,6 +1279,10 @@ static void set_operating_mode(void)
     } else {
         emcmotStatus->motion_state = EMCMOT_MOTION_FREE;
     }
+    if (emcmotStatus->motion_state != old_state) {
+        motTrace(emcmotTrace, MOT_TRACE_STATE, 0,
+                 old_state, emcmotStatus->motion_state, 0, 0);
+    }
 }
 
 static void handle_jogwheels(void)
@@ -1095,7 +1293,7 @@ static void handle_jogwheels(void)
     int new_jog_counts, delta;
     double distance, pos, stop_dist;
 
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint data */
         joint_data = &(emcmot_hal_data->joint[joint_num]);
         joint = &joints[joint_num];
@@ -1171,6 +1369,10 @@ static void handle_jogwheels(void)
             double v = joint->vel_limit * emcmotStatus->net_feed_scale;
             /* compute stopping distance at max speed */
             stop_dist = v * v / ( 2 * joint->acc_limit);
+            if (joint->jerk_limit > 0) {
+                /* plus what ramping the decel up and down adds */
+                stop_dist += 0.5 * v * joint->acc_limit / joint->jerk_limit;
+            }
             /* if commanded position leads the actual position by more
                than stopping distance, discard excess command */
             if ( pos > joint->pos_cmd + stop_dist ) {
@@ -1211,11 +1413,13 @@ static void get_pos_cmds(long period)
     int onlimit = 0;
     int joint_limit[EMCMOT_MAX_JOINTS][2];
     int num_joints;
+    /* last motion id traced, to mark segment changes */
+    static int trace_id = -1;
 
-    num_joints = emcmotConfig->numJoints;
+    num_joints = NUM_JOINTS;
 
     /* copy joint position feedback to local array */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint struct */
         joint = &joints[joint_num];
         /* copy coarse command */
@@ -1236,7 +1440,7 @@ static void get_pos_cmds(long period)
         /* in free mode, each joint is planned independently */
         /* initial value for flag, if needed it will be cleared below */
         SET_MOTION_INPOS_FLAG(1);
-        for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+        for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
             /* point to joint struct */
             joint = &joints[joint_num];
             if (!GET_JOINT_ACTIVE_FLAG(joint)) {
@@ -1372,9 +1576,25 @@ static void get_pos_cmds(long period)
                 tpRunCycle(&emcmotDebug->coord_tp, period);
                 /* gt new commanded traj pos */
                 emcmotStatus->carte_pos_cmd = tpGetPos(&emcmotDebug->coord_tp);
+                if (emcmotStatus->id != trace_id) {
+                    trace_id = emcmotStatus->id;
+                    motTrace(emcmotTrace, MOT_TRACE_SEGMENT, trace_id,
+                             emcmotStatus->distance_to_go,
+                             emcmotStatus->requested_vel, 0, 0);
+                }
+                motTrace(emcmotTrace, MOT_TRACE_TICK, emcmotStatus->id,
+                         emcmotStatus->carte_pos_cmd.tran.x,
+                         emcmotStatus->carte_pos_cmd.tran.y,
+                         emcmotStatus->carte_pos_cmd.tran.z,
+                         emcmotStatus->current_vel);
                 /* OUTPUT KINEMATICS - convert to joints in local array */
-                kinematicsInverse(&emcmotStatus->carte_pos_cmd, positions,
-                        &iflags, &fflags);
+                if (kinematicsInverse(&emcmotStatus->carte_pos_cmd, positions,
+                        &iflags, &fflags) != 0) {
+                    motTrace(emcmotTrace, MOT_TRACE_KINS, emcmotStatus->id,
+                             emcmotStatus->carte_pos_cmd.tran.x,
+                             emcmotStatus->carte_pos_cmd.tran.y,
+                             emcmotStatus->carte_pos_cmd.tran.z, 0);
+                }
                 /* copy to joint structures and spline them up */
                 DPS("%11u", _dt);
                 DPS("%10.5f%10.5f%10.5f%10.5f",
@@ -1382,7 +1602,7 @@ static void get_pos_cmds(long period)
                         emcmotStatus->carte_pos_cmd.tran.y,
                         emcmotStatus->carte_pos_cmd.tran.z,
                         emcmotStatus->carte_pos_cmd.a);
-                for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+                for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                     /* point to joint struct */
                     joint = &joints[joint_num];
                     joint->coarse_pos = positions[joint_num];
@@ -1399,7 +1619,7 @@ static void get_pos_cmds(long period)
             }
             /* there is data in the interpolators */
             /* run interpolation */
-            for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+            for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                 /* point to joint struct */
                 joint = &joints[joint_num];
                 /* save old command */
@@ -1576,7 +1796,7 @@ static void get_pos_cmds(long period)
             /* set position commands to match feedbacks, this avoids
                    disturbances and/or following errors when enabling */
             emcmotStatus->carte_pos_cmd = emcmotStatus->carte_pos_fb;
-            for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+            for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                 /* point to joint struct */
                 joint = &joints[joint_num];
                 /* save old command */
@@ -1599,7 +1819,7 @@ static void get_pos_cmds(long period)
         2) if homing params are wrong then after homing joint pos_cmd are outside,
         the upstream checks will pass it.
      */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint data */
         joint = &joints[joint_num];
         /* skip inactive or unhomed axes */
@@ -1630,7 +1850,7 @@ static void get_pos_cmds(long period)
     if ( onlimit ) {
         if ( ! emcmotStatus->on_soft_limit ) {
             /* just hit the limit */
-            for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+            for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
                 if (joint_limit[joint_num][0]) {
                     reportError(_("Exceeded negative soft limit on joint %d"), joint_num);
                 } else if (joint_limit[joint_num][1]) {
@@ -1736,17 +1956,88 @@ Their exact contents and meaning are as follows:
 
  */
 
+/* finds the entry of the comp table whose span holds pos: the current
+   one in most periods, otherwise by index for an evenly spaced table and
+   by bisection for others, so a long rapid costs no more than a creep */
+static emcmot_comp_entry_t *comp_find_entry(emcmot_comp_t *comp, double pos)
+{
+    emcmot_comp_entry_t *entry = comp->entry;
+    double f;
+    int lo, hi, mid;
+
+    if (pos >= entry->nominal && pos < (entry + 1)->nominal) {
+        return entry;
+    }
+    if (comp->step > 0.0) {
+        f = (pos - comp->array[1].nominal) / comp->step;
+        if (f < 0.0) {
+            entry = &comp->array[0];
+        } else if (f >= comp->entries - 1) {
+            entry = &comp->array[comp->entries];
+        } else {
+            entry = &comp->array[(int) f + 1];
+        }
+    } else {
+        /* array[0] is at -DBL_MAX and array[entries + 1] at +DBL_MAX */
+        lo = 0;
+        hi = comp->entries + 1;
+        while (hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if (comp->array[mid].nominal <= pos) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        entry = &comp->array[lo];
+    }
+    /* rounding can leave the index one entry off */
+    while (pos < entry->nominal) {
+        entry--;
+    }
+    while (pos >= (entry + 1)->nominal) {
+        entry++;
+    }
+    return entry;
+}
+
+/* bilinear interpolation in a joint's 2D comp map */
+static double comp_2d_value(emcmot_comp_2d_t *map, double pos, double other_pos)
+{
+    double f[2], t[2];
+    int i[2], n;
+    float *c;
+
+    f[0] = (pos - map->start[0]) * map->step_inv[0];
+    f[1] = (other_pos - map->start[1]) * map->step_inv[1];
+    for (n = 0; n < 2; n++) {
+        if (f[n] < 0.0) {
+            f[n] = 0.0;
+        } else if (f[n] > map->count[n] - 1) {
+            f[n] = map->count[n] - 1;
+        }
+        i[n] = (int) f[n];
+        if (i[n] > map->count[n] - 2) {
+            i[n] = map->count[n] - 2;
+        }
+        t[n] = f[n] - i[n];
+    }
+    c = &map->corr[i[1] * map->count[0] + i[0]];
+    return (1.0 - t[1]) * ((1.0 - t[0]) * c[0] + t[0] * c[1])
+        + t[1] * ((1.0 - t[0]) * c[map->count[0]] + t[0] * c[map->count[0] + 1]);
+}
+
 static void compute_screw_comp(void)
 {
     int joint_num;
     emcmot_joint_t *joint;
     emcmot_comp_t *comp;
-    double dpos;
+    double dpos, target;
     double a_max, v_max, v, s_to_go, ds_stop, ds_vel, ds_acc, dv_acc;
 
 
     /* compute the correction */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint struct */
         joint = &joints[joint_num];
         if (!GET_JOINT_ACTIVE_FLAG(joint)) {
@@ -1758,12 +2049,7 @@ static void compute_screw_comp(void)
         if ( comp->entries > 0 ) {
             /* there is data in the comp table, use it */
             /* first make sure we're in the right spot in the table */
-            while ( joint->pos_cmd < comp->entry->nominal ) {
-                comp->entry--;
-            }
-            while ( joint->pos_cmd >= (comp->entry+1)->nominal ) {
-                comp->entry++;
-            }
+            comp->entry = comp_find_entry(comp, joint->pos_cmd);
             /* now interpolate */
             dpos = joint->pos_cmd - comp->entry->nominal;
             if (joint->vel_cmd > 0.0) {
@@ -1795,6 +2081,12 @@ static void compute_screw_comp(void)
                 /* not moving, use whatever was there before */
             }
         }
+        if (joint->comp_2d.other >= 0) {
+            joint->comp_2d_corr = comp_2d_value(&joint->comp_2d, joint->pos_cmd,
+                joints[joint->comp_2d.other].pos_cmd);
+        } else {
+            joint->comp_2d_corr = 0.0;
+        }
         /* at this point, the correction has been computed, but
            the value may make abrupt jumps on direction reversal */
         /*
@@ -1832,8 +2124,9 @@ static void compute_screw_comp(void)
         v_max = 0.5 * joint->vel_limit * emcmotStatus->net_feed_scale;
         a_max = 0.5 * joint->acc_limit;
         v = joint->backlash_vel;
-        if (joint->backlash_corr >= joint->backlash_filt) {
-            s_to_go = joint->backlash_corr - joint->backlash_filt; /* abs val */
+        target = joint->backlash_corr + joint->comp_2d_corr;
+        if (target >= joint->backlash_filt) {
+            s_to_go = target - joint->backlash_filt; /* abs val */
             if (s_to_go > 0) {
                 // off target, need to move
                 ds_vel  = v * servo_period;           /* abs val */
@@ -1850,7 +2143,7 @@ static void compute_screw_comp(void)
                     } else {
                         // last step to target
                         joint->backlash_vel  = 0.0;
-                        joint->backlash_filt = joint->backlash_corr;
+                        joint->backlash_filt = target;
                     }
                 } else {
                     if (v + dv_acc > v_max) {
@@ -1871,10 +2164,10 @@ static void compute_screw_comp(void)
             } else if (s_to_go < 0) {
                 // safely handle overshoot (should not occur)
                 joint->backlash_vel = 0.0;
-                joint->backlash_filt = joint->backlash_corr;
+                joint->backlash_filt = target;
             }
-        } else {  /* joint->backlash_corr < 0.0 */
-            s_to_go = joint->backlash_filt - joint->backlash_corr; /* abs val */
+        } else {  /* target < joint->backlash_filt */
+            s_to_go = joint->backlash_filt - target; /* abs val */
             if (s_to_go > 0) {
                 // off target, need to move
                 ds_vel  = -v * servo_period;          /* abs val */
@@ -1891,7 +2184,7 @@ static void compute_screw_comp(void)
                     } else {
                         // last step to target
                         joint->backlash_vel = 0.0;
-                        joint->backlash_filt = joint->backlash_corr;
+                        joint->backlash_filt = target;
                     }
                 } else {
                     if (-v + dv_acc > v_max) {
@@ -1912,7 +2205,7 @@ static void compute_screw_comp(void)
             } else if (s_to_go < 0) {
                 // safely handle overshoot (should not occur)
                 joint->backlash_vel = 0.0;
-                joint->backlash_filt = joint->backlash_corr;
+                joint->backlash_filt = target;
             }
         }
         /* backlash (and motor offset) will be applied to output later */
@@ -2020,7 +2313,7 @@ static void output_to_hal(void)
     } else {
         int i;
         double v2 = 0.0;
-        for(i=0; i < emcmotConfig->numJoints; i++)
+        for(i=0; i < NUM_JOINTS; i++)
             if(GET_JOINT_ACTIVE_FLAG(&(joints[i])) && joints[i].free_tp.active)
                 v2 += joints[i].vel_cmd * joints[i].vel_cmd;
         if(v2 > 0.0)
@@ -2069,7 +2362,7 @@ static void output_to_hal(void)
     *(emcmot_hal_data->tooloffset_w) = emcmotStatus->tool_offset.w;
 
     /* output joint info to HAL for scoping, etc */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint struct */
         joint = &joints[joint_num];
         /* apply backlash and motor offset to output */
@@ -2086,6 +2379,11 @@ static void output_to_hal(void)
         *(joint_data->index_enable) = joint->index_enable;
         *(joint_data->homing) = GET_JOINT_HOMING_FLAG(joint);
         *(joint_data->coarse_pos_cmd) = joint->coarse_pos;
+        /* vel-cmd still holds last period's, so this is the change in
+           velocity over this period, for drives that feed it forward
+           with vel-cmd */
+        *(joint_data->joint_acc_cmd) =
+            (joint->vel_cmd - *(joint_data->joint_vel_cmd)) * servo_freq;
         *(joint_data->joint_vel_cmd) = joint->vel_cmd;
         *(joint_data->backlash_corr) = joint->backlash_corr;
         *(joint_data->backlash_filt) = joint->backlash_filt;
@@ -2108,6 +2406,9 @@ static void output_to_hal(void)
         *(joint_data->f_errored) = GET_JOINT_FERROR_FLAG(joint);
         *(joint_data->faulted) = GET_JOINT_FAULT_FLAG(joint);
         *(joint_data->home_state_pin) = joint->home_state;
+        *(joint_data->home_time[HOME_TIME_SEARCH]) = joint->home_time[HOME_TIME_SEARCH];
+        *(joint_data->home_time[HOME_TIME_LATCH]) = joint->home_time[HOME_TIME_LATCH];
+        *(joint_data->home_time[HOME_TIME_FINAL]) = joint->home_time[HOME_TIME_FINAL];
 
         *(joint_data->risc_probe_vel) = joint->risc_probe_vel;
         *(joint_data->risc_probe_dist) = joint->risc_probe_dist;
@@ -2145,7 +2446,7 @@ static void update_status(void)
 
     /* copy status info from private joint structure to status
        struct in shared memory */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to joint data */
         joint = &joints[joint_num];
         /* point to joint status */
@@ -2200,9 +2501,12 @@ static void update_status(void)
     /* motion emcmotDebug->coord_tp status */
     emcmotStatus->depth = tpQueueDepth(&emcmotDebug->coord_tp);
     emcmotStatus->activeDepth = tpActiveDepth(&emcmotDebug->coord_tp);
+    emcmotStatus->queueTime = tpQueueTime(&emcmotDebug->coord_tp);
     emcmotStatus->id = tpGetExecId(&emcmotDebug->coord_tp);
     emcmotStatus->motionType = tpGetMotionType(&emcmotDebug->coord_tp);
-    emcmotStatus->queueFull = tcqFull(&emcmotDebug->coord_tp.queue);
+    emcmotStatus->queueFull = tcqFull(&emcmotDebug->coord_tp.queue) ||
+        tpNurbsPoolFull(&emcmotDebug->coord_tp) ||
+        tpSyncdioPoolFull(&emcmotDebug->coord_tp);
 
     /* check to see if we should pause in order to implement
        single emcmotDebug->stepping */
@@ -2220,3 +2524,12 @@ static void update_status(void)
 #endif
 }
 
+static void publish_status(void)
+{
+    unsigned int next = emcmotStatusPub->seq + 1;
+
+    /* readers only ever look at snap[seq % 2], so this one is free */
+    emcmotStatusPub->snap[next % 2] = *emcmotStatus;
+    EMCMOT_MB();
+    emcmotStatusPub->seq = next;
+}
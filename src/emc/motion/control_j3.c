@@ -0,0 +1,4 @@
+/* control.c for motmod_j3, the motion module built for three joints;
+   see NUM_JOINTS in mot_priv.h */
+#define EMCMOT_FIXED_JOINTS 3
+#include "control.c"
@@ -58,11 +58,40 @@
 #define DEFAULT_DIO 32
 #define DEFAULT_AIO 16
 
-/* size of motion queue
- * a TC_STRUCT is about 512 bytes so this queue is
- * about a megabyte.  */
+/* default size of the motion queue, in segments.  A TC_STRUCT is
+ * about 1.2k bytes so this queue is a bit over two megabytes.  Can be
+ * set with the tc_queue_size motmod parameter. */
 #define DEFAULT_TC_QUEUE_SIZE 2000
 
+/* shmem key for the motion queue */
+#define TC_QUEUE_SHMEM_KEY 0x54435155
+
+/* number of slots in the task->motion command ring.  Queued moves are
+   posted without waiting for motion, so this must stay below the margin
+   tcqFull() keeps free in the TC queue. */
+#define EMCMOT_COMMAND_RING_SIZE 8
+
+/* size of the NURBS arena shared between task and motion, in control
+   points (and in knots).  A whole NURBS curve must fit in here. */
+#define EMCMOT_NURBS_ARENA_SIZE 8192
+
+/* default size of the NURBS storage pool of the coordinated TP, in
+   control points.  Every queued NURBS segment holds a slice of it until
+   it retires.  Can be set with the nurbs_pool_size motmod parameter. */
+#define DEFAULT_NURBS_POOL_SIZE 16384
+
+/* shmem key for the NURBS storage pool */
+#define NURBS_POOL_SHMEM_KEY 0x4E555242
+
+/* default size of the motion event trace, in records (see mottrace.h).
+ * A record is 56 bytes, and a TP cycle takes one, so at 1 kHz this
+ * holds the last 16 seconds.  Can be set with the trace_size motmod
+ * parameter; 0 turns the trace off. */
+#define DEFAULT_MOT_TRACE_SIZE 16384
+
+/* shmem key for the motion event trace */
+#define MOT_TRACE_SHMEM_KEY 0x4D545243
+
 /* max following error */
 #define DEFAULT_MAX_FERROR 100
 
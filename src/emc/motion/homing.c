@@ -94,6 +94,40 @@ static void home_do_moving_checks(emcmot_joint_t * joint)
     }
 }
 
+/* 'home_account_time()' charges a servo period to the part of the
+   homing sequence the joint is in: searching for the switch, latching
+   the switch or index, or the final move.  It is called once per period
+   for each homing joint. */
+static void home_account_time(emcmot_joint_t * joint)
+{
+    int part;
+
+    if (joint->home_state == HOME_IDLE || joint->home_state == HOME_START
+	|| joint->home_state == HOME_ABORT) {
+	return;
+    }
+    if (joint->home_state < HOME_RISE_SEARCH_START) {
+	part = HOME_TIME_SEARCH;
+    } else if (joint->home_state < HOME_FINAL_MOVE_START) {
+	part = HOME_TIME_LATCH;
+    } else {
+	part = HOME_TIME_FINAL;
+    }
+    joint->home_time[part] += 1.0 / servo_freq;
+}
+
+/* 'home_latched()' is true once the joint has found home and is
+   past the point where it needs the machine for itself, so a joint
+   with HOME_OVERLAP in the next sequence group may start */
+static int home_latched(emcmot_joint_t * joint)
+{
+    if (joint->home_state == HOME_IDLE) {
+	return GET_JOINT_AT_HOME_FLAG(joint);
+    }
+    return joint->home_state >= HOME_FINAL_MOVE_START
+	&& joint->home_state != HOME_ABORT;
+}
+
 /***********************************************************************
 *                      PUBLIC FUNCTIONS                                *
 ************************************************************************/
@@ -101,7 +135,10 @@ static void home_do_moving_checks(emcmot_joint_t * joint)
 void do_homing_sequence(void)
 {
     static int home_sequence = -1;
+    /* joints of the next group that were started early, see HOME_OVERLAP */
+    static char started[EMCMOT_MAX_JOINTS];
     int i;
+    int latched = 1;
     int seen = 0;
     emcmot_joint_t *joint;
 
@@ -118,7 +155,7 @@ void do_homing_sequence(void)
 
     case HOME_SEQUENCE_START:
 	/* a request to home all joints */
-	for(i=0; i < emcmotConfig->numJoints; i++) {
+	for(i=0; i < NUM_JOINTS; i++) {
 	    joint = &joints[i];
 	    if(joint->home_state != HOME_IDLE) {
 		/* a home is already in progress, abort the home-all */
@@ -128,15 +165,21 @@ void do_homing_sequence(void)
 	}
 	/* ok to start the sequence, start at zero */
 	home_sequence = 0;
+	for(i=0; i < EMCMOT_MAX_JOINTS; i++) {
+	    started[i] = 0;
+	}
 	/* tell the world we're on the job */
 	emcmotStatus->homing_active = 1;
 	/* and drop into next state */
 
     case HOME_SEQUENCE_START_JOINTS:
 	/* start all joints whose sequence number matches home_sequence */
-	for(i=0; i < emcmotConfig->numJoints; i++) {
+	for(i=0; i < NUM_JOINTS; i++) {
 	    joint = &joints[i];
-	    if(joint->home_sequence == home_sequence) {
+	    if(joint->home_sequence == home_sequence && started[i]) {
+		/* already on its way, it overlapped the last group */
+		seen++;
+	    } else if(joint->home_sequence == home_sequence) {
 		/* start this joint */
 	        joint->free_tp.enable = 0;
 		joint->home_state = HOME_START;
@@ -155,12 +198,15 @@ void do_homing_sequence(void)
 	break;
 
     case HOME_SEQUENCE_WAIT_JOINTS:
-	for(i=0; i < emcmotConfig->numJoints; i++) {
+	for(i=0; i < NUM_JOINTS; i++) {
 	    joint = &joints[i];
 	    if(joint->home_sequence != home_sequence) {
 		/* this joint is not at the current sequence number, ignore it */
 		continue;
 	    }
+	    if(!home_latched(joint)) {
+		latched = 0;
+	    }
 	    if(joint->home_state != HOME_IDLE) {
 		/* still busy homing, keep waiting */
 		seen = 1;
@@ -179,6 +225,19 @@ void do_homing_sequence(void)
 	    home_sequence ++;
 	    emcmotStatus->homingSequenceState = HOME_SEQUENCE_START_JOINTS;
 	}
+	else if(latched) {
+	    /* every joint of this step has found home, joints of the
+	       next step that may overlap it can go */
+	    for(i=0; i < NUM_JOINTS; i++) {
+		joint = &joints[i];
+		if(joint->home_sequence == home_sequence + 1 &&
+		   (joint->home_flags & HOME_OVERLAP) && !started[i]) {
+		    joint->free_tp.enable = 0;
+		    joint->home_state = HOME_START;
+		    started[i] = 1;
+		}
+	    }
+	}
 	break;
     default:
 	/* should never get here */
@@ -203,7 +262,7 @@ void do_homing(void)
 	return;
     }
     /* loop thru joints, treat each one individually */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
 	/* point to joint struct */
 	joint = &joints[joint_num];
 	if (!GET_JOINT_ACTIVE_FLAG(joint)) {
@@ -213,6 +272,7 @@ void do_homing(void)
 	home_sw_active = GET_JOINT_HOME_SWITCH_FLAG(joint);
 	if (joint->home_state != HOME_IDLE) {
 	    homing_flag = 1; /* at least one joint is homing */
+	    home_account_time(joint);
 	}
 	
 	/* when an joint is homing, 'check_for_faults()' ignores its limit
@@ -251,6 +311,9 @@ void do_homing(void)
 		SET_JOINT_HOMING_FLAG(joint, 1);
 		SET_JOINT_HOMED_FLAG(joint, 0);
 		SET_JOINT_AT_HOME_FLAG(joint, 0);
+		joint->home_time[HOME_TIME_SEARCH] = 0.0;
+		joint->home_time[HOME_TIME_LATCH] = 0.0;
+		joint->home_time[HOME_TIME_FINAL] = 0.0;
 		/* stop any existing motion */
 		joint->free_tp.enable = 0;
 		/* reset delay counter */
@@ -777,6 +840,11 @@ void do_homing(void)
 		SET_JOINT_HOMING_FLAG(joint, 0);
 		SET_JOINT_HOMED_FLAG(joint, 1);
 		SET_JOINT_AT_HOME_FLAG(joint, 1);
+		rtapi_print_msg(RTAPI_MSG_INFO,
+		    "MOTION: joint %d homed, search %d ms, latch %d ms, final %d ms\n",
+		    joint_num, (int) (joint->home_time[HOME_TIME_SEARCH] * 1000),
+		    (int) (joint->home_time[HOME_TIME_LATCH] * 1000),
+		    (int) (joint->home_time[HOME_TIME_FINAL] * 1000));
 		joint->home_state = HOME_IDLE;
 		immediate_state = 1;
 		break;
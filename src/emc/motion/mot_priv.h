@@ -11,6 +11,9 @@
 #ifndef MOT_PRIV_H
 #define MOT_PRIV_H
 
+#include "mottrace.h"		/* mot_trace_t, motTrace() */
+#include "motion_debug.h"	/* EMCMOT_NUM_PHASES */
+
 /***********************************************************************
 *                       TYPEDEFS, ENUMS, ETC.                          *
 ************************************************************************/
@@ -31,6 +34,7 @@
 typedef struct {
     hal_float_t *coarse_pos_cmd;/* RPI: commanded position, w/o comp */
     hal_float_t *joint_vel_cmd;	/* RPI: commanded velocity, w/o comp */
+    hal_float_t *joint_acc_cmd;	/* RPI: commanded acceleration, w/o comp */
     hal_float_t *backlash_corr;	/* RPI: correction for backlash */
     hal_float_t *backlash_filt;	/* RPI: filtered backlash correction */
     hal_float_t *backlash_vel;	/* RPI: backlash speed variable */
@@ -66,6 +70,7 @@ typedef struct {
     hal_bit_t *amp_fault;	/* RPI: amp fault input */
     hal_bit_t *amp_enable;	/* WPI: amp enable output */
     hal_s32_t *home_state_pin;	/* WPI: homing state machine state */
+    hal_float_t *home_time[3];	/* WPI: secs in each part of the last homing */
     hal_float_t *index_pos_pin; /* RPI: motor index position (absolute motor position count) */
     hal_bit_t *usb_ferror_flag;
 
@@ -98,6 +103,7 @@ typedef struct {
 
 typedef struct {
     hal_bit_t *probe_input;	/* RPI: probe switch input */
+    hal_float_t *probe_input_time;	/* RPI: secs from probe edge to feedback sample, < 0 if the board latches */
     hal_bit_t *req_cmd_sync;
     hal_bit_t *align_pos_cmd;
     hal_u32_t *usb_cmd;         /* usb command output */
@@ -117,6 +123,8 @@ typedef struct {
     hal_bit_t *spindle_index_enable;
     hal_bit_t *spindle_is_atspeed;
     hal_float_t *spindle_revs;
+    hal_float_t *spindle_revs_age;	/* RPI: secs from spindle-revs sample to now */
+    hal_float_t spindle_lead_time;	/* param: extrapolate spindle-revs this far */
     hal_float_t *adaptive_feed;	/* RPI: adaptive feedrate, 0.0 to 1.0 */
     hal_bit_t *feed_hold;	/* RPI: set TRUE to stop motion */
     hal_bit_t *motion_enabled;	/* RPI: motion enable for all joints */
@@ -147,6 +155,8 @@ typedef struct {
     hal_bit_t *synch_di[EMCMOT_MAX_DIO]; /* RPI array: input pins for motion synched IO */
     hal_float_t *analog_input[EMCMOT_MAX_AIO]; /* RPI array: input pins for analog Inputs */
     hal_float_t *analog_output[EMCMOT_MAX_AIO]; /* RPI array: output pins for analog Inputs */
+    hal_float_t *synch_do_time[EMCMOT_MAX_DIO]; /* WPI array: when in the period the last change belongs */
+    hal_float_t *analog_output_time[EMCMOT_MAX_AIO]; /* WPI array: the same for the analog outputs */
 
     //hal_bit_t *sync_in[EMCMOT_MAX_SYNC_INPUT];
     hal_bit_t *sync_in_trigger;
@@ -198,6 +208,12 @@ typedef struct {
     hal_u32_t last_period;	/* param: last period in clocks */
     hal_float_t last_period_ns;	/* param: last period in nanoseconds */
     hal_u32_t overruns;		/* param: count of RT overruns */
+    hal_u32_t timing_last[EMCMOT_NUM_PHASES];	/* param: clocks per phase, last run */
+    hal_u32_t timing_max[EMCMOT_NUM_PHASES];	/* param: clocks per phase, max */
+
+    // forward kinematics cache, see do_forward_kins()
+    hal_float_t fk_epsilon;	/* param: joint motion that is ignored, <0 is off */
+    hal_u32_t fk_cache_hits;	/* param: periods the forward kins were skipped */
 
     hal_float_t *tooloffset_x;
     hal_float_t *tooloffset_y;
@@ -243,10 +259,14 @@ extern double servo_freq;
 /* Struct pointers */
 extern struct emcmot_struct_t *emcmotStruct;
 extern struct emcmot_command_t *emcmotCommand;
+extern struct emcmot_command_ring_t *emcmotCommandRing;
+extern struct emcmot_status_pub_t *emcmotStatusPub;
 extern struct emcmot_status_t *emcmotStatus;
 extern struct emcmot_config_t *emcmotConfig;
 extern struct emcmot_debug_t *emcmotDebug;
 extern struct emcmot_error_t *emcmotError;
+/* event trace, or 0 if trace_size=0 */
+extern mot_trace_t *emcmotTrace;
 
 /***********************************************************************
 *                    PUBLIC FUNCTION PROTOTYPES                        *
@@ -258,13 +278,23 @@ extern void emcmotController(void *arg, long period);
 extern void emcmotSetCycleTime(unsigned long nsec);
 
 /* these are related to synchronized I/O */
-extern void emcmotDioWrite(int index, char value);
-extern void emcmotAioWrite(int index, double value);
+extern void emcmotDioWrite(int index, char value, double when);
+extern void emcmotAioWrite(int index, double value, double when);
 extern void emcmotSyncInputWrite(int index, double timeout, int wait_type);
 
 extern void emcmotSetRotaryUnlock(int axis, int unlock);
 extern int emcmotGetRotaryIsUnlocked(int axis);
 
+/* The number of joints the loops run over.  A motmod built with
+   EMCMOT_FIXED_JOINTS (motmod_j3, see the Makefile) has it as a
+   constant, so the compiler can unroll the per-joint loops, and will
+   only load for that many joints. */
+#ifdef EMCMOT_FIXED_JOINTS
+#define NUM_JOINTS (EMCMOT_FIXED_JOINTS)
+#else
+#define NUM_JOINTS (emcmotConfig->numJoints)
+#endif
+
 /* homing is no longer in control.c, make functions public */
 extern void do_homing_sequence(void);
 extern void do_homing(void);
@@ -44,9 +44,19 @@ static long base_period_nsec = 0;	/* fastest thread period */
 RTAPI_MP_LONG(base_period_nsec, "fastest thread period (nsecs)");
 static long servo_period_nsec = 1000000;/* servo thread period */
 RTAPI_MP_LONG(servo_period_nsec, "servo thread period (nsecs)");
+static int base_thread_cpu = -1;	/* CPU for the base thread, -1 = default */
+RTAPI_MP_INT(base_thread_cpu, "CPU to run the base thread on");
+static int servo_thread_cpu = -1;	/* CPU for the servo thread, -1 = default */
+RTAPI_MP_INT(servo_thread_cpu, "CPU to run the servo thread on");
+static int servo_thread_helpers[4] = { -1, -1, -1, -1 };	/* helper CPUs */
+RTAPI_MP_ARRAY_INT(servo_thread_helpers, 4, "CPUs for servo thread helper tasks");
 static long traj_period_nsec = 0;	/* trajectory planner period */
 RTAPI_MP_LONG(traj_period_nsec, "trajectory planner period (nsecs)");
+#ifdef EMCMOT_FIXED_JOINTS
+static int num_joints = EMCMOT_FIXED_JOINTS;	/* the only number it takes */
+#else
 static int num_joints = EMCMOT_MAX_JOINTS;	/* default number of joints present */
+#endif
 RTAPI_MP_INT(num_joints, "number of joints");
 static int num_dio = DEFAULT_DIO;	/* default number of motion synched DIO */
 RTAPI_MP_INT(num_dio, "number of digital inputs/outputs");
@@ -54,6 +64,14 @@ static int num_aio = DEFAULT_AIO;	/* default number of motion synched AIO */
 RTAPI_MP_INT(num_aio, "number of analog inputs/outputs");
 static int num_sync_in = DEFAULT_DIO;
 RTAPI_MP_INT(num_sync_in,"number of synchornized input from 7i43");
+static int nurbs_pool_size = DEFAULT_NURBS_POOL_SIZE;	/* NURBS storage, in control points */
+RTAPI_MP_INT(nurbs_pool_size, "NURBS storage pool size (control points)");
+static int tc_queue_size = DEFAULT_TC_QUEUE_SIZE;	/* motion queue, in segments */
+RTAPI_MP_INT(tc_queue_size, "motion queue size (segments)");
+static int traj_interp_order = 3;	/* 3 = cubic, 5 = quintic, see cubic.c */
+RTAPI_MP_INT(traj_interp_order, "interpolation between trajectory points (3 or 5)");
+static int trace_size = DEFAULT_MOT_TRACE_SIZE;	/* event trace, in records */
+RTAPI_MP_INT(trace_size, "motion event trace size (records, 0 = off)");
 /***********************************************************************
  *                  GLOBAL VARIABLE DEFINITIONS                         *
  ************************************************************************/
@@ -84,16 +102,22 @@ int first_pass = 1;	/* used to set initial conditions */
 
   emcmotStruct is ptr to this memory.
 
-  emcmotCommand points to emcmotStruct->command,
+  emcmotCommandRing points to emcmotStruct->command_ring,
+  emcmotCommand points to emcmotStruct->command, the command being handled,
   emcmotStatus points to emcmotStruct->status,
+  emcmotStatusPub points to emcmotStruct->status_pub, where emcmotStatus
+  is published to,
   emcmotError points to emcmotStruct->error, and
  */
 emcmot_struct_t *emcmotStruct = 0;
 /* ptrs to either buffered copies or direct memory for command and status */
 struct emcmot_command_t *emcmotCommand = 0;
+struct emcmot_command_ring_t *emcmotCommandRing = 0;
+struct emcmot_status_pub_t *emcmotStatusPub = 0;
 struct emcmot_status_t *emcmotStatus = 0;
 struct emcmot_config_t *emcmotConfig = 0;
 struct emcmot_debug_t *emcmotDebug = 0;
+mot_trace_t *emcmotTrace = 0;
 struct emcmot_error_t *emcmotError = 0;	/* unused for RT_FIFO */
 
 /***********************************************************************
@@ -102,6 +126,9 @@ struct emcmot_error_t *emcmotError = 0;	/* unused for RT_FIFO */
 
 /* RTAPI shmem ID - for comms with higher level user space stuff */
 static int emc_shmem_id;	/* the shared memory ID */
+static int nurbs_shmem_id = -1;	/* shmem ID of the TP NURBS pool */
+static int tc_shmem_id = -1;	/* shmem ID of the TP motion queue */
+static int trace_shmem_id = -1;	/* shmem ID of the event trace */
 
 static int mot_comp_id;	/* component ID for motion module */
 
@@ -190,6 +217,14 @@ int rtapi_app_main(void)
         hal_exit(mot_comp_id);
         return -1;
     }
+#ifdef EMCMOT_FIXED_JOINTS
+    if ( num_joints != EMCMOT_FIXED_JOINTS ) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+                _("MOTION: num_joints is %d, this motmod is built for %d\n"), num_joints, EMCMOT_FIXED_JOINTS);
+        hal_exit(mot_comp_id);
+        return -1;
+    }
+#endif
 
     if (( num_dio < 1 ) || ( num_dio > EMCMOT_MAX_DIO )) {
         rtapi_print_msg(RTAPI_MSG_ERR,
@@ -259,6 +294,28 @@ void rtapi_app_exit(void)
                 _("MOTION: hal_stop_threads() failed, returned %d\n"), retval);
     }
     /* free shared memory */
+    if (nurbs_shmem_id >= 0) {
+        retval = rtapi_shmem_delete(nurbs_shmem_id, mot_comp_id);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    _("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
+        }
+    }
+    if (tc_shmem_id >= 0) {
+        retval = rtapi_shmem_delete(tc_shmem_id, mot_comp_id);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    _("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
+        }
+    }
+    if (trace_shmem_id >= 0) {
+        emcmotTrace = 0;
+        retval = rtapi_shmem_delete(trace_shmem_id, mot_comp_id);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    _("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
+        }
+    }
     retval = rtapi_shmem_delete(emc_shmem_id, mot_comp_id);
     if (retval < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
@@ -282,6 +339,7 @@ void rtapi_app_exit(void)
  */
 static int init_hal_io(void)
 {
+    static const char *phase_names[EMCMOT_NUM_PHASES] = EMCMOT_PHASE_NAMES;
     int n, retval;
     joint_hal_t *joint_data;
 
@@ -296,6 +354,7 @@ static int init_hal_io(void)
 
     /* export machine wide hal pins */
     if ((retval = hal_pin_bit_newf(HAL_IN, &(emcmot_hal_data->probe_input), mot_comp_id, "motion.probe-input")) != 0) goto error;
+    if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->probe_input_time), mot_comp_id, "motion.probe-input-time")) != 0) goto error;
 
     // RISC_CMD REQ and ACK
     if ((retval = hal_pin_bit_newf(HAL_IN, &(emcmot_hal_data->update_pos_req), mot_comp_id, "motion.update-pos-req")) < 0) goto error;
@@ -358,6 +417,9 @@ static int init_hal_io(void)
     // before merge:     *(emcmot_hal_data->feed_hold) = 0;
 
     if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->spindle_revs), mot_comp_id, "motion.spindle-revs")) != 0) goto error;
+    if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->spindle_revs_age), mot_comp_id, "motion.spindle-revs-age")) != 0) goto error;
+    if ((retval = hal_param_float_newf(HAL_RW, &(emcmot_hal_data->spindle_lead_time), mot_comp_id, "motion.spindle-lead-time")) != 0) goto error;
+    emcmot_hal_data->spindle_lead_time = 0.0;
     if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->spindle_speed_in), mot_comp_id, "motion.spindle-speed-in")) != 0) goto error;
     if ((retval = hal_pin_bit_newf(HAL_IN, &(emcmot_hal_data->spindle_is_atspeed), mot_comp_id, "motion.spindle-at-speed")) != 0) goto error;
     if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->adaptive_feed), mot_comp_id, "motion.adaptive-feed")) != 0) goto error;
@@ -368,6 +430,7 @@ static int init_hal_io(void)
     /* export motion digital input pins */
     for (n = 0; n < num_dio; n++) {
         if ((retval = hal_pin_bit_newf(HAL_OUT, &(emcmot_hal_data->synch_do[n]), mot_comp_id, "motion.digital-out-%02d", n)) != 0) goto error;
+        if ((retval = hal_pin_float_newf(HAL_OUT, &(emcmot_hal_data->synch_do_time[n]), mot_comp_id, "motion.digital-out-%02d-time", n)) != 0) goto error;
         if ((retval = hal_pin_bit_newf(HAL_IN, &(emcmot_hal_data->synch_di[n]), mot_comp_id, "motion.digital-in-%02d", n)) != 0) goto error;
     }
 
@@ -375,6 +438,7 @@ static int init_hal_io(void)
     /* export motion analog input pins */
     for (n = 0; n < num_aio; n++) {
         if ((retval = hal_pin_float_newf(HAL_OUT, &(emcmot_hal_data->analog_output[n]), mot_comp_id, "motion.analog-out-%02d", n)) != 0) goto error;
+        if ((retval = hal_pin_float_newf(HAL_OUT, &(emcmot_hal_data->analog_output_time[n]), mot_comp_id, "motion.analog-out-%02d-time", n)) != 0) goto error;
         if ((retval = hal_pin_float_newf(HAL_IN, &(emcmot_hal_data->analog_input[n]), mot_comp_id, "motion.analog-in-%02d", n)) != 0) goto error;
     }
 
@@ -435,6 +499,12 @@ static int init_hal_io(void)
     if ((retval = hal_param_float_newf(HAL_RO, &(emcmot_hal_data->last_period_ns), mot_comp_id, "motion.servo.last-period-ns")) != 0) goto error;
 #endif
     if ((retval = hal_param_u32_newf(HAL_RO, &(emcmot_hal_data->overruns), mot_comp_id, "motion.servo.overruns")) != 0) goto error;
+    for (n = 0; n < EMCMOT_NUM_PHASES; n++) {
+        if ((retval = hal_param_u32_newf(HAL_RO, &(emcmot_hal_data->timing_last[n]), mot_comp_id, "motion.timing.%s.last", phase_names[n])) != 0) goto error;
+        if ((retval = hal_param_u32_newf(HAL_RO, &(emcmot_hal_data->timing_max[n]), mot_comp_id, "motion.timing.%s.max", phase_names[n])) != 0) goto error;
+    }
+    if ((retval = hal_param_float_newf(HAL_RW, &(emcmot_hal_data->fk_epsilon), mot_comp_id, "motion.fk-epsilon")) != 0) goto error;
+    if ((retval = hal_param_u32_newf(HAL_RO, &(emcmot_hal_data->fk_cache_hits), mot_comp_id, "motion.fk-cache-hits")) != 0) goto error;
 
     if ((retval = hal_pin_float_newf(HAL_OUT, &(emcmot_hal_data->tooloffset_x), mot_comp_id, "motion.tooloffset.x")) != 0) goto error;
     if ((retval = hal_pin_float_newf(HAL_OUT, &(emcmot_hal_data->tooloffset_y), mot_comp_id, "motion.tooloffset.y")) != 0) goto error;
@@ -452,6 +522,7 @@ static int init_hal_io(void)
     *(emcmot_hal_data->feed_hold) = 0;
 
     //obsolete on arais-emc2-usb: *(emcmot_hal_data->probe_input) = 0;
+    *(emcmot_hal_data->probe_input_time) = -1.0;
     *(emcmot_hal_data->usb_cmd) = USB_CMD_NOOP;
     *(emcmot_hal_data->usb_status) = USB_STATUS_READY;
 
@@ -462,11 +533,13 @@ static int init_hal_io(void)
     /* motion synched dio, init to not enabled */
     for (n = 0; n < num_dio; n++) {
         *(emcmot_hal_data->synch_do[n]) = 0;
+        *(emcmot_hal_data->synch_do_time[n]) = 0.0;
         *(emcmot_hal_data->synch_di[n]) = 0;
     }
 
     for (n = 0; n < num_aio; n++) {
         *(emcmot_hal_data->analog_output[n]) = 0.0;
+        *(emcmot_hal_data->analog_output_time[n]) = 0.0;
         *(emcmot_hal_data->analog_input[n]) = 0.0;
     }
 
@@ -498,6 +571,12 @@ static int init_hal_io(void)
 
     emcmot_hal_data->overruns = 0;
     emcmot_hal_data->last_period = 0;
+    for (n = 0; n < EMCMOT_NUM_PHASES; n++) {
+        emcmot_hal_data->timing_last[n] = 0;
+        emcmot_hal_data->timing_max[n] = 0;
+    }
+    emcmot_hal_data->fk_epsilon = -1.0;
+    emcmot_hal_data->fk_cache_hits = 0;
 
     /* export joint pins and parameters */
     for (n = 0; n < num_joints; n++) {
@@ -562,6 +641,7 @@ static int export_joint(int num, joint_hal_t * addr)
     if ((retval = hal_pin_float_newf(HAL_IN, &(addr->jog_scale), mot_comp_id, "joint.%d.jog-scale", num)) != 0) return retval;
     if ((retval = hal_pin_bit_newf(HAL_IN, &(addr->jog_vel_mode), mot_comp_id, "joint.%d.jog-vel-mode", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->joint_vel_cmd), mot_comp_id, "joint.%d.vel-cmd", num)) != 0) return retval;
+    if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->joint_acc_cmd), mot_comp_id, "joint.%d.acc-cmd", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->backlash_corr), mot_comp_id, "joint.%d.backlash-corr", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->backlash_filt), mot_comp_id, "joint.%d.backlash-filt", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->backlash_vel), mot_comp_id, "joint.%d.backlash-vel", num)) != 0) return retval;
@@ -587,6 +667,9 @@ static int export_joint(int num, joint_hal_t * addr)
     if ((retval = hal_pin_s32_newf(HAL_OUT, &(addr->risc_probe_type), mot_comp_id, "joint.%d.risc-probe-type", num)) != 0) return retval;
     if ((retval = hal_pin_s32_newf(HAL_IN, &(addr->home_sw_id), mot_comp_id, "joint.%d.home-sw-id", num)) != 0) return retval;
     if ((retval = hal_pin_s32_newf(HAL_OUT, &(addr->home_state_pin), mot_comp_id, "joint.%d.home-state", num)) != 0) return retval;
+    if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->home_time[HOME_TIME_SEARCH]), mot_comp_id, "joint.%d.home-search-time", num)) != 0) return retval;
+    if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->home_time[HOME_TIME_LATCH]), mot_comp_id, "joint.%d.home-latch-time", num)) != 0) return retval;
+    if ((retval = hal_pin_float_newf(HAL_OUT, &(addr->home_time[HOME_TIME_FINAL]), mot_comp_id, "joint.%d.home-final-time", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_IN, &(addr->index_pos_pin), mot_comp_id, "joint.%d.index-pos", num)) != 0) return retval;
     if ((retval = hal_pin_bit_newf(HAL_IN, &(addr->usb_ferror_flag), mot_comp_id, "joint.%d.usb-ferror-flag", num)) != 0) return retval;
     if ((retval = hal_pin_float_newf(HAL_IN, &(addr->risc_pos_cmd), mot_comp_id, "joint.%d.risc-pos-cmd", num)) != 0) return retval;
@@ -609,6 +692,7 @@ static int init_comm_buffers(void)
 {
     int joint_num, n;
     emcmot_joint_t *joint;
+    TC_STRUCT *tc_space;
     int retval;
 
     rtapi_print_msg(RTAPI_MSG_INFO, "MOTION: init_comm_buffers() starting...\n");
@@ -617,6 +701,8 @@ static int init_comm_buffers(void)
     emcmotDebug = 0;
     emcmotStatus = 0;
     emcmotCommand = 0;
+    emcmotCommandRing = 0;
+    emcmotStatusPub = 0;
     emcmotConfig = 0;
 
     /* allocate and initialize the shared memory structure */
@@ -638,7 +724,9 @@ static int init_comm_buffers(void)
 
     /* we'll reference emcmotStruct directly */
     emcmotCommand = &emcmotStruct->command;
+    emcmotCommandRing = &emcmotStruct->command_ring;
     emcmotStatus = &emcmotStruct->status;
+    emcmotStatusPub = &emcmotStruct->status_pub;
     emcmotConfig = &emcmotStruct->config;
     emcmotDebug = &emcmotStruct->debug;
     emcmotError = &emcmotStruct->error;
@@ -652,6 +740,8 @@ static int init_comm_buffers(void)
     emcmotCommand->commandNum = 0;
     emcmotCommand->tail = 0;
     emcmotCommand->spindlesync = 0.0;
+    emcmotCommandRing->head = 0;
+    emcmotCommandRing->tail = 0;
 
     /* init status struct */
     emcmotStatus->head = 0;
@@ -699,6 +789,13 @@ static int init_comm_buffers(void)
 
     emcmot_config_change();
 
+    if (traj_interp_order != 3 && traj_interp_order != 5) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+                "MOTION: traj_interp_order must be 3 or 5, not %d\n",
+                traj_interp_order);
+        return -1;
+    }
+
     /* init pointer to joint structs */
 #ifdef STRUCTS_IN_SHMEM
     joints = &(emcmotDebug->joints[0]);
@@ -709,7 +806,7 @@ static int init_comm_buffers(void)
 #endif
 
     /* init per-joint stuff */
-    for (joint_num = 0; joint_num < emcmotConfig->numJoints; joint_num++) {
+    for (joint_num = 0; joint_num < NUM_JOINTS; joint_num++) {
         /* point to structure for this joint */
         joint = &joints[joint_num];
 
@@ -734,6 +831,8 @@ static int init_comm_buffers(void)
 
         joint->comp.entries = 0;
         joint->comp.entry = &(joint->comp.array[0]);
+        joint->comp.step = 0.0;
+        joint->comp_2d.other = -1;
         /* the compensation code has -DBL_MAX at one end of the table
 	   and +DBL_MAX at the other so _all_ commanded positions are
 	   guaranteed to be covered by the table */
@@ -760,6 +859,7 @@ static int init_comm_buffers(void)
         joint->pos_cmd = 0.0;
         joint->vel_cmd = 0.0;
         joint->backlash_corr = 0.0;
+        joint->comp_2d_corr = 0.0;
         joint->backlash_filt = 0.0;
         joint->backlash_vel = 0.0;
         joint->motor_pos_cmd = 0.0;
@@ -777,6 +877,7 @@ static int init_comm_buffers(void)
 
         /* init internal info */
         cubicInit(&(joint->cubic));
+        cubicSetOrder(&(joint->cubic), traj_interp_order);
     }
 
     /*! \todo FIXME-- add emcmotError */
@@ -785,14 +886,90 @@ static int init_comm_buffers(void)
     emcmotDebug->start_time = etime();
     emcmotDebug->running_time = 0.0;
 
+    /* the motion queue gets shmem of its own, sized at insmod time */
+    if (tc_queue_size <= TC_QUEUE_MARGIN) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+                "MOTION: tc_queue_size must be more than %d, not %d\n",
+                TC_QUEUE_MARGIN, tc_queue_size);
+        return -1;
+    }
+    tc_shmem_id = rtapi_shmem_new(TC_QUEUE_SHMEM_KEY, mot_comp_id,
+                                  tc_queue_size * sizeof(TC_STRUCT));
+    if (tc_shmem_id < 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+                "MOTION: rtapi_shmem_new failed for the motion queue, returned %d\n",
+                tc_shmem_id);
+        return -1;
+    }
+    retval = rtapi_shmem_getptr(tc_shmem_id, (void **) &tc_space);
+    if (retval < 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+                "MOTION: rtapi_shmem_getptr failed, returned %d\n", retval);
+        return -1;
+    }
+    TC_QUEUE_SIZE = tc_queue_size;
+    emcmotConfig->tcQueueSize = tc_queue_size;
+
     /* init motion emcmotDebug->coord_tp */
-    if (-1 == tpCreate(&emcmotDebug->coord_tp, DEFAULT_TC_QUEUE_SIZE,
-            emcmotDebug->queueTcSpace)) {
+    if (-1 == tpCreate(&emcmotDebug->coord_tp, tc_queue_size, tc_space)) {
         rtapi_print_msg(RTAPI_MSG_ERR,
                 "MOTION: failed to create motion emcmotDebug->coord_tp\n");
         return -1;
     }
     //    tpInit(&emcmotDebug->coord_tp); // tpInit called from tpCreate
+
+    /* each queued NURBS segment gets its own slice of this pool */
+    if (nurbs_pool_size > 0) {
+        double *nurbs_pool;
+        int nurbs_pool_doubles =
+            nurbs_pool_size * (sizeof(CONTROL_POINT) / sizeof(double) + 1);
+
+        nurbs_shmem_id = rtapi_shmem_new(NURBS_POOL_SHMEM_KEY, mot_comp_id,
+                                         nurbs_pool_doubles * sizeof(double));
+        if (nurbs_shmem_id < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    "MOTION: rtapi_shmem_new failed for the NURBS pool, returned %d\n",
+                    nurbs_shmem_id);
+            return -1;
+        }
+        retval = rtapi_shmem_getptr(nurbs_shmem_id, (void **) &nurbs_pool);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    "MOTION: rtapi_shmem_getptr failed, returned %d\n", retval);
+            return -1;
+        }
+        tpSetNurbsPool(&emcmotDebug->coord_tp, nurbs_pool, nurbs_pool_doubles);
+    }
+    /* the event trace gets shmem of its own too, so motrace can find it */
+    if (trace_size > 0) {
+        unsigned int size = 1;
+
+        while (size < (unsigned int) trace_size) {
+            size <<= 1;
+        }
+        trace_shmem_id = rtapi_shmem_new(MOT_TRACE_SHMEM_KEY, mot_comp_id,
+                                         MOT_TRACE_BYTES(size));
+        if (trace_shmem_id < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    "MOTION: rtapi_shmem_new failed for the event trace, returned %d\n",
+                    trace_shmem_id);
+            return -1;
+        }
+        retval = rtapi_shmem_getptr(trace_shmem_id, (void **) &emcmotTrace);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    "MOTION: rtapi_shmem_getptr failed, returned %d\n", retval);
+            return -1;
+        }
+        memset(emcmotTrace, 0, MOT_TRACE_BYTES(size));
+        for (n = 0; n < size; n++) {
+            emcmotTrace->rec[n].seq = MOT_TRACE_INVALID;
+        }
+        emcmotTrace->size = size;
+        emcmotTrace->mask = ~0u;
+        emcmotTrace->magic = MOT_TRACE_MAGIC;
+    }
+
     tpSetCycleTime(&emcmotDebug->coord_tp, emcmotConfig->trajCycleTime);
     tpSetPos(&emcmotDebug->coord_tp, emcmotStatus->carte_pos_cmd);
     tpSetVmax(&emcmotDebug->coord_tp, emcmotStatus->vel, emcmotStatus->vel);
@@ -811,7 +988,7 @@ static int init_threads(void)
 {
     double base_period_sec, servo_period_sec;
     int servo_base_ratio;
-    int retval;
+    int retval, n;
 
     rtapi_print_msg(RTAPI_MSG_INFO, "MOTION: init_threads() starting...\n");
 
@@ -838,7 +1015,8 @@ static int init_threads(void)
     /* create HAL threads for each period */
     /* only create base thread if it is faster than servo thread */
     if (servo_base_ratio > 1) {
-        retval = hal_create_thread("base-thread", base_period_nsec, 0);
+        retval = hal_create_thread_cpu("base-thread", base_period_nsec, 0,
+                base_thread_cpu);
         if (retval < 0) {
             rtapi_print_msg(RTAPI_MSG_ERR,
                     "MOTION: failed to create %ld nsec base thread\n",
@@ -846,13 +1024,23 @@ static int init_threads(void)
             return -1;
         }
     }
-    retval = hal_create_thread("servo-thread", servo_period_nsec, 1);
+    retval = hal_create_thread_cpu("servo-thread", servo_period_nsec, 1,
+            servo_thread_cpu);
     if (retval < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
                 "MOTION: failed to create %ld nsec servo thread\n",
                 servo_period_nsec);
         return -1;
     }
+    for (n = 0; n < 4 && servo_thread_helpers[n] != -1; n++) {
+        retval = hal_thread_add_worker("servo-thread", servo_thread_helpers[n]);
+        if (retval < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                    "MOTION: failed to add servo thread helper on CPU %d\n",
+                    servo_thread_helpers[n]);
+            return -1;
+        }
+    }
     /* export realtime functions that do the real work */
     retval = hal_export_funct("motion-controller", emcmotController, 0	/* arg
      */ , 1 /* uses_fp */ , 0 /* reentrant */ , mot_comp_id);
@@ -926,7 +1114,7 @@ static int setTrajCycleTime(double secs)
     tpSetCycleTime(&emcmotDebug->coord_tp, secs);
 
     /* set the free planners, cubic interpolation rate and segment time */
-    for (t = 0; t < emcmotConfig->numJoints; t++) {
+    for (t = 0; t < NUM_JOINTS; t++) {
         cubicSetInterpolationRate(&(joints[t].cubic),
                 emcmotConfig->interpolationRate);
     }
@@ -957,7 +1145,7 @@ static int setServoCycleTime(double secs)
             (int) (emcmotConfig->trajCycleTime / secs + 0.5);
 
     /* set the cubic interpolation rate and PID cycle time */
-    for (t = 0; t < emcmotConfig->numJoints; t++) {
+    for (t = 0; t < NUM_JOINTS; t++) {
         cubicSetInterpolationRate(&(joints[t].cubic),
                 emcmotConfig->interpolationRate);
         cubicSetSegmentTime(&(joints[t].cubic), secs);
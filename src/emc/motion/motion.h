@@ -153,10 +153,13 @@ typedef enum {
     EMCMOT_SET_ACC,		/* set the max accel for moves (tooltip) */
     EMCMOT_SET_JERK,	/* set the max jerk for moves (tooltip) */
     EMCMOT_SET_TERM_COND,	/* set termination condition (stop, blend) */
+    EMCMOT_SET_RAPID_TOLERANCE,	/* set the blend tolerance of traverses */
+    EMCMOT_SET_ARC_BLEND,	/* round G64 corners with arcs, or not */
     EMCMOT_SET_NUM_JOINTS,	/* set the number of joints */
     EMCMOT_SET_WORLD_HOME,	/* set pose for world home */
 
     EMCMOT_SET_DEBUG,       /* sets the debug level */
+    EMCMOT_RESET_TIMING,    /* clears the per phase max and histograms */
     EMCMOT_SET_DOUT,        /* sets or unsets a DIO, this can be imediate or synched with motion */
     EMCMOT_SET_AOUT,	/* sets or unsets a AIO, this can be imediate or synched with motion */
     EMCMOT_SET_SPINDLESYNC, /* syncronize motion to spindle encoder */
@@ -193,6 +196,7 @@ typedef enum {
     EMCMOT_SET_JOINT_HOMING_PARAMS, /* sets joint homing parameters */
     EMCMOT_SET_JOINT_MOTOR_OFFSET,  /* set the offset between joint and motor */
     EMCMOT_SET_JOINT_COMP,          /* set a compensation triplet for a joint (nominal, forw., rev.) */
+    EMCMOT_SET_JOINT_COMP_2D,       /* set the grid or one value of a joint's 2D compensation map */
 
     EMCMOT_SET_AXIS_POSITION_LIMITS, /* set the axis position +/- limits */
     EMCMOT_SET_AXIS_VEL_LIMIT,      /* set the max axis vel */
@@ -264,6 +268,10 @@ typedef struct emcmot_command_t {
     unsigned char now, out, start, end;	/* these are related to synched AOUT/DOUT. now=wether now or synched, out = which gets set, start=start value, end=end value */
     unsigned char mode;	/* used for turning overrides etc. on/off */
     double comp_nominal, comp_forward, comp_reverse; /* compensation triplet, nominal, forward, reverse */
+    int comp_other;		/* 2D comp: joint that picks the row of the map */
+    int comp_index;		/* 2D comp: value comp_forward goes to, -1 for the grid */
+    double comp_start[2], comp_step[2];	/* 2D comp grid along joint and comp_other */
+    int comp_count[2];
     unsigned char probe_type; /* ~1 = error if probe operation is unsuccessful (ngc default)
                                      |1 = suppress error, report in # instead
                                      ~2 = move until probe trips (ngc default)
@@ -277,6 +285,22 @@ typedef struct emcmot_command_t {
     int wait_type;          /* wait type for sync_in command */
 } emcmot_command_t;
 
+/* full memory barrier, for the lock-free structures shared between task
+   and motion */
+#define EMCMOT_MB() __sync_synchronize()
+
+/* Command ring.  Task is the only writer of head and motion the only
+   writer of tail; both only ever count up, and slot i % size holds the
+   i'th command.  Task fills the slot before it moves head past it, and
+   motion copies the slot out before it moves tail past it, so neither
+   side ever sees a half written command.  Motion works through all
+   commands in the ring each period. */
+typedef struct emcmot_command_ring_t {
+    volatile unsigned int head;	/* commands written by task */
+    volatile unsigned int tail;	/* commands taken by motion */
+    emcmot_command_t slot[EMCMOT_COMMAND_RING_SIZE];
+} emcmot_command_ring_t;
+
 /*! \todo FIXME - these packed bits might be replaced with chars
    memory is cheap, and being able to access them without those
    damn macros would be nice
@@ -415,10 +439,25 @@ typedef struct {
 typedef struct {
     int entries;		/* number of entries in the array */
     emcmot_comp_entry_t *entry;  /* current entry in array */
+    double step;		/* spacing of the entries if it is even, else 0 */
     emcmot_comp_entry_t array[EMCMOT_COMP_SIZE+2];
     /* +2 because array has -HUGE_VAL and +HUGE_VAL entries at the ends */
 } emcmot_comp_t;
 
+/* 2D compensation map: a correction for the joint as a function of its
+   own position and that of another joint ("X error as a function of X
+   and Y"), on an evenly spaced grid, interpolated bilinearly and held at
+   the edge values outside the grid.  It adds to the screw or backlash
+   comp. */
+#define EMCMOT_COMP_2D_SIZE 1024
+typedef struct {
+    int other;			/* joint that picks the row, -1 for no map */
+    int count[2];		/* grid points along this joint and other */
+    double start[2];		/* position of the first grid point */
+    double step_inv[2];		/* grid points per unit */
+    float corr[EMCMOT_COMP_2D_SIZE];	/* row by row, count[0] per row */
+} emcmot_comp_2d_t;
+
 /* motion controller states */
 
 typedef enum {
@@ -478,6 +517,12 @@ typedef enum {
 #define HOME_USE_INDEX		2
 #define HOME_IS_SHARED		4
 #define HOME_UNLOCK_FIRST       8
+#define HOME_OVERLAP		16	/* may start when the previous group has latched */
+
+/* parts of the homing sequence timed in emcmot_joint_t.home_time */
+#define HOME_TIME_SEARCH	0
+#define HOME_TIME_LATCH		1
+#define HOME_TIME_FINAL		2
 
 /* flags for enabling spindle scaling, feed scaling,
    adaptive feed, and feed hold */
@@ -520,6 +565,7 @@ typedef struct {
     double backlash;	/* amount of backlash */
     int home_sequence;      /* Order in homing sequence */
     emcmot_comp_t comp;	/* leadscrew correction data */
+    emcmot_comp_2d_t comp_2d;	/* 2D correction map */
 
     /* status info - changes regularly */
     /* many of these need to be made available to higher levels */
@@ -530,6 +576,7 @@ typedef struct {
     double pos_cmd;		/* commanded joint position */
     double vel_cmd;		/* comanded joint velocity */
     double backlash_corr;	/* correction for backlash */
+    double comp_2d_corr;	/* correction from the 2D map */
     double backlash_filt;	/* filtered backlash correction */
     double backlash_vel;	/* backlash velocity variable */
     double motor_pos_cmd;	/* commanded position, with comp */
@@ -553,6 +600,8 @@ typedef struct {
     int on_neg_limit;			/* non-zero if on limit */
     double home_sw_pos;			/* latched position of home sw */
     int home_pause_timer;		/* used to delay between homing states */
+    double home_time[3];		/* secs spent in each HOME_TIME_* part of
+					   the last homing */
     int index_enable;			/* current state of index enable pin */
 
     home_state_t home_state;	/* state machine for homing */
@@ -700,6 +749,9 @@ typedef struct emcmot_status_t {
     int spindle_index_enable;  /* hooked to a canon encoder index-enable */
     int spindleSync;        /* we are doing spindle-synced motion */
     double spindleRevs;     /* position of spindle in revolutions */
+    double spindleRevsLead; /* spindleRevs extrapolated motion.spindle-lead-time
+                               ahead, what spindle synced moves follow */
+    double spindleRevsVel;  /* estimated spindle velocity, revs per sec */
     double spindleSpeedIn;  /* velocity of spindle in revolutions per minute */
 
     spindle_status spindle;	/* data types for spindle status */
@@ -718,6 +770,7 @@ typedef struct emcmot_status_t {
     int id;			/* id for executing motion */
     int depth;		/* motion queue depth */
     int activeDepth;	/* depth of active blend elements */
+    double queueTime;	/* seconds of motion queued, at requested vel */
     int queueFull;		/* Flag to indicate the tc queue is full */
     int paused;		/* Flag to signal motion paused */
     int overrideLimitMask;	/* non-zero means one or more limits ignored */
@@ -743,6 +796,17 @@ typedef struct emcmot_status_t {
 
 } emcmot_status_t;
 
+/* Published status.  Motion works on its own copy of the status during
+   a period and publishes it once at the end, into the buffer readers are
+   not looking at: snapshot number seq is in snap[seq % 2], and seq
+   only moves on after the snapshot is complete.  A reader copies
+   snap[seq % 2] and keeps the copy if seq is still the same afterwards,
+   which is only not the case if a whole period passed during the copy. */
+typedef struct emcmot_status_pub_t {
+    volatile unsigned int seq;	/* snapshots published */
+    emcmot_status_t snap[2];
+} emcmot_status_pub_t;
+
 /*********************************
         CONFIG STRUCTURE
  *********************************/
@@ -782,6 +846,8 @@ typedef struct emcmot_config_t {
     int numAIO;             /* userdefined number of analog IO. default is 4. (EMCMOT_MAX_AIO=16),
                                    but can be altered at motmod insmod time */
     int numSyncIn;
+    int tcQueueSize;        /* segments in the coordinated motion queue,
+                                   set with tc_queue_size at insmod time */
 
     /*! \todo FIXME - all structure members beyond this point are in limbo */
 
@@ -808,6 +874,17 @@ typedef struct emcmot_error_t {
     unsigned char tail;	/* flag count for mutex detect */
 } emcmot_error_t;
 
+/* NURBS arena - task copies the control points, knots and arc length
+   table of a whole NURBS curve in here in one go, and EMCMOT_SET_NURBS only carries the
+   offsets and lengths of the block (see nurbs_block_t).  Motion copies
+   the curve out while handling the command, so task may reuse the space
+   as soon as the command has been echoed. */
+typedef struct emcmot_nurbs_arena_t {
+    CONTROL_POINT ctrl_pts[EMCMOT_NURBS_ARENA_SIZE];
+    double knots[EMCMOT_NURBS_ARENA_SIZE];
+    double arclen[EMCMOT_NURBS_ARENA_SIZE];
+} emcmot_nurbs_arena_t;
+
 /*
   function prototypes for emcmot code
  */
@@ -36,10 +36,45 @@
    evaluated - either they move up, or they go away.
 */
 
+/* phases of emcmotController(), timed separately so a servo overrun
+   can be pinned on the one that grew.  The names are exported as
+   motion.timing.<name>.last and .max. */
+    enum emcmot_phase {
+	EMCMOT_PHASE_INPUTS,	/* process_inputs() */
+	EMCMOT_PHASE_FORWARD_KINS,	/* do_forward_kins() */
+	EMCMOT_PHASE_PROBE,	/* process_probe_inputs(), handle_special_cmd() */
+	EMCMOT_PHASE_FAULTS,	/* check_for_faults() */
+	EMCMOT_PHASE_MODE,	/* set_operating_mode() */
+	EMCMOT_PHASE_JOGWHEELS,	/* handle_jogwheels() */
+	EMCMOT_PHASE_HOMING,	/* do_homing_sequence(), do_homing() */
+	EMCMOT_PHASE_POS_CMDS,	/* get_pos_cmds() */
+	EMCMOT_PHASE_SCREW_COMP,	/* compute_screw_comp() */
+	EMCMOT_PHASE_OUTPUT,	/* output_to_hal() */
+	EMCMOT_PHASE_STATUS,	/* update_status() */
+	EMCMOT_NUM_PHASES
+    };
+
+#define EMCMOT_PHASE_NAMES \
+    { "inputs", "forward-kins", "probe", "faults", "mode", "jogwheels", \
+      "homing", "pos-cmds", "screw-comp", "output", "status" }
+
+/* histogram bin n counts the runs that took 2^n to 2^(n+1)-1 clocks */
+#define EMCMOT_TIMING_BINS 32
+
+    typedef struct {
+	unsigned int last;	/* clocks taken by the last run */
+	unsigned int max;	/* most clocks taken since the last reset */
+	unsigned int hist[EMCMOT_TIMING_BINS];
+    } emcmot_phase_timing_t;
+
 /*! \todo FIXME - this has become a dumping ground for all kinds of stuff */
 
     typedef struct emcmot_debug_t {
 	unsigned char head;	/* flag count for mutex detect */
+	/* sequence lock: odd while the command handler or the controller
+	   is running, readers retry if it is odd or changed across their
+	   copy.  Too big to double buffer like the status. */
+	volatile unsigned int seq;
 
 /*! \todo FIXME - all structure members beyond this point are in limbo */
 
@@ -53,6 +88,8 @@
 	double fyMin, fyMax, fyAvg;	/* min, max, avg times frequency
 					   cycle times rather than compute */
 
+	emcmot_phase_timing_t timing[EMCMOT_NUM_PHASES];
+
 	EMC_TELEOP_DATA teleop_data;
 	int split;		/* number of split command reads */
 	/* flag for enabling, disabling watchdog; multiple for down-stepping */
@@ -67,10 +104,6 @@
 
 	TP_STRUCT coord_tp;	/* coordinated mode planner */
 
-/* space for trajectory planner queues, plus 10 more for safety */
-/*! \todo FIXME-- default is used; dynamic is not honored */
-	TC_STRUCT queueTcSpace[DEFAULT_TC_QUEUE_SIZE + 10];
-
 	int enabling;		/* starts up disabled */
 	int coordinating;	/* starts up in free mode */
 	int teleoperating;	/* starts up in free mode */
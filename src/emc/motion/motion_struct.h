@@ -14,13 +14,19 @@
 
 /* big comm structure, for upper memory */
     typedef struct emcmot_struct_t {
-	struct emcmot_command_t command;	/* struct used to pass commands/data
+	struct emcmot_command_t command;	/* the command motion is
+					   handling, copied out of the ring */
+	struct emcmot_command_ring_t command_ring; /* commands/data passed
 					   to the RT module from usr space */
 	struct emcmot_status_t status;	/* Struct used to store RT status */
+	struct emcmot_status_pub_t status_pub; /* status as published to
+					   usr space at the end of a period */
 	struct emcmot_config_t config;	/* Struct used to store RT config */
 	struct emcmot_error_t error;	/* ring buffer for error messages */
 	struct emcmot_debug_t debug;	/* Struct used to store RT status and debug
 				   data - 2nd largest block */
+	struct emcmot_nurbs_arena_t nurbs_arena; /* bulk NURBS curve data
+				   for EMCMOT_SET_NURBS - largest block */
     } emcmot_struct_t;
 
 
@@ -0,0 +1,194 @@
+/********************************************************************
+* Description: motrace.c
+*   Dumps the motion controller's event trace (see mottrace.h)
+*
+*   syntax: motrace [-f] [-n count] [-e event[,event...]]
+*
+*   Prints the last count records still in the ring (all of them by
+*   default), one per line, then exits, or with -f keeps printing new
+*   ones as they come.  -e changes which events motion records from
+*   now on; "all" records everything.  TICK lines also get the path
+*   speed and acceleration worked out from the positions and times of
+*   consecutive ticks.
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <math.h>
+#include "rtapi.h"
+#include "emcmotcfg.h"		/* MOT_TRACE_SHMEM_KEY */
+#include "mottrace.h"
+
+static const char *event_names[MOT_TRACE_NEVENTS] = {
+    0, "TICK", "STATE", "SEGMENT", "FERROR", "KINS", "OVERRUN", "ABORT"
+};
+
+static int comp_id;
+static int shmem_id = -1;
+static volatile int done;
+
+static void quit(int sig)
+{
+    done = 1;
+}
+
+static int parse_events(char *list, unsigned int *mask)
+{
+    char *name;
+    int n;
+
+    *mask = 0;
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+	if (strcasecmp(name, "all") == 0) {
+	    *mask = ~0u;
+	    continue;
+	}
+	for (n = 1; n < MOT_TRACE_NEVENTS; n++) {
+	    if (strcasecmp(name, event_names[n]) == 0) {
+		break;
+	    }
+	}
+	if (n == MOT_TRACE_NEVENTS) {
+	    fprintf(stderr, "motrace: unknown event '%s'\n", name);
+	    return -1;
+	}
+	*mask |= 1u << n;
+    }
+    return 0;
+}
+
+/* map the trace: first the header, to learn its size, then all of it */
+static mot_trace_t *open_trace(void)
+{
+    mot_trace_t *t;
+    unsigned int size;
+
+    shmem_id = rtapi_shmem_new(MOT_TRACE_SHMEM_KEY, comp_id, sizeof(mot_trace_t));
+    if (shmem_id < 0 || rtapi_shmem_getptr(shmem_id, (void **) &t) < 0) {
+	return 0;
+    }
+    if (t->magic != MOT_TRACE_MAGIC) {
+	return 0;
+    }
+    size = t->size;
+    rtapi_shmem_delete(shmem_id, comp_id);
+    shmem_id = rtapi_shmem_new(MOT_TRACE_SHMEM_KEY, comp_id, MOT_TRACE_BYTES(size));
+    if (shmem_id < 0 || rtapi_shmem_getptr(shmem_id, (void **) &t) < 0) {
+	return 0;
+    }
+    return t;
+}
+
+static void print_rec(const mot_trace_rec_t * r)
+{
+    static mot_trace_rec_t last_tick;
+    static double last_vel;
+    static int have_tick;
+    double dt, vel, acc;
+    const char *name = "?";
+
+    if (r->event > 0 && r->event < MOT_TRACE_NEVENTS) {
+	name = event_names[r->event];
+    }
+    printf("%u %.6f %s %d %.6g %.6g %.6g %.6g", r->seq, r->time * 1e-9,
+	name, r->id, r->v[0], r->v[1], r->v[2], r->v[3]);
+    if (r->event == MOT_TRACE_TICK) {
+	dt = (r->time - last_tick.time) * 1e-9;
+	if (have_tick && dt > 0) {
+	    vel = sqrt((r->v[0] - last_tick.v[0]) * (r->v[0] - last_tick.v[0])
+		+ (r->v[1] - last_tick.v[1]) * (r->v[1] - last_tick.v[1])
+		+ (r->v[2] - last_tick.v[2]) * (r->v[2] - last_tick.v[2])) / dt;
+	    acc = have_tick > 1 ? (vel - last_vel) / dt : 0;
+	    printf(" vel %.6g acc %.6g", vel, acc);
+	    last_vel = vel;
+	    have_tick++;
+	} else {
+	    have_tick = 1;
+	}
+	last_tick = *r;
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    mot_trace_t *t;
+    mot_trace_rec_t r;
+    unsigned int next, head, mask = 0;
+    int follow = 0, count = -1, set_mask = 0, c;
+
+    while ((c = getopt(argc, argv, "fn:e:")) != -1) {
+	switch (c) {
+	case 'f':
+	    follow = 1;
+	    break;
+	case 'n':
+	    count = atoi(optarg);
+	    break;
+	case 'e':
+	    if (parse_events(optarg, &mask) < 0) {
+		return 1;
+	    }
+	    set_mask = 1;
+	    break;
+	default:
+	    fprintf(stderr,
+		"syntax: %s [-f] [-n count] [-e event[,event...]]\n", argv[0]);
+	    return 1;
+	}
+    }
+
+    comp_id = rtapi_init("motrace");
+    if (comp_id < 0) {
+	fprintf(stderr, "motrace: rtapi_init() failed\n");
+	return 1;
+    }
+    t = open_trace();
+    if (t == 0) {
+	fprintf(stderr, "motrace: no motion trace; is motmod loaded with trace_size > 0?\n");
+	if (shmem_id >= 0) {
+	    rtapi_shmem_delete(shmem_id, comp_id);
+	}
+	rtapi_exit(comp_id);
+	return 1;
+    }
+    if (set_mask) {
+	t->mask = mask;
+    }
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+
+    head = t->head;
+    next = head - (head < t->size ? head : t->size);
+    if (count >= 0 && head - next > (unsigned int) count) {
+	next = head - count;
+    }
+    do {
+	for (head = t->head; next != head; next++) {
+	    if (head - next > t->size) {
+		/* fell behind, skip what was overwritten */
+		printf("# %u records lost\n", head - t->size - next);
+		next = head - t->size;
+	    }
+	    if (motTraceRead(t, next, &r) == 0) {
+		print_rec(&r);
+	    }
+	}
+	fflush(stdout);
+	if (follow) {
+	    usleep(10000);
+	}
+    } while (follow && !done);
+
+    rtapi_shmem_delete(shmem_id, comp_id);
+    rtapi_exit(comp_id);
+    return 0;
+}
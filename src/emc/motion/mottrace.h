@@ -0,0 +1,109 @@
+/********************************************************************
+* Description: mottrace.h
+*   Binary event trace of the motion controller, kept in a ring in
+*   shared memory so it can be read after the fact with motrace
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+#ifndef MOTTRACE_H
+#define MOTTRACE_H
+
+/* The ring is a flight recorder: the servo thread writes fixed size
+   records into it without ever waiting, overwriting the oldest ones,
+   and readers copy out whatever is still there.  There is one producer
+   per ring, so the only synchronization is a per record sequence
+   number, used like a seqlock: the writer sets it to
+   MOT_TRACE_INVALID, fills in the record, then sets it to the record's
+   number and advances head.  A reader takes a record only if it reads
+   the same, expected, sequence number before and after copying it.
+
+   The record layout is shared with userspace, so it doesn't contain
+   any pointers. */
+
+#define MOT_TRACE_MAGIC 0x4d545243	/* "MTRC" */
+#define MOT_TRACE_INVALID 0xffffffffu
+
+/* event ids; motrace prints these names */
+enum mot_trace_event {
+    MOT_TRACE_TICK = 1,		/* tp cycle: id = motion id, x y z, vel */
+    MOT_TRACE_STATE,		/* motion state: old, new */
+    MOT_TRACE_SEGMENT,		/* new active segment: id, target, reqvel */
+    MOT_TRACE_FERROR,		/* joint id: pos_cmd, pos_fb, ferror, limit */
+    MOT_TRACE_KINS,		/* inverse kins failed: id, x y z */
+    MOT_TRACE_OVERRUN,		/* late servo cycle: clocks, usual clocks */
+    MOT_TRACE_ABORT,		/* abort command: id */
+    MOT_TRACE_NEVENTS
+};
+
+typedef struct {
+    long long time;		/* rtapi_get_time(), nsecs */
+    volatile unsigned int seq;	/* record number, or MOT_TRACE_INVALID */
+    unsigned short event;	/* enum mot_trace_event */
+    unsigned short pad;
+    int id;			/* segment, joint, ... depending on event */
+    int pad2;
+    double v[4];
+} mot_trace_rec_t;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int size;		/* records, a power of two */
+    volatile unsigned int head;	/* records written so far */
+    volatile unsigned int mask;	/* 1 << event for each event recorded */
+    mot_trace_rec_t rec[1];	/* really rec[size] */
+} mot_trace_t;
+
+#define MOT_TRACE_BYTES(size) \
+    (sizeof(mot_trace_t) + ((size) - 1) * sizeof(mot_trace_rec_t))
+
+#ifdef RTAPI
+
+static inline void motTrace(mot_trace_t * t, int event, int id,
+			    double v0, double v1, double v2, double v3)
+{
+    mot_trace_rec_t *r;
+    unsigned int h;
+
+    if (t == 0 || !(t->mask & (1u << event))) {
+	return;
+    }
+    h = t->head;
+    r = &t->rec[h & (t->size - 1)];
+    r->seq = MOT_TRACE_INVALID;
+    __sync_synchronize();
+    r->time = rtapi_get_time();
+    r->event = event;
+    r->id = id;
+    r->v[0] = v0;
+    r->v[1] = v1;
+    r->v[2] = v2;
+    r->v[3] = v3;
+    __sync_synchronize();
+    r->seq = h;
+    t->head = h + 1;
+}
+
+#else
+
+/* copy record n out of the ring; returns 0 if it is still there */
+static inline int motTraceRead(const mot_trace_t * t, unsigned int n,
+			       mot_trace_rec_t * out)
+{
+    const mot_trace_rec_t *r = &t->rec[n & (t->size - 1)];
+    unsigned int seq = r->seq;
+
+    if (seq != n) {
+	return -1;
+    }
+    __sync_synchronize();
+    *out = *r;
+    __sync_synchronize();
+    return r->seq == n ? 0 : -1;
+}
+
+#endif
+
+#endif /* MOTTRACE_H */
@@ -26,10 +26,152 @@
 #include "rtapi_math.h"
 #include "posemath.h"
 
+/* advance p, v, a by t at jerk j */
+static void jerk_move(double *p, double *v, double *a, double j, double t)
+{
+    *p += (*v + (0.5 * *a + j * t / 6.0) * t) * t;
+    *v += (*a + 0.5 * j * t) * t;
+    *a += j * t;
+}
+
+/* how much further than p it goes from vel v and accel a before it
+   can be brought to rest, braking at up to max_acc; zero if it is
+   already on its way back */
+static double jerk_stop_dist(double v, double a, double max_acc, double max_jerk)
+{
+    double p = 0, ap, t;
+
+    if (v + 0.5 * a * fabs(a) / max_jerk <= 0) {
+        if (v <= 0) {
+            return 0;
+        }
+        /* releasing the decel in hand stops it: find where */
+        t = (-a - sqrt(a * a - 2.0 * max_jerk * v)) / max_jerk;
+        jerk_move(&p, &v, &a, max_jerk, t);
+        return p;
+    }
+    /* peak decel of a profile that ends at zero vel and zero accel */
+    ap = sqrt(max_jerk * v + 0.5 * a * a);
+    if (ap > max_acc) {
+        ap = max_acc;
+    }
+    t = (a + ap) / max_jerk;
+    if (t > 0) {
+        jerk_move(&p, &v, &a, -max_jerk, t);
+    }
+    t = (v - 0.5 * ap * ap / max_jerk) / ap;
+    if (t > 0) {
+        jerk_move(&p, &v, &a, 0, t);
+    }
+    jerk_move(&p, &v, &a, max_jerk, -a / max_jerk);
+    return p;
+}
+
+/* accel for the next period that takes vel toward vel_req */
+static double jerk_vel_acc(simple_tp_t *tp, double vel_req, double period)
+{
+    double max_da = tp->max_jerk * period;
+    double dv, acc;
+
+    /* releasing the accel in hand changes vel by a|a|/2j */
+    dv = vel_req - tp->curr_vel
+        - 0.5 * tp->curr_acc * fabs(tp->curr_acc) / tp->max_jerk;
+    acc = dv < 0 ? -sqrt(-2.0 * tp->max_jerk * dv) : sqrt(2.0 * tp->max_jerk * dv);
+    if (acc > tp->max_acc) {
+        acc = tp->max_acc;
+    } else if (acc < -tp->max_acc) {
+        acc = -tp->max_acc;
+    }
+    if (acc > tp->curr_acc + max_da) {
+        acc = tp->curr_acc + max_da;
+    } else if (acc < tp->curr_acc - max_da) {
+        acc = tp->curr_acc - max_da;
+    }
+    return acc;
+}
+
+/* true if, going to accel acc over the next period, it can still stop
+   within dist, all in the direction of the target */
+static int jerk_can_stop(simple_tp_t *tp, double s, double acc, double dist,
+                         double period)
+{
+    double p = 0, v = s * tp->curr_vel, a = s * tp->curr_acc;
+
+    jerk_move(&p, &v, &a, (s * acc - a) / period, period);
+    return p + jerk_stop_dist(v, a, tp->max_acc, tp->max_jerk) <= dist;
+}
+
+/* The jerk limited planner.  Each period it looks for the accel that
+   gets it toward pos_cmd soonest, at up to max_vel, while it can still
+   stop at pos_cmd from where that leaves it; a target that moves, like
+   a jogwheel's, is simply planned for afresh.  The braking model is the
+   one the coordinated planner uses (see tcStopDist() in tc.c): ramp the
+   decel at max_jerk, hold it at max_acc if it gets there, then ramp it
+   back to zero as the velocity reaches zero. */
+static void simple_tp_update_jerk(simple_tp_t *tp, double period)
+{
+    double max_da, tiny_dp, pos_err, s, acc, lo, hi, mid, vel;
+    int n;
+
+    max_da = tp->max_jerk * period;
+    /* what one period of jerk moves it from rest */
+    tiny_dp = max_da * period * period / 6.0;
+    tp->active = 0;
+    if (!tp->enable) {
+        tp->pos_cmd = tp->curr_pos;
+    }
+    pos_err = tp->pos_cmd - tp->curr_pos;
+    if (fabs(pos_err) <= tiny_dp && fabs(tp->curr_vel) <= max_da * period
+        && fabs(tp->curr_acc) <= max_da) {
+        /* close enough, stop right there */
+        tp->curr_pos = tp->pos_cmd;
+        tp->curr_vel = 0.0;
+        tp->curr_acc = 0.0;
+        return;
+    }
+    if (!tp->enable) {
+        acc = jerk_vel_acc(tp, 0.0, period);
+    } else {
+        s = pos_err < 0 ? -1.0 : 1.0;
+        acc = jerk_vel_acc(tp, s * tp->max_vel, period);
+        if (!jerk_can_stop(tp, s, acc, s * pos_err, period)) {
+            /* brake, as little as will do */
+            lo = tp->curr_acc - s * max_da;
+            if (s * lo < -tp->max_acc) {
+                lo = -s * tp->max_acc;
+            }
+            hi = acc;
+            for (n = 0; n < 20 && jerk_can_stop(tp, s, lo, s * pos_err, period); n++) {
+                mid = 0.5 * (lo + hi);
+                if (jerk_can_stop(tp, s, mid, s * pos_err, period)) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            acc = lo;
+        }
+        tp->active = 1;
+    }
+    /* accel is linear over the period */
+    vel = tp->curr_vel + 0.5 * (tp->curr_acc + acc) * period;
+    tp->curr_pos += (tp->curr_vel + (tp->curr_acc / 3.0 + acc / 6.0) * period) * period;
+    tp->curr_vel = vel;
+    tp->curr_acc = acc;
+    if (tp->curr_vel != 0.0 || tp->curr_acc != 0.0) {
+        tp->active = 1;
+    }
+}
+
 void simple_tp_update(simple_tp_t *tp, double period)
 {
     double max_dv, tiny_dp, pos_err, vel_req;
 
+    if (tp->max_jerk > 0.0 && tp->max_acc > 0.0) {
+        simple_tp_update_jerk(tp, period);
+        return;
+    }
+
     tp->active = 0;
     /* compute max change in velocity per servo period */
     max_dv = tp->max_acc * period;
@@ -73,9 +215,12 @@ void simple_tp_update(simple_tp_t *tp, double period)
     /* ramp velocity toward request at accel limit */
     if (vel_req > tp->curr_vel + max_dv) {
         tp->curr_vel += max_dv;
+        tp->curr_acc = tp->max_acc;
     } else if (vel_req < tp->curr_vel - max_dv) {
         tp->curr_vel -= max_dv;
+        tp->curr_acc = -tp->max_acc;
     } else {
+        tp->curr_acc = (vel_req - tp->curr_vel) / period;
         tp->curr_vel = vel_req;
     }
     /* check for still moving */
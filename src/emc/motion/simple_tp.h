@@ -49,6 +49,9 @@ extern "C" {
    ramps the velocity to zero, then clears 'active' and sets
    'pos_cmd' to match 'curr_pos', to avoid motion the next time it
    is enabled.  'period' is the period between calls, in seconds.
+   If 'max_jerk' is non-zero, the acceleration is ramped at no more
+   than 'max_jerk' too, and 'curr_acc' tracks it; otherwise the
+   profile is trapezoidal, as it always used to be.
 */
 
 extern void simple_tp_update(simple_tp_t *tp, double period);
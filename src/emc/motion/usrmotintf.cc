@@ -39,12 +39,13 @@
 
 static int inited = 0;		/* flag if inited */
 
-static emcmot_command_t *emcmotCommand = 0;
-static emcmot_status_t *emcmotStatus = 0;
+static emcmot_command_ring_t *emcmotCommandRing = 0;
+static emcmot_status_pub_t *emcmotStatusPub = 0;
 static emcmot_config_t *emcmotConfig = 0;
 static emcmot_debug_t *emcmotDebug = 0;
 static emcmot_error_t *emcmotError = 0;
 static emcmot_struct_t *emcmotStruct = 0;
+static emcmot_nurbs_arena_t *emcmotNurbsArena = 0;
 
 /* usrmotIniLoad() loads params (SHMEM_KEY, COMM_TIMEOUT, COMM_WAIT)
    from named ini file */
@@ -72,12 +73,29 @@ int usrmotIniLoad(const char *filename)
     return 0;
 }
 
+/* queued moves are posted to the ring without waiting for motion to take
+   them; motion reports errors on those through the error ring and the
+   motion error flag.  Everything else waits for its echo. */
+static int usrmotCommandPosted(cmd_code_t command)
+{
+    switch (command) {
+    case EMCMOT_SET_LINE:
+    case EMCMOT_SET_CIRCLE:
+    case EMCMOT_SET_TERM_COND:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
 /* writes command from c */
 int usrmotWriteEmcmotCommand(emcmot_command_t * c)
 {
-    emcmot_status_t s;
+    int numEcho;
+    int commandStatus;
     static int commandNum = 0;
     static unsigned char headCount = 0;
+    unsigned int head;
     double end;
 
     if (!MOTION_ID_VALID(c->id)) {
@@ -89,21 +107,37 @@ int usrmotWriteEmcmotCommand(emcmot_command_t * c)
     c->commandNum = ++commandNum;
 
     /* check for mapped mem still around */
-    if (0 == emcmotCommand) {
+    if (0 == emcmotCommandRing) {
         rcs_print("USRMOT: ERROR: can't connect to shared memory\n");
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
-    /* copy entire command structure to shared memory */
-    *emcmotCommand = *c;
-    /* poll for receipt of command */
     /* set timeout for comm failure, now + timeout */
     end = etime() + EMCMOT_COMM_TIMEOUT;
+    /* wait for a free slot */
+    head = emcmotCommandRing->head;
+    while (head - emcmotCommandRing->tail >= EMCMOT_COMMAND_RING_SIZE) {
+	if (etime() >= end) {
+	    rcs_print("USRMOT: ERROR: command timeout\n");
+	    return EMCMOT_COMM_ERROR_TIMEOUT;
+	}
+	esleep(25e-6);
+    }
+    /* copy entire command structure into the slot, then hand it over */
+    emcmotCommandRing->slot[head % EMCMOT_COMMAND_RING_SIZE] = *c;
+    EMCMOT_MB();
+    emcmotCommandRing->head = head + 1;
+
+    if (usrmotCommandPosted(c->command)) {
+	return EMCMOT_COMM_OK;
+    }
+    /* poll for receipt of command */
     /* now check to see if it got it */
     while (etime() < end) {
 	/* update status */
-	if (( usrmotReadEmcmotStatus(&s) == 0 ) && ( s.commandNumEcho == commandNum )) {
+	if (( usrmotReadEmcmotEcho(&numEcho, &commandStatus) == 0 ) &&
+	    ( numEcho == commandNum )) {
 	    /* now check emcmot status flag */
-	    if (s.commandStatus == EMCMOT_COMMAND_OK) {
+	    if (commandStatus == EMCMOT_COMMAND_OK) {
 		return EMCMOT_COMM_OK;
 	    } else {
                 rcs_print("USRMOT: ERROR: invalid command\n");
@@ -116,22 +150,80 @@ int usrmotWriteEmcmotCommand(emcmot_command_t * c)
     return EMCMOT_COMM_ERROR_TIMEOUT;
 }
 
+/* copies a whole NURBS curve into the shared arena */
+int usrmotWriteNurbsBlock(const CONTROL_POINT * ctrl_pts,
+			  const double *knots, const double *arclen,
+			  nurbs_block_t * blk)
+{
+    static unsigned int ctrl_pts_next = 0;
+    static unsigned int knots_next = 0;
+    static unsigned int arclen_next = 0;
+
+    if (0 == emcmotNurbsArena) {
+        rcs_print("USRMOT: ERROR: can't connect to shared memory\n");
+	return EMCMOT_COMM_ERROR_CONNECT;
+    }
+    if (blk->nr_of_ctrl_pts > EMCMOT_NURBS_ARENA_SIZE ||
+	blk->nr_of_knots > EMCMOT_NURBS_ARENA_SIZE ||
+	NURBS_ARCLEN_STRIDE * blk->nr_of_arclen > EMCMOT_NURBS_ARENA_SIZE) {
+        rcs_print("USRMOT: ERROR: NURBS curve too large (%d control points, %d knots, %d arc length nodes, max %d)\n",
+		  blk->nr_of_ctrl_pts, blk->nr_of_knots, blk->nr_of_arclen,
+		  EMCMOT_NURBS_ARENA_SIZE);
+	return EMCMOT_COMM_ERROR_COMMAND;
+    }
+    /* motion is done with the previous block once its command has been
+       echoed, so simply wrap around when the rest does not fit */
+    if (ctrl_pts_next + blk->nr_of_ctrl_pts > EMCMOT_NURBS_ARENA_SIZE) {
+	ctrl_pts_next = 0;
+    }
+    if (knots_next + blk->nr_of_knots > EMCMOT_NURBS_ARENA_SIZE) {
+	knots_next = 0;
+    }
+    if (arclen_next + NURBS_ARCLEN_STRIDE * blk->nr_of_arclen > EMCMOT_NURBS_ARENA_SIZE) {
+	arclen_next = 0;
+    }
+    memcpy(&emcmotNurbsArena->ctrl_pts[ctrl_pts_next], ctrl_pts,
+	   blk->nr_of_ctrl_pts * sizeof(CONTROL_POINT));
+    memcpy(&emcmotNurbsArena->knots[knots_next], knots,
+	   blk->nr_of_knots * sizeof(double));
+    if (blk->nr_of_arclen) {
+	memcpy(&emcmotNurbsArena->arclen[arclen_next], arclen,
+	       NURBS_ARCLEN_STRIDE * blk->nr_of_arclen * sizeof(double));
+    }
+    blk->ctrl_pts_offset = ctrl_pts_next;
+    blk->knots_offset = knots_next;
+    blk->arclen_offset = arclen_next;
+    /* pointers mean nothing on the other side of the shmem */
+    blk->ctrl_pts_ptr = 0;
+    blk->knots_ptr = 0;
+    blk->arclen_ptr = 0;
+    blk->N = 0;
+    ctrl_pts_next += blk->nr_of_ctrl_pts;
+    knots_next += blk->nr_of_knots;
+    arclen_next += NURBS_ARCLEN_STRIDE * blk->nr_of_arclen;
+
+    return EMCMOT_COMM_OK;
+}
+
 /* copies status to s */
 int usrmotReadEmcmotStatus(emcmot_status_t * s)
 {
     int split_read_count;
+    unsigned int seq;
     
     /* check for shmem still around */
-    if (0 == emcmotStatus) {
+    if (0 == emcmotStatusPub) {
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
     split_read_count = 0;
     do {
-	/* copy status struct from shmem to local memory */
-	memcpy(s, emcmotStatus, sizeof(emcmot_status_t));
-	/* got it, now check head-tail matche */
-	if (s->head == s->tail) {
-	    /* head and tail match, done */
+	/* copy the latest status snapshot from shmem to local memory */
+	seq = emcmotStatusPub->seq;
+	EMCMOT_MB();
+	memcpy(s, &emcmotStatusPub->snap[seq % 2], sizeof(emcmot_status_t));
+	EMCMOT_MB();
+	/* got it, motion did not get round to that buffer meanwhile */
+	if (emcmotStatusPub->seq == seq) {
 	    return EMCMOT_COMM_OK;
 	}
 	/* inc counter and try again, max three times */
@@ -139,6 +231,87 @@ int usrmotReadEmcmotStatus(emcmot_status_t * s)
     return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
 }
 
+/* copies the latest status snapshot to s, unless it is still snapshot
+   *seq, the one copied last time; returns 1 then, having copied nothing
+   (motion only publishes once a period) */
+int usrmotReadEmcmotStatusChanged(emcmot_status_t * s, unsigned int *seq)
+{
+    int split_read_count;
+    unsigned int now;
+
+    if (0 == emcmotStatusPub) {
+	return EMCMOT_COMM_ERROR_CONNECT;
+    }
+    split_read_count = 0;
+    do {
+	now = emcmotStatusPub->seq;
+	if (now == *seq) {
+	    return 1;
+	}
+	EMCMOT_MB();
+	memcpy(s, &emcmotStatusPub->snap[now % 2], sizeof(emcmot_status_t));
+	EMCMOT_MB();
+	if (emcmotStatusPub->seq == now) {
+	    *seq = now;
+	    return EMCMOT_COMM_OK;
+	}
+    } while ( ++split_read_count < 3 );
+    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+}
+
+/* copies just the command echo and its result out of the latest status
+   snapshot, for waiting on a command without copying all of it */
+int usrmotReadEmcmotEcho(int *commandNumEcho, int *commandStatus)
+{
+    int split_read_count;
+    unsigned int seq;
+    emcmot_status_t *snap;
+
+    if (0 == emcmotStatusPub) {
+	return EMCMOT_COMM_ERROR_CONNECT;
+    }
+    split_read_count = 0;
+    do {
+	seq = emcmotStatusPub->seq;
+	EMCMOT_MB();
+	snap = &emcmotStatusPub->snap[seq % 2];
+	*commandNumEcho = snap->commandNumEcho;
+	*commandStatus = snap->commandStatus;
+	EMCMOT_MB();
+	if (emcmotStatusPub->seq == seq) {
+	    return EMCMOT_COMM_OK;
+	}
+    } while ( ++split_read_count < 3 );
+    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+}
+
+/* copies just the queue state out of the latest status snapshot, for
+   polling it more cheaply than usrmotReadEmcmotStatus() */
+int usrmotReadEmcmotQueue(int *depth, int *queueFull, int *inpos)
+{
+    int split_read_count;
+    unsigned int seq;
+    emcmot_status_t *snap;
+
+    if (0 == emcmotStatusPub) {
+	return EMCMOT_COMM_ERROR_CONNECT;
+    }
+    split_read_count = 0;
+    do {
+	seq = emcmotStatusPub->seq;
+	EMCMOT_MB();
+	snap = &emcmotStatusPub->snap[seq % 2];
+	*depth = snap->depth;
+	*queueFull = snap->queueFull;
+	*inpos = (snap->motionFlag & EMCMOT_MOTION_INPOS_BIT) != 0;
+	EMCMOT_MB();
+	if (emcmotStatusPub->seq == seq) {
+	    return EMCMOT_COMM_OK;
+	}
+    } while ( ++split_read_count < 3 );
+    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+}
+
 /* copies config to s */
 int usrmotReadEmcmotConfig(emcmot_config_t * s)
 {
@@ -167,6 +340,7 @@ printf("ReadEmcmotConfig COMM_SPLIT_READ_TIMEOUT\n" );
 int usrmotReadEmcmotDebug(emcmot_debug_t * s)
 {
     int split_read_count;
+    unsigned int seq;
     
     /* check for shmem still around */
     if (0 == emcmotDebug) {
@@ -174,14 +348,20 @@ int usrmotReadEmcmotDebug(emcmot_debug_t * s)
     }
     split_read_count = 0;
     do {
-	/* copy debug struct from shmem to local memory */
-	memcpy(s, emcmotDebug, sizeof(emcmot_debug_t));
-	/* got it, now check head-tail matches */
-	if (s->head == s->tail) {
-	    /* head and tail match, done */
-	    return EMCMOT_COMM_OK;
+	seq = emcmotDebug->seq;
+	if (!(seq & 1)) {
+	    /* motion is between functions, copy debug struct from shmem
+	       to local memory */
+	    EMCMOT_MB();
+	    memcpy(s, emcmotDebug, sizeof(emcmot_debug_t));
+	    EMCMOT_MB();
+	    /* got it, now check motion did not start again meanwhile */
+	    if (emcmotDebug->seq == seq) {
+		return EMCMOT_COMM_OK;
+	    }
 	}
-	/* inc counter and try again, max three times */
+	/* give motion time to finish, and try again, max three times */
+	esleep(25e-6);
     } while ( ++split_read_count < 3 );
 printf("ReadEmcmotDebug COMM_SPLIT_READ_TIMEOUT\n" );
     return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
@@ -344,6 +524,26 @@ void usrmotPrintEmcmotDebug(emcmot_debug_t *d, int which)
 	}
 #endif
 	printf("\n");
+	break;
+
+    case 13:
+	{
+	    static const char *names[EMCMOT_NUM_PHASES] = EMCMOT_PHASE_NAMES;
+	    int t, bin;
+
+	    printf("phase\t\tlast\tmax\tclocks: runs (2^bin to 2^(bin+1)-1)\n");
+	    for (t = 0; t < EMCMOT_NUM_PHASES; t++) {
+		printf("%-12s\t%u\t%u\t", names[t], d->timing[t].last,
+		    d->timing[t].max);
+		for (bin = 0; bin < EMCMOT_TIMING_BINS; bin++) {
+		    if (d->timing[t].hist[bin]) {
+			printf(" 2^%d: %u", bin, d->timing[t].hist[bin]);
+		    }
+		}
+		printf("\n");
+	    }
+	}
+	break;
 
     default:
 	break;
@@ -362,6 +562,7 @@ void usrmotPrintEmcmotConfig(emcmot_config_t c, int which)
 	printf("traj time:    \t%f\n", c.trajCycleTime);
 	printf("servo time:   \t%f\n", c.servoCycleTime);
 	printf("interp rate:  \t%d\n", c.interpolationRate);
+	printf("queue size:   \t%d\n", c.tcQueueSize);
 	printf("v limit:      \t%f\n", c.limitVel);
 	printf("axis vlimit:  \t");
 /*! \todo Another #if 0 */
@@ -674,11 +875,12 @@ int usrmotInit(const char *modname)
 	return -1;
     }
     /* got it */
-    emcmotCommand = &(emcmotStruct->command);
-    emcmotStatus = &(emcmotStruct->status);
+    emcmotCommandRing = &(emcmotStruct->command_ring);
+    emcmotStatusPub = &(emcmotStruct->status_pub);
     emcmotDebug = &(emcmotStruct->debug);
     emcmotConfig = &(emcmotStruct->config);
     emcmotError = &(emcmotStruct->error);
+    emcmotNurbsArena = &(emcmotStruct->nurbs_arena);
 
     inited = 1;
 
@@ -693,9 +895,10 @@ int usrmotExit(void)
     }
 
     emcmotStruct = 0;
-    emcmotCommand = 0;
-    emcmotStatus = 0;
+    emcmotCommandRing = 0;
+    emcmotStatusPub = 0;
     emcmotError = 0;
+    emcmotNurbsArena = 0;
 /*! \todo Another #if 0 */
 #if 0
 /*! \todo FIXME - comp structs no longer in shmem */
@@ -708,11 +911,74 @@ int usrmotExit(void)
     return 0;
 }
 
+/* Loads a 2D compensation map (type 2).  After any lines starting with
+   '#', the first line gives the grid:
+	other-joint start step count other-start other-step other-count
+   and the corrections follow, count per row, one row for each position of
+   the other joint from other-start up, e.g. for joint 0 against joint 1:
+	1  0 100 3  0 200 2
+	0.000 0.004 0.011
+	0.002 0.007 0.015
+*/
+static int usrmotLoadComp2D(int joint, FILE *fp, const char *file)
+{
+    char buffer[LINELEN];
+    double value;
+    int ret = 0, n = 0, len, total;
+    char *p;
+    emcmot_command_t emcmotCommand;
+
+    do {
+	if (NULL == fgets(buffer, LINELEN, fp)) {
+	    fprintf(stderr, "no grid in 2D compensation file %s\n", file);
+	    return -1;
+	}
+    } while (buffer[0] == '#');
+    if (7 != sscanf(buffer, "%d %lf %lf %d %lf %lf %d",
+		    &emcmotCommand.comp_other,
+		    &emcmotCommand.comp_start[0], &emcmotCommand.comp_step[0],
+		    &emcmotCommand.comp_count[0],
+		    &emcmotCommand.comp_start[1], &emcmotCommand.comp_step[1],
+		    &emcmotCommand.comp_count[1])) {
+	fprintf(stderr, "bad grid in 2D compensation file %s\n", file);
+	return -1;
+    }
+    total = emcmotCommand.comp_count[0] * emcmotCommand.comp_count[1];
+    if (emcmotCommand.comp_count[0] < 2 || emcmotCommand.comp_count[1] < 2
+	|| total > EMCMOT_COMP_2D_SIZE) {
+	fprintf(stderr, "2D compensation file %s needs 2 to %d points\n",
+		file, EMCMOT_COMP_2D_SIZE);
+	return -1;
+    }
+    emcmotCommand.joint = joint;
+    emcmotCommand.command = EMCMOT_SET_JOINT_COMP_2D;
+    emcmotCommand.comp_index = -1;
+    ret |= usrmotWriteEmcmotCommand(&emcmotCommand);
+
+    while (n < total && NULL != fgets(buffer, LINELEN, fp)) {
+	if (buffer[0] == '#') {
+	    continue;
+	}
+	for (p = buffer; n < total && 1 == sscanf(p, "%lf%n", &value, &len); p += len) {
+	    emcmotCommand.comp_index = n++;
+	    emcmotCommand.comp_forward = value;
+	    ret |= usrmotWriteEmcmotCommand(&emcmotCommand);
+	}
+    }
+    if (n < total) {
+	fprintf(stderr, "2D compensation file %s has %d of %d values\n",
+		file, n, total);
+	return -1;
+    }
+    return ret;
+}
+
 /* Loads pairs of comp from the compensation file.
    The default way is to specify nominal, forward & reverse triplets in the file
    However if type != 0, it expects nominal, forward_trim & reverse_trim 
 	(where forward_trim = nominal - forward
 	       reverse_trim = nominal - reverse)
+   and type 2 is a 2D map, see usrmotLoadComp2D().
 */
 int usrmotLoadComp(int joint, const char *file, int type)
 {
@@ -734,6 +1000,12 @@ int usrmotLoadComp(int joint, const char *file, int type)
 	return -1;
     }
 
+    if (type == 2) {
+	ret = usrmotLoadComp2D(joint, fp, file);
+	fclose(fp);
+	return ret;
+    }
+
     while (!feof(fp)) {
 	if (NULL == fgets(buffer, LINELEN, fp)) {
 	    break;
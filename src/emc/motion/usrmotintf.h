@@ -15,6 +15,8 @@
 #ifndef USRMOTINTF_H
 #define USRMOTINTF_H
 
+#include "nurbs.h"		/* CONTROL_POINT, nurbs_block_t */
+
 struct emcmot_status_t;
 struct emcmot_command_t;
 struct emcmot_config_t;
@@ -33,6 +35,21 @@ extern "C" {
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotStatus(emcmot_status_t * s);
 
+/* usrmotReadEmcmotStatusChanged() is usrmotReadEmcmotStatus(), but
+   copies nothing and returns 1 if the latest status is still number
+   *seq; otherwise it sets *seq to the number of the status it copied */
+    extern int usrmotReadEmcmotStatusChanged(emcmot_status_t * s,
+	unsigned int *seq);
+
+/* usrmotReadEmcmotEcho() gets just the echoed command number and the
+   command status of the latest status */
+    extern int usrmotReadEmcmotEcho(int *commandNumEcho,
+	int *commandStatus);
+
+/* usrmotReadEmcmotQueue() gets just the queue depth, queue full and
+   in position flags of the latest status */
+    extern int usrmotReadEmcmotQueue(int *depth, int *queueFull, int *inpos);
+
 /* usrmotReadEmcmotConfig() gets the config info out of
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotConfig(emcmot_config_t * s);
@@ -66,10 +83,23 @@ extern "C" {
 #define EMCMOT_COMM_SPLIT_READ_TIMEOUT -4	/* can't read without split */
 #define EMCMOT_COMM_INVALID_MOTION_ID -5 /* do not queue a motion id MOTION_INVALID_ID */
 
-/* usrmotWriteEmcmotCommand() writes the command to the emcmot process.
+/* usrmotWriteEmcmotCommand() writes the command to the emcmot process
+   through the command ring.  Queued moves return as soon as they are in
+   the ring, other commands wait until motion has handled them.
    Return values are as per the #defines above */
     extern int usrmotWriteEmcmotCommand(emcmot_command_t * c);
 
+/* usrmotWriteNurbsBlock() copies the control points, knots and arc
+   length table of a whole NURBS curve into the shared NURBS arena, and
+   fills in the arena offsets in blk.  The lengths are taken from
+   blk->nr_of_ctrl_pts, blk->nr_of_knots and blk->nr_of_arclen.  Must be
+   followed by an EMCMOT_SET_NURBS command carrying blk before the next
+   call. */
+    extern int usrmotWriteNurbsBlock(const CONTROL_POINT * ctrl_pts,
+				     const double *knots,
+				     const double *arclen,
+				     nurbs_block_t * blk);
+
 /* usrmotInit() initializes communication with the emcmot process */
     extern int usrmotInit(const char *name);
 
@@ -228,6 +228,11 @@ extern void CANON_UPDATE_END_POINT(double x, double y, double z,
 /* Called from emctask to update the canon position during skipping through
    programs started with start-from-line > 0. */
 
+extern void CANON_SAVE_STATE(CanonConfig_t *state);
+extern void CANON_RESTORE_STATE(const CanonConfig_t *state);
+/* Called from emctask to copy the canon settings for a run-from-line
+   checkpoint, and to put them back. The end point is not restored. */
+
 extern void USE_LENGTH_UNITS(CANON_UNITS u);
 
 /* Use the specified units for length. Conceptually, the units must
@@ -461,6 +466,19 @@ extern void STRAIGHT_FEED(int lineno,
                           double a, double b, double c,
                           double u, double v, double w);
 
+/* A drilling cycle at one hole: STRAIGHT_FEED to (x, y, z, a, b, c, u,
+v, w), DWELL for the given seconds unless that is negative, then
+STRAIGHT_TRAVERSE back out to the same point with coordinate number
+axis (0 for x to 8 for w) set to clear.  The interpreter makes this one
+call instead of those three for G81 and G82 when the COMPACT_CYCLES
+feature is on; an interface may simply make the three calls itself. */
+
+extern void DRILL_CYCLE(int lineno,
+                        double x, double y, double z,
+                        double a, double b, double c,
+                        double u, double v, double w,
+                        int axis, double clear, double dwell);
+
 /* Additional functions needed to calculate nurbs points */
 
 extern std::vector<unsigned int> knot_vector_creator(unsigned int n, unsigned int k);
@@ -0,0 +1,197 @@
+/********************************************************************
+* Description: canon_trace.h
+*   Binary trace of canonical calls, written by rs274 -C and by
+*   task when EMC_CANON_TRACE is set, and read back by canterp and
+*   tpbench instead of the printed canon text
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+#ifndef CANON_TRACE_H
+#define CANON_TRACE_H
+
+/* A trace is a 16 byte file header followed by records, each a 16 byte
+   record header, 'nargs' doubles and, for COMMENT and MESSAGE, a NUL
+   terminated string or, for INTERP_MSG, the bytes of a message, padded
+   with NULs to a multiple of 8 bytes.  Every
+   field is in the byte order of the machine that wrote it; a reader on
+   the other kind sees a version it does not know and gives up.
+
+   The record types are numbered for good: new calls get new numbers at
+   the end, and calls that grow arguments add them after the old ones.
+   Readers skip types they do not know by 'size', and treat arguments
+   past 'nargs' as 0, so old traces play on new readers and new traces
+   on old ones.  'version' changes only if the layout itself does. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CANON_TRACE_MAGIC	"CNTR"
+#define CANON_TRACE_VERSION	1
+
+typedef struct {
+    char magic[4];		/* CANON_TRACE_MAGIC */
+    uint16_t version;		/* CANON_TRACE_VERSION */
+    uint16_t header_size;	/* of this header, where the records start */
+    uint32_t reserved[2];
+} canon_trace_header_t;
+
+typedef struct {
+    uint16_t type;		/* CANON_TRACE_* */
+    uint16_t nargs;		/* doubles that follow */
+    uint32_t size;		/* of the whole record, a multiple of 8 */
+    int32_t line;		/* source line, or -1 */
+    uint32_t reserved;
+} canon_trace_record_t;
+
+/* arguments are those of the canon call, in order, with the line number
+   left out and enums and ints as doubles */
+enum {
+    CANON_TRACE_INIT_CANON = 1,
+    CANON_TRACE_STRAIGHT_TRAVERSE,	/* x y z a b c u v w */
+    CANON_TRACE_STRAIGHT_FEED,		/* x y z a b c u v w */
+    CANON_TRACE_ARC_FEED,		/* first_end second_end first_axis
+					   second_axis rotation axis_end_point
+					   a b c u v w */
+    CANON_TRACE_STRAIGHT_PROBE,		/* x y z a b c u v w probe_type */
+    CANON_TRACE_SET_FEED_RATE,		/* rate */
+    CANON_TRACE_SET_FEED_REFERENCE,	/* reference */
+    CANON_TRACE_SELECT_PLANE,		/* plane */
+    CANON_TRACE_SET_MOTION_CONTROL_MODE,	/* mode tolerance */
+    CANON_TRACE_USE_LENGTH_UNITS,	/* units */
+    CANON_TRACE_DWELL,			/* seconds */
+    CANON_TRACE_SET_SPINDLE_SPEED,	/* rpm */
+    CANON_TRACE_START_SPINDLE_CLOCKWISE,
+    CANON_TRACE_START_SPINDLE_COUNTERCLOCKWISE,
+    CANON_TRACE_STOP_SPINDLE_TURNING,
+    CANON_TRACE_ORIENT_SPINDLE,		/* orientation mode */
+    CANON_TRACE_START_SPEED_FEED_SYNCH,	/* sync vel */
+    CANON_TRACE_STOP_SPEED_FEED_SYNCH,
+    CANON_TRACE_SELECT_POCKET,		/* pocket tool */
+    CANON_TRACE_CHANGE_TOOL,		/* slot */
+    CANON_TRACE_MIST_ON,
+    CANON_TRACE_MIST_OFF,
+    CANON_TRACE_FLOOD_ON,
+    CANON_TRACE_FLOOD_OFF,
+    CANON_TRACE_ENABLE_FEED_OVERRIDE,
+    CANON_TRACE_DISABLE_FEED_OVERRIDE,
+    CANON_TRACE_ENABLE_SPEED_OVERRIDE,
+    CANON_TRACE_DISABLE_SPEED_OVERRIDE,
+    CANON_TRACE_TURN_PROBE_ON,
+    CANON_TRACE_TURN_PROBE_OFF,
+    CANON_TRACE_PROGRAM_STOP,
+    CANON_TRACE_OPTIONAL_PROGRAM_STOP,
+    CANON_TRACE_PROGRAM_END,
+    CANON_TRACE_PALLET_SHUTTLE,
+    CANON_TRACE_COMMENT,		/* text */
+    CANON_TRACE_MESSAGE,		/* text */
+    /* what task's canon layer made of the calls, for its canon cache:
+       a line read and executed, and an NML message on the interp list */
+    CANON_TRACE_TASK_READ,		/* read_retval, text: the command */
+    CANON_TRACE_TASK_EXECUTE,		/* execute_retval */
+    CANON_TRACE_INTERP_MSG		/* size, data: the message */
+};
+
+static inline int canon_trace_write_header(FILE *f)
+{
+    canon_trace_header_t h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CANON_TRACE_MAGIC, 4);
+    h.version = CANON_TRACE_VERSION;
+    h.header_size = sizeof(h);
+    return fwrite(&h, sizeof(h), 1, f) == 1 ? 0 : -1;
+}
+
+static inline int canon_trace_write_data(FILE *f, int type, int line,
+    const double *args, int nargs, const void *data, size_t len)
+{
+    static const char pad[8] = { 0 };
+    canon_trace_record_t r;
+    size_t size;
+
+    size = sizeof(r) + nargs * sizeof(double) + len;
+    size = (size + 7) & ~(size_t) 7;
+    r.type = type;
+    r.nargs = nargs;
+    r.size = size;
+    r.line = line;
+    r.reserved = 0;
+    if (fwrite(&r, sizeof(r), 1, f) != 1
+	|| (nargs && fwrite(args, sizeof(double), nargs, f) != (size_t) nargs)
+	|| (len && fwrite(data, len, 1, f) != 1)) {
+	return -1;
+    }
+    size -= sizeof(r) + nargs * sizeof(double) + len;
+    return size == 0 || fwrite(pad, size, 1, f) == 1 ? 0 : -1;
+}
+
+static inline int canon_trace_write(FILE *f, int type, int line,
+    const double *args, int nargs, const char *text)
+{
+    return canon_trace_write_data(f, type, line, args, nargs, text,
+	text ? strlen(text) + 1 : 0);
+}
+
+/* nonzero if the first 'len' bytes at 'p' start a trace this reader
+   can play */
+static inline int canon_trace_check(const void *p, size_t len)
+{
+    const canon_trace_header_t *h = (const canon_trace_header_t *) p;
+
+    return len >= sizeof(*h) && memcmp(h->magic, CANON_TRACE_MAGIC, 4) == 0
+	&& h->version == CANON_TRACE_VERSION
+	&& h->header_size >= sizeof(*h) && h->header_size <= len
+	&& h->header_size % 8 == 0;
+}
+
+/* the record at *pos, which is moved past it, or 0 at the end of the
+   trace or a truncated or damaged record */
+static inline const canon_trace_record_t *canon_trace_next(
+    const char *base, size_t len, size_t *pos)
+{
+    const canon_trace_record_t *r;
+
+    if (*pos + sizeof(*r) > len) {
+	return 0;
+    }
+    r = (const canon_trace_record_t *) (base + *pos);
+    if (r->size % 8 != 0 || r->size > len - *pos
+	|| r->size < sizeof(*r) + r->nargs * sizeof(double)) {
+	return 0;
+    }
+    *pos += r->size;
+    return r;
+}
+
+static inline double canon_trace_arg(const canon_trace_record_t *r, int i)
+{
+    return i < r->nargs ? ((const double *) (r + 1))[i] : 0.0;
+}
+
+/* the bytes after the arguments, and how many there are with padding */
+static inline const void *canon_trace_data(const canon_trace_record_t *r,
+    size_t *len)
+{
+    const double *args = (const double *) (r + 1);
+
+    *len = r->size - sizeof(*r) - r->nargs * sizeof(double);
+    return args + r->nargs;
+}
+
+/* the string after the arguments, "" if there is none */
+static inline const char *canon_trace_text(const canon_trace_record_t *r)
+{
+    const char *s = (const char *) ((const double *) (r + 1) + r->nargs);
+
+    if (s >= (const char *) r + r->size
+	|| ((const char *) r)[r->size - 1] != 0) {
+	return "";
+    }
+    return s;
+}
+
+#endif
@@ -30,6 +30,7 @@
 
 // Forward Function Prototypes
 void EmcPose_update(CMS * cms, EmcPose * x);
+void EMC_TASK_TIMING_update(CMS * cms, EMC_TASK_TIMING * x);
 void CANON_TOOL_TABLE_update(CMS * cms, CANON_TOOL_TABLE * x);
 void PmCartesian_update(CMS * cms, PmCartesian * x);
 void initialize_PmCartesian(PmCartesian * x);
@@ -278,6 +279,9 @@ int emcFormat(NMLTYPE type, void *buffer, CMS * cms)
     case EMC_TASK_PLAN_EXECUTE_TYPE:
 	((EMC_TASK_PLAN_EXECUTE *) buffer)->update(cms);
 	break;
+    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+	((EMC_TASK_PLAN_EXECUTE_BATCH *) buffer)->update(cms);
+	break;
     case EMC_TASK_PLAN_INIT_TYPE:
 	((EMC_TASK_PLAN_INIT *) buffer)->update(cms);
 	break;
@@ -380,6 +384,9 @@ int emcFormat(NMLTYPE type, void *buffer, CMS * cms)
     case EMC_TRAJ_CIRCULAR_MOVE_TYPE:
 	((EMC_TRAJ_CIRCULAR_MOVE *) buffer)->update(cms);
 	break;
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
+	((EMC_TRAJ_LINEAR_MOVE_BATCH *) buffer)->update(cms);
+	break;
     case EMC_TRAJ_RIGID_TAP_TYPE:
 	((EMC_TRAJ_RIGID_TAP *) buffer)->update(cms);
         break;
@@ -637,6 +644,8 @@ const char *emc_symbol_lookup(long type)
 	return "EMC_TASK_PLAN_EXECUTE_INTERNAL";
     case EMC_TASK_PLAN_EXECUTE_TYPE:
 	return "EMC_TASK_PLAN_EXECUTE";
+    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+	return "EMC_TASK_PLAN_EXECUTE_BATCH";
     case EMC_TASK_PLAN_INIT_TYPE:
 	return "EMC_TASK_PLAN_INIT";
     case EMC_TASK_PLAN_OPEN_TYPE:
@@ -705,6 +714,8 @@ const char *emc_symbol_lookup(long type)
 	return "EMC_TRAJ_INIT";
     case EMC_TRAJ_LINEAR_MOVE_TYPE:
 	return "EMC_TRAJ_LINEAR_MOVE";
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
+	return "EMC_TRAJ_LINEAR_MOVE_BATCH";
     case EMC_TRAJ_PAUSE_TYPE:
 	return "EMC_TRAJ_PAUSE";
     case EMC_TRAJ_PROBE_TYPE:
@@ -1303,6 +1314,9 @@ void EMC_STAT::update(CMS * cms)
     motion.update(cms);
     io.update(cms);
     cms->update(debug);
+    cms->update(block_serial, EMC_STAT_BLOCKS);
+    cms->update(echo_serials, EMC_ECHO_SERIALS);
+    cms->update(echo_serial_index);
 
 }
 
@@ -1534,6 +1548,113 @@ void EMC_TRAJ_LINEAR_MOVE::update(CMS * cms)
     cms->update(indexrotary);
 }
 
+/*
+*	NML/CMS Update function for EMC_TRAJ_LINEAR_MOVE_BATCH
+*	only the used part of the arrays goes over the wire
+*/
+void EMC_TRAJ_LINEAR_MOVE_BATCH::update(CMS * cms)
+{
+
+    EMC_TRAJ_CMD_MSG::update(cms);
+    cms->update(type);
+    cms->update(vel);
+    cms->update(ini_maxvel);
+    cms->update(acc);
+    cms->update(feed_mode);
+    cms->update(indexrotary);
+    cms->update(count);
+    cms->update(values);
+    if (count < 0 || count > EMC_TRAJ_BATCH_MAX ||
+	values < 0 || values > EMC_TRAJ_BATCH_DATA) {
+	count = values = 0;
+    }
+    cms->update(line, count);
+    cms->update(mask, count);
+    cms->update(data, values);
+}
+
+// the nine axes of an EmcPose, in mask bit order
+static double *batch_axis(EmcPose &p, int i)
+{
+    switch (i) {
+    case 0: return &p.tran.x;
+    case 1: return &p.tran.y;
+    case 2: return &p.tran.z;
+    case 3: return &p.a;
+    case 4: return &p.b;
+    case 5: return &p.c;
+    case 6: return &p.u;
+    case 7: return &p.v;
+    default: return &p.w;
+    }
+}
+
+bool EMC_TRAJ_LINEAR_MOVE_BATCH::fits(const EMC_TRAJ_LINEAR_MOVE &move) const
+{
+    return count < EMC_TRAJ_BATCH_MAX &&
+	(count == 0 ||
+	 (move.type == type && move.vel == vel &&
+	  move.ini_maxvel == ini_maxvel && move.acc == acc &&
+	  move.feed_mode == feed_mode && move.indexrotary == indexrotary));
+}
+
+int EMC_TRAJ_LINEAR_MOVE_BATCH::add(const EMC_TRAJ_LINEAR_MOVE &move, int l)
+{
+    EmcPose end = move.end;
+    unsigned short m = 0;
+    int i, n = values;
+
+    if (!fits(move)) {
+	return -1;
+    }
+    for (i = 0; i < 9; i++) {
+	if (count == 0 || *batch_axis(end, i) != *batch_axis(last, i)) {
+	    m |= 1 << i;
+	    data[n++] = *batch_axis(end, i);
+	}
+    }
+    if (count == 0 || move.ini_maxjerk != last_jerk) {
+	m |= EMC_TRAJ_BATCH_JERK;
+	data[n++] = move.ini_maxjerk;
+    }
+    if (count == 0) {
+	type = move.type;
+	vel = move.vel;
+	ini_maxvel = move.ini_maxvel;
+	acc = move.acc;
+	feed_mode = move.feed_mode;
+	indexrotary = move.indexrotary;
+    }
+    line[count] = l;
+    mask[count] = m;
+    count++;
+    values = n;
+    last = end;
+    last_jerk = move.ini_maxjerk;
+    return 0;
+}
+
+void EMC_TRAJ_LINEAR_MOVE_BATCH::unpack(EmcPose end[], double jerk[]) const
+{
+    EmcPose p;
+    double j = 0.0;
+    int i, k, n = 0;
+
+    ZERO_EMC_POSE(p);
+    for (k = 0; k < count; k++) {
+	for (i = 0; i < 9; i++) {
+	    if (mask[k] & (1 << i)) {
+		*batch_axis(p, i) = data[n++];
+	    }
+	}
+	if (mask[k] & EMC_TRAJ_BATCH_JERK) {
+	    j = data[n++];
+	}
+	end[k] = p;
+	jerk[k] = j;
+    }
+}
+
 /*
 *	NML/CMS Update function for EMC_TRAJ_CIRCULAR_MOVE
 *	Automatically generated by NML CodeGen Java Applet.
@@ -1967,7 +2088,21 @@ void EMC_TASK_STAT::update(CMS * cms)
     cms->update(programUnits);
     cms->update(interpreter_errcode);
     cms->update(input_timeout);
+    cms->update(mdiBatchLines);
+    cms->update(mdiBatchRead);
+    cms->update(mdiBatchDone);
+    cms->update(cycleOverruns);
+    cms->update(cycleJitter);
+    cms->update(cycleJitterMean);
+    cms->update(cycleLoad);
     cms->update(rotation_xy);
+    for (int i = 0; i < EMC_TASK_PHASES; i++) {
+	EMC_TASK_TIMING_update(cms, &phaseTiming[i]);
+    }
+    for (int i = 0; i < EMC_TASK_LATENCY_TYPES; i++) {
+	cms->update(commandLatency[i].type);
+	EMC_TASK_TIMING_update(cms, &commandLatency[i].timing);
+    }
 
 }
 
@@ -2368,6 +2503,7 @@ void EMC_TRAJ_STAT::update(CMS * cms)
     cms->update(queue);
     cms->update(activeQueue);
     cms->update(queueFull);
+    cms->update(queueTime);
     cms->update(id);
     cms->update(paused);
     cms->update(scale);
@@ -2566,6 +2702,15 @@ void EMC_COOLANT_FLOOD_OFF::update(CMS * cms)
 *	Automatically generated by NML CodeGen Java Applet.
 *	on Sat Oct 11 13:45:17 UTC 2003
 */
+void EMC_TASK_TIMING_update(CMS * cms, EMC_TASK_TIMING * x)
+{
+    cms->update(x->count);
+    cms->update(x->last);
+    cms->update(x->max);
+    cms->update(x->total);
+    cms->update(x->hist, EMC_TASK_TIMING_BUCKETS);
+}
+
 void EmcPose_update(CMS * cms, EmcPose * x)
 {
     PmCartesian_update(cms, &(x->tran));
@@ -2660,6 +2805,7 @@ void EMC_JOINT_SET_HOMING_PARAMS::update(CMS * cms)
     cms->update(ignore_limits);
     cms->update(volatile_home);
     cms->update(locking_indexer);
+    cms->update(home_overlap);
 
 }
 
@@ -2701,6 +2847,17 @@ void EMC_TASK_PLAN_EXECUTE::update(CMS * cms)
 
 }
 
+/*
+*	NML/CMS Update function for EMC_TASK_PLAN_EXECUTE_BATCH
+*/
+void EMC_TASK_PLAN_EXECUTE_BATCH::update(CMS * cms)
+{
+
+    EMC_TASK_CMD_MSG::update(cms);
+    cms->update(commands, EMC_MDI_BATCH_LEN);
+
+}
+
 /*
 *	NML/CMS Update function for EMC_COOLANT_FLOOD_ON
 *	Automatically generated by NML CodeGen Java Applet.
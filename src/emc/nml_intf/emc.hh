@@ -142,6 +142,7 @@ class PM_CARTESIAN;
 #define EMC_TRAJ_SET_FH_ENABLE_TYPE                  ((NMLTYPE) 236)
 #define EMC_TRAJ_RIGID_TAP_TYPE                      ((NMLTYPE) 237)
 #define EMC_TRAJ_NURBS_MOVE_TYPE                     ((NMLTYPE) 238)
+#define EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE              ((NMLTYPE) 239)
 
 
 #define EMC_TRAJ_STAT_TYPE                           ((NMLTYPE) 299)
@@ -181,6 +182,7 @@ class PM_CARTESIAN;
 #define EMC_TASK_PLAN_SET_BLOCK_DELETE_TYPE          ((NMLTYPE) 518)
 #define EMC_TASK_PLAN_OPTIONAL_STOP_TYPE             ((NMLTYPE) 519)
 #define EMC_TASK_PLAN_EXECUTE_TYPE                   ((NMLTYPE) 520)
+#define EMC_TASK_PLAN_EXECUTE_BATCH_TYPE             ((NMLTYPE) 521)
 
 #define EMC_TASK_STAT_TYPE                           ((NMLTYPE) 599)
 
@@ -431,7 +433,8 @@ extern int emcJointSetMinFerror(int joint, double ferror);
 extern int emcJointSetHomingParams(int joint, double home, double offset, double home_vel,
                                   double search_vel, double latch_vel,
                                   int use_index, int ignore_limits,
-				  int is_shared, int home_sequence, int volatile_home, int locking_indexer);
+				  int is_shared, int home_sequence, int volatile_home, int locking_indexer,
+				  int home_overlap);
 extern int emcJointSetMaxVelocity(int joint, double vel);
 extern int emcJointSetMaxAcceleration(int joint, double acc);
 extern int emcJointSetMaxJerk(int joint, double jerk);
@@ -491,9 +494,18 @@ extern int emcTrajLinearMove(EmcPose end, int type, double vel, double ini_maxve
                              double acc, double jerk, int indexrotary);
 extern int emcTrajNurbsMove(EmcPose end, int type,nurbs_block_t nurbs_block, double vel, double ini_maxvel,
                             double ini_maxacc,double ini_maxjerk);
+// hands the control points, knots and arc length table (nr_of_arclen
+// nodes of u, du/ds and feed profile, see nurbs_block_t) of a whole NURBS curve over to
+// task; returns the stage id to put into the nurbs_block of the matching
+// EMC_TRAJ_NURBS_MOVE, or -1 on error
+extern int emcTrajNurbsStage(const CONTROL_POINT *ctrl_pts, int nr_of_ctrl_pts,
+                             const double *knots, int nr_of_knots,
+                             const double *arclen, int nr_of_arclen);
 extern int emcTrajCircularMove(EmcPose end, PM_CARTESIAN center, PM_CARTESIAN
         normal, int turn, int type, double vel, double ini_maxvel, double acc, double ini_maxjerk);
 extern int emcTrajSetTermCond(int cond, double tolerance);
+extern int emcTrajSetRapidTolerance(double tolerance);
+extern int emcTrajSetArcBlend(int on);
 extern int emcTrajSetSpindleSync(double feed_per_revolution, bool wait_for_index);
 extern int emcTrajSetOffset(EmcPose tool_offset);
 extern int emcTrajSetOrigin(EmcPose origin);
@@ -520,6 +532,7 @@ extern int emcMotionSetDout(unsigned char index, unsigned char start,
 extern int emcMotionSetSyncInput(unsigned char index, unsigned char now,
         int wait_type, double timeout);
 extern int emcMotionUpdate(EMC_MOTION_STAT * stat);
+extern int emcMotionQueueState();
 // implementation functions for EMC_TASK types
 
 extern int emcTaskInit();
@@ -547,6 +560,9 @@ extern int emcTaskPlanReset();
 extern int emcTaskPlanLine();
 extern int emcTaskPlanLevel();
 extern int emcTaskPlanCommand(char *cmd);
+extern int emcTaskPlanCheckpointRun(int line);
+extern int emcTaskPlanCheckpoint(int line);
+extern int emcTaskPlanCacheRun(int line);
 
 extern int emcTaskUpdate(EMC_TASK_STAT * stat);
 extern int emcAbortCleanup(int reason,const char *message = "");
@@ -619,6 +635,7 @@ extern int emcIoSetCycleTime(double cycleTime);
 extern int emcIoSetDebug(int debug);
 
 extern int emcIoUpdate(EMC_IO_STAT * stat);
+extern int emcIoStatusCount();
 
 // implementation functions for EMC aggregate types
 
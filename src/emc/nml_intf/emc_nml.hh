@@ -311,6 +311,7 @@ class EMC_JOINT_SET_HOMING_PARAMS:public EMC_JOINT_CMD_MSG {
     int home_sequence;
     int volatile_home;
     int locking_indexer;
+    int home_overlap;
 };
 
 class EMC_JOINT_SET_MAX_VELOCITY:public EMC_JOINT_CMD_MSG {
@@ -832,6 +833,50 @@ class EMC_TRAJ_LINEAR_MOVE:public EMC_TRAJ_CMD_MSG {
 };
 
 
+// Several EMC_TRAJ_LINEAR_MOVEs that share type, vel, ini_maxvel, acc,
+// feed_mode and indexrotary, packed into one message. The first move
+// carries all nine axes and its jerk; every later one carries only the
+// values that differ from the move before it, as flagged in its mask.
+#define EMC_TRAJ_BATCH_MAX 8	// below TC_QUEUE_MARGIN, so a batch fits
+				// in whatever room queueFull leaves
+#define EMC_TRAJ_BATCH_DATA (EMC_TRAJ_BATCH_MAX * 10)
+#define EMC_TRAJ_BATCH_JERK 0x200	// mask bit for ini_maxjerk, after
+					// the nine axes x..w in bits 0-8
+
+class EMC_TRAJ_LINEAR_MOVE_BATCH:public EMC_TRAJ_CMD_MSG {
+  public:
+    EMC_TRAJ_LINEAR_MOVE_BATCH():EMC_TRAJ_CMD_MSG(EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE,
+						  sizeof(EMC_TRAJ_LINEAR_MOVE_BATCH)),
+	count(0), values(0) {
+    };
+
+    // For internal NML/CMS use only.
+    void update(CMS * cms);
+
+    // whether move can join this batch
+    bool fits(const EMC_TRAJ_LINEAR_MOVE &move) const;
+    // appends move, which came from program line 'line'; 0 on success
+    int add(const EMC_TRAJ_LINEAR_MOVE &move, int line);
+    // end points and jerks of all the moves, in order
+    void unpack(EmcPose end[], double jerk[]) const;
+
+    int type;
+    double vel, ini_maxvel, acc;
+    int feed_mode;
+    int indexrotary;
+
+    int count;			// moves in the batch
+    int values;			// entries used in data
+    int line[EMC_TRAJ_BATCH_MAX];
+    unsigned short mask[EMC_TRAJ_BATCH_MAX];
+    double data[EMC_TRAJ_BATCH_DATA];
+
+    // end and jerk of the last move, for add(); not sent over NML
+    EmcPose last;
+    double last_jerk;
+};
+
+
 class EMC_TRAJ_NURBS_MOVE:public EMC_TRAJ_CMD_MSG {
   public:
     EMC_TRAJ_NURBS_MOVE():EMC_TRAJ_CMD_MSG(EMC_TRAJ_NURBS_MOVE_TYPE,
@@ -1053,6 +1098,8 @@ class EMC_TRAJ_STAT:public EMC_TRAJ_STAT_MSG {
     // current
     int activeQueue;		// number of motions blending
     bool queueFull;		// non-zero means can't accept another motion
+    double queueTime;		// secs the pending motions take, at
+    // their requested velocities
     int id;			// id of the currently executing motion
     bool paused;			// non-zero means motion paused
     double scale;		// velocity scale factor
@@ -1371,6 +1418,26 @@ class EMC_TASK_PLAN_EXECUTE:public EMC_TASK_CMD_MSG {
     char command[LINELEN];
 };
 
+// size of the newline-separated text of an EMC_TASK_PLAN_EXECUTE_BATCH
+#define EMC_MDI_BATCH_LEN 4096
+
+// A group of MDI lines, separated by '\n', which task interprets back to
+// back with the same readahead as a program instead of waiting for each
+// line's motion to finish.  Progress is reported in EMC_TASK_STAT
+// mdiBatchLines/mdiBatchRead/mdiBatchDone.
+class EMC_TASK_PLAN_EXECUTE_BATCH:public EMC_TASK_CMD_MSG {
+  public:
+    EMC_TASK_PLAN_EXECUTE_BATCH():EMC_TASK_CMD_MSG(EMC_TASK_PLAN_EXECUTE_BATCH_TYPE,
+					     sizeof(EMC_TASK_PLAN_EXECUTE_BATCH))
+    {
+    };
+
+    // For internal NML/CMS use only.
+    void update(CMS * cms);
+
+    char commands[EMC_MDI_BATCH_LEN];
+};
+
 class EMC_TASK_PLAN_PAUSE:public EMC_TASK_CMD_MSG {
   public:
     EMC_TASK_PLAN_PAUSE():EMC_TASK_CMD_MSG(EMC_TASK_PLAN_PAUSE_TYPE,
@@ -1477,6 +1544,36 @@ class EMC_TASK_PLAN_OPTIONAL_STOP:public EMC_TASK_CMD_MSG {
 };
 
 
+// how long task spends in each phase of its cycle, and how long
+// commands take from arrival until task is done with them.  Bucket n of
+// hist counts times of 2^(n-1) up to 2^n microseconds, the last bucket
+// everything longer.  Once count reaches EMC_TASK_TIMING_HALFLIFE all
+// counts and the total are halved, so they favour recent history.
+#define EMC_TASK_TIMING_BUCKETS 16
+#define EMC_TASK_TIMING_HALFLIFE 65536
+#define EMC_TASK_LATENCY_TYPES 8
+
+enum EMC_TASK_PHASE_ENUM {
+    EMC_TASK_PHASE_PLAN,	// emcTaskPlan()
+    EMC_TASK_PHASE_EXECUTE,	// emcTaskExecute()
+    EMC_TASK_PHASE_ISSUE,	// emcTaskIssueCommand()
+    EMC_TASK_PHASE_READ,	// emcTaskPlanRead()
+    EMC_TASK_PHASES
+};
+
+struct EMC_TASK_TIMING {
+    int count;
+    double last;		// seconds
+    double max;
+    double total;
+    int hist[EMC_TASK_TIMING_BUCKETS];
+};
+
+struct EMC_TASK_LATENCY {
+    int type;			// NML type of the commands, 0 if unused
+    struct EMC_TASK_TIMING timing;
+};
+
 // EMC_TASK status base class
 class EMC_TASK_STAT_MSG:public RCS_STAT_MSG {
   public:
@@ -1525,6 +1622,16 @@ class EMC_TASK_STAT:public EMC_TASK_STAT_MSG {
     int task_paused;		// non-zero means task is paused
     double delayLeft;           // delay time left of G4, M66..
     int queuedMDIcommands;      // current length of MDI input queue
+    int mdiBatchLines;          // lines in the last MDI batch
+    int mdiBatchRead;           // of those, lines handed to the interpreter
+    int mdiBatchDone;           // of those, lines whose motion has completed
+    int cycleOverruns;          // task cycles missed, from RCS_TIMER
+    double cycleJitter;         // latest a cycle woke after its deadline, s
+    double cycleJitterMean;     // average lateness of cycle wakeups, s
+    double cycleLoad;           // fraction of the cycle time spent working
+    struct EMC_TASK_TIMING phaseTiming[EMC_TASK_PHASES];
+    // the first EMC_TASK_LATENCY_TYPES command types seen
+    struct EMC_TASK_LATENCY commandLatency[EMC_TASK_LATENCY_TYPES];
 };
 
 // declarations for EMC_TOOL classes
@@ -2184,6 +2291,19 @@ class EMC_STAT_MSG:public RCS_STAT_MSG {
     void update(CMS * cms);
 };
 
+// sub-blocks of EMC_STAT that carry their own change counter
+enum EMC_STAT_BLOCK {
+    EMC_STAT_TASK,		// task, not counting its heartbeat
+    EMC_STAT_TRAJ,		// motion.traj
+    EMC_STAT_JOINTS,		// motion.joint[] and motion.axis[]
+    EMC_STAT_IO,		// io.coolant, io.aux and io.lube
+    EMC_STAT_TOOL,		// io.tool, with the tool table
+    EMC_STAT_BLOCKS
+};
+
+// how many of the commands task took last EMC_STAT remembers
+#define EMC_ECHO_SERIALS 32
+
 class EMC_STAT:public EMC_STAT_MSG {
   public:
     EMC_STAT();
@@ -2199,6 +2319,21 @@ class EMC_STAT:public EMC_STAT_MSG {
     EMC_IO_STAT io;
 
     int debug;			// copy of EMC_DEBUG global
+
+    // bumped by task whenever a sub-block differs from what it wrote
+    // last time, so readers can skip copying the sub-blocks that did
+    // not change; indexed by EMC_STAT_BLOCK
+    int block_serial[EMC_STAT_BLOCKS];
+
+    // serial numbers of the last commands task took, newest at
+    // echo_serials[echo_serial_index].  With several clients on a
+    // queued emcCommand echo_serial_number may already be another
+    // client's, so each looks for its own here, see echoed()
+    int echo_serials[EMC_ECHO_SERIALS];
+    int echo_serial_index;
+
+    // whether task has taken the command with this serial number
+    int echoed(int serial_number) const;
 };
 
 /*
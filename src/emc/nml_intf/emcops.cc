@@ -15,6 +15,7 @@
 * Last change:
 ********************************************************************/
 
+#include <string.h>		// memset()
 #include "emc.hh"
 #include "emc_nml.hh"
 
@@ -65,6 +66,7 @@ EMC_TRAJ_STAT_MSG(EMC_TRAJ_STAT_TYPE, sizeof(EMC_TRAJ_STAT))
     queue = 0;
     activeQueue = 0;
     queueFull = OFF;
+    queueTime = 0.0;
     id = 0;
     paused = OFF;
     scale = 0.0;
@@ -149,6 +151,15 @@ EMC_TASK_STAT_MSG(EMC_TASK_STAT_TYPE, sizeof(EMC_TASK_STAT))
     task_paused = 0;
     delayLeft = 0.0;
     queuedMDIcommands = 0;
+    mdiBatchLines = 0;
+    mdiBatchRead = 0;
+    mdiBatchDone = 0;
+    cycleOverruns = 0;
+    cycleJitter = 0.0;
+    cycleJitterMean = 0.0;
+    cycleLoad = 0.0;
+    memset(phaseTiming, 0, sizeof(phaseTiming));
+    memset(commandLatency, 0, sizeof(commandLatency));
 }
 
 EMC_TOOL_STAT::EMC_TOOL_STAT():
@@ -222,4 +233,24 @@ EMC_TOOL_STAT EMC_TOOL_STAT::operator =(EMC_TOOL_STAT s)
 
 EMC_STAT::EMC_STAT():EMC_STAT_MSG(EMC_STAT_TYPE, sizeof(EMC_STAT))
 {
+    for (int i = 0; i < EMC_STAT_BLOCKS; i++) {
+        block_serial[i] = 0;
+    }
+    for (int i = 0; i < EMC_ECHO_SERIALS; i++) {
+        echo_serials[i] = -1;
+    }
+    echo_serial_index = 0;
+}
+
+int EMC_STAT::echoed(int serial_number) const
+{
+    if (echo_serial_number == serial_number) {
+        return 1;
+    }
+    for (int i = 0; i < EMC_ECHO_SERIALS; i++) {
+        if (echo_serials[i] == serial_number) {
+            return 1;
+        }
+    }
+    return 0;
 }
@@ -21,27 +21,106 @@
 #include "rcs.hh"		// LinkedList
 #include "interpl.hh"		// these decls
 #include "emc.hh"
+#include "emc_nml.hh"		// EMC_TRAJ_LINEAR_MOVE_BATCH
 #include "emcglb.h"
-#include "linklist.hh"
 #include "nmlmsg.hh"            /* class NMLmsg */
 #include "rcs_print.hh"
+#include "canon_trace.h"	// canon_trace_write_data()
 
 NML_INTERP_LIST interp_list;	/* NML Union, for interpreter */
 
 NML_INTERP_LIST::NML_INTERP_LIST()
 {
-    linked_list_ptr = new LinkedList;
+    size = NML_INTERP_LIST_MIN_SIZE;
+    ring = new NML_INTERP_LIST_NODE[size];
+    retired = NULL;
+    head = tail = 0;
+    reserved = 0;
+    batch = 0;
+    recorder = NULL;
 
     next_line_number = 0;
     line_number = 0;
+    pthread_mutex_init(&mutex, NULL);
 }
 
 NML_INTERP_LIST::~NML_INTERP_LIST()
 {
-    if (NULL != linked_list_ptr) {
-	delete linked_list_ptr;
-	linked_list_ptr = NULL;
+    delete[] ring;
+    ring = NULL;
+    delete[] retired;
+    retired = NULL;
+    pthread_mutex_destroy(&mutex);
+}
+
+// double the ring, keeping the nodes in order.  The node handed out
+// by get() must stay where it is until the next get(), so if there is
+// one its ring is kept around until then.
+void NML_INTERP_LIST::grow()
+{
+    NML_INTERP_LIST_NODE *bigger;
+    NML_INTERP_LIST_NODE *node;
+    unsigned int n;
+
+    bigger = new NML_INTERP_LIST_NODE[2 * size];
+    for (n = 0; head + n != tail; n++) {
+	node = &ring[(head + n) & (size - 1)];
+	bigger[n].line_number = node->line_number;
+	memcpy(bigger[n].command.commandbuf, node->command.commandbuf,
+	       ((NMLmsg *) node->command.commandbuf)->size);
+    }
+    if (reserved && NULL == retired) {
+	retired = ring;
+    } else {
+	delete[] ring;
     }
+    reserved = 0;
+    ring = bigger;
+    size *= 2;
+    head = 0;
+    tail = n;
+}
+
+// with batching on, consecutive linear moves that share their limits
+// are packed into one EMC_TRAJ_LINEAR_MOVE_BATCH as long as the last
+// node hasn't been handed out yet
+void NML_INTERP_LIST::set_batch(int on)
+{
+    batch = on;
+}
+
+int NML_INTERP_LIST::append_batched(EMC_TRAJ_LINEAR_MOVE *move)
+{
+    NML_INTERP_LIST_NODE *node;
+    NMLmsg *last;
+    EMC_TRAJ_LINEAR_MOVE_BATCH packed;
+
+    if (tail == head) {
+	return -1;
+    }
+    node = &ring[(tail - 1) & (size - 1)];
+    last = (NMLmsg *) node->command.commandbuf;
+    if (last->type == EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE) {
+	return ((EMC_TRAJ_LINEAR_MOVE_BATCH *) last)->add(*move, next_line_number);
+    }
+    if (last->type != EMC_TRAJ_LINEAR_MOVE_TYPE) {
+	return -1;
+    }
+    packed.add(*(EMC_TRAJ_LINEAR_MOVE *) last, node->line_number);
+    if (0 != packed.add(*move, next_line_number)) {
+	return -1;
+    }
+    packed.serial_number = ((RCS_CMD_MSG *) last)->serial_number;
+    memcpy(node->command.commandbuf, &packed, packed.size);
+    return 0;
+}
+
+// with a recorder set, everything appended is also written to it as
+// CANON_TRACE_INTERP_MSG records, as it is before any batching, so that
+// appending them again in order gives the same list
+void NML_INTERP_LIST::set_recorder(FILE *f)
+{
+    recorder = f;
 }
 
 int NML_INTERP_LIST::append(NMLmsg & nml_msg)
@@ -59,6 +138,8 @@ int NML_INTERP_LIST::set_line_number(int line)
 
 int NML_INTERP_LIST::append(NMLmsg * nml_msg_ptr)
 {
+    NML_INTERP_LIST_NODE *node;
+
     /* check for invalid data */
     if (NULL == nml_msg_ptr) {
 	rcs_print_error
@@ -83,38 +164,48 @@ int NML_INTERP_LIST::append(NMLmsg * nml_msg_ptr)
 	return -1;
     }
 #ifdef DEBUG_INTERPL
-    if (sizeof(temp_node) < MAX_NML_COMMAND_SIZE + 4 ||
-	sizeof(temp_node) > MAX_NML_COMMAND_SIZE + 16 ||
-	((void *) &temp_node.line_number) >
-	((void *) &temp_node.command.commandbuf)) {
+    if (sizeof(NML_INTERP_LIST_NODE) < MAX_NML_COMMAND_SIZE + 4 ||
+	sizeof(NML_INTERP_LIST_NODE) > MAX_NML_COMMAND_SIZE + 16 ||
+	((void *) &ring->line_number) >
+	((void *) &ring->command.commandbuf)) {
 	rcs_print_error
 	    ("NML_INTERP_LIST::append : assumptions about NML_INTERP_LIST_NODE have been violated.");
 	return -1;
     }
 #endif
 
-    if (NULL == linked_list_ptr) {
+    if (NULL == ring) {
 	return -1;
     }
-    // fill in the NML_INTERP_LIST_NODE
-    temp_node.line_number = next_line_number;
-    memcpy(temp_node.command.commandbuf, nml_msg_ptr, nml_msg_ptr->size);
-
-    // stick it on the list
-    linked_list_ptr->store_at_tail(&temp_node,
-				   nml_msg_ptr->size +
-				   sizeof(temp_node.line_number) +
-				   sizeof(temp_node.dummy) + 32 + (32 -
-								   nml_msg_ptr->
-								   size %
-								   32), 1);
+    pthread_mutex_lock(&mutex);
+    if (recorder != NULL) {
+	// a failed write shows in ferror(recorder), for its owner to see
+	double size = nml_msg_ptr->size;
+	canon_trace_write_data(recorder, CANON_TRACE_INTERP_MSG,
+			       next_line_number, &size, 1, nml_msg_ptr,
+			       nml_msg_ptr->size);
+    }
+    if (batch && nml_msg_ptr->type == EMC_TRAJ_LINEAR_MOVE_TYPE &&
+	0 == append_batched((EMC_TRAJ_LINEAR_MOVE *) nml_msg_ptr)) {
+	pthread_mutex_unlock(&mutex);
+	return 0;
+    }
+    if (tail - head + reserved == size) {
+	grow();
+    }
+    // copy it into the next free node
+    node = &ring[tail & (size - 1)];
+    node->line_number = next_line_number;
+    memcpy(node->command.commandbuf, nml_msg_ptr, nml_msg_ptr->size);
+    tail++;
 
     if (emc_debug & EMC_DEBUG_INTERP_LIST) {
 	rcs_print
 	    ("NML_INTERP_LIST::append(nml_msg_ptr{size=%ld,type=%s}) : list_size=%d, line_number=%d\n",
 	     nml_msg_ptr->size, emc_symbol_lookup(nml_msg_ptr->type),
-	     linked_list_ptr->list_size, temp_node.line_number);
+	     (int) (tail - head), node->line_number);
     }
+    pthread_mutex_unlock(&mutex);
 
     return 0;
 }
@@ -124,31 +215,37 @@ NMLmsg *NML_INTERP_LIST::get()
     NMLmsg *ret;
     NML_INTERP_LIST_NODE *node_ptr;
 
-    if (NULL == linked_list_ptr) {
-	line_number = 0;
-	return NULL;
-    }
-
-    node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->retrieve_head();
+    pthread_mutex_lock(&mutex);
+    // the caller is done with the last one
+    delete[] retired;
+    retired = NULL;
+    reserved = 0;
 
-    if (NULL == node_ptr) {
+    if (NULL == ring || head == tail) {
 	line_number = 0;
+	pthread_mutex_unlock(&mutex);
 	return NULL;
     }
+
+    // it stays put until the next get()
+    node_ptr = &ring[head & (size - 1)];
+    head++;
+    reserved = 1;
     // save line number of this one, for use by get_line_number
     line_number = node_ptr->line_number;
 
     // get it off the front
     ret = (NMLmsg *) ((char *) node_ptr->command.commandbuf);
+    pthread_mutex_unlock(&mutex);
 
     return ret;
 }
 
 void NML_INTERP_LIST::clear()
 {
-    if (NULL != linked_list_ptr) {
-	linked_list_ptr->delete_members();
-    }
+    pthread_mutex_lock(&mutex);
+    head = tail;
+    pthread_mutex_unlock(&mutex);
 }
 
 void NML_INTERP_LIST::print()
@@ -156,31 +253,35 @@ void NML_INTERP_LIST::print()
     NMLmsg *ret;
     NML_INTERP_LIST_NODE *node_ptr;
     int line_number;
+    unsigned int n;
 
-    if (NULL == linked_list_ptr) {
+    if (NULL == ring) {
 	return;
     }
-    node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->get_head();
 
-    rcs_print("NML_INTERP_LIST::print(): list size=%d\n",linked_list_ptr->list_size);
-    while (NULL != node_ptr) {
+    pthread_mutex_lock(&mutex);
+    rcs_print("NML_INTERP_LIST::print(): list size=%d\n",
+	      (int) (tail - head));
+    for (n = head; n != tail; n++) {
+	node_ptr = &ring[n & (size - 1)];
 	line_number = node_ptr->line_number;
 	ret = (NMLmsg *) ((char *) node_ptr->command.commandbuf);
 	rcs_print("--> type=%s,  line_number=%d\n",
 		  emc_symbol_lookup((int)ret->type),
 		  line_number);
-	node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->get_next();
     }
+    pthread_mutex_unlock(&mutex);
     rcs_print("\n");
 }
 
 int NML_INTERP_LIST::len()
 {
-    if (NULL == linked_list_ptr) {
-	return 0;
-    }
+    int n;
 
-    return ((int) linked_list_ptr->list_size);
+    pthread_mutex_lock(&mutex);
+    n = (int) (tail - head);
+    pthread_mutex_unlock(&mutex);
+    return n;
 }
 
 int NML_INTERP_LIST::get_line_number()
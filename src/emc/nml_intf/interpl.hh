@@ -17,7 +17,13 @@
 #ifndef INTERP_LIST_HH
 #define INTERP_LIST_HH
 
+#include <stdio.h>		// FILE
+#include <pthread.h>		// pthread_mutex_t
+
 #define MAX_NML_COMMAND_SIZE 1000
+#define NML_INTERP_LIST_MIN_SIZE 64	// nodes in a new list
+
+class EMC_TRAJ_LINEAR_MOVE;
 
 // these go on the interp list
 struct NML_INTERP_LIST_NODE {
@@ -42,7 +48,8 @@ struct NML_INTERP_LIST_NODE {
     } command;
 };
 
-// here's the interp list itself
+// here's the interp list itself.  It may be appended to by one thread
+// while another gets from it, see [TASK] INTERP_THREAD in emctaskmain.cc
 class NML_INTERP_LIST {
   public:
     NML_INTERP_LIST();
@@ -52,16 +59,29 @@ class NML_INTERP_LIST {
     int get_line_number();
     int append(NMLmsg &);
     int append(NMLmsg *);
+    void set_batch(int on);
+    void set_recorder(FILE *f);
     NMLmsg *get();
     void clear();
     void print();
     int len();
 
   private:
-    class LinkedList * linked_list_ptr;
-    NML_INTERP_LIST_NODE temp_node;	// filled in and put on the list
-    int next_line_number;	// line number used to fill temp_node
+    // the list is a ring of nodes, doubled when it fills up, so that
+    // appending and getting don't allocate once it is big enough
+    void grow();
+    int append_batched(EMC_TRAJ_LINEAR_MOVE *move);
+    NML_INTERP_LIST_NODE *ring;
+    NML_INTERP_LIST_NODE *retired;	// old ring holding the node from get()
+    unsigned int size;		// nodes in ring, a power of two
+    unsigned int head;		// next node for get()
+    unsigned int tail;		// next node for append()
+    int reserved;		// ring[head - 1] is the node from get()
+    int batch;			// pack linear moves, see set_batch()
+    FILE *recorder;		// canon trace of what is appended, or NULL
+    int next_line_number;	// line number for appended nodes
     int line_number;		// line number of node from get()
+    pthread_mutex_t mutex;	// held while the ring is looked at
 };
 
 extern NML_INTERP_LIST interp_list;	/* NML Union, for interpreter */
@@ -29,6 +29,23 @@ typedef struct {
       double X,
              Y;
       } PLANE_POINT;
+
+/* highest NURBS order the motion controller evaluates */
+#define NURBS_MAX_ORDER 10
+
+/* doubles per node of the arc length table: u, du/ds and the feed
+   profile, see nurbs_block_t */
+#define NURBS_ARCLEN_STRIDE 3
+
+/* channels of the per-span polynomial cache of a NURBS curve: the
+   weighted coordinates, the weight and the weighted curvature */
+enum {
+    NURBS_CH_X = 0, NURBS_CH_Y, NURBS_CH_Z,
+    NURBS_CH_A, NURBS_CH_B, NURBS_CH_C,
+    NURBS_CH_U, NURBS_CH_V, NURBS_CH_W,
+    NURBS_CH_R, NURBS_CH_D,
+    NURBS_CHANNELS
+};
 /*typedef struct  {
     double              uofl_knot;
     __u32            uofl_knot_flag;
@@ -46,17 +63,41 @@ typedef struct
     __u32                    nr_of_knots;
     __u32                    order;
     double                      curve_len;
-    double                      curvature;
-    double                      knot;
-    double                      weight;
+    // bulk transfer: where the curve sits in the task->motion NURBS arena
+    __u32                    ctrl_pts_offset;
+    __u32                    knots_offset;
+    // handle of the curve staged in task, see emcTrajNurbsStage()
+    int                      stage_id;
+    // arc length table: nr_of_arclen nodes curve_len / (nr_of_arclen - 1)
+    // apart along the curve, NURBS_ARCLEN_STRIDE doubles each; at node j,
+    // arclen_ptr[NURBS_ARCLEN_STRIDE * j] is u, the next one du/ds and
+    // the last the feed profile, the highest path velocity the curvature
+    // and the accel and jerk limits allow there.  No table (nr_of_arclen
+    // 0) means u runs proportionally to progress, at the control point
+    // feeds.
+    double                      *arclen_ptr;
+    __u32                    nr_of_arclen;
+    __u32                    arclen_offset;
 
     double                      *N; // basis function buffer
+    // evaluation cache: the curve on knot span [knots_ptr[span],
+    // knots_ptr[span+1]) as polynomials in (u - knots_ptr[span]);
+    // span_coef[k * NURBS_CHANNELS + ch] is the t^k coefficient of
+    // channel ch.  span is -1 while the cache is empty.
+    double                      *span_coef;
+    int                         span;
 //    double                      *NL; // basis function buffer for U(L)
     int 		        axis_mask;
 } nurbs_block_t;
 
 extern int nurbs_findspan(int n, int p, double u, double *U);
 extern void nurbs_basisfun(int i, double u, int p, double *U, double *N);
+extern void nurbs_span_coef(int i, int p, double *U,
+                            CONTROL_POINT *ctrl_pts, double *coef);
+extern double nurbs_arclen_u(const double *arclen, int n, double len,
+                             double s);
+extern double nurbs_arclen_vmax(const double *arclen, int n, double len,
+                                double s);
 
 enum {
     AXIS_MASK_X =   1, AXIS_MASK_Y =   2, AXIS_MASK_Z =   4,
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define MAX_ERRMSG_SIZE 256
 
@@ -45,6 +46,7 @@ int PythonPlugin::run_string(const char *cmd, bp::object &retval, bool as_file)
 	bp::handle_exception();
 	PyErr_Clear();
     }
+    callables.clear();  // cmd may have defined anything
     if (status == PLUGIN_EXCEPTION) {
 	logPP(0, "run_string(%s): \n%s",
 	      cmd, exception_msg.c_str());
@@ -94,13 +96,7 @@ int PythonPlugin::call(const char *module, const char *callable,
 	return status;
 
     try {
-	if (module == NULL) {  // default to function in toplevel module
-	    function = main_namespace[callable];
-	} else {
-	    bp::object submod =  main_namespace[module];
-	    bp::object submod_namespace = submod.attr("__dict__");
-	    function = submod_namespace[callable];
-	}
+	lookup(module, callable, function);
 	// this wont work with boost-python1.34 - needs 1.40
 	//retval = function(*tupleargs, **kwargs);
 
@@ -146,13 +142,7 @@ bool PythonPlugin::is_callable(const char *module,
 	return false;
     }
     try {
-	if (module == NULL) {  // default to function in toplevel module
-	   function = main_namespace[funcname];
-	} else {
-	    bp::object submod =  main_namespace[module];
-	    bp::object submod_namespace = submod.attr("__dict__");
-	    function = submod_namespace[funcname];
-	}
+	lookup(module, funcname, function);
 	result = PyCallable_Check(function.ptr());
     }
     catch (bp::error_already_set) {
@@ -177,14 +167,48 @@ bool PythonPlugin::is_callable(const char *module,
     return result;
 }
 
+// Find [module.]funcname, remembering it for the next time. Whatever
+// replaces the functions in the namespaces - a reload or a run_string() -
+// forgets them all again. Throws like the namespace lookup does.
+void PythonPlugin::lookup(const char *module, const char *funcname, bp::object &function)
+{
+    std::string key = module ? std::string(module) + "." + funcname : funcname;
+    std::map<std::string, bp::object>::iterator it = callables.find(key);
+
+    if (it != callables.end()) {
+	function = it->second;
+	return;
+    }
+    if (module == NULL) {  // default to function in toplevel module
+	function = main_namespace[funcname];
+    } else {
+	bp::object submod =  main_namespace[module];
+	bp::object submod_namespace = submod.attr("__dict__");
+	function = submod_namespace[funcname];
+    }
+    callables[key] = function;
+}
+
+// st_mtime only has a resolution of a second, so this looks at the
+// file at most once a second; calls in between see no change.
 // this should be moved to an inotify-based solution and be done with it
 int PythonPlugin::reload()
 {
     struct stat st;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec == reload_checked) {
+	// same as the last look found
+	if (reload_status == PLUGIN_OK)
+	    status = PLUGIN_OK;
+	return status;
+    }
+    reload_checked = now.tv_sec;
 
     if (stat(abs_path, &st)) {
 	logPP(0, "reload: stat(%s) returned %s", abs_path, strerror(errno));
-	status = PLUGIN_STAT_FAILED;
+	status = reload_status = PLUGIN_STAT_FAILED;
 	return status;
     }
     if (st.st_mtime > module_mtime) {
@@ -195,6 +219,7 @@ int PythonPlugin::reload()
 	logPP(5, "reload: no-op");
 	status = PLUGIN_OK;
     }
+    reload_status = status;
     return status;
 }
 
@@ -222,6 +247,7 @@ std::string handle_pyerror()
 void PythonPlugin::initialize(bool reload)
 {
     std::string msg;
+    callables.clear();
     if (Py_IsInitialized()) {
 	try {
 	    bp::object module = bp::import("__main__");
@@ -259,6 +285,8 @@ PythonPlugin::PythonPlugin(const char *iniFilename,
 			   struct _inittab *inittab) :
     status(0),
     module_mtime(0),
+    reload_checked(-1),
+    reload_status(0),
     reload_on_change(0),
     ini_filename(0),
     section(0),
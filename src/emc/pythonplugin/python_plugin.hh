@@ -6,6 +6,7 @@ namespace bp = boost::python;
 
 #include <vector>
 #include <string>
+#include <map>
 #include <sys/types.h>
 
 
@@ -63,9 +64,13 @@ private:
     ~PythonPlugin() {};
 
     int reload();
+    void lookup(const char *module, const char *funcname, bp::object &function);
     std::vector<std::string> inittab_entries;
+    std::map<std::string, bp::object> callables; // [module.]funcname looked up so far
     int status;
     time_t module_mtime;                  // toplevel module - last modification time
+    time_t reload_checked;                // CLOCK_MONOTONIC second of the last stat()
+    int reload_status;                    // and the status it left
     bool reload_on_change;                // auto-reload if toplevel module was changed
     const char *ini_filename;
     const char *section;
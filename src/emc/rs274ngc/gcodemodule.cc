@@ -19,6 +19,9 @@
 #include <Python.h>
 #include <structmember.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
 
 #include "rs274ngc.hh"
 #include "rs274ngc_interp.hh"
@@ -150,12 +153,282 @@ static InterpBase *pinterp;
 
 #define callmethod(o, m, f, ...) PyObject_CallMethod((o), (char*)(m), (char*)(f), ## __VA_ARGS__)
 
+// g5x, g92 and xy rotation of the canon, as kept by interpret.Translated
+struct canon_xform {
+    double g5x[9], g92[9];
+    double rotation_cos, rotation_sin;
+};
+
+static void unrotate(double &x, double &y, double c, double s) {
+    double tx = x * c + y * s;
+    y = -x * s + y * c;
+    x = tx;
+}
+
+static void rotate(double &x, double &y, double c, double s) {
+    double tx = x * c - y * s;
+    y = x * s + y * c;
+    x = tx;
+}
+
+static void rotate_and_translate(const canon_xform &t, double p[9]) {
+    for(int ax=0; ax<9; ax++) p[ax] += t.g92[ax];
+    rotate(p[0], p[1], t.rotation_cos, t.rotation_sin);
+    for(int ax=0; ax<9; ax++) p[ax] += t.g5x[ax];
+}
+
+// Breaks the arc from o to the given end into straight segments, at most
+// max_segments per half turn, and no more than it takes to stay within
+// tolerance of the arc if that is not 0.  o and the points appended to
+// segs (9 per point, the first one being o itself) are in rotated and
+// translated coordinates like canon.lo.
+static void arc_segments(const double lo[9], const canon_xform &t, int plane,
+        double x1, double y1, double cx, double cy, int rot, double z1,
+        double a, double b, double c, double u, double v, double w,
+        int max_segments, double tolerance, std::vector<double> &segs) {
+    double o[9], n[9];
+    int X, Y, Z;
+
+    if(plane == 1) {
+        X=0; Y=1; Z=2;
+    } else if(plane == 3) {
+        X=2; Y=0; Z=1;
+    } else {
+        X=1; Y=2; Z=0;
+    }
+    n[X] = x1;
+    n[Y] = y1;
+    n[Z] = z1;
+    n[3] = a;
+    n[4] = b;
+    n[5] = c;
+    n[6] = u;
+    n[7] = v;
+    n[8] = w;
+    for(int ax=0; ax<9; ax++) o[ax] = lo[ax] - t.g5x[ax];
+    unrotate(o[0], o[1], t.rotation_cos, t.rotation_sin);
+    for(int ax=0; ax<9; ax++) o[ax] -= t.g92[ax];
+
+    double theta1 = atan2(o[Y]-cy, o[X]-cx);
+    double theta2 = atan2(n[Y]-cy, n[X]-cx);
+
+    if(rot < 0) {
+        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
+    } else {
+        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
+    }
+
+    // if multi-turn, add the right number of full circles
+    if(rot < -1) theta2 += 2*M_PI*(rot+1);
+    if(rot > 1) theta2 += 2*M_PI*(rot-1);
+
+    int steps = int(max_segments * fabs(theta1 - theta2) / M_PI);
+    double radius = hypot(o[X]-cx, o[Y]-cy);
+    if(tolerance > 0 && tolerance < radius) {
+        // a chord of angle da is 1-cos(da/2) of the radius off the arc
+        double da = 2 * acos(1 - tolerance / radius);
+        steps = std::min(steps, int(ceil(fabs(theta1 - theta2) / da)));
+    }
+    steps = std::max(3, steps);
+    double rsteps = 1. / (steps); 
+
+    double dtheta = theta2 - theta1;
+    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
+    d[Z] = n[Z] - o[Z];
+
+    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
+    for(int i=0; i<steps-1; i++) {
+        double f = (i) * rsteps; 
+        double p[9];
+        if (i>0) rotate(tx, ty, dc, ds);
+        p[X] = tx + cx;
+        p[Y] = ty + cy;
+        p[Z] = o[Z] + d[Z] * f;
+        p[3] = o[3] + d[3] * f;
+        p[4] = o[4] + d[4] * f;
+        p[5] = o[5] + d[5] * f;
+        p[6] = o[6] + d[6] * f;
+        p[7] = o[7] + d[7] * f;
+        p[8] = o[8] + d[8] * f;
+        rotate_and_translate(t, p);
+        segs.insert(segs.end(), p, p+9);
+    }
+    rotate_and_translate(t, n);
+    segs.insert(segs.end(), n, n+9);
+}
+
+/* Preview mode: instead of calling the canon for every move, the moves
+ * are kept here as flat records, one array each for traverses, feeds and
+ * arc segments, with the same contents as GLCanon's traverse, feed and
+ * arcfeed tuples: line number, start, end, feed rate and tool offset.
+ * The run happens on its own thread.  That thread holds the GIL while it
+ * is in the interpreter, and everything here (and the interpreter) is
+ * only touched with the GIL held, but it lets go of it between lines
+ * every so often so the program can show the part already read.
+ *
+ * The other canon calls still go to the canon object, on the preview
+ * thread, and next_line is only called for lines that have one of those.
+ * The canon's position, offsets, plane, feed rate and suppress count are
+ * copied here after such a call and canon.lo is kept up to date before
+ * one, so a canon written for parse() sees the same state it would there.
+ */
+enum { PREVIEW_TRAVERSE, PREVIEW_FEED, PREVIEW_ARCFEED, PREVIEW_KINDS };
+
+struct preview_segment {
+    int line;
+    int unused;
+    double start[9], end[9];
+    double feedrate;
+    double tool_offset[3];
+};
+#define PREVIEW_SEGMENT_FORMAT "i4x9d9dd3d"
+
+struct preview_run {
+    pthread_t thread;
+    bool joined;
+    bool abort;
+    bool done;
+    char *filename, *unitcode, *initcode, *interpname;
+    PyObject *canon;
+
+    int result, error_line_offset;
+    PyObject *exc_type, *exc_value, *exc_traceback;
+
+    std::vector<preview_segment> segments[PREVIEW_KINDS];
+
+    canon_xform xform;
+    double lo[9], feedrate, tool_offset[3];
+    int plane, suppress, arcdivision;
+    double arc_tolerance;
+    bool first_move, lo_dirty;
+
+    // of every move so far, as calc_extents gives them
+    double min_extents[3], max_extents[3];
+    double min_extents_notool[3], max_extents_notool[3];
+};
+
+static preview_run *preview;
+static bool line_pending;
+
+static void preview_get(const char *attr_name, double *v) {
+    PyObject *attr = PyObject_GetAttrString(preview->canon, attr_name);
+    double d = attr ? PyFloat_AsDouble(attr) : -1;
+    if(!attr || (d == -1 && PyErr_Occurred())) PyErr_Clear();
+    else *v = d;
+    Py_XDECREF(attr);
+}
+
+static void preview_get(const char *attr_name, int *v) {
+    PyObject *attr = PyObject_GetAttrString(preview->canon, attr_name);
+    long l = attr ? PyInt_AsLong(attr) : -1;
+    if(!attr || (l == -1 && PyErr_Occurred())) PyErr_Clear();
+    else *v = l;
+    Py_XDECREF(attr);
+}
+
+// pick up whatever the last canon call changed
+static void preview_reload() {
+    static const char *g5x[9] = {"g5x_offset_x", "g5x_offset_y", "g5x_offset_z",
+        "g5x_offset_a", "g5x_offset_b", "g5x_offset_c",
+        "g5x_offset_u", "g5x_offset_v", "g5x_offset_w"};
+    static const char *g92[9] = {"g92_offset_x", "g92_offset_y", "g92_offset_z",
+        "g92_offset_a", "g92_offset_b", "g92_offset_c",
+        "g92_offset_u", "g92_offset_v", "g92_offset_w"};
+    preview_run *p = preview;
+    for(int ax=0; ax<9; ax++) {
+        preview_get(g5x[ax], &p->xform.g5x[ax]);
+        preview_get(g92[ax], &p->xform.g92[ax]);
+    }
+    preview_get("rotation_cos", &p->xform.rotation_cos);
+    preview_get("rotation_sin", &p->xform.rotation_sin);
+    preview_get("xo", &p->tool_offset[0]);
+    preview_get("yo", &p->tool_offset[1]);
+    preview_get("zo", &p->tool_offset[2]);
+    preview_get("feedrate", &p->feedrate);
+    preview_get("plane", &p->plane);
+    preview_get("suppress", &p->suppress);
+    int first_move = p->first_move;
+    preview_get("first_move", &first_move);
+    p->first_move = first_move;
+
+    // lo may be a list or a tuple
+    PyObject *lo = PyObject_GetAttrString(p->canon, "lo");
+    PyObject *t = lo ? PySequence_Tuple(lo) : NULL;
+    if(!t || !PyArg_ParseTuple(t, "ddddddddd", &p->lo[0], &p->lo[1], &p->lo[2],
+                &p->lo[3], &p->lo[4], &p->lo[5], &p->lo[6], &p->lo[7], &p->lo[8]))
+        PyErr_Clear();
+    Py_XDECREF(t);
+    Py_XDECREF(lo);
+    p->lo_dirty = false;
+}
+
+// give the canon the position the moves kept here ended at
+static void preview_sync() {
+    preview_run *p = preview;
+    if(!p->lo_dirty) return;
+    PyObject *lo = Py_BuildValue("ddddddddd", p->lo[0], p->lo[1], p->lo[2],
+            p->lo[3], p->lo[4], p->lo[5], p->lo[6], p->lo[7], p->lo[8]);
+    if(!lo || PyObject_SetAttrString(p->canon, "lo", lo) < 0) interp_error ++;
+    Py_XDECREF(lo);
+    PyObject *f = PyBool_FromLong(p->first_move);
+    if(PyObject_SetAttrString(p->canon, "first_move", f) < 0) interp_error ++;
+    Py_DECREF(f);
+    p->lo_dirty = false;
+}
+
+static void preview_line(int line_number) {
+    if(line_number == last_sequence_number) return;
+    last_sequence_number = line_number;
+    line_pending = true;
+}
+
+static void preview_move(int kind, const double l[9]) {
+    preview_run *p = preview;
+    preview_segment s;
+    s.line = last_sequence_number;
+    s.unused = 0;
+    memcpy(s.start, p->lo, sizeof(s.start));
+    memcpy(s.end, l, sizeof(s.end));
+    s.feedrate = p->feedrate;
+    memcpy(s.tool_offset, p->tool_offset, sizeof(s.tool_offset));
+    p->segments[kind].push_back(s);
+    for(int ax=0; ax<3; ax++) {
+        double lo = std::min(s.start[ax], s.end[ax]);
+        double hi = std::max(s.start[ax], s.end[ax]);
+        p->min_extents[ax] = std::min(p->min_extents[ax], lo);
+        p->max_extents[ax] = std::max(p->max_extents[ax], hi);
+        p->min_extents_notool[ax] = std::min(p->min_extents_notool[ax], lo + s.tool_offset[ax]);
+        p->max_extents_notool[ax] = std::max(p->max_extents_notool[ax], hi + s.tool_offset[ax]);
+    }
+    memcpy(p->lo, l, sizeof(p->lo));
+    p->lo_dirty = true;
+}
+
+static void preview_straight(int kind, int line_number,
+        double x, double y, double z, double a, double b, double c,
+        double u, double v, double w) {
+    preview_line(line_number);
+    if(preview->suppress > 0) return;
+    double l[9] = {x, y, z, a, b, c, u, v, w};
+    rotate_and_translate(preview->xform, l);
+    if(kind == PREVIEW_TRAVERSE && preview->first_move) {
+        // GLCanon leaves out the move to the first position
+        memcpy(preview->lo, l, sizeof(preview->lo));
+        preview->lo_dirty = true;
+        return;
+    }
+    preview_move(kind, l);
+    preview->first_move = false;
+}
+
 static void maybe_new_line(int sequence_number=interp_new.sequence_number());
 static void maybe_new_line(int sequence_number) {
     if(!pinterp) return;
     if(interp_error) return;
-    if(sequence_number == last_sequence_number)
+    if(preview) preview_sync();
+    if(sequence_number == last_sequence_number && !line_pending)
         return;
+    line_pending = false;
     LineCode *new_line_code =
         (LineCode*)(PyObject_New(LineCode, &LineCodeType));
     interp_new.active_settings(new_line_code->settings);
@@ -352,6 +625,20 @@ void ARC_FEED(int line_number,
         v_position /= 25.4;
         w_position /= 25.4;
     }
+    if(preview) {
+        preview_line(line_number);
+        if(preview->suppress > 0) return;
+        std::vector<double> segs;
+        arc_segments(preview->lo, preview->xform, preview->plane,
+                first_end, second_end, first_axis, second_axis, rotation,
+                axis_end_point, a_position, b_position, c_position,
+                u_position, v_position, w_position,
+                preview->arcdivision, preview->arc_tolerance, segs);
+        for(size_t i=0; i<segs.size(); i+=9)
+            preview_move(PREVIEW_ARCFEED, &segs[i]);
+        preview->first_move = false;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -372,6 +659,10 @@ void STRAIGHT_FEED(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        preview_straight(PREVIEW_FEED, line_number, x, y, z, a, b, c, u, v, w);
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -389,6 +680,10 @@ void STRAIGHT_TRAVERSE(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        preview_straight(PREVIEW_TRAVERSE, line_number, x, y, z, a, b, c, u, v, w);
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -398,6 +693,19 @@ void STRAIGHT_TRAVERSE(int line_number,
     Py_XDECREF(result);
 }
 
+void DRILL_CYCLE(int line_number,
+                 double x, double y, double z,
+                 double a, double b, double c,
+                 double u, double v, double w,
+                 int axis, double clear, double dwell) {
+    double end[9] = {x, y, z, a, b, c, u, v, w};
+    STRAIGHT_FEED(line_number, x, y, z, a, b, c, u, v, w);
+    if(dwell >= 0) DWELL(dwell);
+    end[axis] = clear;
+    STRAIGHT_TRAVERSE(line_number, end[0], end[1], end[2], end[3], end[4],
+                      end[5], end[6], end[7], end[8]);
+}
+
 void SET_G5X_OFFSET(int g5x_index,
                     double x, double y, double z,
                     double a, double b, double c,
@@ -409,6 +717,7 @@ void SET_G5X_OFFSET(int g5x_index,
         callmethod(callback, "set_g5x_offset", "ifffffffff",
                             g5x_index, x, y, z, a, b, c, u, v, w);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -422,6 +731,7 @@ void SET_G92_OFFSET(double x, double y, double z,
         callmethod(callback, "set_g92_offset", "fffffffff",
                             x, y, z, a, b, c, u, v, w);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -431,6 +741,7 @@ void SET_XY_ROTATION(double t) {
     PyObject *result =
         callmethod(callback, "set_xy_rotation", "f", t);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 };
 
@@ -442,6 +753,7 @@ void SELECT_PLANE(CANON_PLANE pl) {
     PyObject *result =
         callmethod(callback, "set_plane", "i", pl);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -471,6 +783,7 @@ void CHANGE_TOOL(int pocket) {
     PyObject *result = 
         callmethod(callback, "change_tool", "i", pocket);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -491,6 +804,7 @@ void SET_FEED_RATE(double rate) {
     PyObject *result =
         callmethod(callback, "set_feed_rate", "f", rate);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -523,6 +837,7 @@ void COMMENT(const char *comment) {
     PyObject *result =
         callmethod(callback, "comment", "s", comment);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -540,6 +855,7 @@ void USE_TOOL_LENGTH_OFFSET(EmcPose offset) {
     PyObject *result = callmethod(callback, "tool_offset", "ddddddddd", offset.tran.x, offset.tran.y, offset.tran.z,
         offset.a, offset.b, offset.c, offset.u, offset.v, offset.w);
     if(result == NULL) interp_error ++;
+    else if(preview) preview_reload();
     Py_XDECREF(result);
 }
 
@@ -666,6 +982,10 @@ void STRAIGHT_PROBE(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        preview_straight(PREVIEW_FEED, line_number, x, y, z, a, b, c, u, v, w);
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -678,6 +998,18 @@ void STRAIGHT_PROBE(int line_number,
 void RIGID_TAP(int line_number,
                double x, double y, double z) {
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; }
+    if(preview) {
+        preview_line(line_number);
+        if(preview->suppress > 0) return;
+        double lo[9], l[9] = {x, y, z, 0, 0, 0, 0, 0, 0};
+        memcpy(lo, preview->lo, sizeof(lo));
+        rotate_and_translate(preview->xform, l);
+        memcpy(l+3, lo+3, 6 * sizeof(double));
+        preview_move(PREVIEW_FEED, l);
+        preview_move(PREVIEW_FEED, lo);
+        preview->first_move = false;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -873,15 +1205,7 @@ CANON_MOTION_MODE GET_EXTERNAL_MOTION_CONTROL_MODE() { return motion_mode; }
 void SET_NAIVECAM_TOLERANCE(double tolerance) { }
 
 #define RESULT_OK (result == INTERP_OK || result == INTERP_EXECUTE_FINISH)
-static PyObject *parse_file(PyObject *self, PyObject *args) {
-    char *f;
-    char *unitcode=0, *initcode=0, *interpname=0;
-    int error_line_offset = 0;
-    struct timeval t0, t1;
-    int wait = 1;
-    if(!PyArg_ParseTuple(args, "sO|sss", &f, &callback, &unitcode, &initcode, &interpname))
-        return NULL;
-
+static void start_interp(const char *f, const char *interpname) {
     if(pinterp) {
         delete pinterp;
         pinterp = 0;
@@ -894,11 +1218,10 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
     for(int i=0; i<USER_DEFINED_FUNCTION_NUM; i++) 
         USER_DEFINED_FUNCTION[i] = user_defined_function;
 
-    gettimeofday(&t0, NULL);
-
     metric=false;
     interp_error = 0;
     last_sequence_number = -1;
+    line_pending = false;
 
     _pos_x = _pos_y = _pos_z = _pos_a = _pos_b = _pos_c = 0;
     _pos_u = _pos_v = _pos_w = 0;
@@ -907,48 +1230,257 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
     interp_new.open(f);
 
     maybe_new_line();
+}
 
+// Runs the whole file; poll is called after each line is read and
+// returns true, with a Python exception set, to stop.
+static int run_interp(const char *unitcode, const char *initcode,
+        bool (*poll)(), int &error_line_offset) {
     int result = INTERP_OK;
+    error_line_offset = 0;
     if(unitcode) {
         result = interp_new.read(unitcode);
-        if(!RESULT_OK) goto out_error;
+        if(!RESULT_OK) goto out;
         result = interp_new.execute();
     }
     if(initcode && RESULT_OK) {
         result = interp_new.read(initcode);
-        if(!RESULT_OK) goto out_error;
+        if(!RESULT_OK) goto out;
         result = interp_new.execute();
     }
     while(!interp_error && RESULT_OK) {
         error_line_offset = 1;
         result = interp_new.read();
-        gettimeofday(&t1, NULL);
-        if(t1.tv_sec > t0.tv_sec + wait) {
-            if(check_abort()) return NULL;
-            t0 = t1;
-        }
+        if(poll()) { interp_error ++; break; }
         if(!RESULT_OK) break;
         error_line_offset = 0;
         result = interp_new.execute();
     }
-out_error:
+out:
     if(pinterp) pinterp->close();
-    if(interp_error) {
-        if(!PyErr_Occurred()) {
-            PyErr_Format(PyExc_RuntimeError,
-                    "interp_error > 0 but no Python exception set");
-        }
-        return NULL;
+    if(!interp_error) {
+        PyErr_Clear();
+        maybe_new_line();
+        if(PyErr_Occurred()) interp_error = 1;
     }
-    PyErr_Clear();
-    maybe_new_line();
-    if(PyErr_Occurred()) { interp_error = 1; goto out_error; }
+    if(interp_error && !PyErr_Occurred()) {
+        PyErr_Format(PyExc_RuntimeError,
+                "interp_error > 0 but no Python exception set");
+    }
+    return result;
+}
+
+static struct timeval poll_time;
+static bool parse_poll() {
+    struct timeval t1;
+    gettimeofday(&t1, NULL);
+    if(t1.tv_sec > poll_time.tv_sec + 1) {
+        if(check_abort()) return true;
+        poll_time = t1;
+    }
+    return false;
+}
+
+static void preview_stop();
+
+static PyObject *parse_file(PyObject *self, PyObject *args) {
+    char *f;
+    char *unitcode=0, *initcode=0, *interpname=0;
+    PyObject *canon;
+    int error_line_offset = 0;
+    if(!PyArg_ParseTuple(args, "sO|sss", &f, &canon, &unitcode, &initcode, &interpname))
+        return NULL;
+
+    preview_stop();
+    callback = canon;
+    gettimeofday(&poll_time, NULL);
+    start_interp(f, interpname);
+    int result = run_interp(unitcode, initcode, parse_poll, error_line_offset);
+    if(interp_error) return NULL;
     PyObject *retval = PyTuple_New(2);
     PyTuple_SetItem(retval, 0, PyInt_FromLong(result));
     PyTuple_SetItem(retval, 1, PyInt_FromLong(last_sequence_number + error_line_offset));
     return retval;
 }
 
+// let other threads run for a moment every 20ms
+static struct timeval yield_time;
+static bool preview_poll() {
+    struct timeval t1;
+    if(preview->abort) {
+        PyErr_Format(PyExc_KeyboardInterrupt, "Load aborted");
+        return true;
+    }
+    gettimeofday(&t1, NULL);
+    if((t1.tv_sec - yield_time.tv_sec) * 1000000 + t1.tv_usec - yield_time.tv_usec > 20000) {
+        if(preview->lo_dirty) preview_sync();
+        Py_BEGIN_ALLOW_THREADS
+        sched_yield();
+        Py_END_ALLOW_THREADS
+        gettimeofday(&yield_time, NULL);
+    }
+    return false;
+}
+
+static void *preview_thread(void *arg) {
+    PyGILState_STATE gil = PyGILState_Ensure();
+    preview_run *p = (preview_run*)arg;
+
+    callback = p->canon;
+    gettimeofday(&yield_time, NULL);
+    preview_reload();
+    start_interp(p->filename, p->interpname);
+    p->result = run_interp(p->unitcode, p->initcode, preview_poll,
+            p->error_line_offset);
+    if(!interp_error) {
+        preview_sync();
+        if(PyErr_Occurred()) interp_error ++;
+    }
+    p->error_line_offset += last_sequence_number;
+    if(interp_error)
+        PyErr_Fetch(&p->exc_type, &p->exc_value, &p->exc_traceback);
+    p->done = true;
+
+    PyGILState_Release(gil);
+    return NULL;
+}
+
+static void preview_join(preview_run *p) {
+    if(p->joined) return;
+    Py_BEGIN_ALLOW_THREADS
+    pthread_join(p->thread, NULL);
+    Py_END_ALLOW_THREADS
+    p->joined = true;
+}
+
+static void preview_free(preview_run *p) {
+    free(p->filename);
+    free(p->unitcode);
+    free(p->initcode);
+    free(p->interpname);
+    Py_XDECREF(p->canon);
+    Py_XDECREF(p->exc_type);
+    Py_XDECREF(p->exc_value);
+    Py_XDECREF(p->exc_traceback);
+    delete p;
+}
+
+// abort the preview, if any, and forget it
+static void preview_stop() {
+    preview_run *p = preview;
+    if(!p) return;
+    p->abort = true;
+    preview_join(p);
+    preview = 0;
+    preview_free(p);
+}
+
+static char *strdup_or_null(const char *s) {
+    return s ? strdup(s) : 0;
+}
+
+static PyObject *preview_file(PyObject *self, PyObject *args) {
+    char *f;
+    char *unitcode=0, *initcode=0, *interpname=0;
+    PyObject *canon;
+    if(!PyArg_ParseTuple(args, "sO|sss", &f, &canon, &unitcode, &initcode, &interpname))
+        return NULL;
+
+    preview_stop();
+    PyEval_InitThreads();
+
+    preview_run *p = new preview_run();
+    p->filename = strdup(f);
+    p->unitcode = strdup_or_null(unitcode);
+    p->initcode = strdup_or_null(initcode);
+    p->interpname = strdup_or_null(interpname);
+    Py_INCREF(canon);
+    p->canon = canon;
+    p->xform.rotation_cos = 1;
+    p->feedrate = 1;
+    p->plane = 1;
+    p->arcdivision = 64;
+    p->arc_tolerance = .0001;
+    p->first_move = true;
+    for(int ax=0; ax<3; ax++) {
+        p->min_extents[ax] = p->min_extents_notool[ax] = 9e99;
+        p->max_extents[ax] = p->max_extents_notool[ax] = -9e99;
+    }
+    preview = p;
+    preview_get("arcdivision", &p->arcdivision);
+    preview_get("arc_tolerance", &p->arc_tolerance);
+
+    if(pthread_create(&p->thread, NULL, preview_thread, p) != 0) {
+        preview = 0;
+        p->joined = true;
+        preview_free(p);
+        PyErr_SetString(PyExc_RuntimeError, "could not start preview thread");
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static bool preview_check() {
+    if(preview) return true;
+    PyErr_SetString(PyExc_RuntimeError, "no preview");
+    return false;
+}
+
+static PyObject *preview_progress(PyObject *self, PyObject *args) {
+    if(!preview_check()) return NULL;
+    preview_run *p = preview;
+    return Py_BuildValue("Oiiii", p->done ? Py_True : Py_False,
+            last_sequence_number,
+            (int)p->segments[PREVIEW_TRAVERSE].size(),
+            (int)p->segments[PREVIEW_FEED].size(),
+            (int)p->segments[PREVIEW_ARCFEED].size());
+}
+
+static PyObject *preview_segments(PyObject *self, PyObject *args) {
+    int kind, start = 0;
+    if(!PyArg_ParseTuple(args, "i|i:preview_segments", &kind, &start))
+        return NULL;
+    if(!preview_check()) return NULL;
+    if(kind < 0 || kind >= PREVIEW_KINDS) {
+        PyErr_Format(PyExc_ValueError, "preview_segments: no kind %d", kind);
+        return NULL;
+    }
+    std::vector<preview_segment> &segs = preview->segments[kind];
+    if(start < 0 || start > (int)segs.size()) start = segs.size();
+    if(start == (int)segs.size()) return PyString_FromStringAndSize("", 0);
+    return PyString_FromStringAndSize((const char*)&segs[start],
+            (segs.size() - start) * sizeof(preview_segment));
+}
+
+static PyObject *preview_extents(PyObject *self, PyObject *args) {
+    if(!preview_check()) return NULL;
+    preview_run *p = preview;
+    return Py_BuildValue("[ddd][ddd][ddd][ddd]",
+        p->min_extents[0], p->min_extents[1], p->min_extents[2],
+        p->max_extents[0], p->max_extents[1], p->max_extents[2],
+        p->min_extents_notool[0], p->min_extents_notool[1], p->min_extents_notool[2],
+        p->max_extents_notool[0], p->max_extents_notool[1], p->max_extents_notool[2]);
+}
+
+static PyObject *preview_wait(PyObject *self, PyObject *args) {
+    if(!preview_check()) return NULL;
+    preview_run *p = preview;
+    preview_join(p);
+    if(p->exc_type) {
+        PyErr_Restore(p->exc_type, p->exc_value, p->exc_traceback);
+        p->exc_type = p->exc_value = p->exc_traceback = 0;
+        return NULL;
+    }
+    return Py_BuildValue("ii", p->result, p->error_line_offset);
+}
+
+static PyObject *preview_abort(PyObject *self, PyObject *args) {
+    preview_stop();
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 
 static int maxerror = -1;
 
@@ -960,6 +1492,25 @@ static PyObject *rs274_strerror(PyObject *s, PyObject *o) {
     return PyString_FromString(savedError);
 }
 
+// extents of packed preview records: every start and the last end.  The
+// records are copied out one at a time, a string's data need not be
+// aligned for doubles.
+static void segment_extents(const char *data, size_t n,
+        double mn[3], double mx[3], double mnt[3], double mxt[3]) {
+    preview_segment s;
+    for(size_t j=0; j<=n; j++) {
+        if(j < n) memcpy(&s, data + j * sizeof(s), sizeof(s));
+        const double *p = j < n ? s.start : s.end;
+        const double *t = s.tool_offset;
+        for(int ax=0; ax<3; ax++) {
+            mn[ax] = std::min(mn[ax], p[ax]);
+            mx[ax] = std::max(mx[ax], p[ax]);
+            mnt[ax] = std::min(mnt[ax], p[ax] + t[ax]);
+            mxt[ax] = std::max(mxt[ax], p[ax] + t[ax]);
+        }
+    }
+}
+
 static PyObject *rs274_calc_extents(PyObject *self, PyObject *args) {
     double min_x = 9e99, min_y = 9e99, min_z = 9e99,
            min_xt = 9e99, min_yt = 9e99, min_zt = 9e99,
@@ -968,6 +1519,25 @@ static PyObject *rs274_calc_extents(PyObject *self, PyObject *args) {
     for(int i=0; i<PySequence_Length(args); i++) {
         PyObject *si = PyTuple_GetItem(args, i);
         if(!si) return NULL;
+        if(PyString_Check(si)) {
+            // records from preview_segments
+            Py_ssize_t size = PyString_Size(si);
+            if(size % sizeof(preview_segment)) {
+                PyErr_SetString(PyExc_ValueError,
+                        "calc_extents: not a whole number of preview records");
+                return NULL;
+            }
+            size_t n = size / sizeof(preview_segment);
+            if(!n) continue;
+            double mn[3] = {min_x, min_y, min_z}, mx[3] = {max_x, max_y, max_z},
+                   mnt[3] = {min_xt, min_yt, min_zt}, mxt[3] = {max_xt, max_yt, max_zt};
+            segment_extents(PyString_AsString(si), n, mn, mx, mnt, mxt);
+            min_x = mn[0]; min_y = mn[1]; min_z = mn[2];
+            max_x = mx[0]; max_y = mx[1]; max_z = mx[2];
+            min_xt = mnt[0]; min_yt = mnt[1]; min_zt = mnt[2];
+            max_xt = mxt[0]; max_yt = mxt[1]; max_zt = mxt[2];
+            continue;
+        }
         int j;
         double xs, ys, zs, xe, ye, ze, xt, yt, zt;
         for(j=0; j<PySequence_Length(si); j++) {
@@ -1064,125 +1634,69 @@ static bool get_attr(PyObject *o, const char *attr_name, const char *fmt, ...) {
     return result;
 }
 
-static void unrotate(double &x, double &y, double c, double s) {
-    double tx = x * c + y * s;
-    y = -x * s + y * c;
-    x = tx;
-}
-
-static void rotate(double &x, double &y, double c, double s) {
-    double tx = x * c - y * s;
-    y = x * s + y * c;
-    x = tx;
-}
-
 static PyObject *rs274_arc_to_segments(PyObject *self, PyObject *args) {
     PyObject *canon;
     double x1, y1, cx, cy, z1, a, b, c, u, v, w;
-    double o[9], n[9], g5xoffset[9], g92offset[9];
+    double o[9];
+    canon_xform t;
     int rot, plane;
-    int X, Y, Z;
-    double rotation_cos, rotation_sin;
     int max_segments = 128;
+    double tolerance = 0;
 
-    if(!PyArg_ParseTuple(args, "Oddddiddddddd|i:arcs_to_segments",
-        &canon, &x1, &y1, &cx, &cy, &rot, &z1, &a, &b, &c, &u, &v, &w, &max_segments)) return NULL;
+    if(!PyArg_ParseTuple(args, "Oddddiddddddd|id:arcs_to_segments",
+        &canon, &x1, &y1, &cx, &cy, &rot, &z1, &a, &b, &c, &u, &v, &w,
+        &max_segments, &tolerance)) return NULL;
     if(!get_attr(canon, "lo", "ddddddddd:arcs_to_segments lo", &o[0], &o[1], &o[2],
                     &o[3], &o[4], &o[5], &o[6], &o[7], &o[8]))
         return NULL;
     if(!get_attr(canon, "plane", &plane)) return NULL;
-    if(!get_attr(canon, "rotation_cos", &rotation_cos)) return NULL;
-    if(!get_attr(canon, "rotation_sin", &rotation_sin)) return NULL;
-    if(!get_attr(canon, "g5x_offset_x", &g5xoffset[0])) return NULL;
-    if(!get_attr(canon, "g5x_offset_y", &g5xoffset[1])) return NULL;
-    if(!get_attr(canon, "g5x_offset_z", &g5xoffset[2])) return NULL;
-    if(!get_attr(canon, "g5x_offset_a", &g5xoffset[3])) return NULL;
-    if(!get_attr(canon, "g5x_offset_b", &g5xoffset[4])) return NULL;
-    if(!get_attr(canon, "g5x_offset_c", &g5xoffset[5])) return NULL;
-    if(!get_attr(canon, "g5x_offset_u", &g5xoffset[6])) return NULL;
-    if(!get_attr(canon, "g5x_offset_v", &g5xoffset[7])) return NULL;
-    if(!get_attr(canon, "g5x_offset_w", &g5xoffset[8])) return NULL;
-    if(!get_attr(canon, "g92_offset_x", &g92offset[0])) return NULL;
-    if(!get_attr(canon, "g92_offset_y", &g92offset[1])) return NULL;
-    if(!get_attr(canon, "g92_offset_z", &g92offset[2])) return NULL;
-    if(!get_attr(canon, "g92_offset_a", &g92offset[3])) return NULL;
-    if(!get_attr(canon, "g92_offset_b", &g92offset[4])) return NULL;
-    if(!get_attr(canon, "g92_offset_c", &g92offset[5])) return NULL;
-    if(!get_attr(canon, "g92_offset_u", &g92offset[6])) return NULL;
-    if(!get_attr(canon, "g92_offset_v", &g92offset[7])) return NULL;
-    if(!get_attr(canon, "g92_offset_w", &g92offset[8])) return NULL;
-
-    if(plane == 1) {
-        X=0; Y=1; Z=2;
-    } else if(plane == 3) {
-        X=2; Y=0; Z=1;
-    } else {
-        X=1; Y=2; Z=0;
-    }
-    n[X] = x1;
-    n[Y] = y1;
-    n[Z] = z1;
-    n[3] = a;
-    n[4] = b;
-    n[5] = c;
-    n[6] = u;
-    n[7] = v;
-    n[8] = w;
-    for(int ax=0; ax<9; ax++) o[ax] -= g5xoffset[ax];
-    unrotate(o[0], o[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) o[ax] -= g92offset[ax];
-
-    double theta1 = atan2(o[Y]-cy, o[X]-cx);
-    double theta2 = atan2(n[Y]-cy, n[X]-cx);
-
-    if(rot < 0) {
-        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
-    } else {
-        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
-    }
-
-    // if multi-turn, add the right number of full circles
-    if(rot < -1) theta2 += 2*M_PI*(rot+1);
-    if(rot > 1) theta2 += 2*M_PI*(rot-1);
-
-    int steps = std::max(3, int(max_segments * fabs(theta1 - theta2) / M_PI));
-    double rsteps = 1. / (steps); 
-    PyObject *segs = PyList_New(steps);
-
-    double dtheta = theta2 - theta1;
-    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
-    d[Z] = n[Z] - o[Z];
-
-    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
-    for(int i=0; i<steps; i++) {
-        double f = (i) * rsteps; 
-        double p[9];
-        if (i>0) rotate(tx, ty, dc, ds);
-        p[X] = tx + cx;
-        p[Y] = ty + cy;
-        p[Z] = o[Z] + d[Z] * f;
-        p[3] = o[3] + d[3] * f;
-        p[4] = o[4] + d[4] * f;
-        p[5] = o[5] + d[5] * f;
-        p[6] = o[6] + d[6] * f;
-        p[7] = o[7] + d[7] * f;
-        p[8] = o[8] + d[8] * f;
-        for(int ax=0; ax<9; ax++) p[ax] += g92offset[ax];
-        rotate(p[0], p[1], rotation_cos, rotation_sin);
-        for(int ax=0; ax<9; ax++) p[ax] += g5xoffset[ax];
-        PyList_SET_ITEM(segs, i,
+    if(!get_attr(canon, "rotation_cos", &t.rotation_cos)) return NULL;
+    if(!get_attr(canon, "rotation_sin", &t.rotation_sin)) return NULL;
+    if(!get_attr(canon, "g5x_offset_x", &t.g5x[0])) return NULL;
+    if(!get_attr(canon, "g5x_offset_y", &t.g5x[1])) return NULL;
+    if(!get_attr(canon, "g5x_offset_z", &t.g5x[2])) return NULL;
+    if(!get_attr(canon, "g5x_offset_a", &t.g5x[3])) return NULL;
+    if(!get_attr(canon, "g5x_offset_b", &t.g5x[4])) return NULL;
+    if(!get_attr(canon, "g5x_offset_c", &t.g5x[5])) return NULL;
+    if(!get_attr(canon, "g5x_offset_u", &t.g5x[6])) return NULL;
+    if(!get_attr(canon, "g5x_offset_v", &t.g5x[7])) return NULL;
+    if(!get_attr(canon, "g5x_offset_w", &t.g5x[8])) return NULL;
+    if(!get_attr(canon, "g92_offset_x", &t.g92[0])) return NULL;
+    if(!get_attr(canon, "g92_offset_y", &t.g92[1])) return NULL;
+    if(!get_attr(canon, "g92_offset_z", &t.g92[2])) return NULL;
+    if(!get_attr(canon, "g92_offset_a", &t.g92[3])) return NULL;
+    if(!get_attr(canon, "g92_offset_b", &t.g92[4])) return NULL;
+    if(!get_attr(canon, "g92_offset_c", &t.g92[5])) return NULL;
+    if(!get_attr(canon, "g92_offset_u", &t.g92[6])) return NULL;
+    if(!get_attr(canon, "g92_offset_v", &t.g92[7])) return NULL;
+    if(!get_attr(canon, "g92_offset_w", &t.g92[8])) return NULL;
+
+    std::vector<double> points;
+    arc_segments(o, t, plane, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w,
+            max_segments, tolerance, points);
+    PyObject *segs = PyList_New(points.size() / 9);
+    for(size_t i=0; i<points.size(); i+=9) {
+        const double *p = &points[i];
+        PyList_SET_ITEM(segs, i / 9,
             Py_BuildValue("ddddddddd", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]));
     }
-    for(int ax=0; ax<9; ax++) n[ax] += g92offset[ax];
-    rotate(n[0], n[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) n[ax] += g5xoffset[ax];
-    PyList_SET_ITEM(segs, steps-1,
-        Py_BuildValue("ddddddddd", n[0], n[1], n[2], n[3], n[4], n[5], n[6], n[7], n[8]));
     return segs;
 }
 
 static PyMethodDef gcode_methods[] = {
     {"parse", (PyCFunction)parse_file, METH_VARARGS, "Parse a G-Code file"},
+    {"preview", (PyCFunction)preview_file, METH_VARARGS,
+        "Start parsing a G-Code file in the background, keeping the moves"},
+    {"preview_progress", (PyCFunction)preview_progress, METH_NOARGS,
+        "(done, line, traverses, feeds, arc segments) of the preview"},
+    {"preview_segments", (PyCFunction)preview_segments, METH_VARARGS,
+        "The moves of one kind from the given index on, as packed records"},
+    {"preview_extents", (PyCFunction)preview_extents, METH_NOARGS,
+        "Extents of the preview's moves so far, like calc_extents"},
+    {"preview_wait", (PyCFunction)preview_wait, METH_NOARGS,
+        "Wait for the preview to finish; returns the same as parse"},
+    {"preview_abort", (PyCFunction)preview_abort, METH_NOARGS,
+        "Stop the preview and drop its moves"},
     {"strerror", (PyCFunction)rs274_strerror, METH_VARARGS,
         "Convert a numeric error to a string"},
     {"calc_extents", (PyCFunction)rs274_calc_extents, METH_VARARGS,
@@ -1201,6 +1715,10 @@ initgcode(void) {
     PyObject_SetAttrString(m, "MAX_ERROR", PyInt_FromLong(maxerror));
     PyObject_SetAttrString(m, "MIN_ERROR",
             PyInt_FromLong(INTERP_MIN_ERROR));
+    PyModule_AddIntConstant(m, "PREVIEW_TRAVERSE", PREVIEW_TRAVERSE);
+    PyModule_AddIntConstant(m, "PREVIEW_FEED", PREVIEW_FEED);
+    PyModule_AddIntConstant(m, "PREVIEW_ARCFEED", PREVIEW_ARCFEED);
+    PyModule_AddStringConstant(m, "PREVIEW_SEGMENT", PREVIEW_SEGMENT_FORMAT);
 }
 
 // vim:ts=8:sts=4:sw=4:et:
@@ -2888,9 +2888,7 @@ int Interp::save_settings(setup_pointer settings)
 {
       // the state is sprinkled all over _setup
       // collate state in _setup.active_* arrays
-      write_g_codes((block_pointer) NULL, settings);
-      write_m_codes((block_pointer) NULL, settings);
-      write_settings(settings);
+      write_active_codes((block_pointer) NULL, settings);
 
       // save in the current call frame
       active_g_codes((int *)settings->sub_context[settings->call_level].saved_g_codes);
@@ -2922,9 +2920,7 @@ int Interp::restore_settings(setup_pointer settings,
     CHKS((settings->call_level < 0), (_("BUG: restore to level %d !?")),settings->call_level);
 
     // linearize state
-    write_g_codes((block_pointer) NULL, settings);
-    write_m_codes((block_pointer) NULL, settings);
-    write_settings(settings);
+    write_active_codes((block_pointer) NULL, settings);
 
     char cmd[LINELEN];
     memset(cmd, 0, LINELEN);
@@ -2952,9 +2948,7 @@ int Interp::restore_settings(setup_pointer settings,
 	    strcpy(currentError,getSavedError());
 	    CHKS(status, _("M7x: restore_settings failed executing: '%s': %s"), cmd, currentError);
 	}
-	write_g_codes((block_pointer) NULL, settings);
-	write_m_codes((block_pointer) NULL, settings);
-	write_settings(settings);
+	write_active_codes((block_pointer) NULL, settings);
     }
 
     // TBD: any state deemed important to restore should be restored here
@@ -3187,6 +3181,7 @@ int Interp::convert_m(block_pointer block,       //!< pointer to a block of RS27
     // and then not worry about it through the program.  When you
     // finally unload the last tool, G43 mode is canceled.
 
+      sync_active_codes(settings);
       if ((settings->active_g_codes[9] == G_43) && ONCE(STEP_RETAIN_G43)) {
         if(settings->selected_pocket > 0) {
             struct block_struct g43;
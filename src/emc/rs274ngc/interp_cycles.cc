@@ -57,6 +57,8 @@ int Interp::convert_cycle_g81(block_pointer block,
                               double clear_z,    //!< z-value of clearance plane      
                               double bottom_z)   //!< value of z at bottom of cycle   
 {
+    if (FEATURE(COMPACT_CYCLES))
+        return cycle_drill(block, plane, x, y, bottom_z, clear_z, -1);
     cycle_feed(block, plane, x, y, bottom_z);
     cycle_traverse(block, plane, x, y, clear_z);
 
@@ -96,6 +98,8 @@ int Interp::convert_cycle_g82(block_pointer block,
                               double bottom_z,   //!< value of z at bottom of cycle   
                               double dwell)      //!< dwell time                      
 {
+  if (FEATURE(COMPACT_CYCLES))
+    return cycle_drill(block, plane, x, y, bottom_z, clear_z, dwell);
   cycle_feed(block, plane, x, y, bottom_z);
   DWELL(dwell);
   cycle_traverse(block, plane, x, y, clear_z);
@@ -2033,3 +2037,63 @@ int Interp::cycle_traverse(block_pointer block,
                           end2, end3, end1);
     return INTERP_OK;
 }
+
+/****************************************************************************/
+
+/*! cycle_drill
+
+Returned Value: int (INTERP_OK)
+
+Side effects:
+  DRILL_CYCLE is called.
+
+Called by:
+  convert_cycle_g81
+  convert_cycle_g82
+
+This writes the cycle_feed to (end1, end2, end3), the dwell (if dwell
+is not negative) and the cycle_traverse back to clear on the third
+axis of the plane as one DRILL_CYCLE command.
+
+*/
+
+int Interp::cycle_drill(block_pointer block,
+                        CANON_PLANE plane,       //!< currently selected plane  
+                        double end1,     //!< first coordinate value    
+                        double end2,     //!< second coordinate value   
+                        double end3,     //!< third coordinate value    
+                        double clear,    //!< third coordinate to retract to
+                        double dwell)    //!< dwell time, or -1 for none
+{
+    if (plane == CANON_PLANE_XY)
+        DRILL_CYCLE(block->line_number, end1, end2, end3,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    _setup.u_current, _setup.v_current, _setup.w_current,
+                    2, clear, dwell);
+    else if (plane == CANON_PLANE_YZ)
+        DRILL_CYCLE(block->line_number, end3, end1, end2,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    _setup.u_current, _setup.v_current, _setup.w_current,
+                    0, clear, dwell);
+    else if (plane == CANON_PLANE_XZ)
+        DRILL_CYCLE(block->line_number, end2, end3, end1,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    _setup.u_current, _setup.v_current, _setup.w_current,
+                    1, clear, dwell);
+    else if (plane == CANON_PLANE_UV)
+        DRILL_CYCLE(block->line_number, _setup.current_x, _setup.current_y, _setup.current_z,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    end1, end2, end3,
+                    8, clear, dwell);
+    else if (plane == CANON_PLANE_VW)
+        DRILL_CYCLE(block->line_number, _setup.current_x, _setup.current_y, _setup.current_z,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    end3, end1, end2,
+                    6, clear, dwell);
+    else // (plane == CANON_PLANE_UW)
+        DRILL_CYCLE(block->line_number, _setup.current_x, _setup.current_y, _setup.current_z,
+                    _setup.AA_current, _setup.BB_current, _setup.CC_current,
+                    end2, end3, end1,
+                    7, clear, dwell);
+    return INTERP_OK;
+}
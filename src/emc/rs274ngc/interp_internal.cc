@@ -312,6 +312,45 @@ int Interp::init_block(block_pointer block)      //!< pointer to a block to be i
 }
 
 
+/****************************************************************************/
+
+/*! block_is_constant
+
+Returned Value: bool
+   true if reading the line has no side effects and does not depend on
+   parameter values, so that read_items always produces the same block
+   for it: no parameters (#), no expressions ([), no semicolon comment
+   (which is executed while reading) and no O-word.
+
+Called by: parse_line
+
+*/
+
+bool Interp::block_is_constant(const char *line)
+{
+  int depth = 0;
+
+  for (; *line; line++) {
+    switch (*line) {
+    case '#':
+    case '[':
+    case ';':
+      return false;
+    case '(':
+      depth++;
+      break;
+    case ')':
+      depth--;
+      break;
+    case 'o':
+      if (depth == 0)
+        return false;
+      break;
+    }
+  }
+  return true;
+}
+
 /****************************************************************************/
 
 /*! parse_line
@@ -329,6 +368,11 @@ Side effects:
    One RS274 line is read into a block and the block is checked for
    errors. System parameters may be reset.
 
+   When _read() marks the line as re-read (loop bodies and subroutines)
+   and the line is constant, the read_items() result comes from
+   parsed_block_cache; enhance_block and the following steps always run
+   because they depend on the modal state.
+
 Called by:  Interp::read
 
 */
@@ -337,8 +381,33 @@ int Interp::parse_line(char *line,       //!< array holding a line of RS274 code
                       block_pointer block,      //!< pointer to a block to be filled     
                       setup_pointer settings)   //!< pointer to machine settings         
 {
-  CHP(init_block(block));
-  CHP(read_items(block, line, settings->parameters));
+  if (settings->parse_cache_ok && (settings->skipping_o == 0) &&
+      block_is_constant(line)) {
+    // the same text always reads into the same block, except for X
+    // which depends on the lathe diameter mode
+    std::string key(1, settings->lathe_diameter_mode ? 'd' : 'r');
+    key += line;
+    parsed_block_map_iterator it = settings->parsed_block_cache.find(key);
+    if (it != settings->parsed_block_cache.end()) {
+      // keep the fields init_block() does not reset
+      long offset = block->offset;
+      int saved_line_number = block->saved_line_number;
+      int phase = block->phase;
+      *block = it->second;
+      block->offset = offset;
+      block->saved_line_number = saved_line_number;
+      block->phase = phase;
+    } else {
+      CHP(init_block(block));
+      CHP(read_items(block, line, settings->parameters));
+      if (settings->parsed_block_cache.size() >= PARSED_BLOCK_CACHE_MAX)
+        settings->parsed_block_cache.clear();
+      settings->parsed_block_cache[key] = *block;
+    }
+  } else {
+    CHP(init_block(block));
+    CHP(read_items(block, line, settings->parameters));
+  }
 
   if(settings->skipping_o == 0)
   {
@@ -17,8 +17,11 @@
 #include "config.h"
 #include <limits.h>
 #include <stdio.h>
+#include <sys/types.h>
 #include <set>
 #include <map>
+#include <string>
+#include <vector>
 #include <bitset>
 #include "canon.hh"
 #include "emcpos.h"
@@ -264,6 +267,11 @@ RETRACT_MODE;
 // string table - to get rid of strdup/free
 const char *strstore(const char *s);
 
+// open an NC code file for reading, mapped if it is a regular file;
+// while ngc_fopen_log is set, the name of each file opened is added to it
+FILE *ngc_fopen(const char *filename);
+extern std::vector<std::string> *ngc_fopen_log;
+
 
 // Block execution phases in execution order
 // very carefully check code for sequencing when
@@ -337,6 +345,9 @@ typedef remap_map::iterator remap_iterator;
 typedef std::map<int, remap_pointer> int_remap_map;
 typedef int_remap_map::iterator int_remap_iterator;
 
+// M codes, and G codes times ten, below this can be remapped
+#define REMAP_CODES 1000
+
 #define REMAP_FUNC(r) (r->remap_ngc ? r->remap_ngc: \
 		       (r->remap_py ? r->remap_py : "BUG-no-remap-func"))
 
@@ -495,6 +506,16 @@ typedef parameter_value *parameter_pointer;
 typedef std::map<const char *, parameter_value, nocase_cmp> parameter_map;
 typedef parameter_map::iterator parameter_map_iterator;
 
+// per-frame open addressing table from strstore()'d names to their
+// named_params entries, so lookups by an interned name skip the
+// case-insensitive map walk; see find_param_entry()
+#define NAMED_PARAM_SLOTS 64    // must be a power of two
+
+typedef struct named_param_slot_struct {
+    const char *name;
+    parameter_pointer param;
+} named_param_slot;
+
 #define PA_READONLY	1
 #define PA_GLOBAL	2
 #define PA_UNSET	4
@@ -506,6 +527,10 @@ typedef parameter_map::iterator parameter_map_iterator;
 // flag initialization of r/o parameter
 #define OVERRIDE_READONLY 1
 
+// setup.named_params_state: the predefined named parameters are
+// not there yet, being added, or there
+enum named_params_states { NP_NONE, NP_ADDING, NP_READY };
+
 #define MAX_REMAPOPTS 20
 // current implementation limits - legal modal groups
 // for M and G codes
@@ -519,6 +544,8 @@ typedef struct context_struct {
     const char *subName;       // name of the subroutine (oword)
     double saved_params[INTERP_SUB_PARAMS];
     parameter_map named_params;
+    named_param_slot param_slots[NAMED_PARAM_SLOTS];
+    int param_slots_used;
     unsigned char context_status;		// see CONTEXT_ defines below
     int saved_g_codes[ACTIVE_G_CODES];  // array of active G codes
     int saved_m_codes[ACTIVE_M_CODES];  // array of active M codes
@@ -552,6 +579,82 @@ typedef struct offset_struct {
 typedef std::map<const char *, offset, nocase_cmp> offset_map_type;
 typedef std::map<const char *, offset, nocase_cmp>::iterator offset_map_iterator;
 
+// where the subs of a file start and end, kept across program runs so
+// a sub in a file read before is reached with a seek.  A file's labels
+// are dropped when its size, mtime or inode no longer match.
+typedef struct sub_label_struct {
+  long offset;              // the o<name> sub line
+  int sequence_number;
+  long end_offset;          // the o<name> endsub line, -1 if not seen
+  int end_sequence_number;
+} sub_label;
+
+typedef std::map<std::string, sub_label> sub_label_map_type;
+
+typedef struct sub_label_file_struct {
+  long size;
+  time_t mtime;
+  long mtime_nsec;
+  ino_t inode;
+  sub_label_map_type labels;  // by o-word name
+} sub_label_file;
+
+typedef std::map<std::string, sub_label_file> sub_label_index_type;
+
+// the .ngc files in the subroutines[] directories and the wizard_root
+// tree, by file name, and the directories they were found in
+typedef std::map<std::string, std::string> sub_index_map_type;
+typedef std::vector<std::pair<std::string, time_t> > sub_index_dirs_type;
+
+// read_items() results for lines without parameters or expressions,
+// keyed by the block text; see parse_line()
+typedef std::map<std::string, block> parsed_block_map_type;
+typedef std::map<std::string, block>::iterator parsed_block_map_iterator;
+#define PARSED_BLOCK_CACHE_MAX 4096
+
+// bracketed expressions compiled to a small stack program, keyed by
+// the expression text; see read_cached_expression()
+enum expr_opcodes {
+  EXPR_PUSH,            // push value
+  EXPR_PARAM,           // push parameters[arg]
+  EXPR_PARAM_INDIRECT,  // replace top with parameters[top]
+  EXPR_NAMED,           // push named parameter name
+  EXPR_EXISTS_NAMED,    // push 1 if named parameter name exists, else 0
+  EXPR_EXISTS_INDIRECT, // replace top with 1 if top is a valid index, else 0
+  EXPR_NEG,             // negate top
+  EXPR_BINARY,          // apply binary operation arg to the top two
+  EXPR_UNARY,           // apply unary operation arg to top
+  EXPR_ATAN,            // atan of the top two, in degrees
+  EXPR_CHECK            // fail if top is nan or infinite
+};
+
+typedef struct expr_op_struct {
+  int opcode;
+  int arg;
+  double value;
+  const char *name;     // strstore()'d
+} expr_op;
+
+typedef struct expr_code_struct {
+  std::vector<expr_op> ops;
+  int depth;            // stack depth while compiling
+  int max_depth;
+} expr_code;
+
+// resolved #<_hal[...]> references, see fetch_hal_param()
+typedef struct hal_ref_struct {
+  int type;             // hal_type_t
+  void *ptr;            // hal_data_u in HAL shared memory
+} hal_ref;
+
+typedef std::map<std::string, hal_ref> hal_ref_map_type;
+typedef std::map<std::string, hal_ref>::iterator hal_ref_map_iterator;
+
+typedef std::map<std::string, expr_code> parsed_expr_map_type;
+typedef std::map<std::string, expr_code>::iterator parsed_expr_map_iterator;
+#define PARSED_EXPR_CACHE_MAX 4096
+#define EXPR_STACK_MAX 32
+
 /*
 
 The current_x, current_y, and current_z are the location of the tool
@@ -589,6 +692,9 @@ typedef struct setup_struct
   int active_g_codes[ACTIVE_G_CODES];  // array of active G codes
   int active_m_codes[ACTIVE_M_CODES];  // array of active M codes
   double active_settings[ACTIVE_SETTINGS];     // array of feed, speed, etc.
+  bool active_codes_stale;      // active_* arrays wait for sync_active_codes()
+  int active_block_modes[3];    // g_modes[0], m_modes[4], m_modes[6] of the last block
+  int active_sequence_number;   // sequence_number when it was executed
   bool arc_not_allowed;       // we just exited cutter compensation, so we error if the next move isn't straight
   double axis_offset_x;         // X-axis g92 offset
   double axis_offset_y;         // Y-axis g92 offset
@@ -640,6 +746,13 @@ typedef struct setup_struct
   double origin_offset_z;       // g5x offset z
   double rotation_xy;         // rotation of coordinate system around Z, in degrees
   double parameters[RS274NGC_MAX_PARAMETERS];   // system parameters
+  // the parameter file as the last restore or save left it, so that
+  // save_parameters can leave it alone when none of its entries changed
+  std::string saved_file;
+  std::map<int, double> saved_parameters;
+  ino_t saved_ino;
+  off_t saved_size;
+  time_t saved_mtime;
   int parameter_occurrence;     // parameter buffer index
   int parameter_numbers[MAX_NAMED_PARAMETERS];    // parameter number buffer
   double parameter_values[MAX_NAMED_PARAMETERS];  // parameter value buffer
@@ -691,6 +804,16 @@ typedef struct setup_struct
   context sub_context[INTERP_SUB_ROUTINE_LEVELS];
   int call_state;                  //  enum call_states - inidicate Py handler reexecution
   offset_map_type offset_map;      // store label x name, file, line
+  sub_label_index_type sub_labels; // sub offsets by file, survive reset
+  parsed_block_map_type parsed_block_cache; // parsed constant lines
+  parsed_expr_map_type parsed_expr_cache;   // compiled expressions
+  hal_ref_map_type hal_ref_cache;  // HAL names resolved by fetch_hal_param
+  unsigned int hal_ref_generation; // hal_data->generation when resolved
+  unsigned long outside_reads;     // HAL values and Python calls, which task's
+                                   // canon cache can't tell the outcome of
+  bool parse_cache_ok;             // current line is being re-read, may use the cache
+  char read_high_water_file[PATH_MAX]; // file and furthest offset read in it
+  long read_high_water;
 
   bool adaptive_feed;              // adaptive feed is enabled
   bool feed_hold;                  // feed hold is enabled
@@ -703,6 +826,10 @@ typedef struct setup_struct
                                      // the input file
   int lazy_closing;                  // close has been called
   char wizard_root[PATH_MAX];
+  sub_index_map_type sub_index;    // file name -> path, first found wins
+  sub_index_dirs_type sub_index_dirs; // directories indexed, with their mtime
+  time_t sub_index_time;           // when the index was built, 0 if never
+  bool sub_index_checked;          // mtimes checked since the last reset
   int tool_change_at_g30;
   int tool_change_quill_up;
   int tool_change_with_spindle_on;
@@ -725,23 +852,38 @@ typedef struct setup_struct
     // do not lowercase named params inside comments - for #<_hal[PinName]>
 #define FEATURE_NO_DOWNCASE_OWORD    0x00000010
 #define FEATURE_OWORD_WARNONLY       0x00000020
+#define FEATURE_COMPACT_CYCLES       0x00000040
 
     boost::python::object pythis;  // boost::cref to 'this'
+    boost::python::object pyself;  // (pythis,), the args of remap handlers
     const char *on_abort_command;
     int_remap_map  g_remapped,m_remapped;
     remap_map remaps;
+    // the codes with an entry in g_remapped, m_remapped, and the letters
+    // (T, S, F) in remaps, so the blocks that remap nothing
+    // need no map lookups
+    std::bitset<REMAP_CODES> g_remap_bits, m_remap_bits;
+    std::bitset<26> letter_remap_bits;
 #define INIT_FUNC  "__init__"
 
     // task calls upon interp.init() repeatedly
     // protect init() operations which are not idempotent
     int init_once;  
+
+    // the predefined named parameters are added on the first reference
+    // to a named parameter, see need_named_parameters()
+    int named_params_state;  // NP_NONE, NP_ADDING or NP_READY
+    // the inifile naming a [PYTHON]TOPLEVEL, if init() found one; the
+    // plugin is set up on first use, see python_usable()
+    const char *py_inifile;
+    bool py_ready;  // python_usable() has set up this interpreter
 } setup;
 
 typedef setup *setup_pointer;
 // the externally visible singleton instance
 
 extern    PythonPlugin *python_plugin;
-#define PYUSABLE (((python_plugin) != NULL) && (python_plugin->usable()))
+#define PYUSABLE (python_usable())
 
 inline bool is_a_cycle(int motion) {
     return ((motion > G_80) && (motion < G_90)) || (motion == G_73);
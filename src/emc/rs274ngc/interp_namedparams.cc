@@ -214,7 +214,8 @@ int Interp::fetch_ini_param( const char *nameBuf, int *status, double *value)
 
 // if the variable is of the form '_hal[hal_name]', then treat it as
 // a HAL pin, signal or param. Lookup value, convert to float, and export as global and read-only.
-// do not cache.
+// the value is not cached, but the location of the data is, until
+// hal_data->generation says pins, signals or params have changed.
 // the shortest possible ini variable is '_hal[x]' or 7 chars long .
 int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
 {
@@ -241,6 +242,8 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
 	hal_pin_t *pin;
 	hal_sig_t *sig;
 	hal_param_t *param;
+	hal_ref_map_iterator hi;
+	hal_ref ref;
 
 	strncpy(hal_name, &nameBuf[5], closeBracket);
 	hal_name[closeBracket - 5] = '\0';
@@ -249,40 +252,53 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
 	    *status = 0;
 	    ERS("%s: trailing garbage after closing bracket", nameBuf);
 	}
-	// the result of these lookups could be cached in the parameter struct, but I'm not sure
-	// this is a good idea - a removed pin/signal will not be noticed
-
-	// I dont think that's needed - no change in pins/sigs/params
-	// rtapi_mutex_get(&(hal_data->mutex)); 
-        // rtapi_mutex_give(&(hal_data->mutex));
+	// a removed, renamed or relinked pin/signal/param bumps the generation
+	if (_setup.hal_ref_generation != hal_data->generation) {
+	    _setup.hal_ref_cache.clear();
+	    _setup.hal_ref_generation = hal_data->generation;
+	}
+	hi = _setup.hal_ref_cache.find(hal_name);
+	if (hi != _setup.hal_ref_cache.end()) {
+	    type = hi->second.type;
+	    ptr = (hal_data_u *) hi->second.ptr;
+	    goto assign;
+	}
 
+	rtapi_mutex_get(&(hal_data->mutex));
+	ptr = NULL;
 	if ((pin = halpr_find_pin_by_name(hal_name)) != NULL) {
-            if (pin && !pin->signal) {
-		logOword("%s: no signal connected", hal_name);
-	    } 
 	    type = pin->type;
-	    hal_sig_t * sig = (hal_sig_t *) SHMPTR(pin->signal);
-	    ptr = (hal_data_u *) SHMPTR(sig->data_ptr);
-	    goto assign;
-	}
-	if ((sig = halpr_find_sig_by_name(hal_name)) != NULL) {
+	    if (!pin->signal) {
+		logOword("%s: no signal connected", hal_name);
+		ptr = &pin->dummysig;
+	    } else {
+		sig = (hal_sig_t *) SHMPTR(pin->signal);
+		ptr = (hal_data_u *) SHMPTR(sig->data_ptr);
+	    }
+	} else if ((sig = halpr_find_sig_by_name(hal_name)) != NULL) {
 	    if (!sig->writers) 
 		logOword("%s: signal has no writer", hal_name);
 	    type = sig->type;
 	    ptr = (hal_data_u *) SHMPTR(sig->data_ptr);
-	    goto assign;
-	}
-	if ((param = halpr_find_param_by_name(hal_name)) != NULL) {
+	} else if ((param = halpr_find_param_by_name(hal_name)) != NULL) {
 	    type = param->type;
 	    ptr = (hal_data_u *) SHMPTR(param->data_ptr);
-	    goto assign;
 	}
+	if (ptr != NULL && _setup.hal_ref_generation == hal_data->generation) {
+	    ref.type = type;
+	    ref.ptr = ptr;
+	    _setup.hal_ref_cache[hal_name] = ref;
+	}
+	rtapi_mutex_give(&(hal_data->mutex));
+	if (ptr != NULL)
+	    goto assign;
 	*status = 0;
 	ERS("Named hal parameter #<%s> not found", nameBuf);
     }
     return INTERP_OK;
 
     assign:
+    _setup.outside_reads++;
     switch (type) {
     case HAL_BIT: *value = (double) (ptr->b); break;
     case HAL_U32: *value = (double) (ptr->u); break;
@@ -294,22 +310,77 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
     return INTERP_OK; 
 }
 
+// Locate the named_params entry for nameBuf in frame, or return NULL.
+// If the caller guarantees nameBuf came from strstore(), the pointer
+// itself identifies the name and is remembered in the frame's slot
+// table, so the next lookup is a hash probe instead of a map walk.
+// Map insertions leave entries in place; anything that erases entries
+// or may have changed the map (Python code) must clear the slots.
+parameter_pointer Interp::find_param_entry(context_pointer frame,
+					   const char *nameBuf,
+					   bool interned)
+{
+  named_param_slot *slot = NULL;
+  parameter_map_iterator pi;
+
+  if (interned) {
+      unsigned h = ((unsigned long) nameBuf >> 3) & (NAMED_PARAM_SLOTS - 1);
+
+      // never more than half full, so this terminates
+      while (frame->param_slots[h].name != NULL) {
+	  if (frame->param_slots[h].name == nameBuf)
+	      return frame->param_slots[h].param;
+	  h = (h + 1) & (NAMED_PARAM_SLOTS - 1);
+      }
+      slot = &frame->param_slots[h];
+  }
+  pi = frame->named_params.find(nameBuf);
+  if (pi == frame->named_params.end())
+      return NULL;
+  if (slot && frame->param_slots_used < NAMED_PARAM_SLOTS / 2) {
+      slot->name = nameBuf;
+      slot->param = &pi->second;
+      frame->param_slots_used++;
+  }
+  return &pi->second;
+}
+
+void Interp::clear_param_slots(context_pointer frame)
+{
+    memset(frame->param_slots, 0, sizeof(frame->param_slots));
+    frame->param_slots_used = 0;
+}
+
+void Interp::clear_all_param_slots()
+{
+    for (int i = 0; i < INTERP_SUB_ROUTINE_LEVELS; i++)
+	clear_param_slots(&_setup.sub_context[i]);
+}
+
 int Interp::find_named_param(
     const char *nameBuf, //!< pointer to name to be read
     int *status,    //!< pointer to return status 1 => found
-    double *value   //!< pointer to value of found parameter
+    double *value,  //!< pointer to value of found parameter
+    bool interned   //!< nameBuf was returned by strstore()
     )
 {
   context_pointer frame;
-  parameter_map_iterator pi;
+  parameter_pointer pv;
   int level;
 
+  CHP(need_named_parameters());
   level = (nameBuf[0] == '_') ? 0 : _setup.call_level; // determine scope
   frame = &_setup.sub_context[level];
   *status = 0;
 
-  pi = frame->named_params.find(nameBuf);
-  if (pi == frame->named_params.end()) { // not found
+  pv = find_param_entry(frame, nameBuf, interned);
+  if ((pv == NULL) && level == 0 && _setup.py_inifile && !_setup.py_ready &&
+      _setup.named_params_state == NP_READY) {
+      // may be one of the namedparams module's, which come with the plugin
+      python_usable();
+      pv = find_param_entry(frame, nameBuf, interned);
+  }
+  if (pv == NULL) { // not found
       int exists = 0;
       double inivalue;
       if (FEATURE(INI_VARS) && (strncasecmp(nameBuf,"_ini[",5) == 0)) {
@@ -337,7 +408,6 @@ int Interp::find_named_param(
       *value = 0.0;
       *status = 0;
   } else {
-      parameter_pointer pv = &pi->second;
       if (pv->attr & PA_UNSET)
 	  logNP("warning: referencing unset variable '%s'",nameBuf);
       if (pv->attr & PA_USE_LOOKUP) {
@@ -352,6 +422,7 @@ int Interp::find_named_param(
 	  kwargs = bp::dict();
 
 	  python_plugin->call(NAMEDPARAMS_MODULE, nameBuf, tupleargs, kwargs, retval);
+	  clear_all_param_slots();
 	  CHKS(python_plugin->plugin_status() == PLUGIN_EXCEPTION,
 	       "named param - pycall(%s):\n%s", nameBuf,
 	       python_plugin->last_exception().c_str());
@@ -392,22 +463,22 @@ int Interp::find_named_param(
 int Interp::store_named_param(setup_pointer settings,
     const char *nameBuf, //!< pointer to name to be written
     double value,   //!< value to be written
-    int override_readonly  //!< set to true to init a r/o parameter
+    int override_readonly,  //!< set to true to init a r/o parameter
+    bool interned   //!< nameBuf was returned by strstore()
     )
 {
   context_pointer frame;
   int level;
-  parameter_map_iterator pi;
+  parameter_pointer pv;
 
+  CHP(need_named_parameters());
   level = (nameBuf[0] == '_') ? 0 : _setup.call_level; // determine scope
   frame = &settings->sub_context[level];
 
-  pi = frame->named_params.find(nameBuf);
-  if (pi == frame->named_params.end()) {
+  pv = find_param_entry(frame, nameBuf, interned);
+  if (pv == NULL) {
       ERS(_("Internal error: Could not assign #<%s>"), nameBuf);
   } else {
-      parameter_pointer pv = &pi->second;
-
       CHKS(((pv->attr & PA_GLOBAL)  && level),
 	   "BUG: variable '%s' marked global, but assigned at level %d", nameBuf, level);
 
@@ -460,6 +531,7 @@ int Interp::add_named_param(
 int Interp::free_named_parameters(context_pointer frame)
 {
     frame->named_params.clear();
+    clear_param_slots(frame);
     return INTERP_OK;
 }
 
@@ -733,6 +805,7 @@ int Interp::init_python_predef_parameter(const char *name)
 	if (exists) {
 	    fprintf(stderr, "warning: redefining named parameter %s\n",name);
 	    _setup.sub_context[0].named_params.erase(name);
+	    clear_param_slots(&_setup.sub_context[0]);
 	}
 	param.value = 0.0;
 	param.attr = PA_READONLY|PA_PYTHON|PA_GLOBAL;
@@ -741,6 +814,20 @@ int Interp::init_python_predef_parameter(const char *name)
     return INTERP_OK;
 }
 
+// The predefined named parameters are a few dozen map entries that a
+// preview or a program without named parameters never looks at, so they
+// are added on the first lookup or assignment rather than by the
+// constructor.
+int Interp::need_named_parameters()
+{
+    if (_setup.named_params_state != NP_NONE)
+	return INTERP_OK;
+    _setup.named_params_state = NP_ADDING; // init_named_parameters() looks them up
+    CHP(init_named_parameters());
+    _setup.named_params_state = NP_READY;
+    return INTERP_OK;
+}
+
 int Interp::init_named_parameters()
 {
 
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <time.h>
 #include "rs274ngc.hh"
 #include "rs274ngc_return.hh"
 #include "interp_return.hh"
@@ -35,47 +36,162 @@ namespace bp = boost::python;
 //========================================================================
 
 /*
-  Given the root of a directory tree and a file name,
-  find the path to the file, if any.
+  Subroutine files are found through an index of the .ngc files in the
+  SUBROUTINE_PATH directories and, recursively, the WIZARD_ROOT tree,
+  rather than by searching them on every first call.  It is built when
+  first needed; after a reset the first lookup checks the mtime of every
+  directory that was indexed, and builds it again if any has changed.
 */
 
-int Interp::findFile( // ARGUMENTS
-		     char *direct,  // the directory to start looking in
-		     char *target,  // the name of the file to find
-		     char *foundFileDirect) // where to store the result
+static bool is_ngc_name(const char *name)
+{
+    size_t n = strlen(name);
+
+    return n > 4 && strcmp(name + n - 4, ".ngc") == 0;
+}
+
+// add the .ngc files in direct, and with recurse the ones in the
+// directories below it, to the index; a name already in it stays
+void Interp::index_sub_dir(setup_pointer settings, const char *direct,
+			   bool recurse)
 {
-    FILE *file;
     DIR *aDir;
     struct dirent *aFile;
-    char targetPath[PATH_MAX+1];
-
-    snprintf(targetPath, PATH_MAX, "%s/%s", direct, target);
-    file = fopen(targetPath, "r");
-    if (file) {
-        strncpy(foundFileDirect, direct, PATH_MAX);
-        fclose(file);
-        return INTERP_OK;
-    }
-    aDir = opendir(direct);
-    if (!aDir) {
-	ERS(NCE_FILE_NOT_OPEN);
-    }
+    struct stat st;
+    std::vector<std::string> subdirs;
+    std::string path;
 
+    if (stat(direct, &st) != 0 || (aDir = opendir(direct)) == NULL) {
+	return;
+    }
+    settings->sub_index_dirs.push_back(std::make_pair(std::string(direct),
+						      st.st_mtime));
     while ((aFile = readdir(aDir))) {
-        if (aFile->d_type == DT_DIR &&
-	    (0 != strcmp(aFile->d_name, "..")) &&
-	    (0 != strcmp(aFile->d_name, "."))) {
-
-            char path[PATH_MAX+1];
-            snprintf(path, PATH_MAX, "%s/%s", direct, aFile->d_name);
-            if (INTERP_OK == findFile(path, target, foundFileDirect)) {
-	        closedir(aDir);
-                return INTERP_OK;
-            }
-        }
+	if (!strcmp(aFile->d_name, ".") || !strcmp(aFile->d_name, "..")) {
+	    continue;
+	}
+	path = std::string(direct) + "/" + aFile->d_name;
+	if (aFile->d_type == DT_DIR ||
+	    (aFile->d_type == DT_UNKNOWN && stat(path.c_str(), &st) == 0 &&
+	     S_ISDIR(st.st_mode))) {
+	    // files right here come before the ones further down
+	    if (recurse) {
+		subdirs.push_back(path);
+	    }
+	} else if (is_ngc_name(aFile->d_name)) {
+	    settings->sub_index.insert(std::make_pair(std::string(aFile->d_name),
+						      path));
+	}
     }
     closedir(aDir);
-    ERS(NCE_FILE_NOT_OPEN);
+    for (size_t i = 0; i < subdirs.size(); i++) {
+	index_sub_dir(settings, subdirs[i].c_str(), true);
+    }
+}
+
+void Interp::build_sub_index(setup_pointer settings)
+{
+    int dct;
+
+    settings->sub_index.clear();
+    settings->sub_index_dirs.clear();
+    settings->sub_index_time = time(NULL);
+    for (dct = 0; dct < MAX_SUB_DIRS; dct++) {
+	if (settings->subroutines[dct]) {
+	    index_sub_dir(settings, settings->subroutines[dct], false);
+	}
+    }
+    if (settings->wizard_root[0]) {
+	index_sub_dir(settings, settings->wizard_root, true);
+    }
+    settings->sub_index_checked = true;
+    logOword("subroutine index: %d files in %d directories",
+	     (int) settings->sub_index.size(),
+	     (int) settings->sub_index_dirs.size());
+}
+
+// the path to name in the subroutine dirs or the wizard tree, or NULL
+const char *Interp::find_sub_index(setup_pointer settings, const char *name)
+{
+    struct stat st;
+    sub_index_map_type::iterator it;
+    size_t i;
+
+    if (settings->sub_index_time == 0) {
+	build_sub_index(settings);
+    } else if (!settings->sub_index_checked) {
+	settings->sub_index_checked = true;
+	for (i = 0; i < settings->sub_index_dirs.size(); i++) {
+	    // a change in the second the index was built may have been missed
+	    if (stat(settings->sub_index_dirs[i].first.c_str(), &st) != 0 ||
+		st.st_mtime != settings->sub_index_dirs[i].second ||
+		st.st_mtime >= settings->sub_index_time) {
+		build_sub_index(settings);
+		break;
+	    }
+	}
+    }
+    it = settings->sub_index.find(name);
+    if (it == settings->sub_index.end()) {
+	return NULL;
+    }
+    return it->second.c_str();
+}
+
+/*
+  The offsets of the o<name> sub and endsub lines of the files read are
+  kept in sub_labels, which reset() leaves alone.  When a sub is defined
+  again in a file that has not changed, the definition seeks straight to
+  the endsub instead of reading through the body, and a call into a sub
+  file seeks straight to the sub line.
+*/
+
+// what is known about the current file, forgotten first if the file
+// changed; NULL if there is no file
+static sub_label_file *current_label_file(setup_pointer settings)
+{
+    struct stat st;
+
+    if (settings->file_pointer == NULL || settings->filename[0] == 0 ||
+	stat(settings->filename, &st) != 0) {
+	return NULL;
+    }
+    sub_label_file &file = settings->sub_labels[settings->filename];
+    if (file.size != (long) st.st_size || file.mtime != st.st_mtime ||
+	file.mtime_nsec != st.st_mtim.tv_nsec || file.inode != st.st_ino) {
+	file.labels.clear();
+	file.size = st.st_size;
+	file.mtime = st.st_mtime;
+	file.mtime_nsec = st.st_mtim.tv_nsec;
+	file.inode = st.st_ino;
+    }
+    return &file;
+}
+
+sub_label *Interp::find_sub_label(setup_pointer settings, const char *name)
+{
+    sub_label_file *file = current_label_file(settings);
+    sub_label_map_type::iterator it;
+
+    if (file == NULL) {
+	return NULL;
+    }
+    it = file->labels.find(name);
+    if (it == file->labels.end()) {
+	return NULL;
+    }
+    return &it->second;
+}
+
+sub_label *Interp::save_sub_label(setup_pointer settings, const char *name)
+{
+    sub_label_file *file = current_label_file(settings);
+    sub_label fresh = { -1, 0, -1, 0 };
+
+    if (file == NULL) {
+	return NULL;
+    }
+    return &file->labels.insert(std::make_pair(std::string(name), fresh)).first->second;
 }
 
 
@@ -107,6 +223,16 @@ int Interp::control_save_offset(block_pointer block,        /* pointer to a bloc
     // the proper value
     new_offset.sequence_number = settings->sequence_number - 1;
     settings->offset_map[block->o_name] = new_offset;
+
+    if (block->o_type == O_sub) {
+	sub_label *label = save_sub_label(settings, block->o_name);
+
+	if (label && label->offset != block->offset) {
+	    label->offset = block->offset;
+	    label->sequence_number = new_offset.sequence_number;
+	    label->end_offset = -1;
+	}
+    }
     return INTERP_OK;
 }
 
@@ -277,8 +403,7 @@ int Interp::execute_call(setup_pointer settings,
 	    if (remap->remap_py || remap->prolog_func || remap->epilog_func) {
 		CHKS(!PYUSABLE, "%s (remapped) uses Python functions, but the Python plugin is not available", 
 		     remap->name);
-		plist.append(settings->pythis);   //self
-		current_frame->tupleargs = bp::tuple(plist);
+		current_frame->tupleargs = settings->pyself;
 		current_frame->kwargs = bp::dict();
 	    }
 	    if (remap->argspec && (strchr(remap->argspec, '@') == NULL)) {
@@ -407,7 +532,7 @@ int Interp::execute_return(setup_pointer settings, context_pointer current_frame
 		//!!!KL must open the new file, if changed
 		if (0 != strcmp(settings->filename, previous_frame->filename))  {
 		    fclose(settings->file_pointer);
-		    settings->file_pointer = fopen(previous_frame->filename, "r");
+		    settings->file_pointer = ngc_fopen(previous_frame->filename);
 		    strcpy(settings->filename, previous_frame->filename);
 		}
 		fseek(settings->file_pointer, previous_frame->position, SEEK_SET);
@@ -436,6 +561,12 @@ int Interp::execute_return(setup_pointer settings, context_pointer current_frame
 	    // a definition
 	    if (eblock->o_type == O_endsub) {
 		CHKS((settings->defining_sub != 1), NCE_NOT_IN_SUBROUTINE_DEFN);
+		// remember where the definition ends for the next run
+		sub_label *label = find_sub_label(settings, settings->sub_name);
+		if (label) {
+		    label->end_offset = eblock->offset;
+		    label->end_sequence_number = settings->sequence_number - 1;
+		}
 		// no longer skipping or defining
 		if (settings->skipping_o)  {
 		    logOword("case O_endsub in defn -- no longer skipping to:|%s|",
@@ -483,7 +614,7 @@ int Interp::control_back_to( block_pointer block, // pointer to block
 	if (0 != strcmp(settings->filename,
 			op->filename)) {
 	    // open the new file...
-	    newFP = fopen(op->filename, "r");
+	    newFP = ngc_fopen(op->filename);
 	    // set the line number
 	    settings->sequence_number = 0;
 	    strcpy(settings->filename, op->filename);
@@ -516,6 +647,13 @@ int Interp::control_back_to( block_pointer block, // pointer to block
 	    fclose(settings->file_pointer);
 	settings->file_pointer = newFP;
 	strcpy(settings->filename, newFileName);
+
+	// the sub line is known from an earlier call: go straight to it
+	sub_label *label = find_sub_label(settings, block->o_name);
+	if (label) {
+	    fseek(settings->file_pointer, label->offset, SEEK_SET);
+	    settings->sequence_number = label->sequence_number;
+	}
     } else {
 	char *dirname = get_current_dir_name();
 	logOword("fopen: |%s| failed CWD:|%s|", newFileName,
@@ -695,6 +833,17 @@ int Interp::convert_control_functions(block_pointer block, // pointer to a block
 	    settings->defining_sub = 1;
 	    settings->sub_name = block->o_name;
 	    logOword("will now skip to: |%s|", settings->sub_name);
+
+	    // defined here before and the file is the same: the body
+	    // needn't be read to find the endsub
+	    sub_label *label = find_sub_label(settings, block->o_name);
+	    if (label && label->offset == block->offset &&
+		label->end_offset >= 0) {
+		logOword("seeking to the endsub of |%s| at %ld",
+			 block->o_name, label->end_offset);
+		fseek(settings->file_pointer, label->end_offset, SEEK_SET);
+		settings->sequence_number = label->end_sequence_number;
+	    }
 	}
 	break;
 
@@ -93,6 +93,118 @@ bool Interp::is_pycallable(setup_pointer settings,
     return python_plugin->is_callable(module,funcname);
 }
 
+// True if init() found a [PYTHON]TOPLEVEL, so REMAP= may name Python
+// handlers; unlike PYUSABLE this does not load the plugin.
+bool Interp::python_configured()
+{
+    return (_setup.py_inifile != NULL) ||
+	((python_plugin != NULL) && python_plugin->usable());
+}
+
+// What PYUSABLE means. The plugin is set up on the first call rather
+// than by init(), so an interpreter that never runs Python code - like
+// a preview of a plain G-code file - never imports the toplevel module.
+bool Interp::python_usable()
+{
+    if (!_setup.py_ready && _setup.py_inifile) {
+	_setup.py_ready = true;
+	if (init_python() != INTERP_OK)
+	    Error("PYTHON: %s", getSavedError());
+    }
+    return (python_plugin != NULL) && python_plugin->usable();
+}
+
+// configure the plugin singleton, which imports the toplevel module once
+// per process, export this interpreter as 'interpreter.this', add the
+// namedparams module's predefined parameters, check the REMAP= Python
+// handlers and call __init__(self) in the toplevel module if defined
+int Interp::init_python()
+{
+    extern struct _inittab builtin_modules[];
+
+    if (PythonPlugin::configure(_setup.py_inifile, "PYTHON", builtin_modules) == NULL) {
+	ERS("no Python plugin available");
+    }
+    try {
+	// this import will register the C++->Python converter for Interp
+	bp::object interp_module = bp::import("interpreter");
+
+	// use a boost::cref to avoid per-call instantiation of the
+	// Interp Python wrapper (used for the 'self' parameter in handlers)
+	// this runs once per Interp, so user attributes tacked onto
+	// the wrapper survive repeated init() calls
+	_setup.pythis =  boost::python::object(boost::cref(this));
+	_setup.pyself = bp::make_tuple(_setup.pythis);
+
+	// alias to 'interpreter.this' for the sake of ';py, .... ' comments
+	bp::scope(interp_module).attr("this") =  _setup.pythis;
+    }
+    catch (bp::error_already_set) {
+	std::string exception_msg;
+	if (PyErr_Occurred()) {
+	    exception_msg = handle_pyerror();
+	} else
+	    exception_msg = "unknown exception";
+	bp::handle_exception();
+	PyErr_Clear();
+	ERS("exception during 'this' export:\n%s\n",exception_msg.c_str());
+    }
+    CHP(need_named_parameters());
+    // initialize any python global predefined named parameters
+    // walk the namedparams module for callables and add their names as predefs
+    try {
+	bp::object npmod =  python_plugin->main_namespace[NAMEDPARAMS_MODULE];
+	bp::dict predef_dict = bp::extract<bp::dict>(npmod.attr("__dict__"));
+	bp::list iterkeys = (bp::list) predef_dict.iterkeys();
+	for (int i = 0; i < bp::len(iterkeys); i++)  {
+	    std::string key = bp::extract<std::string>(iterkeys[i]);
+	    bp::object value = predef_dict[key];
+	    if (PyCallable_Check(value.ptr())) {
+		CHP(init_python_predef_parameter(key.c_str()));
+	    }
+	}
+    }
+    catch (bp::error_already_set) {
+	std::string exception_msg;
+	bool unexpected = false;
+	// KeyError is ok - this means the namedparams module doesnt exist
+	if (!PyErr_ExceptionMatches(PyExc_KeyError)) {
+	    // something else, strange
+	    exception_msg = handle_pyerror();
+	    unexpected = true;
+	}
+	bp::handle_exception();
+	PyErr_Clear();
+	CHKS(unexpected, "exception adding Python predefined named parameter: %s", exception_msg.c_str());
+    }
+
+    // parse_remap() left this to now
+    for (remap_iterator r = _setup.remaps.begin(); r != _setup.remaps.end(); r++) {
+	if (r->second.remap_py &&
+	    !python_plugin->is_callable(REMAP_MODULE, r->second.remap_py)) {
+	    Error("'%s' is not a Python callable function - REMAP %s",
+		  r->second.remap_py, r->second.name);
+	}
+    }
+
+    if (python_plugin->is_callable(NULL, INIT_FUNC)) {
+
+	bp::object retval, tupleargs, kwargs;
+	bp::list plist;
+
+	plist.append(_setup.pythis); // self
+	tupleargs = bp::tuple(plist);
+	kwargs = bp::dict();
+
+	python_plugin->call(NULL, INIT_FUNC, tupleargs, kwargs, retval);
+	clear_all_param_slots();
+	CHKS(python_plugin->plugin_status() == PLUGIN_EXCEPTION,
+	     "pycall(%s):\n%s", INIT_FUNC,
+	     python_plugin->last_exception().c_str());
+    }
+    return INTERP_OK;
+}
+
 // all parameters to/results from Python calls go through the callframe, which looks a bit awkward
 // the reason is not to expose boost.python through the interpreter public interface
 int Interp::pycall(setup_pointer settings,
@@ -112,6 +224,7 @@ int Interp::pycall(setup_pointer settings,
 
     CHKS(!PYUSABLE, "pycall(%s): Pyhton plugin not initialized",funcname);
     frame->py_return_type = 0;
+    settings->outside_reads++;	// Python can look at anything
 
     switch (calltype) {
     case PY_EXECUTE: // just run a string
@@ -162,6 +275,8 @@ int Interp::pycall(setup_pointer settings,
 	     "pycall(%s):\n%s", funcname,
 	     python_plugin->last_exception().c_str());
     }
+    // Python code may have replaced or erased named_params entries
+    clear_all_param_slots();
 
     try {
 	status = INTERP_OK;
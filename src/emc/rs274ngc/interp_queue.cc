@@ -52,9 +52,14 @@ static double latheorigin_z(setup_pointer settings, double z) {
 static double endpoint[2];
 static int endpoint_valid = 0;
 
+// the queue only ever holds the move whose endpoint is still to be
+// found and whatever was issued after it, and it is emptied at every
+// corner, so it is reserved once and clear() keeps the space after that.
+static const unsigned int qc_reserved = 64;
+
 std::vector<queued_canon>& qc(void) {
     static std::vector<queued_canon> c;
-    if(0) printf("len %d\n", (int)c.size());
+    if(c.capacity() < qc_reserved) c.reserve(qc_reserved);
     return c;
 }
 
@@ -394,6 +399,10 @@ void enqueue_START_CHANGE (void) {
 
 void qc_scale(double scale) {
     
+    // the endpoint is in the old units whether or not anything is queued
+    endpoint[0] *= scale;
+    endpoint[1] *= scale;
+
     if(qc().empty()) {
         if(debug_qc) printf("not scaling because qc is empty\n");
         return;
@@ -401,10 +410,9 @@ void qc_scale(double scale) {
 
     if(debug_qc) printf("scaling qc by %f\n", scale);
 
-    for(unsigned int i = 0; i<qc().size(); i++) {
-        queued_canon &q = qc()[i];
-        endpoint[0] *= scale;
-        endpoint[1] *= scale;
+    std::vector<queued_canon> &c = qc();
+    for(unsigned int i = 0; i<c.size(); i++) {
+        queued_canon &q = c[i];
         switch(q.type) {
         case QARC_FEED:
             q.data.arc_feed.end1 *= scale;
@@ -443,10 +451,11 @@ void dequeue_canons(setup_pointer settings) {
     if(debug_qc) printf("dequeueing: endpoint is now invalid\n");
     endpoint_valid = 0;
 
-    if(qc().empty()) return;
+    std::vector<queued_canon> &c = qc();
+    if(c.empty()) return;
 
-    for(unsigned int i = 0; i<qc().size(); i++) {
-        queued_canon &q = qc()[i];
+    for(unsigned int i = 0; i<c.size(); i++) {
+        queued_canon &q = c[i];
 
         switch(q.type) {
         case QARC_FEED:
@@ -560,7 +569,7 @@ void dequeue_canons(setup_pointer settings) {
             break;
         }
     }
-    qc().clear();
+    c.clear();
 }
 
 int Interp::move_endpoint_and_flush(setup_pointer settings, double x, double y) {
@@ -570,15 +579,16 @@ int Interp::move_endpoint_and_flush(setup_pointer settings, double x, double y)
     double y2;
     double dot;
             
-    if(qc().empty()) return 0;
+    std::vector<queued_canon> &c = qc();
+    if(c.empty()) return 0;
     
-    for(unsigned int i = 0; i<qc().size(); i++) {
+    for(unsigned int i = 0; i<c.size(); i++) {
         // there may be several moves in the queue, and we need to
         // change all of them.  consider moving into a concave corner,
         // then up and back down, then continuing on.  there will be
         // three moves to change.
 
-        queued_canon &q = qc()[i];
+        queued_canon &q = c[i];
 
         switch(q.type) {
         case QARC_FEED:
@@ -535,7 +535,7 @@ int Interp::read_g(char *line,   //!< string: line of RS274/NGC code being proce
   // mode = usercode_mgroup(&(_setup),value);
   // if (mode != -1) {
 
- remap_pointer r = _setup.g_remapped[value];
+ remap_pointer r = _setup.g_remap_bits[value] ? _setup.g_remapped[value] : NULL;
   if (r) {
       mode =  r->modal_group;
       CHKS ((mode < 0),"BUG: G remapping: modal group < 0"); // real bad
@@ -691,7 +691,11 @@ int Interp::read_integer_unsigned(char *line,    //!< string: line of RS274 code
       break;
   }
   CHKS((n == *counter), NCE_BAD_FORMAT_UNSIGNED_INTEGER);
-  if (sscanf(line + *counter, "%d", integer_ptr) == 0)
+  if (n - *counter < 10) {
+    *integer_ptr = 0;
+    for (int i = *counter; i < n; i++)
+      *integer_ptr = *integer_ptr * 10 + (line[i] - '0');
+  } else if (sscanf(line + *counter, "%d", integer_ptr) == 0)
     ERS(NCE_SSCANF_FAILED);
   *counter = n;
   return INTERP_OK;
@@ -739,6 +743,17 @@ int Interp::read_integer_value(char *line,       //!< string: line of RS274/NGC
   double float_value;
 
   CHP(read_real_value(line, counter, &float_value, parameters));
+  CHP(real_to_integer(float_value, integer_ptr));
+  return INTERP_OK;
+}
+
+/* real_to_integer rounds a value that should be an integer, allowing
+for a little floating point slop; used by read_integer_value and by
+compiled expressions. */
+
+int Interp::real_to_integer(double float_value, //!< value to round
+                            int *integer_ptr)   //!< pointer to the result
+{
   *integer_ptr = (int) floor(float_value);
   if ((float_value - *integer_ptr) > 0.9999) {
     *integer_ptr = (int) ceil(float_value);
@@ -1061,7 +1076,8 @@ int Interp::read_m(char *line,   //!< string: line of RS274 code being processed
   CHP(read_integer_value(line, counter, &value, parameters));
   CHKS((value < 0), NCE_NEGATIVE_M_CODE_USED);
 
-  remap_pointer r = _setup.m_remapped[value];
+  remap_pointer r = ((value < REMAP_CODES) && _setup.m_remap_bits[value]) ?
+      _setup.m_remapped[value] : NULL;
   if (r) {
       mode =  r->modal_group;
       CHKS ((mode < 0),"BUG: M remapping: modal group < 0");
@@ -2526,6 +2542,8 @@ int Interp::read_real_expression(char *line,     //!< string: line of RS274/NGC
   int operators[MAX_STACK];
   int stack_index;
 
+  if (_setup.parse_cache_ok && line[*counter] == '[')
+    return read_cached_expression(line, counter, value, parameters);
   CHKS((line[*counter] != '['), NCE_BUG_FUNCTION_SHOULD_NOT_HAVE_BEEN_CALLED);
   *counter = (*counter + 1);
   CHP(read_real_value(line, counter, values, parameters));
@@ -2558,6 +2576,372 @@ int Interp::read_real_expression(char *line,     //!< string: line of RS274/NGC
   return INTERP_OK;
 }
 
+/****************************************************************************/
+
+/*! read_cached_expression
+
+Returned Value: int
+   If the expression cannot be evaluated, this returns the same error
+   read_real_expression would.
+   Otherwise, it returns INTERP_OK.
+
+Side effects:
+   The value of the expression is put into what value points at.
+   The counter is set after the closing bracket.
+   The expression may be added to _setup.parsed_expr_cache.
+
+Called by: read_real_expression, when _setup.parse_cache_ok is set
+
+Lines inside loops and subroutines are read over and over, and
+scanning the same expression text each time is a large part of the
+cost of running them. Here the text of the expression, up to its
+closing bracket, is looked up in parsed_expr_cache. On a miss the
+expression is evaluated from the text as usual and then compiled into
+a short stack program (see compile_real_expression), which later
+reads of the same text execute instead of rescanning.
+
+Parameters are fetched when the program is run, never at compile
+time, so the result is always the same as reading the text. Numbered
+parameters with a constant index are resolved to the slot; named
+parameters are looked up by name because their scope changes from
+call to call.
+
+*/
+
+int Interp::read_cached_expression(char *line,   //!< string: line of RS274/NGC code being processed
+                                   int *counter, //!< pointer to a counter for position on the line
+                                   double *value,        //!< pointer to double to be computed
+                                   double *parameters)   //!< array of system parameters
+{
+  parsed_expr_map_iterator it;
+  expr_code code;
+  int start = *counter;
+  int end;
+  int depth = 0;
+  int status;
+
+  // find the matching bracket, skipping over parameter names
+  for (end = start; line[end] != 0; end++) {
+    if (line[end] == '<') {
+      while (line[end] != 0 && line[end] != '>')
+        end++;
+      if (line[end] == 0)
+        break;
+    } else if (line[end] == '[')
+      depth++;
+    else if (line[end] == ']' && --depth == 0)
+      break;
+  }
+
+  if (line[end] != 0) {
+    std::string key(line + start, end + 1 - start);
+    it = _setup.parsed_expr_cache.find(key);
+    if (it != _setup.parsed_expr_cache.end()) {
+      CHP(execute_expr_code(&it->second, value, parameters));
+      *counter = end + 1;
+      return INTERP_OK;
+    }
+  }
+
+  _setup.parse_cache_ok = false;
+  status = read_real_expression(line, counter, value, parameters);
+  _setup.parse_cache_ok = true;
+  CHP(status);
+
+  if (line[end] == 0 || *counter != end + 1)
+    return INTERP_OK;
+  code.depth = code.max_depth = 0;
+  end = start;
+  if (compile_real_expression(line, &end, &code) != INTERP_OK ||
+      end != *counter || code.max_depth > EXPR_STACK_MAX)
+    return INTERP_OK;   // not cached, the text is read every time
+  if (_setup.parsed_expr_cache.size() >= PARSED_EXPR_CACHE_MAX)
+    _setup.parsed_expr_cache.clear();
+  _setup.parsed_expr_cache[std::string(line + start, end - start)] = code;
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! compile_real_expression
+
+Returned Value: int
+   INTERP_OK if the expression starting at the counter was compiled,
+   otherwise INTERP_ERROR. No error message is set; the expression has
+   already been read successfully by read_real_expression, so a failure
+   only means it is not cached.
+
+Side effects:
+   Operations are appended to code. The counter is set after the
+   closing bracket.
+
+Called by: read_cached_expression, compile_real_value, compile_unary
+
+The compilers below mirror read_real_expression, read_real_value,
+read_parameter and read_unary, but emit operations instead of
+computing values. Binary operations are ordered with the same
+precedence function and the same left-to-right rule as
+read_real_expression, so a compiled expression executes the same
+execute_binary calls in the same order.
+
+*/
+
+int Interp::compile_real_expression(char *line,   //!< string: line of RS274/NGC code being processed
+                                    int *counter, //!< pointer to a counter for position on the line
+                                    expr_code *code)      //!< program being compiled
+{
+  int operators[MAX_STACK];
+  int stack_index = 0;
+  int operation;
+
+  if (line[*counter] != '[')
+    return INTERP_ERROR;
+  *counter = (*counter + 1);
+  if (compile_real_value(line, counter, code) != INTERP_OK)
+    return INTERP_ERROR;
+  for (;;) {
+    if (read_operation(line, counter, &operation) != INTERP_OK)
+      return INTERP_ERROR;
+    while (stack_index > 0 &&
+           precedence(operators[stack_index - 1]) >= precedence(operation)) {
+      stack_index--;
+      emit_expr_op(code, EXPR_BINARY, operators[stack_index]);
+    }
+    if (operation == RIGHT_BRACKET)
+      break;
+    if (stack_index == MAX_STACK)
+      return INTERP_ERROR;
+    operators[stack_index++] = operation;
+    if (compile_real_value(line, counter, code) != INTERP_OK)
+      return INTERP_ERROR;
+  }
+  return INTERP_OK;
+}
+
+int Interp::compile_real_value(char *line,   //!< string: line of RS274/NGC code being processed
+                               int *counter, //!< pointer to a counter for position on the line
+                               expr_code *code)      //!< program being compiled
+{
+  double value;
+  char c, c1;
+
+  c = line[*counter];
+  if (c == 0)
+    return INTERP_ERROR;
+  c1 = line[*counter + 1];
+
+  if (c == '[') {
+    if (compile_real_expression(line, counter, code) != INTERP_OK)
+      return INTERP_ERROR;
+  } else if (c == '#') {
+    if (compile_parameter(line, counter, code, false) != INTERP_OK)
+      return INTERP_ERROR;
+  } else if ((c == '+' || c == '-') && c1 && !isdigit(c1) && c1 != '.') {
+    (*counter)++;
+    if (compile_real_value(line, counter, code) != INTERP_OK)
+      return INTERP_ERROR;
+    if (c == '-')
+      emit_expr_op(code, EXPR_NEG);
+  } else if ((c >= 'a') && (c <= 'z')) {
+    if (compile_unary(line, counter, code) != INTERP_OK)
+      return INTERP_ERROR;
+  } else {
+    if (read_real_number(line, counter, &value) != INTERP_OK ||
+        isnan(value) || isinf(value))
+      return INTERP_ERROR;
+    emit_expr_op(code, EXPR_PUSH, 0, value);
+    return INTERP_OK;   // a checked constant, no EXPR_CHECK needed
+  }
+  emit_expr_op(code, EXPR_CHECK);
+  return INTERP_OK;
+}
+
+int Interp::compile_parameter(char *line,   //!< string: line of RS274/NGC code being processed
+                              int *counter, //!< pointer to a counter for position on the line
+                              expr_code *code,      //!< program being compiled
+                              bool check_exists)    //!< test for existence, not value
+{
+  char paramNameBuf[LINELEN+1];
+  size_t mark;
+  int index;
+
+  if (line[*counter] != '#')
+    return INTERP_ERROR;
+  *counter = (*counter + 1);
+
+  if (line[*counter] == '<') {
+    if (read_name(line, counter, paramNameBuf) != INTERP_OK)
+      return INTERP_ERROR;
+    emit_expr_op(code, check_exists ? EXPR_EXISTS_NAMED : EXPR_NAMED,
+                 0, 0.0, strstore(paramNameBuf));
+    return INTERP_OK;
+  }
+
+  mark = code->ops.size();
+  if (compile_real_value(line, counter, code) != INTERP_OK)
+    return INTERP_ERROR;
+  if (code->ops.size() == mark + 1 && code->ops[mark].opcode == EXPR_PUSH) {
+    // constant index, resolve it now
+    if (real_to_integer(code->ops[mark].value, &index) != INTERP_OK)
+      return INTERP_ERROR;
+    code->ops.pop_back();
+    code->depth--;
+    if (check_exists) {
+      emit_expr_op(code, EXPR_PUSH, 0,
+                   index >= 1 && index < RS274NGC_MAX_PARAMETERS);
+      return INTERP_OK;
+    }
+    if ((index < 1) || (index >= RS274NGC_MAX_PARAMETERS))
+      return INTERP_ERROR;
+    emit_expr_op(code, EXPR_PARAM, index);
+    return INTERP_OK;
+  }
+  emit_expr_op(code, check_exists ? EXPR_EXISTS_INDIRECT : EXPR_PARAM_INDIRECT);
+  return INTERP_OK;
+}
+
+int Interp::compile_unary(char *line,   //!< string: line of RS274/NGC code being processed
+                          int *counter, //!< pointer to a counter for position on the line
+                          expr_code *code)      //!< program being compiled
+{
+  int operation;
+
+  if (read_operation_unary(line, counter, &operation) != INTERP_OK ||
+      line[*counter] != '[')
+    return INTERP_ERROR;
+
+  if (operation == EXISTS) {
+    *counter = (*counter + 1);
+    if (compile_parameter(line, counter, code, true) != INTERP_OK ||
+        line[*counter] != ']')
+      return INTERP_ERROR;
+    *counter = (*counter + 1);
+    return INTERP_OK;
+  }
+
+  if (compile_real_expression(line, counter, code) != INTERP_OK)
+    return INTERP_ERROR;
+  if (operation == ATAN) {
+    if (line[*counter] != '/')
+      return INTERP_ERROR;
+    *counter = (*counter + 1);
+    if (compile_real_expression(line, counter, code) != INTERP_OK)
+      return INTERP_ERROR;
+    emit_expr_op(code, EXPR_ATAN);
+  } else
+    emit_expr_op(code, EXPR_UNARY, operation);
+  return INTERP_OK;
+}
+
+void Interp::emit_expr_op(expr_code *code, int opcode, int arg,
+                          double value, const char *name)
+{
+  expr_op op;
+
+  op.opcode = opcode;
+  op.arg = arg;
+  op.value = value;
+  op.name = name;
+  code->ops.push_back(op);
+  switch (opcode) {
+  case EXPR_PUSH:
+  case EXPR_PARAM:
+  case EXPR_NAMED:
+  case EXPR_EXISTS_NAMED:
+    code->depth++;
+    break;
+  case EXPR_BINARY:
+  case EXPR_ATAN:
+    code->depth--;
+    break;
+  }
+  if (code->depth > code->max_depth)
+    code->max_depth = code->depth;
+}
+
+/****************************************************************************/
+
+/*! execute_expr_code
+
+Returned Value: int
+   The error read_real_expression would have returned for the same
+   text and parameter values, or INTERP_OK.
+
+Side effects:
+   The value of the expression is put into what value points at.
+
+Called by: read_cached_expression
+
+*/
+
+int Interp::execute_expr_code(const expr_code *code, //!< compiled expression
+                              double *value,         //!< pointer to double to be computed
+                              double *parameters)    //!< array of system parameters
+{
+  double stack[EXPR_STACK_MAX];
+  std::vector<expr_op>::const_iterator op;
+  int sp = 0;
+  int index;
+  int exists;
+
+  for (op = code->ops.begin(); op != code->ops.end(); ++op) {
+    switch (op->opcode) {
+    case EXPR_PUSH:
+      stack[sp++] = op->value;
+      break;
+    case EXPR_PARAM:
+      CHKS(((op->arg >= 5420) && (op->arg <= 5428) && (_setup.cutter_comp_side)),
+           _("Cannot read current position with cutter radius compensation on"));
+      stack[sp++] = parameters[op->arg];
+      break;
+    case EXPR_PARAM_INDIRECT:
+      CHP(real_to_integer(stack[sp - 1], &index));
+      CHKS(((index < 1) || (index >= RS274NGC_MAX_PARAMETERS)),
+          NCE_PARAMETER_NUMBER_OUT_OF_RANGE);
+      CHKS(((index >= 5420) && (index <= 5428) && (_setup.cutter_comp_side)),
+           _("Cannot read current position with cutter radius compensation on"));
+      stack[sp - 1] = parameters[index];
+      break;
+    case EXPR_NAMED:
+      CHP(find_named_param(op->name, &exists, &stack[sp], true));
+      CHKS(!exists, _("Named parameter #<%s> not defined"), op->name);
+      sp++;
+      break;
+    case EXPR_EXISTS_NAMED:
+      CHP(find_named_param(op->name, &exists, &stack[sp], true));
+      stack[sp++] = exists ? 1.0 : 0.0;
+      break;
+    case EXPR_EXISTS_INDIRECT:
+      CHP(real_to_integer(stack[sp - 1], &index));
+      stack[sp - 1] = index >= 1 && index < RS274NGC_MAX_PARAMETERS;
+      break;
+    case EXPR_NEG:
+      stack[sp - 1] = -stack[sp - 1];
+      break;
+    case EXPR_BINARY:
+      CHP(execute_binary(&stack[sp - 2], op->arg, &stack[sp - 1]));
+      sp--;
+      break;
+    case EXPR_UNARY:
+      CHP(execute_unary(&stack[sp - 1], op->arg));
+      break;
+    case EXPR_ATAN:
+      stack[sp - 2] = atan2(stack[sp - 2], stack[sp - 1]);  /* value in radians */
+      stack[sp - 2] = ((stack[sp - 2] * 180.0) / M_PIl);    /* convert to degrees */
+      sp--;
+      break;
+    case EXPR_CHECK:
+      CHKS(isnan(stack[sp - 1]),
+          _("Calculation resulted in 'not a number'"));
+      CHKS(isinf(stack[sp - 1]),
+          _("Calculation resulted in 'infinity'"));
+      break;
+    }
+  }
+  *value = stack[0];
+  return INTERP_OK;
+}
+
 
 /****************************************************************************/
 
@@ -2590,12 +2974,20 @@ that is not a digit or "." (a second "." terminates reading).
 This function is not called if the first character is NULL, so it is
 not necessary to check that.
 
-The temporary insertion of a NULL character on the line is to avoid
-making a format string like "%3lf" which the LynxOS compiler cannot
-handle.
+Most numbers have one sign at most, one point at most and no more than
+15 digits or so. Those are converted on the way, in a single pass: the
+digits, taken as an integer below 2**53, and the power of ten to divide
+them by (at most 10**22) are both exact doubles, so the one division
+rounds the same way as the full conversion. Anything else goes through
+the full conversion, which also reports the errors.
 
 */
 
+static const double powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
 int Interp::read_real_number(char *line, //!< string: line of RS274/NGC code being processed
                             int *counter,       //!< pointer to a counter for position on the line 
                             double *double_ptr) //!< pointer to double to be read                  
@@ -2605,6 +2997,36 @@ int Interp::read_real_number(char *line, //!< string: line of RS274/NGC code bei
 
   start = line + *counter;
 
+  {
+    const char *p = start;
+    bool negative = false, point = false;
+    unsigned long long digits = 0;
+    int ndigits = 0, decimals = 0;
+
+    if (*p == '+' || *p == '-')
+      negative = (*p++ == '-');
+    for (;; p++) {
+      if (*p >= '0' && *p <= '9') {
+        if (digits >= (1ULL << 53) / 10)
+          break;
+        digits = digits * 10 + (*p - '0');
+        ndigits++;
+        decimals += point;
+      } else if (*p == '.' && !point) {
+        point = true;
+      } else {
+        break;
+      }
+    }
+    if (ndigits && decimals <= 22 && !(*p >= '0' && *p <= '9') &&
+        *p != '.' && *p != '+' && *p != '-') {
+      double val = digits / powers_of_ten[decimals];
+      *double_ptr = negative ? -val : val;
+      *counter = p - line;
+      return INTERP_OK;
+    }
+  }
+
   after = strspn(start, "+-");
   after = strspn(start+after, "0123456789.") + after;
 
@@ -35,7 +35,7 @@ bool Interp::has_user_mcode(setup_pointer settings,block_pointer block)
 	if (block->m_modes[i] == -1)
 	    continue;
 	if (M_REMAPPABLE(block->m_modes[i]) &&
-	    settings->m_remapped[block->m_modes[i]])
+	    settings->m_remap_bits[block->m_modes[i]])
 	    return true;
     }
     return false;
@@ -411,7 +411,7 @@ int Interp::parse_remap(const char *inistring, int lineno)
 	    continue;
 	}
 	if (!strncasecmp(kw,"prolog",kwlen)) {
-	    if (PYUSABLE) {
+	    if (python_configured()) {
 		r.prolog_func = strstore(arg);
 	    } else {
 		Error("Python plugin required for prolog=, but not available: %d:REMAP = %s",
@@ -422,7 +422,7 @@ int Interp::parse_remap(const char *inistring, int lineno)
 	    continue;
 	}
 	if (!strncasecmp(kw,"epilog",kwlen)) {
-	    if (PYUSABLE) {
+	    if (python_configured()) {
 		r.epilog_func = strstore(arg);
 	    } else {
 		Error("Python plugin required for epilog=, but not available: %d:REMAP = %s",
@@ -457,13 +457,14 @@ int Interp::parse_remap(const char *inistring, int lineno)
 		errored = true;
 		continue;
 	    }
-	    if (!PYUSABLE) {
+	    if (!python_configured()) {
 		Error("Python plugin required for python=, but not available: %d:REMAP = %s",
 		      lineno,inistring);
 		errored = true;
 		continue;
 	    }
-	    if (!is_pycallable(&_setup, REMAP_MODULE, arg)) {
+	    // if the plugin is not loaded yet, init_python() checks this
+	    if (_setup.py_ready && !is_pycallable(&_setup, REMAP_MODULE, arg)) {
 		Error("'%s' is not a Python callable function - %d:REMAP = %s",
 		      arg,lineno,inistring);
 		errored = true;
@@ -508,12 +509,19 @@ int Interp::parse_remap(const char *inistring, int lineno)
 	CHECK((strlen(code) > 1),"%d: %c remap - only single letter code allowed", lineno, *code);
 	CHECK((r.modal_group != -1), "%d: %c remap - modal group setting ignored - fixed sequencing", lineno, *code);
 	_setup.remaps[code] = r;
+	_setup.letter_remap_bits.set(towlower(*code) - 'a');
 	break;
 
     case 'm':
 	if (sscanf(code + 1, "%d", &mcode) == 1) {
+	    if ((mcode < 0) || (mcode >= REMAP_CODES)) {
+		Error("M-code '%s' out of range : %d:REMAP = %s",
+		      code,lineno,inistring);
+		goto fail;
+	    }
 	    _setup.remaps[code] = r;
 	    _setup.m_remapped[mcode] = &_setup.remaps[code];
+	    _setup.m_remap_bits.set(mcode);
 	} else {
 	    Error("parsing M-code: expecting integer like 'M420', got '%s' : %d:REMAP = %s",
 		  code,lineno,inistring);
@@ -542,6 +550,11 @@ int Interp::parse_remap(const char *inistring, int lineno)
 		  code, lineno, inistring);
 	    goto fail;
 	}
+	if ((gcode < 0) || (gcode >= REMAP_CODES)) {
+	    Error("G-code '%s' out of range : %d:REMAP = %s",
+		  code, lineno, inistring);
+	    goto fail;
+	}
 	r.motion_code = gcode;
 	if (r.modal_group == -1) {
 	    Error("warning: code '%s' : no modalgroup=<int> given, using default group %d : %d:REMAP = %s",
@@ -559,12 +572,13 @@ int Interp::parse_remap(const char *inistring, int lineno)
 	}
 	_setup.remaps[code] = r;
 	_setup.g_remapped[gcode] = &_setup.remaps[code];
+	_setup.g_remap_bits.set(gcode);
 	break;
 
     default:
 	// make sure the python plugin is in a usable state if needed
 	if ((r.prolog_func || r.remap_py || r.epilog_func) &&
-	    (!PYUSABLE))  {
+	    (!python_configured()))  {
 	    fprintf(stderr, "fatal: REMAP requires the Python plugin, which did not initialize\n");
 	    break;
 	}
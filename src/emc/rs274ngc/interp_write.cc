@@ -33,8 +33,7 @@ Side effects:
    The active_g_codes in the settings are updated.
 
 Called by:
-   Interp::execute
-   Interp::init
+   Interp::write_active_codes
 
 The block may be NULL.
 
@@ -136,8 +135,7 @@ Side effects:
    The settings->active_m_codes are updated.
 
 Called by:
-   Interp::execute
-   Interp::init
+   Interp::write_active_codes
 
 This is testing only the feed override to see if overrides is on.
 Might add check of speed override.
@@ -187,8 +185,7 @@ Side effects:
   sequence number, feed, and speed settings.
 
 Called by:
-  Interp::execute
-  Interp::init
+  Interp::write_active_codes
 
 */
 
@@ -205,3 +202,96 @@ int Interp::write_settings(setup_pointer settings)       //!< pointer to machine
 }
 
 /****************************************************************************/
+
+/*! write_active_codes
+
+Returned Value: int (INTERP_OK)
+
+Side effects:
+  The active_g_codes, active_m_codes and active_settings are updated
+  now, and no longer wait for sync_active_codes.
+
+Called by:
+  Interp::init
+  Interp::save_settings
+  Interp::restore_settings
+  Interp::sync_active_codes
+
+*/
+
+int Interp::write_active_codes(block_pointer block,   //!< pointer to a block of RS274/NGC instructions
+                               setup_pointer settings)        //!< pointer to machine settings
+{
+  write_g_codes(block, settings);
+  write_m_codes(block, settings);
+  write_settings(settings);
+  settings->active_codes_stale = false;
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! mark_active_codes
+
+Returned Value: none
+
+Side effects:
+  The non-modal codes of the block are kept, and the active arrays are
+  marked stale.
+
+Called by:
+  Interp::execute
+
+Nearly every block is executed without anyone looking at the active
+arrays in between, so they are only written out when they are read;
+see sync_active_codes.
+
+*/
+
+void Interp::mark_active_codes(block_pointer block,   //!< pointer to a block of RS274/NGC instructions
+                               setup_pointer settings)        //!< pointer to machine settings
+{
+  settings->active_block_modes[0] = block->g_modes[0];
+  settings->active_block_modes[1] = block->m_modes[4];
+  settings->active_block_modes[2] = block->m_modes[6];
+  settings->active_sequence_number = settings->sequence_number;
+  settings->active_codes_stale = true;
+}
+
+/****************************************************************************/
+
+/*! sync_active_codes
+
+Returned Value: none
+
+Side effects:
+  If the active arrays are stale, they are written as write_g_codes,
+  write_m_codes and write_settings would have written them after the
+  last block.  Only read() and synch() change the settings between
+  blocks: the sequence number is the one kept by mark_active_codes, and
+  synch() syncs before it changes anything.
+
+Called by:
+  Interp::active_g_codes
+  Interp::active_m_codes
+  Interp::active_settings
+  Interp::convert_m
+  Interp::synch
+  the python interp module
+
+*/
+
+void Interp::sync_active_codes(setup_pointer settings) //!< pointer to machine settings
+{
+  if (!settings->active_codes_stale)
+    return;
+  write_active_codes((block_pointer) NULL, settings);
+  settings->active_g_codes[2] = settings->active_block_modes[0];
+  settings->active_m_codes[1] = settings->active_block_modes[1];
+  settings->active_m_codes[3] = settings->active_block_modes[2];
+  settings->active_g_codes[0] = settings->active_sequence_number;
+  settings->active_m_codes[0] = settings->active_sequence_number;
+  settings->active_settings[0] = settings->active_sequence_number;
+}
+
+/****************************************************************************/
@@ -27,13 +27,16 @@ namespace pp = pyplusplus::containers::static_sized;
 #define IS_INT(x) (PyObject_IsInstance(x.ptr(), (PyObject*)&PyInt_Type))
 
 static  active_g_codes_array active_g_codes_wrapper ( Interp & inst) {
+    inst.sync_active_codes(&inst._setup);
     return active_g_codes_array(inst._setup.active_g_codes);
 }
 static  active_m_codes_array active_m_codes_wrapper ( Interp & inst) {
+    inst.sync_active_codes(&inst._setup);
     return active_m_codes_array(inst._setup.active_m_codes);
 }
 
 static  active_settings_array active_settings_wrapper ( Interp & inst) {
+    inst.sync_active_codes(&inst._setup);
     return active_settings_array(inst._setup.active_settings);
 }
 
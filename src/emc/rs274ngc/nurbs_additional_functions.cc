@@ -221,4 +221,76 @@ void nurbs_basisfun(int i, double u, int p,
 
 }
 
+// Span coefficients, the same as nurbs_span_coef() in tc.c, for use
+// outside the motion controller: the p + 1 basis functions of span i as polynomials
+// in t = u - U[i], combined with the control points (premultiplied by
+// their weights) into coef[k * NURBS_CHANNELS + ch], the t^k coefficient
+// of channel ch.
+void nurbs_span_coef(int i, int p, double *U,
+                     CONTROL_POINT *ctrl_pts, double *coef)
+{
+  int j, r, k, ch;
+  double a = U[i], den, lc, rc;
+  double N[NURBS_MAX_ORDER + 1][NURBS_MAX_ORDER + 1]; // N[r][k]: t^k of N_r
+  double saved[NURBS_MAX_ORDER + 1], temp[NURBS_MAX_ORDER + 1];
+  CONTROL_POINT *cp;
+
+  for (r = 0; r <= p; r++)
+    for (k = 0; k <= p; k++)
+      N[r][k] = 0.0;
+  N[0][0] = 1.0;
+
+  for (j = 1; j <= p; j++)
+    {
+      for (k = 0; k <= j; k++)
+        saved[k] = 0.0;
+
+      for (r = 0; r < j; r++)
+        {
+          // right[r+1] = rc - t, left[j-r] = t + lc
+          rc = U[i+r+1] - a;
+          lc = a - U[i+1+r-j];
+          den = rc + lc;
+          for (k = 0; k < j; k++)
+            temp[k] = (den != 0.0) ? N[r][k] / den : 0.0;
+          // N[r] = saved + right[r+1] * temp
+          N[r][0] = saved[0] + rc * temp[0];
+          for (k = 1; k <= j; k++)
+            N[r][k] = saved[k] + rc * (k < j ? temp[k] : 0.0) - temp[k-1];
+          // saved = left[j-r] * temp
+          saved[0] = lc * temp[0];
+          for (k = 1; k <= j; k++)
+            saved[k] = lc * (k < j ? temp[k] : 0.0) + temp[k-1];
+        }
+
+      for (k = 0; k <= j; k++)
+        N[j][k] = saved[k];
+    }
+
+  for (k = 0; k <= p; k++)
+    for (ch = 0; ch < NURBS_CHANNELS; ch++)
+      coef[k * NURBS_CHANNELS + ch] = 0.0;
+
+  for (r = 0; r <= p; r++)
+    {
+      double *c = coef;
+      cp = &ctrl_pts[i - p + r];
+      for (k = 0; k <= p; k++, c += NURBS_CHANNELS)
+        {
+          double n = N[r][k];
+          c[NURBS_CH_X] += n * cp->X;
+          c[NURBS_CH_Y] += n * cp->Y;
+          c[NURBS_CH_Z] += n * cp->Z;
+          c[NURBS_CH_A] += n * cp->A;
+          c[NURBS_CH_B] += n * cp->B;
+          c[NURBS_CH_C] += n * cp->C;
+          c[NURBS_CH_U] += n * cp->U;
+          c[NURBS_CH_V] += n * cp->V;
+          c[NURBS_CH_W] += n * cp->W;
+          c[NURBS_CH_R] += n * cp->R;
+          c[NURBS_CH_D] += n * cp->D;
+        }
+    }
+}
+
 // vim:sw=4:sts=4:et:
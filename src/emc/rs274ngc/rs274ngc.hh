@@ -44,6 +44,13 @@ typedef context *context_pointer;
 typedef struct offset_struct offset;
 typedef offset *offset_pointer;
 
+typedef struct parameter_value_struct parameter_value;
+typedef parameter_value *parameter_pointer;
+
+typedef struct expr_code_struct expr_code;
+
+typedef struct sub_label_struct sub_label;
+
 // Declare class so that we can use it in the typedef.
 class Interp;
 typedef int (Interp::*read_function_pointer) (char *, int *, block_pointer, double *);
@@ -47,9 +47,19 @@ public:
  int save_parameters(const char *filename,
                                     const double parameters[]);
 
+ void remember_parameter_file(const char *filename);
+ bool parameter_file_unchanged(const char *filename,
+                               const double parameters[]);
+
 // synchronize your internal model with the external world
  int synch();
 
+// copy the state of a program run, or go back to such a copy, for
+// run-from-line; save_state returns the file offset reading resumes at
+ bool can_save_state();
+ long save_state(setup_pointer state);
+ int restore_state(const setup *state, long position);
+
 /* Interface functions to call to get information from the interpreter.
    If a function has a return value, the return value contains the information.
    If a function returns nothing, information is copied into one of the
@@ -110,8 +120,14 @@ public:
     void set_loglevel(int level);
 
     // for now, public - for boost.python access
- int find_named_param(const char *nameBuf, int *status, double *value);
- int store_named_param(setup_pointer settings,const char *nameBuf, double value, int override_readonly = 0);
+ int find_named_param(const char *nameBuf, int *status, double *value,
+                      bool interned = false);
+ int store_named_param(setup_pointer settings,const char *nameBuf, double value, int override_readonly = 0,
+                       bool interned = false);
+ parameter_pointer find_param_entry(context_pointer frame, const char *nameBuf,
+                                    bool interned);
+ void clear_param_slots(context_pointer frame);
+ void clear_all_param_slots();
  int add_named_param(const char *nameBuf, int attr = 0);
  int fetch_ini_param( const char *nameBuf, int *status, double *value);
  int fetch_hal_param( const char *nameBuf, int *status, double *value);
@@ -285,6 +301,8 @@ public:
                 double end2, double end3);
  int cycle_traverse(block_pointer block, CANON_PLANE plane, double end1, double end2,
                           double end3);
+ int cycle_drill(block_pointer block, CANON_PLANE plane, double end1,
+                 double end2, double end3, double clear, double dwell);
  int enhance_block(block_pointer block, setup_pointer settings);
  int _execute(const char *command = 0);
  int execute_binary(double *left, int operation, double *right);
@@ -333,6 +351,7 @@ public:
  int move_endpoint_and_flush(setup_pointer, double, double);
  int parse_line(char *line, block_pointer block,
                       setup_pointer settings);
+ bool block_is_constant(const char *line);
  int precedence(int an_operator);
  int _read(const char *command);
  int read_a(char *line, int *counter, block_pointer block,
@@ -366,6 +385,7 @@ public:
  int read_integer_unsigned(char *line, int *counter, int *integer_ptr);
  int read_integer_value(char *line, int *counter, int *integer_ptr,
                               double *parameters);
+ int real_to_integer(double float_value, int *integer_ptr);
  int read_items(block_pointer block, char *line, double *parameters);
  int read_j(char *line, int *counter, block_pointer block,
                   double *parameters);
@@ -414,6 +434,17 @@ public:
                   double *parameters);
  int read_real_expression(char *line, int *counter,
                                 double *hold2, double *parameters);
+ int read_cached_expression(char *line, int *counter,
+                                double *value, double *parameters);
+ int compile_real_expression(char *line, int *counter, expr_code *code);
+ int compile_real_value(char *line, int *counter, expr_code *code);
+ int compile_parameter(char *line, int *counter, expr_code *code,
+                       bool check_exists);
+ int compile_unary(char *line, int *counter, expr_code *code);
+ void emit_expr_op(expr_code *code, int opcode, int arg = 0,
+                   double value = 0.0, const char *name = 0);
+ int execute_expr_code(const expr_code *code, double *value,
+                       double *parameters);
  int read_real_number(char *line, int *counter, double *double_ptr);
  int read_real_value(char *line, int *counter, double *double_ptr,
                            double *parameters);
@@ -443,15 +474,20 @@ public:
  int write_g_codes(block_pointer block, setup_pointer settings);
  int write_m_codes(block_pointer block, setup_pointer settings);
  int write_settings(setup_pointer settings);
+ int write_active_codes(block_pointer block, setup_pointer settings);
+ void mark_active_codes(block_pointer block, setup_pointer settings);
+ void sync_active_codes(setup_pointer settings);
  int unwrap_rotary(double *, double, double, double, char);
  bool isreadonly(int index);
 
   // O_word stuff
 
- int findFile( // ARGUMENTS
-		     char *direct,  // the directory to start looking in
-		     char *target,  // the name of the file to find
-		     char *foundFileDirect); // where to store the result
+ void index_sub_dir(setup_pointer settings, const char *direct, bool recurse);
+ void build_sub_index(setup_pointer settings);
+ const char *find_sub_index(setup_pointer settings, const char *name);
+ // sub start and end offsets kept across runs, see sub_label_file
+ sub_label *find_sub_label(setup_pointer settings, const char *name);
+ sub_label *save_sub_label(setup_pointer settings, const char *name);
 
  int control_save_offset(    /* ARGUMENTS                   */
 			 // int line,                  /* (o-word) line number        */
@@ -510,7 +546,11 @@ int read_inputs(setup_pointer settings);
 		       char *posarglist);
 
  int init_named_parameters();
+    int need_named_parameters();
     int init_python_predef_parameter(const char *name);
+    bool python_usable();
+    int init_python();
+    bool python_configured();
 
     bool has_user_mcode(setup_pointer settings,block_pointer block);
 
@@ -519,7 +559,6 @@ int read_inputs(setup_pointer settings);
 
     // range for user-remapped M-codes
     // and M6,M61
-    // this is overdue for a bitset
 #define M_REMAPPABLE(m)					\
     (((m > 199) && (m < 1000)) ||			\
      ((m > 0) && (m < 100) &&				\
@@ -538,12 +577,15 @@ int read_inputs(setup_pointer settings);
      (g < 1000) && \
      !G_BUILTIN(g))
 
-#define IS_USER_GCODE(x) (G_REMAPPABLE(x) && _setup.g_remapped[x])
+#define IS_USER_GCODE(x) (G_REMAPPABLE(x) && _setup.g_remap_bits[x])
 
 #define IS_USER_MCODE(bp,sp,mgroup) \
     ((M_REMAPPABLE((bp)->m_modes[mgroup])) && \
     (((bp)->m_modes[mgroup]) > -1) &&		\
-     ((sp)->m_remapped[(bp)->m_modes[mgroup]]))
+     ((sp)->m_remap_bits[(bp)->m_modes[mgroup]]))
+
+    // T, S or F remapped; letter is lower case
+#define IS_USER_LETTER(sp,letter) ((sp)->letter_remap_bits[(letter) - 'a'])
     
     bool remap_in_progress(const char *code);
     int convert_remapped_code(block_pointer block,
@@ -74,6 +74,8 @@ include an option for suppressing superfluous commands.
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <sys/time.h>
 #include <time.h>
@@ -110,7 +112,10 @@ Interp::Interp()
     : log_file(stderr)  
 {
     _setup.init_once = 1;  
-    init_named_parameters();  
+    _setup.named_params_state = NP_NONE;
+    _setup.py_inifile = NULL;
+    _setup.py_ready = false;
+    clear_all_param_slots();
 }
 
 
@@ -303,7 +308,7 @@ int Interp::_execute(const char *command)
 
       logDebug("storing param:|%s|", _setup.named_parameters[n]);
       CHP(store_named_param(&_setup, _setup.named_parameters[n],
-                          _setup.named_parameter_values[n]));
+                          _setup.named_parameter_values[n], 0, true));
   }
   _setup.named_parameter_occurrence = 0;
 
@@ -415,9 +420,7 @@ int Interp::_execute(const char *command)
 		      _setup.mdi_interrupt = false;
 		      // at this point the MDI execution of a remapped block is complete.
 		      logRemap("MDI remap execution complete status=%s\n",interp_status(status));
-		      write_g_codes(eblock, &_setup);
-		      write_m_codes(eblock, &_setup);
-		      write_settings(&_setup);
+		      mark_active_codes(eblock, &_setup);
 		      return INTERP_OK;
 		  }
 	      } else {
@@ -437,9 +440,7 @@ int Interp::_execute(const char *command)
 	  // standard case: unremapped block execution
 	  status = execute_block(eblock, &_setup);
 
-	  write_g_codes(eblock, &_setup);
-	  write_m_codes(eblock, &_setup);
-	  write_settings(&_setup);
+	  mark_active_codes(eblock, &_setup);
 
 	  if ((status == INTERP_EXIT) &&
 	      (_setup.remap_level > 0) &&
@@ -580,19 +581,19 @@ int Interp::remap_finished(int phase)
 // return number of remaps found
 int Interp::find_remappings(block_pointer block, setup_pointer settings)
 {
-    if (block->f_flag && remapping("F")) {
+    if (block->f_flag && IS_USER_LETTER(settings, 'f')) {
 	if (remap_in_progress("F"))
 	    CONTROLLING_BLOCK(*settings).builtin_used = true;
 	else
 	    block->remappings.insert(STEP_SET_FEED_RATE);
     }
-    if (block->s_flag && remapping("S")) {
+    if (block->s_flag && IS_USER_LETTER(settings, 's')) {
 	if (remap_in_progress("S"))
 	    CONTROLLING_BLOCK(*settings).builtin_used = true;
 	else
 	    block->remappings.insert(STEP_SET_SPINDLE_SPEED);
     }
-    if (block->t_flag && remapping("T")) {
+    if (block->t_flag && IS_USER_LETTER(settings, 't')) {
 	if (remap_in_progress("T"))
 	    CONTROLLING_BLOCK(*settings).builtin_used = true;
 	else
@@ -754,6 +755,7 @@ int Interp::init()
   _setup.value_returned = 0;
   _setup.remap_level = 0; // remapped blocks stack index
   _setup.call_state = CS_NORMAL;
+  _setup.sub_index_time = 0; // index the subroutine places when next needed
 
   if(iniFileName != NULL) {
 
@@ -880,45 +882,21 @@ int Interp::init()
 	      _setup.on_abort_command = NULL;
           }
 
-	  // initialize the Python plugin singleton
-	  extern struct _inittab builtin_modules[];
+	  // the Python plugin is set up on first use, see python_usable()
 	  if (inifile.Find("TOPLEVEL", "PYTHON")) {
-	      if (PythonPlugin::configure(iniFileName,"PYTHON",  builtin_modules) != NULL) {
-		  try {
-		      // this import will register the C++->Python converter for Interp
-		      bp::object interp_module = bp::import("interpreter");
-
-		      // use a boost::cref to avoid per-call instantiation of the 
-		      // Interp Python wrapper (used for the 'self' parameter in handlers)
-		      // since interp.init() may be called repeatedly this would create a new
-		      // wrapper instance on every init(), abandoning the old one and all user attributes
-		      // tacked onto it, so make sure this is done exactly once
-		      if (_setup.init_once)  
-			  _setup.pythis =  boost::python::object(boost::cref(this));
-
-		      // alias to 'interpreter.this' for the sake of ';py, .... ' comments
-		      bp::scope(interp_module).attr("this") =  _setup.pythis;
-		  }
-		  catch (bp::error_already_set) {
-		      std::string exception_msg;
-		      if (PyErr_Occurred()) {
-			  exception_msg = handle_pyerror();
-		      } else
-			  exception_msg = "unknown exception";
-		      bp::handle_exception();
-		      PyErr_Clear();
-		      Error("PYTHON: exception during 'this' export:\n%s\n",exception_msg.c_str());
-		  }
-	      } else {
-		  Error("no Python plugin available");
-	      }
+	      _setup.py_inifile = strstore(iniFileName);
+	  } else {
+	      _setup.py_inifile = NULL;
 	  }
- 
+
 	  int n = 1;
 	  int lineno = -1;
 	  _setup.g_remapped.clear();
 	  _setup.m_remapped.clear();
 	  _setup.remaps.clear();
+	  _setup.g_remap_bits.reset();
+	  _setup.m_remap_bits.reset();
+	  _setup.letter_remap_bits.reset();
 	  while (NULL != (inistring = inifile.Find("REMAP", "RS274NGC",
 						   n, &lineno))) {
 
@@ -1065,6 +1043,14 @@ int Interp::init()
   _setup.defining_sub = 0;
   _setup.skipping_o = 0;
   _setup.offset_map.clear();
+  _setup.parsed_block_cache.clear(); // readers and remaps may have changed
+  _setup.parsed_expr_cache.clear();
+  _setup.hal_ref_cache.clear();
+  _setup.hal_ref_generation = 0;
+  _setup.outside_reads = 0;
+  _setup.parse_cache_ok = false;
+  _setup.read_high_water_file[0] = 0;
+  _setup.read_high_water = 0;
 
   _setup.lathe_diameter_mode = false;
   _setup.parameters[5599] = 1.0; // enable (DEBUG, ) output
@@ -1084,60 +1070,11 @@ int Interp::init()
 
   synch(); //synch first, then update the interface
 
-  write_g_codes((block_pointer) NULL, &_setup);
-  write_m_codes((block_pointer) NULL, &_setup);
-  write_settings(&_setup);
+  write_active_codes((block_pointer) NULL, &_setup);
 
   init_tool_parameters();
   // Synch rest of settings to external world
 
-  // call __init__(self) once in toplevel module if defined
-  // once fully set up and sync()ed
-  if ((iniFileName != NULL) && _setup.init_once && PYUSABLE ) {
-
-      // initialize any python global predefined named parameters
-      // walk the namedparams module for callables and add their names as predefs
-      try {
-	  bp::object npmod =  python_plugin->main_namespace[NAMEDPARAMS_MODULE];
-	  bp::dict predef_dict = bp::extract<bp::dict>(npmod.attr("__dict__"));
-	  bp::list iterkeys = (bp::list) predef_dict.iterkeys();
-	  for (int i = 0; i < bp::len(iterkeys); i++)  {
-	      std::string key = bp::extract<std::string>(iterkeys[i]);
-	      bp::object value = predef_dict[key];
-	      if (PyCallable_Check(value.ptr())) {
-		  CHP(init_python_predef_parameter(key.c_str()));
-	      }
-	  }
-      }
-      catch (bp::error_already_set) {
-	  std::string exception_msg;
-	  bool unexpected = false;
-	  // KeyError is ok - this means the namedparams module doesnt exist
-	  if (!PyErr_ExceptionMatches(PyExc_KeyError)) {
-	      // something else, strange
-	      exception_msg = handle_pyerror();
-	      unexpected = true;
-	  }
-	  bp::handle_exception();
-	  PyErr_Clear();
-	  CHKS(unexpected, "exception adding Python predefined named parameter: %s", exception_msg.c_str());
-      }
-
-      if (python_plugin->is_callable(NULL, INIT_FUNC)) {
-
-	  bp::object retval, tupleargs, kwargs;
-	  bp::list plist;
-
-	  plist.append(_setup.pythis); // self
-	  tupleargs = bp::tuple(plist);
-	  kwargs = bp::dict();
-
-	  python_plugin->call(NULL, INIT_FUNC, tupleargs, kwargs, retval);
-	  CHKS(python_plugin->plugin_status() == PLUGIN_EXCEPTION,
-	       "pycall(%s):\n%s", INIT_FUNC,
-	       python_plugin->last_exception().c_str());
-      }
-  }
   _setup.init_once = 0;
   
   return INTERP_OK;
@@ -1249,7 +1186,7 @@ int Interp::open(const char *filename) //!< string: the name of the input NC-pro
     }
   CHKS((_setup.file_pointer != NULL), NCE_A_FILE_IS_ALREADY_OPEN);
   CHKS((strlen(filename) > (LINELEN - 1)), NCE_FILE_NAME_TOO_LONG);
-  _setup.file_pointer = fopen(filename, "r");
+  _setup.file_pointer = ngc_fopen(filename);
   CHKS((_setup.file_pointer == NULL), NCE_UNABLE_TO_OPEN_FILE, filename);
   line = _setup.linetext;
   for (index = -1; index == -1;) {      /* skip blank lines */
@@ -1280,6 +1217,7 @@ int Interp::open(const char *filename) //!< string: the name of the input NC-pro
     _setup.sequence_number = 0; // Going back to line 0
   }
   strcpy(_setup.filename, filename);
+  _setup.read_high_water_file[0] = 0;
   reset();
   return INTERP_OK;
 }
@@ -1462,9 +1400,25 @@ int Interp::_read(const char *command)  //!< may be NULL or a string to read
   _setup.parameters[5427] = _setup.v_current;
   _setup.parameters[5428] = _setup.w_current;
 
+  _setup.parse_cache_ok = false;
   if(_setup.file_pointer)
   {
-      EXECUTING_BLOCK(_setup).offset = ftell(_setup.file_pointer);
+      long offset = ftell(_setup.file_pointer);
+      EXECUTING_BLOCK(_setup).offset = offset;
+
+      // a line behind the furthest point read in this file, or any line
+      // of a subroutine, is likely to be read again: let parse_line()
+      // use and fill the parsed block cache for it
+      if (strcmp(_setup.read_high_water_file, _setup.filename) != 0) {
+          strcpy(_setup.read_high_water_file, _setup.filename);
+          _setup.read_high_water = offset;
+      } else if (offset < _setup.read_high_water) {
+          _setup.parse_cache_ok = true;
+      } else {
+          _setup.read_high_water = offset;
+      }
+      if (_setup.call_level > 0)
+          _setup.parse_cache_ok = true;
   }
 
   read_status =
@@ -1545,7 +1499,7 @@ int Interp::unwind_call(int status, const char *file, int line, const char *func
 	if (sub->filename && sub->filename[0]) {
 	    if(0 != strcmp(_setup.filename, sub->filename)) {
 		fclose(_setup.file_pointer);
-		_setup.file_pointer = fopen(sub->filename, "r");
+		_setup.file_pointer = ngc_fopen(sub->filename);
 		logDebug("unwind_call: reopening '%s' at %ld",
 			 sub->filename, sub->position);
 		strcpy(_setup.filename, sub->filename);
@@ -1622,6 +1576,8 @@ int Interp::reset()
     _setup.linetext[0] = 0;
     _setup.blocktext[0] = 0;
     _setup.line_length = 0;
+    clear_all_param_slots(); // a failed Python call may have changed named_params
+    _setup.sub_index_checked = false; // look for new subroutine files
 
     unwind_call(INTERP_OK, __FILE__,__LINE__,__FUNCTION__);
     return INTERP_OK;
@@ -1629,6 +1585,93 @@ int Interp::reset()
 
 /***********************************************************************/
 
+/*! Interp::save_state, Interp::restore_state, Interp::can_save_state
+
+save_state copies the state of the interpreter into *state and returns
+the offset in the open file of the next line. restore_state puts such a
+copy back and seeks the open file to that offset, so reading goes on as
+if every line up to there had been read again. Task uses these for
+run-from-line checkpoints, see emcTaskPlanCheckpoint().
+
+The caches and the subroutine indexes are not part of the copy; they
+stay as they are, as do the open file and the tool table, which comes
+from the world model. A copy can only be taken between lines of the
+main program, outside of any call, definition, remap or cutter
+compensation, which is what can_save_state tells.
+
+*/
+
+struct setup_kept {
+  parsed_block_map_type parsed_block_cache;
+  parsed_expr_map_type parsed_expr_cache;
+  hal_ref_map_type hal_ref_cache;
+  unsigned int hal_ref_generation;
+  sub_label_index_type sub_labels;
+  sub_index_map_type sub_index;
+  sub_index_dirs_type sub_index_dirs;
+  time_t sub_index_time;
+  bool sub_index_checked;
+};
+
+static void swap_kept(setup_pointer settings, setup_kept &kept)
+{
+  settings->parsed_block_cache.swap(kept.parsed_block_cache);
+  settings->parsed_expr_cache.swap(kept.parsed_expr_cache);
+  settings->hal_ref_cache.swap(kept.hal_ref_cache);
+  std::swap(settings->hal_ref_generation, kept.hal_ref_generation);
+  settings->sub_labels.swap(kept.sub_labels);
+  settings->sub_index.swap(kept.sub_index);
+  settings->sub_index_dirs.swap(kept.sub_index_dirs);
+  std::swap(settings->sub_index_time, kept.sub_index_time);
+  std::swap(settings->sub_index_checked, kept.sub_index_checked);
+}
+
+bool Interp::can_save_state()
+{
+  return _setup.file_pointer != NULL && _setup.call_level == 0 &&
+    _setup.remap_level == 0 && _setup.call_state == CS_NORMAL &&
+    !_setup.defining_sub && !_setup.skipping_o && !_setup.skipping_to_sub &&
+    !_setup.cutter_comp_side && qc().empty();
+}
+
+long Interp::save_state(setup_pointer state)
+{
+  setup_kept kept = setup_kept();
+
+  swap_kept(&_setup, kept);
+  *state = _setup;
+  swap_kept(&_setup, kept);
+  return ftell(_setup.file_pointer);
+}
+
+int Interp::restore_state(const setup *state, long position)
+{
+  static CANON_TOOL_TABLE tool_table[CANON_POCKETS_MAX];
+  char filename[PATH_MAX];
+  FILE *file_pointer = _setup.file_pointer;
+  setup_kept kept = setup_kept();
+
+  CHKS((file_pointer == NULL), NCE_FILE_NOT_OPEN);
+  CHKS((strcmp(_setup.filename, state->filename) != 0),
+       _("Saved state is for %s, not %s"), state->filename, _setup.filename);
+  strcpy(filename, _setup.filename);
+  memcpy(tool_table, _setup.tool_table, sizeof(tool_table));
+  swap_kept(&_setup, kept);
+  _setup = *state;
+  swap_kept(&_setup, kept);
+  memcpy(_setup.tool_table, tool_table, sizeof(tool_table));
+  _setup.file_pointer = file_pointer;
+  strcpy(_setup.filename, filename);
+  _setup.parse_cache_ok = false;
+  _setup.read_high_water_file[0] = 0;
+  if (fseek(file_pointer, position, SEEK_SET) != 0) {
+    ERS(NCE_UNABLE_TO_OPEN_FILE, filename);
+  }
+  return INTERP_OK;
+}
+
+/***********************************************************************/
+
 /*! Interp::restore_parameters
 
 Returned Value:
@@ -1681,6 +1724,8 @@ int Interp::restore_parameters(const char *filename)   //!< name of parameter fi
   infile = fopen(filename, "r");
   CHKS((infile == NULL), _("Unable to open parameter file: '%s'"), filename);
 
+  _setup.saved_file.clear();
+  _setup.saved_parameters.clear();
   pars = _setup.parameters;
   k = 0;
   index = 0;
@@ -1699,6 +1744,7 @@ int Interp::restore_parameters(const char *filename)   //!< name of parameter fi
           ERS(NCE_PARAMETER_FILE_OUT_OF_ORDER);
         else if (k == variable) {
           pars[k] = value;
+          _setup.saved_parameters[k] = value;
           if (k == required)
             required = _required_parameters[index++];
           k++;
@@ -1716,11 +1762,75 @@ int Interp::restore_parameters(const char *filename)   //!< name of parameter fi
   for (; k < RS274NGC_MAX_PARAMETERS; k++) {
     pars[k] = 0;
   }
+  // a file lacking required parameters gets them on the next save
+  if (required == RS274NGC_MAX_PARAMETERS)
+    remember_parameter_file(filename);
   return INTERP_OK;
 }
 
 /***********************************************************************/
 
+/*! Interp::remember_parameter_file
+
+Returned Value: none
+
+Side Effects: sets the saved_xxx fields of _setup
+
+Called By:
+  Interp::restore_parameters
+  Interp::save_parameters
+
+Notes which file filename is now, so that save_parameters can tell
+whether it needs to be written again.  The caller has filled in
+_setup.saved_parameters with the values in the file.
+
+*/
+
+void Interp::remember_parameter_file(const char *filename)
+{
+  struct stat st;
+
+  if (stat(filename, &st) != 0) {
+    _setup.saved_file.clear();
+    return;
+  }
+  _setup.saved_file = filename;
+  _setup.saved_ino = st.st_ino;
+  _setup.saved_size = st.st_size;
+  _setup.saved_mtime = st.st_mtime;
+}
+
+/*! Interp::parameter_file_unchanged
+
+Returned Value: bool, true if writing filename from parameters would
+  give the file it holds already
+
+Side Effects: none
+
+Called By: Interp::save_parameters
+
+*/
+
+bool Interp::parameter_file_unchanged(const char *filename,
+                                      const double parameters[])
+{
+  struct stat st;
+  std::map<int, double>::const_iterator it;
+
+  if (_setup.saved_file != filename || stat(filename, &st) != 0
+      || st.st_ino != _setup.saved_ino || st.st_size != _setup.saved_size
+      || st.st_mtime != _setup.saved_mtime)
+    return false;
+  for (it = _setup.saved_parameters.begin();
+       it != _setup.saved_parameters.end(); it++) {
+    if (parameters[it->first] != it->second)
+      return false;
+  }
+  return true;
+}
+
+/***********************************************************************/
+
 /*! Interp::save_parameters
 
 Returned Value:
@@ -1765,6 +1875,13 @@ int Interp::save_parameters(const char *filename,      //!< name of file to writ
   int index;                    // index into _required_parameters
   int k;
 
+  // exit() and reset save on every call; don't wear out the disk
+  // rewriting a file that would come out the same
+  if (parameter_file_unchanged(filename, parameters))
+    return INTERP_OK;
+  _setup.saved_file.clear();
+  _setup.saved_parameters.clear();
+
   if(access(filename, F_OK)==0) 
   {
     // rename as .bak
@@ -1802,6 +1919,7 @@ int Interp::save_parameters(const char *filename,      //!< name of file to writ
         else if (k == variable) {
           sprintf(line, "%d\t%f\n", k, parameters[k]);
           fputs(line, outfile);
+          _setup.saved_parameters[k] = parameters[k];
           if (k == required)
             required = _required_parameters[index++];
           k++;
@@ -1810,6 +1928,7 @@ int Interp::save_parameters(const char *filename,      //!< name of file to writ
         {
           sprintf(line, "%d\t%f\n", k, parameters[k]);
           fputs(line, outfile);
+          _setup.saved_parameters[k] = parameters[k];
           required = _required_parameters[index++];
         }
       }
@@ -1820,10 +1939,12 @@ int Interp::save_parameters(const char *filename,      //!< name of file to writ
     if (k == required) {
       sprintf(line, "%d\t%f\n", k, parameters[k]);
       fputs(line, outfile);
+      _setup.saved_parameters[k] = parameters[k];
       required = _required_parameters[index++];
     }
   }
   fclose(outfile);
+  remember_parameter_file(filename);
   return INTERP_OK;
 }
 
@@ -1852,6 +1973,10 @@ int Interp::synch()
   char file_name[LINELEN];
   double prev_x, prev_y, prev_z;    // for cutter_comp
   double offset_x, offset_y, offset_z;    // for cutter_comp
+
+  // the active arrays show the state before this synch, as they did
+  // when they were written after every block
+  sync_active_codes(&_setup);
     
   //debug: printf("debug: synch():\n");
   //debug: printf("\told: current_x(%f) current_y(%f)\n", _setup.current_x, _setup.current_y);
@@ -1940,6 +2065,7 @@ void Interp::active_g_codes(int *codes)        //!< array of codes to copy into
 {
   int n;
 
+  sync_active_codes(&_setup);
   for (n = 0; n < ACTIVE_G_CODES; n++) {
     codes[n] = _setup.active_g_codes[n];
   }
@@ -1963,6 +2089,7 @@ void Interp::active_m_codes(int *codes)        //!< array of codes to copy into
 {
   int n;
 
+  sync_active_codes(&_setup);
   for (n = 0; n < ACTIVE_M_CODES; n++) {
     codes[n] = _setup.active_m_codes[n];
   }
@@ -1986,6 +2113,7 @@ void Interp::active_settings(double *settings) //!< array of settings to copy in
 {
   int n;
 
+  sync_active_codes(&_setup);
   for (n = 0; n < ACTIVE_SETTINGS; n++) {
     settings[n] = _setup.active_settings[n];
   }
@@ -2400,6 +2528,125 @@ int Interp::on_abort(int reason, const char *message)
     return status;
 }
 
+/*
+  NC code files are read through a mapping of the file rather than a
+  plain stdio stream, so that the fseek() done for every o-word jump and
+  every return from a call refills the stdio buffer with a memcpy()
+  instead of a read from the file.  Each refill checks the size of the
+  file first and maps it again if it has changed, so the interpreter
+  still sees a file that grows while it is being read, and doesn't touch
+  pages past the end of one that was cut short.  Anything that isn't a
+  regular file, like a pipe, is streamed as before.
+*/
+
+struct ngc_map {
+    int fd;
+    char *base;
+    size_t size;          // bytes mapped
+    off64_t pos;
+};
+
+// map the file again if its size changed; false if nothing is mapped
+static bool ngc_map_update(ngc_map *m)
+{
+    struct stat st;
+
+    if (fstat(m->fd, &st) != 0 || (size_t) st.st_size == m->size) {
+	return m->base != NULL;
+    }
+    if (m->base) {
+	munmap(m->base, m->size);
+    }
+    m->base = NULL;
+    m->size = 0;
+    if (st.st_size > 0) {
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, m->fd, 0);
+	if (base != MAP_FAILED) {
+	    m->base = (char *) base;
+	    m->size = st.st_size;
+	}
+    }
+    return m->base != NULL;
+}
+
+static ssize_t ngc_map_read(void *cookie, char *buf, size_t size)
+{
+    ngc_map *m = (ngc_map *) cookie;
+
+    if (!ngc_map_update(m) || m->pos >= (off64_t) m->size) {
+	return 0;
+    }
+    if (size > m->size - m->pos) {
+	size = m->size - m->pos;
+    }
+    memcpy(buf, m->base + m->pos, size);
+    m->pos += size;
+    return size;
+}
+
+static int ngc_map_seek(void *cookie, off64_t *offset, int whence)
+{
+    ngc_map *m = (ngc_map *) cookie;
+    off64_t pos = *offset;
+
+    if (whence == SEEK_CUR) {
+	pos += m->pos;
+    } else if (whence == SEEK_END) {
+	ngc_map_update(m);
+	pos += m->size;
+    }
+    if (pos < 0) {
+	return -1;
+    }
+    *offset = m->pos = pos;
+    return 0;
+}
+
+static int ngc_map_close(void *cookie)
+{
+    ngc_map *m = (ngc_map *) cookie;
+
+    if (m->base) {
+	munmap(m->base, m->size);
+    }
+    close(m->fd);
+    delete m;
+    return 0;
+}
+
+std::vector<std::string> *ngc_fopen_log;
+
+FILE *ngc_fopen(const char *filename)
+{
+    cookie_io_functions_t io = { ngc_map_read, NULL, ngc_map_seek, ngc_map_close };
+    struct stat st;
+    ngc_map *m;
+    FILE *fp;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	return NULL;
+    }
+    if (ngc_fopen_log) {
+	ngc_fopen_log->push_back(filename);
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+	return fdopen(fd, "r");
+    }
+    m = new ngc_map;
+    m->fd = fd;
+    m->base = NULL;
+    m->size = 0;
+    m->pos = 0;
+    fp = fopencookie(m, "r", io);
+    if (fp == NULL) {
+	delete m;
+	return fdopen(fd, "r");
+    }
+    return fp;
+}
+
 // spun out from interp_o_word so we can use it to test ngc file accessibility during
 // config file parsing (REMAP... ngc=<basename>)
 FILE *Interp::find_ngc_file(setup_pointer settings,const char *basename, char *foundhere )
@@ -2407,8 +2654,6 @@ FILE *Interp::find_ngc_file(setup_pointer settings,const char *basename, char *f
     FILE *newFP;
     char tmpFileName[PATH_MAX+1];
     char newFileName[PATH_MAX+1];
-    char foundPlace[PATH_MAX+1];
-    int  dct;
 
     // look for a new file
     sprintf(tmpFileName, "%s.ngc", basename);
@@ -2418,31 +2663,25 @@ FILE *Interp::find_ngc_file(setup_pointer settings,const char *basename, char *f
 
     // first look in the program_prefix place
     sprintf(newFileName, "%s/%s", settings->program_prefix, tmpFileName);
-    newFP = fopen(newFileName, "r");
+    newFP = ngc_fopen(newFileName);
 
-    // then look in the subroutines place
+    // then in the subroutines places and the wizard tree, in that
+    // order, through the index of what is in them
     if (!newFP) {
-	for (dct = 0; dct < MAX_SUB_DIRS; dct++) {
-	    if (!settings->subroutines[dct])
-		continue;
-	    sprintf(newFileName, "%s/%s", settings->subroutines[dct], tmpFileName);
-	    newFP = fopen(newFileName, "r");
-	    if (newFP) {
-		// logOword("fopen: |%s|", newFileName);
-		break; // use first occurrence in dir search
-	    }
+	const char *path = find_sub_index(settings, tmpFileName);
+
+	if (path) {
+	    snprintf(newFileName, sizeof(newFileName), "%s", path);
+	    newFP = ngc_fopen(newFileName);
 	}
-    }
-    // if not found, search the wizard tree
-    if (!newFP) {
-	int ret;
-	ret = findFile(settings->wizard_root, tmpFileName, foundPlace);
-
-	if (INTERP_OK == ret) {
-	    // create the long name
-	    sprintf(newFileName, "%s/%s",
-		    foundPlace, tmpFileName);
-	    newFP = fopen(newFileName, "r");
+	if (!newFP) {
+	    // missing, or gone, since the index was built: look again
+	    build_sub_index(settings);
+	    path = find_sub_index(settings, tmpFileName);
+	    if (path) {
+		snprintf(newFileName, sizeof(newFileName), "%s", path);
+		newFP = ngc_fopen(newFileName);
+	    }
 	}
     }
     if (foundhere && (newFP != NULL)) 
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 #include "emcglb.h"
 #include "emctool.h"
 #include "tool_parse.h"
@@ -270,3 +271,68 @@ int loadToolTable(const char *filename,
 
     return 0;
 }
+
+int toolTableEntryEqual(const struct CANON_TOOL_TABLE *a,
+	const struct CANON_TOOL_TABLE *b)
+{
+    return a->toolno == b->toolno
+	&& !memcmp(&a->offset, &b->offset, sizeof(a->offset))
+	&& a->diameter == b->diameter
+	&& a->frontangle == b->frontangle
+	&& a->backangle == b->backangle
+	&& a->orientation == b->orientation;
+}
+
+int saveToolTable(const char *filename,
+	struct CANON_TOOL_TABLE toolTable[CANON_POCKETS_MAX],
+	int fms[CANON_POCKETS_MAX],
+	char *ttcomments[CANON_POCKETS_MAX],
+	int random_toolchanger)
+{
+    int pocket;
+    FILE *fp;
+    int start_pocket;
+    char tmpname[LINELEN + 8];
+
+    // the table goes to a new file that then replaces the old one, so
+    // nothing reading the tool table ever sees half of one
+    if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename)
+	    >= (int) sizeof(tmpname)) {
+	return -1;
+    }
+    if (NULL == (fp = fopen(tmpname, "w"))) {
+	return -1;
+    }
+
+    if(random_toolchanger) {
+        start_pocket = 0;
+    } else {
+        start_pocket = 1;
+    }
+    for (pocket = start_pocket; pocket < CANON_POCKETS_MAX; pocket++) {
+        if (toolTable[pocket].toolno != -1) {
+            fprintf(fp, "T%d P%d", toolTable[pocket].toolno, random_toolchanger? pocket: fms[pocket]);
+            if (toolTable[pocket].diameter) fprintf(fp, " D%f", toolTable[pocket].diameter);
+            if (toolTable[pocket].offset.tran.x) fprintf(fp, " X%+f", toolTable[pocket].offset.tran.x);
+            if (toolTable[pocket].offset.tran.y) fprintf(fp, " Y%+f", toolTable[pocket].offset.tran.y);
+            if (toolTable[pocket].offset.tran.z) fprintf(fp, " Z%+f", toolTable[pocket].offset.tran.z);
+            if (toolTable[pocket].offset.a) fprintf(fp, " A%+f", toolTable[pocket].offset.a);
+            if (toolTable[pocket].offset.b) fprintf(fp, " B%+f", toolTable[pocket].offset.b);
+            if (toolTable[pocket].offset.c) fprintf(fp, " C%+f", toolTable[pocket].offset.c);
+            if (toolTable[pocket].offset.u) fprintf(fp, " U%+f", toolTable[pocket].offset.u);
+            if (toolTable[pocket].offset.v) fprintf(fp, " V%+f", toolTable[pocket].offset.v);
+            if (toolTable[pocket].offset.w) fprintf(fp, " W%+f", toolTable[pocket].offset.w);
+            if (toolTable[pocket].frontangle) fprintf(fp, " I%+f", toolTable[pocket].frontangle);
+            if (toolTable[pocket].backangle) fprintf(fp, " J%+f", toolTable[pocket].backangle);
+            if (toolTable[pocket].orientation) fprintf(fp, " Q%d", toolTable[pocket].orientation);
+            fprintf(fp, " ;%s\n", ttcomments[pocket]);
+        }
+    }
+
+    int failed = ferror(fp);
+    if (fclose(fp) != 0 || failed || rename(tmpname, filename) != 0) {
+	unlink(tmpname);
+	return -1;
+    }
+    return 0;
+}
@@ -28,6 +28,20 @@ int loadToolTable(const char *filename,
 	int random_toolchanger
 	);
 
+/* writes the table back in the format loadToolTable reads, replacing
+   'filename' only once the whole table is written */
+int saveToolTable(const char *filename,
+	struct CANON_TOOL_TABLE toolTable[CANON_POCKETS_MAX],
+	int fms[CANON_POCKETS_MAX],
+	char *ttcomments[CANON_POCKETS_MAX],
+	int random_toolchanger
+	);
+
+/* nonzero if the two entries hold the same tool and offsets; a
+   EMC_TOOL_SET_OFFSET that changes nothing need not save the table */
+int toolTableEntryEqual(const struct CANON_TOOL_TABLE *a,
+	const struct CANON_TOOL_TABLE *b);
+
 #ifdef CPLUSPLUS
 }
 #endif
@@ -22,9 +22,11 @@
 #include "rs274ngc_interp.hh"
 #include "rs274ngc_return.hh"
 #include "inifile.hh"		// INIFILE
+#include "emcIniFile.hh"	// FindLinearUnits
 #include "canon.hh"		// _parameter_file_name
 #include "config.h"		// LINELEN
 #include "tool_parse.h"
+#include "canon_trace.h"
 #include <stdio.h>    /* gets, etc. */
 #include <stdlib.h>   /* exit       */
 #include <string.h>   /* strcpy     */
@@ -36,6 +38,8 @@
 #include <readline/history.h>
 #include <glob.h>
 #include <wordexp.h>
+#include <time.h>
+#include <sys/resource.h>
 
 InterpBase *pinterp;
 #define interp_new (*pinterp)
@@ -43,6 +47,28 @@ const char *prompt = "READ => ";
 const char *history = "~/.rs274";
 #define RS274_HISTORY "RS274_HISTORY"
 
+/* for -B: the canon calls so far are the lines saicanon has output */
+extern int _line_number;
+static int bench;
+extern FILE *_tracefile;
+static long long bench_lines;
+static double bench_read_secs, bench_execute_secs;
+
+/* for -V: errors are counted and printed one per line, and saicanon
+   checks the moves against the soft limits of the ini file */
+static int verify;
+static int verify_errors;
+extern int _sai_check_limits;
+extern int _sai_limit_errors;
+extern double _sai_min_limit[6], _sai_max_limit[6];
+
+static double bench_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 #define active_settings  interp_new.active_settings
 #define active_g_codes   interp_new.active_g_codes
 #define active_m_codes   interp_new.active_m_codes
@@ -105,6 +131,14 @@ void report_error( /* ARGUMENTS                            */
   char interp_error_text_buf[LINELEN];
   int k;
 
+  if (verify)
+    {
+      error_text(error_code, interp_error_text_buf, LINELEN);
+      fprintf(stderr, "line %d: %s\n", sequence_number(),
+              ((interp_error_text_buf[0] == 0) ? "Unknown error, bad error code" : interp_error_text_buf));
+      verify_errors++;
+      return;
+    }
   error_text(error_code, interp_error_text_buf, 5); /* for coverage of code */
   error_text(error_code, interp_error_text_buf, LINELEN);
   fprintf(stderr, "%s\n",
@@ -251,7 +285,14 @@ int interpret_from_file( /* ARGUMENTS                  */
 
   for(; ;)
     {
+      double t0 = bench ? bench_now() : 0;
       status = interp_read();
+      if (bench)
+        {
+          bench_read_secs += bench_now() - t0;
+          if (status != INTERP_ENDFILE)
+            bench_lines++;
+        }
       if ((status == INTERP_EXECUTE_FINISH) && (block_delete == ON))
         continue;
       else if (status == INTERP_ENDFILE)
@@ -281,7 +322,11 @@ int interpret_from_file( /* ARGUMENTS                  */
           else /* if do_next == 0 -- 0 means continue */
             continue;
         }
+      if (bench)
+        t0 = bench_now();
       status = interp_execute();
+      if (bench)
+        bench_execute_secs += bench_now() - t0;
       if ((status != INTERP_OK) &&
           (status != INTERP_EXIT) &&
           (status != INTERP_EXECUTE_FINISH))
@@ -307,6 +352,55 @@ int interpret_from_file( /* ARGUMENTS                  */
 
 /************************************************************************/
 
+/* read_soft_limits
+
+Returned Value: int
+  Returns 0 for success, 1 if the ini file cannot be opened.
+
+Side Effects:
+  The soft limits of saicanon are set from MIN_LIMIT and MAX_LIMIT of
+  [AXIS_0] to [AXIS_5], in the LINEAR_UNITS of [TRAJ].  Axes without
+  them are not limited.
+
+Called By:
+  main
+
+*/
+
+int read_soft_limits(const char *inifile)
+{
+  EmcIniFile ini;
+  EmcLinearUnits units = 1.0;
+  char section[16];
+  double limit;
+  int n;
+
+  if (!ini.Open(inifile))
+    {
+      fprintf(stderr, "could not open ini file %s\n", inifile);
+      return 1;
+    }
+  ini.FindLinearUnits(&units, "LINEAR_UNITS", "TRAJ");
+  for (n = 0; n < 6; n++)
+    {
+      /* units per mm for X Y Z, degrees for A B C */
+      double scale = (n < 3 && units > 0) ? 1.0 / units : 1.0;
+
+      snprintf(section, sizeof(section), "AXIS_%d", n);
+      _sai_min_limit[n] = -1e99;
+      _sai_max_limit[n] = 1e99;
+      if (ini.Find(&limit, "MIN_LIMIT", section) == IniFile::ERR_NONE)
+        _sai_min_limit[n] = limit * scale;
+      if (ini.Find(&limit, "MAX_LIMIT", section) == IniFile::ERR_NONE)
+        _sai_max_limit[n] = limit * scale;
+    }
+  ini.Close();
+  _sai_check_limits = 1;
+  return 0;
+}
+
+/************************************************************************/
+
 /* read_tool_file
 
 Returned Value: int
@@ -545,6 +639,7 @@ int main (int argc, char ** argv)
   int print_stack;
   int go_flag;
   char *inifile = NULL;
+  char *tracefile = NULL;
   int log_level = -1;
   std::string interp;
 
@@ -557,7 +652,7 @@ int main (int argc, char ** argv)
   go_flag = 0;
 
   while(1) {
-      int c = getopt(argc, argv, "p:t:v:bsn:gi:l:T");
+      int c = getopt(argc, argv, "p:t:v:bsn:gi:l:TBC:V");
       if(c == -1) break;
 
       switch(c) {
@@ -571,6 +666,9 @@ int main (int argc, char ** argv)
           case 'g': go_flag = !go_flag; break;
           case 'i': inifile = optarg; break;
           case 'T': _task = 1; break;
+          case 'B': bench = 1; go_flag = 1; break;
+          case 'C': tracefile = optarg; break;
+          case 'V': verify = 1; go_flag = 1; do_next = 0; break;
           case '?': default: goto usage;
       }
   }
@@ -580,7 +678,7 @@ int main (int argc, char ** argv)
 usage:
       fprintf(stderr,
             "Usage: %s [-p interp.so] [-t tool.tbl] [-v var-file.var] [-n 0|1|2]\n"
-            "          [-b] [-s] [-g] [input file [output file]]\n"
+            "          [-b] [-s] [-g] [-B] [-V] [-C trace file] [input file [output file]]\n"
             "\n"
             "    -p: Specify the pluggable interpreter to use\n"
             "    -t: Specify the .tbl (tool table) file to use\n"
@@ -595,6 +693,14 @@ usage:
             "    -i: specify the .ini file (default: no ini file)\n"
             "    -T: call task_init()\n"
             "    -l: specify the log_level (default: -1)\n"
+            "    -B: benchmark: implies -g, discards the canon output unless\n"
+            "        an output file is given, and prints timings on stderr\n"
+            "    -C: also write the canon calls to a binary trace file,\n"
+            "        which canterp and tpbench can replay\n"
+            "    -V: verify: implies -g and -n 0, discards the canon output unless\n"
+            "        an output file is given, prints each error and each move past\n"
+            "        the soft limits of the -i ini file as 'line N: ...', and exits\n"
+            "        with 1 if there were any\n"
             , argv[0]);
       exit(1);
     }
@@ -656,8 +762,21 @@ usage:
           exit(1);
         }
     }
+  else if (bench || verify)
+    _outfile = fopen("/dev/null", "w");
+  if (tracefile != 0)
+    {
+      _tracefile = fopen(tracefile, "w");
+      if (_tracefile == NULL || canon_trace_write_header(_tracefile) != 0)
+        {
+          fprintf(stderr, "could not open trace file %s\n", tracefile);
+          exit(1);
+        }
+    }
   if (inifile!= 0) {
       setenv("INI_FILE_NAME",inifile,1);
+      if (verify && read_soft_limits(inifile) != 0)
+        exit(1);
   } else
       unsetenv("INI_FILE_NAME");
 
@@ -681,7 +800,31 @@ usage:
           report_error(status, print_stack);
           exit(1);
         }
+      double t0 = bench_now();
       status = interpret_from_file(do_next, block_delete, print_stack);
+      if (bench)
+        {
+          double secs = bench_now() - t0;
+          struct rusage ru;
+          getrusage(RUSAGE_SELF, &ru);
+          fprintf(stderr, "lines %lld\n", bench_lines);
+          fprintf(stderr, "canon-calls %d\n", _line_number - 1);
+          fprintf(stderr, "secs %.6f\n", secs);
+          fprintf(stderr, "read-secs %.6f\n", bench_read_secs);
+          fprintf(stderr, "execute-secs %.6f\n", bench_execute_secs);
+          fprintf(stderr, "lines-per-sec %.0f\n",
+                  secs > 0 ? bench_lines / secs : 0.0);
+          fprintf(stderr, "canon-calls-per-sec %.0f\n",
+                  secs > 0 ? (_line_number - 1) / secs : 0.0);
+          fprintf(stderr, "peak-rss-kb %ld\n", ru.ru_maxrss);
+        }
+      if (verify)
+        {
+          fprintf(stderr, "verify: %d errors, %d moves past the soft limits\n",
+                  verify_errors, _sai_limit_errors);
+          if (verify_errors || _sai_limit_errors)
+            status = 1;
+        }
       file_name(buffer, 5);  /* called to exercise the function */
       file_name(buffer, 79); /* called to exercise the function */
       interp_close();
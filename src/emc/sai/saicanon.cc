@@ -34,6 +34,7 @@
 #include "canon.hh"
 #include "rs274ngc.hh"
 #include "rs274ngc_interp.hh"
+#include "canon_trace.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -44,6 +45,7 @@
 /* where to print */
 //extern FILE * _outfile;
 FILE * _outfile=NULL;      /* where to print, set in main */
+FILE * _tracefile=NULL;    /* binary trace (rs274 -C), set in main */
 
 /* Dummy world model */
 
@@ -54,7 +56,7 @@ static double            _feed_rate = 0.0;
 static int               _flood = 0;
 static double            _length_unit_factor = 1; /* 1 for MM 25.4 for inch */
 static CANON_UNITS       _length_unit_type = CANON_UNITS_MM;
-static int               _line_number = 1;
+int                      _line_number = 1;      /*Not static.Driver reads it for -B*/
 static int               _mist = 0;
 static CANON_MOTION_MODE _motion_mode = CANON_CONTINUOUS;
 char                     _parameter_file_name[PARAMETER_FILE_NAME_LENGTH];/*Not static.Driver writes*/
@@ -88,6 +90,13 @@ static double naivecam_tolerance = 0.;
 static double            _traverse_rate;
 
 static EmcPose _tool_offset;
+
+/* for -V: the soft limits of X Y Z A B C in mm and degrees, set by the
+   driver from the ini file.  Moves past them are printed on stderr with
+   their line number, and counted. */
+int _sai_check_limits = 0;
+int _sai_limit_errors = 0;
+double _sai_min_limit[6], _sai_max_limit[6];
 static bool _toolchanger_fault;
 static int  _toolchanger_reason;
 
@@ -112,6 +121,22 @@ stdout to a file.
 extern InterpBase *pinterp;
 #define interp_new (*pinterp)
 
+/* the calls canterp and tpbench can replay go to _tracefile too */
+static void trace(int type, int nargs, const double *args, const char *text)
+{
+  if (_tracefile != NULL)
+    canon_trace_write(_tracefile, type, interp_new.sequence_number(),
+                      args, nargs, text);
+}
+#define TRACE0(type) trace(CANON_TRACE_##type, 0, NULL, NULL)
+#define TRACE1(type, arg) do { double _a = (arg);                      \
+          trace(CANON_TRACE_##type, 1, &_a, NULL); } while (0)
+#define TRACE2(type, arg1, arg2) do { double _a[2] = { (double)(arg1), \
+          (double)(arg2) }; trace(CANON_TRACE_##type, 2, _a, NULL); } while (0)
+#define TRACEV(type, args)                                            \
+          trace(CANON_TRACE_##type, sizeof(args) / sizeof(double), args, NULL)
+#define TRACES(type, text) trace(CANON_TRACE_##type, 0, NULL, text)
+
 void print_nc_line_number()
 {
   char text[256];
@@ -266,6 +291,7 @@ void USE_LENGTH_UNITS(CANON_UNITS in_unit)
   if (in_unit == CANON_UNITS_INCHES)
     {
       PRINT0("USE_LENGTH_UNITS(CANON_UNITS_INCHES)\n");
+      TRACE1(USE_LENGTH_UNITS, in_unit);
       if (_length_unit_type == CANON_UNITS_MM)
         {
           _length_unit_type = CANON_UNITS_INCHES;
@@ -287,6 +313,7 @@ void USE_LENGTH_UNITS(CANON_UNITS in_unit)
   else if (in_unit == CANON_UNITS_MM)
     {
       PRINT0("USE_LENGTH_UNITS(CANON_UNITS_MM)\n");
+      TRACE1(USE_LENGTH_UNITS, in_unit);
       if (_length_unit_type == CANON_UNITS_INCHES)
         {
           _length_unit_type = CANON_UNITS_MM;
@@ -309,6 +336,85 @@ void USE_LENGTH_UNITS(CANON_UNITS in_unit)
     PRINT0("USE_LENGTH_UNITS(UNKNOWN)\n");
 }
 
+/* machine position of program position x .. c against the soft limits */
+static void check_limits(double x, double y, double z,
+                         double a, double b, double c)
+{
+  static const char axes[] = "XYZABC";
+  double pos[6];
+  int i;
+
+  pos[0] = (x + _g5x_x + _g92_x + _tool_offset.tran.x) * _length_unit_factor;
+  pos[1] = (y + _g5x_y + _g92_y + _tool_offset.tran.y) * _length_unit_factor;
+  pos[2] = (z + _g5x_z + _g92_z + _tool_offset.tran.z) * _length_unit_factor;
+  pos[3] = a + _g5x_a + _g92_a + _tool_offset.a;
+  pos[4] = b + _g5x_b + _g92_b + _tool_offset.b;
+  pos[5] = c + _g5x_c + _g92_c + _tool_offset.c;
+  for (i = 0; i < 6; i++)
+    {
+      if (pos[i] < _sai_min_limit[i] || pos[i] > _sai_max_limit[i])
+        {
+          _sai_limit_errors++;
+          fprintf(stderr, "line %d: %c %.4f outside the soft limits %.4f to %.4f\n",
+                  interp_new.sequence_number(), axes[i], pos[i],
+                  _sai_min_limit[i], _sai_max_limit[i]);
+        }
+    }
+}
+
+/* point of the active plane, as ARC_FEED takes them */
+static void check_plane_limits(double first, double second, double axis,
+                               double a, double b, double c)
+{
+  if (_active_plane == CANON_PLANE_XY)
+    check_limits(first, second, axis, a, b, c);
+  else if (_active_plane == CANON_PLANE_YZ)
+    check_limits(axis, first, second, a, b, c);
+  else /* if (_active_plane == CANON_PLANE_XZ) */
+    check_limits(second, axis, first, a, b, c);
+}
+
+/* an arc reaches past its end points where it crosses the axes through
+   its center, so those crossings are checked too */
+static void check_arc_limits(double first_start, double second_start,
+                             double first_end, double second_end,
+                             double first_axis, double second_axis,
+                             int rotation, double axis_end_point,
+                             double a, double b, double c)
+{
+  double r = hypot(first_end - first_axis, second_end - second_axis);
+  double t0 = atan2(second_start - second_axis, first_start - first_axis);
+  double t1 = atan2(second_end - second_axis, first_end - first_axis);
+  double sweep = t1 - t0;
+  int k;
+
+  if (rotation > 0)
+    {
+      if (sweep <= 0)
+        sweep += 2 * M_PI;
+      sweep += 2 * M_PI * (rotation - 1);
+    }
+  else if (rotation < 0)
+    {
+      if (sweep >= 0)
+        sweep -= 2 * M_PI;
+      sweep -= 2 * M_PI * (-rotation - 1);
+    }
+  else
+    sweep = 0;
+  for (k = 0; sweep != 0 && k < 4; k++)
+    {
+      double t = k * M_PI_2;
+      /* how far round the arc goes to get to t */
+      double d = (sweep > 0) ? fmod(t - t0 + 4 * M_PI, 2 * M_PI)
+                             : fmod(t0 - t + 4 * M_PI, 2 * M_PI);
+      if (d < fabs(sweep))
+        check_plane_limits(first_axis + r * cos(t), second_axis + r * sin(t),
+                           axis_end_point, a, b, c);
+    }
+  check_plane_limits(first_end, second_end, axis_end_point, a, b, c);
+}
+
 /* Free Space Motion */
 void SET_TRAVERSE_RATE(double rate)
 {
@@ -324,6 +430,9 @@ void STRAIGHT_TRAVERSE( int line_number,
  , double u, double v, double w
 )
 {
+  double args[] = { x, y, z, a, b, c, u, v, w };
+
+  TRACEV(STRAIGHT_TRAVERSE, args);
   fprintf(_outfile, "%5d ", _line_number++);
   print_nc_line_number();
   fprintf(_outfile, "STRAIGHT_TRAVERSE(%.4f, %.4f, %.4f"
@@ -335,6 +444,8 @@ void STRAIGHT_TRAVERSE( int line_number,
          , b /*BB*/
          , c /*CC*/
          );
+  if (_sai_check_limits)
+    check_limits(x, y, z, a, b, c);
   _program_position_x = x;
   _program_position_y = y;
   _program_position_z = z;
@@ -352,6 +463,7 @@ void SET_FEED_MODE(int mode)
 void SET_FEED_RATE(double rate)
 {
   PRINT1("SET_FEED_RATE(%.4f)\n", rate);
+  TRACE1(SET_FEED_RATE, rate);
   _feed_rate = rate;
 }
 
@@ -359,11 +471,13 @@ void SET_FEED_REFERENCE(CANON_FEED_REFERENCE reference)
 {
   PRINT1("SET_FEED_REFERENCE(%s)\n",
          (reference == CANON_WORKPIECE) ? "CANON_WORKPIECE" : "CANON_XYZ");
+  TRACE1(SET_FEED_REFERENCE, reference);
 }
 
 extern void SET_MOTION_CONTROL_MODE(CANON_MOTION_MODE mode, double tolerance)
 {
   motion_tolerance = 0;
+  TRACE2(SET_MOTION_CONTROL_MODE, mode, tolerance);
   if (mode == CANON_EXACT_STOP)
     {
       PRINT0("SET_MOTION_CONTROL_MODE(CANON_EXACT_STOP)\n");
@@ -396,6 +510,7 @@ void SELECT_PLANE(CANON_PLANE in_plane)
          ((in_plane == CANON_PLANE_XY) ? "XY" :
           (in_plane == CANON_PLANE_YZ) ? "YZ" :
           (in_plane == CANON_PLANE_XZ) ? "XZ" : "UNKNOWN"));
+  TRACE1(SELECT_PLANE, in_plane);
   _active_plane = in_plane;
 }
 
@@ -415,7 +530,10 @@ void START_SPEED_FEED_SYNCH()
 {PRINT0 ("START_SPEED_FEED_SYNCH()\n");}
 
 void STOP_SPEED_FEED_SYNCH()
-{PRINT0 ("STOP_SPEED_FEED_SYNCH()\n");}
+{
+  PRINT0 ("STOP_SPEED_FEED_SYNCH()\n");
+  TRACE0(STOP_SPEED_FEED_SYNCH);
+}
 
 /* Machining Functions */
 
@@ -454,6 +572,10 @@ void ARC_FEED(int line_number,
  , double u, double v, double w
 )
 {
+  double args[] = { first_end, second_end, first_axis, second_axis,
+                    (double) rotation, axis_end_point, a, b, c, u, v, w };
+
+  TRACEV(ARC_FEED, args);
   fprintf(_outfile, "%5d ", _line_number++);
   print_nc_line_number();
   fprintf(_outfile, "ARC_FEED(%.4f, %.4f, %.4f, %.4f, %d, %.4f"
@@ -466,6 +588,21 @@ void ARC_FEED(int line_number,
          , b /*BB*/
          , c /*CC*/
          );
+  if (_sai_check_limits)
+    {
+      if (_active_plane == CANON_PLANE_XY)
+        check_arc_limits(_program_position_x, _program_position_y,
+                         first_end, second_end, first_axis, second_axis,
+                         rotation, axis_end_point, a, b, c);
+      else if (_active_plane == CANON_PLANE_YZ)
+        check_arc_limits(_program_position_y, _program_position_z,
+                         first_end, second_end, first_axis, second_axis,
+                         rotation, axis_end_point, a, b, c);
+      else /* if (_active_plane == CANON_PLANE_XZ) */
+        check_arc_limits(_program_position_z, _program_position_x,
+                         first_end, second_end, first_axis, second_axis,
+                         rotation, axis_end_point, a, b, c);
+    }
   if (_active_plane == CANON_PLANE_XY)
     {
       _program_position_x = first_end;
@@ -497,6 +634,9 @@ void STRAIGHT_FEED(int line_number,
  , double u, double v, double w
 )
 {
+  double args[] = { x, y, z, a, b, c, u, v, w };
+
+  TRACEV(STRAIGHT_FEED, args);
   fprintf(_outfile, "%5d ", _line_number++);
   print_nc_line_number();
   fprintf(_outfile, "STRAIGHT_FEED(%.4f, %.4f, %.4f"
@@ -508,6 +648,8 @@ void STRAIGHT_FEED(int line_number,
          , b /*BB*/
          , c /*CC*/
          );
+  if (_sai_check_limits)
+    check_limits(x, y, z, a, b, c);
   _program_position_x = x;
   _program_position_y = y;
   _program_position_z = z;
@@ -516,6 +658,35 @@ void STRAIGHT_FEED(int line_number,
   _program_position_c = c; /*CC*/
 }
 
+void DRILL_CYCLE(int line_number,
+ double x, double y, double z
+ , double a /*AA*/
+ , double b /*BB*/
+ , double c /*CC*/
+ , double u, double v, double w
+ , int axis, double clear, double dwell
+)
+{
+  static const char axes[] = "XYZABCUVW";
+  fprintf(_outfile, "%5d ", _line_number++);
+  print_nc_line_number();
+  fprintf(_outfile, "DRILL_CYCLE(%.4f, %.4f, %.4f"
+         ", %.4f" /*AA*/
+         ", %.4f" /*BB*/
+         ", %.4f" /*CC*/
+         ", %c, %.4f, %.4f)\n", x, y, z
+         , a /*AA*/
+         , b /*BB*/
+         , c /*CC*/
+         , axes[axis], clear, dwell
+         );
+  _program_position_x = axis == 0 ? clear : x;
+  _program_position_y = axis == 1 ? clear : y;
+  _program_position_z = axis == 2 ? clear : z;
+  _program_position_a = a; /*AA*/
+  _program_position_b = b; /*BB*/
+  _program_position_c = c; /*CC*/
+}
 
 /* This models backing the probe off 0.01 inch or 0.254 mm from the probe
 point towards the previous location after the probing, if the probe
@@ -532,7 +703,9 @@ void STRAIGHT_PROBE(int line_number,
   double distance;
   double dx, dy, dz;
   double backoff;
+  double args[] = { x, y, z, a, b, c, u, v, w, (double) probe_type };
 
+  TRACEV(STRAIGHT_PROBE, args);
   dx = (_program_position_x - x);
   dy = (_program_position_y - y);
   dz = (_program_position_z - z);
@@ -586,7 +759,10 @@ void RIGID_TAP(int line_number, double x, double y, double z)
 
 
 void DWELL(double seconds)
-{PRINT1("DWELL(%.4f)\n", seconds);}
+{
+  PRINT1("DWELL(%.4f)\n", seconds);
+  TRACE1(DWELL, seconds);
+}
 
 /* Spindle Functions */
 void SPINDLE_RETRACT_TRAVERSE()
@@ -599,6 +775,7 @@ void SET_SPINDLE_MODE(double arg) {
 void START_SPINDLE_CLOCKWISE(int l)
 {
   PRINT0("START_SPINDLE_CLOCKWISE()\n");
+  TRACE0(START_SPINDLE_CLOCKWISE);
   _spindle_turning = ((_spindle_speed == 0) ? CANON_STOPPED :
                                                    CANON_CLOCKWISE);
 }
@@ -606,6 +783,7 @@ void START_SPINDLE_CLOCKWISE(int l)
 void START_SPINDLE_COUNTERCLOCKWISE(int l)
 {
   PRINT0("START_SPINDLE_COUNTERCLOCKWISE()\n");
+  TRACE0(START_SPINDLE_COUNTERCLOCKWISE);
   _spindle_turning = ((_spindle_speed == 0) ? CANON_STOPPED :
                                                    CANON_COUNTERCLOCKWISE);
 }
@@ -613,12 +791,14 @@ void START_SPINDLE_COUNTERCLOCKWISE(int l)
 void SET_SPINDLE_SPEED(double rpm)
 {
   PRINT1("SET_SPINDLE_SPEED(%.4f)\n", rpm);
+  TRACE1(SET_SPINDLE_SPEED, rpm);
   _spindle_speed = rpm;
 }
 
 void STOP_SPINDLE_TURNING()
 {
   PRINT0("STOP_SPINDLE_TURNING()\n");
+  TRACE0(STOP_SPINDLE_TURNING);
   _spindle_turning = CANON_STOPPED;
 }
 
@@ -626,7 +806,9 @@ void SPINDLE_RETRACT()
 {PRINT0("SPINDLE_RETRACT()\n");}
 
 void ORIENT_SPINDLE(double orientation, int mode)
-{PRINT2("ORIENT_SPINDLE(%.4f, %d)\n", orientation,mode);
+{
+  PRINT2("ORIENT_SPINDLE(%.4f, %d)\n", orientation,mode);
+  TRACE2(ORIENT_SPINDLE, orientation, mode);
 }
 
 void WAIT_SPINDLE_ORIENT_COMPLETE(double timeout) 
@@ -662,12 +844,16 @@ void USE_TOOL_LENGTH_OFFSET(EmcPose offset)
 void CHANGE_TOOL(int slot)
 {
   PRINT1("CHANGE_TOOL(%d)\n", slot);
+  TRACE1(CHANGE_TOOL, slot);
   _active_slot = slot;
   _tools[0] = _tools[slot];
 }
 
 void SELECT_POCKET(int slot, int tool)
-{PRINT1("SELECT_POCKET(%d)\n", slot);}
+{
+  PRINT1("SELECT_POCKET(%d)\n", slot);
+  TRACE2(SELECT_POCKET, slot, tool);
+}
 
 void CHANGE_TOOL_NUMBER(int slot)
 {
@@ -688,7 +874,10 @@ void CLAMP_AXIS(CANON_AXIS axis)
         (axis == CANON_AXIS_C) ? "CANON_AXIS_C" : "UNKNOWN");}
 
 void COMMENT(const char *s)
-{PRINT1("COMMENT(\"%s\")\n", s);}
+{
+  PRINT1("COMMENT(\"%s\")\n", s);
+  TRACES(COMMENT, s);
+}
 
 void DISABLE_ADAPTIVE_FEED()
 {PRINT0("DISABLE_ADAPTIVE_FEED()\n");}
@@ -697,10 +886,16 @@ void DISABLE_FEED_HOLD()
 {PRINT0("DISABLE_FEED_HOLD()\n");}
 
 void DISABLE_FEED_OVERRIDE()
-{PRINT0("DISABLE_FEED_OVERRIDE()\n");}
+{
+  PRINT0("DISABLE_FEED_OVERRIDE()\n");
+  TRACE0(DISABLE_FEED_OVERRIDE);
+}
 
 void DISABLE_SPEED_OVERRIDE()
-{PRINT0("DISABLE_SPEED_OVERRIDE()\n");}
+{
+  PRINT0("DISABLE_SPEED_OVERRIDE()\n");
+  TRACE0(DISABLE_SPEED_OVERRIDE);
+}
 
 void ENABLE_ADAPTIVE_FEED()
 {PRINT0("ENABLE_ADAPTIVE_FEED()\n");}
@@ -709,29 +904,41 @@ void ENABLE_FEED_HOLD()
 {PRINT0("ENABLE_FEED_HOLD()\n");}
 
 void ENABLE_FEED_OVERRIDE()
-{PRINT0("ENABLE_FEED_OVERRIDE()\n");}
+{
+  PRINT0("ENABLE_FEED_OVERRIDE()\n");
+  TRACE0(ENABLE_FEED_OVERRIDE);
+}
 
 void ENABLE_SPEED_OVERRIDE()
-{PRINT0("ENABLE_SPEED_OVERRIDE()\n");}
+{
+  PRINT0("ENABLE_SPEED_OVERRIDE()\n");
+  TRACE0(ENABLE_SPEED_OVERRIDE);
+}
 
 void FLOOD_OFF()
 {
   PRINT0("FLOOD_OFF()\n");
+  TRACE0(FLOOD_OFF);
   _flood = 0;
 }
 
 void FLOOD_ON()
 {
   PRINT0("FLOOD_ON()\n");
+  TRACE0(FLOOD_ON);
   _flood = 1;
 }
 
 void INIT_CANON()
 {
+  TRACE0(INIT_CANON);
 }
 
 void MESSAGE(char *s)
-{PRINT1("MESSAGE(\"%s\")\n", s);}
+{
+  PRINT1("MESSAGE(\"%s\")\n", s);
+  TRACES(MESSAGE, s);
+}
 
 void LOG(char *s)
 {PRINT1("LOG(\"%s\")\n", s);}
@@ -745,23 +952,34 @@ void LOGCLOSE()
 void MIST_OFF()
 {
   PRINT0("MIST_OFF()\n");
+  TRACE0(MIST_OFF);
   _mist = 0;
 }
 
 void MIST_ON()
 {
   PRINT0("MIST_ON()\n");
+  TRACE0(MIST_ON);
   _mist = 1;
 }
 
 void PALLET_SHUTTLE()
-{PRINT0("PALLET_SHUTTLE()\n");}
+{
+  PRINT0("PALLET_SHUTTLE()\n");
+  TRACE0(PALLET_SHUTTLE);
+}
 
 void TURN_PROBE_OFF()
-{PRINT0("TURN_PROBE_OFF()\n");}
+{
+  PRINT0("TURN_PROBE_OFF()\n");
+  TRACE0(TURN_PROBE_OFF);
+}
 
 void TURN_PROBE_ON()
-{PRINT0("TURN_PROBE_ON()\n");}
+{
+  PRINT0("TURN_PROBE_ON()\n");
+  TRACE0(TURN_PROBE_ON);
+}
 
 void UNCLAMP_AXIS(CANON_AXIS axis)
 {PRINT1("UNCLAMP_AXIS(%s)\n",
@@ -775,7 +993,10 @@ void UNCLAMP_AXIS(CANON_AXIS axis)
 /* Program Functions */
 
 void PROGRAM_STOP()
-{PRINT0("PROGRAM_STOP()\n");}
+{
+  PRINT0("PROGRAM_STOP()\n");
+  TRACE0(PROGRAM_STOP);
+}
 
 void SET_BLOCK_DELETE(bool state)
 {block_delete = state;} //state == ON, means we don't interpret lines starting with "/"
@@ -790,10 +1011,16 @@ bool GET_OPTIONAL_PROGRAM_STOP()
 {return optional_program_stop;} //state == ON, means we stop
 
 void OPTIONAL_PROGRAM_STOP()
-{PRINT0("OPTIONAL_PROGRAM_STOP()\n");}
+{
+  PRINT0("OPTIONAL_PROGRAM_STOP()\n");
+  TRACE0(OPTIONAL_PROGRAM_STOP);
+}
 
 void PROGRAM_END()
-{PRINT0("PROGRAM_END()\n");}
+{
+  PRINT0("PROGRAM_END()\n");
+  TRACE0(PROGRAM_END);
+}
 
 
 /*************************************************************************/
@@ -827,7 +1054,10 @@ double GET_EXTERNAL_ANGLE_UNITS() {return 1.0;}
 int GET_EXTERNAL_SELECTED_TOOL_SLOT() { return 0; }
 int GET_EXTERNAL_SPINDLE_OVERRIDE_ENABLE() {return 1;}
 void START_SPEED_FEED_SYNCH(double sync, bool vel)
-{PRINT2("START_SPEED_FEED_SYNC(%f,%d)\n", sync, vel);}
+{
+  PRINT2("START_SPEED_FEED_SYNC(%f,%d)\n", sync, vel);
+  TRACE2(START_SPEED_FEED_SYNCH, sync, vel);
+}
 CANON_MOTION_MODE motion_mode;
 
 int GET_EXTERNAL_DIGITAL_INPUT(int index, int def) { return def; }
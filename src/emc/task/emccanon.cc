@@ -44,6 +44,9 @@
 #include "canon.hh"		// these decls
 #include "interpl.hh"		// interp_list
 #include "emcglb.h"		// TRAJ_MAX_VELOCITY
+#include "canon_trace.h"	// canon_trace_write()
+
+extern void CANON_ERROR(const char *fmt, ...) __attribute__((format(printf,1,2)));
 
 #define TRACE 0
 #include "dptrace.h"
@@ -67,6 +70,28 @@ static FILE *dptrace = fopen("emccanon.log","w");
 
 static CanonConfig_t canon;
 
+/*
+  With EMC_CANON_TRACE set to a file name, the calls canterp and tpbench
+  can replay are written there as well, as the interpreter made them,
+  in program units, before anything here changes them.  The file is
+  opened by the first INIT_CANON().
+  */
+static FILE *canon_trace_file;
+
+static void canon_trace(int type, int line, int nargs = 0,
+			const double *args = 0, const char *text = 0)
+{
+    if (canon_trace_file &&
+	canon_trace_write(canon_trace_file, type, line, args, nargs, text)) {
+	fclose(canon_trace_file);
+	canon_trace_file = 0;
+	CANON_ERROR("can't write to the canon trace, stopped it");
+    }
+}
+
+#define canon_trace1(type, arg) do { double _a = (arg);			\
+	canon_trace(type, -1, 1, &_a); } while (0)
+
 static int debug_velacc = 0;
 static const double tiny = 1e-7;
 static const double huge = 1e9;
@@ -132,13 +157,16 @@ static const double huge = 1e9;
 static PM_QUATERNION quat(1, 0, 0, 0);
 
 static void flush_segments(void);
+static void nurbs_move(int line_number,
+                       const std::vector<CONTROL_POINT> &nurbs_control_points,
+                       const std::vector<double> &nurbs_knot_vector,
+                       unsigned int k, double curve_length, uint32_t axis_mask);
 
 /*
   These decls were from the old 3-axis canon.hh, and refer functions
   defined here that are used for convenience but no longer have decls
   in the 6-axis canon.hh. So, we declare them here now.
 */
-extern void CANON_ERROR(const char *fmt, ...) __attribute__((format(printf,1,2)));
 
 #ifndef D2R
 #define D2R(r) ((r)*M_PI/180.0)
@@ -470,6 +498,7 @@ void SET_G92_OFFSET(double x, double y, double z,
 
 void USE_LENGTH_UNITS(CANON_UNITS in_unit)
 {
+    canon_trace1(CANON_TRACE_USE_LENGTH_UNITS, in_unit);
     canon.lengthUnits = in_unit;
 
     emcStatus->task.programUnits = in_unit;
@@ -489,6 +518,7 @@ void SET_FEED_MODE(int mode) {
 
 void SET_FEED_RATE(double rate)
 {
+    canon_trace1(CANON_TRACE_SET_FEED_RATE, rate);
 
     if(canon.feed_mode) {
 	START_SPEED_FEED_SYNCH(rate, 1);
@@ -513,6 +543,7 @@ void SET_FEED_RATE(double rate)
 
 void SET_FEED_REFERENCE(CANON_FEED_REFERENCE reference)
 {
+    canon_trace1(CANON_TRACE_SET_FEED_REFERENCE, reference);
     // nothing need be done here
 }
 double getStraightJerk(double x, double y, double z,
@@ -876,18 +907,149 @@ double getStraightVelocity(double x, double y, double z,
 #include <vector>
 struct pt { double x, y, z, a, b, c, u, v, w; int line_no;};
 
+/* longest chain of feed moves, and for fitting chains with a spline: the
+   longest chain, the spline order, the fewest moves worth fitting, the
+   cosine of the sharpest turn inside a chain and how many points of each
+   move are checked */
+static const unsigned int chain_max_points = 1000;
+static const unsigned int chain_fit_max_points = 100;
+static const int chain_fit_order = 4;
+static const int chain_fit_min_points = 4;
+static const double chain_fit_max_turn = 0.866;
+static const int chain_fit_samples = 4;
+
+static bool chain_fit_enabled(void);
+
+/* Directions of a line from canon.endPoint that passes within the naive
+   cam tolerance of every chained point: a cone around axis, everything
+   while half_angle is M_PI and nothing once it is negative.  A point at
+   distance r from the start only allows directions within asin(tol / r)
+   of its own, and the cone is kept inside the intersection of those, so
+   a new end point in the cone and at least max_r away needs no rescan of
+   the chain.  Points linked only by the spline rule bend the chain, and a
+   bent chain is not checked for collinearity again. */
+static struct {
+    PM_CARTESIAN axis;
+    double half_angle;
+    double max_r;
+    bool bent;
+} chain_cone;
+
 static std::vector<struct pt>& chained_points(void) 
 {
     static std::vector<struct pt> points;
     return points;
 }
 
-static void flush_segments(void) 
+/* distance from P to the segment from A to B */
+static double segment_distance(const PM_CARTESIAN &P,
+                               const PM_CARTESIAN &A, const PM_CARTESIAN &B)
 {
+    PM_CARTESIAN M = B - A;
+    double mm = dot(M, M);
+    double t0 = mm > 0 ? dot(M, P - A) / mm : 0;
 
-    if(chained_points().empty()) return;
-    struct pt &pos = chained_points().back();
+    if(t0 < 0) t0 = 0;
+    if(t0 > 1) t0 = 1;
+    return mag(P - (A + t0 * M));
+}
+
+/* true if the chained points from first up to (not including) last are
+   all within the naive cam tolerance of the line from canon.endPoint to
+   x, y, z */
+static bool chain_within(unsigned int first, unsigned int last,
+                         double x, double y, double z)
+{
+    PM_CARTESIAN B(canon.endPoint.x, canon.endPoint.y, canon.endPoint.z),
+                 E(x, y, z);
 
+    for(unsigned int i = first; i < last; i++) {
+        struct pt &p = chained_points()[i];
+        if(segment_distance(PM_CARTESIAN(p.x, p.y, p.z), B, E) > canon.naivecamTolerance)
+            return false;
+    }
+    return true;
+}
+
+static void chain_cone_reset(void)
+{
+    chain_cone.half_angle = M_PI;
+    chain_cone.max_r = 0;
+    chain_cone.bent = false;
+}
+
+/* External calls to copy the canon settings for a run-from-line
+   checkpoint and put them back.  The end point stays, emctask sets it
+   from the machine position while skipping, and moves waiting to be
+   joined are dropped, they are from before the checkpoint. */
+void CANON_SAVE_STATE(CanonConfig_t *state)
+{
+    *state = canon;
+}
+
+void CANON_RESTORE_STATE(const CanonConfig_t *state)
+{
+    CANON_POSITION endPoint = canon.endPoint;
+
+    chained_points().clear();
+    chain_cone_reset();
+    canon = *state;
+    canon.endPoint = endPoint;
+}
+
+static bool chain_cone_holds(double x, double y, double z)
+{
+    PM_CARTESIAN d(x - canon.endPoint.x, y - canon.endPoint.y, z - canon.endPoint.z);
+
+    if(chain_cone.half_angle < 0 || mag(d) < chain_cone.max_r) return false;
+    if(chain_cone.half_angle >= M_PI) return true;
+    return atan2(mag(cross(chain_cone.axis, d)), dot(chain_cone.axis, d))
+        <= chain_cone.half_angle;
+}
+
+/* shrinks the cone to the widest one inside both it and the directions
+   the newly chained point x, y, z allows */
+static void chain_cone_add(double x, double y, double z)
+{
+    PM_CARTESIAN v(x - canon.endPoint.x, y - canon.endPoint.y, z - canon.endPoint.z);
+    double r = mag(v), phi, delta, beta;
+
+    if(r > chain_cone.max_r) chain_cone.max_r = r;
+    if(r <= canon.naivecamTolerance || chain_cone.half_angle < 0) return;
+    v = v / r;
+    phi = asin(canon.naivecamTolerance / r);
+    if(chain_cone.half_angle >= M_PI) {
+        chain_cone.axis = v;
+        chain_cone.half_angle = phi;
+        return;
+    }
+    delta = atan2(mag(cross(chain_cone.axis, v)), dot(chain_cone.axis, v));
+    if(delta + chain_cone.half_angle <= phi) {
+        // already inside the new one
+    } else if(delta + phi <= chain_cone.half_angle) {
+        chain_cone.axis = v;
+        chain_cone.half_angle = phi;
+    } else if(delta > chain_cone.half_angle + phi) {
+        chain_cone.half_angle = -1;
+    } else {
+        // centred on the overlap of the two along the arc between the axes
+        beta = (delta + chain_cone.half_angle - phi) / 2;
+        chain_cone.axis = (sin(delta - beta) * chain_cone.axis + sin(beta) * v)
+            / sin(delta);
+        chain_cone.half_angle = (chain_cone.half_angle + phi - delta) / 2;
+    }
+}
+
+/* chain_within(), answered from the chain cone when it can be; the cone
+   holds the points from first up to (not including) last */
+static bool chain_collinear(unsigned int first, unsigned int last,
+                            double x, double y, double z)
+{
+    return chain_cone_holds(x, y, z) || chain_within(first, last, x, y, z);
+}
+
+static void send_chained_line(const struct pt &pos)
+{
     double x = pos.x, y = pos.y, z = pos.z;
     double a = pos.a, b = pos.b, c = pos.c;
     double u = pos.u, v = pos.v, w = pos.w;
@@ -897,11 +1059,6 @@ static void flush_segments(void)
     DP("line_no(%d) x(%f) y(%f) z(%f) a(%f) b(%f) c(%f) u(%f) v(%f) w(%f)\n",
         line_no, x, y, z, a, b, c, u, v, w);
 
-#ifdef SHOW_JOINED_SEGMENTS
-    for(unsigned int i=0; i != chained_points().size(); i++) { printf("."); }
-    printf("\n");
-#endif
-
     double ini_maxvel;
     double vel;
 
@@ -953,8 +1110,241 @@ static void flush_segments(void)
         interp_list.append(linearMoveMsg);
     }
     canonUpdateEndPoint(x, y, z, a, b, c, u, v, w);
+}
 
-    chained_points().clear();
+/* Chains of feed moves that are not collinear can still go out as one
+   move: with G64 and a naive cam tolerance, a run of xyz feed moves that
+   turns gently at every point is chained like a collinear one, and when
+   it is flushed it is fit with a cubic B-spline that starts and ends on
+   the first and last points and stays within the tolerance of every
+   programmed point and of the segments between them.  The spline is sent
+   as a single NURBS move, so CAM surfacing code of many short blocks
+   takes a handful of motion queue entries instead of one per block.  A run
+   that cannot be fit goes out as lines, collinear stretches collapsed as
+   before. */
+static bool chain_fit_enabled(void)
+{
+    return canon.motionMode == CANON_CONTINUOUS && canon.naivecamTolerance > 0
+        && !canon.feed_mode && !canon.synched;
+}
+
+/* point of the clamped cubic with control points P and knots U at u */
+static PM_CARTESIAN chain_fit_point(const std::vector<PM_CARTESIAN> &P,
+                                    std::vector<double> &U, double u)
+{
+    int p = chain_fit_order - 1, n = P.size() - 1;
+    double N[chain_fit_order];
+    PM_CARTESIAN C(0, 0, 0);
+    int s, i;
+
+    if(u >= U[n + 1]) return P[n];
+    s = nurbs_findspan(n, p, u, &U[0]);
+    nurbs_basisfun(s, u, p, &U[0], N);
+    for(i = 0; i <= p; i++) {
+        C = C + N[i] * P[s - p + i];
+    }
+    return C;
+}
+
+/* least squares fit of a clamped cubic with n + 1 control points P to the
+   points Q at the parameters ub, with the end points fixed ("The NURBS
+   Book", 9.4.1).  With n equal to the last index of Q the fit interpolates.
+   Returns false if the normal equations are singular. */
+static bool chain_fit_solve(const std::vector<PM_CARTESIAN> &Q,
+                            const std::vector<double> &ub, int n,
+                            std::vector<PM_CARTESIAN> &P,
+                            std::vector<double> &U)
+{
+    int p = chain_fit_order - 1, m = Q.size() - 1, nu = n - 1;
+    double d = (double)(m + 1) / (n - p + 1);
+    double N[chain_fit_order];
+    int i, j, k;
+
+    U.assign(n + p + 2, 0.0);
+    for(j = n + 1; j < n + p + 2; j++) U[j] = 1.0;
+    for(j = 1; j <= n - p; j++) {
+        if(n == m) {
+            // knot averaging, eq. 9.8
+            for(i = j; i < j + p; i++) U[p + j] += ub[i] / p;
+        } else {
+            // eq. 9.69, every knot span holds a data point
+            i = (int)(j * d);
+            double alpha = j * d - i;
+            U[p + j] = (1 - alpha) * ub[i - 1] + alpha * ub[i];
+        }
+    }
+
+    // the normal equations N'N P = N'R for the inner control points;
+    // N'N is banded, p on each side of the diagonal
+    std::vector<double> A(nu * nu, 0.0);
+    std::vector<PM_CARTESIAN> b(nu, PM_CARTESIAN(0, 0, 0));
+    for(k = 1; k < m; k++) {
+        int s = nurbs_findspan(n, p, ub[k], &U[0]);
+        PM_CARTESIAN R = Q[k];
+
+        nurbs_basisfun(s, ub[k], p, &U[0], N);
+        for(i = 0; i <= p; i++) {
+            if(s - p + i == 0) R = R - N[i] * Q[0];
+            if(s - p + i == n) R = R - N[i] * Q[m];
+        }
+        for(i = 0; i <= p; i++) {
+            int r = s - p + i - 1;
+            if(r < 0 || r >= nu) continue;
+            b[r] = b[r] + N[i] * R;
+            for(j = 0; j <= p; j++) {
+                int c = s - p + j - 1;
+                if(c < 0 || c >= nu) continue;
+                A[r * nu + c] += N[i] * N[j];
+            }
+        }
+    }
+    // N'N is positive definite, so elimination needs no pivoting and
+    // stays in the band
+    for(i = 0; i < nu; i++) {
+        double piv = A[i * nu + i];
+        if(!(piv > 1e-12)) return false;
+        for(k = i + 1; k < nu && k <= i + p; k++) {
+            double f = A[k * nu + i] / piv;
+            if(f == 0) continue;
+            for(j = i; j < nu && j <= i + p; j++) A[k * nu + j] -= f * A[i * nu + j];
+            b[k] = b[k] - f * b[i];
+        }
+    }
+    P.resize(n + 1);
+    P[0] = Q[0];
+    P[n] = Q[m];
+    for(i = nu - 1; i >= 0; i--) {
+        PM_CARTESIAN x = b[i];
+        for(j = i + 1; j < nu && j <= i + p; j++) x = x - A[i * nu + j] * P[j + 1];
+        P[i + 1] = x / A[i * nu + i];
+    }
+    return true;
+}
+
+/* true if the spline passes within tol of every point of Q and stays
+   within tol of the segments between them */
+static bool chain_fit_check(const std::vector<PM_CARTESIAN> &Q,
+                            const std::vector<double> &ub,
+                            const std::vector<PM_CARTESIAN> &P,
+                            std::vector<double> &U, double tol)
+{
+    unsigned int k;
+    int s;
+
+    for(k = 0; k < Q.size(); k++) {
+        if(mag(chain_fit_point(P, U, ub[k]) - Q[k]) > tol) return false;
+    }
+    for(k = 1; k < Q.size(); k++) {
+        for(s = 1; s < chain_fit_samples; s++) {
+            double u = ub[k - 1] + (ub[k] - ub[k - 1]) * s / chain_fit_samples;
+            if(segment_distance(chain_fit_point(P, U, u), Q[k - 1], Q[k]) > tol)
+                return false;
+        }
+    }
+    return true;
+}
+
+/* radius of the circle through A, B and C, 0 if they are in line */
+static double circumradius(const PM_CARTESIAN &A, const PM_CARTESIAN &B,
+                           const PM_CARTESIAN &C)
+{
+    double twice_area = mag(cross(B - A, C - B));
+
+    if(twice_area < tiny) return 0;
+    return mag(B - A) * mag(C - B) * mag(C - A) / (2 * twice_area);
+}
+
+/* sends the chained points as one spline if they are not all in line and
+   a fit within the naive cam tolerance exists; returns false, having sent
+   nothing, otherwise */
+static bool send_chained_spline(void)
+{
+    std::vector<struct pt> &chain = chained_points();
+    int m = chain.size(), p = chain_fit_order - 1;
+    int n, i, k;
+
+    if(!chain_fit_enabled() || m < chain_fit_min_points) return false;
+    struct pt &last = chain.back();
+    if(chain_within(0, m - 1, last.x, last.y, last.z)) return false;
+
+    // chord length parameters
+    std::vector<PM_CARTESIAN> Q(m + 1);
+    std::vector<double> ub(m + 1, 0.0);
+    Q[0] = PM_CARTESIAN(canon.endPoint.x, canon.endPoint.y, canon.endPoint.z);
+    for(k = 1; k <= m; k++) {
+        Q[k] = PM_CARTESIAN(chain[k - 1].x, chain[k - 1].y, chain[k - 1].z);
+        if(mag(Q[k] - Q[k - 1]) < tiny) return false;
+        ub[k] = ub[k - 1] + mag(Q[k] - Q[k - 1]);
+    }
+    for(k = 1; k < m; k++) ub[k] /= ub[m];
+    ub[m] = 1.0;
+
+    // as few control points as will do
+    std::vector<PM_CARTESIAN> P;
+    std::vector<double> U;
+    for(n = p; ; n = MIN(m, n + n / 2 + 1)) {
+        if(chain_fit_solve(Q, ub, n, P, U)
+                && chain_fit_check(Q, ub, P, U, canon.naivecamTolerance))
+            break;
+        if(n == m) return false;
+    }
+    DP("fit %d points with %d control points\n", m, n + 1);
+
+    // each control point gets the tightest programmed curvature under it
+    std::vector<double> radius(m + 1, 0.0);
+    for(k = 1; k < m; k++) radius[k] = circumradius(Q[k - 1], Q[k], Q[k + 1]);
+
+    std::vector<CONTROL_POINT> cps(n + 1);
+    for(i = 0; i <= n; i++) {
+        CONTROL_POINT &cp = cps[i];
+        double d = 0;
+
+        for(k = 1; k < m; k++) {
+            if(ub[k] >= U[i] && ub[k] <= U[i + p + 1] && radius[k] > 0
+                    && (d == 0 || radius[k] < d))
+                d = radius[k];
+        }
+        cp.X = P[i].x; cp.Y = P[i].y; cp.Z = P[i].z;
+        cp.A = last.a; cp.B = last.b; cp.C = last.c;
+        cp.U = last.u; cp.V = last.v; cp.W = last.w;
+        cp.R = 1;
+        cp.F = -1;
+        cp.D = d;
+    }
+    nurbs_move(last.line_no, cps, U, chain_fit_order, ub[m],
+               AXIS_MASK_X | AXIS_MASK_Y | AXIS_MASK_Z);
+    return true;
+}
+
+static void flush_segments(void) 
+{
+    std::vector<struct pt> &chain = chained_points();
+
+    if(chain.empty()) return;
+
+#ifdef SHOW_JOINED_SEGMENTS
+    for(unsigned int i=0; i != chain.size(); i++) { printf("."); }
+    printf("\n");
+#endif
+
+    if(!send_chained_spline()) {
+        // one line for each collinear stretch
+        unsigned int first = 0, last;
+        while(first < chain.size()) {
+            chain_cone_reset();
+            chain_cone_add(chain[first].x, chain[first].y, chain[first].z);
+            for(last = first; last + 1 < chain.size(); last++) {
+                struct pt &next = chain[last + 1];
+                if(canon.naivecamTolerance == 0
+                        || !chain_collinear(first, last + 1, next.x, next.y, next.z))
+                    break;
+                chain_cone_add(next.x, next.y, next.z);
+            }
+            send_chained_line(chain[last]);
+            first = last + 1;
+        }
+    }
+    chain.clear();
 }
 
 static void get_last_pos(double &lx, double &ly, double &lz) {
@@ -979,7 +1369,7 @@ linkable(double x, double y, double z,
     if(canon.motionMode != CANON_CONTINUOUS || canon.naivecamTolerance == 0)
         return false;
 
-    if(chained_points().size() > 100) return false;
+    if(chained_points().size() > chain_max_points) return false;
 
     if(a != pos.a) return false;
     if(b != pos.b) return false;
@@ -990,18 +1380,25 @@ linkable(double x, double y, double z,
 
     if(x==canon.endPoint.x && y==canon.endPoint.y && z==canon.endPoint.z) return false;
     
-    for(std::vector<struct pt>::iterator it = chained_points().begin();
-            it != chained_points().end(); it++) {
-        PM_CARTESIAN M(x-canon.endPoint.x, y-canon.endPoint.y, z-canon.endPoint.z),
-                     B(canon.endPoint.x, canon.endPoint.y, canon.endPoint.z),
-                     P(it->x, it->y, it->z);
-        double t0 = dot(M, P-B) / dot(M, M);
-        if(t0 < 0) t0 = 0;
-        if(t0 > 1) t0 = 1;
-
-        double D = mag(P - (B + t0 * M));
-        if(D > canon.naivecamTolerance) return false;
+    if(!chain_cone.bent && chain_collinear(0, chained_points().size(), x, y, z))
+        return true;
+
+    // not collinear: a spline may still take it
+    if(!chain_fit_enabled() || chained_points().size() >= chain_fit_max_points)
+        return false;
+    if(x==pos.x && y==pos.y && z==pos.z) return false;
+
+    PM_CARTESIAN P(pos.x, pos.y, pos.z), prev, N(x, y, z);
+    if(chained_points().size() > 1) {
+        struct pt &p = chained_points()[chained_points().size() - 2];
+        prev = PM_CARTESIAN(p.x, p.y, p.z);
+    } else {
+        prev = PM_CARTESIAN(canon.endPoint.x, canon.endPoint.y, canon.endPoint.z);
     }
+    // a sharp corner ends the run
+    if(dot(P - prev, N - P) < chain_fit_max_turn * mag(P - prev) * mag(N - P))
+        return false;
+    chain_cone.bent = true;
     return true;
 }
 
@@ -1022,8 +1419,12 @@ see_segment(int line_number,
         flush_segments();
     }
 
+    if(chained_points().empty()) {
+        chain_cone_reset();
+    }
     pt pos = {x, y, z, a, b, c, u, v, w, line_number};
     chained_points().push_back(pos);
+    chain_cone_add(x, y, z);
     if(changed_abc || changed_uvw) {
         flush_segments();
     }
@@ -1040,7 +1441,9 @@ void STRAIGHT_TRAVERSE(int line_number,
                        double u, double v, double w)
 {
     double vel, acc;
+    double args[] = { x, y, z, a, b, c, u, v, w };
 
+    canon_trace(CANON_TRACE_STRAIGHT_TRAVERSE, line_number, 9, args);
     flush_segments();
 
     EMC_TRAJ_LINEAR_MOVE linearMoveMsg;
@@ -1082,6 +1485,9 @@ void STRAIGHT_FEED(int line_number,
                    double a, double b, double c,
                    double u, double v, double w)
 {
+    double args[] = { x, y, z, a, b, c, u, v, w };
+
+    canon_trace(CANON_TRACE_STRAIGHT_FEED, line_number, 9, args);
     EMC_TRAJ_LINEAR_MOVE linearMoveMsg;
     linearMoveMsg.feed_mode = canon.feed_mode;
     from_prog(x,y,z,a,b,c,u,v,w);
@@ -1089,6 +1495,22 @@ void STRAIGHT_FEED(int line_number,
     see_segment(line_number, x, y, z, a, b, c, u, v, w);
 }
 
+void DRILL_CYCLE(int line_number,
+                 double x, double y, double z,
+                 double a, double b, double c,
+                 double u, double v, double w,
+                 int axis, double clear, double dwell)
+{
+    double end[9] = {x, y, z, a, b, c, u, v, w};
+
+    STRAIGHT_FEED(line_number, x, y, z, a, b, c, u, v, w);
+    if (dwell >= 0)
+        DWELL(dwell);
+    end[axis] = clear;
+    STRAIGHT_TRAVERSE(line_number, end[0], end[1], end[2], end[3], end[4],
+                      end[5], end[6], end[7], end[8]);
+}
+
 
 void RIGID_TAP(int line_number, double x, double y, double z)
 {
@@ -1146,7 +1568,9 @@ void STRAIGHT_PROBE(int line_number,
 {
     double ini_maxvel, vel, acc;
     EMC_TRAJ_PROBE probeMsg;
+    double args[] = { x, y, z, a, b, c, u, v, w, (double) probe_type };
 
+    canon_trace(CANON_TRACE_STRAIGHT_PROBE, line_number, 10, args);
     from_prog(x,y,z,a,b,c,u,v,w);
     rotate_and_offset_pos(x,y,z,a,b,c,u,v,w);
 
@@ -1191,7 +1615,9 @@ void STRAIGHT_PROBE(int line_number,
 void SET_MOTION_CONTROL_MODE(CANON_MOTION_MODE mode, double tolerance)
 {
     EMC_TRAJ_SET_TERM_COND setTermCondMsg;
+    double args[] = { (double) mode, tolerance };
 
+    canon_trace(CANON_TRACE_SET_MOTION_CONTROL_MODE, -1, 2, args);
     flush_segments();
 
     canon.motionMode = mode;
@@ -1218,6 +1644,7 @@ void SET_NAIVECAM_TOLERANCE(double tolerance)
 
 void SELECT_PLANE(CANON_PLANE in_plane)
 {
+    canon_trace1(CANON_TRACE_SELECT_PLANE, in_plane);
     canon.activePlane = in_plane;
 }
 
@@ -1353,18 +1780,300 @@ biarc(int lineno, double p0x, double p0y, double tsx, double tsy,
 
 
 /* Canon calls */
+/* number of u samples per arc length table interval, and the table size
+   limits, for nurbs_arclen_table() */
+static const int nurbs_arclen_oversample = 16;
+static const int nurbs_arclen_min_nodes = 32;
+static const int nurbs_arclen_max_nodes = 1024;
+
+/* 5 point Gauss-Legendre nodes and weights on [-1, 1] */
+static const double nurbs_gauss_x[5] = {
+    0.0, -0.5384693101056831, 0.5384693101056831,
+    -0.9061798459386640, 0.9061798459386640
+};
+static const double nurbs_gauss_w[5] = {
+    0.5688888888888889, 0.4786286704993665, 0.4786286704993665,
+    0.2369268850560891, 0.2369268850560891
+};
+/* relative accuracy of the length of a sample interval, and the deepest
+   bisection to get it, for nurbs_arclen_length() */
+static const double nurbs_arclen_tolerance = 1e-10;
+static const int nurbs_arclen_max_depth = 10;
+
+/* the curve one knot span at a time, as motion evaluates it with
+   nurbs_span_coef(), for its speed |dC/du| in xyz, uvw or abc */
+struct NurbsSpeed {
+    std::vector<CONTROL_POINT> cp;
+    std::vector<double> U;
+    std::vector<double> coef;
+    int p, n, span, which;
+};
+
+static double nurbs_arclen_speed(NurbsSpeed &c, int s, double u)
+{
+    int ch0 = c.which == 0 ? NURBS_CH_X : c.which == 1 ? NURBS_CH_U : NURBS_CH_A;
+    double P[3] = {0, 0, 0}, dP[3] = {0, 0, 0}, w = 0, dw = 0;
+    double t = u - c.U[s];
+    int k, d;
+
+    if (s != c.span) {
+        nurbs_span_coef(s, c.p, &c.U[0], &c.cp[0], &c.coef[0]);
+        c.span = s;
+    }
+    // Horner for the weighted coordinates and the weight, and their
+    // derivatives, then the quotient rule
+    for (k = c.p; k >= 0; k--) {
+        const double *a = &c.coef[k * NURBS_CHANNELS];
+        for (d = 0; d < 3; d++) {
+            dP[d] = dP[d] * t + P[d];
+            P[d] = P[d] * t + a[ch0 + d];
+        }
+        dw = dw * t + w;
+        w = w * t + a[NURBS_CH_R];
+    }
+    return mag(PM_CARTESIAN(dP[0] - P[0] * dw / w,
+                            dP[1] - P[1] * dw / w,
+                            dP[2] - P[2] * dw / w)) / w;
+}
+
+static double nurbs_arclen_gauss(NurbsSpeed &c, int s, double a, double b)
+{
+    double m = 0.5 * (a + b), h = 0.5 * (b - a), sum = 0;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        sum += nurbs_gauss_w[i] * nurbs_arclen_speed(c, s, m + h * nurbs_gauss_x[i]);
+    }
+    return sum * h;
+}
+
+/* bisects [a, b] until the halves add up to the whole */
+static double nurbs_arclen_adapt(NurbsSpeed &c, int s, double a, double b,
+                                 double whole, int depth)
+{
+    double m = 0.5 * (a + b);
+    double l = nurbs_arclen_gauss(c, s, a, m);
+    double r = nurbs_arclen_gauss(c, s, m, b);
+
+    if (depth >= nurbs_arclen_max_depth ||
+        fabs(l + r - whole) <= nurbs_arclen_tolerance * (l + r)) {
+        return l + r;
+    }
+    return nurbs_arclen_adapt(c, s, a, m, l, depth + 1) +
+           nurbs_arclen_adapt(c, s, m, b, r, depth + 1);
+}
+
+/* length of the curve from u0 to u1, integrated span by span, since the
+   speed is only smooth within a knot span */
+static double nurbs_arclen_length(NurbsSpeed &c, double u0, double u1)
+{
+    int s = nurbs_findspan(c.n, c.p, u0, &c.U[0]);
+    double len = 0;
+
+    while (u0 < u1 && s <= c.n) {
+        double b = (s < c.n && c.U[s + 1] < u1) ? c.U[s + 1] : u1;
+
+        if (b > u0) {
+            len += nurbs_arclen_adapt(c, s, u0, b, nurbs_arclen_gauss(c, s, u0, b), 0);
+            u0 = b;
+        }
+        s++;
+    }
+    return len;
+}
+
+/* point of the (weighted) NURBS curve at u, in xyz, uvw or abc */
+static PM_CARTESIAN nurbs_arclen_point(const std::vector<CONTROL_POINT> &cp,
+                                       std::vector<double> &U, int p,
+                                       double u, int which,
+                                       std::vector<double> &N)
+{
+    int n = cp.size() - 1;
+    int s, i;
+    double x = 0, y = 0, z = 0, r = 0;
+
+    if (u >= U[n + 1]) {
+        s = n;
+        N.assign(p + 1, 0.0);
+        N[p] = 1.0;
+    } else {
+        s = nurbs_findspan(n, p, u, &U[0]);
+        nurbs_basisfun(s, u, p, &U[0], &N[0]);
+    }
+    for (i = 0; i <= p; i++) {
+        const CONTROL_POINT &c = cp[s - p + i];
+        switch (which) {
+        case 0: x += N[i] * c.X; y += N[i] * c.Y; z += N[i] * c.Z; break;
+        case 1: x += N[i] * c.U; y += N[i] * c.V; z += N[i] * c.W; break;
+        default: x += N[i] * c.A; y += N[i] * c.B; z += N[i] * c.C; break;
+        }
+        r += N[i] * c.R;
+    }
+    return PM_CARTESIAN(x / r, y / r, z / r);
+}
+
+/* radius of the circle through three points, huge when they are in line */
+static double nurbs_arclen_radius(const PM_CARTESIAN &p0, const PM_CARTESIAN &p1,
+                                  const PM_CARTESIAN &p2)
+{
+    PM_CARTESIAN a = p1 - p0, b = p2 - p1;
+    double area2 = mag(cross(a, b));
+    double r;
+
+    if (!(area2 > 0)) {
+        return huge;
+    }
+    r = mag(a) * mag(b) * mag(p2 - p0) / (2 * area2);
+    return r < huge ? r : huge;
+}
+
+/* builds the arc length -> u table of a NURBS curve (see nurbs_block_t):
+   samples the curve densely in u, integrates its speed between the
+   samples and inverts that at equal arc length steps.  Length is measured in xyz,
+   or in uvw or abc for curves that do not move xyz, like other feed
+   moves.  Returns the curve length, or 0 (and no table) for a curve
+   that does not move at all.
+
+   Each node also gets the feed profile: the tightest radius of the
+   samples around it limits the velocity to keep the centripetal accel
+   within acc and its jerk within jerk, at most maxvel, and a backward
+   pass then lowers the nodes before a slow span so that half of acc is
+   enough to slow down for it.  The other half is left for the jerk
+   limited ramps of the TP, which only sees the profile as it gets
+   there. */
+static double nurbs_arclen_table(const std::vector<CONTROL_POINT> &cp,
+                                 const std::vector<double> &knots,
+                                 unsigned int order,
+                                 double maxvel, double acc, double jerk,
+                                 std::vector<double> &table)
+{
+    const int S = NURBS_ARCLEN_STRIDE;
+    std::vector<double> U(knots);
+    std::vector<double> N(order);
+    std::vector<double> su, sl, radius;
+    std::vector<PM_CARTESIAN> pts;
+    int p = order - 1, n = cp.size() - 1;
+    int nodes, samples, which, i, j;
+    double u0 = U[p], u1 = U[n + 1], len = 0, h;
+    NurbsSpeed speed;
+
+    table.clear();
+    if (!(u1 > u0)) {
+        return 0;
+    }
+    nodes = 8 * cp.size();
+    if (nodes < nurbs_arclen_min_nodes) nodes = nurbs_arclen_min_nodes;
+    if (nodes > nurbs_arclen_max_nodes) nodes = nurbs_arclen_max_nodes;
+    samples = nodes * nurbs_arclen_oversample;
+    speed.cp = cp;
+    speed.U = U;
+    speed.coef.resize(order * NURBS_CHANNELS);
+    speed.p = p;
+    speed.n = n;
+    speed.span = -1;
+
+    for (which = 0; which < 3; which++) {
+        speed.which = which;
+        pts.assign(1, nurbs_arclen_point(cp, U, p, u0, which, N));
+        su.assign(1, u0);
+        sl.assign(1, 0.0);
+        for (i = 1; i <= samples; i++) {
+            double u = u0 + (u1 - u0) * i / samples;
+            su.push_back(u);
+            sl.push_back(sl.back() + nurbs_arclen_length(speed, su[i - 1], u));
+            pts.push_back(nurbs_arclen_point(cp, U, p, u, which, N));
+        }
+        len = sl.back();
+        if (len > 1e-9) {
+            break;
+        }
+    }
+    if (!(len > 1e-9)) {
+        return 0;
+    }
+
+    table.resize(S * nodes);
+    for (j = 0, i = 0; j < nodes; j++) {
+        double sj = len * j / (nodes - 1);
+        double ds, f;
+
+        while (i < samples - 1 && sl[i + 1] < sj) {
+            i++;
+        }
+        ds = sl[i + 1] - sl[i];
+        f = ds > 0 ? (sj - sl[i]) / ds : 0;
+        if (f > 1) f = 1;
+        table[S * j] = su[i] + f * (su[i + 1] - su[i]);
+        table[S * j + 1] = ds > 0 ? (su[i + 1] - su[i]) / ds : (u1 - u0) / len;
+    }
+    table[0] = u0;
+    table[S * (nodes - 1)] = u1;
+
+    // tightest radius on either side of each node
+    h = len / (nodes - 1);
+    radius.assign(nodes, huge);
+    for (i = 1; i < samples; i++) {
+        double r = nurbs_arclen_radius(pts[i - 1], pts[i], pts[i + 1]);
+
+        j = (int) (sl[i] / h);
+        if (j > nodes - 2) j = nodes - 2;
+        if (r < radius[j]) radius[j] = r;
+        if (r < radius[j + 1]) radius[j + 1] = r;
+    }
+    for (j = 0; j < nodes; j++) {
+        double v = maxvel;
+
+        if (acc > 0 && sqrt(acc * radius[j]) < v) {
+            v = sqrt(acc * radius[j]);
+        }
+        if (jerk > 0 && cbrt(jerk * radius[j] * radius[j]) < v) {
+            v = cbrt(jerk * radius[j] * radius[j]);
+        }
+        table[S * j + 2] = v;
+    }
+    if (acc > 0) {
+        for (j = nodes - 2; j >= 0; j--) {
+            double v = table[S * (j + 1) + 2];
+            v = sqrt(v * v + acc * h);
+            if (v < table[S * j + 2]) {
+                table[S * j + 2] = v;
+            }
+        }
+    }
+    return len;
+}
+
 void NURBS_FEED_3D (
     int line_number, 
     const std::vector<CONTROL_POINT> & nurbs_control_points ,
     const std::vector<double> & nurbs_knot_vector,
     unsigned int k, double curve_length, uint32_t axis_mask)
+{
+    std::vector<CONTROL_POINT> abs_pts(nurbs_control_points);
+
+    flush_segments(); // NURBS move is not similar to point-to-point move
+    for (unsigned int i = 0; i < abs_pts.size(); i++) {
+        CONTROL_POINT &cp = abs_pts[i];
+
+        from_prog(cp.X, cp.Y, cp.Z, cp.A, cp.B, cp.C, cp.U, cp.V, cp.W);
+        rotate_and_offset_pos(cp.X, cp.Y, cp.Z, cp.A, cp.B, cp.C, cp.U, cp.V, cp.W);
+    }
+    nurbs_move(line_number, abs_pts, nurbs_knot_vector, k, curve_length, axis_mask);
+}
+
+/* sends a NURBS move along control points that are already in the
+   absolute frame, for NURBS_FEED_3D() and for chains of feed moves fit
+   with a spline in flush_segments() */
+static void nurbs_move(int line_number,
+                       const std::vector<CONTROL_POINT> &nurbs_control_points,
+                       const std::vector<double> &nurbs_knot_vector,
+                       unsigned int k, double curve_length, uint32_t axis_mask)
 {
     EMC_TRAJ_NURBS_MOVE nurbsMoveMsg;
     uint32_t nr_of_ctrl_pt, nr_of_knot, i;
     double x,y,z,a,b,c,u,v,w,vel,d, max_d;
     double dx, dy, dz, da, db, dc, du, dv, dw;
 
-    flush_segments(); // NURBS move is not similar to point-to-point move
     nurbsMoveMsg.feed_mode = canon.feed_mode;
     nurbsMoveMsg.type = EMC_MOTION_TYPE_FEED;
 
@@ -1549,7 +2258,13 @@ void NURBS_FEED_3D (
         }
     }
 
+    // the whole curve goes to task in one block, with the control points
+    // premultiplied by their weights
+    std::vector<CONTROL_POINT> ctrl_pts(nr_of_ctrl_pt);
+
     for (i=0;i<nr_of_ctrl_pt;i++) {
+        CONTROL_POINT &cp = ctrl_pts[i];
+        double r = nurbs_control_points[i].R;
 
         x = nurbs_control_points[i].X;
         y = nurbs_control_points[i].Y;
@@ -1561,105 +2276,79 @@ void NURBS_FEED_3D (
         v = nurbs_control_points[i].V;
         w = nurbs_control_points[i].W;
         d = nurbs_control_points[i].D;
-        from_prog(x, y, z, a, b, c, u, v, w);
-        rotate_and_offset_pos(x,y,z,a,b,c,u,v,w);
-
-        x *= nurbs_control_points[i].R;
-        y *= nurbs_control_points[i].R;
-        z *= nurbs_control_points[i].R;
-        a *= nurbs_control_points[i].R;
-        b *= nurbs_control_points[i].R;
-        c *= nurbs_control_points[i].R;
-        u *= nurbs_control_points[i].R;
-        v *= nurbs_control_points[i].R;
-        w *= nurbs_control_points[i].R;
-        d *= nurbs_control_points[i].R;
-
-        to_ext_pose(x, y, z, a, b, c, u, v, w);
-        nurbsMoveMsg.vel = canon.linearFeedRate;
-        nurbsMoveMsg.nurbs_block.nr_of_ctrl_pts = nr_of_ctrl_pt;
-        nurbsMoveMsg.nurbs_block.nr_of_knots = nr_of_knot;
-        nurbsMoveMsg.nurbs_block.curve_len = curve_length;
-        nurbsMoveMsg.nurbs_block.order = k;
-        nurbsMoveMsg.nurbs_block.knot = nurbs_knot_vector[i];
-        nurbsMoveMsg.nurbs_block.weight = nurbs_control_points[i].R;
-        nurbsMoveMsg.end.tran.x = x;
-        nurbsMoveMsg.end.tran.y = y;
-        nurbsMoveMsg.end.tran.z = z;
-        nurbsMoveMsg.end.a =  a;
-        nurbsMoveMsg.end.b =  b;
-        nurbsMoveMsg.end.c =  c;
-        nurbsMoveMsg.end.u =  u;
-        nurbsMoveMsg.end.v =  v;
-        nurbsMoveMsg.end.w =  w;
-        if(d > 0) {
-            nurbsMoveMsg.nurbs_block.curvature = d;
-        } else {
-            nurbsMoveMsg.nurbs_block.curvature = max_d;
+        if (i == nr_of_ctrl_pt - 1) {
+            // a clamped curve ends on its last control point
+            canonUpdateEndPoint(x, y, z, a, b, c, u, v, w);
         }
-        nurbsMoveMsg.nurbs_block.axis_mask = axis_mask;
+
+        cp.X = x * r;
+        cp.Y = y * r;
+        cp.Z = z * r;
+        cp.A = a * r;
+        cp.B = b * r;
+        cp.C = c * r;
+        cp.U = u * r;
+        cp.V = v * r;
+        cp.W = w * r;
+        cp.R = r;
+        d *= r;
+        cp.D = (d > 0) ? d : max_d;
         // feed rate
         if(nurbs_control_points[i].F != -1 ) {
-
-            nurbsMoveMsg.vel = FROM_PROG_LEN(nurbs_control_points[i].F)/60;
-            vel = nurbsMoveMsg.vel;
-        } else {
-            if(i != 0) {
-                nurbsMoveMsg.vel = vel;//FROM_PROG_LEN(nurbs_control_points[i-1].F);
-            } else {
-                nurbsMoveMsg.vel = vel;
-            }
+            vel = FROM_PROG_LEN(nurbs_control_points[i].F)/60;
+        }
+        cp.F = vel;
+
+        if (i == nr_of_ctrl_pt - 1) {
+            nurbsMoveMsg.end.tran.x = x;
+            nurbsMoveMsg.end.tran.y = y;
+            nurbsMoveMsg.end.tran.z = z;
+            nurbsMoveMsg.end.a = a;
+            nurbsMoveMsg.end.b = b;
+            nurbsMoveMsg.end.c = c;
+            nurbsMoveMsg.end.u = u;
+            nurbsMoveMsg.end.v = v;
+            nurbsMoveMsg.end.w = w;
         }
-
-        interp_list.set_line_number(line_number);
-        interp_list.append(nurbsMoveMsg);
-        canonUpdateEndPoint(x, y, z, a, b, c, u, v, w);
     }
 
-    for (;i<nr_of_knot;i++) {
-
-        nurbsMoveMsg.vel = canon.linearFeedRate;
-        nurbsMoveMsg.nurbs_block.nr_of_ctrl_pts = nr_of_ctrl_pt;
-        nurbsMoveMsg.nurbs_block.nr_of_knots = nr_of_knot;
-        nurbsMoveMsg.nurbs_block.curve_len = curve_length;
-        nurbsMoveMsg.nurbs_block.order = k;
-        nurbsMoveMsg.nurbs_block.knot = nurbs_knot_vector[i];
-        nurbsMoveMsg.nurbs_block.weight = 0;
-        x = nurbs_control_points[nr_of_ctrl_pt-1].X;
-        y = nurbs_control_points[nr_of_ctrl_pt-1].Y;
-        z = nurbs_control_points[nr_of_ctrl_pt-1].Z;
-        a = nurbs_control_points[nr_of_ctrl_pt-1].A;
-        b = nurbs_control_points[nr_of_ctrl_pt-1].B;
-        c = nurbs_control_points[nr_of_ctrl_pt-1].C;
-        u = nurbs_control_points[nr_of_ctrl_pt-1].U;
-        v = nurbs_control_points[nr_of_ctrl_pt-1].V;
-        w = nurbs_control_points[nr_of_ctrl_pt-1].W;
-        from_prog(x, y, z, a, b, c, u, v, w);
-        rotate_and_offset_pos(x,y,z,a,b,c,u,v,w);
-
-        x *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        y *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        a *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        b *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        c *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        u *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        v *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-        w *= nurbs_control_points[nr_of_ctrl_pt-1].R;
-
-        nurbsMoveMsg.end.tran.x = x;
-        nurbsMoveMsg.end.tran.y = y;
-        nurbsMoveMsg.end.tran.z = z;
-        nurbsMoveMsg.end.a = a;
-        nurbsMoveMsg.end.b = b;
-        nurbsMoveMsg.end.c = c;
-        nurbsMoveMsg.end.u = u;
-        nurbsMoveMsg.end.v = v;
-        nurbsMoveMsg.end.w = w;
-
-        interp_list.set_line_number(line_number);
-        interp_list.append(nurbsMoveMsg);
-        canonUpdateEndPoint(x, y, z, a, b, c, u, v, w);
+    nurbsMoveMsg.vel = ctrl_pts[0].F;
+    nurbsMoveMsg.nurbs_block.nr_of_ctrl_pts = nr_of_ctrl_pt;
+    nurbsMoveMsg.nurbs_block.nr_of_knots = nr_of_knot;
+    if (k < 2 || k > NURBS_MAX_ORDER) {
+        CANON_ERROR("NURBS curve order %u out of range 2..%d", k, NURBS_MAX_ORDER);
+        return;
+    }
+    if (nr_of_knot < nr_of_ctrl_pt + k) {
+        CANON_ERROR("NURBS curve with %d control points of order %u needs %d knots, got %d",
+                    nr_of_ctrl_pt, k, nr_of_ctrl_pt + k, nr_of_knot);
+        return;
     }
+    // motion steps along the curve by arc length; the measured length
+    // takes the place of the given one so the feed comes out right, and
+    // it follows the feed profile that comes with the table
+    std::vector<double> arclen;
+    double len = nurbs_arclen_table(ctrl_pts, nurbs_knot_vector, k,
+                                    FROM_EXT_LEN(nurbsMoveMsg.ini_maxvel),
+                                    FROM_EXT_LEN(nurbsMoveMsg.ini_maxacc),
+                                    FROM_EXT_LEN(nurbsMoveMsg.ini_maxjerk),
+                                    arclen);
+    nurbsMoveMsg.nurbs_block.curve_len = len > 0 ? len : curve_length;
+    nurbsMoveMsg.nurbs_block.order = k;
+    nurbsMoveMsg.nurbs_block.axis_mask = axis_mask;
+    nurbsMoveMsg.nurbs_block.stage_id =
+        emcTrajNurbsStage(&ctrl_pts[0], nr_of_ctrl_pt,
+                          &nurbs_knot_vector[0], nr_of_knot,
+                          arclen.empty() ? 0 : &arclen[0],
+                          arclen.size() / NURBS_ARCLEN_STRIDE);
+    if (nurbsMoveMsg.nurbs_block.stage_id < 0) {
+        CANON_ERROR("NURBS curve with %d control points and %d knots is too large",
+                    nr_of_ctrl_pt, nr_of_knot);
+        return;
+    }
+
+    interp_list.set_line_number(line_number);
+    interp_list.append(nurbsMoveMsg);
 }
 
 void NURBS_FEED(int lineno, std::vector<CONTROL_POINT> nurbs_control_points, unsigned int k) 
@@ -1705,7 +2394,10 @@ void ARC_FEED(int line_number,
     double lx, ly, lz;
     double unused=0;
     int i;
-    
+    double args[] = { first_end, second_end, first_axis, second_axis,
+		      (double) rotation, axis_end_point, a, b, c, u, v, w };
+
+    canon_trace(CANON_TRACE_ARC_FEED, line_number, 12, args);
     for (i = 0; i < 3; i++) {
         axis_max_acc[i] = FROM_EXT_LEN(emcAxisGetMaxAcceleration(i));
         axis_max_vel[i] = FROM_EXT_LEN(emcAxisGetMaxVelocity(i));
@@ -2072,6 +2764,7 @@ void DWELL(double seconds)
 {
     EMC_TRAJ_DELAY delayMsg;
 
+    canon_trace1(CANON_TRACE_DWELL, seconds);
     flush_segments();
 
     delayMsg.delay = seconds;
@@ -2093,6 +2786,7 @@ void START_SPINDLE_CLOCKWISE(int l)
 {
     EMC_SPINDLE_ON emc_spindle_on_msg;
 
+    canon_trace(CANON_TRACE_START_SPINDLE_CLOCKWISE, l);
     flush_segments();
     canon.spindle_dir = 1;
 
@@ -2115,6 +2809,7 @@ void START_SPINDLE_COUNTERCLOCKWISE(int l)
 {
     EMC_SPINDLE_ON emc_spindle_on_msg;
 
+    canon_trace(CANON_TRACE_START_SPINDLE_COUNTERCLOCKWISE, l);
     flush_segments();
     canon.spindle_dir = -1;
 
@@ -2135,6 +2830,7 @@ void START_SPINDLE_COUNTERCLOCKWISE(int l)
 
 void SET_SPINDLE_SPEED(double r)
 {
+    canon_trace1(CANON_TRACE_SET_SPINDLE_SPEED, r);
     // speed is in RPMs everywhere
     canon.spindleSpeed = fabs(r); // interp will never send negative anyway ...
 
@@ -2169,6 +2865,7 @@ void STOP_SPINDLE_TURNING()
 {
     EMC_SPINDLE_OFF emc_spindle_off_msg;
 
+    canon_trace(CANON_TRACE_STOP_SPINDLE_TURNING, -1);
     flush_segments();
 
     interp_list.append(emc_spindle_off_msg);
@@ -2291,6 +2988,7 @@ void CHANGE_TOOL(int slot)
     linearMoveMsg.feed_mode = canon.feed_mode;
     EMC_TOOL_LOAD load_tool_msg;
 
+    canon_trace1(CANON_TRACE_CHANGE_TOOL, slot);
     flush_segments();
 
     /* optional move to tool change position.  This
@@ -2348,7 +3046,9 @@ void CHANGE_TOOL(int slot)
 void SELECT_POCKET(int slot , int tool)
 {
     EMC_TOOL_PREPARE prep_for_tool_msg;
+    double args[] = { (double) slot, (double) tool };
 
+    canon_trace(CANON_TRACE_SELECT_POCKET, -1, 2, args);
     prep_for_tool_msg.pocket = slot;
     prep_for_tool_msg.tool = tool;
 
@@ -2420,6 +3120,8 @@ void COMMENT(const char *comment)
     char probefilename[LINELEN];
     const char *ptr;
 
+    canon_trace(CANON_TRACE_COMMENT, -1, 0, 0, comment);
+
     // set RPY orientation for subsequent moves
     if (!strncmp(comment, "RPY", strlen("RPY"))) {
 	PM_RPY rpy;
@@ -2565,6 +3267,7 @@ void MESSAGE(char *s)
 {
     EMC_OPERATOR_DISPLAY operator_display_msg;
 
+    canon_trace(CANON_TRACE_MESSAGE, -1, 0, 0, s);
     flush_segments();
     operator_display_msg.id = 0;
     strncpy(operator_display_msg.display, s, LINELEN);
@@ -2648,6 +3351,7 @@ void PROGRAM_STOP()
        implement this as a pause. A resume will cause motion to proceed. */
     EMC_TASK_PLAN_PAUSE pauseMsg;
 
+    canon_trace(CANON_TRACE_PROGRAM_STOP, -1);
     flush_segments();
 
     interp_list.append(pauseMsg);
@@ -2678,6 +3382,7 @@ void OPTIONAL_PROGRAM_STOP()
 {
     EMC_TASK_PLAN_OPTIONAL_STOP stopMsg;
 
+    canon_trace(CANON_TRACE_OPTIONAL_PROGRAM_STOP, -1);
     flush_segments();
 
     interp_list.append(stopMsg);
@@ -2685,6 +3390,9 @@ void OPTIONAL_PROGRAM_STOP()
 
 void PROGRAM_END()
 {
+    canon_trace(CANON_TRACE_PROGRAM_END, -1);
+    if (canon_trace_file)
+	fflush(canon_trace_file);
     flush_segments();
 
     EMC_TASK_PLAN_END endMsg;
@@ -2744,7 +3452,24 @@ double GET_EXTERNAL_TOOL_LENGTH_WOFFSET()
 void INIT_CANON()
 {
     double units;
-
+    static int trace_opened;
+
+    if (!trace_opened) {
+	const char *name = getenv("EMC_CANON_TRACE");
+
+	trace_opened = 1;
+	if (name && *name) {
+	    canon_trace_file = fopen(name, "w");
+	    if (canon_trace_file == 0
+		|| canon_trace_write_header(canon_trace_file) != 0) {
+		CANON_ERROR("can't write the canon trace %s", name);
+		if (canon_trace_file)
+		    fclose(canon_trace_file);
+		canon_trace_file = 0;
+	    }
+	}
+    }
+    canon_trace(CANON_TRACE_INIT_CANON, -1);
     chained_points().clear();
 
     // initialize locals to original values
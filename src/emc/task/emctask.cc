@@ -19,13 +19,18 @@
 #include <unistd.h>		// stat()
 #include <limits.h>		// PATH_MAX
 #include <dlfcn.h>
+#include <vector>
+#include <string>
+#include <algorithm>		// std::find
 
 #include "rcs.hh"		// INIFILE
 #include "emc.hh"		// EMC NML
 #include "emc_nml.hh"
 #include "emcglb.h"		// EMC_INIFILE
 #include "interpl.hh"		// NML_INTERP_LIST, interp_list
+#include "canon_trace.h"	// for the canon cache
 #include "canon.hh"		// CANON_VECTOR, GET_PROGRAM_ORIGIN()
+#include "interp_internal.hh"	// setup, for checkpoints
 #include "rs274ngc_interp.hh"	// the interpreter
 #include "interp_return.hh"	// INTERP_FILE_NOT_OPEN
 #include "inifile.hh"
@@ -406,6 +411,488 @@ static void print_interp_error(int retval)
     }
 }
 
+/*
+  Canon cache.  With [TASK]CANON_CACHE = n, the interp list a run from
+  the top of a file makes is kept, as a canon trace of the messages put
+  on it and of what each read and execute returned, for the last n
+  programs run.  A later run of the same program, from the same state,
+  puts the messages on the list again instead of interpreting it, and
+  at the end puts back the interpreter and canon state the live run
+  ended with.
+
+  A run is the same if the program has the same name, size and content
+  hash, the files it opened then (subroutines) are unchanged by stat(),
+  and everything it could have read is the same as it was then: all
+  the numbered parameters and the global named ones, the tool table,
+  the interpreter's modal state and position, the canon state and the
+  axis limits.  A program that waits for task (M6, M66, probing, which
+  return INTERP_EXECUTE_FINISH), reads HAL or calls Python is never
+  kept, as what it did depends on more than that; neither is one that
+  fails, is aborted or makes a trace over CANON_CACHE_MAX_TRACE bytes.
+  While a run is replayed the interpreter stays as it was at the start.
+*/
+#define CANON_CACHE_MAX_TRACE (64 << 20)
+
+struct canon_cache_entry {
+    std::string filename;		// the program
+    off_t size;
+    uint64_t hash;			// of its content
+    std::vector<std::string> files;	// other files it opened
+    std::vector<struct stat> stats;	// and what they were then
+    std::vector<double> state;		// see canon_cache_state()
+    std::string globals;		// names of the global parameters
+    char *trace;			// the canon trace
+    size_t len;
+    setup *end;				// the interpreter's at the end
+    long end_position;
+    CanonConfig_t end_canon;
+};
+
+static std::vector<canon_cache_entry *> canon_cache;	// newest first
+static int canon_cache_runs;		// 0 for none
+static canon_cache_entry *cache_record;	// being recorded, or 0
+static FILE *cache_record_file;
+static unsigned long cache_record_reads;
+static canon_cache_entry *cache_replay;	// being replayed, or 0
+static size_t cache_replay_pos;
+static int cache_replay_line;
+static char cache_replay_command[LINELEN];
+
+static void canon_cache_free(canon_cache_entry *e)
+{
+    free(e->trace);
+    delete e->end;
+    delete e;
+}
+
+static bool canon_cache_hash(const char *filename, off_t *size,
+			     uint64_t *hash)
+{
+    char buf[8192];
+    uint64_t h = 14695981039346656037ULL;	// FNV-1a
+    size_t n, k;
+    FILE *f;
+
+    if ((f = fopen(filename, "r")) == NULL) {
+	return false;
+    }
+    *size = 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+	for (k = 0; k < n; k++) {
+	    h = (h ^ (unsigned char) buf[k]) * 1099511628211ULL;
+	}
+	*size += n;
+    }
+    fclose(f);
+    *hash = h;
+    return true;
+}
+
+// what the program could read, besides its files, in a fixed order
+static void canon_cache_state(std::vector<double> &v, std::string &globals)
+{
+    CanonConfig_t c;
+    int n;
+
+    v.clear();
+    globals.clear();
+    v.insert(v.end(), _is->parameters,
+	     _is->parameters + RS274NGC_MAX_PARAMETERS);
+    parameter_map &named = _is->sub_context[0].named_params;
+    for (parameter_map_iterator p = named.begin(); p != named.end(); p++) {
+	globals += p->first;
+	globals += '\n';
+	v.push_back(p->second.value);
+    }
+    for (n = 0; n < CANON_POCKETS_MAX; n++) {
+	const CANON_TOOL_TABLE &t = _is->tool_table[n];
+	const EmcPose &o = t.offset;
+	double f[] = { (double) t.toolno,
+	    o.tran.x, o.tran.y, o.tran.z, o.a, o.b, o.c, o.u, o.v, o.w,
+	    t.diameter, t.frontangle, t.backangle, (double) t.orientation };
+	v.insert(v.end(), f, f + sizeof(f) / sizeof(f[0]));
+    }
+    int gees[ACTIVE_G_CODES], ems[ACTIVE_M_CODES];
+    double sets[ACTIVE_SETTINGS];
+    interp.active_g_codes(gees);
+    interp.active_m_codes(ems);
+    interp.active_settings(sets);
+    v.insert(v.end(), gees, gees + ACTIVE_G_CODES);
+    v.insert(v.end(), ems, ems + ACTIVE_M_CODES);
+    v.insert(v.end(), sets, sets + ACTIVE_SETTINGS);
+    const EmcPose &o = _is->tool_offset;
+    double s[] = { _is->current_x, _is->current_y, _is->current_z,
+	_is->AA_current, _is->BB_current, _is->CC_current,
+	_is->u_current, _is->v_current, _is->w_current,
+	o.tran.x, o.tran.y, o.tran.z, o.a, o.b, o.c, o.u, o.v, o.w,
+	(double) _is->current_pocket, (double) _is->selected_pocket,
+	(double) _is->cutter_comp_side, _is->cutter_comp_radius,
+	(double) _is->cutter_comp_orientation };
+    v.insert(v.end(), s, s + sizeof(s) / sizeof(s[0]));
+
+    CANON_SAVE_STATE(&c);
+    const CANON_POSITION *p[] = { &c.g5xOffset, &c.g92Offset, &c.endPoint };
+    for (n = 0; n < 3; n++) {
+	double f[] = { p[n]->x, p[n]->y, p[n]->z, p[n]->a, p[n]->b, p[n]->c,
+	    p[n]->u, p[n]->v, p[n]->w };
+	v.insert(v.end(), f, f + 9);
+    }
+    const EmcPose &t = c.toolOffset;
+    double f[] = { c.xy_rotation, (double) c.rotary_unlock_for_traverse,
+	c.css_maximum, c.css_numerator, (double) c.spindle_dir,
+	(double) c.feed_mode, (double) c.synched, (double) c.lengthUnits,
+	(double) c.activePlane,
+	t.tran.x, t.tran.y, t.tran.z, t.a, t.b, t.c, t.u, t.v, t.w,
+	(double) c.motionMode, c.motionTolerance, c.naivecamTolerance,
+	c.spindleSpeed, c.linearFeedRate, c.angularFeedRate,
+	(double) c.optional_program_stop, (double) c.block_delete,
+	(double) c.cartesian_move, (double) c.angular_move,
+	(double) emcStatus->motion.traj.axis_mask };
+    v.insert(v.end(), f, f + sizeof(f) / sizeof(f[0]));
+    for (n = 0; n < EMCMOT_MAX_AXIS; n++) {
+	v.push_back(emcAxisGetMaxVelocity(n));
+	v.push_back(emcAxisGetMaxAcceleration(n));
+	v.push_back(emcAxisGetMaxJerk(n));
+    }
+}
+
+static bool canon_cache_files_same(const canon_cache_entry *e)
+{
+    struct stat st;
+
+    for (size_t n = 0; n < e->files.size(); n++) {
+	const struct stat &was = e->stats[n];
+	if (stat(e->files[n].c_str(), &st) != 0 ||
+	    st.st_size != was.st_size || st.st_mtime != was.st_mtime ||
+	    st.st_mtim.tv_nsec != was.st_mtim.tv_nsec ||
+	    st.st_ino != was.st_ino) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+static void canon_cache_abandon()
+{
+    if (cache_record == 0) {
+	return;
+    }
+    interp_list.set_recorder(NULL);
+    ngc_fopen_log = NULL;
+    fclose(cache_record_file);
+    canon_cache_free(cache_record);
+    cache_record = 0;
+}
+
+// stops any recording or replay
+static void canon_cache_stop()
+{
+    canon_cache_abandon();
+    cache_replay = 0;
+}
+
+// the program ended the way a live run of it is kept
+static void canon_cache_store()
+{
+    Interp *i = dynamic_cast<Interp*>(pinterp);
+    canon_cache_entry *e = cache_record;
+    struct stat st;
+    size_t n;
+
+    if (i == 0 || !i->can_save_state()) {
+	canon_cache_abandon();
+	return;
+    }
+    e->end = new setup;
+    e->end_position = i->save_state(e->end);
+    CANON_SAVE_STATE(&e->end_canon);
+    interp_list.set_recorder(NULL);
+    ngc_fopen_log = NULL;
+    if (ferror(cache_record_file)) {
+	canon_cache_abandon();
+	return;
+    }
+    fclose(cache_record_file);
+    cache_record = 0;
+    for (n = 0; n < e->files.size(); n++) {
+	if (stat(e->files[n].c_str(), &st) != 0) {
+	    canon_cache_free(e);
+	    return;
+	}
+	e->stats.push_back(st);
+    }
+    canon_cache.insert(canon_cache.begin(), e);
+    while (canon_cache.size() > (size_t) canon_cache_runs) {
+	canon_cache_free(canon_cache.back());
+	canon_cache.pop_back();
+    }
+    if (emc_debug & EMC_DEBUG_INTERP) {
+	rcs_print("canon cache: kept %s, %lu bytes\n", e->filename.c_str(),
+		  (unsigned long) e->len);
+    }
+}
+
+/* called when a program run starts, after emcTaskPlanCheckpointRun(): a
+   run from the top is replayed if it is in the cache, and otherwise
+   recorded for it */
+int emcTaskPlanCacheRun(int line)
+{
+    Interp *i = dynamic_cast<Interp*>(pinterp);
+    canon_cache_entry *e;
+    char buf[LINELEN];
+    std::vector<double> state;
+    std::string globals;
+    off_t size;
+    uint64_t hash;
+    size_t n;
+
+    canon_cache_stop();
+    if (i == 0 || canon_cache_runs <= 0 || line != 0 || interp.line() != 0 ||
+	!i->can_save_state() ||
+	!canon_cache_hash(interp.file(buf, LINELEN), &size, &hash)) {
+	return 0;
+    }
+    canon_cache_state(state, globals);
+    for (n = 0; n < canon_cache.size(); n++) {
+	e = canon_cache[n];
+	if (e->filename == buf && e->size == size && e->hash == hash &&
+	    e->state == state && e->globals == globals &&
+	    canon_cache_files_same(e)) {
+	    canon_cache.erase(canon_cache.begin() + n);
+	    canon_cache.insert(canon_cache.begin(), e);
+	    cache_replay = e;
+	    cache_replay_pos = ((canon_trace_header_t *) e->trace)->header_size;
+	    if (emc_debug & EMC_DEBUG_INTERP) {
+		rcs_print("canon cache: replaying %s\n", buf);
+	    }
+	    return 1;
+	}
+    }
+
+    e = new canon_cache_entry();
+    e->filename = buf;
+    e->size = size;
+    e->hash = hash;
+    e->state.swap(state);
+    e->globals.swap(globals);
+    cache_record_file = open_memstream(&e->trace, &e->len);
+    if (cache_record_file == NULL) {
+	canon_cache_free(e);
+	return 0;
+    }
+    cache_record = e;
+    cache_record_reads = _is->outside_reads;
+    if (canon_trace_write_header(cache_record_file) != 0) {
+	canon_cache_abandon();
+	return 0;
+    }
+    interp_list.set_recorder(cache_record_file);
+    ngc_fopen_log = &e->files;
+    return 0;
+}
+
+// after a read or execute in a recorded run
+static void canon_cache_recorded(int type, int retval)
+{
+    char buf[LINELEN];
+    double arg = retval;
+
+    if (cache_record == 0) {
+	return;
+    }
+    if (retval > INTERP_MIN_ERROR || retval == INTERP_EXECUTE_FINISH ||
+	_is->outside_reads != cache_record_reads ||
+	ftell(cache_record_file) > CANON_CACHE_MAX_TRACE) {
+	canon_cache_abandon();
+	return;
+    }
+    canon_trace_write(cache_record_file, type, interp.line(), &arg, 1,
+		      type == CANON_TRACE_TASK_READ ?
+		      interp.command(buf, LINELEN) : 0);
+    if (retval == INTERP_EXIT || retval == INTERP_ENDFILE) {
+	canon_cache_store();
+    }
+}
+
+/* in a replayed run, puts the messages up to the next read or execute
+   on the interp list and returns what that returned */
+static int canon_cache_replayed(int type)
+{
+    canon_cache_entry *e = cache_replay;
+    const canon_trace_record_t *r;
+    const void *data;
+    size_t len;
+    int retval;
+
+    while ((r = canon_trace_next(e->trace, e->len, &cache_replay_pos))) {
+	if (r->type == CANON_TRACE_INTERP_MSG) {
+	    data = canon_trace_data(r, &len);
+	    interp_list.set_line_number(r->line);
+	    interp_list.append((NMLmsg *) data);
+	    continue;
+	}
+	if (r->type != type) {
+	    break;
+	}
+	retval = (int) canon_trace_arg(r, 0);
+	if (type == CANON_TRACE_TASK_READ) {
+	    cache_replay_line = r->line;
+	    strncpy(cache_replay_command, canon_trace_text(r), LINELEN);
+	    cache_replay_command[LINELEN - 1] = 0;
+	}
+	if (retval == INTERP_EXIT || retval == INTERP_ENDFILE) {
+	    Interp *i = dynamic_cast<Interp*>(pinterp);
+	    cache_replay = 0;
+	    if (i->restore_state(e->end, e->end_position) > INTERP_MIN_ERROR) {
+		print_interp_error(INTERP_ERROR);
+		return INTERP_ERROR;
+	    }
+	    CANON_RESTORE_STATE(&e->end_canon);
+	}
+	return retval;
+    }
+    rcs_print_error("canon cache: the trace of %s is damaged\n",
+		    e->filename.c_str());
+    cache_replay = 0;
+    canon_cache.erase(std::find(canon_cache.begin(), canon_cache.end(), e));
+    canon_cache_free(e);
+    return INTERP_ERROR;
+}
+
+/*
+  Run-from-line checkpoints.  While a program runs, a copy of the
+  interpreter and canon state is kept every [TASK]CHECKPOINT_LINES lines
+  of the main program, the first time the program gets that far.  A run
+  from line n restores the last checkpoint before n and only skips
+  through the lines after it, instead of all of them from the top of the
+  file.  Checkpoints are for one file and are dropped when it changes.
+  One is only used if the offsets (parameters 5161-5390, but not 5220,
+  the active one) and the tool table are the same now as when it was
+  taken; otherwise the run skips from an earlier one, or from the top.
+  Once there are MAX_CHECKPOINTS every other one goes and the spacing
+  doubles.
+*/
+#define MAX_CHECKPOINTS 64
+
+struct plan_checkpoint {
+    int line;			// last line read
+    long position;		// offset of the line after it
+    setup *state;		// the interpreter's
+    CanonConfig_t canon;
+};
+
+static std::vector<plan_checkpoint> checkpoints;
+static int checkpoint_lines = 10000;	// 0 for none
+static int checkpoint_every;
+static bool checkpointing;		// this run started at the top
+static struct stat checkpoint_file;
+
+static void checkpoints_clear()
+{
+    for (size_t n = 0; n < checkpoints.size(); n++) {
+	delete checkpoints[n].state;
+    }
+    checkpoints.clear();
+    checkpoint_every = checkpoint_lines;
+}
+
+// whether what the program was run with then is what it would get now
+static bool checkpoint_usable(const plan_checkpoint &cp)
+{
+    for (int n = 5161; n <= 5390; n++) {
+	if (n != 5220 && cp.state->parameters[n] != _is->parameters[n]) {
+	    return false;
+	}
+    }
+    for (int n = 0; n < CANON_POCKETS_MAX; n++) {
+	const CANON_TOOL_TABLE &was = cp.state->tool_table[n];
+	const CANON_TOOL_TABLE &is = _is->tool_table[n];
+	if (was.toolno != is.toolno || was.diameter != is.diameter ||
+	    memcmp(&was.offset, &is.offset, sizeof(was.offset)) != 0) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+/* called when a program run starts: drops the checkpoints if they are
+   for another file, or the file changed, and with line > 0 restores the
+   last usable one before it; returns the line restored, or 0 */
+int emcTaskPlanCheckpointRun(int line)
+{
+    Interp *i = dynamic_cast<Interp*>(pinterp);
+    char buf[LINELEN];
+    struct stat st;
+
+    checkpointing = false;
+    if (i == 0 || checkpoint_lines <= 0 || interp.line() != 0 ||
+	interp.call_level() != 0 || stat(interp.file(buf, LINELEN), &st) != 0) {
+	return 0;
+    }
+    if (checkpoints.empty() || strcmp(checkpoints[0].state->filename, buf) != 0 ||
+	st.st_size != checkpoint_file.st_size ||
+	st.st_mtime != checkpoint_file.st_mtime ||
+	st.st_mtim.tv_nsec != checkpoint_file.st_mtim.tv_nsec ||
+	st.st_ino != checkpoint_file.st_ino) {
+	checkpoints_clear();
+	checkpoint_file = st;
+    }
+    checkpointing = true;
+
+    // line - 1 has to be read again, it is where skipping stops
+    for (size_t n = checkpoints.size(); n-- > 0;) {
+	const plan_checkpoint &cp = checkpoints[n];
+	if (cp.line > line - 2 || !checkpoint_usable(cp)) {
+	    continue;
+	}
+	if (i->restore_state(cp.state, cp.position) > INTERP_MIN_ERROR) {
+	    return 0;
+	}
+	CANON_RESTORE_STATE(&cp.canon);
+	if (emc_debug & EMC_DEBUG_INTERP) {
+	    rcs_print("emcTaskPlanCheckpointRun(%d) restored line %d\n",
+		      line, cp.line);
+	}
+	return cp.line;
+    }
+    return 0;
+}
+
+/* called after each line executed in a run, line being the last one
+   read: takes a checkpoint if it is time for one */
+int emcTaskPlanCheckpoint(int line)
+{
+    Interp *i;
+    plan_checkpoint cp;
+    size_t n;
+
+    if (!checkpointing || cache_replay || line < (checkpoints.empty() ? 0 :
+				  checkpoints.back().line) + checkpoint_every) {
+	return 0;
+    }
+    i = dynamic_cast<Interp*>(pinterp);
+    if (i == 0 || !i->can_save_state()) {
+	return 0;
+    }
+    if (checkpoints.size() == MAX_CHECKPOINTS) {
+	for (n = 0; n < MAX_CHECKPOINTS; n++) {
+	    if (n % 2) {
+		delete checkpoints[n].state;
+	    } else {
+		checkpoints[n / 2] = checkpoints[n];
+	    }
+	}
+	checkpoints.resize(MAX_CHECKPOINTS / 2);
+	checkpoint_every *= 2;
+    }
+    cp.line = line;
+    cp.state = new setup;
+    cp.position = i->save_state(cp.state);
+    CANON_SAVE_STATE(&cp.canon);
+    checkpoints.push_back(cp);
+    return 0;
+}
+
 int emcTaskPlanInit()
 {
     if(!pinterp) {
@@ -423,6 +910,20 @@ int emcTaskPlanInit()
         pinterp = new Interp;
     }
 
+    {
+	IniFile inifile;
+	const char *inistring;
+	inifile.Open(emc_inifile);
+	if((inistring = inifile.Find("CHECKPOINT_LINES", "TASK"))) {
+	    checkpoint_lines = atoi(inistring);
+	}
+	if((inistring = inifile.Find("CANON_CACHE", "TASK"))) {
+	    canon_cache_runs = atoi(inistring);
+	}
+	inifile.Close();
+    }
+    checkpoints_clear();
+
     Interp *i = dynamic_cast<Interp*>(pinterp);
     if(i) _is = &i->_setup; // FIXME
     else  _is = 0;
@@ -508,6 +1009,7 @@ int emcTaskPlanExit()
 
 int emcTaskPlanOpen(const char *file)
 {
+    canon_cache_stop();
     if (emcStatus != 0) {
 	emcStatus->task.motionLine = 0;
 	emcStatus->task.currentLine = 0;
@@ -531,6 +1033,9 @@ int emcTaskPlanOpen(const char *file)
 
 int emcTaskPlanRead()
 {
+    if (cache_replay) {
+	return canon_cache_replayed(CANON_TRACE_TASK_READ);
+    }
     int retval = interp.read();
     if (retval == INTERP_FILE_NOT_OPEN) {
 	if (emcStatus->task.file[0] != 0) {
@@ -545,6 +1050,8 @@ int emcTaskPlanRead()
 	print_interp_error(retval);
     }
     
+    canon_cache_recorded(CANON_TRACE_TASK_READ, retval);
+
     if (emc_debug & EMC_DEBUG_INTERP) {
         rcs_print("emcTaskPlanRead() returned %d\n", retval);
     }
@@ -556,6 +1063,9 @@ int emcTaskPlanExecute(const char *command)
 {
     int inpos = emcStatus->motion.traj.inpos;	// 1 if in position, 0 if not.
 
+    if (command == 0 && cache_replay) {
+	return canon_cache_replayed(CANON_TRACE_TASK_EXECUTE);
+    }
     if (command != 0) {		// Command is 0 if in AUTO mode, non-null if in MDI mode.
 	// Don't sync if not in position.
 	if ((*command != 0) && (inpos)) {
@@ -568,6 +1078,8 @@ int emcTaskPlanExecute(const char *command)
     }
     if(command != 0) {
 	FINISH();
+    } else {
+	canon_cache_recorded(CANON_TRACE_TASK_EXECUTE, retval);
     }
 
     if (emc_debug & EMC_DEBUG_INTERP) {
@@ -596,6 +1108,7 @@ int emcTaskPlanExecute(const char *command, int line_number)
 
 int emcTaskPlanClose()
 {
+    canon_cache_stop();
     int retval = interp.close();
     if (retval > INTERP_MIN_ERROR) {
 	print_interp_error(retval);
@@ -607,6 +1120,7 @@ int emcTaskPlanClose()
 
 int emcTaskPlanReset()
 {
+    canon_cache_stop();
     int retval = interp.reset();
     if (retval > INTERP_MIN_ERROR) {
 	print_interp_error(retval);
@@ -617,7 +1131,7 @@ int emcTaskPlanReset()
 
 int emcTaskPlanLine()
 {
-    int retval = interp.line();
+    int retval = cache_replay ? cache_replay_line : interp.line();
     
     if (emc_debug & EMC_DEBUG_INTERP) {
         rcs_print("emcTaskPlanLine() returned %d\n", retval);
@@ -641,7 +1155,8 @@ int emcTaskPlanCommand(char *cmd)
 {
     char buf[LINELEN];
 
-    strcpy(cmd, interp.command(buf, LINELEN));
+    strcpy(cmd, cache_replay ? cache_replay_command :
+	   interp.command(buf, LINELEN));
 
     if (emc_debug & EMC_DEBUG_INTERP) {
         rcs_print("emcTaskPlanCommand(%s) called. (line_number=%d)\n",
@@ -658,6 +1173,7 @@ int emcTaskUpdate(EMC_TASK_STAT * stat)
     stat->state = (enum EMC_TASK_STATE_ENUM) determineState();
 
     if(oldstate == EMC_TASK_STATE_ON && oldstate != stat->state) {
+	emcTaskInterpWait();
 	emcTaskAbort();
         emcSpindleAbort();
         emcIoAbort(EMC_ABORT_TASK_STATE_NOT_ON);
@@ -672,14 +1188,18 @@ int emcTaskUpdate(EMC_TASK_STAT * stat)
     // currentLine set in main
     // readLine set in main
 
-    char buf[LINELEN];
-    strcpy(stat->file, interp.file(buf, LINELEN));
-    // command set in main
-
-    // update active G and M codes
-    interp.active_g_codes(&stat->activeGCodes[0]);
-    interp.active_m_codes(&stat->activeMCodes[0]);
-    interp.active_settings(&stat->activeSettings[0]);
+    // the interpreter thread has these while it reads; they catch up
+    // once it is done
+    if (!emcTaskInterpBusy()) {
+	char buf[LINELEN];
+	strcpy(stat->file, interp.file(buf, LINELEN));
+	// command set in main
+
+	// update active G and M codes
+	interp.active_g_codes(&stat->activeGCodes[0]);
+	interp.active_m_codes(&stat->activeMCodes[0]);
+	interp.active_settings(&stat->activeSettings[0]);
+    }
 
     //update state of optional stop
     stat->optional_stop_state = GET_OPTIONAL_PROGRAM_STOP();
@@ -694,6 +1214,7 @@ int emcTaskUpdate(EMC_TASK_STAT * stat)
 
 int emcAbortCleanup(int reason, const char *message)
 {
+    canon_cache_stop();
     int status = interp.on_abort(reason,message);
     if (status > INTERP_MIN_ERROR)
 	print_interp_error(status);
@@ -56,8 +56,15 @@
 #include <unistd.h>		// fork()
 #include <sys/wait.h>		// waitpid(), WNOHANG, WIFEXITED
 #include <ctype.h>		// isspace()
+#include <fcntl.h>		// fcntl(), O_NONBLOCK
+#include <poll.h>		// poll()
+#include <pthread.h>		// the interpreter thread
+#include <sched.h>		// SCHED_OTHER
+#include <errno.h>		// EINTR
+#include <sched.h>		// sched_setscheduler(), SCHED_FIFO
 #include <libintl.h>
 #include <locale.h>
+#include <vector>
 
 #if 0
 // Enable this to niftily trap floating point exceptions for debugging
@@ -105,6 +112,16 @@ EMC_STAT *emcStatus = 0;
 // timer stuff
 static RCS_TIMER *timer = 0;
 
+// [TASK] WAKE_POLL: if > 0, instead of sleeping out the cycle, task
+// looks this often for a new command, news from iocontrol, or the
+// motion queue changing while there is work waiting for it, and starts
+// the next cycle as soon as one of them happens
+static double task_wake_poll = 0.0;
+
+// [TASK] RT_PRIORITY: if > 0, task asks to run SCHED_FIFO at this
+// priority, so other processes do not delay its wakeups
+static int task_rt_priority = 0;
+
 // flag signifying that ini file [TASK] CYCLE_TIME is <= 0.0, so
 // we should not delay at all between cycles. This means also that
 // the EMC_TASK_CYCLE_TIME global will be set to the measured cycle
@@ -120,6 +137,26 @@ static int no_force_homing = 0; // forces the user to home first before allowing
 
 static double EMC_TASK_CYCLE_TIME_ORIG = 0.0;
 
+// [TASK] READAHEAD_TIME: while motion has less than this many seconds
+// queued, keep interpreting for up to READAHEAD_BUDGET seconds a cycle
+// instead of stopping at INTERP_MAX_LEN lines. 0 keeps the line count
+static double readahead_time = 0.0;
+static double readahead_budget = 0.0;
+
+// [TASK] MOVE_BATCH: pack runs of linear moves with the same limits
+// into one interp list node, except while single stepping
+static int move_batch = 0;
+
+// [TASK] SYSTEM_CMD_LAUNCHER: if set, system commands (M100-M199) are
+// started by a small process forked before task grows, instead of by
+// forking all of task for each one
+static int system_cmd_launcher = 0;
+
+// [TASK] INTERP_THREAD: if set, program lines are read and executed on
+// a thread of their own, so that a slow line holds up neither status
+// nor the motion queue, see emcTaskInterpRequest()
+static int interp_thread = 0;
+
 // delay counter
 static double taskExecDelayTimeout = 0.0;
 
@@ -157,6 +194,19 @@ void emctask_quit(int sig)
     signal(sig, emctask_quit);
 }
 
+// the interpreter thread writes errors too, see [TASK] INTERP_THREAD
+static pthread_mutex_t error_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int emcErrorBufferWrite(NMLmsg &msg)
+{
+    int retval;
+
+    pthread_mutex_lock(&error_mutex);
+    retval = emcErrorBuffer->write(msg);
+    pthread_mutex_unlock(&error_mutex);
+    return retval;
+}
+
 /* make sure at least space bytes are available on
  * error channel; wait a bit to drain if needed
  */
@@ -171,7 +221,10 @@ int emcErrorBufferOKtoWrite(int space, const char *caller)
     double send_errorchan_timout = etime() + DEFAULT_EMC_UI_TIMEOUT;
 
     while (etime() < send_errorchan_timout) {
-	if (emcErrorBuffer->get_space_available() < space) {
+	pthread_mutex_lock(&error_mutex);
+	int available = emcErrorBuffer->get_space_available();
+	pthread_mutex_unlock(&error_mutex);
+	if (available < space) {
 	    esleep(0.01);
 	    continue;
 	} else {
@@ -221,7 +274,7 @@ int emcOperatorError(int id, const char *fmt, ...)
 
     // write it
     rcs_print("%s\n", error_msg.error);
-    return emcErrorBuffer->write(error_msg);
+    return emcErrorBufferWrite(error_msg);
 }
 
 int emcOperatorText(int id, const char *fmt, ...)
@@ -241,7 +294,7 @@ int emcOperatorText(int id, const char *fmt, ...)
     text_msg.text[LINELEN - 1] = 0;
 
     // write it
-    return emcErrorBuffer->write(text_msg);
+    return emcErrorBufferWrite(text_msg);
 }
 
 int emcOperatorDisplay(int id, const char *fmt, ...)
@@ -261,7 +314,7 @@ int emcOperatorDisplay(int id, const char *fmt, ...)
     display_msg.display[LINELEN - 1] = 0;
 
     // write it
-    return emcErrorBuffer->write(display_msg);
+    return emcErrorBufferWrite(display_msg);
 }
 
 /*
@@ -309,6 +362,285 @@ static int argvize(const char *src, char *dst, char *argv[], int len)
     return argvix;
 }
 
+/*
+  The launcher is forked once, right after the ini file is read, and
+  execs system commands on task's behalf. Requests and replies are
+  fixed size records on a pair of pipes, small enough to be written
+  atomically. Commands are known to task by an id the launcher maps to
+  the pid it started; launcherRun(), launcherWait() and launcherKill()
+  stand in for fork(), waitpid(WNOHANG) and kill().
+ */
+
+struct launcher_msg {
+    pid_t id;
+    int sig;			// request: signal to send, 0 to start cmd
+    				// reply: wait status of the command
+    char cmd[EMC_SYSTEM_CMD_LEN];
+};
+
+#define LAUNCHER_JOBS 16
+
+static pid_t launcher_pid = 0;
+static int launcher_req = -1;	// to the launcher
+static int launcher_rep = -1;	// from the launcher
+static pid_t launcher_id = 0;	// last id handed out
+
+// commands task is still waiting to hear about; id 0 is a free slot
+static struct {
+    pid_t id;
+    int done;
+    int abandoned;
+    int status;
+} launcher_jobs[LAUNCHER_JOBS];
+
+// launcher side
+static int launcher_chld[2];
+
+static void launcher_sigchld(int sig)
+{
+    char c = 0;
+    if (write(launcher_chld[1], &c, 1) < 0) {
+	// pipe full, there's a wakeup pending anyway
+    }
+}
+
+static void launcher_reply(int rep, pid_t id, int status)
+{
+    struct launcher_msg m;
+
+    memset(&m, 0, sizeof(m));
+    m.id = id;
+    m.sig = status;
+    if (write(rep, &m, sizeof(m)) != sizeof(m)) {
+	// task is gone, we'll see EOF on the request pipe
+    }
+}
+
+static void launcher_main(int req, int rep)
+{
+    struct {
+	pid_t id;
+	pid_t pid;
+    } running[LAUNCHER_JOBS];
+    struct launcher_msg m;
+    struct pollfd fds[2];
+    char buffer[EMC_SYSTEM_CMD_LEN];
+    char *argv[EMC_SYSTEM_CMD_LEN / 2 + 1];
+    pid_t pid;
+    int status;
+    int n;
+    char c;
+
+    // go down with the rest of the session, not with task's handlers
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    memset(running, 0, sizeof(running));
+    if (pipe(launcher_chld) < 0) {
+	_exit(1);
+    }
+    fcntl(launcher_chld[0], F_SETFL, O_NONBLOCK);
+    fcntl(launcher_chld[1], F_SETFL, O_NONBLOCK);
+    signal(SIGCHLD, launcher_sigchld);
+
+    for (;;) {
+	fds[0].fd = req;
+	fds[0].events = POLLIN;
+	fds[0].revents = 0;
+	fds[1].fd = launcher_chld[0];
+	fds[1].events = POLLIN;
+	fds[1].revents = 0;
+	if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+	    break;
+	}
+	while (read(launcher_chld[0], &c, 1) == 1);
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+	    for (n = 0; n < LAUNCHER_JOBS; n++) {
+		if (running[n].pid == pid) {
+		    launcher_reply(rep, running[n].id, status);
+		    running[n].pid = 0;
+		    break;
+		}
+	    }
+	}
+	if (!(fds[0].revents & (POLLIN | POLLHUP))) {
+	    continue;
+	}
+	n = read(req, &m, sizeof(m));
+	if (n == 0) {
+	    break;		// task closed its end
+	}
+	if (n != sizeof(m)) {
+	    continue;
+	}
+	if (m.sig != 0) {
+	    for (n = 0; n < LAUNCHER_JOBS; n++) {
+		if (running[n].pid != 0 && running[n].id == m.id) {
+		    kill(running[n].pid, m.sig);
+		}
+	    }
+	    continue;
+	}
+	for (n = 0; n < LAUNCHER_JOBS && running[n].pid != 0; n++);
+	pid = n < LAUNCHER_JOBS ? fork() : -1;
+	if (pid == 0) {
+	    close(req);
+	    close(rep);
+	    signal(SIGCHLD, SIG_DFL);
+	    m.cmd[sizeof(m.cmd) - 1] = 0;
+	    argvize(m.cmd, buffer, argv, EMC_SYSTEM_CMD_LEN);
+	    // drop any setuid privileges
+	    setuid(getuid());
+	    execvp(argv[0], argv);
+	    _exit(-1);
+	}
+	if (pid < 0) {
+	    // same as a command that couldn't be exec'd
+	    launcher_reply(rep, m.id, 255 << 8);
+	    continue;
+	}
+	running[n].id = m.id;
+	running[n].pid = pid;
+    }
+    _exit(0);
+}
+
+// task side
+static int launcherStart(void)
+{
+    int req[2], rep[2];
+
+    if (pipe(req) < 0) {
+	return -1;
+    }
+    if (pipe(rep) < 0) {
+	close(req[0]);
+	close(req[1]);
+	return -1;
+    }
+    launcher_pid = fork();
+    if (launcher_pid < 0) {
+	launcher_pid = 0;
+	close(req[0]);
+	close(req[1]);
+	close(rep[0]);
+	close(rep[1]);
+	return -1;
+    }
+    if (launcher_pid == 0) {
+	close(req[1]);
+	close(rep[0]);
+	launcher_main(req[0], rep[1]);
+    }
+    close(req[0]);
+    close(rep[1]);
+    launcher_req = req[1];
+    launcher_rep = rep[0];
+    fcntl(launcher_rep, F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+static void launcherStop(void)
+{
+    if (launcher_pid == 0) {
+	return;
+    }
+    // EOF on its request pipe makes it exit; commands still running
+    // are left to finish on their own
+    close(launcher_req);
+    close(launcher_rep);
+    waitpid(launcher_pid, NULL, 0);
+    launcher_pid = 0;
+}
+
+// collect whatever replies have come in
+static void launcherCollect(void)
+{
+    struct launcher_msg m;
+    int n;
+
+    while (read(launcher_rep, &m, sizeof(m)) == sizeof(m)) {
+	for (n = 0; n < LAUNCHER_JOBS; n++) {
+	    if (launcher_jobs[n].id == m.id) {
+		if (launcher_jobs[n].abandoned) {
+		    launcher_jobs[n].id = 0;
+		} else {
+		    launcher_jobs[n].done = 1;
+		    launcher_jobs[n].status = m.sig;
+		}
+		break;
+	    }
+	}
+    }
+}
+
+static pid_t launcherRun(const char *s)
+{
+    struct launcher_msg m;
+    int n;
+
+    launcherCollect();
+    for (n = 0; n < LAUNCHER_JOBS && launcher_jobs[n].id != 0; n++);
+    if (n == LAUNCHER_JOBS) {
+	return -1;
+    }
+    if (++launcher_id <= 0) {
+	launcher_id = 1;
+    }
+    memset(&m, 0, sizeof(m));
+    m.id = launcher_id;
+    strncpy(m.cmd, s, sizeof(m.cmd) - 1);
+    if (write(launcher_req, &m, sizeof(m)) != sizeof(m)) {
+	return -1;
+    }
+    launcher_jobs[n].id = m.id;
+    launcher_jobs[n].done = 0;
+    launcher_jobs[n].abandoned = 0;
+    return m.id;
+}
+
+// like waitpid(id, status, WNOHANG)
+static pid_t launcherWait(pid_t id, int *status)
+{
+    int n;
+
+    launcherCollect();
+    for (n = 0; n < LAUNCHER_JOBS; n++) {
+	if (launcher_jobs[n].id == id && !launcher_jobs[n].abandoned) {
+	    if (!launcher_jobs[n].done) {
+		return 0;
+	    }
+	    *status = launcher_jobs[n].status;
+	    launcher_jobs[n].id = 0;
+	    return id;
+	}
+    }
+    return -1;
+}
+
+// signal the command, and forget about it
+static int launcherKill(pid_t id, int sig)
+{
+    struct launcher_msg m;
+    int n;
+
+    for (n = 0; n < LAUNCHER_JOBS; n++) {
+	if (launcher_jobs[n].id == id) {
+	    if (launcher_jobs[n].done) {
+		launcher_jobs[n].id = 0;
+	    } else {
+		launcher_jobs[n].abandoned = 1;
+	    }
+	}
+    }
+    memset(&m, 0, sizeof(m));
+    m.id = id;
+    m.sig = sig;
+    if (write(launcher_req, &m, sizeof(m)) != sizeof(m)) {
+	return -1;
+    }
+    return 0;
+}
+
 static pid_t emcSystemCmdPid = 0;
 
 int emcSystemCmd(char *s)
@@ -325,6 +657,18 @@ int emcSystemCmd(char *s)
 	}
     }
 
+    if (0 != launcher_pid) {
+	emcSystemCmdPid = launcherRun(s);
+	if (-1 == emcSystemCmdPid) {
+	    emcSystemCmdPid = 0;
+	    if (emc_debug & EMC_DEBUG_TASK_ISSUE) {
+		rcs_print("system command ``%s'' can't be executed\n", s);
+	    }
+	    return -1;
+	}
+	return 0;
+    }
+
     emcSystemCmdPid = fork();
 
     if (-1 == emcSystemCmdPid) {
@@ -379,6 +723,7 @@ static EMC_TRAJ_SET_SPINDLE_SCALE *emcTrajSetSpindleScaleMsg;
 static EMC_TRAJ_SET_VELOCITY *emcTrajSetVelocityMsg;
 static EMC_TRAJ_SET_ACCELERATION *emcTrajSetAccelerationMsg;
 static EMC_TRAJ_LINEAR_MOVE *emcTrajLinearMoveMsg;
+static EMC_TRAJ_LINEAR_MOVE_BATCH *emcTrajLinearMoveBatchMsg;
 static EMC_TRAJ_NURBS_MOVE *emcTrajNurbsMoveMsg;
 static EMC_TRAJ_CIRCULAR_MOVE *emcTrajCircularMoveMsg;
 static EMC_TRAJ_DELAY *emcTrajDelayMsg;
@@ -438,6 +783,10 @@ static NML_INTERP_LIST mdi_input_queue;
 #define  MAX_MDI_QUEUE 100
 static int max_mdi_queued_commands = MAX_MDI_QUEUE;
 
+// lines of an EMC_TASK_PLAN_EXECUTE_BATCH not yet handed to interp_list;
+// the next one is appended behind the output of the one just interpreted
+static NML_INTERP_LIST mdi_batch_queue;
+
 /*
   checkInterpList(NML_INTERP_LIST *il, EMC_STAT *stat) takes a pointer
   to an interpreter list and a pointer to the EMC status, pops each NML
@@ -518,12 +867,175 @@ static int checkInterpList(NML_INTERP_LIST * il, EMC_STAT * stat)
 #undef operator_error_msg
 #undef nurbs_move_msg
 }
+// adds one time to a timing histogram, see EMC_TASK_TIMING
+static void emcTaskTimingAdd(struct EMC_TASK_TIMING *t, double secs)
+{
+    double us = secs * 1e6;
+    int n;
+
+    if (t->count >= EMC_TASK_TIMING_HALFLIFE) {
+	t->count /= 2;
+	t->total /= 2;
+	for (n = 0; n < EMC_TASK_TIMING_BUCKETS; n++) {
+	    t->hist[n] /= 2;
+	}
+    }
+    t->count++;
+    t->last = secs;
+    t->total += secs;
+    if (secs > t->max) {
+	t->max = secs;
+    }
+    for (n = 0; n < EMC_TASK_TIMING_BUCKETS - 1 && us >= 1.0; n++) {
+	us /= 2;
+    }
+    t->hist[n]++;
+}
+
+static void emcTaskPhaseTime(int phase, double start)
+{
+    emcTaskTimingAdd(&emcStatus->task.phaseTiming[phase], etime() - start);
+}
+
+// command being timed until task is done with it. One that comes in
+// before then starts the clock again, so only the last one is timed.
+// Types beyond the first EMC_TASK_LATENCY_TYPES aren't kept.
+static NMLTYPE latency_type = 0;
+static double latency_start;
+
+static void emcTaskLatencyDone(void)
+{
+    struct EMC_TASK_LATENCY *l = emcStatus->task.commandLatency;
+    int n;
+
+    for (n = 0; n < EMC_TASK_LATENCY_TYPES; n++) {
+	if (l[n].type == latency_type || l[n].type == 0) {
+	    l[n].type = latency_type;
+	    emcTaskTimingAdd(&l[n].timing, etime() - latency_start);
+	    break;
+	}
+    }
+    latency_type = 0;
+}
+
 extern int emcTaskMopup();
 
+// most commands task takes from emcCommand in a cycle, see
+// emcTaskSettingCommand()
+#define TASK_COMMANDS_PER_CYCLE 8
+
+/*
+  emcTaskSettingCommand() says whether a command only changes a setting
+  that doesn't depend on the mode or state, so that the one queued
+  after it can be planned in the same cycle without seeing a stale
+  emcStatus
+  */
+static int emcTaskSettingCommand(NMLTYPE type)
+{
+    switch (type) {
+    case EMC_TRAJ_SET_SCALE_TYPE:
+    case EMC_TRAJ_SET_MAX_VELOCITY_TYPE:
+    case EMC_TRAJ_SET_SPINDLE_SCALE_TYPE:
+    case EMC_TRAJ_SET_FO_ENABLE_TYPE:
+    case EMC_TRAJ_SET_FH_ENABLE_TYPE:
+    case EMC_TRAJ_SET_SO_ENABLE_TYPE:
+    case EMC_TASK_PLAN_SET_OPTIONAL_STOP_TYPE:
+    case EMC_TASK_PLAN_SET_BLOCK_DELETE_TYPE:
+    case EMC_SET_DEBUG_TYPE:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+/*
+  emcTaskEcho() notes in emcStatus that task took the command with
+  this serial number, for clients sharing a queued emcCommand
+  */
+static void emcTaskEcho(int serial_number)
+{
+    emcStatus->echo_serial_index =
+	(emcStatus->echo_serial_index + 1) % EMC_ECHO_SERIALS;
+    emcStatus->echo_serials[emcStatus->echo_serial_index] = serial_number;
+}
+
+// timing function for the cycle timer when [TASK] WAKE_POLL is set:
+// returns at the end of the cycle, or earlier once there's something
+// to do.  The wake-up sources are compared with what they were when
+// the last cycle started, so news that came in during it counts too
+static int emcTaskWait(void *arg)
+{
+    static double last_wake = 0.0;
+    static int last_commands, last_io, last_motion;
+    int commands, io, motion;
+    double now, deadline;
+
+    deadline = last_wake + emc_task_cycle_time;
+    for (;;) {
+	commands = emcCommandBuffer->get_msg_count();
+	io = emcIoStatusCount();
+	motion = emcMotionQueueState();
+	if (commands != last_commands || io != last_io) {
+	    break;
+	}
+	// the motion queue only matters if something waits on it
+	if (motion != last_motion &&
+	    (interp_list.len() != 0 || emcTaskCommand != 0 ||
+	     emcStatus->task.execState != EMC_TASK_EXEC_DONE)) {
+	    break;
+	}
+	now = etime();
+	if (now >= deadline) {
+	    break;
+	}
+	esleep(deadline - now < task_wake_poll ? deadline - now : task_wake_poll);
+    }
+    last_commands = commands;
+    last_io = io;
+    last_motion = motion;
+    last_wake = etime();
+    return 0;
+}
+
+/*
+  With [TASK] INTERP_THREAD, readahead_reading() runs on interp_tid when
+  the task loop asks for it with emcTaskInterpRequest(), and the task
+  loop goes on sending interp_list to motion in the meantime.  The
+  interpreter and canon are only used by one thread at a time: while
+  the thread is busy the task loop doesn't plan, leaves a new command
+  in emcCommand, and issues only what emcTaskInterpOverlap() allows.
+  Anything else sets interp_yield and waits for the thread to finish
+  the line it is on.
+  */
+static pthread_t interp_tid;
+static pthread_mutex_t interp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t interp_cond = PTHREAD_COND_INITIALIZER;
+static int interp_started = 0;		// interp_tid is running
+static int interp_requested = 0;	// the thread should read some lines
+static int interp_busy = 0;		// until it has
+static int interp_quit = 0;
+static volatile int interp_yield = 0;	// stop after the current line
+
+// whether readahead_reading should read another line this cycle
+static int readahead_more(int count, double start)
+{
+    if (interp_yield) {
+	return 0;
+    }
+    if (readahead_time > 0.0 &&
+	emcStatus->motion.traj.queueTime < readahead_time) {
+	return interp_list.len() <= emc_task_interp_max_len &&
+	    etime() - start < readahead_budget;
+    }
+    return count < emc_task_interp_max_len &&
+	interp_list.len() <= emc_task_interp_max_len * 2/3;
+}
+
 void readahead_reading(void)
 {
     int readRetval;
     int execRetval;
+    double start = etime();
 
 		if (interp_list.len() <= emc_task_interp_max_len) {
                     int count = 0;
@@ -537,7 +1049,10 @@ interpret_again:
 			    emcTaskPlanClearWait();
 			 }
 		    } else {
+			double readStart = etime();
+			interp_list.set_batch(move_batch && !stepping);
 			readRetval = emcTaskPlanRead();
+			emcTaskPhaseTime(EMC_TASK_PHASE_READ, readStart);
 			/*! \todo MGS FIXME
 			   This if() actually evaluates to if (readRetval != INTERP_OK)...
 			   *** Need to look at all calls to things that return INTERP_xxx values! ***
@@ -590,6 +1105,7 @@ interpret_again:
 			    } else {
 
 				// executed a good line
+				emcTaskPlanCheckpoint(emcStatus->task.readLine);
 			    }
 
 			    // throw the results away if we're supposed to
@@ -638,9 +1154,8 @@ interpret_again:
                                 }
 			    }
 
-                            if (count++ < emc_task_interp_max_len
-                                    && emcStatus->task.interpState == EMC_TASK_INTERP_READING
-                                    && interp_list.len() <= emc_task_interp_max_len * 2/3) {
+                            if (emcStatus->task.interpState == EMC_TASK_INTERP_READING
+                                    && readahead_more(++count, start)) {
                                 goto interpret_again;
                             }
 
@@ -649,6 +1164,137 @@ interpret_again:
 		}		// if interp len is less than max
 }
 
+static void *emcTaskInterpThread(void *arg)
+{
+    pthread_mutex_lock(&interp_mutex);
+    while (!interp_quit) {
+	if (!interp_requested) {
+	    pthread_cond_wait(&interp_cond, &interp_mutex);
+	    continue;
+	}
+	interp_requested = 0;
+	pthread_mutex_unlock(&interp_mutex);
+	readahead_reading();
+	pthread_mutex_lock(&interp_mutex);
+	interp_busy = 0;
+	pthread_cond_broadcast(&interp_cond);
+    }
+    pthread_mutex_unlock(&interp_mutex);
+    return NULL;
+}
+
+// starts the interpreter thread at normal priority, so that it only
+// gets what task and motion leave over; 0 if it's running
+static int emcTaskInterpStart(void)
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+    int retval;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam(&attr, &param);
+    retval = pthread_create(&interp_tid, &attr, emcTaskInterpThread, NULL);
+    pthread_attr_destroy(&attr);
+    if (retval != 0) {
+	return -1;
+    }
+    interp_started = 1;
+    return 0;
+}
+
+static void emcTaskInterpStop(void)
+{
+    if (!interp_started) {
+	return;
+    }
+    emcTaskInterpWait();
+    pthread_mutex_lock(&interp_mutex);
+    interp_quit = 1;
+    pthread_cond_broadcast(&interp_cond);
+    pthread_mutex_unlock(&interp_mutex);
+    pthread_join(interp_tid, NULL);
+    interp_started = 0;
+}
+
+// has the thread read some lines, unless it still is
+static void emcTaskInterpRequest(void)
+{
+    pthread_mutex_lock(&interp_mutex);
+    if (!interp_busy) {
+	interp_yield = 0;
+	interp_busy = interp_requested = 1;
+	pthread_cond_broadcast(&interp_cond);
+    }
+    pthread_mutex_unlock(&interp_mutex);
+}
+
+// whether the interpreter thread is reading, so that the interpreter
+// and canon are not to be used
+int emcTaskInterpBusy(void)
+{
+    int busy;
+
+    if (!interp_started) {
+	return 0;
+    }
+    pthread_mutex_lock(&interp_mutex);
+    busy = interp_busy;
+    pthread_mutex_unlock(&interp_mutex);
+    return busy;
+}
+
+// waits for the interpreter thread to finish the line it is on, for
+// aborts and anything else that needs the interpreter now
+void emcTaskInterpWait(void)
+{
+    if (!interp_started) {
+	return;
+    }
+    pthread_mutex_lock(&interp_mutex);
+    if (interp_busy) {
+	interp_yield = 1;
+	while (interp_busy) {
+	    pthread_cond_wait(&interp_cond, &interp_mutex);
+	}
+    }
+    pthread_mutex_unlock(&interp_mutex);
+}
+
+// whether a command from interp_list only goes to motion, so that it
+// can be issued while the interpreter thread is reading
+static int emcTaskInterpOverlap(NMLTYPE type)
+{
+    switch (type) {
+    case EMC_TRAJ_LINEAR_MOVE_TYPE:
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
+    case EMC_TRAJ_CIRCULAR_MOVE_TYPE:
+    case EMC_TRAJ_NURBS_MOVE_TYPE:
+    case EMC_TRAJ_SET_VELOCITY_TYPE:
+    case EMC_TRAJ_SET_ACCELERATION_TYPE:
+    case EMC_TRAJ_SET_TERM_COND_TYPE:
+    case EMC_TRAJ_SET_SPINDLESYNC_TYPE:
+    case EMC_TRAJ_SET_FO_ENABLE_TYPE:
+    case EMC_TRAJ_SET_FH_ENABLE_TYPE:
+    case EMC_TRAJ_SET_SO_ENABLE_TYPE:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+// emcCommand's message count when it was last read
+static int command_count = 0;
+
+// whether a command came in that the task loop hasn't read yet
+static int emcTaskCommandWaiting(void)
+{
+    return emcCommandBuffer->get_msg_count() != command_count ||
+	emcCommandBuffer->get_queue_length() > 0;
+}
+
 static void mdi_execute_abort(void)
 {
     // XXX: Reset needed?
@@ -660,9 +1306,58 @@ static void mdi_execute_abort(void)
     
     mdi_execute_queue.clear();
     mdi_input_queue.clear();
+    mdi_batch_queue.clear();
     emcStatus->task.interpState = EMC_TASK_INTERP_IDLE;
 }
 
+// Split an MDI batch into its lines and append the first to interp_list.
+// Returns the number of lines, or -1 if one is too long.
+static int mdi_batch_start(const char *commands)
+{
+    EMC_TASK_PLAN_EXECUTE line;
+    const char *p = commands;
+    const char *end = commands + strnlen(commands, EMC_MDI_BATCH_LEN);
+    int count = 0;
+
+    mdi_batch_queue.clear();
+    while (p < end) {
+	const char *nl = (const char *) memchr(p, '\n', end - p);
+	size_t len = nl ? (size_t) (nl - p) : (size_t) (end - p);
+	if (len >= sizeof(line.command)) {
+	    mdi_batch_queue.clear();
+	    return -1;
+	}
+	memcpy(line.command, p, len);
+	line.command[len] = 0;
+	p += len + (nl ? 1 : 0);
+	// blank lines would read as the 0xff continuation marker
+	if (strspn(line.command, " \t\r") == len)
+	    continue;
+	mdi_batch_queue.append(line);
+	count++;
+    }
+
+    emcStatus->task.mdiBatchLines = count;
+    emcStatus->task.mdiBatchRead = 0;
+    emcStatus->task.mdiBatchDone = 0;
+    if (count)
+	interp_list.append(mdi_batch_queue.get());
+    return count;
+}
+
+// Lines of the current batch are interpreted with their batch index as
+// line number, so the motion id tells which of them are complete.
+static void mdi_batch_update(void)
+{
+    EMC_TASK_STAT *task = &emcStatus->task;
+
+    if (task->mdiBatchDone >= task->mdiBatchRead)
+	return;
+    if (task->motionLine > task->mdiBatchDone + 1 &&
+	task->motionLine <= task->mdiBatchRead)
+	task->mdiBatchDone = task->motionLine - 1;
+}
+
 static void mdi_execute_hook(void)
 {
     if (mdi_execute_wait && emcTaskPlanIsWait()) {
@@ -699,6 +1394,9 @@ static void mdi_execute_hook(void)
 		      emcStatus->task.command, mdi_input_queue.len());
 	emcStatus->task.command[0] = 0;
 	emcStatus->task.interpState = EMC_TASK_INTERP_IDLE;
+	emcStatus->task.mdiBatchDone = emcStatus->task.mdiBatchRead;
+    } else if (emcStatus->task.interpState != EMC_TASK_INTERP_IDLE) {
+	mdi_batch_update();
     }
 
     if (!mdi_execute_next) return;
@@ -1136,7 +1834,11 @@ static int emcTaskPlan(void)
 		}		// switch (type) in ON, AUTO, READING
 
                // handle interp readahead logic
-                readahead_reading();
+		if (interp_started) {
+		    emcTaskInterpRequest();
+		} else {
+		    readahead_reading();
+		}
                 
 		break;		// EMC_TASK_INTERP_READING
 
@@ -1399,6 +2101,17 @@ static int emcTaskPlan(void)
 		}
 		break;
 
+	    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+		// too big for the MDI input queue, so only taken when idle
+		if (emcStatus->task.interpState != EMC_TASK_INTERP_IDLE ||
+		    mdi_input_queue.len() > 0) {
+		    emcOperatorError(0, _("can't start an MDI batch while MDI is executing"));
+		    retval = -1;
+		} else {
+		    retval = emcTaskIssueCommand(emcCommand);
+		}
+		break;
+
 	    case EMC_TOOL_LOAD_TOOL_TABLE_TYPE:
 	    case EMC_TOOL_SET_OFFSET_TYPE:
 		// send to IO
@@ -1469,6 +2182,7 @@ static int emcTaskCheckPreconditions(NMLmsg * cmd)
     case EMC_TRAJ_NURBS_MOVE_TYPE:
 //TODO-eric:nurbs preconditions check
     case EMC_TRAJ_LINEAR_MOVE_TYPE:
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
     case EMC_TRAJ_CIRCULAR_MOVE_TYPE:
     case EMC_TRAJ_SET_VELOCITY_TYPE:
     case EMC_TRAJ_SET_ACCELERATION_TYPE:
@@ -1566,6 +2280,13 @@ static int emcTaskCheckPreconditions(NMLmsg * cmd)
     case EMC_IO_PLUGIN_CALL_TYPE:
 	return EMC_TASK_EXEC_DONE;
 	break;
+
+    case EMC_TASK_PLAN_EXECUTE_TYPE:
+	// deferred and batched MDI lines: interpret without waiting, so
+	// the new line's moves blend with those still queued
+	return EMC_TASK_EXEC_DONE;
+	break;
+
     default:
 	// unrecognized command
 	if (emc_debug & EMC_DEBUG_TASK_ISSUE) {
@@ -1591,8 +2312,19 @@ int emcTaskQueueCommand(NMLmsg * cmd)
     return 0;
 }
 
+static int emcTaskIssue(NMLmsg * cmd);
+
 // issues command immediately
 static int emcTaskIssueCommand(NMLmsg * cmd)
+{
+    double start = etime();
+    int retval = emcTaskIssue(cmd);
+
+    emcTaskPhaseTime(EMC_TASK_PHASE_ISSUE, start);
+    return retval;
+}
+
+static int emcTaskIssue(NMLmsg * cmd)
 {
     int retval = 0;
     int execRetval = 0;
@@ -1694,7 +2426,8 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 					set_homing_params_msg->is_shared,
 					set_homing_params_msg->home_sequence,
 					set_homing_params_msg->volatile_home,
-                                        set_homing_params_msg->locking_indexer);
+                                        set_homing_params_msg->locking_indexer,
+                                        set_homing_params_msg->home_overlap);
 	break;
 
     case EMC_JOINT_SET_FERROR_TYPE:
@@ -1799,6 +2532,30 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
                 emcTrajLinearMoveMsg->indexrotary);
 	break;
 
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
+	{
+	    EmcPose end[EMC_TRAJ_BATCH_MAX];
+	    double jerk[EMC_TRAJ_BATCH_MAX];
+
+	    emcTrajLinearMoveBatchMsg = (EMC_TRAJ_LINEAR_MOVE_BATCH *) cmd;
+	    emcTrajLinearMoveBatchMsg->unpack(end, jerk);
+	    for (int i = 0; i < emcTrajLinearMoveBatchMsg->count; i++) {
+		// each move keeps its own line for motion's status
+		emcTrajSetMotionId(emcTrajLinearMoveBatchMsg->line[i]);
+		retval = emcTrajLinearMove(end[i],
+			emcTrajLinearMoveBatchMsg->type,
+			emcTrajLinearMoveBatchMsg->vel,
+			emcTrajLinearMoveBatchMsg->ini_maxvel,
+			emcTrajLinearMoveBatchMsg->acc,
+			jerk[i],
+			emcTrajLinearMoveBatchMsg->indexrotary);
+		if (retval != 0) {
+		    break;
+		}
+	    }
+	}
+	break;
+
     case EMC_TRAJ_CIRCULAR_MOVE_TYPE:
 	emcTrajCircularMoveMsg = (EMC_TRAJ_CIRCULAR_MOVE *) cmd;
         retval = emcTrajCircularMove(emcTrajCircularMoveMsg->end,
@@ -2184,7 +2941,13 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 		    mdi_execute_level = level;
 	    }
 
-	    execRetval = emcTaskPlanExecute(command, 0);
+	    // while a batch runs, every new line executed is the next of it
+	    int batch_line = 0;
+	    if (command && emcStatus->task.mdiBatchRead <
+		emcStatus->task.mdiBatchLines)
+		batch_line = ++emcStatus->task.mdiBatchRead;
+
+	    execRetval = emcTaskPlanExecute(command, batch_line);
 
 	    level = emcTaskPlanLevel();
 
@@ -2238,6 +3001,37 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 		// other codes are OK
 		retval = 0;
 	    }
+
+	    // queue the next batch line behind this one's output; if this
+	    // one waits or calls a sub it is held on mdi_execute_queue
+	    if (batch_line && execRetval != INTERP_ERROR && mdi_batch_queue.len())
+		interp_list.append(mdi_batch_queue.get());
+	}
+	break;
+
+    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+        if (!all_homed() && !no_force_homing) {
+            emcOperatorError(0, _("Can't issue MDI command when not homed"));
+            retval = -1;
+            break;
+        }
+        if (emcStatus->task.mode != EMC_TASK_MODE_MDI) {
+            emcOperatorError(0, _("Must be in MDI mode to issue MDI command"));
+            retval = -1;
+            break;
+        }
+	stepping = 0;
+	steppingWait = 0;
+	{
+	    int lines = mdi_batch_start(((EMC_TASK_PLAN_EXECUTE_BATCH *) cmd)->commands);
+	    if (lines < 0) {
+		emcOperatorError(0, _("MDI batch line too long"));
+		retval = -1;
+	    } else if (lines > 0) {
+		// the lines run from interp_list, so READING until the last is done
+		emcStatus->task.interpState = EMC_TASK_INTERP_READING;
+		retval = 0;
+	    }
 	}
 	break;
 
@@ -2254,6 +3048,10 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 	}
 	run_msg = (EMC_TASK_PLAN_RUN *) cmd;
 	programStartLine = run_msg->line;
+	// skip only from the last checkpoint before the line on
+	emcTaskPlanCheckpointRun(programStartLine);
+	// and don't interpret at all if the run is in the canon cache
+	emcTaskPlanCacheRun(programStartLine);
 	emcStatus->task.interpState = EMC_TASK_INTERP_READING;
 	emcStatus->task.task_paused = 0;
 	retval = 0;
@@ -2381,6 +3179,7 @@ static int emcTaskCheckPostconditions(NMLmsg * cmd)
     case EMC_TRAJ_NURBS_MOVE_TYPE:
 //TODO-eric: NURBS postcondition check
     case EMC_TRAJ_LINEAR_MOVE_TYPE:
+    case EMC_TRAJ_LINEAR_MOVE_BATCH_TYPE:
     case EMC_TRAJ_CIRCULAR_MOVE_TYPE:
     case EMC_TRAJ_SET_VELOCITY_TYPE:
     case EMC_TRAJ_SET_ACCELERATION_TYPE:
@@ -2502,7 +3301,11 @@ static int emcTaskExecute(void)
 	    rcs_print("emcSystemCmd: abandoning process %d\n",
 		      emcSystemCmdPid);
 	}
-	kill(emcSystemCmdPid, SIGINT);
+	if (0 != launcher_pid) {
+	    launcherKill(emcSystemCmdPid, SIGINT);
+	} else {
+	    kill(emcSystemCmdPid, SIGINT);
+	}
 	emcSystemCmdPid = 0;
     }
 
@@ -2514,6 +3317,7 @@ static int emcTaskExecute(void)
 	   and in emcTaskIssueCommand() */
 
 	// abort everything
+	emcTaskInterpWait();
 	emcTaskAbort();
         emcIoAbort(EMC_ABORT_TASK_EXEC_ERROR);
         emcSpindleAbort();
@@ -2572,6 +3376,10 @@ static int emcTaskExecute(void)
 			    emcTaskCheckPreconditions(emcTaskCommand);
 		    }
 		}
+	    } else if (emcTaskInterpBusy() &&
+		       !emcTaskInterpOverlap(emcTaskCommand->type)) {
+		// it goes out once the interpreter thread is done
+		interp_yield = 1;
 	    } else {
 		// have an outstanding command
 		if (0 != emcTaskIssueCommand(emcTaskCommand)) {
@@ -2765,7 +3573,11 @@ static int emcTaskExecute(void)
 	    break;
 	}
 	// check the status of the system command
-	pid = waitpid(emcSystemCmdPid, &status, WNOHANG);
+	if (0 != launcher_pid) {
+	    pid = launcherWait(emcSystemCmdPid, &status);
+	} else {
+	    pid = waitpid(emcSystemCmdPid, &status, WNOHANG);
+	}
 
 	if (0 == pid) {
 	    // child is still executing
@@ -2840,211 +3652,172 @@ static int emcTaskExecute(void)
 }
 
 // called to allocate and init resources
-static int emctask_startup()
-{
-    double end;
-    int good;
-
 #define RETRY_TIME 10.0		// seconds to wait for subsystems to come up
-#define RETRY_INTERVAL 1.0	// seconds between wait tries for a subsystem
-
-    // moved up so it can be exposed in taskmodule at init time
-    // // get our status data structure
-    // emcStatus = new EMC_STAT;
-
-    // get the NML command buffer
-    if (!(emc_debug & EMC_DEBUG_NML)) {
-	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
-	// messages
-    }
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (NULL != emcCommandBuffer) {
-	    delete emcCommandBuffer;
-	}
-	emcCommandBuffer =
-	    new RCS_CMD_CHANNEL(emcFormat, "emcCommand", "emc",
-				emc_nmlfile);
-	if (emcCommandBuffer->valid()) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
-	}
-    } while (end > 0.0);
-    set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
-    // messages
-    if (!good) {
-	rcs_print_error("can't get emcCommand buffer\n");
+#define RETRY_FIRST 0.01	// seconds before the first retry
+#define RETRY_INTERVAL 0.2	// most seconds between retries
+
+// The peers task waits for at startup.  Each try constructs the channel
+// or sends the init again; nothing tells task when emcsvr, iocontrol or
+// motmod have made their shared memory, so it retries, but every step
+// that is not up is tried each round rather than one step at a time.
+static int startupCommandBuffer()
+{
+    delete emcCommandBuffer;
+    emcCommandBuffer =
+	new RCS_CMD_CHANNEL(emcFormat, "emcCommand", "emc", emc_nmlfile);
+    if (!emcCommandBuffer->valid()) {
 	return -1;
     }
     // get our command data structure
     emcCommand = emcCommandBuffer->get_address();
+    return 0;
+}
 
-    // get the NML status buffer
-    if (!(emc_debug & EMC_DEBUG_NML)) {
-	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
-	// messages
-    }
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (NULL != emcStatusBuffer) {
-	    delete emcStatusBuffer;
-	}
-	emcStatusBuffer =
-	    new RCS_STAT_CHANNEL(emcFormat, "emcStatus", "emc",
-				 emc_nmlfile);
-	if (emcStatusBuffer->valid()) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
+static int startupStatusBuffer()
+{
+    delete emcStatusBuffer;
+    emcStatusBuffer =
+	new RCS_STAT_CHANNEL(emcFormat, "emcStatus", "emc", emc_nmlfile);
+    return emcStatusBuffer->valid() ? 0 : -1;
+}
+
+static int startupErrorBuffer()
+{
+    delete emcErrorBuffer;
+    emcErrorBuffer = new NML(nmlErrorFormat, "emcError", "emc", emc_nmlfile);
+    return emcErrorBuffer->valid() ? 0 : -1;
+}
+
+static int startupIoUpdate() { return emcIoUpdate(&emcStatus->io); }
+static int startupMotionUpdate() { return emcMotionUpdate(&emcStatus->motion); }
+
+static struct startup_step {
+    const char *what;		// for the timeline
+    const char *error;		// if it never comes up
+    int (*attempt)();		// returns 0 once it is up
+    int after;			// step that must be up first, or -1;
+				// IO and motion report through emcError
+    double up;			// seconds into startup it came up, or -1
+    int tries;
+} startup_steps[] = {
+    { "emcCommand buffer", "can't get emcCommand buffer",
+      startupCommandBuffer, -1 },
+    { "emcStatus buffer", "can't get emcStatus buffer",
+      startupStatusBuffer, -1 },
+    { "emcError buffer", "can't get emcError buffer",
+      startupErrorBuffer, -1 },
+    { "IO", "can't initialize IO", emcIoInit, 2 },
+    { "IO status", "can't read IO status", startupIoUpdate, 3 },
+    { "motion", "can't initialize motion", emcMotionInit, 2 },
+    { "motion status", "can't read motion status", startupMotionUpdate, 5 },
+};
+#define STARTUP_STEPS (int) (sizeof(startup_steps) / sizeof(startup_steps[0]))
+
+// with EMC_DEBUG_CONFIG, or when a step never came up, print when each
+// one did, so a slow boot can be traced to the peer it waited for
+static void startup_timeline(double interp, double total)
+{
+    int n;
+
+    rcs_print("task startup:\n");
+    for (n = 0; n < STARTUP_STEPS; n++) {
+	struct startup_step *step = &startup_steps[n];
+	if (step->up < 0.0) {
+	    rcs_print("  %-18s not up after %d tries\n", step->what,
+		step->tries);
+	} else {
+	    rcs_print("  %-18s %7.3f s, %d tries\n", step->what, step->up,
+		step->tries);
 	}
-    } while (end > 0.0);
-    set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
-    // messages
-    if (!good) {
-	rcs_print_error("can't get emcStatus buffer\n");
-	return -1;
     }
-
-    if (!(emc_debug & EMC_DEBUG_NML)) {
-	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
-	// messages
+    if (interp >= 0.0) {
+	rcs_print("  %-18s %7.3f s\n", "interpreter", interp);
     }
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (NULL != emcErrorBuffer) {
-	    delete emcErrorBuffer;
-	}
-	emcErrorBuffer =
-	    new NML(nmlErrorFormat, "emcError", "emc", emc_nmlfile);
-	if (emcErrorBuffer->valid()) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
-	}
-    } while (end > 0.0);
-    set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
-    // messages
-    if (!good) {
-	rcs_print_error("can't get emcError buffer\n");
-	return -1;
+    if (total >= 0.0) {
+	rcs_print("  %-18s %7.3f s\n", "task", total);
     }
+}
+
+static int emctask_startup()
+{
+    double start = etime(), interval = RETRY_FIRST, interp;
+    int n, left;
+
+    // moved up so it can be exposed in taskmodule at init time
+    // // get our status data structure
+    // emcStatus = new EMC_STAT;
+
     // get the timer
     if (!emcTaskNoDelay) {
-	timer = new RCS_TIMER(emc_task_cycle_time, "", "");
+	if (task_wake_poll > 0.0) {
+	    timer = new RCS_TIMER(emc_task_cycle_time, emcTaskWait);
+	} else {
+	    timer = new RCS_TIMER(emc_task_cycle_time, "", "");
+	}
+    }
+    if (task_rt_priority > 0) {
+	struct sched_param param;
+	int max = sched_get_priority_max(SCHED_FIFO);
+	param.sched_priority = task_rt_priority > max ? max : task_rt_priority;
+	if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+	    // a hint only: without the privilege task runs as before
+	    rcs_print("can't set SCHED_FIFO priority %d for task: %s\n",
+		      param.sched_priority, strerror(errno));
+	}
     }
-    // initialize the subsystems
-
-    // IO first
 
+    // the NML buffers, IO and motion, all at once
     if (!(emc_debug & EMC_DEBUG_NML)) {
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
 	// messages
     }
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (0 == emcIoInit()) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
-	}
-    } while (end > 0.0);
-    set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
-    // messages
-    if (!good) {
-	rcs_print_error("can't initialize IO\n");
-	return -1;
+    for (n = 0; n < STARTUP_STEPS; n++) {
+	startup_steps[n].up = -1.0;
+	startup_steps[n].tries = 0;
     }
-
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (0 == emcIoUpdate(&emcStatus->io)) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
+    left = STARTUP_STEPS;
+    while (1) {
+	for (n = 0; n < STARTUP_STEPS; n++) {
+	    struct startup_step *step = &startup_steps[n];
+	    if (step->up >= 0.0 ||
+		(step->after >= 0 && startup_steps[step->after].up < 0.0)) {
+		continue;
+	    }
+	    step->tries++;
+	    if (0 == step->attempt()) {
+		step->up = etime() - start;
+		left--;
+	    }
 	}
-    } while (end > 0.0);
-    if (!good) {
-	rcs_print_error("can't read IO status\n");
-	return -1;
-    }
-
-
-    // now motion
-
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (0 == emcMotionInit()) {
-	    good = 1;
+	if (left == 0 || etime() - start >= RETRY_TIME) {
 	    break;
 	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
+	esleep(interval);
+	interval = interval * 2 > RETRY_INTERVAL ? RETRY_INTERVAL : interval * 2;
 	if (done) {
 	    emctask_shutdown();
 	    exit(1);
 	}
-    } while (end > 0.0);
-    if (!good) {
-	rcs_print_error("can't initialize motion\n");
-	return -1;
     }
-
-    end = RETRY_TIME;
-    good = 0;
-    do {
-	if (0 == emcMotionUpdate(&emcStatus->motion)) {
-	    good = 1;
-	    break;
-	}
-	esleep(RETRY_INTERVAL);
-	end -= RETRY_INTERVAL;
-	if (done) {
-	    emctask_shutdown();
-	    exit(1);
+    set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
+    // messages
+    if (left) {
+	for (n = 0; n < STARTUP_STEPS; n++) {
+	    if (startup_steps[n].up < 0.0) {
+		rcs_print_error("%s\n", startup_steps[n].error);
+	    }
 	}
-    } while (end > 0.0);
-    if (!good) {
-	rcs_print_error("can't read motion status\n");
+	startup_timeline(-1.0, -1.0);
 	return -1;
     }
+
     // now the interpreter
 
     if (0 != emcTaskPlanInit()) {
 	rcs_print_error("can't initialize interpreter\n");
 	return -1;
     }
+    interp = etime() - start;
 
     if (done ) {
 	emctask_shutdown();
@@ -3058,12 +3831,16 @@ static int emctask_startup()
     }
     emcTaskUpdate(&emcStatus->task);
 
+    if (emc_debug & EMC_DEBUG_CONFIG) {
+	startup_timeline(interp, etime() - start);
+    }
     return 0;
 }
 
 // called to deallocate resources
 static int emctask_shutdown(void)
 {
+    emcTaskInterpStop();
     // shut down the subsystems
     if (0 != emcStatus) {
 	emcTaskHalt();
@@ -3071,6 +3848,7 @@ static int emctask_shutdown(void)
 	emcMotionHalt();
 	emcIoHalt();
     }
+    launcherStop();
     // delete the timer
     if (0 != timer) {
 	delete timer;
@@ -3202,6 +3980,66 @@ static int iniLoad(const char *filename)
 		  filename, emc_task_cycle_time);
     }
 
+    if (NULL != (inistring = inifile.Find("WAKE_POLL", "TASK"))) {
+	if (1 != sscanf(inistring, "%lf", &task_wake_poll) ||
+	    task_wake_poll < 0.0) {
+	    task_wake_poll = 0.0;
+	    rcs_print("invalid [TASK] WAKE_POLL in %s (%s); not using it\n",
+		      filename, inistring);
+	}
+    }
+
+    if (NULL != (inistring = inifile.Find("RT_PRIORITY", "TASK"))) {
+	if (1 != sscanf(inistring, "%d", &task_rt_priority) ||
+	    task_rt_priority < 0) {
+	    task_rt_priority = 0;
+	    rcs_print("invalid [TASK] RT_PRIORITY in %s (%s); not using it\n",
+		      filename, inistring);
+	}
+    }
+
+    if (NULL != (inistring = inifile.Find("ASYNC_PRINT", "TASK"))) {
+	int async_print = 0;
+	if (1 != sscanf(inistring, "%d", &async_print)) {
+	    rcs_print("invalid [TASK] ASYNC_PRINT in %s (%s); not using it\n",
+		      filename, inistring);
+	} else if (async_print && 0 != set_rcs_print_async(1)) {
+	    rcs_print("task: can't start the print thread; printing directly\n");
+	}
+    }
+
+    if (NULL != (inistring = inifile.Find("READAHEAD_TIME", "TASK"))) {
+	if (1 != sscanf(inistring, "%lf", &readahead_time) ||
+	    readahead_time < 0.0) {
+	    readahead_time = 0.0;
+	    rcs_print("invalid [TASK] READAHEAD_TIME in %s (%s); not using it\n",
+		      filename, inistring);
+	}
+    }
+    // by default spend at most half a cycle reading
+    readahead_budget = emc_task_cycle_time > 0.0 ?
+	emc_task_cycle_time / 2 : 0.001;
+    if (NULL != (inistring = inifile.Find("READAHEAD_BUDGET", "TASK"))) {
+	if (1 != sscanf(inistring, "%lf", &readahead_budget) ||
+	    readahead_budget <= 0.0) {
+	    readahead_budget = emc_task_cycle_time > 0.0 ?
+		emc_task_cycle_time / 2 : 0.001;
+	    rcs_print("invalid [TASK] READAHEAD_BUDGET in %s (%s); using %f\n",
+		      filename, inistring, readahead_budget);
+	}
+    }
+
+
+    inifile.Find(&move_batch, "MOVE_BATCH", "TASK");
+    inifile.Find(&interp_thread, "INTERP_THREAD", "TASK");
+
+    if (NULL != (inistring = inifile.Find("SYSTEM_CMD_LAUNCHER", "TASK"))) {
+	if (1 != sscanf(inistring, "%d", &system_cmd_launcher)) {
+	    system_cmd_launcher = 0;
+	    rcs_print("invalid [TASK] SYSTEM_CMD_LAUNCHER in %s (%s); not using it\n",
+		      filename, inistring);
+	}
+    }
 
     if (NULL != (inistring = inifile.Find("NO_FORCE_HOMING", "TRAJ"))) {
 	if (1 == sscanf(inistring, "%d", &no_force_homing)) {
@@ -3238,6 +4076,46 @@ static int iniLoad(const char *filename)
     return 0;
 }
 
+/*
+  emcStatusCheckBlock() bumps the change counter of a sub-block of
+  emcStatus if its bytes differ from the ones written last time
+  */
+static void emcStatusCheckBlock(int block, const void *begin, const void *end)
+{
+    static std::vector<char> last[EMC_STAT_BLOCKS];
+    std::vector<char> &prev = last[block];
+    size_t len = (const char *) end - (const char *) begin;
+
+    if (prev.size() == len && 0 == memcmp(&prev[0], begin, len)) {
+	return;
+    }
+    prev.assign((const char *) begin, (const char *) end);
+    emcStatus->block_serial[block]++;
+}
+
+/*
+  emcStatusCountChanges() updates the change counters of emcStatus
+  before it gets written out, see EMC_STAT_BLOCK
+  */
+static void emcStatusCountChanges(void)
+{
+    unsigned long int heartbeat = emcStatus->task.heartbeat;
+
+    // the heartbeat changes every cycle and doesn't count
+    emcStatus->task.heartbeat = 0;
+    emcStatusCheckBlock(EMC_STAT_TASK, &emcStatus->task, &emcStatus->task + 1);
+    emcStatus->task.heartbeat = heartbeat;
+
+    emcStatusCheckBlock(EMC_STAT_TRAJ, &emcStatus->motion.traj,
+			&emcStatus->motion.traj + 1);
+    emcStatusCheckBlock(EMC_STAT_JOINTS, &emcStatus->motion.joint[0],
+			&emcStatus->motion.axis[EMCMOT_MAX_AXIS]);
+    emcStatusCheckBlock(EMC_STAT_IO, &emcStatus->io.coolant,
+			&emcStatus->io.lube + 1);
+    emcStatusCheckBlock(EMC_STAT_TOOL, &emcStatus->io.tool,
+			&emcStatus->io.tool + 1);
+}
+
 /*
   syntax: a.out {-d -ini <inifile>} {-nml <nmlfile>} {-shm <key>}
   */
@@ -3247,6 +4125,7 @@ int main(int argc, char *argv[])
     int taskExecuteError = 0;
     double startTime, endTime, deltaTime;
     double minTime, maxTime;
+    double phaseStart;
     bindtextdomain("linuxcnc", EMC2_PO_DIR);
     setlocale(LC_MESSAGES,"");
     setlocale(LC_CTYPE,"");
@@ -3295,6 +4174,11 @@ int main(int argc, char *argv[])
 	exit(1);
     }
 
+    // fork the system command launcher while task is still small
+    if (system_cmd_launcher && 0 != launcherStart()) {
+	rcs_print("can't start system command launcher; forking task for each command\n");
+    }
+
     // get our status data structure
     // moved up from emc_startup so we can expose it in Python right away
     emcStatus = new EMC_STAT;
@@ -3324,6 +4208,9 @@ int main(int argc, char *argv[])
 
     // cause the interpreter's starting offset to be reflected
     emcTaskPlanInit();
+    if (interp_thread && 0 != emcTaskInterpStart()) {
+	rcs_print("can't start interpreter thread; interpreting in task\n");
+    }
     // reflect the initial value of EMC_DEBUG in emcStatus->debug
     emcStatus->debug = emc_debug;
 
@@ -3333,19 +4220,55 @@ int main(int argc, char *argv[])
     maxTime = 0.0;		// set to value that can never be underset
 
     while (!done) {
-	// read command
-	if (0 != emcCommandBuffer->peek()) {
-	    // got a new command, so clear out errors
-	    taskPlanError = 0;
-	    taskExecuteError = 0;
-	}
-	// run control cycle
-	if (0 != emcTaskPlan()) {
-	    taskPlanError = 1;
+	if (emcTaskInterpBusy()) {
+	    // the interpreter thread has the plan; a new command waits in
+	    // emcCommand for it to finish the line it is on
+	    if (emcTaskCommandWaiting()) {
+		interp_yield = 1;
+	    }
+	} else {
+	    command_count = emcCommandBuffer->get_msg_count();
+	    // read command; read rather than peek, so that a queued
+	    // emcCommand moves on to the next one
+	    if (0 != emcCommandBuffer->read()) {
+		// got a new command, so clear out errors
+		taskPlanError = 0;
+		taskExecuteError = 0;
+		emcTaskEcho(emcCommand->serial_number);
+	    }
+	    if (emcCommand->serial_number != emcStatus->echo_serial_number &&
+		emcCommand->type != EMC_NULL_TYPE) {
+		// time it until task is done with it
+		latency_type = emcCommand->type;
+		latency_start = etime();
+	    }
+	    // run control cycle
+	    phaseStart = etime();
+	    if (0 != emcTaskPlan()) {
+		taskPlanError = 1;
+	    }
+	    // settings that are waiting behind it in a queued emcCommand
+	    // needn't wait a cycle each
+	    for (int n = 1; n < TASK_COMMANDS_PER_CYCLE &&
+		     emcTaskSettingCommand(emcCommand->type) &&
+		     emcCommandBuffer->get_queue_length() > 0; n++) {
+		emcStatus->task.echo_serial_number = emcCommand->serial_number;
+		emcStatus->echo_serial_number = emcCommand->serial_number;
+		if (0 == emcCommandBuffer->read()) {
+		    break;
+		}
+		emcTaskEcho(emcCommand->serial_number);
+		if (0 != emcTaskPlan()) {
+		    taskPlanError = 1;
+		}
+	    }
+	    emcTaskPhaseTime(EMC_TASK_PHASE_PLAN, phaseStart);
 	}
+	phaseStart = etime();
 	if (0 != emcTaskExecute()) {
 	    taskExecuteError = 1;
 	}
+	emcTaskPhaseTime(EMC_TASK_PHASE_EXECUTE, phaseStart);
 	checkPlanSyncReq();
 	// update subordinate status
 
@@ -3354,6 +4277,7 @@ int main(int argc, char *argv[])
 	// synchronize subordinate states
 	if (emcStatus->io.aux.estop) {
 	    if (emcStatus->motion.traj.enabled) {
+		emcTaskInterpWait();
 		emcTrajDisable();
 		emcTaskAbort();
                 emcIoAbort(EMC_ABORT_AUX_ESTOP);
@@ -3424,6 +4348,7 @@ int main(int argc, char *argv[])
 	    // }
 
         // abort everything
+        emcTaskInterpWait();
         emcTaskAbort();
         emcIoAbort(EMC_ABORT_MOTION_OR_IO_RCS_ERROR);
         emcSpindleAbort();
@@ -3489,11 +4414,21 @@ int main(int argc, char *argv[])
 	    emcStatus->status = RCS_EXEC;
 	    emcStatus->task.status = RCS_EXEC;
 	}
+	if (latency_type != 0 && emcStatus->status != RCS_EXEC) {
+	    emcTaskLatencyDone();
+	}
 
 	// write it
 	// since emcStatus was passed to the WM init functions, it
 	// will be updated in the _update() functions above. There's
 	// no need to call the individual functions on all WM items.
+	if (timer) {
+	    emcStatus->task.cycleOverruns = timer->overruns();
+	    emcStatus->task.cycleJitter = timer->jitter();
+	    emcStatus->task.cycleJitterMean = timer->mean_jitter();
+	    emcStatus->task.cycleLoad = timer->load();
+	}
+	emcStatusCountChanges();
 	emcStatusBuffer->write(emcStatus);
 
 	// wait on timer cycle, if specified, or calculate actual
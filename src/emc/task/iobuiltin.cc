@@ -0,0 +1,655 @@
+/********************************************************************
+* Description: iobuiltin.cc
+*   iocontrol-v2 inside task
+*
+*   The tool changer, coolant, lube and estop handling of
+*   ioControl_v2.cc, as Task methods. The handshakes with HAL are the
+*   same; what goes away is the iocontrol process, the toolCmd/toolSts
+*   NML channels, and the wait for iocontrol's next cycle on every
+*   command.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hal.h"		// HAL pins
+#include "rcs_print.hh"
+#include "timer.hh"		// etime()
+#include "emc.hh"		// EMC NML
+#include "emc_nml.hh"
+#include "emcglb.h"		// tool_table_file
+#include "inifile.hh"
+#include "initool.hh"		// iniTool()
+#include "tool_parse.h"		// loadToolTable(), saveToolTable()
+
+#include "iobuiltin.hh"
+
+typedef enum {
+    V1 = 1,
+    V2 = 2
+} version_t;
+
+// extend  EMC_IO_ABORT_REASON_ENUM from emc.hh
+enum {
+    EMC_ABORT_BY_TOOLCHANGER_FAULT = EMC_ABORT_USER + 1
+};
+
+// read_inputs() returns a mask of changes observed
+enum {
+    TI_PREPARING = 1,
+    TI_PREPARE_COMPLETE = 2,
+    TI_CHANGING = 4,
+    TI_CHANGE_COMPLETE = 8,
+    TI_TC_FAULT = 16,
+    TI_TC_ABORT = 32,
+    TI_EMC_ABORT_SIGNALED = 64,
+    TI_EMC_ABORT_ACKED = 128,
+    TI_START_CHANGE = 1024,
+    TI_START_CHANGE_ACKED = 2048
+};
+
+// iocontrol states. Reflected in state pin
+typedef  enum {
+    ST_IDLE = 0,
+    ST_PREPARING = 1,
+    ST_START_CHANGE = 2, // V2 only
+    ST_CHANGING = 3,
+    ST_WAIT_FOR_ABORT_ACK = 4, // V2 only
+} iostate_t;
+
+// see ioControl_v2.cc for what each of these does
+struct iocontrol_pins {
+    hal_bit_t *user_enable_out;
+    hal_bit_t *emc_enable_in;
+    hal_bit_t *user_request_enable;
+    hal_bit_t *coolant_mist;
+    hal_bit_t *coolant_flood;
+    hal_bit_t *lube;
+    hal_bit_t *lube_level;
+
+    hal_bit_t *tool_prepare;
+    hal_s32_t *tool_prep_pocket;
+    hal_s32_t *tool_prep_number;
+    hal_s32_t *tool_number;
+    hal_bit_t *tool_prepared;
+    hal_bit_t *tool_change;
+    hal_bit_t *tool_changed;
+
+    // v2 protocol
+    hal_bit_t *emc_abort;
+    hal_bit_t *emc_abort_ack;
+    hal_s32_t *emc_reason;
+    hal_bit_t *toolchanger_fault;
+    hal_bit_t *toolchanger_fault_ack;
+    hal_s32_t *toolchanger_reason;
+    hal_bit_t *start_change;
+    hal_bit_t *start_change_ack;
+    hal_bit_t *toolchanger_faulted;
+    hal_bit_t *toolchanger_clear_fault;
+
+    hal_s32_t *state;
+};
+
+bool IoBuiltin::wanted(const char *inifile)
+{
+    IniFile ini;
+    int builtin = 0;
+
+    if (!ini.Open(inifile)) {
+	return false;
+    }
+    ini.Find(&builtin, "BUILTIN_IO", "TASK");
+    if (builtin && (ini.Find("EMCIO", "EMCIO") != NULL ||
+		    ini.Find("IO", "IO") != NULL)) {
+	rcs_print("[TASK]BUILTIN_IO set, but the ini file names an io program; using that\n");
+	builtin = 0;
+    }
+    return builtin != 0;
+}
+
+IoBuiltin::IoBuiltin() : Task(), pins(0), comp_id(0), proto(V2),
+			 support_start_change(0), toolchanger_reason(0),
+			 io_cycle_time(0.100), request_enable_until(0.0)
+{
+    IniFile inifile;
+
+    if (inifile.Open(ini_filename)) {
+	inifile.Find(&proto, "PROTOCOL_VERSION", "EMCIO");
+	inifile.Find(&support_start_change, "SUPPORT_START_CHANGE", "EMCIO");
+	inifile.Find(&io_cycle_time, "CYCLE_TIME", "EMCIO");
+    }
+
+    // task's status is allocated before the Task methods, and
+    // is what we update directly, the same way Python Task methods do
+    io = &emcStatus->io;
+    io->aux.estop = 1;
+    io->tool.pocketPrepped = -1;
+    io->tool.toolInSpindle = 0;
+    io->coolant.mist = 0;
+    io->coolant.flood = 0;
+    io->lube.on = 0;
+    io->lube.level = 1;
+    io->status = RCS_DONE;
+
+    if (0 != hal_init_component()) {
+	rcs_print_error("can't create iocontrol HAL component in task\n");
+	return;
+    }
+    hal_init_pins();
+}
+
+IoBuiltin::~IoBuiltin()
+{
+    if (comp_id > 0) {
+	hal_exit(comp_id);
+    }
+}
+
+#define BITPIN(dir,fmt,ptr)						\
+    if ((retval = hal_pin_bit_newf(dir,ptr,comp_id, fmt,n)) < 0) {	\
+	rcs_print_error("iocontrol: " fmt " export failed error=%d\n",n,retval); \
+	goto HAL_EXIT;							\
+    }
+#define S32PIN(dir,fmt,ptr)						\
+    if ((retval = hal_pin_s32_newf(dir,ptr,comp_id, fmt,n)) < 0) {	\
+	rcs_print_error("iocontrol: " fmt " export failed error=%d\n",n,retval); \
+	goto HAL_EXIT;							\
+    }
+
+// same pins as iocontrol-v2, so existing HAL files work unchanged. As
+// with a Python Task, they only exist once task is up, so they have to
+// be connected from a POSTTASK_HALFILE
+int IoBuiltin::hal_init_component()
+{
+    int n = 0;
+    int retval = -1;
+
+    if ((comp_id = hal_init("iocontrol")) < 0) {
+	rcs_print_error("iocontrol: hal_init() failed - error=%d\n", comp_id);
+	comp_id = 0;
+	return -1;
+    }
+
+    if ((pins = (iocontrol_pins *) hal_malloc(sizeof(iocontrol_pins))) == NULL) {
+	rcs_print_error("iocontrol: hal_malloc() failed\n");
+	goto HAL_EXIT;
+    }
+    memset(pins, 0, sizeof(iocontrol_pins));
+
+    BITPIN( HAL_OUT, "iocontrol.%d.user-enable-out", &(pins->user_enable_out));
+    BITPIN( HAL_OUT, "iocontrol.%d.user-request-enable", &(pins->user_request_enable));
+    BITPIN( HAL_OUT, "iocontrol.%d.coolant-flood", &(pins->coolant_flood));
+    BITPIN( HAL_OUT, "iocontrol.%d.coolant-mist", &(pins->coolant_mist));
+    BITPIN( HAL_OUT, "iocontrol.%d.lube", &(pins->lube));
+    S32PIN( HAL_OUT, "iocontrol.%d.tool-number", &(pins->tool_number));
+    S32PIN( HAL_OUT, "iocontrol.%d.tool-prep-number", &(pins->tool_prep_number));
+    S32PIN( HAL_OUT, "iocontrol.%d.tool-prep-pocket", &(pins->tool_prep_pocket));
+    BITPIN( HAL_OUT, "iocontrol.%d.tool-prepare", &(pins->tool_prepare));
+    BITPIN( HAL_IN , "iocontrol.%d.tool-prepared", &(pins->tool_prepared));
+    BITPIN( HAL_OUT, "iocontrol.%d.tool-change", &(pins->tool_change));
+    BITPIN( HAL_IN , "iocontrol.%d.tool-changed", &(pins->tool_changed));
+    BITPIN( HAL_IN , "iocontrol.%d.emc-enable-in", &(pins->emc_enable_in));
+    BITPIN( HAL_IN , "iocontrol.%d.lube_level", &(pins->lube_level));
+
+    S32PIN( HAL_OUT, "iocontrol.%d.state", &(pins->state));
+
+    if (proto > V1) {
+	BITPIN( HAL_OUT, "iocontrol.%d.emc-abort", &(pins->emc_abort));
+	BITPIN( HAL_IN , "iocontrol.%d.emc-abort-ack", &(pins->emc_abort_ack));
+	S32PIN( HAL_OUT, "iocontrol.%d.emc-reason", &(pins->emc_reason));
+	BITPIN( HAL_IN , "iocontrol.%d.toolchanger-fault", &(pins->toolchanger_fault));
+	BITPIN( HAL_OUT, "iocontrol.%d.toolchanger-fault-ack", &(pins->toolchanger_fault_ack));
+	S32PIN( HAL_IN , "iocontrol.%d.toolchanger-reason", &(pins->toolchanger_reason));
+	BITPIN( HAL_OUT, "iocontrol.%d.toolchanger-faulted", &(pins->toolchanger_faulted));
+	BITPIN( HAL_IN , "iocontrol.%d.toolchanger-clear-fault", &(pins->toolchanger_clear_fault));
+	BITPIN( HAL_OUT, "iocontrol.%d.start-change", &(pins->start_change));
+	BITPIN( HAL_IN , "iocontrol.%d.start-change-ack", &(pins->start_change_ack));
+    }
+    hal_ready(comp_id);
+    return 0;
+
+HAL_EXIT:
+    hal_exit(comp_id);
+    comp_id = 0;
+    pins = 0;
+    return retval;
+}
+
+void IoBuiltin::hal_init_pins()
+{
+    *(pins->user_enable_out) = 0;
+    *(pins->user_request_enable) = 0;
+    *(pins->coolant_mist) = 0;
+    *(pins->coolant_flood) = 0;
+    *(pins->lube) = 0;
+    *(pins->tool_prepare) = 0;
+    *(pins->tool_prep_number) = 0;
+    *(pins->tool_prep_pocket) = 0;
+    *(pins->tool_change) = 0;
+
+    *(pins->state) = ST_IDLE;
+
+    if (proto > V1) {
+	*(pins->emc_abort) = 0;
+	*(pins->emc_reason) = 0;
+	*(pins->toolchanger_fault_ack) = 0;
+	*(pins->toolchanger_faulted) = 0;
+	*(pins->start_change) = 0;
+    }
+}
+
+int IoBuiltin::faulted()
+{
+    return (proto > V1) && *(pins->toolchanger_faulted);
+}
+
+// ioControl_v2.cc's read_inputs(), less the estop and lube level change
+// reports: io is task's own status here, so there's nothing to push
+int IoBuiltin::read_inputs()
+{
+    int retval = 0;
+
+    io->aux.estop = *(pins->emc_enable_in) == 0;
+    io->lube.level = *(pins->lube_level);
+
+    if (proto > V1) {
+	// record toolchanger fault
+	if (*pins->toolchanger_fault) {
+	    toolchanger_reason = *pins->toolchanger_reason;
+	    *(pins->toolchanger_fault_ack) = 1;
+	    *(pins->toolchanger_faulted) = 1;
+	    retval |= TI_TC_FAULT;
+	} else {
+	    *(pins->toolchanger_fault_ack) = 0;
+	}
+
+	// clear toolchanger fault condition if so signaled,
+	if (*pins->toolchanger_clear_fault) {
+	    *(pins->toolchanger_faulted) = 0;
+	    toolchanger_reason = 0;
+	    retval &= ~TI_TC_FAULT;
+	}
+
+	// an EMC-side abort is in progress.
+	if (*pins->emc_abort) {
+	    if (*pins->emc_abort_ack) {
+		*(pins->emc_abort) = 0;
+		*(pins->state) = ST_IDLE;
+		retval |= TI_EMC_ABORT_ACKED;
+	    } else {
+		retval |= TI_EMC_ABORT_SIGNALED;
+	    }
+	}
+	// the very start of an M6 operation was signaled
+	if (*pins->start_change) {
+	    if (*pins->start_change_ack) {
+		*(pins->start_change) = 0;
+		retval |= TI_START_CHANGE_ACKED;
+	    } else {
+		retval |= TI_START_CHANGE;
+	    }
+	}
+    }
+
+    if (*pins->tool_prepare) {
+	if (*pins->tool_prepared) {
+	    io->tool.pocketPrepped = *(pins->tool_prep_pocket);
+	    *(pins->tool_prepare) = 0;
+	    *(pins->state) = ST_IDLE;
+	    retval |= TI_PREPARE_COMPLETE;
+	} else {
+	    *(pins->state) = ST_PREPARING;
+	    retval |= TI_PREPARING;
+	}
+    }
+
+    if (*pins->tool_change) {
+	// check wether a toolchanger fault will force an abort of this change
+	if (faulted()) {
+	    toolchanger_reason = *pins->toolchanger_reason;
+	    *(pins->emc_reason) = EMC_ABORT_BY_TOOLCHANGER_FAULT;
+	    *(pins->emc_abort) = 1;
+	    retval |= TI_TC_ABORT;
+	    *(pins->tool_change) = 0;
+	    *(pins->state) = ST_WAIT_FOR_ABORT_ACK;
+	}
+
+	if (*pins->tool_changed) {
+	    // good to commit this change
+	    if (!random_toolchanger && io->tool.pocketPrepped == 0) {
+		io->tool.toolInSpindle = 0;
+	    } else {
+		io->tool.toolInSpindle = io->tool.toolTable[io->tool.pocketPrepped].toolno;
+	    }
+	    *(pins->tool_number) = io->tool.toolInSpindle;
+	    load_tool(io->tool.pocketPrepped);
+	    io->tool.pocketPrepped = -1;
+	    *(pins->tool_prep_number) = 0;
+	    *(pins->tool_prep_pocket) = 0;
+	    *(pins->tool_change) = 0;
+	    *(pins->state) = ST_IDLE;
+	    retval |= TI_CHANGE_COMPLETE;
+	} else {
+	    retval |= TI_CHANGING;
+	}
+    }
+    return retval;
+}
+
+int IoBuiltin::save_tool_table()
+{
+    return saveToolTable(tool_table_file, io->tool.toolTable, fms, ttcomments,
+			 random_toolchanger);
+}
+
+void IoBuiltin::load_tool(int pocket)
+{
+    if(random_toolchanger) {
+	// swap the tools between the desired pocket and the spindle pocket
+	CANON_TOOL_TABLE temp;
+	char *comment_temp;
+
+	temp = io->tool.toolTable[0];
+	io->tool.toolTable[0] = io->tool.toolTable[pocket];
+	io->tool.toolTable[pocket] = temp;
+
+	comment_temp = ttcomments[0];
+	ttcomments[0] = ttcomments[pocket];
+	ttcomments[pocket] = comment_temp;
+
+	if (0 != save_tool_table())
+	    io->status = RCS_ERROR;
+    } else if (pocket == 0) {
+	// magic T0 = pocket 0 = no tool
+	io->tool.toolTable[0].toolno = -1;
+	ZERO_EMC_POSE(io->tool.toolTable[0].offset);
+	io->tool.toolTable[0].diameter = 0.0;
+	io->tool.toolTable[0].frontangle = 0.0;
+	io->tool.toolTable[0].backangle = 0.0;
+	io->tool.toolTable[0].orientation = 0;
+    } else {
+	// just copy the desired tool to the spindle
+	io->tool.toolTable[0] = io->tool.toolTable[pocket];
+    }
+}
+
+void IoBuiltin::reload_tool_number(int toolno)
+{
+    if(random_toolchanger) return; // doesn't need special handling here
+    for(int i=1; i<CANON_POCKETS_MAX; i++) {
+	if(io->tool.toolTable[i].toolno == toolno) {
+	    load_tool(i);
+	    break;
+	}
+    }
+}
+
+// Commands. Each one leaves io->status RCS_DONE, or RCS_EXEC while a
+// handshake is going on, which emcIoUpdate() then follows every cycle
+
+int IoBuiltin::emcIoInit()
+{
+    if (!valid()) {
+	return -1;
+    }
+    if (0 != iniTool(emc_inifile)) {
+	return -1;
+    }
+    io->status = RCS_DONE;
+    loadToolTable(tool_table_file, io->tool.toolTable,
+		  fms, ttcomments, random_toolchanger);
+    reload_tool_number(io->tool.toolInSpindle);
+    return 0;
+}
+
+int IoBuiltin::emcIoHalt()
+{
+    if (comp_id > 0) {
+	hal_exit(comp_id);
+	comp_id = 0;
+    }
+    return 0;
+}
+
+int IoBuiltin::emcIoAbort(int reason)
+{
+    io->status = RCS_DONE;
+    io->coolant.mist = 0;
+    io->coolant.flood = 0;
+    *(pins->coolant_mist) = 0;
+    *(pins->coolant_flood) = 0;
+
+    if (proto > V1) {
+	// assert emc-abort before deasserting tool-change and tool-prepare
+	*(pins->emc_reason) = reason;
+	*(pins->emc_abort) = 1;
+	*(pins->start_change) = 0;
+    }
+    *(pins->tool_change) = 0;
+    *(pins->tool_prepare) = 0;
+    *(pins->state) = (proto > V1) ? ST_WAIT_FOR_ABORT_ACK : ST_IDLE;
+
+    // call abort o-word sub handler if defined
+    emcAbortCleanup(reason);
+
+    return 0;
+}
+
+int IoBuiltin::emcIoSetDebug(int debug)
+{
+    // emc_debug is task's own here
+    io->status = RCS_DONE;
+    return 0;
+}
+
+int IoBuiltin::emcAuxEstopOn()
+{
+    io->status = RCS_DONE;
+    *(pins->user_enable_out) = 0;
+    hal_init_pins();
+    return 0;
+}
+
+int IoBuiltin::emcAuxEstopOff()
+{
+    io->status = RCS_DONE;
+    *(pins->user_enable_out) = 1;
+    // rising edge to reset an optional HAL latch, held for as long as
+    // iocontrol would have held it
+    *(pins->user_request_enable) = 1;
+    request_enable_until = etime() + io_cycle_time;
+    return 0;
+}
+
+int IoBuiltin::emcCoolantMistOn()
+{
+    io->status = RCS_DONE;
+    io->coolant.mist = 1;
+    *(pins->coolant_mist) = 1;
+    return 0;
+}
+
+int IoBuiltin::emcCoolantMistOff()
+{
+    io->status = RCS_DONE;
+    io->coolant.mist = 0;
+    *(pins->coolant_mist) = 0;
+    return 0;
+}
+
+int IoBuiltin::emcCoolantFloodOn()
+{
+    io->status = RCS_DONE;
+    io->coolant.flood = 1;
+    *(pins->coolant_flood) = 1;
+    return 0;
+}
+
+int IoBuiltin::emcCoolantFloodOff()
+{
+    io->status = RCS_DONE;
+    io->coolant.flood = 0;
+    *(pins->coolant_flood) = 0;
+    return 0;
+}
+
+int IoBuiltin::emcLubeOn()
+{
+    io->status = RCS_DONE;
+    io->lube.on = 1;
+    *(pins->lube) = 1;
+    return 0;
+}
+
+int IoBuiltin::emcLubeOff()
+{
+    io->status = RCS_DONE;
+    io->lube.on = 0;
+    *(pins->lube) = 0;
+    return 0;
+}
+
+int IoBuiltin::emcToolPrepare(int p, int tool)
+{
+    io->status = RCS_DONE;
+
+    // it doesn't make sense to prep the spindle pocket
+    if (random_toolchanger && p == 0)
+	return 0;
+
+    *(pins->tool_prep_pocket) = p;
+    if (!random_toolchanger && p == 0) {
+	*(pins->tool_prep_number) = 0;
+    } else {
+	*(pins->tool_prep_number) = io->tool.toolTable[p].toolno;
+    }
+
+    // then set the prepare pin to tell external logic to get started
+    *(pins->tool_prepare) = 1;
+    *(pins->state) = ST_PREPARING;
+    io->status = RCS_EXEC;
+    return 0;
+}
+
+int IoBuiltin::emcToolStartChange()
+{
+    io->status = RCS_DONE;
+    // only handle this if explicitly enabled - less backwards config breakage
+    if ((proto > V1) && support_start_change) {
+	*(pins->start_change) = 1;
+	*(pins->state) = ST_START_CHANGE;
+	io->status = RCS_EXEC;
+    }
+    return 0;
+}
+
+int IoBuiltin::emcToolLoad()
+{
+    io->status = RCS_DONE;
+
+    // it doesn't make sense to load a tool from the spindle pocket
+    if (random_toolchanger && io->tool.pocketPrepped == 0) {
+	return 0;
+    }
+
+    // it's not necessary to load the tool already in the spindle
+    if (!random_toolchanger && io->tool.pocketPrepped > 0 &&
+	io->tool.toolInSpindle == io->tool.toolTable[io->tool.pocketPrepped].toolno) {
+	return 0;
+    }
+
+    if (io->tool.pocketPrepped != -1) {
+	*(pins->tool_change) = 1;
+	*(pins->state) = ST_CHANGING;
+	io->status = RCS_EXEC;
+    }
+    return 0;
+}
+
+int IoBuiltin::emcToolUnload()
+{
+    io->status = RCS_DONE;
+    io->tool.toolInSpindle = 0;
+    return 0;
+}
+
+int IoBuiltin::emcToolLoadToolTable(const char *file)
+{
+    io->status = RCS_DONE;
+    if (!strlen(file)) file = tool_table_file;
+    if (0 != loadToolTable(file, io->tool.toolTable,
+			   fms, ttcomments, random_toolchanger))
+	io->status = RCS_ERROR;
+    else
+	reload_tool_number(io->tool.toolInSpindle);
+    return 0;
+}
+
+int IoBuiltin::emcToolSetOffset(int pocket, int toolno, EmcPose offset, double diameter,
+				double frontangle, double backangle, int orientation)
+{
+    io->status = RCS_DONE;
+    CANON_TOOL_TABLE was = io->tool.toolTable[pocket];
+    io->tool.toolTable[pocket].toolno = toolno;
+    io->tool.toolTable[pocket].offset = offset;
+    io->tool.toolTable[pocket].diameter = diameter;
+    io->tool.toolTable[pocket].frontangle = frontangle;
+    io->tool.toolTable[pocket].backangle = backangle;
+    io->tool.toolTable[pocket].orientation = orientation;
+
+    if (io->tool.toolInSpindle == toolno) {
+	io->tool.toolTable[0] = io->tool.toolTable[pocket];
+    }
+    // touching off again to the same values leaves the file be
+    if (toolTableEntryEqual(&was, &io->tool.toolTable[pocket]))
+	return 0;
+    if (0 != save_tool_table())
+	io->status = RCS_ERROR;
+    return 0;
+}
+
+int IoBuiltin::emcToolSetNumber(int number)
+{
+    // conveys the pocket number, not the tool number
+    io->status = RCS_DONE;
+    io->tool.toolInSpindle = io->tool.toolTable[number].toolno;
+    load_tool(number);
+    *(pins->tool_number) = io->tool.toolInSpindle;
+    return 0;
+}
+
+// Status: one pass of iocontrol-v2's main loop, minus the NML
+int IoBuiltin::emcIoUpdate(EMC_IO_STAT * stat)
+{
+    int input_status;
+
+    if (!valid()) {
+	return -1;
+    }
+
+    // clear reset line to allow for a later rising edge
+    if (*(pins->user_request_enable) && etime() >= request_enable_until) {
+	*(pins->user_request_enable) = 0;
+    }
+
+    input_status = read_inputs();
+
+    // always piggyback fault and reason
+    io->fault = faulted();
+    io->reason = toolchanger_reason;
+
+    if (input_status & TI_PREPARING) {
+	io->status = RCS_EXEC;
+    }
+    if (input_status & (TI_START_CHANGE|TI_CHANGING)) {
+	io->status = faulted() ? RCS_ERROR : RCS_EXEC;
+    }
+    if (input_status & (TI_PREPARE_COMPLETE|TI_CHANGE_COMPLETE|TI_START_CHANGE_ACKED)) {
+	io->status = RCS_DONE;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef IOBUILTIN_HH
+#define IOBUILTIN_HH
+
+#include "taskclass.hh"
+
+// In-process replacement for iocontrol-v2: exports the same iocontrol.0
+// HAL pins and runs the same handshakes, but is driven directly by task's
+// io methods instead of through the toolCmd/toolSts NML channels.
+// Used when [TASK]BUILTIN_IO is set and there is no [EMCIO]EMCIO program.
+class IoBuiltin : public Task {
+public:
+    IoBuiltin();
+    virtual ~IoBuiltin();
+
+    static bool wanted(const char *inifile);
+    bool valid() { return comp_id > 0; }
+
+    virtual int emcIoInit();
+    virtual int emcIoHalt();
+    virtual int emcIoAbort(int reason);
+    virtual int emcToolStartChange();
+    virtual int emcAuxEstopOn();
+    virtual int emcAuxEstopOff();
+    virtual int emcCoolantMistOn();
+    virtual int emcCoolantMistOff();
+    virtual int emcCoolantFloodOn();
+    virtual int emcCoolantFloodOff();
+    virtual int emcLubeOn();
+    virtual int emcLubeOff();
+    virtual int emcIoSetDebug(int debug);
+    virtual int emcToolSetOffset(int pocket, int toolno, EmcPose offset, double diameter,
+				 double frontangle, double backangle, int orientation);
+    virtual int emcToolPrepare(int p, int tool);
+    virtual int emcToolLoad();
+    virtual int emcToolLoadToolTable(const char *file);
+    virtual int emcToolUnload();
+    virtual int emcToolSetNumber(int number);
+    virtual int emcIoUpdate(EMC_IO_STAT * stat);
+
+private:
+    int hal_init_component();
+    void hal_init_pins();
+    int read_inputs();
+    int faulted();
+    void load_tool(int pocket);
+    void reload_tool_number(int toolno);
+    int save_tool_table();
+
+    struct iocontrol_pins *pins;
+    EMC_IO_STAT *io;
+    int comp_id;
+    int proto;
+    int support_start_change;
+    int toolchanger_reason;	// last fault reason read from toolchanger
+    double io_cycle_time;	// how long user-request-enable stays up
+    double request_enable_until;
+};
+
+#endif
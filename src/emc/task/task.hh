@@ -5,6 +5,8 @@ extern NMLmsg *emcTaskCommand;
 extern int stepping;
 extern int steppingWait;
 extern int emcTaskQueueCommand(NMLmsg *cmd);
+extern int emcTaskInterpBusy(void);
+extern void emcTaskInterpWait(void);
 extern int emcPluginCall(EMC_EXEC_PLUGIN_CALL *call_msg);
 extern int emcIoPluginCall(EMC_IO_PLUGIN_CALL *call_msg);
 extern int emcTaskOnce(const char *inifile);
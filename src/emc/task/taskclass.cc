@@ -35,6 +35,7 @@
 
 #include "python_plugin.hh"
 #include "taskclass.hh"
+#include "iobuiltin.hh"
 
 // Python plugin interface
 #define TASK_MODULE "task"
@@ -291,6 +292,16 @@ int emcToolSetOffset(int pocket, int toolno, EmcPose offset, double diameter,
 					   frontangle,  backangle,  orientation); }
 int emcToolSetNumber(int number) { return task_methods->emcToolSetNumber(number); }
 int emcIoUpdate(EMC_IO_STAT * stat) { return task_methods->emcIoUpdate(stat); }
+
+// number of status messages iocontrol has written, to tell when it
+// has news without reading it
+int emcIoStatusCount()
+{
+    if (0 == emcIoStatusBuffer || !emcIoStatusBuffer->valid()) {
+	return 0;
+    }
+    return emcIoStatusBuffer->get_msg_count();
+}
 int emcIoPluginCall(EMC_IO_PLUGIN_CALL *call_msg) { return task_methods->emcIoPluginCall(call_msg->len,
 											   call_msg->call); }
 static const char *instance_name = "task_instance";
@@ -337,6 +348,17 @@ int emcTaskOnce(const char *filename)
 	}
     }
  no_pytask:
+    if (task_methods == NULL && IoBuiltin::wanted(filename)) {
+	IoBuiltin *builtin = new IoBuiltin();
+	if (!builtin->valid()) {
+	    delete builtin;
+	    return -1;
+	}
+	if (emc_debug & EMC_DEBUG_PYTHON_TASK) {
+	    rcs_print("emcTaskOnce: using builtin io task methods\n");
+	}
+	task_methods = builtin;
+    }
     if (task_methods == NULL) {
 	if (emc_debug & EMC_DEBUG_PYTHON_TASK) {
 	    rcs_print("emcTaskOnce: no Python Task() instance available, using default iocontrol-based task methods\n");
@@ -39,7 +39,7 @@ public:
     int random_toolchanger;
     const char *ini_filename;
     const char *tooltable_filename;
-private:
+protected:
 
     char *ttcomments[CANON_POCKETS_MAX];
     int fms[CANON_POCKETS_MAX];
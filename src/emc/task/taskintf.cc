@@ -16,6 +16,8 @@
 #include <float.h>              // DBL_MAX
 #include <string.h>		// memcpy() strncpy()
 #include <unistd.h>             // unlink()
+#include <deque>
+#include <vector>
 
 #include "usrmotintf.h"		// usrmotInit(), usrmotReadEmcmotStatus(),
 				// etc.
@@ -265,7 +267,8 @@ int emcJointSetMinFerror(int joint, double ferror)
 int emcJointSetHomingParams(int joint, double home, double offset, double home_final_vel,
 			   double search_vel, double latch_vel,
 			   int use_index, int ignore_limits, int is_shared,
-			   int sequence,int volatile_home, int locking_indexer)
+			   int sequence,int volatile_home, int locking_indexer,
+			   int home_overlap)
 {
     CATCH_NAN(isnan(home) || isnan(offset) || isnan(home_final_vel) || isnan(search_vel) || isnan(latch_vel));
 
@@ -295,6 +298,9 @@ int emcJointSetHomingParams(int joint, double home, double offset, double home_f
     if (locking_indexer) {
         emcmotCommand.flags |= HOME_UNLOCK_FIRST;
     }
+    if (home_overlap) {
+        emcmotCommand.flags |= HOME_OVERLAP;
+    }
 
     int retval = usrmotWriteEmcmotCommand(&emcmotCommand);
 
@@ -834,13 +840,12 @@ int emcJointLoadComp(int joint, const char *file, int type)
 }
 
 static emcmot_config_t emcmotConfig;
-int get_emcmot_debug_info = 0;
 
 /*
   these globals are set in emcMotionUpdate(), then referenced in
   emcJointUpdate(), emcTrajUpdate() to save calls to usrmotReadEmcmotStatus
  */
-static emcmot_debug_t emcmotDebug;
+static unsigned int emcmotStatusSeq = ~0u;	// snapshot emcmotStatus is
 static char errorString[EMCMOT_ERROR_LEN];
 static int new_config = 0;
 
@@ -1344,8 +1349,77 @@ int emcTrajSetTermCond(int cond, double tolerance)
     return usrmotWriteEmcmotCommand(&emcmotCommand);
 }
 
+int emcTrajSetRapidTolerance(double tolerance)
+{
+    if (tolerance < 0.0) {
+	tolerance = 0.0;
+    }
+
+    emcmotCommand.command = EMCMOT_SET_RAPID_TOLERANCE;
+    emcmotCommand.tolerance = tolerance;
+
+    int retval = usrmotWriteEmcmotCommand(&emcmotCommand);
+
+    if (emc_debug & EMC_DEBUG_CONFIG) {
+        rcs_print("%s(%.4f) returned %d\n", __FUNCTION__, tolerance, retval);
+    }
+    return retval;
+}
+
+int emcTrajSetArcBlend(int on)
+{
+    emcmotCommand.command = EMCMOT_SET_ARC_BLEND;
+    emcmotCommand.mode = on != 0;
+
+    int retval = usrmotWriteEmcmotCommand(&emcmotCommand);
+
+    if (emc_debug & EMC_DEBUG_CONFIG) {
+        rcs_print("%s(%d) returned %d\n", __FUNCTION__, on, retval);
+    }
+    return retval;
+}
+
+/*
+  NURBS curves are staged here by emccanon as a whole, the
+  EMC_TRAJ_NURBS_MOVE message only refers to them by stage id.  When the
+  message is issued the curve is copied into the shared NURBS arena in one
+  go and motion gets a single EMCMOT_SET_NURBS for it.
+  */
+struct NurbsStage {
+    int id;
+    std::vector<CONTROL_POINT> ctrl_pts;
+    std::vector<double> knots;
+    std::vector<double> arclen;
+};
+
+static std::deque<NurbsStage> nurbsStageQueue;
+static int nurbsStageId = 0;
+
+int emcTrajNurbsStage(const CONTROL_POINT *ctrl_pts, int nr_of_ctrl_pts,
+                      const double *knots, int nr_of_knots,
+                      const double *arclen, int nr_of_arclen)
+{
+    if (nr_of_ctrl_pts < 2 || nr_of_knots < nr_of_ctrl_pts ||
+        nr_of_knots > EMCMOT_NURBS_ARENA_SIZE ||
+        nr_of_arclen < 0 || nr_of_arclen == 1 ||
+        NURBS_ARCLEN_STRIDE * nr_of_arclen > EMCMOT_NURBS_ARENA_SIZE) {
+        rcs_print_error("emcTrajNurbsStage: bad NURBS curve (%d control points, %d knots, %d arc length nodes)\n",
+                        nr_of_ctrl_pts, nr_of_knots, nr_of_arclen);
+        return -1;
+    }
+    nurbsStageQueue.push_back(NurbsStage());
+    NurbsStage &stage = nurbsStageQueue.back();
+    stage.id = ++nurbsStageId;
+    stage.ctrl_pts.assign(ctrl_pts, ctrl_pts + nr_of_ctrl_pts);
+    stage.knots.assign(knots, knots + nr_of_knots);
+    stage.arclen.assign(arclen, arclen + NURBS_ARCLEN_STRIDE * nr_of_arclen);
+    return stage.id;
+}
+
 int emcTrajNurbsMove(EmcPose end, int type,nurbs_block_t nurbs_block,double vel, double ini_maxvel, double ini_maxacc, double ini_maxjerk)
 {
+    int retval;
+
 #ifdef ISNAN_TRAP
     if (isnan(end.tran.x) || isnan(end.tran.y) || isnan(end.tran.z) ||
         isnan(end.a) || isnan(end.b) || isnan(end.c) ||
@@ -1355,6 +1429,30 @@ int emcTrajNurbsMove(EmcPose end, int type,nurbs_block_t nurbs_block,double vel,
     }
 #endif
 
+    // drop curves left behind by an aborted readahead
+    while (!nurbsStageQueue.empty() &&
+           nurbsStageQueue.front().id < nurbs_block.stage_id) {
+        nurbsStageQueue.pop_front();
+    }
+    if (nurbsStageQueue.empty() ||
+        nurbsStageQueue.front().id != nurbs_block.stage_id) {
+        rcs_print_error("emcTrajNurbsMove: NURBS curve %d not staged\n",
+                        nurbs_block.stage_id);
+        return -1;
+    }
+
+    NurbsStage &stage = nurbsStageQueue.front();
+    nurbs_block.nr_of_ctrl_pts = stage.ctrl_pts.size();
+    nurbs_block.nr_of_knots = stage.knots.size();
+    nurbs_block.nr_of_arclen = stage.arclen.size() / NURBS_ARCLEN_STRIDE;
+    retval = usrmotWriteNurbsBlock(&stage.ctrl_pts[0], &stage.knots[0],
+                                   stage.arclen.empty() ? 0 : &stage.arclen[0],
+                                   &nurbs_block);
+    nurbsStageQueue.pop_front();
+    if (retval != EMCMOT_COMM_OK) {
+        return retval;
+    }
+
     emcmotCommand.command = EMCMOT_SET_NURBS;
 
     emcmotCommand.pos = end;
@@ -1511,6 +1609,7 @@ int emcTrajUpdate(EMC_TRAJ_STAT * stat)
     stat->queue = emcmotStatus.depth;
     stat->activeQueue = emcmotStatus.activeDepth;
     stat->queueFull = emcmotStatus.queueFull;
+    stat->queueTime = emcmotStatus.queueTime;
     stat->id = emcmotStatus.id;
     stat->motion_type = emcmotStatus.motionType;
     stat->distance_to_go = emcmotStatus.distance_to_go;
@@ -1852,6 +1951,18 @@ int emcSpindleConstant()
 
 
 
+/* a number that changes whenever the motion queue drains, fills or
+   comes into position, or -1 if motion can't be read */
+int emcMotionQueueState()
+{
+    int depth, queueFull, inpos;
+
+    if (usrmotReadEmcmotQueue(&depth, &queueFull, &inpos) != EMCMOT_COMM_OK) {
+	return -1;
+    }
+    return depth * 4 + queueFull * 2 + inpos;
+}
+
 int emcMotionUpdate(EMC_MOTION_STAT * stat)
 {
     int r1, r2, r3;
@@ -1860,8 +1971,9 @@ int emcMotionUpdate(EMC_MOTION_STAT * stat)
     int exec;
     int dio, aio;
 
-    // read the emcmot status
-    if (0 != usrmotReadEmcmotStatus(&emcmotStatus)) {
+    // read the emcmot status, if motion has published a new one since;
+    // the config is read when config_num says it changed
+    if (usrmotReadEmcmotStatusChanged(&emcmotStatus, &emcmotStatusSeq) < 0) {
 	return -1;
     }
 
@@ -1873,11 +1985,6 @@ int emcMotionUpdate(EMC_MOTION_STAT * stat)
 	new_config = 1;
     }
 
-    if (get_emcmot_debug_info) {
-	if (0 != usrmotReadEmcmotDebug(&emcmotDebug)) {
-	    return -1;
-	}
-    }
     // read the emcmot error
     if (0 != usrmotReadEmcmotError(errorString)) {
 	// no error, so ignore
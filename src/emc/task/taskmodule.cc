@@ -313,6 +313,7 @@ BOOST_PYTHON_MODULE(emctask) {
 	.def_readwrite("queue", &EMC_TRAJ_STAT::queue )
 	.def_readwrite("activeQueue", &EMC_TRAJ_STAT::activeQueue )
 	.def_readwrite("queueFull", &EMC_TRAJ_STAT::queueFull )
+	.def_readwrite("queueTime", &EMC_TRAJ_STAT::queueTime )
 	.def_readwrite("id", &EMC_TRAJ_STAT::id )
 	.def_readwrite("paused", &EMC_TRAJ_STAT::paused )
 	.def_readwrite("scale", &EMC_TRAJ_STAT::scale )
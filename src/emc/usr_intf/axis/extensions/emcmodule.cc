@@ -30,6 +30,7 @@
 #include "timer.hh"
 #include "nml_oi.hh"
 #include "rcs_print.hh"
+#include "cmsdiag.hh"
 
 #include <cmath>
 
@@ -77,10 +78,23 @@ struct pyIniFile {
     IniFile *i;
 };
 
+// attributes of linuxcnc.stat that are built once and handed out again
+// until the change counter of the sub-block they come from moves
+enum {
+    CACHE_position, CACHE_actual, CACHE_dtg, CACHE_probed,
+    CACHE_g5x_offset, CACHE_g92_offset, CACHE_tool_offset,
+    CACHE_activegcodes, CACHE_activemcodes, CACHE_activesettings,
+    CACHE_joint_position, CACHE_joint_actual, CACHE_homed, CACHE_limit,
+    CACHE_tool_table,
+    STAT_CACHE_SIZE
+};
+
 struct pyStatChannel {
     PyObject_HEAD
     RCS_STAT_CHANNEL *c;
     EMC_STAT status;
+    PyObject *cache[STAT_CACHE_SIZE];
+    int cache_serial[STAT_CACHE_SIZE];
 };
 
 struct pyCommandChannel {
@@ -204,33 +218,43 @@ static PyTypeObject Ini_Type = {
 #define EMC_COMMAND_TIMEOUT 5.0  // how long to wait until timeout
 #define EMC_COMMAND_DELAY   0.01 // how long to sleep between checks
 
+/* Waits up to timeout seconds for task to write the status again.  On
+   a SHMEM channel this wakes as soon as the write lands; if the channel
+   can't block, it sleeps and peeks instead. */
+static void emcWaitStatus(RCS_STAT_CHANNEL *s, double timeout) {
+    if(s->blocking_read(timeout) < 0) {
+        esleep(fmin(timeout, EMC_COMMAND_DELAY));
+        s->peek();
+    }
+}
+
 static int emcWaitCommandComplete(int serial_number, RCS_STAT_CHANNEL *s, double timeout) {
-    double start = etime();
-
-    do {
-        double now = etime();
-        if(s->peek() == EMC_STAT_TYPE) {
-           EMC_STAT *stat = (EMC_STAT*)s->get_address();
-           // DEBUG: printf("WaitComplete: %d %d %d\n", serial_number, stat->echo_serial_number, stat->status);
-           if (stat->echo_serial_number == serial_number &&
-               ( stat->status == RCS_DONE || stat->status == RCS_ERROR )) {
-                return s->get_address()->status;
-           }
+    double start = etime(), left;
+
+    s->peek();
+    while(1) {
+        EMC_STAT *stat = (EMC_STAT*)s->get_address();
+        // DEBUG: printf("WaitComplete: %d %d %d\n", serial_number, stat->echo_serial_number, stat->status);
+        if (stat->type == EMC_STAT_TYPE &&
+            stat->echoed(serial_number) &&
+            ( stat->status == RCS_DONE || stat->status == RCS_ERROR )) {
+            return stat->status;
         }
-        esleep(fmin(timeout - (now - start), EMC_COMMAND_DELAY));
-    } while (etime() - start < timeout);
-    return -1;
+        left = timeout - (etime() - start);
+        if(left <= 0) return -1;
+        emcWaitStatus(s, left);
+    }
 }
 
 static void emcWaitCommandReceived(int serial_number, RCS_STAT_CHANNEL *s) {
-    double start = etime();
-
-    while (etime() - start < EMC_COMMAND_TIMEOUT) {
-        if(s->peek() == EMC_STAT_TYPE &&
-           s->get_address()->echo_serial_number == serial_number) {
-                return;
-           }
-        esleep(EMC_COMMAND_DELAY);
+    double start = etime(), left;
+
+    s->peek();
+    while(s->get_address()->type != EMC_STAT_TYPE ||
+          !((EMC_STAT*)s->get_address())->echoed(serial_number)) {
+        left = EMC_COMMAND_TIMEOUT - (etime() - start);
+        if(left <= 0) return;
+        emcWaitStatus(s, left);
     }
 }
 
@@ -260,7 +284,10 @@ static int Stat_init(pyStatChannel *self, PyObject *a, PyObject *k) {
 }
 
 static void Stat_dealloc(PyObject *self) {
-    delete ((pyStatChannel*)self)->c;
+    pyStatChannel *s = (pyStatChannel*)self;
+    delete s->c;
+    for(int i = 0; i < STAT_CACHE_SIZE; i++)
+        Py_XDECREF(s->cache[i]);
     PyObject_Del(self);
 }
 
@@ -272,18 +299,92 @@ static bool check_stat(RCS_STAT_CHANNEL *emcStatusBuffer) {
     return true;
 }
 
+// copies from to to, leaving out the sub-blocks whose change counter
+// says to has them already
+static void stat_copy(EMC_STAT *to, const EMC_STAT *from) {
+    struct { int block; const void *begin, *end; } blocks[] = {
+        { EMC_STAT_TASK, &from->task, &from->task + 1 },
+        { EMC_STAT_TRAJ, &from->motion.traj, &from->motion.traj + 1 },
+        { EMC_STAT_JOINTS, &from->motion.joint[0],
+            &from->motion.axis[EMCMOT_MAX_AXIS] },
+        { EMC_STAT_TOOL, &from->io.tool, &from->io.tool + 1 },
+        { EMC_STAT_IO, &from->io.coolant, &from->io.lube + 1 },
+    };
+    const char *pos = (const char *)from;
+
+    for(unsigned i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        int b = blocks[i].block;
+        if(to->block_serial[b] != from->block_serial[b]) continue;
+        memcpy((char *)to + (pos - (const char *)from), pos,
+                (const char *)blocks[i].begin - pos);
+        pos = (const char *)blocks[i].end;
+    }
+    memcpy((char *)to + (pos - (const char *)from), pos,
+            (const char *)(from + 1) - pos);
+    to->task.heartbeat = from->task.heartbeat;
+}
+
 static PyObject *poll(pyStatChannel *s, PyObject *o) {
     if(!check_stat(s->c)) return NULL;
-    if(s->c->peek() == EMC_STAT_TYPE) {
-        EMC_STAT *emcStatus = static_cast<EMC_STAT*>(s->c->get_address());
-        memcpy(&s->status, emcStatus, sizeof(EMC_STAT));
-    }
+    NML_BORROWED_READ view(s->c);
+    if(view.type == EMC_STAT_TYPE)
+        stat_copy(&s->status, static_cast<const EMC_STAT*>(view.msg));
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+// the access counters of c's buffer as a dict, see CMS_ACCESS_STATS,
+// or None if it is not a local SHMEM buffer
+static PyObject *access_stats_dict(NML *c) {
+    const CMS_ACCESS_STATS *st = c ? c->get_access_stats() : NULL;
+    if(!st) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    CMS_ACCESS_STATS t;
+    memcpy(&t, st, sizeof(t));
+    PyObject *res = PyDict_New(), *o;
+#define F(x) \
+    PyDict_SetItemString(res, #x, o = PyLong_FromLongLong(t.x)); \
+    Py_XDECREF(o)
+    F(reads);
+    F(new_reads);
+    F(writes);
+    F(bytes_read);
+    F(bytes_written);
+    F(retries);
+    F(queue_full);
+    F(lock_timeouts);
+    F(wait_max_ns);
+#undef F
+    PyObject *hist = PyTuple_New(CMS_STATS_WAIT_BUCKETS);
+    for(int i=0; i<CMS_STATS_WAIT_BUCKETS; i++)
+        PyTuple_SET_ITEM(hist, i, PyLong_FromLongLong(t.wait_histogram[i]));
+    PyDict_SetItemString(res, "wait_histogram", hist);
+    Py_XDECREF(hist);
+    PyObject *procs = PyList_New(0);
+    for(int i=0; i<CMS_STATS_PROCS; i++) {
+        CMS_STATS_PROC &p = t.procs[i];
+        if(!p.pid) continue;
+        p.name[sizeof(p.name)-1] = 0;
+        o = Py_BuildValue("{s:s,s:i,s:L,s:d}", "name", p.name, "pid", p.pid,
+            "accesses", p.accesses, "last_access_time", p.last_access_time);
+        PyList_Append(procs, o);
+        Py_XDECREF(o);
+    }
+    PyDict_SetItemString(res, "procs", procs);
+    Py_XDECREF(procs);
+    return res;
+}
+
+static PyObject *Stat_nml_stats(pyStatChannel *s, PyObject *o) {
+    return access_stats_dict(s->c);
+}
+
 static PyMethodDef Stat_methods[] = {
     {"poll", (PyCFunction)poll, METH_NOARGS, "Update current machine state"},
+    {"nml_stats", (PyCFunction)Stat_nml_stats, METH_NOARGS,
+        "Access counters of the emcStatus buffer, or None if not local"},
     {NULL}
 };
 
@@ -312,6 +413,13 @@ static PyMemberDef Stat_members[] = {
     {(char*)"rotation_xy", T_DOUBLE, O(task.rotation_xy), READONLY},
     {(char*)"delay_left", T_DOUBLE, O(task.delayLeft), READONLY},
     {(char*)"queued_mdi_commands", T_INT, O(task.queuedMDIcommands), READONLY},
+    {(char*)"mdi_batch_lines", T_INT, O(task.mdiBatchLines), READONLY},
+    {(char*)"mdi_batch_read", T_INT, O(task.mdiBatchRead), READONLY},
+    {(char*)"mdi_batch_done", T_INT, O(task.mdiBatchDone), READONLY},
+    {(char*)"cycle_overruns", T_INT, O(task.cycleOverruns), READONLY},
+    {(char*)"cycle_jitter", T_DOUBLE, O(task.cycleJitter), READONLY},
+    {(char*)"cycle_jitter_mean", T_DOUBLE, O(task.cycleJitterMean), READONLY},
+    {(char*)"cycle_load", T_DOUBLE, O(task.cycleLoad), READONLY},
 
 // motion
 //   EMC_TRAJ_STAT traj
@@ -327,6 +435,7 @@ static PyMemberDef Stat_members[] = {
     {(char*)"queue", T_INT, O(motion.traj.queue), READONLY},
     {(char*)"active_queue", T_INT, O(motion.traj.activeQueue), READONLY},
     {(char*)"queue_full", T_BOOL, O(motion.traj.queueFull), READONLY},
+    {(char*)"queue_time", T_DOUBLE, O(motion.traj.queueTime), READONLY},
     {(char*)"id", T_INT, O(motion.traj.id), READONLY},
     {(char*)"paused", T_BOOL, O(motion.traj.paused), READONLY},
     {(char*)"feedrate", T_DOUBLE, O(motion.traj.scale), READONLY},
@@ -488,6 +597,10 @@ static PyObject *Stat_limit(pyStatChannel *s) {
     return res;
 }
 
+static PyObject *Stat_block_serial(pyStatChannel *s) {
+    return int_array(s->status.block_serial, EMC_STAT_BLOCKS);
+}
+
 static PyObject *Stat_homed(pyStatChannel *s) {
     PyObject *res = PyTuple_New(EMCMOT_MAX_JOINTS);
     for(int i = 0; i < EMCMOT_MAX_JOINTS; i++) {
@@ -626,32 +739,111 @@ static PyObject *Stat_tool_table(pyStatChannel *s) {
     return res;
 }
 
+static PyObject *timing_dict(const struct EMC_TASK_TIMING &t) {
+    PyObject *res = PyDict_New();
+    PyObject *hist = PyTuple_New(EMC_TASK_TIMING_BUCKETS), *o;
+    for(int i=0; i<EMC_TASK_TIMING_BUCKETS; i++)
+        PyTuple_SET_ITEM(hist, i, PyInt_FromLong(t.hist[i]));
+    PyDict_SetItemString(res, "count", o = PyInt_FromLong(t.count));
+    Py_XDECREF(o);
+    dict_add(res, "last", t.last);
+    dict_add(res, "max", t.max);
+    dict_add(res, "total", t.total);
+    PyDict_SetItemString(res, "histogram", hist);
+    Py_XDECREF(hist);
+    return res;
+}
+
+static PyObject *Stat_task_timing(pyStatChannel *s) {
+    static const char *names[EMC_TASK_PHASES] = {
+        "plan", "execute", "issue", "read" };
+    PyObject *res = PyDict_New(), *o;
+    for(int i=0; i<EMC_TASK_PHASES; i++) {
+        PyDict_SetItemString(res, names[i],
+            o = timing_dict(s->status.task.phaseTiming[i]));
+        Py_XDECREF(o);
+    }
+    return res;
+}
+
+static PyObject *Stat_command_latency(pyStatChannel *s) {
+    PyObject *res = PyDict_New(), *o;
+    for(int i=0; i<EMC_TASK_LATENCY_TYPES; i++) {
+        struct EMC_TASK_LATENCY &l = s->status.task.commandLatency[i];
+        if(!l.type) break;
+        PyDict_SetItemString(res, emc_symbol_lookup(l.type),
+            o = timing_dict(l.timing));
+        Py_XDECREF(o);
+    }
+    return res;
+}
+
+// the cached attribute in 'slot', made again by 'make' if the sub-block
+// 'block' has changed since.  Only immutable results are cached; joint
+// and axis are dicts a caller could change, and are made every time.
+static PyObject *stat_cached(pyStatChannel *s, int slot, int block,
+        PyObject *(*make)(pyStatChannel *)) {
+    if(!s->cache[slot] || s->cache_serial[slot] != s->status.block_serial[block]) {
+        PyObject *o = make(s);
+        if(!o) return NULL;
+        Py_XDECREF(s->cache[slot]);
+        s->cache[slot] = o;
+        s->cache_serial[slot] = s->status.block_serial[block];
+    }
+    Py_INCREF(s->cache[slot]);
+    return s->cache[slot];
+}
+
+#define CACHED(name, block) \
+    static PyObject *Stat_##name##_cached(pyStatChannel *s) { \
+        return stat_cached(s, CACHE_##name, block, Stat_##name); \
+    }
+CACHED(position, EMC_STAT_TRAJ)
+CACHED(actual, EMC_STAT_TRAJ)
+CACHED(dtg, EMC_STAT_TRAJ)
+CACHED(probed, EMC_STAT_TRAJ)
+CACHED(g5x_offset, EMC_STAT_TASK)
+CACHED(g92_offset, EMC_STAT_TASK)
+CACHED(tool_offset, EMC_STAT_TASK)
+CACHED(activegcodes, EMC_STAT_TASK)
+CACHED(activemcodes, EMC_STAT_TASK)
+CACHED(activesettings, EMC_STAT_TASK)
+CACHED(joint_position, EMC_STAT_JOINTS)
+CACHED(joint_actual, EMC_STAT_JOINTS)
+CACHED(homed, EMC_STAT_JOINTS)
+CACHED(limit, EMC_STAT_JOINTS)
+CACHED(tool_table, EMC_STAT_TOOL)
+#undef CACHED
+
 // XXX io.tool.toolTable
 // XXX EMC_JOINT_STAT motion.joint[]
 
 static PyGetSetDef Stat_getsetlist[] = {
-    {(char*)"actual_position", (getter)Stat_actual},
+    {(char*)"actual_position", (getter)Stat_actual_cached},
     {(char*)"ain", (getter)Stat_ain},
     {(char*)"aout", (getter)Stat_aout},
     {(char*)"joint", (getter)Stat_joint},
+    {(char*)"block_serial", (getter)Stat_block_serial},
     {(char*)"axis", (getter)Stat_axis},
     {(char*)"din", (getter)Stat_din},
     {(char*)"dout", (getter)Stat_dout},
-    {(char*)"gcodes", (getter)Stat_activegcodes},
-    {(char*)"homed", (getter)Stat_homed},
-    {(char*)"limit", (getter)Stat_limit},
-    {(char*)"mcodes", (getter)Stat_activemcodes},
-    {(char*)"g5x_offset", (getter)Stat_g5x_offset},
+    {(char*)"gcodes", (getter)Stat_activegcodes_cached},
+    {(char*)"homed", (getter)Stat_homed_cached},
+    {(char*)"limit", (getter)Stat_limit_cached},
+    {(char*)"mcodes", (getter)Stat_activemcodes_cached},
+    {(char*)"g5x_offset", (getter)Stat_g5x_offset_cached},
     {(char*)"g5x_index", (getter)Stat_g5x_index},
-    {(char*)"g92_offset", (getter)Stat_g92_offset},
-    {(char*)"position", (getter)Stat_position},
-    {(char*)"dtg", (getter)Stat_dtg},
-    {(char*)"joint_position", (getter)Stat_joint_position},
-    {(char*)"joint_actual_position", (getter)Stat_joint_actual},
-    {(char*)"probed_position", (getter)Stat_probed},
-    {(char*)"settings", (getter)Stat_activesettings},
-    {(char*)"tool_offset", (getter)Stat_tool_offset},
-    {(char*)"tool_table", (getter)Stat_tool_table},
+    {(char*)"g92_offset", (getter)Stat_g92_offset_cached},
+    {(char*)"position", (getter)Stat_position_cached},
+    {(char*)"dtg", (getter)Stat_dtg_cached},
+    {(char*)"joint_position", (getter)Stat_joint_position_cached},
+    {(char*)"joint_actual_position", (getter)Stat_joint_actual_cached},
+    {(char*)"probed_position", (getter)Stat_probed_cached},
+    {(char*)"settings", (getter)Stat_activesettings_cached},
+    {(char*)"tool_offset", (getter)Stat_tool_offset_cached},
+    {(char*)"tool_table", (getter)Stat_tool_table_cached},
+    {(char*)"task_timing", (getter)Stat_task_timing},
+    {(char*)"command_latency", (getter)Stat_command_latency},
     {NULL}
 };
 
@@ -883,6 +1075,25 @@ static PyObject *mdi(pyCommandChannel *s, PyObject *o) {
     return Py_None;
 }
 
+static PyObject *mdi_batch(pyCommandChannel *s, PyObject *o) {
+    char *cmd;
+    int len;
+    if(!PyArg_ParseTuple(o, "s#", &cmd, &len)) return NULL;
+    if(len >= EMC_MDI_BATCH_LEN) {
+        PyErr_Format(PyExc_ValueError,"MDI batches limited to %d characters",
+                EMC_MDI_BATCH_LEN - 1);
+        return NULL;
+    }
+    EMC_TASK_PLAN_EXECUTE_BATCH m;
+    m.serial_number = next_serial(s);
+    memcpy(m.commands, cmd, len);
+    m.commands[len] = 0;
+    s->c->write(m);
+    emcWaitCommandReceived(s->serial, s->s);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyObject *state(pyCommandChannel *s, PyObject *o) {
     EMC_TASK_SET_STATE m;
     if(!PyArg_ParseTuple(o, "i", &m.state)) return NULL;
@@ -1347,7 +1558,12 @@ static PyMemberDef Command_members[] = {
     {NULL}
 };
 
+static PyObject *Command_nml_stats(pyCommandChannel *s, PyObject *o) {
+    return access_stats_dict(s->c);
+}
+
 static PyMethodDef Command_methods[] = {
+    {"nml_stats", (PyCFunction)Command_nml_stats, METH_NOARGS},
     {"debug", (PyCFunction)debug, METH_VARARGS},
     {"teleop_enable", (PyCFunction)teleop, METH_VARARGS},
     {"teleop_vector", (PyCFunction)set_teleop_vector, METH_VARARGS},
@@ -1355,6 +1571,7 @@ static PyMethodDef Command_methods[] = {
     {"wait_complete", (PyCFunction)wait_complete, METH_VARARGS},
     {"state", (PyCFunction)state, METH_VARARGS},
     {"mdi", (PyCFunction)mdi, METH_VARARGS},
+    {"mdi_batch", (PyCFunction)mdi_batch, METH_VARARGS},
     {"mode", (PyCFunction)mode, METH_VARARGS},
     {"feedrate", (PyCFunction)feedrate, METH_VARARGS},
     {"maxvel", (PyCFunction)maxvel, METH_VARARGS},
@@ -1807,6 +2024,237 @@ static PyObject *pydraw_dwells(PyObject *s, PyObject *o) {
     return Py_None;
 }
 
+// The preview's lines in the 'rs274.glcanon' format, turned once into a
+// vertex array of GL_LINES pairs, so that drawing them, for display or
+// for selection, is a few glDrawArrays calls instead of a glVertex per
+// point from Python tuples, and highlighting one line draws just its
+// range of the array.
+typedef struct {
+    PyObject_HEAD
+    int nsegs, nverts, mverts;
+    float *v;           // 3 per vertex, after the geometry
+    int *first;         // nsegs+1: where each segment's vertices start
+    int *lineno;        // nsegs: the source line of each segment
+    float *ends;        // 6 per segment: xyz of both ends, before it
+} pyPreviewLines;
+
+static int preview_vertex(pyPreviewLines *s, const double pt[9],
+        const char *geometry) {
+    double p[3];
+    if(s->nverts == s->mverts) {
+        int m = s->mverts ? 2 * s->mverts : 1024;
+        float *v = (float*) realloc(s->v, sizeof(float) * 3 * m);
+        if(!v) return -1;
+        s->v = v;
+        s->mverts = m;
+    }
+    vertex9(pt, p, geometry);
+    float *v = s->v + 3 * s->nverts++;
+    v[0] = p[0]; v[1] = p[1]; v[2] = p[2];
+    return 0;
+}
+
+// the vertices line9b would draw, as GL_LINES pairs
+static int preview_line9(pyPreviewLines *s, const double p1[9],
+        const double p2[9], const char *geometry) {
+    if(p1[3] != p2[3] || p1[4] != p2[4] || p1[5] != p2[5]) {
+        double dc = max3(
+            fabs(p2[3] - p1[3]),
+            fabs(p2[4] - p1[4]),
+            fabs(p2[5] - p1[5]));
+        int st = (int)ceil(max(10, dc/10));
+        double pl[9];
+        memcpy(pl, p1, sizeof(pl));
+        for(int i=1; i<=st; i++) {
+            double t = i * 1.0 / st;
+            double v = 1.0 - t;
+            double pt[9];
+            for(int j=0; j<9; j++) { pt[j] = t * p2[j] + v * p1[j]; }
+            if(preview_vertex(s, pl, geometry) || preview_vertex(s, pt, geometry))
+                return -1;
+            memcpy(pl, pt, sizeof(pl));
+        }
+        return 0;
+    }
+    return preview_vertex(s, p1, geometry) || preview_vertex(s, p2, geometry)
+        ? -1 : 0;
+}
+
+static int Preview_init(pyPreviewLines *self, PyObject *a, PyObject *k) {
+    PyListObject *li;
+    char *geometry;
+    double p1[9], p2[9];
+
+    if(!PyArg_ParseTuple(a, "sO!:preview_lines", &geometry, &PyList_Type, &li))
+        return -1;
+    free(self->v); free(self->first); free(self->lineno); free(self->ends);
+    self->v = 0;
+    self->nsegs = self->nverts = self->mverts = 0;
+    int n = PyList_GET_SIZE(li);
+    self->first = (int*) malloc(sizeof(int) * (n + 1));
+    self->lineno = (int*) malloc(sizeof(int) * (n + 1));
+    self->ends = (float*) malloc(sizeof(float) * 6 * (n + 1));
+    if(!self->first || !self->lineno || !self->ends) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for(int i=0; i<n; i++) {
+        PyObject *it = PyList_GET_ITEM(li, i);
+        PyObject *dummy1, *dummy2, *dummy3;
+        int l;
+        if(!PyArg_ParseTuple(it, "i(ddddddddd)(ddddddddd)|OOO", &l,
+                    p1+0, p1+1, p1+2,
+                    p1+3, p1+4, p1+5,
+                    p1+6, p1+7, p1+8,
+                    p2+0, p2+1, p2+2,
+                    p2+3, p2+4, p2+5,
+                    p2+6, p2+7, p2+8,
+                    &dummy1, &dummy2, &dummy3))
+            return -1;
+        self->first[i] = self->nverts;
+        self->lineno[i] = l;
+        float *e = self->ends + 6 * i;
+        e[0] = p1[0]; e[1] = p1[1]; e[2] = p1[2];
+        e[3] = p2[0]; e[4] = p2[1]; e[5] = p2[2];
+        if(preview_line9(self, p1, p2, geometry)) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->nsegs = i + 1;
+    }
+    self->first[self->nsegs] = self->nverts;
+    return 0;
+}
+
+static void Preview_dealloc(pyPreviewLines *s) {
+    free(s->v);
+    free(s->first);
+    free(s->lineno);
+    free(s->ends);
+    PyObject_Del(s);
+}
+
+// the position logger leaves its color array enabled, so the client
+// state is saved and restored around every draw
+static void preview_begin(pyPreviewLines *s) {
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, s->v);
+}
+
+static void preview_range(pyPreviewLines *s, int i, int j) {
+    glDrawArrays(GL_LINES, s->first[i], s->first[j] - s->first[i]);
+}
+
+static PyObject *Preview_draw(pyPreviewLines *s, PyObject *o) {
+    int for_selection = 0;
+    if(!PyArg_ParseTuple(o, "|i:preview_lines.draw", &for_selection))
+        return NULL;
+    if(!s->nsegs) Py_RETURN_NONE;
+    preview_begin(s);
+    if(!for_selection) {
+        preview_range(s, 0, s->nsegs);
+    } else {
+        for(int i=0, j; i<s->nsegs; i=j) {
+            for(j=i+1; j<s->nsegs && s->lineno[j] == s->lineno[i]; j++) {}
+            glLoadName(s->lineno[i]);
+            preview_range(s, i, j);
+        }
+    }
+    glPopClientAttrib();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_highlight(pyPreviewLines *s, PyObject *o) {
+    int lineno;
+    if(!PyArg_ParseTuple(o, "i:preview_lines.highlight", &lineno))
+        return NULL;
+    PyObject *coords = PyList_New(0);
+    if(!coords) return NULL;
+    bool begun = false;
+    for(int i=0, j; i<s->nsegs; i=j) {
+        for(j=i+1; j<s->nsegs && s->lineno[j] == s->lineno[i]; j++) {}
+        if(s->lineno[i] != lineno) continue;
+        if(!begun) { preview_begin(s); begun = true; }
+        preview_range(s, i, j);
+        for(int k=i; k<j; k++) {
+            float *e = s->ends + 6 * k;
+            for(int m=0; m<6; m+=3) {
+                PyObject *c = Py_BuildValue("(ddd)", e[m], e[m+1], e[m+2]);
+                if(!c || PyList_Append(coords, c)) {
+                    Py_XDECREF(c);
+                    Py_DECREF(coords);
+                    glPopClientAttrib();
+                    return NULL;
+                }
+                Py_DECREF(c);
+            }
+        }
+    }
+    if(begun) glPopClientAttrib();
+    return coords;
+}
+
+static PyMemberDef Preview_members[] = {
+    {(char*)"count", T_INT, offsetof(pyPreviewLines, nsegs), READONLY,
+        (char*)"How many lines it was made from"},
+    {0, 0, 0, 0},
+};
+
+static PyMethodDef Preview_methods[] = {
+    {"draw", (PyCFunction)Preview_draw, METH_VARARGS,
+        "Draw the lines, naming each source line if ARG is true"},
+    {"highlight", (PyCFunction)Preview_highlight, METH_VARARGS,
+        "Draw the lines from source line ARG and return their end points"},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject PreviewLinesType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "linuxcnc.preview_lines",   /*tp_name*/
+    sizeof(pyPreviewLines), /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)Preview_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    0,                      /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    0,                      /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    0,                      /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    Preview_methods,        /*tp_methods*/
+    Preview_members,        /*tp_members*/
+    0,                      /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    (initproc)Preview_init, /*tp_init*/
+    0,                      /*tp_alloc*/
+    PyType_GenericNew,      /*tp_new*/
+    0,                      /*tp_free*/
+    0,                      /*tp_is_gc*/
+};
+
 struct color {
     unsigned char r, g, b, a;
     bool operator==(const color &o) const {
@@ -1830,6 +2278,7 @@ typedef struct {
     PyObject_HEAD
     int npts, mpts, lpts;
     struct logger_point *p;
+    double tolerance;
     struct color colors[NUMCOLORS];
     bool exit, clear, changed;
     char *geometry;
@@ -1853,6 +2302,66 @@ static inline bool colinear(float xa, float ya, float za, float xb, float yb, fl
     return false;
 }
 
+// distance from p to the segment a-b
+static double seg_dist(double px, double py, double pz,
+        double ax, double ay, double az, double bx, double by, double bz) {
+    double dx = bx-ax, dy = by-ay, dz = bz-az;
+    double l2 = dx*dx + dy*dy + dz*dz;
+    double t = 0;
+    if(l2 > tiny) {
+        t = ((px-ax)*dx + (py-ay)*dy + (pz-az)*dz) / l2;
+        if(t < 0) t = 0;
+        if(t > 1) t = 1;
+    }
+    dx = px - (ax + t*dx); dy = py - (ay + t*dy); dz = pz - (az + t*dz);
+    return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+// whether b can go from between a and c without the plot moving more than
+// tol; points where the color changes always stay
+static bool removable(pyPositionLogger *s, const logger_point &a,
+        const logger_point &b, const logger_point &c, double tol) {
+    if(a.c != b.c || b.c != c.c) return false;
+    if(seg_dist(b.x, b.y, b.z, a.x, a.y, a.z, c.x, c.y, c.z) > tol)
+        return false;
+    return !s->is_xyuv
+        || seg_dist(b.rx, b.ry, b.rz, a.rx, a.ry, a.rz, c.rx, c.ry, c.rz) <= tol;
+}
+
+// Make room by thinning the older half of the plot, first by dropping
+// the points that lie within the tolerance of their neighbours' line and,
+// if that frees too little, every other point.  The recent half stays at
+// full resolution; the oldest points, thinned each time the plot fills,
+// get coarser the older they are.  Returns how many points went.
+static int logger_compact(pyPositionLogger *s) {
+    int removed = 0, lremoved = 0;
+    for(int pass = 0; pass < 2 && removed < s->npts / 4; pass++) {
+        int end = (s->npts - removed) / 2;
+        int lpts = s->lpts - lremoved;
+        int j = 1;
+        for(int i = 1; i < end; i++) {
+            bool drop = pass == 0
+                ? removable(s, s->p[j-1], s->p[i], s->p[i+1], s->tolerance)
+                : (i & 1) && removable(s, s->p[j-1], s->p[i], s->p[i+1], HUGE_VAL);
+            if(drop) {
+                if(i < lpts) lremoved++;
+                continue;
+            }
+            s->p[j++] = s->p[i];
+        }
+        if(end > 1) {
+            memmove(s->p + j, s->p + end,
+                    sizeof(struct logger_point) * (s->npts - removed - end));
+            removed += end - j;
+        }
+    }
+    s->npts -= removed;
+    s->lpts -= lremoved;
+    if(s->lpts > s->npts) s->lpts = s->npts;
+    if(s->lpts < 0) s->lpts = 0;
+    return removed;
+}
+
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void LOCK() { pthread_mutex_lock(&mutex); }
@@ -1861,8 +2370,16 @@ static void UNLOCK() { pthread_mutex_unlock(&mutex); }
 static int Logger_init(pyPositionLogger *self, PyObject *a, PyObject *k) {
     char *geometry;
     struct color *c = self->colors;
-    self->p = (logger_point*)malloc(0);
-    self->npts = self->mpts = 0;
+    // the plot never grows past MAX_POINTS, so it is allocated once and
+    // the arrays handed to GL stay put
+    self->p = (logger_point*)malloc(sizeof(struct logger_point) * MAX_POINTS);
+    if(!self->p) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->npts = self->lpts = 0;
+    self->mpts = MAX_POINTS;
+    self->tolerance = 1e-3;
     self->exit = self->clear = 0;
     self->changed = 1;
     self->st = 0;
@@ -1984,17 +2501,14 @@ static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
                 bool changed_color = s->npts && c != op->c;
                 if(s->npts+2 > s->mpts) {
                     LOCK();
-                    if(s->mpts >= MAX_POINTS) {
+                    logger_compact(s);
+                    if(s->npts+2 > s->mpts) {
+                        // nothing left to thin; lose the oldest points
                         int adjust = MAX_POINTS / 10;
-                        if(adjust < 2) adjust = 2;
                         s->npts -= adjust;
+                        s->lpts = s->lpts > adjust ? s->lpts - adjust : 0;
                         memmove(s->p, s->p + adjust, 
                                 sizeof(struct logger_point) * s->npts);
-                    } else {
-                        s->mpts = 2 * s->mpts + 2;
-                        s->changed = 1;
-                        s->p = (struct logger_point*) realloc(s->p,
-                                    sizeof(struct logger_point) * s->mpts);
                     }
                     UNLOCK();
                     op = &s->p[s->npts-1];
@@ -2106,6 +2620,8 @@ static PyObject *Logger_last(pyPositionLogger *s, PyObject *o) {
 
 static PyMemberDef Logger_members[] = {
     {(char*)"npts", T_INT, offsetof(pyPositionLogger, npts), READONLY},
+    {(char*)"tolerance", T_DOUBLE, offsetof(pyPositionLogger, tolerance), 0,
+        (char*)"How far older points may move when the plot is thinned"},
     {0, 0, 0, 0},
 };
 
@@ -2210,6 +2726,8 @@ initlinuxcnc(void) {
 
     PyType_Ready(&PositionLoggerType);
     PyModule_AddObject(m, "positionlogger", (PyObject*)&PositionLoggerType);
+    PyType_Ready(&PreviewLinesType);
+    PyModule_AddObject(m, "preview_lines", (PyObject*)&PreviewLinesType);
     pthread_mutex_init(&mutex, NULL);
 
     PyModule_AddStringConstant(m, "nmlfile", EMC2_DEFAULT_NMLFILE);
@@ -2228,6 +2746,12 @@ initlinuxcnc(void) {
     ENUMX(4, EMC_LINEAR);
     ENUMX(4, EMC_ANGULAR);
 
+    ENUMX(4, EMC_STAT_TASK);
+    ENUMX(4, EMC_STAT_TRAJ);
+    ENUMX(4, EMC_STAT_JOINTS);
+    ENUMX(4, EMC_STAT_IO);
+    ENUMX(4, EMC_STAT_TOOL);
+
     ENUMX(9, EMC_TASK_INTERP_IDLE);
     ENUMX(9, EMC_TASK_INTERP_READING);
     ENUMX(9, EMC_TASK_INTERP_PAUSED);
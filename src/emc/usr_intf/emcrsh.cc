@@ -27,7 +27,6 @@
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <netinet/in.h>
-#include <pthread.h>
 #include <errno.h>
 
 #include <getopt.h>
@@ -42,6 +41,7 @@
 #include "rcs_print.hh"
 #include "timer.hh"             // etime()
 #include "shcom.hh"             // NML Messaging functions
+#include "sockets.h"            // sockServe()
 
 /*
   Using emcrsh:
@@ -61,7 +61,7 @@
             Make sure to include the final slash (/).
   With -- -ini <inifile>, uses inifile instead of emc.ini. 
 
-  There are six commands supported, Where the commands set and get contain EMC
+  There are eight commands supported, Where the commands set and get contain EMC
   specific sub-commands based on the commands supported by emcsh, but where the "emc_"
   is omitted. Commands and most parameters are not case sensitive. The exceptions are 
   passwords, file paths and text strings.
@@ -101,6 +101,26 @@
   command may only be issued if the Hello has been successfully negotiated and the
   connection has control of the CNC (see enable sub-command below). This command
   has no parameters.
+
+  All the connections are served by one thread, so the commands of each
+  are carried out in turn, and the status is read once a tick for all of
+  them rather than once for each GET. A connection that doesn't read its
+  replies isn't listened to until it has caught up.
+  
+  ==> Subscribe <==
+  
+  Subscribe <period> [change] <sub-command> [<sub-command> ...]
+  Has the server send, every <period> milliseconds, the replies get would
+  give to each of the sub-commands, which must be ones that report status
+  and take no parameters. With change, only replies that differ from the
+  ones last sent are sent. The status is read once for every connection
+  due, not once for each. The server responds with SUBSCRIBE ACK, or
+  SUBSCRIBE NAK if Hello has not been negotiated or a sub-command cannot
+  be subscribed to; a new Subscribe replaces the old.
+  
+  ==> Unsubscribe <==
+  
+  Stops the updates of Subscribe. The server responds with UNSUBSCRIBE ACK.
   
   ==> Help <==
   
@@ -421,7 +441,8 @@
 // EMC_STAT *emcStatus;
 
 typedef enum {
-  cmdHello, cmdSet, cmdGet, cmdQuit, cmdShutdown, cmdHelp, cmdUnknown} commandTokenType;
+  cmdHello, cmdSet, cmdGet, cmdQuit, cmdShutdown, cmdHelp, cmdSubscribe,
+  cmdUnsubscribe, cmdUnknown} commandTokenType;
   
 typedef enum {
   scEcho, scVerbose, scEnable, scConfig, scCommMode, scCommProt, scIniFile,
@@ -442,6 +463,19 @@ typedef enum {
 typedef enum {
   rtNoError, rtHandledNoError, rtStandardError, rtCustomError, rtCustomHandledError
   } cmdResponseType;
+
+#define MAX_SUB_ITEMS 32
+#define MAX_SUBSCRIBERS 64
+#define SUB_TICK 0.010
+
+// What a connection asked SUBSCRIBE for, and what it was last sent
+typedef struct {
+  int count;
+  setCommandType item[MAX_SUB_ITEMS];
+  char last[MAX_SUB_ITEMS][256];
+  double period;
+  bool onChange;
+  double due;} subscriptionType;
   
 typedef struct {  
   int cliSock;
@@ -455,13 +489,13 @@ typedef struct {
   int commProt;
   char inBuf[256];
   char outBuf[4096];
-  char progName[256];} connectionRecType;
+  char progName[256];
+  subscriptionType sub;} connectionRecType;
 
 int port = 5007;
-int server_sockfd, client_sockfd;
-socklen_t server_len, client_len;
+int server_sockfd;
+socklen_t server_len;
 struct sockaddr_in server_address;
-struct sockaddr_in client_address;
 bool useSockets = true;
 int tokenIdx;
 const char *delims = " \n\r\0";
@@ -469,8 +503,8 @@ int enabledConn = -1;
 char pwd[16] = "EMC\0";
 char enablePWD[16] = "EMCTOO\0";
 char serverName[24] = "EMCNETSVR\0";
-int sessions = 0;
 int maxSessions = -1;
+connectionRecType *subscribers[MAX_SUBSCRIBERS];
 
 const char *setCommands[] = {
   "ECHO", "VERBOSE", "ENABLE", "CONFIG", "COMM_MODE", "COMM_PROT", "INIFILE", "PLAT", "INI", "DEBUG",
@@ -487,7 +521,8 @@ const char *setCommands[] = {
   "PROBE_VALUE", "PROBE", "TELEOP_ENABLE", "KINEMATICS_TYPE", "OVERRIDE_LIMITS", 
   "SPINDLE_OVERRIDE", "OPTIONAL_STOP", ""};
 
-const char *commands[] = {"HELLO", "SET", "GET", "QUIT", "SHUTDOWN", "HELP", ""};
+const char *commands[] = {"HELLO", "SET", "GET", "QUIT", "SHUTDOWN", "HELP",
+  "SUBSCRIBE", "UNSUBSCRIBE", ""};
 
 struct option longopts[] = {
   {"help", 0, NULL, 'h'},
@@ -567,7 +602,7 @@ static void sigQuit(int sig)
 static int sockWrite(connectionRecType *context)
 {
    strcat(context->outBuf, "\r\n");
-   return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+   return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
 }
 
 static setCommandType lookupSetCommand(char *s)
@@ -1198,13 +1233,13 @@ int commandSet(connectionRecType *context)
   
   pch = strtok(NULL, delims);
   if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
+    return sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
     }
   strupr(pch);
   cmd = lookupSetCommand(pch);
   if ((cmd >= scIniFile) && (context->cliSock != enabledConn)) {
     sprintf(context->outBuf, setCmdNakStr, pch);
-    return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
     }
   if ((cmd > scMachine) && (emcStatus->task.state != EMC_TASK_STATE_ON)) {
 //  Extra check in the event of an undetected change in Machine state resulting in
@@ -1212,7 +1247,7 @@ int commandSet(connectionRecType *context)
 //  and appropriate error messages are generated, however erratic behavior has been
 //  seen when doing certain set commands when the Machine state is other than 'On'.
     sprintf(context->outBuf, setCmdNakStr, pch);
-    return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
     }
   switch (cmd) {
     case scEcho: ret = setEcho(strtok(NULL, delims), context); break;
@@ -1297,17 +1332,17 @@ int commandSet(connectionRecType *context)
     case rtNoError:  
       if (context->verbose) {
         sprintf(context->outBuf, ackStr, pch);
-        return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+        return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
         }
       break;
     case rtHandledNoError: // Custom ok response already handled, take no action
       break; 
     case rtStandardError:
       sprintf(context->outBuf, setCmdNakStr, pch);
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomError: // Custom error response entered in buffer
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomHandledError: ;// Custom error respose handled, take no action
     }
@@ -2248,23 +2283,12 @@ static cmdResponseType getOptionalStop(char *s, connectionRecType *context)
   return rtNoError;
 }
 
-int commandGet(connectionRecType *context)
+// Puts the reply to GET <pch> [<arg>] in context->outBuf
+static cmdResponseType getItem(setCommandType cmd, char *pch, char *arg,
+  connectionRecType *context)
 {
-  const static char *setNakStr = "GET NAK\r\n";
-  const static char *setCmdNakStr = "GET %s NAK\r\n";
-  setCommandType cmd;
-  char *pch;
   cmdResponseType ret = rtNoError;
-  
-  pch = strtok(NULL, delims);
-  if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
-    }
-  if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
-  strupr(pch);
-  cmd = lookupSetCommand(pch);
-  if (cmd > scIni)
-    if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
+
   switch (cmd) {
     case scEcho: ret = getEcho(pch, context); break;
     case scVerbose: ret = getVerbose(pch, context); break;
@@ -2301,15 +2325,15 @@ int commandGet(connectionRecType *context)
     case scJog: ret = rtStandardError; break;
     case scJogIncr: ret = rtStandardError; break;
     case scFeedOverride: ret = getFeedOverride(pch, context); break;
-    case scAbsCmdPos: ret = getAbsCmdPos(strtok(NULL, delims), context); break;
-    case scAbsActPos: ret = getAbsActPos(strtok(NULL, delims), context); break;
-    case scRelCmdPos: ret = getRelCmdPos(strtok(NULL, delims), context); break;
-    case scRelActPos: ret = getRelActPos(strtok(NULL, delims), context); break;
-    case scJointPos: ret = getJointPos(strtok(NULL, delims), context); break;
-    case scPosOffset: ret = getPosOffset(strtok(NULL, delims), context); break;
-    case scJointLimit: ret = getJointLimit(strtok(NULL, delims), context); break;
-    case scJointFault: ret = getJointFault(strtok(NULL, delims), context); break;
-    case scJointHomed: ret = getJointHomed(strtok(NULL, delims), context); break;
+    case scAbsCmdPos: ret = getAbsCmdPos(arg, context); break;
+    case scAbsActPos: ret = getAbsActPos(arg, context); break;
+    case scRelCmdPos: ret = getRelCmdPos(arg, context); break;
+    case scRelActPos: ret = getRelActPos(arg, context); break;
+    case scJointPos: ret = getJointPos(arg, context); break;
+    case scPosOffset: ret = getPosOffset(arg, context); break;
+    case scJointLimit: ret = getJointLimit(arg, context); break;
+    case scJointFault: ret = getJointFault(arg, context); break;
+    case scJointHomed: ret = getJointHomed(arg, context); break;
     case scMDI: ret = rtStandardError; break;
     case scTskPlanInit: ret = rtStandardError; break;
     case scOpen: ret = rtStandardError; break;
@@ -2322,8 +2346,8 @@ int commandGet(connectionRecType *context)
     case scProgramLine: ret = getProgramLine(pch, context); break;
     case scProgramStatus: ret = getProgramStatus(pch, context); break;
     case scProgramCodes: ret = getProgramCodes(pch, context); break;
-    case scJointType: ret = getJointType(strtok(NULL, delims), context); break;
-    case scJointUnits: ret = getJointUnits(strtok(NULL, delims), context); break;
+    case scJointType: ret = getJointType(arg, context); break;
+    case scJointUnits: ret = getJointUnits(arg, context); break;
     case scProgramUnits: 
     case scProgramLinearUnits: ret = getProgramLinearUnits(pch, context); break;
     case scProgramAngularUnits: ret = getProgramAngularUnits(pch, context); break;
@@ -2344,6 +2368,25 @@ int commandGet(connectionRecType *context)
     case scOptionalStop: ret = getOptionalStop(pch, context); break;
     case scUnknown: ret = rtStandardError;
     }
+  return ret;
+}
+
+int commandGet(connectionRecType *context)
+{
+  const static char *setNakStr = "GET NAK\r\n";
+  const static char *setCmdNakStr = "GET %s NAK\r\n";
+  setCommandType cmd;
+  char *pch;
+  cmdResponseType ret = rtNoError;
+  
+  pch = strtok(NULL, delims);
+  if (pch == NULL) {
+    return sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
+    }
+  // the status was read this tick, by serverTick()
+  strupr(pch);
+  cmd = lookupSetCommand(pch);
+  ret = getItem(cmd, pch, strtok(NULL, delims), context);
   switch (ret) {
     case rtNoError: // Standard ok response, just write value in buffer
       sockWrite(context);
@@ -2386,6 +2429,8 @@ static int helpGeneral(connectionRecType *context)
   strcat(context->outBuf, "  Get <emc command>\n\r");
   strcat(context->outBuf, "  Set <emc command>\n\r");
   strcat(context->outBuf, "  Shutdown\n\r");
+  strcat(context->outBuf, "  Subscribe <period ms> [Change] <emc command> ...\n\r");
+  strcat(context->outBuf, "  Unsubscribe\n\r");
   strcat(context->outBuf, "  Help <command>\n\r");
   sockWrite(context);
   return 0;
@@ -2550,6 +2595,21 @@ static int helpShutdown(connectionRecType *context)
   return 0;
 }
 
+static int helpSubscribe(connectionRecType *context)
+{
+  sprintf(context->outBuf, "Usage:\n\r");
+  strcat(context->outBuf, "  Subscribe <Period> [Change] <EMC Command> [<EMC Command> ...]\n\rWhere:\n\r");
+  strcat(context->outBuf, "  Period is how often, in milliseconds, the server sends the reply\n\r");
+  strcat(context->outBuf, "  Get would give to each EMC Command, one per line, without being asked.\n\r");
+  strcat(context->outBuf, "  With Change, only the replies that differ from those last sent are sent.\n\r");
+  strcat(context->outBuf, "  EMC Commands are those of Get that report the state of EMC, without\n\r");
+  strcat(context->outBuf, "  parameters; Error, Operator_Display and Operator_Text are not allowed.\n\r");
+  strcat(context->outBuf, "  A new Subscribe replaces the last one, and Unsubscribe ends it.\n\r");
+  strcat(context->outBuf, "  Requires that Hello has been negotiated.\n\r");
+  sockWrite(context);
+  return 0;
+}
+
 static int helpHelp(connectionRecType *context)
 {
   sprintf(context->outBuf, "If you need help on help, it is time to look into another line of work.\n\r");
@@ -2557,6 +2617,141 @@ static int helpHelp(connectionRecType *context)
   return 0;
 }
 
+// Items that can be subscribed to: what GET reports of the status, less the
+// messages, which GET takes off the queue, the per connection settings and
+// the names GET accepts but says nothing to
+static bool subscribable(setCommandType cmd)
+{
+  cmdResponseType ret;
+  connectionRecType *scratch;
+
+  if ((cmd <= scIni) || (cmd == scError) || (cmd == scOperatorDisplay) ||
+      (cmd == scOperatorText) || (cmd == scWait) || (cmd == scUpdate) ||
+      (cmd == scProbeClear) || (cmd == scProbe) || (cmd == scUnknown))
+    return false;
+  scratch = (connectionRecType *) malloc(sizeof(connectionRecType));
+  ret = getItem(cmd, (char *) setCommands[cmd], NULL, scratch);
+  free(scratch);
+  return ret == rtNoError;
+}
+
+static void removeSubscriber(connectionRecType *context)
+{
+  int i;
+
+  for (i = 0; i < MAX_SUBSCRIBERS; i++)
+    if (subscribers[i] == context) subscribers[i] = NULL;
+  context->sub.count = 0;
+}
+
+int commandSubscribe(connectionRecType *context)
+{
+  static const char *subNakStr = "SUBSCRIBE NAK\r\n";
+  static const char *subAckStr = "SUBSCRIBE ACK\r\n";
+  subscriptionType sub;
+  setCommandType cmd;
+  char *pch;
+  int i, slot;
+
+  pch = strtok(NULL, delims);
+  if ((!context->linked) || (pch == NULL) || (sscanf(pch, "%lf", &sub.period) != 1) ||
+      (sub.period <= 0))
+    return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+  sub.period /= 1000.0;
+  if (sub.period < SUB_TICK) sub.period = SUB_TICK;
+  sub.onChange = false;
+  sub.count = 0;
+  sub.due = 0;
+  while ((pch = strtok(NULL, delims)) != NULL) {
+    strupr(pch);
+    if ((sub.count == 0) && (!sub.onChange) && (strcmp(pch, "CHANGE") == 0)) {
+      sub.onChange = true;
+      continue;
+      }
+    cmd = lookupSetCommand(pch);
+    if ((sub.count == MAX_SUB_ITEMS) || (!subscribable(cmd)))
+      return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+    sub.last[sub.count][0] = 0;
+    sub.item[sub.count++] = cmd;
+    }
+  if (sub.count == 0)
+    return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+  slot = -1;
+  for (i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if (subscribers[i] == context) break;
+    if ((subscribers[i] == NULL) && (slot == -1)) slot = i;
+    }
+  if ((i == MAX_SUBSCRIBERS) && (slot == -1))
+    return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+  if (i == MAX_SUBSCRIBERS) subscribers[slot] = context;
+  context->sub = sub;
+  return sockQueue(context->cliSock, subAckStr, strlen(subAckStr));
+}
+
+int commandUnsubscribe(connectionRecType *context)
+{
+  static const char *unsubAckStr = "UNSUBSCRIBE ACK\r\n";
+
+  removeSubscriber(context);
+  return sockQueue(context->cliSock, unsubAckStr, strlen(unsubAckStr));
+}
+
+// Sends each subscriber that is due the replies GET would give for its
+// items, or under CHANGE those of them that differ from what it was last
+// sent, all in one go.  The status was read once this tick, so they all
+// show the same moment, and each item is put into words once, however
+// many connections want it.  A connection that hasn't taken what it was
+// sent last time is tried again next tick.
+static void publishStatus(double now)
+{
+  static connectionRecType scratch;
+  static char cache[scUnknown][sizeof(scratch.outBuf)];
+  static bool cached[scUnknown];
+  char buf[MAX_SUB_ITEMS * 256];
+  subscriptionType *sub;
+  int i, n, cmd;
+  size_t len;
+
+  memset(cached, 0, sizeof(cached));
+  for (i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if ((subscribers[i] == NULL) || (subscribers[i]->sub.due > now)) continue;
+    if (sockPending(subscribers[i]->cliSock) > 0) continue;
+    sub = &subscribers[i]->sub;
+    len = 0;
+    for (n = 0; n < sub->count; n++) {
+      cmd = sub->item[n];
+      if (!cached[cmd]) {
+        getItem(sub->item[n], (char *) setCommands[cmd], NULL, &scratch);
+        strcpy(cache[cmd], scratch.outBuf);
+        cached[cmd] = true;
+        }
+      if (sub->onChange && (strcmp(cache[cmd], sub->last[n]) == 0)) continue;
+      if (len + strlen(cache[cmd]) + 3 > sizeof(buf)) break;
+      len += sprintf(buf + len, "%s\r\n", cache[cmd]);
+      if (strlen(cache[cmd]) < sizeof(sub->last[n]))
+        strcpy(sub->last[n], cache[cmd]);
+      else sub->last[n][0] = 0;
+      }
+    if (len) sockQueue(subscribers[i]->cliSock, buf, len);
+    sub->due += sub->period;
+    if (sub->due <= now) sub->due = now + sub->period;
+    }
+}
+
+// Once a tick: the one read of the status that GET and the subscriptions
+// of every connection use
+static void serverTick(void)
+{
+  double now = etime();
+  bool due = false;
+  int i;
+
+  for (i = 0; i < MAX_SUBSCRIBERS; i++)
+    if ((subscribers[i] != NULL) && (subscribers[i]->sub.due <= now)) due = true;
+  if (due || (emcUpdateType == EMC_UPDATE_AUTO)) updateStatus();
+  if (due) publishStatus(now);
+}
+
 int commandHelp(connectionRecType *context)
 {
   char *pch;
@@ -2570,6 +2765,8 @@ int commandHelp(connectionRecType *context)
   if (strcmp(pch, "QUIT") == 0) return (helpQuit(context));
   if (strcmp(pch, "SHUTDOWN") == 0) return (helpShutdown(context));
   if (strcmp(pch, "HELP") == 0) return (helpHelp(context));
+  if ((strcmp(pch, "SUBSCRIBE") == 0) || (strcmp(pch, "UNSUBSCRIBE") == 0))
+    return (helpSubscribe(context));
   sprintf(context->outBuf, "%s is not a valid command.", pch);
   sockWrite(context);
   return 0;
@@ -2607,15 +2804,15 @@ int parseCommand(connectionRecType *context)
     switch (lookupToken(pch)) {
       case cmdHello: 
         if (commandHello(context) == -1)
-          ret = write(context->cliSock, helloNakStr, strlen(helloNakStr));
-        else ret = write(context->cliSock, s, strlen(s));
+          ret = sockQueue(context->cliSock, helloNakStr, strlen(helloNakStr));
+        else ret = sockQueue(context->cliSock, s, strlen(s));
         break;
       case cmdGet: 
         ret = commandGet(context);
         break;
       case cmdSet:
         if (!context->linked)
-	  ret = write(context->cliSock, setNakStr, strlen(setNakStr));
+	  ret = sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
         else ret = commandSet(context);
         break;
       case cmdQuit: 
@@ -2624,30 +2821,31 @@ int parseCommand(connectionRecType *context)
       case cmdShutdown:
         ret = commandShutdown(context);
         if(ret ==0){
-          ret = write(context->cliSock, shutdownNakStr, strlen(shutdownNakStr));
+          ret = sockQueue(context->cliSock, shutdownNakStr, strlen(shutdownNakStr));
         }
 	break;
       case cmdHelp:
         ret = commandHelp(context);
 	break;
+      case cmdSubscribe:
+        ret = commandSubscribe(context);
+        break;
+      case cmdUnsubscribe:
+        ret = commandUnsubscribe(context);
+        break;
       case cmdUnknown: ret = -2;
       }
     }
   return ret;
 }  
 
-void *readClient(void *arg)
+static void *openClient(int fd)
 {
-  char str[1600];
-  char buf[1600];
-  unsigned int i, j;
-  int len;
   connectionRecType *context;
-  
-  signal(SIGPIPE, SIG_IGN);
-  
+
   context = (connectionRecType *) malloc(sizeof(connectionRecType));
-  context->cliSock = client_sockfd;
+  if (context == NULL) return NULL;
+  context->cliSock = fd;
   context->linked = false;
   context->echo = true;
   context->verbose = false;
@@ -2657,64 +2855,46 @@ void *readClient(void *arg)
   context->commMode = 0;
   context->commProt = 0;
   context->inBuf[0] = 0;
-  buf[0] = 0;
-  
-  while (1) {
-    len = read(context->cliSock, &str, 1600);
-    if (len <= 0) goto finished;
-    str[len] = 0;
-    strcat(buf, str);
-    if ((!memchr(str, '\r', strlen(str))) && (!memchr(str, '\n', strlen(str)))) continue;
-    if (context->echo && context->linked)
-      if(write(context->cliSock, buf, strlen(buf)) != (ssize_t)strlen(buf)) {
-        fprintf(stderr, "emcrsh: write() failed: %s", strerror(errno));
-      }
-    i = 0;
-    j = 0;
-    while (i <= strlen(buf)) {
-      if ((buf[i] != '\n') && (buf[i] != '\r')) {
-        context->inBuf[j] = buf[i];
-	j++;
-	}
-      else
-        if (j > 0)
-          {
-  	    context->inBuf[j] = 0;
-            if (parseCommand(context) == -1) goto finished;
-	    j = 0;
-	}
-        i++;	
-      }
-    buf[0] = 0;
-    } 
+  context->sub.count = 0;
+  return context;
+}
+
+static int readClient(void *conn, char *line)
+{
+  connectionRecType *context = (connectionRecType *) conn;
+
+  if (context->echo && context->linked) {
+    sockQueue(context->cliSock, line, strlen(line));
+    sockQueue(context->cliSock, "\r\n", 2);
+    }
+  strncpy(context->inBuf, line, sizeof(context->inBuf) - 1);
+  context->inBuf[sizeof(context->inBuf) - 1] = 0;
+  return parseCommand(context) == -1 ? -1 : 0;
+}
 
-finished:
-  close(context->cliSock);
+static void closeClient(void *conn)
+{
+  connectionRecType *context = (connectionRecType *) conn;
+
+  removeSubscriber(context);
+  if (context->cliSock == enabledConn) enabledConn = -1;
   free(context);
-  pthread_exit((void *)0);
-  sessions--;  // FIXME: not reached
 }
 
 int sockMain()
 {
-    pthread_t thrd;
-    int res;
-    
-    while (1) {
-      
-      client_len = sizeof(client_address);
-      client_sockfd = accept(server_sockfd,
-        (struct sockaddr *)&client_address, &client_len);
-      if (client_sockfd < 0) exit(0);
-      sessions++;
-      if ((maxSessions == -1) || (sessions <= maxSessions))
-        res = pthread_create(&thrd, NULL, readClient, (void *)NULL);
-      else res = -1;
-      if (res != 0) {
-        close(client_sockfd);
-        sessions--;
-        }
-     }
+    sockServerType server;
+
+    signal(SIGPIPE, SIG_IGN);
+    server.listenFd = server_sockfd;
+    server.maxSessions = maxSessions;
+    server.tick = SUB_TICK;
+    server.outMax = sizeof(((connectionRecType *) 0)->outBuf);
+    server.onOpen = openClient;
+    server.onLine = readClient;
+    server.onClose = closeClient;
+    server.onTick = serverTick;
+    if (sockServe(&server) != 0) exit(1);
     return 0;
 }
 
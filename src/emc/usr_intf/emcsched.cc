@@ -22,6 +22,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <list>
 #include <stdint.h>
 
@@ -60,6 +61,7 @@ class SchedEntry {
     float feedOverride;
     float spindleOverride;
     int tool;
+    int checked;		// 0 not yet, 1 ready to run, -1 can't run
 
   public:
     SchedEntry();
@@ -83,6 +85,8 @@ class SchedEntry {
     void setSpindleOverride(float s);
     int getTool() const;
     void setTool(int t);
+    int getChecked() const;
+    void setChecked(int c);
   };
 
 SchedEntry::SchedEntry() {
@@ -96,6 +100,7 @@ SchedEntry::SchedEntry() {
     feedOverride = 100.0;
     spindleOverride = 100.0;
     tool = 1;
+    checked = 0;
   }
 
 list<SchedEntry> q;
@@ -187,6 +192,14 @@ void SchedEntry::setTool(int t) {
   tool = t;
   }
 
+int SchedEntry::getChecked() const {
+  return checked;
+  }
+
+void SchedEntry::setChecked(int c) {
+  checked = c;
+  }
+
 static void crcInit() {
   crc rmdr;
   int i;
@@ -245,11 +258,62 @@ bool interlocksOk() {
   return true;
 }
 
+static bool toolAvailable(int tool) {
+  if (tool <= 0) return true;   // the job asks for no particular tool
+  if (emcStatus->io.tool.toolInSpindle == tool) return true;
+  for (int i = 0; i < CANON_POCKETS_MAX; i++)
+    if (emcStatus->io.tool.toolTable[i].toolno == tool) return true;
+  return false;
+}
+
+/*
+  checkNext() looks at the job to run next while the current one runs, so
+  that a missing file or tool shows up before the machine gets to it and
+  starting the job doesn't wait on the disk: the file is read through
+  once, which leaves it in the page cache for task's interpreter.
+  Returns the job's checked state.
+  */
+static int checkNext(SchedEntry &e) {
+  char fileStr[255];
+  char buf[8192];
+  int fd;
+  ssize_t n;
+
+  if (e.getChecked() != 0) return e.getChecked();
+  snprintf(fileStr, sizeof(fileStr), "%s%s", defaultPath, e.getFileName().c_str());
+  fd = open(fileStr, O_RDONLY);
+  if (fd < 0) {
+    rcs_print_error("emcsched: can't open %s for tag %d\n", fileStr, e.getTagId());
+    e.setChecked(-1);
+    return -1;
+    }
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {}
+  close(fd);
+  if (n < 0) {
+    rcs_print_error("emcsched: can't read %s for tag %d\n", fileStr, e.getTagId());
+    e.setChecked(-1);
+    return -1;
+    }
+  if (!toolAvailable(e.getTool())) {
+    rcs_print_error("emcsched: tool %d for tag %d is not in the tool table\n",
+      e.getTool(), e.getTagId());
+    e.setChecked(-1);
+    return -1;
+    }
+  e.setChecked(1);
+  return 1;
+}
+
+bool queueBusy() {
+  return queueStatus == qsRun && !isIdle();
+}
+
 void updateQueue() {
   char fileStr[255];
   float x, y, z;
   char cmd[80];
 
+  updateStatus();
   if (queueStatus == qsRun) {
     if (isIdle() && q.empty()) {
       queueStatus = qsStop;
@@ -258,6 +322,13 @@ void updateQueue() {
     if (!q.empty()) {
       if (isIdle()) {
         q.front().setPriority(MAX_PRIORITY); // Lock job as first job
+        // the tool table may have changed since it was looked at
+        if (q.front().getChecked() == 1 && !toolAvailable(q.front().getTool()))
+          q.front().setChecked(-1);
+        if (checkNext(q.front()) < 0) {
+          queueStatus = qsError;
+          return;
+          }
         if (interlocksOk()) {
           sendFeedOverride(((double) q.front().getFeedOverride()) / 100.0);
           sendSpindleOverride(((double) q.front().getSpindleOverride()) / 100.0);             
@@ -315,6 +386,7 @@ void updateQueue() {
           }
         else queueStatus = qsError;
         } 
+      else checkNext(q.front());
       }
     }
   }
@@ -351,6 +423,9 @@ int getStatus() {
   }
 
 void queueStart() {
+  // look at every job again, in case what was wrong has been put right
+  for (list<SchedEntry>::iterator i = q.begin(); i != q.end(); ++i)
+    i->setChecked(0);
   setQueueStatus(qsRun);
   }
 
@@ -39,6 +39,7 @@ typedef struct {
 
 extern int addProgram(int pri, int tag, float x, float y, float z, int azone, string progName, float feedOvr, float spindleOvr, int toolNum);
 extern void updateQueue();
+extern bool queueBusy();
 extern int getQueueSize();
 extern void clearQueue();
 extern int getStatus();
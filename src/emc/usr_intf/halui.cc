@@ -381,6 +381,28 @@ static int num_mdi_commands=0;
 static int have_home_all = 0;
 
 static int comp_id, done;				/* component ID, main while loop */
+static hal_watch_t *halui_watch;		/* wakes main loop on input changes */
+static bool halui_new_status = true;		/* output pins need updating */
+
+// how long the main loop waits for an input to change before it looks
+// for a new status; NML has no way to wake it when one is written, but
+// looking and finding none costs next to nothing
+#define HALUI_STATUS_NS 10000000
+
+// An input pin that sends one command when it goes true.  These are
+// most of halui's inputs; the table of them is made once the pins are
+// exported, and the pins whose input needs more than that are looked
+// at in check_hal_changes.
+struct halui_edge {
+    hal_bit_t *pin;
+    bool *old;
+    int (*send)(int arg);
+    int arg;
+};
+
+#define MAX_EDGES (40 + 2 * EMCMOT_MAX_JOINTS + MDI_MAX)
+static halui_edge halui_edges[MAX_EDGES];
+static int num_halui_edges = 0;
 
 static int num_axes = 3; //number of axes, taken from the ini [TRAJ] section
 static int num_joints = 3; //number of joints, taken from the ini [KINS] section
@@ -537,7 +559,10 @@ static int updateStatus()
 	break;
 
     case 0:			// no new data
+	break;
+
     case EMC_STAT_TYPE:	// new data
+	halui_new_status = true;
 	break;
 
     default:
@@ -552,59 +577,75 @@ static int updateStatus()
 #define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
 
 /*
+  waitStatus() waits up to timeout seconds for task to write the status
+  buffer again.  On a SHMEM buffer the read wakes as soon as the write
+  lands; if the channel can't block, it sleeps and peeks as before.
+
   emcCommandWaitReceived() waits until the EMC reports that it got
   the command with the indicated serial_number.
   emcCommandWaitDone() waits until the EMC reports that it got the
   command with the indicated serial_number, and it's done, or error.
 */
 
-static int emcCommandWaitReceived(int serial_number)
+static void waitStatus(double timeout)
 {
-    double end = 0.0;
+    NMLTYPE type;
 
-    while (end < receiveTimeout) {
+    if (0 == emcStatus || 0 == emcStatusBuffer
+	|| !emcStatusBuffer->valid()
+	|| (type = emcStatusBuffer->blocking_read(timeout)) < 0) {
+	esleep(fmin(timeout, EMC_COMMAND_DELAY));
 	updateStatus();
+	return;
+    }
+    if (type == EMC_STAT_TYPE) {
+	halui_new_status = true;
+    }
+}
 
-	if (emcStatus->echo_serial_number == serial_number) {
-	    return 0;
-	}
+static int emcCommandWaitReceived(int serial_number)
+{
+    double start = etime(), left;
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+    updateStatus();
+    while (!emcStatus->echoed(serial_number)) {
+	left = receiveTimeout - (etime() - start);
+	if (left <= 0.0) {
+	    return -1;
+	}
+	waitStatus(left);
     }
 
-    return -1;
+    return 0;
 }
 
 static int emcCommandWaitDone(int serial_number)
 {
-    double end = 0.0;
+    double start, left;
 
     // first get it there
     if (0 != emcCommandWaitReceived(serial_number)) {
 	return -1;
     }
     // now wait until it, or subsequent command (e.g., abort) is done
-    while (end < doneTimeout) {
-	updateStatus();
-
-	if (emcStatus->status == RCS_DONE) {
-	    return 0;
-	}
-
+    start = etime();
+    while (emcStatus->status != RCS_DONE) {
 	if (emcStatus->status == RCS_ERROR) {
 	    return -1;
 	}
-
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	left = doneTimeout - (etime() - start);
+	if (left <= 0.0) {
+	    return -1;
+	}
+	waitStatus(left);
     }
-    return -1;
+    return 0;
 }
 
 static void thisQuit()
 {
     //don't forget the big HAL sin ;)
+    hal_watch_delete(halui_watch);
     hal_exit(comp_id);
     
     if(emcCommandBuffer) { delete emcCommandBuffer;  emcCommandBuffer = 0; }
@@ -1607,6 +1648,66 @@ static int iniLoad(const char *filename)
     return 0;
 }
 
+template<int (*F)()> static int send_no_arg(int) { return F(); }
+template<int (*F)(bool)> static int send_bool_arg(int arg) { return F(arg); }
+
+static void add_edge(hal_bit_t *pin, bool &old, int (*send)(int), int arg)
+{
+    halui_edge &e = halui_edges[num_halui_edges++];
+
+    e.pin = pin;
+    e.old = &old;
+    e.send = send;
+    e.arg = arg;
+}
+
+static void init_edges()
+{
+    int joint, n;
+
+#define EDGE(f, send, arg) add_edge(halui_data->f, old_halui_data.f, send, arg)
+    EDGE(machine_on, send_no_arg<sendMachineOn>, 0);
+    EDGE(machine_off, send_no_arg<sendMachineOff>, 0);
+    EDGE(estop_activate, send_no_arg<sendEstop>, 0);
+    EDGE(estop_reset, send_no_arg<sendEstopReset>, 0);
+    EDGE(mode_manual, send_no_arg<sendManual>, 0);
+    EDGE(mode_auto, send_no_arg<sendAuto>, 0);
+    EDGE(mode_mdi, send_no_arg<sendMdi>, 0);
+    EDGE(mode_teleop, send_no_arg<sendTeleop>, 0);
+    EDGE(mode_joint, send_no_arg<sendJoint>, 0);
+    EDGE(mist_on, send_no_arg<sendMistOn>, 0);
+    EDGE(mist_off, send_no_arg<sendMistOff>, 0);
+    EDGE(flood_on, send_no_arg<sendFloodOn>, 0);
+    EDGE(flood_off, send_no_arg<sendFloodOff>, 0);
+    EDGE(lube_on, send_no_arg<sendLubeOn>, 0);
+    EDGE(lube_off, send_no_arg<sendLubeOff>, 0);
+    EDGE(program_run, sendProgramRun, 0);
+    EDGE(program_pause, send_no_arg<sendProgramPause>, 0);
+    EDGE(program_os_on, send_bool_arg<sendSetOptionalStop>, ON);
+    EDGE(program_os_off, send_bool_arg<sendSetOptionalStop>, OFF);
+    EDGE(program_bd_on, send_bool_arg<sendSetBlockDelete>, ON);
+    EDGE(program_bd_off, send_bool_arg<sendSetBlockDelete>, OFF);
+    EDGE(program_resume, send_no_arg<sendProgramResume>, 0);
+    EDGE(program_step, send_no_arg<sendProgramStep>, 0);
+    EDGE(program_stop, send_no_arg<sendAbort>, 0);
+    EDGE(spindle_start, send_no_arg<sendSpindleForward>, 0);
+    EDGE(spindle_stop, send_no_arg<sendSpindleOff>, 0);
+    EDGE(spindle_forward, send_no_arg<sendSpindleForward>, 0);
+    EDGE(spindle_reverse, send_no_arg<sendSpindleReverse>, 0);
+    EDGE(spindle_brake_on, send_no_arg<sendBrakeEngage>, 0);
+    EDGE(spindle_brake_off, send_no_arg<sendBrakeRelease>, 0);
+    EDGE(abort, send_no_arg<sendAbort>, 0);
+    EDGE(home_all, sendHome, -1);
+    for (joint = 0; joint < num_joints; joint++) {
+	EDGE(joint_home[joint], sendHome, joint);
+	EDGE(joint_unhome[joint], sendUnhome, joint);
+    }
+    for (n = 0; n < num_mdi_commands; n++) {
+	EDGE(mdi_commands[n], sendMdiCommand, n);
+    }
+#undef EDGE
+}
+
 static void hal_init_pins()
 {
     int joint;
@@ -1674,79 +1775,11 @@ static void check_hal_changes()
     copy_hal_data(*halui_data, new_halui_data_mutable);
     const local_halui_str &new_halui_data = new_halui_data_mutable;
 
-
-    //check if machine_on pin has changed (the rest work exactly the same)
-    if (check_bit_changed(new_halui_data.machine_on, old_halui_data.machine_on) != 0)
-	sendMachineOn();                //send MachineOn NML command
-    
-    if (check_bit_changed(new_halui_data.machine_off, old_halui_data.machine_off) != 0)
-	sendMachineOff();
-
-    if (check_bit_changed(new_halui_data.estop_activate, old_halui_data.estop_activate) != 0)
-	sendEstop();
-
-    if (check_bit_changed(new_halui_data.estop_reset, old_halui_data.estop_reset) != 0)
-	sendEstopReset();
-
-    if (check_bit_changed(new_halui_data.mode_manual, old_halui_data.mode_manual) != 0)
-	sendManual();
-
-    if (check_bit_changed(new_halui_data.mode_auto, old_halui_data.mode_auto) != 0)
-	sendAuto();
-
-    if (check_bit_changed(new_halui_data.mode_mdi, old_halui_data.mode_mdi) != 0)
-	sendMdi();
-
-    if (check_bit_changed(new_halui_data.mode_teleop, old_halui_data.mode_teleop) != 0)
-	sendTeleop();
-
-    if (check_bit_changed(new_halui_data.mode_joint, old_halui_data.mode_joint) != 0)
-	sendJoint();
-
-    if (check_bit_changed(new_halui_data.mist_on, old_halui_data.mist_on) != 0)
-	sendMistOn();
-
-    if (check_bit_changed(new_halui_data.mist_off, old_halui_data.mist_off) != 0)
-	sendMistOff();
-
-    if (check_bit_changed(new_halui_data.flood_on, old_halui_data.flood_on) != 0)
-	sendFloodOn();
-
-    if (check_bit_changed(new_halui_data.flood_off, old_halui_data.flood_off) != 0)
-	sendFloodOff();
-
-    if (check_bit_changed(new_halui_data.lube_on, old_halui_data.lube_on) != 0)
-	sendLubeOn();
-
-    if (check_bit_changed(new_halui_data.lube_off, old_halui_data.lube_off) != 0)
-	sendLubeOff();
-
-    if (check_bit_changed(new_halui_data.program_run, old_halui_data.program_run) != 0)
-	sendProgramRun(0);
-
-    if (check_bit_changed(new_halui_data.program_pause, old_halui_data.program_pause) != 0)
-	sendProgramPause();
-
-    if (check_bit_changed(new_halui_data.program_os_on, old_halui_data.program_os_on) != 0)
-	sendSetOptionalStop(ON);
-
-    if (check_bit_changed(new_halui_data.program_os_off, old_halui_data.program_os_off) != 0)
-	sendSetOptionalStop(OFF);
-
-    if (check_bit_changed(new_halui_data.program_bd_on, old_halui_data.program_bd_on) != 0)
-	sendSetBlockDelete(ON);
-
-    if (check_bit_changed(new_halui_data.program_bd_off, old_halui_data.program_bd_off) != 0)
-	sendSetBlockDelete(OFF);
-
-    if (check_bit_changed(new_halui_data.program_resume, old_halui_data.program_resume) != 0)
-	sendProgramResume();
-
-    if (check_bit_changed(new_halui_data.program_step, old_halui_data.program_step) != 0)
-	sendProgramStep();
-
-    if (check_bit_changed(new_halui_data.program_stop, old_halui_data.program_stop) != 0)
-	sendAbort();
+    for (int n = 0; n < num_halui_edges; n++) {
+	halui_edge &e = halui_edges[n];
+	if (check_bit_changed(*e.pin, *e.old) != 0)
+	    e.send(e.arg);
+    }
 
     //max-velocity stuff
     counts = new_halui_data.mv_counts;
@@ -1806,18 +1839,6 @@ static void check_hal_changes()
         sendSpindleOverride(new_halui_data.so_value - new_halui_data.so_scale);
 
 //spindle stuff
-    if (check_bit_changed(new_halui_data.spindle_start, old_halui_data.spindle_start) != 0)
-	sendSpindleForward();
-
-    if (check_bit_changed(new_halui_data.spindle_stop, old_halui_data.spindle_stop) != 0)
-	sendSpindleOff();
-
-    if (check_bit_changed(new_halui_data.spindle_forward, old_halui_data.spindle_forward) != 0)
-	sendSpindleForward();
-
-    if (check_bit_changed(new_halui_data.spindle_reverse, old_halui_data.spindle_reverse) != 0)
-	sendSpindleReverse();
-
     bit = new_halui_data.spindle_increase;
     if (bit != old_halui_data.spindle_increase) {
 	if (bit != 0)
@@ -1836,18 +1857,6 @@ static void check_hal_changes()
 	old_halui_data.spindle_decrease = bit;
     }
 
-    if (check_bit_changed(new_halui_data.spindle_brake_on, old_halui_data.spindle_brake_on) != 0)
-	sendBrakeEngage();
-
-    if (check_bit_changed(new_halui_data.spindle_brake_off, old_halui_data.spindle_brake_off) != 0)
-	sendBrakeRelease();
-    
-    if (check_bit_changed(new_halui_data.abort, old_halui_data.abort) != 0)
-	sendAbort();
-    
-    if (check_bit_changed(new_halui_data.home_all, old_halui_data.home_all) != 0)
-	sendHome(-1);
-
 // joint stuff (selection, homing..)
     select_changed = -1; // flag to see if the selected joint changed
 
@@ -1862,12 +1871,6 @@ static void check_hal_changes()
 
     
     for (joint=0; joint < num_joints; joint++) {
-	if (check_bit_changed(new_halui_data.joint_home[joint], old_halui_data.joint_home[joint]) != 0)
-	    sendHome(joint);
-
-	if (check_bit_changed(new_halui_data.joint_unhome[joint], old_halui_data.joint_unhome[joint]) != 0)
-	    sendUnhome(joint);
-
 	bit = new_halui_data.jog_minus[joint];
 	if ((bit != old_halui_data.jog_minus[joint]) || (bit && jog_speed_changed)) {
 	    if (bit != 0)
@@ -1972,11 +1975,6 @@ static void check_hal_changes()
 	    sendJogIncr(js, new_halui_data.jog_speed, -(new_halui_data.jog_increment[num_axes]));
 	old_halui_data.jog_increment_minus[num_axes] = bit;
     }
-
-    for(int n = 0; n < num_mdi_commands; n++) {
-        if (check_bit_changed(new_halui_data.mdi_commands[n], old_halui_data.mdi_commands[n]) != 0)
-            sendMdiCommand(n);
-    }
 }
 
 // this function looks at the received NML status message
@@ -2121,6 +2119,8 @@ static void modify_hal_pins()
 
 int main(int argc, char *argv[])
 {
+    bool inputs_changed;
+
     // process command line args
     if (0 != emcGetArgs(argc, argv)) {
 	rcs_print_error("error in argument list\n");
@@ -2141,6 +2141,14 @@ int main(int argc, char *argv[])
 
     //initialize safe values
     hal_init_pins();
+    init_edges();
+
+    // watch the input pins, so a button press is seen at once
+    halui_watch = hal_watch_new();
+    if (halui_watch && hal_watch_comp(halui_watch, comp_id) < 0) {
+	hal_watch_delete(halui_watch);
+	halui_watch = 0;
+    }
 
     // init NML
     if (0 != tryNml()) {
@@ -2159,12 +2167,26 @@ int main(int argc, char *argv[])
     /* catch SIGTERM too - the run script uses it to shut things down */
     signal(SIGTERM, quit);
 
+    inputs_changed = true;
     while (!done) {
-	check_hal_changes(); //if anything changed send NML messages
+	if (inputs_changed) {
+	    check_hal_changes(); //if anything changed send NML messages
+	}
 
-	modify_hal_pins(); //if status changed modify HAL too
+	// the outputs follow the status, and the selected joint's the
+	// joint-select input; with neither new there is nothing to write
+	if (halui_new_status || inputs_changed) {
+	    halui_new_status = false;
+	    modify_hal_pins();
+	}
 	
-	esleep(0.02); //sleep for a while
+	if (halui_watch) {
+	    //until an input changes, or it is time to look at the status
+	    inputs_changed = hal_watch_wait(halui_watch, HALUI_STATUS_NS) != 0;
+	} else {
+	    esleep(0.02); //sleep for a while
+	    inputs_changed = true;
+	}
 	
 	updateStatus();
     }
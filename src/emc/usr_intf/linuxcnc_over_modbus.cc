@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 #include <pthread.h>
 #include <errno.h>
@@ -46,20 +47,41 @@
 #include "shcom.hh"             // NML Messaging functions
 
 #define MAX_JOINT_NUM           5   // support up to 5 joints
+#define MAX_CLIENTS             8   // TCP clients served at once
+#define IMAGE_REGS              32  // input registers kept in the image
+#define WRITE_QUEUE_LEN         64  // MDI lines waiting to be sent
+#define STATUS_PERIOD           0.01    // seconds between status updates
 
 #define DEBUG			0
 
 /*
   Using linuxcnc_over_modbus:
 
-  TODO ...
+  With --port <port> it is a Modbus/TCP server on that port, taking up to
+  MAX_CLIENTS clients at once; without it a Modbus/RTU slave on the serial
+  line set up in initModbus().
+
+  The input registers are an image of the status, rebuilt once per status
+  update rather than per request, so a read of any block of them is a
+  copy out of the image.  Writes to the holding registers are turned into
+  MDI lines and queued; the queue is sent to task one line at a time from
+  the main loop, so a reply never waits on task.
 */
 
 // global vars for modbus connection:
-static modbus_t            *mb_ctx;
-static modbus_mapping_t    *mb_mapping;
+static modbus_t            *mb_ctx = NULL;
+static modbus_mapping_t    *mb_mapping = NULL;
 static int status_bits[32];
 static int com_ready;
+static int tcp_port = 0;            // 0 for RTU
+static int listen_socket = -1;
+static int clients[MAX_CLIENTS];    // sockets, or -1
+static uint16_t image[IMAGE_REGS];
+
+// MDI lines from register writes waiting to go to task
+static char write_queue[WRITE_QUEUE_LEN][256];
+static int write_head = 0, write_count = 0;
+static double write_sent = 0.0;     // when the last one was sent, or 0
 
 struct option longopts[] = {
   {"help", 0, NULL, 'h'},
@@ -103,9 +125,24 @@ static void thisQuit()
 	emcCommandBuffer = 0;
     }
     
-    modbus_mapping_free(mb_mapping);
-    modbus_close(mb_ctx);
-    modbus_free(mb_ctx);
+    // for RTU the one client is the serial line, closed with the context
+    for (int i = 0; tcp_port && i < MAX_CLIENTS; i++) {
+	if (clients[i] != -1) {
+	    close(clients[i]);
+	}
+    }
+    if (listen_socket != -1) {
+	close(listen_socket);
+    }
+    if (mb_mapping != NULL) {
+	modbus_mapping_free(mb_mapping);
+    }
+    if (mb_ctx != NULL) {
+	if (tcp_port == 0) {
+	    modbus_close(mb_ctx);
+	}
+	modbus_free(mb_ctx);
+    }
 
     printf("finish quit process\n");
 //    Tcl_Exit(0);
@@ -134,45 +171,58 @@ static int initModbus()
     // parity = "N";   // O: odd, E: even, N: none
     server_id = 1;
 
-    printf("modbus_rtu: device='%s', baud=%d, bits=%d, parity='%s', stopbits=%d, verbose=%d\n", device, baud, bits, parity, stopbits, debug);
-
-    /* Initialize Modbus */
-    // serial: 
-    mb_ctx = modbus_new_rtu(device, baud, *parity, bits, stopbits);
-    modbus_set_slave(mb_ctx, server_id);
     for (i = 0; i < 32; i++) {
 	status_bits[i] = 0;
     }
-            
-    // ethernet:
-    // ctx = modbus_new_tcp("127.0.0.1", 1502);
-    // ctx = modbus_new_tcp("10.1.1.138", 1502);
-    
+
+    /* Initialize Modbus */
+    if (tcp_port) {
+	printf("modbus_tcp: port=%d, clients=%d, verbose=%d\n", tcp_port, MAX_CLIENTS, debug);
+	mb_ctx = modbus_new_tcp(NULL, tcp_port);
+    } else {
+	printf("modbus_rtu: device='%s', baud=%d, bits=%d, parity='%s', stopbits=%d, verbose=%d\n", device, baud, bits, parity, stopbits, debug);
+	mb_ctx = modbus_new_rtu(device, baud, *parity, bits, stopbits);
+    }
+
     if (mb_ctx == NULL) {
         fprintf(stderr, "Unable to create the libmodbus context\n");
         return -1;
     }
 
     modbus_set_debug(mb_ctx, debug);
+    modbus_set_slave(mb_ctx, server_id);
 
     mb_mapping = modbus_mapping_new(500, 500, 500, 500);
     if (mb_mapping == NULL) {
         fprintf(stderr, "Failed to allocate the mapping: %s\n",
                 modbus_strerror(errno));
         modbus_free(mb_ctx);
+        mb_ctx = NULL;
         return -1;
     }
 
-    // TCP:
-    // socket = modbus_tcp_listen(ctx, 1);
-    // modbus_tcp_accept(ctx, &socket);
-
-    // RTU:
-    rc = modbus_connect(mb_ctx);
-    if (rc == -1) {
-        fprintf(stderr, "Unable to connect %s\n", modbus_strerror(errno));
-        modbus_free(mb_ctx);
-        return -1;
+    if (tcp_port) {
+	listen_socket = modbus_tcp_listen(mb_ctx, MAX_CLIENTS);
+	if (listen_socket == -1) {
+	    fprintf(stderr, "Unable to listen %s\n", modbus_strerror(errno));
+	    modbus_mapping_free(mb_mapping);
+	    modbus_free(mb_ctx);
+	    mb_mapping = NULL;
+	    mb_ctx = NULL;
+	    return -1;
+	}
+    } else {
+	rc = modbus_connect(mb_ctx);
+	if (rc == -1) {
+	    fprintf(stderr, "Unable to connect %s\n", modbus_strerror(errno));
+	    modbus_mapping_free(mb_mapping);
+	    modbus_free(mb_ctx);
+	    mb_mapping = NULL;
+	    mb_ctx = NULL;
+	    return -1;
+	}
+	// the serial line is the one client
+	clients[0] = modbus_get_socket(mb_ctx);
     }
 
     return 0;
@@ -228,74 +278,140 @@ static inline void com_set_intArray32_to_uint32 (uint16_t *dest, int *ia)
     com_set_uint32 (dest, tmp);
 }
 
-static void parseModbusCommand(const uint8_t *req, int req_length)
+/**
+ * refreshImage() - rebuild the input registers from a status update
+ *
+ * The registers are built in image[] and copied into the mapping in one
+ * go, so each read is answered from the same update.
+ **/
+static void refreshImage()
+{
+#if DEBUG
+    printf("RD REGS\n");
+    printf("queueFull: %d\n", emcStatus->motion.traj.queueFull);
+    printf("inpos: %d\n", emcStatus->motion.traj.inpos);
+    // queue gets updated from tpQueueDepth of control.c
+    printf("queue: %d\n", emcStatus->motion.traj.queue);
+    printf("echo_serial_number: %d\n", emcStatus->echo_serial_number);
+    // EmcPose position;		// current commanded position
+    printf("pos_x: %f\n", emcStatus->motion.traj.position.tran.x);
+    printf("pos_y: %f\n", emcStatus->motion.traj.position.tran.y);
+    printf("pos_z: %f\n", emcStatus->motion.traj.position.tran.z);
+    printf("pos_a: %f\n", emcStatus->motion.traj.position.a);
+    printf("pos_b: %f\n", emcStatus->motion.traj.position.b);
+    // EmcPose actualPosition;	// current actual position, from forward kins
+    printf("actual_pos_x: %f\n", emcStatus->motion.traj.actualPosition.tran.x);
+    printf("actual_pos_y: %f\n", emcStatus->motion.traj.actualPosition.tran.y);
+    printf("actual_pos_z: %f\n", emcStatus->motion.traj.actualPosition.tran.z);
+    printf("actual_pos_a: %f\n", emcStatus->motion.traj.actualPosition.a);
+    printf("actual_pos_b: %f\n", emcStatus->motion.traj.actualPosition.b);
+    printf("sync_di[0]: %d\n", emcStatus->motion.synch_di[0]);
+    printf("sync_di[1]: %d\n", emcStatus->motion.synch_di[1]);
+#endif
+    status_bits[0] = (int) emcStatus->motion.traj.queueFull;
+    status_bits[1] = (int) emcStatus->motion.traj.inpos;
+    status_bits[2] = (int) com_ready;
+
+    com_set_uint32 (image +  0, (uint32_t) emcStatus->motion.traj.queue);
+    com_set_uint32 (image +  2, (uint32_t) emcStatus->echo_serial_number);
+    // EmcPose position;		// current commanded position
+    com_set_float (image +  4, (float) emcStatus->motion.traj.position.tran.x);
+    com_set_float (image +  6, (float) emcStatus->motion.traj.position.tran.y);
+    com_set_float (image +  8, (float) emcStatus->motion.traj.position.tran.z);
+    com_set_float (image + 10, (float) emcStatus->motion.traj.position.a);
+    com_set_float (image + 12, (float) emcStatus->motion.traj.position.b);
+    // EmcPose actualPosition;	// current actual position, from forward kins
+    com_set_float (image + 14, (float) emcStatus->motion.traj.actualPosition.tran.x);
+    com_set_float (image + 16, (float) emcStatus->motion.traj.actualPosition.tran.y);
+    com_set_float (image + 18, (float) emcStatus->motion.traj.actualPosition.tran.z);
+    com_set_float (image + 20, (float) emcStatus->motion.traj.actualPosition.a);
+    com_set_float (image + 22, (float) emcStatus->motion.traj.actualPosition.b);
+    com_set_intArray32_to_uint32 (image + 24, emcStatus->motion.synch_di);
+    com_set_intArray32_to_uint32 (image + 26, emcStatus->motion.synch_di + 32);
+    com_set_intArray32_to_uint32 (image + 28, emcStatus->motion.synch_do);
+    com_set_intArray32_to_uint32 (image + 30, status_bits);
+    memcpy(mb_mapping->tab_input_registers, image, sizeof(image));
+}
+
+/**
+ * queueWrite() - queue an MDI line for sendQueuedWrite()
+ *
+ * Returns 0, or the Modbus exception to reply with if the queue is full.
+ **/
+static int queueWrite(const char *mdi)
+{
+    if (write_count == WRITE_QUEUE_LEN) {
+	printf("write queue full, dropping: %s\n", mdi);
+	return MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY;
+    }
+    strncpy(write_queue[(write_head + write_count) % WRITE_QUEUE_LEN], mdi,
+	    sizeof(write_queue[0]) - 1);
+    write_count++;
+    return 0;
+}
+
+/**
+ * commandReceived() - check that task has taken the last command sent
+ *
+ * A queued line that task hasn't echoed after emcTimeout is given up on,
+ * as sendMdiCmd() would when waiting for it.
+ **/
+static int commandReceived()
+{
+    if (emcStatus->echo_serial_number == emcCommandSerialNumber) {
+	write_sent = 0.0;
+	return 1;
+    }
+    if (write_sent != 0.0 && etime() - write_sent > emcTimeout) {
+	printf("sendMdiCmd ERROR or emcTimeout(%.2f)\n", emcTimeout);
+	write_sent = 0.0;
+	return 1;
+    }
+    return write_sent == 0.0;
+}
+
+/**
+ * sendQueuedWrite() - send the next queued MDI line, without waiting
+ *
+ * Only one line is out at a time: the next goes once task has echoed the
+ * last and has room in its motion queue.
+ **/
+static void sendQueuedWrite()
+{
+    EMC_WAIT_TYPE waitType = emcWaitType;
+
+    if (write_count == 0 || !com_ready
+	|| emcStatus->motion.traj.queueFull) {
+	return;
+    }
+#if DEBUG
+    printf("%s\n", write_queue[write_head]);
+#endif
+    emcWaitType = EMC_WAIT_NONE;
+    sendMdiCmd(write_queue[write_head]);
+    emcWaitType = waitType;
+    write_sent = etime();
+    write_head = (write_head + 1) % WRITE_QUEUE_LEN;
+    write_count--;
+}
+
+/**
+ * parseModbusCommand() - act on a request before it gets its reply
+ *
+ * Returns 0 to reply from the mapping, or a Modbus exception code.
+ **/
+static int parseModbusCommand(const uint8_t *req, int req_length)
 {
     int offset = modbus_get_header_length(mb_ctx);
-    int slave = req[offset - 1];
     int function = req[offset];
     uint16_t address = (req[offset + 1] << 8) + req[offset + 2];
     int nb;
     static uint32_t sn = 0;   // serial number
     float *fp;
-    
-    // TODO: read slave address through INI file
-    assert (slave == 1);
-
-    updateStatus();
 
     switch (function) {
     case _FC_READ_INPUT_REGISTERS:
-        switch (address) {
-            case    0:  
-#if DEBUG
-		printf("RD REGS\n");
-		printf("queueFull: %d\n", emcStatus->motion.traj.queueFull);
-		printf("inpos: %d\n", emcStatus->motion.traj.inpos);
-                // queue gets updated from tpQueueDepth of control.c
-		printf("queue: %d\n", emcStatus->motion.traj.queue);
-		printf("echo_serial_number: %d\n", emcStatus->echo_serial_number);
-		// EmcPose position;		// current commanded position
-		printf("pos_x: %f\n", emcStatus->motion.traj.position.tran.x);
-		printf("pos_y: %f\n", emcStatus->motion.traj.position.tran.y);
-		printf("pos_z: %f\n", emcStatus->motion.traj.position.tran.z);
-		printf("pos_a: %f\n", emcStatus->motion.traj.position.a);
-		printf("pos_b: %f\n", emcStatus->motion.traj.position.b);
-		// EmcPose actualPosition;	// current actual position, from forward kins
-		printf("actual_pos_x: %f\n", emcStatus->motion.traj.actualPosition.tran.x);
-		printf("actual_pos_y: %f\n", emcStatus->motion.traj.actualPosition.tran.y);
-		printf("actual_pos_z: %f\n", emcStatus->motion.traj.actualPosition.tran.z);
-		printf("actual_pos_a: %f\n", emcStatus->motion.traj.actualPosition.a);
-		printf("actual_pos_b: %f\n", emcStatus->motion.traj.actualPosition.b);
-		printf("sync_di[0]: %d\n", emcStatus->motion.synch_di[0]);
-		printf("sync_di[1]: %d\n", emcStatus->motion.synch_di[1]);
-#endif
-		status_bits[0] = (int) emcStatus->motion.traj.queueFull;
-		status_bits[1] = (int) emcStatus->motion.traj.inpos;
-		status_bits[2] = (int) com_ready;
-
-		com_set_uint32 (mb_mapping->tab_input_registers +  0, (uint32_t) emcStatus->motion.traj.queue);
-		com_set_uint32 (mb_mapping->tab_input_registers +  2, (uint32_t) emcStatus->echo_serial_number);
-		// EmcPose position;		// current commanded position
-		com_set_float (mb_mapping->tab_input_registers +  4, (float) emcStatus->motion.traj.position.tran.x);
-		com_set_float (mb_mapping->tab_input_registers +  6, (float) emcStatus->motion.traj.position.tran.y);
-		com_set_float (mb_mapping->tab_input_registers +  8, (float) emcStatus->motion.traj.position.tran.z);
-		com_set_float (mb_mapping->tab_input_registers + 10, (float) emcStatus->motion.traj.position.a);
-		com_set_float (mb_mapping->tab_input_registers + 12, (float) emcStatus->motion.traj.position.b);
-		// EmcPose actualPosition;	// current actual position, from forward kins
-		com_set_float (mb_mapping->tab_input_registers + 14, (float) emcStatus->motion.traj.actualPosition.tran.x);
-		com_set_float (mb_mapping->tab_input_registers + 16, (float) emcStatus->motion.traj.actualPosition.tran.y);
-		com_set_float (mb_mapping->tab_input_registers + 18, (float) emcStatus->motion.traj.actualPosition.tran.z);
-		com_set_float (mb_mapping->tab_input_registers + 20, (float) emcStatus->motion.traj.actualPosition.a);
-		com_set_float (mb_mapping->tab_input_registers + 22, (float) emcStatus->motion.traj.actualPosition.b);
-		com_set_intArray32_to_uint32 (mb_mapping->tab_input_registers + 24, emcStatus->motion.synch_di);
-		com_set_intArray32_to_uint32 (mb_mapping->tab_input_registers + 26, emcStatus->motion.synch_di + 32);
-		com_set_intArray32_to_uint32 (mb_mapping->tab_input_registers + 28, emcStatus->motion.synch_do);
-		com_set_intArray32_to_uint32 (mb_mapping->tab_input_registers + 30, status_bits);
-		break;
-            default:    
-	        printf("TODO ");
-                break;
-        }
+        // any block is served from the image by modbus_reply()
         break;
 
     case _FC_WRITE_MULTIPLE_REGISTERS: 
@@ -359,40 +475,20 @@ static void parseModbusCommand(const uint8_t *req, int req_length)
                     }
                 }
             }
-#if DEBUG
-            printf("%s\n", mdi_buf);
-#endif
-
-            // execState: usually at EMC_TASK_EXEC_DONE(2)
-            // printf("execState(%d)\n", emcStatus->task.execState);
-            // printf("status(%d)\n", emcStatus->status);
-	    /**
-	     * emcStatus->status:
-	     *	    RCS_DONE = 1
-	     * 	    RCS_EXEC = 2
-	     * 	    RCS_ERROR = 3
-	     **/
-	    // if (emcStatus->status != RCS_EXEC)
-	    if (0 == emcStatus->motion.traj.queueFull) {
-		if (sendMdiCmd(mdi_buf) != 0) {
-		    printf("sendMdiCmd ERROR or emcTimeout(%.2f)\n", emcTimeout); 
-		    // this may happen when system loading is high
-		    // assert(0);
-		}
-	    } else {
-		printf("queue: %d\n", emcStatus->motion.traj.queue);
-		printf("queueFull: %d\n", emcStatus->motion.traj.queueFull);
-	    }
+            // sent by sendQueuedWrite() once task has room for it
+            return queueWrite(mdi_buf);
         }
         break;
 
     default:
+        // the rest are answered from the mapping as they stand
+#if DEBUG
         printf("debug: unknown Modbus Function Code:0x%02X\n", function);
-        assert(0);
+#endif
         break;
     }
 
-    return;
+    return 0;
 }
 
 #if 0
@@ -549,36 +645,133 @@ static int check_machine_stat()
     return (-1);
 }
 
-static void modbus_main()
+/**
+ * updateMachine() - one status update: the image, the machine state and
+ * the next queued write
+ **/
+static void updateMachine()
 {
-    int rc;
-    uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
-    
-    while(1) {
-	struct timespec	req= {0,10500000};   // 10.5ms
-
-        updateStatus();
+    updateStatus();
+    // the checks may send commands of their own, which mustn't overwrite
+    // a queued line task hasn't taken yet
+    if (commandReceived()) {
         if (check_machine_stat()) {
             // bypass receiving modbus MDI messages if the machine is not READY
             com_ready = 0;
         } else {
-	    com_ready = 1;
-	}
-	
-        rc = modbus_receive(mb_ctx, query);
-	nanosleep(&req, NULL);  // sleep for 10.5ms to avoid blocking by UART
-        if (rc > 0) {
-            /* rc is the query size */
-            parseModbusCommand(query, rc);
-            modbus_reply(mb_ctx, query, rc, mb_mapping);
-	    nanosleep(&req, NULL);  // sleep for 10.5ms to avoid blocking by UART
-        } else if (rc == -1) {
-            /* modbus related error */
-	    rcs_print_error("ERROR: %s\n", modbus_strerror(errno));
+            com_ready = 1;
+        }
+        sendQueuedWrite();
+    }
+    refreshImage();
+}
+
+/**
+ * serveClient() - answer one request from a client
+ *
+ * Returns -1 if the client has gone and its socket should be closed.
+ **/
+static int serveClient(int socket)
+{
+    int rc, exception;
+    uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
+
+    modbus_set_socket(mb_ctx, socket);
+    rc = modbus_receive(mb_ctx, query);
+    if (rc > 0) {
+        /* rc is the query size */
+        exception = parseModbusCommand(query, rc);
+        if (exception) {
+            modbus_reply_exception(mb_ctx, query, exception);
         } else {
-            rcs_print_error("ERROR: modbus query size: %d\n", rc);
+            modbus_reply(mb_ctx, query, rc, mb_mapping);
         }
+    } else if (rc == -1) {
+        if (tcp_port) {
+            return -1;      // connection closed or broken
+        }
+        /* modbus related error */
+        rcs_print_error("ERROR: %s\n", modbus_strerror(errno));
+    } else if (rc < 0) {
+        rcs_print_error("ERROR: modbus query size: %d\n", rc);
+    }
+    // rc == 0 is a request for another slave
+    return 0;
+}
+
+/**
+ * modbus_main() - the event loop
+ *
+ * Waits on the listening socket and every client at once, so a slow
+ * client doesn't hold up the others, and makes a status update every
+ * STATUS_PERIOD whatever the traffic.
+ **/
+static void modbus_main()
+{
+    int i, nfds, rc;
+    double next = 0.0;
+    fd_set fds;
+    struct timeval tv;
+
+    while(1) {
+	struct timespec	req= {0,10500000};   // 10.5ms
+	double now = etime();
 
+	if (now >= next) {
+	    updateMachine();
+	    next = now + STATUS_PERIOD;
+	    now = etime();
+	}
+
+	FD_ZERO(&fds);
+	nfds = 0;
+	if (listen_socket != -1) {
+	    FD_SET(listen_socket, &fds);
+	    nfds = listen_socket + 1;
+	}
+	for (i = 0; i < MAX_CLIENTS; i++) {
+	    if (clients[i] != -1) {
+		FD_SET(clients[i], &fds);
+		if (clients[i] >= nfds) {
+		    nfds = clients[i] + 1;
+		}
+	    }
+	}
+	tv.tv_sec = 0;
+	tv.tv_usec = next > now ? (long) ((next - now) * 1e6) : 0;
+	rc = select(nfds, &fds, NULL, NULL, &tv);
+	if (rc == -1) {
+	    if (errno != EINTR) {
+		rcs_print_error("ERROR: select: %s\n", strerror(errno));
+	    }
+	    continue;
+	}
+
+	for (i = 0; i < MAX_CLIENTS; i++) {
+	    if (clients[i] != -1 && FD_ISSET(clients[i], &fds)) {
+		if (serveClient(clients[i]) == -1) {
+		    close(clients[i]);
+		    clients[i] = -1;
+		} else if (tcp_port == 0) {
+		    nanosleep(&req, NULL);  // sleep for 10.5ms to avoid blocking by UART
+		}
+	    }
+	}
+
+	if (listen_socket != -1 && FD_ISSET(listen_socket, &fds)) {
+	    int client = accept(listen_socket, NULL, NULL);
+	    if (client == -1) {
+		rcs_print_error("ERROR: accept: %s\n", strerror(errno));
+		continue;
+	    }
+	    for (i = 0; i < MAX_CLIENTS && clients[i] != -1; i++);
+	    if (i == MAX_CLIENTS) {
+		rcs_print_error("ERROR: more than %d modbus clients\n", MAX_CLIENTS);
+		close(client);
+	    } else {
+		clients[i] = client;
+	    }
+	}
     }
 
     return;
@@ -603,10 +796,16 @@ static void initMain()
     operator_text_string[LINELEN-1] = 0;
     operator_display_string[LINELEN-1] = 0;
     programStartLine = 0;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+	clients[i] = -1;
+    }
 }
 
 static void usage(char* pname) {
-    printf("Usage: TODO\n");
+    printf("Usage: %s [--port <port>] [-- emcOptions]\n"
+           "         --port       serve Modbus/TCP on <port> instead of RTU\n",
+           pname);
     //obsolete: printf("         %s [Options] [-- emcOptions]\n"
     //obsolete:        "Options:\n"
     //obsolete:        "         --help       this help\n"
@@ -633,7 +832,7 @@ int main(int argc, char *argv[])
         case 'h': usage(argv[0]); exit(1);
         //obsolete: case 'e': strncpy(enablePWD, optarg, strlen(optarg) + 1); break;
         //obsolete: case 'n': strncpy(serverName, optarg, strlen(optarg) + 1); break;
-        //obsolete: case 'p': sscanf(optarg, "%d", &port); break;
+        case 'p': sscanf(optarg, "%d", &tcp_port); break;
         //obsolete: case 's': sscanf(optarg, "%d", &maxSessions); break;
         //obsolete: case 'w': strncpy(pwd, optarg, strlen(optarg) + 1); break;
         //obsolete: case 'd': strncpy(defaultPath, optarg, strlen(optarg) + 1);
@@ -27,7 +27,6 @@
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <netinet/in.h>
-#include <pthread.h>
 #include <errno.h>
 
 #include <getopt.h>
@@ -42,6 +41,7 @@
 #include "rcs_print.hh"
 #include "timer.hh"             // etime()
 #include "shcom.hh"             // NML Messaging functions
+#include "sockets.h"            // sockServe()
 #include "emcsched.hh"
 
 /*
@@ -219,7 +219,10 @@
 
   PollRate <rate>
   With set, sets the rate at which the scheduler polls for information. The default is 1.0 or one
-  second. With get, returns the current poll rate.
+  second. With get, returns the current poll rate. While a program runs the queue is polled every
+  0.05 seconds, so the next one starts as soon as it ends; meanwhile the next program's file is
+  read ahead and its tool looked up in the tool table, and if either fails the queue goes to error
+  when it is that program's turn. A tool of 0 or less asks for no particular tool.
 */
 
 // EMC_STAT *emcStatus;
@@ -251,10 +254,9 @@ typedef struct {
   char progName[256];} connectionRecType;
 
 int port = 5008;
-int server_sockfd, client_sockfd;
-socklen_t server_len, client_len;
+int server_sockfd;
+socklen_t server_len;
 struct sockaddr_in server_address;
-struct sockaddr_in client_address;
 bool useSockets = true;
 int tokenIdx;
 const char *delims = " \n\r\0";
@@ -262,7 +264,6 @@ int enabledConn = -1;
 char pwd[16] = "EMC\0";
 char enablePWD[16] = "EMCTOO\0";
 char serverName[24] = "EMCNETSVR\0";
-int sessions = 0;
 int maxSessions = -1;
 float pollDelay = 1.0;
 
@@ -342,7 +343,7 @@ static void sigQuit(int sig)
 static int sockWrite(connectionRecType *context)
 {
    strcat(context->outBuf, "\r\n");
-   return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+   return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
 }
 
 static setCommandType lookupSetCommand(char *s)
@@ -639,13 +640,13 @@ int commandSet(connectionRecType *context)
   
   pch = strtok(NULL, delims);
   if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
+    return sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
     }
   strupr(pch);
   cmd = lookupSetCommand(pch);
   if ((cmd >= scIniFile) && (context->cliSock != enabledConn)) {
     sprintf(context->outBuf, setCmdNakStr, pch);
-    return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
     }
   switch (cmd) {
     case scEcho: ret = setEcho(strtok(NULL, delims), context); break;
@@ -676,17 +677,17 @@ int commandSet(connectionRecType *context)
     case rtNoError:  
       if (context->verbose) {
         sprintf(context->outBuf, ackStr, pch);
-        return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+        return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
         }
       break;
     case rtHandledNoError: // Custom ok response already handled, take no action
       break; 
     case rtStandardError:
       sprintf(context->outBuf, setCmdNakStr, pch);
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomError: // Custom error response entered in buffer
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomHandledError: ;// Custom error respose handled, take no action
     }
@@ -886,13 +887,11 @@ int commandGet(connectionRecType *context)
   
   pch = strtok(NULL, delims);
   if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
+    return sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
     }
-  if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
+  // the status was read this tick, by serverTick()
   strupr(pch);
   cmd = lookupSetCommand(pch);
-  if (cmd > scIni)
-    if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
   switch (cmd) {
     case scEcho: ret = getEcho(pch, context); break;
     case scVerbose: ret = getVerbose(pch, context); break;
@@ -1110,15 +1109,15 @@ int parseCommand(connectionRecType *context)
     switch (lookupToken(pch)) {
       case cmdHello: 
         if (commandHello(context) == -1)
-          ret = write(context->cliSock, helloNakStr, strlen(helloNakStr));
-        else ret = write(context->cliSock, s, strlen(s));
+          ret = sockQueue(context->cliSock, helloNakStr, strlen(helloNakStr));
+        else ret = sockQueue(context->cliSock, s, strlen(s));
         break;
       case cmdGet: 
         ret = commandGet(context);
         break;
       case cmdSet:
         if (!context->linked)
-	  ret = write(context->cliSock, setNakStr, strlen(setNakStr));
+	  ret = sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
         else ret = commandSet(context);
         break;
       case cmdQuit: 
@@ -1127,7 +1126,7 @@ int parseCommand(connectionRecType *context)
       case cmdShutdown:
         ret = commandShutdown(context);
         if(ret ==0){
-          ret = write(context->cliSock, shutdownNakStr, strlen(shutdownNakStr));
+          ret = sockQueue(context->cliSock, shutdownNakStr, strlen(shutdownNakStr));
         }
 	break;
       case cmdHelp:
@@ -1139,27 +1138,34 @@ int parseCommand(connectionRecType *context)
   return ret;
 }
 
-void *checkQueue(void *arg)
+// how often the queue is looked at while a job runs, so the next one
+// starts as soon as it ends rather than up to a poll period later
+#define BUSY_POLL_DELAY 0.05
+// how often the server looks at its clients' status and the queue
+#define SERVER_TICK 0.01
+
+// Once a tick: the one read of the status the GETs of every connection
+// use, and the queue when it is due
+static void serverTick(void)
 {
-  while (1) {
-    updateQueue();
-    sleep((unsigned)pollDelay);
-    }
-  return 0;
-}  
+  static double due = 0.0;
+  double now = etime();
+
+  if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
+  if (now < due) return;
+  updateQueue();
+  if (queueBusy() && pollDelay > BUSY_POLL_DELAY)
+    due = now + BUSY_POLL_DELAY;
+  else due = now + pollDelay;
+}
 
-void *readClient(void *arg)
+static void *openClient(int fd)
 {
-  char str[1600];
-  char buf[1600];
-  unsigned int i, j;
-  int len;
   connectionRecType *context;
-  
-  
-//  res = 1;
+
   context = (connectionRecType *) malloc(sizeof(connectionRecType));
-  context->cliSock = client_sockfd;
+  if (context == NULL) return NULL;
+  context->cliSock = fd;
   context->linked = false;
   context->echo = true;
   context->verbose = false;
@@ -1169,64 +1175,44 @@ void *readClient(void *arg)
   context->commMode = 0;
   context->commProt = 0;
   context->inBuf[0] = 0;
-  buf[0] = 0;
-  
-  while (1) {
-    len = read(context->cliSock, &str, 1600);
-    if (len <= 0) goto finished;
-    str[len] = 0;
-    strcat(buf, str);
-    if (!memchr(str, 0x0d, strlen(str))) continue;
-    if (context->echo && context->linked)
-      if(write(context->cliSock, buf, strlen(buf)) != (ssize_t)strlen(buf)) {
-        fprintf(stderr, "emcrsh: write() failed: %s", strerror(errno));
-      }
-    i = 0;
-    j = 0;
-    while (i <= strlen(buf)) {
-      if ((buf[i] != '\n') && (buf[i] != '\r')) {
-        context->inBuf[j] = buf[i];
-	j++;
-	}
-      else
-        if (j > 0)
-          {
-  	    context->inBuf[j] = 0;
-            if (parseCommand(context) == -1) goto finished;
-	    j = 0;
-	}
-        i++;	
-      }
-    buf[0] = 0;
-    } 
+  return context;
+}
+
+static int readClient(void *conn, char *line)
+{
+  connectionRecType *context = (connectionRecType *) conn;
+
+  if (context->echo && context->linked) {
+    sockQueue(context->cliSock, line, strlen(line));
+    sockQueue(context->cliSock, "\r\n", 2);
+    }
+  strncpy(context->inBuf, line, sizeof(context->inBuf) - 1);
+  context->inBuf[sizeof(context->inBuf) - 1] = 0;
+  return parseCommand(context) == -1 ? -1 : 0;
+}
+
+static void closeClient(void *conn)
+{
+  connectionRecType *context = (connectionRecType *) conn;
 
-finished:
-  close(context->cliSock);
+  if (context->cliSock == enabledConn) enabledConn = -1;
   free(context);
-  pthread_exit((void *)0);
-  sessions--;  // FIXME: not reached
 }
 
 int sockMain()
 {
-    pthread_t thrd;
-    int res;
-    
-    while (1) {
-      
-      client_len = sizeof(client_address);
-      client_sockfd = accept(server_sockfd,
-        (struct sockaddr *)&client_address, &client_len);
-      if (client_sockfd < 0) exit(0);
-      sessions++;
-      if ((maxSessions == -1) || (sessions <= maxSessions))
-        res = pthread_create(&thrd, NULL, readClient, (void *)NULL);
-      else res = -1;
-      if (res != 0) {
-        close(client_sockfd);
-        sessions--;
-        }
-     }
+    sockServerType server;
+
+    signal(SIGPIPE, SIG_IGN);
+    server.listenFd = server_sockfd;
+    server.maxSessions = maxSessions;
+    server.tick = SERVER_TICK;
+    server.outMax = sizeof(((connectionRecType *) 0)->outBuf);
+    server.onOpen = openClient;
+    server.onLine = readClient;
+    server.onClose = closeClient;
+    server.onTick = serverTick;
+    if (sockServe(&server) != 0) exit(1);
     return 0;
 }
 
@@ -1254,8 +1240,6 @@ static void initMain()
 int main(int argc, char *argv[])
 {
     int opt;
-    pthread_t updateThread;
-    int res;
 
     initMain();
     // process local command line args
@@ -1294,8 +1278,6 @@ int main(int argc, char *argv[])
     signal(SIGINT, sigQuit);
 
     schedInit();
-    res = pthread_create(&updateThread, NULL, checkQueue, (void *)NULL);
-    if(res < 0) { perror("pthread_create"); return 1; }
     if (useSockets) sockMain();
 
     return 0;
@@ -278,55 +278,79 @@ int updateError()
 #define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
 
 /*
+  waitStatus() waits for task to write the status buffer again, for up
+  to timeout seconds, or forever if timeout is negative.  On a SHMEM
+  buffer the read wakes as soon as the write lands; other buffers are
+  polled inside NML::blocking_read().  If the channel can't block, it
+  sleeps EMC_COMMAND_DELAY and peeks instead, as before.
+
   emcCommandWaitReceived() waits until the EMC reports that it got
   the command with the indicated serial_number.
   emcCommandWaitDone() waits until the EMC reports that it got the
   command with the indicated serial_number, and it's done, or error.
 */
 
-int emcCommandWaitReceived(int serial_number)
+static int waitStatus(double timeout)
 {
-    double end = 0.0;
+    if (0 == emcStatus || 0 == emcStatusBuffer
+	|| !emcStatusBuffer->valid()
+	|| emcStatusBuffer->blocking_read(timeout) < 0) {
+	esleep(timeout >= 0.0 && timeout < EMC_COMMAND_DELAY ?
+	    timeout : EMC_COMMAND_DELAY);
+	return updateStatus();
+    }
 
-    while (emcTimeout <= 0.0 || end < emcTimeout) {
-	updateStatus();
+    return 0;
+}
 
-	if (emcStatus->echo_serial_number == serial_number) {
-	    return 0;
-	}
+/* the time left before start + emcTimeout, or -1 for no timeout */
+static double waitLeft(double start)
+{
+    if (emcTimeout <= 0.0) {
+	return -1.0;
+    }
+    double left = emcTimeout - (etime() - start);
+    return left > 0.0 ? left : 0.0;
+}
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+int emcCommandWaitReceived(int serial_number)
+{
+    double start = etime();
+
+    updateStatus();
+    while (!emcStatus->echoed(serial_number)) {
+	double left = waitLeft(start);
+	if (left == 0.0) {
+	    return -1;
+	}
+	waitStatus(left);
     }
 
-    return -1;
+    return 0;
 }
 
 int emcCommandWaitDone(int serial_number)
 {
-    double end = 0.0;
+    double start;
 
     // first get it there
     if (0 != emcCommandWaitReceived(serial_number)) {
 	return -1;
     }
     // now wait until it, or subsequent command (e.g., abort) is done
-    while (emcTimeout <= 0.0 || end < emcTimeout) {
-	updateStatus();
-
-	if (emcStatus->status == RCS_DONE) {
-	    return 0;
-	}
-
+    start = etime();
+    while (emcStatus->status != RCS_DONE) {
 	if (emcStatus->status == RCS_ERROR) {
 	    return -1;
 	}
-
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	double left = waitLeft(start);
+	if (left == 0.0) {
+	    return -1;
+	}
+	waitStatus(left);
     }
 
-    return -1;
+    return 0;
 }
 
 
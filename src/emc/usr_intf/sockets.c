@@ -28,6 +28,8 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
 #else
 #include <winsock2.h>
 #endif
@@ -323,3 +325,272 @@ int sockPrintfError(int fd, const char *format, .../*args*/ )
 
   return sockSendString(fd, buf);
 }
+
+/**************************************************
+*  Line based server
+**************************************************/
+
+// Longest line taken from a client; a longer one is cut up
+#define SOCK_LINE_MAX 1600
+// Events taken from epoll at once
+#define SOCK_EVENTS 32
+
+typedef struct {
+  void *data;                   // from onOpen
+  char in[SOCK_LINE_MAX];       // the line being read
+  size_t inLen;
+  char *out;                    // queued to send
+  size_t outLen, outSize;
+  unsigned int events;          // what epoll is watching for
+  int closing;
+} sockConnType;
+
+static sockServerType *sockServer;
+static int sockEpoll = -1;
+static sockConnType **sockConns;        // indexed by fd
+static int sockConnsSize;
+static int sockSessions;
+
+static double sockTime(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static sockConnType *sockConn(int fd)
+{
+  if ((fd < 0) || (fd >= sockConnsSize)) return NULL;
+  return sockConns[fd];
+}
+
+// Reads while the client is keeping up, and waits to write while there
+// is something queued
+static void sockWatch(int fd, sockConnType *conn)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  if (conn->outLen <= sockServer->outMax) ev.events |= EPOLLIN;
+  if (conn->outLen > 0) ev.events |= EPOLLOUT;
+  if (ev.events == conn->events) return;
+  ev.data.fd = fd;
+  epoll_ctl(sockEpoll, EPOLL_CTL_MOD, fd, &ev);
+  conn->events = ev.events;
+}
+
+static void sockFlush(int fd, sockConnType *conn)
+{
+  ssize_t sent;
+
+  if (conn->outLen == 0) return;
+  sent = send(fd, conn->out, conn->outLen, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (sent < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      conn->closing = 1;
+    return;
+    }
+  conn->outLen -= sent;
+  memmove(conn->out, conn->out + sent, conn->outLen);
+}
+
+int sockQueue(int fd, const void *src, size_t size)
+{
+  sockConnType *conn = sockConn(fd);
+  ssize_t sent = 0;
+  char *out;
+
+  if ((conn == NULL) || conn->closing) return -1;
+  if (conn->outLen == 0) {
+    sent = send(fd, src, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+        conn->closing = 1;
+        return -1;
+        }
+      sent = 0;
+      }
+    }
+  if ((size_t) sent < size) {
+    if (conn->outLen + size - sent > conn->outSize) {
+      out = realloc(conn->out, conn->outLen + size - sent + MAXMSG);
+      if (out == NULL) {
+        rcs_print_error("sockQueue: out of memory\n");
+        conn->closing = 1;
+        return -1;
+        }
+      conn->out = out;
+      conn->outSize = conn->outLen + size - sent + MAXMSG;
+      }
+    memcpy(conn->out + conn->outLen, (const char *) src + sent, size - sent);
+    conn->outLen += size - sent;
+    sockWatch(fd, conn);
+    }
+  return size;
+}
+
+size_t sockPending(int fd)
+{
+  sockConnType *conn = sockConn(fd);
+
+  return conn ? conn->outLen : 0;
+}
+
+static void sockOpen(void)
+{
+  struct epoll_event ev;
+  sockConnType *conn, **conns;
+  int fd, size;
+
+  fd = accept(sockServer->listenFd, NULL, NULL);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+      rcs_print_error("sockServe: accept: %s\n", strerror(errno));
+      }
+    return;
+    }
+  if ((sockServer->maxSessions != -1) &&
+      (sockSessions >= sockServer->maxSessions)) {
+    close(fd);
+    return;
+    }
+  if (fd >= sockConnsSize) {
+    size = fd < 64 ? 64 : 2 * fd;
+    conns = realloc(sockConns, size * sizeof(*conns));
+    if (conns == NULL) {
+      close(fd);
+      return;
+      }
+    memset(conns + sockConnsSize, 0, (size - sockConnsSize) * sizeof(*conns));
+    sockConns = conns;
+    sockConnsSize = size;
+    }
+  conn = calloc(1, sizeof(*conn));
+  if (conn == NULL) {
+    close(fd);
+    return;
+    }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(sockEpoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    free(conn);
+    close(fd);
+    return;
+    }
+  conn->events = EPOLLIN;
+  // queued replies during onOpen need the client to be there already
+  sockConns[fd] = conn;
+  sockSessions++;
+  conn->data = sockServer->onOpen(fd);
+  if (conn->data == NULL) conn->closing = 1;
+}
+
+static void sockDrop(int fd)
+{
+  sockConnType *conn = sockConns[fd];
+
+  if (conn->data != NULL) sockServer->onClose(conn->data);
+  epoll_ctl(sockEpoll, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+  free(conn->out);
+  free(conn);
+  sockConns[fd] = NULL;
+  sockSessions--;
+}
+
+// Hands each whole line read to onLine
+static void sockRead(int fd, sockConnType *conn)
+{
+  ssize_t len;
+  size_t i, start;
+
+  len = recv(fd, conn->in + conn->inLen, sizeof(conn->in) - conn->inLen, 0);
+  if (len <= 0) {
+    if ((len == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+        (errno != EINTR)))
+      conn->closing = 1;
+    return;
+    }
+  start = 0;
+  for (i = conn->inLen; (i < conn->inLen + len) && !conn->closing; i++) {
+    if ((conn->in[i] != '\r') && (conn->in[i] != '\n')) continue;
+    conn->in[i] = 0;
+    if ((i > start) && (sockServer->onLine(conn->data, conn->in + start) == -1))
+      conn->closing = 1;
+    start = i + 1;
+    }
+  conn->inLen += len;
+  if (conn->closing) return;
+  if (start == 0 && conn->inLen == sizeof(conn->in)) {
+    // no end in sight; take what there is as a line
+    conn->in[sizeof(conn->in) - 1] = 0;
+    if (sockServer->onLine(conn->data, conn->in) == -1) conn->closing = 1;
+    start = conn->inLen;
+    }
+  conn->inLen -= start;
+  memmove(conn->in, conn->in + start, conn->inLen);
+}
+
+int sockServe(sockServerType *server)
+{
+  struct epoll_event ev, events[SOCK_EVENTS];
+  sockConnType *conn;
+  double now, next;
+  int i, n, fd, timeout;
+
+  sockServer = server;
+  sockEpoll = epoll_create(SOCK_EVENTS);
+  if (sockEpoll < 0) {
+    rcs_print_error("sockServe: epoll_create: %s\n", strerror(errno));
+    return -1;
+    }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = server->listenFd;
+  if (epoll_ctl(sockEpoll, EPOLL_CTL_ADD, server->listenFd, &ev) < 0) {
+    rcs_print_error("sockServe: epoll_ctl: %s\n", strerror(errno));
+    return -1;
+    }
+  next = sockTime() + server->tick;
+  while (1) {
+    now = sockTime();
+    if (now >= next) {
+      if (server->onTick != NULL) server->onTick();
+      next += server->tick;
+      if (next <= now) next = now + server->tick;
+      // a client may have gone while the tick wrote to it
+      for (fd = 0; fd < sockConnsSize; fd++)
+        if ((sockConns[fd] != NULL) && sockConns[fd]->closing) sockDrop(fd);
+      now = sockTime();
+      }
+    timeout = (int) ((next - now) * 1000.0) + 1;
+    n = epoll_wait(sockEpoll, events, SOCK_EVENTS, timeout);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      rcs_print_error("sockServe: epoll_wait: %s\n", strerror(errno));
+      return -1;
+      }
+    for (i = 0; i < n; i++) {
+      fd = events[i].data.fd;
+      if (fd == server->listenFd) {
+        sockOpen();
+        continue;
+        }
+      conn = sockConn(fd);
+      if (conn == NULL) continue;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) conn->closing = 1;
+      if (!conn->closing && (events[i].events & EPOLLOUT)) sockFlush(fd, conn);
+      if (!conn->closing && (events[i].events & EPOLLIN)) sockRead(fd, conn);
+      if (!conn->closing) sockWatch(fd, conn);
+      }
+    for (i = 0; i < n; i++) {
+      fd = events[i].data.fd;
+      conn = sockConn(fd);
+      if ((conn != NULL) && conn->closing) sockDrop(fd);
+      }
+    }
+  return 0;
+}
@@ -51,6 +51,29 @@ extern char *sockGetError(void);
 extern int sockSendError(int fd, const char* message);
 extern int sockPrintfError(int fd, const char *format, .../*args*/) __attribute__((format(printf,2,3)));
 
+// Line based server...
+// One thread serves every client of a listening socket from an epoll
+// loop.  Each line a client sends, without its CR or LF, goes to onLine;
+// what is written with sockQueue() is buffered and sent as the client
+// takes it.  A client with more than outMax bytes waiting to go out isn't
+// read from until it has caught up.
+typedef struct {
+  int listenFd;                 // bound and listening
+  int maxSessions;              // clients at once, -1 for no limit
+  double tick;                  // seconds between calls of onTick
+  size_t outMax;
+  void *(*onOpen)(int fd);      // the client's record, NULL to refuse it
+  int (*onLine)(void *conn, char *line);  // -1 to close the client
+  void (*onClose)(void *conn);
+  void (*onTick)(void);         // may be NULL
+} sockServerType;
+
+extern int sockServe(sockServerType *server);
+// Queue data for a client of sockServe(), -1 if it has gone
+extern int sockQueue(int fd, const void *src, size_t size);
+// Bytes queued for a client and not yet sent
+extern size_t sockPending(int fd);
+
 #ifdef __cplusplus
 }
 #endif
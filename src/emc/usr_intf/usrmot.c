@@ -285,6 +285,8 @@ int main(int argc, char *argv[])
 		printf
 		    ("show {flags} {limits} {scales} {times}\tshow status\n");
 		printf("show debug <screen>\tshow debug\n");
+		printf("show timing\tshow time taken by each controller phase\n");
+		printf("resettiming\tclear the controller phase max times\n");
 		printf("show config <screen>\tshow config\n");
 		printf("free\tset mode to free\n");
 		printf("teleop\tset mode to teleop\n");
@@ -340,6 +342,9 @@ int main(int argc, char *argv[])
 		    } else if (!strcmp(cmd, "times")) {
 			lastPrint = 5;
 			statconfigdebug = 1;	/* debug */
+		    } else if (!strcmp(cmd, "timing")) {
+			lastPrint = 13;
+			statconfigdebug = 1;	/* debug */
 		    } else if (!strcmp(cmd, "stat")) {
 			statconfigdebug = 0;
 			lastPrint =
@@ -355,7 +360,7 @@ int main(int argc, char *argv[])
 		    } else {
 			/* invalid parameter */
 			printf
-			    ("syntax: show {pids} {flags} {limits} {scales} {times}\n");
+			    ("syntax: show {pids} {flags} {limits} {scales} {times} {timing}\n");
 			continue;	/* to while loop on stdin */
 		    }
 		} else {
@@ -419,6 +424,11 @@ int main(int argc, char *argv[])
 		    }
 		    break;
 		}
+	    } else if (!strcmp(cmd, "resettiming")) {
+		emcmotCommand.command = EMCMOT_RESET_TIMING;
+		if (usrmotWriteEmcmotCommand(&emcmotCommand) == -1) {
+		    fprintf(stderr, "Can't send a command to RT-task\n");
+		}
 	    } else if (!strcmp(cmd, "pause")) {
 		emcmotCommand.command = EMCMOT_PAUSE;
 		if (usrmotWriteEmcmotCommand(&emcmotCommand) == -1) {
@@ -690,3 +690,475 @@ char * VerifySyntaxForMakeCalc(char * StringToVerify)
 	return VerifyErrorDesc;
 }
 
+
+
+/* ------------------------------------------------------------ */
+/* Compiled expressions : the grammar above, parsed only once   */
+/* (on the realtime side, the first time an expression is used  */
+/* after the rungs have been loaded or edited) into operations  */
+/* on a small stack, with the variables already identified.     */
+/* An expression that does not compile (or too long) is still   */
+/* evaluated from its text, so its errors are reported as ever. */
+/* ------------------------------------------------------------ */
+
+#define ARITHM_OP_CONST 0
+#define ARITHM_OP_VAR 1
+#define ARITHM_OP_INDEX 2	/* push value of the index var... */
+#define ARITHM_OP_VAR_INDEXED 3	/* ...and replace it by the var indexed */
+#define ARITHM_OP_NOT 4
+#define ARITHM_OP_ABS 5
+#define ARITHM_OP_MINI 6
+#define ARITHM_OP_MAXI 7
+#define ARITHM_OP_AVG 8
+#define ARITHM_OP_POW 9
+#define ARITHM_OP_MUL 10
+#define ARITHM_OP_DIV 11
+#define ARITHM_OP_MOD 12
+#define ARITHM_OP_ADD 13
+#define ARITHM_OP_SUB 14
+#define ARITHM_OP_AND 15
+#define ARITHM_OP_XOR 16
+#define ARITHM_OP_OR 17
+#define ARITHM_OP_GT 18
+#define ARITHM_OP_LT 19
+#define ARITHM_OP_NE 20
+#define ARITHM_OP_EQ 21
+#define ARITHM_OP_GE 22
+#define ARITHM_OP_LE 23
+#define ARITHM_OP_STORE 24
+#define ARITHM_OP_STORE_INDEXED 25
+
+StrArithmExpr * CompiledExpr;
+
+void EmitCode(int Op,int VarType,int Value)
+{
+	StrArithmCode * pCode;
+	if ( CompiledExpr->CodeLength>=ARITHM_CODE_SIZE )
+	{
+		ErrorDesc = "Expression too long to be compiled";
+		return;
+	}
+	pCode = &CompiledExpr->Code[ CompiledExpr->CodeLength++ ];
+	pCode->Op = Op;
+	pCode->VarType = VarType;
+	pCode->Value = Value;
+}
+
+/* emit the read of a var, and skip it as Variable() does */
+void CompileVariable(void)
+{
+	int VarType,VarOffset,IndexVarType,IndexVarOffset;
+	if ( !IdentifyVarIndexedOrNot( Expr, &VarType, &VarOffset, &IndexVarType, &IndexVarOffset ) )
+		return;
+	if ( IndexVarType!=-1 && IndexVarOffset!=-1 )
+	{
+		EmitCode( ARITHM_OP_INDEX, IndexVarType, IndexVarOffset );
+		EmitCode( ARITHM_OP_VAR_INDEXED, VarType, VarOffset );
+	}
+	else
+	{
+		EmitCode( ARITHM_OP_VAR, VarType, VarOffset );
+	}
+	Expr++;
+	do
+	{
+		Expr++;
+	}
+	while( (*Expr!='@') && (*Expr!='\0') );
+	if ( *Expr=='\0' )
+	{
+		ErrorDesc = "Bad var coding, should end with @";
+		return;
+	}
+	Expr++;
+}
+
+void CompileFunction(void)
+{
+	char tcFonc[ 20 ], *pFonc;
+	int Op = -1;
+	int NbrVars = 0;
+
+	pFonc = tcFonc;
+	while((unsigned int)(pFonc-tcFonc)<sizeof(tcFonc)-1 && *Expr>='A' && *Expr<='Z')
+	{
+		*pFonc++ = *Expr;
+		Expr++;
+	}
+	*pFonc = '\0';
+
+	if ( !strcmp(tcFonc, "ABS") )
+	{
+		Expr++; /* ( */
+		CompileVariable( );
+		Expr++; /* ) */
+		EmitCode( ARITHM_OP_ABS, 0, 0 );
+		return;
+	}
+	if ( !strcmp(tcFonc, "MINI") )
+		Op = ARITHM_OP_MINI;
+	if ( !strcmp(tcFonc, "MAXI") )
+		Op = ARITHM_OP_MAXI;
+	if ( !strcmp(tcFonc, "MOY") || !strcmp(tcFonc, "AVG") )
+		Op = ARITHM_OP_AVG;
+	if ( Op==-1 )
+	{
+		ErrorDesc = "Unknown function";
+		return;
+	}
+	do
+	{
+		Expr++; /* ( -or- , */
+		CompileVariable( );
+		NbrVars++;
+		if ( ErrorDesc )
+			return;
+	}
+	while( *Expr!=')' && *Expr!='\0' );
+	if ( *Expr=='\0' )
+	{
+		ErrorDesc = "Missing parenthesis";
+		return;
+	}
+	Expr++; /* ) */
+	EmitCode( Op, NbrVars, 0 );
+}
+
+void CompileOr(void);
+
+void CompileTerm(void)
+{
+	if (*Expr=='(')
+	{
+		Expr++;
+		CompileOr();
+		if (*Expr!=')')
+		{
+			ErrorDesc = "Missing parenthesis";
+			return;
+		}
+		Expr++;
+	}
+	else if ( (*Expr>='0' && *Expr<='9') || (*Expr=='$') || (*Expr=='-') )
+		EmitCode( ARITHM_OP_CONST, 0, Constant() );
+	else if (*Expr>='A' && *Expr<='Z')
+		CompileFunction();
+	else if (*Expr=='@')
+		CompileVariable();
+	else if (*Expr=='!')
+	{
+		Expr++;
+		CompileTerm();
+		EmitCode( ARITHM_OP_NOT, 0, 0 );
+	}
+	else
+	{
+		ErrorDesc = "Unknown term";
+	}
+}
+
+void CompilePow(void)
+{
+	CompileTerm();
+	while(*Expr=='^')
+	{
+		if ( ErrorDesc )
+			break;
+		Expr++;
+		CompilePow();
+		EmitCode( ARITHM_OP_POW, 0, 0 );
+	}
+}
+
+void CompileMulDivMod(void)
+{
+	CompilePow();
+	while( !ErrorDesc && (*Expr=='*' || *Expr=='/' || *Expr=='%') )
+	{
+		int Op = (*Expr=='*')?ARITHM_OP_MUL:(*Expr=='/')?ARITHM_OP_DIV:ARITHM_OP_MOD;
+		Expr++;
+		CompilePow();
+		EmitCode( Op, 0, 0 );
+	}
+}
+
+void CompileAddSub(void)
+{
+	CompileMulDivMod();
+	while( !ErrorDesc && (*Expr=='+' || *Expr=='-') )
+	{
+		int Op = (*Expr=='+')?ARITHM_OP_ADD:ARITHM_OP_SUB;
+		Expr++;
+		CompileMulDivMod();
+		EmitCode( Op, 0, 0 );
+	}
+}
+
+void CompileAnd(void)
+{
+	CompileAddSub();
+	while( !ErrorDesc && *Expr=='&' )
+	{
+		Expr++;
+		CompileAddSub();
+		EmitCode( ARITHM_OP_AND, 0, 0 );
+	}
+}
+
+void CompileXor(void)
+{
+	CompileAnd();
+	while( !ErrorDesc && *Expr=='^' )
+	{
+		Expr++;
+		CompileAnd();
+		EmitCode( ARITHM_OP_XOR, 0, 0 );
+	}
+}
+
+void CompileOr(void)
+{
+	CompileXor();
+	while( !ErrorDesc && *Expr=='|' )
+	{
+		Expr++;
+		CompileXor();
+		EmitCode( ARITHM_OP_OR, 0, 0 );
+	}
+}
+
+/* same split as EvalCompare() */
+void CompileCompare(char * CompareString)
+{
+	char StrCopy[ARITHM_EXPR_SIZE+1];
+	char * SecondExpr = NULL;
+	char * SearchSep;
+	char * CutFirst;
+	int Found = FALSE;
+	int Op;
+
+	strcpy(StrCopy,CompareString);
+	CutFirst = StrCopy;
+	SearchSep = CompareString;
+	do
+	{
+		if ( (*SearchSep=='>') || (*SearchSep=='<') || (*SearchSep=='=') )
+		{
+			Found = TRUE;
+			*CutFirst = '\0';
+			CutFirst++;
+			SecondExpr = CutFirst;
+			if ( *CutFirst=='=' || *CutFirst=='>')
+			{
+				CutFirst++;
+				SecondExpr = CutFirst;
+			}
+		}
+		else
+		{
+			SearchSep++;
+			CutFirst++;
+		}
+	}
+	while (*SearchSep!='\0' && !Found);
+	if (!Found)
+	{
+		ErrorDesc = "Missing < or > or = or ... to make compare";
+		return;
+	}
+	if ( *SearchSep=='>' )
+		Op = ( *(SearchSep+1)=='=' )?ARITHM_OP_GE:ARITHM_OP_GT;
+	else if ( *SearchSep=='<' )
+		Op = ( *(SearchSep+1)=='>' )?ARITHM_OP_NE:( *(SearchSep+1)=='=' )?ARITHM_OP_LE:ARITHM_OP_LT;
+	else
+		Op = ARITHM_OP_EQ;
+	Expr = StrCopy;
+	CompileOr();
+	if ( ErrorDesc )
+		return;
+	Expr = SecondExpr;
+	CompileOr();
+	EmitCode( Op, 0, 0 );
+}
+
+/* same parsing of the target as MakeCalc() */
+void CompileCalc(char * CalcString)
+{
+	char StrCopy[ARITHM_EXPR_SIZE+1];
+	int TargetVarType,TargetVarOffset,IndexVarType,IndexVarOffset;
+	int Found = FALSE;
+
+	strcpy(StrCopy,CalcString);
+	Expr = StrCopy;
+	if ( !IdentifyVarIndexedOrNot( Expr, &TargetVarType, &TargetVarOffset, &IndexVarType, &IndexVarOffset ) )
+		return;
+	Expr++;
+	do
+	{
+		Expr++;
+	}
+	while( (*Expr!='@') && (*Expr!='\0') );
+	if ( *Expr=='\0' )
+	{
+		ErrorDesc = "Bad var coding, should end with @";
+		return;
+	}
+	Expr++;
+	do
+	{
+		if (*Expr==':')
+			Expr++;
+		if (*Expr=='=')
+		{
+			Found = TRUE;
+			Expr++;
+		}
+		if (*Expr==' ')
+			Expr++;
+	}
+	while( !Found && *Expr!='\0' );
+	while( *Expr==' ')
+		Expr++;
+	if (!Found)
+	{
+		ErrorDesc = "Missing := to make operate";
+		return;
+	}
+	CompileOr();
+	if ( IndexVarType!=-1 && IndexVarOffset!=-1 )
+	{
+		EmitCode( ARITHM_OP_INDEX, IndexVarType, IndexVarOffset );
+		EmitCode( ARITHM_OP_STORE_INDEXED, TargetVarType, TargetVarOffset );
+	}
+	else
+	{
+		EmitCode( ARITHM_OP_STORE, TargetVarType, TargetVarOffset );
+	}
+}
+
+void CompileArithmExpr(StrArithmExpr * pArithmExpr, char TypeElement)
+{
+	int SaveUnderVerify = UnderVerify;
+	char * SaveVerifyErrorDesc = VerifyErrorDesc;
+	int Generation = InfosGene->RungsGeneration;
+
+	CompiledExpr = pArithmExpr;
+	pArithmExpr->CodeLength = 0;
+	ErrorDesc = NULL;
+	/* errors are not printed here, only when evaluated from the text */
+	UnderVerify = TRUE;
+	if ( pArithmExpr->Expr[0]!='\0' && pArithmExpr->Expr[0]!='#' )
+	{
+		if ( TypeElement==ELE_COMPAR )
+			CompileCompare( pArithmExpr->Expr );
+		else
+			CompileCalc( pArithmExpr->Expr );
+	}
+	if ( ErrorDesc )
+		pArithmExpr->CodeLength = -1;
+	UnderVerify = SaveUnderVerify;
+	VerifyErrorDesc = SaveVerifyErrorDesc;
+	pArithmExpr->CompiledFor = TypeElement;
+	pArithmExpr->CompiledGeneration = Generation;
+}
+
+/* run the code, returning what is left on the top of the stack */
+arithmtype RunArithmCode(StrArithmExpr * pArithmExpr)
+{
+	arithmtype Stack[ ARITHM_CODE_SIZE ];
+	int Top = -1;
+	int NumCode, Scan;
+	for( NumCode=0; NumCode<pArithmExpr->CodeLength; NumCode++ )
+	{
+		StrArithmCode * pCode = &pArithmExpr->Code[ NumCode ];
+		arithmtype Res;
+		switch( pCode->Op )
+		{
+			case ARITHM_OP_CONST:
+				Stack[ ++Top ] = pCode->Value;
+				break;
+			case ARITHM_OP_VAR:
+			case ARITHM_OP_INDEX:
+				Stack[ ++Top ] = (arithmtype)ReadVar( pCode->VarType, pCode->Value );
+				break;
+			case ARITHM_OP_VAR_INDEXED:
+				Stack[ Top ] = (arithmtype)ReadVar( pCode->VarType, pCode->Value+Stack[ Top ] );
+				break;
+			case ARITHM_OP_NOT:
+				Stack[ Top ] = Stack[ Top ]?0:1;
+				break;
+			case ARITHM_OP_ABS:
+				if ( Stack[ Top ]<0 )
+					Stack[ Top ] = Stack[ Top ] * -1;
+				break;
+			case ARITHM_OP_MINI:
+			case ARITHM_OP_MAXI:
+			case ARITHM_OP_AVG:
+				Top = Top - pCode->VarType + 1;
+				Res = (pCode->Op==ARITHM_OP_MINI)?0x7FFFFFFF:(pCode->Op==ARITHM_OP_MAXI)?0x80000000:0;
+				for( Scan=Top; Scan<Top+pCode->VarType; Scan++ )
+				{
+					if ( pCode->Op==ARITHM_OP_AVG )
+						Res = Res + Stack[ Scan ];
+					else if ( pCode->Op==ARITHM_OP_MINI ? Stack[ Scan ]<Res : Stack[ Scan ]>Res )
+						Res = Stack[ Scan ];
+				}
+				if ( pCode->Op==ARITHM_OP_AVG )
+					Res = Res/pCode->VarType;
+				Stack[ Top ] = Res;
+				break;
+			case ARITHM_OP_STORE:
+				WriteVar( pCode->VarType, pCode->Value, (int)Stack[ Top-- ] );
+				break;
+			case ARITHM_OP_STORE_INDEXED:
+				WriteVar( pCode->VarType, pCode->Value+Stack[ Top ], (int)Stack[ Top-1 ] );
+				Top = Top-2;
+				break;
+			default:
+				/* operators with two operands */
+				Res = Stack[ Top-1 ];
+				switch( pCode->Op )
+				{
+					case ARITHM_OP_POW: Res = pow_int(Res,Stack[ Top ]); break;
+					case ARITHM_OP_MUL: Res = Res * Stack[ Top ]; break;
+					case ARITHM_OP_DIV: Res = Res / Stack[ Top ]; break;
+					case ARITHM_OP_MOD: Res = Res % Stack[ Top ]; break;
+					case ARITHM_OP_ADD: Res = Res + Stack[ Top ]; break;
+					case ARITHM_OP_SUB: Res = Res - Stack[ Top ]; break;
+					case ARITHM_OP_AND: Res = Res & Stack[ Top ]; break;
+					case ARITHM_OP_XOR: Res = Res ^ Stack[ Top ]; break;
+					case ARITHM_OP_OR: Res = Res | Stack[ Top ]; break;
+					case ARITHM_OP_GT: Res = Res > Stack[ Top ]; break;
+					case ARITHM_OP_LT: Res = Res < Stack[ Top ]; break;
+					case ARITHM_OP_NE: Res = Res != Stack[ Top ]; break;
+					case ARITHM_OP_EQ: Res = Res == Stack[ Top ]; break;
+					case ARITHM_OP_GE: Res = Res >= Stack[ Top ]; break;
+					case ARITHM_OP_LE: Res = Res <= Stack[ Top ]; break;
+				}
+				Stack[ --Top ] = Res;
+				break;
+		}
+	}
+	return Top>=0?Stack[ Top ]:0;
+}
+
+/* Used at each scan for the compare elements */
+int EvalCompiledCompare(StrArithmExpr * pArithmExpr)
+{
+	if ( pArithmExpr->CompiledGeneration!=InfosGene->RungsGeneration || pArithmExpr->CompiledFor!=ELE_COMPAR )
+		CompileArithmExpr( pArithmExpr, ELE_COMPAR );
+	if ( pArithmExpr->CodeLength<0 )
+		return EvalCompare( pArithmExpr->Expr );
+	return RunArithmCode( pArithmExpr )?1:0;
+}
+
+/* Used at each scan for the operate elements */
+void MakeCompiledCalc(StrArithmExpr * pArithmExpr)
+{
+	if ( pArithmExpr->CompiledGeneration!=InfosGene->RungsGeneration || pArithmExpr->CompiledFor!=ELE_OUTPUT_OPERATE )
+		CompileArithmExpr( pArithmExpr, ELE_OUTPUT_OPERATE );
+	if ( pArithmExpr->CodeLength<0 )
+		MakeCalc( pArithmExpr->Expr, FALSE /* verify mode */ );
+	else
+		RunArithmCode( pArithmExpr );
+}
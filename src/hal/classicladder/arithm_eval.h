@@ -9,5 +9,7 @@ arithmtype AddSub(void);
 arithmtype Or(void);
 char * VerifySyntaxForEvalCompare(char * StringToVerify);
 char * VerifySyntaxForMakeCalc(char * StringToVerify);
+int EvalCompiledCompare(StrArithmExpr * pArithmExpr);
+void MakeCompiledCalc(StrArithmExpr * pArithmExpr);
 
 
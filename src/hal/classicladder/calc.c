@@ -31,6 +31,9 @@
 #include <rtlinux_signal.h>
 #endif
 
+#ifdef RTAPI
+#include "rtapi.h"
+#endif
 #include "classicladder.h"
 #include "global.h"
 #include "vars_access.h"
@@ -64,6 +67,7 @@ void InitRungs()
 				RungArray[NumRung].Element[x][y].DynamicOutput = 0;
 			}
 		}
+		CompileRung(&RungArray[NumRung]);
 	}
 	// the rung used in the default section created per default
 	InfosGene->FirstRung = 0;
@@ -95,6 +99,7 @@ void PrepareRungs()
 			}
 		}
 	}
+	InfosGene->RungsGeneration++;
 }
 #ifdef OLD_TIMERS_MONOS_SUPPORT
 void InitTimers()
@@ -210,7 +215,11 @@ void InitArithmExpr()
 {
     int NumExpr;
     for (NumExpr=0; NumExpr<NBR_ARITHM_EXPR; NumExpr++)
+    {
         strcpy(ArithmExpr[NumExpr].Expr,"");
+        ArithmExpr[NumExpr].CompiledGeneration = -1;
+        ArithmExpr[NumExpr].CodeLength = 0;
+    }
 }
 void InitIOConf( )
 {
@@ -236,44 +245,18 @@ void InitIOConf( )
 
 char StateOnLeft(int x,int y,StrRung * TheRung)
 {
-    char State = 0;
     int PosY;
-    char StillConnected;
     // directly connected to the "left"? if yes, ON !
     if (x==0)
         return 1;
-    /* Direct on left */
-    if (TheRung->Element[x-1][y].DynamicOutput)
-        State = 1;
-    /* Up */
-    PosY = y;
-    StillConnected = TheRung->Element[x][PosY].ConnectedWithTop;
-    while( (PosY>0) && StillConnected)
+    /* the rows on the left that are linked to this one */
+    /* through vertical connections, found by CompileRung() */
+    for (PosY=TheRung->Element[x][y].LeftTop; PosY<=TheRung->Element[x][y].LeftBottom; PosY++)
     {
-        PosY--;
         if (TheRung->Element[x-1][PosY].DynamicOutput)
-            State = 1;
-        if ( !(TheRung->Element[x][PosY].ConnectedWithTop) )
-            StillConnected = FALSE;
+            return 1;
     }
-    /* Down */
-    if (y<RUNG_HEIGHT-1)
-    {
-        PosY = y+1;
-        StillConnected = TheRung->Element[x][PosY].ConnectedWithTop;
-        while( (PosY<RUNG_HEIGHT) && StillConnected)
-        {
-            if (TheRung->Element[x-1][PosY].DynamicOutput)
-                State = 1;
-            PosY++;
-            if (PosY<RUNG_HEIGHT)
-            {
-                if ( !(TheRung->Element[x][PosY].ConnectedWithTop) )
-                    StillConnected = FALSE;
-            }
-        }
-    }
-    return State;
+    return 0;
 }
 
 /* Elements : -| |- and -|/|- */
@@ -625,7 +608,7 @@ char CalcTypeCompar(int x,int y,StrRung * UpdateRung)
     char State;
     char StateElement;
 
-    StateElement = EvalCompare(ArithmExpr[UpdateRung->Element[x][y].VarNum].Expr);
+    StateElement = EvalCompiledCompare(&ArithmExpr[UpdateRung->Element[x][y].VarNum]);
     UpdateRung->Element[x][y].DynamicState = StateElement;
     if (x==2)
     {
@@ -646,7 +629,7 @@ char CalcTypeOutputOperate(int x,int y,StrRung * UpdateRung)
     char State;
     State = StateOnLeft(x-2,y,UpdateRung);
     if (State)
-        MakeCalc(ArithmExpr[UpdateRung->Element[x][y].VarNum].Expr,FALSE /* verify mode */);
+        MakeCompiledCalc(&ArithmExpr[UpdateRung->Element[x][y].VarNum]);
     UpdateRung->Element[x][y].DynamicInput = State;
     UpdateRung->Element[x][y].DynamicState = State;
     return State;
@@ -655,94 +638,93 @@ char CalcTypeOutputOperate(int x,int y,StrRung * UpdateRung)
 
 int RefreshRung(StrRung * Rung, int * JumpTo)
 {
-	int x = 0, y = 0;
+	int x, y;
+	int Cell = 0;
 	int JumpToRung = -1;
 	int SectionToCall = -1;
 
-	do
+	/* only the elements found by CompileRung(), in the order of */
+	/* the columns from the left */
+	while( Cell<Rung->NbrCompiledCells && JumpToRung==-1 )
 	{
-		do
+		x = Rung->CompiledCells[ Cell ] / RUNG_HEIGHT;
+		y = Rung->CompiledCells[ Cell ] % RUNG_HEIGHT;
+		switch(Rung->Element[x][y].Type)
 		{
-			switch(Rung->Element[x][y].Type)
-			{
-				/* MLD,16/5/2001,V0.2.8 , fixed for drawing */
-				case ELE_FREE:
-				case ELE_UNUSABLE:
-					if (StateOnLeft(x,y,Rung))
-						Rung->Element[x][y].DynamicInput = 1;
-					else
-						Rung->Element[x][y].DynamicInput = 0;
-					break;
-				/* End fix */
-				case ELE_INPUT:
-					CalcTypeInput(x,y,Rung,FALSE,FALSE);
-					break;
-				case ELE_INPUT_NOT:
-					CalcTypeInput(x,y,Rung,TRUE,FALSE);
-					break;
-				case ELE_RISING_INPUT:
-					CalcTypeInput(x,y,Rung,FALSE,TRUE);
-					break;
-				case ELE_FALLING_INPUT:
-					CalcTypeInput(x,y,Rung,TRUE,TRUE);
-					break;
-				case ELE_CONNECTION:
-					CalcTypeConnection(x,y,Rung);
-					break;
+			/* MLD,16/5/2001,V0.2.8 , fixed for drawing */
+			case ELE_FREE:
+			case ELE_UNUSABLE:
+				if (StateOnLeft(x,y,Rung))
+					Rung->Element[x][y].DynamicInput = 1;
+				else
+					Rung->Element[x][y].DynamicInput = 0;
+				break;
+			/* End fix */
+			case ELE_INPUT:
+				CalcTypeInput(x,y,Rung,FALSE,FALSE);
+				break;
+			case ELE_INPUT_NOT:
+				CalcTypeInput(x,y,Rung,TRUE,FALSE);
+				break;
+			case ELE_RISING_INPUT:
+				CalcTypeInput(x,y,Rung,FALSE,TRUE);
+				break;
+			case ELE_FALLING_INPUT:
+				CalcTypeInput(x,y,Rung,TRUE,TRUE);
+				break;
+			case ELE_CONNECTION:
+				CalcTypeConnection(x,y,Rung);
+				break;
 #ifdef OLD_TIMERS_MONOS_SUPPORT
-				case ELE_TIMER:
-					CalcTypeTimer(x,y,Rung);
-					break;
-				case ELE_MONOSTABLE:
-					CalcTypeMonostable(x,y,Rung);
-					break;
+			case ELE_TIMER:
+				CalcTypeTimer(x,y,Rung);
+				break;
+			case ELE_MONOSTABLE:
+				CalcTypeMonostable(x,y,Rung);
+				break;
 #endif
-				case ELE_COUNTER:
-					CalcTypeCounter(x,y,Rung);
-					break;
-				case ELE_TIMER_IEC:
-					CalcTypeTimerIEC(x,y,Rung);
-					break;
-				case ELE_COMPAR:
-					CalcTypeCompar(x,y,Rung);
-					break;
-				case ELE_OUTPUT:
-					CalcTypeOutput(x,y,Rung,FALSE);
-					break;
-				case ELE_OUTPUT_NOT:
-					CalcTypeOutput(x,y,Rung,TRUE);
-					break;
-				case ELE_OUTPUT_SET:
-					CalcTypeOutputSetReset(x,y,Rung,FALSE);
-					break;
-				case ELE_OUTPUT_RESET:
-					CalcTypeOutputSetReset(x,y,Rung,TRUE);
-					break;
-				case ELE_OUTPUT_JUMP:
-					JumpToRung = CalcTypeOutputJump(x,y,Rung);
-					// we will now abort the refresh of the rung immediately...
-					break;
-				case ELE_OUTPUT_CALL:
-					SectionToCall = CalcTypeOutputCall(x,y,Rung);
-					if ( SectionToCall!=-1 )
-					{
-						StrSection * pSubRoutineSection = &SectionArray[ SectionToCall ];
-						if ( pSubRoutineSection->Used && pSubRoutineSection->SubRoutineNumber>=0 )
-							RefreshASection( pSubRoutineSection ); //recursive call! ;-)
-						else
-							debug_printf("Refresh rungs aborted - call to a sub-routine undefined or programmed as main !!!");
-					}
-					break;
-				case ELE_OUTPUT_OPERATE:
-					CalcTypeOutputOperate(x,y,Rung);
-					break;
-			}
-			y++;
-		}while( y<RUNG_HEIGHT && JumpToRung==-1 );
-		y = 0;
-		x++;
+			case ELE_COUNTER:
+				CalcTypeCounter(x,y,Rung);
+				break;
+			case ELE_TIMER_IEC:
+				CalcTypeTimerIEC(x,y,Rung);
+				break;
+			case ELE_COMPAR:
+				CalcTypeCompar(x,y,Rung);
+				break;
+			case ELE_OUTPUT:
+				CalcTypeOutput(x,y,Rung,FALSE);
+				break;
+			case ELE_OUTPUT_NOT:
+				CalcTypeOutput(x,y,Rung,TRUE);
+				break;
+			case ELE_OUTPUT_SET:
+				CalcTypeOutputSetReset(x,y,Rung,FALSE);
+				break;
+			case ELE_OUTPUT_RESET:
+				CalcTypeOutputSetReset(x,y,Rung,TRUE);
+				break;
+			case ELE_OUTPUT_JUMP:
+				JumpToRung = CalcTypeOutputJump(x,y,Rung);
+				// we will now abort the refresh of the rung immediately...
+				break;
+			case ELE_OUTPUT_CALL:
+				SectionToCall = CalcTypeOutputCall(x,y,Rung);
+				if ( SectionToCall!=-1 )
+				{
+					StrSection * pSubRoutineSection = &SectionArray[ SectionToCall ];
+					if ( pSubRoutineSection->Used && pSubRoutineSection->SubRoutineNumber>=0 )
+						RefreshASection( pSubRoutineSection ); //recursive call! ;-)
+					else
+						debug_printf("Refresh rungs aborted - call to a sub-routine undefined or programmed as main !!!");
+				}
+				break;
+			case ELE_OUTPUT_OPERATE:
+				CalcTypeOutputOperate(x,y,Rung);
+				break;
+		}
+		Cell++;
 	}
-	while( x<RUNG_WIDTH && JumpToRung==-1 );
 
 	*JumpTo = JumpToRung;
 	return TRUE;
@@ -789,15 +771,174 @@ void RefreshASection( StrSection * pSection )
 	while(!Done);
 }
 
+// A section only needs a refresh when one of the bits it reads or
+// writes changed since its last refresh, if it has no timers, counters,
+// expressions or calls (those are always refreshed). After a refresh,
+// it is refreshed once more, for the edges to settle, and again while
+// that changes something. Every FullScanEvery scans, all the sections
+// are refreshed anyway; with 1 (the default), they are at every scan.
+int FullScanEvery = 1;
+static int ScansSinceFullScan = 0;
+static int SectionsGeneration = -1;
+
+static void AddWatchedVar( StrSection * pSection, int VarType, int VarNum )
+{
+	int Scan;
+	for ( Scan=0; Scan<pSection->NbrWatchedVars; Scan++ )
+	{
+		if ( pSection->WatchedVars[ Scan ].VarType==VarType && pSection->WatchedVars[ Scan ].VarNum==VarNum )
+			return;
+	}
+	if ( pSection->NbrWatchedVars>=NBR_WATCHED_VARS )
+	{
+		// too many to follow...
+		pSection->ScanAlways = TRUE;
+		return;
+	}
+	pSection->WatchedVars[ pSection->NbrWatchedVars ].VarType = VarType;
+	pSection->WatchedVars[ pSection->NbrWatchedVars ].VarNum = VarNum;
+	pSection->WatchedVars[ pSection->NbrWatchedVars ].Value = ReadVar( VarType, VarNum );
+	pSection->NbrWatchedVars++;
+}
+
+static void CompileSectionDependencies( StrSection * pSection )
+{
+	int NumRung = pSection->FirstRung;
+	int NbrRungs = 0;
+	int x,y;
+	StrElement * Element;
+	pSection->ScanAlways = FALSE;
+	pSection->ScanAgain = TRUE;
+	pSection->NbrWatchedVars = 0;
+	if ( pSection->Language!=SECTION_IN_LADDER )
+	{
+		pSection->ScanAlways = TRUE;
+		return;
+	}
+	while( !pSection->ScanAlways && NbrRungs++<NBR_RUNGS )
+	{
+		for (x=0;x<RUNG_WIDTH;x++)
+		{
+			for (y=0;y<RUNG_HEIGHT;y++)
+			{
+				Element = &RungArray[ NumRung ].Element[x][y];
+				switch( Element->Type )
+				{
+					case ELE_INPUT:
+					case ELE_INPUT_NOT:
+					case ELE_RISING_INPUT:
+					case ELE_FALLING_INPUT:
+					case ELE_OUTPUT:
+					case ELE_OUTPUT_NOT:
+					case ELE_OUTPUT_SET:
+					case ELE_OUTPUT_RESET:
+						AddWatchedVar( pSection, Element->VarType, Element->VarNum );
+						break;
+					case ELE_TIMER:
+					case ELE_MONOSTABLE:
+					case ELE_COUNTER:
+					case ELE_TIMER_IEC:
+					case ELE_COMPAR:
+					case ELE_OUTPUT_CALL:
+					case ELE_OUTPUT_OPERATE:
+						pSection->ScanAlways = TRUE;
+						break;
+				}
+			}
+		}
+		if ( NumRung==pSection->LastRung )
+			break;
+		NumRung = RungArray[ NumRung ].NextRung;
+	}
+}
+
+// returns TRUE if the bits watched have changed since the last refresh
+// of the section, and gives their current values
+static char SectionVarsChanged( StrSection * pSection, int * Values )
+{
+	int Scan;
+	char Changed = FALSE;
+	for ( Scan=0; Scan<pSection->NbrWatchedVars; Scan++ )
+	{
+		Values[ Scan ] = ReadVar( pSection->WatchedVars[ Scan ].VarType, pSection->WatchedVars[ Scan ].VarNum );
+		if ( Values[ Scan ]!=pSection->WatchedVars[ Scan ].Value )
+			Changed = TRUE;
+	}
+	return Changed;
+}
+
+static void RefreshMainSection( StrSection * pSection, char FullScan )
+{
+	int Values[ NBR_WATCHED_VARS ];
+	char Changed = FALSE;
+	char Modified;
+	int Scan;
+#ifdef RTAPI
+	long long int t0 = rtapi_get_time( );
+#endif
+	if ( FullScanEvery>1 && !pSection->ScanAlways )
+	{
+		Changed = SectionVarsChanged( pSection, Values );
+		if ( !FullScan && !Changed && !pSection->ScanAgain )
+		{
+			pSection->NbrSkips++;
+			return;
+		}
+	}
+
+	if ( pSection->Language==SECTION_IN_LADDER )
+		RefreshASection( pSection );
+#ifdef SEQUENTIAL_SUPPORT
+	else
+		RefreshSequentialPage( pSection->SequentialPage );
+#endif
+
+	if ( FullScanEvery>1 && !pSection->ScanAlways )
+	{
+		// keep the values for the next time, and see if the section
+		// itself changed any of them
+		Modified = FALSE;
+		for ( Scan=0; Scan<pSection->NbrWatchedVars; Scan++ )
+		{
+			pSection->WatchedVars[ Scan ].Value = ReadVar( pSection->WatchedVars[ Scan ].VarType, pSection->WatchedVars[ Scan ].VarNum );
+			if ( pSection->WatchedVars[ Scan ].Value!=Values[ Scan ] )
+				Modified = TRUE;
+		}
+		pSection->ScanAgain = Changed || Modified;
+	}
+	pSection->NbrScans++;
+#ifdef RTAPI
+	pSection->DurationOfLastScan = (int)( rtapi_get_time( ) - t0 );
+#endif
+}
+
 // All the sections 'main' are refreshed in the order defined.
 #define SR_STACK 25
 void ClassicLadder_RefreshAllSections()
 {
 	int ScanMainSection;
 	StrSection * pScanSection;
+	char FullScan = TRUE;
 
 	CycleStart();
 
+	if ( FullScanEvery>1 )
+	{
+		// rungs or sections modified since the last scan ?
+		if ( InfosGene->RungsGeneration!=SectionsGeneration )
+		{
+			SectionsGeneration = InfosGene->RungsGeneration;
+			for ( ScanMainSection=0; ScanMainSection<NBR_SECTIONS; ScanMainSection++ )
+			{
+				if ( SectionArray[ ScanMainSection ].Used )
+					CompileSectionDependencies( &SectionArray[ ScanMainSection ] );
+			}
+		}
+		FullScan = ( ++ScansSinceFullScan>=FullScanEvery );
+		if ( FullScan )
+			ScansSinceFullScan = 0;
+	}
+
 	for ( ScanMainSection=0; ScanMainSection<NBR_SECTIONS; ScanMainSection++ )
 	{
 
@@ -807,14 +948,14 @@ void ClassicLadder_RefreshAllSections()
 		// and in Ladder language ?
 		if ( pScanSection->Used && pScanSection->SubRoutineNumber==-1 && pScanSection->Language==SECTION_IN_LADDER )
 		{
-			RefreshASection( pScanSection );
+			RefreshMainSection( pScanSection, FullScan );
 		}
 
 #ifdef SEQUENTIAL_SUPPORT
 		// current section defined and is in sequential language
 		if ( pScanSection->Used && pScanSection->Language==SECTION_IN_SEQUENTIAL )
 		{
-			RefreshSequentialPage( pScanSection->SequentialPage );
+			RefreshMainSection( pScanSection, FullScan );
 		}
 #endif
 
@@ -827,6 +968,66 @@ void ClassicLadder_RefreshAllSections()
 
 void CopyRungToRung(StrRung * RungSrc,StrRung * RungDest)
 {
+    /* compiled before the copy, so a rung being refreshed */
+    /* never sees its new elements with the old list */
+    CompileRung(RungSrc);
     memcpy(RungDest,RungSrc,sizeof(StrRung));
+    InfosGene->RungsGeneration++;
+}
+
+/* Find once, when a rung is loaded or edited, what the refresh */
+/* used to work out for each element at every scan: the rows on */
+/* the left that feed it (StateOnLeft), and which elements need */
+/* a refresh at all. Free elements with nothing on their left */
+/* are left out, their input never changes. */
+void CompileRung(StrRung * Rung)
+{
+    int x,y;
+    int PosY;
+    int NbrCells = 0;
+    char Needed;
+    StrElement * Element;
+    for (x=0;x<RUNG_WIDTH;x++)
+    {
+        for (y=0;y<RUNG_HEIGHT;y++)
+        {
+            Element = &Rung->Element[x][y];
+            /* up, then down, through the vertical connections */
+            PosY = y;
+            while( PosY>0 && Rung->Element[x][PosY].ConnectedWithTop )
+                PosY--;
+            Element->LeftTop = PosY;
+            PosY = y;
+            while( PosY<RUNG_HEIGHT-1 && Rung->Element[x][PosY+1].ConnectedWithTop )
+                PosY++;
+            Element->LeftBottom = PosY;
+            if ( Element->Type!=ELE_FREE )
+            {
+                Needed = TRUE;
+            }
+            else
+            {
+                /* never set by the refresh */
+                Element->DynamicOutput = 0;
+                Needed = FALSE;
+                if ( x==0 )
+                {
+                    Element->DynamicInput = 1;
+                }
+                else
+                {
+                    Element->DynamicInput = 0;
+                    for (PosY=Element->LeftTop; PosY<=Element->LeftBottom; PosY++)
+                    {
+                        if ( Rung->Element[x-1][PosY].Type!=ELE_FREE )
+                            Needed = TRUE;
+                    }
+                }
+            }
+            if ( Needed )
+                Rung->CompiledCells[ NbrCells++ ] = x*RUNG_HEIGHT+y;
+        }
+    }
+    Rung->NbrCompiledCells = NbrCells;
 }
 
@@ -13,4 +13,6 @@ void InitArithmExpr(void);
 void InitIOConf( void );
 void RefreshASection( StrSection * pSection );
 void ClassicLadder_RefreshAllSections(void);
+extern int FullScanEvery;
 void CopyRungToRung(StrRung * RungSrc,StrRung * RungDest);
+void CompileRung(StrRung * Rung);
@@ -211,6 +211,10 @@ typedef struct StrElement
 	char DynamicState;
 	char DynamicVarBak; /* used for rising/falling edges */
 	char DynamicOutput;
+	/* rows of the column on the left connected to this element, */
+	/* set by CompileRung() */
+	char LeftTop;
+	char LeftBottom;
 }StrElement;
 
 #define LGT_LABEL 10
@@ -223,6 +227,9 @@ typedef struct StrRung
 	char Label[LGT_LABEL];
 	char Comment[LGT_COMMENT];
 	StrElement Element[RUNG_WIDTH][RUNG_HEIGHT];
+	/* elements to refresh, in order (x*RUNG_HEIGHT+y), set by CompileRung() */
+	short int NbrCompiledCells;
+	short int CompiledCells[RUNG_WIDTH*RUNG_HEIGHT];
 }StrRung;
 
 #ifdef OLD_TIMERS_MONOS_SUPPORT
@@ -279,9 +286,27 @@ typedef struct StrTimerIEC
 	int ValueToReachOneBaseUnit;
 }StrTimerIEC;
 
+/* One operation of a compiled arithmetic expression (see arithm_eval.c) */
+typedef struct StrArithmCode
+{
+	short Op;
+	short VarType;	/* of a variable, or number of them for MINI/MAXI/AVG */
+	int Value;	/* constant, or offset of the variable */
+}StrArithmCode;
+
+/* an expression has at most one operation per character, and */
+/* a compare or an operate one more at the end */
+#define ARITHM_CODE_SIZE (ARITHM_EXPR_SIZE+1)
+
 typedef struct StrArithmExpr
 {
 	char Expr[ARITHM_EXPR_SIZE];
+	/* compiled on the realtime side, the first time the expression */
+	/* is used after RungsGeneration has changed */
+	int CompiledGeneration;
+	char CompiledFor;	/* ELE_COMPAR or ELE_OUTPUT_OPERATE */
+	short CodeLength;	/* -1 if it did not compile: the text is evaluated */
+	StrArithmCode Code[ARITHM_CODE_SIZE];
 }StrArithmExpr;
 
 #define DEVICE_TYPE_DIRECT_ACCESS 0	/* used inb( ) and outb( ) calls */
@@ -326,6 +351,8 @@ typedef struct StrInfosGene
 	
 	/* how time for the last scan of the rungs in ns (if calc on RTLinux side) */
 	int DurationOfLastScan;
+	/* incremented each time rungs or sections are modified */
+	int RungsGeneration;
 	
 	int CurrentSection;
 
@@ -375,6 +402,16 @@ typedef struct StrDatasForBases
 #define SECTION_IN_LADDER 0
 #define SECTION_IN_SEQUENTIAL 1
 
+/* a bit read or written by a section, with its value after the */
+/* last refresh of the section */
+typedef struct StrWatchedVar
+{
+	int VarType;
+	int VarNum;
+	int Value;
+}StrWatchedVar;
+#define NBR_WATCHED_VARS 64
+
 #define LGT_SECTION_NAME 20
 typedef struct StrSection
 {
@@ -388,6 +425,15 @@ typedef struct StrSection
 	int LastRung;
 	/* if section is in Sequential */
 	int SequentialPage;
+	/* to skip the refresh while nothing it uses changes (see calc.c) */
+	char ScanAlways;
+	char ScanAgain;
+	int NbrWatchedVars;
+	StrWatchedVar WatchedVars[ NBR_WATCHED_VARS ];
+	/* statistics */
+	int NbrScans;
+	int NbrSkips;
+	int DurationOfLastScan; /* ns, if calc on realtime side */
 }StrSection;
 
 #define LGT_VAR_NAME 10
@@ -60,6 +60,7 @@ static struct cfg_cfg maincfg[] = {
 	{ "MODBUS_MASTER_TIME_INTER_FRAME", TYPE_INT, (void *) &ModbusTimeInterFrame },
 	{ "MODBUS_MASTER_TIME_OUT_RECEIPT", TYPE_INT, (void *) &ModbusTimeOutReceipt },
 	{ "MODBUS_MASTER_TIME_AFTER_TRANSMIT", TYPE_INT, (void *) &ModbusTimeAfterTransmit },
+	{ "MODBUS_MASTER_GROUP_REQUESTS", TYPE_INT, (void *) &ModbusGroupRequests },
 #endif
 	{ NULL, 0, NULL },
 };
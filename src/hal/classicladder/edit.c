@@ -553,6 +553,8 @@ void ApplyNewArithmExpr()
 	int NumExpr;
 	for (NumExpr=0; NumExpr<NBR_ARITHM_EXPR; NumExpr++)
 		strcpy(ArithmExpr[NumExpr].Expr,EditArithmExpr[NumExpr].Expr);
+	/* so that the realtime side compiles them again */
+	InfosGene->RungsGeneration++;
 }
 void CheckForFreeingArithmExpr(int PosiX,int PosiY)
 {
@@ -709,6 +711,7 @@ void InitBufferRungEdited( StrRung * pRung )
 	pRung->Used = TRUE;
 	pRung->PrevRung = -1;
 	pRung->NextRung = -1;
+	CompileRung( pRung );
 }
 
 int GetNbrRungsDefined( void )
@@ -827,6 +830,7 @@ void DeleteCurrentRung()
 				}
 			}
 		}
+		InfosGene->RungsGeneration++;
 	}
 }
 
@@ -911,6 +915,7 @@ void ApplyRungEdited()
 	DrawRungs();
 	autorize_prevnext_buttons(TRUE);
 	InfosGene->AskConfirmationToQuit = TRUE;
+	InfosGene->RungsGeneration++;
 }
 
 
@@ -203,6 +203,7 @@ char LoadRung(char * FileName,StrRung * BufRung)
         }
         while(LineOk);
         fclose(File);
+        CompileRung( BufRung );
         Okay = TRUE;
     }
     return (Okay);
@@ -727,6 +728,8 @@ char LoadArithmeticExpr(char * FileName)
 		while(LineOk);
 		fclose(File);
 		Okay = TRUE;
+		/* so that the realtime side compiles them again */
+		InfosGene->RungsGeneration++;
 	}
 	return (Okay);
 }
@@ -1227,6 +1230,9 @@ char LoadComParameters(char * FileName)
 				pParameter = "MODBUS_MASTER_TIME_AFTER_TRANSMIT=";
 				if ( strncmp( Line, pParameter, strlen( pParameter) )==0 )
 					ModbusTimeAfterTransmit = atoi( &Line[ strlen( pParameter) ] );
+				pParameter = "MODBUS_MASTER_GROUP_REQUESTS=";
+				if ( strncmp( Line, pParameter, strlen( pParameter) )==0 )
+					ModbusGroupRequests = atoi( &Line[ strlen( pParameter) ] );
 				pParameter = "MODBUS_DEBUG_LEVEL=";
 				if ( strncmp( Line, pParameter, strlen( pParameter) )==0 )
 					ModbusDebugLevel = atoi( &Line[ strlen( pParameter) ] ); 
@@ -1275,6 +1281,7 @@ char SaveComParameters(char * FileName)
 		fprintf( File,S_LINE "MODBUS_MASTER_TIME_INTER_FRAME=%d" E_LINE "\n", ModbusTimeInterFrame );
 		fprintf( File,S_LINE "MODBUS_MASTER_TIME_OUT_RECEIPT=%d" E_LINE "\n", ModbusTimeOutReceipt );
 		fprintf( File,S_LINE "MODBUS_MASTER_TIME_AFTER_TRANSMIT=%d" E_LINE "\n", ModbusTimeAfterTransmit );
+		fprintf( File,S_LINE "MODBUS_MASTER_GROUP_REQUESTS=%d" E_LINE "\n", ModbusGroupRequests );
 		fprintf( File,S_LINE "MODBUS_DEBUG_LEVEL=%d" E_LINE "\n", ModbusDebugLevel );
 
                 fprintf( File,S_LINE "MODBUS_MAP_COIL_READ=%d" E_LINE "\n", MapCoilRead );
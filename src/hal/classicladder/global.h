@@ -44,6 +44,13 @@ extern StrGeneralParams GeneralParamsMirror;
 
 #ifdef MODBUS_IO_MASTER
 extern StrModbusMasterReq ModbusMasterReq[ NBR_MODBUS_MASTER_REQ ];
+extern StrModbusPollReq ModbusPollReq[ NBR_MODBUS_MASTER_REQ ];
+extern int NbrModbusPollReqs;
+extern StrModbusSlave ModbusSlave[ NBR_MODBUS_MASTER_REQ ];
+// exchange in progress, for the response
+extern int CurrentReq;
+extern int InvoqIdentifHeaderIP;
+extern unsigned char CurrentFuncCode;
 // if '\0' => IP mode used for I/O modbus modules
 extern char ModbusSerialPortNameUsed[ 30 ];
 extern int ModbusSerialSpeed;
@@ -56,6 +63,7 @@ extern int ModbusTimeOutReceipt;
 extern int ModbusTimeAfterTransmit;
 extern int ModbusEleOffset;
 extern int ModbusDebugLevel;
+extern int ModbusGroupRequests;
 // Variables for Mapping MODBUS
 extern int MapCoilRead;
 extern int MapCoilWrite;
@@ -190,6 +190,7 @@ int AddSection( char * NewSectionName, int TypeLanguageSection, int SubRoutineNb
 			}
 		}
 #endif
+		InfosGene->RungsGeneration++;
 	}
 	return FreeFound;
 }
@@ -64,7 +64,10 @@ RTAPI_MP_INT(numFloatOut,"i");
 #define numPhysInputs InfosGene->SizesInfos.nbr_phys_inputs
 #define numPhysOutputs InfosGene->SizesInfos.nbr_phys_outputs
 #define numWords InfosGene->SizesInfos.nbr_words
+#define numSections InfosGene->SizesInfos.nbr_sections
 #endif
+int fullScanEvery=1;
+RTAPI_MP_INT(fullScanEvery, "refresh all sections every N scans, only the changed ones in between");
 
 hal_bit_t **hal_inputs;
 hal_bit_t **hide_gui;
@@ -74,6 +77,9 @@ hal_s32_t **hal_s32_outputs;
 hal_s32_t *hal_state;
 hal_float_t **hal_float_inputs;
 hal_float_t **hal_float_outputs;
+hal_s32_t **hal_section_scan_time;
+hal_s32_t **hal_section_scans;
+hal_s32_t **hal_section_skips;
 
 extern StrGeneralParams GeneralParamsMirror; 
 
@@ -117,6 +123,14 @@ void HalWriteFloatOutputs(void) {
 		*(hal_float_outputs[i]) = ReadVar(VAR_PHYS_FLOAT_OUTPUT, i);
 	}
 }
+void HalWriteSectionsStats(void) {
+	int i;
+	for( i=0; i<InfosGene->GeneralParams.SizesInfos.nbr_sections; i++) {
+		*(hal_section_scan_time[i]) = SectionArray[i].DurationOfLastScan;
+		*(hal_section_scans[i]) = SectionArray[i].NbrScans;
+		*(hal_section_skips[i]) = SectionArray[i].NbrSkips;
+	}
+}
 // This actually does the magic of periodic refresh of pins and
 // calculations. This function runs at the period rate of the thread
 // that you added it to.
@@ -160,6 +174,8 @@ static void hal_task(void *arg, long period) {
 				HalWrites32Outputs();
     
 				HalWriteFloatOutputs();
+
+				HalWriteSectionsStats();
 			}
 	 	t1 = rtapi_get_time();
 	 	InfosGene->DurationOfLastScan = t1 - t0;
@@ -205,6 +221,12 @@ error:
 	if(!hal_s32_outputs) { result = -ENOMEM; goto error; }
 	hal_float_outputs = hal_malloc(sizeof(hal_float_t*) * numFloatOut);
 	if(!hal_float_outputs) { result = -ENOMEM; goto error; }
+	hal_section_scan_time = hal_malloc(sizeof(hal_s32_t*) * numSections);
+	if(!hal_section_scan_time) { result = -ENOMEM; goto error; }
+	hal_section_scans = hal_malloc(sizeof(hal_s32_t*) * numSections);
+	if(!hal_section_scans) { result = -ENOMEM; goto error; }
+	hal_section_skips = hal_malloc(sizeof(hal_s32_t*) * numSections);
+	if(!hal_section_skips) { result = -ENOMEM; goto error; }
 
 	for(i=0; i<numPhysInputs; i++) {
 		result = hal_pin_bit_newf(HAL_IN, &hal_inputs[i], compId,
@@ -245,6 +267,19 @@ error:
 		if(result < 0) goto error;
 	}
 
+	for(i=0; i<numSections; i++) {
+		result = hal_pin_s32_newf(HAL_OUT, &hal_section_scan_time[i], compId,
+				"classicladder.0.section-%02d.scan-time", i);
+		if(result < 0) goto error;
+		result = hal_pin_s32_newf(HAL_OUT, &hal_section_scans[i], compId,
+				"classicladder.0.section-%02d.scans", i);
+		if(result < 0) goto error;
+		result = hal_pin_s32_newf(HAL_OUT, &hal_section_skips[i], compId,
+				"classicladder.0.section-%02d.skips", i);
+		if(result < 0) goto error;
+	}
+	FullScanEvery = fullScanEvery;
+
 	hal_ready(compId);
 	ClassicLadder_AllocAll( );
 	return 0;
@@ -36,6 +36,11 @@
 #include "socket_modbus_master.h"
 
 StrModbusMasterReq ModbusMasterReq[ NBR_MODBUS_MASTER_REQ ];
+// what is really polled, rebuilt from ModbusMasterReq[] each round
+StrModbusPollReq ModbusPollReq[ NBR_MODBUS_MASTER_REQ ];
+int NbrModbusPollReqs;
+StrModbusSlave ModbusSlave[ NBR_MODBUS_MASTER_REQ ];
+StrModbusReqStats ModbusReqStats[ NBR_MODBUS_MASTER_REQ ];
 // if '\0' => IP mode used for I/O modbus modules
 char ModbusSerialPortNameUsed[ 30 ];
 int ModbusSerialSpeed;
@@ -50,6 +55,7 @@ int ModbusTimeAfterTransmit;
 /* TEMP!!! put this variable in global config instead ? */
 int ModbusEleOffset = 0;
 int ModbusDebugLevel = 0; 
+int ModbusGroupRequests = 1;
 int MapCoilRead= 0;
 int MapCoilWrite= 0;
 int MapInputs= 0;
@@ -60,7 +66,6 @@ int MapRegisterWrite= 0;
 int CurrentReq;
 int InvoqIdentifHeaderIP;
 unsigned char CurrentFuncCode;
-int ErrorCnt;
 
 void InitModbusMasterBeforeReadConf( void )
 { 
@@ -75,6 +80,7 @@ void InitModbusMasterBeforeReadConf( void )
         ModbusTimeOutReceipt = 500;
         ModbusTimeAfterTransmit = 0;
         ModbusDebugLevel= 0;
+        ModbusGroupRequests = 1;
         MapCoilRead = 0;
         MapCoilWrite = 0;
         MapInputs = 0;
@@ -105,34 +111,213 @@ void InitModbusMasterParams( void )
 		ModbusMasterReq[ ScanReq ].NbrModbusElements = 1;
 		ModbusMasterReq[ ScanReq ].LogicInverted = 0;
 		ModbusMasterReq[ ScanReq ].OffsetVarMapped = 0;
+		ModbusSlave[ ScanReq ].Used = FALSE;
+		ModbusReqStats[ ScanReq ].NbrResponses = 0;
+		ModbusReqStats[ ScanReq ].NbrErrors = 0;
+		ModbusReqStats[ ScanReq ].NbrResponsesReported = 0;
 	}
+	NbrModbusPollReqs = 0;
 	
 	
 	CurrentReq = -1;
 	InvoqIdentifHeaderIP = 0;
 	CurrentFuncCode = 0;
-	ErrorCnt = 0;
 }
 
-void FindNextReqFromTable( void )
+/* Most elements one request of this type can carry */
+static int MaxModbusElesForReq( char TypeReq )
 {
-	char Found = FALSE;
-	int LoopSec = 0;
-	int ReqSearched = CurrentReq;
-	do
+	switch( TypeReq )
 	{
-		ReqSearched++;
-		if ( ReqSearched>=NBR_MODBUS_MASTER_REQ )
-			ReqSearched = 0;
-		if ( ModbusMasterReq[ ReqSearched ].SlaveAdr[ 0 ]!='\0' )
-			Found = TRUE;
-		LoopSec++;
+		case MODBUS_REQ_INPUTS_READ:
+		case MODBUS_REQ_COILS_READ:
+			return MODBUS_MAX_READ_BITS;
+		case MODBUS_REQ_COILS_WRITE:
+			return MODBUS_MAX_WRITE_BITS;
+		case MODBUS_REQ_REGISTERS_READ:
+		case MODBUS_REQ_HOLD_READ:
+			return MODBUS_MAX_READ_REGS;
+		case MODBUS_REQ_REGISTERS_WRITE:
+			return MODBUS_MAX_WRITE_REGS;
+	}
+	return 0;
+}
+
+/* Can 'Next' be sent in the same request as 'Poll' ? Only if it
+   continues it both on the slave and in the variables mapped */
+static char CanGroupModbusReq( StrModbusMasterReq * Poll, StrModbusMasterReq * Next )
+{
+	if ( strcmp( Poll->SlaveAdr, Next->SlaveAdr )!=0 || Poll->TypeReq!=Next->TypeReq
+		|| Poll->LogicInverted!=Next->LogicInverted )
+		return FALSE;
+	if ( Next->FirstModbusElement!=Poll->FirstModbusElement+Poll->NbrModbusElements
+		|| Next->OffsetVarMapped!=Poll->OffsetVarMapped+Poll->NbrModbusElements )
+		return FALSE;
+	return Poll->NbrModbusElements+Next->NbrModbusElements<=MaxModbusElesForReq( Poll->TypeReq );
+}
+
+/* Slave entry for this address, taking a free one the first time.
+   They are kept from round to round for the time-outs */
+static int FindModbusSlave( char * SlaveAdr )
+{
+	int ScanSlave;
+	int FreeSlave = -1;
+	for( ScanSlave=0; ScanSlave<NBR_MODBUS_MASTER_REQ; ScanSlave++ )
+	{
+		if ( ModbusSlave[ ScanSlave ].Used )
+		{
+			if ( strcmp( ModbusSlave[ ScanSlave ].SlaveAdr, SlaveAdr )==0 )
+				return ScanSlave;
+		}
+		else if ( FreeSlave==-1 )
+		{
+			FreeSlave = ScanSlave;
+		}
+	}
+	// one slave per request at most, so there is always a free one
+	strcpy( ModbusSlave[ FreeSlave ].SlaveAdr, SlaveAdr );
+	ModbusSlave[ FreeSlave ].Used = TRUE;
+	ModbusSlave[ FreeSlave ].SmoothedRespTime = -1;
+	ModbusSlave[ FreeSlave ].RespTimeDeviation = 0;
+	ModbusSlave[ FreeSlave ].ErrorsInARow = 0;
+	ModbusSlave[ FreeSlave ].NextTryTime = 0;
+	return FreeSlave;
+}
+
+/* Build the requests to poll this round from the configured ones,
+   merging adjacent ones that continue each other if asked to */
+void BuildModbusPollTable( void )
+{
+	int ScanReq, ScanSlave;
+	char SlaveStillUsed[ NBR_MODBUS_MASTER_REQ ];
+	StrModbusPollReq * pPoll = NULL;
+
+	NbrModbusPollReqs = 0;
+	for( ScanReq=0; ScanReq<NBR_MODBUS_MASTER_REQ; ScanReq++ )
+	{
+		StrModbusMasterReq * pReq = &ModbusMasterReq[ ScanReq ];
+		if ( pReq->SlaveAdr[ 0 ]=='\0' )
+		{
+			pPoll = NULL;
+			continue;
+		}
+		if ( ModbusGroupRequests && pPoll!=NULL && pReq->TypeReq!=MODBUS_REQ_DIAGNOSTICS
+				&& CanGroupModbusReq( &pPoll->Req, pReq ) )
+		{
+			pPoll->Req.NbrModbusElements += pReq->NbrModbusElements;
+			pPoll->NbrConfReqs++;
+			continue;
+		}
+		pPoll = &ModbusPollReq[ NbrModbusPollReqs++ ];
+		pPoll->Req = *pReq;
+		pPoll->FirstConfReq = ScanReq;
+		pPoll->NbrConfReqs = 1;
+	}
+
+	// forget slaves no more in the config (edited from the GUI)
+	for( ScanSlave=0; ScanSlave<NBR_MODBUS_MASTER_REQ; ScanSlave++ )
+		SlaveStillUsed[ ScanSlave ] = FALSE;
+	for( ScanReq=0; ScanReq<NbrModbusPollReqs; ScanReq++ )
+	{
+		for( ScanSlave=0; ScanSlave<NBR_MODBUS_MASTER_REQ; ScanSlave++ )
+		{
+			if ( ModbusSlave[ ScanSlave ].Used && strcmp( ModbusSlave[ ScanSlave ].SlaveAdr, ModbusPollReq[ ScanReq ].Req.SlaveAdr )==0 )
+				SlaveStillUsed[ ScanSlave ] = TRUE;
+		}
+	}
+	for( ScanSlave=0; ScanSlave<NBR_MODBUS_MASTER_REQ; ScanSlave++ )
+		ModbusSlave[ ScanSlave ].Used = SlaveStillUsed[ ScanSlave ];
+	for( ScanReq=0; ScanReq<NbrModbusPollReqs; ScanReq++ )
+		ModbusPollReq[ ScanReq ].Slave = FindModbusSlave( ModbusPollReq[ ScanReq ].Req.SlaveAdr );
+}
+
+/* Should this slave be asked now ? Not if it has stopped answering,
+   except from time to time to see if it is back */
+char ModbusSlaveToPoll( int Slave, unsigned int Now )
+{
+	if ( ModbusSlave[ Slave ].ErrorsInARow<MODBUS_SLAVE_ERRORS_OFFLINE )
+		return TRUE;
+	return (int)(Now-ModbusSlave[ Slave ].NextTryTime)>=0;
+}
+
+/* Time-out to wait for this slave: a bit more than it usually takes
+   to answer, but never more than the one configured */
+int GetModbusSlaveTimeOut( int Slave )
+{
+	StrModbusSlave * pSlave = &ModbusSlave[ Slave ];
+	int TimeOut;
+	if ( pSlave->SmoothedRespTime<0 )
+		return ModbusTimeOutReceipt;
+	TimeOut = pSlave->SmoothedRespTime+4*pSlave->RespTimeDeviation+MODBUS_SLAVE_TIMEOUT_MARGIN;
+	if ( TimeOut>ModbusTimeOutReceipt )
+		TimeOut = ModbusTimeOutReceipt;
+	return TimeOut;
+}
+
+/* Account an exchange with a slave: response time smoothed as for
+   TCP retransmits, and a slave that stopped answering waits for its
+   next try */
+void ModbusSlaveResult( int Slave, char Answered, int RespTime, unsigned int Now )
+{
+	StrModbusSlave * pSlave = &ModbusSlave[ Slave ];
+	if ( Answered )
+	{
+		if ( pSlave->ErrorsInARow>=MODBUS_SLAVE_ERRORS_OFFLINE )
+			printf("INFO CLASSICLADDER-   MODBUS slave %s answers again\n", pSlave->SlaveAdr);
+		pSlave->ErrorsInARow = 0;
+		if ( pSlave->SmoothedRespTime<0 )
+		{
+			pSlave->SmoothedRespTime = RespTime;
+			pSlave->RespTimeDeviation = RespTime/2;
+		}
+		else
+		{
+			int Delta = RespTime-pSlave->SmoothedRespTime;
+			pSlave->RespTimeDeviation += ((Delta<0?-Delta:Delta)-pSlave->RespTimeDeviation)/4;
+			pSlave->SmoothedRespTime += Delta/8;
+		}
 	}
-	while( !Found  && LoopSec<NBR_MODBUS_MASTER_REQ+1 );
-	if ( Found )
-		CurrentReq = ReqSearched;
 	else
-		CurrentReq = -1;
+	{
+		// next one waits the whole time-out configured
+		pSlave->SmoothedRespTime = -1;
+		pSlave->ErrorsInARow++;
+		if ( pSlave->ErrorsInARow==MODBUS_SLAVE_ERRORS_OFFLINE )
+			printf("ERROR CLASSICLADDER-   MODBUS slave %s does not answer, now tried every %d ms\n", pSlave->SlaveAdr, MODBUS_SLAVE_RETRY_PERIOD);
+		pSlave->NextTryTime = Now+MODBUS_SLAVE_RETRY_PERIOD;
+	}
+}
+
+/* Print how often each configured request has been refreshed */
+void ReportModbusMasterRates( unsigned int Now )
+{
+	static unsigned int LastReport = 0;
+	static char Started = FALSE;
+	int Elapsed = Now-LastReport;
+	int ScanReq;
+	if ( !Started || ModbusDebugLevel<1 )
+	{
+		// start counting from now
+		for( ScanReq=0; ScanReq<NBR_MODBUS_MASTER_REQ; ScanReq++ )
+			ModbusReqStats[ ScanReq ].NbrResponsesReported = ModbusReqStats[ ScanReq ].NbrResponses;
+		LastReport = Now;
+		Started = TRUE;
+		return;
+	}
+	if ( Elapsed<MODBUS_STATS_PERIOD )
+		return;
+	for( ScanReq=0; ScanReq<NBR_MODBUS_MASTER_REQ; ScanReq++ )
+	{
+		StrModbusReqStats * pStats = &ModbusReqStats[ ScanReq ];
+		if ( ModbusMasterReq[ ScanReq ].SlaveAdr[ 0 ]!='\0' )
+		{
+			int Rate = (pStats->NbrResponses-pStats->NbrResponsesReported)*10000/Elapsed;
+			printf("INFO CLASSICLADDER-   MODBUS req %d (slave %s): %d.%d refresh/s, %d errors\n",
+				ScanReq, ModbusMasterReq[ ScanReq ].SlaveAdr, Rate/10, Rate%10, pStats->NbrErrors);
+		}
+		pStats->NbrResponsesReported = pStats->NbrResponses;
+	}
+	LastReport = Now;
 }
 
 /* Question prepared here start directly with function code 
@@ -141,11 +326,11 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 {
 	int FrameSize = 0;
 	unsigned char FunctionCode = 0;
-	int FirstEle = ModbusMasterReq[ CurrentReq ].FirstModbusElement-ModbusEleOffset; 
-	int NbrEles = ModbusMasterReq[ CurrentReq ].NbrModbusElements;
+	int FirstEle = ModbusPollReq[ CurrentReq ].Req.FirstModbusElement-ModbusEleOffset; 
+	int NbrEles = ModbusPollReq[ CurrentReq ].Req.NbrModbusElements;
 	if ( FirstEle<0 )
 		FirstEle = 0;
-	switch( ModbusMasterReq[ CurrentReq ].TypeReq )
+	switch( ModbusPollReq[ CurrentReq ].Req.TypeReq )
 	{
 		case MODBUS_REQ_INPUTS_READ:
 			FunctionCode = MODBUS_FC_READ_INPUTS;
@@ -155,7 +340,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 			break;
 		case MODBUS_REQ_COILS_WRITE:
 			FunctionCode = MODBUS_FC_FORCE_COILS;
-			if ( ModbusMasterReq[ CurrentReq ].NbrModbusElements==1 )
+			if ( ModbusPollReq[ CurrentReq ].Req.NbrModbusElements==1 )
 				FunctionCode = MODBUS_FC_FORCE_COIL; 
 			break;
 		case MODBUS_REQ_REGISTERS_READ:
@@ -163,7 +348,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 			break;
 		case MODBUS_REQ_REGISTERS_WRITE:
 			FunctionCode = MODBUS_FC_WRITE_REGS;
-			if ( ModbusMasterReq[ CurrentReq ].NbrModbusElements==1 )
+			if ( ModbusPollReq[ CurrentReq ].Req.NbrModbusElements==1 )
 				FunctionCode = MODBUS_FC_WRITE_REG; 
 			break;
 		case MODBUS_REQ_HOLD_READ:
@@ -190,7 +375,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
                             break;
 			case MODBUS_FC_FORCE_COIL:     // 5
 			{
-				int BitValue = GetVarForModbus( &ModbusMasterReq[ CurrentReq ], FirstEle );
+				int BitValue = GetVarForModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle );
 				BitValue = (BitValue!=0)?MODBUS_BIT_ON:MODBUS_BIT_OFF;
 				AskFrame[ FrameSize++ ] = FirstEle >> 8;
 				AskFrame[ FrameSize++ ] = FirstEle & 0xff;
@@ -214,7 +399,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 					unsigned char ByteRes = 0;
 					for( ScanBit=0; ScanBit<8; ScanBit++ )
 					{
-						int Value = GetVarForModbus( &ModbusMasterReq[ CurrentReq ], FirstEle+ScanEle );
+						int Value = GetVarForModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle+ScanEle );
 						if ( Value && ScanEle<NbrEles )
 							ByteRes = ByteRes | Mask;
 						ScanEle++;
@@ -229,7 +414,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 				int Value;
 				AskFrame[ FrameSize++ ] = FirstEle >> 8;
 				AskFrame[ FrameSize++ ] = FirstEle & 0xff;
-				Value = GetVarForModbus( &ModbusMasterReq[ CurrentReq ], FirstEle );
+				Value = GetVarForModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle );
 //				printf("INFO MODBUS writing: WORD value =%d \n",Value);
 				AskFrame[ FrameSize++ ] = Value >> 8;
 				AskFrame[ FrameSize++ ] = Value & 0xff;
@@ -246,7 +431,7 @@ int PrepPureModbusAskForCurrentReq( unsigned char * AskFrame )
 				AskFrame[ FrameSize++ ] = (NbrEles*2) & 0xff; /* this may get truncated */
 				for (i=0; i <NbrEles; i++)
 				{
-				int Value = GetVarForModbus( &ModbusMasterReq[ CurrentReq ], FirstEle +i );
+				int Value = GetVarForModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle +i );
 //				printf("INFO MODBUS writing: WORD value =%d \n",Value);
 				AskFrame[ FrameSize++ ] = Value >> 8;
 				AskFrame[ FrameSize++ ] = Value & 0xff;
@@ -283,8 +468,8 @@ int TreatPureModbusResponse( unsigned char * RespFrame, int SizeFrame )
 		else
 		{
 	
-			int FirstEle = ModbusMasterReq[ CurrentReq ].FirstModbusElement-ModbusEleOffset;
-			int NbrEles = ModbusMasterReq[ CurrentReq ].NbrModbusElements;
+			int FirstEle = ModbusPollReq[ CurrentReq ].Req.FirstModbusElement-ModbusEleOffset;
+			int NbrEles = ModbusPollReq[ CurrentReq ].Req.NbrModbusElements;
 
 			if ( FirstEle<0 )
 				FirstEle = 0;
@@ -309,10 +494,10 @@ int TreatPureModbusResponse( unsigned char * RespFrame, int SizeFrame )
 								int Value = 0;
 								if ( BitsValues & Mask )
 									Value = 1;
-								if (  ModbusMasterReq[ CurrentReq ].LogicInverted )
+								if (  ModbusPollReq[ CurrentReq ].Req.LogicInverted )
 									Value = (Value==0)?1:0;
 								if ( ScanEle<NbrEles )
-									SetVarFromModbus( &ModbusMasterReq[ CurrentReq ], FirstEle+ScanEle++, Value );
+									SetVarFromModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle+ScanEle++, Value );
 								Mask = Mask<<1;
 							}
 						}
@@ -330,7 +515,7 @@ int TreatPureModbusResponse( unsigned char * RespFrame, int SizeFrame )
 						int hivalue=(RespFrame[2+(i*2)]<<8);
 						int lovalue=( RespFrame[3+(i*2)]);
 						int value=hivalue | lovalue;
-						SetVarFromModbus( &ModbusMasterReq[ CurrentReq ], FirstEle+i, value );
+						SetVarFromModbus( &ModbusPollReq[ CurrentReq ].Req, FirstEle+i, value );
 					}
 						cError = 0;
 				
@@ -362,10 +547,10 @@ int TreatPureModbusResponse( unsigned char * RespFrame, int SizeFrame )
 				case MODBUS_FC_DIAGNOSTICS://function 8
 					if ( ((RespFrame[3]<<8) | RespFrame[4])== 257 )
 					{	
-					printf("INFO CLASSICLADDER-   MODBUS -Echo back from slave #%s is correct (data=257).\n",ModbusMasterReq[ CurrentReq ].SlaveAdr);
+					printf("INFO CLASSICLADDER-   MODBUS -Echo back from slave #%s is correct (data=257).\n",ModbusPollReq[ CurrentReq ].Req.SlaveAdr);
 					cError = 0;
 					}else{
-					printf("ERROR CLASSICLADDER-    MODBUS -Echo back from slave #%s is WRONG.\n",ModbusMasterReq[ CurrentReq ].SlaveAdr);
+					printf("ERROR CLASSICLADDER-    MODBUS -Echo back from slave #%s is WRONG.\n",ModbusPollReq[ CurrentReq ].Req.SlaveAdr);
 					}
 					break;
 			}
@@ -380,7 +565,7 @@ int GetModbusResponseLenghtToReceive( void )
 	int LgtResp = 0, NbrRealBytes;
 	if ( CurrentReq!=-1 )
 	{
-		int NbrEles = ModbusMasterReq[ CurrentReq ].NbrModbusElements;
+		int NbrEles = ModbusPollReq[ CurrentReq ].Req.NbrModbusElements;
 		switch( CurrentFuncCode )
 		{
 				case MODBUS_FC_READ_INPUTS:
@@ -498,14 +683,13 @@ unsigned short CRC16(unsigned char *puchMsg, unsigned short usDataLen)
 }
 
 
-/* Question generated here start directly with function code 
-  (no IP header or Slave number) */
-int ModbusMasterAsk( unsigned char * SlaveAddressIP, unsigned char * Question )
+/* Frame for a request of the poll table, which becomes the current
+   one, for the response */
+int ModbusMasterAskForReq( int NumPollReq, unsigned char * SlaveAddressIP, unsigned char * Question )
 {
 	int LgtAskFrame = 0;
 	
-	if ( CurrentReq==-1 )
-		FindNextReqFromTable( );
+	CurrentReq = NumPollReq;
 	if ( CurrentReq!=-1 )
 	{
 		// start of the usefull frame depend if serial or IP
@@ -522,7 +706,7 @@ int ModbusMasterAsk( unsigned char * SlaveAddressIP, unsigned char * Question )
 				LgtAskFrame = LgtAskFrame+OffsetHeader;
 				
 				// slave address
-				Question[ 0 ] = atoi( ModbusMasterReq[ CurrentReq ].SlaveAdr );
+				Question[ 0 ] = atoi( ModbusPollReq[ CurrentReq ].Req.SlaveAdr );
 				// add CRC at the end of the frame
 				CalcCRC = CRC16( &Question[ 0 ], LgtAskFrame ) ;
 				Question[ LgtAskFrame++ ] = (unsigned char)(CalcCRC>>8); 
@@ -545,7 +729,7 @@ int ModbusMasterAsk( unsigned char * SlaveAddressIP, unsigned char * Question )
 				Question[ 5 ] = (unsigned char)(LgtAskFrame+1);
 				// unit identifier
 				Question[ 6 ] = 1;
-				strcpy( (char*) SlaveAddressIP, ModbusMasterReq[ CurrentReq ].SlaveAdr );
+				strcpy( (char*) SlaveAddressIP, ModbusPollReq[ CurrentReq ].Req.SlaveAdr );
 				LgtAskFrame = LgtAskFrame+OffsetHeader;
 			}
 			 
@@ -599,7 +783,7 @@ char TreatModbusMasterResponse( unsigned char * Response, int LgtResponse )
 				{
 					LgtResponse = LgtResponse-2;
 					// verify number of slave which has responded
-					if ( Response[ 0 ]==atoi( ModbusMasterReq[ CurrentReq ].SlaveAdr ) )
+					if ( Response[ 0 ]==atoi( ModbusPollReq[ CurrentReq ].Req.SlaveAdr ) )
 						FrameOk = TRUE;
 				}
 				else
@@ -618,17 +802,13 @@ char TreatModbusMasterResponse( unsigned char * Response, int LgtResponse )
 	
 		if ( FrameOk )
 		{
-			// if valid frame => advance to next request
 			if ( TreatPureModbusResponse( &Response[ OffsetHeader ], LgtResponse-OffsetHeader)>=0 )
 			{
-				ErrorCnt = 0;
-				FindNextReqFromTable( );
 				RepOk = TRUE;
 			}
 			else
 			{
 				printf("ERROR CLASSICLADDER-   MODBUS-INCORRECT RESPONSE RECEIVED FROM SLAVE!!!\n");
-				ErrorCnt++;
 			}
 		}
 		else
@@ -636,15 +816,20 @@ char TreatModbusMasterResponse( unsigned char * Response, int LgtResponse )
 			printf("ERROR CLASSICLADDER-   MODBUS-LOW LEVEL ERROR IN RESPONSE!!!\n");
                         //set error coil 0 on 'MODBUS ERROR'
                         
-			ErrorCnt++;
 		}
-		if ( ErrorCnt>=3 )
+
+		// counted for each configured request sent in it
 		{
-			ErrorCnt = 0;
-			FindNextReqFromTable( );
+			StrModbusPollReq * pPoll = &ModbusPollReq[ CurrentReq ];
+			int ScanReq;
+			for( ScanReq=pPoll->FirstConfReq; ScanReq<pPoll->FirstConfReq+pPoll->NbrConfReqs; ScanReq++ )
+			{
+				if ( RepOk )
+					ModbusReqStats[ ScanReq ].NbrResponses++;
+				else
+					ModbusReqStats[ ScanReq ].NbrErrors++;
+			}
 		}
-
-		
 	}
         //set error coil (%E0) as apprioprate  
         if (RepOk==TRUE) {    WriteVar( VAR_ERROR_BIT, 0, FALSE);   }else{    WriteVar( VAR_ERROR_BIT, 0, TRUE);   }
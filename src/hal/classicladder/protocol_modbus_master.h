@@ -51,6 +51,21 @@
 
 #define NBR_MODBUS_MASTER_REQ 16/*50: problem with GTK config window: adding vertical scroll else required*/
 
+/* Most elements a request can carry in a 256 bytes frame */
+#define MODBUS_MAX_READ_BITS 2000
+#define MODBUS_MAX_WRITE_BITS 1968
+#define MODBUS_MAX_READ_REGS 125
+#define MODBUS_MAX_WRITE_REGS 123
+
+/* Failed exchanges in a row before a slave is only tried now and then */
+#define MODBUS_SLAVE_ERRORS_OFFLINE 3
+/* Time between tries of a slave that does not answer (ms) */
+#define MODBUS_SLAVE_RETRY_PERIOD 1000
+/* Added to the smoothed response time of a slave for its time-out (ms) */
+#define MODBUS_SLAVE_TIMEOUT_MARGIN 20
+/* Refresh rates printed this often with debug level 1 (ms) */
+#define MODBUS_STATS_PERIOD 10000
+
 typedef struct StrModbusMasterReq
 {
 	/* IP address or IP:port or slave number for serial */
@@ -62,13 +77,45 @@ typedef struct StrModbusMasterReq
 	char LogicInverted;
 	int OffsetVarMapped;
 }StrModbusMasterReq;
+
+/* A request as sent: one configured, or contiguous configured ones
+   for the same slave merged together (see BuildModbusPollTable) */
+typedef struct StrModbusPollReq
+{
+	StrModbusMasterReq Req;
+	int FirstConfReq; /* in ModbusMasterReq[] */
+	int NbrConfReqs;
+	int Slave; /* in ModbusSlave[] */
+}StrModbusPollReq;
+
+typedef struct StrModbusSlave
+{
+	char SlaveAdr[ LGT_SLAVE_ADR ];
+	char Used;
+	int SmoothedRespTime; /* ms, -1 until it has answered */
+	int RespTimeDeviation;
+	int ErrorsInARow;
+	unsigned int NextTryTime; /* when not answering */
+}StrModbusSlave;
+
+typedef struct StrModbusReqStats
+{
+	int NbrResponses;
+	int NbrErrors;
+	int NbrResponsesReported;
+}StrModbusReqStats;
  
 void InitModbusMasterBeforeReadConf( void );
 void PrepareModbusMaster( void );
 void InitModbusMasterParams( void );
+void BuildModbusPollTable( void );
 int GetModbusResponseLenghtToReceive( void );
-int ModbusMasterAsk( unsigned char * SlaveAddressIP, unsigned char * Question );
+int ModbusMasterAskForReq( int NumPollReq, unsigned char * SlaveAddressIP, unsigned char * Question );
 char TreatModbusMasterResponse( unsigned char * Response, int LgtResponse );
+char ModbusSlaveToPoll( int Slave, unsigned int Now );
+int GetModbusSlaveTimeOut( int Slave );
+void ModbusSlaveResult( int Slave, char Answered, int RespTime, unsigned int Now );
+void ReportModbusMasterRates( unsigned int Now );
 
 void SetVarFromModbus( StrModbusMasterReq * ModbusReq, int ModbusNum, int Value );
 int GetVarForModbus( StrModbusMasterReq * ModbusReq, int ModbusNum );
@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/time.h>
 #endif
 #include <errno.h>
 #include <time.h>
@@ -77,6 +78,18 @@ SOCK_FD client_s;             // Client socket descriptor
 int CptErrors = 0;
 int NbrFrames = 0;
 
+/* Milliseconds clock for the time-outs (wraps, compare differences) */
+static unsigned int MilliSecsNow( void )
+{
+#ifdef __WIN32__
+	return (unsigned int)GetTickCount( );
+#else
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (unsigned int)tv.tv_sec*1000+tv.tv_usec/1000;
+#endif
+}
+
 void InitSocketModbusMaster( )
 {
 
@@ -275,6 +288,25 @@ int WaitRespSocketModbusMaster( char * Buff, int BuffSize, int TimeOutResponseMi
 	return ResponseSize;
 }
 
+/* Throw away what a slave sent too late for its previous request,
+   else each response would be taken for the one of the next request */
+static void FlushSocketModbusMaster( SOCK_FD Sock )
+{
+	char Buff[ BUF_SIZE ];
+	fd_set myset;
+	struct timeval tv;
+	do
+	{
+		FD_ZERO( &myset );
+		FD_SET( Sock, &myset );
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		if ( select( Sock+1, &myset, NULL, NULL, &tv )<=0 )
+			break;
+	}
+	while( recv( Sock, Buff, BUF_SIZE, 0 )>0 );
+}
+
 
 void CloseSocketModbusMaster( void )
 {
@@ -303,14 +335,214 @@ void CloseSocketModbusMaster( void )
 	printf("INFO CLASSICLADDER---I/O modbus master closed!\n");
 }
 
-void SocketModbusMasterLoop( void )
+static void AfterTransmitPause( void )
+{
+	if ( ModbusTimeAfterTransmit>0 )
+	{
+		// usefull for USB-RS485 dongle...
+		if( ModbusDebugLevel>=3 )
+			printf("INFO CLASSICLADDER- after transmit delay now...%i milliseconds\n",ModbusTimeAfterTransmit);
+		DoPauseMilliSecs( ModbusTimeAfterTransmit );
+	}
+}
+
+/* Ends the exchange in progress on the request made current by
+   ModbusMasterAskForReq(), a zero size meaning no response */
+static char EndOfModbusExchange( int Slave, char * ResponseFrame, int ResponseSize, unsigned int SentTime )
+{
+	unsigned int Now = MilliSecsNow( );
+	char RepOk;
+	NbrFrames++;
+	if ( ResponseSize==0 )
+		printf("ERROR CLASSICLADDER-  MODBUS NO RESPONSE (Errs=%d/%d) !?\n", ++CptErrors, NbrFrames);
+	RepOk = TreatModbusMasterResponse( (unsigned char *)ResponseFrame, ResponseSize );
+	ModbusSlaveResult( Slave, ResponseSize>0, Now-SentTime, Now );
+	return RepOk;
+}
+
+/* One round of the poll table on the serial line: half-duplex, so one
+   request at a time, each retried up to 3 times, but leaving out the
+   slaves that do not answer */
+static void PollModbusSerialRound( char * QuestionFrame, char * ResponseFrame )
 {
 	char AdrIP[ 30 ];
-	int SizeQuestionToAsk;
+	int ScanReq;
+	for( ScanReq=0; ScanReq<NbrModbusPollReqs && ClientSocketRunning; ScanReq++ )
+	{
+		int Slave = ModbusPollReq[ ScanReq ].Slave;
+		int Tries = 0;
+		char RepOk = FALSE;
+		while( !RepOk && Tries<3 && ModbusSlaveToPoll( Slave, MilliSecsNow( ) ) )
+		{
+			int TimeOut = GetModbusSlaveTimeOut( Slave );
+			int SizeQuestionToAsk = ModbusMasterAskForReq( ScanReq, (unsigned char*)AdrIP, (unsigned char*)QuestionFrame );
+			unsigned int SentTime;
+			int ResponseSize;
+			if ( SizeQuestionToAsk<=0 )
+				break;
+			// before sending queston, set size of frame that will be to receive after! 
+			SerialSetResponseSize( 1/*adr*/+GetModbusResponseLenghtToReceive()+2/*crc*/, TimeOut );
+			SerialSend( QuestionFrame, SizeQuestionToAsk );
+			AfterTransmitPause( );
+			SentTime = MilliSecsNow( );
+			ResponseSize = SerialReceive( ResponseFrame, 800, TimeOut );
+			RepOk = EndOfModbusExchange( Slave, ResponseFrame, ResponseSize, SentTime );
+			if ( !RepOk )
+			{
+				// trouble? => flush all (perhaps we can receive now responses for old asks
+				// and are shifted between ask/resp...)
+				SerialFlush( );
+			}
+			Tries++;
+			DoPauseMilliSecs( ModbusTimeInterFrame );
+		}
+	}
+}
+
+/* One round of the poll table over TCP: each slave has its own
+   connection, so one request is sent to each of them before waiting,
+   and a slow slave does not hold up the others */
+static void PollModbusTcpRound( char * QuestionFrame, char * ResponseFrame )
+{
+	char AdrIP[ 30 ];
+	int NextReq[ NBR_MODBUS_MASTER_REQ ]; // per slave, next one of poll table to look at
+	int Tries[ NBR_MODBUS_MASTER_REQ ];
+	int PendingReq[ NBR_MODBUS_MASTER_REQ ]; // per slave, -1 if none
+	int PendingTransId[ NBR_MODBUS_MASTER_REQ ];
+	unsigned char PendingFuncCode[ NBR_MODBUS_MASTER_REQ ];
+	SOCK_FD PendingSock[ NBR_MODBUS_MASTER_REQ ];
+	unsigned int SentTime[ NBR_MODBUS_MASTER_REQ ];
+	int TimeOut[ NBR_MODBUS_MASTER_REQ ];
+	int Slave, NbrPending;
+
+	for( Slave=0; Slave<NBR_MODBUS_MASTER_REQ; Slave++ )
+	{
+		NextReq[ Slave ] = 0;
+		Tries[ Slave ] = 0;
+	}
+	do
+	{
+		// send the next request of each slave
+		NbrPending = 0;
+		for( Slave=0; Slave<NBR_MODBUS_MASTER_REQ && ClientSocketRunning; Slave++ )
+		{
+			int ScanReq = NextReq[ Slave ];
+			PendingReq[ Slave ] = -1;
+			if ( !ModbusSlave[ Slave ].Used || !ModbusSlaveToPoll( Slave, MilliSecsNow( ) ) )
+				continue;
+			while( ScanReq<NbrModbusPollReqs && ModbusPollReq[ ScanReq ].Slave!=Slave )
+				ScanReq++;
+			NextReq[ Slave ] = ScanReq;
+			if ( ScanReq<NbrModbusPollReqs )
+			{
+				int SizeQuestionToAsk = ModbusMasterAskForReq( ScanReq, (unsigned char*)AdrIP, (unsigned char*)QuestionFrame );
+				if ( SizeQuestionToAsk<=0 )
+				{
+					NextReq[ Slave ]++;
+					continue;
+				}
+				PendingReq[ Slave ] = ScanReq;
+				PendingTransId[ Slave ] = InvoqIdentifHeaderIP;
+				PendingFuncCode[ Slave ] = CurrentFuncCode;
+				TimeOut[ Slave ] = GetModbusSlaveTimeOut( Slave );
+				PendingSock[ Slave ] = SOCK_INVALID;
+				if ( VerifyTcpConnection( AdrIP ) )
+					FlushSocketModbusMaster( client_s );
+				if ( SendSocketModbusMaster( AdrIP, 502, QuestionFrame, SizeQuestionToAsk )==0 )
+					PendingSock[ Slave ] = client_s;
+				SentTime[ Slave ] = MilliSecsNow( );
+				NbrPending++;
+			}
+		}
+		if ( NbrPending>0 )
+			AfterTransmitPause( );
+
+		// collect the responses, as they come
+		while( NbrPending>0 )
+		{
+			fd_set myset;
+			struct timeval tv;
+			SOCK_FD MaxSock = 0;
+			int Wait = -1;
+			unsigned int Now = MilliSecsNow( );
+			FD_ZERO( &myset );
+			for( Slave=0; Slave<NBR_MODBUS_MASTER_REQ; Slave++ )
+			{
+				if ( PendingReq[ Slave ]!=-1 && PendingSock[ Slave ]!=SOCK_INVALID )
+				{
+					int Left = TimeOut[ Slave ]-(int)(Now-SentTime[ Slave ]);
+					if ( Left<0 )
+						Left = 0;
+					if ( Wait==-1 || Left<Wait )
+						Wait = Left;
+					FD_SET( PendingSock[ Slave ], &myset );
+					if ( PendingSock[ Slave ]>MaxSock )
+						MaxSock = PendingSock[ Slave ];
+				}
+			}
+			if ( Wait>=0 )
+			{
+				tv.tv_sec = Wait/1000;
+				tv.tv_usec = (Wait%1000)*1000;
+				if ( select( MaxSock+1, &myset, NULL, NULL, &tv )<=0 )
+					FD_ZERO( &myset );
+			}
+			else
+			{
+				FD_ZERO( &myset );
+			}
+			Now = MilliSecsNow( );
+			for( Slave=0; Slave<NBR_MODBUS_MASTER_REQ; Slave++ )
+			{
+				int ResponseSize = 0;
+				char RepOk;
+				if ( PendingReq[ Slave ]==-1 )
+					continue;
+				if ( PendingSock[ Slave ]!=SOCK_INVALID && FD_ISSET( PendingSock[ Slave ], &myset ) )
+				{
+					int bytesRcvd;
+					if( ModbusDebugLevel>=2 )   {printf("INFO CLASSICLADDER-   waiting for slave response...\n");}
+					if ((bytesRcvd = recv(PendingSock[ Slave ], ResponseFrame, 800, 0)) > 0)    {ResponseSize = bytesRcvd;}
+				}
+				else if ( PendingSock[ Slave ]!=SOCK_INVALID && (int)(Now-SentTime[ Slave ])<TimeOut[ Slave ] )
+				{
+					continue;
+				}
+				// back to the request this response is for
+				CurrentReq = PendingReq[ Slave ];
+				CurrentFuncCode = PendingFuncCode[ Slave ];
+				InvoqIdentifHeaderIP = PendingTransId[ Slave ];
+				RepOk = EndOfModbusExchange( Slave, ResponseFrame, ResponseSize, SentTime[ Slave ] );
+				Tries[ Slave ]++;
+				if ( RepOk || Tries[ Slave ]>=3 )
+				{
+					NextReq[ Slave ]++;
+					Tries[ Slave ] = 0;
+				}
+				PendingReq[ Slave ] = -1;
+				NbrPending--;
+			}
+		}
+		// go on while a slave has requests left
+		for( Slave=0; Slave<NBR_MODBUS_MASTER_REQ; Slave++ )
+		{
+			if ( ModbusSlave[ Slave ].Used && ModbusSlaveToPoll( Slave, MilliSecsNow( ) ) )
+			{
+				int ScanReq = NextReq[ Slave ];
+				while( ScanReq<NbrModbusPollReqs && ModbusPollReq[ ScanReq ].Slave!=Slave )
+					ScanReq++;
+				if ( ScanReq<NbrModbusPollReqs )
+					NbrPending++;
+			}
+		}
+	}
+	while( NbrPending>0 && ClientSocketRunning );
+}
+
+void SocketModbusMasterLoop( void )
+{
 	static char QuestionFrame[ 800 ];
-	int ResponseSize;
 	static char ResponseFrame[ 800 ];
-        int SendResultStatus = 0;
 
 #ifdef __XENO__
 	pthread_set_name_np(pthread_self(), __FUNCTION__);
@@ -330,45 +562,20 @@ void SocketModbusMasterLoop( void )
 		}
 		else
 		{
-			SizeQuestionToAsk = ModbusMasterAsk( (unsigned char*)AdrIP, (unsigned char*)QuestionFrame );
-			if ( SizeQuestionToAsk>0 )
+			// taken again each round, as the config can be edited meanwhile
+			BuildModbusPollTable( );
+			if ( NbrModbusPollReqs>0 )
 			{
 				if ( ModbusSerialPortNameUsed[ 0 ]=='\0' )
 				{
-					SendResultStatus = SendSocketModbusMaster( AdrIP, 502, QuestionFrame, SizeQuestionToAsk );
+					PollModbusTcpRound( QuestionFrame, ResponseFrame );
+					DoPauseMilliSecs( ModbusTimeInterFrame );
 				}
 				else
 				{
-					// before sending queston, set size of frame that will be to receive after! 
-					SerialSetResponseSize( 1/*adr*/+GetModbusResponseLenghtToReceive()+2/*crc*/, ModbusTimeOutReceipt );
-					SerialSend( QuestionFrame, SizeQuestionToAsk );
+					PollModbusSerialRound( QuestionFrame, ResponseFrame );
 				}
-                                if ( SendResultStatus==0 )
-				{
-				    if ( ModbusTimeAfterTransmit>0 )
-				    {
-				    	// usefull for USB-RS485 dongle...
-				    	if( ModbusDebugLevel>=3 )
-						printf("INFO CLASSICLADDER- after transmit delay now...%i milliseconds\n",ModbusTimeAfterTransmit);
-					DoPauseMilliSecs( ModbusTimeAfterTransmit );
-			    	    }
-				
-				    if ( ModbusSerialPortNameUsed[ 0 ]=='\0' )
-					ResponseSize = WaitRespSocketModbusMaster( ResponseFrame, 800, ModbusTimeOutReceipt );
-				    else
-					ResponseSize = SerialReceive( ResponseFrame, 800, ModbusTimeOutReceipt );
-				    NbrFrames++;
-				    if ( ResponseSize==0 )
-					printf("ERROR CLASSICLADDER-  MODBUS NO RESPONSE (Errs=%d/%d) !?\n", ++CptErrors, NbrFrames);
-				    if ( !TreatModbusMasterResponse( (unsigned char *)ResponseFrame, ResponseSize ) )
-				    {
-					// trouble? => flush all (perhaps we can receive now responses for old asks
-					// and are shifted between ask/resp...)
-					if ( ModbusSerialPortNameUsed[ 0 ]!='\0' )
-						SerialFlush( );
-				    }
-                                }
-				DoPauseMilliSecs( ModbusTimeInterFrame );
+				ReportModbusMasterRates( MilliSecsNow( ) );
 			}
 			else
 			{
@@ -383,5 +590,3 @@ void SocketModbusMasterLoop( void )
 #endif
 
 }
-
-
@@ -104,8 +104,10 @@ typedef struct {
     unsigned char state;	/* u:rw quad decode state machine state */
     unsigned char oldZ;		/* u:rw previous value of phase Z */
     unsigned char Zmask;	/* u:rc c:s mask for oldZ, from index-ena */
-    hal_bit_t *x4_mode;		/* u:r enables x4 counting (default) */
-    hal_bit_t *counter_mode;	/* u:r enables counter mode */
+    unsigned char latch_edges;	/* u:r c:w LATCH_RISING/FALLING enabled */
+    const unsigned char *lut;	/* u:r c:w decode table for the mode */
+    hal_bit_t *x4_mode;		/* c:r enables x4 counting (default) */
+    hal_bit_t *counter_mode;	/* c:r enables counter mode */
     atomic buf[2];		/* u:w c:r double buffer for atomic data */
     volatile atomic *bp;	/* u:r c:w ptr to in-use buffer */
     hal_s32_t *raw_counts;	/* u:rw raw count value, in update() only */
@@ -115,8 +117,8 @@ typedef struct {
     hal_bit_t *index_ena;	/* c:rw index enable input */
     hal_bit_t *reset;		/* c:r counter reset input */
     hal_bit_t *latch_in;        /* c:r counter latch input */
-    hal_bit_t *latch_rising;    /* u:r latch on rising edge? */
-    hal_bit_t *latch_falling;   /* u:r latch on falling edge? */
+    hal_bit_t *latch_rising;    /* c:r latch on rising edge? */
+    hal_bit_t *latch_falling;   /* c:r latch on falling edge? */
     __s32 raw_count;		/* c:rw captured raw_count */
     __u32 timestamp;		/* c:rw captured timestamp */
     __s32 index_count;		/* c:rw captured index count */
@@ -147,6 +149,10 @@ static counter_t *counter_array;
 #define SM_CNT_UP_MASK  0x40
 #define SM_CNT_DN_MASK  0x80
 
+/* bits of latch_edges */
+#define LATCH_RISING    0x01
+#define LATCH_FALLING   0x02
+
 /* Lookup table for quadrature decode state machine.  This machine
    will reject glitches on either input (will count up 1 on glitch,
    down 1 after glitch), and on both inputs simultaneously (no count
@@ -167,11 +173,12 @@ static const unsigned char lut_x1[16] = {
     0x00, 0x04, 0x08, 0x0C, 0x00, 0x04, 0x08, 0x0C
 };
 
-/* look-up table for a one-wire counter */
+/* look-up table for a one-wire counter; phase B is ignored, so the
+   entries with it set are the same as those without */
 
 static const unsigned char lut_ctr[16] = {
-   0x00, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-   0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x48, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
 };
 
 /* other globals */
@@ -252,6 +259,8 @@ int rtapi_app_main(void)
 	cntr->state = 0;
 	cntr->oldZ = 0;
 	cntr->Zmask = 0;
+	cntr->latch_edges = LATCH_RISING | LATCH_FALLING;
+	cntr->lut = lut_x4;
 	*(cntr->x4_mode) = 1;
 	*(cntr->counter_mode) = 0;
 	*(cntr->latch_rising) = 1;
@@ -308,73 +317,60 @@ void rtapi_app_exit(void)
 *            REALTIME ENCODER COUNTING AND UPDATE FUNCTIONS            *
 ************************************************************************/
 
+/* This runs in the base thread, so it is kept to the decode: the mode
+   pins are turned into a table, and the latch edge pins into a mask,
+   by capture(), and index and latch are only looked at when their
+   input changes. */
+
 static void update(void *arg, long period)
 {
     counter_t *cntr;
     atomic *buf;
     int n;
-    unsigned char state;
-    int latch, old_latch, rising, falling;
+    unsigned char state, Z, latch;
 
     cntr = arg;
     for (n = 0; n < howmany; n++) {
 	buf = (atomic *) cntr->bp;
-	/* get state machine current state */
-	state = cntr->state;
-	/* add input bits to state code */
-	if (*(cntr->phaseA)) {
-	    state |= SM_PHASE_A_MASK;
-	}
-	if (*(cntr->phaseB)) {
-	    state |= SM_PHASE_B_MASK;
-	}
-	/* look up new state */
-	if ( *(cntr->counter_mode) ) {
-	    state = lut_ctr[state & (SM_LOOKUP_MASK & ~SM_PHASE_B_MASK)];
-	} else if ( *(cntr->x4_mode) ) {
-	    state = lut_x4[state & SM_LOOKUP_MASK];
-	} else {
-	    state = lut_x1[state & SM_LOOKUP_MASK];
-	}
+	/* add input bits to the state machine current state, and look
+	   up the new state */
+	state = cntr->state & SM_LOOKUP_MASK;
+	state |= (*(cntr->phaseA) ? SM_PHASE_A_MASK : 0)
+	    | (*(cntr->phaseB) ? SM_PHASE_B_MASK : 0);
+	state = cntr->lut[state];
 	/* should we count? */
-	if (state & SM_CNT_UP_MASK) {
-	    (*cntr->raw_counts)++;
-	    buf->raw_count = *(cntr->raw_counts);
-	    buf->timestamp = timebase;
-	    buf->count_detected = 1;
-	} else if (state & SM_CNT_DN_MASK) {
-	    (*cntr->raw_counts)--;
+	if (state & (SM_CNT_UP_MASK | SM_CNT_DN_MASK)) {
+	    if (state & SM_CNT_UP_MASK) {
+		(*cntr->raw_counts)++;
+	    } else {
+		(*cntr->raw_counts)--;
+	    }
 	    buf->raw_count = *(cntr->raw_counts);
 	    buf->timestamp = timebase;
 	    buf->count_detected = 1;
 	}
 	/* save state machine state */
 	cntr->state = state;
-	/* get old phase Z state, make room for new bit value */
-	state = cntr->oldZ << 1;
-	/* add new value of phase Z */
-	if (*(cntr->phaseZ)) {
-	    state |= 1;
-	}
-	cntr->oldZ = state & 3;
 	/* test for index enabled and rising edge on phase Z */
-	if ((state & cntr->Zmask) == 1) {
-	    /* capture counts, reset Zmask */
-	    buf->index_count = *(cntr->raw_counts);
-	    buf->index_detected = 1;
-	    cntr->Zmask = 0;
+	Z = *(cntr->phaseZ) ? 1 : 0;
+	if (Z != cntr->oldZ) {
+	    cntr->oldZ = Z;
+	    if (Z && cntr->Zmask) {
+		/* capture counts, reset Zmask */
+		buf->index_count = *(cntr->raw_counts);
+		buf->index_detected = 1;
+		cntr->Zmask = 0;
+	    }
 	}
         /* test for latch enabled and desired edge on latch-in */
-        latch = *(cntr->latch_in), old_latch = cntr->old_latch;
-        rising = latch && !old_latch;
-        falling = !latch && old_latch;
-
-        if((rising && *(cntr->latch_rising))
-                || (falling && *(cntr->latch_falling))) {
-            buf->latch_detected = 1;
-            buf->latch_count = *(cntr->raw_counts);
+        latch = *(cntr->latch_in) ? 1 : 0;
+        if (latch != cntr->old_latch) {
+            cntr->old_latch = latch;
+            if (cntr->latch_edges & (latch ? LATCH_RISING : LATCH_FALLING)) {
+                buf->latch_detected = 1;
+                buf->latch_count = *(cntr->raw_counts);
+            }
         }
-        cntr->old_latch = latch;
 
 	/* move on to next channel */
 	cntr++;
@@ -422,6 +418,16 @@ static void capture(void *arg, long period)
 	} else {
 	    cntr->Zmask = 0;
 	}
+	/* pick the decode table and the latch edges for update() */
+	if ( *(cntr->counter_mode) ) {
+	    cntr->lut = lut_ctr;
+	} else if ( *(cntr->x4_mode) ) {
+	    cntr->lut = lut_x4;
+	} else {
+	    cntr->lut = lut_x1;
+	}
+	cntr->latch_edges = (*(cntr->latch_rising) ? LATCH_RISING : 0)
+	    | (*(cntr->latch_falling) ? LATCH_FALLING : 0);
 	/* done interacting with update() */
 	/* check for change in scale value */
 	if ( *(cntr->pos_scale) != cntr->old_scale ) {
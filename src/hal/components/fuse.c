@@ -0,0 +1,200 @@
+/********************************************************************
+* Description:  fuse.c
+*               This file, 'fuse.c', is a HAL component that
+*               provides kernels that run a chain of simple
+*               component functions as a single function.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'fuse.c', provides the kernels that hal_fuse_thread()
+    puts in place of runs of and2, or2, not, mux2, scale, sum2 and
+    the lossless conv_* functions in a thread.  Each kernel walks a
+    table of operations that point straight at the pins and params
+    of the fused instances, instead of calling each function through
+    its own pointer and instance data.  The results are the same,
+    including the values of the signals in between.
+
+    The module has one parameter, "count", the number of kernels to
+    provide.  Each kernel can take over one run of up to
+    HAL_FUSE_MAX_OPS functions.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+#include "hal.h"		/* HAL public API decls */
+#include "hal_priv.h"		/* HAL private decls */
+#include "rtapi_string.h"
+
+/* module information */
+MODULE_DESCRIPTION("Fused function kernels for HAL");
+MODULE_LICENSE("GPL");
+#define MAX_FUSE 16
+
+static int count = 1;		/* number of kernels */
+RTAPI_MP_INT(count, "number of fuse kernels");
+
+/***********************************************************************
+*                GLOBAL VARIABLES AND DECLARATIONS                     *
+************************************************************************/
+
+static int comp_id;		/* component ID */
+static hal_fuse_t *fuses[MAX_FUSE];
+
+/* an op's pins hold the address of the pin's data, its params the
+   data itself */
+#define PIN(type,n) (**(type **) SHMPTR(op->arg[n]))
+#define PARAM(type,n) (*(type *) SHMPTR(op->arg[n]))
+
+static void fuse_run(void *arg, long period)
+{
+    hal_fuse_t *fuse = arg;
+    hal_fuse_op_t *op, *end;
+
+    end = fuse->op + fuse->nops;
+    for (op = fuse->op; op < end; op++) {
+	switch (op->type) {
+	case HAL_FUSE_AND2:
+	    PIN(hal_bit_t, 2) = PIN(hal_bit_t, 0) && PIN(hal_bit_t, 1);
+	    break;
+	case HAL_FUSE_OR2:
+	    PIN(hal_bit_t, 2) = PIN(hal_bit_t, 0) || PIN(hal_bit_t, 1);
+	    break;
+	case HAL_FUSE_NOT:
+	    PIN(hal_bit_t, 1) = !PIN(hal_bit_t, 0);
+	    break;
+	case HAL_FUSE_MUX2:
+	    PIN(hal_float_t, 3) = PIN(hal_bit_t, 0)
+		? PIN(hal_float_t, 2) : PIN(hal_float_t, 1);
+	    break;
+	case HAL_FUSE_SCALE:
+	    PIN(hal_float_t, 3) = PIN(hal_float_t, 0) * PIN(hal_float_t, 1)
+		+ PIN(hal_float_t, 2);
+	    break;
+	case HAL_FUSE_SUM2:
+	    PIN(hal_float_t, 2) = PIN(hal_float_t, 0) * PARAM(hal_float_t, 3)
+		+ PIN(hal_float_t, 1) * PARAM(hal_float_t, 4)
+		+ PARAM(hal_float_t, 5);
+	    break;
+	case HAL_FUSE_BIT_S32:
+	    PIN(hal_s32_t, 1) = PIN(hal_bit_t, 0);
+	    break;
+	case HAL_FUSE_BIT_U32:
+	    PIN(hal_u32_t, 1) = PIN(hal_bit_t, 0);
+	    break;
+	case HAL_FUSE_S32_FLOAT:
+	    PIN(hal_float_t, 1) = PIN(hal_s32_t, 0);
+	    break;
+	case HAL_FUSE_U32_FLOAT:
+	    PIN(hal_float_t, 1) = PIN(hal_u32_t, 0);
+	    break;
+	}
+    }
+}
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    hal_fuse_t *fuse;
+    hal_funct_t *funct;
+    char name[HAL_NAME_LEN + 1];
+    int n, retval;
+
+    if (count < 1 || count > MAX_FUSE) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "FUSE: ERROR: count must be 1 to %d\n", MAX_FUSE);
+	return -EINVAL;
+    }
+    comp_id = hal_init("fuse");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "FUSE: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    for (n = 0; n < count; n++) {
+	fuse = hal_malloc(sizeof(hal_fuse_t));
+	if (fuse == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"FUSE: ERROR: hal_malloc() failed\n");
+	    hal_exit(comp_id);
+	    return -ENOMEM;
+	}
+	memset(fuse, 0, sizeof(hal_fuse_t));
+	rtapi_snprintf(name, sizeof(name), "fuse.%d", n);
+	retval = hal_export_funct(name, fuse_run, fuse, 1, 0, comp_id);
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"FUSE: ERROR: function '%s' export failed\n", name);
+	    hal_exit(comp_id);
+	    return retval;
+	}
+	/* offer the kernel to hal_fuse_thread() */
+	halpr_mutex_get();
+	funct = halpr_find_funct_by_name(name);
+	fuse->funct_ptr = SHMOFF(funct);
+	fuse->next_ptr = hal_data->fuse_list_ptr;
+	hal_data->fuse_list_ptr = SHMOFF(fuse);
+	halpr_mutex_give();
+	fuses[n] = fuse;
+    }
+    rtapi_print_msg(RTAPI_MSG_INFO, "FUSE: installed %d kernels\n", count);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    hal_thread_t *thread;
+    int n, *next;
+
+    /* give the fused functions back to their threads */
+    for (n = 0; n < count && n < MAX_FUSE; n++) {
+	if (fuses[n] != 0 && fuses[n]->thread_ptr != 0) {
+	    thread = SHMPTR(fuses[n]->thread_ptr);
+	    hal_unfuse_thread(thread->name);
+	}
+    }
+    halpr_mutex_get();
+    for (n = 0; n < count && n < MAX_FUSE; n++) {
+	if (fuses[n] == 0) {
+	    continue;
+	}
+	next = &(hal_data->fuse_list_ptr);
+	while (*next != 0) {
+	    if (*next == SHMOFF(fuses[n])) {
+		*next = fuses[n]->next_ptr;
+		break;
+	    }
+	    next = &(((hal_fuse_t *) SHMPTR(*next))->next_ptr);
+	}
+    }
+    halpr_mutex_give();
+    hal_exit(comp_id);
+}
@@ -0,0 +1,356 @@
+/********************************************************************
+* Description:  halbench.c
+*               This file, 'halbench.c', is a HAL component that
+*               measures what it costs a thread to call a function
+*               and a function to get at a pin.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'halbench.c', is a HAL component for benchmarking HAL
+    itself.  It exports 'calls' functions that do nothing and 'stages'
+    functions that between them copy 'pins' s32 input pins to as many
+    output pins, adding one.  Added to a thread in the order
+
+    halbench.start, halbench.nop.0 .. N, halbench.mark,
+    halbench.stage.0 .. N, halbench.end
+
+    it times each period's run of the empty functions, which is the
+    thread's cost of calling a function, and of the stages, which less
+    the calls is the cost of reading or writing a pin.  Each stage's
+    outputs can be netted to the next stage's inputs, to have a chain
+    that passes data like a real configuration; the last stage's
+    outputs are then the number of stages.
+
+    The figures are in ns and are on output pins, as the best period
+    and as the mean since the last reset.  The clock reading itself is
+    timed in 'start' and taken off.
+
+    Loading:
+
+    loadrt halbench calls=100 pins=1000 stages=10
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+#include "hal.h"		/* HAL public API decls */
+#include "rtapi_errno.h"
+#include "rtapi_string.h"
+
+/* module information */
+MODULE_DESCRIPTION("Function call and pin access benchmark for HAL");
+MODULE_LICENSE("GPL");
+
+static int calls = 100;		/* number of empty functions */
+RTAPI_MP_INT(calls, "number of empty functions");
+static int pins = 1000;		/* number of input and of output pins */
+RTAPI_MP_INT(pins, "number of pins in each direction");
+static int stages = 10;		/* number of functions copying pins */
+RTAPI_MP_INT(stages, "number of functions the pins are split over");
+
+/***********************************************************************
+*                STRUCTURES AND GLOBAL VARIABLES                       *
+************************************************************************/
+
+/* one of the functions that copy pins */
+
+typedef struct {
+    int first;			/* its first pin */
+    int count;			/* and how many */
+} stage_t;
+
+/* this structure contains the HAL shared memory data for the component */
+
+typedef struct {
+    hal_s32_t **in;		/* pins: copied from */
+    hal_s32_t **out;		/* pins: copied to, plus one */
+    stage_t *stage;
+    hal_bit_t *reset;		/* pin: clear the figures */
+    hal_float_t *call_ns;	/* pin: best cost of a call, ns */
+    hal_float_t *pin_ns;	/* pin: best cost of a pin access, ns */
+    hal_float_t *call_ns_avg;	/* pin: mean cost of a call */
+    hal_float_t *pin_ns_avg;	/* pin: mean cost of a pin access */
+    hal_u32_t *samples;		/* pin: periods measured */
+    long long clock_ns;		/* least time to read the clock */
+    long long start;		/* when the calls started, 0 if not yet */
+    long long mark;		/* when they ended, 0 if not yet */
+    double call_sum;		/* for the means */
+    double pin_sum;
+} bench_t;
+
+/* other globals */
+static int comp_id;		/* component ID */
+static bench_t *bench;
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static int export_bench(void);
+static void bench_start(void *arg, long period);
+static void bench_nop(void *arg, long period);
+static void bench_mark(void *arg, long period);
+static void bench_stage(void *arg, long period);
+static void bench_end(void *arg, long period);
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    int retval;
+
+    if (calls < 1 || pins < 1 || stages < 1 || stages > pins) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HALBENCH: ERROR: calls and pins must be at least 1, and "
+	    "stages from 1 to pins\n");
+	return -EINVAL;
+    }
+    comp_id = hal_init("halbench");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "HALBENCH: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    retval = export_bench();
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "HALBENCH: ERROR: export failed\n");
+	hal_exit(comp_id);
+	return retval;
+    }
+    rtapi_print_msg(RTAPI_MSG_INFO,
+	"HALBENCH: installed %d calls and %d pins in %d stages\n",
+	calls, pins, stages);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    hal_exit(comp_id);
+}
+
+/***********************************************************************
+*                     REALTIME MEASURING FUNCTIONS                     *
+************************************************************************/
+
+static void bench_start(void *arg, long period)
+{
+    bench_t *b;
+    long long t;
+
+    b = arg;
+    if (*(b->reset)) {
+	*(b->call_ns) = 0.0;
+	*(b->pin_ns) = 0.0;
+	*(b->call_ns_avg) = 0.0;
+	*(b->pin_ns_avg) = 0.0;
+	*(b->samples) = 0;
+	b->call_sum = 0.0;
+	b->pin_sum = 0.0;
+	b->clock_ns = 0;
+    }
+    t = rtapi_get_time();
+    b->start = rtapi_get_time();
+    if (b->clock_ns == 0 || b->start - t < b->clock_ns) {
+	b->clock_ns = b->start - t;
+    }
+    b->mark = 0;
+}
+
+static void bench_nop(void *arg, long period)
+{
+}
+
+static void bench_mark(void *arg, long period)
+{
+    bench_t *b;
+
+    b = arg;
+    b->mark = rtapi_get_time();
+}
+
+static void bench_stage(void *arg, long period)
+{
+    stage_t *s;
+    hal_s32_t **in, **out;
+    int n;
+
+    s = arg;
+    in = bench->in + s->first;
+    out = bench->out + s->first;
+    for (n = 0; n < s->count; n++) {
+	*(out[n]) = *(in[n]) + 1;
+    }
+}
+
+static void bench_end(void *arg, long period)
+{
+    bench_t *b;
+    long long now;
+    double call, pin;
+
+    b = arg;
+    now = rtapi_get_time();
+    if (b->start == 0 || b->mark == 0) {
+	return;
+    }
+    /* from start to mark there are the calls and mark's; from mark to
+       end the stages and end's, and each time one clock reading */
+    call = (double) (b->mark - b->start - b->clock_ns) / (calls + 1);
+    pin = ((double) (now - b->mark - b->clock_ns) - call * (stages + 1))
+	/ (2.0 * pins);
+    if (call < 0.0) {
+	call = 0.0;
+    }
+    if (pin < 0.0) {
+	pin = 0.0;
+    }
+    (*(b->samples))++;
+    if (*(b->samples) == 1 || call < *(b->call_ns)) {
+	*(b->call_ns) = call;
+    }
+    if (*(b->samples) == 1 || pin < *(b->pin_ns)) {
+	*(b->pin_ns) = pin;
+    }
+    b->call_sum += call;
+    b->pin_sum += pin;
+    *(b->call_ns_avg) = b->call_sum / *(b->samples);
+    *(b->pin_ns_avg) = b->pin_sum / *(b->samples);
+    b->start = 0;
+}
+
+/***********************************************************************
+*                   LOCAL FUNCTION DEFINITIONS                         *
+************************************************************************/
+
+static int export_bench(void)
+{
+    int n, retval;
+    bench_t *b;
+    char buf[HAL_NAME_LEN + 1];
+
+    b = hal_malloc(sizeof(bench_t));
+    if (b != 0) {
+	b->in = hal_malloc(pins * sizeof(hal_s32_t *));
+	b->out = hal_malloc(pins * sizeof(hal_s32_t *));
+	b->stage = hal_malloc(stages * sizeof(stage_t));
+    }
+    if (b == 0 || b->in == 0 || b->out == 0 || b->stage == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HALBENCH: ERROR: couldn't allocate HAL shared memory\n");
+	return -ENOMEM;
+    }
+    bench = b;
+    retval = hal_pin_bit_newf(HAL_IN, &(b->reset), comp_id,
+	"halbench.reset");
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_float_newf(HAL_OUT, &(b->call_ns), comp_id,
+	"halbench.ns-per-call");
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_float_newf(HAL_OUT, &(b->pin_ns), comp_id,
+	"halbench.ns-per-pin");
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_float_newf(HAL_OUT, &(b->call_ns_avg), comp_id,
+	"halbench.ns-per-call-avg");
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_float_newf(HAL_OUT, &(b->pin_ns_avg), comp_id,
+	"halbench.ns-per-pin-avg");
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_u32_newf(HAL_OUT, &(b->samples), comp_id,
+	"halbench.samples");
+    if (retval != 0) {
+	return retval;
+    }
+    for (n = 0; n < pins; n++) {
+	retval = hal_pin_s32_newf(HAL_IN, &(b->in[n]), comp_id,
+	    "halbench.in.%d", n);
+	if (retval != 0) {
+	    return retval;
+	}
+	retval = hal_pin_s32_newf(HAL_OUT, &(b->out[n]), comp_id,
+	    "halbench.out.%d", n);
+	if (retval != 0) {
+	    return retval;
+	}
+	*(b->in[n]) = 0;
+	*(b->out[n]) = 0;
+    }
+    *(b->reset) = 0;
+    *(b->call_ns) = 0.0;
+    *(b->pin_ns) = 0.0;
+    *(b->call_ns_avg) = 0.0;
+    *(b->pin_ns_avg) = 0.0;
+    *(b->samples) = 0;
+    b->clock_ns = 0;
+    b->start = 0;
+    b->mark = 0;
+    b->call_sum = 0.0;
+    b->pin_sum = 0.0;
+
+    retval = hal_export_funct("halbench.start", bench_start, b, 1, 0,
+	comp_id);
+    if (retval != 0) {
+	return retval;
+    }
+    for (n = 0; n < calls; n++) {
+	rtapi_snprintf(buf, sizeof(buf), "halbench.nop.%d", n);
+	retval = hal_export_funct(buf, bench_nop, b, 0, 0, comp_id);
+	if (retval != 0) {
+	    return retval;
+	}
+    }
+    retval = hal_export_funct("halbench.mark", bench_mark, b, 0, 0,
+	comp_id);
+    if (retval != 0) {
+	return retval;
+    }
+    /* the pins are split as evenly as they go, in order */
+    for (n = 0; n < stages; n++) {
+	b->stage[n].first = n * (pins / stages) + n * (pins % stages) / stages;
+	b->stage[n].count = (n + 1) * (pins / stages)
+	    + (n + 1) * (pins % stages) / stages - b->stage[n].first;
+	rtapi_snprintf(buf, sizeof(buf), "halbench.stage.%d", n);
+	retval = hal_export_funct(buf, bench_stage, &b->stage[n], 0, 0,
+	    comp_id);
+	if (retval != 0) {
+	    return retval;
+	}
+    }
+    return hal_export_funct("halbench.end", bench_end, b, 1, 0, comp_id);
+}
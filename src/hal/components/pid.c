@@ -96,6 +96,11 @@
     This component exports one function called 'pid.x.do-pid-calcs'
     for each PID loop.  This allows loops to be included in different
     threads and execute at different rates.
+
+    With "batch=1" it also exports 'pid.do-pid-calcs', which runs all
+    the loops in one call.  It gives the same results, but does the
+    output sums of all loops in one pass over contiguous arrays.  Use
+    either it or the per-loop functions, not both.
 */
 
 /** Copyright (C) 2003 John Kasunich
@@ -148,6 +153,9 @@ RTAPI_MP_ARRAY_STRING(names, MAX_CHAN,"pid names");
 static int debug = 0;		/* flag to export optional params */
 RTAPI_MP_INT(debug, "enables optional params");
 
+static int batch = 0;		/* flag to export pid.do-pid-calcs */
+RTAPI_MP_INT(batch, "also export one function for all loops");
+
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
 ************************************************************************/
@@ -204,6 +212,29 @@ typedef struct {
 /* pointer to array of pid_t structs in shared memory, 1 per loop */
 static hal_pid_t *pid_array;
 
+/** The batched function gathers the terms of the output sum for all
+    loops into these arrays, so the sum is one straight loop over
+    contiguous doubles that the compiler can vectorize.  Only the
+    batched function uses them, and it is not reentrant.
+*/
+static struct {
+    int enable[MAX_CHAN];
+    double error[MAX_CHAN];
+    double error_i[MAX_CHAN];
+    double error_d[MAX_CHAN];
+    double command[MAX_CHAN];
+    double cmd_d[MAX_CHAN];
+    double cmd_dd[MAX_CHAN];
+    double bias[MAX_CHAN];
+    double pgain[MAX_CHAN];
+    double igain[MAX_CHAN];
+    double dgain[MAX_CHAN];
+    double ff0gain[MAX_CHAN];
+    double ff1gain[MAX_CHAN];
+    double ff2gain[MAX_CHAN];
+    double output[MAX_CHAN];
+} pid_batch;
+
 /* other globals */
 static int comp_id;		/* component ID */
 
@@ -213,6 +244,7 @@ static int comp_id;		/* component ID */
 
 static int export_pid(hal_pid_t * addr,char * prefix);
 static void calc_pid(void *arg, long period);
+static void calc_pid_all(void *arg, long period);
 
 /***********************************************************************
 *                       INIT AND EXIT CODE                             *
@@ -273,6 +305,16 @@ int rtapi_app_main(void)
 	    return -1;
 	}
     }
+    if (batch) {
+	retval = hal_export_funct("pid.do-pid-calcs", calc_pid_all, 0, 1, 0,
+	    comp_id);
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"PID: ERROR: batched do_pid_calcs funct export failed\n");
+	    hal_exit(comp_id);
+	    return -1;
+	}
+    }
     rtapi_print_msg(RTAPI_MSG_INFO, "PID: installed %d PID loops\n",
 	howmany);
     hal_ready(comp_id);
@@ -288,18 +330,14 @@ void rtapi_app_exit(void)
 *                   REALTIME PID LOOP CALCULATIONS                     *
 ************************************************************************/
 
-static void calc_pid(void *arg, long period)
+/* does everything up to the output sum: returns the enable bit and
+   leaves the error, after the limits and deadband, in *error */
+static inline int pid_terms(hal_pid_t * pid, double periodfp,
+    double periodrecip, double *error)
 {
-    hal_pid_t *pid;
     double tmp1, tmp2, command, feedback;
     int enable;
-    double periodfp, periodrecip;
 
-    /* point to the data for this PID loop */
-    pid = arg;
-    /* precalculate some timing constants */
-    periodfp = period * 0.000000001;
-    periodrecip = 1.0 / periodfp;
     /* get the enable bit */
     enable = *(pid->enable);
     /* read the command and feedback only once */
@@ -397,14 +435,16 @@ static void calc_pid(void *arg, long period)
 	    *(pid->cmd_dd) = -*(pid->maxcmd_dd);
 	}
     }
-    /* do output calcs only if enabled */
+    *error = tmp1;
+    return enable;
+}
+
+/* applies the output limits and sets the output and 'saturated' pins */
+static inline void pid_output(hal_pid_t * pid, int enable, double tmp1,
+    long period)
+{
+    /* do output limits only if enabled */
     if (enable != 0) {
-	/* calculate the output value */
-	tmp1 =
-	    *(pid->bias) + *(pid->pgain) * tmp1 + *(pid->igain) * *(pid->error_i) +
-	    *(pid->dgain) * *(pid->error_d);
-	tmp1 += command * *(pid->ff0gain) + *(pid->cmd_d) * *(pid->ff1gain) +
-	    *(pid->cmd_dd) * *(pid->ff2gain);
 	/* apply output limits */
 	if (*(pid->maxoutput) != 0.0) {
 	    if (tmp1 > *(pid->maxoutput)) {
@@ -436,9 +476,78 @@ static void calc_pid(void *arg, long period)
         *(pid->saturated_s) = 0;
         *(pid->saturated_count) = 0;
     }
+}
+
+static void calc_pid(void *arg, long period)
+{
+    hal_pid_t *pid;
+    double tmp1, command;
+    int enable;
+    double periodfp, periodrecip;
+
+    /* point to the data for this PID loop */
+    pid = arg;
+    /* precalculate some timing constants */
+    periodfp = period * 0.000000001;
+    periodrecip = 1.0 / periodfp;
+    enable = pid_terms(pid, periodfp, periodrecip, &tmp1);
+    if (enable != 0) {
+	/* calculate the output value */
+	command = *(pid->command);
+	tmp1 =
+	    *(pid->bias) + *(pid->pgain) * tmp1 + *(pid->igain) * *(pid->error_i) +
+	    *(pid->dgain) * *(pid->error_d);
+	tmp1 += command * *(pid->ff0gain) + *(pid->cmd_d) * *(pid->ff1gain) +
+	    *(pid->cmd_dd) * *(pid->ff2gain);
+    }
+    pid_output(pid, enable, tmp1, period);
     /* done */
 }
 
+/* the same calculations for all loops, in three passes: the branchy
+   per-loop work, then the output sums for all loops at once, then
+   the output limits */
+static void calc_pid_all(void *arg, long period)
+{
+    hal_pid_t *pid;
+    double periodfp, periodrecip;
+    int n;
+
+    /* the timing constants are the same for every loop */
+    periodfp = period * 0.000000001;
+    periodrecip = 1.0 / periodfp;
+    for (n = 0; n < howmany; n++) {
+	pid = &(pid_array[n]);
+	pid_batch.enable[n] =
+	    pid_terms(pid, periodfp, periodrecip, &(pid_batch.error[n]));
+	pid_batch.error_i[n] = *(pid->error_i);
+	pid_batch.error_d[n] = *(pid->error_d);
+	pid_batch.command[n] = *(pid->command);
+	pid_batch.cmd_d[n] = *(pid->cmd_d);
+	pid_batch.cmd_dd[n] = *(pid->cmd_dd);
+	pid_batch.bias[n] = *(pid->bias);
+	pid_batch.pgain[n] = *(pid->pgain);
+	pid_batch.igain[n] = *(pid->igain);
+	pid_batch.dgain[n] = *(pid->dgain);
+	pid_batch.ff0gain[n] = *(pid->ff0gain);
+	pid_batch.ff1gain[n] = *(pid->ff1gain);
+	pid_batch.ff2gain[n] = *(pid->ff2gain);
+    }
+    for (n = 0; n < howmany; n++) {
+	pid_batch.output[n] =
+	    pid_batch.bias[n] + pid_batch.pgain[n] * pid_batch.error[n] +
+	    pid_batch.igain[n] * pid_batch.error_i[n] +
+	    pid_batch.dgain[n] * pid_batch.error_d[n];
+	pid_batch.output[n] += pid_batch.command[n] * pid_batch.ff0gain[n] +
+	    pid_batch.cmd_d[n] * pid_batch.ff1gain[n] +
+	    pid_batch.cmd_dd[n] * pid_batch.ff2gain[n];
+    }
+    for (n = 0; n < howmany; n++) {
+	pid_output(&(pid_array[n]), pid_batch.enable[n], pid_batch.output[n],
+	    period);
+    }
+}
+
 /***********************************************************************
 *                   LOCAL FUNCTION DEFINITIONS                         *
 ************************************************************************/
@@ -0,0 +1,314 @@
+/********************************************************************
+* Description:  rtapi_latency.c
+*               This file, 'rtapi_latency.c', is a HAL component
+*               that keeps histograms of how late a thread wakes up
+*               and how long its functions take.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'rtapi_latency.c', is the realtime part of a HAL
+    component that measures scheduling latency on the machine it runs
+    on, with whichever RTAPI it was built for.  Each instance exports
+    two functions for one thread: 'rtapi-latency.N.start', to be added
+    first, records how late the thread started its period, and
+    'rtapi-latency.N.end', to be added last, how long the functions in
+    between took.  Both go into log-scale histograms in user/RT shared
+    memory, which 'hallatency' reads and turns into counts, percentiles
+    and maxima since the last reset.
+
+    Lateness is measured against a schedule that starts at the first
+    wakeup and advances by the thread's period.  Waking early moves the
+    schedule to now, so drift between the clocks cannot show up as
+    latency; waking a whole period late counts an overrun and moves it
+    too, as the thread has then lost its place.
+
+    Loading:
+
+    loadrt rtapi_latency count=2
+    addf rtapi-latency.0.start servo-thread 1
+    addf rtapi-latency.0.end servo-thread
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+#include "hal.h"		/* HAL public API decls */
+#include "rtapi_latency.h"	/* decls for the user/RT shared memory */
+#include "rtapi_errno.h"
+#include "rtapi_string.h"
+
+/* module information */
+MODULE_DESCRIPTION("Thread latency histograms for HAL");
+MODULE_LICENSE("GPL");
+
+static int count = 1;		/* number of instances */
+RTAPI_MP_INT(count, "number of threads to measure");
+
+/* a wakeup this many periods late means the thread was stopped */
+#define STOPPED_PERIODS 1000
+
+/***********************************************************************
+*                STRUCTURES AND GLOBAL VARIABLES                       *
+************************************************************************/
+
+/* this structure contains the HAL shared memory data for one instance */
+
+typedef struct {
+    latency_shmem_t *shmem;	/* histograms, in user/RT shmem */
+    hal_bit_t *reset;		/* pin: clear the histograms */
+    hal_s32_t *max_latency;	/* pin: worst lateness since reset, ns */
+    hal_s32_t *max_exec;	/* pin: longest start to end, ns */
+    hal_s32_t *overruns;	/* pin: wakeups a period or more late */
+    long long expected;		/* when this period should have started */
+    long long start;		/* when it did, 0 if not yet */
+} latency_t;
+
+/* other globals */
+static int comp_id;		/* component ID */
+static int shmem_id[MAX_LATENCY];
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static int init_latency(int num);
+static void free_shmem(void);
+static void latency_start(void *arg, long period);
+static void latency_end(void *arg, long period);
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    int n, retval;
+
+    if (count < 1 || count > MAX_LATENCY) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: count must be 1 to %d\n", MAX_LATENCY);
+	return -EINVAL;
+    }
+    for (n = 0; n < MAX_LATENCY; n++) {
+	shmem_id[n] = -1;
+    }
+    comp_id = hal_init("rtapi_latency");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    for (n = 0; n < count; n++) {
+	retval = init_latency(n);
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"RTAPI_LATENCY: ERROR: instance %d init failed\n", n);
+	    free_shmem();
+	    hal_exit(comp_id);
+	    return retval;
+	}
+    }
+    rtapi_print_msg(RTAPI_MSG_INFO,
+	"RTAPI_LATENCY: installed %d latency histograms\n", count);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    free_shmem();
+    hal_exit(comp_id);
+}
+
+/***********************************************************************
+*                     REALTIME MEASURING FUNCTIONS                     *
+************************************************************************/
+
+static void hist_add(latency_hist_t * h, long long v)
+{
+    h->count[latency_bucket(v)]++;
+    h->samples++;
+    if (v > h->max) {
+	h->max = v;
+    }
+}
+
+static hal_s32_t clamp_s32(long long v)
+{
+    return v > 0x7fffffff ? 0x7fffffff : (hal_s32_t) v;
+}
+
+static void latency_start(void *arg, long period)
+{
+    latency_t *l;
+    latency_shmem_t *s;
+    long long now, late;
+
+    l = arg;
+    s = l->shmem;
+    now = rtapi_get_time();
+    if (*(l->reset) || s->reset) {
+	memset(&s->wake, 0, sizeof(s->wake));
+	memset(&s->exec, 0, sizeof(s->exec));
+	s->overruns = 0;
+	s->reset = 0;
+	l->expected = 0;
+	*(l->max_latency) = 0;
+	*(l->max_exec) = 0;
+	*(l->overruns) = 0;
+    }
+    s->period = period;
+    l->start = now;
+    if (l->expected == 0) {
+	l->expected = now + period;
+	return;
+    }
+    late = now - l->expected;
+    if (late < 0) {
+	/* early: the clocks have drifted apart */
+	l->expected = now + period;
+	late = 0;
+    } else if (late >= period) {
+	l->expected = now + period;
+	if (late >= STOPPED_PERIODS * (long long) period) {
+	    /* it was not running, rather than late */
+	    return;
+	}
+	s->overruns++;
+	*(l->overruns) = clamp_s32(s->overruns);
+    } else {
+	l->expected += period;
+    }
+    hist_add(&s->wake, late);
+    *(l->max_latency) = clamp_s32(s->wake.max);
+}
+
+static void latency_end(void *arg, long period)
+{
+    latency_t *l;
+    latency_shmem_t *s;
+
+    l = arg;
+    s = l->shmem;
+    if (l->start == 0) {
+	return;
+    }
+    hist_add(&s->exec, rtapi_get_time() - l->start);
+    *(l->max_exec) = clamp_s32(s->exec.max);
+    l->start = 0;
+}
+
+/***********************************************************************
+*                   LOCAL FUNCTION DEFINITIONS                         *
+************************************************************************/
+
+static void free_shmem(void)
+{
+    int n;
+
+    for (n = 0; n < MAX_LATENCY; n++) {
+	if (shmem_id[n] >= 0) {
+	    rtapi_shmem_delete(shmem_id[n], comp_id);
+	    shmem_id[n] = -1;
+	}
+    }
+}
+
+static int init_latency(int num)
+{
+    int retval;
+    void *shmem_ptr;
+    latency_t *l;
+    char buf[HAL_NAME_LEN + 1];
+
+    l = hal_malloc(sizeof(latency_t));
+    if (l == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: couldn't allocate HAL shared memory\n");
+	return -ENOMEM;
+    }
+    retval = hal_pin_bit_newf(HAL_IN, &(l->reset), comp_id,
+	"rtapi-latency.%d.reset", num);
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_s32_newf(HAL_OUT, &(l->max_latency), comp_id,
+	"rtapi-latency.%d.max-latency", num);
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_s32_newf(HAL_OUT, &(l->max_exec), comp_id,
+	"rtapi-latency.%d.max-exec", num);
+    if (retval != 0) {
+	return retval;
+    }
+    retval = hal_pin_s32_newf(HAL_OUT, &(l->overruns), comp_id,
+	"rtapi-latency.%d.overruns", num);
+    if (retval != 0) {
+	return retval;
+    }
+    *(l->reset) = 0;
+    *(l->max_latency) = 0;
+    *(l->max_exec) = 0;
+    *(l->overruns) = 0;
+    l->expected = 0;
+    l->start = 0;
+
+    shmem_id[num] = rtapi_shmem_new(RTAPI_LATENCY_SHMEM_KEY + num, comp_id,
+	sizeof(latency_shmem_t));
+    if (shmem_id[num] < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: couldn't allocate user/RT shared memory\n");
+	return -ENOMEM;
+    }
+    retval = rtapi_shmem_getptr(shmem_id[num], &shmem_ptr);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: couldn't map user/RT shared memory\n");
+	return -ENOMEM;
+    }
+    l->shmem = shmem_ptr;
+    memset(l->shmem, 0, sizeof(latency_shmem_t));
+    l->shmem->magic = RTAPI_LATENCY_MAGIC;
+
+    rtapi_snprintf(buf, sizeof(buf), "rtapi-latency.%d.start", num);
+    retval = hal_export_funct(buf, latency_start, l, 0, 0, comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: start function export failed\n");
+	return retval;
+    }
+    rtapi_snprintf(buf, sizeof(buf), "rtapi-latency.%d.end", num);
+    retval = hal_export_funct(buf, latency_end, l, 0, 0, comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_LATENCY: ERROR: end function export failed\n");
+	return retval;
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef RTAPI_LATENCY_H
+#define RTAPI_LATENCY_H
+
+/* Shared between the realtime module 'rtapi_latency' and 'hallatency',
+   which reads it.  Each instance has one block of user/RT shared
+   memory, at RTAPI_LATENCY_SHMEM_KEY plus its number. */
+
+#define RTAPI_LATENCY_SHMEM_KEY	0x484c4130
+#define RTAPI_LATENCY_MAGIC	0x4c415431
+#define MAX_LATENCY		8
+
+/* Log-scale buckets, four to each power of two: values below 4 ns have
+   a bucket each, and from there on a bucket is at most 25% wide.  The
+   last one, from about 960 seconds, holds everything longer. */
+#define RTAPI_LATENCY_MAX_EXP	39
+#define RTAPI_LATENCY_BUCKETS	(4 * RTAPI_LATENCY_MAX_EXP)
+
+typedef struct {
+    unsigned long long count[RTAPI_LATENCY_BUCKETS];
+    unsigned long long samples;	/* sum of count[] */
+    long long max;		/* largest value seen, ns */
+} latency_hist_t;
+
+typedef struct {
+    int magic;			/* RTAPI_LATENCY_MAGIC once set up */
+    volatile int reset;		/* set by a reader, cleared by RT */
+    long period;		/* of the thread it runs in, ns */
+    unsigned long long overruns;	/* wakeups a whole period late */
+    latency_hist_t wake;	/* how late each period started */
+    latency_hist_t exec;	/* from 'start' to 'end', if both run */
+} latency_shmem_t;
+
+static inline int latency_bucket(long long v)
+{
+    int e;
+
+    if (v < 4) {
+	return v < 0 ? 0 : (int) v;
+    }
+    e = 63 - __builtin_clzll((unsigned long long) v);
+    if (e > RTAPI_LATENCY_MAX_EXP) {
+	return RTAPI_LATENCY_BUCKETS - 1;
+    }
+    return 4 * (e - 1) + (int) ((v >> (e - 2)) & 3);
+}
+
+/* smallest value that goes in bucket i */
+static inline long long latency_bucket_low(int i)
+{
+    if (i < 4) {
+	return i;
+    }
+    return (long long) (4 + i % 4) << (i / 4 - 1);
+}
+
+#endif
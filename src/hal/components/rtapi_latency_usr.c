@@ -0,0 +1,329 @@
+/********************************************************************
+* Description:  rtapi_latency_usr.c
+*               User space part of "rtapi_latency", a HAL component
+*		that keeps histograms of thread wakeup latency and
+*		execution time.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'rtapi_latency_usr.c', is the user part of the HAL
+    component 'rtapi_latency'.  It reads the histograms the realtime
+    module keeps in shared memory and prints, for each instance, one
+    line of name=value fields: the thread period, how many periods
+    were measured, the overruns, and the 50th, 90th, 99th, 99.9th and
+    99.99th percentile and maximum wakeup latency and execution time,
+    in nanoseconds.  Percentiles are the top of the histogram bucket
+    they fall in, so they are at most 25% high.
+
+    Invoking:
+
+    hallatency [-c chan_num] [-r] [-u seconds] [-v]
+
+    'chan_num', if present, reports only that instance; otherwise all
+    the loaded ones are reported.
+
+    '-r' clears the histograms after they have been read.
+
+    '-u seconds' prints the figures again every 'seconds' until killed.
+
+    '-v' also prints each histogram's non-empty buckets, one per line,
+    as the range of the bucket in nanoseconds and its count.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"                /* HAL public API decls */
+#include "rtapi_latency.h"
+
+/***********************************************************************
+*                         GLOBAL VARIABLES                             *
+************************************************************************/
+
+int comp_id = -1;	/* -1 means hal_init() not called yet */
+int shmem_id[MAX_LATENCY];
+int exitval = 1;	/* program return code - 1 means error */
+int ignore_sig = 0;	/* used to flag critical regions */
+char comp_name[HAL_NAME_LEN+1];	/* name for this instance of hallatency */
+
+static const double fractions[] = { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+static const char *fraction_names[] = { "p50", "p90", "p99", "p99.9",
+    "p99.99" };
+#define NUM_FRACTIONS (sizeof(fractions) / sizeof(fractions[0]))
+
+/***********************************************************************
+*                            MAIN PROGRAM                              *
+************************************************************************/
+
+static void detach(void)
+{
+    int n;
+
+    for ( n = 0 ; n < MAX_LATENCY ; n++ ) {
+	if ( shmem_id[n] >= 0 ) {
+	    rtapi_shmem_delete(shmem_id[n], comp_id);
+	    shmem_id[n] = -1;
+	}
+    }
+    if ( comp_id >= 0 ) {
+	hal_exit(comp_id);
+	comp_id = -1;
+    }
+}
+
+/* signal handler */
+static void quit(int sig)
+{
+    if ( ignore_sig ) {
+	return;
+    }
+    detach();
+    exit(exitval);
+}
+
+/* the smallest bucket top that at least 'fraction' of the samples are
+   at or below, but no more than the largest sample */
+static long long percentile(const latency_hist_t *h,
+    unsigned long long total, double fraction)
+{
+    unsigned long long want, seen;
+    long long top;
+    int i;
+
+    want = (unsigned long long)(fraction * total + 0.5);
+    if ( want < 1 ) {
+	want = 1;
+    }
+    seen = 0;
+    for ( i = 0 ; i < RTAPI_LATENCY_BUCKETS - 1 ; i++ ) {
+	seen += h->count[i];
+	if ( seen >= want ) {
+	    break;
+	}
+    }
+    top = i < RTAPI_LATENCY_BUCKETS - 1 ? latency_bucket_low(i + 1) - 1
+	: h->max;
+    return top < h->max ? top : h->max;
+}
+
+static void print_hist(const char *name, const latency_hist_t *h)
+{
+    unsigned long long total;
+    unsigned n;
+    int i;
+
+    total = 0;
+    for ( i = 0 ; i < RTAPI_LATENCY_BUCKETS ; i++ ) {
+	total += h->count[i];
+    }
+    for ( n = 0 ; n < NUM_FRACTIONS ; n++ ) {
+	printf(" %s_%s_ns=%lld", name, fraction_names[n],
+	    total ? percentile(h, total, fractions[n]) : 0);
+    }
+    printf(" %s_max_ns=%lld", name, h->max);
+}
+
+static void print_buckets(const char *name, const latency_hist_t *h)
+{
+    int i;
+
+    for ( i = 0 ; i < RTAPI_LATENCY_BUCKETS ; i++ ) {
+	if ( h->count[i] == 0 ) {
+	    continue;
+	}
+	if ( i < RTAPI_LATENCY_BUCKETS - 1 ) {
+	    printf("  %s %lld-%lld %llu\n", name, latency_bucket_low(i),
+		latency_bucket_low(i + 1) - 1, h->count[i]);
+	} else {
+	    printf("  %s %lld- %llu\n", name, latency_bucket_low(i),
+		h->count[i]);
+	}
+    }
+}
+
+static void report(int chan, latency_shmem_t *shmem, int verbose)
+{
+    latency_shmem_t copy;
+
+    /* work from a copy, so the figures on one line agree */
+    memcpy(&copy, shmem, sizeof(copy));
+    printf("rtapi-latency.%d period_ns=%ld samples=%llu overruns=%llu",
+	chan, copy.period, copy.wake.samples, copy.overruns);
+    print_hist("latency", &copy.wake);
+    print_hist("exec", &copy.exec);
+    printf("\n");
+    if ( verbose ) {
+	print_buckets("latency", &copy.wake);
+	print_buckets("exec", &copy.exec);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int n, channel, reset, verbose, found, retval;
+    double update;
+    char *cp, *cp2;
+    void *shmem_ptr;
+    latency_shmem_t *shmem[MAX_LATENCY];
+    struct timespec delay;
+
+    /* set return code to "fail", clear it later if all goes well */
+    exitval = 1;
+    channel = -1;
+    reset = 0;
+    verbose = 0;
+    update = 0.0;
+    for ( n = 0 ; n < MAX_LATENCY ; n++ ) {
+	shmem_id[n] = -1;
+	shmem[n] = NULL;
+    }
+    for ( n = 1 ; n < argc ; n++ ) {
+	cp = argv[n];
+	if ( *cp != '-' ) {
+	    break;
+	}
+	switch ( *(++cp) ) {
+	case 'c':
+	    if (( *(++cp) == '\0' ) && ( ++n < argc )) {
+		cp = argv[n];
+	    }
+	    channel = strtol(cp, &cp2, 10);
+	    if (( *cp2 ) || ( channel < 0 ) || ( channel >= MAX_LATENCY )) {
+		fprintf(stderr,"ERROR: invalid channel number '%s'\n", cp );
+		exit(1);
+	    }
+	    break;
+	case 'u':
+	    if (( *(++cp) == '\0' ) && ( ++n < argc )) {
+		cp = argv[n];
+	    }
+	    update = strtod(cp, &cp2);
+	    if (( *cp2 ) || ( update <= 0.0 )) {
+		fprintf(stderr, "ERROR: invalid update interval '%s'\n", cp );
+		exit(1);
+	    }
+	    break;
+	case 'r':
+	    reset = 1;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	default:
+	    fprintf(stderr,"ERROR: unknown option '%s'\n", cp );
+	    exit(1);
+	    break;
+	}
+    }
+    if ( n < argc ) {
+	fprintf(stderr, "ERROR: unexpected argument '%s'\n", argv[n]);
+	exit(1);
+    }
+    /* register signal handlers - if the process is killed
+       we need to call hal_exit() to free the shared memory */
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, quit);
+    /* create a unique module name, to allow for multiple readers */
+    snprintf(comp_name, sizeof(comp_name), "hallatency%d", getpid());
+    /* connect to the HAL */
+    ignore_sig = 1;
+    comp_id = hal_init(comp_name);
+    ignore_sig = 0;
+    /* check result */
+    if (comp_id < 0) {
+	fprintf(stderr, "ERROR: hal_init() failed: %d\n", comp_id );
+	goto out;
+    }
+    hal_ready(comp_id);
+    /* open the shmem of each instance asked for that is loaded */
+    found = 0;
+    for ( n = 0 ; n < MAX_LATENCY ; n++ ) {
+	if ( channel >= 0 && n != channel ) {
+	    continue;
+	}
+	shmem_id[n] = rtapi_shmem_new(RTAPI_LATENCY_SHMEM_KEY + n, comp_id,
+	    sizeof(latency_shmem_t));
+	if ( shmem_id[n] < 0 ) {
+	    fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
+	    goto out;
+	}
+	retval = rtapi_shmem_getptr(shmem_id[n], &shmem_ptr);
+	if ( retval < 0 ) {
+	    fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
+	    goto out;
+	}
+	if ( ((latency_shmem_t *) shmem_ptr)->magic != RTAPI_LATENCY_MAGIC ) {
+	    rtapi_shmem_delete(shmem_id[n], comp_id);
+	    shmem_id[n] = -1;
+	    continue;
+	}
+	shmem[n] = shmem_ptr;
+	found++;
+    }
+    if ( found == 0 ) {
+	if ( channel >= 0 ) {
+	    fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n",
+		channel );
+	} else {
+	    fprintf(stderr, "ERROR: rtapi_latency is not loaded\n");
+	}
+	goto out;
+    }
+    while ( 1 ) {
+	for ( n = 0 ; n < MAX_LATENCY ; n++ ) {
+	    if ( shmem[n] == NULL ) {
+		continue;
+	    }
+	    report(n, shmem[n], verbose);
+	    if ( reset ) {
+		shmem[n]->reset = 1;
+	    }
+	}
+	fflush(stdout);
+	if ( update <= 0.0 ) {
+	    break;
+	}
+	delay.tv_sec = (time_t) update;
+	delay.tv_nsec = (long)((update - delay.tv_sec) * 1e9);
+	nanosleep(&delay, NULL);
+    }
+    /* run was succesfull */
+    exitval = 0;
+
+out:
+    ignore_sig = 1;
+    detach();
+    return exitval;
+}
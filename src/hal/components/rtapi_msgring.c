@@ -0,0 +1,219 @@
+/********************************************************************
+* Description:  rtapi_msgring.c
+*               This file, 'rtapi_msgring.c', is a HAL component
+*               that takes realtime messages off the print path and
+*               queues them for 'halmsgd' to print.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'rtapi_msgring.c', is the realtime part of a component
+    that replaces the RTAPI message handler.  With it loaded, a call to
+    rtapi_print or rtapi_print_msg in realtime code formats the message
+    into a short fixed-size record in a ring in user/RT shared memory
+    and returns, instead of going through rt_printk or stdio;
+    'halmsgd' drains the ring and prints the messages.
+
+    The ring takes any number of writers without a lock, so a servo
+    thread can print while a base thread preempts it.  A message that
+    does not fit is cut short, and one that finds the ring full is
+    dropped and counted.  Each call site, known by its format string,
+    may queue at most 'rate' messages a second; the rest are counted
+    and dropped, so a message in a fast thread cannot fill the ring.
+
+    While no 'halmsgd' is attached, messages go to the handler that was
+    there before, as they did without this module.
+
+    Loading:
+
+    loadrt rtapi_msgring rate=20
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+#include "hal.h"		/* HAL public API decls */
+#include "rtapi_msgring.h"	/* decls for the user/RT shared memory */
+#include "rtapi_errno.h"
+#include "rtapi_string.h"
+
+/* module information */
+MODULE_DESCRIPTION("Lock-free queue for realtime messages");
+MODULE_LICENSE("GPL");
+
+static int rate = 20;		/* messages per second per call site */
+RTAPI_MP_INT(rate, "messages a second each call site may queue");
+
+/* call sites whose rate is tracked; a site whose slot another takes
+   over starts counting afresh, which errs towards letting it through */
+#define SITES 64
+
+/***********************************************************************
+*                STRUCTURES AND GLOBAL VARIABLES                       *
+************************************************************************/
+
+typedef struct {
+    const char *fmt;		/* format string of the call site */
+    long long window;		/* when its current second started */
+    unsigned int count;		/* messages queued in that second */
+} site_t;
+
+static int comp_id;		/* component ID */
+static int shmem_id = -1;
+static msgring_shmem_t *shmem;
+static site_t sites[SITES];
+static rtapi_msg_handler_t old_handler;
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static void msgring_handler(msg_level_t level, const char *fmt, va_list ap);
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    int n, retval;
+    void *shmem_ptr;
+
+    if (rate < 1) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_MSGRING: ERROR: rate must be at least 1\n");
+	return -EINVAL;
+    }
+    comp_id = hal_init("rtapi_msgring");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_MSGRING: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    shmem_id = rtapi_shmem_new(RTAPI_MSGRING_SHMEM_KEY, comp_id,
+	sizeof(msgring_shmem_t));
+    if (shmem_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_MSGRING: ERROR: couldn't allocate user/RT shared memory\n");
+	hal_exit(comp_id);
+	return -ENOMEM;
+    }
+    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "RTAPI_MSGRING: ERROR: couldn't map user/RT shared memory\n");
+	rtapi_shmem_delete(shmem_id, comp_id);
+	hal_exit(comp_id);
+	return -ENOMEM;
+    }
+    shmem = shmem_ptr;
+    /* a reader that was already attached stays attached */
+    shmem->head = 0;
+    shmem->tail = 0;
+    shmem->dropped = 0;
+    shmem->limited = 0;
+    for (n = 0; n < RTAPI_MSGRING_RECORDS; n++) {
+	shmem->ring[n].seq = n;
+    }
+    __sync_synchronize();
+    shmem->magic = RTAPI_MSGRING_MAGIC;
+
+    old_handler = rtapi_get_msg_handler();
+    rtapi_set_msg_handler(msgring_handler);
+    rtapi_print_msg(RTAPI_MSG_INFO,
+	"RTAPI_MSGRING: installed, %d records\n", RTAPI_MSGRING_RECORDS);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    rtapi_set_msg_handler(old_handler);
+    shmem->magic = 0;
+    rtapi_shmem_delete(shmem_id, comp_id);
+    hal_exit(comp_id);
+}
+
+/***********************************************************************
+*                        MESSAGE HANDLER                               *
+************************************************************************/
+
+/* whether the call site 'fmt' may queue another message this second */
+static int site_allows(const char *fmt)
+{
+    site_t *s;
+    long long now;
+
+    s = &sites[((unsigned long) fmt >> 2) % SITES];
+    now = rtapi_get_time();
+    if (s->fmt != fmt || now - s->window >= 1000000000LL) {
+	s->fmt = fmt;
+	s->window = now;
+	s->count = 0;
+    }
+    if (s->count >= (unsigned int) rate) {
+	return 0;
+    }
+    s->count++;
+    return 1;
+}
+
+static void msgring_handler(msg_level_t level, const char *fmt, va_list ap)
+{
+    msgring_record_t *r;
+    unsigned int pos;
+    int dif;
+
+    if (!shmem->reader) {
+	old_handler(level, fmt, ap);
+	return;
+    }
+    if (!site_allows(fmt)) {
+	__sync_fetch_and_add(&shmem->limited, 1);
+	return;
+    }
+    /* claim a record */
+    while (1) {
+	pos = shmem->head;
+	r = &shmem->ring[pos & (RTAPI_MSGRING_RECORDS - 1)];
+	dif = (int) (r->seq - pos);
+	if (dif == 0) {
+	    if (__sync_bool_compare_and_swap(&shmem->head, pos, pos + 1)) {
+		break;
+	    }
+	} else if (dif < 0) {
+	    /* the reader has not got this far yet */
+	    __sync_fetch_and_add(&shmem->dropped, 1);
+	    return;
+	}
+	/* another writer took it first; try the next one */
+    }
+    r->level = level;
+    rtapi_vsnprintf(r->text, RTAPI_MSGRING_TEXT, fmt, ap);
+    __sync_synchronize();
+    r->seq = pos + 1;
+}
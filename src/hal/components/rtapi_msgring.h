@@ -0,0 +1,37 @@
+#ifndef RTAPI_MSGRING_H
+#define RTAPI_MSGRING_H
+
+/* Shared between the realtime module 'rtapi_msgring' and 'halmsgd',
+   which drains it.  One block of user/RT shared memory holds a ring of
+   fixed-size records, each one message already formatted.
+
+   Any number of writers, in any thread, and one reader.  Each record
+   has a sequence number: a record the writers may take next has
+   seq == its position, one that holds a message has seq == position+1,
+   and when the reader is done with it it becomes position+RECORDS,
+   ready for the next lap.  A writer claims a position by advancing
+   'head' with compare-and-swap, fills the record in, and then
+   publishes it by setting seq; a full ring drops the message. */
+
+#define RTAPI_MSGRING_SHMEM_KEY	0x484d5347
+#define RTAPI_MSGRING_MAGIC	0x4d534731
+#define RTAPI_MSGRING_RECORDS	512	/* must be a power of 2 */
+#define RTAPI_MSGRING_TEXT	120
+
+typedef struct {
+    volatile unsigned int seq;
+    int level;			/* RTAPI_MSG_* */
+    char text[RTAPI_MSGRING_TEXT];	/* NUL terminated, may be cut short */
+} msgring_record_t;
+
+typedef struct {
+    int magic;			/* RTAPI_MSGRING_MAGIC once set up */
+    volatile int reader;	/* pid of the reader draining it, or 0 */
+    volatile unsigned int head;	/* next position for a writer */
+    volatile unsigned int tail;	/* next position for the reader */
+    volatile unsigned int dropped;	/* ring was full */
+    volatile unsigned int limited;	/* over the rate for its call site */
+    msgring_record_t ring[RTAPI_MSGRING_RECORDS];
+} msgring_shmem_t;
+
+#endif
@@ -0,0 +1,235 @@
+/********************************************************************
+* Description:  rtapi_msgring_usr.c
+*               User space part of "rtapi_msgring", a HAL component
+*		that queues realtime messages for printing.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'rtapi_msgring_usr.c', is the user part of the
+    component 'rtapi_msgring'.  It attaches to the ring of messages the
+    realtime module queues, and prints them on stdout as they come,
+    along with how many were dropped because the ring was full or their
+    call site was over its rate.  While it runs, realtime messages go
+    only to it; once it exits they go back to the usual handler.
+
+    Invoking:
+
+    halmsgd [-i milliseconds]
+
+    'milliseconds' is how often the ring is checked, 100 by default.
+    The ring holds 512 messages, so the servo thread can print several
+    each period without any being lost.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"                /* HAL public API decls */
+#include "rtapi_msgring.h"
+
+/***********************************************************************
+*                         GLOBAL VARIABLES                             *
+************************************************************************/
+
+int comp_id = -1;	/* -1 means hal_init() not called yet */
+int shmem_id = -1;
+int exitval = 1;	/* program return code - 1 means error */
+int ignore_sig = 0;	/* used to flag critical regions */
+char comp_name[HAL_NAME_LEN+1];	/* name for this instance of halmsgd */
+msgring_shmem_t *shmem = NULL;
+
+/***********************************************************************
+*                            MAIN PROGRAM                              *
+************************************************************************/
+
+static void detach(void)
+{
+    if ( shmem != NULL && shmem->reader == getpid() ) {
+	shmem->reader = 0;
+    }
+    shmem = NULL;
+    if ( shmem_id >= 0 ) {
+	rtapi_shmem_delete(shmem_id, comp_id);
+	shmem_id = -1;
+    }
+    if ( comp_id >= 0 ) {
+	hal_exit(comp_id);
+	comp_id = -1;
+    }
+}
+
+/* signal handler */
+static void quit(int sig)
+{
+    if ( ignore_sig ) {
+	return;
+    }
+    exitval = 0;
+    detach();
+    exit(exitval);
+}
+
+/* print every message that is ready; returns how many there were */
+static int drain(void)
+{
+    msgring_record_t *r;
+    unsigned int pos;
+    int n, len;
+
+    n = 0;
+    while ( 1 ) {
+	pos = shmem->tail;
+	r = &shmem->ring[pos & (RTAPI_MSGRING_RECORDS - 1)];
+	if ( r->seq != pos + 1 ) {
+	    break;
+	}
+	__sync_synchronize();
+	r->text[RTAPI_MSGRING_TEXT - 1] = '\0';
+	len = strlen(r->text);
+	fputs(r->text, stdout);
+	if ( len == 0 || r->text[len - 1] != '\n' ) {
+	    putchar('\n');
+	}
+	__sync_synchronize();
+	r->seq = pos + RTAPI_MSGRING_RECORDS;
+	shmem->tail = pos + 1;
+	n++;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int n, retval, interval;
+    unsigned int dropped, limited;
+    char *cp, *cp2;
+    void *shmem_ptr;
+    struct timespec delay;
+
+    /* set return code to "fail", clear it later if all goes well */
+    exitval = 1;
+    interval = 100;
+    for ( n = 1 ; n < argc ; n++ ) {
+	cp = argv[n];
+	if ( *cp != '-' ) {
+	    break;
+	}
+	switch ( *(++cp) ) {
+	case 'i':
+	    if (( *(++cp) == '\0' ) && ( ++n < argc )) {
+		cp = argv[n];
+	    }
+	    interval = strtol(cp, &cp2, 10);
+	    if (( *cp2 ) || ( interval < 1 )) {
+		fprintf(stderr, "ERROR: invalid interval '%s'\n", cp );
+		exit(1);
+	    }
+	    break;
+	default:
+	    fprintf(stderr,"ERROR: unknown option '%s'\n", cp );
+	    exit(1);
+	    break;
+	}
+    }
+    if ( n < argc ) {
+	fprintf(stderr, "ERROR: unexpected argument '%s'\n", argv[n]);
+	exit(1);
+    }
+    /* register signal handlers - if the process is killed
+       we need to call hal_exit() to free the shared memory */
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, quit);
+    snprintf(comp_name, sizeof(comp_name), "halmsgd%d", getpid());
+    /* connect to the HAL */
+    ignore_sig = 1;
+    comp_id = hal_init(comp_name);
+    ignore_sig = 0;
+    /* check result */
+    if (comp_id < 0) {
+	fprintf(stderr, "ERROR: hal_init() failed: %d\n", comp_id );
+	goto out;
+    }
+    hal_ready(comp_id);
+    shmem_id = rtapi_shmem_new(RTAPI_MSGRING_SHMEM_KEY, comp_id,
+	sizeof(msgring_shmem_t));
+    if ( shmem_id < 0 ) {
+	fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
+	goto out;
+    }
+    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr);
+    if ( retval < 0 ) {
+	fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
+	goto out;
+    }
+    shmem = shmem_ptr;
+    if ( shmem->magic != RTAPI_MSGRING_MAGIC ) {
+	fprintf(stderr, "ERROR: rtapi_msgring is not loaded\n");
+	goto out;
+    }
+    /* one reader at a time; one that died without detaching
+       does not count */
+    if ( shmem->reader != 0 && kill(shmem->reader, 0) == 0 ) {
+	fprintf(stderr, "ERROR: halmsgd is already running as pid %d\n",
+	    shmem->reader);
+	shmem = NULL;
+	goto out;
+    }
+    shmem->reader = getpid();
+    dropped = shmem->dropped;
+    limited = shmem->limited;
+    delay.tv_sec = interval / 1000;
+    delay.tv_nsec = (interval % 1000) * 1000000L;
+    while ( shmem->magic == RTAPI_MSGRING_MAGIC ) {
+	if ( drain() ) {
+	    fflush(stdout);
+	}
+	if ( shmem->dropped != dropped || shmem->limited != limited ) {
+	    printf("halmsgd: %u messages dropped with the ring full, "
+		"%u over their rate\n", shmem->dropped - dropped,
+		shmem->limited - limited);
+	    fflush(stdout);
+	    dropped = shmem->dropped;
+	    limited = shmem->limited;
+	}
+	nanosleep(&delay, NULL);
+    }
+    /* the realtime module was unloaded */
+    exitval = 0;
+
+out:
+    ignore_sig = 1;
+    detach();
+    return exitval;
+}
@@ -22,6 +22,16 @@
 
     loadrt sampler depth=100 cfg=uffb
 
+    With 'window=N' each record holds the min, max, mean and last
+    value of every float pin (min, max and last of s32 and u32 pins,
+    and whether a bit pin was ever TRUE and its last value) over N
+    periods, instead of one period's values.
+
+    With 'pretrigger=' or 'posttrigger=' set, a 'trigger' pin is
+    exported and records only go to the fifo around the times it is
+    TRUE: the last 'pretrigger' records from before, every record in
+    which it was TRUE, and 'posttrigger' records after.  The records
+    in between are dropped, and the sample numbers skip them.
 
 */
 
@@ -68,6 +78,14 @@ static char *cfg[MAX_SAMPLERS];	/* config string, no default */
 RTAPI_MP_ARRAY_STRING(cfg,MAX_SAMPLERS,"config string");
 static int depth[MAX_SAMPLERS];	/* depth of fifo, default 0 */
 RTAPI_MP_ARRAY_INT(depth,MAX_SAMPLERS,"fifo depth");
+static int max_shmem = MAX_SHMEM;	/* limit on fifo size, in bytes */
+RTAPI_MP_INT(max_shmem, "max bytes of user/RT shared memory per fifo");
+static int window[MAX_SAMPLERS];	/* periods per record, default 1 */
+RTAPI_MP_ARRAY_INT(window,MAX_SAMPLERS,"periods aggregated into a record");
+static int pretrigger[MAX_SAMPLERS];
+RTAPI_MP_ARRAY_INT(pretrigger,MAX_SAMPLERS,"records kept from before a trigger");
+static int posttrigger[MAX_SAMPLERS];
+RTAPI_MP_ARRAY_INT(posttrigger,MAX_SAMPLERS,"records sent after a trigger");
 
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
@@ -82,6 +100,20 @@ typedef struct {
     hal_bit_t *enable;		/* pin: enable sampling */
     hal_s32_t *overruns;	/* pin: number of overruns */
     hal_s32_t *sample_num;	/* pin: sample ID / timestamp */
+    hal_bit_t *trigger;		/* pin: record around this, or NULL */
+    int num_pins;		/* HAL pins sampled */
+    hal_type_t type[MAX_PINS];	/* and their types */
+    int window;			/* periods per record */
+    int count;			/* periods in 'rec' so far */
+    shmem_data_t *rec;		/* record being built, if not straight
+				   to the fifo */
+    int pre;			/* records kept in 'pre_ring' */
+    int post;			/* records sent after a trigger */
+    int post_left;
+    int hit;			/* trigger was TRUE during 'rec' */
+    int pre_in;			/* next slot in 'pre_ring' */
+    int pre_count;		/* records in it */
+    shmem_data_t *pre_ring;	/* in the fifo shmem, after the fifo */
 } sampler_t;
 
 /* other globals */
@@ -93,6 +125,7 @@ static int shmem_id[MAX_SAMPLERS];
 ************************************************************************/
 
 static int parse_types(fifo_t *f, char *cfg);
+static int record_width(fifo_t *f, int window);
 static int init_sampler(int num, fifo_t *tmp_fifo);
 static void sample(void *arg, long period);
 
@@ -102,8 +135,8 @@ static void sample(void *arg, long period);
 
 int rtapi_app_main(void)
 {
-    int n, numchan, max_depth, retval;
-    fifo_t tmp_fifo[MAX_SAMPLERS];
+    int n, numchan, max_depth, width, retval;
+    static fifo_t tmp_fifo[MAX_SAMPLERS];
 
     /* validate config info */
     for ( n = 0 ; n < MAX_SAMPLERS ; n++ ) {
@@ -116,11 +149,24 @@ int rtapi_app_main(void)
 		"SAMPLER: ERROR: bad config string '%s'\n", cfg[n]);
 	    return -EINVAL;
 	}
-	/* allow one extra "slot" for the sample number */
-	max_depth = MAX_SHMEM / (sizeof(shmem_data_t) * (tmp_fifo[n].num_pins + 1));
+	if (( window[n] < 0 ) || ( pretrigger[n] < 0 ) || ( posttrigger[n] < 0 )) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SAMPLER: ERROR: window, pretrigger and posttrigger can't be negative\n");
+	    return -EINVAL;
+	}
+	width = record_width(&(tmp_fifo[n]), window[n]);
+	if ( width > MAX_PINS ) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SAMPLER: ERROR: window record of '%s' has %d items, max is %d\n",
+		cfg[n], width, MAX_PINS);
+	    return -EINVAL;
+	}
+	/* allow one extra "slot" for the sample number, and room for
+	   the pre-trigger records after the fifo */
+	max_depth = max_shmem / (sizeof(shmem_data_t) * (width + 1)) - pretrigger[n];
 	if ( depth[n] > max_depth ) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
-		"SAMPLER: ERROR: depth too large, max is %d\n", max_depth);
+		"SAMPLER: ERROR: depth too large, max is %d (see max_shmem=)\n", max_depth);
 	    return -ENOMEM;
 	}
 	tmp_fifo[n].depth = depth[n];
@@ -176,30 +222,15 @@ void rtapi_app_exit(void)
 *            REALTIME COUNTER COUNTING AND UPDATE FUNCTIONS            *
 ************************************************************************/
 
-static void sample(void *arg, long period)
+/* returns the fifo slot for the next record, making room for it if
+   the fifo is full */
+static shmem_data_t *fifo_slot(sampler_t *samp)
 {
-    sampler_t *samp;
     fifo_t *fifo;
-    pin_data_t *pptr;
-    shmem_data_t *dptr;
-    int tmpin, newin, tmpout, n;
+    int newin, tmpout;
 
-    /* point at sampler struct in HAL shmem */
-    samp = arg;
-    /* are we enabled? */
-    if ( ! *(samp->enable) ) {
-	/* no, done */
-	return;
-    }
-    /* HAL pins are right after the sampler_t struct in HAL shmem */
-    pptr = (pin_data_t *)(samp+1);
-    /* point at user/RT fifo in other shmem */
     fifo = samp->fifo;
-    /* fifo data area is right after the fifo_t struct in shmem */
-    dptr = (shmem_data_t *)(fifo+1);
-    /* calculate _next_ value for in */
-    tmpin = fifo->in;
-    newin = tmpin + 1;
+    newin = fifo->in + 1;
     if ( newin >= fifo->depth ) {
 	newin = 0;
     }
@@ -217,11 +248,52 @@ static void sample(void *arg, long period)
     } else {
 	*(samp->full) = 0;
     }
-    /* make pointer to fifo entry */
-    dptr += tmpin * (fifo->num_pins+1);
-    /* copy data from HAL pins to fifo */
-    for ( n = 0 ; n < fifo->num_pins ; n++ ) {
-	switch ( fifo->type[n] ) {
+    return fifo->data + fifo->in * (fifo->num_pins+1);
+}
+
+/* puts the record in the slot from fifo_slot() into the fifo */
+static void fifo_commit(sampler_t *samp)
+{
+    fifo_t *fifo;
+    int newin, tmpout;
+
+    fifo = samp->fifo;
+    newin = fifo->in + 1;
+    if ( newin >= fifo->depth ) {
+	newin = 0;
+    }
+    /* update fifo pointer */
+    fifo->in = newin;
+    /* calculate current depth */
+    tmpout = fifo->out;
+    if ( newin < tmpout ) {
+	newin += fifo->depth;
+    }
+    *(samp->curr_depth) = newin - tmpout;
+}
+
+static void fifo_put(sampler_t *samp, shmem_data_t *rec)
+{
+    shmem_data_t *dptr;
+    int n;
+
+    dptr = fifo_slot(samp);
+    for ( n = 0 ; n <= samp->fifo->num_pins ; n++ ) {
+	dptr[n] = rec[n];
+    }
+    fifo_commit(samp);
+}
+
+/* copies the HAL pins to a record */
+static void read_pins(sampler_t *samp, shmem_data_t *dptr)
+{
+    pin_data_t *pptr;
+    int n;
+
+    /* HAL pins are right after the sampler_t struct in HAL shmem */
+    pptr = (pin_data_t *)(samp+1);
+    for ( n = 0 ; n < samp->num_pins ; n++ ) {
+	switch ( samp->type[n] ) {
 	case HAL_FLOAT:
 	    dptr->f = *(pptr->hfloat);
 	    break;
@@ -244,15 +316,166 @@ static void sample(void *arg, long period)
 	dptr++;
 	pptr++;
     }
-    /* store sample number at the end of the fifo record */
-    dptr->u = (*samp->sample_num)++;
-    /* update fifo pointer */
-    fifo->in = newin;
-    /* calculate current depth */
-    if ( newin < tmpout ) {
-	newin += fifo->depth;
+}
+
+/* adds this period's pin values to 'rec', returns 1 once it covers a
+   whole window.  A float takes min, max, mean (the sum until the
+   window is done) and last; s32 and u32 min, max and last; a bit
+   whether it was ever TRUE, and last. */
+static int add_pins(sampler_t *samp)
+{
+    pin_data_t *pptr;
+    shmem_data_t *dptr;
+    int n, first;
+    real_t f;
+    hal_s32_t s;
+    hal_u32_t u;
+
+    pptr = (pin_data_t *)(samp+1);
+    dptr = samp->rec;
+    first = ( samp->count == 0 );
+    for ( n = 0 ; n < samp->num_pins ; n++ ) {
+	switch ( samp->type[n] ) {
+	case HAL_FLOAT:
+	    f = *(pptr->hfloat);
+	    if ( first || f < dptr[0].f ) dptr[0].f = f;
+	    if ( first || f > dptr[1].f ) dptr[1].f = f;
+	    dptr[2].f = first ? f : dptr[2].f + f;
+	    dptr[3].f = f;
+	    dptr += 4;
+	    break;
+	case HAL_BIT:
+	    if ( first ) dptr[0].b = 0;
+	    dptr[1].b = *(pptr->hbit) ? 1 : 0;
+	    dptr[0].b |= dptr[1].b;
+	    dptr += 2;
+	    break;
+	case HAL_U32:
+	    u = *(pptr->hu32);
+	    if ( first || u < dptr[0].u ) dptr[0].u = u;
+	    if ( first || u > dptr[1].u ) dptr[1].u = u;
+	    dptr[2].u = u;
+	    dptr += 3;
+	    break;
+	case HAL_S32:
+	    s = *(pptr->hs32);
+	    if ( first || s < dptr[0].s ) dptr[0].s = s;
+	    if ( first || s > dptr[1].s ) dptr[1].s = s;
+	    dptr[2].s = s;
+	    dptr += 3;
+	    break;
+	default:
+	    break;
+	}
+	pptr++;
+    }
+    if ( ++samp->count < samp->window ) {
+	return 0;
+    }
+    samp->count = 0;
+    /* turn the sums into means */
+    dptr = samp->rec;
+    for ( n = 0 ; n < samp->num_pins ; n++ ) {
+	switch ( samp->type[n] ) {
+	case HAL_FLOAT:
+	    dptr[2].f /= samp->window;
+	    dptr += 4;
+	    break;
+	case HAL_BIT:
+	    dptr += 2;
+	    break;
+	default:
+	    dptr += 3;
+	    break;
+	}
+    }
+    return 1;
+}
+
+/* sends the records from before the trigger, oldest first */
+static void flush_pre(sampler_t *samp)
+{
+    int rec_len, n, i;
+
+    rec_len = samp->fifo->num_pins + 1;
+    i = samp->pre_in - samp->pre_count;
+    if ( i < 0 ) {
+	i += samp->pre;
+    }
+    for ( n = 0 ; n < samp->pre_count ; n++ ) {
+	fifo_put(samp, &samp->pre_ring[i * rec_len]);
+	if ( ++i >= samp->pre ) {
+	    i = 0;
+	}
+    }
+    samp->pre_count = 0;
+}
+
+static void keep_pre(sampler_t *samp, shmem_data_t *rec)
+{
+    shmem_data_t *dptr;
+    int n;
+
+    if ( samp->pre == 0 ) {
+	return;
+    }
+    dptr = &samp->pre_ring[samp->pre_in * (samp->fifo->num_pins + 1)];
+    for ( n = 0 ; n <= samp->fifo->num_pins ; n++ ) {
+	dptr[n] = rec[n];
+    }
+    if ( ++samp->pre_in >= samp->pre ) {
+	samp->pre_in = 0;
+    }
+    if ( samp->pre_count < samp->pre ) {
+	samp->pre_count++;
+    }
+}
+
+static void sample(void *arg, long period)
+{
+    sampler_t *samp;
+    shmem_data_t *dptr;
+
+    /* point at sampler struct in HAL shmem */
+    samp = arg;
+    /* are we enabled? */
+    if ( ! *(samp->enable) ) {
+	/* no, done */
+	return;
+    }
+    if ( samp->rec == 0 ) {
+	/* every period goes straight to the fifo */
+	dptr = fifo_slot(samp);
+	read_pins(samp, dptr);
+	/* store sample number at the end of the fifo record */
+	dptr[samp->num_pins].u = (*samp->sample_num)++;
+	fifo_commit(samp);
+	return;
+    }
+    if ( samp->trigger && *(samp->trigger) ) {
+	samp->hit = 1;
+    }
+    if ( samp->window > 1 ) {
+	if ( ! add_pins(samp) ) {
+	    return;
+	}
+    } else {
+	read_pins(samp, samp->rec);
+    }
+    samp->rec[samp->fifo->num_pins].u = (*samp->sample_num)++;
+    if ( samp->trigger == 0 ) {
+	fifo_put(samp, samp->rec);
+    } else if ( samp->hit ) {
+	samp->hit = 0;
+	flush_pre(samp);
+	fifo_put(samp, samp->rec);
+	samp->post_left = samp->post;
+    } else if ( samp->post_left > 0 ) {
+	fifo_put(samp, samp->rec);
+	samp->post_left--;
+    } else {
+	keep_pre(samp, samp->rec);
     }
-    *(samp->curr_depth) = newin - tmpout;
 }
 
 /***********************************************************************
@@ -303,9 +526,34 @@ static int parse_types(fifo_t *f, char *cfg)
     return n;
 }
 
+/* values in a record of the pins in 'f', see add_pins() */
+static int record_width(fifo_t *f, int window)
+{
+    int n, width;
+
+    if ( window <= 1 ) {
+	return f->num_pins;
+    }
+    width = 0;
+    for ( n = 0 ; n < f->num_pins ; n++ ) {
+	switch ( f->type[n] ) {
+	case HAL_FLOAT:
+	    width += 4;
+	    break;
+	case HAL_BIT:
+	    width += 2;
+	    break;
+	default:
+	    width += 3;
+	    break;
+	}
+    }
+    return width;
+}
+
 static int init_sampler(int num, fifo_t *tmp_fifo)
 {
-    int size, retval, n, usefp;
+    int size, retval, n, i, usefp, width;
     void *shmem_ptr;
     sampler_t *str;
     pin_data_t *pptr;
@@ -363,6 +611,40 @@ static int init_sampler(int num, fifo_t *tmp_fifo)
     *(str->curr_depth) = 0;
     *(str->overruns) = 0;
     *(str->sample_num) = 0;
+    str->num_pins = tmp_fifo->num_pins;
+    for ( n = 0 ; n < tmp_fifo->num_pins ; n++ ) {
+	str->type[n] = tmp_fifo->type[n];
+    }
+    str->window = window[num] > 1 ? window[num] : 1;
+    str->count = 0;
+    str->pre = pretrigger[num];
+    str->post = posttrigger[num];
+    str->post_left = 0;
+    str->hit = 0;
+    str->pre_in = 0;
+    str->pre_count = 0;
+    str->pre_ring = 0;
+    str->trigger = 0;
+    str->rec = 0;
+    width = record_width(tmp_fifo, str->window);
+    if ( str->pre > 0 || str->post > 0 ) {
+	retval = hal_pin_bit_newf(HAL_IN, &(str->trigger), comp_id,
+	    "sampler.%d.trigger", num);
+	if (retval != 0 ) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SAMPLER: ERROR: 'trigger' pin export failed\n");
+	    return -EIO;
+	}
+	*(str->trigger) = 0;
+    }
+    if ( str->window > 1 || str->trigger ) {
+	str->rec = hal_malloc((width + 1) * sizeof(shmem_data_t));
+	if (str->rec == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SAMPLER: ERROR: couldn't allocate HAL shared memory\n");
+	    return -ENOMEM;
+	}
+    }
     /* HAL pins are right after the sampler_t struct in HAL shmem */
     pptr = (pin_data_t *)(str+1);
     usefp = 0;
@@ -404,8 +686,9 @@ static int init_sampler(int num, fifo_t *tmp_fifo)
 	return retval;
     }
 
-    /* alloc shmem for user/RT comms (fifo) */
-    size = sizeof(fifo_t) + (tmp_fifo->num_pins + 1) * tmp_fifo->depth * sizeof(shmem_data_t);
+    /* alloc shmem for user/RT comms (fifo), followed by the records
+       kept from before a trigger */
+    size = sizeof(fifo_t) + (width + 1) * (tmp_fifo->depth + str->pre) * sizeof(shmem_data_t);
     shmem_id[num] = rtapi_shmem_new(SAMPLER_SHMEM_KEY+num, comp_id, size);
     if ( shmem_id[num] < 0 ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
@@ -422,6 +705,33 @@ static int init_sampler(int num, fifo_t *tmp_fifo)
     str->fifo = fifo;
     /* copy data from temp_fifo */
     *fifo = *tmp_fifo;
+    /* a window record has several values per pin */
+    if ( str->window > 1 ) {
+	i = 0;
+	for ( n = 0 ; n < tmp_fifo->num_pins ; n++ ) {
+	    switch ( tmp_fifo->type[n] ) {
+	    case HAL_FLOAT:
+		fifo->type[i++] = HAL_FLOAT;
+		fifo->type[i++] = HAL_FLOAT;
+		fifo->type[i++] = HAL_FLOAT;
+		fifo->type[i++] = HAL_FLOAT;
+		break;
+	    case HAL_BIT:
+		fifo->type[i++] = HAL_BIT;
+		fifo->type[i++] = HAL_BIT;
+		break;
+	    default:
+		fifo->type[i++] = tmp_fifo->type[n];
+		fifo->type[i++] = tmp_fifo->type[n];
+		fifo->type[i++] = tmp_fifo->type[n];
+		break;
+	    }
+	}
+	fifo->num_pins = width;
+    }
+    fifo->window = str->window;
+    fifo->triggered = ( str->trigger != 0 );
+    str->pre_ring = fifo->data + (width + 1) * fifo->depth;
     /* init fields */
     fifo->in = 0;
     fifo->out = 0;
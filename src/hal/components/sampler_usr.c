@@ -32,6 +32,10 @@
     '-t' tells sampler to print the sample number at the start
     of each line.
 
+    For a sampler loaded with pretrigger= or posttrigger=, the records
+    from around each trigger are printed as a block, with an empty
+    line between blocks instead of 'overrun'.
+
 */
 
 /** This program is free software; you can redistribute it and/or
@@ -78,6 +82,8 @@
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
+static int sample_binary(fifo_t *fifo, long samples, int tag);
+
 /***********************************************************************
 *                         GLOBAL VARIABLES                             *
 ************************************************************************/
@@ -86,6 +92,7 @@ int comp_id = -1;	/* -1 means hal_init() not called yet */
 int shmem_id = -1;
 int exitval = 1;	/* program return code - 1 means error */
 int ignore_sig = 0;	/* used to flag critical regions */
+unsigned long lost = 0;	/* samples overwritten before binary mode saw them */
 char comp_name[HAL_NAME_LEN+1];	/* name for this instance of sampler */
 
 /***********************************************************************
@@ -98,6 +105,9 @@ static void quit(int sig)
     if ( ignore_sig ) {
 	return;
     }
+    if ( lost ) {
+	fprintf(stderr, "%lu samples lost to overruns\n", lost);
+    }
     if ( shmem_id >= 0 ) {
 	rtapi_shmem_delete(shmem_id, comp_id);
     }
@@ -111,20 +121,21 @@ static void quit(int sig)
 
 int main(int argc, char **argv)
 {
-    int n, channel, retval, size, tag;
+    int n, channel, retval, size, tag, binary;
     long int samples;
     unsigned long this_sample;
     char *cp, *cp2;
     void *shmem_ptr;
     fifo_t *fifo;
     shmem_data_t *data, *dptr, buf[MAX_PINS];
-    int tmpout, newout;
+    int tmpout, newout, printed;
     struct timespec delay;
 
     /* set return code to "fail", clear it later if all goes well */
     exitval = 1;
     channel = 0;
     tag = 0;
+    binary = 0;
     samples = -1;  /* -1 means run forever */
     /* FIXME - if I wasn't so lazy I'd learn how to use getopt() here */
     for ( n = 1 ; n < argc ; n++ ) {
@@ -156,6 +167,9 @@ int main(int argc, char **argv)
 	case 't':
 	    tag = 1;
 	    break;
+	case 'b':
+	    binary = 1;
+	    break;
 	default:
 	    fprintf(stderr,"ERROR: unknown option '%s'\n", cp );
 	    exit(1);
@@ -223,7 +237,14 @@ int main(int argc, char **argv)
 	goto out;
     }
     fifo = shmem_ptr;
+    if ( binary ) {
+	if ( sample_binary(fifo, samples, tag) == 0 ) {
+	    exitval = 0;
+	}
+	goto out;
+    }
     data = fifo->data;
+    printed = 0;
     while ( samples != 0 ) {
 	while ( fifo->in == fifo->out ) {
             /* fifo empty, sleep for 10mS */
@@ -253,9 +274,15 @@ int main(int argc, char **argv)
 	    fifo->out = newout;
 	}
 	if ( this_sample != ++(fifo->last_sample) ) {
-	    printf ( "overrun\n" );
+	    if ( ! fifo->triggered ) {
+		printf ( "overrun\n" );
+	    } else if ( printed ) {
+		/* records in between were not kept, not lost */
+		printf ( "\n" );
+	    }
 	    fifo->last_sample = this_sample;
 	}
+	printed = 1;
 	if ( tag ) {
 	    printf ( "%ld ", this_sample );
 	}
@@ -292,6 +319,9 @@ int main(int argc, char **argv)
 
 out:
     ignore_sig = 1;
+    if ( lost ) {
+	fprintf(stderr, "%lu samples lost to overruns\n", lost);
+    }
     if ( shmem_id >= 0 ) {
 	rtapi_shmem_delete(shmem_id, comp_id);
     }
@@ -300,3 +330,76 @@ out:
     }
     return exitval;
 }
+
+/* writes raw fifo records to stdout, copying as many as are waiting
+   at once.  Without 'tag' the sample number slot is dropped, which
+   gives the record layout halstreamer -b expects. */
+static int sample_binary(fifo_t *fifo, long samples, int tag)
+{
+    int rec_len, out_len, tmpout, n, i;
+    shmem_data_t *buf, *src, *dst;
+    hal_u32_t this_sample;
+    struct timespec delay;
+
+    rec_len = fifo->num_pins + 1;
+    out_len = tag ? rec_len : fifo->num_pins;
+    buf = malloc(fifo->depth * rec_len * sizeof(shmem_data_t));
+    if ( buf == NULL ) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	return -1;
+    }
+    while ( samples != 0 ) {
+	while ( fifo->in == fifo->out ) {
+            /* fifo empty, sleep for 10mS */
+	    delay.tv_sec = 0;
+	    delay.tv_nsec = 10000000;
+	    nanosleep(&delay,NULL);
+	}
+	/* take everything up to 'in' or the end of the fifo */
+	tmpout = fifo->out;
+	n = fifo->in - tmpout;
+	if ( n < 0 ) {
+	    n = fifo->depth - tmpout;
+	}
+	if (( samples > 0 ) && ( n > samples )) {
+	    n = samples;
+	}
+	memcpy(buf, &fifo->data[tmpout * rec_len], n * rec_len * sizeof(shmem_data_t));
+	if ( fifo->out != tmpout ) {
+	    /* RT overwrote the oldest records while we were reading
+	       them, try again with what is there now */
+	    continue;
+	}
+	tmpout += n;
+	if ( tmpout >= fifo->depth ) {
+	    tmpout = 0;
+	}
+	fifo->out = tmpout;
+	/* check the sample numbers for gaps, and pack the records */
+	src = dst = buf;
+	for ( i = 0 ; i < n ; i++ ) {
+	    this_sample = src[fifo->num_pins].u;
+	    if ( this_sample != (hal_u32_t)++(fifo->last_sample) ) {
+		if ( ! fifo->triggered ) {
+		    lost += (hal_u32_t)(this_sample - fifo->last_sample);
+		}
+		fifo->last_sample = this_sample;
+	    }
+	    if ( dst != src ) {
+		memmove(dst, src, out_len * sizeof(shmem_data_t));
+	    }
+	    src += rec_len;
+	    dst += out_len;
+	}
+	if ( fwrite(buf, out_len * sizeof(shmem_data_t), n, stdout) != (size_t)n ) {
+	    fprintf(stderr, "ERROR: write failed\n");
+	    free(buf);
+	    return -1;
+	}
+	if ( samples > 0 ) {
+	    samples -= n;
+	}
+    }
+    free(buf);
+    return 0;
+}
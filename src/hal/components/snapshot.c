@@ -0,0 +1,327 @@
+/********************************************************************
+* Description:  snapshot.c
+*               A HAL component that copies a group of pins to
+*               shared memory each period, for user space programs
+*               to read as one consistent frame.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'snapshot.c', is the realtime part of a HAL component
+    that lets user space programs read a group of related values, such
+    as the joint positions, all from the same period.  Reading the pins
+    one at a time from user space can mix values from different
+    periods, and 'sampler' keeps every period, which a program that
+    only wants the present values must then drain.
+
+    Each instance has input pins of the types given in its config
+    string, as for 'sampler', and a function 'snapshot.N' that copies
+    them, with a frame number and the time, into one of three frames
+    in user/RT shared memory.  Readers take the latest frame without a
+    lock and check its sequence number afterwards, so the function
+    never waits for them; see snapshot_read() in snapshot.h, and
+    'halsnapshot', which prints frames.
+
+    Loading:
+
+    loadrt snapshot cfg=ffffff,bb
+    addf snapshot.0 servo-thread
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_app.h"		/* RTAPI realtime module decls */
+#include "hal.h"		/* HAL public API decls */
+#include "snapshot.h"		/* decls for the user/RT shared memory */
+#include "rtapi_errno.h"
+#include "rtapi_string.h"
+
+/* module information */
+MODULE_DESCRIPTION("Consistent snapshots of HAL pins for user space");
+MODULE_LICENSE("GPL");
+static char *cfg[MAX_SNAPSHOTS];	/* config string, no default */
+RTAPI_MP_ARRAY_STRING(cfg, MAX_SNAPSHOTS, "config string");
+
+/***********************************************************************
+*                STRUCTURES AND GLOBAL VARIABLES                       *
+************************************************************************/
+
+/* this structure contains the HAL shared memory data for one instance */
+
+typedef struct {
+    snapshot_shmem_t *shmem;	/* frames, in user/RT shmem */
+    hal_s32_t *frame;		/* pin: number of the latest frame */
+    int num_pins;
+    pin_data_t pins[MAX_PINS];
+} snapshot_t;
+
+/* other globals */
+static int comp_id;		/* component ID */
+static int shmem_id[MAX_SNAPSHOTS];
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static int parse_types(hal_type_t *type, char *cfg);
+static int init_snapshot(int num, char *cfg);
+static void free_shmem(void);
+static void take(void *arg, long period);
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    int n, retval;
+
+    for (n = 0; n < MAX_SNAPSHOTS; n++) {
+	shmem_id[n] = -1;
+    }
+    if (cfg[0] == NULL || *cfg[0] == '\0') {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: no channels specified\n");
+	return -EINVAL;
+    }
+    comp_id = hal_init("snapshot");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "SNAPSHOT: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    for (n = 0; n < MAX_SNAPSHOTS && cfg[n] != NULL && *cfg[n] != '\0';
+	n++) {
+	retval = init_snapshot(n, cfg[n]);
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SNAPSHOT: ERROR: channel %d init failed\n", n);
+	    free_shmem();
+	    hal_exit(comp_id);
+	    return retval;
+	}
+    }
+    rtapi_print_msg(RTAPI_MSG_INFO,
+	"SNAPSHOT: installed %d snapshot channels\n", n);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    free_shmem();
+    hal_exit(comp_id);
+}
+
+/***********************************************************************
+*                     REALTIME SNAPSHOT FUNCTION                       *
+************************************************************************/
+
+static void take(void *arg, long period)
+{
+    snapshot_t *snap;
+    snapshot_shmem_t *s;
+    snapshot_frame_t *f;
+    pin_data_t *pptr;
+    int n, next;
+
+    snap = arg;
+    s = snap->shmem;
+    /* the oldest frame, which no reader should still be copying */
+    next = (s->latest + 1) % SNAPSHOT_FRAMES;
+    f = &s->frame[next];
+    f->seq++;
+    __sync_synchronize();
+    pptr = snap->pins;
+    for (n = 0; n < snap->num_pins; n++) {
+	switch (s->type[n]) {
+	case HAL_FLOAT:
+	    f->data[n].f = *(pptr->hfloat);
+	    break;
+	case HAL_BIT:
+	    f->data[n].b = *(pptr->hbit) ? 1 : 0;
+	    break;
+	case HAL_U32:
+	    f->data[n].u = *(pptr->hu32);
+	    break;
+	case HAL_S32:
+	    f->data[n].s = *(pptr->hs32);
+	    break;
+	default:
+	    break;
+	}
+	pptr++;
+    }
+    f->frame = *(snap->frame) + 1;
+    f->time = rtapi_get_time();
+    __sync_synchronize();
+    f->seq++;
+    __sync_synchronize();
+    s->latest = next;
+    *(snap->frame) = f->frame;
+}
+
+/***********************************************************************
+*                   LOCAL FUNCTION DEFINITIONS                         *
+************************************************************************/
+
+static void free_shmem(void)
+{
+    int n;
+
+    for (n = 0; n < MAX_SNAPSHOTS; n++) {
+	if (shmem_id[n] >= 0) {
+	    rtapi_shmem_delete(shmem_id[n], comp_id);
+	    shmem_id[n] = -1;
+	}
+    }
+}
+
+static int parse_types(hal_type_t *type, char *cfg)
+{
+    char *c;
+    int n;
+
+    c = cfg;
+    n = 0;
+    while (n < MAX_PINS && *c != '\0') {
+	switch (*c++) {
+	case 'f':
+	case 'F':
+	    type[n++] = HAL_FLOAT;
+	    break;
+	case 'b':
+	case 'B':
+	    type[n++] = HAL_BIT;
+	    break;
+	case 'u':
+	case 'U':
+	    type[n++] = HAL_U32;
+	    break;
+	case 's':
+	case 'S':
+	    type[n++] = HAL_S32;
+	    break;
+	default:
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SNAPSHOT: ERROR: unknown type '%c', must be F, B, U, or S\n",
+		c[-1]);
+	    return 0;
+	}
+    }
+    if (*c != '\0') {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: more than %d items\n", MAX_PINS);
+	return 0;
+    }
+    return n;
+}
+
+static int init_snapshot(int num, char *cfg)
+{
+    int n, retval, usefp;
+    void *shmem_ptr;
+    snapshot_t *snap;
+    snapshot_shmem_t *s;
+    char buf[HAL_NAME_LEN + 1];
+
+    snap = hal_malloc(sizeof(snapshot_t));
+    if (snap == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: couldn't allocate HAL shared memory\n");
+	return -ENOMEM;
+    }
+    shmem_id[num] = rtapi_shmem_new(SNAPSHOT_SHMEM_KEY + num, comp_id,
+	sizeof(snapshot_shmem_t));
+    if (shmem_id[num] < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: couldn't allocate user/RT shared memory\n");
+	return -ENOMEM;
+    }
+    retval = rtapi_shmem_getptr(shmem_id[num], &shmem_ptr);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: couldn't map user/RT shared memory\n");
+	return -ENOMEM;
+    }
+    s = shmem_ptr;
+    memset(s, 0, sizeof(snapshot_shmem_t));
+    s->latest = -1;
+    s->num_pins = parse_types(s->type, cfg);
+    if (s->num_pins == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: bad config string '%s'\n", cfg);
+	return -EINVAL;
+    }
+    snap->shmem = s;
+    snap->num_pins = s->num_pins;
+
+    retval = hal_pin_s32_newf(HAL_OUT, &(snap->frame), comp_id,
+	"snapshot.%d.frame", num);
+    if (retval != 0) {
+	return retval;
+    }
+    *(snap->frame) = 0;
+    usefp = 0;
+    for (n = 0; n < snap->num_pins; n++) {
+	rtapi_snprintf(buf, sizeof(buf), "snapshot.%d.pin.%d", num, n);
+	retval = hal_pin_new(buf, s->type[n], HAL_IN,
+	    (void **) &(snap->pins[n]), comp_id);
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SNAPSHOT: ERROR: pin '%s' export failed\n", buf);
+	    return retval;
+	}
+	switch (s->type[n]) {
+	case HAL_FLOAT:
+	    *(snap->pins[n].hfloat) = 0.0;
+	    usefp = 1;
+	    break;
+	case HAL_BIT:
+	    *(snap->pins[n].hbit) = 0;
+	    break;
+	case HAL_U32:
+	    *(snap->pins[n].hu32) = 0;
+	    break;
+	case HAL_S32:
+	    *(snap->pins[n].hs32) = 0;
+	    break;
+	default:
+	    break;
+	}
+    }
+    /* readers check this before trusting the rest */
+    s->magic = SNAPSHOT_MAGIC;
+
+    rtapi_snprintf(buf, sizeof(buf), "snapshot.%d", num);
+    retval = hal_export_funct(buf, take, snap, usefp, 0, comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SNAPSHOT: ERROR: function export failed\n");
+	return retval;
+    }
+    return 0;
+}
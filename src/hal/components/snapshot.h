@@ -0,0 +1,67 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/* Shared between the realtime module 'snapshot' and the programs that
+   read it.  Each instance has one block of user/RT shared memory, at
+   SNAPSHOT_SHMEM_KEY plus its number, holding three frames.  The
+   realtime function writes the oldest of them each period and then
+   makes it the latest, so a reader copying the latest has two whole
+   periods before it is written again. */
+
+#include "streamer.h"		/* shmem_data_t, MAX_PINS */
+
+#define MAX_SNAPSHOTS		8
+#define SNAPSHOT_SHMEM_KEY	0x48534e30
+#define SNAPSHOT_MAGIC		0x534e4150
+#define SNAPSHOT_FRAMES		3
+
+typedef struct {
+    volatile unsigned int seq;	/* odd while the frame is being written */
+    unsigned int frame;		/* counts up by one each period */
+    long long time;		/* rtapi_get_time() when it was taken, ns */
+    shmem_data_t data[MAX_PINS];
+} snapshot_frame_t;
+
+typedef struct {
+    unsigned int magic;		/* SNAPSHOT_MAGIC once set up */
+    int num_pins;
+    hal_type_t type[MAX_PINS];
+    volatile int latest;	/* frame[] last written, -1 before the first */
+    snapshot_frame_t frame[SNAPSHOT_FRAMES];
+} snapshot_shmem_t;
+
+#ifdef ULAPI
+#include <string.h>
+
+/* Copies the latest frame to 'out'.  Returns 0, or -1 if there is no
+   frame yet or the reader was held up for so long that the frame was
+   written over every time it tried. */
+static inline int snapshot_read(snapshot_shmem_t *s, snapshot_frame_t *out)
+{
+    snapshot_frame_t *f;
+    unsigned int seq;
+    int tries, latest;
+
+    for (tries = 0; tries < 4; tries++) {
+	latest = s->latest;
+	if (latest < 0 || latest >= SNAPSHOT_FRAMES) {
+	    return -1;
+	}
+	f = &s->frame[latest];
+	seq = f->seq;
+	__sync_synchronize();
+	if (seq & 1) {
+	    continue;
+	}
+	memcpy(out, (void *) f, sizeof(*out));
+	__sync_synchronize();
+	if (f->seq == seq) {
+	    out->seq = seq;
+	    return 0;
+	}
+    }
+    return -1;
+}
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+/********************************************************************
+* Description:  snapshot_usr.c
+*               User space part of "snapshot", a HAL component that
+*		copies a group of pins to shared memory each period.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'snapshot_usr.c', is the user part of the HAL component
+    'snapshot'.  It reads the latest frame the realtime function has
+    taken and prints its values on one line, in the order of the
+    config string, all from the same period.
+
+    Invoking:
+
+    halsnapshot [-c chan_num] [-n num_frames] [-t]
+
+    'chan_num', if present, specifies the snapshot channel to use.
+    The default is channel zero.
+
+    'num_frames', if present, prints that many frames, waiting for a
+    new one each time, rather than only the latest.  Frames taken
+    while it waits are not printed; use 'halsampler' to have every
+    period.  Zero prints frames until killed.
+
+    It waits for the first frame if the function has not run yet.
+
+    '-t' prints the frame number and the time it was taken, in ns,
+    at the start of each line.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"                /* HAL public API decls */
+#include "snapshot.h"
+
+/***********************************************************************
+*                         GLOBAL VARIABLES                             *
+************************************************************************/
+
+int comp_id = -1;	/* -1 means hal_init() not called yet */
+int shmem_id = -1;
+int exitval = 1;	/* program return code - 1 means error */
+int ignore_sig = 0;	/* used to flag critical regions */
+char comp_name[HAL_NAME_LEN+1];	/* name for this instance of halsnapshot */
+
+/***********************************************************************
+*                            MAIN PROGRAM                              *
+************************************************************************/
+
+static void detach(void)
+{
+    if ( shmem_id >= 0 ) {
+	rtapi_shmem_delete(shmem_id, comp_id);
+	shmem_id = -1;
+    }
+    if ( comp_id >= 0 ) {
+	hal_exit(comp_id);
+	comp_id = -1;
+    }
+}
+
+/* signal handler */
+static void quit(int sig)
+{
+    if ( ignore_sig ) {
+	return;
+    }
+    detach();
+    exit(exitval);
+}
+
+static void print_frame(snapshot_shmem_t *s, snapshot_frame_t *f, int tag)
+{
+    int n;
+
+    if ( tag ) {
+	printf ( "%u %lld ", f->frame, f->time );
+    }
+    for ( n = 0 ; n < s->num_pins ; n++ ) {
+	switch ( s->type[n] ) {
+	case HAL_FLOAT:
+	    printf ( "%f ", f->data[n].f);
+	    break;
+	case HAL_BIT:
+	    printf ( f->data[n].b ? "1 " : "0 " );
+	    break;
+	case HAL_U32:
+	    printf ( "%lu ", (unsigned long)f->data[n].u);
+	    break;
+	case HAL_S32:
+	    printf ( "%ld ", (long)f->data[n].s);
+	    break;
+	default:
+	    break;
+	}
+    }
+    printf ( "\n" );
+}
+
+int main(int argc, char **argv)
+{
+    int n, channel, tag, retval, printed, count;
+    unsigned int last;
+    char *cp, *cp2;
+    void *shmem_ptr;
+    snapshot_shmem_t *s;
+    snapshot_frame_t frame;
+    struct timespec delay;
+
+    /* set return code to "fail", clear it later if all goes well */
+    exitval = 1;
+    channel = 0;
+    tag = 0;
+    count = 1;
+    for ( n = 1 ; n < argc ; n++ ) {
+	cp = argv[n];
+	if ( *cp != '-' ) {
+	    break;
+	}
+	switch ( *(++cp) ) {
+	case 'c':
+	    if (( *(++cp) == '\0' ) && ( ++n < argc )) {
+		cp = argv[n];
+	    }
+	    channel = strtol(cp, &cp2, 10);
+	    if (( *cp2 ) || ( channel < 0 ) || ( channel >= MAX_SNAPSHOTS )) {
+		fprintf(stderr,"ERROR: invalid channel number '%s'\n", cp );
+		exit(1);
+	    }
+	    break;
+	case 'n':
+	    if (( *(++cp) == '\0' ) && ( ++n < argc )) {
+		cp = argv[n];
+	    }
+	    count = strtol(cp, &cp2, 10);
+	    if (( *cp2 ) || ( count < 0 )) {
+		fprintf(stderr, "ERROR: invalid frame count '%s'\n", cp );
+		exit(1);
+	    }
+	    break;
+	case 't':
+	    tag = 1;
+	    break;
+	default:
+	    fprintf(stderr,"ERROR: unknown option '%s'\n", cp );
+	    exit(1);
+	    break;
+	}
+    }
+    if ( n < argc ) {
+	fprintf(stderr, "ERROR: unexpected argument '%s'\n", argv[n]);
+	exit(1);
+    }
+    /* register signal handlers - if the process is killed
+       we need to call hal_exit() to free the shared memory */
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, quit);
+    /* create a unique module name, to allow for multiple readers */
+    snprintf(comp_name, sizeof(comp_name), "halsnapshot%d", getpid());
+    /* connect to the HAL */
+    ignore_sig = 1;
+    comp_id = hal_init(comp_name);
+    ignore_sig = 0;
+    /* check result */
+    if (comp_id < 0) {
+	fprintf(stderr, "ERROR: hal_init() failed: %d\n", comp_id );
+	goto out;
+    }
+    hal_ready(comp_id);
+    shmem_id = rtapi_shmem_new(SNAPSHOT_SHMEM_KEY + channel, comp_id,
+	sizeof(snapshot_shmem_t));
+    if ( shmem_id < 0 ) {
+	fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
+	goto out;
+    }
+    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr);
+    if ( retval < 0 ) {
+	fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
+	goto out;
+    }
+    s = shmem_ptr;
+    if ( s->magic != SNAPSHOT_MAGIC ) {
+	fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n",
+	    channel );
+	goto out;
+    }
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000000;
+    printed = 0;
+    last = 0;
+    while ( count == 0 || printed < count ) {
+	/* a failed read means no frame yet, or none that held still */
+	if ( snapshot_read(s, &frame) == 0 &&
+		( printed == 0 || frame.frame != last )) {
+	    print_frame(s, &frame, tag);
+	    fflush(stdout);
+	    last = frame.frame;
+	    printed++;
+	    continue;
+	}
+	nanosleep(&delay, NULL);
+    }
+    /* run was succesfull */
+    exitval = 0;
+
+out:
+    ignore_sig = 1;
+    detach();
+    return exitval;
+}
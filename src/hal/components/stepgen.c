@@ -324,26 +324,39 @@ RTAPI_MP_ARRAY_INT(user_step_type, MAX_CYCLE,
 *                STRUCTURES AND GLOBAL VARIABLES                       *
 ************************************************************************/
 
-/** This structure contains the runtime data for a single generator. */
-
-/* structure members are ordered to optimize caching for makepulses,
-   which runs in the fastest thread */
+/** The per-period state of all the generators is kept in arrays
+    indexed by channel, rather than in each channel's stepgen_t.  That
+    way makepulses walks a handful of short contiguous arrays, and when
+    every channel is step/dir the whole update is one loop over those
+    arrays with no branches in it, which the compiler can vectorize.
+    The pins are read and written in separate loops around it.
+*/
 
 typedef struct {
     /* stuff that is both read and written by makepulses */
-    unsigned int timer1;	/* times out when step pulse should end */
-    unsigned int timer2;	/* times out when safe to change dir */
-    unsigned int timer3;	/* times out when safe to step in new dir */
-    int hold_dds;		/* prevents accumulator from updating */
-    long addval;		/* actual frequency generator add value */
-    volatile long long accum;	/* frequency generator accumulator */
-    hal_s32_t rawcount;		/* param: position feedback in counts */
-    int curr_dir;		/* current direction */
-    int state;			/* current position in state table */
+    unsigned int timer1[MAX_CHAN];	/* times out when step pulse should end */
+    unsigned int timer2[MAX_CHAN];	/* times out when safe to change dir */
+    unsigned int timer3[MAX_CHAN];	/* times out when safe to step in new dir */
+    int hold_dds[MAX_CHAN];		/* prevents accumulator from updating */
+    long addval[MAX_CHAN];		/* actual frequency generator add value */
+    long long accum[MAX_CHAN];		/* frequency generator accumulator */
+    hal_s32_t rawcount[MAX_CHAN];	/* param: position feedback in counts */
+    int curr_dir[MAX_CHAN];		/* current direction */
+    int enable[MAX_CHAN];		/* enable pins, sampled by makepulses */
+    /* stuff that is read but not written by makepulses */
+    long target_addval[MAX_CHAN];	/* desired freq generator add value */
+    long deltalim[MAX_CHAN];		/* max allowed change per period */
+    unsigned int step_len[MAX_CHAN];	/* timing params, after update_freq */
+    unsigned int dir_hold_dly[MAX_CHAN];	/* has rounded them to */
+    unsigned int dir_setup[MAX_CHAN];	/* multiples of the period */
+} pulse_data_t;
+
+/** This structure contains the rest of the data for a single generator. */
+
+typedef struct {
     /* stuff that is read but not written by makepulses */
+    int state;			/* current position in state table */
     hal_bit_t *enable;		/* pin for enable stepgen */
-    long target_addval;		/* desired freq generator add value */
-    long deltalim;		/* max allowed change per period */
     hal_u32_t step_len;		/* parameter: step pulse length */
     hal_u32_t dir_hold_dly;	/* param: direction hold time or delay */
     hal_u32_t dir_setup;	/* param: direction setup time */
@@ -376,6 +389,12 @@ typedef struct {
 /* ptr to array of stepgen_t structs in shared memory, 1 per channel */
 static stepgen_t *stepgen_array;
 
+/* ptr to the per-period state of all channels, also in shared memory */
+static pulse_data_t *pulse_data;
+
+/* non-zero if every channel is step type 0 */
+static int all_step_dir;
+
 /* lookup tables for stepping types 2 and higher - phase A is the LSB */
 
 static unsigned char master_lut[][MAX_CYCLE] = {
@@ -410,6 +429,8 @@ static unsigned char num_phases_lut[] =
 
 #define PICKOFF		28	/* bit location in DDS accum */
 
+#define ADDVAL_MAX	((long)(~0UL >> 1))	/* 'no limit' for deltalim */
+
 
 
 /* other globals */
@@ -492,14 +513,19 @@ int rtapi_app_main(void)
     }
     /* allocate shared memory for counter data */
     stepgen_array = hal_malloc(num_chan * sizeof(stepgen_t));
-    if (stepgen_array == 0) {
+    pulse_data = hal_malloc(sizeof(pulse_data_t));
+    if (stepgen_array == 0 || pulse_data == 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 			"STEPGEN: ERROR: hal_malloc() failed\n");
 	hal_exit(comp_id);
 	return -1;
     }
     /* export all the variables for each pulse generator */
+    all_step_dir = 1;
     for (n = 0; n < num_chan; n++) {
+	if (step_type[n] != 0) {
+	    all_step_dir = 0;
+	}
 	/* export all vars */
 	retval = export_stepgen(n, &(stepgen_array[n]),
 	    step_type[n], (parse_ctrl_type(ctrl_type[n]) == POSITION));
@@ -555,9 +581,73 @@ void rtapi_app_exit(void)
     toggles, a step is generated.
 */
 
+/* the part of makepulses that does the timing and the DDS for step
+   type 0, for all channels at once; it touches no pins or params,
+   which are volatile */
+static void step_dir_dds(pulse_data_t *pd, unsigned int period)
+{
+    unsigned int t1, t2, t3, step_len, dir_hold_dly, dir_setup;
+    long old_addval, new_addval, target_addval, lim, delta;
+    long long accum, new_accum;
+    int n, hold, run, dir, new_dir, step_now;
+
+    for (n = 0; n < num_chan; n++) {
+	/* load everything first, and use only selects below, so the
+	   loop body has no branches and no conditional loads */
+	t1 = pd->timer1[n];
+	t2 = pd->timer2[n];
+	t3 = pd->timer3[n];
+	hold = pd->hold_dds[n];
+	run = pd->enable[n];
+	old_addval = pd->addval[n];
+	target_addval = pd->target_addval[n];
+	lim = pd->deltalim[n];
+	accum = pd->accum[n];
+	dir = pd->curr_dir[n];
+	step_len = pd->step_len[n];
+	dir_hold_dly = pd->dir_hold_dly[n];
+	dir_setup = pd->dir_setup[n];
+	/* a hold is cancelled when timer 3 times out, that is when it
+	   is 1 to period (unsigned, so 0 wraps around and keeps it) */
+	hold = t3 - 1 >= period ? hold : 0;
+	/* decrement "timing constraint" timers */
+	t1 = t1 > period ? t1 - period : 0;
+	t2 = t2 > period ? t2 - period : 0;
+	t3 = t3 > period ? t3 - period : 0;
+	run = hold ? 0 : run;
+	/* update addval (ramping), deltalim = 0 means no limit */
+	lim = lim != 0 ? lim : ADDVAL_MAX;
+	delta = target_addval - old_addval;
+	delta = delta > lim ? lim : delta;
+	delta = delta < -lim ? -lim : delta;
+	new_addval = run ? old_addval + delta : old_addval;
+	/* a reversal must wait until the delays time out */
+	hold = (new_addval ^ old_addval) < 0 ? (t3 != 0 ? 1 : hold) : hold;
+	run = hold ? 0 : run;
+	/* update DDS, only the pickoff bit tells us to step */
+	new_accum = run ? accum + new_addval : accum;
+	step_now = ((accum ^ new_accum) >> PICKOFF) & 1;
+	/* update direction - do not change if addval = 0 */
+	new_dir = new_addval > 0 ? 1 : (new_addval < 0 ? -1 : dir);
+	dir = t2 == 0 ? new_dir : dir;
+	/* (re)start the timers if we stepped */
+	t1 = step_now ? step_len : t1;
+	t2 = step_now ? t1 + dir_hold_dly : t2;
+	t3 = step_now ? t2 + dir_setup : t3;
+	pd->timer1[n] = t1;
+	pd->timer2[n] = t2;
+	pd->timer3[n] = t3;
+	pd->hold_dds[n] = hold;
+	pd->addval[n] = new_addval;
+	pd->accum[n] = new_accum;
+	pd->curr_dir[n] = dir;
+    }
+}
+
 static void make_pulses(void *arg, long period)
 {
     stepgen_t *stepgen;
+    pulse_data_t *pd;
     long old_addval, target_addval, new_addval, step_now;
     int n, p;
     unsigned char outbits;
@@ -566,44 +656,59 @@ static void make_pulses(void *arg, long period)
     periodns = period;
     /* point to stepgen data structures */
     stepgen = arg;
+    pd = pulse_data;
+
+    for (n = 0; n < num_chan; n++) {
+	pd->enable[n] = *(stepgen[n].enable);
+    }
+    if (all_step_dir) {
+	/* fast path: do the arithmetic for all channels, then the pins */
+	step_dir_dds(pd, periodns);
+	for (n = 0; n < num_chan; n++) {
+	    *(stepgen[n].phase[STEP_PIN]) = pd->timer1[n] != 0;
+	    *(stepgen[n].phase[DIR_PIN]) = pd->curr_dir[n] < 0;
+	    pd->rawcount[n] = pd->accum[n] >> PICKOFF;
+	}
+	return;
+    }
 
     for (n = 0; n < num_chan; n++) {
 	/* decrement "timing constraint" timers */
-	if ( stepgen->timer1 > 0 ) {
-	    if ( stepgen->timer1 > periodns ) {
-		stepgen->timer1 -= periodns;
+	if ( pd->timer1[n] > 0 ) {
+	    if ( pd->timer1[n] > periodns ) {
+		pd->timer1[n] -= periodns;
 	    } else {
-		stepgen->timer1 = 0;
+		pd->timer1[n] = 0;
 	    }
 	}
-	if ( stepgen->timer2 > 0 ) {
-	    if ( stepgen->timer2 > periodns ) {
-		stepgen->timer2 -= periodns;
+	if ( pd->timer2[n] > 0 ) {
+	    if ( pd->timer2[n] > periodns ) {
+		pd->timer2[n] -= periodns;
 	    } else {
-		stepgen->timer2 = 0;
+		pd->timer2[n] = 0;
 	    }
 	}
-	if ( stepgen->timer3 > 0 ) {
-	    if ( stepgen->timer3 > periodns ) {
-		stepgen->timer3 -= periodns;
+	if ( pd->timer3[n] > 0 ) {
+	    if ( pd->timer3[n] > periodns ) {
+		pd->timer3[n] -= periodns;
 	    } else {
-		stepgen->timer3 = 0;
+		pd->timer3[n] = 0;
 		/* last timer timed out, cancel hold */
-		stepgen->hold_dds = 0;
+		pd->hold_dds[n] = 0;
 	    }
 	}
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
+	if ( !pd->hold_dds[n] && pd->enable[n] ) {
 	    /* update addval (ramping) */
-	    old_addval = stepgen->addval;
-	    target_addval = stepgen->target_addval;
-	    if (stepgen->deltalim != 0) {
+	    old_addval = pd->addval[n];
+	    target_addval = pd->target_addval[n];
+	    if (pd->deltalim[n] != 0) {
 		/* implement accel/decel limit */
-		if (target_addval > (old_addval + stepgen->deltalim)) {
+		if (target_addval > (old_addval + pd->deltalim[n])) {
 		    /* new value is too high, increase addval as far as possible */
-		    new_addval = old_addval + stepgen->deltalim;
-		} else if (target_addval < (old_addval - stepgen->deltalim)) {
+		    new_addval = old_addval + pd->deltalim[n];
+		} else if (target_addval < (old_addval - pd->deltalim[n])) {
 		    /* new value is too low, decrease addval as far as possible */
-		    new_addval = old_addval - stepgen->deltalim;
+		    new_addval = old_addval - pd->deltalim[n];
 		} else {
 		    /* new value can be reached in one step - do it */
 		    new_addval = target_addval;
@@ -613,52 +718,52 @@ static void make_pulses(void *arg, long period)
 		new_addval = target_addval;
 	    }
 	    /* save result */
-	    stepgen->addval = new_addval;
+	    pd->addval[n] = new_addval;
 	    /* check for direction reversal */
 	    if (((new_addval >= 0) && (old_addval < 0)) ||
 		((new_addval < 0) && (old_addval >= 0))) {
 		/* reversal required, can we do so now? */
-		if ( stepgen->timer3 != 0 ) {
+		if ( pd->timer3[n] != 0 ) {
 		    /* no - hold everything until delays time out */
-		    stepgen->hold_dds = 1;
+		    pd->hold_dds[n] = 1;
 		}
 	    }
 	}
 	/* update DDS */
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
+	if ( !pd->hold_dds[n] && pd->enable[n] ) {
 	    /* save current value of low half of accum */
-	    step_now = stepgen->accum;
+	    step_now = pd->accum[n];
 	    /* update the accumulator */
-	    stepgen->accum += stepgen->addval;
+	    pd->accum[n] += pd->addval[n];
 	    /* test for changes in low half of accum */
-	    step_now ^= stepgen->accum;
+	    step_now ^= pd->accum[n];
 	    /* we only care about the pickoff bit */
 	    step_now &= (1L << PICKOFF);
 	    /* update rawcounts parameter */
-	    stepgen->rawcount = stepgen->accum >> PICKOFF;
+	    pd->rawcount[n] = pd->accum[n] >> PICKOFF;
 	} else {
 	    /* DDS is in hold, no steps */
 	    step_now = 0;
 	}
-	if ( stepgen->timer2 == 0 ) {
+	if ( pd->timer2[n] == 0 ) {
 	    /* update direction - do not change if addval = 0 */
-	    if ( stepgen->addval > 0 ) {
-		stepgen->curr_dir = 1;
-	    } else if ( stepgen->addval < 0 ) {
-		stepgen->curr_dir = -1;
+	    if ( pd->addval[n] > 0 ) {
+		pd->curr_dir[n] = 1;
+	    } else if ( pd->addval[n] < 0 ) {
+		pd->curr_dir[n] = -1;
 	    }
 	}
 	if ( step_now ) {
 	    /* (re)start various timers */
 	    /* timer 1 = time till end of step pulse */
-	    stepgen->timer1 = stepgen->step_len;
+	    pd->timer1[n] = pd->step_len[n];
 	    /* timer 2 = time till allowed to change dir pin */
-	    stepgen->timer2 = stepgen->timer1 + stepgen->dir_hold_dly;
+	    pd->timer2[n] = pd->timer1[n] + pd->dir_hold_dly[n];
 	    /* timer 3 = time till allowed to step the other way */
-	    stepgen->timer3 = stepgen->timer2 + stepgen->dir_setup;
+	    pd->timer3[n] = pd->timer2[n] + pd->dir_setup[n];
 	    if ( stepgen->step_type >= 2 ) {
 		/* update state */
-		stepgen->state += stepgen->curr_dir;
+		stepgen->state += pd->curr_dir[n];
 		if ( stepgen->state < 0 ) {
 		    stepgen->state = stepgen->cycle_max;
 		} else if ( stepgen->state > stepgen->cycle_max ) {
@@ -669,20 +774,20 @@ static void make_pulses(void *arg, long period)
 	/* generate output, based on stepping type */
 	if (stepgen->step_type == 0) {
 	    /* step/dir output */
-	    if ( stepgen->timer1 != 0 ) {
+	    if ( pd->timer1[n] != 0 ) {
 		 *(stepgen->phase[STEP_PIN]) = 1;
 	    } else {
 		 *(stepgen->phase[STEP_PIN]) = 0;
 	    }
-	    if ( stepgen->curr_dir < 0 ) {
+	    if ( pd->curr_dir[n] < 0 ) {
 		 *(stepgen->phase[DIR_PIN]) = 1;
 	    } else {
 		 *(stepgen->phase[DIR_PIN]) = 0;
 	    }
 	} else if (stepgen->step_type == 1) {
 	    /* up/down */
-	    if ( stepgen->timer1 != 0 ) {
-		if ( stepgen->curr_dir < 0 ) {
+	    if ( pd->timer1[n] != 0 ) {
+		if ( pd->curr_dir[n] < 0 ) {
 		    *(stepgen->phase[UP_PIN]) = 0;
 		    *(stepgen->phase[DOWN_PIN]) = 1;
 		} else {
@@ -724,8 +829,8 @@ static void update_pos(void *arg, long period)
 	   make_pulses could change it half-way through a read.
 	   So we have a crude atomic read routine */
 	do {
-	    accum_a = stepgen->accum;
-	    accum_b = stepgen->accum;
+	    accum_a = ((volatile long long *) pulse_data->accum)[n];
+	    accum_b = ((volatile long long *) pulse_data->accum)[n];
 	} while ( accum_a != accum_b );
 	/* compute integer counts */
 	*(stepgen->count) = accum_a >> PICKOFF;
@@ -859,6 +964,10 @@ static void update_freq(void *arg, long period)
 	    stepgen->old_dir_hold_dly = ulceil(stepgen->dir_hold_dly, periodns);
 	    stepgen->dir_hold_dly = stepgen->old_dir_hold_dly;
 	}
+	/* hand the rounded values to makepulses */
+	pulse_data->step_len[n] = stepgen->step_len;
+	pulse_data->dir_hold_dly[n] = stepgen->dir_hold_dly;
+	pulse_data->dir_setup[n] = stepgen->dir_setup;
 	/* test for disabled stepgen */
 	if (*stepgen->enable == 0) {
 	    /* disabled: keep updating old_pos_cmd (if in pos ctrl mode) */
@@ -867,8 +976,8 @@ static void update_freq(void *arg, long period)
 	    }
 	    /* set velocity to zero */
 	    stepgen->freq = 0;
-	    stepgen->addval = 0;
-	    stepgen->target_addval = 0;
+	    pulse_data->addval[n] = 0;
+	    pulse_data->target_addval[n] = 0;
 	    /* and skip to next one */
 	    stepgen++;
 	    continue;
@@ -930,8 +1039,8 @@ static void update_freq(void *arg, long period)
 	       make_pulses could change it half-way through a read.
 	       So we have a crude atomic read routine */
 	    do {
-		accum_a = stepgen->accum;
-		accum_b = stepgen->accum;
+		accum_a = ((volatile long long *) pulse_data->accum)[n];
+		accum_b = ((volatile long long *) pulse_data->accum)[n];
 	    } while ( accum_a != accum_b );
 	    /* convert from fixed point to double, after subtracting
 	       the one-half step offset */
@@ -1016,9 +1125,9 @@ static void update_freq(void *arg, long period)
 	}
 	stepgen->freq = new_vel;
 	/* calculate new addval */
-	stepgen->target_addval = stepgen->freq * freqscale;
+	pulse_data->target_addval[n] = stepgen->freq * freqscale;
 	/* calculate new deltalim */
-	stepgen->deltalim = max_ac * accelscale;
+	pulse_data->deltalim[n] = max_ac * accelscale;
 	/* move on to next channel */
 	stepgen++;
     }
@@ -1041,7 +1150,7 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
     rtapi_set_msg_level(RTAPI_MSG_WARN);
 
     /* export param variable for raw counts */
-    retval = hal_param_s32_newf(HAL_RO, &(addr->rawcount), comp_id,
+    retval = hal_param_s32_newf(HAL_RO, &(pulse_data->rawcount[num]), comp_id,
 	"stepgen.%d.rawcounts", num);
     if (retval != 0) { return retval; }
     /* export pin for counts captured by update() */
@@ -1170,20 +1279,24 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
 	addr->lut = &(master_lut[step_type - 2][0]);
     }
     /* init the step generator core to zero output */
-    addr->timer1 = 0;
-    addr->timer2 = 0;
-    addr->timer3 = 0;
-    addr->hold_dds = 0;
-    addr->addval = 0;
+    pulse_data->timer1[num] = 0;
+    pulse_data->timer2[num] = 0;
+    pulse_data->timer3[num] = 0;
+    pulse_data->hold_dds[num] = 0;
+    pulse_data->addval[num] = 0;
     /* accumulator gets a half step offset, so it will step half
        way between integer positions, not at the integer positions */
-    addr->accum = 1 << (PICKOFF-1);
-    addr->rawcount = 0;
-    addr->curr_dir = 0;
+    pulse_data->accum[num] = 1 << (PICKOFF-1);
+    pulse_data->rawcount[num] = 0;
+    pulse_data->curr_dir[num] = 0;
+    pulse_data->enable[num] = 0;
     addr->state = 0;
     *(addr->enable) = 0;
-    addr->target_addval = 0;
-    addr->deltalim = 0;
+    pulse_data->target_addval[num] = 0;
+    pulse_data->deltalim[num] = 0;
+    pulse_data->step_len[num] = addr->step_len;
+    pulse_data->dir_hold_dly[num] = addr->dir_hold_dly;
+    pulse_data->dir_setup[num] = addr->dir_setup;
     /* other init */
     addr->printed_error = 0;
     addr->old_pos_cmd = 0.0;
@@ -68,6 +68,8 @@ static char *cfg[MAX_STREAMERS];	/* config string, no default */
 RTAPI_MP_ARRAY_STRING(cfg,MAX_STREAMERS,"config string");
 static int depth[MAX_STREAMERS];	/* depth of fifo, default 0 */
 RTAPI_MP_ARRAY_INT(depth,MAX_STREAMERS,"fifo depth");
+static int max_shmem = MAX_SHMEM;	/* limit on fifo size, in bytes */
+RTAPI_MP_INT(max_shmem, "max bytes of user/RT shared memory per fifo");
 
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
@@ -115,10 +117,10 @@ int rtapi_app_main(void)
 		"STREAMER: ERROR: bad config string '%s'\n", cfg[n]);
 	    return -EINVAL;
 	}
-	max_depth = MAX_SHMEM / (sizeof(shmem_data_t) * tmp_fifo[n].num_pins);
+	max_depth = max_shmem / (sizeof(shmem_data_t) * tmp_fifo[n].num_pins);
 	if ( depth[n] > max_depth ) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
-		"STREAMER: ERROR: depth too large, max is %d\n", max_depth);
+		"STREAMER: ERROR: depth too large, max is %d (see max_shmem=)\n", max_depth);
 	    return -ENOMEM;
 	}
 	tmp_fifo[n].depth = depth[n];
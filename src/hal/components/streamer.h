@@ -12,14 +12,21 @@
 
 #define MAX_STREAMERS		8
 #define MAX_SAMPLERS		8
-#define MAX_PINS 		20
-#define MAX_SHMEM 		128000
+#define MAX_PINS 		64
+#define MAX_SHMEM 		128000	/* default for max_shmem= */
 #define STREAMER_SHMEM_KEY 	0x48535430
 #define SAMPLER_SHMEM_KEY	0x48534130
 #define FIFO_MAGIC_NUM		0x4649464F
 
 /* These structs live in the shared memory that connects the user
    space and RT parts.  They are _not_ in HAL shared memory.
+   A fifo record is 'num_pins' shmem_data_t's for the streamer, and
+   one more holding the sample number for the sampler.  For a sampler
+   with a window, 'num_pins' and 'type' describe the values in a
+   record rather than the pins; with a trigger, records are only
+   written around it and the sample numbers jump in between.  The binary
+   modes of halstreamer and halsampler read and write records in
+   exactly this layout, in native byte order.
 */
 
 typedef union {
@@ -36,6 +43,8 @@ typedef struct {
     int depth;
     int num_pins;
     unsigned long last_sample;
+    int window;			/* sampler periods per record */
+    int triggered;		/* sampler only writes around a trigger */
     hal_type_t type[MAX_PINS];
     shmem_data_t data[];
 } fifo_t;
@@ -63,6 +63,7 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 #include "rtapi.h"		/* RTAPI realtime OS API */
@@ -73,6 +74,9 @@
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
+static void put_records(fifo_t *fifo, const char *src, long count);
+static int stream_binary(fifo_t *fifo, int fd);
+
 /***********************************************************************
 *                         GLOBAL VARIABLES                             *
 ************************************************************************/
@@ -114,12 +118,13 @@ int main(int argc, char **argv)
     shmem_data_t *data, *dptr;
     char buf[BUF_SIZE];
 	const char *errmsg;
-    int tmpin, newin;
+    int tmpin, newin, binary;
     struct timespec delay;
 
     /* set return code to "fail", clear it later if all goes well */
     exitval = 1;
     channel = 0;
+    binary = 0;
     for ( n = 1 ; n < argc ; n++ ) {
 	cp = argv[n];
 	if ( *cp != '-' ) {
@@ -136,6 +141,9 @@ int main(int argc, char **argv)
 		exit(1);
 	    }
 	    break;
+	case 'b':
+	    binary = 1;
+	    break;
 	default:
 	    fprintf(stderr,"ERROR: unknown option '%s'\n", cp );
 	    exit(1);
@@ -150,6 +158,10 @@ int main(int argc, char **argv)
 	}
 	// make stdin be the named file
 	fd = open(argv[n], O_RDONLY);
+	if(fd < 0) {
+	    fprintf(stderr, "ERROR: can't open '%s'\n", argv[n]);
+	    exit(1);
+	}
 	close(0);
 	dup2(fd, 0);
     }
@@ -202,8 +214,14 @@ int main(int argc, char **argv)
 	fprintf(stderr, "ERROR: couldn't re-map user/RT shared memory\n");
 	goto out;
     }
-    line = 1;
     fifo = shmem_ptr;
+    if ( binary ) {
+	if ( stream_binary(fifo, 0) == 0 ) {
+	    exitval = 0;
+	}
+	goto out;
+    }
+    line = 1;
     data = fifo->data;
     while ( fgets(buf, BUF_SIZE, stdin) ) {
 	/* calculate _next_ value for in */
@@ -299,3 +317,100 @@ out:
     }
     return exitval;
 }
+
+/* copies 'count' records into the fifo, in as few blocks as the free
+   space allows, waiting whenever the fifo is full */
+static void put_records(fifo_t *fifo, const char *src, long count)
+{
+    int rec_size, tmpin, space, n;
+    struct timespec delay;
+
+    rec_size = fifo->num_pins * sizeof(shmem_data_t);
+    while ( count > 0 ) {
+	tmpin = fifo->in;
+	space = fifo->out - tmpin - 1;
+	if ( space < 0 ) {
+	    space += fifo->depth;
+	}
+	if ( space == 0 ) {
+            /* fifo full, sleep for 10mS */
+	    delay.tv_sec = 0;
+	    delay.tv_nsec = 10000000;
+	    nanosleep(&delay,NULL);
+	    continue;
+	}
+	/* don't wrap within a block */
+	n = fifo->depth - tmpin;
+	if ( n > space ) {
+	    n = space;
+	}
+	if ( n > count ) {
+	    n = count;
+	}
+	memcpy(&fifo->data[tmpin*fifo->num_pins], src, n * rec_size);
+	tmpin += n;
+	if ( tmpin >= fifo->depth ) {
+	    tmpin = 0;
+	}
+	/* data must be in place before RT can see the new 'in' */
+	__sync_synchronize();
+	fifo->in = tmpin;
+	src += n * rec_size;
+	count -= n;
+    }
+}
+
+/* streams raw fifo records from 'fd'.  A regular file is mapped and
+   copied straight into the fifo, anything else (a pipe, for example)
+   is read a fifo's worth at a time. */
+static int stream_binary(fifo_t *fifo, int fd)
+{
+    int rec_size, len, got, n;
+    struct stat st;
+    char *map, *buf;
+
+    rec_size = fifo->num_pins * sizeof(shmem_data_t);
+    if (( fstat(fd, &st) == 0 ) && S_ISREG(st.st_mode) && ( st.st_size > 0 )) {
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( map != MAP_FAILED ) {
+	    madvise(map, st.st_size, MADV_SEQUENTIAL);
+	    put_records(fifo, map, st.st_size / rec_size);
+	    munmap(map, st.st_size);
+	    if ( st.st_size % rec_size ) {
+		fprintf(stderr, "ERROR: partial record at end of input\n");
+		return -1;
+	    }
+	    return 0;
+	}
+    }
+    len = fifo->depth * rec_size;
+    buf = malloc(len);
+    if ( buf == NULL ) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	return -1;
+    }
+    got = 0;
+    while ( 1 ) {
+	n = read(fd, buf + got, len - got);
+	if ( n < 0 ) {
+	    fprintf(stderr, "ERROR: read failed\n");
+	    free(buf);
+	    return -1;
+	}
+	if ( n == 0 ) {
+	    break;
+	}
+	got += n;
+	/* pass on whole records, keep any partial one for next time */
+	put_records(fifo, buf, got / rec_size);
+	n = got % rec_size;
+	memmove(buf, buf + got - n, n);
+	got = n;
+    }
+    free(buf);
+    if ( got ) {
+	fprintf(stderr, "ERROR: partial record at end of input\n");
+	return -1;
+    }
+    return 0;
+}
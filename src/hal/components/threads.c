@@ -16,7 +16,8 @@
     It will mostly be used for testing - when EMC is run normally,
     the motion module creates all the neccessary threads.
     
-    The module has three pairs of parameters, "name1, period1", etc.
+    The module has three sets of parameters, "name1, period1, fp1, cpu1",
+    etc.
 */
 
 /** Copyright (C) 2003 John Kasunich
@@ -57,24 +58,38 @@
 MODULE_AUTHOR("John Kasunich");
 MODULE_DESCRIPTION("Thread Module for HAL");
 MODULE_LICENSE("GPL");
+#define MAX_HELPERS 4
+
 static char *name1 = "thread1";	/* name of thread */
 RTAPI_MP_STRING(name1, "name of thread 1");
 static int fp1 = 1;		/* use floating point? default = yes */
 RTAPI_MP_INT(fp1, "thread1 uses floating point");
 static long period1 = 1000000;	/* thread period - default = 1ms thread */
 RTAPI_MP_LONG(period1,  "thread1 period (nsecs)");
+static int cpu1 = -1;		/* CPU to run on - default = any */
+RTAPI_MP_INT(cpu1, "thread1 CPU number (-1 = default)");
+static int helpers1[MAX_HELPERS] = { -1, -1, -1, -1 };
+RTAPI_MP_ARRAY_INT(helpers1, MAX_HELPERS, "CPUs for thread1 helper tasks");
 static char *name2 = NULL;	/* name of thread */
 RTAPI_MP_STRING(name2, "name of thread 2");
 static int fp2 = 1;		/* use floating point? default = yes */
 RTAPI_MP_INT(fp2, "thread2 uses floating point");
 static long period2 = 0;	/* thread period - default = no thread */
 RTAPI_MP_LONG(period2, "thread2 period (nsecs)");
+static int cpu2 = -1;		/* CPU to run on - default = any */
+RTAPI_MP_INT(cpu2, "thread2 CPU number (-1 = default)");
+static int helpers2[MAX_HELPERS] = { -1, -1, -1, -1 };
+RTAPI_MP_ARRAY_INT(helpers2, MAX_HELPERS, "CPUs for thread2 helper tasks");
 static char *name3 = NULL;	/* name of thread */
 RTAPI_MP_STRING(name3, "name of thread 3");
 static int fp3 = 1;		/* use floating point? default = yes */
 RTAPI_MP_INT(fp3, "thread1 uses floating point");
 static long period3 = 0;	/* thread period - default = no thread */
 RTAPI_MP_LONG(period3, "thread3 period (nsecs)");
+static int cpu3 = -1;		/* CPU to run on - default = any */
+RTAPI_MP_INT(cpu3, "thread3 CPU number (-1 = default)");
+static int helpers3[MAX_HELPERS] = { -1, -1, -1, -1 };
+RTAPI_MP_ARRAY_INT(helpers3, MAX_HELPERS, "CPUs for thread3 helper tasks");
 
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
@@ -87,6 +102,8 @@ static int comp_id;		/* component ID */
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
+static int add_helpers(char *name, int *cpus);
+
 
 /***********************************************************************
 *                       INIT AND EXIT CODE                             *
@@ -106,7 +123,7 @@ int rtapi_app_main(void)
     /* was 'period' specified in the insmod command? */
     if ((period1 > 0) && (name1 != NULL) && (*name1 != '\0')) {
 	/* create a thread */
-	retval = hal_create_thread(name1, period1, fp1);
+	retval = hal_create_thread_cpu(name1, period1, fp1, cpu1);
 	if (retval < 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"THREADS: ERROR: could not create thread '%s'\n", name1);
@@ -115,10 +132,14 @@ int rtapi_app_main(void)
 	} else {
 	    rtapi_print_msg(RTAPI_MSG_INFO, "THREADS: created %ld uS thread\n", period1 / 1000);
 	}
+	if (add_helpers(name1, helpers1) < 0) {
+	    hal_exit(comp_id);
+	    return -1;
+	}
     }
     if ((period2 > 0) && (name2 != NULL) && (*name2 != '\0')) {
 	/* create a thread */
-	retval = hal_create_thread(name2, period2, fp2);
+	retval = hal_create_thread_cpu(name2, period2, fp2, cpu2);
 	if (retval < 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"THREADS: ERROR: could not create thread '%s'\n", name2);
@@ -127,10 +148,14 @@ int rtapi_app_main(void)
 	} else {
 	    rtapi_print_msg(RTAPI_MSG_INFO, "THREADS: created %ld uS thread\n", period2 / 1000);
 	}
+	if (add_helpers(name2, helpers2) < 0) {
+	    hal_exit(comp_id);
+	    return -1;
+	}
     }
     if ((period3 > 0) && (name3 != NULL) && (*name3 != '\0')) {
 	/* create a thread */
-	retval = hal_create_thread(name3, period3, fp3);
+	retval = hal_create_thread_cpu(name3, period3, fp3, cpu3);
 	if (retval < 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"THREADS: ERROR: could not create thread '%s'\n", name3);
@@ -139,6 +164,10 @@ int rtapi_app_main(void)
 	} else {
 	    rtapi_print_msg(RTAPI_MSG_INFO, "THREADS: created %ld uS thread\n", period3 / 1000);
 	}
+	if (add_helpers(name3, helpers3) < 0) {
+	    hal_exit(comp_id);
+	    return -1;
+	}
     }
     hal_ready(comp_id);
     return 0;
@@ -149,3 +178,22 @@ void rtapi_app_exit(void)
     hal_exit(comp_id);
 }
 
+/***********************************************************************
+*                       LOCAL FUNCTION DEFINITIONS                     *
+************************************************************************/
+
+static int add_helpers(char *name, int *cpus)
+{
+    int n, retval;
+
+    for (n = 0; n < MAX_HELPERS && cpus[n] != -1; n++) {
+	retval = hal_thread_add_worker(name, cpus[n]);
+	if (retval < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"THREADS: ERROR: could not add helper on CPU %d to thread '%s'\n",
+		cpus[n], name);
+	    return retval;
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef _TRACE_RING_H_
+#define _TRACE_RING_H_
+
+/*
+ * trace_ring: logging from the servo function without stdio.
+ *
+ * The servo function is the only producer and a background thread the
+ * only consumer, so the ring needs no lock: the producer only moves
+ * head, the consumer only moves tail.  Each record is a 16 bit length
+ * followed by the payload.  The thread hands each record to a
+ * formatter, or writes it out as is when there is none, so binary
+ * records (e.g. raw mailbox words) are decoded away from the servo
+ * thread.  A record that does not fit is dropped and counted.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define TRACE_RING_SIZE     (1 << 18)       // bytes, power of two
+#define TRACE_RING_MSG      1024            // longest trace_ring_printf()
+
+typedef void (*trace_format_t)(FILE *fp, const uint8_t *rec, int size);
+
+typedef struct {
+    volatile uint32_t   head;       // written by the producer
+    volatile uint32_t   tail;       // written by the consumer
+    volatile int        running;
+    uint32_t            dropped;
+    FILE                *fp;
+    trace_format_t      format;
+    pthread_t           thread;
+    uint8_t             buf[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static void trace_ring_copy_out(trace_ring_t *r, uint32_t pos, void *dst, int size)
+{
+    uint32_t at = pos & (TRACE_RING_SIZE - 1);
+    uint32_t n = TRACE_RING_SIZE - at;
+
+    if (n > size) {
+        n = size;
+    }
+    memcpy(dst, r->buf + at, n);
+    memcpy((uint8_t *) dst + n, r->buf, size - n);
+}
+
+static void trace_ring_copy_in(trace_ring_t *r, uint32_t pos, const void *src, int size)
+{
+    uint32_t at = pos & (TRACE_RING_SIZE - 1);
+    uint32_t n = TRACE_RING_SIZE - at;
+
+    if (n > size) {
+        n = size;
+    }
+    memcpy(r->buf + at, src, n);
+    memcpy(r->buf, (const uint8_t *) src + n, size - n);
+}
+
+/* producer side: never blocks */
+static inline void trace_ring_write(trace_ring_t *r, const void *rec, int size)
+{
+    uint16_t len = size;
+    uint32_t head = r->head;
+
+    if (size > 0xFFFF
+        || TRACE_RING_SIZE - (head - r->tail) < sizeof(len) + size) {
+        r->dropped++;
+        return;
+    }
+    trace_ring_copy_in(r, head, &len, sizeof(len));
+    trace_ring_copy_in(r, head + sizeof(len), rec, size);
+    __sync_synchronize();   // payload before head
+    r->head = head + sizeof(len) + size;
+}
+
+static inline void trace_ring_printf(trace_ring_t *r, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+static inline void trace_ring_printf(trace_ring_t *r, const char *fmt, ...)
+{
+    char msg[TRACE_RING_MSG];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    if (n >= (int) sizeof(msg)) {
+        n = sizeof(msg) - 1;
+    }
+    if (n > 0) {
+        trace_ring_write(r, msg, n);
+    }
+}
+
+/* consumer side: returns the number of records written to the file */
+static int trace_ring_drain(trace_ring_t *r)
+{
+    static uint8_t rec[0x10000];
+    uint32_t tail = r->tail;
+    uint32_t head;
+    uint16_t len;
+    int n = 0;
+
+    head = r->head;
+    __sync_synchronize();   // head before payload
+    while (tail != head) {
+        trace_ring_copy_out(r, tail, &len, sizeof(len));
+        trace_ring_copy_out(r, tail + sizeof(len), rec, len);
+        tail += sizeof(len) + len;
+        __sync_synchronize();   // payload read before the space is freed
+        r->tail = tail;
+        if (r->format) {
+            r->format(r->fp, rec, len);
+        } else {
+            fwrite(rec, 1, len, r->fp);
+        }
+        n++;
+    }
+    if (n) {
+        fflush(r->fp);
+    }
+    return n;
+}
+
+static void *trace_ring_thread(void *arg)
+{
+    trace_ring_t *r = arg;
+
+    while (r->running) {
+        if (trace_ring_drain(r) == 0) {
+            usleep(10000);
+        }
+    }
+    return NULL;
+}
+
+static int trace_ring_open(trace_ring_t *r, const char *path, trace_format_t format)
+{
+    r->head = r->tail = 0;
+    r->dropped = 0;
+    r->format = format;
+    r->fp = fopen(path, "w");
+    if (r->fp == NULL) {
+        return -1;
+    }
+    r->running = 1;
+    if (pthread_create(&r->thread, NULL, trace_ring_thread, r) != 0) {
+        r->running = 0;
+        fclose(r->fp);
+        r->fp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void trace_ring_close(trace_ring_t *r)
+{
+    if (r->fp == NULL) {
+        return;
+    }
+    r->running = 0;
+    pthread_join(r->thread, NULL);
+    trace_ring_drain(r);
+    if (r->dropped) {
+        fprintf(r->fp, "# %u records dropped\n", r->dropped);
+    }
+    fclose(r->fp);
+    r->fp = NULL;
+}
+
+#endif  // _TRACE_RING_H_
@@ -219,6 +219,19 @@ RTAPI_MP_INT(num_gpio_in, "Number of WOU HAL PINs for gpio input");
 int num_gpio_out = 32;
 RTAPI_MP_INT(num_gpio_out, "Number of WOU HAL PINs for gpio output");
 
+// simulated USB link: latency = usb_latency_ns + [0, usb_jitter_ns),
+// plus usb_spike_ns for usb_spike_ppm frames out of a million
+int usb_latency_ns = 0;
+RTAPI_MP_INT(usb_latency_ns, "simulated USB latency per frame, unit: ns");
+int usb_jitter_ns = 0;
+RTAPI_MP_INT(usb_jitter_ns, "random extra USB latency, unit: ns");
+int usb_spike_ns = 0;
+RTAPI_MP_INT(usb_spike_ns, "extra USB latency of rare frames, unit: ns");
+int usb_spike_ppm = 0;
+RTAPI_MP_INT(usb_spike_ppm, "frames per million with usb_spike_ns");
+int sim_seed = 1;
+RTAPI_MP_INT(sim_seed, "seed of the simulated USB latencies");
+
 //const char *thc_velocity = "1.0"; // 1mm/s
 //RTAPI_MP_STRING(thc_velocity, "Torch Height Control velocity");
 
@@ -378,6 +391,7 @@ typedef struct {
     hal_float_t *vel_cmd;	/* pin: velocity command (pos units/sec) */
     double prev_vel_cmd;        /* prev vel cmd: previous velocity command */
     double      pos_cmd_s;	/* saved pos_cmd at rising edge of usb_busy */
+    double      sim_pos_cmd;	/* pos_cmd of the last frame, for wou.sim.stalls */
     hal_float_t *pos_cmd;	/* pin: position command (position units) */
     double prev_pos_cmd;        /* prev pos_cmd: previous position command */
     hal_float_t *probed_pos;
@@ -420,6 +434,9 @@ typedef struct {
 typedef struct {
     hal_bit_t   *usb_busy;
     hal_bit_t   usb_busy_s;
+    hal_u32_t   *usb_overruns;  /* periods the last frame was still on the link */
+    hal_u32_t   *sim_frames;    /* frames sent */
+    hal_u32_t   *sim_stalls;    /* frames in coord mode that moved no joint */
     hal_bit_t   *ignore_ahc_limit;
     hal_bit_t   *align_pos_cmd;
     hal_bit_t   *ignore_host_cmd;
@@ -523,6 +540,13 @@ static int num_joints = 0;	/* number of step generators configured */
 static double dt;		/* update_freq period in seconds */
 static double recip_dt;		/* reciprocal of period, avoids divides */
 
+/* The simulated link keeps its own time, advanced by the period of
+   update_freq(), so a given seed gives the same busy periods however
+   fast the threads really run. */
+static long long link_now;	/* ns */
+static long long link_free_at;	/* ns: when the last frame is through */
+static uint32_t link_rand;
+
 /***********************************************************************
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
@@ -887,6 +911,9 @@ int rtapi_app_main(void)
 			"STEPGEN: ERROR: hal_init(wou_sim) failed\n");
 	return -1;
     }
+    link_rand = sim_seed;
+    link_now = 0;
+    link_free_at = 0;
 
     /* allocate shared memory for counter data */
     stepgen_array = hal_malloc(num_joints * sizeof(stepgen_t));
@@ -1080,6 +1107,25 @@ void rtapi_app_exit(void)
 *              REALTIME STEP PULSE GENERATION FUNCTIONS                *
 ************************************************************************/
 
+static uint32_t sim_rand(void)
+{
+    link_rand = link_rand * 1103515245 + 12345;
+    return link_rand >> 8;	// low bits of an LCG are poor
+}
+
+static long long link_latency(void)
+{
+    long long latency = usb_latency_ns;
+
+    if (usb_jitter_ns > 0) {
+        latency += (long long) sim_rand() * usb_jitter_ns >> 24;
+    }
+    if (usb_spike_ppm > 0 && sim_rand() % 1000000 < usb_spike_ppm) {
+        latency += usb_spike_ns;
+    }
+    return latency;
+}
+
 // This function was invented by Jeff Epler.
 // It forces a floating-point variable to be degraded from native register
 // size (80 bits on x86) to C double size (64 bits).
@@ -1121,6 +1167,25 @@ static void update_freq(void *arg, long period)
     int msg;
         
     // TODO: confirm trajecotry planning thread is always ahead of wou
+    link_now += period;
+    if (link_now < link_free_at) {
+        // the last frame is still on the link: same as wou_flush() == -1
+        *(machine_control->usb_busy) = 1;
+        *(machine_control->usb_overruns) += 1;
+        if (machine_control->usb_busy_s == 0) {
+            // store current traj-planning command
+            stepgen = arg;
+            for (n = 0; n < num_joints; n++) {
+                stepgen->pos_cmd_s = *(stepgen->pos_cmd);
+                stepgen ++;
+            }
+        }
+        machine_control->usb_busy_s = 1;
+        return;
+    }
+    link_free_at = link_now + link_latency();
+    *(machine_control->sim_frames) += 1;
+
         *(machine_control->usb_busy) = 0;
         if (machine_control->usb_busy_s == 1) {
             // DP("usb_busy: end\n");
@@ -1560,6 +1625,21 @@ static void update_freq(void *arg, long period)
         memcpy(data, &sync_cmd, sizeof(uint16_t));
     }
     machine_control->prev_vel_sync = sync_cmd;
+
+    // a frame in coord mode that moves no joint: motion ran out of commands
+    // (or is in a dwell)
+    i = 0;
+    stepgen = arg;
+    for (n = 0; n < num_joints; n++) {
+        if (*(stepgen->pos_cmd) != stepgen->sim_pos_cmd) {
+            i = 1;
+        }
+        stepgen->sim_pos_cmd = *(stepgen->pos_cmd);
+        stepgen ++;
+    }
+    if (i == 0 && *machine_control->motion_state == EMCMOT_MOTION_COORD) {
+        *(machine_control->sim_stalls) += 1;
+    }
     machine_control->prev_motion_state = *machine_control->motion_state;
 
 #if (TRACE!=0)
@@ -1796,6 +1876,7 @@ static int export_stepgen(int num, stepgen_t * addr,
     addr->maxaccel = 0.0;
     addr->pos_mode = pos_mode;
     addr->pos_cmd_s = 0;
+    addr->sim_pos_cmd = 0;
     /* timing parameter defaults depend on step type */
     addr->step_len = 1;
     /* init the step generator core to zero output */
@@ -1842,6 +1923,27 @@ static int export_machine_control(machine_control_t * machine_control)
         return retval;
     }
 
+    retval = hal_pin_u32_newf(HAL_OUT, &(machine_control->usb_overruns), comp_id,
+                              "wou.usb-overruns");
+    if (retval != 0) {
+        return retval;
+    }
+    *(machine_control->usb_overruns) = 0;
+
+    retval = hal_pin_u32_newf(HAL_OUT, &(machine_control->sim_frames), comp_id,
+                              "wou.sim.frames");
+    if (retval != 0) {
+        return retval;
+    }
+    *(machine_control->sim_frames) = 0;
+
+    retval = hal_pin_u32_newf(HAL_OUT, &(machine_control->sim_stalls), comp_id,
+                              "wou.sim.stalls");
+    if (retval != 0) {
+        return retval;
+    }
+    *(machine_control->sim_stalls) = 0;
+
     retval = hal_pin_bit_newf(HAL_OUT, &(machine_control->vel_sync), comp_id,
                               "wou.motion.vel-sync");
     if (retval != 0) {
@@ -53,15 +53,24 @@
 // to disable DP(): #define TRACE 0
 #define TRACE 0
 #include "dptrace.h"
+#include "trace_ring.h"
 #if (TRACE!=0)
-static FILE *dptrace;
+// the servo function only fills the ring, a thread writes the file
+static trace_ring_t dptrace;
+#undef DP
+#undef DPS
+#define DP(fmt, args...)                                                \
+    trace_ring_printf(&dptrace, "%s: (%s:%d) " fmt,                     \
+                      __FILE__, __FUNCTION__, __LINE__, ##args)
+#define DPS(fmt, args...)   trace_ring_printf(&dptrace, fmt, ##args)
 #endif
 
 // to disable MAILBOX dump: #define MBOX_LOG 0
 #define MBOX_LOG 0
 #if (MBOX_LOG)
 #define MBOX_DEBUG_VARS     0      // extra MBOX VARS for debugging
-static FILE *mbox_fp;
+// fetchmail() queues the raw MT_MOTION_STATUS words, mbox_log() decodes them
+static trace_ring_t mbox_ring;
 #endif
 
 #define DEBUG_LOG 0
@@ -265,6 +274,9 @@ typedef struct {
     double      pos_cmd_s;	/* saved pos_cmd at rising edge of usb_busy */
     hal_float_t *pos_cmd;	/* pin: motor_pos_cmd (position units) */
     double prev_pos_cmd;        /* prev pos_cmd: previous position command */
+    hal_bit_t *feed_forward;    /* pin: lead pos_cmd by vel_ff, acc_ff */
+    hal_float_t *vel_ff;        /* pin: joint.N.vel-cmd from motion */
+    hal_float_t *acc_ff;        /* pin: joint.N.acc-cmd from motion */
     hal_float_t *probed_pos;
     hal_bit_t *align_pos_cmd;
     hal_float_t *pos_fb;	/* pin: position feedback (position units) */
@@ -309,6 +321,7 @@ typedef struct {
 typedef struct {
     hal_bit_t   *usb_busy;
     hal_bit_t   usb_busy_s;
+    hal_u32_t   *usb_overruns;  /* periods the last frame was not yet accepted */
     hal_bit_t   *ignore_ahc_limit;
     hal_bit_t   *align_pos_cmd;
     // hal_bit_t   *ignore_host_cmd;
@@ -439,7 +452,10 @@ void endian_swap(uint32_t  *x)
  ************************************************************************/
 static void get_crc_error_counter(int32_t crc_error_counter)
 {
-    // store crc_error_counter
+    // libwou resends the frames that failed their crc check
+    if (machine_control) {
+        *(machine_control->crc_error_counter) = crc_error_counter;
+    }
     return;
 }
 
@@ -452,10 +468,7 @@ static void fetchmail(const uint8_t *buf_head)
     stepgen_t   *stepgen;
     uint32_t    bp_tick;    // served as previous-bp-tick
     uint32_t    machine_status;
-#if (MBOX_LOG)
-    char        dmsg[1024];
-    int         dsize;
-#elif (DEBUG_LOG)
+#if (DEBUG_LOG)
     char        dmsg[1024];
     int         dsize;
 #endif
@@ -562,31 +575,8 @@ static void fetchmail(const uint8_t *buf_head)
 
 
 #if (MBOX_LOG)
-        dsize = sprintf (dmsg, "%10d  ", bp_tick);  // #0
-        // fprintf (mbox_fp, "%10d  ", bp_tick);
-        stepgen = stepgen_array;
-        for (i=0; i<num_joints; i++) {
-            dsize += sprintf (dmsg + dsize, "%10d %10d %10d  ",
-                    *(stepgen->pulse_pos),
-                    *(stepgen->enc_pos),
-                    *(stepgen->joint_cmd)
-            );
-            stepgen += 1;   // point to next joint
-        }
-        dsize += sprintf (dmsg + dsize, "0x%04X 0x%04X 0x%04X", // #21 #22 #23
-                din[0],
-                din[1],
-                dout[0]);
-        dsize += sprintf (dmsg + dsize, "  %10d 0x%04X", *(analog->in[0]), ferror_flag); // #24 #25
-
-
-        // number of debug words: to match "send_joint_status() at common.c
-        for (i=0; i<MBOX_DEBUG_VARS; i++) {
-            p += 1;
-            dsize += sprintf (dmsg + dsize, "%10d ", *p);
-        }
-        assert (dsize < 1023);
-        fprintf (mbox_fp, "%s\n", dmsg);
+        trace_ring_write(&mbox_ring, buf_head,
+                         (uint8_t *) (p + 1 + MBOX_DEBUG_VARS) - buf_head);
 #endif
         break;
 
@@ -653,26 +643,69 @@ static void fetchmail(const uint8_t *buf_head)
     }
 }
 
+#if (MBOX_LOG)
+/* runs in the trace_ring thread: one line per MT_MOTION_STATUS mail */
+static void mbox_log(FILE *fp, const uint8_t *buf_head, int size)
+{
+    const uint32_t *p;
+    int i;
+
+    p = (const uint32_t *) (buf_head + 4);
+    fprintf (fp, "%10d  ", p[0]);       // #0 bp_tick
+    for (i=0; i<num_joints; i++) {
+        // pulse_pos, enc_pos, cmd_fbs
+        fprintf (fp, "%10d %10d %10d  ",
+                (int32_t) p[1 + 4*i],
+                (int32_t) p[2 + 4*i],
+                (int32_t) p[3 + 4*i]);
+    }
+    p += 4 * num_joints;
+    // din[0], din[1], dout[0], analog in[0], machine_status
+    fprintf (fp, "0x%04X 0x%04X 0x%04X", p[1], p[2], p[3]);
+    fprintf (fp, "  %10d 0x%04X", p[4], p[13]);
+
+    // number of debug words: to match "send_joint_status() at common.c
+    p += 15;
+    for (i=0; i<MBOX_DEBUG_VARS; i++) {
+        fprintf (fp, "%10d ", p[1 + i]);
+    }
+    fprintf (fp, "\n");
+}
+#endif
+
+
+/* Set while update_freq() builds the frame of a servo period.  The
+ * sync commands of the write_*() helpers are then only queued: they go
+ * out with the rest of the frame, and a frame that is not accepted by
+ * the next period is counted in wou.usb-overruns instead of spinning. */
+static int sync_batch = 0;
+
+static void flush_sync_cmd (void)
+{
+    if (sync_batch) {
+        return;
+    }
+    while(wou_flush(&w_param) == -1);
+}
 
 static void write_mot_pos_cmd (uint32_t joint, int64_t mot_pos_cmd)
 {
     uint16_t    sync_cmd;
-    uint8_t     buf[sizeof(uint16_t)];
+    uint8_t     buf[(sizeof(int64_t) + 1) * sizeof(uint16_t)];
     int         j;
 
+    // all words go in one WB_WR_CMD
     for(j=0; j<sizeof(int64_t); j++) {
         // byte sequence for int64_t: "4, 5, 6, 7, 0, 1, 2, 3"
         sync_cmd = SYNC_DATA | ((uint8_t *)&mot_pos_cmd)[(4+j) & 0x07];
-        memcpy(buf, &sync_cmd, sizeof(uint16_t));
-        wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-                sizeof(uint16_t), buf);
+        memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     }
 
     sync_cmd = SYNC_MOT_POS_CMD | PACK_MOT_PARAM_ID(joint);
-    memcpy(buf, &sync_cmd, sizeof(uint16_t));
+    memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-            sizeof(uint16_t), buf);
-    while(wou_flush(&w_param) == -1);
+            sizeof(buf), buf);
+    flush_sync_cmd();
     DP("end of SYNC_MOT_POS_CMD\n");
 
     return;
@@ -681,21 +714,19 @@ static void write_mot_pos_cmd (uint32_t joint, int64_t mot_pos_cmd)
 static void write_mot_param (uint32_t joint, uint32_t addr, int32_t data)
 {
     uint16_t    sync_cmd;
-    uint8_t     buf[MAX_DSIZE];
+    uint8_t     buf[(sizeof(int32_t) + 1) * sizeof(uint16_t)];
     int         j;
 
     for(j=0; j<sizeof(int32_t); j++) {
         sync_cmd = SYNC_DATA | ((uint8_t *)&data)[j];
-        memcpy(buf, &sync_cmd, sizeof(uint16_t));
-        wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-                sizeof(uint16_t), buf);
+        memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     }
 
     sync_cmd = SYNC_MOT_PARAM | PACK_MOT_PARAM_ADDR(addr) | PACK_MOT_PARAM_ID(joint);
-    memcpy(buf, &sync_cmd, sizeof(uint16_t));
+    memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-            sizeof(uint16_t), buf);
-    while(wou_flush(&w_param) == -1);
+            sizeof(buf), buf);
+    flush_sync_cmd();
     DP ("end of SYNC_MOT_PARAM_CMD\n");
 
     return;
@@ -717,7 +748,7 @@ static void send_sync_cmd (uint16_t sync_cmd, uint32_t *data, uint32_t size)
     }
 
     wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD), sizeof(uint16_t), (const uint8_t *)&sync_cmd);
-    while(wou_flush(&w_param) == -1);   // wait until all those WB_WR_CMDs are accepted by WOU
+    flush_sync_cmd();   // outside update_freq(): wait until all those WB_WR_CMDs are accepted by WOU
     DP ("end of send_sync_cmd\n");
 
     return;
@@ -807,7 +838,7 @@ static void write_usb_cmd(machine_control_t *mc)
         break;
     }
     *mc->usb_cmd = 0;
-    while(wou_flush(&w_param) == -1);
+    flush_sync_cmd();
     DP("end of write_usb_cmd\n");
     return;
 }
@@ -815,21 +846,19 @@ static void write_usb_cmd(machine_control_t *mc)
 static void write_machine_param (uint32_t addr, int32_t data)
 {
     uint16_t    sync_cmd;
-    uint8_t     buf[MAX_DSIZE];
+    uint8_t     buf[(sizeof(int32_t) + 1) * sizeof(uint16_t)];
     int         j;
 
     for(j=0; j<sizeof(int32_t); j++) {
         sync_cmd = SYNC_DATA | ((uint8_t *)&data)[j];
-        memcpy(buf, &sync_cmd, sizeof(uint16_t));
-        wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-                sizeof(uint16_t), buf);
+        memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     }
     sync_cmd = SYNC_MACH_PARAM | PACK_MACH_PARAM_ADDR(addr);
-    memcpy(buf, &sync_cmd, sizeof(uint16_t));
+    memcpy(buf + j * sizeof(uint16_t), &sync_cmd, sizeof(uint16_t));
     wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD),
-            sizeof(uint16_t), buf);
+            sizeof(buf), buf);
 
-    while(wou_flush(&w_param) == -1);
+    flush_sync_cmd();
     DP ("end of write_machine_param(%u)\n", addr);     // addr(32): MACHINE_CTRL ... updated when accel_state changes
     return;
 }
@@ -853,8 +882,8 @@ int rtapi_app_main(void)
     rtapi_set_msg_level(RTAPI_MSG_DBG);
 
 #if (TRACE!=0)
-    // initialize file handle for logging wou steps
-    dptrace = fopen("wou_stepgen.log", "w");
+    // initialize the ring and thread for logging wou steps
+    trace_ring_open(&dptrace, "wou_stepgen.log", NULL);
     /* prepare header for gnuplot */
     DPS("#%10s  %15s%15s%15s%15s  %15s%15s%15s%15s  %15s%15s%15s%15s  %15s%15s%15s%15s\n",
             "dt",
@@ -895,16 +924,16 @@ int rtapi_app_main(void)
         }
 
 #if (MBOX_LOG)
-        mbox_fp = fopen ("./mbox.log", "w");
-        fprintf (mbox_fp, "%10s  ", "bp_tick");
+        trace_ring_open(&mbox_ring, "./mbox.log", mbox_log);
+        fprintf (mbox_ring.fp, "%10s  ", "bp_tick");
         for (i=0; i<4; i++) {
-            fprintf (mbox_fp, "%9s%d  %9s%d %9s%d  ",
+            fprintf (mbox_ring.fp, "%9s%d  %9s%d %9s%d  ",
                     "pls_pos-", i,
                     "enc_pos-", i,
                     "jnt_cmd-", i
             );
         }
-        fprintf (mbox_fp, "\n");
+        fprintf (mbox_ring.fp, "\n");
 #endif
 #if (DEBUG_LOG)
         debug_fp = fopen ("./debug.log", "w");
@@ -1327,7 +1356,10 @@ int rtapi_app_main(void)
 void rtapi_app_exit(void)
 {
 #if (TRACE!=0)
-    fclose(dptrace);
+    trace_ring_close(&dptrace);
+#endif
+#if (MBOX_LOG)
+    trace_ring_close(&mbox_ring);
 #endif
     hal_exit(comp_id);
 }
@@ -1397,6 +1429,7 @@ static void update_freq(void *arg, long period)
 
         // raise flag to pause trajectory planning
         *(machine_control->usb_busy) = 1;
+        *(machine_control->usb_overruns) += 1;
         if (machine_control->usb_busy_s == 0) {
             // DP("usb_busy: begin\n");
             // store current traj-planning command
@@ -1437,6 +1470,8 @@ static void update_freq(void *arg, long period)
     // wou_status (&w_param); // print usb bandwidth utilization
     wou_update(&w_param);   // link to wou_recv()
 
+    sync_batch = 1;
+
     /* begin: sending debug pattern */
     if (test_pattern_type != NO_TEST) {
         write_machine_param(TEST_PATTERN, *(machine_control->test_pattern));
@@ -1755,7 +1790,16 @@ static void update_freq(void *arg, long period)
                 stepgen->pulse_accel = 0;
                 stepgen->pulse_jerk = 0;
             }
-            *stepgen->vel_cmd = ((*stepgen->pos_cmd) - (stepgen->prev_pos_cmd));
+            /* the move sent now ends a period from now, so with
+               feed-forward it aims at where pos_cmd will be then
+               instead of where it is now */
+            if (*stepgen->feed_forward) {
+                *stepgen->vel_cmd = ((*stepgen->pos_cmd)
+                        + (*stepgen->vel_ff + *stepgen->acc_ff * dt) * dt
+                        - (stepgen->prev_pos_cmd));
+            } else {
+                *stepgen->vel_cmd = ((*stepgen->pos_cmd) - (stepgen->prev_pos_cmd));
+            }
         } else {
             /* velocity command mode */
             /* NB: has to wire *pos_cmd-pin to velocity command input */
@@ -1895,6 +1939,10 @@ static void update_freq(void *arg, long period)
     memcpy(data, &sync_cmd, sizeof(uint16_t));
     wou_cmd(&w_param, WB_WR_CMD, (uint16_t) (JCMD_BASE | JCMD_SYNC_CMD), sizeof(uint16_t), data);
 
+    /* start sending the frame; what is left goes out by the next period */
+    sync_batch = 0;
+    wou_flush(&w_param);
+
 #if (TRACE!=0)
     stepgen = arg;
     if (*(stepgen->enable)) {
@@ -2016,6 +2064,23 @@ static int export_stepgen(int num, stepgen_t * addr,
         return retval;
     }
 
+    /* export pins for feed-forward in position mode */
+    retval = hal_pin_bit_newf(HAL_IN, &(addr->feed_forward), comp_id,
+            "wou.stepgen.%d.feed-forward", num);
+    if (retval != 0) {
+        return retval;
+    }
+    retval = hal_pin_float_newf(HAL_IN, &(addr->vel_ff), comp_id,
+            "wou.stepgen.%d.velocity-ff", num);
+    if (retval != 0) {
+        return retval;
+    }
+    retval = hal_pin_float_newf(HAL_IN, &(addr->acc_ff), comp_id,
+            "wou.stepgen.%d.acceleration-ff", num);
+    if (retval != 0) {
+        return retval;
+    }
+
     /* export pin for pos/vel command */
     retval = hal_pin_float_newf(HAL_OUT, &(addr->probed_pos), comp_id,
             "wou.stepgen.%d.probed-pos", num);
@@ -2131,6 +2196,9 @@ static int export_stepgen(int num, stepgen_t * addr,
     addr->freq = 0.0;
     addr->maxvel = 0.0;
     addr->maxaccel = 0.0;
+    *addr->feed_forward = 0;
+    *addr->vel_ff = 0.0;
+    *addr->acc_ff = 0.0;
     addr->pos_mode = pos_mode;
     addr->pos_cmd_s = 0;
     /* timing parameter defaults depend on step type */
@@ -2179,6 +2247,13 @@ static int export_machine_control(machine_control_t * machine_control)
         return retval;
     }
 
+    retval = hal_pin_u32_newf(HAL_OUT, &(machine_control->usb_overruns), comp_id,
+            "wou.usb-overruns");
+    if (retval != 0) {
+        return retval;
+    }
+    *(machine_control->usb_overruns) = 0;
+
     retval = hal_pin_bit_newf(HAL_OUT, &(machine_control->vel_sync), comp_id,
             "wou.motion.vel-sync");
     if (retval != 0) {
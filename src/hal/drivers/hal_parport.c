@@ -100,6 +100,7 @@
 #include "rtapi_app.h"		/* RTAPI realtime module decls */
 
 #include "hal.h"		/* HAL public API decls */
+#include "rtapi_string.h"
 
 /* If FASTIO is defined, uses outb() and inb() from <asm.io>,
    instead of rtapi_outb() and rtapi_inb() - the <asm.io> ones
@@ -153,6 +154,16 @@ typedef struct {
     unsigned char outdata_ctrl;
     unsigned char reset_mask_ctrl;  /* reset flag for pin 1, 14, 16, 17 */
     unsigned char reset_val_ctrl;   /* reset values for pin 1, 14, 16, 17 */
+    unsigned long long data_inv_word;	/* data_inv[], data_reset[], */
+    unsigned long long data_reset_word;	/* control_inv[] and */
+    unsigned int control_inv_word;	/* control_reset[] as they were */
+    unsigned int control_reset_word;	/* when the masks were built */
+    unsigned char data_inv_mask;	/* data_inv[] as a byte */
+    unsigned char control_inv_mask;	/* control_inv[] as a byte */
+    int hw_data;		/* last byte written to the data port, */
+    int hw_ctrl;		/* and to the control port, -1 if unknown */
+    hal_s32_t read_clocks;	/* CPU clocks spent in the last read */
+    hal_s32_t write_clocks;	/* and in the last write */
     struct hal_parport_t portdata;
 } parport_t;
 
@@ -179,6 +190,7 @@ static void reset_port(void *arg, long period);
 static void write_port(void *arg, long period);
 static void read_all(void *arg, long period);
 static void write_all(void *arg, long period);
+static void read_write_all(void *arg, long period);
 
 /* 'pins_and_params()' does most of the work involved in setting up
    the driver.  It parses the command line (argv[]), then if the
@@ -311,6 +323,14 @@ rtapi_print ( "config string '%s'\n", cfg );
 	hal_exit(comp_id);
 	return -1;
     }
+    retval = hal_export_funct("parport.read-write", read_write_all,
+	port_data_array, 0, 0, comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "PARPORT: ERROR: read write funct export failed\n");
+	hal_exit(comp_id);
+	return -1;
+    }
     rtapi_print_msg(RTAPI_MSG_INFO,
 	"PARPORT: installed driver for %d ports\n", num_ports);
     hal_ready(comp_id);
@@ -333,10 +353,12 @@ void rtapi_app_exit(void)
 static void read_port(void *arg, long period)
 {
     parport_t *port;
+    long long start;
     int b;
     unsigned char indata, mask;
 
     port = arg;
+    start = rtapi_get_clocks();
     /* read the status port */
     indata = rtapi_inb(port->base_addr + 1);
     /* invert bit 7 (pin 11) to compensate for hardware inverter */
@@ -371,6 +393,7 @@ static void read_port(void *arg, long period)
 	    mask <<= 1;
         }
     }
+    port->read_clocks = rtapi_get_clocks() - start;
 }
 
 static void reset_port(void *arg, long period) {
@@ -385,6 +408,7 @@ static void reset_port(void *arg, long period) {
         deadline = port->write_time + reset_time_tsc;
         while(rtapi_get_clocks() < deadline) {}
         rtapi_outb(outdata, port->base_addr);
+        port->hw_data = outdata;
     }
 
     outdata = (port->outdata_ctrl&~port->reset_mask_ctrl)^port->reset_val_ctrl;
@@ -395,42 +419,79 @@ static void reset_port(void *arg, long period) {
         deadline = port->write_time_ctrl + reset_time_tsc;
         while(rtapi_get_clocks() < deadline) {}
         rtapi_outb(outdata, port->base_addr + 2);
+        port->hw_ctrl = outdata;
     }
 }
 
-static void write_port(void *arg, long period)
+/* The -out-invert and -out-reset params are arrays of 0/1 bytes, so
+   those of a whole port can be read as one word and compared with the
+   word the masks were last built from.  The masks are rebuilt only
+   when a param has been changed. */
+static void update_masks(parport_t *port)
 {
-    parport_t *port;
+    unsigned long long inv, reset;
+    unsigned int cinv, creset;
     int b;
-    unsigned char outdata, mask;
 
-    port = arg;
+    memcpy(&inv, (const void *) port->data_inv, sizeof(inv));
+    memcpy(&reset, (const void *) port->data_reset, sizeof(reset));
+    if (inv != port->data_inv_word || reset != port->data_reset_word) {
+	port->data_inv_mask = 0;
+	port->reset_mask = 0;
+	for (b = 0; b < 8; b++) {
+	    port->data_inv_mask |= (port->data_inv[b] != 0) << b;
+	    port->reset_mask |= (port->data_reset[b] != 0) << b;
+	}
+	port->reset_val = port->data_inv_mask & port->reset_mask;
+	port->data_inv_word = inv;
+	port->data_reset_word = reset;
+    }
+    memcpy(&cinv, (const void *) port->control_inv, sizeof(cinv));
+    memcpy(&creset, (const void *) port->control_reset, sizeof(creset));
+    if (cinv != port->control_inv_word || creset != port->control_reset_word) {
+	port->control_inv_mask = 0;
+	port->reset_mask_ctrl = 0;
+	for (b = 0; b < 4; b++) {
+	    port->control_inv_mask |= (port->control_inv[b] != 0) << b;
+	    port->reset_mask_ctrl |= (port->control_reset[b] != 0) << b;
+	}
+	port->reset_val_ctrl = port->control_inv_mask & port->reset_mask_ctrl;
+	port->control_inv_word = cinv;
+	port->control_reset_word = creset;
+    }
+}
+
+/* assemble an output byte from the first 'n' pins, without branches */
+static inline unsigned char pack_pins(hal_bit_t **pins, int n)
+{
+    unsigned char outdata = 0;
+    int b;
+
+    for (b = 0; b < n; b++) {
+	outdata |= (*(pins[b]) != 0) << b;
+    }
+    return outdata;
+}
+
+/* build both output bytes and write them; if 'skip' is set, a byte
+   that the hardware already holds is not written again */
+static void write_port_bytes(parport_t *port, int skip)
+{
+    long long start;
+    unsigned char outdata;
+
+    start = rtapi_get_clocks();
+    update_masks(port);
     /* are we using the data port for output? */
     if (port->data_dir == 0) {
-	int reset_mask=0, reset_val=0;
 	/* yes */
-	outdata = 0x00;
-	mask = 0x01;
-	/* assemble output byte for data port from 8 source variables */
-	for (b = 0; b < 8; b++) {
-	    /* get the data, add to output byte */
-	    if ((*(port->data_out[b])) && (!port->data_inv[b])) {
-		outdata |= mask;
-	    }
-	    if ((!*(port->data_out[b])) && (port->data_inv[b])) {
-		outdata |= mask;
-	    }
-	    if (port->data_reset[b]) {
-		reset_mask |= mask;
-		if(port->data_inv[b]) reset_val |= mask;
-	    }
-	    mask <<= 1;
-	}
+	outdata = pack_pins(port->data_out, 8) ^ port->data_inv_mask;
 	/* write it to the hardware */
-	rtapi_outb(outdata, port->base_addr);
+	if (!skip || outdata != port->hw_data) {
+	    rtapi_outb(outdata, port->base_addr);
+	    port->hw_data = outdata;
+	}
 	port->write_time = rtapi_get_clocks();
-	port->reset_val = reset_val;
-	port->reset_mask = reset_mask;
 	port->outdata = outdata;
 	/* prepare to build control port byte, with direction bit clear */
 	outdata = 0x00;
@@ -443,32 +504,24 @@ static void write_port(void *arg, long period)
 	/* yes, force those pins high */
 	outdata |= 0x0F;
     } else {
-	int reset_mask=0, reset_val=0;
 	/* no, assemble output byte from 4 source variables */
-	mask = 0x01;
-	for (b = 0; b < 4; b++) {
-	    /* get the data, add to output byte */
-	    if ((*(port->control_out[b])) && (!port->control_inv[b])) {
-		outdata |= mask;
-	    }
-	    if ((!*(port->control_out[b])) && (port->control_inv[b])) {
-		outdata |= mask;
-	    }
-	    if (port->control_reset[b]) {
-		reset_mask |= mask;
-		if(port->control_inv[b]) reset_val |= mask;
-	    }
-	    mask <<= 1;
-	}
-        port->reset_mask_ctrl = reset_mask;
-        port->reset_val_ctrl = reset_val;
+	outdata |= pack_pins(port->control_out, 4) ^ port->control_inv_mask;
 	port->outdata_ctrl = outdata;
     }
     /* correct for hardware inverters on pins 1, 14, & 17 */
     outdata ^= 0x0B;
     /* write it to the hardware */
-    rtapi_outb(outdata, port->base_addr + 2);
+    if (!skip || outdata != port->hw_ctrl) {
+	rtapi_outb(outdata, port->base_addr + 2);
+	port->hw_ctrl = outdata;
+    }
     port->write_time_ctrl = rtapi_get_clocks();
+    port->write_clocks = port->write_time_ctrl - start;
+}
+
+static void write_port(void *arg, long period)
+{
+    write_port_bytes(arg, 0);
 }
 
 void read_all(void *arg, long period)
@@ -491,6 +544,19 @@ void write_all(void *arg, long period)
     }
 }
 
+/* reads and writes all ports in one pass, leaving out the writes of
+   bytes that have not changed since they were last written */
+void read_write_all(void *arg, long period)
+{
+    parport_t *port;
+    int n;
+    port = arg;
+    for (n = 0; n < num_ports; n++) {
+	read_port(&(port[n]), period);
+	write_port_bytes(&(port[n]), 1);
+    }
+}
+
 /***********************************************************************
 *                   LOCAL FUNCTION DEFINITIONS                         *
 ************************************************************************/
@@ -645,6 +711,11 @@ static int export_port(int portnum, parport_t * port)
     rtapi_set_msg_level(RTAPI_MSG_WARN);
 
     retval = 0;
+    /* force the masks to be built and both bytes to be written */
+    port->data_inv_word = ~0ull;
+    port->control_inv_word = ~0u;
+    port->hw_data = -1;
+    port->hw_ctrl = -1;
     /* declare input pins (status port) */
     retval += export_input_pin(portnum, 15, port->status_in, 0);
     retval += export_input_pin(portnum, 13, port->status_in, 1);
@@ -705,6 +776,11 @@ static int export_port(int portnum, parport_t * port)
         retval += export_input_pin(portnum, 17, port->control_in, 3);
     }
 
+    retval += hal_param_s32_newf(HAL_RO, &port->read_clocks, comp_id,
+	    "parport.%d.read-time", portnum);
+    retval += hal_param_s32_newf(HAL_RO, &port->write_clocks, comp_id,
+	    "parport.%d.write-time", portnum);
+
     /* restore saved message level */
     rtapi_set_msg_level(msg);
     return retval;
@@ -329,6 +329,18 @@ typedef struct slot_data_s {
   unsigned int use_timestamp;   /* indicates whether to use timestamp encoder feature */
 } slot_data_t;
 
+/* a run of registers in one slot that are read or written in one
+   autoincrementing burst */
+
+typedef struct {
+    slot_data_t *slot;		/* slot the registers are in */
+    unsigned char start;	/* first register, from slot_base */
+    unsigned char len;		/* number of registers */
+} epp_run_t;
+
+/* a 32 bit bitmap has at most 16 separate runs */
+#define MAX_RUNS (NUM_SLOTS * 16)
+
 /* this structure contains the runtime data for a complete EPP bus */
 
 typedef struct {
@@ -345,6 +357,10 @@ typedef struct {
 //    unsigned int last_extradout;/* used for numbering digital outputs */
     char slot_valid[NUM_SLOTS];	/* tags for slots that are used */
     slot_data_t slot_data[NUM_SLOTS];  /* data for slots on EPP bus */
+    int num_rd_runs;		/* the bursts read_all does, all slots */
+    epp_run_t rd_runs[MAX_RUNS];
+    int num_wr_runs;		/* the bursts write_all does, all slots */
+    epp_run_t wr_runs[MAX_RUNS];
 } bus_data_t;
 
 
@@ -383,6 +399,8 @@ static unsigned short SelRead(unsigned char epp_addr, unsigned int port_addr);
 static unsigned short ReadMore(unsigned int port_addr);
 static void SelWrt(unsigned char byte, unsigned char epp_addr, unsigned int port_addr);
 static void WrtMore(unsigned char byte, unsigned int port_addr);
+static void ReadBurst(unsigned char *buf, int len, unsigned char epp_addr, unsigned int port_addr);
+static void WrtBurst(unsigned char *buf, int len, unsigned char epp_addr, unsigned int port_addr);
 
 
 /***********************************************************************
@@ -390,6 +408,7 @@ static void WrtMore(unsigned char byte, unsigned int port_addr);
 ************************************************************************/
 
 static __u32 block(int min, int max);
+static int build_runs(bus_data_t *bus, epp_run_t *runs, int rd);
 static int add_rd_funct(slot_funct_t *funct, slot_data_t *slot, __u32 cache_bitmap );
 static int add_wr_funct(slot_funct_t *funct, slot_data_t *slot, __u32 cache_bitmap );
 
@@ -673,6 +692,12 @@ int rtapi_app_main(void)
 	    /* skip to next bus */
 	    continue;
 	}
+	/* turn the slots' cache bitmaps into the bursts done each period */
+	bus->num_rd_runs = build_runs(bus, bus->rd_runs, 1);
+	bus->num_wr_runs = build_runs(bus, bus->wr_runs, 0);
+	rtapi_print_msg(RTAPI_MSG_INFO,
+	    "PPMC: bus %d: %d read and %d write bursts per period\n",
+	    busnum, bus->num_rd_runs, bus->num_wr_runs);
 	/* export functions */
 	rtapi_snprintf(buf, sizeof(buf), "ppmc.%d.read", busnum);
 	rv1 = hal_export_funct(buf, read_all, &(bus_array[busnum]),
@@ -769,9 +794,8 @@ static void read_all(void *arg, long period)
 {
     bus_data_t *bus;
     slot_data_t *slot;
-    int slotnum, functnum, addr_ok;
-    unsigned char n, eppaddr;
-    __u32 bitmap;
+    epp_run_t *run;
+    int slotnum, functnum, n;
 
     read_period = period;          /* make thread period available to called functions */
     /* get pointer to bus data structure */
@@ -780,48 +804,35 @@ static void read_all(void *arg, long period)
     if ( bus == NULL ) {
 	return;
     }
+    /* We only need to send a latch strobe on the master encoder */
+    for ( slotnum = 0 ; slotnum < NUM_SLOTS ; slotnum++ ) {
+	slot = &(bus->slot_data[slotnum]);
+	if ( bus->slot_valid[slotnum] && ( slot->strobe == 1 ) ) {
+	    /* set the strobe bit, slave mode */
+	    SelWrt(0x20, slot->slot_base + ENCRATE, slot->port_addr);
+	    /* repeat to guarantee at least 2uS */
+	    SelWrt(0x20, slot->slot_base + ENCRATE, slot->port_addr);
+	    /* end of strobe pulse, stay in slave mode */
+	    SelWrt(0x00, slot->slot_base + ENCRATE, slot->port_addr);
+	}
+    }
+    /* fetch data from EPP to the slots' caches, one burst per run of
+       registers, checking for a bus timeout once for all of them */
+    if ( bus->num_rd_runs > 0 ) {
+	ClrTimeout(bus->rd_runs[0].slot->port_addr);
+    }
+    for ( n = 0 ; n < bus->num_rd_runs ; n++ ) {
+	run = &(bus->rd_runs[n]);
+	slot = run->slot;
+	ReadBurst(&(slot->rd_buf[run->start]), run->len,
+	    slot->slot_base + run->start, slot->port_addr);
+    }
     /* loop thru all slots */
     for ( slotnum = 0 ; slotnum < NUM_SLOTS ; slotnum++ ) {
 	/* check for anthing in slot */
 	if ( bus->slot_valid[slotnum] ) {
 	    /* point at slot data */
 	    slot = &(bus->slot_data[slotnum]);
-	    /* We only need to send a latch strobe on the master encoder */
-	    if ( slot->strobe == 1 ) {
-	      /* set the strobe bit, slave mode */
-	      SelWrt(0x20, slot->slot_base + ENCRATE, slot->port_addr);
-	      /* repeat to guarantee at least 2uS */
-	      SelWrt(0x20, slot->slot_base + ENCRATE, slot->port_addr);
-	      /* end of strobe pulse, stay in slave mode */
-	      SelWrt(0x00, slot->slot_base + ENCRATE, slot->port_addr);
-	    }
-	    /* fetch data from EPP to cache */
-	    addr_ok = 0;
-	    bitmap = slot->read_bitmap;
-	    n = 0;
-	    while ( bitmap ) {
-		if ( bitmap & 1 ) {
-		    /* need to read register 'n' */
-		    if ( addr_ok ) {
-			/* auto-increment address is usable */
-			slot->rd_buf[n] = ReadMore(slot->port_addr);
-		    } else {
-			/* need to specify address */
-			eppaddr = slot->slot_base + n;
-			/* send address and read byte */
-			slot->rd_buf[n] = SelRead(eppaddr, slot->port_addr);
-			/* mark auto-incrementing address as valid */
-			addr_ok = 1;
-		    }
-		} else {
-		    /* don't need to read this register */
-		    /* mark auto-incrementing address as invalid */
-		    addr_ok = 0;
-		}
-		/* next register */
-		n++;
-		bitmap >>= 1;
-	    }
 	    /* loop thru all functions associated with slot */
 	    for ( functnum = 0 ; functnum < slot->num_rd_functs ; functnum++ ) {
 		/* call function */
@@ -835,9 +846,8 @@ static void write_all(void *arg, long period)
 {
     bus_data_t *bus;
     slot_data_t *slot;
-    int slotnum, functnum, addr_ok;
-    unsigned char n, eppaddr;
-    __u32 bitmap;
+    epp_run_t *run;
+    int slotnum, functnum, n;
 
     /* get pointer to bus data structure */
     bus = *(bus_data_t **)(arg);
@@ -856,35 +866,18 @@ static void write_all(void *arg, long period)
 		/* call function */
 		(slot->wr_functs[functnum])(slot);
 	    }
-	    /* write data from cache to EPP */
-	    addr_ok = 0;
-	    bitmap = slot->write_bitmap;
-	    n = 0;
-	    while ( bitmap ) {
-		if ( bitmap & 1 ) {
-		    /* need to write data register 'n' */
-		    if ( addr_ok ) {
-			/* auto-increment address is usable */
-			WrtMore(slot->wr_buf[n], slot->port_addr);
-		    } else {
-			/* need to specify address */
-			eppaddr = slot->slot_base + n;
-			/* send address and write byte */
-			SelWrt(slot->wr_buf[n], eppaddr, slot->port_addr);
-			/* mark auto-incrementing address as valid */
-			addr_ok = 1;
-		    }
-		} else {
-		    /* don't need to write this one */
-		    /* mark auto-incrementing address as invalid */
-		    addr_ok = 0;
-		}
-		/* next register */
-		n++;
-		bitmap >>= 1;
-	    }
 	}
     }
+    /* write data from the slots' caches to EPP, one burst per run */
+    if ( bus->num_wr_runs > 0 ) {
+	ClrTimeout(bus->wr_runs[0].slot->port_addr);
+    }
+    for ( n = 0 ; n < bus->num_wr_runs ; n++ ) {
+	run = &(bus->wr_runs[n]);
+	slot = run->slot;
+	WrtBurst(&(slot->wr_buf[run->start]), run->len,
+	    slot->slot_base + run->start, slot->port_addr);
+    }
 }
 
 static void read_digins(slot_data_t *slot)
@@ -1593,6 +1586,44 @@ static __u32 block(int min, int max)
     return mask;
 }
 
+/* this function splits the read (rd != 0) or write cache bitmaps of
+   all the bus's slots into runs of contiguous registers, one EPP burst
+   each, in slot order.  Registers that aren't in the bitmap are not
+   bridged, reading or writing them might have side effects.  Returns
+   the number of runs.
+*/
+
+static int build_runs(bus_data_t *bus, epp_run_t *runs, int rd)
+{
+    slot_data_t *slot;
+    int slotnum, n, num_runs;
+    __u32 bitmap;
+
+    num_runs = 0;
+    for ( slotnum = 0 ; slotnum < NUM_SLOTS ; slotnum++ ) {
+	if ( !bus->slot_valid[slotnum] ) {
+	    continue;
+	}
+	slot = &(bus->slot_data[slotnum]);
+	bitmap = rd ? slot->read_bitmap : slot->write_bitmap;
+	for ( n = 0 ; n < 32 ; n++ ) {
+	    if ( !( bitmap & ( 1 << n ) ) ) {
+		continue;
+	    }
+	    if ( n > 0 && ( bitmap & ( 1 << ( n - 1 ) ) ) ) {
+		/* continues the previous run */
+		runs[num_runs - 1].len++;
+	    } else {
+		runs[num_runs].slot = slot;
+		runs[num_runs].start = n;
+		runs[num_runs].len = 1;
+		num_runs++;
+	    }
+	}
+    }
+    return num_runs;
+}
+
 /* these functions are used to register a runtime function to be called
    by either read_all or write_all.  'cache_bitmap' defines the EPP
    addresses that the function needs.  All addresses needed by all 
@@ -2354,3 +2385,34 @@ static void WrtMore(unsigned char byte, unsigned int port_addr)
     return;
 }
 
+/* like SelRead followed by ReadMore, for 'len' bytes, but without
+   checking for a timeout first, the caller does that once for all
+   the bursts in a period */
+static void ReadBurst(unsigned char *buf, int len, unsigned char epp_addr, unsigned int port_addr)
+{
+    /* set port direction to output */
+    rtapi_outb(0x04,CONTROLPORT(port_addr));
+    /* write epp address to port */
+    rtapi_outb(epp_addr,ADDRPORT(port_addr));
+    /* set port direction to input */
+    rtapi_outb(0x24,CONTROLPORT(port_addr));
+    /* read data values */
+    while ( len-- > 0 ) {
+	*(buf++) = rtapi_inb(DATAPORT(port_addr));
+    }
+}
+
+/* like SelWrt followed by WrtMore, for 'len' bytes, but without
+   checking for a timeout first */
+static void WrtBurst(unsigned char *buf, int len, unsigned char epp_addr, unsigned int port_addr)
+{
+    /* set port direction to output */
+    rtapi_outb(0x04,CONTROLPORT(port_addr));
+    /* write epp address to port */
+    rtapi_outb(epp_addr,ADDRPORT(port_addr));
+    /* write data to port */
+    while ( len-- > 0 ) {
+	rtapi_outb(*(buf++),DATAPORT(port_addr));
+    }
+}
+
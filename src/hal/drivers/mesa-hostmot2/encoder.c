@@ -347,6 +347,13 @@ int hm2_encoder_parse_md(hostmot2_t *hm2, int md_index) {
                 goto fail1;
             }
 
+            rtapi_snprintf(name, sizeof(name), "%s.encoder.%02d.position-interpolated", hm2->llio->name, i);
+            r = hal_pin_float_new(name, HAL_OUT, &(hm2->encoder.instance[i].hal.pin.position_interpolated), hm2->llio->comp_id);
+            if (r < 0) {
+                HM2_ERR("error adding pin '%s', aborting\n", name);
+                goto fail1;
+            }
+
             rtapi_snprintf(name, sizeof(name), "%s.encoder.%02d.velocity", hm2->llio->name, i);
             r = hal_pin_float_new(name, HAL_OUT, &(hm2->encoder.instance[i].hal.pin.velocity), hm2->llio->comp_id);
             if (r < 0) {
@@ -439,6 +446,13 @@ int hm2_encoder_parse_md(hostmot2_t *hm2, int md_index) {
                 goto fail1;
             }
 
+            rtapi_snprintf(name, sizeof(name), "%s.encoder.%02d.interpolate-time", hm2->llio->name, i);
+            r = hal_param_float_new(name, HAL_RW, &(hm2->encoder.instance[i].hal.param.interpolate_time), hm2->llio->comp_id);
+            if (r < 0) {
+                HM2_ERR("error adding param '%s', aborting\n", name);
+                goto fail1;
+            }
+
 
             //
             // init the hal objects that need it
@@ -455,6 +469,7 @@ int hm2_encoder_parse_md(hostmot2_t *hm2, int md_index) {
             hm2->encoder.instance[i].hal.param.counter_mode = 0;
             hm2->encoder.instance[i].hal.param.filter = 1;
             hm2->encoder.instance[i].hal.param.vel_timeout = 0.5;
+            hm2->encoder.instance[i].hal.param.interpolate_time = 0.0;
 
             hm2->encoder.instance[i].state = HM2_ENCODER_STOPPED;
 
@@ -538,6 +553,7 @@ void hm2_encoder_tram_init(hostmot2_t *hm2) {
         *hm2->encoder.instance[i].hal.pin.count_latch = 0;
         *hm2->encoder.instance[i].hal.pin.position = 0.0;
         *hm2->encoder.instance[i].hal.pin.position_latch = 0.0;
+        *hm2->encoder.instance[i].hal.pin.position_interpolated = 0.0;
         *hm2->encoder.instance[i].hal.pin.velocity = 0.0;
         *hm2->encoder.instance[i].hal.pin.quadrature_error = 0;
 
@@ -723,6 +739,60 @@ static void hm2_encoder_instance_update_position(hostmot2_t *hm2, int instance)
 
 
 
+/**
+ * @brief Extrapolates the encoder's position to the time it is used.
+ *
+ * Sets hal.pin.position_interpolated.
+ *
+ * This function expects hm2_encoder_instance_process_tram_read() to have
+ * just run, so that the velocity, the last edge and its timestamp are
+ * up-to-date.
+ *
+ * While moving, the position is that of the last edge, moved on at the
+ * estimated velocity for the time from the edge to the TRAM read, and
+ * then for .interpolate_time more (the time from the read to when the
+ * servo thread's output takes effect).  Up to the read the encoder
+ * can't have gone a whole count past the edge, or the FPGA would have
+ * seen the next one, so that part is held to less than a count.
+ *
+ * @param hm2 The hostmot2 structure being worked on.
+ *
+ * @param instance The index of the encoder instance.
+ */
+
+static void hm2_encoder_instance_update_interpolated(hostmot2_t *hm2, int instance) {
+    hm2_encoder_instance_t *e;
+    s32 dT_clocks;
+    double dS_max;
+    double dS;
+
+    e = &hm2->encoder.instance[instance];
+
+    if (e->state != HM2_ENCODER_MOVING) {
+        *e->hal.pin.position_interpolated = *e->hal.pin.position;
+        return;
+    }
+
+    dT_clocks = ((s32)hm2_encoder_get_reg_tsc(hm2) - (s32)e->prev_event_reg_timestamp) + (e->tsc_num_rollovers << 16);
+    if (dT_clocks < 0) {
+        // the tsc rolled over between the edge and the read
+        dT_clocks += 65536;
+    }
+
+    dS = *e->hal.pin.velocity * (double)dT_clocks * hm2->encoder.seconds_per_tsdiv_clock;
+    dS_max = 1.0 / fabs(e->hal.param.scale);
+    if (dS > dS_max) dS = dS_max;
+    if (dS < -dS_max) dS = -dS_max;
+
+    *e->hal.pin.position_interpolated =
+        (e->prev_event_rawcounts - e->zero_offset) / e->hal.param.scale
+        + dS
+        + *e->hal.pin.velocity * e->hal.param.interpolate_time;
+}
+
+
+
+
 /**
  * @brief Processes the information received from the QuadratureCounter
  *     (encoder) instance to produce an estimate of position & velocity.
@@ -937,6 +1007,7 @@ void hm2_encoder_process_tram_read(hostmot2_t *hm2, long l_period_ns) {
     // process each encoder instance independently
     for (i = 0; i < hm2->encoder.num_instances; i ++) {
         hm2_encoder_instance_process_tram_read(hm2, i);
+        hm2_encoder_instance_update_interpolated(hm2, i);
     }
 }
 
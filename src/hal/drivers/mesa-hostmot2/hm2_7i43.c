@@ -134,6 +134,30 @@ static inline void hm2_7i43_epp_write32(uint32_t w, hm2_7i43_t *board) {
     }
 }
 
+// A burst of data cycles at the selected (autoincrementing) address,
+// done as string I/O.  EPP data bytes arrive in the order they sit in
+// memory, so in narrow mode the whole burst is a byte string, and in
+// wide mode it is 32-bit words and then any odd bytes.
+static inline void hm2_7i43_epp_read_burst(void *buffer, int size, hm2_7i43_t *board) {
+    int words = 0;
+
+    if (board->epp_wide) {
+        words = size / 4;
+        insl(board->port.base + HM2_7I43_EPP_DATA_OFFSET, buffer, words);
+    }
+    insb(board->port.base + HM2_7I43_EPP_DATA_OFFSET, (u8*)buffer + 4 * words, size - 4 * words);
+}
+
+static inline void hm2_7i43_epp_write_burst(void *buffer, int size, hm2_7i43_t *board) {
+    int words = 0;
+
+    if (board->epp_wide) {
+        words = size / 4;
+        outsl(board->port.base + HM2_7I43_EPP_DATA_OFFSET, buffer, words);
+    }
+    outsb(board->port.base + HM2_7I43_EPP_DATA_OFFSET, (u8*)buffer + 4 * words, size - 4 * words);
+}
+
 static inline uint8_t hm2_7i43_epp_read_status(hm2_7i43_t *board) {
     uint8_t val;
     val = inb(board->port.base + HM2_7I43_EPP_STATUS_OFFSET);
@@ -211,6 +235,11 @@ int hm2_7i43_read(hm2_lowlevel_io_t *this, u32 addr, void *buffer, int size) {
 
     hm2_7i43_epp_addr16(addr | HM2_7I43_ADDR_AUTOINCREMENT, board);
 
+    if (!debug_epp) {
+        hm2_7i43_epp_read_burst(buffer, size, board);
+        bytes_remaining = 0;
+    }
+
     for (; bytes_remaining > 3; bytes_remaining -= 4) {
         *((u32*)buffer) = hm2_7i43_epp_read32(board);
         buffer += 4;
@@ -241,6 +270,11 @@ int hm2_7i43_write(hm2_lowlevel_io_t *this, u32 addr, void *buffer, int size) {
 
     hm2_7i43_epp_addr16(addr | HM2_7I43_ADDR_AUTOINCREMENT, board);
 
+    if (!debug_epp) {
+        hm2_7i43_epp_write_burst(buffer, size, board);
+        bytes_remaining = 0;
+    }
+
     for (; bytes_remaining > 3; bytes_remaining -= 4) {
         hm2_7i43_epp_write32(*((u32*)buffer), board);
         buffer += 4;
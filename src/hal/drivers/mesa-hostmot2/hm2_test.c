@@ -24,6 +24,15 @@
 //  special hardware plugged in.  Its job is to provide a test-pattern to
 //  verify that the hostmot2 driver functions as it ought.
 //
+//  Test pattern 15 is a whole synthetic board, with a watchdog, four
+//  IOPorts and 'encoders' encoders and 'stepgens' stepgens, for timing
+//  the hostmot2 read and write functions without hardware.  Writes go
+//  into the register file, so the registers read back like a board's.
+//  Each access can be made to take as long as it would on a PCI, EPP
+//  or USB bus ('bus'), and the time spent in the llio is added up by
+//  module, for the hm2_test.0.bench function to put on pins each
+//  period.
+//
 
 
 #include <linux/pci.h>
@@ -53,12 +62,49 @@ MODULE_PARM_DESC(config, "config string for the AnyIO boards (see hostmot2(9) ma
 int test_pattern = 0;
 RTAPI_MP_INT(test_pattern, "The test pattern to show to the hostmot2 driver.");
 
+static char *bus = "none";
+RTAPI_MP_STRING(bus, "Bus whose access times to emulate: none, pci, epp or usb.");
+
+static long read_ns = -1;
+RTAPI_MP_LONG(read_ns, "ns per read transaction, overrides the bus figure");
+static long read_word_ns = -1;
+RTAPI_MP_LONG(read_word_ns, "ns per 32-bit word read, overrides the bus figure");
+static long write_ns = -1;
+RTAPI_MP_LONG(write_ns, "ns per write transaction, overrides the bus figure");
+static long write_word_ns = -1;
+RTAPI_MP_LONG(write_word_ns, "ns per 32-bit word written, overrides the bus figure");
+
+static int encoders = 4;
+RTAPI_MP_INT(encoders, "Encoder instances on the synthetic board (test pattern 15).");
+static int stepgens = 4;
+RTAPI_MP_INT(stepgens, "Stepgen instances on the synthetic board (test pattern 15).");
+
 
 static int comp_id;
 
 static hm2_test_t board[1];
 
 
+//
+// Rough figures: PCI reads wait for the target, writes are posted; EPP
+// sets the address and then moves a byte per bus cycle; USB waits for
+// a (micro)frame per round trip, but writes don't wait for an answer.
+//
+
+static const hm2_test_bus_t hm2_test_buses[] = {
+    { "none",      0,    0,     0,    0 },
+    { "pci",       0,  600,     0,   60 },
+    { "epp",    2000, 4000,  2000, 4000 },
+    { "usb",  125000,   20, 20000,   20 },
+    { NULL,        0,    0,     0,    0 }
+};
+
+
+static const char *hm2_test_module_name[HM2_TEST_NUM_MODULES] = {
+    "other", "watchdog", "ioport", "encoder", "stepgen"
+};
+
+
 
 
 // 
@@ -66,14 +112,55 @@ static hm2_test_t board[1];
 //
 
 
+// spin until 'cost' ns after 'start', and charge the time to the module
+static void hm2_test_account(hm2_test_t *me, u32 addr, long long start, long cost, int is_write) {
+    hm2_test_count_t *count = &me->count[me->page_module[(addr >> 8) & 0xff]];
+    long long now;
+
+    do {
+        now = rtapi_get_time();
+    } while (now - start < cost);
+
+    count->ns += now - start;
+    if (is_write) {
+        count->writes ++;
+    } else {
+        count->reads ++;
+    }
+}
+
+
 static int hm2_test_read(hm2_lowlevel_io_t *this, u32 addr, void *buffer, int size) {
     hm2_test_t *me = this->private;
+    long long start = rtapi_get_time();
+
+    if (addr + size > sizeof(me->test_pattern)) {
+        THIS_ERR("read of %d bytes at 0x%04x is past the register file\n", size, addr);
+        *this->io_error = 1;
+        this->needs_reset = 1;
+        return 0;
+    }
     memcpy(buffer, (me->test_pattern + addr), size);
+    hm2_test_account(me, addr, start, me->bus.read_ns + me->bus.read_word_ns * ((size + 3) / 4), 0);
     return 1;  // success
 }
 
 
 static int hm2_test_write(hm2_lowlevel_io_t *this, u32 addr, void *buffer, int size) {
+    hm2_test_t *me = this->private;
+    long long start;
+
+    if (test_pattern != 15) return 1;  // the IDROM patterns stay as they are
+
+    start = rtapi_get_time();
+    if (addr + size > sizeof(me->test_pattern)) {
+        THIS_ERR("write of %d bytes at 0x%04x is past the register file\n", size, addr);
+        *this->io_error = 1;
+        this->needs_reset = 1;
+        return 0;
+    }
+    memcpy((me->test_pattern + addr), buffer, size);
+    hm2_test_account(me, addr, start, me->bus.write_ns + me->bus.write_word_ns * ((size + 3) / 4), 1);
     return 1;  // success
 }
 
@@ -90,6 +177,217 @@ static int hm2_test_reset(hm2_lowlevel_io_t *this) {
 
 
 
+//
+// Puts the llio time since its last run on the bench pins.  Add it to
+// the thread after the hostmot2 read and write functions.
+//
+
+static void hm2_test_bench(void *arg, long period) {
+    hm2_test_t *me = arg;
+    hm2_test_bench_t *b = me->bench;
+    int i;
+
+    if (*b->reset) {
+        *b->samples = 0;
+        for (i = 0; i < HM2_TEST_NUM_MODULES; i ++) {
+            b->module[i].ns_sum = 0.0;
+        }
+    }
+
+    (*b->samples) ++;
+    for (i = 0; i < HM2_TEST_NUM_MODULES; i ++) {
+        hm2_test_module_pins_t *m = &b->module[i];
+        hm2_test_count_t *count = &me->count[i];
+
+        *m->ns = count->ns;
+        *m->reads = count->reads;
+        *m->writes = count->writes;
+        m->ns_sum += count->ns;
+        *m->ns_avg = m->ns_sum / *b->samples;
+
+        count->ns = 0;
+        count->reads = 0;
+        count->writes = 0;
+    }
+}
+
+
+static int hm2_test_export_bench(hm2_test_t *me) {
+    hm2_test_bench_t *b;
+    int i, r;
+
+    b = hal_malloc(sizeof(hm2_test_bench_t));
+    if (b == NULL) {
+        LL_ERR("out of memory for the bench pins\n");
+        return -ENOMEM;
+    }
+    me->bench = b;
+
+    r = hal_pin_bit_newf(HAL_IN, &b->reset, comp_id, "%s.bench.reset", me->llio.name);
+    if (r != 0) return r;
+    r = hal_pin_u32_newf(HAL_OUT, &b->samples, comp_id, "%s.bench.samples", me->llio.name);
+    if (r != 0) return r;
+    *b->reset = 0;
+    *b->samples = 0;
+
+    for (i = 0; i < HM2_TEST_NUM_MODULES; i ++) {
+        hm2_test_module_pins_t *m = &b->module[i];
+        const char *name = hm2_test_module_name[i];
+
+        r = hal_pin_float_newf(HAL_OUT, &m->ns, comp_id, "%s.bench.%s.ns", me->llio.name, name);
+        if (r != 0) return r;
+        r = hal_pin_float_newf(HAL_OUT, &m->ns_avg, comp_id, "%s.bench.%s.ns-avg", me->llio.name, name);
+        if (r != 0) return r;
+        r = hal_pin_u32_newf(HAL_OUT, &m->reads, comp_id, "%s.bench.%s.reads", me->llio.name, name);
+        if (r != 0) return r;
+        r = hal_pin_u32_newf(HAL_OUT, &m->writes, comp_id, "%s.bench.%s.writes", me->llio.name, name);
+        if (r != 0) return r;
+        *m->ns = 0.0;
+        *m->ns_avg = 0.0;
+        *m->reads = 0;
+        *m->writes = 0;
+        m->ns_sum = 0.0;
+    }
+
+    {
+        char name[HAL_NAME_LEN + 1];
+
+        rtapi_snprintf(name, sizeof(name), "%s.bench", me->llio.name);
+        r = hal_export_funct(name, hm2_test_bench, me, 1, 0, comp_id);
+        if (r != 0) return r;
+    }
+
+    return 0;
+}
+
+
+static int hm2_test_set_bus(hm2_test_t *me) {
+    const hm2_test_bus_t *b;
+
+    for (b = hm2_test_buses; b->name != NULL; b ++) {
+        if (strcmp(b->name, bus) == 0) break;
+    }
+    if (b->name == NULL) {
+        LL_ERR("unknown bus '%s', expected none, pci, epp or usb\n", bus);
+        return -EINVAL;
+    }
+
+    me->bus = *b;
+    if (read_ns >= 0) me->bus.read_ns = read_ns;
+    if (read_word_ns >= 0) me->bus.read_word_ns = read_word_ns;
+    if (write_ns >= 0) me->bus.write_ns = write_ns;
+    if (write_word_ns >= 0) me->bus.write_word_ns = write_word_ns;
+
+    return 0;
+}
+
+
+
+
+//
+// the synthetic board of test pattern 15
+//
+
+#define HM2_TEST_CONNECTORS (4)
+
+static void hm2_test_set_u32(hm2_test_t *me, u32 addr, u32 value) {
+    *((u32*)&me->test_pattern[addr]) = value;
+}
+
+
+// a Module Descriptor, and which register pages it answers on
+static void hm2_test_add_md(hm2_test_t *me, int md_index, int module, u8 gtag, u8 version, u8 instances, u16 base, u8 num_registers, u32 multiple_registers) {
+    u32 addr = 0x440 + (md_index * 12);
+    int page;
+
+    // clock tag 1 (ClockLow), register stride 0, instance stride 0
+    hm2_test_set_u32(me, addr + 0, gtag | (version << 8) | (1 << 16) | (instances << 24));
+    hm2_test_set_u32(me, addr + 4, base | (num_registers << 16));
+    hm2_test_set_u32(me, addr + 8, multiple_registers);
+
+    for (page = 0; page < num_registers; page ++) {
+        me->page_module[((base >> 8) + page) & 0xff] = module;
+    }
+}
+
+
+// the Pin Descriptor of the next free pin
+static void hm2_test_add_pd(hm2_test_t *me, int *pin, u8 sec_pin, u8 sec_tag, u8 sec_unit) {
+    u32 addr = 0x600 + (*pin * 4);
+
+    me->test_pattern[addr + 0] = sec_pin;
+    me->test_pattern[addr + 1] = sec_tag;
+    me->test_pattern[addr + 2] = sec_unit;
+    me->test_pattern[addr + 3] = HM2_GTAG_IOPORT;
+    (*pin) ++;
+}
+
+
+static int hm2_test_synthetic_board(hm2_test_t *me) {
+    int num_pins = HM2_TEST_CONNECTORS * 24;
+    int md_index = 0;
+    int pin = 0;
+    int i;
+
+    if ((encoders < 0) || (stepgens < 0) || ((encoders * 3) + (stepgens * 2) > num_pins)) {
+        LL_ERR("%d encoders and %d stepgens don't fit on %d pins\n", encoders, stepgens, num_pins);
+        return -EINVAL;
+    }
+
+    hm2_test_set_u32(me, HM2_ADDR_IOCOOKIE, HM2_IOCOOKIE);
+    memcpy(&me->test_pattern[HM2_ADDR_CONFIGNAME], "HOSTMOT2", 8);
+    hm2_test_set_u32(me, HM2_ADDR_IDROM_OFFSET, 0x400);
+
+    hm2_test_set_u32(me, 0x400, 2);          // standard idrom type
+    hm2_test_set_u32(me, 0x404, 0x40);       // Module Descriptors at 0x440
+    hm2_test_set_u32(me, 0x408, 0x200);      // Pin Descriptors at 0x600
+    memcpy(&me->test_pattern[0x40c], "SYNTHETC", 8);
+    hm2_test_set_u32(me, 0x41c, HM2_TEST_CONNECTORS);  // IOPorts
+    hm2_test_set_u32(me, 0x420, num_pins);   // IOWidth
+    hm2_test_set_u32(me, 0x424, 24);         // PortWidth
+    hm2_test_set_u32(me, 0x428, 33333333);   // ClockLow
+    hm2_test_set_u32(me, 0x42c, 100000000);  // ClockHigh
+    hm2_test_set_u32(me, 0x430, 4);          // InstanceStride0
+    hm2_test_set_u32(me, 0x434, 0x40);       // InstanceStride1
+    hm2_test_set_u32(me, 0x438, 0x100);      // RegisterStride0
+    hm2_test_set_u32(me, 0x43c, 4);          // RegisterStride1
+
+    hm2_test_add_md(me, md_index ++, HM2_TEST_MODULE_WATCHDOG, HM2_GTAG_WATCHDOG, 0, 1, 0x0c00, 3, 0);
+    hm2_test_add_md(me, md_index ++, HM2_TEST_MODULE_IOPORT, HM2_GTAG_IOPORT, 0, HM2_TEST_CONNECTORS, 0x1000, 5, 0x1f);
+    if (stepgens > 0) {
+        hm2_test_add_md(me, md_index ++, HM2_TEST_MODULE_STEPGEN, HM2_GTAG_STEPGEN, 2, stepgens, 0x2000, 10, 0x1ff);
+    }
+    if (encoders > 0) {
+        hm2_test_add_md(me, md_index ++, HM2_TEST_MODULE_ENCODER, HM2_GTAG_ENCODER, 3, encoders, 0x3000, 5, 0x3);
+    }
+
+    // A, B and Index for each encoder, then Step and Direction for
+    // each stepgen (outputs have bit 7 of SecPin set), then GPIOs
+    for (i = 0; i < encoders; i ++) {
+        hm2_test_add_pd(me, &pin, 1, HM2_GTAG_ENCODER, i);
+        hm2_test_add_pd(me, &pin, 2, HM2_GTAG_ENCODER, i);
+        hm2_test_add_pd(me, &pin, 3, HM2_GTAG_ENCODER, i);
+    }
+    for (i = 0; i < stepgens; i ++) {
+        hm2_test_add_pd(me, &pin, 0x81, HM2_GTAG_STEPGEN, i);
+        hm2_test_add_pd(me, &pin, 0x82, HM2_GTAG_STEPGEN, i);
+    }
+    while (pin < num_pins) {
+        hm2_test_add_pd(me, &pin, 0, 0, 0);
+    }
+
+    me->llio.num_ioport_connectors = HM2_TEST_CONNECTORS;
+    me->llio.ioport_connector_name[0] = "P2";
+    me->llio.ioport_connector_name[1] = "P3";
+    me->llio.ioport_connector_name[2] = "P4";
+    me->llio.ioport_connector_name[3] = "P5";
+
+    return 0;
+}
+
+
+
+
 int rtapi_app_main(void) {
     hm2_test_t *me;
     hm2_lowlevel_io_t *this;
@@ -109,6 +407,12 @@ int rtapi_app_main(void) {
     me->llio.pins_per_connector = 24;
     me->llio.ioport_connector_name[0] = "P99";
 
+    r = hm2_test_set_bus(me);
+    if (r != 0) {
+        hal_exit(comp_id);
+        return r;
+    }
+
     switch (test_pattern) {
 
         // 
@@ -626,6 +930,20 @@ int rtapi_app_main(void) {
         }
 
 
+        //
+        // the whole synthetic board, see hm2_test_synthetic_board()
+        //
+
+        case 15: {
+            r = hm2_test_synthetic_board(me);
+            if (r != 0) {
+                hal_exit(comp_id);
+                return r;
+            }
+            break;
+        }
+
+
         default: {
             LL_ERR("unknown test pattern %d", test_pattern); 
             return -ENODEV;
@@ -654,6 +972,14 @@ int rtapi_app_main(void) {
         return -EIO;
     }
 
+    r = hm2_test_export_bench(me);
+    if (r != 0) {
+        THIS_ERR("error %d exporting the bench pins and function\n", r);
+        hm2_unregister(&me->llio);
+        hal_exit(comp_id);
+        return r;
+    }
+
     THIS_PRINT("initialized hm2 test-pattern %d\n", test_pattern);
 
     hal_ready(comp_id);
@@ -22,9 +22,63 @@
 
 #define HM2_TEST_MAX_BOARDS (2)
 
+
+//
+// The llio time is split up by the module whose registers were touched,
+// found from the register page (the address >> 8).
+//
+
+#define HM2_TEST_MODULE_OTHER     (0)
+#define HM2_TEST_MODULE_WATCHDOG  (1)
+#define HM2_TEST_MODULE_IOPORT    (2)
+#define HM2_TEST_MODULE_ENCODER   (3)
+#define HM2_TEST_MODULE_STEPGEN   (4)
+#define HM2_TEST_NUM_MODULES      (5)
+
+
+// what one llio access costs, in ns, for the emulated bus
+typedef struct {
+    const char *name;
+    long read_ns;       // per read transaction
+    long read_word_ns;  // per 32-bit word read
+    long write_ns;      // per write transaction
+    long write_word_ns; // per 32-bit word written
+} hm2_test_bus_t;
+
+
+// llio time since the last run of the bench function
+typedef struct {
+    long long ns;
+    u32 reads;
+    u32 writes;
+} hm2_test_count_t;
+
+
+// HAL pins for one module
+typedef struct {
+    hal_float_t *ns;      // llio time, last period
+    hal_float_t *ns_avg;  // mean since the reset
+    hal_u32_t *reads;     // read transactions, last period
+    hal_u32_t *writes;    // write transactions, last period
+    double ns_sum;
+} hm2_test_module_pins_t;
+
+
+typedef struct {
+    hal_bit_t *reset;
+    hal_u32_t *samples;
+    hm2_test_module_pins_t module[HM2_TEST_NUM_MODULES];
+} hm2_test_bench_t;
+
+
 typedef struct {
     u8 test_pattern[64 * 1024];
 
+    hm2_test_bus_t bus;
+    u8 page_module[256];
+    hm2_test_count_t count[HM2_TEST_NUM_MODULES];
+    hm2_test_bench_t *bench;
+
     hm2_lowlevel_io_t llio;
 } hm2_test_t;
 
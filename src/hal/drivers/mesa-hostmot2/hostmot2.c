@@ -70,6 +70,20 @@ static int comp_id;
 // functions exported to LinuxCNC
 //
 
+static void hm2_read_process(hostmot2_t *hm2, long period) {
+    hm2_ioport_gpio_process_tram_read(hm2);
+    hm2_encoder_process_tram_read(hm2, period);
+    hm2_resolver_process_tram_read(hm2, period);
+    hm2_stepgen_process_tram_read(hm2, period);
+    hm2_sserial_process_tram_read(hm2, period);
+    hm2_bspi_process_tram_read(hm2, period);
+    //UARTS need to be explicity handled by an external component
+
+    hm2_tp_pwmgen_read(hm2); // check the status of the fault bit
+    hm2_raw_read(hm2);
+}
+
+
 static void hm2_read(void *void_hm2, long period) {
     hostmot2_t *hm2 = void_hm2;
 
@@ -87,16 +101,65 @@ static void hm2_read(void *void_hm2, long period) {
     hm2_tram_read(hm2);
     if ((*hm2->llio->io_error) != 0) return;
 
-    hm2_ioport_gpio_process_tram_read(hm2);
-    hm2_encoder_process_tram_read(hm2, period);
-    hm2_resolver_process_tram_read(hm2, period);
-    hm2_stepgen_process_tram_read(hm2, period);
-    hm2_sserial_process_tram_read(hm2, period);
-    hm2_bspi_process_tram_read(hm2, period);
-    //UARTS need to be explicity handled by an external component
+    hm2_read_process(hm2, period);
+}
 
-    hm2_tp_pwmgen_read(hm2); // check the status of the fault bit
-    hm2_raw_read(hm2);
+
+//
+// The split-phase read: .read-request does the TRAM read, early (at the
+// end of the previous period, or in a faster thread when the llio is
+// threadsafe), and .read-complete later processes what it got, so the
+// bus round trip is not on the critical path.  The TRAM is read all at
+// once, so the encoder counts and their timestamps come from the same
+// moment and the velocity estimates stay right; the data is as old as
+// the request.
+//
+// The request reads into a staging buffer and raises tram_read_staged;
+// nothing writes the staging buffer again until the complete has copied
+// it out and cleared the flag.
+//
+
+static void hm2_read_request(void *void_hm2, long period) {
+    hostmot2_t *hm2 = void_hm2;
+
+    // if there are comm problems, wait for the user to fix it
+    if ((*hm2->llio->io_error) != 0) return;
+
+    // the last one was not picked up yet
+    if (hm2->tram_read_staged) return;
+
+    if (hm2_tram_read_staging(hm2) != 0) return;
+    smp_wmb();
+    hm2->tram_read_staged = 1;
+}
+
+
+static void hm2_read_complete(void *void_hm2, long period) {
+    hostmot2_t *hm2 = void_hm2;
+
+    // if there are comm problems, wait for the user to fix it
+    if ((*hm2->llio->io_error) != 0) return;
+
+    // is there a watchdog?
+    if (hm2->watchdog.num_instances > 0) {
+        // we're reading from the hm2 board now, so turn on the watchdog
+        hm2->watchdog.instance[0].enable = 1;
+
+        hm2_watchdog_read(hm2);  // look for bite
+    }
+
+    if (hm2->tram_read_staged) {
+        smp_rmb();
+        memcpy(hm2->tram_read_buffer, hm2->tram_read_staging, hm2->tram_read_size);
+        smp_mb();
+        hm2->tram_read_staged = 0;
+    } else {
+        // no request since the last complete, read it now
+        hm2_tram_read(hm2);
+    }
+    if ((*hm2->llio->io_error) != 0) return;
+
+    hm2_read_process(hm2, period);
 }
 
 
@@ -271,6 +334,7 @@ static int hm2_parse_config_string(hostmot2_t *hm2, char *config_string) {
     hm2->config.num_uarts = -1;
     hm2->config.num_leds = -1;
     hm2->config.enable_raw = 0;
+    hm2->config.reuse_firmware = 0;
     hm2->config.firmware = NULL;
 
     if (config_string == NULL) return 0;
@@ -344,6 +408,9 @@ static int hm2_parse_config_string(hostmot2_t *hm2, char *config_string) {
         } else if (strncmp(token, "enable_raw", 10) == 0) {
             hm2->config.enable_raw = 1;
 
+        } else if (strncmp(token, "reuse_firmware", 14) == 0) {
+            hm2->config.reuse_firmware = 1;
+
         } else if (strncmp(token, "firmware=", 9) == 0) {
             // FIXME: we leak this in hm2_register
             hm2->config.firmware = kstrdup(token + 9, GFP_KERNEL);
@@ -374,6 +441,7 @@ static int hm2_parse_config_string(hostmot2_t *hm2, char *config_string) {
     HM2_DBG("    num_bspis=%d\n", hm2->config.num_bspis);
     HM2_DBG("    num_uarts=%d\n", hm2->config.num_uarts);
     HM2_DBG("    enable_raw=%d\n",   hm2->config.enable_raw);
+    HM2_DBG("    reuse_firmware=%d\n",   hm2->config.reuse_firmware);
     HM2_DBG("    firmware=%s\n",   hm2->config.firmware ? hm2->config.firmware : "(NULL)");
 
     argv_free(argv);
@@ -894,6 +962,21 @@ static void hm2_release_device(struct device *dev) {
 }
 
 
+// returns 1 if the FPGA answers with the HostMot2 cookie and config name,
+// ie it is configured with some HostMot2 firmware, and 0 if not
+static int hm2_is_hostmot2(hm2_lowlevel_io_t *llio) {
+    uint32_t cookie;
+    char name[9];
+
+    if (!llio->read(llio, HM2_ADDR_IOCOOKIE, &cookie, 4)) return 0;
+    if (cookie != HM2_IOCOOKIE) return 0;
+
+    if (!llio->read(llio, HM2_ADDR_CONFIGNAME, name, 8)) return 0;
+    name[8] = '\0';
+    return (strncmp(name, HM2_CONFIGNAME, 9) == 0);
+}
+
+
 EXPORT_SYMBOL_GPL(hm2_register);
 
 int hm2_register(hm2_lowlevel_io_t *llio, char *config_string) {
@@ -1100,21 +1183,28 @@ int hm2_register(hm2_lowlevel_io_t *llio, char *config_string) {
             }
         }
 
-        if (llio->reset != NULL) {
-            r = llio->reset(llio);
+        if (hm2->config.reuse_firmware && hm2_is_hostmot2(llio)) {
+            // left configured by the last run, sending it again is the
+            // slow part of bringing up an EPP board
+            HM2_INFO("FPGA already has HostMot2 firmware, not reprogramming it\n");
+            release_firmware(fw);
+        } else {
+            if (llio->reset != NULL) {
+                r = llio->reset(llio);
+                if (r != 0) {
+                    release_firmware(fw);
+                    HM2_ERR("failed to reset fpga, aborting hm2_register\n");
+                    goto fail0;
+                }
+            }
+
+            r = llio->program_fpga(llio, &bitfile);
+            release_firmware(fw);
             if (r != 0) {
-                release_firmware(fw);
-                HM2_ERR("failed to reset fpga, aborting hm2_register\n");
+                HM2_ERR("failed to program fpga, aborting hm2_register\n");
                 goto fail0;
             }
         }
-
-        r = llio->program_fpga(llio, &bitfile);
-        release_firmware(fw);
-        if (r != 0) {
-            HM2_ERR("failed to program fpga, aborting hm2_register\n");
-            goto fail0;
-        }
     }
 
 
@@ -1143,6 +1233,32 @@ int hm2_register(hm2_lowlevel_io_t *llio, char *config_string) {
             r = -EINVAL;
             goto fail0;
         }
+
+        hm2->tram_read_time = (hal_s32_t *)hal_malloc(2 * sizeof(hal_s32_t));
+        if (hm2->tram_read_time == NULL) {
+            HM2_ERR("out of memory!\n");
+            r = -ENOMEM;
+            goto fail0;
+        }
+        hm2->tram_write_time = hm2->tram_read_time + 1;
+        (*hm2->tram_read_time) = 0;
+        (*hm2->tram_write_time) = 0;
+
+        rtapi_snprintf(name, sizeof(name), "%s.tram-read-time", llio->name);
+        r = hal_param_s32_new(name, HAL_RO, hm2->tram_read_time, llio->comp_id);
+        if (r < 0) {
+            HM2_ERR("error adding param '%s', aborting\n", name);
+            r = -EINVAL;
+            goto fail0;
+        }
+
+        rtapi_snprintf(name, sizeof(name), "%s.tram-write-time", llio->name);
+        r = hal_param_s32_new(name, HAL_RO, hm2->tram_write_time, llio->comp_id);
+        if (r < 0) {
+            HM2_ERR("error adding param '%s', aborting\n", name);
+            r = -EINVAL;
+            goto fail0;
+        }
     }
 
 
@@ -1369,6 +1485,22 @@ int hm2_register(hm2_lowlevel_io_t *llio, char *config_string) {
             r = -EINVAL;
             goto fail1;
         }
+
+        rtapi_snprintf(name, sizeof(name), "%s.read-request", hm2->llio->name);
+        r = hal_export_funct(name, hm2_read_request, hm2, 1, 0, hm2->llio->comp_id);
+        if (r != 0) {
+            HM2_ERR("error %d exporting read-request function %s\n", r, name);
+            r = -EINVAL;
+            goto fail1;
+        }
+
+        rtapi_snprintf(name, sizeof(name), "%s.read-complete", hm2->llio->name);
+        r = hal_export_funct(name, hm2_read_complete, hm2, 1, 0, hm2->llio->comp_id);
+        if (r != 0) {
+            HM2_ERR("error %d exporting read-complete function %s\n", r, name);
+            r = -EINVAL;
+            goto fail1;
+        }
     }
 
 
@@ -255,6 +255,7 @@ typedef struct {
             hal_s32_t *count_latch;  // (rawlatch - zero_offset)
             hal_float_t *position;
             hal_float_t *position_latch;
+            hal_float_t *position_interpolated;
             hal_float_t *velocity;
             hal_bit_t *reset;
             hal_bit_t *index_enable;
@@ -271,6 +272,7 @@ typedef struct {
             hal_bit_t counter_mode;
             hal_bit_t filter;
             hal_float_t vel_timeout;
+            hal_float_t interpolate_time;
         } param;
 
     } hal;
@@ -684,6 +686,15 @@ typedef struct {
     hal_bit_t *run;
     hal_u32_t *state;
     u32 timer;
+
+    // The DoIt written in hm2_write() is answered while the rest of the
+    // thread runs and read in the next hm2_read().  The pins hold the
+    // last complete answer; data_age says how long ago it was asked for.
+    hal_float_t *data_age;
+    int doit_pending;
+    int data_fresh;         // the registers hold an answer not yet on the pins
+    long long doit_time;    // when the pending DoIt was queued
+    long long data_time;    // when the answer on the pins was asked for
 } hm2_sserial_instance_t;
 
 typedef struct {
@@ -758,6 +769,11 @@ typedef struct {
             hal_bit_t *enable;
             hal_bit_t *control_type;  // 0="position control", 1="velocity control"
 
+            // feed-forward from the trajectory planner, for position control
+            hal_bit_t *feed_forward;
+            hal_float_t *velocity_ff;
+            hal_float_t *acceleration_ff;
+
             // debug pins
             hal_float_t *dbg_ff_vel;
             hal_float_t *dbg_vel_error;
@@ -1006,6 +1022,17 @@ typedef struct {
 } hm2_tram_entry_t;
 
 
+//
+// the TRAM entries are coalesced into bursts, one llio transfer each
+//
+
+typedef struct {
+    u16 addr;
+    u16 size;
+    u32 *buffer;
+} hm2_tram_burst_t;
+
+
 
 
 // 
@@ -1027,6 +1054,7 @@ typedef struct {
         int num_uarts;
         char sserial_modes[4][8];
         int enable_raw;
+        int reuse_firmware;
         char *firmware;
     } config;
 
@@ -1050,6 +1078,20 @@ typedef struct {
     u32 *tram_write_buffer;
     u16 tram_write_size;
 
+    // for the split-phase read: .read-request fills the staging
+    // buffer and sets tram_read_staged, .read-complete copies it out
+    u32 *tram_read_staging;
+    volatile int tram_read_staged;
+
+    hm2_tram_burst_t *tram_read_bursts;
+    int tram_num_read_bursts;
+    hm2_tram_burst_t *tram_write_bursts;
+    int tram_num_write_bursts;
+
+    // CPU clocks spent in the last TRAM read and write, HAL params
+    hal_s32_t *tram_read_time;
+    hal_s32_t *tram_write_time;
+
     // the hostmot2 "Functions"
     hm2_encoder_t encoder;
     hm2_resolver_t resolver;
@@ -1111,6 +1153,7 @@ int hm2_register_tram_read_region(hostmot2_t *hm2, u16 addr, u16 size, u32 **buf
 int hm2_register_tram_write_region(hostmot2_t *hm2, u16 addr, u16 size, u32 **buffer);
 int hm2_allocate_tram_regions(hostmot2_t *hm2);
 int hm2_tram_read(hostmot2_t *hm2);
+int hm2_tram_read_staging(hostmot2_t *hm2);
 int hm2_tram_write(hostmot2_t *hm2);
 void hm2_tram_cleanup(hostmot2_t *hm2);
 
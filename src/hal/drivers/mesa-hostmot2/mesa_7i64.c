@@ -221,7 +221,7 @@ void hm2_7i64_process_tram_read(hostmot2_t  * hm2){
     for (i = 0 ; i < hm2->sserial.num_instances ; i++){
         hm2_sserial_instance_t *inst = &hm2->sserial.instance[i];
 
-        if (*inst->state != 0x01) continue ; // Only work on running instances
+        if (! inst->data_fresh) continue ; // Only take complete answers
 
         for (c = 0 ; c < hm2->sserial.instance[i].num_7i64 ; c++){
             hal_7i64_t *hal = &inst->hal_7i64[c];
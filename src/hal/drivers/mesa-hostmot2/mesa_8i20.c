@@ -273,7 +273,7 @@ void hm2_8i20_process_tram_read(hostmot2_t *hm2){
     for (i = 0 ; i < hm2->sserial.num_instances ; i++){
          hm2_sserial_instance_t *inst = &hm2->sserial.instance[i];
 
-        if (*inst->state != 0x01) continue ; // Only work on running instances
+        if (! inst->data_fresh) continue ; // Only take complete answers
 
         for (c = 0 ; c < hm2->sserial.instance[i].num_8i20 ; c++){
             hal_8i20_t *hal = &inst->hal_8i20[c];
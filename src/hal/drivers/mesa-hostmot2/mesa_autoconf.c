@@ -179,7 +179,7 @@ void hm2_auto_process_tram_read(hostmot2_t *hm2){
     s32 buff32;
     for (i = 0 ; i < hm2->sserial.num_instances ; i++){
         hm2_sserial_instance_t *inst = &hm2->sserial.instance[i];
-        if (*inst->state != 0x01) continue ; // Only work on running instances
+        if (! inst->data_fresh) continue ; // Only take complete answers
         n = 0;
         for (c = 0 ; c < inst->num_channels ; c++ ) {
             if (inst->tag_auto & (1 << c)) {
@@ -261,6 +261,19 @@ int hm2_sserial_parse_md(hostmot2_t *hm2, int md_index) {
                         hm2->llio->name, i);
                 goto fail0;
             }
+            r = hal_pin_float_newf(HAL_OUT, &(inst->data_age),
+                                   hm2->llio->comp_id,
+                                   "%s.sserial.port-%1d.data-age",
+                                   hm2->llio->name, i);
+            if (r < 0) {
+                HM2_ERR("error adding pin %s.sserial.%1d.data-age. aborting\n",
+                        hm2->llio->name, i);
+                goto fail0;
+            }
+            *inst->data_age = 0;
+            inst->doit_pending = 0;
+            inst->data_fresh = 0;
+            inst->data_time = 0;
             r = hal_param_u32_newf(HAL_RW, &(inst->fault_inc),
                                    hm2->llio->comp_id, 
                                    "%s.sserial.port-%1d.fault-inc",
@@ -425,6 +438,8 @@ void hm2_sserial_prepare_tram_write(hostmot2_t *hm2, long period){
                 *inst->fault_count = 0;
                 doit_err_count = 0;
                 comm_err_flag = 0;
+                inst->doit_pending = 0;
+                inst->data_time = 0;
                 break;
             case 0x01: // normal running
                 if (!*inst->run){
@@ -484,6 +499,8 @@ void hm2_sserial_prepare_tram_write(hostmot2_t *hm2, long period){
                 }
                 
                 *inst->command_reg_write = 0x1000 | inst->tag_all;
+                inst->doit_pending = 1;
+                inst->doit_time = rtapi_get_time();
                 break;
 
             case 0x02: // run to stop transition
@@ -519,6 +536,33 @@ void hm2_sserial_prepare_tram_write(hostmot2_t *hm2, long period){
 }
 
 void hm2_sserial_process_tram_read(hostmot2_t *hm2, long period){
+    // The answer to last period's DoIt is only copied to the pins once
+    // the DoIt has cleared; until then the registers may be half-updated
+    // and the pins keep the previous answer, which data-age shows.
+    long long now;
+    int i;
+
+    if (hm2->sserial.num_instances <= 0) return;
+
+    now = rtapi_get_time();
+    for (i = 0 ; i < hm2->sserial.num_instances ; i++ ) {
+        hm2_sserial_instance_t *inst = &hm2->sserial.instance[i];
+
+        if (inst->num_all <= 0) continue;
+
+        inst->data_fresh = 0;
+        if (*inst->state == 0x01 && inst->doit_pending
+            && *inst->command_reg_read == 0) {
+            inst->doit_pending = 0;
+            inst->data_fresh = 1;
+            inst->data_time = inst->doit_time;
+        }
+        if (inst->data_time != 0) {
+            *inst->data_age = (now - inst->data_time) * 1e-9;
+        } else {
+            *inst->data_age = 0;
+        }
+    }
 
     hm2_8i20_process_tram_read(hm2);
     hm2_7i64_process_tram_read(hm2);
@@ -102,8 +102,14 @@ static void hm2_stepgen_instance_position_control(hostmot2_t *hm2, long l_period
 
     (*s->hal.pin.dbg_pos_minus_prev_cmd) = (*s->hal.pin.position_fb) - s->old_position_cmd;
 
-    // calculate feed-forward velocity in machine units per second
-    ff_vel = ((*s->hal.pin.position_cmd) - s->old_position_cmd) / f_period_s;
+    // calculate feed-forward velocity in machine units per second.
+    // Without velocity-ff this is how fast position-cmd moved over the
+    // last period; with it, how fast it will move over the next one
+    if (*s->hal.pin.feed_forward) {
+        ff_vel = *s->hal.pin.velocity_ff + (*s->hal.pin.acceleration_ff * f_period_s);
+    } else {
+        ff_vel = ((*s->hal.pin.position_cmd) - s->old_position_cmd) / f_period_s;
+    }
     (*s->hal.pin.dbg_ff_vel) = ff_vel;
 
     s->old_position_cmd = (*s->hal.pin.position_cmd);
@@ -149,8 +155,15 @@ static void hm2_stepgen_instance_position_control(hostmot2_t *hm2, long l_period
         position_at_match = *s->hal.pin.position_fb + (avg_v * (seconds_to_vel_match + f_period_s));
     }
 
-    // Note: this assumes that position-cmd keeps the current velocity
-    position_cmd_at_match = *s->hal.pin.position_cmd + (ff_vel * seconds_to_vel_match);
+    // Note: this assumes that position-cmd keeps the current velocity.
+    // position_at_match is a period later than seconds_to_vel_match,
+    // so without feed-forward the stepgen trails position-cmd by a
+    // period; with it, position-cmd is taken on to then as well
+    if (*s->hal.pin.feed_forward) {
+        position_cmd_at_match = *s->hal.pin.position_cmd + (ff_vel * (seconds_to_vel_match + f_period_s));
+    } else {
+        position_cmd_at_match = *s->hal.pin.position_cmd + (ff_vel * seconds_to_vel_match);
+    }
     error_at_match = position_at_match - position_cmd_at_match;
 
     *s->hal.pin.dbg_err_at_match = error_at_match;
@@ -713,6 +726,30 @@ int hm2_stepgen_parse_md(hostmot2_t *hm2, int md_index) {
                 goto fail5;
             }
 
+            rtapi_snprintf(name, sizeof(name), "%s.stepgen.%02d.feed-forward", hm2->llio->name, i);
+            r = hal_pin_bit_new(name, HAL_IN, &(hm2->stepgen.instance[i].hal.pin.feed_forward), hm2->llio->comp_id);
+            if (r < 0) {
+                HM2_ERR("error adding pin '%s', aborting\n", name);
+                r = -ENOMEM;
+                goto fail5;
+            }
+
+            rtapi_snprintf(name, sizeof(name), "%s.stepgen.%02d.velocity-ff", hm2->llio->name, i);
+            r = hal_pin_float_new(name, HAL_IN, &(hm2->stepgen.instance[i].hal.pin.velocity_ff), hm2->llio->comp_id);
+            if (r < 0) {
+                HM2_ERR("error adding pin '%s', aborting\n", name);
+                r = -ENOMEM;
+                goto fail5;
+            }
+
+            rtapi_snprintf(name, sizeof(name), "%s.stepgen.%02d.acceleration-ff", hm2->llio->name, i);
+            r = hal_pin_float_new(name, HAL_IN, &(hm2->stepgen.instance[i].hal.pin.acceleration_ff), hm2->llio->comp_id);
+            if (r < 0) {
+                HM2_ERR("error adding pin '%s', aborting\n", name);
+                r = -ENOMEM;
+                goto fail5;
+            }
+
             // debug pins
 
             rtapi_snprintf(name, sizeof(name), "%s.stepgen.%02d.dbg_pos_minus_prev_cmd", hm2->llio->name, i);
@@ -836,6 +873,9 @@ int hm2_stepgen_parse_md(hostmot2_t *hm2, int md_index) {
             *(hm2->stepgen.instance[i].hal.pin.velocity_fb) = 0.0;
             *(hm2->stepgen.instance[i].hal.pin.enable) = 0;
             *(hm2->stepgen.instance[i].hal.pin.control_type) = 0;
+            *(hm2->stepgen.instance[i].hal.pin.feed_forward) = 0;
+            *(hm2->stepgen.instance[i].hal.pin.velocity_ff) = 0.0;
+            *(hm2->stepgen.instance[i].hal.pin.acceleration_ff) = 0.0;
 
             hm2->stepgen.instance[i].hal.param.position_scale = 1.0;
             hm2->stepgen.instance[i].hal.param.maxvel = 0.0;
@@ -28,6 +28,9 @@
 #include "hal/drivers/mesa-hostmot2/hostmot2.h"
 
 
+int tram_read_gap = 0;
+RTAPI_MP_INT(tram_read_gap, "Read up to this many bytes between two TRAM read regions\nto merge them into one transfer.  Only safe if reading the\nregisters in between has no side effects.");
+
 
 
 //
@@ -80,97 +83,227 @@ int hm2_register_tram_write_region(hostmot2_t *hm2, u16 addr, u16 size, u32 **bu
 }
 
 
-int hm2_allocate_tram_regions(hostmot2_t *hm2) {
+//
+// Coalesces a list of TRAM entries into bursts: an entry that starts
+// where the previous burst ends is transferred with it, so the llio
+// does one transfer (one address setup on EPP) per burst instead of
+// one per entry.
+//
+// With sort, the entries are taken in address order (reads), otherwise
+// in the order they were registered (writes, whose order may matter).
+// Up to gap bytes between two entries are transferred too; that is
+// only allowed for reads, and only when the user asks for it.
+//
+// The buffer is laid out like the bursts, and each entry's buffer
+// pointer is set to its place in it.
+//
+
+static int hm2_tram_build_bursts(
+    hostmot2_t *hm2,
+    struct list_head *entries,
+    int sort,
+    int gap,
+    hm2_tram_burst_t **bursts,
+    int *num_bursts,
+    u32 **buffer,
+    u16 *buffer_size
+) {
     struct list_head *ptr;
+    hm2_tram_entry_t **entry;
+    int *which;
+    int n, i, j, nb;
     u16 offset;
-    
-    hm2->tram_read_size = 0;
-    list_for_each(ptr, &hm2->tram_read_entries) {
-        hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
-        hm2->tram_read_size += tram_entry->size;
+
+    n = 0;
+    list_for_each(ptr, entries) {
+        n ++;
     }
 
-    hm2->tram_write_size = 0;
-    list_for_each(ptr, &hm2->tram_write_entries) {
+    if (*bursts != NULL) kfree(*bursts);
+    *bursts = NULL;
+    *num_bursts = 0;
+
+    entry = kmalloc((n + 1) * sizeof(hm2_tram_entry_t *), GFP_KERNEL);
+    which = kmalloc((n + 1) * sizeof(int), GFP_KERNEL);
+    *bursts = kmalloc((n + 1) * sizeof(hm2_tram_burst_t), GFP_KERNEL);
+    if ((entry == NULL) || (which == NULL) || (*bursts == NULL)) {
+        HM2_ERR("out of memory!\n");
+        if (entry != NULL) kfree(entry);
+        if (which != NULL) kfree(which);
+        return -ENOMEM;
+    }
+
+    i = 0;
+    list_for_each(ptr, entries) {
         hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
-        hm2->tram_write_size += tram_entry->size;
+
+        // insertion sort, keeps entries at the same address in order
+        for (j = i; sort && (j > 0) && (entry[j-1]->addr > tram_entry->addr); j --) {
+            entry[j] = entry[j-1];
+        }
+        entry[j] = tram_entry;
+        i ++;
     }
 
-    HM2_DBG(
-        "allocating Translation RAM buffers (reading %d bytes, writing %d bytes)\n",
-        hm2->tram_read_size,
-        hm2->tram_write_size
-    );
+    nb = 0;
+    for (i = 0; i < n; i ++) {
+        if (nb > 0) {
+            hm2_tram_burst_t *last = &(*bursts)[nb-1];
+            u32 end = last->addr + last->size;
+
+            if ((entry[i]->addr >= end) && (entry[i]->addr <= end + gap)) {
+                last->size = entry[i]->addr + entry[i]->size - last->addr;
+                which[i] = nb - 1;
+                continue;
+            }
+        }
+        (*bursts)[nb].addr = entry[i]->addr;
+        (*bursts)[nb].size = entry[i]->size;
+        which[i] = nb;
+        nb ++;
+    }
 
-    hm2->tram_read_buffer = (u32 *)krealloc(hm2->tram_read_buffer, hm2->tram_read_size, GFP_KERNEL);
-    if (hm2->tram_read_buffer == NULL) {
-        HM2_ERR("Error while (re)allocating Translation RAM read buffer (%d bytes)\n", hm2->tram_read_size);
-        return -ENOMEM;
+    *buffer_size = 0;
+    for (i = 0; i < nb; i ++) {
+        *buffer_size += (*bursts)[i].size;
     }
-    
-    hm2->tram_write_buffer = (u32 *)krealloc(hm2->tram_write_buffer, hm2->tram_write_size, GFP_KERNEL);
-    if (hm2->tram_write_buffer == NULL) {
-        HM2_ERR("Error while (re)allocating Translation RAM write buffer (%d bytes)\n", hm2->tram_write_size);
+
+    *buffer = (u32 *)krealloc(*buffer, *buffer_size, GFP_KERNEL);
+    if (*buffer == NULL) {
+        kfree(entry);
+        kfree(which);
         return -ENOMEM;
     }
-    HM2_DBG("buffer address %p\n", &hm2->tram_write_buffer);
-    HM2_DBG("Translation RAM read buffer:\n");
+
     offset = 0;
-    list_for_each(ptr, &hm2->tram_read_entries) {
-        hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
-        *tram_entry->buffer = (u32*)((u8*)hm2->tram_read_buffer + offset);
-        offset += tram_entry->size;
-        HM2_DBG("    addr=0x%04x, size=%d, buffer=%p\n", tram_entry->addr, tram_entry->size, *tram_entry->buffer);
+    for (i = 0; i < nb; i ++) {
+        (*bursts)[i].buffer = (u32*)((u8*)(*buffer) + offset);
+        offset += (*bursts)[i].size;
+    }
+    *num_bursts = nb;
+
+    for (i = 0; i < n; i ++) {
+        hm2_tram_burst_t *burst = &(*bursts)[which[i]];
+        *entry[i]->buffer = (u32*)((u8*)burst->buffer + (entry[i]->addr - burst->addr));
+        HM2_DBG("    addr=0x%04x, size=%d, buffer=%p\n", entry[i]->addr, entry[i]->size, *entry[i]->buffer);
+    }
+
+    HM2_DBG("    %d entries in %d transfers\n", n, nb);
+
+    kfree(entry);
+    kfree(which);
+    return 0;
+}
+
+
+int hm2_allocate_tram_regions(hostmot2_t *hm2) {
+    int r;
+
+    if (tram_read_gap < 0) tram_read_gap = 0;
+
+    HM2_DBG("Translation RAM read buffer:\n");
+    r = hm2_tram_build_bursts(
+        hm2,
+        &hm2->tram_read_entries,
+        1,
+        tram_read_gap,
+        &hm2->tram_read_bursts,
+        &hm2->tram_num_read_bursts,
+        &hm2->tram_read_buffer,
+        &hm2->tram_read_size
+    );
+    if (r != 0) {
+        HM2_ERR("Error while (re)allocating Translation RAM read buffer (%d bytes)\n", hm2->tram_read_size);
+        return r;
+    }
+
+    // whatever was staged has the old layout
+    hm2->tram_read_staged = 0;
+    hm2->tram_read_staging = (u32 *)krealloc(hm2->tram_read_staging, hm2->tram_read_size, GFP_KERNEL);
+    if (hm2->tram_read_staging == NULL) {
+        HM2_ERR("Error while (re)allocating Translation RAM staging buffer (%d bytes)\n", hm2->tram_read_size);
+        return -ENOMEM;
     }
 
     HM2_DBG("Translation RAM write buffer:\n");
-    offset = 0;
-    list_for_each(ptr, &hm2->tram_write_entries) {
-        hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
-        *tram_entry->buffer = (u32*)((u8*)hm2->tram_write_buffer + offset);
-        offset += tram_entry->size;
-        HM2_DBG("    addr=0x%04x, size=%d, buffer=%p\n", tram_entry->addr, tram_entry->size, *tram_entry->buffer);
+    r = hm2_tram_build_bursts(
+        hm2,
+        &hm2->tram_write_entries,
+        0,
+        0,
+        &hm2->tram_write_bursts,
+        &hm2->tram_num_write_bursts,
+        &hm2->tram_write_buffer,
+        &hm2->tram_write_size
+    );
+    if (r != 0) {
+        HM2_ERR("Error while (re)allocating Translation RAM write buffer (%d bytes)\n", hm2->tram_write_size);
+        return r;
     }
-    
+
+    HM2_DBG(
+        "allocated Translation RAM buffers (reading %d bytes, writing %d bytes)\n",
+        hm2->tram_read_size,
+        hm2->tram_write_size
+    );
+
     return 0;
 }
 
 
-int hm2_tram_read(hostmot2_t *hm2) {
+// reads the bursts into buffer, laid out like tram_read_buffer
+static int hm2_tram_read_into(hostmot2_t *hm2, u32 *buffer) {
     static u32 tram_read_iteration = 0;
-    struct list_head *ptr;
-    u16 offset;
+    long long start = rtapi_get_clocks();
+    int i;
 
-    offset = 0;
-    list_for_each(ptr, &hm2->tram_read_entries) {
-        hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
+    for (i = 0; i < hm2->tram_num_read_bursts; i ++) {
+        hm2_tram_burst_t *burst = &hm2->tram_read_bursts[i];
+        u8 *dest = (u8*)buffer + ((u8*)burst->buffer - (u8*)hm2->tram_read_buffer);
 
-        if (!hm2->llio->read(hm2->llio, tram_entry->addr, *tram_entry->buffer, tram_entry->size)) {
-            HM2_ERR("TRAM read error! (addr=0x%04x, size=%d, iter=%u)\n", tram_entry->addr, tram_entry->size, tram_read_iteration);
+        if (!hm2->llio->read(hm2->llio, burst->addr, dest, burst->size)) {
+            HM2_ERR("TRAM read error! (addr=0x%04x, size=%d, iter=%u)\n", burst->addr, burst->size, tram_read_iteration);
             return -EIO;
         }
     }
 
     tram_read_iteration ++;
+    if (hm2->tram_read_time != NULL) {
+        *hm2->tram_read_time = rtapi_get_clocks() - start;
+    }
 
     return 0;
 }
 
 
+int hm2_tram_read(hostmot2_t *hm2) {
+    return hm2_tram_read_into(hm2, hm2->tram_read_buffer);
+}
+
+
+int hm2_tram_read_staging(hostmot2_t *hm2) {
+    return hm2_tram_read_into(hm2, hm2->tram_read_staging);
+}
+
+
 int hm2_tram_write(hostmot2_t *hm2) {
     static u32 tram_write_iteration = 0;
-    struct list_head *ptr;
+    long long start = rtapi_get_clocks();
+    int i;
 
-    list_for_each(ptr, &hm2->tram_write_entries) {
-        hm2_tram_entry_t *tram_entry = list_entry(ptr, hm2_tram_entry_t, list);
+    for (i = 0; i < hm2->tram_num_write_bursts; i ++) {
+        hm2_tram_burst_t *burst = &hm2->tram_write_bursts[i];
 
-        if (!hm2->llio->write(hm2->llio, tram_entry->addr, *tram_entry->buffer, tram_entry->size)) {
-            HM2_ERR("TRAM write error! (addr=0x%04x, size=%d, iter=%u)\n", tram_entry->addr, tram_entry->size, tram_write_iteration);
+        if (!hm2->llio->write(hm2->llio, burst->addr, burst->buffer, burst->size)) {
+            HM2_ERR("TRAM write error! (addr=0x%04x, size=%d, iter=%u)\n", burst->addr, burst->size, tram_write_iteration);
             return -EIO;
         }
     }
 
     tram_write_iteration ++;
+    if (hm2->tram_write_time != NULL) {
+        *hm2->tram_write_time = rtapi_get_clocks() - start;
+    }
 
     return 0;
 }
@@ -193,5 +326,8 @@ void hm2_tram_cleanup(hostmot2_t *hm2) {
     // free the tram buffers
     if (hm2->tram_read_buffer != NULL) kfree(hm2->tram_read_buffer);
     if (hm2->tram_write_buffer != NULL) kfree(hm2->tram_write_buffer);
+    if (hm2->tram_read_staging != NULL) kfree(hm2->tram_read_staging);
+    if (hm2->tram_read_bursts != NULL) kfree(hm2->tram_read_bursts);
+    if (hm2->tram_write_bursts != NULL) kfree(hm2->tram_write_bursts);
 }
 
@@ -643,6 +643,30 @@ extern int hal_export_funct(const char *name, void (*funct) (void *, long),
 extern int hal_create_thread(const char *name, unsigned long period_nsec,
     int uses_fp);
 
+/** hal_create_thread_cpu() is the same as hal_create_thread(), but
+    the thread runs on CPU number 'cpu', or on the default realtime
+    CPU if 'cpu' is -1.  See rtapi_task_new_cpu().
+*/
+extern int hal_create_thread_cpu(const char *name, unsigned long period_nsec,
+    int uses_fp, int cpu);
+
+/** hal_thread_add_worker() gives thread 'name' a helper task on CPU
+    'cpu' (-1 for the default realtime CPU), which runs with the same
+    period and priority.  Once a thread has helpers, functions in it
+    that do not depend on each other are run at the same time, split
+    between the thread and its helpers, while functions that do depend
+    on each other still run in list order.  Functions from the same
+    component are always treated as dependent, as are functions from
+    components that share a signal written by one of them; so this
+    assumes components exchange data only through HAL signals.
+    A thread can have up to four helpers.  Helpers are only
+    useful on CPUs of their own, since waiting for one that is not
+    running delays the thread.
+    On success, returns 0, on failure returns a negative error code.
+    Call only from realtime init code, after hal_create_thread().
+*/
+extern int hal_thread_add_worker(const char *name, int cpu);
+
 /** hal_thread_delete() deletes a realtime thread.
     'name' is the name of the thread, which must have been created
     by 'hal_create_thread()'.
@@ -705,6 +729,62 @@ extern int hal_start_threads(void);
 */
 extern int hal_stop_threads(void);
 
+/** hal_compact_signals() moves the values of all signals into one
+    new block of shared memory and points the linked pins at them.
+    Signals that each thread function writes are grouped together,
+    in the order the threads run them, each group starting on a new
+    cache line; then the signals each function only reads, and then
+    the rest.  This packs the data a thread touches into as few cache
+    lines as possible, where normally it is spread around in the
+    order the signals were created.  The old copies are not reused.
+    Threads must be stopped.  On success it returns 0, on failure a
+    negative error code.  Call only from user space or init code.
+*/
+extern int hal_compact_signals(void);
+
+/** hal_fuse_thread() replaces each run of two or more consecutive
+    functions in thread 'thread_name' that belong to simple stock
+    components (and2, or2, not, mux2, scale, sum2 and the lossless
+    conv_* variants) with a single call to a fuse kernel, which does
+    the work of all of them from one table, saving a function call
+    and the indirection through each instance's data per function.
+    The kernels come from the 'fuse' module, which must be loaded;
+    runs are left alone once they are all in use.  Threads must be
+    stopped.  Returns the number of functions fused, or a negative
+    error code.  Call only from user space or init code.
+*/
+extern int hal_fuse_thread(const char *thread_name);
+
+/** hal_unfuse_thread() undoes hal_fuse_thread(), putting the fused
+    functions back in place of the kernels in thread 'thread_name'.
+    Threads must be stopped.  Returns the number of functions put
+    back, or a negative error code.
+*/
+extern int hal_unfuse_thread(const char *thread_name);
+
+/** A watch is a set of pins that a user space program waits on,
+    instead of polling them on a timer.
+    hal_watch_new() returns an empty watch, or NULL if out of memory.
+    hal_watch_pin() adds the pin 'name' to 'watch', and
+    hal_watch_comp() adds every input and I/O pin of component
+    'comp_id'.  They return 0, or a negative error code.
+    hal_watch_wait() returns as soon as any watched pin has a value
+    different from the one it had when it was added or when the last
+    call returned, and returns the number of pins that changed.  If
+    nothing changes within 'timeout' nanoseconds it returns 0; a
+    negative 'timeout' waits forever.  It returns -EINTR if a signal
+    arrives.  Changes are noticed within a few milliseconds (see
+    HAL_WATCH_NS in hal_priv.h).  hal_watch_delete() frees 'watch',
+    and must be called before any of its pins are removed.
+    These functions are only available in user space.
+*/
+typedef struct hal_watch_t hal_watch_t;
+extern hal_watch_t *hal_watch_new(void);
+extern int hal_watch_pin(hal_watch_t * watch, const char *name);
+extern int hal_watch_comp(hal_watch_t * watch, int comp_id);
+extern int hal_watch_wait(hal_watch_t * watch, long int timeout);
+extern void hal_watch_delete(hal_watch_t * watch);
+
 /** HAL 'constructor' typedef
     If it is not NULL, this points to a function which can construct a new
     instance of its component.  Return value is >=0 for success,
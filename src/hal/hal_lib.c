@@ -70,8 +70,25 @@ MODULE_LICENSE("GPL");
 #if defined(ULAPI)
 #include <sys/types.h>		/* pid_t */
 #include <unistd.h>		/* getpid() */
+#include <stdlib.h>		/* getenv(), atol(), malloc() */
+#include <time.h>		/* clock_gettime(), nanosleep() */
+#include <errno.h>		/* errno */
+#include "config.h"		/* RTAPI_SIM */
 #endif
 
+#if (defined(ULAPI) && defined(RTAPI_SIM)) || (defined(RTAPI) && defined(SIM))
+#include <limits.h>		/* INT_MAX */
+#include <unistd.h>		/* syscall() */
+#include <sys/syscall.h>	/* SYS_futex */
+#include <linux/futex.h>	/* FUTEX_WAIT, FUTEX_WAKE */
+#define HAL_WATCH_FUTEX
+#endif
+
+#ifdef RTAPI
+static int hal_size = HAL_SIZE;	/* size of the shmem block */
+RTAPI_MP_INT(hal_size, "size of HAL shared memory in bytes");
+#endif /* RTAPI */
+
 char *hal_shmem_base = 0;
 hal_data_t *hal_data = 0;
 static int lib_module_id = -1;	/* RTAPI module ID for library module */
@@ -86,9 +103,17 @@ static int lib_mem_id = 0;	/* RTAPI shmem ID for library module */
 
 /** init_hal_data() initializes the entire HAL data structure, only
     if the structure has not already been initialized.  (The init
-    is done by the first HAL component to be loaded.
+    is done by the first HAL component to be loaded.  'size' is the
+    size of the shared memory block.
+*/
+static int init_hal_data(long int size);
+
+#ifdef ULAPI
+/** map_hal_shmem() gets the HAL shared memory block from RTAPI and
+    sets 'mem' and 'size'.  Returns the shmem ID, or a negative error.
 */
-static int init_hal_data(void);
+static int map_hal_shmem(void **mem, long int *size);
+#endif
 
 /** The 'shmalloc_xx()' functions allocate blocks of shared memory.
     Each function allocates a block that is 'size' bytes long.
@@ -141,6 +166,20 @@ static void free_pin_struct(hal_pin_t * pin);
 static void free_sig_struct(hal_sig_t * sig);
 static void free_param_struct(hal_param_t * param);
 static void free_oldname_struct(hal_oldname_t * oldname);
+
+/** The hash_xxx() functions add a pin, signal or parameter (and the
+    old name of an aliased one) to the name hash chains in hal_data,
+    the unhash_xxx() functions remove it again.  They are called
+    whenever an object is inserted into or removed from its list.
+    They also assume the mutex is held.
+*/
+static unsigned int hal_name_hash(const char *name);
+static void hash_pin(hal_pin_t * pin);
+static void unhash_pin(hal_pin_t * pin);
+static void hash_sig(hal_sig_t * sig);
+static void unhash_sig(hal_sig_t * sig);
+static void hash_param(hal_param_t * param);
+static void unhash_param(hal_param_t * param);
 #ifdef RTAPI
 static void free_funct_struct(hal_funct_t * funct);
 #endif /* RTAPI */
@@ -155,8 +194,37 @@ static void free_thread_struct(hal_thread_t * thread);
     and calling each function in turn.
 */
 static void thread_task(void *arg);
+
+/** 'clear_funct_stats()' resets the execution time statistics of
+    'funct'.  It is called by the thread that runs the function.
+*/
+static void clear_funct_stats(hal_funct_t * funct);
+
+#ifdef HAL_WATCH_FUTEX
+/** 'wake_watchers()' bumps the watch sequence and wakes any process
+    in hal_watch_wait(), no more often than every HAL_WATCH_NS.
+*/
+static void wake_watchers(void);
+#endif
+
+/** 'worker_task()' is the realtime task of a thread's helper.  Each
+    period it waits briefly for the thread to start a parallel run,
+    and then helps run each stage of it.
+*/
+static void worker_task(void *arg);
 #endif /* RTAPI */
 
+/** 'ready_changed()' bumps hal_data->ready_seq and wakes any process
+    in halpr_wait_ready().  Called with the mutex held.
+*/
+static void ready_changed(void);
+
+/** 'plan_threads()' works out the stages of a parallel run for each
+    thread that has helpers (see hal_priv.h), or marks it to run
+    serially.  It assumes the mutex is held.
+*/
+static void plan_threads(void);
+
 /***********************************************************************
 *                  PUBLIC (API) FUNCTION CODE                          *
 ************************************************************************/
@@ -169,6 +237,7 @@ int hal_init(const char *name)
 #ifdef ULAPI
     int retval;
     void *mem;
+    long int size;
 #endif
     char rtapi_name[RTAPI_NAME_LEN + 1];
     char hal_name[HAL_NAME_LEN + 1];
@@ -191,26 +260,18 @@ int hal_init(const char *name)
 	lib_module_id = rtapi_init(rtapi_name);
 
 	/* get HAL shared memory block from RTAPI */
-	lib_mem_id = rtapi_shmem_new(HAL_KEY, lib_module_id, HAL_SIZE);
+	lib_mem_id = map_hal_shmem(&mem, &size);
 	if (lib_mem_id < 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: could not open shared memory\n");
 	    rtapi_exit(lib_module_id);
 	    return -EINVAL;
 	}
-	/* get address of shared memory area */
-	retval = rtapi_shmem_getptr(lib_mem_id, &mem);
-	if (retval < 0) {
-	    rtapi_print_msg(RTAPI_MSG_ERR,
-		"HAL: ERROR: could not access shared memory\n");
-	    rtapi_exit(lib_module_id);
-	    return -EINVAL;
-	}
 	/* set up internal pointers to shared mem and data structure */
         hal_shmem_base = (char *) mem;
         hal_data = (hal_data_t *) mem;
 	/* perform a global init if needed */
-	retval = init_hal_data();
+	retval = init_hal_data(size);
 	if ( retval ) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: could not init shared memory\n");
@@ -231,11 +292,11 @@ int hal_init(const char *name)
 	return -EINVAL;
     }
     /* get mutex before manipulating the shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* make sure name is unique in the system */
     if (halpr_find_comp_by_name(hal_name) != 0) {
 	/* a component with this name already exists */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: duplicate component name '%s'\n", hal_name);
 	rtapi_exit(comp_id);
@@ -245,7 +306,7 @@ int hal_init(const char *name)
     comp = halpr_alloc_comp_struct();
     if (comp == 0) {
 	/* couldn't allocate structure */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for component '%s'\n", hal_name);
 	rtapi_exit(comp_id);
@@ -268,7 +329,7 @@ int hal_init(const char *name)
     comp->next_ptr = hal_data->comp_list_ptr;
     hal_data->comp_list_ptr = SHMOFF(comp);
     /* done with list, release mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* done */
     rtapi_print_msg(RTAPI_MSG_DBG,
 	"HAL: component '%s' initialized, ID = %02d\n", hal_name, comp_id);
@@ -289,13 +350,13 @@ int hal_exit(int comp_id)
     }
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: removing component %02d\n", comp_id);
     /* grab mutex before manipulating list */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search component list for 'comp_id' */
     prev = &(hal_data->comp_list_ptr);
     next = *prev;
     if (next == 0) {
 	/* list is empty - should never happen, but... */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
@@ -307,7 +368,7 @@ int hal_exit(int comp_id)
 	next = *prev;
 	if (next == 0) {
 	    /* reached end of list without finding component */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: component %d not found\n", comp_id);
 	    return -EINVAL;
@@ -320,6 +381,10 @@ int hal_exit(int comp_id)
     rtapi_snprintf(name, sizeof(name), "%s", comp->name);
     /* get rid of the component */
     free_comp_struct(comp);
+    ready_changed();
+    if (hal_data->threads_running) {
+	plan_threads();
+    }
 /*! \todo Another #if 0 */
 #if 0
     /*! \todo FIXME - this is the beginning of a two pronged approach to managing
@@ -338,7 +403,7 @@ int hal_exit(int comp_id)
     }
 #endif
     /* release mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     --ref_cnt;
 #ifdef ULAPI
     if(ref_cnt == 0) {
@@ -370,11 +435,11 @@ void *hal_malloc(long int size)
 	return 0;
     }
     /* get the mutex */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* allocate memory */
     retval = shmalloc_up(size);
     /* release the mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* check return value */
     if (retval == 0) {
 	rtapi_print_msg(RTAPI_MSG_DBG,
@@ -388,13 +453,13 @@ int hal_set_constructor(int comp_id, constructor make) {
     int next;
     hal_comp_t *comp;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
 
     /* search component list for 'comp_id' */
     next = hal_data->comp_list_ptr;
     if (next == 0) {
 	/* list is empty - should never happen, but... */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
@@ -406,7 +471,7 @@ int hal_set_constructor(int comp_id, constructor make) {
 	next = comp->next_ptr;
 	if (next == 0) {
 	    /* reached end of list without finding component */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: component %d not found\n", comp_id);
 	    return -EINVAL;
@@ -416,7 +481,7 @@ int hal_set_constructor(int comp_id, constructor make) {
     
     comp->make = make;
 
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 #endif
@@ -425,13 +490,13 @@ int hal_ready(int comp_id) {
     int next;
     hal_comp_t *comp;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
 
     /* search component list for 'comp_id' */
     next = hal_data->comp_list_ptr;
     if (next == 0) {
 	/* list is empty - should never happen, but... */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
@@ -443,7 +508,7 @@ int hal_ready(int comp_id) {
 	next = comp->next_ptr;
 	if (next == 0) {
 	    /* reached end of list without finding component */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: component %d not found\n", comp_id);
 	    return -EINVAL;
@@ -453,11 +518,12 @@ int hal_ready(int comp_id) {
     if(comp->ready > 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
                 "HAL: ERROR: Component '%s' already ready\n", comp->name);
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return -EINVAL;
     }
     comp->ready = 1;
-    rtapi_mutex_give(&(hal_data->mutex));
+    ready_changed();
+    halpr_mutex_give();
     return 0;
 }
 
@@ -465,10 +531,10 @@ char *hal_comp_name(int comp_id)
 {
     hal_comp_t *comp;
     char *result = NULL;
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     comp = halpr_find_comp_by_id(comp_id);
     if(comp) result = comp->name;
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return result;
 }
 
@@ -638,12 +704,12 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
 
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: creating pin '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* validate comp_id */
     comp = halpr_find_comp_by_id(comp_id);
     if (comp == 0) {
 	/* bad comp_id */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
@@ -651,13 +717,13 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
     /* validate passed in pointer - must point to HAL shmem */
     if (! SHMCHK(data_ptr_addr)) {
 	/* bad pointer */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: data_ptr_addr not in shared memory\n");
 	return -EINVAL;
     }
     if(comp->ready) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: pin_new called after hal_ready\n");
 	return -EINVAL;
@@ -666,7 +732,7 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
     new = alloc_pin_struct();
     if (new == 0) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for pin '%s'\n", name);
 	return -ENOMEM;
@@ -681,15 +747,25 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
     rtapi_snprintf(new->name, sizeof(new->name), "%s", name);
     /* make 'data_ptr' point to dummy signal */
     *data_ptr_addr = comp->shmem_base + SHMOFF(&(new->dummysig));
-    /* search list for 'name' and insert new structure */
+    /* search list for 'name' and insert new structure; names are
+       usually created in order, so start after the last one if we can */
+    hal_data->generation++;
     prev = &(hal_data->pin_list_ptr);
+    if (hal_data->pin_insert_hint != 0) {
+	ptr = SHMPTR(hal_data->pin_insert_hint);
+	if (strcmp(ptr->name, new->name) < 0) {
+	    prev = &(ptr->next_ptr);
+	}
+    }
     next = *prev;
     while (1) {
 	if (next == 0) {
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_pin(new);
+	    hal_data->pin_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	ptr = SHMPTR(next);
@@ -698,13 +774,15 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_pin(new);
+	    hal_data->pin_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	if (cmp == 0) {
 	    /* name already in list, can't insert */
 	    free_pin_struct(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: duplicate variable '%s'\n", name);
 	    return -EINVAL;
@@ -739,11 +817,11 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	}
     }
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     if (alias != NULL ) {
 	pin = halpr_find_pin_by_name(alias);
 	if ( pin != NULL ) {
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 	        "HAL: ERROR: duplicate pin/alias name '%s'\n", alias);
 	    return -EINVAL;
@@ -757,7 +835,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
        to succeed since at least one struct is on the free list. */
     oldname = halpr_alloc_oldname_struct();
     if ( oldname == NULL ) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for pin_alias\n");
 	return -EINVAL;
@@ -769,7 +847,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
     while (1) {
 	if (next == 0) {
 	    /* reached end of list, not found */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: pin '%s' not found\n", pin_name);
 	    return -EINVAL;
@@ -778,6 +856,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	if ( strcmp(pin->name, pin_name) == 0 ) {
 	    /* found it, unlink from list */
 	    *prev = pin->next_ptr;
+	    unhash_pin(pin);
 	    break;
 	}
 	if (pin->oldname != 0 ) {
@@ -785,6 +864,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	    if (strcmp(oldname->name, pin_name) == 0) {
 		/* found it, unlink from list */
 		*prev = pin->next_ptr;
+		unhash_pin(pin);
 		break;
 	    }
 	}
@@ -813,6 +893,8 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	}
     }
     /* insert pin back into list in proper place */
+    hash_pin(pin);
+    hal_data->generation++;
     prev = &(hal_data->pin_list_ptr);
     next = *prev;
     while (1) {
@@ -820,7 +902,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	    /* reached end of list, insert here */
 	    pin->next_ptr = next;
 	    *prev = SHMOFF(pin);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	ptr = SHMPTR(next);
@@ -829,7 +911,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	    /* found the right place for it, insert here */
 	    pin->next_ptr = next;
 	    *prev = SHMOFF(pin);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* didn't find it yet, look at next one */
@@ -868,10 +950,10 @@ int hal_signal_new(const char *name, hal_type_t type)
 
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: creating signal '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* check for an existing signal with the same name */
     if (halpr_find_sig_by_name(name) != 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: duplicate signal '%s'\n", name);
 	return -EINVAL;
@@ -891,7 +973,7 @@ int hal_signal_new(const char *name, hal_type_t type)
 	data_addr = shmalloc_up(sizeof(hal_float_t));
 	break;
     default:
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: illegal signal type %d'\n", type);
 	return -EINVAL;
@@ -901,7 +983,7 @@ int hal_signal_new(const char *name, hal_type_t type)
     new = alloc_sig_struct();
     if ((new == 0) || (data_addr == 0)) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for signal '%s'\n", name);
 	return -ENOMEM;
@@ -930,15 +1012,25 @@ int hal_signal_new(const char *name, hal_type_t type)
     new->writers = 0;
     new->bidirs = 0;
     rtapi_snprintf(new->name, sizeof(new->name), "%s", name);
-    /* search list for 'name' and insert new structure */
+    /* search list for 'name' and insert new structure; names are
+       usually created in order, so start after the last one if we can */
+    hal_data->generation++;
     prev = &(hal_data->sig_list_ptr);
+    if (hal_data->sig_insert_hint != 0) {
+	ptr = SHMPTR(hal_data->sig_insert_hint);
+	if (strcmp(ptr->name, new->name) < 0) {
+	    prev = &(ptr->next_ptr);
+	}
+    }
     next = *prev;
     while (1) {
 	if (next == 0) {
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_sig(new);
+	    hal_data->sig_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	ptr = SHMPTR(next);
@@ -947,7 +1039,9 @@ int hal_signal_new(const char *name, hal_type_t type)
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_sig(new);
+	    hal_data->sig_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* didn't find it yet, look at next one */
@@ -975,7 +1069,7 @@ int hal_signal_delete(const char *name)
     
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: deleting signal '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search for the signal */
     prev = &(hal_data->sig_list_ptr);
     next = *prev;
@@ -987,7 +1081,7 @@ int hal_signal_delete(const char *name)
 	    /* and delete it */
 	    free_sig_struct(sig);
 	    /* done */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* no match, try the next one */
@@ -995,7 +1089,7 @@ int hal_signal_delete(const char *name)
 	next = *prev;
     }
     /* if we get here, we didn't find a match */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: signal '%s' not found\n",
 	name);
     return -EINVAL;
@@ -1032,12 +1126,12 @@ int hal_link(const char *pin_name, const char *sig_name)
     rtapi_print_msg(RTAPI_MSG_DBG,
 	"HAL: linking pin '%s' to '%s'\n", pin_name, sig_name);
     /* get mutex before accessing data structures */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* locate the pin */
     pin = halpr_find_pin_by_name(pin_name);
     if (pin == 0) {
 	/* not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: pin '%s' not found\n", pin_name);
 	return -EINVAL;
@@ -1046,21 +1140,21 @@ int hal_link(const char *pin_name, const char *sig_name)
     sig = halpr_find_sig_by_name(sig_name);
     if (sig == 0) {
 	/* not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: signal '%s' not found\n", sig_name);
 	return -EINVAL;
     }
     /* found both pin and signal, are they already connected? */
     if (SHMPTR(pin->signal) == sig) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_WARN,
 	    "HAL: Warning: pin '%s' already linked to '%s'\n", pin_name, sig_name);
 	return 0;
     }
     /* is the pin connected to something else? */
     if(pin->signal) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	sig = SHMPTR(pin->signal);
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: pin '%s' is linked to '%s', cannot link to '%s'\n",
@@ -1069,7 +1163,7 @@ int hal_link(const char *pin_name, const char *sig_name)
     }
     /* check types */
     if (pin->type != sig->type) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: type mismatch '%s' <- '%s'\n", pin_name, sig_name);
 	return -EINVAL;
@@ -1077,7 +1171,7 @@ int hal_link(const char *pin_name, const char *sig_name)
     /* linking output pin to sig that already has output or I/O pins? */
     if ((pin->dir == HAL_OUT) && ((sig->writers > 0) || (sig->bidirs > 0 ))) {
 	/* yes, can't do that */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: signal '%s' already has output or I/O pin(s)\n", sig_name);
 	return -EINVAL;
@@ -1085,7 +1179,7 @@ int hal_link(const char *pin_name, const char *sig_name)
     /* linking bidir pin to sig that already has output pin? */
     if ((pin->dir == HAL_IO) && (sig->writers > 0)) {
 	/* yes, can't do that */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: signal '%s' already has output pin\n", sig_name);
 	return -EINVAL;
@@ -1107,8 +1201,13 @@ int hal_link(const char *pin_name, const char *sig_name)
     }
     /* and update the pin */
     pin->signal = SHMOFF(sig);
+    hal_data->generation++;
+    /* while stopped, the plan is made once, by hal_start_threads() */
+    if (hal_data->threads_running) {
+	plan_threads();
+    }
     /* done, release the mutex and return */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -1135,20 +1234,23 @@ int hal_unlink(const char *pin_name)
     rtapi_print_msg(RTAPI_MSG_DBG,
 	"HAL: unlinking pin '%s'\n", pin_name);
     /* get mutex before accessing data structures */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* locate the pin */
     pin = halpr_find_pin_by_name(pin_name);
     if (pin == 0) {
 	/* not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: pin '%s' not found\n", pin_name);
 	return -EINVAL;
     }
     /* found pin, unlink it */
     unlink_pin(pin);
+    if (hal_data->threads_running) {
+	plan_threads();
+    }
     /* done, release the mutex and return */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -1281,12 +1383,12 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
 
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: creating parameter '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* validate comp_id */
     comp = halpr_find_comp_by_id(comp_id);
     if (comp == 0) {
 	/* bad comp_id */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
@@ -1294,13 +1396,13 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
     /* validate passed in pointer - must point to HAL shmem */
     if (! SHMCHK(data_addr)) {
 	/* bad pointer */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: data_addr not in shared memory\n");
 	return -EINVAL;
     }
     if(comp->ready) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: param_new called after hal_ready\n");
 	return -EINVAL;
@@ -1309,7 +1411,7 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
     new = alloc_param_struct();
     if (new == 0) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for parameter '%s'\n", name);
 	return -ENOMEM;
@@ -1320,15 +1422,25 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
     new->type = type;
     new->dir = dir;
     rtapi_snprintf(new->name, sizeof(new->name), "%s", name);
-    /* search list for 'name' and insert new structure */
+    /* search list for 'name' and insert new structure; names are
+       usually created in order, so start after the last one if we can */
+    hal_data->generation++;
     prev = &(hal_data->param_list_ptr);
+    if (hal_data->param_insert_hint != 0) {
+	ptr = SHMPTR(hal_data->param_insert_hint);
+	if (strcmp(ptr->name, new->name) < 0) {
+	    prev = &(ptr->next_ptr);
+	}
+    }
     next = *prev;
     while (1) {
 	if (next == 0) {
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_param(new);
+	    hal_data->param_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	ptr = SHMPTR(next);
@@ -1337,13 +1449,15 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    hash_param(new);
+	    hal_data->param_insert_hint = SHMOFF(new);
+	    halpr_mutex_give();
 	    return 0;
 	}
 	if (cmp == 0) {
 	    /* name already in list, can't insert */
 	    free_param_struct(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: duplicate parameter '%s'\n", name);
 	    return -EINVAL;
@@ -1397,27 +1511,27 @@ int hal_param_set(const char *name, hal_type_t type, void *value_addr)
     
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: setting parameter '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
 
     /* search param list for name */
     param = halpr_find_param_by_name(name);
     if (param == 0) {
 	/* parameter not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: parameter '%s' not found\n", name);
 	return -EINVAL;
     }
     /* found it, is type compatible? */
     if (param->type != type) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: type mismatch setting param '%s'\n", name);
 	return -EINVAL;
     }
     /* is it read only? */
     if (param->dir == HAL_RO) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: param '%s' is not writable\n", name);
 	return -EINVAL;
@@ -1443,12 +1557,12 @@ int hal_param_set(const char *name, hal_type_t type, void *value_addr)
 	break;
     default:
 	/* Shouldn't get here, but just in case... */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: bad type %d setting param\n", param->type);
 	return -EINVAL;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -1476,11 +1590,11 @@ int hal_param_alias(const char *param_name, const char *alias)
 	}
     }
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     if (alias != NULL ) {
 	param = halpr_find_param_by_name(alias);
 	if ( param != NULL ) {
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 	        "HAL: ERROR: duplicate pin/alias name '%s'\n", alias);
 	    return -EINVAL;
@@ -1494,7 +1608,7 @@ int hal_param_alias(const char *param_name, const char *alias)
        to succeed since at least one struct is on the free list. */
     oldname = halpr_alloc_oldname_struct();
     if ( oldname == NULL ) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for param_alias\n");
 	return -EINVAL;
@@ -1506,7 +1620,7 @@ int hal_param_alias(const char *param_name, const char *alias)
     while (1) {
 	if (next == 0) {
 	    /* reached end of list, not found */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: param '%s' not found\n", param_name);
 	    return -EINVAL;
@@ -1515,6 +1629,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	if ( strcmp(param->name, param_name) == 0 ) {
 	    /* found it, unlink from list */
 	    *prev = param->next_ptr;
+	    unhash_param(param);
 	    break;
 	}
 	if (param->oldname != 0 ) {
@@ -1522,6 +1637,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	    if (strcmp(oldname->name, param_name) == 0) {
 		/* found it, unlink from list */
 		*prev = param->next_ptr;
+		unhash_param(param);
 		break;
 	    }
 	}
@@ -1550,6 +1666,8 @@ int hal_param_alias(const char *param_name, const char *alias)
 	}
     }
     /* insert param back into list in proper place */
+    hash_param(param);
+    hal_data->generation++;
     prev = &(hal_data->param_list_ptr);
     next = *prev;
     while (1) {
@@ -1557,7 +1675,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	    /* reached end of list, insert here */
 	    param->next_ptr = next;
 	    *prev = SHMOFF(param);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	ptr = SHMPTR(next);
@@ -1566,7 +1684,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	    /* found the right place for it, insert here */
 	    param->next_ptr = next;
 	    *prev = SHMOFF(param);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* didn't find it yet, look at next one */
@@ -1608,25 +1726,25 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
     
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: exporting function '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* validate comp_id */
     comp = halpr_find_comp_by_id(comp_id);
     if (comp == 0) {
 	/* bad comp_id */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d not found\n", comp_id);
 	return -EINVAL;
     }
     if (comp->type == 0) {
 	/* not a realtime component */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: component %d is not realtime\n", comp_id);
 	return -EINVAL;
     }
     if(comp->ready) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: export_funct called after hal_ready\n");
 	return -EINVAL;
@@ -1635,7 +1753,7 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
     new = alloc_funct_struct();
     if (new == 0) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for function '%s'\n", name);
 	return -ENOMEM;
@@ -1671,7 +1789,7 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
 	if (cmp == 0) {
 	    /* name already in list, can't insert */
 	    free_funct_struct(new);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: duplicate function '%s'\n", name);
 	    return -EINVAL;
@@ -1681,10 +1799,11 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
 	next = *prev;
     }
     /* at this point we have a new function and can yield the mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* init time logging variables */
     new->runtime = 0;
     new->maxtime = 0;
+    clear_funct_stats(new);
     /* note that failure to successfully create the following params
        does not cause the "export_funct()" call to fail - they are
        for debugging and testing use only */
@@ -1694,10 +1813,24 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
     /* create a parameter with the function's maximum runtime in it */
     rtapi_snprintf(buf, sizeof(buf), "%s.tmax", name);
     hal_param_s32_new(buf, HAL_RW, &(new->maxtime), comp_id);
+    /* and the shortest one, and how many runs the statistics cover */
+    rtapi_snprintf(buf, sizeof(buf), "%s.tmin", name);
+    hal_param_s32_new(buf, HAL_RO, &(new->mintime), comp_id);
+    rtapi_snprintf(buf, sizeof(buf), "%s.calls", name);
+    hal_param_u32_new(buf, HAL_RO, &(new->calls), comp_id);
+    /* setting this clears tmin, calls and the histogram */
+    rtapi_snprintf(buf, sizeof(buf), "%s.reset", name);
+    hal_param_bit_new(buf, HAL_RW, &(new->reset), comp_id);
     return 0;
 }
 
 int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
+{
+    return hal_create_thread_cpu(name, period_nsec, uses_fp, -1);
+}
+
+int hal_create_thread_cpu(const char *name, unsigned long period_nsec,
+    int uses_fp, int cpu)
 {
     int next, cmp, prev_priority;
     int retval, n;
@@ -1733,7 +1866,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     }
 
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* make sure name is unique on thread list */
     next = hal_data->thread_list_ptr;
     while (next != 0) {
@@ -1741,7 +1874,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
 	cmp = strcmp(tptr->name, name);
 	if (cmp == 0) {
 	    /* name already in list, can't insert */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: duplicate thread name %s\n", name);
 	    return -EINVAL;
@@ -1753,7 +1886,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     new = alloc_thread_struct();
     if (new == 0) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory to create thread\n");
 	return -ENOMEM;
@@ -1770,7 +1903,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
 	    /* not running, start it */
 	    curr_period = rtapi_clock_set_period(period_nsec);
 	    if (curr_period < 0) {
-		rtapi_mutex_give(&(hal_data->mutex));
+		halpr_mutex_give();
 		rtapi_print_msg(RTAPI_MSG_ERR,
 		    "HAL_LIB: ERROR: clock_set_period returned %ld\n",
 		    curr_period);
@@ -1779,7 +1912,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
 	}
 	/* make sure period <= desired period (allow 1% roundoff error) */
 	if (curr_period > (period_nsec + (period_nsec / 100))) {
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL_LIB: ERROR: clock period too long: %ld\n", curr_period);
 	    return -EINVAL;
@@ -1801,7 +1934,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
 	prev_priority = tptr->priority;
     }
     if ( period_nsec < hal_data->base_period) { 
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: ERROR: new thread period %ld is less than clock period %ld\n",
 	     period_nsec, hal_data->base_period);
@@ -1811,7 +1944,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     n = (period_nsec + hal_data->base_period / 2) / hal_data->base_period;
     new->period = hal_data->base_period * n;
     if ( new->period < prev_period ) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: ERROR: new thread period %ld is less than existing thread period %ld\n",
 	     period_nsec, prev_period);
@@ -1820,10 +1953,10 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     /* make priority one lower than previous */
     new->priority = rtapi_prio_next_lower(prev_priority);
     /* create task - owned by library module, not caller */
-    retval = rtapi_task_new(thread_task, new, new->priority,
-	lib_module_id, HAL_STACKSIZE, uses_fp);
+    retval = rtapi_task_new_cpu(thread_task, new, new->priority,
+	lib_module_id, HAL_STACKSIZE, uses_fp, cpu);
     if (retval < 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: could not create task for thread %s\n", name);
 	return -EINVAL;
@@ -1832,7 +1965,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     /* start task */
     retval = rtapi_task_start(new->task_id, new->period);
     if (retval < 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: could not start task for thread %s: %d\n", name, retval);
 	return -EINVAL;
@@ -1841,7 +1974,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     new->next_ptr = hal_data->thread_list_ptr;
     hal_data->thread_list_ptr = SHMOFF(new);
     /* done, release mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* init time logging variables */
     new->runtime = 0;
     new->maxtime = 0;
@@ -1863,6 +1996,69 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     return 0;
 }
 
+int hal_thread_add_worker(const char *name, int cpu)
+{
+    hal_thread_t *thread;
+    int retval;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: thread_add_worker called before init\n");
+	return -EINVAL;
+    }
+#ifdef SIM
+    /* simulator tasks take turns on one CPU, so a helper could only
+       get in the way */
+    rtapi_print_msg(RTAPI_MSG_ERR,
+	"HAL: ERROR: thread helpers are not supported by the simulator\n");
+    return -ENOSYS;
+#endif
+    rtapi_print_msg(RTAPI_MSG_DBG,
+	"HAL: adding helper on CPU %d to thread %s\n", cpu, name);
+    /* get mutex before accessing shared data */
+    halpr_mutex_get();
+    thread = halpr_find_thread_by_name(name);
+    if (thread == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: thread '%s' not found\n", name);
+	return -EINVAL;
+    }
+    if (thread->workers == HAL_MAX_WORKERS) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: thread '%s' already has %d helpers\n", name,
+	    HAL_MAX_WORKERS);
+	return -EINVAL;
+    }
+    /* create task - owned by library module, not caller */
+    retval = rtapi_task_new_cpu(worker_task, thread, thread->priority,
+	lib_module_id, HAL_STACKSIZE, thread->uses_fp, cpu);
+    if (retval < 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL_LIB: could not create helper task for thread %s\n", name);
+	return -EINVAL;
+    }
+    /* the task looks itself up in worker_id[], so record it first */
+    thread->worker_id[thread->workers] = retval;
+    retval = rtapi_task_start(retval, thread->period);
+    if (retval < 0) {
+	rtapi_task_delete(thread->worker_id[thread->workers]);
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL_LIB: could not start helper task for thread %s: %d\n",
+	    name, retval);
+	return -EINVAL;
+    }
+    thread->workers++;
+    if (hal_data->threads_running) {
+	plan_threads();
+    }
+    halpr_mutex_give();
+    return 0;
+}
+
 extern int hal_thread_delete(const char *name)
 {
     hal_thread_t *thread;
@@ -1882,7 +2078,7 @@ extern int hal_thread_delete(const char *name)
     
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: deleting thread '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search for the signal */
     prev = &(hal_data->thread_list_ptr);
     next = *prev;
@@ -1894,7 +2090,7 @@ extern int hal_thread_delete(const char *name)
 	    /* and delete it */
 	    free_thread_struct(thread);
 	    /* done */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* no match, try the next one */
@@ -1902,7 +2098,7 @@ extern int hal_thread_delete(const char *name)
 	next = *prev;
     }
     /* if we get here, we didn't find a match */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: thread '%s' not found\n",
 	name);
     return -EINVAL;
@@ -1934,25 +2130,25 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
 	"HAL: adding function '%s' to thread '%s'\n",
 	funct_name, thread_name);
     /* get mutex before accessing data structures */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* make sure position is valid */
     if (position == 0) {
 	/* zero is not allowed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: bad position: 0\n");
 	return -EINVAL;
     }
     /* make sure we were given a function name */
     if (funct_name == 0) {
 	/* no name supplied */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: missing function name\n");
 	return -EINVAL;
     }
     /* make sure we were given a thread name */
     if (thread_name == 0) {
 	/* no name supplied */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: missing thread name\n");
 	return -EINVAL;
     }
@@ -1960,14 +2156,14 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
     funct = halpr_find_funct_by_name(funct_name);
     if (funct == 0) {
 	/* function not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: function '%s' not found\n", funct_name);
 	return -EINVAL;
     }
     /* found the function, is it available? */
     if ((funct->users > 0) && (funct->reentrant == 0)) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: function '%s' may only be added to one thread\n", funct_name);
 	return -EINVAL;
@@ -1976,14 +2172,14 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
     thread = halpr_find_thread_by_name(thread_name);
     if (thread == 0) {
 	/* thread not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: thread '%s' not found\n", thread_name);
 	return -EINVAL;
     }
     /* ok, we have thread and function, are they compatible? */
     if ((funct->uses_fp) && (!thread->uses_fp)) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: function '%s' needs FP\n", funct_name);
 	return -EINVAL;
@@ -1999,7 +2195,7 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
 	    list_entry = list_next(list_entry);
 	    if (list_entry == list_root) {
 		/* reached end of list */
-		rtapi_mutex_give(&(hal_data->mutex));
+		halpr_mutex_give();
 		rtapi_print_msg(RTAPI_MSG_ERR,
 		    "HAL: ERROR: position '%d' is too high\n", position);
 		return -EINVAL;
@@ -2012,7 +2208,7 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
 	    list_entry = list_prev(list_entry);
 	    if (list_entry == list_root) {
 		/* reached end of list */
-		rtapi_mutex_give(&(hal_data->mutex));
+		halpr_mutex_give();
 		rtapi_print_msg(RTAPI_MSG_ERR,
 		    "HAL: ERROR: position '%d' is too low\n", position);
 		return -EINVAL;
@@ -2025,7 +2221,7 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
     funct_entry = alloc_funct_entry_struct();
     if (funct_entry == 0) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for thread->function link\n");
 	return -ENOMEM;
@@ -2038,7 +2234,11 @@ int hal_add_funct_to_thread(const char *funct_name, const char *thread_name, int
     list_add_after((hal_list_t *) funct_entry, list_entry);
     /* update the function usage count */
     funct->users++;
-    rtapi_mutex_give(&(hal_data->mutex));
+    hal_data->generation++;
+    if (hal_data->threads_running) {
+	plan_threads();
+    }
+    halpr_mutex_give();
     return 0;
 }
 
@@ -2065,18 +2265,18 @@ int hal_del_funct_from_thread(const char *funct_name, const char *thread_name)
 	"HAL: removing function '%s' from thread '%s'\n",
 	funct_name, thread_name);
     /* get mutex before accessing data structures */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* make sure we were given a function name */
     if (funct_name == 0) {
 	/* no name supplied */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: missing function name\n");
 	return -EINVAL;
     }
     /* make sure we were given a thread name */
     if (thread_name == 0) {
 	/* no name supplied */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: missing thread name\n");
 	return -EINVAL;
     }
@@ -2084,14 +2284,14 @@ int hal_del_funct_from_thread(const char *funct_name, const char *thread_name)
     funct = halpr_find_funct_by_name(funct_name);
     if (funct == 0) {
 	/* function not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: function '%s' not found\n", funct_name);
 	return -EINVAL;
     }
     /* found the function, is it in use? */
     if (funct->users == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: function '%s' is not in use\n", funct_name);
 	return -EINVAL;
@@ -2100,7 +2300,7 @@ int hal_del_funct_from_thread(const char *funct_name, const char *thread_name)
     thread = halpr_find_thread_by_name(thread_name);
     if (thread == 0) {
 	/* thread not found */
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: thread '%s' not found\n", thread_name);
 	return -EINVAL;
@@ -2111,7 +2311,7 @@ int hal_del_funct_from_thread(const char *funct_name, const char *thread_name)
     while (1) {
 	if (list_entry == list_root) {
 	    /* reached end of list, funct not found */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"HAL: ERROR: thread '%s' doesn't use %s\n", thread_name,
 		funct_name);
@@ -2123,8 +2323,11 @@ int hal_del_funct_from_thread(const char *funct_name, const char *thread_name)
 	    list_remove_entry(list_entry);
 	    /* and delete it */
 	    free_funct_entry_struct(funct_entry);
+	    if (hal_data->threads_running) {
+		plan_threads();
+	    }
 	    /* done */
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return 0;
 	}
 	/* try next one */
@@ -2149,63 +2352,751 @@ int hal_start_threads(void)
 
 
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL: starting threads\n");
+    halpr_mutex_get();
+    plan_threads();
     hal_data->threads_running = 1;
+    halpr_mutex_give();
     return 0;
 }
 
-int hal_stop_threads(void)
+/* returns the size of the value of a signal of type 'type' */
+static int sig_data_size(hal_type_t type)
 {
-    /* wow, two in a row! */
+    switch (type) {
+    case HAL_BIT:
+	return sizeof(hal_bit_t);
+    case HAL_S32:
+	return sizeof(hal_s32_t);
+    case HAL_U32:
+	return sizeof(hal_u32_t);
+    case HAL_FLOAT:
+	return sizeof(hal_float_t);
+    default:
+	return sizeof(hal_data_u);
+    }
+}
+
+/* copies the value of 'sig' to 'used' bytes into the block at 'base',
+   and returns the new number of bytes used */
+static long int place_sig(hal_sig_t * sig, long int base, long int used)
+{
+    int size;
+
+    size = sig_data_size(sig->type);
+    used = (used + size - 1) & ~(long int) (size - 1);
+    memcpy(SHMPTR(base + used), SHMPTR(sig->data_ptr), size);
+    sig->data_ptr = base + used;
+    return used + size;
+}
+
+/* places the signals that pins of 'comp_ptr' in direction 'dir' are
+   linked to, if they have not been placed yet, and returns the new
+   number of bytes used, rounded up to a cache line if it changed */
+static long int place_comp_sigs(int comp_ptr, int writers, long int base,
+    long int used)
+{
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    long int start;
+    int next;
+
+    start = used;
+    next = hal_data->pin_list_ptr;
+    while (next != 0) {
+	pin = SHMPTR(next);
+	if (pin->owner_ptr == comp_ptr && pin->signal != 0
+	    && (writers ? pin->dir != HAL_IN : pin->dir == HAL_IN)) {
+	    sig = SHMPTR(pin->signal);
+	    /* the new block is above all the old values */
+	    if (sig->data_ptr < base) {
+		used = place_sig(sig, base, used);
+	    }
+	}
+	next = pin->next_ptr;
+    }
+    if (used != start) {
+	used = (used + HAL_CACHE_LINE - 1) & ~(long int) (HAL_CACHE_LINE - 1);
+    }
+    return used;
+}
+
+int hal_compact_signals(void)
+{
+    hal_thread_t *thread;
+    hal_list_t *list_root, *list_entry;
+    hal_funct_t *funct;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_comp_t *comp;
+    void **data_ptr_addr;
+    char *block;
+    long int size, base, used;
+    int next, next_thread, writers;
+
     if (hal_data == 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: stop_threads called before init\n");
+	    "HAL: ERROR: compact_signals called before init\n");
 	return -EINVAL;
     }
-
-    if (hal_data->lock & HAL_LOCK_RUN) {
+    if (hal_data->lock & HAL_LOCK_CONFIG) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: stop_threads called while HAL is locked\n");
+	    "HAL: ERROR: compact_signals called while HAL is locked\n");
 	return -EPERM;
     }
-
-    hal_data->threads_running = 0;
-    rtapi_print_msg(RTAPI_MSG_DBG, "HAL: threads stopped\n");
+    if (hal_data->threads_running) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: compact_signals called while threads are running\n");
+	return -EBUSY;
+    }
+    rtapi_print_msg(RTAPI_MSG_DBG, "HAL: compacting signals\n");
+    /* get mutex before accessing shared data */
+    halpr_mutex_get();
+    /* work out the most the new block can need: every value padded to
+       its size, two groups per function, plus the leftovers, each
+       rounded up to a cache line, and the alignment of the start */
+    size = 2 * HAL_CACHE_LINE;
+    next = hal_data->sig_list_ptr;
+    while (next != 0) {
+	sig = SHMPTR(next);
+	size += 2 * sig_data_size(sig->type);
+	next = sig->next_ptr;
+    }
+    next_thread = hal_data->thread_list_ptr;
+    while (next_thread != 0) {
+	thread = SHMPTR(next_thread);
+	list_root = &(thread->funct_list);
+	list_entry = list_next(list_root);
+	while (list_entry != list_root) {
+	    size += 2 * HAL_CACHE_LINE;
+	    list_entry = list_next(list_entry);
+	}
+	next_thread = thread->next_ptr;
+    }
+    block = shmalloc_up(size);
+    if (block == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: insufficient memory to compact signals\n");
+	return -ENOMEM;
+    }
+    base = (SHMOFF(block) + HAL_CACHE_LINE - 1) & ~(long int) (HAL_CACHE_LINE - 1);
+    used = 0;
+    /* first what each function writes, then what it only reads */
+    for (writers = 1; writers >= 0; writers--) {
+	next_thread = hal_data->thread_list_ptr;
+	while (next_thread != 0) {
+	    thread = SHMPTR(next_thread);
+	    list_root = &(thread->funct_list);
+	    list_entry = list_next(list_root);
+	    while (list_entry != list_root) {
+		funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+		used = place_comp_sigs(funct->owner_ptr, writers, base, used);
+		list_entry = list_next(list_entry);
+	    }
+	    next_thread = thread->next_ptr;
+	}
+    }
+    /* then everything else */
+    next = hal_data->sig_list_ptr;
+    while (next != 0) {
+	sig = SHMPTR(next);
+	if (sig->data_ptr < base) {
+	    used = place_sig(sig, base, used);
+	}
+	next = sig->next_ptr;
+    }
+    /* point every linked pin at the new copy of its signal */
+    next = hal_data->pin_list_ptr;
+    while (next != 0) {
+	pin = SHMPTR(next);
+	if (pin->signal != 0) {
+	    sig = SHMPTR(pin->signal);
+	    data_ptr_addr = SHMPTR(pin->data_ptr_addr);
+	    comp = SHMPTR(pin->owner_ptr);
+	    *data_ptr_addr = comp->shmem_base + sig->data_ptr;
+	}
+	next = pin->next_ptr;
+    }
+    /* anything holding on to the old addresses must look again */
+    hal_data->generation++;
+    halpr_mutex_give();
+    rtapi_print_msg(RTAPI_MSG_DBG,
+	"HAL: signals compacted into %ld bytes\n", used);
     return 0;
 }
 
-/***********************************************************************
-*                    PRIVATE FUNCTION CODE                             *
-************************************************************************/
-
-hal_list_t *list_prev(hal_list_t * entry)
+/* the stock components whose functions a fuse kernel can run: the
+   pins come first in 'items', in the order the kernel expects them,
+   followed by the params */
+static const struct {
+    const char *comp;
+    int type;
+    int npins;
+    const char *items[HAL_FUSE_MAX_ARGS];
+} fuse_patterns[] = {
+    { "and2", HAL_FUSE_AND2, 3, { "in0", "in1", "out" } },
+    { "or2", HAL_FUSE_OR2, 3, { "in0", "in1", "out" } },
+    { "not", HAL_FUSE_NOT, 2, { "in", "out" } },
+    { "mux2", HAL_FUSE_MUX2, 4, { "sel", "in0", "in1", "out" } },
+    { "scale", HAL_FUSE_SCALE, 4, { "in", "gain", "offset", "out" } },
+    { "sum2", HAL_FUSE_SUM2, 3,
+	{ "in0", "in1", "out", "gain0", "gain1", "offset" } },
+    { "conv_bit_s32", HAL_FUSE_BIT_S32, 2, { "in", "out" } },
+    { "conv_bit_u32", HAL_FUSE_BIT_U32, 2, { "in", "out" } },
+    { "conv_s32_float", HAL_FUSE_S32_FLOAT, 2, { "in", "out" } },
+    { "conv_u32_float", HAL_FUSE_U32_FLOAT, 2, { "in", "out" } },
+};
+
+#define FUSE_PATTERNS (sizeof(fuse_patterns) / sizeof(fuse_patterns[0]))
+
+/* fills in 'op' to do the work of 'funct', if it is the function of
+   one instance of a component listed above; returns 1 if so, else 0 */
+static int fuse_op(hal_funct_t * funct, hal_fuse_op_t * op)
 {
-    /* this function is only needed because of memory mapping */
-    return SHMPTR(entry->prev);
-}
+    hal_comp_t *comp;
+    hal_pin_t *pin;
+    hal_param_t *param;
+    char name[HAL_NAME_LEN + 1];
+    unsigned int n;
+    int i;
 
-hal_list_t *list_next(hal_list_t * entry)
-{
-    /* this function is only needed because of memory mapping */
-    return SHMPTR(entry->next);
+    comp = SHMPTR(funct->owner_ptr);
+    for (n = 0; n < FUSE_PATTERNS; n++) {
+	if (strcmp(comp->name, fuse_patterns[n].comp) == 0) {
+	    break;
+	}
+    }
+    if (n == FUSE_PATTERNS) {
+	return 0;
+    }
+    /* the function of a comp instance is named after the instance */
+    for (i = 0; i < HAL_FUSE_MAX_ARGS && fuse_patterns[n].items[i]; i++) {
+	rtapi_snprintf(name, sizeof(name), "%s.%s", funct->name,
+	    fuse_patterns[n].items[i]);
+	if (i < fuse_patterns[n].npins) {
+	    pin = halpr_find_pin_by_name(name);
+	    if (pin == 0 || pin->owner_ptr != funct->owner_ptr) {
+		return 0;
+	    }
+	    op->arg[i] = pin->data_ptr_addr;
+	} else {
+	    param = halpr_find_param_by_name(name);
+	    if (param == 0 || param->owner_ptr != funct->owner_ptr) {
+		return 0;
+	    }
+	    op->arg[i] = param->data_ptr;
+	}
+    }
+    op->type = fuse_patterns[n].type;
+    op->funct_ptr = SHMOFF(funct);
+    return 1;
 }
 
-void list_init_entry(hal_list_t * entry)
+/* finds a fuse kernel that is not in use and can run in 'thread' */
+static hal_fuse_t *find_free_fuse(hal_thread_t * thread)
 {
-    int entry_n;
+    hal_fuse_t *fuse;
+    hal_funct_t *funct;
+    int next;
 
-    entry_n = SHMOFF(entry);
-    entry->next = entry_n;
-    entry->prev = entry_n;
+    next = hal_data->fuse_list_ptr;
+    while (next != 0) {
+	fuse = SHMPTR(next);
+	funct = SHMPTR(fuse->funct_ptr);
+	if (fuse->thread_ptr == 0 && funct->users == 0
+	    && (thread->uses_fp || !funct->uses_fp)) {
+	    return fuse;
+	}
+	next = fuse->next_ptr;
+    }
+    return 0;
 }
 
-void list_add_after(hal_list_t * entry, hal_list_t * prev)
+int hal_fuse_thread(const char *thread_name)
 {
-    int entry_n, prev_n, next_n;
-    hal_list_t *next;
+    hal_thread_t *thread;
+    hal_list_t *list_root, *list_entry, *run_start, *next_entry;
+    hal_funct_entry_t *funct_entry;
+    hal_funct_t *funct;
+    hal_fuse_t *fuse;
+    hal_fuse_op_t op;
+    int len, n, fused;
 
-    /* messiness needed because of memory mapping */
-    entry_n = SHMOFF(entry);
-    prev_n = SHMOFF(prev);
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: fuse_thread called before init\n");
+	return -EINVAL;
+    }
+    if (hal_data->lock & HAL_LOCK_CONFIG) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: fuse_thread called while HAL is locked\n");
+	return -EPERM;
+    }
+    if (hal_data->threads_running) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: fuse_thread called while threads are running\n");
+	return -EBUSY;
+    }
+    halpr_mutex_get();
+    thread = halpr_find_thread_by_name(thread_name);
+    if (thread == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: thread '%s' not found\n", thread_name);
+	return -EINVAL;
+    }
+    list_root = &(thread->funct_list);
+    list_entry = list_next(list_root);
+    fused = 0;
+    while (list_entry != list_root) {
+	/* measure the run of fusable functions starting here */
+	run_start = list_entry;
+	len = 0;
+	while (list_entry != list_root && len < HAL_FUSE_MAX_OPS) {
+	    funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+	    if (!fuse_op(funct, &op)) {
+		break;
+	    }
+	    len++;
+	    list_entry = list_next(list_entry);
+	}
+	if (len < 2) {
+	    /* nothing to gain from a kernel for one function */
+	    if (len == 0) {
+		list_entry = list_next(list_entry);
+	    }
+	    continue;
+	}
+	fuse = find_free_fuse(thread);
+	if (fuse == 0) {
+	    rtapi_print_msg(RTAPI_MSG_INFO,
+		"HAL: no free fuse kernel for the rest of thread '%s'\n",
+		thread_name);
+	    break;
+	}
+	funct_entry = alloc_funct_entry_struct();
+	if (funct_entry == 0) {
+	    halpr_mutex_give();
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: insufficient memory for thread->function link\n");
+	    return -ENOMEM;
+	}
+	/* build the table, and take the functions out of the thread */
+	list_entry = run_start;
+	for (n = 0; n < len; n++) {
+	    next_entry = list_next(list_entry);
+	    funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+	    fuse_op(funct, &(fuse->op[n]));
+	    if (n == 0) {
+		/* the kernel goes where the run started */
+		list_add_before((hal_list_t *) funct_entry, list_entry);
+	    }
+	    list_remove_entry(list_entry);
+	    free_funct_entry_struct((hal_funct_entry_t *) list_entry);
+	    /* the kernel still runs it */
+	    funct->users++;
+	    list_entry = next_entry;
+	}
+	fuse->nops = len;
+	fuse->thread_ptr = SHMOFF(thread);
+	funct = SHMPTR(fuse->funct_ptr);
+	funct_entry->funct_ptr = fuse->funct_ptr;
+	funct_entry->arg = funct->arg;
+	funct_entry->funct = funct->funct;
+	funct->users++;
+	fused += len;
+	rtapi_print_msg(RTAPI_MSG_DBG,
+	    "HAL: %s runs %d functions of thread '%s'\n", funct->name, len,
+	    thread_name);
+    }
+    hal_data->generation++;
+    halpr_mutex_give();
+    return fused;
+}
+
+int hal_unfuse_thread(const char *thread_name)
+{
+    hal_thread_t *thread;
+    hal_list_t *list_root, *list_entry;
+    hal_funct_entry_t *funct_entry;
+    hal_funct_t *funct;
+    hal_fuse_t *fuse;
+    int next, n, restored;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: unfuse_thread called before init\n");
+	return -EINVAL;
+    }
+    if (hal_data->lock & HAL_LOCK_CONFIG) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: unfuse_thread called while HAL is locked\n");
+	return -EPERM;
+    }
+    if (hal_data->threads_running) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: unfuse_thread called while threads are running\n");
+	return -EBUSY;
+    }
+    halpr_mutex_get();
+    thread = halpr_find_thread_by_name(thread_name);
+    if (thread == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: thread '%s' not found\n", thread_name);
+	return -EINVAL;
+    }
+    list_root = &(thread->funct_list);
+    restored = 0;
+    next = hal_data->fuse_list_ptr;
+    while (next != 0) {
+	fuse = SHMPTR(next);
+	next = fuse->next_ptr;
+	if (fuse->thread_ptr != SHMOFF(thread)) {
+	    continue;
+	}
+	/* find the kernel; if it was removed by hand, the functions
+	   go back at the end of the thread */
+	list_entry = list_next(list_root);
+	while (list_entry != list_root
+	    && ((hal_funct_entry_t *) list_entry)->funct_ptr != fuse->funct_ptr) {
+	    list_entry = list_next(list_entry);
+	}
+	for (n = 0; n < fuse->nops; n++) {
+	    funct_entry = alloc_funct_entry_struct();
+	    if (funct_entry == 0) {
+		/* leave the kernel to run the rest */
+		fuse->nops -= n;
+		memmove(fuse->op, fuse->op + n, fuse->nops * sizeof(hal_fuse_op_t));
+		hal_data->generation++;
+		halpr_mutex_give();
+		rtapi_print_msg(RTAPI_MSG_ERR,
+		    "HAL: ERROR: insufficient memory for thread->function link\n");
+		return -ENOMEM;
+	    }
+	    funct = SHMPTR(fuse->op[n].funct_ptr);
+	    funct_entry->funct_ptr = fuse->op[n].funct_ptr;
+	    funct_entry->arg = funct->arg;
+	    funct_entry->funct = funct->funct;
+	    /* it takes over the reference the kernel held */
+	    list_add_before((hal_list_t *) funct_entry, list_entry);
+	    restored++;
+	}
+	if (list_entry != list_root) {
+	    list_remove_entry(list_entry);
+	    free_funct_entry_struct((hal_funct_entry_t *) list_entry);
+	}
+	fuse->nops = 0;
+	fuse->thread_ptr = 0;
+    }
+    hal_data->generation++;
+    halpr_mutex_give();
+    return restored;
+}
+
+int hal_stop_threads(void)
+{
+    /* wow, two in a row! */
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: stop_threads called before init\n");
+	return -EINVAL;
+    }
+
+    if (hal_data->lock & HAL_LOCK_RUN) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: stop_threads called while HAL is locked\n");
+	return -EPERM;
+    }
+
+    hal_data->threads_running = 0;
+    rtapi_print_msg(RTAPI_MSG_DBG, "HAL: threads stopped\n");
+    return 0;
+}
+
+#ifdef ULAPI
+struct hal_watch_t {
+    int count;			/* number of pins watched */
+    int alloc;			/* number of slots allocated */
+    int *pins;			/* offsets of the pin structs */
+    hal_data_u *last;		/* value of each pin when last looked at */
+};
+
+/* the value a pin reads, following the signal it is linked to */
+static hal_data_u *watch_data(hal_pin_t * pin)
+{
+    hal_sig_t *sig;
+
+    if (pin->signal == 0) {
+	return &pin->dummysig;
+    }
+    sig = SHMPTR(pin->signal);
+    return SHMPTR(sig->data_ptr);
+}
+
+/* compares 'data' with 'last' and copies it there; a signal only
+   has room for its own type, so never touch the whole union */
+static int watch_update(hal_pin_t * pin, hal_data_u * data,
+    hal_data_u * last)
+{
+    int changed;
+
+    switch (pin->type) {
+    case HAL_BIT:
+	changed = data->b != last->b;
+	last->b = data->b;
+	break;
+    case HAL_FLOAT:
+	changed = data->f != last->f;
+	last->f = data->f;
+	break;
+    default:
+	changed = data->s != last->s;
+	last->s = data->s;
+	break;
+    }
+    return changed;
+}
+
+static int watch_add(hal_watch_t * watch, hal_pin_t * pin)
+{
+    int n;
+    void *p;
+
+    if (watch->count == watch->alloc) {
+	n = watch->alloc ? watch->alloc * 2 : 32;
+	p = realloc(watch->pins, n * sizeof(int));
+	if (p == 0) {
+	    return -ENOMEM;
+	}
+	watch->pins = p;
+	p = realloc(watch->last, n * sizeof(hal_data_u));
+	if (p == 0) {
+	    return -ENOMEM;
+	}
+	watch->last = p;
+	watch->alloc = n;
+    }
+    watch->pins[watch->count] = SHMOFF(pin);
+    watch_update(pin, watch_data(pin), &watch->last[watch->count]);
+    watch->count++;
+    return 0;
+}
+
+/* counts the pins that changed and remembers their new values */
+static int watch_scan(hal_watch_t * watch)
+{
+    hal_pin_t *pin;
+    int n, changed;
+
+    changed = 0;
+    for (n = 0; n < watch->count; n++) {
+	pin = SHMPTR(watch->pins[n]);
+	changed += watch_update(pin, watch_data(pin), &watch->last[n]);
+    }
+    return changed;
+}
+
+hal_watch_t *hal_watch_new(void)
+{
+    hal_watch_t *watch;
+
+    watch = malloc(sizeof(hal_watch_t));
+    if (watch != 0) {
+	watch->count = 0;
+	watch->alloc = 0;
+	watch->pins = 0;
+	watch->last = 0;
+    }
+    return watch;
+}
+
+void hal_watch_delete(hal_watch_t * watch)
+{
+    if (watch != 0) {
+	free(watch->pins);
+	free(watch->last);
+	free(watch);
+    }
+}
+
+int hal_watch_pin(hal_watch_t * watch, const char *name)
+{
+    hal_pin_t *pin;
+    int retval;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: watch_pin called before init\n");
+	return -EINVAL;
+    }
+    halpr_mutex_get();
+    pin = halpr_find_pin_by_name(name);
+    if (pin == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: pin '%s' not found\n", name);
+	return -EINVAL;
+    }
+    retval = watch_add(watch, pin);
+    halpr_mutex_give();
+    return retval;
+}
+
+int hal_watch_comp(hal_watch_t * watch, int comp_id)
+{
+    hal_comp_t *comp;
+    hal_pin_t *pin;
+    int retval;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: watch_comp called before init\n");
+	return -EINVAL;
+    }
+    halpr_mutex_get();
+    comp = halpr_find_comp_by_id(comp_id);
+    if (comp == 0) {
+	halpr_mutex_give();
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: component %d not found\n", comp_id);
+	return -EINVAL;
+    }
+    retval = 0;
+    pin = halpr_find_pin_by_owner(comp, 0);
+    while (pin != 0 && retval == 0) {
+	if (pin->dir != HAL_OUT) {
+	    retval = watch_add(watch, pin);
+	}
+	pin = halpr_find_pin_by_owner(comp, pin);
+    }
+    halpr_mutex_give();
+    return retval;
+}
+
+static long long int watch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int hal_watch_wait(hal_watch_t * watch, long int timeout)
+{
+    long long int deadline, slice;
+    struct timespec ts;
+    unsigned int seq;
+    int changed, retval;
+
+    if (hal_data == 0) {
+	return -EINVAL;
+    }
+    deadline = timeout < 0 ? 0 : watch_now() + timeout;
+    __sync_fetch_and_add(&hal_data->watchers, 1);
+    while (1) {
+	/* read the sequence first, so a wakeup during the scan is kept */
+	seq = hal_data->watch_seq;
+	changed = watch_scan(watch);
+	if (changed > 0) {
+	    break;
+	}
+	if (timeout < 0) {
+	    slice = HAL_WATCH_NS;
+	} else {
+	    slice = deadline - watch_now();
+	    if (slice <= 0) {
+		break;
+	    }
+	}
+#ifdef HAL_WATCH_FUTEX
+	/* the threads wake us, unless they are stopped; then the
+	   slice bounds the wait, so pins set by halcmd are noticed */
+	if (slice > 10 * HAL_WATCH_NS) {
+	    slice = 10 * HAL_WATCH_NS;
+	}
+	ts.tv_sec = slice / 1000000000;
+	ts.tv_nsec = slice % 1000000000;
+	retval = syscall(SYS_futex, &hal_data->watch_seq, FUTEX_WAIT, seq,
+	    &ts, NULL, 0);
+#else
+	if (slice > HAL_WATCH_NS) {
+	    slice = HAL_WATCH_NS;
+	}
+	ts.tv_sec = 0;
+	ts.tv_nsec = slice;
+	retval = nanosleep(&ts, NULL);
+#endif
+	if (retval < 0 && errno == EINTR) {
+	    changed = -EINTR;
+	    break;
+	}
+    }
+    __sync_fetch_and_sub(&hal_data->watchers, 1);
+    return changed;
+}
+
+int halpr_wait_ready(unsigned int seq, long int timeout)
+{
+    struct timespec ts;
+    int retval;
+
+    if (hal_data == 0) {
+	return -EINVAL;
+    }
+#ifndef HAL_WATCH_FUTEX
+    if (timeout > 10000000) {
+	timeout = 10000000;
+    }
+#endif
+    ts.tv_sec = timeout / 1000000000;
+    ts.tv_nsec = timeout % 1000000000;
+#ifdef HAL_WATCH_FUTEX
+    retval = syscall(SYS_futex, &hal_data->ready_seq, FUTEX_WAIT, seq,
+	&ts, NULL, 0);
+#else
+    retval = hal_data->ready_seq != seq ? 0 : nanosleep(&ts, NULL);
+#endif
+    if (retval < 0 && errno == EINTR) {
+	return -EINTR;
+    }
+    return 0;
+}
+#endif /* ULAPI */
+
+/***********************************************************************
+*                    PRIVATE FUNCTION CODE                             *
+************************************************************************/
+
+hal_list_t *list_prev(hal_list_t * entry)
+{
+    /* this function is only needed because of memory mapping */
+    return SHMPTR(entry->prev);
+}
+
+hal_list_t *list_next(hal_list_t * entry)
+{
+    /* this function is only needed because of memory mapping */
+    return SHMPTR(entry->next);
+}
+
+void list_init_entry(hal_list_t * entry)
+{
+    int entry_n;
+
+    entry_n = SHMOFF(entry);
+    entry->next = entry_n;
+    entry->prev = entry_n;
+}
+
+void list_add_after(hal_list_t * entry, hal_list_t * prev)
+{
+    int entry_n, prev_n, next_n;
+    hal_list_t *next;
+
+    /* messiness needed because of memory mapping */
+    entry_n = SHMOFF(entry);
+    prev_n = SHMOFF(prev);
     next_n = prev->next;
     next = SHMPTR(next_n);
     /* insert the entry */
@@ -2249,6 +3140,40 @@ hal_list_t *list_remove_entry(hal_list_t * entry)
     return next;
 }
 
+#ifdef ULAPI
+static int batch_held = 0;	/* non-zero while a batch holds the mutex */
+
+void halpr_mutex_get(void)
+{
+    if (!batch_held) {
+	rtapi_mutex_get(&(hal_data->mutex));
+    }
+}
+
+void halpr_mutex_give(void)
+{
+    if (!batch_held) {
+	rtapi_mutex_give(&(hal_data->mutex));
+    }
+}
+
+void halpr_batch_begin(void)
+{
+    if (!batch_held) {
+	rtapi_mutex_get(&(hal_data->mutex));
+	batch_held = 1;
+    }
+}
+
+void halpr_batch_end(void)
+{
+    if (batch_held) {
+	batch_held = 0;
+	rtapi_mutex_give(&(hal_data->mutex));
+    }
+}
+#endif /* ULAPI */
+
 hal_comp_t *halpr_find_comp_by_name(const char *name)
 {
     int next;
@@ -2275,23 +3200,26 @@ hal_pin_t *halpr_find_pin_by_name(const char *name)
     hal_pin_t *pin;
     hal_oldname_t *oldname;
 
-    /* search pin list for 'name' */
-    next = hal_data->pin_list_ptr;
+    /* search the hash chain for 'name' */
+    next = hal_data->pin_hash[hal_name_hash(name) & (HAL_HASH_SIZE - 1)];
     while (next != 0) {
 	pin = SHMPTR(next);
 	if (strcmp(pin->name, name) == 0) {
 	    /* found a match */
 	    return pin;
 	}
-	if (pin->oldname != 0 ) {
-	    oldname = SHMPTR(pin->oldname);
-	    if (strcmp(oldname->name, name) == 0) {
-		/* found a match */
-		return pin;
-	    }
-	}
 	/* didn't find it yet, look at next one */
-	next = pin->next_ptr;
+	next = pin->hash_next;
+    }
+    /* not a current name, try the old names of aliased pins */
+    next = hal_data->pin_alias_hash[hal_name_hash(name) & (HAL_ALIAS_HASH_SIZE - 1)];
+    while (next != 0) {
+	oldname = SHMPTR(next);
+	if (strcmp(oldname->name, name) == 0) {
+	    /* found a match */
+	    return SHMPTR(oldname->owner_ptr);
+	}
+	next = oldname->hash_next;
     }
     /* if loop terminates, we reached end of list with no match */
     return 0;
@@ -2302,8 +3230,8 @@ hal_sig_t *halpr_find_sig_by_name(const char *name)
     int next;
     hal_sig_t *sig;
 
-    /* search signal list for 'name' */
-    next = hal_data->sig_list_ptr;
+    /* search the hash chain for 'name' */
+    next = hal_data->sig_hash[hal_name_hash(name) & (HAL_HASH_SIZE - 1)];
     while (next != 0) {
 	sig = SHMPTR(next);
 	if (strcmp(sig->name, name) == 0) {
@@ -2311,7 +3239,7 @@ hal_sig_t *halpr_find_sig_by_name(const char *name)
 	    return sig;
 	}
 	/* didn't find it yet, look at next one */
-	next = sig->next_ptr;
+	next = sig->hash_next;
     }
     /* if loop terminates, we reached end of list with no match */
     return 0;
@@ -2323,23 +3251,26 @@ hal_param_t *halpr_find_param_by_name(const char *name)
     hal_param_t *param;
     hal_oldname_t *oldname;
 
-    /* search parameter list for 'name' */
-    next = hal_data->param_list_ptr;
+    /* search the hash chain for 'name' */
+    next = hal_data->param_hash[hal_name_hash(name) & (HAL_HASH_SIZE - 1)];
     while (next != 0) {
 	param = SHMPTR(next);
 	if (strcmp(param->name, name) == 0) {
 	    /* found a match */
 	    return param;
 	}
-	if (param->oldname != 0 ) {
-	    oldname = SHMPTR(param->oldname);
-	    if (strcmp(oldname->name, name) == 0) {
-		/* found a match */
-		return param;
-	    }
-	}
 	/* didn't find it yet, look at next one */
-	next = param->next_ptr;
+	next = param->hash_next;
+    }
+    /* not a current name, try the old names of aliased params */
+    next = hal_data->param_alias_hash[hal_name_hash(name) & (HAL_ALIAS_HASH_SIZE - 1)];
+    while (next != 0) {
+	oldname = SHMPTR(next);
+	if (strcmp(oldname->name, name) == 0) {
+	    /* found a match */
+	    return SHMPTR(oldname->owner_ptr);
+	}
+	next = oldname->hash_next;
     }
     /* if loop terminates, we reached end of list with no match */
     return 0;
@@ -2588,8 +3519,14 @@ int rtapi_app_main(void)
 	rtapi_print_msg(RTAPI_MSG_ERR, "HAL_LIB: ERROR: rtapi init failed\n");
 	return -EINVAL;
     }
+    if (hal_size < (int) sizeof(hal_data_t)) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL_LIB: ERROR: hal_size=%d is too small\n", hal_size);
+	rtapi_exit(lib_module_id);
+	return -EINVAL;
+    }
     /* get HAL shared memory block from RTAPI */
-    lib_mem_id = rtapi_shmem_new(HAL_KEY, lib_module_id, HAL_SIZE);
+    lib_mem_id = rtapi_shmem_new(HAL_KEY, lib_module_id, hal_size);
     if (lib_mem_id < 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: ERROR: could not open shared memory\n");
@@ -2608,7 +3545,7 @@ int rtapi_app_main(void)
     hal_shmem_base = (char *) mem;
     hal_data = (hal_data_t *) mem;
     /* perform a global init if needed */
-    retval = init_hal_data();
+    retval = init_hal_data(hal_size);
     if ( retval ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL_LIB: ERROR: could not init shared memory\n");
@@ -2635,7 +3572,7 @@ void rtapi_app_exit(void)
     rtapi_print_msg(RTAPI_MSG_DBG, "HAL_LIB: removing kernel lib\n");
     hal_proc_clean();
     /* grab mutex before manipulating list */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* must remove all threads before unloading this module */
     while (hal_data->thread_list_ptr != 0) {
 	/* point to a thread */
@@ -2646,7 +3583,7 @@ void rtapi_app_exit(void)
 	free_thread_struct(thread);
     }
     /* release mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* release RTAPI resources */
     rtapi_shmem_delete(lib_mem_id, lib_module_id);
     rtapi_exit(lib_module_id);
@@ -2657,10 +3594,154 @@ void rtapi_app_exit(void)
 
 /* this is the task function that implements threads in realtime */
 
+/* returns the histogram bin for 'time': the number of significant
+   bits in it, found by binary search so it takes the same few steps
+   for any value */
+static inline int funct_hist_bin(hal_s32_t time)
+{
+    unsigned long t;
+    int bin;
+
+    if (time <= 0) {
+	return 0;
+    }
+    t = time;
+    bin = 1;
+    if (t >= 0x10000) {
+	t >>= 16;
+	bin += 16;
+    }
+    if (t >= 0x100) {
+	t >>= 8;
+	bin += 8;
+    }
+    if (t >= 0x10) {
+	t >>= 4;
+	bin += 4;
+    }
+    if (t >= 0x4) {
+	t >>= 2;
+	bin += 2;
+    }
+    if (t >= 0x2) {
+	bin += 1;
+    }
+    return bin;
+}
+
+static void clear_funct_stats(hal_funct_t * funct)
+{
+    int n;
+
+    funct->mintime = 0x7FFFFFFF;
+    funct->calls = 0;
+    funct->sumtime = 0;
+    for (n = 0; n < HAL_FUNCT_HIST_BINS; n++) {
+	funct->hist[n] = 0;
+    }
+    funct->reset = 0;
+}
+
+static void update_funct_stats(hal_funct_t * funct, hal_s32_t time)
+{
+    funct->runtime = time;
+    if (funct->runtime > funct->maxtime) {
+	funct->maxtime = funct->runtime;
+    }
+    if (funct->reset) {
+	clear_funct_stats(funct);
+    }
+    if (funct->runtime < funct->mintime) {
+	funct->mintime = funct->runtime;
+    }
+    funct->calls++;
+    funct->sumtime += funct->runtime;
+    funct->hist[funct_hist_bin(funct->runtime)]++;
+}
+
+/* claims and runs each function of 'stage' (any stage if negative)
+   that nobody else has taken yet this period */
+static void run_stage(hal_thread_t * thread, int stage)
+{
+    hal_list_t *list_root, *list_entry;
+    hal_funct_entry_t *funct_entry;
+    long long int start_time;
+
+    list_root = &(thread->funct_list);
+    list_entry = list_next(list_root);
+    while (list_entry != list_root) {
+	funct_entry = (hal_funct_entry_t *) list_entry;
+	if ((stage < 0 || funct_entry->stage == stage)
+	    && !test_and_set_bit(HAL_ENTRY_CLAIMED, &funct_entry->state)) {
+	    start_time = rtapi_get_clocks();
+	    funct_entry->funct(funct_entry->arg, thread->period);
+	    update_funct_stats(SHMPTR(funct_entry->funct_ptr),
+		(hal_s32_t)(rtapi_get_clocks() - start_time));
+	    test_and_set_bit(HAL_ENTRY_DONE, &funct_entry->state);
+	}
+	list_entry = list_next(list_entry);
+    }
+}
+
+/* waits until every claimed function of 'stage' (any stage if
+   negative) has finished */
+static void wait_for_stage(hal_thread_t * thread, int stage)
+{
+    hal_list_t *list_root, *list_entry;
+    hal_funct_entry_t *funct_entry;
+
+    list_root = &(thread->funct_list);
+    list_entry = list_next(list_root);
+    while (list_entry != list_root) {
+	funct_entry = (hal_funct_entry_t *) list_entry;
+	if (stage < 0 || funct_entry->stage == stage) {
+	    while (test_bit(HAL_ENTRY_CLAIMED, &funct_entry->state)
+		&& !test_bit(HAL_ENTRY_DONE, &funct_entry->state)) {
+		/* spin */
+	    }
+	}
+	list_entry = list_next(list_entry);
+    }
+}
+
+/* one period of a thread with helpers: the stages run in order, and
+   the thread takes whatever functions of each stage the helpers have
+   not, so it never depends on them turning up */
+static void run_parallel(hal_thread_t * thread)
+{
+    hal_list_t *list_root, *list_entry;
+    int stage, stages;
+
+    stages = thread->stages;
+    list_root = &(thread->funct_list);
+    /* a helper still busy with the last run could claim functions
+       out of turn once the claims are cleared, so wait for them */
+    while (thread->busy != 0) {
+	/* spin */
+    }
+    list_entry = list_next(list_root);
+    while (list_entry != list_root) {
+	((hal_funct_entry_t *) list_entry)->state = 0;
+	list_entry = list_next(list_entry);
+    }
+    /* x86 does not reorder stores, so a helper that sees the new stage
+       also sees the cleared claims, and the results of earlier stages */
+    thread->run_stage = 0;
+    thread->run_seq++;
+    for (stage = 0; stage < stages; stage++) {
+	thread->run_stage = stage;
+	run_stage(thread, stage);
+	wait_for_stage(thread, stage);
+    }
+    thread->run_stage = -1;
+    /* if the plan changed during the run, some may have been missed */
+    run_stage(thread, -1);
+    wait_for_stage(thread, -1);
+}
+
 static void thread_task(void *arg)
 {
     hal_thread_t *thread;
-    hal_funct_t *funct;
     hal_funct_entry_t *funct_root, *funct_entry;
     long long int start_time, end_time;
     long long int thread_start_time;
@@ -2675,19 +3756,21 @@ static void thread_task(void *arg)
 	    start_time = rtapi_get_clocks();
 	    end_time = start_time;
 	    thread_start_time = start_time;
-	    /* run thru function list */
-	    while (funct_entry != funct_root) {
+	    if (thread->stages > 0
+		&& thread->plan_generation == hal_data->generation) {
+		/* share the functions out with the helpers */
+		run_parallel(thread);
+		end_time = rtapi_get_clocks();
+	    }
+	    /* otherwise run thru function list */
+	    else while (funct_entry != funct_root) {
 		/* call the function */
 		funct_entry->funct(funct_entry->arg, thread->period);
 		/* capture execution time */
 		end_time = rtapi_get_clocks();
-		/* point to function structure */
-		funct = SHMPTR(funct_entry->funct_ptr);
 		/* update execution time data */
-		funct->runtime = (hal_s32_t)(end_time - start_time);
-		if (funct->runtime > funct->maxtime) {
-		    funct->maxtime = funct->runtime;
-		}
+		update_funct_stats(SHMPTR(funct_entry->funct_ptr),
+		    (hal_s32_t)(end_time - start_time));
 		/* point to next next entry in list */
 		funct_entry = SHMPTR(funct_entry->links.next);
 		/* prepare to measure time for next funct */
@@ -2698,6 +3781,65 @@ static void thread_task(void *arg)
 	    if (thread->runtime > thread->maxtime) {
 		thread->maxtime = thread->runtime;
 	    }
+#ifdef HAL_WATCH_FUTEX
+	    if (hal_data->watchers > 0) {
+		wake_watchers();
+	    }
+#endif
+	}
+	/* wait until next period */
+	rtapi_wait();
+    }
+}
+
+#ifdef HAL_WATCH_FUTEX
+static void wake_watchers(void)
+{
+    long long int now;
+
+    now = rtapi_get_time();
+    if (now - hal_data->watch_time < HAL_WATCH_NS) {
+	return;
+    }
+    /* two threads may get here at once; that only costs a wakeup */
+    hal_data->watch_time = now;
+    __sync_fetch_and_add(&hal_data->watch_seq, 1);
+    syscall(SYS_futex, &hal_data->watch_seq, FUTEX_WAKE, INT_MAX,
+	NULL, NULL, 0);
+}
+#endif
+
+static void worker_task(void *arg)
+{
+    hal_thread_t *thread;
+    long long int deadline;
+    int worker, seq, stage;
+
+    thread = arg;
+    /* find out which helper we are */
+    worker = 0;
+    while (worker < thread->workers
+	&& thread->worker_id[worker] != rtapi_task_self()) {
+	worker++;
+    }
+    seq = thread->run_seq;
+    while (1) {
+	if (hal_data->threads_running > 0) {
+	    /* the thread starts at about the same time; give it half a
+	       period, rather than miss the run or spin all period */
+	    deadline = rtapi_get_time() + thread->period / 2;
+	    while (thread->run_seq == seq && rtapi_get_time() < deadline) {
+		/* spin */
+	    }
+	    test_and_set_bit(worker, &thread->busy);
+	    seq = thread->run_seq;
+	    while ((stage = thread->run_stage) >= 0) {
+		run_stage(thread, stage);
+		while (thread->run_stage == stage) {
+		    /* spin */
+		}
+	    }
+	    clear_bit(worker, &thread->busy);
 	}
 	/* wait until next period */
 	rtapi_wait();
@@ -2709,7 +3851,178 @@ static void thread_task(void *arg)
    a description of what they do.
 */
 
-static int init_hal_data(void)
+static int plan_comp_index(int *comps, int ncomps, int comp_ptr)
+{
+    int n;
+
+    for (n = 0; n < ncomps; n++) {
+	if (comps[n] == comp_ptr) {
+	    return n;
+	}
+    }
+    return -1;
+}
+
+static void plan_thread(hal_thread_t * thread)
+{
+    hal_list_t *list_root, *list_entry, *prev_entry;
+    hal_funct_entry_t *funct_entry, *prev_funct;
+    hal_funct_t *funct;
+    hal_pin_t *pin, *other;
+    hal_fuse_t *fuse;
+    int comps[HAL_PLAN_MAX_COMPS];
+    unsigned long conflict[HAL_PLAN_MAX_COMPS];
+    int ncomps, count, stages, next, a, b;
+
+    /* run serially until the new plan is ready */
+    thread->stages = 0;
+    if (thread->workers == 0) {
+	return;
+    }
+    list_root = &(thread->funct_list);
+    /* find the components whose functions the thread runs */
+    ncomps = 0;
+    list_entry = list_next(list_root);
+    while (list_entry != list_root) {
+	funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+	if (plan_comp_index(comps, ncomps, funct->owner_ptr) < 0) {
+	    if (ncomps == HAL_PLAN_MAX_COMPS) {
+		/* too many to keep track of */
+		return;
+	    }
+	    comps[ncomps] = funct->owner_ptr;
+	    conflict[ncomps] = 0;
+	    ncomps++;
+	}
+	list_entry = list_next(list_entry);
+    }
+    /* note which of them share a signal that one of them writes */
+    next = hal_data->pin_list_ptr;
+    while (next != 0) {
+	pin = SHMPTR(next);
+	a = plan_comp_index(comps, ncomps, pin->owner_ptr);
+	if (a >= 0 && pin->signal != 0) {
+	    other = pin;
+	    while (other->next_ptr != 0) {
+		other = SHMPTR(other->next_ptr);
+		if (other->signal != pin->signal) {
+		    continue;
+		}
+		if (pin->dir == HAL_IN && other->dir == HAL_IN) {
+		    continue;
+		}
+		b = plan_comp_index(comps, ncomps, other->owner_ptr);
+		if (b >= 0) {
+		    conflict[a] |= 1UL << b;
+		    conflict[b] |= 1UL << a;
+		}
+	    }
+	}
+	next = pin->next_ptr;
+    }
+    /* a fuse kernel works on other components' pins, so order it
+       against everything */
+    next = hal_data->fuse_list_ptr;
+    while (next != 0) {
+	fuse = SHMPTR(next);
+	funct = SHMPTR(fuse->funct_ptr);
+	a = plan_comp_index(comps, ncomps, funct->owner_ptr);
+	if (a >= 0) {
+	    for (b = 0; b < ncomps; b++) {
+		conflict[a] |= 1UL << b;
+		conflict[b] |= 1UL << a;
+	    }
+	}
+	next = fuse->next_ptr;
+    }
+    /* put each function in the stage after the latest one ahead of it
+       that it depends on */
+    count = 0;
+    stages = 0;
+    list_entry = list_next(list_root);
+    while (list_entry != list_root) {
+	funct_entry = (hal_funct_entry_t *) list_entry;
+	funct = SHMPTR(funct_entry->funct_ptr);
+	a = plan_comp_index(comps, ncomps, funct->owner_ptr);
+	funct_entry->stage = 0;
+	prev_entry = list_next(list_root);
+	while (prev_entry != list_entry) {
+	    prev_funct = (hal_funct_entry_t *) prev_entry;
+	    funct = SHMPTR(prev_funct->funct_ptr);
+	    b = plan_comp_index(comps, ncomps, funct->owner_ptr);
+	    if ((a == b || (conflict[a] & (1UL << b)))
+		&& prev_funct->stage >= funct_entry->stage) {
+		funct_entry->stage = prev_funct->stage + 1;
+	    }
+	    prev_entry = list_next(prev_entry);
+	}
+	if (funct_entry->stage >= stages) {
+	    stages = funct_entry->stage + 1;
+	}
+	count++;
+	list_entry = list_next(list_entry);
+    }
+    if (stages == count) {
+	/* one function per stage, nothing to share out */
+	return;
+    }
+    thread->plan_generation = hal_data->generation;
+    thread->stages = stages;
+}
+
+static void plan_threads(void)
+{
+    int next;
+    hal_thread_t *thread;
+
+    next = hal_data->thread_list_ptr;
+    while (next != 0) {
+	thread = SHMPTR(next);
+	plan_thread(thread);
+	next = thread->next_ptr;
+    }
+}
+
+#ifdef ULAPI
+static int map_hal_shmem(void **mem, long int *size)
+{
+    int mem_id, retval;
+    char *env;
+
+    /* the realtime hal_lib normally creates the block, with its own
+       size; asking for just the header maps an existing block whole */
+    mem_id = rtapi_shmem_new(HAL_KEY, lib_module_id, sizeof(hal_data_t));
+    if (mem_id < 0) {
+	return mem_id;
+    }
+    retval = rtapi_shmem_getptr(mem_id, mem);
+    if (retval < 0) {
+	return retval;
+    }
+    if (((hal_data_t *) *mem)->version != 0) {
+	*size = ((hal_data_t *) *mem)->shmem_size;
+	return mem_id;
+    }
+    /* nobody set it up, so we just created it: make it full size */
+    rtapi_shmem_delete(mem_id, lib_module_id);
+    *size = HAL_SIZE;
+    env = getenv("HAL_SIZE");
+    if (env != NULL && atol(env) >= (long int) sizeof(hal_data_t)) {
+	*size = atol(env);
+    }
+    mem_id = rtapi_shmem_new(HAL_KEY, lib_module_id, *size);
+    if (mem_id < 0) {
+	return mem_id;
+    }
+    retval = rtapi_shmem_getptr(mem_id, mem);
+    if (retval < 0) {
+	return retval;
+    }
+    return mem_id;
+}
+#endif /* ULAPI */
+
+static int init_hal_data(long int size)
 {
     /* has the block already been initialized? */
     if (hal_data->version != 0) {
@@ -2748,10 +4061,25 @@ static int init_hal_data(void)
     hal_data->exact_base_period = 0;
     /* set up for shmalloc_xx() */
     hal_data->shmem_bot = sizeof(hal_data_t);
-    hal_data->shmem_top = HAL_SIZE;
+    hal_data->shmem_top = size;
+    hal_data->shmem_size = size;
     hal_data->lock = HAL_LOCK_NONE;
+    hal_data->generation = 0;
+    memset(hal_data->pin_hash, 0, sizeof(hal_data->pin_hash));
+    memset(hal_data->sig_hash, 0, sizeof(hal_data->sig_hash));
+    memset(hal_data->param_hash, 0, sizeof(hal_data->param_hash));
+    memset(hal_data->pin_alias_hash, 0, sizeof(hal_data->pin_alias_hash));
+    memset(hal_data->param_alias_hash, 0, sizeof(hal_data->param_alias_hash));
+    hal_data->pin_insert_hint = 0;
+    hal_data->sig_insert_hint = 0;
+    hal_data->param_insert_hint = 0;
+    hal_data->watch_seq = 0;
+    hal_data->watchers = 0;
+    hal_data->watch_time = 0;
+    hal_data->ready_seq = 0;
+    hal_data->fuse_list_ptr = 0;
     /* done, release mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -2859,12 +4187,14 @@ static hal_pin_t *alloc_pin_struct(void)
     if (p) {
 	/* make sure it's empty */
 	p->next_ptr = 0;
+	p->hash_next = 0;
 	p->data_ptr_addr = 0;
 	p->owner_ptr = 0;
 	p->type = 0;
 	p->dir = 0;
 	p->signal = 0;
 	memset(&p->dummysig, 0, sizeof(hal_data_u));
+	p->oldname = 0;
 	p->name[0] = '\0';
     }
     return p;
@@ -2888,6 +4218,7 @@ static hal_sig_t *alloc_sig_struct(void)
     if (p) {
 	/* make sure it's empty */
 	p->next_ptr = 0;
+	p->hash_next = 0;
 	p->data_ptr = 0;
 	p->type = 0;
 	p->readers = 0;
@@ -2916,8 +4247,10 @@ static hal_param_t *alloc_param_struct(void)
     if (p) {
 	/* make sure it's empty */
 	p->next_ptr = 0;
+	p->hash_next = 0;
 	p->data_ptr = 0;
 	p->owner_ptr = 0;
+	p->oldname = 0;
 	p->type = 0;
 	p->name[0] = '\0';
     }
@@ -2942,6 +4275,8 @@ static hal_oldname_t *halpr_alloc_oldname_struct(void)
     if (p) {
 	/* make sure it's empty */
 	p->next_ptr = 0;
+	p->hash_next = 0;
+	p->owner_ptr = 0;
 	p->name[0] = '\0';
     }
     return p;
@@ -3001,6 +4336,8 @@ static hal_funct_entry_t *alloc_funct_entry_struct(void)
 	p->funct_ptr = 0;
 	p->arg = 0;
 	p->funct = 0;
+	p->stage = 0;
+	p->state = 0;
     }
     return p;
 }
@@ -3029,12 +4366,27 @@ static hal_thread_t *alloc_thread_struct(void)
 	p->priority = 0;
 	p->task_id = 0;
 	list_init_entry(&(p->funct_list));
+	p->workers = 0;
+	p->stages = 0;
+	p->plan_generation = 0;
+	p->run_seq = 0;
+	p->run_stage = -1;
+	p->busy = 0;
 	p->name[0] = '\0';
     }
     return p;
 }
 #endif /* RTAPI */
 
+static void ready_changed(void)
+{
+    __sync_fetch_and_add(&hal_data->ready_seq, 1);
+#ifdef HAL_WATCH_FUTEX
+    syscall(SYS_futex, &hal_data->ready_seq, FUTEX_WAKE, INT_MAX,
+	NULL, NULL, 0);
+#endif
+}
+
 static void free_comp_struct(hal_comp_t * comp)
 {
     int *prev, next;
@@ -3135,6 +4487,7 @@ static void unlink_pin(hal_pin_t * pin)
 	}
 	/* mark pin as unlinked */
 	pin->signal = 0;
+	hal_data->generation++;
     }
 }
 
@@ -3142,8 +4495,11 @@ static void free_pin_struct(hal_pin_t * pin)
 {
 
     unlink_pin(pin);
+    unhash_pin(pin);
+    hal_data->generation++;
     /* clear contents of struct */
     if ( pin->oldname != 0 ) free_oldname_struct(SHMPTR(pin->oldname));
+    pin->oldname = 0;
     pin->data_ptr_addr = 0;
     pin->owner_ptr = 0;
     pin->type = 0;
@@ -3168,6 +4524,8 @@ static void free_sig_struct(hal_sig_t * sig)
 	/* check for another pin linked to the signal */
 	pin = halpr_find_pin_by_sig(sig, pin);
     }
+    unhash_sig(sig);
+    hal_data->generation++;
     /* clear contents of struct */
     sig->data_ptr = 0;
     sig->type = 0;
@@ -3182,8 +4540,11 @@ static void free_sig_struct(hal_sig_t * sig)
 
 static void free_param_struct(hal_param_t * p)
 {
+    unhash_param(p);
+    hal_data->generation++;
     /* clear contents of struct */
     if ( p->oldname != 0 ) free_oldname_struct(SHMPTR(p->oldname));
+    p->oldname = 0;
     p->data_ptr = 0;
     p->owner_ptr = 0;
     p->type = 0;
@@ -3202,7 +4563,143 @@ static void free_oldname_struct(hal_oldname_t * oldname)
     hal_data->oldname_free_ptr = SHMOFF(oldname);
 }
 
+static unsigned int hal_name_hash(const char *name)
+{
+    unsigned int h = 5381;
+
+    while (*name != '\0') {
+	h = h * 33 + (unsigned char) *name++;
+    }
+    return h;
+}
+
+/* add 'obj' to the front of its chain; 'link' is its hash_next field */
+static void hash_insert(int *table, int size, const char *name,
+    void *obj, int *link)
+{
+    int *bucket;
+
+    bucket = &table[hal_name_hash(name) & (size - 1)];
+    *link = *bucket;
+    *bucket = SHMOFF(obj);
+}
+
+/* remove 'obj' from its chain, if it is there; 'link' is its hash_next
+   field, which is at the same offset in every object in the chain */
+static void hash_remove(int *table, int size, const char *name,
+    void *obj, int *link)
+{
+    int *prev, offset;
+
+    offset = (char *) link - (char *) obj;
+    prev = &table[hal_name_hash(name) & (size - 1)];
+    while (*prev != 0) {
+	if (*prev == SHMOFF(obj)) {
+	    *prev = *link;
+	    *link = 0;
+	    return;
+	}
+	prev = (int *) ((char *) SHMPTR(*prev) + offset);
+    }
+}
+
+static void hash_pin(hal_pin_t * pin)
+{
+    hal_oldname_t *oldname;
+
+    hash_insert(hal_data->pin_hash, HAL_HASH_SIZE, pin->name, pin,
+	&(pin->hash_next));
+    if (pin->oldname != 0) {
+	oldname = SHMPTR(pin->oldname);
+	oldname->owner_ptr = SHMOFF(pin);
+	hash_insert(hal_data->pin_alias_hash, HAL_ALIAS_HASH_SIZE,
+	    oldname->name, oldname, &(oldname->hash_next));
+    }
+}
+
+static void unhash_pin(hal_pin_t * pin)
+{
+    hal_oldname_t *oldname;
+
+    hash_remove(hal_data->pin_hash, HAL_HASH_SIZE, pin->name, pin,
+	&(pin->hash_next));
+    if (pin->oldname != 0) {
+	oldname = SHMPTR(pin->oldname);
+	hash_remove(hal_data->pin_alias_hash, HAL_ALIAS_HASH_SIZE,
+	    oldname->name, oldname, &(oldname->hash_next));
+    }
+    /* it is no longer in the list, so can't be an insertion point */
+    if (hal_data->pin_insert_hint == SHMOFF(pin)) {
+	hal_data->pin_insert_hint = 0;
+    }
+}
+
+static void hash_sig(hal_sig_t * sig)
+{
+    hash_insert(hal_data->sig_hash, HAL_HASH_SIZE, sig->name, sig,
+	&(sig->hash_next));
+}
+
+static void unhash_sig(hal_sig_t * sig)
+{
+    hash_remove(hal_data->sig_hash, HAL_HASH_SIZE, sig->name, sig,
+	&(sig->hash_next));
+    if (hal_data->sig_insert_hint == SHMOFF(sig)) {
+	hal_data->sig_insert_hint = 0;
+    }
+}
+
+static void hash_param(hal_param_t * param)
+{
+    hal_oldname_t *oldname;
+
+    hash_insert(hal_data->param_hash, HAL_HASH_SIZE, param->name, param,
+	&(param->hash_next));
+    if (param->oldname != 0) {
+	oldname = SHMPTR(param->oldname);
+	oldname->owner_ptr = SHMOFF(param);
+	hash_insert(hal_data->param_alias_hash, HAL_ALIAS_HASH_SIZE,
+	    oldname->name, oldname, &(oldname->hash_next));
+    }
+}
+
+static void unhash_param(hal_param_t * param)
+{
+    hal_oldname_t *oldname;
+
+    hash_remove(hal_data->param_hash, HAL_HASH_SIZE, param->name, param,
+	&(param->hash_next));
+    if (param->oldname != 0) {
+	oldname = SHMPTR(param->oldname);
+	hash_remove(hal_data->param_alias_hash, HAL_ALIAS_HASH_SIZE,
+	    oldname->name, oldname, &(oldname->hash_next));
+    }
+    if (hal_data->param_insert_hint == SHMOFF(param)) {
+	hal_data->param_insert_hint = 0;
+    }
+}
+
 #ifdef RTAPI
+static void unfuse_funct(hal_funct_t * funct)
+{
+    hal_fuse_t *fuse;
+    int next, n, m;
+
+    next = hal_data->fuse_list_ptr;
+    while (next != 0) {
+	fuse = SHMPTR(next);
+	for (n = m = 0; n < fuse->nops; n++) {
+	    if (fuse->op[n].funct_ptr == SHMOFF(funct)) {
+		funct->users--;
+	    } else {
+		fuse->op[m++] = fuse->op[n];
+	    }
+	}
+	fuse->nops = m;
+	next = fuse->next_ptr;
+    }
+}
+
 static void free_funct_struct(hal_funct_t * funct)
 {
     int next_thread;
@@ -3212,6 +4709,8 @@ static void free_funct_struct(hal_funct_t * funct)
 
 /*  int next_thread, next_entry;*/
 
+    /* a fuse kernel that runs it must stop doing so */
+    unfuse_funct(funct);
     if (funct->users > 0) {
 	/* We can't casually delete the function, there are thread(s) which
 	   will call it.  So we must check all the threads and remove any
@@ -3271,6 +4770,8 @@ static void free_funct_entry_struct(hal_funct_entry_t * funct_entry)
     funct_entry->funct_ptr = 0;
     funct_entry->arg = 0;
     funct_entry->funct = 0;
+    funct_entry->stage = 0;
+    hal_data->generation++;
     /* add it to free list */
     list_add_after((hal_list_t *) funct_entry, &(hal_data->funct_entry_free));
 }
@@ -3292,6 +4793,15 @@ static void free_thread_struct(hal_thread_t * thread)
     /* and stop the task associated with this thread */
     rtapi_task_pause(thread->task_id);
     rtapi_task_delete(thread->task_id);
+    /* and those of its helpers */
+    while (thread->workers > 0) {
+	thread->workers--;
+	rtapi_task_pause(thread->worker_id[thread->workers]);
+	rtapi_task_delete(thread->worker_id[thread->workers]);
+    }
+    thread->stages = 0;
+    thread->run_stage = -1;
+    thread->busy = 0;
     /* clear contents of struct */
     thread->uses_fp = 0;
     thread->period = 0;
@@ -3393,14 +4903,20 @@ EXPORT_SYMBOL(hal_set_constructor);
 EXPORT_SYMBOL(hal_export_funct);
 
 EXPORT_SYMBOL(hal_create_thread);
+EXPORT_SYMBOL(hal_create_thread_cpu);
+EXPORT_SYMBOL(hal_thread_add_worker);
 
 EXPORT_SYMBOL(hal_add_funct_to_thread);
 EXPORT_SYMBOL(hal_del_funct_from_thread);
 
 EXPORT_SYMBOL(hal_start_threads);
 EXPORT_SYMBOL(hal_stop_threads);
+EXPORT_SYMBOL(hal_compact_signals);
+EXPORT_SYMBOL(hal_fuse_thread);
+EXPORT_SYMBOL(hal_unfuse_thread);
 
 EXPORT_SYMBOL(hal_shmem_base);
+EXPORT_SYMBOL(hal_data);
 EXPORT_SYMBOL(halpr_find_comp_by_name);
 EXPORT_SYMBOL(halpr_find_pin_by_name);
 EXPORT_SYMBOL(halpr_find_sig_by_name);
@@ -105,7 +105,7 @@ RTAPI_BEGIN_DECLS
    location that is part of the HAL shared memory block. */
 
 #define SHMCHK(ptr)  ( ((char *)(ptr)) > (hal_shmem_base) && \
-                       ((char *)(ptr)) < (hal_shmem_base + HAL_SIZE) )
+                       ((char *)(ptr)) < (hal_shmem_base + hal_data->shmem_size) )
 
 /** The good news is that none of this linked list complexity is
     visible to the components that use this API.  Complexity here
@@ -148,9 +148,18 @@ typedef struct {
 */
 typedef struct {
     int next_ptr;		/* next struct (used for free list only) */
+    int hash_next;		/* next old name in the same hash chain */
+    int owner_ptr;		/* pin or parameter that had this name */
     char name[HAL_NAME_LEN + 1];	/* the original name */
 } hal_oldname_t;
 
+/* Pins, signals and parameters are also chained by name hash, so that
+   lookups by name do not walk the (sorted) lists.  Old names of
+   aliased pins and parameters are hashed separately.  Sizes must be
+   powers of two. */
+#define HAL_HASH_SIZE		512
+#define HAL_ALIAS_HASH_SIZE	32
+
 /* Master HAL data structure
    There is a single instance of this structure in the machine.
    It resides at the base of the HAL shared memory block, where it
@@ -171,6 +180,7 @@ typedef struct {
 			        /* prefix of name for new instance */
     int shmem_bot;		/* bottom of free shmem (first free byte) */
     int shmem_top;		/* top of free shmem (1 past last free) */
+    int shmem_size;		/* size of the whole shmem block */
     int comp_list_ptr;		/* root of linked list of components */
     int pin_list_ptr;		/* root of linked list of pins */
     int sig_list_ptr;		/* root of linked list of signals */
@@ -190,6 +200,24 @@ typedef struct {
     int exact_base_period;      /* if set, pretend that rtapi satisfied our
 				   period request exactly */
     unsigned char lock;         /* hal locking, can be one of the HAL_LOCK_* types */
+    unsigned int generation;	/* incremented whenever a pin, signal or
+				   parameter is added, removed, renamed,
+				   linked or unlinked; lets users cache
+				   name lookups */
+    int pin_hash[HAL_HASH_SIZE];	/* hash chains of pins by name */
+    int sig_hash[HAL_HASH_SIZE];	/* hash chains of signals by name */
+    int param_hash[HAL_HASH_SIZE];	/* hash chains of params by name */
+    int pin_alias_hash[HAL_ALIAS_HASH_SIZE];	/* old names of pins */
+    int param_alias_hash[HAL_ALIAS_HASH_SIZE];	/* old names of params */
+    int pin_insert_hint;	/* last pin inserted in the pin list */
+    int sig_insert_hint;	/* last signal inserted in the signal list */
+    int param_insert_hint;	/* last param inserted in the param list */
+    unsigned int watch_seq;	/* bumped to wake hal_watch_wait() */
+    int watchers;		/* processes in hal_watch_wait() */
+    long long int watch_time;	/* when watch_seq was last bumped */
+    unsigned int ready_seq;	/* bumped when a component becomes ready
+				   or exits, to wake halpr_wait_ready() */
+    int fuse_list_ptr;		/* list of fuse kernels */
 } hal_data_t;
 
 /** HAL 'component' data structure.
@@ -215,6 +243,7 @@ typedef struct {
 */
 typedef struct {
     int next_ptr;		/* next pin in linked list */
+    int hash_next;		/* next pin in the same hash chain */
     int data_ptr_addr;		/* address of pin data pointer */
     int owner_ptr;		/* component that owns this pin */
     int signal;			/* signal to which pin is linked */
@@ -230,6 +259,7 @@ typedef struct {
 */
 typedef struct {
     int next_ptr;		/* next signal in linked list */
+    int hash_next;		/* next signal in the same hash chain */
     int data_ptr;		/* offset of signal value */
     hal_type_t type;		/* data type */
     int readers;		/* number of input pins linked */
@@ -243,6 +273,7 @@ typedef struct {
 */
 typedef struct {
     int next_ptr;		/* next parameter in linked list */
+    int hash_next;		/* next parameter in the same hash chain */
     int data_ptr;		/* offset of parameter value */
     int owner_ptr;		/* component that owns this signal */
     int oldname;		/* old name if aliased, else zero */
@@ -267,6 +298,12 @@ typedef struct {
     that identify the functions connected to that thread.
 */
 
+/* Each function keeps a histogram of its run times, in the same units
+   as 'runtime'.  Bin 'n' counts runs taking from 2^(n-1) up to 2^n - 1
+   (bin 0 counts runs of zero), so 32 bins cover any hal_s32_t time.
+*/
+#define HAL_FUNCT_HIST_BINS 32
+
 typedef struct {
     int next_ptr;		/* next function in linked list */
     int uses_fp;		/* floating point flag */
@@ -277,6 +314,11 @@ typedef struct {
     void (*funct) (void *, long);	/* ptr to function code */
     hal_s32_t runtime;		/* duration of last run, in nsec */
     hal_s32_t maxtime;		/* duration of longest run, in nsec */
+    hal_s32_t mintime;		/* duration of shortest run, in nsec */
+    hal_u32_t calls;		/* number of runs since the last reset */
+    hal_bit_t reset;		/* set to clear the statistics */
+    unsigned long long sumtime;	/* total duration of those runs */
+    hal_u32_t hist[HAL_FUNCT_HIST_BINS];	/* log2 runtime histogram */
     char name[HAL_NAME_LEN + 1];	/* function name */
 } hal_funct_t;
 
@@ -285,10 +327,42 @@ typedef struct {
     void *arg;			/* argument for function */
     void (*funct) (void *, long);	/* ptr to function code */
     int funct_ptr;		/* pointer to function */
+    int stage;			/* stage of a parallel run it belongs to */
+    volatile unsigned long state;	/* HAL_ENTRY_xxx bits, parallel runs */
 } hal_funct_entry_t;
 
+/* bit numbers in hal_funct_entry_t.state */
+#define HAL_ENTRY_CLAIMED 0	/* some task has taken it this period */
+#define HAL_ENTRY_DONE    1	/* and has finished running it */
+
 #define HAL_STACKSIZE 16384	/* realtime task stacksize */
 
+/* A thread can have helper tasks ('workers'), normally on other CPUs,
+   that share out its functions.  The functions are split into stages:
+   a function goes in the stage after the latest function ahead of it
+   in the list that it depends on, being one from the same component,
+   or one from a component it shares a signal with that either of them
+   writes.  Each period the thread and its workers run the stages in
+   order, the functions within a stage in any order and on any CPU.
+   Since dependent functions still run in list order, the results are
+   the same as running them one by one, provided components only pass
+   data to each other through HAL signals.  The plan is made with the
+   mutex held and is only used while 'plan_generation' matches the HAL
+   generation count; otherwise the thread runs its list serially.
+*/
+#define HAL_MAX_WORKERS 4	/* helper tasks per thread */
+#define HAL_CACHE_LINE 64	/* size hal_compact_signals() aligns groups to */
+#define HAL_PLAN_MAX_COMPS 32	/* components in a thread it can plan */
+
+/* Pin writes are plain stores, so HAL can not tell when a value
+   changes.  Instead hal_watch_wait() compares the watched pins with
+   their last values each time it wakes.  Under the simulator the
+   realtime threads wake it through a futex on 'watch_seq', at most
+   once every HAL_WATCH_NS while somebody is waiting; the realtime
+   kernels can not do that, so there it sleeps HAL_WATCH_NS at a time.
+*/
+#define HAL_WATCH_NS 5000000	/* how often watched pins are checked */
+
 typedef struct {
     int next_ptr;		/* next thread in linked list */
     int uses_fp;		/* floating point flag */
@@ -298,9 +372,56 @@ typedef struct {
     hal_s32_t runtime;		/* duration of last run, in nsec */
     hal_s32_t maxtime;		/* duration of longest run, in nsec */
     hal_list_t funct_list;	/* list of functions to run */
+    int workers;		/* number of helper tasks */
+    int worker_id[HAL_MAX_WORKERS];	/* task IDs of the helpers */
+    int stages;			/* stages in the plan, 0 to run serially */
+    unsigned int plan_generation;	/* HAL generation the plan is for */
+    volatile int run_seq;	/* bumped at the start of each parallel run */
+    volatile int run_stage;	/* stage being run, -1 between runs */
+    volatile unsigned long busy;	/* bit n set while helper n is working */
     char name[HAL_NAME_LEN + 1];	/* thread name */
 } hal_thread_t;
 
+/** HAL 'fuse kernel' data structure.
+    The 'fuse' module exports functions that each run a table of
+    operations.  hal_fuse_thread() turns a run of functions belonging
+    to simple stock components into one such table, and puts the
+    kernel in the thread in their place.  Each operation does the work
+    of one of those functions, on the same pins and parameters, so
+    every signal keeps being updated.  Arguments are the offsets of
+    the pin pointers (pin->data_ptr_addr) and parameter values
+    (param->data_ptr), in the order listed in hal_lib.c.
+*/
+#define HAL_FUSE_MAX_OPS 64	/* operations in one kernel */
+#define HAL_FUSE_MAX_ARGS 6	/* pins and params of one operation */
+
+typedef enum {
+    HAL_FUSE_AND2 = 1,
+    HAL_FUSE_OR2,
+    HAL_FUSE_NOT,
+    HAL_FUSE_MUX2,
+    HAL_FUSE_SCALE,
+    HAL_FUSE_SUM2,
+    HAL_FUSE_BIT_S32,
+    HAL_FUSE_BIT_U32,
+    HAL_FUSE_S32_FLOAT,
+    HAL_FUSE_U32_FLOAT
+} hal_fuse_op_type_t;
+
+typedef struct {
+    int type;			/* hal_fuse_op_type_t */
+    int arg[HAL_FUSE_MAX_ARGS];	/* offsets of pin pointers and params */
+    int funct_ptr;		/* the function this operation replaces */
+} hal_fuse_op_t;
+
+typedef struct {
+    int next_ptr;		/* next kernel in the list */
+    int funct_ptr;		/* the kernel's own function */
+    int thread_ptr;		/* thread it is fused into, 0 if free */
+    int nops;			/* number of operations in use */
+    hal_fuse_op_t op[HAL_FUSE_MAX_OPS];	/* the operations, in order */
+} hal_fuse_t;
+
 /* IMPORTANT:  If any of the structures in this file are changed, the
    version code (HAL_VER) must be incremented, to ensure that 
    incompatible utilities, etc, aren't used to manipulate data in
@@ -324,7 +445,12 @@ typedef struct {
 */
 
 #define HAL_KEY   0x48414C32	/* key used to open HAL shared memory */
-#define HAL_VER   0x0000000C	/* version code */
+#define HAL_VER   0x00000013	/* version code */
+
+/* Default size of the HAL shared memory block.  The realtime hal_lib
+   takes 'hal_size=<bytes>' to override it ('realtime start' passes
+   $HAL_SIZE, which linuxcnc sets from [HAL]HAL_SIZE); everything else
+   maps the block at whatever size it was created with. */
 #define HAL_SIZE  262000
 
 /* These pointers are set by hal_init() to point to the shmem block
@@ -342,6 +468,40 @@ extern hal_data_t *hal_data;
 *            PRIVATE HAL FUNCTIONS - NOT PART OF THE API               *
 ************************************************************************/
 
+/** 'halpr_mutex_get()' and 'halpr_mutex_give()' take and release
+    the HAL mutex.  All code in hal_lib and halcmd uses these instead
+    of calling rtapi_mutex_get() on hal_data->mutex directly, so that
+    a user process can hold the mutex across a batch of API calls.
+
+    'halpr_batch_begin()' gets the mutex and keeps it; until the
+    matching 'halpr_batch_end()' the get/give calls made by this
+    process do nothing.  While a batch is open no other HAL process
+    can run, so the batch must be ended before starting one (for
+    example loadrt or loadusr).  Batches are only available in user
+    space.
+*/
+#ifdef ULAPI
+extern void halpr_mutex_get(void);
+extern void halpr_mutex_give(void);
+extern void halpr_batch_begin(void);
+extern void halpr_batch_end(void);
+#else
+#define halpr_mutex_get() rtapi_mutex_get(&(hal_data->mutex))
+#define halpr_mutex_give() rtapi_mutex_give(&(hal_data->mutex))
+#endif
+
+#ifdef ULAPI
+/** 'halpr_wait_ready()' waits until some component calls hal_ready()
+    or hal_exit() after hal_data->ready_seq was 'seq', or 'timeout'
+    nanoseconds pass.  The caller reads ready_seq before looking at the
+    components, so nothing that happens while it looks is missed.
+    Under the simulator the wait is a futex on ready_seq; otherwise
+    realtime modules can not wake it, so it sleeps 10 ms at a time.
+    Returns 0, or -EINTR if a signal arrived.  Does not take the mutex.
+*/
+extern int halpr_wait_ready(unsigned int seq, long int timeout);
+#endif
+
 /** None of these functions get or release any mutex.  They all assume
     that the mutex has already been obtained.  Calling them without
     having the mutex may give incorrect results if other processes are
@@ -19,6 +19,7 @@
 #include <Python.h>
 #include <string>
 #include <map>
+#include <vector>
 using namespace std;
 
 #include "config.h"
@@ -80,8 +81,12 @@ typedef struct halobject {
     char *name;
     char *prefix;
     itemmap *items;
+    hal_watch_t *watch;
+    size_t watch_items;
 } halobject;
 
+static PyObject * pyhal_group_new(halobject *comp, PyObject *names);
+
 PyObject *pyhal_error_type = NULL;
 
 static PyObject *pyrtapi_error(int code) {
@@ -125,6 +130,9 @@ static int pyhal_init(PyObject *_self, PyObject *args, PyObject *kw) {
 
 static void pyhal_delete(PyObject *_self) {
     halobject *self = (halobject *)_self;
+    if(self->watch)
+        hal_watch_delete(self->watch);
+
     if(self->hal_id > 0) 
         hal_exit(self->hal_id);
 
@@ -392,6 +400,49 @@ static PyObject *pyhal_get_pin(PyObject *_self, PyObject *o) {
     return pyhal_pin_new(pin, name);
 }
 
+static PyObject *pyhal_group(PyObject *_self, PyObject *o) {
+    PyObject *names;
+    halobject *self = (halobject *)_self;
+
+    if(!PyArg_ParseTuple(o, "O", &names))
+        return NULL;
+    return pyhal_group_new(self, names);
+}
+
+static PyObject *pyhal_wait(PyObject *_self, PyObject *o) {
+    double timeout = -1;
+    int res;
+    halobject *self = (halobject *)_self;
+
+    if(!PyArg_ParseTuple(o, "|d", &timeout))
+        return NULL;
+
+    // watch all input pins, including any created since the last call
+    if(!self->watch || self->watch_items != self->items->size()) {
+        if(self->watch)
+            hal_watch_delete(self->watch);
+        self->watch = hal_watch_new();
+        if(!self->watch) {
+            PyErr_SetString(PyExc_MemoryError, "hal_watch_new failed");
+            return NULL;
+        }
+        res = hal_watch_comp(self->watch, self->hal_id);
+        if(res) return pyhal_error(res);
+        self->watch_items = self->items->size();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    res = hal_watch_wait(self->watch,
+            timeout < 0 ? -1 : (long)(timeout * 1e9));
+    Py_END_ALLOW_THREADS
+    if(res == -EINTR) {
+        if(PyErr_CheckSignals()) return NULL;
+        res = 0;
+    }
+    if(res < 0) return pyhal_error(res);
+    return PyInt_FromLong(res);
+}
+
 static PyObject *pyhal_ready(PyObject *_self, PyObject *o) {
     // hal_ready did not exist in EMC 2.0.x, make it a no-op
     halobject *self = (halobject *)_self;
@@ -402,6 +453,9 @@ static PyObject *pyhal_ready(PyObject *_self, PyObject *o) {
 
 static PyObject *pyhal_exit(PyObject *_self, PyObject *o) {
     halobject *self = (halobject *)_self;
+    if(self->watch)
+        hal_watch_delete(self->watch);
+    self->watch = 0;
     if(self->hal_id > 0) 
         hal_exit(self->hal_id);
     self->hal_id = 0;
@@ -474,6 +528,10 @@ static PyMethodDef hal_methods[] = {
         "Create a new pin"},
     {"getitem", pyhal_get_pin, METH_VARARGS,
         "Get existing pin object"},
+    {"group", pyhal_group, METH_VARARGS,
+        "Get a group object to read or write several items at once"},
+    {"wait", pyhal_wait, METH_VARARGS,
+        "Wait up to timeout seconds for an input pin to change"},
     {"exit", pyhal_exit, METH_NOARGS,
         "Call hal_exit"},
     {"ready", pyhal_ready, METH_NOARGS,
@@ -692,6 +750,210 @@ static PyObject * pyhal_pin_new(halitem * pin, const char * name) {
     return (PyObject *) pypin;
 }
 
+// A group is a fixed list of items of one component whose values are
+// copied to or from a buffer of doubles in one call, so a component
+// polling many pins does not create a Python object per pin per cycle.
+// Any object with the buffer interface works, e.g. array.array('d')
+// or a float64 numpy array.
+struct groupobject {
+    PyObject_HEAD
+    halobject *comp;
+    std::vector<halitem> *items;
+};
+
+static void pyhalgroup_delete(PyObject *_self) {
+    groupobject *self = (groupobject *)_self;
+    delete self->items;
+    Py_XDECREF(self->comp);
+    PyObject_Del(self);
+}
+
+static Py_ssize_t pyhalgroup_len(PyObject *_self) {
+    groupobject *self = (groupobject *)_self;
+    return self->items->size();
+}
+
+static PyObject *pyhalgroup_repr(PyObject *_self) {
+    groupobject *self = (groupobject *)_self;
+    return PyString_FromFormat("<hal group of %d items of %s>",
+            (int)self->items->size(), self->comp->name);
+}
+
+static int group_buffer_ok(groupobject *self, Py_ssize_t len) {
+    if(len < (Py_ssize_t)(self->items->size() * sizeof(double))) {
+        PyErr_Format(PyExc_ValueError,
+                "Buffer holds %d doubles, group has %d items",
+                (int)(len / sizeof(double)), (int)self->items->size());
+        return 0;
+    }
+    return 1;
+}
+
+static PyObject *pyhalgroup_read(PyObject *_self, PyObject *o) {
+    groupobject *self = (groupobject *)_self;
+    void *ptr;
+    Py_ssize_t len;
+
+    if(PyObject_AsWriteBuffer(o, &ptr, &len) < 0) return NULL;
+    if(!group_buffer_ok(self, len)) return NULL;
+
+    double *buf = (double *)ptr;
+    std::vector<halitem>::iterator i;
+    for(i = self->items->begin(); i != self->items->end(); i++, buf++) {
+        if(i->is_pin) {
+            switch(i->type) {
+                case HAL_BIT: *buf = *i->u->pin.b; break;
+                case HAL_U32: *buf = *i->u->pin.u32; break;
+                case HAL_S32: *buf = *i->u->pin.s32; break;
+                default: *buf = *i->u->pin.f; break;
+            }
+        } else {
+            switch(i->type) {
+                case HAL_BIT: *buf = i->u->param.b; break;
+                case HAL_U32: *buf = i->u->param.u32; break;
+                case HAL_S32: *buf = i->u->param.s32; break;
+                default: *buf = i->u->param.f; break;
+            }
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyhalgroup_write(PyObject *_self, PyObject *o) {
+    groupobject *self = (groupobject *)_self;
+    const void *ptr;
+    Py_ssize_t len;
+    size_t n;
+
+    if(PyObject_AsReadBuffer(o, &ptr, &len) < 0) return NULL;
+    if(!group_buffer_ok(self, len)) return NULL;
+
+    // check every value first, so a bad one leaves all items unchanged
+    const double *buf = (const double *)ptr;
+    for(n = 0; n < self->items->size(); n++) {
+        halitem &item = (*self->items)[n];
+        double v = buf[n];
+        bool ok = true;
+        if(item.type == HAL_U32)
+            ok = v >= 0 && v <= 4294967295.0;
+        else if(item.type == HAL_S32)
+            ok = v >= -2147483648.0 && v <= 2147483647.0;
+        if(!ok) {
+            PyErr_Format(PyExc_OverflowError,
+                    "Value at index %d out of range for item", (int)n);
+            return NULL;
+        }
+    }
+
+    for(n = 0; n < self->items->size(); n++) {
+        halitem &item = (*self->items)[n];
+        double v = buf[n];
+        if(item.is_pin) {
+            switch(item.type) {
+                case HAL_BIT: *item.u->pin.b = v != 0; break;
+                case HAL_U32: *item.u->pin.u32 = (hal_u32_t)v; break;
+                case HAL_S32: *item.u->pin.s32 = (hal_s32_t)v; break;
+                default: *item.u->pin.f = v; break;
+            }
+        } else {
+            switch(item.type) {
+                case HAL_BIT: item.u->param.b = v != 0; break;
+                case HAL_U32: item.u->param.u32 = (hal_u32_t)v; break;
+                case HAL_S32: item.u->param.s32 = (hal_s32_t)v; break;
+                default: item.u->param.f = v; break;
+            }
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef halgroup_methods[] = {
+    {"read", pyhalgroup_read, METH_O,
+        "Copy the item values into a buffer of doubles"},
+    {"write", pyhalgroup_write, METH_O,
+        "Set the item values from a buffer of doubles"},
+    {NULL},
+};
+
+static PySequenceMethods halgroup_seq = {
+    pyhalgroup_len,            /*sq_length*/
+};
+
+static 
+PyTypeObject halgroup_type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "hal.group",               /*tp_name*/
+    sizeof(groupobject),       /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pyhalgroup_delete,         /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    pyhalgroup_repr,           /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &halgroup_seq,             /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "HAL Item Group",          /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    halgroup_methods,          /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    0,                         /*tp_init*/
+    0,                         /*tp_alloc*/
+    0,                         /*tp_new*/
+    0,                         /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
+
+static PyObject * pyhal_group_new(halobject *comp, PyObject *names) {
+    PyObject *seq = PySequence_Fast(names, "group() expects a sequence of names");
+    if(!seq) return NULL;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    std::vector<halitem> *items = new std::vector<halitem>();
+    items->reserve(n);
+    for(Py_ssize_t i = 0; i < n; i++) {
+        char *name = PyString_AsString(PySequence_Fast_GET_ITEM(seq, i));
+        halitem *item = find_item(comp, name);
+        if(!item) {
+            delete items;
+            Py_DECREF(seq);
+            return NULL;
+        }
+        items->push_back(*item);
+    }
+    Py_DECREF(seq);
+
+    groupobject *self = PyObject_New(groupobject, &halgroup_type);
+    if(!self) {
+        delete items;
+        return NULL;
+    }
+    Py_INCREF(comp);
+    self->comp = comp;
+    self->items = items;
+    return (PyObject *)self;
+}
+
 PyObject *pin_has_writer(PyObject *self, PyObject *args) {
     char *name;
     if(!PyArg_ParseTuple(args, "s", &name)) return NULL;
@@ -1103,9 +1365,11 @@ void init_hal(void) {
     PyType_Ready(&halobject_type);
     PyType_Ready(&shm_type);
     PyType_Ready(&halpin_type);
+    PyType_Ready(&halgroup_type);
     PyModule_AddObject(m, "component", (PyObject*)&halobject_type);
     PyModule_AddObject(m, "shm", (PyObject*)&shm_type);
     PyModule_AddObject(m, "item", (PyObject*)&halpin_type);
+    PyModule_AddObject(m, "group", (PyObject*)&halgroup_type);
 
     PyModule_AddIntConstant(m, "MSG_NONE", RTAPI_MSG_NONE);
     PyModule_AddIntConstant(m, "MSG_ERR", RTAPI_MSG_ERR);
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <termio.h>
 #include <sys/time.h>
+#include <sys/file.h>
 #include <unistd.h>
 #include <errno.h>
 #include <glib.h>
@@ -260,7 +261,26 @@ static unsigned short crc16(unsigned char *buffer,
   return (crc_hi << 8 | crc_lo);
 }
 
-/* Function to send a query out to a modbus slave */
+/* A serial line can be shared by several programs, each talking to
+   its own slaves.  The line is held from the query to the end of the
+   response, so the transactions of two programs never interleave. */
+static void bus_lock(modbus_param_t *mb_param)
+{
+  if (mb_param->type_com == RTU) {
+    flock(mb_param->fd, LOCK_EX);
+    /* Drop what is left of the previous owner's trames */
+    tcflush(mb_param->fd, TCIFLUSH);
+  }
+}
+
+static void bus_unlock(modbus_param_t *mb_param)
+{
+  if (mb_param->type_com == RTU)
+    flock(mb_param->fd, LOCK_UN);
+}
+
+/* Function to send a query out to a modbus slave.  On success the
+   line is left locked until modbus_response() */
 static int modbus_query(modbus_param_t *mb_param, unsigned char *query,
 			size_t query_size)
 {
@@ -283,7 +303,8 @@ static int modbus_query(modbus_param_t *mb_param, unsigned char *query,
 
     g_print("\n");
   }
-	
+
+  bus_lock(mb_param);
   if (mb_param->type_com == RTU)
     write_ret = write(mb_param->fd, query, query_size);
   else
@@ -292,6 +313,7 @@ static int modbus_query(modbus_param_t *mb_param, unsigned char *query,
 	/* Return the number of bytes written (0 to n)
   or PORT_SOCKET_FAILURE on error */
   if ((write_ret == -1) || (write_ret != query_size)) {
+    bus_unlock(mb_param);
     error_treat(write_ret, "Write port/socket failure", mb_param);
     write_ret = PORT_SOCKET_FAILURE;
   }
@@ -457,9 +479,9 @@ static int check_crc16(modbus_param_t *mb_param,
    return these values.
 */
 
-static int modbus_response(modbus_param_t *mb_param, 
-			   unsigned char *query,
-      unsigned char *response)
+static int check_response(modbus_param_t *mb_param, 
+			  unsigned char *query,
+     unsigned char *response)
 {
   int response_size;
   int response_size_computed;
@@ -548,6 +570,18 @@ static int modbus_response(modbus_param_t *mb_param,
 	     return response_size;
 }
 
+static int modbus_response(modbus_param_t *mb_param, 
+			   unsigned char *query,
+      unsigned char *response)
+{
+  int ret;
+
+  ret = check_response(mb_param, query, response);
+  bus_unlock(mb_param);
+
+  return ret;
+}
+
 /* Read IO status */
 static int read_io_status(modbus_param_t *mb_param, int slave, int function,
 			  int start_addr, int count, int *data_dest)
@@ -903,6 +937,357 @@ int report_slave_id(modbus_param_t *mb_param, int slave,
   return response_ret;
 }
 
+/* Scheduler
+
+   modbus_schedule() reads adjacent or nearly adjacent addresses of a
+   slave in one transaction, and in TCP sends several reads before
+   waiting for the first response.
+*/
+
+/* Largest hole between two requests that are still read together */
+#define MERGE_GAP         8
+/* Reads in flight on a TCP connection */
+#define TCP_PIPELINE      4
+
+typedef struct {
+  int slave;
+  int function;
+  int start_addr;
+  int count;
+  /* requests served, in the sorted list */
+  int first;
+  int last;
+  /* transaction identifier of the query (TCP) */
+  int t_id;
+  int pending;
+  int status;
+  int data[MAX_READ_STATUS];
+} read_block_t;
+
+static int is_read(int function)
+{
+  return function >= 0x01 && function <= 0x04;
+}
+
+static int read_limit(int function)
+{
+  switch (function) {
+    case 0x03:
+      return MAX_READ_HOLD_REGS;
+    case 0x04:
+      return MAX_READ_INPUT_REGS;
+    default:
+      return MAX_READ_STATUS;
+  }
+}
+
+/* Highest priority first, then by slave, function and address so
+   neighbours end up next to each other.  The position in the caller's
+   array breaks ties, so writes to one address keep their order. */
+static int compare_requests(const void *a, const void *b)
+{
+  const modbus_request_t *ra = *(modbus_request_t * const *) a;
+  const modbus_request_t *rb = *(modbus_request_t * const *) b;
+
+  if (ra->priority != rb->priority)
+    return rb->priority - ra->priority;
+  if (ra->slave != rb->slave)
+    return ra->slave - rb->slave;
+  if (ra->function != rb->function)
+    return ra->function - rb->function;
+  if (ra->start_addr != rb->start_addr)
+    return ra->start_addr - rb->start_addr;
+  return (ra < rb) ? -1 : (ra > rb);
+}
+
+static int run_write(modbus_param_t *mb_param, modbus_request_t *req)
+{
+  switch (req->function) {
+    case 0x05:
+      return force_single_coil(mb_param, req->slave,
+			       req->start_addr, req->data[0]);
+    case 0x06:
+      return preset_single_register(mb_param, req->slave,
+				    req->start_addr, req->data[0]);
+    case 0x0F:
+      return force_multiple_coils(mb_param, req->slave, req->start_addr,
+				  req->count, req->data);
+    case 0x10:
+      return preset_multiple_registers(mb_param, req->slave,
+				       req->start_addr, req->count,
+		req->data);
+    default:
+      return ILLEGAL_FUNCTION;
+  }
+}
+
+static int run_read(modbus_param_t *mb_param, read_block_t *block)
+{
+  switch (block->function) {
+    case 0x01:
+      return read_coil_status(mb_param, block->slave, block->start_addr,
+			      block->count, block->data);
+    case 0x02:
+      return read_input_status(mb_param, block->slave, block->start_addr,
+			       block->count, block->data);
+    case 0x03:
+      return read_holding_registers(mb_param, block->slave,
+				    block->start_addr, block->count,
+		block->data);
+    default:
+      return read_input_registers(mb_param, block->slave,
+				  block->start_addr, block->count,
+		block->data);
+  }
+}
+
+/* Decodes a TCP response to a read; response holds the whole trame */
+static int read_block_response(modbus_param_t *mb_param,
+			       read_block_t *block,
+	unsigned char *response, int length)
+{
+  int offset = HEADER_LENGTH_TCP;
+  int i, n;
+
+  if (response[offset + 1] == 0x80 + block->function) {
+    /* The connection is still usable for the other responses, so
+       error_treat() is not called here */
+    if (response[offset + 2] < SIZE_TAB_ERROR_MSG) {
+      if (mb_param->print_errors)
+	g_print("\n\nERROR %s\n\n", TAB_ERROR_MSG[response[offset + 2]]);
+      return -response[offset + 2];
+    }
+    return INVALID_EXCEPTION_CODE;
+  }
+  if (response[offset + 1] != block->function)
+    return INVALID_RESPONSE;
+
+  /* Bytes of data actually in the trame */
+  n = response[offset + 2];
+  if (n > length - 3)
+    n = length - 3;
+
+  if (block->function <= 0x02) {
+    n *= 8;
+    if (n > block->count)
+      n = block->count;
+    for (i = 0; i < n; i++)
+      block->data[i] = 
+	  (response[offset + 3 + (i >> 3)] & (1 << (i & 7))) ? TRUE : FALSE;
+  } else {
+    n /= 2;
+    if (n > block->count)
+      n = block->count;
+    for (i = 0; i < n; i++)
+      block->data[i] = response[offset + 3 + (i << 1)] << 8 |
+	  response[offset + 4 + (i << 1)];
+  }
+
+  return n;
+}
+
+/* Sends the queries of all blocks, then matches the responses to
+   them by their transaction identifier */
+static void run_reads_tcp(modbus_param_t *mb_param,
+			  read_block_t *blocks, int nb_blocks)
+{
+  unsigned char query[MIN_QUERY_SIZE];
+  unsigned char response[MAX_PACKET_SIZE];
+  int response_size;
+  int query_size;
+  int length;
+  int pending = 0;
+  int ret = 0;
+  int i;
+
+  for (i = 0; i < nb_blocks; i++)
+    blocks[i].pending = TRUE;
+
+  for (i = 0; i < nb_blocks; i++) {
+    query_size = build_request_packet(mb_param, blocks[i].slave,
+				      blocks[i].function,
+	blocks[i].start_addr,
+ blocks[i].count, query);
+    blocks[i].t_id = query[0] << 8 | query[1];
+    ret = modbus_query(mb_param, query, query_size);
+    if (ret <= 0)
+      /* The connection has been reopened, nothing will come back
+	 for the queries already sent */
+      break;
+    pending++;
+  }
+
+  while (ret > 0 && pending > 0) {
+    ret = receive_response(mb_param, HEADER_LENGTH_TCP,
+			   response, &response_size);
+    if (ret == 0) {
+      length = response[4] << 8 | response[5];
+      if (length < 3 || length > MAX_PACKET_SIZE - HEADER_LENGTH_TCP) {
+	error_treat(0, "Invalid length in TCP header", mb_param);
+	ret = INVALID_RESPONSE;
+	break;
+      }
+      ret = receive_response(mb_param, length,
+			     response + HEADER_LENGTH_TCP, &response_size);
+    }
+    if (ret == COMM_TIME_OUT)
+      error_treat(0, "Communication time out", mb_param);
+    if (ret < 0)
+      break;
+
+    /* A response to an earlier, timed out query is dropped */
+    for (i = 0; i < nb_blocks; i++) {
+      if (blocks[i].pending &&
+	  blocks[i].t_id == (response[0] << 8 | response[1])) {
+	blocks[i].status = read_block_response(mb_param, &blocks[i],
+					       response, length);
+	blocks[i].pending = FALSE;
+	pending--;
+	break;
+      }
+    }
+    ret = 1;
+  }
+
+  for (i = 0; i < nb_blocks; i++) {
+    if (blocks[i].pending)
+      blocks[i].status = ret;
+    blocks[i].pending = FALSE;
+  }
+}
+
+/* Gives each request its part of the data read by its block */
+static int scatter_block(read_block_t *block, modbus_request_t **list)
+{
+  modbus_request_t *req;
+  int failed = 0;
+  int i, j, n;
+
+  for (i = block->first; i <= block->last; i++) {
+    req = list[i];
+    if (block->status < 0) {
+      req->status = block->status;
+      failed++;
+      continue;
+    }
+    n = block->status - (req->start_addr - block->start_addr);
+    if (n > req->count)
+      n = req->count;
+    if (n < 0)
+      n = 0;
+    for (j = 0; j < n; j++)
+      req->data[j] = block->data[req->start_addr - block->start_addr + j];
+    req->status = n;
+  }
+
+  return failed;
+}
+
+static int run_reads(modbus_param_t *mb_param, read_block_t *blocks,
+		     int nb_blocks, modbus_request_t **list)
+{
+  int failed = 0;
+  int i;
+
+  if (mb_param->type_com == TCP) {
+    run_reads_tcp(mb_param, blocks, nb_blocks);
+  } else {
+    for (i = 0; i < nb_blocks; i++)
+      blocks[i].status = run_read(mb_param, &blocks[i]);
+  }
+  for (i = 0; i < nb_blocks; i++)
+    failed += scatter_block(&blocks[i], list);
+
+  return failed;
+}
+
+int modbus_schedule(modbus_param_t *mb_param, modbus_request_t *requests,
+		    int nb_requests)
+{
+  static read_block_t blocks[TCP_PIPELINE];
+  modbus_request_t **list;
+  modbus_request_t *req, *next;
+  read_block_t *block;
+  int nb_list = 0;
+  int nb_blocks = 0;
+  int failed = 0;
+  int i, j, end;
+
+  if (nb_requests <= 0)
+    return 0;
+
+  /* Requests that are due this time */
+  list = g_new(modbus_request_t *, nb_requests);
+  for (i = 0; i < nb_requests; i++) {
+    req = &requests[i];
+    if (req->countdown > 0) {
+      req->countdown--;
+      continue;
+    }
+    req->countdown = (req->interval > 1) ? req->interval - 1 : 0;
+    list[nb_list++] = req;
+  }
+  qsort(list, nb_list, sizeof(modbus_request_t *), compare_requests);
+
+  i = 0;
+  while (i < nb_list) {
+    req = list[i];
+    if (!is_read(req->function)) {
+      /* Reads queued before the write go out first */
+      if (nb_blocks > 0) {
+	failed += run_reads(mb_param, blocks, nb_blocks, list);
+	nb_blocks = 0;
+      }
+      req->status = run_write(mb_param, req);
+      if (req->status < 0)
+	failed++;
+      i++;
+      continue;
+    }
+
+    block = &blocks[nb_blocks++];
+    block->slave = req->slave;
+    block->function = req->function;
+    block->start_addr = req->start_addr;
+    block->count = req->count;
+    block->first = i;
+    block->t_id = -1;
+    block->pending = FALSE;
+    block->status = 0;
+
+    for (j = i + 1; j < nb_list; j++) {
+      next = list[j];
+      if (next->priority != req->priority || next->slave != req->slave ||
+	  next->function != req->function)
+	break;
+      if (next->start_addr > block->start_addr + block->count + MERGE_GAP)
+	break;
+      end = next->start_addr + next->count;
+      if (end < block->start_addr + block->count)
+	end = block->start_addr + block->count;
+      if (end - block->start_addr > read_limit(req->function))
+	break;
+      block->count = end - block->start_addr;
+    }
+    block->last = j - 1;
+    i = j;
+
+    if (block->count > read_limit(block->function))
+      block->count = read_limit(block->function);
+
+    if (nb_blocks == TCP_PIPELINE || mb_param->type_com == RTU) {
+      failed += run_reads(mb_param, blocks, nb_blocks, list);
+      nb_blocks = 0;
+    }
+  }
+  if (nb_blocks > 0)
+    failed += run_reads(mb_param, blocks, nb_blocks, list);
+
+  g_free(list);
+
+  return failed;
+}
+
 /* Initialises the modbus_param_t structure for RTU */
 void modbus_init_rtu(modbus_param_t *mb_param, char *device,
 		     int baud_i, char *parity, int data_bit,
@@ -84,6 +84,7 @@
 #define TOO_MANY_DATAS          -0x0F
 #define INVALID_CRC             -0x10
 #define INVALID_EXCEPTION_CODE  -0x11
+#define INVALID_RESPONSE        -0x12
 
 typedef enum { RTU, TCP } type_com_t;
 
@@ -116,6 +117,28 @@ typedef struct _modbus_param_t {
 	int checksum_size;
 } modbus_param_t;
 
+/* One transfer handled by modbus_schedule() */
+typedef struct _modbus_request_t {
+	/* Slave number */
+	int slave;
+	/* 0x01 to 0x04 to read, 0x05, 0x06, 0x0F or 0x10 to write */
+	int function;
+	int start_addr;
+	/* Number of bits or registers */
+	int count;
+	/* Destination of a read, source of a write */
+	int *data;
+	/* Requests of higher priority are done first */
+	int priority;
+	/* Done every interval calls (0 or 1: every call) */
+	int interval;
+	/* Result of the last transfer, as returned by the functions
+	   below */
+	int status;
+	/* Calls left before the next transfer, start with 0 */
+	int countdown;
+} modbus_request_t;
+
 /* All functions used for sending or receiving data return :
    - the numbers of values (bits or word) if success (0 or more)
    - less than 0 for exceptions errors
@@ -162,6 +185,14 @@ int preset_multiple_registers(modbus_param_t *mb_param, int slave,
 int report_slave_id(modbus_param_t *mb_param, int slave,
 		    unsigned char *dest);
 
+/* Does every request of the array that is due, highest priority
+   first.  Reads of the same slave and function that are next to each
+   other are done in one transaction; in TCP up to 4 reads are sent
+   before the responses are read.  Returns the number of requests that
+   failed (see the status of each request) */
+int modbus_schedule(modbus_param_t *mb_param, modbus_request_t *requests,
+		    int nb_requests);
+
 /* Initialises a parameters structure
    - device : "/dev/ttyS0"
    - baud :   19200
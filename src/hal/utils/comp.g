@@ -303,6 +303,10 @@ static int comp_id;
             print >>f, "%s(%s, %s);" % (decl, name, q(doc))
             
     print >>f
+    if options.get("soa"):
+        soa_prologue(f, has_personality)
+        return
+
     print >>f, "struct __comp_state {"
     print >>f, "    struct __comp_state *_next;"
     if has_personality:
@@ -613,9 +617,225 @@ static int comp_id;
     print >>f
     print >>f
 
+def soa_decl(type, name, array):
+    stars = name[:len(name) - len(name.lstrip("*"))]
+    name = name.lstrip("*")
+    if array:
+        return "%s %s(*%s)[%s];" % (type, stars, name, array)
+    return "%s %s*%s;" % (type, stars, name)
+
+# With 'option soa', every instance lives in one set of arrays indexed by
+# instance number, and each function is exported once and loops over all
+# instances.  The loop body is the function as written, made into an
+# inline function, so the compiler sees the whole loop.
+def soa_prologue(f, has_personality):
+    base = to_hal(removeprefix(comp_name, "hal_"))
+    for opt in ("userspace", "singleton", "constructable", "data",
+                "count_function", "no_convenience_defines"):
+        if options.get(opt):
+            raise SystemExit, "option soa may not be combined with option %s" % opt
+    if not options.get("rtapi_app", 1):
+        raise SystemExit, "option soa requires rtapi_app"
+
+    fields = []
+    if has_personality:
+        fields.append(("int", "_personality", 0))
+    for name, type, array, dir, value, personality in pins:
+        if isinstance(array, tuple): array = array[0]
+        fields.append(("hal_%s_t" % type, "*" + to_c(name), array))
+    for name, type, array, dir, value, personality in params:
+        if isinstance(array, tuple): array = array[0]
+        fields.append(("hal_%s_t" % type, to_c(name), array))
+    for type, name, array, value in variables:
+        fields.append((type, name, array))
+
+    print >>f, "static struct {"
+    print >>f, "    int _count;"
+    for type, name, array in fields:
+        print >>f, "    %s" % soa_decl(type, name, array)
+    print >>f, "} __comp_soa;"
+    print >>f
+
+    print >>f, "static int __comp_soa_alloc(int n) {"
+    print >>f, "    __comp_soa._count = n;"
+    for type, name, array in fields:
+        name = name.lstrip("*")
+        print >>f, "    __comp_soa.%s = hal_malloc(n * sizeof(*__comp_soa.%s));" % (name, name)
+        print >>f, "    if(!__comp_soa.%s) return -ENOMEM;" % name
+        print >>f, "    memset((void*)__comp_soa.%s, 0, n * sizeof(*__comp_soa.%s));" % (name, name)
+    print >>f, "    return 0;"
+    print >>f, "}"
+    print >>f
+
+    for name, fp in functions:
+        print >>f, "static void %s(void *__comp_arg, long period);" % to_c(name)
+    if options.get("extra_setup"):
+        print >>f, "static int extra_setup(int __comp_i, char *prefix, long extra_arg);"
+    if options.get("extra_cleanup"):
+        print >>f, "static void extra_cleanup(void);"
+
+    print >>f, "#undef TRUE"
+    print >>f, "#define TRUE (1)"
+    print >>f, "#undef FALSE"
+    print >>f, "#define FALSE (0)"
+    print >>f, "#undef true"
+    print >>f, "#define true (1)"
+    print >>f, "#undef false"
+    print >>f, "#define false (0)"
+
+    print >>f
+    if has_personality:
+        print >>f, "static int export(char *prefix, long extra_arg, long personality, int __comp_i) {"
+    else:
+        print >>f, "static int export(char *prefix, long extra_arg, int __comp_i) {"
+    print >>f, "    int r = 0;"
+    if [1 for item in pins + params if item[2]] or \
+            [1 for item in variables if item[2] and item[3] is not None]:
+        print >>f, "    int j = 0;"
+    if has_personality:
+        print >>f, "    __comp_soa._personality[__comp_i] = personality;"
+    if options.get("extra_setup"):
+        print >>f, "    r = extra_setup(__comp_i, prefix, extra_arg);"
+        print >>f, "    if(r != 0) return r;"
+    if has_personality:
+        print >>f, "    personality = __comp_soa._personality[__comp_i];"
+    for kind, items in (("pin", pins), ("param", params)):
+        for name, type, array, dir, value, personality in items:
+            ref = "__comp_soa.%s[__comp_i]" % to_c(name)
+            deref = kind == "pin" and "*" or ""
+            if personality:
+                print >>f, "if(%s) {" % personality
+            if array:
+                if isinstance(array, tuple): array = array[1]
+                print >>f, "    for(j=0; j < (%s); j++) {" % array
+                print >>f, "        r = hal_%s_%s_newf(%s, &(%s[j]), comp_id," % (
+                    kind, type, dirmap[dir], ref)
+                print >>f, "            \"%%s%s\", prefix, j);" % to_hal("." + name)
+                print >>f, "        if(r != 0) return r;"
+                if value is not None:
+                    print >>f, "        %s(%s[j]) = %s;" % (deref, ref, value)
+                print >>f, "    }"
+            else:
+                print >>f, "    r = hal_%s_%s_newf(%s, &(%s), comp_id," % (
+                    kind, type, dirmap[dir], ref)
+                print >>f, "        \"%%s%s\", prefix);" % to_hal("." + name)
+                print >>f, "    if(r != 0) return r;"
+                if value is not None:
+                    print >>f, "    %s(%s) = %s;" % (deref, ref, value)
+            if personality:
+                print >>f, "}"
+    for type, name, array, value in variables:
+        if value is None: continue
+        name = name.lstrip("*")
+        if array:
+            print >>f, "    for(j=0; j < %s; j++) {" % array
+            print >>f, "        __comp_soa.%s[__comp_i][j] = %s;" % (name, value)
+            print >>f, "    }"
+        else:
+            print >>f, "    __comp_soa.%s[__comp_i] = %s;" % (name, value)
+    print >>f, "    return 0;"
+    print >>f, "}"
+
+    print >>f, "static int default_count=%s, count=0;" \
+        % options.get("default_count", 1)
+    print >>f, "char *names[16] = {0,};"
+    print >>f, "RTAPI_MP_INT(count, \"number of %s\");" % comp_name
+    print >>f, "RTAPI_MP_ARRAY_STRING(names, 16, \"names of %s\");" % comp_name
+    if has_personality:
+        init1 = str(int(options.get('default_personality', 0)))
+        init = ",".join([init1] * 16)
+        print >>f, "static int personality[16] = {%s};" % init
+        print >>f, "RTAPI_MP_ARRAY_INT(personality, 16, \"personality of each %s\");" % comp_name
+    print >>f, "int rtapi_app_main(void) {"
+    print >>f, "    int r = 0;"
+    print >>f, "    int i;"
+    print >>f, "    comp_id = hal_init(\"%s\");" % comp_name
+    print >>f, "    if(comp_id < 0) return comp_id;"
+    print >>f, "    if(count && names[0]) {"
+    print >>f, "        rtapi_print_msg(RTAPI_MSG_ERR," \
+                    "\"count= and names= are mutually exclusive\\n\");"
+    print >>f, "        hal_exit(comp_id);"
+    print >>f, "        return -EINVAL;"
+    print >>f, "    }"
+    print >>f, "    if(!count && !names[0]) count = default_count;"
+    print >>f, "    if(!count) while(count < 16 && names[count]) count++;"
+    print >>f, "    r = __comp_soa_alloc(count);"
+    print >>f, "    for(i=0; r == 0 && i<count; i++) {"
+    print >>f, "        char buf[HAL_NAME_LEN + 1];"
+    print >>f, "        if(names[0]) {"
+    print >>f, "            rtapi_snprintf(buf, sizeof(buf), \"%s\", names[i]);"
+    print >>f, "        } else {"
+    print >>f, "            rtapi_snprintf(buf, sizeof(buf), \"%s.%%d\", i);" % base
+    print >>f, "        }"
+    if has_personality:
+        print >>f, "        r = export(buf, i, personality[i%16], i);"
+    else:
+        print >>f, "        r = export(buf, i, i);"
+    print >>f, "    }"
+    for name, fp in functions:
+        print >>f, "    if(r == 0) r = hal_export_funct(\"%s\", %s, 0, %s, 0, comp_id);" % (
+            to_hal(base + "." + name), to_c(name), int(fp))
+    print >>f, "    if(r) {"
+    if options.get("extra_cleanup"):
+        print >>f, "    extra_cleanup();"
+    print >>f, "        hal_exit(comp_id);"
+    print >>f, "    } else {"
+    print >>f, "        hal_ready(comp_id);"
+    print >>f, "    }"
+    print >>f, "    return r;"
+    print >>f, "}"
+    print >>f
+    print >>f, "void rtapi_app_exit(void) {"
+    if options.get("extra_cleanup"):
+        print >>f, "    extra_cleanup();"
+    print >>f, "    hal_exit(comp_id);"
+    print >>f, "}"
+
+    print >>f
+    print >>f, "#undef FUNCTION"
+    print >>f, "#define FUNCTION(name) " \
+        "static inline void name##__soa(int __comp_i, long period); " \
+        "static void name(void *__comp_arg, long period) { " \
+        "int __comp_i; " \
+        "for(__comp_i = 0; __comp_i < __comp_soa._count; __comp_i++) " \
+        "name##__soa(__comp_i, period); " \
+        "} " \
+        "static inline void name##__soa(int __comp_i, long period)"
+    print >>f, "#undef EXTRA_SETUP"
+    print >>f, "#define EXTRA_SETUP() static int extra_setup(int __comp_i, char *prefix, long extra_arg)"
+    print >>f, "#undef EXTRA_CLEANUP"
+    print >>f, "#define EXTRA_CLEANUP() static void extra_cleanup(void)"
+    print >>f, "#undef fperiod"
+    print >>f, "#define fperiod (period * 1e-9)"
+    for name, type, array, dir, value, personality in pins:
+        print >>f, "#undef %s" % to_c(name)
+        if dir == 'in': prefix = "0+"
+        else: prefix = ""
+        if array:
+            print >>f, "#define %s(i) (%s*(__comp_soa.%s[__comp_i][i]))" % (to_c(name), prefix, to_c(name))
+        else:
+            print >>f, "#define %s (%s*__comp_soa.%s[__comp_i])" % (to_c(name), prefix, to_c(name))
+    for name, type, array, dir, value, personality in params:
+        print >>f, "#undef %s" % to_c(name)
+        if array:
+            print >>f, "#define %s(i) (__comp_soa.%s[__comp_i][i])" % (to_c(name), to_c(name))
+        else:
+            print >>f, "#define %s (__comp_soa.%s[__comp_i])" % (to_c(name), to_c(name))
+    for type, name, array, value in variables:
+        name = name.replace("*", "")
+        print >>f, "#undef %s" % name
+        print >>f, "#define %s (__comp_soa.%s[__comp_i])" % (name, name)
+    if has_personality:
+        print >>f, "#undef personality"
+        print >>f, "#define personality (__comp_soa._personality[__comp_i])"
+    print >>f
+    print >>f
+
 def epilogue(f):
     data = options.get('data')
     print >>f
+    if options.get("soa"):
+        return
     if data:
         print >>f, "static int __comp_get_data_size(void) { return sizeof(%s); }" % data
     else:
@@ -798,7 +1018,10 @@ def document(filename, outfilename):
         print >>f, ".SH FUNCTIONS"
         for _, name, fp, doc in finddocs('funct'):
             print >>f, ".TP"
-            print >>f, "\\fB%s\\fR" % to_hal_man(name),
+            if options.get("soa"):
+                print >>f, "\\fB%s\\fR" % to_hal_man_unnumbered(name),
+            else:
+                print >>f, "\\fB%s\\fR" % to_hal_man(name),
             if fp:
                 print >>f, "(requires a floating-point thread)"
             else:
@@ -136,8 +136,12 @@ void halcmd_shutdown(void) {
 struct halcmd_command halcmd_commands[] = {
     {"addf",    FUNCT(do_addf_cmd),    A_TWO | A_PLUS },
     {"alias",   FUNCT(do_alias_cmd),   A_THREE },
+    {"begin",   FUNCT(do_begin_cmd),   A_ZERO },
+    {"commit",  FUNCT(do_commit_cmd),  A_ZERO },
+    {"compact", FUNCT(do_compact_cmd), A_ZERO},
     {"delf",    FUNCT(do_delf_cmd),    A_TWO | A_OPTIONAL },
     {"delsig",  FUNCT(do_delsig_cmd),  A_ONE },
+    {"fuse",    FUNCT(do_fuse_cmd),    A_ONE },
     {"getp",    FUNCT(do_getp_cmd),    A_ONE },
     {"gets",    FUNCT(do_gets_cmd),    A_ONE },
     {"ptype",   FUNCT(do_ptype_cmd),   A_ONE },
@@ -147,11 +151,12 @@ struct halcmd_command halcmd_commands[] = {
     {"linkps",  FUNCT(do_linkps_cmd),  A_TWO | A_REMOVE_ARROWS },
     {"linksp",  FUNCT(do_linksp_cmd),  A_TWO | A_REMOVE_ARROWS },
     {"list",    FUNCT(do_list_cmd),    A_ONE | A_PLUS },
-    {"loadrt",  FUNCT(do_loadrt_cmd),  A_ONE | A_PLUS },
-    {"loadusr", FUNCT(do_loadusr_cmd), A_PLUS | A_TILDE },
+    {"loadrt",  FUNCT(do_loadrt_cmd),  A_ONE | A_PLUS | A_SPAWN },
+    {"loadusr", FUNCT(do_loadusr_cmd), A_PLUS | A_TILDE | A_SPAWN },
     {"lock",    FUNCT(do_lock_cmd),    A_ONE | A_OPTIONAL },
     {"net",     FUNCT(do_net_cmd),     A_ONE | A_PLUS | A_REMOVE_ARROWS },
     {"newsig",  FUNCT(do_newsig_cmd),  A_TWO },
+    {"rollback", FUNCT(do_rollback_cmd), A_ZERO },
     {"save",    FUNCT(do_save_cmd),    A_TWO | A_OPTIONAL | A_TILDE },
     {"setexact_for_test_suite_only", FUNCT(do_setexact_cmd), A_ZERO },
     {"setp",    FUNCT(do_setp_cmd),    A_TWO },
@@ -162,12 +167,14 @@ struct halcmd_command halcmd_commands[] = {
     {"status",  FUNCT(do_status_cmd),  A_ONE | A_OPTIONAL },
     {"stop",    FUNCT(do_stop_cmd),    A_ZERO},
     {"unalias", FUNCT(do_unalias_cmd), A_TWO },
+    {"unfuse",  FUNCT(do_unfuse_cmd),  A_ONE },
     {"unlinkp", FUNCT(do_unlinkp_cmd), A_ONE },
-    {"unload",  FUNCT(do_unload_cmd),  A_ONE },
-    {"unloadrt", FUNCT(do_unloadrt_cmd), A_ONE },
-    {"unloadusr", FUNCT(do_unloadusr_cmd), A_ONE },
+    {"unload",  FUNCT(do_unload_cmd),  A_ONE | A_SPAWN },
+    {"unloadrt", FUNCT(do_unloadrt_cmd), A_ONE | A_SPAWN },
+    {"unloadusr", FUNCT(do_unloadusr_cmd), A_ONE | A_SPAWN },
     {"unlock",  FUNCT(do_unlock_cmd),  A_ONE | A_OPTIONAL },
-    {"waitusr", FUNCT(do_waitusr_cmd), A_ONE },
+    {"waitready", FUNCT(do_waitready_cmd), A_ZERO | A_SPAWN },
+    {"waitusr", FUNCT(do_waitusr_cmd), A_ONE | A_SPAWN },
 };
 int halcmd_ncommands = (sizeof(halcmd_commands) / sizeof(halcmd_commands[0]));
 
@@ -277,6 +284,10 @@ static void quit(int sig)
 	/* don't have to worry about the mutex, but if we just
 	   return, we might return into the fgets() and wait 
 	   all day instead of exiting.  So we exit from here. */
+	if ( halcmd_batch_active() ) {
+	    /* undo the open batch, which also releases the mutex */
+	    halcmd_batch_rollback();
+	}
 	if ( comp_id > 0 ) {
 	    hal_exit(comp_id);
 	}
@@ -362,6 +373,8 @@ static int parse_cmd1(char **argv) {
 	}
 #endif
 
+	if(command->type & A_SPAWN) halcmd_batch_suspend();
+
 	switch(nargs | is_plus) {
 	case A_ZERO: {
 	    result = command->func();
@@ -421,6 +434,8 @@ static int parse_cmd1(char **argv) {
 	    result = -EINVAL;
 	}
 
+	if(command->type & A_SPAWN) halcmd_batch_resume();
+
 #ifndef NO_TILDE
 	if(command->type & A_TILDE)
 	{
@@ -450,6 +465,10 @@ int halcmd_parse_cmd(char *tokens[])
 
     hal_flag = 1;
     retval = parse_cmd1(tokens);
+    if(retval != 0 && halcmd_batch_active()) {
+        /* a failed command aborts the whole batch */
+        halcmd_batch_rollback();
+    }
     hal_flag = 0;
     return retval;
 }
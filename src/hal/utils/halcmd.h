@@ -70,6 +70,8 @@ enum halcmd_argtype {
     A_REMOVE_ARROWS = 0x200, /* removes any arrows from command */
     A_OPTIONAL = 0x400,      /* arguments may be NULL */
     A_TILDE = 0x800,         /* tilde-expand all arguments */
+    A_SPAWN = 0x1000,        /* runs another HAL process, so must not
+                                hold the mutex of a batch */
 };
 
 typedef int(*halcmd_func_t)(void);
@@ -55,6 +55,8 @@
 #include <errno.h>
 #include <time.h>
 #include <fnmatch.h>
+#include <regex.h>
+#include <stdarg.h>
 
 
 static int unloadrt_comp(char *mod_name);
@@ -66,6 +68,8 @@ static void print_sig_info(int type, char **patterns);
 static void print_script_sig_info(int type, char **patterns);
 static void print_param_info(int type, char **patterns);
 static void print_funct_info(char **patterns);
+static void print_functime_info(char **patterns);
+static void print_locality_info(char **patterns);
 static void print_thread_info(char **patterns);
 static void print_comp_names(char **patterns);
 static void print_pin_names(char **patterns);
@@ -97,17 +101,88 @@ static int tmatch(int req_type, int type) {
     return req_type == -1 || type == req_type;
 }
 
+/* a pattern written /like this/ is an extended regular expression; the
+   last one compiled is kept, since match() is called for every item */
+static int rematch(char *pattern, char *value) {
+    static char last[MAX_CMD_LEN+3];
+    static regex_t re;
+    static int compiled = 0;
+    int len = strlen(pattern);
+
+    if(!compiled || strcmp(pattern, last) != 0) {
+	if(compiled) regfree(&re);
+	compiled = 0;
+	if(len > MAX_CMD_LEN + 2) return 0;
+	strncpy(last, pattern + 1, len - 2);
+	last[len - 2] = '\0';
+	if(regcomp(&re, last, REG_EXTENDED | REG_NOSUB) != 0) return 0;
+	strcpy(last, pattern);
+	compiled = 1;
+    }
+    return regexec(&re, value, 0, NULL, 0) == 0;
+}
+
 static int match(char **patterns, char *value) {
     int i;
     if(!patterns || !patterns[0] || !patterns[0][0]) return 1;
     for(i=0; patterns[i] && *patterns[i]; i++) {
 	char *pattern = patterns[i];
-	if(strncmp(pattern, value, strlen(pattern)) == 0) return 1;
+	int len = strlen(pattern);
+	if(len > 2 && pattern[0] == '/' && pattern[len-1] == '/') {
+	    if(rematch(pattern, value)) return 1;
+	    continue;
+	}
+	if(strncmp(pattern, value, len) == 0) return 1;
 	if (fnmatch(pattern, value, 0) == 0) return 1;
     }
     return 0;
 }
 
+/* show, list and status format into memory and only write it out once
+   they are done, so a slow terminal or pipe doesn't keep the HAL mutex
+   held, and every other HAL program waiting, while it drains */
+static FILE *held_out;
+static char *held_buf;
+static size_t held_size;
+
+static void hold_output(void) {
+    held_out = open_memstream(&held_buf, &held_size);
+}
+
+static void release_output(void) {
+    char *p, *nl;
+
+    if(!held_out) return;
+    fclose(held_out);
+    held_out = NULL;
+    /* halsh wants its output a line at a time */
+    for(p = held_buf; p < held_buf + held_size; p = nl + 1) {
+	nl = memchr(p, '\n', held_buf + held_size - p);
+	if(!nl) {
+	    halcmd_output("%s", p);
+	    break;
+	}
+	halcmd_output("%.*s", (int)(nl - p + 1), p);
+    }
+    free(held_buf);
+    held_buf = NULL;
+}
+
+static void output(const char *format, ...) __attribute__((format(printf,1,2)));
+static void output(const char *format, ...) {
+    va_list ap;
+    char *buf;
+
+    va_start(ap, format);
+    if(held_out) {
+	vfprintf(held_out, format, ap);
+    } else if(vasprintf(&buf, format, ap) >= 0) {
+	halcmd_output("%s", buf);
+	free(buf);
+    }
+    va_end(ap);
+}
+
 int do_lock_cmd(char *command)
 {
     int retval=0;
@@ -154,6 +229,192 @@ int do_unlock_cmd(char *command)
     return retval;
 }
 
+/* A batch holds the HAL mutex from 'begin' to 'commit', so a long
+   file of net/setp/addf commands is applied without other processes
+   interleaving with it.  Each change made inside the batch is logged,
+   and if a command fails the log is played back in reverse to leave
+   HAL as it was at 'begin'.  Deleting commands (delsig, unlinkp, delf)
+   are not logged and cannot be undone.
+*/
+typedef enum {
+    UNDO_DELSIG,		/* delete a signal made by newsig/net */
+    UNDO_UNLINK,		/* unlink a pin linked by net/linkps */
+    UNDO_DELF,			/* remove a function added by addf */
+    UNDO_VALUE			/* restore a value changed by setp/sets */
+} undo_type_t;
+
+typedef struct {
+    undo_type_t type;
+    char name[HAL_NAME_LEN + 1];
+    char name2[HAL_NAME_LEN + 1];
+    void *addr;
+    int size;
+    hal_data_u value;
+} undo_entry_t;
+
+static int batch_active = 0;
+static undo_entry_t *undo_log = 0;
+static int undo_count = 0;
+static int undo_alloc = 0;
+
+static undo_entry_t *undo_push(undo_type_t type, const char *name,
+    const char *name2)
+{
+    undo_entry_t *u;
+
+    if (!batch_active) {
+	return 0;
+    }
+    if (undo_count == undo_alloc) {
+	int n = undo_alloc ? undo_alloc * 2 : 256;
+	u = realloc(undo_log, n * sizeof(undo_entry_t));
+	if (u == 0) {
+	    halcmd_warning("out of memory, batch can not be rolled back\n");
+	    return 0;
+	}
+	undo_log = u;
+	undo_alloc = n;
+    }
+    u = &undo_log[undo_count++];
+    u->type = type;
+    rtapi_snprintf(u->name, sizeof(u->name), "%s", name ? name : "");
+    rtapi_snprintf(u->name2, sizeof(u->name2), "%s", name2 ? name2 : "");
+    u->addr = 0;
+    u->size = 0;
+    return u;
+}
+
+/* save the current contents of a pin, param or signal value */
+static void undo_push_value(hal_type_t type, void *d_ptr)
+{
+    undo_entry_t *u;
+    int size;
+
+    switch (type) {
+    case HAL_BIT:
+	size = sizeof(hal_bit_t);
+	break;
+    case HAL_FLOAT:
+	size = sizeof(hal_float_t);
+	break;
+    case HAL_S32:
+	size = sizeof(hal_s32_t);
+	break;
+    case HAL_U32:
+	size = sizeof(hal_u32_t);
+	break;
+    default:
+	return;
+    }
+    u = undo_push(UNDO_VALUE, 0, 0);
+    if (u) {
+	u->addr = d_ptr;
+	u->size = size;
+	memcpy(&u->value, d_ptr, size);
+    }
+}
+
+static int pin_is_linked(const char *name)
+{
+    hal_pin_t *pin;
+    int linked;
+
+    halpr_mutex_get();
+    pin = halpr_find_pin_by_name(name);
+    linked = pin && pin->signal;
+    halpr_mutex_give();
+    return linked;
+}
+
+int halcmd_batch_active(void)
+{
+    return batch_active;
+}
+
+/* let another HAL process (loadrt, loadusr) run inside a batch */
+void halcmd_batch_suspend(void)
+{
+    if (batch_active) {
+	halpr_batch_end();
+    }
+}
+
+void halcmd_batch_resume(void)
+{
+    if (batch_active) {
+	halpr_batch_begin();
+    }
+}
+
+int halcmd_batch_rollback(void)
+{
+    undo_entry_t *u;
+    int errors = 0;
+
+    if (!batch_active) {
+	return 0;
+    }
+    while (undo_count > 0) {
+	u = &undo_log[--undo_count];
+	switch (u->type) {
+	case UNDO_DELSIG:
+	    errors += hal_signal_delete(u->name) < 0;
+	    break;
+	case UNDO_UNLINK:
+	    errors += hal_unlink(u->name) < 0;
+	    break;
+	case UNDO_DELF:
+	    errors += hal_del_funct_from_thread(u->name, u->name2) < 0;
+	    break;
+	case UNDO_VALUE:
+	    memcpy(u->addr, &u->value, u->size);
+	    break;
+	}
+    }
+    batch_active = 0;
+    halpr_batch_end();
+    if (errors) {
+	halcmd_error("batch rollback incomplete, %d changes remain\n", errors);
+	return -EINVAL;
+    }
+    halcmd_info("Batch rolled back\n");
+    return 0;
+}
+
+int do_begin_cmd(void)
+{
+    if (batch_active) {
+	halcmd_error("batch already open\n");
+	return -EINVAL;
+    }
+    halpr_batch_begin();
+    batch_active = 1;
+    undo_count = 0;
+    return 0;
+}
+
+int do_commit_cmd(void)
+{
+    if (!batch_active) {
+	halcmd_error("no batch open\n");
+	return -EINVAL;
+    }
+    batch_active = 0;
+    halpr_batch_end();
+    halcmd_info("Batch committed, %d changes\n", undo_count);
+    undo_count = 0;
+    return 0;
+}
+
+int do_rollback_cmd(void)
+{
+    if (!batch_active) {
+	halcmd_error("no batch open\n");
+	return -EINVAL;
+    }
+    return halcmd_batch_rollback();
+}
+
 int do_linkpp_cmd(char *first_pin_name, char *second_pin_name)
 {
     int retval;
@@ -164,23 +425,23 @@ int do_linkpp_cmd(char *first_pin_name, char *second_pin_name)
 	halcmd_warning("linkpp command is deprecated, use 'net'\n");
 	dep_msg_printed = 1;
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* check if the pins are there */
     first_pin = halpr_find_pin_by_name(first_pin_name);
     second_pin = halpr_find_pin_by_name(second_pin_name);
     if (first_pin == 0) {
 	/* first pin not found*/
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("pin '%s' not found\n", first_pin_name);
 	return -EINVAL; 
     } else if (second_pin == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("pin '%s' not found\n", second_pin_name);
 	return -EINVAL; 
     }
     
     /* give the mutex, as the other functions use their own mutex */
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     
     /* check that both pins have the same type, 
        don't want to create a sig, which after that won't be usefull */
@@ -194,12 +455,17 @@ int do_linkpp_cmd(char *first_pin_name, char *second_pin_name)
     retval = hal_signal_new(first_pin_name, first_pin->type);
 
     if (retval == 0) {
+	undo_push(UNDO_DELSIG, first_pin_name, 0);
 	/* if it worked, link the pins to it */
 	retval = hal_link(first_pin_name, first_pin_name);
 
 	if ( retval == 0 ) {
+	    undo_push(UNDO_UNLINK, first_pin_name, 0);
 	/* if that worked, link the second pin to the new signal */
 	    retval = hal_link(second_pin_name, first_pin_name);
+	    if ( retval == 0 ) {
+		undo_push(UNDO_UNLINK, second_pin_name, 0);
+	    }
 	}
     }
     if (retval < 0) {
@@ -210,10 +476,14 @@ int do_linkpp_cmd(char *first_pin_name, char *second_pin_name)
 
 int do_linkps_cmd(char *pin, char *sig)
 {
-    int retval;
+    int retval, was_linked;
 
+    was_linked = batch_active && pin_is_linked(pin);
     retval = hal_link(pin, sig);
     if (retval == 0) {
+	if (!was_linked) {
+	    undo_push(UNDO_UNLINK, pin, 0);
+	}
 	/* print success message */
         halcmd_info("Pin '%s' linked to signal '%s'\n", pin, sig);
     } else {
@@ -299,6 +569,33 @@ int do_stop_cmd(void) {
     return retval;
 }
 
+int do_compact_cmd(void) {
+    int retval = hal_compact_signals();
+    if (retval == 0) {
+        /* print success message */
+        halcmd_info("Signals compacted\n");
+    }
+    return retval;
+}
+
+int do_fuse_cmd(char *thread) {
+    int retval = hal_fuse_thread(thread);
+    if (retval >= 0) {
+        halcmd_info("%d functions of thread '%s' fused\n", retval, thread);
+        retval = 0;
+    }
+    return retval;
+}
+
+int do_unfuse_cmd(char *thread) {
+    int retval = hal_unfuse_thread(thread);
+    if (retval >= 0) {
+        halcmd_info("%d functions of thread '%s' restored\n", retval, thread);
+        retval = 0;
+    }
+    return retval;
+}
+
 int do_addf_cmd(char *func, char *thread, char **opt) {
     char *position_str = opt ? opt[0] : NULL;
     int position = -1;
@@ -308,6 +605,7 @@ int do_addf_cmd(char *func, char *thread, char **opt) {
 
     retval = hal_add_funct_to_thread(func, thread, position);
     if(retval == 0) {
+        undo_push(UNDO_DELF, func, thread);
         halcmd_info("Function '%s' added to thread '%s'\n",
                     func, thread);
     } else {
@@ -451,14 +749,14 @@ int do_net_cmd(char *signal, char *pins[]) {
     hal_sig_t *sig;
     int i, retval;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* see if signal already exists */
     sig = halpr_find_sig_by_name(signal);
 
     /* verify that everything matches up (pin types, etc) */
     retval = preflight_net_cmd(signal, sig, pins);
     if(retval < 0) {
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return retval;
     }
 
@@ -469,21 +767,24 @@ int do_net_cmd(char *signal, char *pins[]) {
                     "Signal name '%s' must not be the same as a pin.  "
                     "Did you omit the signal name?\n",
 		signal);
-	    rtapi_mutex_give(&(hal_data->mutex));
+	    halpr_mutex_give();
 	    return -ENOENT;
 	}
     }
     if(!sig) {
         /* Create the signal with the type of the first pin */
         hal_pin_t *pin = halpr_find_pin_by_name(pins[0]);
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         if(!pin) {
             return -ENOENT;
         }
         retval = hal_signal_new(signal, pin->type);
+        if(retval == 0) {
+            undo_push(UNDO_DELSIG, signal, 0);
+        }
     } else {
 	/* signal already exists */
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
     }
     /* add pins to signal */
     for(i=0; retval == 0 && pins[i] && *pins[i]; i++) {
@@ -535,35 +836,35 @@ int do_newinst_cmd(char *comp_name, char *inst_name) {
         return -EINVAL;
     }
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
 
     while(hal_data->pending_constructor) {
         struct timespec ts = {0, 100 * 1000 * 1000}; // 100ms
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         nanosleep(&ts, NULL);
-        rtapi_mutex_get(&(hal_data->mutex));
+        halpr_mutex_get();
     }
     strncpy(hal_data->constructor_prefix, inst_name, HAL_NAME_LEN);
     hal_data->constructor_prefix[HAL_NAME_LEN]=0;
     hal_data->pending_constructor = comp->make;
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 
     if(fputc(' ', f) == EOF) {
         halcmd_error( "cannot write to proc entry: %s\n",
                 strerror(errno));
         fclose(f);
-        rtapi_mutex_get(&(hal_data->mutex));
+        halpr_mutex_get();
         hal_data->pending_constructor = 0;
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return -EINVAL;
     }
     if(fclose(f) != 0) {
         halcmd_error(
                 "cannot close proc entry: %s\n",
                 strerror(errno));
-        rtapi_mutex_get(&(hal_data->mutex));
+        halpr_mutex_get();
         hal_data->pending_constructor = 0;
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return -EINVAL;
     }
 
@@ -573,12 +874,12 @@ int do_newinst_cmd(char *comp_name, char *inst_name) {
     }
     }
 #endif
-    rtapi_mutex_get(&hal_data->mutex);
+    halpr_mutex_get();
     {
     hal_comp_t *inst = halpr_alloc_comp_struct();
     if (inst == 0) {
         /* couldn't allocate structure */
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         halcmd_error(
             "insufficient memory for instance '%s'\n", inst_name);
         return -ENOMEM;
@@ -594,7 +895,7 @@ int do_newinst_cmd(char *comp_name, char *inst_name) {
     inst->next_ptr = hal_data->comp_list_ptr;
     hal_data->comp_list_ptr = SHMOFF(inst);
 
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     }
     return 0;
 }
@@ -618,6 +919,8 @@ int do_newsig_cmd(char *name, char *type)
     }
     if (retval < 0) {
 	halcmd_error("newsig failed\n");
+    } else {
+	undo_push(UNDO_DELSIG, name, 0);
     }
     return retval;
 }
@@ -690,25 +993,25 @@ int do_setp_cmd(char *name, char *value)
 
     halcmd_info("setting parameter '%s' to '%s'\n", name, value);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search param list for name */
     param = halpr_find_param_by_name(name);
     if (param == 0) {
         pin = halpr_find_pin_by_name(name);
         if(pin == 0) {
-            rtapi_mutex_give(&(hal_data->mutex));
+            halpr_mutex_give();
             halcmd_error("parameter or pin '%s' not found\n", name);
             return -EINVAL;
         } else {
             /* found it */
             type = pin->type;
             if(pin->dir == HAL_OUT) {
-                rtapi_mutex_give(&(hal_data->mutex));
+                halpr_mutex_give();
                 halcmd_error("pin '%s' is not writable\n", name);
                 return -EINVAL;
             }
             if(pin->signal != 0) {
-                rtapi_mutex_give(&(hal_data->mutex));
+                halpr_mutex_give();
                 halcmd_error("pin '%s' is connected to a signal\n", name);
                 return -EINVAL;
             }
@@ -720,16 +1023,17 @@ int do_setp_cmd(char *name, char *value)
         type = param->type;
         /* is it read only? */
         if (param->dir == HAL_RO) {
-            rtapi_mutex_give(&(hal_data->mutex));
+            halpr_mutex_give();
             halcmd_error("param '%s' is not writable\n", name);
             return -EINVAL;
         }
         d_ptr = SHMPTR(param->data_ptr);
     }
 
+    undo_push_value(type, d_ptr);
     retval = set_common(type, d_ptr, value);
 
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     if (retval == 0) {
 	/* print success message */
         if(param) {
@@ -752,14 +1056,14 @@ int do_ptype_cmd(char *name)
     
     rtapi_print_msg(RTAPI_MSG_DBG, "getting parameter '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search param list for name */
     param = halpr_find_param_by_name(name);
     if (param) {
         /* found it */
         type = param->type;
         halcmd_output("%s\n", data_type2(type));
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return 0;
     }
         
@@ -769,11 +1073,11 @@ int do_ptype_cmd(char *name)
         /* found it */
         type = pin->type;
         halcmd_output("%s\n", data_type2(type));
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return 0;
     }   
     
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     halcmd_error("parameter '%s' not found\n", name);
     return -EINVAL;
 }
@@ -789,7 +1093,7 @@ int do_getp_cmd(char *name)
     
     rtapi_print_msg(RTAPI_MSG_DBG, "getting parameter '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search param list for name */
     param = halpr_find_param_by_name(name);
     if (param) {
@@ -797,7 +1101,7 @@ int do_getp_cmd(char *name)
         type = param->type;
         d_ptr = SHMPTR(param->data_ptr);
         halcmd_output("%s\n", data_value2((int) type, d_ptr));
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return 0;
     }
         
@@ -814,11 +1118,11 @@ int do_getp_cmd(char *name)
             d_ptr = &(pin->dummysig);
         }
         halcmd_output("%s\n", data_value2((int) type, d_ptr));
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         return 0;
     }   
     
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     halcmd_error("parameter '%s' not found\n", name);
     return -EINVAL;
 }
@@ -832,25 +1136,26 @@ int do_sets_cmd(char *name, char *value)
 
     rtapi_print_msg(RTAPI_MSG_DBG, "setting signal '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search signal list for name */
     sig = halpr_find_sig_by_name(name);
     if (sig == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("signal '%s' not found\n", name);
 	return -EINVAL;
     }
     /* found it - does it have a writer? */
     if (sig->writers > 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("signal '%s' already has writer(s)\n", name);
 	return -EINVAL;
     }
     /* no writer, so we can safely set it */
     type = sig->type;
     d_ptr = SHMPTR(sig->data_ptr);
+    undo_push_value(type, d_ptr);
     retval = set_common(type, d_ptr, value);
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     if (retval == 0) {
 	/* print success message */
 	halcmd_info("Signal '%s' set to %s\n", name, value);
@@ -868,18 +1173,18 @@ int do_stype_cmd(char *name)
 
     rtapi_print_msg(RTAPI_MSG_DBG, "getting signal '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search signal list for name */
     sig = halpr_find_sig_by_name(name);
     if (sig == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("signal '%s' not found\n", name);
 	return -EINVAL;
     }
     /* found it */
     type = sig->type;
     halcmd_output("%s\n", data_type2(type));
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -891,11 +1196,11 @@ int do_gets_cmd(char *name)
 
     rtapi_print_msg(RTAPI_MSG_DBG, "getting signal '%s'\n", name);
     /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     /* search signal list for name */
     sig = halpr_find_sig_by_name(name);
     if (sig == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("signal '%s' not found\n", name);
 	return -EINVAL;
     }
@@ -903,7 +1208,7 @@ int do_gets_cmd(char *name)
     type = sig->type;
     d_ptr = SHMPTR(sig->data_ptr);
     halcmd_output("%s\n", data_value2((int) type, d_ptr));
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -936,6 +1241,7 @@ int do_show_cmd(char *type, char **patterns)
 	/* must be -Q, don't print anything */
 	return 0;
     }
+    hold_output();
     if (!type || *type == '\0') {
 	/* print everything */
 	print_comp_info(NULL);
@@ -977,15 +1283,21 @@ int do_show_cmd(char *type, char **patterns)
 	print_funct_info(patterns);
     } else if (strcmp(type, "function") == 0) {
 	print_funct_info(patterns);
+    } else if (strcmp(type, "functime") == 0) {
+	print_functime_info(patterns);
+    } else if (strcmp(type, "locality") == 0) {
+	print_locality_info(patterns);
     } else if (strcmp(type, "thread") == 0) {
 	print_thread_info(patterns);
     } else if (strcmp(type, "alias") == 0) {
 	print_pin_aliases(patterns);
 	print_param_aliases(patterns);
     } else {
+	release_output();
 	halcmd_error("Unknown 'show' type '%s'\n", type);
 	return -1;
     }
+    release_output();
     return 0;
 }
 
@@ -999,6 +1311,7 @@ int do_list_cmd(char *type, char **patterns)
 	/* must be -Q, don't print anything */
 	return 0;
     }
+    hold_output();
     if (strcmp(type, "comp") == 0) {
 	print_comp_names(patterns);
     } else if (strcmp(type, "pin") == 0) {
@@ -1018,9 +1331,11 @@ int do_list_cmd(char *type, char **patterns)
     } else if (strcmp(type, "thread") == 0) {
 	print_thread_names(patterns);
     } else {
+	release_output();
 	halcmd_error("Unknown 'list' type '%s'\n", type);
 	return -1;
     }
+    release_output();
     return 0;
 }
 
@@ -1031,6 +1346,7 @@ int do_status_cmd(char *type)
 	/* must be -Q, don't print anything */
 	return 0;
     }
+    hold_output();
     if ((type == NULL) || (strcmp(type, "all") == 0)) {
 	/* print everything */
 	/* add other status functions here if/when they are defined */
@@ -1041,19 +1357,58 @@ int do_status_cmd(char *type)
     } else if (strcmp(type, "mem") == 0) {
 	print_mem_status();
     } else {
+	release_output();
 	halcmd_error("Unknown 'status' type '%s'\n", type);
 	return -1;
     }
+    release_output();
     return 0;
 }
 
-int do_loadrt_cmd(char *mod_name, char *args[])
+/* remember the args a module was loaded with, in its component */
+static int loadrt_record(char *mod_name, char *args[])
 {
     char arg_string[MAX_CMD_LEN+1];
-    int m=0, n=0, retval;
+    int n;
     hal_comp_t *comp;
-    char *argv[MAX_TOK+3];
     char *cp1;
+
+    /* make the args that were passed to the module into a single string */
+    n = 0;
+    arg_string[0] = '\0';
+    while ( args[n] && args[n][0] != '\0' ) {
+	strncat(arg_string, args[n++], MAX_CMD_LEN);
+	strncat(arg_string, " ", MAX_CMD_LEN);
+    }
+    /* allocate HAL shmem for the string */
+    cp1 = hal_malloc(strlen(arg_string)+1);
+    if ( cp1 == NULL ) {
+	halcmd_error("failed to allocate memory for module args\n");
+	return -1;
+    }
+    /* copy string to shmem */
+    strcpy (cp1, arg_string);
+    /* get mutex before accessing shared data */
+    halpr_mutex_get();
+    /* search component list for the newly loaded component */
+    comp = halpr_find_comp_by_name(mod_name);
+    if (comp == 0) {
+	halpr_mutex_give();
+	halcmd_error("module '%s' not loaded\n", mod_name);
+	return -EINVAL;
+    }
+    /* link args to comp struct */
+    comp->insmod_args = SHMOFF(cp1);
+    halpr_mutex_give();
+    /* print success message */
+    halcmd_info("Realtime module '%s' loaded\n", mod_name);
+    return 0;
+}
+
+static int loadrt_one(char *mod_name, char *args[])
+{
+    int m=0, n=0, retval;
+    char *argv[MAX_TOK+3];
 #if defined(RTAPI_SIM)
     argv[m++] = "-Wn";
     argv[m++] = mod_name;
@@ -1124,36 +1479,110 @@ int do_loadrt_cmd(char *mod_name, char *args[])
         , retval );
 	return -1;
     }
-    /* make the args that were passed to the module into a single string */
-    n = 0;
-    arg_string[0] = '\0';
-    while ( args[n] && args[n][0] != '\0' ) {
-	strncat(arg_string, args[n++], MAX_CMD_LEN);
-	strncat(arg_string, " ", MAX_CMD_LEN);
+    return loadrt_record(mod_name, args);
+}
+
+/* 'loadrt a x=1 b c y=2' loads several modules; each word without
+   '=' starts the next one.  With RTAPI_SIM they go to rtapi_app in
+   one command, which saves a round trip and an exec for each, and
+   lets it read their files ahead together.  Either way a failure
+   does not stop the rest, and the command fails if any of them did. */
+static int loadrt_many(char *mod_name, char *args[])
+{
+    char *names[MAX_TOK+1];
+    char *list[2*MAX_TOK+2];	/* each module's args, NULL terminated */
+    char **margs[MAX_TOK+1];
+    int nmods=0, l=0, n, failed=0;
+#if defined(RTAPI_SIM)
+    char *argv[MAX_TOK+4];
+    int m=0, status, exited=0, ready=0;
+    pid_t pid;
+    hal_comp_t *comp;
+#endif
+
+    names[nmods] = mod_name;
+    margs[nmods++] = &list[l];
+    for (n = 0; args[n] && args[n][0] != '\0'; n++) {
+	if (strchr(args[n], '=') == NULL) {
+	    list[l++] = NULL;
+	    names[nmods] = args[n];
+	    margs[nmods++] = &list[l];
+	} else {
+	    list[l++] = args[n];
+	}
     }
-    /* allocate HAL shmem for the string */
-    cp1 = hal_malloc(strlen(arg_string)+1);
-    if ( cp1 == NULL ) {
-	halcmd_error("failed to allocate memory for module args\n");
+    list[l] = NULL;
+
+#if defined(RTAPI_SIM)
+    if (hal_get_lock()&HAL_LOCK_LOAD) {
+	halcmd_error("HAL is locked, loading of modules is not permitted\n");
+	return -EPERM;
+    }
+    argv[m++] = EMC2_BIN_DIR "/rtapi_app";
+    argv[m++] = "loadmany";
+    argv[m++] = mod_name;
+    for (n = 0; args[n] && args[n][0] != '\0'; n++) {
+	argv[m++] = args[n];
+    }
+    argv[m] = NULL;
+    pid = hal_systemv_nowait(argv);
+    if (comp_id < 0) {
+	fprintf(stderr, "halcmd: hal_init() failed after fork: %d\n",
+	    comp_id );
+	exit(-1);
+    }
+    hal_ready(comp_id);
+    if (pid < 0) {
 	return -1;
     }
-    /* copy string to shmem */
-    strcpy (cp1, arg_string);
-    /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
-    /* search component list for the newly loaded component */
-    comp = halpr_find_comp_by_name(mod_name);
-    if (comp == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
-	halcmd_error("module '%s' not loaded\n", mod_name);
-	return -EINVAL;
+    /* rtapi_app exits when it only passed the command on, and stays
+       to run the modules when it is the first; then they all being
+       ready means it is done */
+    while (!exited && !ready) {
+	struct timespec ts = {0, 10 * 1000 * 1000};
+	nanosleep(&ts, NULL);
+	if (waitpid(pid, &status, WNOHANG) != 0) {
+	    exited = 1;
+	    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		failed = 1;
+	    }
+	}
+	ready = 1;
+	halpr_mutex_get();
+	for (n = 0; n < nmods && ready; n++) {
+	    comp = halpr_find_comp_by_name(names[n]);
+	    ready = comp && comp->ready;
+	}
+	halpr_mutex_give();
     }
-    /* link args to comp struct */
-    comp->insmod_args = SHMOFF(cp1);
-    rtapi_mutex_give(&(hal_data->mutex));
-    /* print success message */
-    halcmd_info("Realtime module '%s' loaded\n", mod_name);
-    return 0;
+    if (failed) {
+	halcmd_error("rtapi_app failed to load some of the modules\n");
+    }
+    for (n = 0; n < nmods; n++) {
+	if (loadrt_record(names[n], margs[n]) != 0) {
+	    failed = 1;
+	}
+    }
+#else
+    for (n = 0; n < nmods; n++) {
+	if (loadrt_one(names[n], margs[n]) != 0) {
+	    failed = 1;
+	}
+    }
+#endif
+    return failed ? -1 : 0;
+}
+
+int do_loadrt_cmd(char *mod_name, char *args[])
+{
+    int n;
+
+    for (n = 0; args[n] && args[n][0] != '\0'; n++) {
+	if (strchr(args[n], '=') == NULL) {
+	    return loadrt_many(mod_name, args);
+	}
+    }
+    return loadrt_one(mod_name, args);
 }
 
 int do_delsig_cmd(char *mod_name)
@@ -1173,7 +1602,7 @@ int do_delsig_cmd(char *mod_name)
     } else {
 	/* build a list of signal(s) to delete */
 	n = 0;
-	rtapi_mutex_get(&(hal_data->mutex));
+	halpr_mutex_get();
 
 	next = hal_data->sig_list_ptr;
 	while (next != 0) {
@@ -1186,7 +1615,7 @@ int do_delsig_cmd(char *mod_name)
 	    }
 	    next = sig->next_ptr;
 	}
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	sigs[n][0] = '\0';
 
 	if ( ( sigs[0][0] == '\0' )) {
@@ -1231,7 +1660,7 @@ int do_unloadusr_cmd(char *mod_name)
 	all = 0;
     }
     /* build a list of component(s) to unload */
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->comp_list_ptr;
     while (next != 0) {
 	comp = SHMPTR(next);
@@ -1244,7 +1673,7 @@ int do_unloadusr_cmd(char *mod_name)
 	}
 	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return 0;
 }
 
@@ -1263,7 +1692,7 @@ int do_unloadrt_cmd(char *mod_name)
     }
     /* build a list of component(s) to unload */
     n = 0;
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->comp_list_ptr;
     while (next != 0) {
 	comp = SHMPTR(next);
@@ -1280,7 +1709,7 @@ int do_unloadrt_cmd(char *mod_name)
 	}
 	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* mark end of list */
     comps[n][0] = '\0';
     if ( !all && ( comps[0][0] == '\0' )) {
@@ -1344,10 +1773,10 @@ int do_unload_cmd(char *mod_name) {
     } else {
         hal_comp_t *comp;
         int type = -1;
-        rtapi_mutex_get(&(hal_data->mutex));
+        halpr_mutex_get();
         comp = halpr_find_comp_by_name(mod_name);
         if(comp) type = comp->type;
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         if(type == -1) {
             halcmd_error("component '%s' is not loaded\n",
                 mod_name);
@@ -1371,9 +1800,119 @@ static char *guess_comp_name(char *prog_name)
     return name;
 }
 
+/* programs started with 'loadusr -P', not yet waited for */
+#define MAX_PENDING 32
+static struct {
+    pid_t pid;
+    char comp[HAL_NAME_LEN+1];
+    char prog[HAL_NAME_LEN+1];
+} pending[MAX_PENDING];
+static int num_pending = 0;
+
+static long long int now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Waits for every program in pending[] to make its component ready, or
+   to exit.  halpr_wait_ready() wakes us as soon as one of them calls
+   hal_ready(); a program that dies without saying so is noticed within
+   the 100 ms the wait is bounded to.  Empties pending[] and returns the
+   number that did not become ready. */
+static int wait_pending(void)
+{
+    int n, left, failed = 0, pacified = 0;
+    int done[MAX_PENDING];
+    long long int start = now_ns(), shown = 0;
+    unsigned int seq;
+    hal_comp_t *comp;
+
+    for (n = 0; n < num_pending; n++) {
+	done[n] = 0;
+    }
+    left = num_pending;
+    while (left > 0) {
+	/* read the sequence first, so a component that becomes ready
+	   while we look is not slept through */
+	seq = hal_data->ready_seq;
+	__sync_synchronize();
+	for (n = 0; n < num_pending; n++) {
+	    int status, exited = 0;
+	    pid_t retval;
+
+	    if (done[n]) {
+		continue;
+	    }
+	    /* check for program ending */
+	    retval = waitpid(pending[n].pid, &status, WNOHANG);
+	    if (retval != 0) {
+		exited = 1;
+	    }
+	    /* check for program becoming ready */
+	    halpr_mutex_get();
+	    comp = halpr_find_comp_by_name(pending[n].comp);
+	    if (comp && comp->ready) {
+		done[n] = 1;
+	    }
+	    halpr_mutex_give();
+	    if (done[n]) {
+		halcmd_info("Component '%s' ready\n", pending[n].comp);
+	    } else if (exited) {
+		done[n] = 1;
+		failed++;
+		if (retval < 0) {
+		    halcmd_error("waitpid(%d) failed\n", pending[n].pid);
+		} else {
+		    halcmd_error("%s exited without becoming ready\n",
+			pending[n].prog);
+		}
+	    }
+	    if (done[n]) {
+		left--;
+	    }
+	}
+	if (left == 0) {
+	    break;
+	}
+	/* pacify the user */
+	if (now_ns() - start > 2000000000LL) {
+	    if (!pacified) {
+		for (n = 0; done[n]; n++) {
+		}
+		fprintf(stderr, "Waiting for component '%s' to become ready.",
+		    pending[n].comp);
+		pacified = 1;
+		shown = now_ns();
+	    } else if (now_ns() - shown > 100000000LL) {
+		fprintf(stderr, ".");
+		shown = now_ns();
+	    }
+	    fflush(stderr);
+	}
+	halpr_wait_ready(seq, 100000000L);
+    }
+    if (pacified) {
+	/* terminate pacifier */
+	fprintf(stderr, "\n");
+    }
+    num_pending = 0;
+    return failed;
+}
+
+int do_waitready_cmd(void)
+{
+    if (wait_pending() != 0) {
+	return -1;
+    }
+    return 0;
+}
+
 int do_loadusr_cmd(char *args[])
 {
-    int wait_flag, wait_comp_flag, ignore_flag;
+    int wait_flag, wait_comp_flag, ignore_flag, parallel_flag;
     char *prog_name, *new_comp_name=NULL;
     char *argv[MAX_TOK+1];
     int n, m, retval, status;
@@ -1390,12 +1929,13 @@ int do_loadusr_cmd(char *args[])
     wait_flag = 0;
     wait_comp_flag = 0;
     ignore_flag = 0;
+    parallel_flag = 0;
     prog_name = NULL;
 
-    /* check for options (-w, -i, and/or -r) */
+    /* check for options (-w, -W, -P, -i, and/or -n) */
     optind = 0;
     while (1) {
-	int c = getopt(argc, args, "+wWin:");
+	int c = getopt(argc, args, "+wWPin:");
 	if(c == -1) break;
 
 	switch(c) {
@@ -1403,6 +1943,8 @@ int do_loadusr_cmd(char *args[])
 		wait_flag = 1; break;
 	    case 'W':
 		wait_comp_flag = 1; break;
+	    case 'P':
+		parallel_flag = 1; break;
 	    case 'i':
 		ignore_flag = 1; break;
 	    case 'n':
@@ -1419,6 +1961,15 @@ int do_loadusr_cmd(char *args[])
     if(!new_comp_name) {
 	new_comp_name = guess_comp_name(prog_name);
     }
+    if (parallel_flag && (wait_flag || wait_comp_flag)) {
+	halcmd_error("-P can not be used with -w or -W\n");
+	return -EINVAL;
+    }
+    if (parallel_flag && num_pending == MAX_PENDING) {
+	halcmd_error("more than %d programs started with -P; "
+	    "use 'waitready'\n", MAX_PENDING);
+	return -EINVAL;
+    }
     /* prepare to exec() the program */
     argv[0] = prog_name;
     /* loop thru remaining arguments */
@@ -1438,50 +1989,24 @@ int do_loadusr_cmd(char *args[])
 	exit(-1);
     }
     hal_ready(comp_id);
-    if ( wait_comp_flag ) {
-        int ready = 0, count=0, exited=0;
-        hal_comp_t *comp = NULL;
-	retval = 0;
-        while(!ready && !exited) {
-	    /* sleep for 10mS */
-            struct timespec ts = {0, 10 * 1000 * 1000};
-            nanosleep(&ts, NULL);
-	    /* check for program ending */
-	    retval = waitpid( pid, &status, WNOHANG );
-	    if ( retval != 0 ) {
-		exited = 1;
-	    }
-	    /* check for program becoming ready */
-            rtapi_mutex_get(&(hal_data->mutex));
-            comp = halpr_find_comp_by_name(new_comp_name);
-            if(comp && comp->ready) {
-                ready = 1;
-            }
-            rtapi_mutex_give(&(hal_data->mutex));
-	    /* pacify the user */
-            count++;
-            if(count == 200) {
-                fprintf(stderr, "Waiting for component '%s' to become ready.",
-                        new_comp_name);
-                fflush(stderr);
-            } else if(count > 200 && count % 10 == 0) {
-                fprintf(stderr, ".");
-                fflush(stderr);
-            }
-        }
-        if (count >= 100) {
-	    /* terminate pacifier */
-	    fprintf(stderr, "\n");
+    if ( parallel_flag || wait_comp_flag ) {
+	if ( pid < 0 ) {
+	    return -1;
 	}
-	/* did it work? */
-	if (ready) {
-	    halcmd_info("Component '%s' ready\n", new_comp_name);
-	} else {
-	    if ( retval < 0 ) {
-		halcmd_error("\nwaitpid(%d) failed\n", pid);
-	    } else {
-		halcmd_error("%s exited without becoming ready\n", prog_name);
-	    }
+	pending[num_pending].pid = pid;
+	rtapi_snprintf(pending[num_pending].comp,
+	    sizeof(pending[num_pending].comp), "%s", new_comp_name);
+	rtapi_snprintf(pending[num_pending].prog,
+	    sizeof(pending[num_pending].prog), "%s", prog_name);
+	num_pending++;
+    }
+    if ( parallel_flag ) {
+	halcmd_info("Program '%s' started, not waited for yet\n", prog_name);
+	return 0;
+    }
+    if ( wait_comp_flag ) {
+	/* waits for any started with -P too */
+	if ( wait_pending() != 0 ) {
 	    return -1;
 	}
     }
@@ -1523,19 +2048,19 @@ int do_waitusr_cmd(char *comp_name)
 	halcmd_error("component name missing\n");
 	return -EINVAL;
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     comp = halpr_find_comp_by_name(comp_name);
     if (comp == NULL) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("component '%s' not found\n", comp_name);
 	return -EINVAL;
     }
     if (comp->type != 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
 	halcmd_error("'%s' is not a userspace component\n", comp_name);
 	return -EINVAL;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     /* let the user know what is going on */
     halcmd_info("Waiting for component '%s'\n", comp_name);
     exited = 0;
@@ -1544,12 +2069,12 @@ int do_waitusr_cmd(char *comp_name)
 	struct timespec ts = {0, 200 * 1000 * 1000};
 	nanosleep(&ts, NULL);
 	/* check for component still around */
-	rtapi_mutex_get(&(hal_data->mutex));
+	halpr_mutex_get();
 	comp = halpr_find_comp_by_name(comp_name);
 	if(comp == NULL) {
 		exited = 1;
 	}
-	rtapi_mutex_give(&(hal_data->mutex));
+	halpr_mutex_give();
     }
     halcmd_info("Component '%s' finished\n", comp_name);
     return 0;
@@ -1562,37 +2087,37 @@ static void print_comp_info(char **patterns)
     hal_comp_t *comp;
 
     if (scriptmode == 0) {
-	halcmd_output("Loaded HAL Components:\n");
-	halcmd_output("ID      Type  %-*s PID   State\n", HAL_NAME_LEN, "Name");
+	output("Loaded HAL Components:\n");
+	output("ID      Type  %-*s PID   State\n", HAL_NAME_LEN, "Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->comp_list_ptr;
     while (next != 0) {
 	comp = SHMPTR(next);
 	if ( match(patterns, comp->name) ) {
             if(comp->type == 2) {
                 hal_comp_t *comp1 = halpr_find_comp_by_id(comp->comp_id & 0xffff);
-                halcmd_output("    INST %s %s",
+                output("    INST %s %s",
                         comp1 ? comp1->name : "(unknown)", 
                         comp->name);
             } else {
-                halcmd_output(" %5d  %-4s  %-*s",
+                output(" %5d  %-4s  %-*s",
                     comp->comp_id, (comp->type ? "RT" : "User"),
                     HAL_NAME_LEN, comp->name);
                 if(comp->type == 0) {
-                        halcmd_output(" %5d %s", comp->pid, comp->ready > 0 ?
+                        output(" %5d %s", comp->pid, comp->ready > 0 ?
                                 "ready" : "initializing");
                 } else {
-                        halcmd_output(" %5s %s", "", comp->ready > 0 ?
+                        output(" %5s %s", "", comp->ready > 0 ?
                                 "ready" : "initializing");
                 }
             }
-            halcmd_output("\n");
+            output("\n");
 	}
 	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_pin_info(int type, char **patterns)
@@ -1604,10 +2129,10 @@ static void print_pin_info(int type, char **patterns)
     void *dptr;
 
     if (scriptmode == 0) {
-	halcmd_output("Component Pins:\n");
-	halcmd_output("Owner   Type  Dir         Value  Name\n");
+	output("Component Pins:\n");
+	output("Owner   Type  Dir         Value  Name\n");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
@@ -1621,14 +2146,14 @@ static void print_pin_info(int type, char **patterns)
 		dptr = &(pin->dummysig);
 	    }
 	    if (scriptmode == 0) {
-		halcmd_output(" %5d  %5s %-3s  %9s  %s",
+		output(" %5d  %5s %-3s  %9s  %s",
 		    comp->comp_id,
 		    data_type((int) pin->type),
 		    pin_data_dir((int) pin->dir),
 		    data_value((int) pin->type, dptr),
 		    pin->name);
 	    } else {
-		halcmd_output("%s %s %s %s %s",
+		output("%s %s %s %s %s",
 		    comp->name,
 		    data_type((int) pin->type),
 		    pin_data_dir((int) pin->dir),
@@ -1636,15 +2161,15 @@ static void print_pin_info(int type, char **patterns)
 		    pin->name);
 	    } 
 	    if (sig == 0) {
-		halcmd_output("\n");
+		output("\n");
 	    } else {
-		halcmd_output(" %s %s\n", data_arrow1((int) pin->dir), sig->name);
+		output(" %s %s\n", data_arrow1((int) pin->dir), sig->name);
 	    }
 	}
 	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_pin_aliases(char **patterns)
@@ -1654,10 +2179,10 @@ static void print_pin_aliases(char **patterns)
     hal_pin_t *pin;
 
     if (scriptmode == 0) {
-	halcmd_output("Pin Aliases:\n");
-	halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
+	output("Pin Aliases:\n");
+	output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
@@ -1666,16 +2191,16 @@ static void print_pin_aliases(char **patterns)
 	    oldname = SHMPTR(pin->oldname);
 	    if ( match(patterns, pin->name) || match(patterns, oldname->name) ) {
 		if (scriptmode == 0) {
-		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, pin->name, oldname->name);
+		    output(" %-*s  %s\n", HAL_NAME_LEN, pin->name, oldname->name);
 		} else {
-		    halcmd_output(" %s  %s\n", pin->name, oldname->name);
+		    output(" %s  %s\n", pin->name, oldname->name);
 		}
 	    }
 	}
 	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_sig_info(int type, char **patterns)
@@ -1689,28 +2214,28 @@ static void print_sig_info(int type, char **patterns)
     	print_script_sig_info(type, patterns);
 	return;
     }
-    halcmd_output("Signals:\n");
-    halcmd_output("Type          Value  Name     (linked to)\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    output("Signals:\n");
+    output("Type          Value  Name     (linked to)\n");
+    halpr_mutex_get();
     next = hal_data->sig_list_ptr;
     while (next != 0) {
 	sig = SHMPTR(next);
 	if ( tmatch(type, sig->type) && match(patterns, sig->name) ) {
 	    dptr = SHMPTR(sig->data_ptr);
-	    halcmd_output("%s  %s  %s\n", data_type((int) sig->type),
+	    output("%s  %s  %s\n", data_type((int) sig->type),
 		data_value((int) sig->type, dptr), sig->name);
 	    /* look for pin(s) linked to this signal */
 	    pin = halpr_find_pin_by_sig(sig, 0);
 	    while (pin != 0) {
-		halcmd_output("                         %s %s\n",
+		output("                         %s %s\n",
 		    data_arrow2((int) pin->dir), pin->name);
 		pin = halpr_find_pin_by_sig(sig, pin);
 	    }
 	}
 	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_script_sig_info(int type, char **patterns)
@@ -1723,27 +2248,27 @@ static void print_script_sig_info(int type, char **patterns)
     if (scriptmode == 0) {
     	return;
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->sig_list_ptr;
     while (next != 0) {
 	sig = SHMPTR(next);
 	if ( tmatch(type, sig->type) && match(patterns, sig->name) ) {
 	    dptr = SHMPTR(sig->data_ptr);
-	    halcmd_output("%s  %s  %s", data_type((int) sig->type),
+	    output("%s  %s  %s", data_type((int) sig->type),
 		data_value2((int) sig->type, dptr), sig->name);
 	    /* look for pin(s) linked to this signal */
 	    pin = halpr_find_pin_by_sig(sig, 0);
 	    while (pin != 0) {
-		halcmd_output(" %s %s",
+		output(" %s %s",
 		    data_arrow2((int) pin->dir), pin->name);
 		pin = halpr_find_pin_by_sig(sig, pin);
 	    }
-	    halcmd_output("\n");
+	    output("\n");
 	}
 	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_param_info(int type, char **patterns)
@@ -1753,23 +2278,23 @@ static void print_param_info(int type, char **patterns)
     hal_comp_t *comp;
 
     if (scriptmode == 0) {
-	halcmd_output("Parameters:\n");
-	halcmd_output("Owner   Type  Dir         Value  Name\n");
+	output("Parameters:\n");
+	output("Owner   Type  Dir         Value  Name\n");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->param_list_ptr;
     while (next != 0) {
 	param = SHMPTR(next);
 	if ( tmatch(type, param->type), match(patterns, param->name) ) {
 	    comp = SHMPTR(param->owner_ptr);
 	    if (scriptmode == 0) {
-		halcmd_output(" %5d  %5s %-3s  %9s  %s\n",
+		output(" %5d  %5s %-3s  %9s  %s\n",
 		    comp->comp_id, data_type((int) param->type),
 		    param_data_dir((int) param->dir),
 		    data_value((int) param->type, SHMPTR(param->data_ptr)),
 		    param->name);
 	    } else {
-		halcmd_output("%s %s %s %s %s\n",
+		output("%s %s %s %s %s\n",
 		    comp->name, data_type((int) param->type),
 		    param_data_dir((int) param->dir),
 		    data_value2((int) param->type, SHMPTR(param->data_ptr)),
@@ -1778,8 +2303,8 @@ static void print_param_info(int type, char **patterns)
 	}
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_param_aliases(char **patterns)
@@ -1789,10 +2314,10 @@ static void print_param_aliases(char **patterns)
     hal_param_t *param;
 
     if (scriptmode == 0) {
-	halcmd_output("Parameter Aliases:\n");
-	halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
+	output("Parameter Aliases:\n");
+	output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->param_list_ptr;
     while (next != 0) {
 	param = SHMPTR(next);
@@ -1801,16 +2326,16 @@ static void print_param_aliases(char **patterns)
 	    oldname = SHMPTR(param->oldname);
 	    if ( match(patterns, param->name) || match(patterns, oldname->name) ) {
 		if (scriptmode == 0) {
-		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, param->name, oldname->name);
+		    output(" %-*s  %s\n", HAL_NAME_LEN, param->name, oldname->name);
 		} else {
-		    halcmd_output(" %s  %s\n", param->name, oldname->name);
+		    output(" %s  %s\n", param->name, oldname->name);
 		}
 	    }
 	}
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_funct_info(char **patterns)
@@ -1820,23 +2345,23 @@ static void print_funct_info(char **patterns)
     hal_comp_t *comp;
 
     if (scriptmode == 0) {
-	halcmd_output("Exported Functions:\n");
-	halcmd_output("Owner   CodeAddr  Arg       FP   Users  Name\n");
+	output("Exported Functions:\n");
+	output("Owner   CodeAddr  Arg       FP   Users  Name\n");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->funct_list_ptr;
     while (next != 0) {
 	fptr = SHMPTR(next);
 	if ( match(patterns, fptr->name) ) {
 	    comp = SHMPTR(fptr->owner_ptr);
 	    if (scriptmode == 0) {
-		halcmd_output(" %05d  %08lx  %08lx  %-3s  %5d   %s\n",
+		output(" %05d  %08lx  %08lx  %-3s  %5d   %s\n",
 		    comp->comp_id,
 		    (long)fptr->funct,
 		    (long)fptr->arg, (fptr->uses_fp ? "YES" : "NO"),
 		    fptr->users, fptr->name);
 	    } else {
-		halcmd_output("%s %08lx %08lx %s %3d %s\n",
+		output("%s %08lx %08lx %s %3d %s\n",
 		    comp->name,
 		    (long)fptr->funct,
 		    (long)fptr->arg, (fptr->uses_fp ? "YES" : "NO"),
@@ -1845,8 +2370,135 @@ static void print_funct_info(char **patterns)
 	}
 	next = fptr->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
+}
+
+static void print_functime_info(char **patterns)
+{
+    int next, n, last;
+    hal_funct_t *fptr;
+    hal_u32_t calls, hist[HAL_FUNCT_HIST_BINS];
+    unsigned long long sum;
+    long min, max;
+
+    if (scriptmode == 0) {
+	output("Function Execution Times:\n");
+	output("      Calls       Min      Mean       Max  Name\n");
+    }
+    halpr_mutex_get();
+    next = hal_data->funct_list_ptr;
+    while (next != 0) {
+	fptr = SHMPTR(next);
+	if ( match(patterns, fptr->name) ) {
+	    /* the thread keeps updating these, so take a copy first */
+	    calls = fptr->calls;
+	    sum = fptr->sumtime;
+	    min = calls ? (long)fptr->mintime : 0;
+	    max = (long)fptr->maxtime;
+	    for (n = 0; n < HAL_FUNCT_HIST_BINS; n++) {
+		hist[n] = fptr->hist[n];
+	    }
+	    output(((scriptmode == 0) ? "%11lu  %8ld  %8ld  %8ld  %s\n" : "%lu %ld %ld %ld %s"),
+		(unsigned long)calls, min,
+		(long)(calls ? sum / calls : 0), max, fptr->name);
+	    /* histogram: each bin holds runs of fewer than 2^n clocks */
+	    last = -1;
+	    for (n = 0; n < HAL_FUNCT_HIST_BINS; n++) {
+		if (hist[n] != 0) {
+		    last = n;
+		}
+	    }
+	    for (n = 0; n <= last; n++) {
+		if (scriptmode == 0) {
+		    if (hist[n] != 0) {
+			output("                 < %10lu  %10lu\n",
+			    1UL << n, (unsigned long)hist[n]);
+		    }
+		} else {
+		    output(" %lu", (unsigned long)hist[n]);
+		}
+	    }
+	    if (scriptmode != 0) {
+		output("\n");
+	    }
+	}
+	next = fptr->next_ptr;
+    }
+    halpr_mutex_give();
+    output("\n");
+}
+
+/* how many lines the signals of the pins of 'comp_ptr' are spread
+   over, and how far apart the first and last are */
+#define MAX_LOCALITY_LINES 1024
+
+static void sig_locality(int comp_ptr, int *nsigs, int *nlines, long *span)
+{
+    static long lines[MAX_LOCALITY_LINES];
+    int next, n;
+    long line, lo, hi;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+
+    *nsigs = 0;
+    *nlines = 0;
+    lo = hi = 0;
+    next = hal_data->pin_list_ptr;
+    while (next != 0) {
+	pin = SHMPTR(next);
+	if (pin->owner_ptr == comp_ptr && pin->signal != 0) {
+	    sig = SHMPTR(pin->signal);
+	    if (*nsigs == 0 || sig->data_ptr < lo) {
+		lo = sig->data_ptr;
+	    }
+	    if (*nsigs == 0 || sig->data_ptr > hi) {
+		hi = sig->data_ptr;
+	    }
+	    (*nsigs)++;
+	    line = sig->data_ptr / HAL_CACHE_LINE;
+	    for (n = 0; n < *nlines && lines[n] != line; n++) {
+	    }
+	    if (n == *nlines && n < MAX_LOCALITY_LINES) {
+		lines[(*nlines)++] = line;
+	    }
+	}
+	next = pin->next_ptr;
+    }
+    *span = hi - lo;
+}
+
+static void print_locality_info(char **patterns)
+{
+    int next_thread, nsigs, nlines;
+    long span;
+    hal_thread_t *tptr;
+    hal_list_t *list_root, *list_entry;
+    hal_funct_t *funct;
+
+    if (scriptmode == 0) {
+	output("Signal Locality (%d byte cache lines):\n", HAL_CACHE_LINE);
+	output("Signals  Lines      Span  Thread / Function\n");
+    }
+    halpr_mutex_get();
+    next_thread = hal_data->thread_list_ptr;
+    while (next_thread != 0) {
+	tptr = SHMPTR(next_thread);
+	list_root = &(tptr->funct_list);
+	list_entry = list_next(list_root);
+	while (list_entry != list_root) {
+	    funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+	    if ( match(patterns, funct->name) ) {
+		sig_locality(funct->owner_ptr, &nsigs, &nlines, &span);
+		output(((scriptmode == 0) ? "%7d  %5d  %8ld  %s / %s\n" : "%d %d %ld %s %s\n"),
+		    nsigs, nlines, span, tptr->name, funct->name);
+	    }
+	    list_entry = list_next(list_entry);
+	}
+	next_thread = tptr->next_ptr;
+    }
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_thread_info(char **patterns)
@@ -1858,17 +2510,17 @@ static void print_thread_info(char **patterns)
     hal_funct_t *funct;
 
     if (scriptmode == 0) {
-	halcmd_output("Realtime Threads:\n");
-	halcmd_output("     Period  FP     Name               (     Time, Max-Time )\n");
+	output("Realtime Threads:\n");
+	output("     Period  FP     Name               (     Time, Max-Time )\n");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next_thread = hal_data->thread_list_ptr;
     while (next_thread != 0) {
 	tptr = SHMPTR(next_thread);
 	if ( match(patterns, tptr->name) ) {
 		/* note that the scriptmode format string has no \n */
 		// TODO FIXME add thread runtime and max runtime to this print
-	    halcmd_output(((scriptmode == 0) ? "%11ld  %-3s  %20s ( %8ld, %8ld )\n" : "%ld %s %s %ld %ld"),
+	    output(((scriptmode == 0) ? "%11ld  %-3s  %20s ( %8ld, %8ld )\n" : "%ld %s %s %ld %ld"),
 		tptr->period, (tptr->uses_fp ? "YES" : "NO"), tptr->name, (long)tptr->runtime, (long)tptr->maxtime);
 	    list_root = &(tptr->funct_list);
 	    list_entry = list_next(list_root);
@@ -1880,21 +2532,21 @@ static void print_thread_info(char **patterns)
 		/* scriptmode only uses one line per thread, which contains: 
 		   thread period, FP flag, name, then all functs separated by spaces  */
 		if (scriptmode == 0) {
-		    halcmd_output("                 %2d %s\n", n, funct->name);
+		    output("                 %2d %s\n", n, funct->name);
 		} else {
-		    halcmd_output(" %s", funct->name);
+		    output(" %s", funct->name);
 		}
 		n++;
 		list_entry = list_next(list_entry);
 	    }
 	    if (scriptmode != 0) {
-		halcmd_output("\n");
+		output("\n");
 	    }
 	}
 	next_thread = tptr->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_comp_names(char **patterns)
@@ -1902,17 +2554,17 @@ static void print_comp_names(char **patterns)
     int next;
     hal_comp_t *comp;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->comp_list_ptr;
     while (next != 0) {
 	comp = SHMPTR(next);
 	if ( match(patterns, comp->name) ) {
-	    halcmd_output("%s ", comp->name);
+	    output("%s ", comp->name);
 	}
 	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_pin_names(char **patterns)
@@ -1920,17 +2572,17 @@ static void print_pin_names(char **patterns)
     int next;
     hal_pin_t *pin;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
 	if ( match(patterns, pin->name) ) {
-	    halcmd_output("%s ", pin->name);
+	    output("%s ", pin->name);
 	}
 	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_sig_names(char **patterns)
@@ -1938,17 +2590,17 @@ static void print_sig_names(char **patterns)
     int next;
     hal_sig_t *sig;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->sig_list_ptr;
     while (next != 0) {
 	sig = SHMPTR(next);
 	if ( match(patterns, sig->name) ) {
-	    halcmd_output("%s ", sig->name);
+	    output("%s ", sig->name);
 	}
 	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_param_names(char **patterns)
@@ -1956,17 +2608,17 @@ static void print_param_names(char **patterns)
     int next;
     hal_param_t *param;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->param_list_ptr;
     while (next != 0) {
 	param = SHMPTR(next);
 	if ( match(patterns, param->name) ) {
-	    halcmd_output("%s ", param->name);
+	    output("%s ", param->name);
 	}
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_funct_names(char **patterns)
@@ -1974,17 +2626,17 @@ static void print_funct_names(char **patterns)
     int next;
     hal_funct_t *fptr;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->funct_list_ptr;
     while (next != 0) {
 	fptr = SHMPTR(next);
 	if ( match(patterns, fptr->name) ) {
-	    halcmd_output("%s ", fptr->name);
+	    output("%s ", fptr->name);
 	}
 	next = fptr->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_thread_names(char **patterns)
@@ -1992,17 +2644,17 @@ static void print_thread_names(char **patterns)
     int next_thread;
     hal_thread_t *tptr;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next_thread = hal_data->thread_list_ptr;
     while (next_thread != 0) {
 	tptr = SHMPTR(next_thread);
 	if ( match(patterns, tptr->name) ) {
-	    halcmd_output("%s ", tptr->name);
+	    output("%s ", tptr->name);
 	}
 	next_thread = tptr->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
-    halcmd_output("\n");
+    halpr_mutex_give();
+    output("\n");
 }
 
 static void print_lock_status()
@@ -2011,33 +2663,33 @@ static void print_lock_status()
 
     lock = hal_get_lock();
 
-    halcmd_output("HAL locking status:\n");
-    halcmd_output("  current lock value %d (%02x)\n", lock, lock);
+    output("HAL locking status:\n");
+    output("  current lock value %d (%02x)\n", lock, lock);
     
     if (lock == HAL_LOCK_NONE) 
-	halcmd_output("  HAL_LOCK_NONE - nothing is locked\n");
+	output("  HAL_LOCK_NONE - nothing is locked\n");
     if (lock & HAL_LOCK_LOAD) 
-	halcmd_output("  HAL_LOCK_LOAD    - loading of new components is locked\n");
+	output("  HAL_LOCK_LOAD    - loading of new components is locked\n");
     if (lock & HAL_LOCK_CONFIG) 
-	halcmd_output("  HAL_LOCK_CONFIG  - link and addf is locked\n");
+	output("  HAL_LOCK_CONFIG  - link and addf is locked\n");
     if (lock & HAL_LOCK_PARAMS) 
-	halcmd_output("  HAL_LOCK_PARAMS  - setting params is locked\n");
+	output("  HAL_LOCK_PARAMS  - setting params is locked\n");
     if (lock & HAL_LOCK_RUN) 
-	halcmd_output("  HAL_LOCK_RUN     - running/stopping HAL is locked\n");
+	output("  HAL_LOCK_RUN     - running/stopping HAL is locked\n");
 }
 
 static int count_list(int list_root)
 {
     int n, next;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = list_root;
     n = 0;
     while (next != 0) {
 	n++;
 	next = *((int *) SHMPTR(next));
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return n;
 }
 
@@ -2047,22 +2699,22 @@ static void print_mem_status()
     hal_pin_t *pin;
     hal_param_t *param;
 
-    halcmd_output("HAL memory status\n");
-    halcmd_output("  used/total shared memory:   %ld/%d\n", (long)(HAL_SIZE - hal_data->shmem_avail), HAL_SIZE);
+    output("HAL memory status\n");
+    output("  used/total shared memory:   %ld/%d\n", (long)(hal_data->shmem_size - hal_data->shmem_avail), hal_data->shmem_size);
     // count components
     active = count_list(hal_data->comp_list_ptr);
     recycled = count_list(hal_data->comp_free_ptr);
-    halcmd_output("  active/recycled components: %d/%d\n", active, recycled);
+    output("  active/recycled components: %d/%d\n", active, recycled);
     // count pins
     active = count_list(hal_data->pin_list_ptr);
     recycled = count_list(hal_data->pin_free_ptr);
-    halcmd_output("  active/recycled pins:       %d/%d\n", active, recycled);
+    output("  active/recycled pins:       %d/%d\n", active, recycled);
     // count parameters
     active = count_list(hal_data->param_list_ptr);
     recycled = count_list(hal_data->param_free_ptr);
-    halcmd_output("  active/recycled parameters: %d/%d\n", active, recycled);
+    output("  active/recycled parameters: %d/%d\n", active, recycled);
     // count aliases
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     active = 0;
     while (next != 0) {
@@ -2076,21 +2728,21 @@ static void print_mem_status()
 	if ( param->oldname != 0 ) active++;
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     recycled = count_list(hal_data->oldname_free_ptr);
-    halcmd_output("  active/recycled aliases:    %d/%d\n", active, recycled);
+    output("  active/recycled aliases:    %d/%d\n", active, recycled);
     // count signals
     active = count_list(hal_data->sig_list_ptr);
     recycled = count_list(hal_data->sig_free_ptr);
-    halcmd_output("  active/recycled signals:    %d/%d\n", active, recycled);
+    output("  active/recycled signals:    %d/%d\n", active, recycled);
     // count functions
     active = count_list(hal_data->funct_list_ptr);
     recycled = count_list(hal_data->funct_free_ptr);
-    halcmd_output("  active/recycled functions:  %d/%d\n", active, recycled);
+    output("  active/recycled functions:  %d/%d\n", active, recycled);
     // count threads
     active = count_list(hal_data->thread_list_ptr);
     recycled = count_list(hal_data->thread_free_ptr);
-    halcmd_output("  active/recycled threads:    %d/%d\n", active, recycled);
+    output("  active/recycled threads:    %d/%d\n", active, recycled);
 }
 
 /* Switch function for pin/sig/param type for the print_*_list functions */
@@ -2295,7 +2947,9 @@ static char *data_value2(int type, void *valptr)
 
 int do_save_cmd(char *type, char *filename)
 {
-    FILE *dst;
+    FILE *dst, *out;
+    char *buf = NULL;
+    size_t size = 0;
 
     if (rtapi_get_msg_level() == RTAPI_MSG_NONE) {
 	/* must be -Q, don't print anything */
@@ -2310,50 +2964,64 @@ int do_save_cmd(char *type, char *filename)
 	return -1;
 	}
     }
+    /* as with show, write it all out after the mutex is given back */
+    out = open_memstream(&buf, &size);
+    if (out == NULL) {
+	out = dst;
+    }
     if (type == 0 || *type == '\0') {
 	type = "all";
     }
     if (strcmp(type, "all" ) == 0) {
 	/* save everything */
-	save_comps(dst);
-	save_aliases(dst);
-        save_signals(dst, 1);
-        save_nets(dst, 3);
-	save_params(dst);
-	save_threads(dst);
+	save_comps(out);
+	save_aliases(out);
+        save_signals(out, 1);
+        save_nets(out, 3);
+	save_params(out);
+	save_threads(out);
     } else if (strcmp(type, "comp") == 0) {
-	save_comps(dst);
+	save_comps(out);
     } else if (strcmp(type, "alias") == 0) {
-	save_aliases(dst);
+	save_aliases(out);
     } else if (strcmp(type, "sig") == 0) {
-	save_signals(dst, 0);
+	save_signals(out, 0);
     } else if (strcmp(type, "signal") == 0) {
-	save_signals(dst, 0);
+	save_signals(out, 0);
     } else if (strcmp(type, "sigu") == 0) {
-	save_signals(dst, 1);
+	save_signals(out, 1);
     } else if (strcmp(type, "link") == 0) {
-	save_links(dst, 0);
+	save_links(out, 0);
     } else if (strcmp(type, "linka") == 0) {
-	save_links(dst, 1);
+	save_links(out, 1);
     } else if (strcmp(type, "net") == 0) {
-	save_nets(dst, 0);
+	save_nets(out, 0);
     } else if (strcmp(type, "neta") == 0) {
-	save_nets(dst, 1);
+	save_nets(out, 1);
     } else if (strcmp(type, "netl") == 0) {
-	save_nets(dst, 2);
+	save_nets(out, 2);
     } else if (strcmp(type, "netla") == 0 || strcmp(type, "netal") == 0) {
-	save_nets(dst, 3);
+	save_nets(out, 3);
     } else if (strcmp(type, "param") == 0) {
-	save_params(dst);
+	save_params(out);
     } else if (strcmp(type, "parameter") == 0) {
-	save_params(dst);
+	save_params(out);
     } else if (strcmp(type, "thread") == 0) {
-	save_threads(dst);
+	save_threads(out);
     } else {
 	halcmd_error("Unknown 'save' type '%s'\n", type);
+	if (out != dst) {
+	    fclose(out);
+	    free(buf);
+	}
         if (dst != stdout) fclose(dst);
 	return -1;
     }
+    if (out != dst) {
+	fclose(out);
+	fwrite(buf, 1, size, dst);
+	free(buf);
+    }
     if (dst != stdout) {
 	fclose(dst);
     }
@@ -2366,7 +3034,7 @@ static void save_comps(FILE *dst)
     hal_comp_t *comp;
 
     fprintf(dst, "# components\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->comp_list_ptr;
     while (next != 0) {
 	comp = SHMPTR(next);
@@ -2392,7 +3060,7 @@ static void save_comps(FILE *dst)
 	next = comp->next_ptr;
     }
 #endif
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_aliases(FILE *dst)
@@ -2403,7 +3071,7 @@ static void save_aliases(FILE *dst)
     hal_oldname_t *oldname;
 
     fprintf(dst, "# pin aliases\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
@@ -2425,7 +3093,7 @@ static void save_aliases(FILE *dst)
 	}
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_signals(FILE *dst, int only_unlinked)
@@ -2434,14 +3102,14 @@ static void save_signals(FILE *dst, int only_unlinked)
     hal_sig_t *sig;
 
     fprintf(dst, "# signals\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     
     for( next = hal_data->sig_list_ptr; next; next = sig->next_ptr) {
 	sig = SHMPTR(next);
         if(only_unlinked && (sig->readers || sig->writers)) continue;
 	fprintf(dst, "newsig %s %s\n", sig->name, data_type((int) sig->type));
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_links(FILE *dst, int arrow)
@@ -2452,7 +3120,7 @@ static void save_links(FILE *dst, int arrow)
     const char *arrow_str;
 
     fprintf(dst, "# links\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
@@ -2467,7 +3135,7 @@ static void save_links(FILE *dst, int arrow)
 	}
 	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_nets(FILE *dst, int arrow)
@@ -2478,7 +3146,7 @@ static void save_nets(FILE *dst, int arrow)
     const char *arrow_str;
 
     fprintf(dst, "# nets\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     
     for (next = hal_data->sig_list_ptr; next != 0; next = sig->next_ptr) {
 	sig = SHMPTR(next);
@@ -2550,7 +3218,7 @@ static void save_nets(FILE *dst, int arrow)
             }
         }
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_params(FILE *dst)
@@ -2559,7 +3227,7 @@ static void save_params(FILE *dst)
     hal_param_t *param;
 
     fprintf(dst, "# parameter values\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next = hal_data->param_list_ptr;
     while (next != 0) {
 	param = SHMPTR(next);
@@ -2570,7 +3238,7 @@ static void save_params(FILE *dst)
 	}
 	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 static void save_threads(FILE *dst)
@@ -2582,7 +3250,7 @@ static void save_threads(FILE *dst)
     hal_funct_t *funct;
 
     fprintf(dst, "# realtime thread/function links\n");
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     next_thread = hal_data->thread_list_ptr;
     while (next_thread != 0) {
 	tptr = SHMPTR(next_thread);
@@ -2597,12 +3265,12 @@ static void save_threads(FILE *dst)
 	}
 	next_thread = tptr->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 }
 
 int do_setexact_cmd() {
     int retval = 0;
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
     if(hal_data->base_period) {
         halcmd_error(
             "HAL_LIB: Cannot run 'setexact'"
@@ -2615,7 +3283,7 @@ int do_setexact_cmd() {
             "This mode is not suitable for running real hardware.\n");
         hal_data->exact_base_period = 1;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
     return retval;
 }
 
@@ -2658,6 +3326,12 @@ int do_help_cmd(char *command)
 	printf("  -Wn name to wait for the component, which will have the given name.\n");
 	printf("  -w  wait for program to finish\n");
 	printf("  -i  ignore program return value (use with -w)\n");
+	printf("  -P  start it, but wait for its component at the next\n");
+	printf("      'waitready' or 'loadusr -W', to start several at once\n");
+    } else if (strcmp(command, "waitready") == 0) {
+	printf("waitready\n");
+	printf("  Waits for the components of programs started with\n");
+	printf("  'loadusr -P' to become ready.\n");
     } else if ((strcmp(command, "linksp") == 0) || (strcmp(command,"linkps") == 0)) {
 	printf("linkps pinname [arrow] signame\n");
 	printf("linksp signame [arrow] pinname\n");
@@ -2743,10 +3417,14 @@ int do_help_cmd(char *command)
 	printf("show [type] [pattern]\n");
 	printf("  Prints info about HAL items of the specified type.\n");
 	printf("  'type' is 'comp', 'pin', 'sig', 'param', 'funct',\n");
-	printf("  'thread', or 'all'.  If 'type' is omitted, it assumes\n");
-	printf("  'all' with no pattern.  If 'pattern' is specified\n");
-	printf("  it prints only those items whose names match the\n");
-	printf("  pattern, which may be a 'shell glob'.\n");
+	printf("  'functime', 'locality', 'thread', or 'all'.  If 'type' is\n");
+	printf("  omitted, it assumes 'all' with no pattern.  'functime' shows\n");
+	printf("  the run time statistics and histogram of functions, and\n");
+	printf("  'locality' how many cache lines the signals of each\n");
+	printf("  function in a thread are spread over.\n");
+	printf("  If 'pattern' is specified it prints only those items\n");
+	printf("  whose names match the pattern, which may be a\n");
+	printf("  'shell glob'.\n");
     } else if (strcmp(command, "list") == 0) {
 	printf("list type [pattern]\n");
 	printf("  Prints the names of HAL items of the specified type.\n");
@@ -2780,6 +3458,32 @@ int do_help_cmd(char *command)
     } else if (strcmp(command, "stop") == 0) {
 	printf("stop\n");
 	printf("  Stops all realtime threads.\n");
+    } else if (strcmp(command, "compact") == 0) {
+	printf("compact\n");
+	printf("  Moves all signal values next to each other, grouped by\n");
+	printf("  the thread functions that use them, so each thread touches\n");
+	printf("  fewer cache lines.  Threads must be stopped.  'show\n");
+	printf("  locality' shows the result.\n");
+    } else if (strcmp(command, "fuse") == 0) {
+	printf("fuse threadname\n");
+	printf("  Replaces each run of two or more and2, or2, not, mux2,\n");
+	printf("  scale, sum2 and lossless conv functions in 'threadname'\n");
+	printf("  with one call to a kernel from the 'fuse' module, which\n");
+	printf("  must be loaded.  Threads must be stopped.\n");
+    } else if (strcmp(command, "unfuse") == 0) {
+	printf("unfuse threadname\n");
+	printf("  Puts back the functions that 'fuse' replaced.\n");
+    } else if (strcmp(command, "begin") == 0) {
+	printf("begin\n");
+	printf("  Starts a batch.  The HAL mutex is held until 'commit', and\n");
+	printf("  if a command fails all changes made since 'begin' by newsig,\n");
+	printf("  net, link*, addf, setp and sets are undone.\n");
+    } else if (strcmp(command, "commit") == 0) {
+	printf("commit\n");
+	printf("  Ends a batch, keeping its changes.\n");
+    } else if (strcmp(command, "rollback") == 0) {
+	printf("rollback\n");
+	printf("  Ends a batch, undoing its changes.\n");
     } else if (strcmp(command, "quit") == 0) {
 	printf("quit\n");
 	printf("  Stop processing input and terminate halcmd (when\n");
@@ -2815,6 +3519,7 @@ static void print_help_commands(void)
     printf("  loadrt              Load realtime module(s)\n");
     printf("  loadusr             Start user space program\n");
     printf("  waitusr             Waits for userspace component to exit\n");
+    printf("  waitready           Waits for components started with loadusr -P\n");
     printf("  unload              Unload realtime module or terminate userspace component\n");
     printf("  lock, unlock        Lock/unlock HAL behaviour\n");
     printf("  linkps              Link pin to signal\n");
@@ -2832,6 +3537,10 @@ static void print_help_commands(void)
     printf("  status              Display status information\n");
     printf("  save                Print config as commands\n");
     printf("  start, stop         Start/stop realtime threads\n");
+    printf("  compact             Group signal values by thread function\n");
+    printf("  fuse, unfuse        Run simple thread functions as one kernel\n");
+    printf("  begin, commit       Apply commands as one batch\n");
+    printf("  rollback            Undo the open batch\n");
     printf("  alias, unalias      Add or remove pin or parameter name aliases\n");
     printf("  quit, exit          Exit from halcmd\n");
 }
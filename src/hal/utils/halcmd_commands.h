@@ -50,6 +50,9 @@ extern int do_linkps_cmd(char *pin, char *signal);
 extern int do_linksp_cmd(char *signal, char *pin);
 extern int do_start_cmd();
 extern int do_stop_cmd();
+extern int do_compact_cmd();
+extern int do_fuse_cmd(char *thread);
+extern int do_unfuse_cmd(char *thread);
 extern int do_help_cmd(char *command);
 extern int do_lock_cmd(char *command);
 extern int do_unlock_cmd(char *command);
@@ -77,8 +80,17 @@ extern int do_unloadrt_cmd(char *mod_name);
 extern int do_unloadusr_cmd(char *mod_name);
 extern int do_loadusr_cmd(char *args[]);
 extern int do_waitusr_cmd(char *comp_name);
+extern int do_waitready_cmd(void);
 extern int do_save_cmd(char *type, char *filename);
 extern int do_setexact_cmd(void);
+extern int do_begin_cmd(void);
+extern int do_commit_cmd(void);
+extern int do_rollback_cmd(void);
+
+extern int halcmd_batch_active(void);
+extern void halcmd_batch_suspend(void);
+extern void halcmd_batch_resume(void);
+extern int halcmd_batch_rollback(void);
 
 pid_t hal_systemv_nowait(char *const argv[]);
 int hal_systemv(char *const argv[]);
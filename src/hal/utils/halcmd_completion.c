@@ -46,11 +46,11 @@
 static int argno;
 
 static const char *command_table[] = {
-    "loadrt", "loadusr", "unload", "lock", "unlock",
+    "loadrt", "loadusr", "waitready", "unload", "lock", "unlock",
     "linkps", "linksp", "linkpp", "unlinkp",
     "net", "newsig", "delsig", "getp", "gets", "setp", "sets", "ptype", "stype",
     "addf", "delf", "show", "list", "status", "save", "source",
-    "start", "stop", "quit", "exit", "help", "alias", "unalias", 
+    "start", "stop", "compact", "fuse", "unfuse", "begin", "commit", "rollback", "quit", "exit", "help", "alias", "unalias", 
     NULL,
 };
 
@@ -65,7 +65,8 @@ static const char *alias_table[] = {
 };
 
 static const char *show_table[] = {
-    "all", "alias", "comp", "pin", "sig", "param", "funct", "thread",
+    "all", "alias", "comp", "pin", "sig", "param", "funct", "functime",
+    "locality", "thread",
     NULL,
 };
 
@@ -586,7 +587,7 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
     match_writers = -1;
     match_direction = -1;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    halpr_mutex_get();
 
     if(startswith(buffer, "delsig ") && argno == 1) {
         result = func(text, signal_generator);
@@ -716,18 +717,18 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
     } else if(startswith(buffer, "unload ") && argno == 1) {
         result = func(text, comp_generator);
     } else if(startswith(buffer, "source ") && argno == 1) {
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         // leaves rl_attempted_completion_over = 0 to complete from filesystem
         return 0;
     } else if(startswith(buffer, "loadusr ") && argno < 3) {
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_mutex_give();
         // leaves rl_attempted_completion_over = 0 to complete from filesystem
         return func(text, loadusr_generator);
     } else if(startswith(buffer, "loadrt ") && argno == 1) {
         result = func(text, loadrt_generator);
     }
 
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_mutex_give();
 
     rl_attempted_completion_over = 1;
     return result;
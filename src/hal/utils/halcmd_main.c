@@ -74,6 +74,7 @@ int main(int argc, char **argv)
     int c, fd;
     int keep_going, retval, errorcount;
     int filemode = 0;
+    int batchmode = 0;
     char *filename = NULL;
     FILE *srcfile = NULL;
     char raw_buf[MAX_CMD_LEN+1];
@@ -91,7 +92,7 @@ int main(int argc, char **argv)
     keep_going = 0;
     /* start parsing the command line, options first */
     while(1) {
-        c = getopt(argc, argv, "+RCfi:kqQsvVh");
+        c = getopt(argc, argv, "+RCbfi:kqQsvVh");
         if(c == -1) break;
         switch(c) {
             case 'R':
@@ -111,6 +112,10 @@ int main(int argc, char **argv)
                 }
 		return 0;
 		break;
+	    case 'b':
+		/* -b = run all commands as one batch */
+		batchmode = 1;
+		break;
 	    case 'k':
 		/* -k = keep going */
 		keep_going = 1;
@@ -220,6 +225,9 @@ int main(int argc, char **argv)
     if ( halcmd_startup(0) != 0 ) return 1;
 
     errorcount = 0;
+    if (batchmode) {
+        do_begin_cmd();
+    }
     /* HAL init is OK, let's process the command(s) */
     if (srcfile == NULL) {
 #ifndef NO_INI
@@ -268,6 +276,14 @@ int main(int argc, char **argv)
 	    }
 	}
     }
+    /* close a batch left open by -b or a 'begin' without 'commit' */
+    if (halcmd_batch_active()) {
+        if (errorcount > 0) {
+            halcmd_batch_rollback();
+        } else {
+            do_commit_cmd();
+        }
+    }
     /* all done */
     halcmd_shutdown();
     if ( errorcount > 0 ) {
@@ -294,7 +310,8 @@ static int release_HAL_mutex(void)
         return -EINVAL;
     }
     /* get HAL shared memory block from RTAPI */
-    mem_id = rtapi_shmem_new(HAL_KEY, comp_id, HAL_SIZE);
+    /* just the header; this maps an existing block whole */
+    mem_id = rtapi_shmem_new(HAL_KEY, comp_id, sizeof(hal_data_t));
     if (mem_id < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
             "ERROR: could not open shared memory\n");
@@ -347,6 +364,8 @@ static void print_help_general(int showR)
     printf("\nUsage:   halcmd [options] [cmd [args]]\n\n");
     printf("\n         halcmd [options] -f [filename]\n\n");
     printf("options:\n\n");
+    printf("  -b             Batch - hold the HAL mutex for all commands and\n");
+    printf("                 undo them all if one fails.\n");
     printf("  -f [filename]  Read commands from 'filename', not command\n");
     printf("                 line.  If no filename, read from stdin.\n");
 #ifndef NO_INI
@@ -365,9 +384,10 @@ static void print_help_general(int showR)
     printf("  -V             Very verbose - print lots of junk.\n");
     printf("  -h             Help - print this help screen and exit.\n\n");
     printf("commands:\n\n");
-    printf("  loadrt, loadusr, waitusr, unload, lock, unlock, net, linkps, linksp,\n");
-    printf("  unlinkp, newsig, delsig, setp, getp, ptype, sets, gets, stype,\n");
-    printf("  addf, delf, show, list, save, status, start, stop, source, quit, exit\n");
+    printf("  loadrt, loadusr, waitready, waitusr, unload, lock, unlock, net,\n");
+    printf("  linkps, linksp, unlinkp, newsig, delsig, setp, getp, ptype, sets,\n");
+    printf("  gets, stype, addf, delf, show, list, save, status, start, stop,\n");
+    printf("  source, begin, commit, rollback, quit, exit\n");
     printf("  help           Lists all commands with short descriptions\n");
     printf("  help command   Prints detailed help for 'command'\n\n");
 }
@@ -31,7 +31,7 @@
             to max sessions. Default is no limit (-1).
   With -- -ini <inifile>, uses inifile instead of emc.ini. 
 
-  There are six commands supported, Where the commands set and get contain HAL
+  There are eight commands supported, Where the commands set and get contain HAL
   specific sub-commands based on the commands supported by halcmd. Commands and 
   most parameters are not case sensitive. The exceptions are passwords, 
   file paths and text strings.
@@ -72,6 +72,28 @@
   connection has control of the CNC (see enable sub-command below). This command
   has no parameters.
   
+  ==> Subscribe <==
+  
+  Subscribe <period> [Deadband <change>] <name> [[Deadband <change>] <name> ...]
+  Adds the named pins, signals or parameters to those the connection is sent,
+  and sets how often, in milliseconds, they are looked at. The names are
+  looked up once, and again only when the HAL's pins, signals or parameters
+  change. Each time one or more values have changed by more than the
+  deadband given before them, 0 if none was, the server sends them in
+  lines of
+  
+  UPDATE <name> <value> [<name> <value> ...]
+  
+  Bits are sent on any change, and every value is sent the first time. A
+  single thread reads the HAL for all the connections, taking the HAL mutex
+  once a period. The server responds with SUBSCRIBE ACK, or with
+  SUBSCRIBE <name> NAK if a name is not found, in which case none are added.
+  
+  ==> Unsubscribe <==
+  
+  Unsubscribe [<name> ...]
+  Stops the named values, or all of them, and responds with UNSUBSCRIBE ACK.
+  
   ==> Help <==
   
   The help command will return help information in text format over the telnet
@@ -204,6 +226,15 @@
   Get only, returns all information about the thread matching the 
   specified name.
 
+  Values <name> [<name> ...]
+
+  With get, returns VALUES and the values of the named pins, signals or
+  parameters, in the order given, all read at once. With set, takes
+  pairs of <name> <value> and sets them all, as setp and sets would, or
+  none if any name is not found or not writable, or any value is bad.
+  Up to 64 names may be given, and the command line may be 1023
+  characters long.
+
   LoadRt <name>
 
   Set only, loads the real time executable specified by name.
@@ -288,13 +319,13 @@
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
+#include <sys/time.h>
 #include <string.h>
 #include <math.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/uio.h>
-#include <pthread.h>
 #include <fnmatch.h>
 #include <getopt.h>
 
@@ -303,6 +334,7 @@
 #include "../hal_priv.h"	/* private HAL decls */
 /* non-EMC related uses of halrmt may want to avoid libnml dependency */
 #ifndef NO_INI
+#include "sockets.h"		/* sockServe() */
 #include "inifile.h"		/* iniFind() from libnml */
 #endif
 
@@ -352,9 +384,40 @@ char comp_name[HAL_NAME_LEN+1];	/* name for this instance of halrmt */
 char pwd[16] = "EMC\0";              // Connect password
 char enablePWD[16] = "EMCTOO\0";     // Enable password
 char serverName[24] = "EMCNETSVR\0"; // Server name written in hello response
-int sessions = 0;                    // Number of open sessions
 int maxSessions = -1;                // Maximum number of sessions to allow
 
+#define MAX_VALUES 64		/* names in one VALUES or SUBSCRIBE */
+#define MAX_SUBSCRIBERS 64
+#define SUB_TICK 0.010		/* how often the subscriptions are looked at */
+#define SUB_LINE_LEN 1000	/* an UPDATE line is split after this */
+
+/* A pin, signal or parameter looked up by name.  It is good for as long
+   as the HAL generation it was looked up in lasts. */
+typedef struct {
+  char name[HAL_NAME_LEN+1];
+  hal_type_t type;
+  void *ptr;			/* its value, 0 if it was not found */
+  int writable;
+} halHandleType;
+
+typedef struct {
+  halHandleType handle;
+  double deadband;		/* least change in a number worth sending */
+  hal_data_u value;		/* at the last snapshot */
+  hal_data_u sent;		/* last sent */
+  int unsent;			/* 1 until sent, and after an update is lost */
+} subItemType;
+
+/* what a connection has subscribed to */
+typedef struct {
+  subItemType *item;
+  int count;
+  int size;			/* of item */
+  double period;		/* seconds between snapshots */
+  double due;			/* time of the next one */
+  unsigned int generation;	/* HAL generation the handles are for */
+} subscriptionType;
+
 typedef struct {  
   int cliSock;
   char hostName[80];
@@ -365,26 +428,28 @@ typedef struct {
   int enabled;
   int commMode;
   int commProt;
-  char inBuf[256];
+  char inBuf[MAX_CMD_LEN];
   char outBuf[4096];
-  char progName[256];} connectionRecType;
+  char progName[256];
+  subscriptionType sub;} connectionRecType;
 
 
 int port = 5006;
 char errorStr[256];
 
-int server_sockfd, client_sockfd;
-socklen_t server_len, client_len;
+int server_sockfd;
+socklen_t server_len;
 struct sockaddr_in server_address;
-struct sockaddr_in client_address;
 int useSockets = 1;
 int tokenIdx;
 const char *delims = " \n\r\0";
 int connCount = -1;
 int enabledConn = -1;
+connectionRecType *subscribers[MAX_SUBSCRIBERS];
 
 typedef enum {
-  cmdHello, cmdSet, cmdGet, cmdQuit, cmdShutdown, cmdHelp, cmdUnknown} commandTokenType;
+  cmdHello, cmdSet, cmdGet, cmdQuit, cmdShutdown, cmdHelp, cmdSubscribe,
+  cmdUnsubscribe, cmdUnknown} commandTokenType;
   
 typedef enum {
   hcEcho, hcVerbose, hcEnable, hcConfig, hcCommMode, hcCommProt,
@@ -392,7 +457,7 @@ typedef enum {
   hcComp, hcPin, hcPinVal, hcSig, hcSigVal, hcParam, hcParamVal, hcFunct, hcThread,
   hcLoadRt, hcUnload, hcLoadUsr, hcLinkps, hcLinksp, hcLinkpp, hcNet, hcUnlinkp,
   hcLock, hcUnlock, hcNewSig, hcDelSig, hcSetP, hcSetS, hcAddF, hcDelF,
-  hcSave, hcStart, hcStop, hcUnknown
+  hcSave, hcStart, hcStop, hcValues, hcUnknown
   } halCommandType;
   
 typedef enum {
@@ -408,14 +473,15 @@ struct option longopts[] = {
   {0,0,0,0}
 };
 
-const char *commands[] = {"HELLO", "SET", "GET", "QUIT", "SHUTDOWN", "HELP", ""};
+const char *commands[] = {"HELLO", "SET", "GET", "QUIT", "SHUTDOWN", "HELP",
+  "SUBSCRIBE", "UNSUBSCRIBE", ""};
 const char *halCommands[] = {
   "ECHO", "VERBOSE", "ENABLE", "CONFIG", "COMM_MODE", "COMM_PROT",
   "COMPS", "PINS", "PINVALS", "SIGNALS", "SIGVALS", "PARAMS", "PARAMVALS", "FUNCTS", "THREADS",
   "COMP", "PIN", "PINVAL", "SIGNAL", "SIGVAL", "PARAM", "PARAMVAL", "FUNCT", "THREAD",
   "LOADRT", "UNLOAD", "LOADUSR", "LINKPS", "LINKSP", "LINKPP", "NET", "UNLINKP",
   "LOCK", "UNLOCK", "NEWSIG", "DELSIG", "SETP", "SETS", "ADDF", "DELF",
-  "SAVE", "START", "STOP", ""};
+  "SAVE", "START", "STOP", "VALUES", ""};
 
 #ifndef NO_INI
     FILE *inifile = NULL;
@@ -468,7 +534,7 @@ static int initSockets()
 static int sockWrite(connectionRecType *context)
 {
    strcat(context->outBuf, "\r\n");
-   return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+   return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
 }
 
 static void sockWriteError(const char *nakStr, connectionRecType *context)
@@ -591,7 +657,8 @@ static int release_HAL_mutex(void)
         return -EINVAL;
     }
     /* get HAL shared memory block from RTAPI */
-    mem_id = rtapi_shmem_new(HAL_KEY, comp_id, HAL_SIZE);
+    /* just the header; this maps an existing block whole */
+    mem_id = rtapi_shmem_new(HAL_KEY, comp_id, sizeof(hal_data_t));
     if (mem_id < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
             "ERROR: could not open shared memory\n");
@@ -960,6 +1027,88 @@ static int set_common(hal_type_t type, void *d_ptr, char *value, connectionRecTy
     return retval;
 }
 
+/* Looks up h->name, a pin, signal or parameter, and points h at its value.
+   Writable is as setp and sets see it.  This function assumes that the
+   mutex is held. */
+static int resolveName(halHandleType *h)
+{
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_param_t *param;
+
+    h->ptr = 0;
+    h->writable = 0;
+    if ((pin = halpr_find_pin_by_name(h->name)) != 0) {
+	h->type = pin->type;
+	if (pin->signal != 0) {
+	    sig = SHMPTR(pin->signal);
+	    h->ptr = SHMPTR(sig->data_ptr);
+	} else {
+	    h->ptr = &pin->dummysig;
+	    h->writable = (pin->dir != HAL_OUT);
+	}
+    } else if ((sig = halpr_find_sig_by_name(h->name)) != 0) {
+	h->type = sig->type;
+	h->ptr = SHMPTR(sig->data_ptr);
+	h->writable = (sig->writers == 0);
+    } else if ((param = halpr_find_param_by_name(h->name)) != 0) {
+	h->type = param->type;
+	h->ptr = SHMPTR(param->data_ptr);
+	h->writable = (param->dir != HAL_RO);
+    }
+    return h->ptr != 0 ? 0 : -EINVAL;
+}
+
+static void copyValue(hal_type_t type, void *d_ptr, hal_data_u *v)
+{
+    switch (type) {
+    case HAL_BIT: v->b = *((hal_bit_t *) d_ptr); break;
+    case HAL_FLOAT: v->f = *((hal_float_t *) d_ptr); break;
+    case HAL_S32: v->s = *((hal_s32_t *) d_ptr); break;
+    case HAL_U32: v->u = *((hal_u32_t *) d_ptr); break;
+    default: break;
+    }
+}
+
+static void storeValue(hal_type_t type, hal_data_u *v, void *d_ptr)
+{
+    switch (type) {
+    case HAL_BIT: *((hal_bit_t *) d_ptr) = v->b; break;
+    case HAL_FLOAT: *((hal_float_t *) d_ptr) = v->f; break;
+    case HAL_S32: *((hal_s32_t *) d_ptr) = v->s; break;
+    case HAL_U32: *((hal_u32_t *) d_ptr) = v->u; break;
+    default: break;
+    }
+}
+
+/* A value as data_value2() prints it, but into 'buf', as the reader
+   thread and the connections may format values at the same time */
+static int valueText(hal_type_t type, hal_data_u *v, char *buf)
+{
+    switch (type) {
+    case HAL_BIT: return sprintf(buf, "%s", v->b ? "TRUE" : "FALSE");
+    case HAL_FLOAT: return sprintf(buf, "%.7g", (double) v->f);
+    case HAL_S32: return sprintf(buf, "%ld", (long) v->s);
+    case HAL_U32: return sprintf(buf, "%lu", (unsigned long) (hal_u32_t) v->u);
+    default: return sprintf(buf, "unknown_type");
+    }
+}
+
+/* How far apart two values are, for deadbands; bits are 0 or 1 apart */
+static double valueChange(hal_type_t type, hal_data_u *a, hal_data_u *b)
+{
+    double d;
+
+    switch (type) {
+    case HAL_BIT: d = (a->b != b->b); break;
+    case HAL_FLOAT: d = (double) a->f - (double) b->f; break;
+    case HAL_S32: d = (double) a->s - (double) b->s; break;
+    case HAL_U32: d = (double) (hal_u32_t) a->u - (double) (hal_u32_t) b->u; break;
+    default: d = 0;
+    }
+    return d < 0 ? -d : d;
+}
+
 static int doSetp(char *name, char *value, connectionRecType *context)
 {
     const char *nakStr = "SET SETP NAK";
@@ -2653,6 +2802,44 @@ static cmdResponseType getThread(char *s, connectionRecType *context)
   return rtHandledNoError;
 }
 
+/* GET VALUES <name> [<name> ...]: the names are looked up and read with
+   one hold of the mutex, and the values returned in the order asked for */
+static cmdResponseType getValues(connectionRecType *context)
+{
+  halHandleType h[MAX_VALUES];
+  hal_data_u v[MAX_VALUES];
+  char *pch;
+  int n, i, bad;
+  size_t len;
+
+  n = 0;
+  while ((pch = strtok(NULL, delims)) != NULL) {
+    if (n == MAX_VALUES) return rtStandardError;
+    snprintf(h[n++].name, sizeof(h[0].name), "%s", pch);
+    }
+  if (n == 0) return rtStandardError;
+  bad = -1;
+  rtapi_mutex_get(&(hal_data->mutex));
+  for (i = 0; i < n; i++) {
+    if (resolveName(&h[i]) != 0) {
+      bad = i;
+      break;
+      }
+    copyValue(h[i].type, h[i].ptr, &v[i]);
+    }
+  rtapi_mutex_give(&(hal_data->mutex));
+  if (bad >= 0) {
+    sprintf(context->outBuf, "GET VALUES %s NAK", h[bad].name);
+    return rtCustomError;
+    }
+  len = sprintf(context->outBuf, "VALUES");
+  for (i = 0; i < n; i++) {
+    context->outBuf[len++] = ' ';
+    len += valueText(h[i].type, &v[i], context->outBuf + len);
+    }
+  return rtNoError;
+}
+
 int commandGet(connectionRecType *context)
 {
   static char *setNakStr = "GET NAK\r\n";
@@ -2664,7 +2851,7 @@ int commandGet(connectionRecType *context)
   
   pch = strtok(NULL, delims);
   if (pch == NULL) {
-    retval = write(context->cliSock, setNakStr, strlen(setNakStr));
+    retval = sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
     return 0;
     }
   strupr(pch);
@@ -2712,7 +2899,8 @@ int commandGet(connectionRecType *context)
     case hcDelF: ;
     case hcSave: ;
     case hcStart: ;
-    case hcStop: ;
+    case hcStop: ret = rtStandardError; break;
+    case hcValues: ret = getValues(context); break;
     case hcUnknown: ret = rtStandardError;
     }
   switch (ret) {
@@ -3017,6 +3205,45 @@ static cmdResponseType setStop(connectionRecType *context)
     return rtCustomHandledError;
 }
 
+/* SET VALUES <name> <value> [<name> <value> ...]: every name is looked
+   up and every value checked before any is written, with one hold of the
+   mutex, so either all of them change or none do */
+static cmdResponseType setValues(connectionRecType *context)
+{
+  static char *nakStr = "SET VALUES %s NAK\n\r";
+  halHandleType h[MAX_VALUES];
+  hal_data_u v[MAX_VALUES];
+  char *value[MAX_VALUES];
+  char *pch;
+  int n, i, bad;
+
+  n = 0;
+  while ((pch = strtok(NULL, delims)) != NULL) {
+    if (n == MAX_VALUES) return rtStandardError;
+    snprintf(h[n].name, sizeof(h[0].name), "%s", pch);
+    value[n] = strtok(NULL, delims);
+    if (value[n++] == NULL) return rtStandardError;
+    }
+  if (n == 0) return rtStandardError;
+  bad = -1;
+  rtapi_mutex_get(&(hal_data->mutex));
+  for (i = 0; i < n; i++)
+    if ((resolveName(&h[i]) != 0) || (h[i].writable == 0) ||
+        (set_common(h[i].type, &v[i], value[i], context) != 0)) {
+      bad = i;
+      break;
+      }
+  if (bad < 0)
+    for (i = 0; i < n; i++)
+      storeValue(h[i].type, &v[i], h[i].ptr);
+  rtapi_mutex_give(&(hal_data->mutex));
+  if (bad >= 0) {
+    sprintf(context->outBuf, nakStr, h[bad].name);
+    return rtCustomError;
+    }
+  return rtNoError;
+}
+
 #define MAX_TOKENS 5
 
 int commandSet(connectionRecType *context)
@@ -3034,19 +3261,20 @@ int commandSet(connectionRecType *context)
   
   pcmd = strtok(NULL, delims);
   if (pcmd == NULL) {
-    retval = write(context->cliSock, setNakStr, strlen(setNakStr));
+    retval = sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
     return 0;
     }
   strupr(pcmd);
   cmd = lookupHalCommand(pcmd);
   if ((cmd >= hcCommProt) && (context->cliSock != enabledConn)) {
     sprintf(context->outBuf, setCmdNakStr, pcmd);
-    retval = write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    retval = sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
     return 0;
     }
-  pch = strtok(NULL, delims);
+  /* values takes any number of tokens, and reads them itself */
+  pch = (cmd == hcValues) ? NULL : strtok(NULL, delims);
   i = 0;
-  while (pch != NULL) {
+  while ((pch != NULL) && (i < MAX_TOKENS)) {
     tokens[i] = pch;
     i++;
     pch = strtok(NULL, delims);
@@ -3095,23 +3323,24 @@ int commandSet(connectionRecType *context)
     case hcSave: setSave(tokens[0], tokens[1], context); break;
     case hcStart: setStart(context); break;
     case hcStop: setStop(context); break;
+    case hcValues: ret = setValues(context); break;
     case hcUnknown: ret = rtStandardError;
     }
   switch (ret) {
     case rtNoError:  
       if (context->verbose) {
         sprintf(context->outBuf, ackStr, pcmd);
-        retval = write(context->cliSock, context->outBuf, strlen(context->outBuf));
+        retval = sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
         }
       break;
     case rtHandledNoError: // Custom ok response already handled, take no action
       break; 
     case rtStandardError:
       sprintf(context->outBuf, setCmdNakStr, pcmd);
-      retval = write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      retval = sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomError: // Custom error response entered in buffer
-      retval = write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      retval = sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
       break;
     case rtCustomHandledError: ;// Custom error respose handled, take no action
     }
@@ -3137,6 +3366,225 @@ int commandShutdown(connectionRecType *context)
     return 0;
 }
 
+/* Looks the names of a subscription up again, after the HAL has changed.
+   This function assumes that the mutex is held. */
+static void resolveSubscription(subscriptionType *sub)
+{
+  int i;
+
+  for (i = 0; i < sub->count; i++) {
+    resolveName(&sub->item[i].handle);
+    sub->item[i].unsent = 1;
+    }
+  sub->generation = hal_data->generation;
+}
+
+static void removeSubscriber(connectionRecType *context)
+{
+  int i;
+
+  for (i = 0; i < MAX_SUBSCRIBERS; i++)
+    if (subscribers[i] == context) subscribers[i] = NULL;
+}
+
+/* SUBSCRIBE <period> [DEADBAND <change>] <name> [[DEADBAND <change>] <name> ...]
+   adds the names to those the connection is sent, and sets how often, in
+   ms, they are looked at.  A value is sent when it has changed by more
+   than the deadband in force for it, which is 0 until one is given. */
+int commandSubscribe(connectionRecType *context)
+{
+  static char *subNakStr = "SUBSCRIBE NAK\r\n";
+  static char *subNameNakStr = "SUBSCRIBE %s NAK\r\n";
+  static char *subAckStr = "SUBSCRIBE ACK\r\n";
+  subscriptionType *sub;
+  subItemType item[MAX_VALUES], *p;
+  double period, deadband;
+  char *pch;
+  int n, i, j, bad;
+
+  pch = strtok(NULL, delims);
+  if ((context->linked == 0) || (pch == NULL) ||
+      (sscanf(pch, "%lf", &period) != 1) || (period <= 0))
+    return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+  deadband = 0;
+  n = 0;
+  while ((pch = strtok(NULL, delims)) != NULL) {
+    if (strcasecmp(pch, "DEADBAND") == 0) {
+      pch = strtok(NULL, delims);
+      if ((pch == NULL) || (sscanf(pch, "%lf", &deadband) != 1) || (deadband < 0))
+        return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+      continue;
+      }
+    if (n == MAX_VALUES)
+      return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+    memset(&item[n], 0, sizeof(item[n]));
+    snprintf(item[n].handle.name, sizeof(item[n].handle.name), "%s", pch);
+    item[n].deadband = deadband;
+    item[n++].unsent = 1;
+    }
+  if (n == 0)
+    return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+  sub = &context->sub;
+  bad = -1;
+  rtapi_mutex_get(&(hal_data->mutex));
+  for (i = 0; i < n; i++)
+    if (resolveName(&item[i].handle) != 0) {
+      bad = i;
+      break;
+      }
+  if (bad < 0) {
+    if ((sub->count > 0) && (sub->generation != hal_data->generation))
+      resolveSubscription(sub);
+    sub->generation = hal_data->generation;
+    }
+  rtapi_mutex_give(&(hal_data->mutex));
+  if (bad >= 0) {
+    sprintf(context->outBuf, subNameNakStr, item[bad].handle.name);
+    return sockQueue(context->cliSock, context->outBuf, strlen(context->outBuf));
+    }
+  for (i = 0; (i < MAX_SUBSCRIBERS) && (subscribers[i] != context); i++);
+  if (i == MAX_SUBSCRIBERS) {
+    for (i = 0; (i < MAX_SUBSCRIBERS) && (subscribers[i] != NULL); i++);
+    if (i == MAX_SUBSCRIBERS) {
+      return sockQueue(context->cliSock, subNakStr, strlen(subNakStr));
+      }
+    subscribers[i] = context;
+    }
+  for (i = 0; i < n; i++) {
+    /* a name subscribed to again just gets the new deadband */
+    for (j = 0; j < sub->count; j++)
+      if (strcmp(sub->item[j].handle.name, item[i].handle.name) == 0) break;
+    if (j < sub->count) {
+      sub->item[j].deadband = item[i].deadband;
+      continue;
+      }
+    if (sub->count == sub->size) {
+      p = realloc(sub->item, (sub->size + MAX_VALUES) * sizeof(subItemType));
+      if (p == NULL) break;
+      sub->item = p;
+      sub->size += MAX_VALUES;
+      }
+    sub->item[sub->count++] = item[i];
+    }
+  sub->period = period / 1000.0;
+  sub->due = 0;
+  return sockQueue(context->cliSock, subAckStr, strlen(subAckStr));
+}
+
+/* UNSUBSCRIBE [<name> ...] stops the names, or all of them */
+int commandUnsubscribe(connectionRecType *context)
+{
+  static char *unsubAckStr = "UNSUBSCRIBE ACK\r\n";
+  subscriptionType *sub;
+  char *pch;
+  int i, j;
+
+  sub = &context->sub;
+  pch = strtok(NULL, delims);
+  if (pch == NULL) sub->count = 0;
+  while (pch != NULL) {
+    for (i = 0, j = 0; i < sub->count; i++)
+      if (strcmp(sub->item[i].handle.name, pch) != 0)
+        sub->item[j++] = sub->item[i];
+    sub->count = j;
+    pch = strtok(NULL, delims);
+    }
+  if (sub->count == 0) removeSubscriber(context);
+  return sockQueue(context->cliSock, unsubAckStr, strlen(unsubAckStr));
+}
+
+static double timeNow(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* Adds to buf the UPDATE text for the values of a subscription that have
+   moved past their deadbands, and returns its new length.  *size is how
+   big buf is now; it is grown as needed. */
+static size_t formatUpdate(subscriptionType *sub, char **buf, size_t *size)
+{
+  subItemType *item;
+  size_t len, line;
+  char *p;
+  int i;
+
+  len = 0;
+  line = 0;
+  for (i = 0; i < sub->count; i++) {
+    item = &sub->item[i];
+    if (item->handle.ptr == 0) continue;
+    if ((item->unsent == 0) && (valueChange(item->handle.type, &item->value,
+        &item->sent) <= (item->handle.type == HAL_BIT ? 0 : item->deadband)))
+      continue;
+    if (len + HAL_NAME_LEN + 40 > *size) {
+      p = realloc(*buf, *size + 4096);
+      if (p == NULL) break;
+      *buf = p;
+      *size += 4096;
+      }
+    if ((line > 0) && (len - line > SUB_LINE_LEN)) {
+      len += sprintf(*buf + len, "\r\n");
+      line = 0;
+      }
+    if (line == 0) {
+      line = len;
+      len += sprintf(*buf + len, "UPDATE");
+      }
+    len += sprintf(*buf + len, " %s ", item->handle.name);
+    len += valueText(item->handle.type, &item->value, *buf + len);
+    item->sent = item->value;
+    item->unsent = 0;
+    }
+  if (line > 0) len += sprintf(*buf + len, "\r\n");
+  return len;
+}
+
+/* Reads the HAL for the subscriptions, once a tick.  It takes the mutex
+   once, for all the connections that are due, and copies their values
+   out; they are then compared and sent with the mutex given back.  A
+   connection that hasn't taken what it was sent last time is tried again
+   next tick. */
+static void readSubscriptions(void)
+{
+  subscriptionType *sub;
+  static char *buf = NULL;
+  static size_t size = 0;
+  size_t len;
+  double now;
+  int i, n, read;
+
+  now = timeNow();
+  read = 0;
+  for (i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if ((subscribers[i] == NULL) || (subscribers[i]->sub.due > now)) continue;
+    if (sockPending(subscribers[i]->cliSock) > 0) continue;
+    sub = &subscribers[i]->sub;
+    if (read == 0) {
+      rtapi_mutex_get(&(hal_data->mutex));
+      read = 1;
+      }
+    if (sub->generation != hal_data->generation) resolveSubscription(sub);
+    for (n = 0; n < sub->count; n++)
+      if (sub->item[n].handle.ptr != 0)
+        copyValue(sub->item[n].handle.type, sub->item[n].handle.ptr,
+          &sub->item[n].value);
+    }
+  if (read == 0) return;
+  rtapi_mutex_give(&(hal_data->mutex));
+  for (i = 0; i < MAX_SUBSCRIBERS; i++) {
+    if ((subscribers[i] == NULL) || (subscribers[i]->sub.due > now)) continue;
+    if (sockPending(subscribers[i]->cliSock) > 0) continue;
+    sub = &subscribers[i]->sub;
+    len = formatUpdate(sub, &buf, &size);
+    if (len) sockQueue(subscribers[i]->cliSock, buf, len);
+    sub->due += sub->period;
+    if (sub->due <= now) sub->due = now + sub->period;
+    }
+}
+
 static int helpGeneral(connectionRecType *context)
 {
   sprintf(context->outBuf, "Available commands:\n\r");
@@ -3145,6 +3593,8 @@ static int helpGeneral(connectionRecType *context)
   strcat(context->outBuf, "  Set <emc command>\n\r");
   strcat(context->outBuf, "  Quit\n\r");
   strcat(context->outBuf, "  Shutdown\n\r");
+  strcat(context->outBuf, "  Subscribe <period ms> [Deadband <change>] <name> ...\n\r");
+  strcat(context->outBuf, "  Unsubscribe [<name> ...]\n\r");
   strcat(context->outBuf, "  Help <command>\n\r");
   sockWrite(context);
   return 0;
@@ -3196,6 +3646,7 @@ static int helpGet(connectionRecType *context)
   strcat(context->outBuf, "    SigVals\n\r");
   strcat(context->outBuf, "    Thread <thread name>\n\r");
   strcat(context->outBuf, "    Threads\n\r");
+  strcat(context->outBuf, "    Values <name> [<name> ...]\n\r");
   strcat(context->outBuf, "    Verbose\n\r");
 //  strcat(outBuf, "CONFIG\n\r");
   sockWrite(context);
@@ -3233,6 +3684,7 @@ static int helpSet(connectionRecType *context)
   strcat(context->outBuf, "    Unlink <pin name>\n\r");
   strcat(context->outBuf, "    Unload <name>\n\r");
   strcat(context->outBuf, "    Unlock <command>\n\r");
+  strcat(context->outBuf, "    Values <name> <value> [<name> <value> ...]\n\r");
   
   sockWrite(context);
   return 0;
@@ -3315,16 +3767,16 @@ int parseCommand(connectionRecType *context)
     switch (lookupToken(pch)) {
       case cmdHello: 
         if (commandHello(context) == -1)
-          ret = write(context->cliSock, helloNakStr, strlen(helloNakStr));
+          ret = sockQueue(context->cliSock, helloNakStr, strlen(helloNakStr));
         else 
-          ret = write(context->cliSock, s, strlen(s));
+          ret = sockQueue(context->cliSock, s, strlen(s));
         break;
       case cmdGet: 
         ret = commandGet(context);
         break;
       case cmdSet:
         if (context->linked == 0)
-	  ret = write(context->cliSock, setNakStr, strlen(setNakStr));
+	  ret = sockQueue(context->cliSock, setNakStr, strlen(setNakStr));
         else ret = commandSet(context);
         break;
       case cmdQuit: 
@@ -3336,25 +3788,25 @@ int parseCommand(connectionRecType *context)
       case cmdHelp:
         ret = commandHelp(context);
 	break;
+      case cmdSubscribe:
+        ret = commandSubscribe(context);
+        break;
+      case cmdUnsubscribe:
+        ret = commandUnsubscribe(context);
+        break;
       case cmdUnknown: ret = -2;
       }
     }
   return ret;
 }  
 
-void *readClient(void *arg)
+static void *openClient(int fd)
 {
-  char str[1600];
-  char buf[1600];
-  unsigned int i, j;
-  int len;
-  int ret;
   connectionRecType *context;
-  
-  
-//  res = 1;
+
   context = (connectionRecType *) malloc(sizeof(connectionRecType));
-  context->cliSock = client_sockfd;
+  if (context == NULL) return NULL;
+  context->cliSock = fd;
   context->linked = 0;
   context->echo = 1;
   context->verbose = 0;
@@ -3364,39 +3816,30 @@ void *readClient(void *arg)
   context->commMode = 0;
   context->commProt = 0;
   context->inBuf[0] = 0;
-  buf[0] = 0;
-  
-  while (1) {
-    len = read(context->cliSock, &str, 1600);
-    if (len <= 0) goto finished;
-    str[len] = 0;
-    strcat(buf, str);
-    if (!memchr(str, 0x0d, strlen(str))) continue;
-    if ((context->echo == 1) && (context->linked) == 1)
-      ret = write(context->cliSock, &buf, strlen(buf));
-    i = 0;
-    j = 0;
-    while (i <= strlen(buf)) {
-      if ((buf[i] != '\n') && (buf[i] != '\r')) {
-        context->inBuf[j] = buf[i];
-	j++;
-	}
-      else
-        if (j > 0)
-          {
-  	    context->inBuf[j] = 0;
-            if (parseCommand(context) == -1) goto finished;
-	    j = 0;
-	}
-        i++;	
-      }
-    buf[0] = 0;
-    } 
+  memset(&context->sub, 0, sizeof(context->sub));
+  return context;
+}
+
+static int readClient(void *conn, char *line)
+{
+  connectionRecType *context = conn;
 
-finished:
-  close(context->cliSock);
+  if ((context->echo == 1) && (context->linked) == 1) {
+    sockQueue(context->cliSock, line, strlen(line));
+    sockQueue(context->cliSock, "\r\n", 2);
+    }
+  snprintf(context->inBuf, sizeof(context->inBuf), "%s", line);
+  return parseCommand(context) == -1 ? -1 : 0;
+}
+
+static void closeClient(void *conn)
+{
+  connectionRecType *context = conn;
+
+  removeSubscriber(context);
+  if (context->cliSock == enabledConn) enabledConn = -1;
+  free(context->sub.item);
   free(context);
-  pthread_exit((void *)0);
 }
   
 /***********************************************************************
@@ -3412,20 +3855,17 @@ finished:
 
 int sockMain()
 {
-    pthread_t thrd;
-    int res;
-    
-    while (1) {
-      
-      client_len = sizeof(client_address);
-      client_sockfd = accept(server_sockfd,
-        (struct sockaddr *)&client_address, &client_len);
-      if (client_sockfd < 0) exit(0);
-      res = pthread_create(&thrd, NULL, readClient, (void *)NULL);
-      if (res != 0)
-        close(client_sockfd);
-     }
-    return 0;
+    sockServerType server;
+
+    server.listenFd = server_sockfd;
+    server.maxSessions = maxSessions;
+    server.tick = SUB_TICK;
+    server.outMax = sizeof(((connectionRecType *) 0)->outBuf);
+    server.onOpen = openClient;
+    server.onLine = readClient;
+    server.onClose = closeClient;
+    server.onTick = readSubscriptions;
+    return sockServe(&server);
 }
 
 int main(int argc, char **argv)
@@ -88,6 +88,9 @@ static void main_window_closed(GtkWidget * widget, gpointer * gdata);
 static void set_focus(GtkWindow * window, GtkWidget *widget, gpointer * gdata);
 static void quit(int sig);
 static int heartbeat(gpointer data);
+static int stream_timer(gpointer data);
+static void start_stream(void);
+static void copy_aux_data(void);
 static void rm_normal_button_clicked(GtkWidget * widget, gpointer * gdata);
 static void rm_single_button_clicked(GtkWidget * widget, gpointer * gdata);
 static void rm_roll_button_clicked(GtkWidget * widget, gpointer * gdata);
@@ -97,6 +100,7 @@ static void rm_stop_button_clicked(GtkWidget * widget, gpointer * gdata);
 *                        MAIN() FUNCTION                               *
 ************************************************************************/
 static void *shm_base;
+static char *stream_filename;	/* stream file waiting for scope to idle */
 
 
 int main(int argc, gchar * argv[])
@@ -232,6 +236,9 @@ static int heartbeat(gpointer data)
     } else {
 	handle_watchdog_timeout();
     }
+    if (stream_filename && ctrl_shm->state == IDLE) {
+	start_stream();
+    }
     if (ctrl_usr->pending_restart && ctrl_shm->state == IDLE) {
         ctrl_usr->pending_restart = 0;
         ctrl_usr->run_mode = ctrl_usr->old_run_mode;
@@ -254,6 +261,38 @@ static int heartbeat(gpointer data)
     return 1;
 }
 
+/* The RT code only holds a short ring of samples, so while streaming
+   it is drained more often than the heartbeat runs. */
+
+static int stream_timer(gpointer data)
+{
+    drain_stream_file();
+    if (ctrl_shm->state != STREAM && ctrl_shm->state != INIT) {
+	/* stopped, by the menu or the stop button */
+	close_stream_file();
+	ctrl_shm->stream = 0;
+	return 0;
+    }
+    return 1;
+}
+
+static void start_stream(void)
+{
+    /* make sure a normal run does not restart the capture */
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ctrl_usr->
+	    rm_stop_button), TRUE);
+    ctrl_shm->stream = 1;
+    start_capture();
+    if (open_stream_file(stream_filename) == 0) {
+	gtk_timeout_add(20, stream_timer, NULL);
+    } else {
+	ctrl_shm->stream = 0;
+	ctrl_shm->state = RESET;
+    }
+    free(stream_filename);
+    stream_filename = NULL;
+}
+
 void start_capture(void)
 {
     int n;
@@ -266,6 +305,8 @@ void start_capture(void)
 	/* already running! */
 	return;
     }
+    /* channels may have been turned on or off since the buffer was split */
+    calc_aux_split();
     for (n = 0; n < 16; n++) {
 	/* point to user space channel data */
 	chan = &(ctrl_usr->chan[n]);
@@ -323,6 +364,8 @@ void start_capture(void)
 	} else {
 	    ctrl_shm->data_len[n] = 0;
 	}
+	ctrl_shm->data_aux[n] = ctrl_usr->vert.chan_enabled[n] && chan->aux
+	    && (ctrl_shm->aux_ring_len > 0) && (ctrl_shm->data_len[n] > 0);
     }
     ctrl_shm->pre_trig = (ctrl_shm->rec_len-2) * ctrl_usr->trig.position;
     ctrl_shm->state = INIT;
@@ -363,6 +406,58 @@ void capture_copy_data(void) {
 	    src = ctrl_usr->buffer;
 	}
     }
+    if (!ctrl_shm->stream && (ctrl_shm->aux_ring_len > 0)) {
+	copy_aux_data();
+    }
+    update_display_minmax();
+}
+
+/* Fills the slots the main samples keep for aux channels by sample and
+   hold: each main sample gets the last aux record taken before it.
+   The oldest record in the ring may be the one being written, so it
+   is skipped. */
+static void copy_aux_data(void)
+{
+    int n, s, slot[16], num_aux;
+    unsigned int count, first, rec, start_tick;
+    scope_data_t *aux, *dst, *held;
+
+    num_aux = 0;
+    for (n = 0; n < 16; n++) {
+	if (ctrl_shm->data_aux[n]) {
+	    slot[num_aux++] = ctrl_usr->vert.data_offset[n];
+	}
+    }
+    if (num_aux == 0) {
+	return;
+    }
+    count = ctrl_shm->aux_count;
+    first = 0;
+    if (count > (unsigned int) (ctrl_shm->aux_ring_len - 1)) {
+	first = count - (ctrl_shm->aux_ring_len - 1);
+    }
+    aux = ctrl_usr->buffer + ctrl_shm->aux_start;
+    start_tick = ctrl_shm->tick - ctrl_usr->samples;
+    held = NULL;
+    rec = first;
+    dst = ctrl_usr->disp_buf;
+    for (s = 0; s < ctrl_usr->samples; s++) {
+	while (rec != count) {
+	    scope_data_t *r = aux + (rec % ctrl_shm->aux_ring_len) *
+		ctrl_shm->aux_sample_len;
+	    if ((int) (r->d_u32 - (start_tick + s)) > 0) {
+		break;
+	    }
+	    held = r;
+	    rec++;
+	}
+	if (held != NULL) {
+	    for (n = 0; n < num_aux; n++) {
+		dst[slot[n]] = held[n + 1];
+	    }
+	}
+	dst += ctrl_shm->sample_len;
+    }
 }
 
 void capture_cont()
@@ -518,11 +613,48 @@ static void save_configuration(int junk) {
 }
 
 
+static void do_stream_to_file(GtkWidget *w, GtkFileSelection *fs) {
+    free(stream_filename);
+    stream_filename = strdup(gtk_file_selection_get_filename(fs));
+    /* heartbeat() starts streaming once the scope is idle */
+    if (ctrl_shm->state != IDLE) {
+	ctrl_shm->state = RESET;
+    }
+}
+
+static void stream_to_file(int junk) {
+    GtkWidget *filew;
+    filew = gtk_file_selection_new(_("Stream to File:"));
+    gtk_signal_connect (GTK_OBJECT (filew), "destroy",
+        (GtkSignalFunc) gtk_widget_destroy, &filew);
+    gtk_signal_connect (GTK_OBJECT (GTK_FILE_SELECTION (filew)->ok_button),
+                        "clicked", (GtkSignalFunc) do_stream_to_file, filew );
+    //link ok to destroy, otherwise the window stays open
+    gtk_signal_connect_object (GTK_OBJECT (GTK_FILE_SELECTION
+                                            (filew)->ok_button),
+                               "clicked", (GtkSignalFunc) gtk_widget_destroy,
+                               GTK_OBJECT (filew));
+    gtk_signal_connect_object (GTK_OBJECT (GTK_FILE_SELECTION
+                                            (filew)->cancel_button),
+                               "clicked", (GtkSignalFunc) gtk_widget_destroy,
+                               GTK_OBJECT (filew));
+    gtk_file_selection_set_select_multiple(GTK_FILE_SELECTION(filew), FALSE);
+    gtk_dialog_run(GTK_DIALOG(filew));
+}
+
+static void stop_streaming(int junk) {
+    if (ctrl_shm->state == STREAM || ctrl_shm->state == INIT) {
+	/* stream_timer() closes the file when it sees this */
+	ctrl_shm->state = RESET;
+    }
+}
+
 static void define_menubar(GtkWidget *vboxtop) {
     GtkWidget *file_rootmenu, *help_rootmenu;
     GtkWidget *menubar, *filemenu, 
               *fileopenconfiguration, *filesaveconfiguration, 
               *fileopendatafile, *filesavedatafile,
+              *filestream, *filestopstream,
               *filequit, *sep1, *sep2;
     GtkWidget *helpmenu, *helpabout;
     GtkWidget *vbox;
@@ -559,6 +691,18 @@ static void define_menubar(GtkWidget *vboxtop) {
     gtk_signal_connect_object(GTK_OBJECT(filesavedatafile), "activate", 
             GTK_SIGNAL_FUNC(log_popup), 0);
     gtk_widget_show(filesavedatafile);
+
+    filestream = gtk_menu_item_new_with_mnemonic(_("S_tream to File..."));
+    gtk_menu_append(GTK_MENU(filemenu), filestream);
+    gtk_signal_connect_object(GTK_OBJECT(filestream), "activate", 
+            GTK_SIGNAL_FUNC(stream_to_file), 0);
+    gtk_widget_show(filestream);
+
+    filestopstream = gtk_menu_item_new_with_mnemonic(_("Stop St_reaming"));
+    gtk_menu_append(GTK_MENU(filemenu), filestopstream);
+    gtk_signal_connect_object(GTK_OBJECT(filestopstream), "activate", 
+            GTK_SIGNAL_FUNC(stop_streaming), 0);
+    gtk_widget_show(filestopstream);
     
     gtk_menu_append(GTK_MENU(filemenu), sep2);
     gtk_widget_show(sep2);
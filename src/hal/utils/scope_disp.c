@@ -92,6 +92,13 @@ void init_display(void)
 	/* should never get here - gmalloc checks its return value */
 	exit(-1);
     }
+    /* and room for the min/max summaries of it - each channel needs
+       less than two blocks per MINMAX_BASE samples, plus one more per
+       level for the partial blocks at the end */
+    ctrl_usr->disp.minmax_pool_len =
+	2 * (2 * ctrl_shm->buf_len / MINMAX_BASE + 16 * MINMAX_LEVELS);
+    ctrl_usr->disp.minmax_pool =
+	g_malloc(sizeof(double) * ctrl_usr->disp.minmax_pool_len);
     /* initialize waveform window */
     init_display_window();
 
@@ -126,46 +133,129 @@ void request_display_refresh(int delay)
 
 static int motion_x = -1, motion_y = -1;
 
+static double sample_value(scope_data_t *dptr, hal_type_t type)
+{
+    switch (type) {
+    case HAL_BIT:
+	if (dptr->d_u8) {
+	    return 1.0;
+	} else {
+	    return 0.0;
+	};
+    case HAL_FLOAT:
+	return dptr->d_real;
+    case HAL_S32:
+	return dptr->d_s32;
+    case HAL_U32:
+	return dptr->d_u32;
+    default:
+	return 0.0;
+    }
+}
+
 static void calculate_offset(int chan_num) {
-    int n;
     scope_chan_t *chan = &(ctrl_usr->chan[chan_num]);
-    scope_data_t *dptr =
-        ctrl_usr->disp_buf + ctrl_usr->vert.data_offset[chan_num];
-    int type = chan->data_type;
-
-    double sum=0, value;
 
     if(!chan->ac_offset) return;
 
-    for(n=0; n < ctrl_usr->samples; n++) {
-	switch (type) {
-	case HAL_BIT:
-	    if (dptr->d_u8) {
-		value = 1.0;
-	    } else {
-		value = 0.0;
-	    };
-	    break;
-	case HAL_FLOAT:
-	    value = dptr->d_real;
-	    break;
-	case HAL_S32:
-	    value = dptr->d_s32;
-	    break;
-	case HAL_U32:
-	    value = dptr->d_u32;
-	    break;
-	default:
-	    value = 0.0;
-	    break;
-        }
-        sum = sum + value;
+    /* the average is computed once per capture, not once per redraw */
+    chan->vert_offset = ctrl_usr->disp.minmax[chan_num].mean;
+}
+
+void update_display_minmax(void)
+{
+    scope_disp_t *disp = &(ctrl_usr->disp);
+    scope_minmax_t *mm;
+    scope_data_t *dptr;
+    hal_type_t type;
+    double *pool, *pool_end, *lo, *hi, value, sum;
+    int chan, level, blocks, b, n, samples, sample_len;
+
+    pool = disp->minmax_pool;
+    pool_end = pool + disp->minmax_pool_len;
+    samples = ctrl_usr->samples;
+    sample_len = ctrl_shm->sample_len;
+    for (chan = 0; chan < 16; chan++) {
+	mm = &(disp->minmax[chan]);
+	mm->levels = 0;
+	mm->mean = 0.0;
+	if (ctrl_usr->vert.data_offset[chan] < 0 || samples <= 0) {
+	    continue;
+	}
+	blocks = (samples + MINMAX_BASE - 1) / MINMAX_BASE;
+	if (pool + 2 * blocks > pool_end) {
+	    /* should never happen, but if it does the trace is
+	       simply drawn from the raw samples */
+	    continue;
+	}
+	/* level 0 comes straight from the samples */
+	type = ctrl_shm->data_type[chan];
+	dptr = ctrl_usr->disp_buf + ctrl_usr->vert.data_offset[chan];
+	lo = mm->min[0] = pool;
+	pool += blocks;
+	hi = mm->max[0] = pool;
+	pool += blocks;
+	mm->blocks[0] = blocks;
+	sum = 0.0;
+	for (n = 0; n < samples; n++) {
+	    value = sample_value(dptr, type);
+	    sum += value;
+	    b = n / MINMAX_BASE;
+	    if (n % MINMAX_BASE == 0) {
+		lo[b] = hi[b] = value;
+	    } else if (value < lo[b]) {
+		lo[b] = value;
+	    } else if (value > hi[b]) {
+		hi[b] = value;
+	    }
+	    dptr += sample_len;
+	}
+	mm->mean = sum / samples;
+	/* each level above that merges pairs of blocks */
+	level = 1;
+	while (level < MINMAX_LEVELS && blocks > 1) {
+	    blocks = (blocks + 1) / 2;
+	    if (pool + 2 * blocks > pool_end) {
+		break;
+	    }
+	    mm->min[level] = pool;
+	    pool += blocks;
+	    mm->max[level] = pool;
+	    pool += blocks;
+	    mm->blocks[level] = blocks;
+	    lo = mm->min[level - 1];
+	    hi = mm->max[level - 1];
+	    for (b = 0; b < blocks; b++) {
+		mm->min[level][b] = lo[2 * b];
+		mm->max[level][b] = hi[2 * b];
+		if (2 * b + 1 < mm->blocks[level - 1]) {
+		    if (lo[2 * b + 1] < mm->min[level][b]) {
+			mm->min[level][b] = lo[2 * b + 1];
+		    }
+		    if (hi[2 * b + 1] > mm->max[level][b]) {
+			mm->max[level][b] = hi[2 * b + 1];
+		    }
+		}
+	    }
+	    level++;
+	}
+	mm->levels = level;
     }
-    if(n == 0) {
-        chan->vert_offset = 0;
-    } else {
-        chan->vert_offset = sum / n;
+}
+
+/* returns the coarsest min/max level whose blocks are no wider than
+   one pixel, or -1 if the trace should be drawn from raw samples */
+static int minmax_level(int chan, double pixels_per_sample)
+{
+    scope_minmax_t *mm = &(ctrl_usr->disp.minmax[chan]);
+    int level;
+
+    level = -1;
+    while (level + 1 < mm->levels
+	&& (MINMAX_BASE << (level + 1)) * pixels_per_sample <= 1.0) {
+	level++;
     }
+    return level;
 }
 
 void refresh_display(void)
@@ -775,7 +865,7 @@ void draw_waveform(int chan_num, int highlight)
     double xscale, xoffset;
     double yscale, yfoffset, ypoffset, fy;
     hal_type_t type;
-    int x1, y1, x2, y2, miny, maxy, midx, ct, pn;
+    int x1, y1, x2, y2, miny, maxy, midx, ct, pn, level;
     GdkPoint *points;
     int first=1;
     scope_horiz_t *horiz = &(ctrl_usr->horiz);
@@ -798,7 +888,13 @@ void draw_waveform(int chan_num, int highlight)
     /* point to first one that gets displayed */
     start = disp->start_sample;
     end = disp->end_sample;
-    ct = end - start + 1;
+    /* when zoomed out, draw one min/max pair per pixel column */
+    level = minmax_level(chan_num - 1, xscale);
+    if (level >= 0) {
+	ct = disp->width + 4;
+    } else {
+	ct = end - start + 1;
+    }
     points = alloca(2 * ct * sizeof(GdkPoint));
     pn = 0;
     n = start;
@@ -812,32 +908,72 @@ void draw_waveform(int chan_num, int highlight)
 	gdk_gc_set_foreground(disp->context, &(disp->color_normal[chan_num-1]));
     }
 
+    if (level >= 0) {
+	scope_minmax_t *mm = &(disp->minmax[chan_num - 1]);
+	int bsize = MINMAX_BASE << level;
+	int b, bend, col;
+	double lo, hi;
+
+	b = start / bsize;
+	bend = end / bsize;
+	if (bend >= mm->blocks[level]) {
+	    bend = mm->blocks[level] - 1;
+	}
+	while (b <= bend) {
+	    /* merge all blocks that start in this pixel column */
+	    col = (b * bsize * xscale) - xoffset;
+	    n = b * bsize;
+	    lo = mm->min[level][b];
+	    hi = mm->max[level][b];
+	    b++;
+	    while (b <= bend && (int)((b * bsize * xscale) - xoffset) == col) {
+		if (mm->min[level][b] < lo) {
+		    lo = mm->min[level][b];
+		}
+		if (mm->max[level][b] > hi) {
+		    hi = mm->max[level][b];
+		}
+		b++;
+	    }
+	    x2 = COORDINATE_CLIP(col);
+	    y1 = ((hi - yfoffset) * yscale) + ypoffset;
+	    y2 = ((lo - yfoffset) * yscale) + ypoffset;
+	    y1 = COORDINATE_CLIP(y1 < miny ? miny : y1 > maxy ? maxy : y1);
+	    y2 = COORDINATE_CLIP(y2 < miny ? miny : y2 > maxy ? maxy : y2);
+	    /* start with the end nearest the previous column so
+	       the trace stays connected */
+	    if (pn > 0 && abs(points[pn-1].y - y2) < abs(points[pn-1].y - y1)) {
+		points[pn].x = x2; points[pn].y = y2; pn++;
+		y2 = y1;
+	    } else {
+		points[pn].x = x2; points[pn].y = y1; pn++;
+	    }
+	    if (y2 != points[pn-1].y) {
+		points[pn].x = x2; points[pn].y = y2; pn++;
+	    }
+	    if(first && highlight && DRAWING && x2 >= motion_x) {
+		first = 0;
+		fy = sample_value(ctrl_usr->disp_buf
+		    + ctrl_usr->vert.data_offset[chan_num - 1]
+		    + n * sample_len, type);
+		y2 = ((fy - yfoffset) * yscale) + ypoffset;
+		gdk_draw_arc(disp->win, disp->context, TRUE,
+			    x2-3, y2-3, 7, 7, 0, 360*64);
+		cursor_value = fy;
+		cursor_time = (n - ctrl_shm->pre_trig)*horiz->sample_period;
+		cursor_valid = 1;
+	    }
+	}
+	/* skip the per-sample loop below */
+	n = end + 1;
+    }
+
     x1 = y1 = 0;
     while (n <= end) {
 	/* calc x coordinate of this point */
 	x2 = (n * xscale) - xoffset;
 	/* calc y coordinate of this point */
-	switch (type) {
-	case HAL_BIT:
-	    if (dptr->d_u8) {
-		fy = 1.0;
-	    } else {
-		fy = 0.0;
-	    };
-	    break;
-	case HAL_FLOAT:
-	    fy = dptr->d_real;
-	    break;
-	case HAL_S32:
-	    fy = dptr->d_s32;
-	    break;
-	case HAL_U32:
-	    fy = dptr->d_u32;
-	    break;
-	default:
-	    fy = 0.0;
-	    break;
-	}
+	fy = sample_value(dptr, type);
 	y2 = ((fy - yfoffset) * yscale) + ypoffset;
 	if (y2 < miny) {
 	    y2 = miny;
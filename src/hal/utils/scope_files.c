@@ -64,11 +64,14 @@
    HMULT <int>		multiplier, sample every N runs of thread
    HZOOM <int>		1-9, horizontal zoom setting
    HPOS <float>		0.0-1.0, horizontal position setting
+   AUXTHREAD <string>	name of thread for the aux channels
+   AUXMULT <int>	multiplier, aux sample every N runs of it
    CHAN <int>		sets channel for subsequent commands
    PIN <string>		named pin becomes source for channel
    PARAM <string>	named parameter becomes source for channel
    SIG <string>		named signal becomes source for channel
    CHOFF		disables selected channel
+   CHAUX <int>		1 = selected channel sampled in aux thread
    VSCALE <int>		vertical scaling
    VPOS <float>		0.0-1.0, vertical position setting
    VOFF <float>		vertical offset
@@ -82,6 +85,29 @@
   
 */
 
+/* A stream file is binary, in the byte order of the machine.  It starts
+   with a header:
+
+   char[8]   "HALSTRM1"
+   u32       sample period in nsec
+   u32       number of channels
+   u32       samples kept before each trigger
+   u32       samples per trigger window, 0 if every sample is kept
+   then for each channel:
+   u8        HAL type
+   u8        bytes per value: 1 (bit), 4 (s32, u32) or 8 (float)
+   char[]    channel source name, HAL_NAME_LEN+1 bytes
+
+   followed by any number of blocks:
+
+   u64       number of the first sample in the block
+   u64       number of the trigger sample, all ones if none
+   u32       number of samples in the block
+   then the samples, each with the channel values packed one after
+   another.  Blocks of one trigger window have the same trigger
+   number; a window can be split over several blocks.
+*/
+
 
 /***********************************************************************
 *                         TYPEDEFS AND DEFINES                         *
@@ -124,6 +150,9 @@ static char *hpos_cmd(void * arg);
 static char *hmult_cmd(void * arg);
 static char *chan_cmd(void * arg);
 static char *choff_cmd(void * arg);
+static char *chaux_cmd(void * arg);
+static char *auxthread_cmd(void * arg);
+static char *auxmult_cmd(void * arg);
 static char *pin_cmd(void * arg);
 static char *sig_cmd(void * arg);
 static char *param_cmd(void * arg);
@@ -149,8 +178,11 @@ static const cmd_lut_entry_t cmd_lut[25] =
   { "hmult",	INT,	hmult_cmd },
   { "hzoom",	INT,	hzoom_cmd },
   { "hpos",	FLOAT,	hpos_cmd },
+  { "auxthread",	STRING,	auxthread_cmd },
+  { "auxmult",	INT,	auxmult_cmd },
   { "chan",	INT,	chan_cmd },
   { "choff",	INT,	choff_cmd },
+  { "chaux",	INT,	chaux_cmd },
   { "pin",	STRING,	pin_cmd },
   { "sig",	STRING,	sig_cmd },
   { "param",	STRING,	param_cmd },
@@ -168,6 +200,19 @@ static const cmd_lut_entry_t cmd_lut[25] =
 };
 
 static int deferred_channel;
+
+/* state of the stream file, see open_stream_file() */
+static FILE *stream_fp;
+static int stream_windowed;		/* keep only trigger windows */
+static unsigned int stream_pre;		/* samples before a trigger */
+static unsigned int stream_post;	/* samples from a trigger on */
+static unsigned int stream_ring_len;	/* samples in the shm ring */
+static unsigned long long stream_rd;	/* samples consumed from ring */
+static unsigned int stream_trig_seen;	/* triggers handled */
+static int stream_in_window;		/* inside a trigger window */
+static unsigned long long stream_win_end;	/* end of that window */
+static unsigned long long stream_win_trig;	/* its trigger sample */
+static unsigned int stream_lost_trigs;	/* triggers the ring forgot */
   
 /***********************************************************************
 *                        PUBLIC FUNCTION CODE                          *
@@ -314,6 +359,179 @@ void write_log_file (char *filename)
     fprintf(stderr, "Log file '%s' written.\n", filename );
 }
 
+/* opens 'filename' and writes the stream header for the channels
+   start_capture() has just set up */
+
+int open_stream_file(char *filename)
+{
+    char name[HAL_NAME_LEN + 1];
+    unsigned int hdr[4];
+    unsigned char info[2];
+    int n, nchan;
+
+    stream_fp = fopen(filename, "wb");
+    if (stream_fp == NULL) {
+	fprintf(stderr, "ERROR: stream file '%s' could not be created\n",
+	    filename);
+	return -1;
+    }
+    nchan = 0;
+    for (n = 0; n < 16; n++) {
+	if (ctrl_shm->data_len[n] > 0) {
+	    nchan++;
+	}
+    }
+    /* without a trigger source every sample is kept */
+    stream_windowed = ctrl_shm->trig_chan != 0 || ctrl_shm->auto_trig;
+    stream_pre = ctrl_shm->pre_trig;
+    stream_post = ctrl_shm->rec_len - ctrl_shm->pre_trig;
+    stream_ring_len = ctrl_shm->buf_len / ctrl_shm->sample_len;
+    stream_rd = 0;
+    stream_trig_seen = 0;
+    stream_in_window = 0;
+    stream_lost_trigs = 0;
+
+    fwrite("HALSTRM1", 1, 8, stream_fp);
+    hdr[0] = ctrl_usr->horiz.thread_period_ns * ctrl_shm->mult;
+    hdr[1] = nchan;
+    hdr[2] = stream_windowed ? stream_pre : 0;
+    hdr[3] = stream_windowed ? stream_pre + stream_post : 0;
+    fwrite(hdr, sizeof(hdr), 1, stream_fp);
+    for (n = 0; n < 16; n++) {
+	if (ctrl_shm->data_len[n] > 0) {
+	    info[0] = ctrl_shm->data_type[n];
+	    info[1] = ctrl_shm->data_len[n];
+	    memset(name, 0, sizeof(name));
+	    if (ctrl_usr->chan[n].name) {
+		strncpy(name, ctrl_usr->chan[n].name, HAL_NAME_LEN);
+	    }
+	    fwrite(info, sizeof(info), 1, stream_fp);
+	    fwrite(name, sizeof(name), 1, stream_fp);
+	}
+    }
+    return 0;
+}
+
+/* writes samples 'first' up to 'end' from the ring as one block */
+static void write_stream_block(unsigned long long first,
+    unsigned long long end, unsigned long long trig)
+{
+    unsigned char buf[16 * sizeof(scope_data_t)];
+    unsigned long long s;
+    unsigned int count;
+    scope_data_t *src;
+    int n, len;
+
+    if (end <= first) {
+	return;
+    }
+    count = end - first;
+    fwrite(&first, sizeof(first), 1, stream_fp);
+    fwrite(&trig, sizeof(trig), 1, stream_fp);
+    fwrite(&count, sizeof(count), 1, stream_fp);
+    for (s = first; s < end; s++) {
+	src = ctrl_usr->buffer + (s % stream_ring_len) * ctrl_shm->sample_len;
+	len = 0;
+	/* pack each value into its own size, like capture_sample() */
+	for (n = 0; n < 16; n++) {
+	    switch (ctrl_shm->data_len[n]) {
+	    case 1:
+		buf[len++] = src->d_u8;
+		src++;
+		break;
+	    case 4:
+		memcpy(buf + len, &src->d_u32, 4);
+		len += 4;
+		src++;
+		break;
+	    case 8:
+		memcpy(buf + len, &src->d_ireal, 8);
+		len += 8;
+		src++;
+		break;
+	    default:
+		break;
+	    }
+	}
+	fwrite(buf, len, 1, stream_fp);
+    }
+}
+
+/* moves everything the RT code has streamed so far into the file,
+   and frees the ring space.  Called often while streaming. */
+
+void drain_stream_file(void)
+{
+    unsigned long long wr, start, trig, end;
+    unsigned int trig_count;
+
+    if (stream_fp == NULL) {
+	return;
+    }
+    /* read the write count before the triggers: a trigger is recorded
+       before the count passes its sample */
+    wr = stream_rd + (unsigned int)(ctrl_shm->wr_count - (unsigned int)stream_rd);
+    trig_count = ctrl_shm->trig_count;
+    if (!stream_windowed) {
+	write_stream_block(stream_rd, wr, ~0ULL);
+	stream_rd = wr;
+    }
+    while (stream_windowed) {
+	if (!stream_in_window) {
+	    if (stream_trig_seen == trig_count) {
+		/* no trigger pending, keep only the pre-trigger history */
+		if (wr - stream_rd > stream_pre) {
+		    stream_rd = wr - stream_pre;
+		}
+		break;
+	    }
+	    if (trig_count - stream_trig_seen > SCOPE_STREAM_TRIGS) {
+		stream_lost_trigs +=
+		    trig_count - stream_trig_seen - SCOPE_STREAM_TRIGS;
+		stream_trig_seen = trig_count - SCOPE_STREAM_TRIGS;
+	    }
+	    trig = stream_rd + (int)(ctrl_shm->trig_sample[stream_trig_seen
+		    % SCOPE_STREAM_TRIGS] - (unsigned int)stream_rd);
+	    stream_trig_seen++;
+	    /* windows that overlap the last one start where it ended */
+	    start = trig >= stream_pre ? trig - stream_pre : 0;
+	    if (start > stream_rd) {
+		stream_rd = start;
+	    }
+	    stream_win_trig = trig;
+	    stream_win_end = trig + stream_post;
+	    stream_in_window = 1;
+	}
+	end = wr < stream_win_end ? wr : stream_win_end;
+	write_stream_block(stream_rd, end, stream_win_trig);
+	stream_rd = end;
+	if (stream_rd < stream_win_end) {
+	    /* rest of the window is not sampled yet */
+	    break;
+	}
+	stream_in_window = 0;
+    }
+    ctrl_shm->rd_count = stream_rd;
+}
+
+void close_stream_file(void)
+{
+    if (stream_fp == NULL) {
+	return;
+    }
+    drain_stream_file();
+    fclose(stream_fp);
+    stream_fp = NULL;
+    fprintf(stderr, "Stream file written after %llu samples", stream_rd);
+    if (ctrl_shm->overruns > 0) {
+	fprintf(stderr, ", %u dropped", ctrl_shm->overruns);
+    }
+    if (stream_lost_trigs > 0) {
+	fprintf(stderr, ", %u triggers lost", stream_lost_trigs);
+    }
+    fprintf(stderr, ".\n");
+}
+
 /* format the data and print it */
 void write_sample(FILE *fp, char *label, scope_data_t *dptr, hal_type_t type)
 {
@@ -479,6 +697,29 @@ static char *hmult_cmd(void * arg)
     return NULL;
 }
 
+static char *auxthread_cmd(void * arg)
+{
+    int rv;
+
+    rv = set_aux_thread((char *)(arg));
+    if ( rv < 0 ) {
+	return "could not use aux thread";
+    }
+    return NULL;
+}
+
+static char *auxmult_cmd(void * arg)
+{
+    int *argp, rv;
+
+    argp = (int *)(arg);
+    rv = set_aux_mult(*argp);
+    if ( rv < 0 ) {
+	return "could not set aux multiplier";
+    }
+    return NULL;
+}
+
 static char *chan_cmd(void * arg)
 {
     int *argp, chan_num, rv;
@@ -518,6 +759,17 @@ static char *choff_cmd(void * arg)
     return NULL;
 }    
 
+static char *chaux_cmd(void * arg)
+{
+    int *argp;
+
+    argp = (int *)(arg);
+    if ( set_channel_aux(*argp) < 0 ) {
+	return "no channel selected";
+    }
+    return NULL;
+}
+
 static char *chan_src_cmd(int src_type, char *src_name)
 {
     int chan_num, rv;
@@ -76,8 +76,12 @@ static void acquire_selection_made(GtkWidget * clist, gint row, gint column,
 static int set_sample_thread_name(char *name);
 static int activate_sample_thread(void);
 static void deactivate_sample_thread(void);
+static void aux_selection_made(GtkWidget * clist, gint row, gint column,
+    GdkEventButton * event, gpointer gdata);
+static void deactivate_aux_thread(void);
 
 static void mult_changed(GtkAdjustment * adj, gpointer gdata);
+static void aux_mult_changed(GtkAdjustment * adj, gpointer gdata);
 static void zoom_changed(GtkAdjustment * adj, gpointer gdata);
 static void pos_changed(GtkAdjustment * adj, gpointer gdata);
 static void rec_len_button(GtkWidget * widget, gpointer gdata);
@@ -212,6 +216,14 @@ static void init_acquire_function(void)
     horiz = &(ctrl_usr->horiz);
     /* set watchdog to trip immediately once heartbeat funct is called */
     ctrl_shm->watchdog = 10;
+    /* is the aux function still linked from an earlier run? */
+    if (ctrl_shm->aux_thread_name[0] != '\0') {
+	thread = halpr_find_thread_by_name(ctrl_shm->aux_thread_name);
+	if (thread != NULL) {
+	    horiz->aux_thread_name = thread->name;
+	    horiz->aux_thread_period_ns = thread->period;
+	}
+    }
     /* is the realtime function present? */
     funct = halpr_find_funct_by_name("scope.sample");
     if (funct == NULL) {
@@ -285,11 +297,12 @@ void refresh_state_info(void)
 	"TRIGGER?",
 	"TRIGGERED",
 	"DONE",
-	"RESET"
+	"RESET",
+	"STREAM"
     };
 
     horiz = &(ctrl_usr->horiz);
-    if (ctrl_shm->state > RESET) {
+    if (ctrl_shm->state > STREAM) {
 	ctrl_shm->state = IDLE;
     }
     gtk_label_set_text_if(horiz->state_label, state_names[ctrl_shm->state]);
@@ -304,6 +317,10 @@ void write_horiz_config(FILE *fp)
     fprintf(fp, "THREAD %s\n", horiz->thread_name);
     fprintf(fp, "MAXCHAN %d\n", ctrl_shm->sample_len);
     fprintf(fp, "HMULT %d\n", ctrl_shm->mult);
+    if (horiz->aux_thread_name != NULL) {
+	fprintf(fp, "AUXTHREAD %s\n", horiz->aux_thread_name);
+	fprintf(fp, "AUXMULT %d\n", ctrl_shm->aux_mult);
+    }
     fprintf(fp, "HZOOM %d\n", horiz->zoom_setting);
     fprintf(fp, "HPOS %e\n", horiz->pos_setting);
 }
@@ -327,6 +344,118 @@ int set_sample_thread(char *name)
     return rv;
 }
 
+/* Links the aux function to thread 'name', or unlinks it if 'name' is
+   NULL or empty. */
+int set_aux_thread(char *name)
+{
+    scope_horiz_t *horiz;
+    hal_thread_t *thread;
+    int rv;
+
+    horiz = &(ctrl_usr->horiz);
+    thread = NULL;
+    if ((name != NULL) && (*name != '\0')) {
+	thread = halpr_find_thread_by_name(name);
+	if (thread == NULL) {
+	    return -1;
+	}
+    }
+    if (ctrl_shm->state != IDLE) {
+	/* acquisition in progress, must restart it */
+	prepare_scope_restart();
+    }
+    deactivate_aux_thread();
+    if (thread != NULL) {
+	rv = hal_add_funct_to_thread("scope.sample-aux", thread->name, -1);
+	if (rv < 0) {
+	    calc_aux_split();
+	    return rv;
+	}
+	strncpy(ctrl_shm->aux_thread_name, thread->name, HAL_NAME_LEN);
+	ctrl_shm->aux_thread_name[HAL_NAME_LEN] = '\0';
+	horiz->aux_thread_name = thread->name;
+	horiz->aux_thread_period_ns = thread->period;
+    }
+    calc_aux_split();
+    return 0;
+}
+
+int set_aux_mult(int setting)
+{
+    scope_horiz_t *horiz;
+    long max_mult;
+
+    if (setting < 1) {
+	return -1;
+    }
+    horiz = &(ctrl_usr->horiz);
+    /* keep the aux sample period <= 1 sec too */
+    max_mult = 1000;
+    if ((horiz->aux_thread_period_ns > 0)
+	&& (1000000000 / horiz->aux_thread_period_ns < max_mult)) {
+	max_mult = 1000000000 / horiz->aux_thread_period_ns;
+    }
+    if (setting > max_mult) {
+	setting = max_mult;
+    }
+    if ((setting != ctrl_shm->aux_mult) && (ctrl_shm->state != IDLE)) {
+	prepare_scope_restart();
+    }
+    ctrl_shm->aux_mult = setting;
+    calc_aux_split();
+    return 0;
+}
+
+/* Shares the buffer between the main record and the aux ring.  The
+   ring needs a record for each aux sample period the main record
+   spans, and spares for rounding and for the record being written as
+   the capture ends, which the user side skips. */
+void calc_aux_split(void)
+{
+    scope_horiz_t *horiz;
+    int n, aux_chans, rec_len, ring_len, len;
+    double per_sample;
+
+    horiz = &(ctrl_usr->horiz);
+    if (ctrl_shm->sample_len < 1) {
+	return;
+    }
+    aux_chans = 0;
+    for (n = 0; n < 16; n++) {
+	if (ctrl_usr->vert.chan_enabled[n] && ctrl_usr->chan[n].aux) {
+	    aux_chans++;
+	}
+    }
+    rec_len = ctrl_shm->buf_len / ctrl_shm->sample_len;
+    ring_len = 0;
+    len = 0;
+    if ((aux_chans > 0) && !ctrl_shm->stream
+	&& (horiz->aux_thread_name != NULL)
+	&& (horiz->aux_thread_period_ns > 0)
+	&& (horiz->thread_period_ns > 0)) {
+	len = aux_chans + 1;
+	/* aux records taken during each main sample period */
+	per_sample = (double) (horiz->thread_period_ns * ctrl_shm->mult) /
+	    (double) (horiz->aux_thread_period_ns * ctrl_shm->aux_mult);
+	rec_len = (ctrl_shm->buf_len - 3 * len) /
+	    (ctrl_shm->sample_len + per_sample * len);
+	ring_len = rec_len * per_sample + 3;
+	while ((rec_len > 2) && (rec_len * ctrl_shm->sample_len +
+		ring_len * len > ctrl_shm->buf_len)) {
+	    rec_len--;
+	    ring_len = rec_len * per_sample + 3;
+	}
+    }
+    ctrl_shm->aux_sample_len = len;
+    ctrl_shm->aux_ring_len = ring_len;
+    ctrl_shm->aux_start = rec_len * ctrl_shm->sample_len;
+    if (ctrl_shm->rec_len != rec_len) {
+	ctrl_shm->rec_len = rec_len;
+	calc_horiz_scaling();
+	refresh_horiz_info();
+    }
+}
+
 int set_rec_len(int setting)
 {
     int count, n;
@@ -355,7 +484,7 @@ int set_rec_len(int setting)
 	return -1;
     }
     ctrl_shm->sample_len = setting;
-    ctrl_shm->rec_len = ctrl_shm->buf_len / ctrl_shm->sample_len;
+    calc_aux_split();
     calc_horiz_scaling();
     refresh_horiz_info();
     return 0;
@@ -389,6 +518,7 @@ int set_horiz_mult(int setting)
     /* save new value */
     ctrl_shm->mult = setting;
     /* refresh other stuff */    
+    calc_aux_split();
     calc_horiz_scaling();
     refresh_horiz_info();
     return 0;
@@ -478,7 +608,7 @@ static void dialog_realtime_not_linked(void)
     scope_horiz_t *horiz;
     dialog_generic_t dialog;
 
-    int next, colwidth, sel_row, n;
+    int next, colwidth, sel_row, aux_row, n;
     double period;
     hal_thread_t *thread;
     gchar *strs[2];
@@ -632,6 +762,69 @@ static void dialog_realtime_not_linked(void)
     /* a separator */
     gtk_hseparator_new_in_box(GTK_DIALOG(dialog.window)->vbox, 0);
 
+    /* second, optional thread for the channels marked "Aux" */
+    gtk_label_new_in_box(_("Aux Thread"),
+	GTK_DIALOG(dialog.window)->vbox, TRUE, TRUE, 0);
+    scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+	GTK_POLICY_AUTOMATIC, GTK_POLICY_ALWAYS);
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog.window)->vbox),
+	scrolled_window, TRUE, TRUE, 5);
+    gtk_widget_show(scrolled_window);
+    horiz->aux_thread_list = gtk_clist_new_with_titles(2, titles);
+    gtk_clist_column_titles_passive(GTK_CLIST(horiz->aux_thread_list));
+    gtk_clist_set_shadow_type(GTK_CLIST(horiz->aux_thread_list),
+	GTK_SHADOW_OUT);
+    gtk_clist_set_selection_mode(GTK_CLIST(horiz->aux_thread_list),
+	GTK_SELECTION_BROWSE);
+    gtk_container_add(GTK_CONTAINER(scrolled_window), horiz->aux_thread_list);
+    gtk_widget_show(horiz->aux_thread_list);
+    /* row 0 is no aux thread */
+    strs[0] = _("(none)");
+    strs[1] = "";
+    gtk_clist_append(GTK_CLIST(horiz->aux_thread_list), strs);
+    aux_row = 0;
+    n = 1;
+    rtapi_mutex_get(&(hal_data->mutex));
+    next = hal_data->thread_list_ptr;
+    while (next != 0) {
+	thread = SHMPTR(next);
+	if (thread->period <= 1000000000) {
+	    period = thread->period / 1000000000.0;
+	    format_time_value(buf, BUFLEN, period);
+	    strs[1] = buf;
+	    strs[0] = thread->name;
+	    gtk_clist_append(GTK_CLIST(horiz->aux_thread_list), strs);
+	    if ((horiz->aux_thread_name != NULL)
+		&& (strcmp(horiz->aux_thread_name, thread->name) == 0)) {
+		aux_row = n;
+	    }
+	    n++;
+	}
+	next = thread->next_ptr;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    gtk_clist_select_row(GTK_CLIST(horiz->aux_thread_list), aux_row, -1);
+    /* connect after preselecting, so that doesn't relink the funct */
+    gtk_signal_connect(GTK_OBJECT(horiz->aux_thread_list), "select_row",
+	GTK_SIGNAL_FUNC(aux_selection_made), NULL);
+    hbox =
+	gtk_hbox_new_in_box(TRUE, 0, 0, (GTK_DIALOG(dialog.window)->vbox),
+	FALSE, TRUE, 5);
+    gtk_label_new_in_box(_("Aux Multiplier:"), hbox, FALSE, FALSE, 0);
+    horiz->aux_mult_adj =
+	gtk_adjustment_new(ctrl_shm->aux_mult, 1, 1000, 1, 1, 0);
+    horiz->aux_mult_spinbutton =
+	gtk_spin_button_new(GTK_ADJUSTMENT(horiz->aux_mult_adj), 1, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), horiz->aux_mult_spinbutton, FALSE,
+	TRUE, 0);
+    gtk_widget_show(horiz->aux_mult_spinbutton);
+    gtk_signal_connect(GTK_OBJECT(horiz->aux_mult_adj), "value_changed",
+	GTK_SIGNAL_FUNC(aux_mult_changed), NULL);
+
+    /* a separator */
+    gtk_hseparator_new_in_box(GTK_DIALOG(dialog.window)->vbox, 0);
+
     /* box for record length buttons */
     gtk_label_new_in_box(_("Record Length"),
 	GTK_DIALOG(dialog.window)->vbox, TRUE, TRUE, 0);
@@ -728,6 +921,9 @@ static void dialog_realtime_not_linked(void)
     horiz->sample_period_label = NULL;
     horiz->mult_adj = NULL;
     horiz->mult_spinbutton = NULL;
+    horiz->aux_thread_list = NULL;
+    horiz->aux_mult_adj = NULL;
+    horiz->aux_mult_spinbutton = NULL;
     /* we get here when the user hits OK or Cancel or closes the window */
     if ((dialog.retval == 0) || (dialog.retval == 2)) {
 	/* user either closed dialog, or hit cancel - end the program */
@@ -877,6 +1073,7 @@ static int set_sample_thread_name(char *name)
     if (ctrl_shm->mult > max_mult) {
 	ctrl_shm->mult = max_mult;
     }
+    calc_aux_split();
     calc_horiz_scaling();
     refresh_horiz_info();
     return 0;
@@ -893,6 +1090,39 @@ static void deactivate_sample_thread(void)
     }
 }
 
+static void aux_selection_made(GtkWidget * clist, gint row, gint column,
+    GdkEventButton * event, gpointer gdata)
+{
+    gchar *picked;
+
+    if ((clist == NULL) || (column < 0)) {
+	return;
+    }
+    if ((event != NULL) && (event->type != 4)) {
+	/* drag across the list, see acquire_selection_made() */
+	return;
+    }
+    picked = NULL;
+    if (row > 0) {
+	gtk_clist_get_text(GTK_CLIST(clist), row, 0, &picked);
+    }
+    set_aux_thread(picked);
+}
+
+static void deactivate_aux_thread(void)
+{
+    scope_horiz_t *horiz;
+
+    horiz = &(ctrl_usr->horiz);
+    if (ctrl_shm->aux_thread_name[0] != '\0') {
+	hal_del_funct_from_thread("scope.sample-aux",
+	    ctrl_shm->aux_thread_name);
+	ctrl_shm->aux_thread_name[0] = '\0';
+    }
+    horiz->aux_thread_name = NULL;
+    horiz->aux_thread_period_ns = 0;
+}
+
 static int activate_sample_thread(void)
 {
     scope_horiz_t *horiz;
@@ -937,6 +1167,19 @@ static void mult_changed(GtkAdjustment * adj, gpointer gdata)
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(horiz->mult_spinbutton), ctrl_shm->mult);
 }
 
+static void aux_mult_changed(GtkAdjustment * adj, gpointer gdata)
+{
+    scope_horiz_t *horiz;
+    int value;
+
+    horiz = &(ctrl_usr->horiz);
+    value = gtk_spin_button_get_value_as_int(
+	GTK_SPIN_BUTTON(horiz->aux_mult_spinbutton));
+    set_aux_mult(value);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(horiz->aux_mult_spinbutton),
+	ctrl_shm->aux_mult);
+}
+
 static void zoom_changed(GtkAdjustment * adj, gpointer gdata)
 {
     set_horiz_zoom(adj->value);
@@ -71,7 +71,11 @@ static void init_rt_control_struct(void *shmem);
 static void init_shm_control_struct(void);
 
 static void sample(void *arg, long period);
+static void sample_aux(void *arg, long period);
+static void capture_value(scope_data_t *dest, int n);
 static void capture_sample(void);
+static void capture_aux_sample(void);
+static void stream_sample(void);
 static int check_trigger(void);
 
 /***********************************************************************
@@ -120,7 +124,15 @@ int rtapi_app_main(void)
 	hal_exit(comp_id);
 	return -1;
     }
-    rtapi_print_msg(RTAPI_MSG_DBG, "SCOPE_RT: installed sample function\n");
+    retval = hal_export_funct("scope.sample-aux", sample_aux, NULL, 0, 0,
+	comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SCOPE_RT: ERROR: sample-aux funct export failed\n");
+	hal_exit(comp_id);
+	return -1;
+    }
+    rtapi_print_msg(RTAPI_MSG_DBG, "SCOPE_RT: installed sample functions\n");
     hal_ready(comp_id);
     return 0;
 }
@@ -132,6 +144,10 @@ void rtapi_app_exit(void)
 	/* need to unlink it before we release the scope shared memory */
 	hal_del_funct_from_thread("scope.sample", ctrl_shm->thread_name);
     }
+    if (ctrl_shm->aux_thread_name[0] != '\0') {
+	hal_del_funct_from_thread("scope.sample-aux",
+	    ctrl_shm->aux_thread_name);
+    }
     rtapi_shmem_delete(shm_id, comp_id);
     hal_exit(comp_id);
 }
@@ -173,11 +189,28 @@ static void sample(void *arg, long period)
 	ctrl_shm->samples = 0;
 	ctrl_shm->force_trig = 0;
 	ctrl_rt->auto_timer = 0;
+	ctrl_shm->tick = 0;
+	ctrl_shm->aux_count = 0;
+	ctrl_rt->aux_mult_cntr = 0;
+	ctrl_rt->aux_on = !ctrl_shm->stream && ctrl_shm->aux_ring_len > 0;
 	/* get info about channels */
 	for (n = 0; n < 16; n++) {
 	    ctrl_rt->data_addr[n] = SHMPTR(ctrl_shm->data_offset[n]);
 	    ctrl_rt->data_type[n] = ctrl_shm->data_type[n];
 	    ctrl_rt->data_len[n] = ctrl_shm->data_len[n];
+	    ctrl_rt->data_aux[n] = ctrl_rt->aux_on && ctrl_shm->data_aux[n]
+		&& ctrl_rt->data_len[n] > 0;
+	}
+	if (ctrl_shm->stream) {
+	    ctrl_rt->ring_len = ctrl_shm->buf_len / ctrl_shm->sample_len;
+	    ctrl_shm->wr_count = 0;
+	    ctrl_shm->rd_count = 0;
+	    ctrl_shm->overruns = 0;
+	    ctrl_shm->trig_count = 0;
+	    /* dummy call to preset 'compare_result' */
+	    check_trigger();
+	    ctrl_shm->state = STREAM;
+	    break;
 	}
 	/* set next state */
 	ctrl_shm->state = PRE_TRIG;
@@ -229,6 +262,9 @@ static void sample(void *arg, long period)
     case DONE:
 	/* do nothing while GUI displays waveform */
 	break;
+    case STREAM:
+	stream_sample();
+	break;
     default:
 	/* shouldn't get here - if we do, set a legal state */
 	ctrl_shm->state = IDLE;
@@ -237,6 +273,51 @@ static void sample(void *arg, long period)
     /* done */
 }
 
+static void sample_aux(void *arg, long period)
+{
+    scope_state_t state;
+
+    if (!ctrl_rt->aux_on) {
+	return;
+    }
+    ctrl_rt->aux_mult_cntr++;
+    if (ctrl_rt->aux_mult_cntr < ctrl_shm->aux_mult) {
+	/* not time to do anything yet */
+	return;
+    }
+    ctrl_rt->aux_mult_cntr = 0;
+    /* record for as long as the main function does */
+    state = ctrl_shm->state;
+    if (state == PRE_TRIG || state == TRIG_WAIT || state == POST_TRIG) {
+	capture_aux_sample();
+    }
+}
+
+static void capture_value(scope_data_t *dest, int n)
+{
+    /* capture 1, 4, or 8 bytes, based on data size */
+    switch (ctrl_rt->data_len[n]) {
+    case 1:
+	dest->d_u8 = *((unsigned char *) (ctrl_rt->data_addr[n]));
+	break;
+    case 4:
+	dest->d_u32 = *((unsigned long *) (ctrl_rt->data_addr[n]));
+	break;
+    case 8:
+	{
+	    ireal_t sample_a, sample_b;
+	    do {
+		sample_a = *((volatile ireal_t *) (ctrl_rt->data_addr[n]));
+		sample_b = *((volatile ireal_t *) (ctrl_rt->data_addr[n]));
+	    } while( sample_a != sample_b );
+	    dest->d_ireal = sample_a;
+	}
+	break;
+    default:
+	break;
+    }
+}
+
 static void capture_sample(void)
 {
     scope_data_t *dest;
@@ -245,31 +326,16 @@ static void capture_sample(void)
     dest = &(ctrl_rt->buffer[ctrl_shm->curr]);
     /* loop through all channels to acquire data */
     for (n = 0; n < 16; n++) {
-	/* capture 1, 2, or 4 bytes, based on data size */
-	switch (ctrl_rt->data_len[n]) {
-	case 1:
-	    dest->d_u8 = *((unsigned char *) (ctrl_rt->data_addr[n]));
-	    dest++;
-	    break;
-	case 4:
-	    dest->d_u32 = *((unsigned long *) (ctrl_rt->data_addr[n]));
-	    dest++;
-	    break;
-	case 8:
-            {
-                ireal_t sample_a, sample_b;
-                do {
-                    sample_a = *((volatile ireal_t *) (ctrl_rt->data_addr[n]));
-                    sample_b = *((volatile ireal_t *) (ctrl_rt->data_addr[n]));
-                } while( sample_a != sample_b );
-                dest->d_ireal = sample_a;
-                dest++;
-            }
-	    break;
-	default:
-	    break;
+	if (ctrl_rt->data_len[n] == 0) {
+	    continue;
 	}
+	/* leave the slot of an aux channel for the user side to fill */
+	if (!ctrl_rt->data_aux[n]) {
+	    capture_value(dest, n);
+	}
+	dest++;
     }
+    ctrl_shm->tick++;
     /* increment sample pointer */
     ctrl_shm->curr += ctrl_shm->sample_len;
     /* is there room in the buffer for another sample? */
@@ -279,6 +345,50 @@ static void capture_sample(void)
     }
 }
 
+static void capture_aux_sample(void)
+{
+    scope_data_t *dest;
+    int n;
+
+    dest = &(ctrl_rt->buffer[ctrl_shm->aux_start +
+	(ctrl_shm->aux_count % ctrl_shm->aux_ring_len) *
+	ctrl_shm->aux_sample_len]);
+    /* when it was taken, on the main function's timeline */
+    dest->d_u32 = ctrl_shm->tick;
+    dest++;
+    for (n = 0; n < 16; n++) {
+	if (ctrl_rt->data_aux[n]) {
+	    capture_value(dest, n);
+	    dest++;
+	}
+    }
+    /* the record must be complete before the user side counts it */
+    __sync_synchronize();
+    ctrl_shm->aux_count++;
+}
+
+static void stream_sample(void)
+{
+    /* is the ring full? */
+    if (ctrl_shm->wr_count - ctrl_shm->rd_count >= ctrl_rt->ring_len) {
+	/* yes, user side is behind, drop this sample */
+	ctrl_shm->overruns++;
+	return;
+    }
+    capture_sample();
+    if (check_trigger()) {
+	/* note where it happened, the user side cuts out the window */
+	ctrl_shm->trig_sample[ctrl_shm->trig_count % SCOPE_STREAM_TRIGS] =
+	    ctrl_shm->wr_count;
+	ctrl_shm->trig_count++;
+	/* a forced trigger fires once */
+	ctrl_shm->force_trig = 0;
+	ctrl_rt->auto_timer = 0;
+    }
+    /* sample is complete, let user side have it */
+    ctrl_shm->wr_count++;
+}
+
 // TODO: type-independent way to get high bit
 // #define SIGN_BIT (~(((ireal_t)~(ireal_t)0)>>1))
 static int check_trigger(void)
@@ -420,5 +530,6 @@ static void init_shm_control_struct(void)
     ctrl_shm->buf_len = (shm_size - skip) / sizeof(scope_data_t);
     /* init any non-zero fields */
     ctrl_shm->mult = 1;
+    ctrl_shm->aux_mult = 1;
     ctrl_shm->state = IDLE;
 }
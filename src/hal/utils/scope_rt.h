@@ -52,6 +52,10 @@ typedef struct {
     char data_len[16];		/* data size for each channel */
     void *data_addr[16];	/* pointers to data for each channel */
     hal_type_t data_type[16];	/* data type for each channel */
+    unsigned int ring_len;	/* samples in the ring when streaming */
+    char data_aux[16];		/* channel is taken by the aux function */
+    int aux_on;			/* aux function is recording */
+    int aux_mult_cntr;		/* used to divide by 'aux_mult' */
 } scope_rt_control_t;
 
 /***********************************************************************
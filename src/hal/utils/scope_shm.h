@@ -43,6 +43,7 @@
 
 #define SCOPE_SHM_KEY  0x130CF406
 #define SCOPE_NUM_SAMPLES_DEFAULT 16000
+#define SCOPE_STREAM_TRIGS 64	/* triggers remembered while streaming */
 
 typedef enum {
     IDLE = 0,			/* waiting for run command */
@@ -51,7 +52,8 @@ typedef enum {
     TRIG_WAIT,			/* waiting for trigger */
     POST_TRIG,			/* acquiring post-trigger data */
     DONE,			/* data acquisition complete */
-    RESET			/* data acquisition interrupted */
+    RESET,			/* data acquisition interrupted */
+    STREAM			/* acquiring continuously for user to drain */
 } scope_state_t;
 
 /* this struct holds a single value - one sample of one channel */
@@ -91,6 +93,35 @@ typedef struct {
     int data_offset[16];	/* U data addr in shmem for each channel */
     hal_type_t data_type[16];	/* U data type for each channel */
     char data_len[16];		/* U data size, 0 if not to be acquired */
+    /* In streaming mode the buffer is a ring of whole samples that the
+       user side drains.  The counts only ever increase; the ring is full
+       when 'wr_count' is a ring's worth ahead of 'rd_count', and then
+       new samples are dropped rather than overwriting unread ones. */
+    int stream;			/* U non-zero to stream instead of record */
+    unsigned int wr_count;	/* R samples written to the ring */
+    unsigned int rd_count;	/* U samples consumed from the ring */
+    unsigned int overruns;	/* R samples dropped because ring was full */
+    unsigned int trig_count;	/* R triggers seen while streaming */
+    unsigned int trig_sample[SCOPE_STREAM_TRIGS];	/* R wr_count at each
+				   trigger, indexed by trig_count */
+    /* A second function, 'scope.sample-aux', can run in another thread
+       and take the channels with 'data_aux' set, so that a fast thread
+       copies only its own signals.  It keeps a ring of records at
+       'aux_start' in the buffer, each the value of 'tick' when it was
+       taken followed by its channels, while 'scope.sample' records and
+       looks for the trigger.  'tick' counts the samples 'scope.sample'
+       has taken since INIT, so the user side puts each aux value on the
+       main timeline at the sample that followed it.  The main samples
+       keep a slot for each aux channel, which the user side fills in.
+       Not used while streaming. */
+    char aux_thread_name[HAL_NAME_LEN + 1];	/* U thread used for aux */
+    int aux_mult;		/* U aux sample period multiplier */
+    char data_aux[16];		/* U non-zero if aux function takes chan */
+    int aux_start;		/* U offset of the aux ring in the buffer */
+    int aux_sample_len;		/* U entries per aux record, tick + chans */
+    int aux_ring_len;		/* U records in the aux ring, 0 if none */
+    unsigned int tick;		/* R samples taken since INIT */
+    unsigned int aux_count;	/* R aux records written since INIT */
 } scope_shm_control_t;
 
 #endif /* HALSC_SHM_H */
@@ -50,6 +50,8 @@ typedef struct {
     /* general data */
     gchar *thread_name;		/* name of thread that does sampling */
     long thread_period_ns;	/* period of thread in nano-secs */
+    gchar *aux_thread_name;	/* thread of the aux function, or NULL */
+    long aux_thread_period_ns;	/* period of that thread in nano-secs */
     long sample_period_ns;	/* sample period in nano-secs */
     double sample_period;	/* sample period as a double */
     double disp_scale;		/* display scale (sec/div) */
@@ -74,6 +76,9 @@ typedef struct {
     GtkWidget *sample_period_label;
     GtkObject *mult_adj;
     GtkWidget *mult_spinbutton;
+    GtkWidget *aux_thread_list;
+    GtkObject *aux_mult_adj;
+    GtkWidget *aux_mult_spinbutton;
 } scope_horiz_t;
 
 /* this struct holds control data related to a single channel */
@@ -93,6 +98,7 @@ typedef struct {
     int min_index;
     double scale;		/* scaling (units/div) */
     double position;		/* vertical pos (0.0-1.0) */
+    int aux;			/* sampled by the aux function */
 } scope_chan_t;
 
 /* this struct holds control data related to vertical control */
@@ -117,6 +123,7 @@ typedef struct {
     GtkObject *pos_adj;
     GtkWidget *offset_button;
     GtkWidget *offset_label;
+    GtkWidget *aux_button;
     GtkWidget *readout_label;
     /* widgets for offset dialog */
     GtkWidget *offset_entry;
@@ -152,6 +159,23 @@ typedef struct {
 
 
 
+/* this struct holds a min/max summary of one channel of the display
+   buffer.  Level 0 covers MINMAX_BASE samples per block, and each
+   level above it covers twice as many.  It lets zoomed out traces be
+   drawn in time proportional to the window width, not the record length.
+*/
+
+#define MINMAX_BASE 16		/* samples per block at level 0 */
+#define MINMAX_LEVELS 24	/* max number of levels */
+
+typedef struct {
+    int levels;			/* number of valid levels, 0 if no data */
+    int blocks[MINMAX_LEVELS];	/* number of blocks at each level */
+    double *min[MINMAX_LEVELS];	/* smallest value in each block */
+    double *max[MINMAX_LEVELS];	/* largest value in each block */
+    double mean;		/* average of all samples */
+} scope_minmax_t;
+
 /* this struct holds control data related to the display */
 /* it lives in user space (as part of the master control struct) */
 
@@ -177,6 +201,10 @@ typedef struct {
 
     GdkGC *context;		/* graphics context for drawing */
     int selected_part;
+    /* min/max summaries of the display buffer */
+    scope_minmax_t minmax[16];
+    double *minmax_pool;	/* storage for all summaries */
+    int minmax_pool_len;	/* number of doubles in pool */
 } scope_disp_t;
 
 /* this struct holds data relating to logging */ 
@@ -255,6 +283,7 @@ void capture_cont(void);
 void start_capture(void);
 void request_display_refresh(int delay);
 void refresh_display(void);
+void update_display_minmax(void);
 void refresh_trigger(void);
 void invalidate_channel(int chan);
 void invalidate_all_channels(void);
@@ -270,6 +299,9 @@ void write_vert_config(FILE *fp);
 void write_trig_config(FILE *fp);
 void write_log_file (char *filename);
 void write_sample(FILE *fp, char *label, scope_data_t *dptr, hal_type_t type);
+int open_stream_file(char *filename);
+void drain_stream_file(void);
+void close_stream_file(void);
 
 /* the following functions set various parameters, they are normally
    called by the GUI, but can also be called by code reading a file
@@ -277,6 +309,9 @@ void write_sample(FILE *fp, char *label, scope_data_t *dptr, hal_type_t type);
 */
 
 int set_sample_thread(char *name);
+int set_aux_thread(char *name);
+int set_aux_mult(int setting);
+void calc_aux_split(void);
 int set_rec_len(int setting);
 int set_horiz_mult(int setting);
 int set_horiz_zoom(int setting);
@@ -284,6 +319,7 @@ int set_horiz_pos(double setting);
 int set_active_channel(int chan_num);
 int set_channel_source(int chan, int type, char *name);
 int set_channel_off(int chan_num);
+int set_channel_aux(int setting);
 int set_vert_scale(int setting);
 void format_scale_value(char *buf, int buflen, double value);
 int set_vert_pos(double setting);
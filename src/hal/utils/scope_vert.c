@@ -66,6 +66,8 @@
    the code rather than the user, without causing any action.
    This global is used for that */
 static int ignore_click = 0;
+/* likewise for the aux button */
+static int ignore_aux = 0;
 
 /***********************************************************************
 *                  LOCAL FUNCTION PROTOTYPES                           *
@@ -86,6 +88,7 @@ static void selection_made(GtkWidget * clist, gint row, gint column,
 static void change_source_button(GtkWidget * widget, gpointer gdata);
 static void channel_off_button(GtkWidget * widget, gpointer gdata);
 static void offset_button(GtkWidget * widget, gpointer gdata);
+static void aux_button(GtkWidget * widget, gpointer gdata);
 static gboolean dialog_set_offset(int chan_num);
 static void scale_changed(GtkAdjustment * adj, gpointer gdata);
 static void offset_changed(GtkEditable * editable, struct offset_data *);
@@ -281,6 +284,34 @@ int set_channel_source(int chan_num, int type, char *name)
     return 0;
 }
 
+/* Has the selected channel taken by the aux function, see
+   set_aux_thread(). */
+int set_channel_aux(int setting)
+{
+    scope_vert_t *vert;
+    scope_chan_t *chan;
+    int chan_num;
+
+    vert = &(ctrl_usr->vert);
+    chan_num = vert->selected;
+    if ((chan_num < 1) || (chan_num > 16)) {
+	return -1;
+    }
+    chan = &(ctrl_usr->chan[chan_num - 1]);
+    setting = (setting != 0);
+    if (chan->aux == setting) {
+	return 0;
+    }
+    if (ctrl_shm->state != IDLE) {
+	/* acquisition in progress, must restart it */
+	prepare_scope_restart();
+    }
+    chan->aux = setting;
+    calc_aux_split();
+    channel_changed();
+    return 0;
+}
+
 int set_vert_scale(int setting)
 {
     scope_vert_t *vert;
@@ -653,6 +684,13 @@ static void init_vert_info_window(void)
     gtk_signal_connect(GTK_OBJECT(vert->offset_button), "clicked",
 	GTK_SIGNAL_FUNC(offset_button), NULL);
     gtk_widget_show(vert->offset_button);
+    /* take the channel in the aux thread */
+    vert->aux_button = gtk_check_button_new_with_label(_("Aux"));
+    gtk_box_pack_start(GTK_BOX(ctrl_usr->vert_info_win),
+	vert->aux_button, FALSE, FALSE, 0);
+    gtk_signal_connect(GTK_OBJECT(vert->aux_button), "toggled",
+	GTK_SIGNAL_FUNC(aux_button), NULL);
+    gtk_widget_show(vert->aux_button);
     /* a button to turn off the channel */
     button = gtk_button_new_with_label(_("Chan Off"));
     gtk_box_pack_start(GTK_BOX(ctrl_usr->vert_info_win), button, FALSE, FALSE,
@@ -698,6 +736,14 @@ static void offset_button(GtkWidget * widget, gpointer gdata)
     }
 }
 
+static void aux_button(GtkWidget * widget, gpointer gdata)
+{
+    if (ignore_aux != 0) {
+	return;
+    }
+    set_channel_aux(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
+}
+
 static gboolean dialog_set_offset(int chan_num)
 {
     scope_vert_t *vert;
@@ -1256,6 +1302,12 @@ void channel_changed(void)
     }
     snprintf(buf2, BUFLEN, _("Offset\n%s"), buf1);
     gtk_label_set_text_if(vert->offset_label, buf2);
+    if (vert->aux_button != NULL) {
+	ignore_aux = 1;
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(vert->aux_button),
+	    chan->aux);
+	ignore_aux = 0;
+    }
     request_display_refresh(1);
 }
 
@@ -1308,4 +1360,7 @@ static void write_chan_config(FILE *fp, scope_chan_t *chan)
     } else {
         fprintf(fp, "VOFF %e\n", chan->vert_offset);
     }
+    if (chan->aux) {
+	fprintf(fp, "CHAUX 1\n");
+    }
 }
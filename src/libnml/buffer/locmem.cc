@@ -34,6 +34,7 @@ extern "C" {
 }
 #endif
 LinkedList *LOCMEM::buffers_list = (LinkedList *) NULL;
+pthread_mutex_t LOCMEM::buffers_list_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 LOCMEM::LOCMEM(const char *bufline, const char *procline, int set_to_server,
     int set_to_master):CMS(bufline, procline, set_to_server)
@@ -48,13 +49,34 @@ LOCMEM::LOCMEM(const char *bufline, const char *procline, int set_to_server,
 	is_local_master = 0;
     }
 
-    if (is_local_master) {
+    pthread_mutex_lock(&buffers_list_mutex);
+
+    /* Search for a matching buffer name. */
+    BUFFERS_LIST_NODE *node = (BUFFERS_LIST_NODE *) NULL;
+    if (buffers_list != NULL) {
+	node = (BUFFERS_LIST_NODE *) buffers_list->get_head();
+	while (node != NULL && strcmp(BufferName, node->name)) {
+	    node = (BUFFERS_LIST_NODE *) buffers_list->get_next();
+	}
+    }
+
+    /* A process_local buffer is created by whichever of its users comes
+       first, since no other process will. */
+    if (is_local_master || (process_local && node == NULL)) {
+	if (node != NULL) {
+	    rcs_print_error("LOCMEM: buffer %s already exists.\n",
+		BufferName);
+	    status = CMS_CREATE_ERROR;
+	    pthread_mutex_unlock(&buffers_list_mutex);
+	    return;
+	}
 	if (buffers_list == NULL) {
 	    buffers_list = new LinkedList;
 	}
 	if (buffers_list == NULL) {
 	    rcs_print_error("LOCMEM: Can't create buffers_list.\n");
 	    status = CMS_CREATE_ERROR;
+	    pthread_mutex_unlock(&buffers_list_mutex);
 	    return;
 	}
 	my_node = new BUFFERS_LIST_NODE;
@@ -62,57 +84,75 @@ LOCMEM::LOCMEM(const char *bufline, const char *procline, int set_to_server,
 	if (my_node == NULL || lm_addr == NULL) {
 	    rcs_print_error("Can't malloc needed space.\n");
 	    status = CMS_CREATE_ERROR;
+	    pthread_mutex_unlock(&buffers_list_mutex);
 	    return;
 	}
 	my_node->size = size;
 	strcpy(my_node->name, BufferName);
 	memset(my_node->addr, 0, size);
+	my_node->users = 1;
+	pthread_mutex_init(&my_node->mutex, NULL);
 	buffer_id = buffers_list->store_at_tail(my_node, sizeof(my_node), 0);
+	pthread_mutex_unlock(&buffers_list_mutex);
 	return;
     }
 
     if (buffers_list == NULL) {
 	rcs_print_error("LOCMEM: buffers_list is NULL.\n");
 	status = CMS_NO_MASTER_ERROR;
+	pthread_mutex_unlock(&buffers_list_mutex);
 	return;
     }
-
-    /* Search for a matching buffer name. */
-    my_node = (BUFFERS_LIST_NODE *) buffers_list->get_head();
-    while (my_node != NULL) {
-	if (!strcmp(BufferName, my_node->name)) {
-	    /* Found it!!! */
-	    if (my_node->size != size) {
-		rcs_print_error("LOCMEM - size mismatch for buffer %s.\n",
-		    BufferName);
-		status = CMS_CONFIG_ERROR;
-		return;
-	    }
-	    buffer_id = buffers_list->get_current_id();
-	    lm_addr = my_node->addr;
-	    return;
-	}
-	my_node = (BUFFERS_LIST_NODE *) buffers_list->get_next();
+    if (node == NULL) {
+	rcs_print_error("LOCMEM: buffer not found on buffers_list.\n");
+	status = CMS_NO_MASTER_ERROR;
+	pthread_mutex_unlock(&buffers_list_mutex);
+	return;
     }
-    rcs_print_error("LOCMEM: buffer not found on buffers_list.\n");
-    status = CMS_NO_MASTER_ERROR;
-    return;
-
+    if (node->size != size) {
+	rcs_print_error("LOCMEM - size mismatch for buffer %s.\n",
+	    BufferName);
+	status = CMS_CONFIG_ERROR;
+	pthread_mutex_unlock(&buffers_list_mutex);
+	return;
+    }
+    my_node = node;
+    my_node->users++;
+    buffer_id = buffers_list->get_current_id();
+    lm_addr = my_node->addr;
+    pthread_mutex_unlock(&buffers_list_mutex);
 }
 
 LOCMEM::~LOCMEM()
 {
-    if (NULL != buffers_list) {
-	buffers_list->delete_node(buffer_id);
-	if (0 == buffers_list->list_size) {
-	    delete buffers_list;
-	    buffers_list = (LinkedList *) NULL;
+    if (NULL == my_node || NULL == lm_addr) {
+	/* Failed constructor; nothing was attached. */
+	return;
+    }
+    pthread_mutex_lock(&buffers_list_mutex);
+    /* The buffer goes away with the last of its users, not its creator. */
+    if (--my_node->users == 0) {
+	if (NULL != buffers_list) {
+	    buffers_list->delete_node(buffer_id);
+	    if (0 == buffers_list->list_size) {
+		delete buffers_list;
+		buffers_list = (LinkedList *) NULL;
+	    }
 	}
+	pthread_mutex_destroy(&my_node->mutex);
+	free(my_node->addr);
+	delete my_node;
     }
+    my_node = (BUFFERS_LIST_NODE *) NULL;
+    pthread_mutex_unlock(&buffers_list_mutex);
 }
 
 CMS_STATUS LOCMEM::main_access(void *local_address)
 {
+    /* Users may be on different threads; an uncontended mutex costs no
+       system call. */
+    pthread_mutex_lock(&my_node->mutex);
     internal_access(lm_addr, size, local_address);
+    pthread_mutex_unlock(&my_node->mutex);
     return status;
 }
@@ -24,10 +24,14 @@
 #include "cms.hh"		// class CMS
 #include "linklist.hh"		// class LinkedList
 
+#include <pthread.h>		// pthread_mutex_t
+
 struct BUFFERS_LIST_NODE {
     void *addr;
     long size;
     char name[64];
+    int users;			// LOCMEM objects attached to this buffer
+    pthread_mutex_t mutex;	// held while one of them accesses it
 };
 
 class LOCMEM:public CMS {
@@ -42,6 +46,7 @@ class LOCMEM:public CMS {
     int buffer_id;
     BUFFERS_LIST_NODE *my_node;
     static LinkedList *buffers_list;
+    static pthread_mutex_t buffers_list_mutex;
 };
 
 #endif
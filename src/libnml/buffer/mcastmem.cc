@@ -0,0 +1,285 @@
+/********************************************************************
+* Description: mcastmem.cc
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdlib.h>		// malloc(), free()
+#include <unistd.h>		// close()
+#include <string.h>		// memcpy(), strerror()
+#include <errno.h>		// errno
+#include <fcntl.h>		/* fcntl(), O_NONBLOCK */
+#include <math.h>		/* fmod() */
+#include <arpa/inet.h>		/* inet_addr() */
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>           /* struct timeval */
+#include <netinet/in.h>		/* struct ip_mreq */
+
+#ifdef __cplusplus
+}
+#endif
+#include "rcs_print.hh"		/* rcs_print_error() */
+#include "timer.hh"		/* etime() */
+#include "mcastmem.hh"
+#include "mcast.hh"		/* NML_MCAST_MAGIC */
+#include "tcp_pack.hh"		/* tcp_unpack() */
+
+static uint32_t getbe32(char *addr) {
+    uint32_t val;
+    memcpy(&val, addr, sizeof(val));
+    return ntohl(val);
+}
+
+MCASTMEM::MCASTMEM(const char *_bufline, const char *_procline):CMS(_bufline, _procline)
+{
+    socket_fd = -1;
+    assembly = NULL;
+    fragment_seen = NULL;
+    base = NULL;
+    base_size = 0;
+    base_id = 0;
+    assembly_seq = 0;
+    assembly_id = 0;
+    assembly_size_field = 0;
+    fragments = 0;
+    fragments_left = 0;
+    new_message = 0;
+    new_id = 0;
+    if (status < 0) {
+	return;
+    }
+    if (0 == mcast_group[0]) {
+	rcs_print_error("MCASTMEM: %s has no MCAST=group:port.\n",
+	    BufferName);
+	status = CMS_CONFIG_ERROR;
+	return;
+    }
+
+    max_fragments = (max_encoded_message_size + NML_MCAST_FRAGMENT_SIZE -
+	1) / NML_MCAST_FRAGMENT_SIZE;
+    assembly = (char *) malloc(max_encoded_message_size);
+    base = (char *) malloc(max_encoded_message_size);
+    fragment_seen = (char *) malloc(max_fragments);
+    if (NULL == assembly || NULL == base || NULL == fragment_seen) {
+	rcs_print_error("MCASTMEM: Can't malloc %ld bytes.\n",
+	    max_encoded_message_size);
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+
+    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+	rcs_print_error("MCASTMEM: Error from socket() (errno = %d:%s)\n",
+	    errno, strerror(errno));
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+    /* Any number of viewers on one host share the port. */
+    int on = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((u_short) mcast_port);
+    if (bind(socket_fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+	rcs_print_error("MCASTMEM: bind error %d = %s\n", errno,
+	    strerror(errno));
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(mcast_group);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(socket_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+	    sizeof(mreq)) < 0) {
+	rcs_print_error("MCASTMEM: Can't join %s (errno = %d:%s)\n",
+	    mcast_group, errno, strerror(errno));
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	"MCASTMEM: %s from %s:%d\n", BufferName, mcast_group, mcast_port);
+}
+
+MCASTMEM::~MCASTMEM()
+{
+    if (socket_fd >= 0) {
+	close(socket_fd);
+	socket_fd = -1;
+    }
+    free(assembly);
+    free(base);
+    free(fragment_seen);
+}
+
+/* Reads whatever datagrams have come in.  Returns 1 if that finished
+   a message the last read() did not have. */
+int MCASTMEM::receive()
+{
+    char datagram[NML_MCAST_DATAGRAM_SIZE];
+
+    /* Bounded, so a flood can't keep a reader here. */
+    for (int i = 0; i < 4096; i++) {
+	long length = recv(socket_fd, datagram, sizeof(datagram), 0);
+	if (length < 0) {
+	    break;
+	}
+	take_fragment(datagram, length);
+    }
+    return new_message;
+}
+
+int MCASTMEM::take_fragment(char *datagram, long length)
+{
+    if (length < NML_MCAST_HEADER_SIZE
+	|| getbe32(datagram) != NML_MCAST_MAGIC
+	|| (long) getbe32(datagram + 4) != buffer_number) {
+	return 0;
+    }
+    unsigned long seq = getbe32(datagram + 8);
+    unsigned long id = getbe32(datagram + 12);
+    long size_field = getbe32(datagram + 16);
+    long index = getbe32(datagram + 20) >> 16;
+    long count = getbe32(datagram + 20) & 0xffff;
+    long size = size_field & ~TCP_PACKED_SIZE_FLAG;
+    if (size <= 0 || size > max_encoded_message_size
+	|| count != (size + NML_MCAST_FRAGMENT_SIZE - 1) /
+	NML_MCAST_FRAGMENT_SIZE || index >= count) {
+	return 0;
+    }
+    long offset = index * NML_MCAST_FRAGMENT_SIZE;
+    long fragment_size = size - offset;
+    if (fragment_size > NML_MCAST_FRAGMENT_SIZE) {
+	fragment_size = NML_MCAST_FRAGMENT_SIZE;
+    }
+    if (length != NML_MCAST_HEADER_SIZE + fragment_size) {
+	return 0;
+    }
+
+    /* A fragment of a newer message drops what is left of the old. */
+    if (0 == fragments || seq != assembly_seq) {
+	assembly_seq = seq;
+	assembly_id = id;
+	assembly_size_field = size_field;
+	fragments = fragments_left = count;
+	memset(fragment_seen, 0, count);
+    } else if (size_field != assembly_size_field) {
+	return 0;
+    }
+    if (fragment_seen[index]) {
+	return 0;
+    }
+    fragment_seen[index] = 1;
+    memcpy(assembly + offset, datagram + NML_MCAST_HEADER_SIZE,
+	fragment_size);
+    if (--fragments_left > 0) {
+	return 0;
+    }
+    fragments = 0;
+    return finish_message();
+}
+
+/* Unpacks the message just put back together into encoded_data.  One
+   packed against a message this end missed is dropped, to wait for
+   the next keyframe. */
+int MCASTMEM::finish_message()
+{
+    long size = assembly_size_field & ~TCP_PACKED_SIZE_FLAG;
+
+    if (assembly_size_field & TCP_PACKED_SIZE_FLAG) {
+	unsigned long packed_base_id = tcp_packed_base_id(assembly, size);
+	if (packed_base_id != 0 && packed_base_id != base_id) {
+	    return 0;
+	}
+	size = tcp_unpack(assembly, size,
+	    packed_base_id ? base : NULL, packed_base_id ? base_size : 0,
+	    (char *) encoded_data, max_encoded_message_size);
+	if (size < 0) {
+	    rcs_print_error("MCASTMEM: Received a bad packed message.\n");
+	    base_id = 0;
+	    return 0;
+	}
+    } else {
+	memcpy(encoded_data, assembly, size);
+    }
+    memcpy(base, encoded_data, size);
+    base_size = size;
+    base_id = assembly_id;
+    new_id = assembly_id;
+    new_message = 1;
+    return 1;
+}
+
+CMS_STATUS MCASTMEM::read()
+{
+    if (!read_permission_flag) {
+	rcs_print_error("CMS: %s was not configured to read %s\n",
+	    ProcessName, BufferName);
+	return (status = CMS_PERMISSIONS_ERROR);
+    }
+    if (socket_fd < 0) {
+	return (status = CMS_MISC_ERROR);
+    }
+    if (!receive()) {
+	return (status = CMS_READ_OLD);
+    }
+    new_message = 0;
+    status = CMS_STATUS_NOT_SET;
+    check_id(new_id);
+    return (status);
+}
+
+CMS_STATUS MCASTMEM::blocking_read(double _blocking_timeout)
+{
+    double start_time = etime();
+
+    while (1) {
+	read();
+	if (status != CMS_READ_OLD) {
+	    return (status);
+	}
+	struct timeval tm;
+	struct timeval *tmp = NULL;
+	if (_blocking_timeout >= 0.0) {
+	    double timeleft = start_time + _blocking_timeout - etime();
+	    if (timeleft <= 0.0) {
+		return (status = CMS_TIMED_OUT);
+	    }
+	    tm.tv_sec = (long) timeleft;
+	    tm.tv_usec = (long) (fmod(timeleft, 1.0) * 1e6);
+	    tmp = &tm;
+	}
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(socket_fd, &fds);
+	if (select(socket_fd + 1, &fds, NULL, NULL, tmp) < 0
+	    && errno != EINTR) {
+	    return (status = CMS_MISC_ERROR);
+	}
+    }
+}
+
+/* Viewers don't change was_read, so peeking is the same as reading. */
+CMS_STATUS MCASTMEM::peek()
+{
+    return read();
+}
+
+CMS_STATUS MCASTMEM::write(void *user_data)
+{
+    rcs_print_error("MCASTMEM: %s is read only.\n", BufferName);
+    return (status = CMS_PERMISSIONS_ERROR);
+}
+
+CMS_STATUS MCASTMEM::write_if_read(void *user_data)
+{
+    return write(user_data);
+}
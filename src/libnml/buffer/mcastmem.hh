@@ -0,0 +1,50 @@
+/********************************************************************
+* Description: mcastmem.hh
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef MCASTMEM_HH
+#define MCASTMEM_HH
+
+#include "cms.hh"		/* class CMS */
+
+/* A read only view of a buffer that its TCP server publishes to a
+   multicast group, see mcast.hh.  cms_config() makes one instead of a
+   TCPMEM for a REMOTE process with "mcast" on its line when the
+   buffer line has MCAST=. */
+class MCASTMEM:public CMS {
+  public:
+    MCASTMEM(const char *bufline, const char *procline);
+      virtual ~ MCASTMEM();
+
+    /* Overloaded CMS functions. */
+    CMS_STATUS read();
+    CMS_STATUS blocking_read(double);
+    CMS_STATUS peek();
+    CMS_STATUS write(void *data);
+    CMS_STATUS write_if_read(void *data);
+
+  protected:
+    int receive();
+    int take_fragment(char *datagram, long length);
+    int finish_message();
+    int socket_fd;
+    char *assembly;		/* the message being put back together */
+    char *fragment_seen;
+    long max_fragments;
+    unsigned long assembly_seq;
+    unsigned long assembly_id;
+    long assembly_size_field;
+    long fragments;
+    long fragments_left;
+    char *base;			/* the last message put back together */
+    long base_size;
+    unsigned long base_id;
+    int new_message;
+    unsigned long new_id;
+};
+
+#endif
@@ -110,6 +110,7 @@ int recvn(int fd, void *vptr, int n, int flags, double _timeout,
 	    if (timeout_tv.tv_usec >= 1000000) {
 		timeout_tv.tv_usec = timeout_tv.tv_usec % 1000000;
 	    }
+	    FD_SET(fd, &recv_fd_set);
 	    switch (select(fd + 1, &recv_fd_set, (fd_set *) NULL,
 		    (fd_set *) NULL, &timeout_tv)) {
 	    case -1:
@@ -192,8 +193,9 @@ int recvn(int fd, void *vptr, int n, int flags, double _timeout,
 	}
 	nleft -= nrecv;
 	ptr += nrecv;
+	/* The select() at the top of the loop blocks until the rest of the
+	   message arrives, so there is no need to sleep here. */
 	if (nleft > 0 && _timeout > 0.0) {
-	    esleep(0.001);
 	    if (etime() - start_time > _timeout) {
 		rcs_print_error("Recv timed out.\n");
 		recvn_timedout = 1;
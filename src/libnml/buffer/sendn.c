@@ -54,6 +54,7 @@ int sendn(int fd, const void *vptr, int n, int _flags, double _timeout)
     start_time = etime();
     while (nleft > 0) {
 	if (fabs(_timeout) > 1E-6) {
+	    FD_SET(fd, &send_fd_set);
 	    if (_timeout > 0) {
                 double timeleft;
 		timeleft = start_time + _timeout - etime();
@@ -111,7 +112,6 @@ int sendn(int fd, const void *vptr, int n, int _flags, double _timeout)
                 rcs_print_error("sendn: timed out after %f seconds.\n", duration);
 		return (-1);
 	    }
-	    esleep(0.001);
 	}
     }
     rcs_print_debug(PRINT_SOCKET_WRITE_SIZE, "wrote %d bytes to %d\n", n, fd);
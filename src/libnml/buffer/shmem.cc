@@ -27,6 +27,11 @@ extern "C" {
 #include <errno.h>		// errno
 #include <string.h>		/* strchr(), memcpy(), memset() */
 #include <stdlib.h>		/* strtod */
+#include <limits.h>		/* INT_MAX */
+#include <unistd.h>		/* syscall() */
+#include <sys/syscall.h>	/* SYS_futex */
+#include <linux/futex.h>	/* FUTEX_WAIT, FUTEX_WAKE */
+#include <signal.h>		/* kill() */
 #include <physmem.hh>           /* PHYSMEM_HANDLE */
 
 #ifdef __cplusplus
@@ -43,6 +48,14 @@ extern "C" {
 //#include "autokey.h"
 /* rw-rw-r-- permissions */
 #define MODE (0777)
+
+/* The segment starts with the buffer name, then the SHMEM_WAKE words;
+   the CMS area follows the whole header. */
+#define SHMEM_NAME_SIZE 32
+#define SHMEM_HEADER_SIZE (SHMEM_NAME_SIZE + (int) sizeof(struct SHMEM_WAKE))
+/* The CMS_ACCESS_STATS block is past the size on the buffer line, so
+   keeping it costs no message space. */
+#define SHMEM_STATS_OFFSET(size) (((size) + 7) & ~7L)
 static double last_non_zero_x;
 static double last_x;
 
@@ -150,6 +163,13 @@ SHMEM::SHMEM(const char *bufline, const char *procline, int set_to_server,
 	use_os_sem_only = 0;
     }
 
+    /* single writer, any number of readers which never write back */
+    if (NULL != strstr(buflineupper, "MUTEX=LOCKFREE")) {
+	mutex_type = LOCK_FREE_MUTEX;
+	use_os_sem = 0;
+	use_os_sem_only = 0;
+    }
+
     if (NULL != strstr(buflineupper, "MAO_W_OS_SEM")) {
 	mutex_type = MAO_MUTEX_W_OS_SEM;
 	use_os_sem = 1;
@@ -162,6 +182,7 @@ SHMEM::SHMEM(const char *bufline, const char *procline, int set_to_server,
 
 SHMEM::~SHMEM()
 {
+    release_borrow();
     /* detach from shared memory and semaphores */
     close();
 }
@@ -173,20 +194,28 @@ int SHMEM::open()
 {
     /* Set pointers to NULL incase error occurs. */
     sem = NULL;
+    borrow_locked = 0;
     shm = NULL;
     bsem = NULL;
+    wake = NULL;
+    snapshot = NULL;
+    snapshot_seq = -1;
     shm_addr_offset = NULL;
     second_read = 0;
     autokey_table_size = 0;
+    stats = NULL;
+    stats_proc = -1;
 /*! \todo Another #if 0 */
 #if 0				// PC Do we need to use autokey ?
     if (use_autokey_for_connection_number) {
 	autokey_table_size = sizeof(AUTOKEY_TABLE_ENTRY) * total_connections;
     }
 #endif
+    long shm_size = SHMEM_STATS_OFFSET(size) + sizeof(CMS_ACCESS_STATS);
     /* set up the shared memory address and semaphore, in given state */
     if (master) {
-	shm = new RCS_SHAREDMEM(key, size, RCS_SHAREDMEM_CREATE, (int) MODE);
+	shm = new RCS_SHAREDMEM(key, shm_size, RCS_SHAREDMEM_CREATE,
+	    (int) MODE);
 	if (shm->addr == NULL) {
 	    switch (shm->create_errno) {
 	    case EACCES:
@@ -242,7 +271,7 @@ int SHMEM::open()
 	}
 	in_buffer_id = 0;
     } else {
-	shm = new RCS_SHAREDMEM(key, size, RCS_SHAREDMEM_NOCREATE);
+	shm = new RCS_SHAREDMEM(key, shm_size, RCS_SHAREDMEM_NOCREATE);
 	if (NULL == shm) {
 	    rcs_print_error
 		("CMS: couldn't create RCS_SHAREDMEM(%d(0x%X), %ld(0x%lX), RCS_SHAREDMEM_NOCREATE).\n",
@@ -307,6 +336,13 @@ int SHMEM::open()
 	}
     }
 
+    stats = (struct CMS_ACCESS_STATS *) ((char *) shm->addr +
+	SHMEM_STATS_OFFSET(size));
+    if (master) {
+	memset(stats, 0, sizeof(CMS_ACCESS_STATS));
+    }
+    claim_stats_slot();
+
     if (min_compatible_version < 3.44 && min_compatible_version > 0) {
 	total_subdivisions = 1;
     }
@@ -314,14 +350,15 @@ int SHMEM::open()
     if (min_compatible_version > 2.57 || min_compatible_version <= 0) {
 	if (!shm->created) {
 	    char *cptr = (char *) shm->addr;
-	    cptr[31] = 0;
-	    if (strncmp(cptr, BufferName, 31)) {
+	    cptr[SHMEM_NAME_SIZE - 1] = 0;
+	    if (strncmp(cptr, BufferName, SHMEM_NAME_SIZE - 1)) {
 		rcs_print_error
 		    ("Shared memory buffers %s and %s may conflict. (key=%d(0x%X))\n",
 		    BufferName, cptr, key, key);
-		strncpy(cptr, BufferName, 32);
+		strncpy(cptr, BufferName, SHMEM_NAME_SIZE);
 	    }
 	}
+	wake = (struct SHMEM_WAKE *) ((char *) shm->addr + SHMEM_NAME_SIZE);
 	if (master) {
 /*! \todo Another #if 0 */
 #if 0				// PC Do we need to use autokey ?
@@ -331,7 +368,11 @@ int SHMEM::open()
 		memset(autokey_table_end, 0, size - 32 - autokey_table_size);
 	    }
 #endif
-	    strncpy((char *) shm->addr, BufferName, 32);
+	    strncpy((char *) shm->addr, BufferName, SHMEM_NAME_SIZE);
+	    // nobody can be waiting on a segment we are just setting up,
+	    // nor writing to it
+	    wake->waiters = 0;
+	    wake->seq &= ~1;
 	}
 /*! \todo Another #if 0 */
 #if 0				// PC Do we need to use autokey ?
@@ -347,9 +388,9 @@ int SHMEM::open()
 								   for user */
 	} else {
 #endif
-	    shm_addr_offset = (void *) ((char *) (shm->addr) + 32);
-	    max_message_size -= 32;	/* size of cms buffer available for
-					   user */
+	    shm_addr_offset = (void *) ((char *) (shm->addr) + SHMEM_HEADER_SIZE);
+	    max_message_size -= SHMEM_HEADER_SIZE;	/* size of cms buffer
+							   available for user */
 /*! \todo Another #if 0 */
 #if 0				// PC Do we need to use autokey ?
 	}
@@ -357,18 +398,20 @@ int SHMEM::open()
 	/* messages = size - CMS Header space */
 	if (enc_max_size <= 0 || enc_max_size > size) {
 	    if (neutral) {
-		max_encoded_message_size -= 32;
+		max_encoded_message_size -= SHMEM_HEADER_SIZE;
 	    } else {
 		max_encoded_message_size -=
-		    (cms_encoded_data_explosion_factor * 32);
+		    (cms_encoded_data_explosion_factor * SHMEM_HEADER_SIZE);
 	    }
 	}
 	/* Maximum size of message after being encoded. */
-	guaranteed_message_space -= 32;	/* Largest size message before being
-					   encoded that can be guaranteed to
-					   fit after xdr. */
-	size -= 32;
-	size_without_diagnostics -= 32;
+	guaranteed_message_space -= SHMEM_HEADER_SIZE;	/* Largest size message
+							   before being encoded
+							   that can be
+							   guaranteed to fit
+							   after xdr. */
+	size -= SHMEM_HEADER_SIZE;
+	size_without_diagnostics -= SHMEM_HEADER_SIZE;
 	subdiv_size =
 	    (size_without_diagnostics -
 	    total_connections) / total_subdivisions;
@@ -379,7 +422,7 @@ int SHMEM::open()
 	}
 	shm_addr_offset = shm->addr;
     }
-    skip_area = 32 + total_connections + autokey_table_size;
+    skip_area = SHMEM_HEADER_SIZE + total_connections + autokey_table_size;
     mao.data = shm_addr_offset;
     mao.timeout = timeout;
     mao.total_connections = total_connections;
@@ -389,6 +432,24 @@ int SHMEM::open()
     mao.read_only = 0;
     mao.sem = sem;
 
+    if (mutex_type == LOCK_FREE_MUTEX) {
+	if (NULL == wake || queuing_enabled || split_buffer
+	    || total_subdivisions > 1) {
+	    rcs_print_error
+		("SHMEM: %s: MUTEX=LOCKFREE can not be used with queue, split or subdivisions.\n",
+		BufferName);
+	    status = CMS_CONFIG_ERROR;
+	    return -1;
+	}
+	snapshot = (char *) malloc(size);
+	if (NULL == snapshot) {
+	    rcs_print_error("SHMEM: can't malloc snapshot for %s\n",
+		BufferName);
+	    status = CMS_CREATE_ERROR;
+	    return -1;
+	}
+    }
+
     fast_mode = !queuing_enabled && !split_buffer && !neutral &&
 	(mutex_type == NO_SWITCHING_MUTEX);
     handle_to_global_data = dummy_handle = new PHYSMEM_HANDLE;
@@ -443,6 +504,8 @@ int SHMEM::close()
 	}
 	delete bsem;
     }
+    free(snapshot);
+    snapshot = NULL;
 #ifdef DEBUG
     printf("SHMEM(%s): nattch = %d\n", BufferName, nattch);
 #endif
@@ -450,24 +513,10 @@ int SHMEM::close()
     return 0;
 }
 
-/* Access the shared memory buffer. */
-CMS_STATUS SHMEM::main_access(void *_local)
+/* Take the buffer's mutual exclusion lock for the current access type.
+   Returns 0 on success, or -1 with status set. */
+int SHMEM::take_access()
 {
-
-    /* Check pointers. */
-    if (shm == NULL) {
-	second_read = 0;
-	return (status = CMS_MISC_ERROR);
-    }
-
-    if (bsem == NULL && not_zero(blocking_timeout)) {
-	rcs_print_error
-	    ("No blocking semaphore available. Can not call blocking_read(%f).\n",
-	    blocking_timeout);
-	second_read = 0;
-	return (status = CMS_NO_BLOCKING_SEM_ERROR);
-    }
-
     mao.read_only = ((internal_access_type == CMS_CHECK_IF_READ_ACCESS) ||
 	(internal_access_type == CMS_PEEK_ACCESS) ||
 	(internal_access_type == CMS_READ_ACCESS));
@@ -476,13 +525,20 @@ CMS_STATUS SHMEM::main_access(void *_local)
     case NO_MUTEX:
 	break;
 
+    case LOCK_FREE_MUTEX:
+	rcs_print_error("SHMEM: %s is lock-free and can not be locked.\n",
+	    BufferName);
+	status = CMS_NO_IMPLEMENTATION_ERROR;
+	return -1;
+
     case MAO_MUTEX:
     case MAO_MUTEX_W_OS_SEM:
 	switch (mem_get_access(&mao)) {
 	case -1:
 	    rcs_print_error("SHMEM: Can't take semaphore\n");
 	    second_read = 0;
-	    return (status = CMS_MISC_ERROR);
+	    status = CMS_MISC_ERROR;
+	    return -1;
 	case -2:
 	    if (timeout > 0) {
 		rcs_print_error("SHMEM: Timed out waiting for semaphore.\n");
@@ -490,7 +546,8 @@ CMS_STATUS SHMEM::main_access(void *_local)
 		    BufferName, timeout);
 	    }
 	    second_read = 0;
-	    return (status = CMS_TIMED_OUT);
+	    status = CMS_TIMED_OUT;
+	    return -1;
 	default:
 	    break;
 	}
@@ -500,13 +557,15 @@ CMS_STATUS SHMEM::main_access(void *_local)
     case OS_SEM_MUTEX:
 	if (sem == NULL) {
 	    second_read = 0;
-	    return (status = CMS_MISC_ERROR);
+	    status = CMS_MISC_ERROR;
+	    return -1;
 	}
 	switch (sem->wait()) {
 	case -1:
 	    rcs_print_error("SHMEM: Can't take semaphore\n");
 	    second_read = 0;
-	    return (status = CMS_MISC_ERROR);
+	    status = CMS_MISC_ERROR;
+	    return -1;
 	case -2:
 	    if (timeout > 0) {
 		rcs_print_error("SHMEM: Timed out waiting for semaphore.\n");
@@ -514,7 +573,8 @@ CMS_STATUS SHMEM::main_access(void *_local)
 		    BufferName, timeout);
 	    }
 	    second_read = 0;
-	    return (status = CMS_TIMED_OUT);
+	    status = CMS_TIMED_OUT;
+	    return -1;
 	default:
 	    break;
 	}
@@ -523,37 +583,29 @@ CMS_STATUS SHMEM::main_access(void *_local)
     case NO_INTERRUPTS_MUTEX:
 	rcs_print_error("Interrupts can not be disabled.\n");
 	second_read = 0;
-	return (status = CMS_MISC_ERROR);
-	break;
+	status = CMS_MISC_ERROR;
+	return -1;
 
     case NO_SWITCHING_MUTEX:
 	rcs_print_error("Interrupts can not be disabled.\n");
-	return (status = CMS_MISC_ERROR);
-	break;
+	status = CMS_MISC_ERROR;
+	return -1;
 
     default:
 	rcs_print_error("SHMEM: Invalid mutex type.(%d)\n", mutex_type);
 	second_read = 0;
-	return (status = CMS_MISC_ERROR);
-	break;
-    }
-
-    if (second_read > 0 && enable_diagnostics) {
-	disable_diag_store = 1;
+	status = CMS_MISC_ERROR;
+	return -1;
     }
+    return 0;
+}
 
-    /* Perform access function. */
-    internal_access(shm->addr, size, _local);
-
-    disable_diag_store = 0;
-
-    if (NULL != bsem &&
-	(internal_access_type == CMS_WRITE_ACCESS
-	    || internal_access_type == CMS_WRITE_IF_READ_ACCESS)) {
-	bsem->flush();
-    }
+/* Release the lock taken by take_access(). */
+void SHMEM::release_access()
+{
     switch (mutex_type) {
     case NO_MUTEX:
+    case LOCK_FREE_MUTEX:
 	break;
 
     case MAO_MUTEX:
@@ -572,6 +624,266 @@ CMS_STATUS SHMEM::main_access(void *_local)
 	rcs_print_error("Can not restore interrupts.\n");
 	break;
     }
+}
+
+/* Called after a write has bumped the write count: if some reader is
+   blocked on it, wake them all. */
+void SHMEM::wake_readers()
+{
+    if (__atomic_load_n(&wake->waiters, __ATOMIC_SEQ_CST) > 0) {
+	syscall(SYS_futex, &wake->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/* Block until the write count differs from seq.  A negative timeout
+   waits forever.  Returns 0 on a write, -2 on timeout, -1 on error. */
+int SHMEM::wait_for_write(int seq, double timeout)
+{
+    double deadline = etime() + timeout;
+    int retval = 0;
+
+    __atomic_add_fetch(&wake->waiters, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&wake->seq, __ATOMIC_SEQ_CST) == seq) {
+	struct timespec ts, *tsp = NULL;
+	if (timeout >= 0) {
+	    double left = deadline - etime();
+	    if (left <= 0) {
+		retval = -2;
+		break;
+	    }
+	    ts.tv_sec = (time_t) left;
+	    ts.tv_nsec = (long) ((left - ts.tv_sec) * 1e9);
+	    tsp = &ts;
+	}
+	if (syscall(SYS_futex, &wake->seq, FUTEX_WAIT, seq, tsp, NULL, 0) < 0
+	    && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+	    rcs_print_error("SHMEM: futex wait on %s failed: %s\n",
+		BufferName, strerror(errno));
+	    retval = -1;
+	    break;
+	}
+    }
+    __atomic_sub_fetch(&wake->waiters, 1, __ATOMIC_SEQ_CST);
+    return retval;
+}
+
+/* MUTEX=LOCKFREE access.  The writer marks seq odd while it updates
+   the segment in place and never waits for anybody.  Readers copy the
+   segment into their snapshot, keeping the copy only if seq was even
+   and unchanged across it, and then do the CMS read on the snapshot so
+   nothing they do (was_read, diagnostics) touches shared memory.
+   Only one process may write. */
+CMS_STATUS SHMEM::lock_free_access(void *_local)
+{
+    switch (internal_access_type) {
+    case CMS_WRITE_ACCESS:
+    case CMS_CLEAR_ACCESS:
+	{
+	    int seq = __atomic_load_n(&wake->seq, __ATOMIC_RELAXED);
+	    __atomic_store_n(&wake->seq, seq + 1, __ATOMIC_RELAXED);
+	    __atomic_thread_fence(__ATOMIC_RELEASE);
+	    internal_access(shm->addr, size, _local);
+	    __atomic_store_n(&wake->seq, seq + 2, __ATOMIC_RELEASE);
+	    wake_readers();
+	}
+	return (status);
+
+    case CMS_READ_ACCESS:
+    case CMS_PEEK_ACCESS:
+    case CMS_CHECK_IF_READ_ACCESS:
+    case CMS_GET_MSG_COUNT_ACCESS:
+    case CMS_GET_DIAG_INFO_ACCESS:
+	break;
+
+    default:
+	rcs_print_error("SHMEM: %s is lock-free; access type %d is not supported.\n",
+	    BufferName, (int) internal_access_type);
+	return (status = CMS_NO_IMPLEMENTATION_ERROR);
+    }
+
+    double start = 0;
+    for (int tries = 0;; tries++) {
+	int seq = __atomic_load_n(&wake->seq, __ATOMIC_ACQUIRE);
+	if (seq == snapshot_seq) {
+	    break;		/* nothing written since the last copy */
+	}
+	if (!(seq & 1)) {
+	    memcpy(snapshot, shm->addr, size);
+	    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+	    if (__atomic_load_n(&wake->seq, __ATOMIC_RELAXED) == seq) {
+		snapshot_seq = seq;
+		break;
+	    }
+	}
+	/* raced with the writer: retry at once, then back off */
+	__atomic_add_fetch(&stats->retries, 1, __ATOMIC_RELAXED);
+	if (tries < 100) {
+	    continue;
+	}
+	if (tries == 100) {
+	    start = etime();
+	} else if (timeout >= 0 && etime() - start > timeout) {
+	    rcs_print_error("SHMEM: %s: timed out waiting for the writer.\n",
+		BufferName);
+	    return (status = CMS_TIMED_OUT);
+	}
+	esleep(sem_delay);
+    }
+    internal_access(snapshot, size, _local);
+    return (status);
+}
+
+/* Find this process a slot in stats->procs: the one it had, a free
+   one, or one left by a process that has gone. */
+void SHMEM::claim_stats_slot()
+{
+    int pid = getpid();
+
+    stats_proc = -1;
+    for (int i = 0; i < CMS_STATS_PROCS && stats_proc < 0; i++) {
+	struct CMS_STATS_PROC *proc = &stats->procs[i];
+	int old = __atomic_load_n(&proc->pid, __ATOMIC_ACQUIRE);
+	if (old == pid && !strncmp(proc->name, ProcessName,
+		sizeof(proc->name) - 1)) {
+	    stats_proc = i;
+	} else if (old == 0 || (kill(old, 0) < 0 && errno == ESRCH)) {
+	    if (__atomic_compare_exchange_n(&proc->pid, &old, pid, 0,
+		    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+		strncpy(proc->name, ProcessName, sizeof(proc->name) - 1);
+		proc->name[sizeof(proc->name) - 1] = 0;
+		proc->accesses = 0;
+		proc->last_access_time = 0;
+		stats_proc = i;
+	    }
+	}
+    }
+}
+
+/* Note how long take_access() waited for the lock. */
+void SHMEM::count_wait(double seconds)
+{
+    long long ns = (long long) (seconds * 1e9);
+    long long limit = 1000;
+    int bucket = 0;
+
+    while (ns >= limit && bucket < CMS_STATS_WAIT_BUCKETS - 1) {
+	limit *= 10;
+	bucket++;
+    }
+    __atomic_add_fetch(&stats->wait_histogram[bucket], 1, __ATOMIC_RELAXED);
+    long long max = __atomic_load_n(&stats->wait_max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&stats->wait_max_ns,
+	    &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/* Count the access main_access() just made. */
+void SHMEM::count_access()
+{
+    switch (internal_access_type) {
+    case CMS_READ_ACCESS:
+    case CMS_PEEK_ACCESS:
+	__atomic_add_fetch(&stats->reads, 1, __ATOMIC_RELAXED);
+	if (status == CMS_READ_OK) {
+	    __atomic_add_fetch(&stats->new_reads, 1, __ATOMIC_RELAXED);
+	    __atomic_add_fetch(&stats->bytes_read, header.in_buffer_size,
+		__ATOMIC_RELAXED);
+	}
+	break;
+
+    case CMS_WRITE_ACCESS:
+    case CMS_WRITE_IF_READ_ACCESS:
+	if (status == CMS_WRITE_OK) {
+	    __atomic_add_fetch(&stats->writes, 1, __ATOMIC_RELAXED);
+	    __atomic_add_fetch(&stats->bytes_written, header.in_buffer_size,
+		__ATOMIC_RELAXED);
+	} else if (status == CMS_QUEUE_FULL) {
+	    __atomic_add_fetch(&stats->queue_full, 1, __ATOMIC_RELAXED);
+	}
+	break;
+
+    default:
+	return;
+    }
+    if (stats_proc >= 0) {
+	struct CMS_STATS_PROC *proc = &stats->procs[stats_proc];
+	double now = etime();
+	__atomic_add_fetch(&proc->accesses, 1, __ATOMIC_RELAXED);
+	__atomic_store(&proc->last_access_time, &now, __ATOMIC_RELAXED);
+    }
+}
+
+const CMS_ACCESS_STATS *SHMEM::get_access_stats()
+{
+    return stats;
+}
+
+/* Access the shared memory buffer. */
+CMS_STATUS SHMEM::main_access(void *_local)
+{
+
+    /* Check pointers. */
+    if (shm == NULL || stats == NULL) {
+	second_read = 0;
+	return (status = CMS_MISC_ERROR);
+    }
+
+    if (bsem == NULL && wake == NULL && not_zero(blocking_timeout)) {
+	rcs_print_error
+	    ("No blocking semaphore available. Can not call blocking_read(%f).\n",
+	    blocking_timeout);
+	second_read = 0;
+	return (status = CMS_NO_BLOCKING_SEM_ERROR);
+    }
+
+    /* Sampled before looking at the buffer so that a write landing
+       between our read and the wait below is not missed. */
+    int wake_seq = 0;
+    if (NULL != wake) {
+	wake_seq = __atomic_load_n(&wake->seq, __ATOMIC_SEQ_CST);
+    }
+
+    if (mutex_type == LOCK_FREE_MUTEX) {
+	if (lock_free_access(_local) < 0) {
+	    second_read = 0;
+	    return (status);
+	}
+    } else {
+	double wait_start = etime_monotonic();
+	if (take_access() < 0) {
+	    if (status == CMS_TIMED_OUT) {
+		__atomic_add_fetch(&stats->lock_timeouts, 1, __ATOMIC_RELAXED);
+	    }
+	    return (status);
+	}
+	count_wait(etime_monotonic() - wait_start);
+
+	if (second_read > 0 && enable_diagnostics) {
+	    disable_diag_store = 1;
+	}
+
+	/* Perform access function. */
+	internal_access(shm->addr, size, _local);
+
+	disable_diag_store = 0;
+
+	if (NULL != bsem &&
+	    (internal_access_type == CMS_WRITE_ACCESS
+		|| internal_access_type == CMS_WRITE_IF_READ_ACCESS)) {
+	    bsem->flush();
+	}
+	int written = NULL != wake
+	    && (internal_access_type == CMS_WRITE_ACCESS
+	    || internal_access_type == CMS_WRITE_IF_READ_ACCESS);
+	if (written) {
+	    __atomic_add_fetch(&wake->seq, 1, __ATOMIC_SEQ_CST);
+	}
+	release_access();
+	if (written) {
+	    wake_readers();
+	}
+    }
+    count_access();
 
     switch (internal_access_type) {
 
@@ -586,6 +898,9 @@ CMS_STATUS SHMEM::main_access(void *_local)
 		second_read = 0;
 		return (status);
 	    }
+	    if (second_read > 0) {
+		__atomic_add_fetch(&stats->retries, 1, __ATOMIC_RELAXED);
+	    }
 	    second_read++;
 	    bsem->timeout = blocking_timeout;
 	    int bsem_ret = bsem->wait();
@@ -601,6 +916,32 @@ CMS_STATUS SHMEM::main_access(void *_local)
 		return (status);
 	    }
 	    main_access(_local);
+	} else if (NULL == bsem && NULL != wake && status == CMS_READ_OLD &&
+	    (blocking_timeout > 1e-6 || blocking_timeout < -1E-6)) {
+	    if (second_read > 10 && total_subdivisions <= 1) {
+		status = CMS_MISC_ERROR;
+		rcs_print_error
+		    ("CMS: Blocking read error. Woken %d times but there is still no new data.\n",
+		    second_read);
+		second_read = 0;
+		return (status);
+	    }
+	    if (second_read > 0) {
+		__atomic_add_fetch(&stats->retries, 1, __ATOMIC_RELAXED);
+	    }
+	    second_read++;
+	    int wait_ret = wait_for_write(wake_seq, blocking_timeout);
+	    if (wait_ret == -2) {
+		status = CMS_TIMED_OUT;
+		second_read = 0;
+		return (status);
+	    }
+	    if (wait_ret == -1) {
+		status = CMS_MISC_ERROR;
+		second_read = 0;
+		return (status);
+	    }
+	    main_access(_local);
 	}
 	break;
 
@@ -616,3 +957,50 @@ CMS_STATUS SHMEM::main_access(void *_local)
     second_read = 0;
     return (status);
 }
+
+/* Borrowed read: peek at the message in place instead of copying it into
+   the local buffer. On CMS_READ_OK *_data points into shared memory and
+   the buffer stays locked until release_borrow(); no other access may be
+   made through this object in between. */
+CMS_STATUS SHMEM::borrow(const void **_data)
+{
+    *_data = NULL;
+    if (shm == NULL) {
+	return (status = CMS_MISC_ERROR);
+    }
+    if (neutral || queuing_enabled || split_buffer
+	|| total_subdivisions > 1 || !read_permission_flag
+	|| mutex_type == LOCK_FREE_MUTEX) {
+	return (status = CMS_NO_IMPLEMENTATION_ERROR);
+    }
+    if (borrow_locked) {
+	rcs_print_error("SHMEM: %s is already borrowed.\n", BufferName);
+	return (status = CMS_MISC_ERROR);
+    }
+
+    internal_access_type = CMS_PEEK_ACCESS;
+    status = CMS_STATUS_NOT_SET;
+    blocking_timeout = 0;
+    if (take_access() < 0) {
+	return (status);
+    }
+    borrowed_data = NULL;
+    borrowing = 1;
+    internal_access(shm->addr, size, data);
+    borrowing = 0;
+    if (status == CMS_READ_OK && NULL != borrowed_data) {
+	borrow_locked = 1;
+	*_data = borrowed_data;
+	return (status);
+    }
+    release_access();
+    return (status);
+}
+
+void SHMEM::release_borrow()
+{
+    if (borrow_locked) {
+	borrow_locked = 0;
+	release_access();
+    }
+}
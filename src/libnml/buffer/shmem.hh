@@ -33,6 +33,16 @@ extern "C" {
 #include "cms.hh"		/* class CMS */
 #include "shm.hh"		/* class RCS_SHAREDMEM */
 #include "memsem.hh"		/* struct mem_access_object */
+#include "cmsdiag.hh"		/* struct CMS_ACCESS_STATS */
+
+/* Futex words kept in the shared segment after the buffer name: seq
+   changes on every write, waiters counts readers blocked on it so a
+   writer only makes the wake syscall when somebody is waiting.  With
+   MUTEX=LOCKFREE seq is odd while a write is in progress. */
+struct SHMEM_WAKE {
+    int seq;
+    int waiters;
+};
 
 class SHMEM:public CMS {
   public:
@@ -42,8 +52,20 @@ class SHMEM:public CMS {
     virtual ~ SHMEM();
 
     CMS_STATUS main_access(void *_local);
+    CMS_STATUS borrow(const void **_data);
+    void release_borrow();
+    const CMS_ACCESS_STATS *get_access_stats();
 
   private:
+    int take_access();
+    void release_access();
+    void wake_readers();
+    int wait_for_write(int seq, double timeout);
+    CMS_STATUS lock_free_access(void *_local);
+    void claim_stats_slot();
+    void count_wait(double seconds);
+    void count_access();
+    int borrow_locked;		/* buffer is locked by borrow() */
 
     /* data buffer stuff */
     int fast_mode;
@@ -66,7 +88,8 @@ class SHMEM:public CMS {
 	MAO_MUTEX_W_OS_SEM,
 	OS_SEM_MUTEX,
 	NO_INTERRUPTS_MUTEX,
-	NO_SWITCHING_MUTEX
+	NO_SWITCHING_MUTEX,
+	LOCK_FREE_MUTEX
     };
 
     int use_os_sem;
@@ -76,7 +99,12 @@ class SHMEM:public CMS {
     void *shm_addr_offset;
 
     RCS_SEMAPHORE *bsem;	// blocking semaphore
+    struct SHMEM_WAKE *wake;	// used for blocking reads without bsem
+    char *snapshot;		// LOCK_FREE_MUTEX: private copy readers use
+    int snapshot_seq;		// seq the snapshot was taken at
     int autokey_table_size;
+    struct CMS_ACCESS_STATS *stats;	// after the end of the segment
+    int stats_proc;		// our slot in stats->procs, or -1
 
 };
 
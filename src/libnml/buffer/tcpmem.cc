@@ -40,6 +40,7 @@ extern "C" {
 #include "sendn.h"		/* sendn() */
 #include "tcp_opts.hh"		/* SET_TCP_NODELAY */
 #include "linklist.hh"          /* LinkedList */
+#include "tcp_pack.hh"		/* tcp_unpack() */
 
 int tcpmem_sigpipe_count = 0;
 int last_sig = 0;
@@ -84,6 +85,13 @@ TCPMEM::TCPMEM(const char *_bufline, const char *_procline):CMS(_bufline, _procl
 	if (!strncmp(sub_info_string + 4, "none", 4)) {
 	    subscription_type = CMS_NO_SUBSCRIPTION;
 	} else if (!strncmp(sub_info_string + 4, "var", 3)) {
+	    /* sub=var[:min_interval] sends every change, but no more
+	       often than min_interval seconds. */
+	    poll_interval_millis = 0;
+	    if (sub_info_string[7] == ':') {
+		poll_interval_millis =
+		    ((int) (atof(sub_info_string + 8) * 1000.0));
+	    }
 	    subscription_type = CMS_VARIABLE_SUBSCRIPTION;
 	} else {
 	    poll_interval_millis =
@@ -94,6 +102,15 @@ TCPMEM::TCPMEM(const char *_bufline, const char *_procline):CMS(_bufline, _procl
     if (NULL != strstr(ProcessLine, "noreconnect")) {
 	autoreconnect = 0;
     }
+    /* delta asks the server to pack read replies against the last one
+       it sent, which mostly saves bandwidth on large status buffers. */
+    delta = (NULL != strstr(ProcessLine, "delta"));
+    delta_on = 0;
+    reply_packed = 0;
+    delta_wire = NULL;
+    delta_base = NULL;
+    delta_base_size = 0;
+    delta_base_id = 0;
     server_host_entry = NULL;
 
     /* Set up the socket address stucture. */
@@ -192,7 +209,7 @@ void
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) diag_info_buf + 1)), buffer_number);
+	getbe32(diag_info_buf + 4), buffer_number);
     reenable_sigpipe();
 
 }
@@ -207,8 +224,8 @@ void TCPMEM::verify_bufname()
     set_socket_fds(read_socket_fd);
 
     putbe32(temp_buffer, (uint32_t) serial_number);
-    putbe32(temp_buffer + 1, REMOTE_CMS_GET_BUF_NAME_REQUEST_TYPE);
-    putbe32(temp_buffer + 2, buffer_number);
+    putbe32(temp_buffer + 4, REMOTE_CMS_GET_BUF_NAME_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, buffer_number);
     if (sendn(socket_fd, temp_buffer, 20, 0, timeout) < 0) {
 	reconnect_needed = 1;
 	fatal_error_occurred = 1;
@@ -220,7 +237,7 @@ void TCPMEM::verify_bufname()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 40, 0, timeout, &recvd_bytes) < 0) {
 	if (recvn_timedout) {
 	    bytes_to_throw_away = 40;
@@ -241,7 +258,7 @@ void TCPMEM::verify_bufname()
 	status = CMS_MISC_ERROR;
 	return;
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
     if (status < 0) {
 	return;
     }
@@ -288,7 +305,7 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 32, 0, -1.0, &recvd_bytes) < 0) {
 	if (recvn_timedout) {
 	    bytes_to_throw_away = 32;
@@ -310,7 +327,7 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	status = CMS_MISC_ERROR;
 	return (NULL);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
     if (status < 0) {
 	return (NULL);
     }
@@ -322,14 +339,14 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
     }
     di->last_writer_dpi = NULL;
     di->last_reader_dpi = NULL;
-    di->last_writer = ntohl(*((u_long *) temp_buffer + 2));
-    di->last_reader = ntohl(*((u_long *) temp_buffer + 3));
+    di->last_writer = getbe32(temp_buffer + 8);
+    di->last_reader = getbe32(temp_buffer + 12);
     double server_time;
     memcpy(&server_time, temp_buffer + 16, 8);
     double local_time = etime();
     double diff_time = local_time - server_time;
-    int dpi_count = ntohl(*((u_long *) temp_buffer + 6));
-    int dpi_max_size = ntohl(*((u_long *) temp_buffer + 7));
+    int dpi_count = getbe32(temp_buffer + 24);
+    int dpi_max_size = getbe32(temp_buffer + 28);
     if (dpi_max_size > 32 && dpi_max_size < 0x2000) {
 	if (recvn
 	    (socket_fd, temp_buffer + 32, dpi_max_size - 32, 0, -1.0,
@@ -349,27 +366,27 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	    memcpy(cms_dpi.host_sysinfo, temp_buffer + dpi_offset, 32);
 	    dpi_offset += 32;
 	    cms_dpi.pid =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    memcpy(&(cms_dpi.rcslib_ver), temp_buffer + dpi_offset, 8);
 	    dpi_offset += 8;
 	    cms_dpi.access_type = (CMS_INTERNAL_ACCESS_TYPE)
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_id =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_size =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_type =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.number_of_accesses =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.number_of_new_messages =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    memcpy(&(cms_dpi.bytes_moved), temp_buffer + dpi_offset, 8);
 	    dpi_offset += 8;
@@ -392,14 +409,14 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	    dpi_offset += 8;
 	    di->dpis->store_at_tail(&cms_dpi, sizeof(CMS_DIAG_PROC_INFO), 1);
 	    int is_last_writer =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    if (is_last_writer) {
 		di->last_writer_dpi =
 		    (CMS_DIAG_PROC_INFO *) di->dpis->get_tail();
 	    }
 	    int is_last_reader =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    if (is_last_reader) {
 		di->last_reader_dpi =
@@ -460,14 +477,14 @@ void TCPMEM::reconnect()
 	if (EINPROGRESS == errno) {
 
 	    tm.tv_sec = (long) timeout;
-	    tm.tv_sec = (long) (fmod(timeout, 1.0) * 1e6);
+	    tm.tv_usec = (long) (fmod(timeout, 1.0) * 1e6);
 	    FD_ZERO(&fds);
 	    FD_SET(socket_fd, &fds);
 	    start_time = etime();
 	    while (!(socket_ret = select(socket_fd + 1,
-			(fd_set *) NULL, &fds, (fd_set *) NULL, &tm))) {
+			(fd_set *) NULL, &fds, (fd_set *) NULL,
+			timeout >= 0.0 ? &tm : (timeval *) NULL))) {
 		FD_SET(socket_fd, &fds);
-		esleep(0.001);
 		current_time = etime();
 		double timeleft = start_time + timeout - current_time;
 		if (timeleft <= 0.0 && timeout >= 0.0) {
@@ -479,7 +496,7 @@ void TCPMEM::reconnect()
 		    return;
 		}
 		tm.tv_sec = (long) timeleft;
-		tm.tv_sec = (long) (fmod(timeleft, 1.0) * 1e6);
+		tm.tv_usec = (long) (fmod(timeleft, 1.0) * 1e6);
 	    }
 
 	    if (-1 == socket_ret) {
@@ -508,6 +525,13 @@ void TCPMEM::reconnect()
 	subscription_type = CMS_NO_SUBSCRIPTION;
     }
 
+    delta_on = 0;
+    delta_base_size = 0;
+    delta_base_id = 0;
+    if (delta && total_subdivisions <= 1) {
+	set_delta();
+    }
+
     if (subscription_type != CMS_NO_SUBSCRIPTION) {
 	verify_bufname();
 	if (status < 0) {
@@ -527,7 +551,7 @@ void TCPMEM::reconnect()
 	    rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 		"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 		socket_fd, serial_number,
-		ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+		getbe32(temp_buffer + 4), buffer_number);
 	    memset(temp_buffer, 0, 20);
 	    recvd_bytes = 0;
 	    if (recvn(socket_fd, temp_buffer, 8, 0, 30, &recvd_bytes) < 0) {
@@ -582,11 +606,11 @@ void TCPMEM::reconnect()
 		FD_SET(write_socket_fd, &fds);
 		start_time = etime();
 		tm.tv_sec = (long) timeout;
-		tm.tv_sec = (long) (fmod(timeout, 1.0) * 1e6);
+		tm.tv_usec = (long) (fmod(timeout, 1.0) * 1e6);
 		while (!(socket_ret = select(write_socket_fd + 1,
-			    (fd_set *) NULL, &fds, (fd_set *) NULL, &tm))) {
+			    (fd_set *) NULL, &fds, (fd_set *) NULL,
+			    timeout >= 0.0 ? &tm : (timeval *) NULL))) {
 		    FD_SET(write_socket_fd, &fds);
-		    esleep(0.001);
 		    current_time = etime();
 		    double timeleft = start_time + timeout - current_time;
 		    if (timeleft <= 0.0 && timeout >= 0.0) {
@@ -596,7 +620,7 @@ void TCPMEM::reconnect()
 			return;
 		    }
 		    tm.tv_sec = (long) timeleft;
-		    tm.tv_sec = (long) (fmod(timeleft, 1.0) * 1e6);
+		    tm.tv_usec = (long) (fmod(timeleft, 1.0) * 1e6);
 		}
 		if (-1 == socket_ret) {
 		    rcs_print_error("select error: %d -- %s\n", errno,
@@ -622,9 +646,101 @@ void TCPMEM::reconnect()
 
 }
 
+/* A server too old to know the request never answers it, so the
+   reply is only waited for briefly, and delta stays off without it. */
+void TCPMEM::set_delta()
+{
+    if (NULL == delta_wire) {
+	delta_wire = (char *) malloc(max_encoded_message_size);
+	delta_base = (char *) malloc(max_encoded_message_size);
+	if (NULL == delta_wire || NULL == delta_base) {
+	    rcs_print_error("TCPMEM: Can't malloc %ld bytes for delta.\n",
+		max_encoded_message_size);
+	    return;
+	}
+    }
+    putbe32(temp_buffer, (uint32_t) serial_number);
+    putbe32(temp_buffer + 4, REMOTE_CMS_SET_DELTA_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, (uint32_t) buffer_number);
+    putbe32(temp_buffer + 12, 1);
+    putbe32(temp_buffer + 16, 0);
+    if (sendn(socket_fd, temp_buffer, 20, 0, 30) < 0) {
+	rcs_print_error("Can`t set up delta replies.\n");
+	return;
+    }
+    serial_number++;
+    rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
+	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
+	socket_fd, serial_number, getbe32(temp_buffer + 4), buffer_number);
+    memset(temp_buffer, 0, 20);
+    recvd_bytes = 0;
+    if (recvn(socket_fd, temp_buffer, 8, 0, 2.0, &recvd_bytes) < 0) {
+	rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	    "TCPMEM: server does not do delta replies.\n");
+    } else if (getbe32(temp_buffer + 4)) {
+	delta_on = 1;
+    }
+    recvd_bytes = 0;
+    memset(temp_buffer, 0, 20);
+}
+
+/* Takes the size from a read reply header, noting whether the data
+   that follows is packed. */
+long TCPMEM::reply_size(long size_field)
+{
+    reply_packed = delta_on && (size_field & TCP_PACKED_SIZE_FLAG);
+    if (reply_packed) {
+	return size_field & ~TCP_PACKED_SIZE_FLAG;
+    }
+    return size_field;
+}
+
+char *TCPMEM::reply_buffer()
+{
+    return reply_packed ? delta_wire : (char *) encoded_data;
+}
+
+/* Called once the size bytes of a read reply with the given id are in.
+   Unpacks it into encoded_data if it came packed, and keeps it as the
+   base for the next one.  Returns the id to check, 0 if the reply was
+   packed against a base this end no longer has, or -1 if it was bad. */
+long TCPMEM::unpack_reply(long size, long id)
+{
+    if (!delta_on || size <= 0) {
+	return id;
+    }
+    if (reply_packed) {
+	unsigned long base_id = tcp_packed_base_id(delta_wire, size);
+	if (base_id != 0 && base_id != delta_base_id) {
+	    delta_base_id = 0;
+	    return 0;
+	}
+	size = tcp_unpack(delta_wire, size, base_id ? delta_base : NULL,
+	    base_id ? delta_base_size : 0, (char *) encoded_data,
+	    max_encoded_message_size);
+	if (size < 0) {
+	    rcs_print_error("TCPMEM: Received a bad packed reply.\n");
+	    delta_base_id = 0;
+	    return -1;
+	}
+    }
+    memcpy(delta_base, encoded_data, size);
+    delta_base_size = size;
+    delta_base_id = id;
+    return id;
+}
+
 TCPMEM::~TCPMEM()
 {
     disconnect();
+    if (NULL != delta_wire) {
+	free(delta_wire);
+	delta_wire = NULL;
+    }
+    if (NULL != delta_base) {
+	free(delta_base);
+	delta_base = NULL;
+    }
 }
 
 void TCPMEM::disconnect()
@@ -706,11 +822,11 @@ CMS_STATUS TCPMEM::handle_old_replies()
 		    serial_number = returned_serial_number;
 		}
 	    }
-	    message_size = ntohl(*((u_long *) temp_buffer + 2));
+	    message_size = reply_size(getbe32(temp_buffer + 8));
 	    timedout_request_status =
-		(CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	    timedout_request_writeid = ntohl(*((u_long *) temp_buffer + 3));
-	    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+		(CMS_STATUS) getbe32(temp_buffer + 4);
+	    timedout_request_writeid = getbe32(temp_buffer + 12);
+	    header.was_read = getbe32(temp_buffer + 16);
 	    if (message_size > max_encoded_message_size) {
 		rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 		    message_size, max_encoded_message_size);
@@ -723,7 +839,7 @@ CMS_STATUS TCPMEM::handle_old_replies()
 	}
 	if (message_size > 0) {
 	    if (recvn
-		(socket_fd, encoded_data, message_size, 0, timeout,
+		(socket_fd, reply_buffer(), message_size, 0, timeout,
 		    &recvd_bytes) < 0) {
 		if (recvn_timedout) {
 		    if (!waiting_for_message) {
@@ -757,6 +873,14 @@ CMS_STATUS TCPMEM::handle_old_replies()
 	    if (waiting_for_message) {
 		timedout_request_writeid = waiting_message_id;
 	    }
+	    long unpacked_id =
+		unpack_reply(message_size, timedout_request_writeid);
+	    if (unpacked_id < 0) {
+		fatal_error_occurred = 1;
+		reconnect_needed = 1;
+		return (status = CMS_MISC_ERROR);
+	    }
+	    timedout_request_writeid = unpacked_id;
 	}
 	break;
 
@@ -955,7 +1079,7 @@ CMS_STATUS TCPMEM::read()
 
     int send_header_size = 20;
     if (total_subdivisions > 1) {
-	*((u_long *) temp_buffer + 5) = htonl((u_long) current_subdivision);
+	putbe32(temp_buffer + 20, current_subdivision);
 	send_header_size = 24;
     }
     if (sendn(socket_fd, temp_buffer, send_header_size, 0, timeout) < 0) {
@@ -969,7 +1093,7 @@ CMS_STATUS TCPMEM::read()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
 
     if (recvn(socket_fd, temp_buffer, 20, 0, timeout, &recvd_bytes) < 20) {
 	if (recvn_timedout) {
@@ -1006,10 +1130,10 @@ CMS_STATUS TCPMEM::read()
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = reply_size(getbe32(temp_buffer + 8));
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 	    message_size, max_encoded_message_size);
@@ -1020,7 +1144,7 @@ CMS_STATUS TCPMEM::read()
     }
     if (message_size > 0) {
 	if (recvn
-	    (socket_fd, encoded_data, message_size, 0, timeout,
+	    (socket_fd, reply_buffer(), message_size, 0, timeout,
 		&recvd_bytes) < 0) {
 	    if (recvn_timedout) {
 		if (!waiting_for_message) {
@@ -1046,6 +1170,13 @@ CMS_STATUS TCPMEM::read()
 	}
     }
     recvd_bytes = 0;
+    id = unpack_reply(message_size, id);
+    if (id < 0) {
+	fatal_error_occurred = 1;
+	reconnect_needed = 1;
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1170,7 +1301,7 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	"TCPMEM sending request: fd = %d, serial_number=%ld, "
 	"request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 20, 0, blocking_timeout, &recvd_bytes) <
 	0) {
 	print_recvn_timeout_errors = orig_print_recvn_timeout_errors;
@@ -1209,10 +1340,10 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = reply_size(getbe32(temp_buffer + 8));
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 	    message_size, max_encoded_message_size);
@@ -1223,7 +1354,7 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
     }
     if (message_size > 0) {
 	if (recvn
-	    (socket_fd, encoded_data, message_size, 0, blocking_timeout,
+	    (socket_fd, reply_buffer(), message_size, 0, blocking_timeout,
 		&recvd_bytes) < 0) {
 	    if (recvn_timedout) {
 		if (!waiting_for_message) {
@@ -1249,6 +1380,13 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	}
     }
     recvd_bytes = 0;
+    id = unpack_reply(message_size, id);
+    if (id < 0) {
+	fatal_error_occurred = 1;
+	reconnect_needed = 1;
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1350,7 +1488,7 @@ CMS_STATUS TCPMEM::peek()
     putbe32(temp_buffer + 16, (uint32_t) in_buffer_id);
     int send_header_size = 20;
     if (total_subdivisions > 1) {
-	*((u_long *) temp_buffer + 20) = htonl((u_long) current_subdivision);
+	putbe32(temp_buffer + 20, (uint32_t) current_subdivision);
 	send_header_size = 24;
     }
     if (sendn(socket_fd, temp_buffer, send_header_size, 0, timeout) < 0) {
@@ -1395,10 +1533,10 @@ CMS_STATUS TCPMEM::peek()
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = reply_size(getbe32(temp_buffer + 8));
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	reconnect_needed = 1;
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
@@ -1408,7 +1546,7 @@ CMS_STATUS TCPMEM::peek()
     }
     if (message_size > 0) {
 	if (recvn
-	    (socket_fd, encoded_data, message_size, 0, timeout,
+	    (socket_fd, reply_buffer(), message_size, 0, timeout,
 		&recvd_bytes) < 0) {
 	    if (recvn_timedout) {
 		if (!waiting_for_message) {
@@ -1434,6 +1572,13 @@ CMS_STATUS TCPMEM::peek()
 	}
     }
     recvd_bytes = 0;
+    id = unpack_reply(message_size, id);
+    if (id < 0) {
+	fatal_error_occurred = 1;
+	reconnect_needed = 1;
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1554,8 +1699,8 @@ CMS_STATUS TCPMEM::write(void *user_data)
 		return (status = CMS_MISC_ERROR);
 	    }
 	}
-	status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+	status = (CMS_STATUS) getbe32(temp_buffer + 4);
+	header.was_read = getbe32(temp_buffer + 8);
     } else {
 	header.was_read = 0;
 	status = CMS_WRITE_OK;
@@ -1673,8 +1818,8 @@ CMS_STATUS TCPMEM::write_if_read(void *user_data)
 		return (status = CMS_MISC_ERROR);
 	    }
 	}
-	status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+	status = (CMS_STATUS) getbe32(temp_buffer + 4);
+	header.was_read = getbe32(temp_buffer + 8);
     } else {
 	header.was_read = 0;
 	status = CMS_WRITE_OK;
@@ -1758,8 +1903,8 @@ int TCPMEM::check_if_read()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.was_read = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (header.was_read);
 }
@@ -1838,8 +1983,8 @@ int TCPMEM::get_queue_length()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    queuing_header.queue_length = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    queuing_header.queue_length = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (queuing_header.queue_length);
 }
@@ -1918,8 +2063,8 @@ int TCPMEM::get_msg_count()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.write_id = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.write_id = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (header.write_id);
 }
@@ -1998,8 +2143,8 @@ int TCPMEM::get_space_available()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    free_space = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    free_space = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (free_space);
 }
@@ -2065,8 +2210,8 @@ CMS_STATUS TCPMEM::clear()
 	reconnect_needed = 1;
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.was_read = getbe32(temp_buffer + 8);
     return (status);
 }
 /*! \todo Another #if 0 */
@@ -2093,10 +2238,9 @@ int TCPMEM::login(const char *name, const char *passwd)
 	return 0;
     }
     set_socket_fds(write_socket_fd);
-    *((u_long *) temp_buffer) = htonl((u_long) serial_number);
-    *((u_long *) temp_buffer + 1) =
-	htonl((u_long) REMOTE_CMS_GET_KEYS_REQUEST_TYPE);
-    *((u_long *) temp_buffer + 2) = htonl((u_long) buffer_number);
+    putbe32(temp_buffer, serial_number);
+    putbe32(temp_buffer + 4, REMOTE_CMS_GET_KEYS_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, buffer_number);
     if (sendn(socket_fd, temp_buffer, 20, 0, 30.0) < 0) {
 	return 0;
     }
@@ -2135,10 +2279,9 @@ int TCPMEM::login(const char *name, const char *passwd)
     char passwd_pass2[16];
     strncpy(passwd_pass2, crypt2_ret, 16);
 
-    *((u_long *) temp_buffer) = htonl((u_long) serial_number);
-    *((u_long *) temp_buffer + 1) =
-	htonl((u_long) REMOTE_CMS_LOGIN_REQUEST_TYPE);
-    *((u_long *) temp_buffer + 2) = htonl((u_long) buffer_number);
+    putbe32(temp_buffer, serial_number);
+    putbe32(temp_buffer + 4, REMOTE_CMS_LOGIN_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, buffer_number);
     if (sendn(socket_fd, temp_buffer, 20, 0, 30.0) < 0) {
 	return 0;
     }
@@ -2165,7 +2308,7 @@ int TCPMEM::login(const char *name, const char *passwd)
 	    returned_serial_number, serial_number);
 	return (status = CMS_MISC_ERROR);
     }
-    int success = ntohl(*((u_long *) temp_buffer + 1));
+    int success = getbe32(temp_buffer + 4);
     return (success);
 }
 #endif
@@ -81,6 +81,17 @@ class TCPMEM:public CMS {
     void reenable_sigpipe();
     void verify_bufname();
     int subscription_count;
+    void set_delta();
+    long reply_size(long size_field);
+    char *reply_buffer();
+    long unpack_reply(long size, long id);
+    int delta;
+    int delta_on;
+    int reply_packed;
+    char *delta_wire;
+    char *delta_base;
+    long delta_base_size;
+    unsigned long delta_base_id;
 };
 
 #endif
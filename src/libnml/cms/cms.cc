@@ -37,6 +37,7 @@ extern "C" {
 #include "cms_xup.hh"		/* class CMS_XDR_UPDATER */
 #include "cms_aup.hh"		/* class CMS_ASCII_UPDATER */
 #include "cms_dup.hh"		/* class CMS_DISPLAY_ASCII_UPDATER */
+#include "cms_pup.hh"		/* class CMS_PACKED_UPDATER */
 #include "rcs_print.hh"		/* rcs_print_error(), separate_words() */
 				/* rcs_print_debug() */
 #include "cmsdiag.hh"
@@ -137,6 +138,12 @@ CMS::CMS(long s)
     last_im = CMS_NOT_A_MODE;
     min_compatible_version = 0;
     confirm_write = 0;
+    server_threads = 0;
+    mcast_group[0] = 0;
+    mcast_port = 0;
+    mcast_interval = 0.1;
+    mcast_keyframe = 1.0;
+    process_local = 0;
     disable_final_write_raw_for_dma = 0;
     subdiv_data = 0;
     enable_diagnostics = 0;
@@ -194,6 +201,12 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
     min_compatible_version = 0;
     force_raw = 0;
     confirm_write = 0;
+    server_threads = 0;
+    mcast_group[0] = 0;
+    mcast_port = 0;
+    mcast_interval = 0.1;
+    mcast_keyframe = 1.0;
+    process_local = 0;
     disable_final_write_raw_for_dma = 0;
     /* Init string buffers */
     memset(BufferName, 0, CMS_CONFIG_LINELEN);
@@ -378,6 +391,10 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
 	    neutral_encoding_method = CMS_XDR_ENCODING;
 	    continue;
 	}
+	if (!strcmp(word[i], "PACKED")) {
+	    neutral_encoding_method = CMS_PACKED_ENCODING;
+	    continue;
+	}
 
 	char *port_string;
 	if (NULL != (port_string = strstr(word[i], "STCP="))) {
@@ -422,6 +439,40 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
 	    confirm_write = 1;
 	    continue;
 	}
+
+	char *threads_string;
+	if (NULL != (threads_string = strstr(word[i], "SERVER_THREADS="))) {
+	    server_threads = strtol(threads_string + 15, (char **) NULL, 0);
+	    continue;
+	}
+
+	/* MCAST=239.192.0.1:5006 */
+	char *mcast_string;
+	if (NULL != (mcast_string = strstr(word[i], "MCAST="))) {
+	    mcast_string += 6;
+	    char *colon = strchr(mcast_string, ':');
+	    if (NULL == colon || colon - mcast_string >=
+		(long) sizeof(mcast_group)) {
+		rcs_print_error("CMS: %s is not MCAST=group:port\n", word[i]);
+		continue;
+	    }
+	    memcpy(mcast_group, mcast_string, colon - mcast_string);
+	    mcast_group[colon - mcast_string] = 0;
+	    mcast_port = (int) strtol(colon + 1, (char **) NULL, 0);
+	    continue;
+	}
+	if (NULL != (mcast_string = strstr(word[i], "MCAST_INTERVAL="))) {
+	    mcast_interval = strtod(mcast_string + 15, (char **) NULL);
+	    continue;
+	}
+	if (NULL != (mcast_string = strstr(word[i], "MCAST_KEYFRAME="))) {
+	    mcast_keyframe = strtod(mcast_string + 15, (char **) NULL);
+	    continue;
+	}
+	if (!strcmp(word[i], "PROCESS_LOCAL")) {
+	    process_local = 1;
+	    continue;
+	}
 	if (!strcmp(word[i], "FORCE_RAW")) {
 	    force_raw = 1;
 	    continue;
@@ -617,6 +668,8 @@ void CMS::open(void)
     /* free successfully allocated memory. */
     data = NULL;
     subdiv_data = NULL;
+    borrowing = 0;
+    borrowed_data = NULL;
     encoded_data = NULL;
     encoded_header = NULL;
     encoded_queuing_header = NULL;
@@ -673,6 +726,10 @@ void CMS::open(void)
 	    updater = new CMS_DISPLAY_ASCII_UPDATER(this);
 	    break;
 
+	case CMS_PACKED_ENCODING:
+	    updater = new CMS_PACKED_UPDATER(this);
+	    break;
+
 	default:
 	    updater = (CMS_UPDATER *) NULL;
 	    status = CMS_UPDATE_ERROR;
@@ -1027,6 +1084,19 @@ CMS_STATUS CMS::peek()
     return (status);
 }
 
+/* Only buffers that live in this process's address space can lend out
+   their message; everything else reports CMS_NO_IMPLEMENTATION_ERROR so
+   the caller can fall back to peek(). */
+CMS_STATUS CMS::borrow(const void **_data)
+{
+    *_data = NULL;
+    return (status = CMS_NO_IMPLEMENTATION_ERROR);
+}
+
+void CMS::release_borrow()
+{
+}
+
 CMS_STATUS CMS::write(void *user_data)
 {
     internal_access_type = CMS_WRITE_ACCESS;
@@ -1117,6 +1187,10 @@ void CMS::set_temp_updater(CMS_NEUTRAL_ENCODING_METHOD temp_encoding_method)
 	    temp_updater = new CMS_DISPLAY_ASCII_UPDATER(this);
 	    break;
 
+	case CMS_PACKED_ENCODING:
+	    temp_updater = new CMS_PACKED_UPDATER(this);
+	    break;
+
 	default:
 	    temp_updater = (CMS_UPDATER *) NULL;
 	    status = CMS_UPDATE_ERROR;
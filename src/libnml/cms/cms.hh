@@ -150,6 +150,7 @@ struct CMS_HEADER {
 class CMS_DIAG_PROC_INFO;
 class CMS_DIAG_HEADER;
 class CMS_DIAGNOSTICS_INFO;
+struct CMS_ACCESS_STATS;
 
 struct CMS_QUEUING_HEADER {
     long head;
@@ -163,7 +164,8 @@ enum CMS_NEUTRAL_ENCODING_METHOD {
     CMS_NO_ENCODING,
     CMS_XDR_ENCODING,
     CMS_ASCII_ENCODING,
-    CMS_DISPLAY_ASCII_ENCODING
+    CMS_DISPLAY_ASCII_ENCODING,
+    CMS_PACKED_ENCODING
 };
 
 /* CMS class declaration. */
@@ -200,6 +202,8 @@ class CMS {
     virtual void disconnect();
     virtual int get_queue_length();
     virtual int get_space_available();
+    virtual CMS_STATUS borrow(const void **_data);	/* Peek in place. */
+    virtual void release_borrow();	/* End a borrow(). */
 
     /* Protocol Defined Virtual Function Stubs. */
     virtual CMS_STATUS main_access(void *_local);
@@ -349,6 +353,8 @@ class CMS {
     void set_encoded_data(void *, long _encoded_data_size);
     void *data;			/* pointer to local copy of data (raw) */
     void *subdiv_data;		/* pointer to current subdiv; */
+    int borrowing;		/* peek_raw() should not copy the message */
+    void *borrowed_data;	/* message in the global buffer, if borrowing */
 
     /* Intersting Info Saved from the Configuration File. */
     char BufferName[CMS_CONFIG_LINELEN];
@@ -442,6 +448,13 @@ class CMS {
     double blocking_timeout;
     double min_compatible_version;
     int confirm_write;
+    int server_threads;		/* TCP server workers, 0 for none */
+    char mcast_group[32];	/* MCAST= group for the TCP server to publish
+				   to, "" for none, see mcast.hh */
+    int mcast_port;
+    double mcast_interval;	/* seconds between checks for a change */
+    double mcast_keyframe;	/* seconds between unpacked messages */
+    int process_local;		/* every user is in this process */
     int disable_final_write_raw_for_dma;
     virtual const char *status_string(int);
 
@@ -462,6 +475,7 @@ class CMS {
 	void *);
     CMS_DIAGNOSTICS_INFO *di;
     virtual CMS_DIAGNOSTICS_INFO *get_diagnostics_info();
+    virtual const CMS_ACCESS_STATS *get_access_stats();
     int first_diag_store;
     double pre_op_total_bytes_moved;
     double time_bias;
@@ -31,6 +31,7 @@ extern "C" {
 #include <stdlib.h>		/* strtol(), strtoul(), strtod() */
 #include <stdio.h>		/* sprintf() */
 #include <ctype.h>		/* isspace() */
+#include <math.h>		/* signbit() */
 
 #ifdef __cplusplus
 }
@@ -38,6 +39,10 @@ extern "C" {
 #include "cms.hh"		/* class CMS */
 #include "cms_aup.hh"		/* class CMS_ASCII_UPDATER */
 #include "rcs_print.hh"		/* rcs_print_error() */
+
+/* What sprintf("%-13.7e") gives for 0.0, which fills most of the large
+   arrays in status messages. */
+static const char ascii_zero[] = "0.0000000e+00";
 #define DEFAULT_WARNING_COUNT_MAX 100
 /* Member functions for CMS_ASCII_UPDATER Class */
 
@@ -687,7 +692,11 @@ CMS_STATUS CMS_ASCII_UPDATER::update(float &x)
 
     if (encoding) {
 	end_current_string[15] = 0;
-	sprintf(end_current_string, "%-13.7e", x);
+	if (x == 0.0 && !signbit(x)) {
+	    memcpy(end_current_string, ascii_zero, sizeof(ascii_zero));
+	} else {
+	    sprintf(end_current_string, "%-13.7e", x);
+	}
 	if (end_current_string[15] != 0 && warning_count < warning_count_max) {
 	    warning_count++;
 	    rcs_print_error
@@ -749,7 +758,11 @@ CMS_STATUS CMS_ASCII_UPDATER::update(double &x)
 
     if (encoding) {
 	end_current_string[15] = 0;
-	sprintf(end_current_string, "%-13.7e", x);
+	if (x == 0.0 && !signbit(x)) {
+	    memcpy(end_current_string, ascii_zero, sizeof(ascii_zero));
+	} else {
+	    sprintf(end_current_string, "%-13.7e", x);
+	}
 	if (end_current_string[15] != 0 && warning_count < warning_count_max) {
 	    warning_count++;
 	    rcs_print_error
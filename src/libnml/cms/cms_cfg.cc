@@ -29,6 +29,7 @@ extern "C" {
 #include <netdb.h>
 #include <arpa/inet.h>		/* inet_ntoa */
 #include <stdlib.h>
+#include <sys/stat.h>		/* stat() */
 
 #ifdef __cplusplus
 }
@@ -41,6 +42,7 @@ extern "C" {
     and can handle larger messages than UDP and is more widely available than 
     RPC. */
 #include "tcpmem.hh"		/* class TCPMEM */
+#include "mcastmem.hh"		/* class MCASTMEM */
 
  /* If the buffer type or process type specified in the configuration file is 
     "PHANTOM" then every NML call of that type will result in calling your
@@ -66,9 +68,21 @@ extern "C" {
 #include "rcs_print.hh"		/* rcs_print_error() */
 #include "linklist.hh"		/* LinkedList */
 
+#include <map>
+#include <string>
+
+/* A B or P line of a loaded config file, and its position among the
+   stored lines. */
+struct CONFIG_LINE {
+    const char *line;
+    int number;
+};
+
 struct CONFIG_FILE_INFO {
     CONFIG_FILE_INFO() {
 	lines_list = NULL;
+	mtime = 0;
+	fsize = 0;
     };
 
     ~CONFIG_FILE_INFO() {
@@ -80,11 +94,49 @@ struct CONFIG_FILE_INFO {
 
     LinkedList *lines_list;
     char file_name[80];
+    time_t mtime;		/* of the file when it was loaded */
+    off_t fsize;
+
+    /* First B line for each buffer name, first P line for each
+       "process buffer" pair, pointing into lines_list. */
+    std::map < std::string, CONFIG_LINE > buffers;
+    std::map < std::string, CONFIG_LINE > procs;
 };
 
 static LinkedList *config_file_list = NULL;
 static int loading_config_file = 0;
 
+static std::string proc_key(const char *procname, const char *bufname)
+{
+    return std::string(procname) + ' ' + bufname;
+}
+
+static void index_config_file(CONFIG_FILE_INFO * info)
+{
+    char *word[4];
+    int number = 0;
+
+    for (char *line = (char *) info->lines_list->get_head(); NULL != line;
+	line = (char *) info->lines_list->get_next()) {
+	number++;
+	if (line[0] == CMS_CONFIG_COMMENTCHAR ||
+	    strchr(" \t\n\r", line[0]) != NULL) {
+	    continue;
+	}
+	if (separate_words(word, 4, line) != 4) {
+	    continue;
+	}
+	CONFIG_LINE entry = { line, number };
+	/* insert() keeps the first line, as the file scan does */
+	if (line[0] == 'B') {
+	    info->buffers.insert(std::make_pair(std::string(word[1]), entry));
+	} else if (line[0] == 'P') {
+	    info->procs.insert(std::make_pair(proc_key(word[1], word[2]),
+		    entry));
+	}
+    }
+}
+
 int load_nml_config_file(const char *file)
 {
     unload_nml_config_file(file);
@@ -146,9 +198,15 @@ int load_nml_config_file(const char *file)
     }
 
     if (NULL != fp) {
+	struct stat st;
+	if (fstat(fileno(fp), &st) == 0) {
+	    info->mtime = st.st_mtime;
+	    info->fsize = st.st_size;
+	}
 	fclose(fp);
 	fp = NULL;
     }
+    index_config_file(info);
     config_file_list->store_at_tail(info, sizeof(info), 0);
     loading_config_file = 0;
     return 0;
@@ -197,6 +255,29 @@ CONFIG_FILE_INFO *get_loaded_nml_config_file(const char *file)
     return NULL;
 }
 
+/* Like get_loaded_nml_config_file(), but (re)loads the file if it is not
+   loaded yet or has changed since, so each process reads and indexes
+   its config file once however many channels it opens. */
+static CONFIG_FILE_INFO *get_indexed_nml_config_file(const char *file)
+{
+    CONFIG_FILE_INFO *info = get_loaded_nml_config_file(file);
+    struct stat st;
+
+    if (loading_config_file) {
+	return info;
+    }
+    if (NULL != info) {
+	if (stat(file, &st) != 0 ||
+	    (st.st_mtime == info->mtime && st.st_size == info->fsize)) {
+	    return info;
+	}
+    }
+    if (load_nml_config_file(file) < 0) {
+	return NULL;
+    }
+    return get_loaded_nml_config_file(file);
+}
+
 /*! \todo Another #if 0 */
 #if 0
 int print_loaded_nml_config_file(const char *file)
@@ -591,12 +672,110 @@ int hostname_matches_bufferline(char *bufline)
     return 0;
 }
 
+/* Buffer line found, store the line and type. */
+static void found_buffer_line(CONFIG_SEARCH_STRUCT * s, const char *line,
+    char **word, int line_number)
+{
+    strncpy(s->buffer_line, line, CMS_CONFIG_LINELEN);
+    convert2upper(s->buffer_type, word[2], CMS_CONFIG_LINELEN);
+    s->bufline_found = 1;
+    s->bufline_number = line_number;
+    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	"cms_config found buffer line on line %d\n", line_number);
+}
+
+/* Procedure line found, store the line and type. */
+static int found_proc_line(CONFIG_SEARCH_STRUCT * s, const char *line,
+    char **word, int line_number)
+{
+    strncpy(s->proc_line, line, CMS_CONFIG_LINELEN);
+    switch (cms_connection_mode) {
+    case CMS_NORMAL_CONNECTION_MODE:
+	convert2upper(s->proc_type, word[3], CMS_CONFIG_LINELEN);
+	if (!strncmp(s->proc_type, "AUTO", 4)) {
+	    if (!s->bufline_found || s->bufline_number > line_number) {
+		rcs_print_error
+		    ("Can't use process type AUTO unless the buffer line for %s is found earlier in the config file.\n",
+		    s->bufname);
+		rcs_print_error("Bad line:\n%s:%d %s\n", s->filename,
+		    line_number, line);
+		s->error_type = MISC_CONFIG_SEARCH_ERROR;
+		return -1;
+	    }
+	    if (hostname_matches_bufferline(s->buffer_line)) {
+		strcpy(s->proc_type, "LOCAL");
+	    } else {
+		strcpy(s->proc_type, "REMOTE");
+	    }
+	}
+	break;
+
+    case CMS_FORCE_LOCAL_CONNECTION_MODE:
+	strcpy(s->proc_type, "LOCAL");
+	break;
+
+    case CMS_FORCE_REMOTE_CONNECTION_MODE:
+	strcpy(s->proc_type, "REMOTE");
+	break;
+    }
+    s->procline_found = 1;
+    s->procline_number = line_number;
+    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	"cms_config found process line on line %d\n", line_number);
+    return 0;
+}
+
+/* Look the lines up in the index of a loaded config file. */
+static void find_indexed_lines(CONFIG_SEARCH_STRUCT * s,
+    CONFIG_FILE_INFO * info)
+{
+    char *word[4];
+
+    if (!s->bufline_found) {
+	std::map < std::string, CONFIG_LINE >::iterator b =
+	    info->buffers.find(s->bufname);
+	if (b != info->buffers.end()) {
+	    separate_words(word, 4, (char *) b->second.line);
+	    found_buffer_line(s, b->second.line, word, b->second.number);
+	}
+    }
+    if (!s->procline_found) {
+	std::map < std::string, CONFIG_LINE >::iterator p =
+	    info->procs.find(proc_key(s->procname, s->bufname_for_procline));
+	if (p != info->procs.end()) {
+	    separate_words(word, 4, (char *) p->second.line);
+	    if (found_proc_line(s, p->second.line, word, p->second.number) < 0) {
+		return;
+	    }
+	}
+    }
+
+    if (!s->bufline_found) {
+	s->error_type = NO_BUFFER_LINE;
+    } else if (!s->procline_found) {
+	s->error_type = NO_PROCESS_LINE;
+    } else {
+	s->error_type = CONFIG_SEARCH_OK;
+    }
+}
+
 void find_proc_and_buffer_lines(CONFIG_SEARCH_STRUCT * s)
 {
     if (s == 0) {
 	return;
     }
 
+    if (!loading_config_file) {
+	CONFIG_FILE_INFO *indexed = get_indexed_nml_config_file(s->filename);
+	if (NULL == indexed) {
+	    /* load_nml_config_file() has reported why */
+	    s->error_type = BAD_CONFIG_FILE;
+	    return;
+	}
+	find_indexed_lines(s, indexed);
+	return;
+    }
+
     loading_config_file = 1;
     FILE *fp = NULL;		/* FILE ptr to config file.  */
     char linebuf[CMS_CONFIG_LINELEN];	/* Temporary buffer for line from
@@ -683,50 +862,16 @@ void find_proc_and_buffer_lines(CONFIG_SEARCH_STRUCT * s)
 
 	if (!s->bufline_found && !strcmp(word[1], s->bufname) &&
 	    line[0] == 'B') {
-	    /* Buffer line found, store the line and type. */
-	    strncpy(s->buffer_line, line, CMS_CONFIG_LINELEN);
-	    convert2upper(s->buffer_type, word[2], CMS_CONFIG_LINELEN);
-	    s->bufline_found = 1;
-	    s->bufline_number = line_number;
-	    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
-		"cms_config found buffer line on line %d\n", line_number);
+	    found_buffer_line(s, line, word, line_number);
 	} else if (!s->procline_found && !strcmp(word[1], s->procname) &&
 	    line[0] == 'P' && !strcmp(word[2], s->bufname_for_procline)) {
-	    /* Procedure line found, store the line and type. */
-	    strncpy(s->proc_line, line, CMS_CONFIG_LINELEN);
-	    switch (cms_connection_mode) {
-	    case CMS_NORMAL_CONNECTION_MODE:
-		convert2upper(s->proc_type, word[3], CMS_CONFIG_LINELEN);
-		if (!strncmp(s->proc_type, "AUTO", 4)) {
-		    if (!s->bufline_found) {
-			rcs_print_error
-			    ("Can't use process type AUTO unless the buffer line for %s is found earlier in the config file.\n",
-			    s->bufname);
-			rcs_print_error("Bad line:\n%s:%d %s\n", s->filename,
-			    line_number, line);
-			s->error_type = MISC_CONFIG_SEARCH_ERROR;
-			return;
-		    }
-		    if (hostname_matches_bufferline(s->buffer_line)) {
-			strcpy(s->proc_type, "LOCAL");
-		    } else {
-			strcpy(s->proc_type, "REMOTE");
-		    }
+	    if (found_proc_line(s, line, word, line_number) < 0) {
+		if (NULL != fp) {
+		    fclose(fp);
 		}
-		break;
-
-	    case CMS_FORCE_LOCAL_CONNECTION_MODE:
-		strcpy(s->proc_type, "LOCAL");
-		break;
-
-	    case CMS_FORCE_REMOTE_CONNECTION_MODE:
-		strcpy(s->proc_type, "REMOTE");
-		break;
+		loading_config_file = 0;
+		return;
 	    }
-	    s->procline_found = 1;
-	    s->procline_number = line_number;
-	    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
-		"cms_config found process line on line %d\n", line_number);
 	}
 
 	if (s->procline_found && s->bufline_found) {
@@ -870,6 +1015,26 @@ int cms_create(CMS ** cms, const char *buffer_line, const char *proc_line,
 		return (-1);
 	    }
 #endif
+	} else if (NULL != strstr(buffer_line, "MCAST=")
+	    && NULL != strstr(proc_line, "mcast")) {
+	    *cms = new MCASTMEM(buffer_line, proc_line);
+	    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+		"%p = new MCASTMEM(%s,%s)\n", *cms, buffer_line, proc_line);
+	    if (NULL == *cms) {
+		if (verbose_nml_error_messages) {
+		    rcs_print_error
+			("cms_config: Can't create new MCASTMEM object.\n");
+		}
+		return (-1);
+	    } else if ((*cms)->status < 0) {
+		if (verbose_nml_error_messages) {
+		    rcs_print_error
+			("cms_config: Error  %d(%s) occured during MCASTMEM create.\n",
+			(*cms)->status,
+			(*cms)->status_string((*cms)->status));
+		}
+		return (-1);
+	    }
 	} else if (NULL != strstr(buffer_line, "TCP=")) {
 	    *cms = new TCPMEM(buffer_line, proc_line);
 	    rcs_print_debug(PRINT_CMS_CONFIG_INFO, "%p = new TCPMEM(%s,%s)\n",
@@ -898,7 +1063,10 @@ int cms_create(CMS ** cms, const char *buffer_line, const char *proc_line,
 	}
     } else if (!strcmp(proc_type, "LOCAL")) {
 
-	if (!strcmp(buffer_type, "SHMEM")) {
+	/* A SHMEM buffer that only this process uses needs no shared
+	   memory or semaphores; its users share a LOCMEM buffer instead. */
+	if (!strcmp(buffer_type, "SHMEM")
+	    && NULL == strcasestr(buffer_line, "PROCESS_LOCAL")) {
 	    *cms = new SHMEM(buffer_line, proc_line, set_to_server,
 		set_to_master);
 	    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
@@ -928,7 +1096,7 @@ int cms_create(CMS ** cms, const char *buffer_line, const char *proc_line,
 	    return (-1);
 	}
 
-	if (!strcmp(buffer_type, "LOCMEM")) {
+	if (!strcmp(buffer_type, "LOCMEM") || !strcmp(buffer_type, "SHMEM")) {
 	    *cms =
 		new LOCMEM(buffer_line, proc_line, set_to_server,
 		set_to_master);
@@ -26,6 +26,7 @@ extern "C" {
 #include <stdlib.h>		/* strtol(), strtoul(), strtod() */
 #include <stdio.h>		/* sprintf() */
 #include <ctype.h>		/* isspace() */
+#include <math.h>		/* signbit() */
 
 #ifdef __cplusplus
 }
@@ -33,6 +34,10 @@ extern "C" {
 #include "cms.hh"		/* class CMS */
 #include "cms_dup.hh"		/* class CMS_DISPLAY_ASCII_UPDATER */
 #include "rcs_print.hh"		/* rcs_print_error() */
+
+/* What sprintf("%f,") gives for 0.0, which fills most of the large
+   arrays in status messages. */
+static const char display_zero[] = "0.000000,";
 #define DEFAULT_WARNING_COUNT_MAX 100
 /* Member functions for CMS_DISPLAY_ASCII_UPDATER Class */
     CMS_DISPLAY_ASCII_UPDATER::CMS_DISPLAY_ASCII_UPDATER(CMS * _cms_parent):
@@ -683,7 +688,11 @@ CMS_STATUS CMS_DISPLAY_ASCII_UPDATER::update(float &x)
     }
 
     if (encoding) {
-	sprintf(end_current_string, "%f,", x);
+	if (x == 0.0 && !signbit(x)) {
+	    memcpy(end_current_string, display_zero, sizeof(display_zero));
+	} else {
+	    sprintf(end_current_string, "%f,", x);
+	}
     } else {
 	if (0 == end_current_string[0]) {
 	    x = 0;
@@ -736,7 +745,11 @@ CMS_STATUS CMS_DISPLAY_ASCII_UPDATER::update(double &x)
     }
 
     if (encoding) {
-	sprintf(end_current_string, "%f,", x);
+	if (x == 0.0 && !signbit(x)) {
+	    memcpy(end_current_string, display_zero, sizeof(display_zero));
+	} else {
+	    sprintf(end_current_string, "%f,", x);
+	}
     } else {
 	if (0 == end_current_string[0]) {
 	    x = 0;
@@ -1087,6 +1087,19 @@ CMS_STATUS CMS::peek_raw()
 
     /* Read the message. */
     handle_to_global_data->offset += sizeof(CMS_HEADER);
+    if (borrowing && NULL != handle_to_global_data->local_address) {
+	/* Hand out the message in place instead of copying it. */
+	if (handle_to_global_data->offset + header.in_buffer_size >
+	    handle_to_global_data->size) {
+	    rcs_print_error
+		("CMS:(%s) Message size of %ld overruns the buffer\n",
+		BufferName, header.in_buffer_size);
+	    return (status = CMS_INTERNAL_ACCESS_ERROR);
+	}
+	borrowed_data = ((char *) handle_to_global_data->local_address) +
+	    handle_to_global_data->offset;
+	return (status);
+    }
     if (-1 ==
 	handle_to_global_data->read(subdiv_data,
 	    (long) header.in_buffer_size)) {
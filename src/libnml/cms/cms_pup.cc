@@ -0,0 +1,377 @@
+/********************************************************************
+* Description: cms_pup.cc
+*   Provides the interface to CMS used by NML update functions
+*   including a CMS update function for all the basic C data types
+*   to convert NMLmsgs to a packed little-endian layout.
+*
+*   Unlike XDR there is no per-field framing: a message encodes to
+*   exactly the fields its update() function visits, in that order,
+*   at fixed widths.  Both ends must use the same update() functions,
+*   as with any other neutral encoding.
+*
+* License: LGPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+extern "C" {
+#include <stdlib.h>		/* malloc(), free() */
+#include <string.h>		/* memcpy() */
+#include <stdint.h>		/* int64_t */
+#include <endian.h>		/* __BYTE_ORDER */
+}
+
+#include "cms.hh"		/* class CMS */
+#include "cms_pup.hh"		/* class CMS_PACKED_UPDATER */
+#include "rcs_print.hh"		/* rcs_print_error() */
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define CMS_PACKED_SWAP 1
+#else
+#define CMS_PACKED_SWAP 0
+#endif
+
+/* Copy one wire-sized value, reversing its bytes on big-endian hosts. */
+static inline void packed_copy(char *dst, const char *src, size_t n)
+{
+    if (CMS_PACKED_SWAP) {
+	for (size_t i = 0; i < n; i++) {
+	    dst[i] = src[n - 1 - i];
+	}
+    } else {
+	memcpy(dst, src, n);
+    }
+}
+
+/* Whether an array of T can be moved to/from its W encoding with one
+   memcpy(). */
+template < class W, class T > struct packed_raw {
+    enum { value = sizeof(W) == sizeof(T)
+	    && (sizeof(W) == 1 || !CMS_PACKED_SWAP) };
+};
+template < class W > struct packed_raw <W, bool > {
+    enum { value = 0 };
+};
+template < class W > struct packed_raw <W, long double > {
+    enum { value = 0 };
+};
+
+/* Member functions for CMS_PACKED_UPDATER Class */
+CMS_PACKED_UPDATER::CMS_PACKED_UPDATER(CMS * _cms_parent):CMS_UPDATER
+    (_cms_parent, 0, 2)
+{
+    current_buffer = NULL;
+    current_limit = 0;
+    current_pos = NULL;
+    data_pos = header_pos = queuing_header_pos = 0;
+    encoded_header = NULL;
+    encoded_queuing_header = NULL;
+
+    if (!cms_parent->isserver) {
+	encoded_data = NULL;
+    }
+    using_external_encoded_data = 0;
+
+    /* Store and validate constructors arguments. */
+    cms_parent = _cms_parent;
+    if (NULL == cms_parent) {
+	rcs_print_error("CMS parent for updater is NULL.\n");
+	status = CMS_UPDATE_ERROR;
+	return;
+    }
+
+    /* Allocate the encoded header too large, */
+    /* and find out what size it really is. */
+    encoded_header = malloc(neutral_size_factor * sizeof(CMS_HEADER));
+    if (encoded_header == NULL) {
+	rcs_print_error("CMS:can't malloc encoded_header");
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+    if (cms_parent->queuing_enabled) {
+	encoded_queuing_header =
+	    malloc(neutral_size_factor * sizeof(CMS_QUEUING_HEADER));
+	if (encoded_queuing_header == NULL) {
+	    rcs_print_error("CMS:can't malloc encoded_queuing_header");
+	    status = CMS_CREATE_ERROR;
+	    return;
+	}
+    }
+    if (!cms_parent->isserver) {
+	if (cms_parent->enc_max_size > 0
+	    && cms_parent->enc_max_size < neutral_size_factor * size) {
+	    set_encoded_data(malloc(cms_parent->enc_max_size),
+		cms_parent->enc_max_size);
+	} else {
+	    set_encoded_data(malloc(neutral_size_factor * size),
+		neutral_size_factor * size);
+	}
+    }
+    using_external_encoded_data = 0;
+}
+
+CMS_PACKED_UPDATER::~CMS_PACKED_UPDATER()
+{
+    if (NULL != encoded_data && !using_external_encoded_data) {
+	free(encoded_data);
+	encoded_data = NULL;
+    }
+    if (NULL != encoded_header) {
+	free(encoded_header);
+	encoded_header = NULL;
+    }
+    if (NULL != encoded_queuing_header) {
+	free(encoded_queuing_header);
+	encoded_queuing_header = NULL;
+    }
+}
+
+void CMS_PACKED_UPDATER::set_encoded_data(void *_encoded_data,
+    long _encoded_data_size)
+{
+    /* If the encoded data area has already been setup then release it. */
+    if (NULL != encoded_data && !using_external_encoded_data
+	&& encoded_data != _encoded_data) {
+	free(encoded_data);
+	encoded_data = NULL;
+    }
+
+    encoded_data_size = _encoded_data_size;
+    encoded_data = _encoded_data;
+    using_external_encoded_data = 1;
+    if (encoded_data == NULL) {
+	rcs_print_error
+	    ("CMS: Attempt to set  encoded_data buffer to NULL.\n");
+	status = CMS_MISC_ERROR;
+	return;
+    }
+    if (mode == CMS_ENCODE_DATA || mode == CMS_DECODE_DATA) {
+	set_mode(mode);
+    }
+}
+
+int CMS_PACKED_UPDATER::set_mode(CMS_UPDATER_MODE _mode)
+{
+    mode = _mode;
+    CMS_UPDATER::set_mode(_mode);
+    switch (mode) {
+    case CMS_NO_UPDATE:
+	current_buffer = NULL;
+	current_limit = 0;
+	current_pos = NULL;
+	break;
+
+    case CMS_ENCODE_DATA:
+    case CMS_DECODE_DATA:
+	current_buffer = (char *) encoded_data;
+	current_limit = encoded_data_size;
+	if (current_limit > cms_parent->max_encoded_message_size
+	    && cms_parent->max_encoded_message_size > 0) {
+	    current_limit = cms_parent->max_encoded_message_size;
+	}
+	current_pos = &data_pos;
+	break;
+
+    case CMS_ENCODE_HEADER:
+    case CMS_DECODE_HEADER:
+	current_buffer = (char *) encoded_header;
+	current_limit = neutral_size_factor * sizeof(CMS_HEADER);
+	current_pos = &header_pos;
+	break;
+
+    case CMS_ENCODE_QUEUING_HEADER:
+    case CMS_DECODE_QUEUING_HEADER:
+	current_buffer = (char *) encoded_queuing_header;
+	current_limit = neutral_size_factor * sizeof(CMS_QUEUING_HEADER);
+	current_pos = &queuing_header_pos;
+	break;
+
+    default:
+	rcs_print_error("CMS updater in invalid mode.(%d)\n", mode);
+	return (-1);
+    }
+    return (0);
+}
+
+/* Repositions the data buffer to the very beginning */
+void CMS_PACKED_UPDATER::rewind()
+{
+    CMS_UPDATER::rewind();
+    if (NULL != current_pos) {
+	*current_pos = 0;
+    } else {
+	rcs_print_error
+	    ("CMS_PACKED_UPDATER: Can't rewind because no buffer is selected.\n");
+    }
+    if (NULL != cms_parent) {
+	cms_parent->format_size = 0;
+    }
+}
+
+int CMS_PACKED_UPDATER::get_encoded_msg_size()
+{
+    if (NULL == current_pos) {
+	rcs_print_error
+	    ("CMS_PACKED_UPDATER can not provide encoded_msg_size because no buffer is selected.\n");
+	return (-1);
+    }
+    return ((int) *current_pos);
+}
+
+template < class W, class T >
+CMS_STATUS CMS_PACKED_UPDATER::pack(T * x, unsigned int len)
+{
+    if (NULL == current_buffer || NULL == current_pos) {
+	rcs_print_error("CMS_PACKED_UPDATER: Required pointer is NULL.\n");
+	return (status = CMS_UPDATE_ERROR);
+    }
+    /* Check to see if the pointers are in the proper range. */
+    if (-1 == check_pointer((char *) x, len * sizeof(T))) {
+	return (CMS_UPDATE_ERROR);
+    }
+    long bytes = (long) len * sizeof(W);
+    if (*current_pos + bytes > current_limit) {
+	rcs_print_error
+	    ("Encoded message buffer full. (pos=%ld,_bytes=%ld,limit=%ld)\n",
+	    *current_pos, bytes, current_limit);
+	return (status = CMS_UPDATE_ERROR);
+    }
+    char *p = current_buffer + *current_pos;
+    *current_pos += bytes;
+
+    if (packed_raw < W, T >::value) {
+	if (encoding) {
+	    memcpy(p, x, bytes);
+	} else {
+	    memcpy(x, p, bytes);
+	}
+	return (status);
+    }
+    for (unsigned int i = 0; i < len; i++, p += sizeof(W)) {
+	W w;
+	if (encoding) {
+	    w = (W) x[i];
+	    packed_copy(p, (const char *) &w, sizeof(W));
+	} else {
+	    packed_copy((char *) &w, p, sizeof(W));
+	    x[i] = (T) w;
+	}
+    }
+    return (status);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(bool &x)
+{
+    return pack < unsigned char >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(char &x)
+{
+    return pack < char >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned char &x)
+{
+    return pack < unsigned char >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(short int &x)
+{
+    return pack < int16_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned short int &x)
+{
+    return pack < uint16_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(int &x)
+{
+    return pack < int32_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned int &x)
+{
+    return pack < uint32_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long int &x)
+{
+    return pack < int64_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned long int &x)
+{
+    return pack < uint64_t >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(float &x)
+{
+    return pack < float >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(double &x)
+{
+    return pack < double >(&x, 1);
+}
+
+/* Long doubles travel as doubles, as they do through XDR. */
+CMS_STATUS CMS_PACKED_UPDATER::update(long double &x)
+{
+    return pack < double >(&x, 1);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(char *x, unsigned int len)
+{
+    return pack < char >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned char *x, unsigned int len)
+{
+    return pack < unsigned char >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(short *x, unsigned int len)
+{
+    return pack < int16_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned short *x, unsigned int len)
+{
+    return pack < uint16_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(int *x, unsigned int len)
+{
+    return pack < int32_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned int *x, unsigned int len)
+{
+    return pack < uint32_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long *x, unsigned int len)
+{
+    return pack < int64_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned long *x, unsigned int len)
+{
+    return pack < uint64_t >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(float *x, unsigned int len)
+{
+    return pack < float >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(double *x, unsigned int len)
+{
+    return pack < double >(x, len);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long double *x, unsigned int len)
+{
+    return pack < double >(x, len);
+}
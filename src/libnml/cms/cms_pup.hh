@@ -0,0 +1,64 @@
+/********************************************************************
+* Description: cms_pup.hh
+*   CMS_PACKED_UPDATER: a fixed-layout little-endian neutral encoding.
+*   Each field is stored at its natural width (long as 64 bits, long
+*   double as double) with no per-field framing, and arrays are moved
+*   with a single copy on little-endian hosts.
+*
+* License: LGPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef CMS_PUP_HH
+#define CMS_PUP_HH
+
+#include "cms_up.hh"		/* class CMS_UPDATER */
+
+class CMS_PACKED_UPDATER:public CMS_UPDATER {
+  public:
+    CMS_STATUS update(bool &x);
+    CMS_STATUS update(char &x);
+    CMS_STATUS update(unsigned char &x);
+    CMS_STATUS update(short int &x);
+    CMS_STATUS update(unsigned short int &x);
+    CMS_STATUS update(int &x);
+    CMS_STATUS update(unsigned int &x);
+    CMS_STATUS update(long int &x);
+    CMS_STATUS update(unsigned long int &x);
+    CMS_STATUS update(float &x);
+    CMS_STATUS update(double &x);
+    CMS_STATUS update(long double &x);
+    CMS_STATUS update(char *x, unsigned int len);
+    CMS_STATUS update(unsigned char *x, unsigned int len);
+    CMS_STATUS update(short *x, unsigned int len);
+    CMS_STATUS update(unsigned short *x, unsigned int len);
+    CMS_STATUS update(int *x, unsigned int len);
+    CMS_STATUS update(unsigned int *x, unsigned int len);
+    CMS_STATUS update(long *x, unsigned int len);
+    CMS_STATUS update(unsigned long *x, unsigned int len);
+    CMS_STATUS update(float *x, unsigned int len);
+    CMS_STATUS update(double *x, unsigned int len);
+    CMS_STATUS update(long double *x, unsigned int len);
+    int set_mode(CMS_UPDATER_MODE);
+    void rewind();
+    int get_encoded_msg_size();
+    void set_encoded_data(void *, long _encoded_data_size);
+  protected:
+      CMS_PACKED_UPDATER(CMS *);
+      virtual ~ CMS_PACKED_UPDATER();
+    friend class CMS;
+
+    /* W is the type on the wire, T the type in the message. */
+    template < class W, class T > CMS_STATUS pack(T * x, unsigned int len);
+
+    char *current_buffer;	/* encoded area for the current mode */
+    long current_limit;		/* its size */
+    long *current_pos;		/* and where the next field goes */
+    long data_pos;
+    long header_pos;
+    long queuing_header_pos;
+};
+
+#endif
+// !defined(CMS_PUP_HH)
@@ -593,7 +593,9 @@ void CMS_SERVER::reset_diag_info(int buffer_number)
     last_local_port_used = NULL;
 }
 
-REMOTE_CMS_REPLY *CMS_SERVER::process_request(REMOTE_CMS_REQUEST * _request)
+/* Find the local port a request is for and check the user may use it. */
+CMS_SERVER_LOCAL_PORT *CMS_SERVER::check_request(REMOTE_CMS_REQUEST *
+    _request)
 {
     CMS_SERVER_LOCAL_PORT *local_port;
 
@@ -617,6 +619,30 @@ REMOTE_CMS_REPLY *CMS_SERVER::process_request(REMOTE_CMS_REQUEST * _request)
 	(remote_port->current_user_info, request->buffer_number)) {
 	return NULL;
     }
+    return local_port;
+}
+
+/* The read half of process_request(), for a local port already returned
+   by check_request().  It touches nothing but the local port, so a
+   remote port may call it without serializing against other buffers. */
+REMOTE_READ_REPLY *CMS_SERVER::read_local_port(CMS_SERVER_LOCAL_PORT *
+    local_port, REMOTE_READ_REQUEST * _request)
+{
+    if (NULL == local_port || NULL == _request) {
+	return NULL;
+    }
+    local_port->cms->set_subdivision(_request->subdiv);
+    _request->subdiv = 0;
+    return (local_port->reader(_request));
+}
+
+REMOTE_CMS_REPLY *CMS_SERVER::process_request(REMOTE_CMS_REQUEST * _request)
+{
+    CMS_SERVER_LOCAL_PORT *local_port = check_request(_request);
+
+    if (NULL == local_port) {
+	return NULL;
+    }
 
     local_port->cms->set_subdivision(_request->subdiv);
     _request->subdiv = 0;
@@ -149,6 +149,9 @@ class CMS_SERVER {
 
     long maximum_cms_size;
     REMOTE_CMS_REPLY *process_request(REMOTE_CMS_REQUEST *);
+    CMS_SERVER_LOCAL_PORT *check_request(REMOTE_CMS_REQUEST *);
+    REMOTE_READ_REPLY *read_local_port(CMS_SERVER_LOCAL_PORT *,
+	REMOTE_READ_REQUEST *);
     void register_server(int setup_CC_signal_handler = 1);
     void unregister_server();
     void run(int setup_CC_signal_handler = 1);
@@ -17,12 +17,66 @@
 
 extern "C" {
 #include <stdlib.h>		/* malloc(), free() */
+#include <string.h>		/* memcpy() */
+#include <stdint.h>		/* int32_t */
+#include <endian.h>		/* htobe32(), be64toh() */
 }
 
 #include "cms.hh"		/* class CMS */
 #include "cms_xup.hh"		/* class CMS_XDR_UPDATER */
 #include "rcs_print.hh"		/* rcs_print_error() */
 
+/* Bulk arrays: rather than have xdr_vector() call the element filter for
+   each of len elements, take room for the whole array from the memory
+   stream with xdr_inline() and convert in one loop.  W is the type XDR
+   puts on the wire for T (shorts travel as 32-bit ints); the bytes are
+   the same as the element filters produce.  Returns 0 when the stream
+   can not hand out the room, and the caller falls back to xdr_vector(). */
+static inline void xdr_wire_copy(char *dst, const char *src, size_t n)
+{
+#if __BYTE_ORDER == __BIG_ENDIAN
+    memcpy(dst, src, n);
+#else
+    if (n == 4) {
+	uint32_t u;
+	memcpy(&u, src, 4);
+	u = __builtin_bswap32(u);
+	memcpy(dst, &u, 4);
+    } else {
+	uint64_t u;
+	memcpy(&u, src, 8);
+	u = __builtin_bswap64(u);
+	memcpy(dst, &u, 8);
+    }
+#endif
+}
+
+template < class W, class T >
+static int xdr_bulk(XDR * xdrs, T * x, unsigned int len)
+{
+    if (len == 0 || len > 0x10000000
+	|| (xdrs->x_op != XDR_ENCODE && xdrs->x_op != XDR_DECODE)) {
+	return 0;
+    }
+    char *p = (char *) xdr_inline(xdrs, len * sizeof(W));
+    if (NULL == p) {
+	return 0;
+    }
+    if (xdrs->x_op == XDR_ENCODE) {
+	for (unsigned int i = 0; i < len; i++, p += sizeof(W)) {
+	    W w = (W) x[i];
+	    xdr_wire_copy(p, (const char *) &w, sizeof(W));
+	}
+    } else {
+	for (unsigned int i = 0; i < len; i++, p += sizeof(W)) {
+	    W w;
+	    xdr_wire_copy((char *) &w, p, sizeof(W));
+	    x[i] = (T) w;
+	}
+    }
+    return 1;
+}
+
 /* Member functions for CMS_XDR_UPDATER Class */
 CMS_XDR_UPDATER::CMS_XDR_UPDATER(CMS * _cms_parent):CMS_UPDATER(_cms_parent,
     0, 2)
@@ -412,6 +466,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(short *x, unsigned int len)
 	return (CMS_UPDATE_ERROR);
     }
 
+    if (xdr_bulk < int32_t >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream, (char *) x, len, sizeof(short),
 	    (xdrproc_t) xdr_short) != TRUE) {
 	rcs_print_error
@@ -441,6 +498,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(unsigned short *x, unsigned int len)
 	return (CMS_UPDATE_ERROR);
     }
 
+    if (xdr_bulk < uint32_t >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream,
 	    (char *) x, len,
 	    sizeof(unsigned short), (xdrproc_t) xdr_u_short) != TRUE) {
@@ -471,6 +531,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(int *x, unsigned int len)
     if (-1 == check_pointer((char *) x, len * sizeof(int))) {
 	return (CMS_UPDATE_ERROR);
     }
+    if (xdr_bulk < int32_t >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream, (char *) x, len, sizeof(int),
 	    (xdrproc_t) xdr_int) != TRUE) {
 	rcs_print_error
@@ -499,6 +562,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(unsigned int *x, unsigned int len)
 	return (CMS_UPDATE_ERROR);
     }
 
+    if (xdr_bulk < uint32_t >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream,
 	    (char *) x, len,
 	    sizeof(unsigned int), (xdrproc_t) xdr_u_int) != TRUE) {
@@ -590,6 +656,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(float *x, unsigned int len)
 	return (CMS_UPDATE_ERROR);
     }
 
+    if (xdr_bulk < float >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream, (char *) x, len, sizeof(float),
 	    (xdrproc_t) xdr_float) != TRUE) {
 	rcs_print_error
@@ -618,6 +687,9 @@ CMS_STATUS CMS_XDR_UPDATER::update(double *x, unsigned int len)
 	return (CMS_UPDATE_ERROR);
     }
 
+    if (xdr_bulk < double >(current_stream, x, len)) {
+	return (status);
+    }
     if (xdr_vector(current_stream, (char *) x, len, sizeof(double),
 	    (xdrproc_t) xdr_double) != TRUE) {
 	rcs_print_error
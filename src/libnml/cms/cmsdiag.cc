@@ -276,3 +276,9 @@ CMS_DIAGNOSTICS_INFO *CMS::get_diagnostics_info()
     main_access(data);
     return (di);
 }
+
+/* Only buffer types that keep a CMS_ACCESS_STATS block override this. */
+const CMS_ACCESS_STATS *CMS::get_access_stats()
+{
+    return (NULL);
+}
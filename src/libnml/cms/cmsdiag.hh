@@ -63,6 +63,37 @@ class CMS_DIAGNOSTICS_INFO:public CMS_DIAG_HEADER {
     LinkedList *dpis;
 };
 
+/* Access counters kept for every SHMEM buffer, whether or not it has
+   "diag" on its line, in a block after the end of the segment.  They
+   only count up, with relaxed atomics, so a reader such as nmlstat
+   gets rates by sampling twice.  Remote clients are counted as the
+   server that does the access for them.  Lock waits go into decade
+   buckets from under 1 us (bucket 0) up to 1 s and over. */
+#define CMS_STATS_WAIT_BUCKETS 8
+#define CMS_STATS_PROCS 16
+
+struct CMS_STATS_PROC {
+    int pid;			/* 0 if the slot is free */
+    char name[16];		/* process name from the .nml file */
+    long long accesses;
+    double last_access_time;	/* etime() of the last access */
+};
+
+struct CMS_ACCESS_STATS {
+    long long reads;		/* read() and peek() calls */
+    long long new_reads;	/* of those, the ones that got a new message */
+    long long writes;		/* messages written */
+    long long bytes_read;
+    long long bytes_written;
+    long long retries;		/* lock-free copies that raced the writer,
+				   blocking reads woken with nothing new */
+    long long queue_full;	/* writes refused by a full queue */
+    long long lock_timeouts;
+    long long wait_histogram[CMS_STATS_WAIT_BUCKETS];
+    long long wait_max_ns;
+    struct CMS_STATS_PROC procs[CMS_STATS_PROCS];
+};
+
 extern double cmsdiag_timebias;
 extern int cmsdiag_timebias_set;
 
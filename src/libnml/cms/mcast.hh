@@ -0,0 +1,37 @@
+/********************************************************************
+* Description: mcast.hh
+*
+* License: LGPL Version 2
+* System: Linux
+*
+********************************************************************/
+#ifndef MCAST_HH
+#define MCAST_HH
+
+/* A buffer with MCAST=group:port on its line has the TCP server that
+   serves it send each new message to that UDP multicast group, for
+   any number of read only MCASTMEM viewers at no cost to the server
+   per viewer.  Each message goes out in datagrams of at most
+   NML_MCAST_DATAGRAM_SIZE bytes, each starting with these big endian
+   32 bit words:
+
+	NML_MCAST_MAGIC
+	buffer number
+	sequence number, one more for each message sent
+	write id of the message
+	size of the data, with TCP_PACKED_SIZE_FLAG set if it is packed
+	fragment number << 16 | number of fragments
+
+   The data is packed as by tcp_pack() against the message sent before
+   it, or against nothing every MCAST_KEYFRAME= seconds (1 by default),
+   so a viewer that joins late or misses a datagram has the whole
+   message again by then.  The buffer is checked for a new message
+   every MCAST_INTERVAL= seconds, 0.1 by default. */
+
+#define NML_MCAST_MAGIC 0x4e4d4c4d	/* "NMLM" */
+#define NML_MCAST_HEADER_SIZE 24
+#define NML_MCAST_DATAGRAM_SIZE 1400
+#define NML_MCAST_FRAGMENT_SIZE \
+	(NML_MCAST_DATAGRAM_SIZE - NML_MCAST_HEADER_SIZE)
+
+#endif /* MCAST_HH */
@@ -0,0 +1,155 @@
+/********************************************************************
+* Description: tcp_pack.cc
+*
+* License: LGPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include "tcp_pack.hh"
+
+#include <string.h>		// memcpy
+#include <stdint.h>		// uint32_t
+#include <arpa/inet.h>		// htonl
+
+/* an equal run shorter than this stays in the differing run around it,
+   since a new pair of run lengths costs as much */
+#define TCP_PACK_MIN_SAME 4
+#define TCP_PACK_MAX_RUN 0xffff
+
+static inline unsigned char base_byte(const char *base, long base_size,
+    long i)
+{
+    return i < base_size ? (unsigned char) base[i] : 0;
+}
+
+static inline int same(const char *data, const char *base, long base_size,
+    long i)
+{
+    return (unsigned char) data[i] == base_byte(base, base_size, i);
+}
+
+static void put16(char *addr, unsigned int val)
+{
+    addr[0] = (char) (val >> 8);
+    addr[1] = (char) val;
+}
+
+static unsigned int get16(const char *addr)
+{
+    return ((unsigned char) addr[0] << 8) | (unsigned char) addr[1];
+}
+
+static void putbe32(char *addr, uint32_t val)
+{
+    val = htonl(val);
+    memcpy(addr, &val, sizeof(val));
+}
+
+static uint32_t getbe32(const char *addr)
+{
+    uint32_t val;
+    memcpy(&val, addr, sizeof(val));
+    return ntohl(val);
+}
+
+long tcp_pack(const char *data, long size, const char *base,
+    long base_size, unsigned long base_id, char *out, long out_size)
+{
+    long limit, o, i, start, j, nsame, ndiff;
+
+    if (NULL == base) {
+	base_size = 0;
+	base_id = 0;
+    }
+    limit = size - 1;
+    if (limit > out_size) {
+	limit = out_size;
+    }
+    if (limit < TCP_PACKED_HEADER_SIZE) {
+	return -1;
+    }
+    putbe32(out, (uint32_t) size);
+    putbe32(out + 4, (uint32_t) base_id);
+    o = TCP_PACKED_HEADER_SIZE;
+    i = 0;
+    while (i < size) {
+	start = i;
+	while (i < size && i - start < TCP_PACK_MAX_RUN
+	    && same(data, base, base_size, i)) {
+	    i++;
+	}
+	nsame = i - start;
+	start = i;
+	while (i < size && i - start < TCP_PACK_MAX_RUN) {
+	    if (!same(data, base, base_size, i)) {
+		i++;
+		continue;
+	    }
+	    for (j = i; j < size && j - i < TCP_PACK_MIN_SAME
+		&& same(data, base, base_size, j); j++) {
+	    }
+	    if (j - i >= TCP_PACK_MIN_SAME || j == size
+		|| j - start > TCP_PACK_MAX_RUN) {
+		break;
+	    }
+	    i = j;
+	}
+	ndiff = i - start;
+	if (o + 4 + ndiff > limit) {
+	    return -1;
+	}
+	put16(out + o, (unsigned int) nsame);
+	put16(out + o + 2, (unsigned int) ndiff);
+	memcpy(out + o + 4, data + start, ndiff);
+	o += 4 + ndiff;
+    }
+    return o;
+}
+
+unsigned long tcp_packed_base_id(const char *packed, long packed_size)
+{
+    if (packed_size < TCP_PACKED_HEADER_SIZE) {
+	return 0;
+    }
+    return getbe32(packed + 4);
+}
+
+long tcp_unpack(const char *packed, long packed_size, const char *base,
+    long base_size, char *out, long out_size)
+{
+    long size, o, p, k;
+    unsigned int nsame, ndiff;
+
+    if (NULL == base) {
+	base_size = 0;
+    }
+    if (packed_size < TCP_PACKED_HEADER_SIZE) {
+	return -1;
+    }
+    size = getbe32(packed);
+    if (size > out_size) {
+	return -1;
+    }
+    o = 0;
+    p = TCP_PACKED_HEADER_SIZE;
+    while (p < packed_size) {
+	if (p + 4 > packed_size) {
+	    return -1;
+	}
+	nsame = get16(packed + p);
+	ndiff = get16(packed + p + 2);
+	p += 4;
+	if (o + (long) nsame + (long) ndiff > size
+	    || p + (long) ndiff > packed_size) {
+	    return -1;
+	}
+	for (k = 0; k < (long) nsame; k++, o++) {
+	    out[o] = (char) base_byte(base, base_size, o);
+	}
+	memcpy(out + o, packed + p, ndiff);
+	o += ndiff;
+	p += ndiff;
+    }
+    return o == size ? size : -1;
+}
@@ -0,0 +1,38 @@
+/********************************************************************
+* Description: tcp_pack.hh
+*
+* License: LGPL Version 2
+* System: Linux
+*
+********************************************************************/
+#ifndef TCP_PACK_HH
+#define TCP_PACK_HH
+
+/* Functions shared by client and server to pack read replies when a
+   client has asked for it with REMOTE_CMS_SET_DELTA_REQUEST_TYPE.  A
+   packed reply has TCP_PACKED_SIZE_FLAG set in the size of the reply
+   header, and its data is the unpacked size and the write id of the
+   base it was packed against (0 for none), then runs of bytes that are
+   the same as the base, given only by their length, each followed by a
+   run that differs, given in full.  Where there is no base, or it is
+   shorter, its bytes count as zero, so an encoded message full of
+   zeros packs small even without one. */
+
+#define TCP_PACKED_SIZE_FLAG 0x40000000
+#define TCP_PACKED_HEADER_SIZE 8
+
+/* Packs size bytes of data against base into out, which has room for
+   out_size.  Returns the packed length, or -1 if it would not be
+   shorter than size, in which case the data is best sent as it is. */
+long tcp_pack(const char *data, long size, const char *base,
+    long base_size, unsigned long base_id, char *out, long out_size);
+
+/* Returns the write id of the base packed was packed against. */
+unsigned long tcp_packed_base_id(const char *packed, long packed_size);
+
+/* Unpacks into out, which has room for out_size.  Returns the unpacked
+   size, or -1 if the packed data is bad or doesn't fit. */
+long tcp_unpack(const char *packed, long packed_size, const char *base,
+    long base_size, char *out, long out_size);
+
+#endif /* TCP_PACK_HH */
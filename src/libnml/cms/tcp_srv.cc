@@ -29,6 +29,7 @@ extern "C" {
 #include <sys/ioctl.h>
 #include <errno.h>		/* errno */
 #include <signal.h>		// SIGPIPE, signal()
+#include <fcntl.h>		/* fcntl(), O_NONBLOCK */
 
 #ifdef __cplusplus
 }
@@ -50,6 +51,8 @@ extern "C" {
 extern "C" {
 #include "recvn.h"		/* recvn() */
 #include "sendn.h"		/* sendn() */
+#include "tcp_pack.hh"		/* tcp_pack() */
+#include "mcast.hh"		/* NML_MCAST_MAGIC */
 }
 #include "physmem.hh"           // PHYSMEM_HANDLE
 
@@ -58,6 +61,29 @@ int tcpsvr_threads_killed = 0;
 int tcpsvr_threads_exited = 0;
 int tcpsvr_threads_returned_early = 0;
 
+/* One per buffer a threaded server has served. */
+struct TCP_BUFFER_LOCK {
+    long buffer_number;
+    pthread_mutex_t mutex;
+};
+
+/* One per buffer published to a multicast group. */
+struct TCP_MCAST_PUBLISHER {
+    long buffer_number;
+    int socket_fd;
+    struct sockaddr_in address;
+    double interval;
+    double keyframe_interval;
+    double last_check_time;
+    double last_keyframe_time;
+    unsigned long seq;
+    unsigned long last_id;	/* write id of base, 0 before the first */
+    char *base;			/* the last message sent, unpacked */
+    long base_size;
+    char *packed;
+    long packed_size;
+};
+
 TCPSVR_BLOCKING_READ_REQUEST::TCPSVR_BLOCKING_READ_REQUEST()
 {
     access_type = CMS_READ_ACCESS;	/* read or just peek */
@@ -131,6 +157,16 @@ CMS_SERVER_REMOTE_PORT(_cms_server)
     connection_port = 0;
     maxfdpl = 0;
     dtimeout = 20.0;
+    server_threads = 0;
+    workers = NULL;
+    workers_exit = 0;
+    workers_running = 0;
+    ready_clients = NULL;
+    buffer_locks = NULL;
+    mcast_publishers = NULL;
+    wake_fds[0] = wake_fds[1] = -1;
+    pthread_mutex_init(&state_mutex, NULL);
+    pthread_cond_init(&clients_ready, NULL);
 
     memset(&server_socket_address, 0, sizeof(server_socket_address));
     server_socket_address.sin_family = AF_INET;
@@ -160,6 +196,33 @@ CMS_SERVER_REMOTE_TCP_PORT::~CMS_SERVER_REMOTE_TCP_PORT()
 	delete client_ports;
 	client_ports = (LinkedList *) NULL;
     }
+    /* Workers that did not stop in time may still use these. */
+    if (workers_running > 0) {
+	return;
+    }
+    if (NULL != ready_clients) {
+	delete ready_clients;
+	ready_clients = NULL;
+    }
+    if (NULL != buffer_locks) {
+	TCP_BUFFER_LOCK *lock = (TCP_BUFFER_LOCK *) buffer_locks->get_head();
+	while (NULL != lock) {
+	    pthread_mutex_destroy(&lock->mutex);
+	    delete lock;
+	    lock = (TCP_BUFFER_LOCK *) buffer_locks->get_next();
+	}
+	delete buffer_locks;
+	buffer_locks = NULL;
+    }
+    if (NULL != workers) {
+	delete[]workers;
+	workers = NULL;
+    }
+    if (wake_fds[0] >= 0) {
+	close(wake_fds[0]);
+	close(wake_fds[1]);
+	wake_fds[0] = wake_fds[1] = -1;
+    }
 }
 
 void blocking_thread_kill(long int id)
@@ -184,6 +247,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::unregister_port()
     CLIENT_TCP_PORT *client;
     int number_of_connected_clients = 0;
 
+    stop_workers();
     client = (CLIENT_TCP_PORT *) client_ports->get_head();
     while (NULL != client) {
 	rcs_print("Exiting even though client on %s is still connected.\n",
@@ -208,6 +272,19 @@ void CMS_SERVER_REMOTE_TCP_PORT::unregister_port()
 	delete subscription_buffers;
 	subscription_buffers = NULL;
     }
+    if (NULL != mcast_publishers) {
+	TCP_MCAST_PUBLISHER *pub =
+	    (TCP_MCAST_PUBLISHER *) mcast_publishers->get_head();
+	while (NULL != pub) {
+	    close(pub->socket_fd);
+	    free(pub->base);
+	    free(pub->packed);
+	    delete pub;
+	    pub = (TCP_MCAST_PUBLISHER *) mcast_publishers->get_next();
+	}
+	delete mcast_publishers;
+	mcast_publishers = NULL;
+    }
     if (number_of_connected_clients > 0) {
 	esleep(2.0);
     }
@@ -238,20 +315,60 @@ int CMS_SERVER_REMOTE_TCP_PORT::accept_local_port_cms(CMS * _cms)
     if (_cms->total_subdivisions > max_total_subdivisions) {
 	max_total_subdivisions = _cms->total_subdivisions;
     }
+    if (_cms->server_threads > server_threads) {
+	server_threads = _cms->server_threads;
+    }
     if (server_socket_address.sin_port == 0) {
 	server_socket_address.sin_port =
 	    htons(((u_short) _cms->tcp_port_number));
 	port_num = _cms->tcp_port_number;
+	add_mcast_publisher(_cms);
 	return 1;
     }
     if (server_socket_address.sin_port ==
 	htons(((u_short) _cms->tcp_port_number))) {
 	port_num = _cms->tcp_port_number;
+	add_mcast_publisher(_cms);
 	return 1;
     }
     return 0;
 }
 
+void CMS_SERVER_REMOTE_TCP_PORT::add_mcast_publisher(CMS * _cms)
+{
+    if (0 == _cms->mcast_group[0]) {
+	return;
+    }
+    TCP_MCAST_PUBLISHER *pub = new TCP_MCAST_PUBLISHER;
+    memset(pub, 0, sizeof(*pub));
+    pub->buffer_number = _cms->buffer_number;
+    pub->interval = _cms->mcast_interval;
+    pub->keyframe_interval = _cms->mcast_keyframe;
+    pub->address.sin_family = AF_INET;
+    pub->address.sin_port = htons((u_short) _cms->mcast_port);
+    pub->address.sin_addr.s_addr = inet_addr(_cms->mcast_group);
+    if (!IN_MULTICAST(ntohl(pub->address.sin_addr.s_addr))) {
+	rcs_print_error("TCP server: %s is not a multicast group.\n",
+	    _cms->mcast_group);
+	delete pub;
+	return;
+    }
+    pub->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (pub->socket_fd < 0) {
+	rcs_print_error("socket error: %d -- %s\n", errno, strerror(errno));
+	delete pub;
+	return;
+    }
+    if (NULL == mcast_publishers) {
+	mcast_publishers = new LinkedList;
+    }
+    mcast_publishers->store_at_tail(pub, sizeof(*pub), 0);
+    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	"Publishing buffer %ld to %s:%d.\n", pub->buffer_number,
+	_cms->mcast_group, _cms->mcast_port);
+    recalculate_polling_interval();
+}
+
 void CMS_SERVER_REMOTE_TCP_PORT::register_port()
 {
     port_registered = 0;
@@ -299,7 +416,7 @@ static void handle_pipe_error(int signum)
 
 void CMS_SERVER_REMOTE_TCP_PORT::run()
 {
-    unsigned long bytes_ready;
+    int bytes_ready;
     int ready_descriptors;
     if (NULL == client_ports) {
 	rcs_print_error("CMS_SERVER: List of client ports is NULL.\n");
@@ -321,7 +438,19 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
     FD_ZERO(&write_fd_set_copy);
     FD_SET(connection_socket, &read_fd_set_copy);
 
+    start_workers();
+    if (NULL != workers) {
+	FD_SET(wake_fds[0], &read_fd_set);
+	if (maxfdpl < wake_fds[0] + 1) {
+	    maxfdpl = wake_fds[0] + 1;
+	}
+	pthread_mutex_lock(&state_mutex);
+    }
+
     while (1) {
+	if (NULL != workers) {
+	    pthread_mutex_unlock(&state_mutex);
+	}
 	if (polling_enabled) {
 	    memcpy(&read_fd_set_copy, &read_fd_set, sizeof(fd_set));
 	    memcpy(&write_fd_set_copy, &write_fd_set, sizeof(fd_set));
@@ -331,6 +460,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
 	    ready_descriptors =
 		select(maxfdpl, &read_fd_set, &write_fd_set,
 		(fd_set *) NULL, (timeval *) & select_timeout);
+	    if (NULL != workers) {
+		pthread_mutex_lock(&state_mutex);
+	    }
 	    if (ready_descriptors == 0) {
 		update_subscriptions();
 		memcpy(&read_fd_set, &read_fd_set_copy, sizeof(fd_set));
@@ -341,7 +473,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
 	    ready_descriptors =
 		select(maxfdpl, &read_fd_set, &write_fd_set,
 		(fd_set *) NULL, (timeval *) NULL);
-
+	    if (NULL != workers) {
+		pthread_mutex_lock(&state_mutex);
+	    }
 	}
 	if (ready_descriptors < 0) {
 	    rcs_print_error("server: select error.(errno = %d | %s)\n",
@@ -418,7 +552,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
 		    if (client_port_to_check->blocking) {
 			if (client_port_to_check->threadId > 0) {
 			    rcs_print_debug(PRINT_SERVER_THREAD_ACTIVITY,
-				"Data recieved from %s:%d when it should be blocking (bytes_ready=%ld).\n",
+				"Data recieved from %s:%d when it should be blocking (bytes_ready=%d).\n",
 				inet_ntoa
 				(client_port_to_check->address.
 				    sin_addr),
@@ -430,11 +564,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
 			    blocking_thread_kill
 				(client_port_to_check->threadId);
 #if 0
-			    *((u_long *) temp_buffer) =
-				htonl(client_port_to_check->serial_number);
-			    *((u_long *) temp_buffer + 1) =
-				htonl((unsigned long)
-				CMS_SERVER_SIDE_ERROR);
+			    putbe32(temp_buffer, client_port_to_check->serial_number);
+			    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 			    putbe32(temp_buffer + 8, 0);	/* size
 									 */
 			    putbe32(temp_buffer + 12, 0);	/* write_id
@@ -448,15 +579,33 @@ void CMS_SERVER_REMOTE_TCP_PORT::run()
 			    client_port_to_check->blocking = 0;
 			}
 		    }
-		    handle_request(client_port_to_check);
+		    if (NULL != workers) {
+			/* Out of the select() set until its worker is done. */
+			client_port_to_check->busy = 1;
+			FD_CLR(client_port_to_check->socket_fd, &read_fd_set);
+			ready_clients->store_at_tail(client_port_to_check,
+			    sizeof(client_port_to_check), 0);
+			pthread_cond_signal(&clients_ready);
+		    } else {
+			handle_request(client_port_to_check);
+		    }
 		}
 		ready_descriptors--;
-	    } else {
+	    } else if (!client_port_to_check->busy) {
 		FD_SET(client_port_to_check->socket_fd, &read_fd_set);
 	    }
 	    client_port_to_check =
 		(CLIENT_TCP_PORT *) client_ports->get_next();
 	}
+	if (NULL != workers) {
+	    if (FD_ISSET(wake_fds[0], &read_fd_set)) {
+		char wake[64];
+		while (read(wake_fds[0], wake, sizeof(wake)) > 0) {
+		}
+		ready_descriptors--;
+	    }
+	    FD_SET(wake_fds[0], &read_fd_set);
+	}
 	if (FD_ISSET(connection_socket, &read_fd_set)
 	    && ready_descriptors > 0) {
 	    ready_descriptors--;
@@ -519,6 +668,75 @@ static uint32_t getbe32(char *addr) {
     return ntohl(val);
 }
 
+/* The last reply a delta client was sent from one buffer. */
+struct TCP_DELTA_BASE {
+    long buffer_number;
+    unsigned long id;
+    long size;
+    char *data;
+};
+
+/* For a client that asked for delta replies, packs the size bytes at
+   *data against the reply it was last sent from the buffer, if that is
+   the one it says it has, and points *data and *size at the packed
+   reply when that is shorter.  Returns the size to put in the reply
+   header. */
+static long tcpsvr_pack_reply(CLIENT_TCP_PORT * clnt, long buffer_number,
+    unsigned long acked_id, unsigned long write_id, char **data,
+    long *size)
+{
+    if (!clnt->delta || *size <= TCP_PACKED_HEADER_SIZE) {
+	return *size;
+    }
+    if (NULL == clnt->delta_bases) {
+	clnt->delta_bases = new LinkedList;
+    }
+    TCP_DELTA_BASE *base =
+	(TCP_DELTA_BASE *) clnt->delta_bases->get_head();
+    while (NULL != base && base->buffer_number != buffer_number) {
+	base = (TCP_DELTA_BASE *) clnt->delta_bases->get_next();
+    }
+    if (NULL == base) {
+	base = new TCP_DELTA_BASE;
+	base->buffer_number = buffer_number;
+	base->id = 0;
+	base->size = 0;
+	base->data = NULL;
+	clnt->delta_bases->store_at_tail(base, sizeof(*base), 0);
+    }
+    if (*size > clnt->pack_data_size) {
+	char *grown = (char *) realloc(clnt->pack_data, *size);
+	if (NULL == grown) {
+	    return *size;
+	}
+	clnt->pack_data = grown;
+	clnt->pack_data_size = *size;
+    }
+    long packed;
+    if (acked_id != 0 && acked_id == base->id) {
+	packed = tcp_pack(*data, *size, base->data, base->size, base->id,
+	    clnt->pack_data, *size);
+    } else {
+	packed = tcp_pack(*data, *size, NULL, 0, 0, clnt->pack_data, *size);
+    }
+    /* The client keeps whatever it is sent, packed or not. */
+    char *grown = (char *) realloc(base->data, *size);
+    if (NULL != grown) {
+	base->data = grown;
+	memcpy(base->data, *data, *size);
+	base->size = *size;
+	base->id = write_id;
+    } else {
+	base->id = 0;
+    }
+    if (packed < 0) {
+	return *size;
+    }
+    *data = clnt->pack_data;
+    *size = packed;
+    return packed | TCP_PACKED_SIZE_FLAG;
+}
+
 #if defined(POSIX_THREADS) || defined(NO_THREADS)
 void *tcpsvr_handle_blocking_request(void *_req)
 {
@@ -578,16 +796,22 @@ void *tcpsvr_handle_blocking_request(void *_req)
 	tcpsvr_threads_returned_early++;
 	return 0;
     }
+    char *reply_data = (char *) read_reply->data;
+    long reply_size = read_reply->size;
     putbe32(temp_buffer, _client_tcp_port->serial_number);
     putbe32(temp_buffer + 4, read_reply->status);
-    putbe32(temp_buffer + 8, read_reply->size);
+    putbe32(temp_buffer + 8,
+	tcpsvr_pack_reply(_client_tcp_port,
+	    blocking_read_req->buffer_number,
+	    blocking_read_req->last_id_read, read_reply->write_id,
+	    &reply_data, &reply_size));
     putbe32(temp_buffer + 12, read_reply->write_id);
     putbe32(temp_buffer + 16, read_reply->was_read);
-    if (read_reply->size < (0x2000 - 20) && read_reply->size > 0) {
-	memcpy(temp_buffer + 20, read_reply->data, read_reply->size);
+    if (reply_size < (0x2000 - 20) && reply_size > 0) {
+	memcpy(temp_buffer + 20, reply_data, reply_size);
 	_client_tcp_port->blocking = 0;
 	if (sendn
-	    (_client_tcp_port->socket_fd, temp_buffer, 20 + read_reply->size,
+	    (_client_tcp_port->socket_fd, temp_buffer, 20 + reply_size,
 		0, dtimeout) < 0) {
 	    _client_tcp_port->blocking = 0;
 	    _client_tcp_port->errors++;
@@ -609,10 +833,10 @@ void *tcpsvr_handle_blocking_request(void *_req)
 	    tcpsvr_threads_returned_early++;
 	    return 0;
 	}
-	if (read_reply->size > 0) {
+	if (reply_size > 0) {
 	    if (sendn
-		(_client_tcp_port->socket_fd, read_reply->data,
-		    read_reply->size, 0, dtimeout) < 0) {
+		(_client_tcp_port->socket_fd, reply_data,
+		    reply_size, 0, dtimeout) < 0) {
 		_client_tcp_port->blocking = 0;
 		_client_tcp_port->errors++;
 		_client_tcp_port->blocking_read_req = NULL;
@@ -641,6 +865,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
     _client_tcp_port)
 {
     CLIENT_TCP_PORT *client_port_to_check = NULL;
+    char *temp_buffer = _client_tcp_port->temp_buffer;
+    pthread_mutex_t *buffer_lock = NULL;
     pid_t pid = getpid();
     pid_t tid = 0;
     CMS_SERVER *server;
@@ -657,22 +883,22 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
     }
 
     if (_client_tcp_port->errors >= _client_tcp_port->max_errors) {
-	rcs_print_error("Too many errors - closing connection(%d)\n",
-	    _client_tcp_port->socket_fd);
+	int fd = _client_tcp_port->socket_fd;
+	rcs_print_error("Too many errors - closing connection(%d)\n", fd);
+	close(fd);
+	current_clients--;
+	FD_CLR(fd, &read_fd_set);
 	client_port_to_check = (CLIENT_TCP_PORT *) client_ports->get_head();
 	while (NULL != client_port_to_check) {
-	    if (client_port_to_check->socket_fd ==
-		_client_tcp_port->socket_fd) {
+	    if (client_port_to_check->socket_fd == fd) {
+		client_port_to_check->socket_fd = -1;
 		delete client_port_to_check;
 		client_ports->delete_current_node();
 	    }
 	    client_port_to_check =
 		(CLIENT_TCP_PORT *) client_ports->get_next();
 	}
-	close(_client_tcp_port->socket_fd);
-	current_clients--;
-	FD_CLR(_client_tcp_port->socket_fd, &read_fd_set);
-	_client_tcp_port->socket_fd = -1;
+	return;
     }
 
     if (recvn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, -1, NULL) < 0) {
@@ -692,14 +918,20 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
 	_client_tcp_port->errors++;
     }
     _client_tcp_port->serial_number++;
-    request_type = ntohl(*((u_long *) temp_buffer + 1));
-    buffer_number = ntohl(*((u_long *) temp_buffer + 2));
+    request_type = getbe32(temp_buffer + 4);
+    buffer_number = getbe32(temp_buffer + 8);
 
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPSVR request recieved: fd = %d, serial_number=%ld, request_type=%ld, buffer_number=%ld\n",
 	_client_tcp_port->socket_fd,
 	_client_tcp_port->serial_number, request_type, buffer_number);
 
+    if (NULL != workers && request_type != REMOTE_CMS_CLOSE_CHANNEL_REQUEST_TYPE
+	&& NULL != server->find_local_port(buffer_number)) {
+	buffer_lock = get_buffer_lock(buffer_number);
+	pthread_mutex_lock(buffer_lock);
+    }
+
     if (NULL != _client_tcp_port->diag_info) {
 	_client_tcp_port->diag_info->buffer_number = buffer_number;
 	server->set_diag_info(_client_tcp_port->diag_info);
@@ -721,6 +953,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
 	    }
 	}
     }
+    if (NULL != buffer_lock) {
+	pthread_mutex_unlock(buffer_lock);
+    }
 }
 
 void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
@@ -730,6 +965,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 {
     int total_subdivisions = 1;
     CLIENT_TCP_PORT *client_port_to_check = NULL;
+    char *temp_buffer = _client_tcp_port->temp_buffer;
+    char *reply_data;
+    long reply_size;
     switch (request_type) {
     case REMOTE_CMS_SET_DIAG_INFO_REQUEST_TYPE:
 	{
@@ -754,9 +992,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    memcpy(_client_tcp_port->diag_info->host_sysinfo,
 		server->set_diag_info_buf + 16, 32);
 	    _client_tcp_port->diag_info->pid =
-		htonl(*((u_long *) (server->set_diag_info_buf + 48)));
+		getbe32(server->set_diag_info_buf + 48);
 	    _client_tcp_port->diag_info->c_num =
-		htonl(*((u_long *) (server->set_diag_info_buf + 52)));
+		getbe32(server->set_diag_info_buf + 52);
 	    memcpy(&(_client_tcp_port->diag_info->rcslib_ver),
 		server->set_diag_info_buf + 56, 8);
 	    _client_tcp_port->diag_info->reverse_flag =
@@ -824,8 +1062,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    dpi_offset += 16;
 		    memcpy(temp_buffer + dpi_offset, dpi->host_sysinfo, 32);
 		    dpi_offset += 32;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->pid);
+		    putbe32(temp_buffer + dpi_offset, dpi->pid);
 		    dpi_offset += 4;
 		    if (_client_tcp_port->diag_info->reverse_flag ==
 			0x44332211) {
@@ -838,23 +1075,17 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 			    8);
 		    }
 		    dpi_offset += 8;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->access_type);
+		    putbe32(temp_buffer + dpi_offset, dpi->access_type);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_id);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_id);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_size);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_size);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_type);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_type);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->number_of_accesses);
+		    putbe32(temp_buffer + dpi_offset, dpi->number_of_accesses);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->number_of_new_messages);
+		    putbe32(temp_buffer + dpi_offset, dpi->number_of_new_messages);
 		    dpi_offset += 4;
 		    if (_client_tcp_port->diag_info->reverse_flag ==
 			0x44332211) {
@@ -924,21 +1155,19 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    dpi_offset += 8;
 		    int is_last_writer =
 			(dpi == diagreply->cdi->last_writer_dpi);
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(is_last_writer);
+		    putbe32(temp_buffer + dpi_offset, is_last_writer);
 		    dpi_offset += 4;
 		    int is_last_reader =
 			(dpi == diagreply->cdi->last_reader_dpi);
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(is_last_reader);
+		    putbe32(temp_buffer + dpi_offset, is_last_reader);
 		    dpi_offset += 4;
 		    dpi =
 			(CMS_DIAG_PROC_INFO *) diagreply->cdi->dpis->
 			get_next();
 		}
 	    }
-	    *((u_long *) temp_buffer + 6) = htonl(dpi_count);
-	    *((u_long *) temp_buffer + 7) = htonl(dpi_offset);
+	    putbe32(temp_buffer + 24, dpi_count);
+	    putbe32(temp_buffer + 28, dpi_offset);
 	    if (sendn
 		(_client_tcp_port->socket_fd, temp_buffer, dpi_offset, 0,
 		    dtimeout) < 0) {
@@ -996,9 +1225,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 #endif
 	    blocking_read_req->buffer_number = buffer_number;
 	    blocking_read_req->access_type =
-		ntohl(*((u_long *) temp_buffer + 3));
+		getbe32(temp_buffer + 12);
 	    blocking_read_req->last_id_read =
-		ntohl(*((u_long *) temp_buffer + 4));
+		getbe32(temp_buffer + 16);
 	    total_subdivisions = 1;
 	    if (max_total_subdivisions > 1) {
 		total_subdivisions =
@@ -1007,7 +1236,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    if (total_subdivisions > 1) {
 		if (recvn
 		    (_client_tcp_port->socket_fd,
-			(char *) (((u_long *) temp_buffer) + 5), 8, 0, -1,
+			temp_buffer + 20, 8, 0, -1,
 			NULL) < 0) {
 		    rcs_print_error
 			("Can not read from client port (%d) from %s\n",
@@ -1017,11 +1246,11 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    return;
 		}
 		blocking_read_req->subdiv =
-		    ntohl(*((u_long *) temp_buffer + 6));
+		    getbe32(temp_buffer + 24);
 	    } else {
 		if (recvn
 		    (_client_tcp_port->socket_fd,
-			(char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
+			temp_buffer + 20, 4, 0, -1,
 			NULL) < 0) {
 		    rcs_print_error
 			("Can not read from client port (%d) from %s\n",
@@ -1032,7 +1261,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		}
 	    }
 	    blocking_read_req->timeout_millis =
-		ntohl(*((u_long *) temp_buffer + 5));
+		getbe32(temp_buffer + 20);
 	    blocking_read_req->server = server;
 	    blocking_read_req->remport = this;
 	    _client_tcp_port->blocking = 1;
@@ -1049,10 +1278,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    thr_retval);
 		rcs_print_error("pthread_create error: %d %s\n", errno,
 		    strerror(errno));
-		*((u_long *) temp_buffer) =
-		    htonl(_client_tcp_port->serial_number);
-		*((u_long *) temp_buffer + 1) =
-		    htonl((unsigned long) CMS_SERVER_SIDE_ERROR);
+		putbe32(temp_buffer, _client_tcp_port->serial_number);
+		putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 		putbe32(temp_buffer + 8, 0);	/* size */
 		putbe32(temp_buffer + 12, 0);	/* write_id */
 		putbe32(temp_buffer + 16, 0);	/* was_read */
@@ -1090,10 +1317,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 #else
 	    rcs_print_error
 		("Blocking read not supported on this platform.\n");
-	    *((u_long *) temp_buffer) =
-		htonl(_client_tcp_port->serial_number);
-	    *((u_long *) temp_buffer + 1) =
-		htonl((unsigned long) CMS_SERVER_SIDE_ERROR);
+	    putbe32(temp_buffer, _client_tcp_port->serial_number);
+	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* size */
 	    putbe32(temp_buffer + 12, 0);	/* write_id */
 	    putbe32(temp_buffer + 16, 0);	/* was_read */
@@ -1107,9 +1332,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	break;
 
     case REMOTE_CMS_READ_REQUEST_TYPE:
+	if (NULL != workers) {
+	    read_unlocked(_client_tcp_port, server, buffer_number);
+	    break;
+	}
 	server->read_req.buffer_number = buffer_number;
-	server->read_req.access_type = ntohl(*((u_long *) temp_buffer + 3));
-	server->read_req.last_id_read = ntohl(*((u_long *) temp_buffer + 4));
+	server->read_req.access_type = getbe32(temp_buffer + 12);
+	server->read_req.last_id_read = getbe32(temp_buffer + 16);
 	server->read_reply =
 	    (REMOTE_READ_REPLY *) server->process_request(&server->read_req);
 	if (max_total_subdivisions > 1) {
@@ -1119,7 +1348,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	if (total_subdivisions > 1) {
 	    if (recvn
 		(_client_tcp_port->socket_fd,
-		    (char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
+		    temp_buffer + 20, 4, 0, -1,
 		    NULL) < 0) {
 		rcs_print_error
 		    ("Can not read from client port (%d) from %s\n",
@@ -1128,7 +1357,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->errors++;
 		return;
 	    }
-	    server->read_req.subdiv = ntohl(*((u_long *) temp_buffer + 5));
+	    server->read_req.subdiv = getbe32(temp_buffer + 20);
 	} else {
 	    server->read_req.subdiv = 0;
 	}
@@ -1142,18 +1371,21 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
 	    return;
 	}
+	reply_data = (char *) server->read_reply->data;
+	reply_size = server->read_reply->size;
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
 	putbe32(temp_buffer + 4, server->read_reply->status);
-	putbe32(temp_buffer + 8, server->read_reply->size);
+	putbe32(temp_buffer + 8,
+	    tcpsvr_pack_reply(_client_tcp_port, buffer_number,
+		server->read_req.last_id_read, server->read_reply->write_id,
+		&reply_data, &reply_size));
 	putbe32(temp_buffer + 12, server->read_reply->write_id);
 	putbe32(temp_buffer + 16, server->read_reply->was_read);
-	if (server->read_reply->size < (0x2000 - 20)
-	    && server->read_reply->size > 0) {
-	    memcpy(temp_buffer + 20, server->read_reply->data,
-		server->read_reply->size);
+	if (reply_size < (0x2000 - 20) && reply_size > 0) {
+	    memcpy(temp_buffer + 20, reply_data, reply_size);
 	    if (sendn
 		(_client_tcp_port->socket_fd, temp_buffer,
-		    20 + server->read_reply->size, 0, dtimeout) < 0) {
+		    20 + reply_size, 0, dtimeout) < 0) {
 		_client_tcp_port->errors++;
 		return;
 	    }
@@ -1164,10 +1396,10 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->errors++;
 		return;
 	    }
-	    if (server->read_reply->size > 0) {
+	    if (reply_size > 0) {
 		if (sendn
-		    (_client_tcp_port->socket_fd, server->read_reply->data,
-			server->read_reply->size, 0, dtimeout) < 0) {
+		    (_client_tcp_port->socket_fd, reply_data,
+			reply_size, 0, dtimeout) < 0) {
 		    _client_tcp_port->errors++;
 		    return;
 		}
@@ -1177,8 +1409,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 
     case REMOTE_CMS_WRITE_REQUEST_TYPE:
 	server->write_req.buffer_number = buffer_number;
-	server->write_req.access_type = ntohl(*((u_long *) temp_buffer + 3));
-	server->write_req.size = ntohl(*((u_long *) temp_buffer + 4));
+	server->write_req.access_type = getbe32(temp_buffer + 12);
+	server->write_req.size = getbe32(temp_buffer + 16);
 	total_subdivisions = 1;
 	if (max_total_subdivisions > 1) {
 	    total_subdivisions =
@@ -1187,7 +1419,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	if (total_subdivisions > 1) {
 	    if (recvn
 		(_client_tcp_port->socket_fd,
-		    (char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
+		    temp_buffer + 20, 4, 0, -1,
 		    NULL) < 0) {
 		rcs_print_error
 		    ("Can not read from client port (%d) from %s\n",
@@ -1196,7 +1428,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->errors++;
 		return;
 	    }
-	    server->write_req.subdiv = ntohl(*((u_long *) temp_buffer + 5));
+	    server->write_req.subdiv = getbe32(temp_buffer + 20);
 	} else {
 	    server->write_req.subdiv = 0;
 	}
@@ -1239,7 +1471,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_CHECK_IF_READ_REQUEST_TYPE:
 	server->check_if_read_req.buffer_number = buffer_number;
 	server->check_if_read_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->check_if_read_reply =
 	    (REMOTE_CHECK_IF_READ_REPLY *) server->process_request(&server->
 	    check_if_read_req);
@@ -1252,10 +1484,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->check_if_read_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->check_if_read_reply->was_read);
+	putbe32(temp_buffer + 4, server->check_if_read_reply->status);
+	putbe32(temp_buffer + 8, server->check_if_read_reply->was_read);
 	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
 	    0) {
 	    _client_tcp_port->errors++;
@@ -1265,7 +1495,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_MSG_COUNT_REQUEST_TYPE:
 	server->get_msg_count_req.buffer_number = buffer_number;
 	server->get_msg_count_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_msg_count_reply =
 	    (REMOTE_GET_MSG_COUNT_REPLY *) server->process_request(&server->
 	    get_msg_count_req);
@@ -1278,10 +1508,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_msg_count_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_msg_count_reply->count);
+	putbe32(temp_buffer + 4, server->get_msg_count_reply->status);
+	putbe32(temp_buffer + 8, server->get_msg_count_reply->count);
 	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
 	    0) {
 	    _client_tcp_port->errors++;
@@ -1291,7 +1519,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_QUEUE_LENGTH_REQUEST_TYPE:
 	server->get_queue_length_req.buffer_number = buffer_number;
 	server->get_queue_length_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_queue_length_reply =
 	    (REMOTE_GET_QUEUE_LENGTH_REPLY *) server->
 	    process_request(&server->get_queue_length_req);
@@ -1304,10 +1532,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_queue_length_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_queue_length_reply->queue_length);
+	putbe32(temp_buffer + 4, server->get_queue_length_reply->status);
+	putbe32(temp_buffer + 8, server->get_queue_length_reply->queue_length);
 	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
 	    0) {
 	    _client_tcp_port->errors++;
@@ -1317,7 +1543,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_SPACE_AVAILABLE_REQUEST_TYPE:
 	server->get_space_available_req.buffer_number = buffer_number;
 	server->get_space_available_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_space_available_reply =
 	    (REMOTE_GET_SPACE_AVAILABLE_REPLY *) server->
 	    process_request(&server->get_space_available_req);
@@ -1330,10 +1556,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_space_available_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_space_available_reply->space_available);
+	putbe32(temp_buffer + 4, server->get_space_available_reply->status);
+	putbe32(temp_buffer + 8, server->get_space_available_reply->space_available);
 	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
 	    0) {
 	    _client_tcp_port->errors++;
@@ -1342,7 +1566,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 
     case REMOTE_CMS_CLEAR_REQUEST_TYPE:
 	server->clear_req.buffer_number = buffer_number;
-	server->clear_req.subdiv = ntohl(*((u_long *) temp_buffer + 3));
+	server->clear_req.subdiv = getbe32(temp_buffer + 12);
 	server->clear_reply =
 	    (REMOTE_CLEAR_REPLY *) server->process_request(&server->
 	    clear_req);
@@ -1450,9 +1674,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_SET_SUBSCRIPTION_REQUEST_TYPE:
 	server->set_subscription_req.buffer_number = buffer_number;
 	server->set_subscription_req.subscription_type =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->set_subscription_req.poll_interval_millis =
-	    ntohl(*((u_long *) temp_buffer + 4));
+	    getbe32(temp_buffer + 16);
 	server->set_subscription_reply =
 	    (REMOTE_SET_SUBSCRIPTION_REPLY *) server->
 	    process_request(&server->set_subscription_req);
@@ -1481,14 +1705,20 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		}
 	    }
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
-	    *((u_long *) temp_buffer + 1) =
-		htonl(server->set_subscription_reply->success);
+	    putbe32(temp_buffer + 4, server->set_subscription_reply->success);
 	    /* successful ? */
 	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
 	    return;
 	}
 	break;
 
+    case REMOTE_CMS_SET_DELTA_REQUEST_TYPE:
+	_client_tcp_port->delta = getbe32(temp_buffer + 12);
+	putbe32(temp_buffer, _client_tcp_port->serial_number);
+	putbe32(temp_buffer + 4, 1);	/* successful */
+	sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	return;
+
     default:
 	_client_tcp_port->errors++;
 	rcs_print_error("Unrecognized request type received.(%ld)\n",
@@ -1552,6 +1782,12 @@ void CMS_SERVER_REMOTE_TCP_PORT::add_subscription_client(int buffer_number,
 	buf_info->sub_clnt_info->store_at_tail(temp_clnt_info,
 	    sizeof(*temp_clnt_info), 0);
     }
+    /* Older clients always sent the 30 second default with sub=var,
+       which predates the minimum interval; treat it as no limit. */
+    if (subscription_type == CMS_VARIABLE_SUBSCRIPTION &&
+	poll_interval_millis >= 30000) {
+	poll_interval_millis = 0;
+    }
     temp_clnt_info->subscription_type = subscription_type;
     temp_clnt_info->poll_interval_millis = poll_interval_millis;
     recalculate_polling_interval();
@@ -1589,12 +1825,152 @@ void CMS_SERVER_REMOTE_TCP_PORT::remove_subscription_client(CLIENT_TCP_PORT *
     recalculate_polling_interval();
 }
 
+/* Called from update_subscriptions().  Checks each published buffer
+   that is due, and sends a message that is new, or the last one again
+   unpacked when a keyframe is due.  Datagrams are sent without
+   waiting, so a full socket only costs viewers a message. */
+void CMS_SERVER_REMOTE_TCP_PORT::publish_mcast(CMS_SERVER * server,
+    double cur_time)
+{
+    TCP_MCAST_PUBLISHER *pub =
+	(TCP_MCAST_PUBLISHER *) mcast_publishers->get_head();
+    for (; NULL != pub;
+	pub = (TCP_MCAST_PUBLISHER *) mcast_publishers->get_next()) {
+	if (cur_time - pub->last_check_time < pub->interval) {
+	    continue;
+	}
+	pub->last_check_time = cur_time;
+	int keyframe =
+	    cur_time - pub->last_keyframe_time >= pub->keyframe_interval;
+	unsigned long write_id = pub->last_id;
+	long size = pub->base_size;
+	const char *data = pub->base;
+
+	pthread_mutex_t *buffer_lock = NULL;
+	if (NULL != workers
+	    && NULL != server->find_local_port(pub->buffer_number)) {
+	    buffer_lock = get_buffer_lock(pub->buffer_number);
+	    pthread_mutex_lock(buffer_lock);
+	}
+	server->read_req.buffer_number = pub->buffer_number;
+	server->read_req.access_type = CMS_PEEK_ACCESS;
+	server->read_req.last_id_read = pub->last_id;
+	server->read_req.subdiv = 0;
+	server->read_reply =
+	    (REMOTE_READ_REPLY *) server->process_request(&server->read_req);
+	REMOTE_READ_REPLY *read_reply = server->read_reply;
+	if (NULL != read_reply && read_reply->size > 0
+	    && (unsigned long) read_reply->write_id != pub->last_id) {
+	    write_id = read_reply->write_id;
+	    size = read_reply->size;
+	    data = (const char *) read_reply->data;
+	}
+	if (size <= 0 || (write_id == pub->last_id && !keyframe)) {
+	    if (NULL != buffer_lock) {
+		pthread_mutex_unlock(buffer_lock);
+	    }
+	    continue;
+	}
+	if (size > pub->packed_size) {
+	    char *grown = (char *) realloc(pub->packed, size);
+	    if (NULL == grown) {
+		if (NULL != buffer_lock) {
+		    pthread_mutex_unlock(buffer_lock);
+		}
+		continue;
+	    }
+	    pub->packed = grown;
+	    pub->packed_size = size;
+	}
+	long packed;
+	if (keyframe || 0 == pub->last_id) {
+	    packed = tcp_pack(data, size, NULL, 0, 0, pub->packed, size);
+	} else {
+	    packed = tcp_pack(data, size, pub->base, pub->base_size,
+		pub->last_id, pub->packed, size);
+	}
+	long size_field = size;
+	if (packed >= 0) {
+	    size_field = packed | TCP_PACKED_SIZE_FLAG;
+	} else {
+	    /* Not shorter, so send it as it is. */
+	    packed = size;
+	    memcpy(pub->packed, data, size);
+	}
+	if (data != pub->base) {
+	    char *grown = (char *) realloc(pub->base, size);
+	    if (NULL == grown) {
+		pub->last_id = 0;
+	    } else {
+		pub->base = grown;
+		memcpy(pub->base, data, size);
+		pub->base_size = size;
+		pub->last_id = write_id;
+	    }
+	}
+	if (NULL != buffer_lock) {
+	    pthread_mutex_unlock(buffer_lock);
+	}
+	if (keyframe) {
+	    pub->last_keyframe_time = cur_time;
+	}
+
+	pub->seq++;
+	long fragments = (packed + NML_MCAST_FRAGMENT_SIZE - 1) /
+	    NML_MCAST_FRAGMENT_SIZE;
+	if (fragments > 0xffff) {
+	    rcs_print_error("TCP server: buffer %ld is too big to publish.\n",
+		pub->buffer_number);
+	    continue;
+	}
+	char datagram[NML_MCAST_DATAGRAM_SIZE];
+	putbe32(datagram, NML_MCAST_MAGIC);
+	putbe32(datagram + 4, pub->buffer_number);
+	putbe32(datagram + 8, pub->seq);
+	putbe32(datagram + 12, write_id);
+	putbe32(datagram + 16, size_field);
+	for (long i = 0; i < fragments; i++) {
+	    long offset = i * NML_MCAST_FRAGMENT_SIZE;
+	    long length = packed - offset;
+	    if (length > NML_MCAST_FRAGMENT_SIZE) {
+		length = NML_MCAST_FRAGMENT_SIZE;
+	    }
+	    putbe32(datagram + 20, (i << 16) | fragments);
+	    memcpy(datagram + NML_MCAST_HEADER_SIZE, pub->packed + offset,
+		length);
+	    if (sendto(pub->socket_fd, datagram,
+		    NML_MCAST_HEADER_SIZE + length, MSG_DONTWAIT,
+		    (struct sockaddr *) &pub->address,
+		    sizeof(pub->address)) < 0 && errno != EAGAIN) {
+		rcs_print_debug(PRINT_SERVER_SUBSCRIPTION_ACTIVITY,
+		    "TCP server: can't publish buffer %ld: %s\n",
+		    pub->buffer_number, strerror(errno));
+		break;
+	    }
+	}
+    }
+}
+
 void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
 {
     int min_poll_interval_millis = 30000;
     polling_enabled = 0;
-    TCP_BUFFER_SUBSCRIPTION_INFO *buf_info =
-	(TCP_BUFFER_SUBSCRIPTION_INFO *) subscription_buffers->get_head();
+    if (NULL != mcast_publishers) {
+	TCP_MCAST_PUBLISHER *pub =
+	    (TCP_MCAST_PUBLISHER *) mcast_publishers->get_head();
+	while (NULL != pub) {
+	    if ((int) (pub->interval * 1000.0) < min_poll_interval_millis) {
+		min_poll_interval_millis = (int) (pub->interval * 1000.0);
+	    }
+	    polling_enabled = 1;
+	    pub = (TCP_MCAST_PUBLISHER *) mcast_publishers->get_next();
+	}
+    }
+    TCP_BUFFER_SUBSCRIPTION_INFO *buf_info = NULL;
+    if (NULL != subscription_buffers) {
+	buf_info = (TCP_BUFFER_SUBSCRIPTION_INFO *)
+	    subscription_buffers->get_head();
+    }
     while (NULL != buf_info) {
 	TCP_CLIENT_SUBSCRIPTION_INFO *temp_clnt_info =
 	    (TCP_CLIENT_SUBSCRIPTION_INFO *) buf_info->sub_clnt_info->
@@ -1608,6 +1984,19 @@ void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
 		    temp_clnt_info->poll_interval_millis;
 		polling_enabled = 1;
 	    }
+	    /* Variable subscriptions are sent whenever the buffer changes.
+	       Local writers do not go through this server, so check for
+	       new data at the subscriber's minimum interval, or at the
+	       fastest rate the clock allows if it has none. */
+	    if (temp_clnt_info->subscription_type ==
+		CMS_VARIABLE_SUBSCRIPTION) {
+		if (temp_clnt_info->poll_interval_millis <
+		    min_poll_interval_millis) {
+		    min_poll_interval_millis =
+			temp_clnt_info->poll_interval_millis;
+		}
+		polling_enabled = 1;
+	    }
 	    temp_clnt_info = (TCP_CLIENT_SUBSCRIPTION_INFO *)
 		buf_info->sub_clnt_info->get_next();
 	}
@@ -1621,7 +2010,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
     }
     select_timeout.tv_sec = current_poll_interval_millis / 1000;
     select_timeout.tv_usec = (current_poll_interval_millis % 1000) * 1000;
-    dtimeout = (current_poll_interval_millis + 10) * 1000.0;
+    dtimeout = (current_poll_interval_millis + 10) / 1000.0;
     if (dtimeout < 0.5) {
 	dtimeout = 0.5;
     }
@@ -1639,13 +2028,22 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
 	    pid);
 	return;
     }
+    double cur_time = etime();
+    if (NULL != mcast_publishers) {
+	publish_mcast(server, cur_time);
+    }
     if (NULL == subscription_buffers) {
 	return;
     }
-    double cur_time = etime();
     TCP_BUFFER_SUBSCRIPTION_INFO *buf_info =
 	(TCP_BUFFER_SUBSCRIPTION_INFO *) subscription_buffers->get_head();
     while (NULL != buf_info) {
+	pthread_mutex_t *buffer_lock = NULL;
+	if (NULL != workers
+	    && NULL != server->find_local_port(buf_info->buffer_number)) {
+	    buffer_lock = get_buffer_lock(buf_info->buffer_number);
+	    pthread_mutex_lock(buffer_lock);
+	}
 	server->read_req.buffer_number = buf_info->buffer_number;
 	server->read_req.access_type = CMS_READ_ACCESS;
 	server->read_req.last_id_read = buf_info->min_last_id;
@@ -1653,12 +2051,18 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
 	    (REMOTE_READ_REPLY *) server->process_request(&server->read_req);
 	if (NULL == server->read_reply) {
 	    rcs_print_error("Server could not process request.\n");
+	    if (NULL != buffer_lock) {
+	        pthread_mutex_unlock(buffer_lock);
+	    }
 	    buf_info = (TCP_BUFFER_SUBSCRIPTION_INFO *)
 		subscription_buffers->get_next();
 	    continue;
 	}
 	if (server->read_reply->write_id == buf_info->min_last_id ||
 	    server->read_reply->size < 1) {
+	    if (NULL != buffer_lock) {
+	        pthread_mutex_unlock(buffer_lock);
+	    }
 	    buf_info = (TCP_BUFFER_SUBSCRIPTION_INFO *)
 		subscription_buffers->get_next();
 	    continue;
@@ -1673,42 +2077,72 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
 	    get_head();
 	buf_info->min_last_id = server->read_reply->write_id;
 	while (temp_clnt_info != NULL) {
+	    /* A worker is using its socket; it gets this next time. */
+	    if (temp_clnt_info->clnt_port->busy) {
+		if (temp_clnt_info->last_id_read < buf_info->min_last_id) {
+		    buf_info->min_last_id = temp_clnt_info->last_id_read;
+		}
+		temp_clnt_info = (TCP_CLIENT_SUBSCRIPTION_INFO *)
+		    buf_info->sub_clnt_info->get_next();
+		continue;
+	    }
 	    double time_diff = cur_time - temp_clnt_info->last_sub_sent_time;
 	    int time_diff_millis = (int) ((double) time_diff * 1000.0);
 	    rcs_print_debug(PRINT_SERVER_SUBSCRIPTION_ACTIVITY,
 		"Subscription time_diff_millis=%d\n", time_diff_millis);
+	    /* A variable subscriber's poll_interval_millis is a minimum
+	       spacing between updates. Changes that arrive sooner are
+	       coalesced: its last_id_read stays behind, which holds
+	       min_last_id back until the latest value has been sent. */
 	    if (((temp_clnt_info->subscription_type == CMS_POLLED_SUBSCRIPTION
 			&& time_diff_millis + 10 >=
 			temp_clnt_info->poll_interval_millis)
-		    || temp_clnt_info->subscription_type ==
-		    CMS_VARIABLE_SUBSCRIPTION)
+		    || (temp_clnt_info->subscription_type ==
+			CMS_VARIABLE_SUBSCRIPTION
+			&& time_diff_millis >=
+			temp_clnt_info->poll_interval_millis))
 		&& temp_clnt_info->last_id_read !=
 		server->read_reply->write_id) {
 		temp_clnt_info->last_id_read = server->read_reply->write_id;
 		temp_clnt_info->last_sub_sent_time = cur_time;
 		temp_clnt_info->clnt_port->serial_number++;
 		putbe32(temp_buffer, temp_clnt_info->clnt_port->serial_number);
-		if (server->read_reply->size < 0x2000 - 20
-		    && server->read_reply->size > 0) {
-		    memcpy(temp_buffer + 20, server->read_reply->data,
-			server->read_reply->size);
+		/* Which reply the client holds isn't known here, so
+		   this is packed against none. */
+		char *reply_data = (char *) server->read_reply->data;
+		long reply_size = server->read_reply->size;
+		putbe32(temp_buffer + 8,
+		    tcpsvr_pack_reply(temp_clnt_info->clnt_port,
+			buf_info->buffer_number, 0,
+			server->read_reply->write_id, &reply_data,
+			&reply_size));
+		if (reply_size < 0x2000 - 20 && reply_size > 0) {
+		    memcpy(temp_buffer + 20, reply_data, reply_size);
 		    if (sendn
 			(temp_clnt_info->clnt_port->socket_fd, temp_buffer,
-			    20 + server->read_reply->size, 0, dtimeout) < 0) {
+			    20 + reply_size, 0, dtimeout) < 0) {
 			temp_clnt_info->clnt_port->errors++;
+			if (NULL != buffer_lock) {
+			    pthread_mutex_unlock(buffer_lock);
+			}
 			return;
 		    }
 		} else {
 		    if (sendn(temp_clnt_info->clnt_port->socket_fd,
 			    temp_buffer, 20, 0, dtimeout) < 0) {
 			temp_clnt_info->clnt_port->errors++;
+			if (NULL != buffer_lock) {
+			    pthread_mutex_unlock(buffer_lock);
+			}
 			return;
 		    }
-		    if (server->read_reply->size > 0) {
+		    if (reply_size > 0) {
 			if (sendn(temp_clnt_info->clnt_port->socket_fd,
-				server->read_reply->data,
-				server->read_reply->size, 0, dtimeout) < 0) {
+				reply_data, reply_size, 0, dtimeout) < 0) {
 			    temp_clnt_info->clnt_port->errors++;
+			    if (NULL != buffer_lock) {
+			        pthread_mutex_unlock(buffer_lock);
+			    }
 			    return;
 			}
 		    }
@@ -1720,11 +2154,259 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
 	    temp_clnt_info = (TCP_CLIENT_SUBSCRIPTION_INFO *)
 		buf_info->sub_clnt_info->get_next();
 	}
+	if (NULL != buffer_lock) {
+	    pthread_mutex_unlock(buffer_lock);
+	}
 	buf_info =
 	    (TCP_BUFFER_SUBSCRIPTION_INFO *) subscription_buffers->get_next();
     }
 }
 
+void CMS_SERVER_REMOTE_TCP_PORT::start_workers()
+{
+    if (server_threads < 1 || NULL != workers) {
+	return;
+    }
+    if (pipe(wake_fds) < 0) {
+	rcs_print_error("TCP server: pipe error: %d -- %s\n", errno,
+	    strerror(errno));
+	wake_fds[0] = wake_fds[1] = -1;
+	return;
+    }
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+    ready_clients = new LinkedList;
+    workers = new pthread_t[server_threads];
+
+    /* Workers inherit this mask, leaving SIGINT and friends to run(). */
+    sigset_t all_signals, old_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+    int started = 0;
+    for (int i = 0; i < server_threads; i++) {
+	__sync_fetch_and_add(&workers_running, 1);
+	int thr_retval = pthread_create(&workers[i], NULL, worker_main, this);
+	if (thr_retval != 0) {
+	    __sync_fetch_and_sub(&workers_running, 1);
+	    rcs_print_error("pthread_create error: thr_retval = %d\n",
+		thr_retval);
+	    break;
+	}
+	pthread_detach(workers[i]);
+	started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    if (0 == started) {
+	rcs_print_error
+	    ("TCP server on port %d could not start workers, serving requests itself.\n",
+	    ntohs(server_socket_address.sin_port));
+	delete[]workers;
+	workers = NULL;
+	return;
+    }
+    rcs_print_debug(PRINT_CMS_CONFIG_INFO,
+	"TCP server on port %d using %d worker threads.\n",
+	ntohs(server_socket_address.sin_port), started);
+}
+
+void CMS_SERVER_REMOTE_TCP_PORT::stop_workers()
+{
+    if (NULL == workers) {
+	return;
+    }
+    workers_exit = 1;
+    pthread_cond_broadcast(&clients_ready);
+
+    /* Not joined: this may run from clean() having interrupted run()
+       with state_mutex held, so only wait a little for them. */
+    double give_up = etime() + 1.0;
+    while (workers_running > 0 && etime() < give_up) {
+	esleep(0.01);
+    }
+}
+
+void *CMS_SERVER_REMOTE_TCP_PORT::worker_main(void *arg)
+{
+    CMS_SERVER_REMOTE_TCP_PORT *port = (CMS_SERVER_REMOTE_TCP_PORT *) arg;
+    CLIENT_TCP_PORT *client, *client_port_to_check;
+    char wake = 0;
+
+    pthread_mutex_lock(&port->state_mutex);
+    while (!port->workers_exit) {
+	client = (CLIENT_TCP_PORT *) port->ready_clients->get_head();
+	if (NULL == client) {
+	    pthread_cond_wait(&port->clients_ready, &port->state_mutex);
+	    continue;
+	}
+	port->ready_clients->delete_current_node();
+	port->handle_request(client);
+
+	/* The request may have closed the channel and deleted the
+	   client. */
+	client_port_to_check =
+	    (CLIENT_TCP_PORT *) port->client_ports->get_head();
+	while (NULL != client_port_to_check && client_port_to_check != client) {
+	    client_port_to_check =
+		(CLIENT_TCP_PORT *) port->client_ports->get_next();
+	}
+	if (NULL != client_port_to_check) {
+	    client_port_to_check->busy = 0;
+	}
+	if (write(port->wake_fds[1], &wake, 1) < 0 && errno != EAGAIN) {
+	    rcs_print_error("TCP server: write error: %d -- %s\n", errno,
+		strerror(errno));
+	}
+    }
+    pthread_mutex_unlock(&port->state_mutex);
+    __sync_fetch_and_sub(&port->workers_running, 1);
+    return NULL;
+}
+
+/* Called with state_mutex held.  The locks are kept until the port is
+   deleted, so the pointer stays good after state_mutex is released. */
+pthread_mutex_t *CMS_SERVER_REMOTE_TCP_PORT::get_buffer_lock(long
+    buffer_number)
+{
+    if (NULL == buffer_locks) {
+	buffer_locks = new LinkedList;
+    }
+    TCP_BUFFER_LOCK *lock = (TCP_BUFFER_LOCK *) buffer_locks->get_head();
+    while (NULL != lock) {
+	if (lock->buffer_number == buffer_number) {
+	    return &lock->mutex;
+	}
+	lock = (TCP_BUFFER_LOCK *) buffer_locks->get_next();
+    }
+    lock = new TCP_BUFFER_LOCK;
+    lock->buffer_number = buffer_number;
+    pthread_mutex_init(&lock->mutex, NULL);
+    buffer_locks->store_at_tail(lock, sizeof(lock), 0);
+    return &lock->mutex;
+}
+
+/* A read request for the threaded server.  Called with state_mutex and
+   the buffer's lock held, and returns with both held again, but drops
+   state_mutex while the buffer is read and encoded and the buffer's lock
+   too while the reply is sent, so neither a large buffer nor a slow
+   client holds up requests on other buffers. */
+void CMS_SERVER_REMOTE_TCP_PORT::read_unlocked(CLIENT_TCP_PORT *
+    _client_tcp_port, CMS_SERVER * server, long buffer_number)
+{
+    char *temp_buffer = _client_tcp_port->temp_buffer;
+    REMOTE_READ_REQUEST read_req;
+    int total_subdivisions = 1;
+
+    read_req.buffer_number = buffer_number;
+    read_req.access_type = getbe32(temp_buffer + 12);
+    read_req.last_id_read = getbe32(temp_buffer + 16);
+    if (max_total_subdivisions > 1) {
+	total_subdivisions = server->get_total_subdivisions(buffer_number);
+    }
+    if (total_subdivisions > 1) {
+	if (recvn
+	    (_client_tcp_port->socket_fd,
+		temp_buffer + 20, 4, 0, -1, NULL) < 0) {
+	    rcs_print_error("Can not read from client port (%d) from %s\n",
+		_client_tcp_port->socket_fd,
+		inet_ntoa(_client_tcp_port->address.sin_addr));
+	    _client_tcp_port->errors++;
+	    return;
+	}
+	read_req.subdiv = getbe32(temp_buffer + 20);
+    }
+
+    CMS_SERVER_LOCAL_PORT *local_port = server->check_request(&read_req);
+    if (NULL == local_port) {
+	rcs_print_error("Server could not process request.\n");
+	putbe32(temp_buffer, _client_tcp_port->serial_number);
+	putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
+	putbe32(temp_buffer + 8, 0);
+	putbe32(temp_buffer + 12, 0);
+	putbe32(temp_buffer + 16, 0);
+	sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
+	return;
+    }
+    pthread_mutex_t *buffer_lock = get_buffer_lock(buffer_number);
+    long serial_number = _client_tcp_port->serial_number;
+    double send_timeout = dtimeout;
+    pthread_mutex_unlock(&state_mutex);
+
+    REMOTE_READ_REPLY *read_reply =
+	server->read_local_port(local_port, &read_req);
+    long size = 0;
+    char *data = NULL;
+    if (NULL != read_reply) {
+	putbe32(temp_buffer, serial_number);
+	putbe32(temp_buffer + 4, read_reply->status);
+	putbe32(temp_buffer + 8, read_reply->size);
+	putbe32(temp_buffer + 12, read_reply->write_id);
+	putbe32(temp_buffer + 16, read_reply->was_read);
+	if (read_reply->size > 0) {
+	    size = read_reply->size;
+	}
+	if (size < (0x2000 - 20)) {
+	    data = temp_buffer + 20;
+	} else {
+	    if (size > _client_tcp_port->reply_data_size) {
+		char *grown =
+		    (char *) realloc(_client_tcp_port->reply_data, size);
+		if (NULL != grown) {
+		    _client_tcp_port->reply_data = grown;
+		    _client_tcp_port->reply_data_size = size;
+		}
+	    }
+	    if (size <= _client_tcp_port->reply_data_size) {
+		data = _client_tcp_port->reply_data;
+	    } else {
+		rcs_print_error("TCP server: can't malloc %ld bytes.\n",
+		    size);
+		read_reply = NULL;
+	    }
+	}
+	if (NULL != data && size > 0) {
+	    memcpy(data, read_reply->data, size);
+	}
+    }
+    pthread_mutex_unlock(buffer_lock);
+
+    if (NULL != read_reply && NULL != data) {
+	long packed_size = tcpsvr_pack_reply(_client_tcp_port,
+	    buffer_number, read_req.last_id_read, getbe32(temp_buffer + 12),
+	    &data, &size);
+	putbe32(temp_buffer + 8, packed_size);
+	if (data != temp_buffer + 20 && size < (0x2000 - 20)) {
+	    memcpy(temp_buffer + 20, data, size);
+	    data = temp_buffer + 20;
+	}
+    }
+
+    if (NULL == read_reply) {
+	rcs_print_error("Server could not process request.\n");
+	putbe32(temp_buffer, serial_number);
+	putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
+	putbe32(temp_buffer + 8, 0);
+	putbe32(temp_buffer + 12, 0);
+	putbe32(temp_buffer + 16, 0);
+	sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, send_timeout);
+    } else if (data == temp_buffer + 20) {
+	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 20 + size, 0,
+		send_timeout) < 0) {
+	    _client_tcp_port->errors++;
+	}
+    } else {
+	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0,
+		send_timeout) < 0
+	    || sendn(_client_tcp_port->socket_fd, data, size, 0,
+		send_timeout) < 0) {
+	    _client_tcp_port->errors++;
+	}
+    }
+
+    pthread_mutex_lock(&state_mutex);
+    pthread_mutex_lock(buffer_lock);
+}
+
 TCP_BUFFER_SUBSCRIPTION_INFO::TCP_BUFFER_SUBSCRIPTION_INFO()
 {
     buffer_number = -1;
@@ -1785,6 +2467,13 @@ CLIENT_TCP_PORT::CLIENT_TCP_PORT()
     blocking_read_req = NULL;
     threadId = 0;
     diag_info = NULL;
+    busy = 0;
+    reply_data = NULL;
+    reply_data_size = 0;
+    delta = 0;
+    delta_bases = NULL;
+    pack_data = NULL;
+    pack_data_size = 0;
 }
 
 CLIENT_TCP_PORT::~CLIENT_TCP_PORT()
@@ -1814,4 +2503,22 @@ CLIENT_TCP_PORT::~CLIENT_TCP_PORT()
 	delete diag_info;
 	diag_info = NULL;
     }
+    if (NULL != reply_data) {
+	free(reply_data);
+	reply_data = NULL;
+    }
+    if (NULL != delta_bases) {
+	TCP_DELTA_BASE *base = (TCP_DELTA_BASE *) delta_bases->get_head();
+	while (NULL != base) {
+	    free(base->data);
+	    delete base;
+	    base = (TCP_DELTA_BASE *) delta_bases->get_next();
+	}
+	delete delta_bases;
+	delta_bases = NULL;
+    }
+    if (NULL != pack_data) {
+	free(pack_data);
+	pack_data = NULL;
+    }
 }
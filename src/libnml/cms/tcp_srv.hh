@@ -28,6 +28,7 @@ extern "C" {
 #include <errno.h>		/* errno */
 #include <signal.h>		// SIGPIPE, signal()
 #include <sys/time.h>           /* struct timeval */
+#include <pthread.h>		/* pthread_mutex_t */
 
 #ifdef __cplusplus
 }
@@ -77,6 +78,34 @@ class CMS_SERVER_REMOTE_TCP_PORT:public CMS_SERVER_REMOTE_PORT {
 	_client_tcp_port,
 	CMS_SERVER * server, long request_type, long buffer_number, long
 	received_serial_number);
+
+    /* With SERVER_THREADS=n on a buffer line, run() only waits for
+       sockets and hands readable clients to n workers.  state_mutex is
+       held by whoever is touching the server, the client list or the
+       subscriptions, i.e. all the time except while run() is in
+       select() and while a worker encodes and sends a read reply.
+       Requests on the same buffer are still served one at a time under
+       that buffer's lock. */
+    int server_threads;
+    pthread_t *workers;
+    pthread_mutex_t state_mutex;
+    pthread_cond_t clients_ready;
+    LinkedList *ready_clients;
+    LinkedList *buffer_locks;
+    int wake_fds[2];		/* workers tell run() a client is free */
+    int workers_exit;
+    int workers_running;
+    void start_workers();
+    void stop_workers();
+    static void *worker_main(void *);
+    pthread_mutex_t *get_buffer_lock(long buffer_number);
+    void read_unlocked(CLIENT_TCP_PORT * _client_tcp_port,
+	CMS_SERVER * server, long buffer_number);
+
+    /* Buffers with MCAST= on their line, see mcast.hh. */
+    LinkedList *mcast_publishers;
+    void add_mcast_publisher(CMS *);
+    void publish_mcast(CMS_SERVER * server, double cur_time);
 };
 
 class TCP_BUFFER_SUBSCRIPTION_INFO {
@@ -126,6 +155,20 @@ class CLIENT_TCP_PORT {
     TCPSVR_BLOCKING_READ_REQUEST *blocking_read_req;
     REMOTE_SET_DIAG_INFO_REQUEST *diag_info;
 
+    /* For the threaded server: set while a worker owns the client, and
+       that worker's buffers. */
+    int busy;
+    char temp_buffer[0x2000];
+    char *reply_data;
+    long reply_data_size;
+
+    /* Set by REMOTE_CMS_SET_DELTA_REQUEST_TYPE: read replies to this
+       client are packed (see tcp_pack.hh) against what it was last
+       sent from the same buffer, kept in delta_bases. */
+    int delta;
+    LinkedList *delta_bases;
+    char *pack_data;
+    long pack_data_size;
 };
 
 class TCPSVR_BLOCKING_READ_REQUEST:public REMOTE_BLOCKING_READ_REQUEST {
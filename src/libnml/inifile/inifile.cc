@@ -18,36 +18,73 @@
 #include <string.h>             /* strstr() */
 #include <ctype.h>              /* isspace() */
 #include <fcntl.h>
+#include <sys/stat.h>               /* fstat() */
+#include <string>
+#include <vector>
+#include <map>
 
 
 #include "config.h"
 #include "inifile.hh"
 
 /// Return TRUE if the line has a line-ending problem
-static bool check_line_endings(const char *s) {
+static bool check_line_endings(const char *s, bool report = true) {
     if(!s) return false;
     for(; *s; s++ ) {
         if(*s == '\r') {
             char c = s[1];
             if(c == '\n' || c == '\0') {
                 static bool warned = 0;
-                if(!warned) 
+                if(!warned && report) {
                     fprintf(stderr, "inifile: warning: File contains DOS-style line endings.\n");
-                warned = true;
+                    warned = true;
+                }
                 continue;
             }
-            fprintf(stderr, "inifile: error: File contains ambiguous carriage returns\n");
+            if(report)
+                fprintf(stderr, "inifile: error: File contains ambiguous carriage returns\n");
             return true;
         }
     }
     return false;
 }
 
+
+/*! In-memory copy of an ini file, shared by every IniFile that opens the
+   same path while the file is unchanged. Find() reads lines from here
+   instead of rewinding and re-reading the file, and goes straight to
+   a section through the sections index.
+
+   Lines are kept exactly as fgets() returned them, so Find() behaves the
+   same as when reading the file. */
+struct IniIndex {
+    std::string                 path;
+    dev_t                       dev;            // identify the file version
+    ino_t                       ino;
+    off_t                       size;
+    struct timespec             mtime;
+
+    int                         refs;           // IniFiles using this copy
+    bool                        detached;       // no longer in the cache
+    bool                        unterminated;   // no newline at the end
+    bool                        strayCr;        // check_line_endings fails
+
+    std::vector<std::string>    lines;
+    std::map<std::string, unsigned int> sections;  // "[name]" -> first line
+};
+
+typedef std::map<std::string, IniIndex *> IniIndexMap;
+
+// Like Find(), not reentrant.
+static IniIndexMap              iniIndexCache;
+
 IniFile::IniFile(int _errMask, FILE *_fp)
 {
     fp = _fp;
     errMask = _errMask;
     owned = false;
+    index = NULL;
+    indexPos = 0;
 
     if(fp != NULL)
         LockFile();
@@ -75,10 +112,135 @@ IniFile::Open(const char *file)
     if(!LockFile())
         return(false);
 
+    AttachIndex(path);
+
     return(true);
 }
 
 
+/*! Uses the cached copy of the open file if the file has not changed
+   since it was read, otherwise reads the file into a new copy. Without
+   a copy Find() falls back to reading the file. */
+void
+IniFile::AttachIndex(const char *path)
+{
+    struct stat                 st;
+    char                        line[LINELEN + 2];
+    IniIndexMap::iterator       it;
+    IniIndex                    *ix;
+
+    if(fstat(fileno(fp), &st) != 0)
+        return;
+
+    it = iniIndexCache.find(path);
+    if(it != iniIndexCache.end()){
+        ix = it->second;
+        if(ix->dev == st.st_dev && ix->ino == st.st_ino
+           && ix->size == st.st_size
+           && ix->mtime.tv_sec == st.st_mtim.tv_sec
+           && ix->mtime.tv_nsec == st.st_mtim.tv_nsec){
+            ix->refs++;
+            index = ix;
+            indexPos = 0;
+            return;
+        }
+        /* file changed-- drop the old copy once nobody uses it */
+        iniIndexCache.erase(it);
+        ix->detached = true;
+        if(ix->refs == 0)
+            delete ix;
+    }
+
+    ix = new IniIndex;
+    ix->path = path;
+    ix->dev = st.st_dev;
+    ix->ino = st.st_ino;
+    ix->size = st.st_size;
+    ix->mtime = st.st_mtim;
+    ix->refs = 1;
+    ix->detached = false;
+    ix->unterminated = false;
+    ix->strayCr = false;
+
+    rewind(fp);
+    while(fgets(line, LINELEN + 1, fp) != NULL){
+        char                    *nonWhite, *end;
+        size_t                  len;
+
+        ix->lines.push_back(line);
+        ix->unterminated = feof(fp);
+        if(check_line_endings(line, false))
+            ix->strayCr = true;
+
+        /* index the section headers, as Find() matches them */
+        len = strlen(line);
+        if(len > 0 && line[len - 1] == '\n')
+            line[len - 1] = 0;
+        if((nonWhite = SkipWhite(line)) != NULL && nonWhite[0] == '['
+           && (end = strchr(nonWhite, ']')) != NULL){
+            std::string key(nonWhite, end + 1 - nonWhite);
+            /* keep the first one, that is the one Find() would stop at */
+            ix->sections.insert(std::make_pair(key, ix->lines.size() - 1));
+        }
+    }
+    if(ferror(fp)){
+        delete ix;
+        return;
+    }
+
+    iniIndexCache[path] = ix;
+    index = ix;
+    indexPos = 0;
+}
+
+
+void
+IniFile::ReleaseIndex(void)
+{
+    if(index == NULL)
+        return;
+
+    if(--index->refs == 0 && index->detached)
+        delete index;
+    index = NULL;
+}
+
+
+void
+IniFile::Rewind(void)
+{
+    if(index != NULL)
+        indexPos = 0;
+    else
+        rewind(fp);
+}
+
+
+/*! Reads the next line like fgets(line, LINELEN + 1, fp). */
+bool
+IniFile::ReadLine(char *line)
+{
+    if(index == NULL)
+        return(fgets(line, LINELEN + 1, fp) != NULL);
+
+    if(indexPos >= index->lines.size())
+        return(false);
+    strcpy(line, index->lines[indexPos++].c_str());
+    return(true);
+}
+
+
+/*! Same as feof(fp) would be after the lines read so far. */
+bool
+IniFile::AtEnd(void)
+{
+    if(index == NULL)
+        return(feof(fp));
+
+    return(indexPos >= index->lines.size() && index->unterminated);
+}
+
+
 /*! Closes the file descriptor..
 
    @return true on success, false on failure */
@@ -87,6 +249,8 @@ IniFile::Close()
 {
     int                         rVal = 0;
 
+    ReleaseIndex();
+
     if(fp != NULL){
         lock.l_type = F_UNLCK;
         fcntl(fileno(fp), F_SETLKW, &lock);
@@ -297,17 +461,28 @@ IniFile::Find(const char *_tag, const char *_section, int _num, int *lineno)
         return(NULL);
 
     /* start from beginning */
-    rewind(fp);
+    Rewind();
 
     /* check for section first-- if it's non-NULL, then position file at
        line after [section] */
     if(section != NULL){
         sprintf(bracketSection, "[%s]", section);
 
+        /* with a cached copy, skip the lines before the section; a
+           missing section leaves nothing to read */
+        if(index != NULL && !index->strayCr && strchr(section, ']') == NULL){
+            std::map<std::string, unsigned int>::const_iterator it;
+
+            it = index->sections.find(bracketSection);
+            indexPos = (it != index->sections.end()) ?
+                it->second : index->lines.size();
+            lineNo = indexPos;
+        }
+
         /* find [section], and position fp just after it */
-        while (!feof(fp)) {
+        while (!AtEnd()) {
 
-            if (NULL == fgets(line, LINELEN + 1, fp)) {
+            if (!ReadLine(line)) {
                 /* got to end of file without finding it */
                 ThrowException(ERR_SECTION_NOT_FOUND);
                 return(NULL);
@@ -346,9 +521,9 @@ IniFile::Find(const char *_tag, const char *_section, int _num, int *lineno)
         }
     }
 
-    while (!feof(fp)) {
+    while (!AtEnd()) {
         /* check for end of file */
-        if (NULL == fgets(line, LINELEN + 1, (FILE *) fp)) {
+        if (!ReadLine(line)) {
             /* got to end of file without finding it */
             ThrowException(ERR_TAG_NOT_FOUND);
             return(NULL);
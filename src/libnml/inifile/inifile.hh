@@ -23,6 +23,8 @@
 #endif
 
 #ifdef __cplusplus
+struct IniIndex;
+
 class IniFile {
 public:
     typedef enum {
@@ -103,6 +105,9 @@ private:
     struct flock                lock;
     bool                        owned;
 
+    IniIndex                    *index;         // shared copy of the file
+    unsigned int                indexPos;       // next line to return
+
     Exception                   exception;
     int                         errMask;
 
@@ -113,6 +118,11 @@ private:
 
     bool                        CheckIfOpen(void);
     bool                        LockFile(void);
+    void                        AttachIndex(const char *path);
+    void                        ReleaseIndex(void);
+    void                        Rewind(void);
+    bool                        ReadLine(char *line);
+    bool                        AtEnd(void);
     void                        ThrowException(ErrorCode);
     char                        *AfterEqual(const char *string);
     char                        *SkipWhite(const char *string);
@@ -47,6 +47,12 @@ LinkedList::LinkedList()
     next_node_id = 1;
     delete_data_not_copied = 0;
     extra_node = new LinkedListNode(NULL, 0);
+    pool_block_size = 0;
+    pool_max_free = 0;
+    free_nodes = (LinkedListNode *) NULL;
+    free_node_count = 0;
+    free_blocks = NULL;
+    free_block_count = 0;
     max_list_size = 0;
     sizing_mode = NO_MAXIMUM_SIZE;
 }
@@ -58,6 +64,120 @@ LinkedList::~LinkedList()
 	delete extra_node;
 	extra_node = (LinkedListNode *) NULL;
     }
+    empty_pool();
+}
+
+/*! Makes the list keep nodes, and blocks of data for copies, that it
+   is done with, instead of freeing them, so that storing after
+   retrieving or deleting doesn't go to the heap. Copies of data no
+   larger than _block_size bytes are made in blocks of that size, larger
+   ones are malloc'ed as usual. At most _max_free nodes and _max_free
+   blocks are kept. Calling it with _max_free zero frees them and turns
+   pooling off.
+
+   The block size can only be changed while nothing copied is stored or
+   was last retrieved.
+
+   @param _block_size Size of the blocks copies are made in.
+
+   @param _max_free Number of unused nodes and blocks to keep.
+
+   @return Returns 0 if successful or -1 if the list is not empty. */
+int LinkedList::set_pool(size_t _block_size, int _max_free)
+{
+    if (_block_size != pool_block_size
+	&& (NULL != head || (last_copied_retrieved
+		&& NULL != last_data_retrieved))) {
+	return (-1);
+    }
+    empty_pool();
+    if (_max_free <= 0) {
+	_block_size = 0;
+	_max_free = 0;
+    } else if (_block_size != 0 && _block_size < sizeof(void *)) {
+	_block_size = sizeof(void *);
+    }
+    pool_block_size = _block_size;
+    pool_max_free = _max_free;
+    return (0);
+}
+
+void LinkedList::empty_pool()
+{
+    LinkedListNode *node;
+    void *block;
+
+    while (NULL != free_nodes) {
+	node = free_nodes;
+	free_nodes = node->next;
+	delete node;
+    }
+    free_node_count = 0;
+    while (NULL != free_blocks) {
+	block = free_blocks;
+	free_blocks = *(void **) block;
+	free(block);
+    }
+    free_block_count = 0;
+}
+
+LinkedListNode *LinkedList::get_node(void *_data, size_t _size)
+{
+    LinkedListNode *node;
+
+    if (NULL == free_nodes) {
+	return new LinkedListNode(_data, _size);
+    }
+    node = free_nodes;
+    free_nodes = node->next;
+    free_node_count--;
+    node->data = _data;
+    node->size = _size;
+    node->next = (LinkedListNode *) NULL;
+    node->last = (LinkedListNode *) NULL;
+    return (node);
+}
+
+void LinkedList::release_node(LinkedListNode * node)
+{
+    if (free_node_count >= pool_max_free) {
+	delete node;
+	return;
+    }
+    node->next = free_nodes;
+    free_nodes = node;
+    free_node_count++;
+}
+
+void *LinkedList::get_data(size_t _size)
+{
+    void *block;
+
+    if (0 == pool_block_size || _size > pool_block_size) {
+	return malloc(_size);
+    }
+    if (NULL == free_blocks) {
+	return malloc(pool_block_size);
+    }
+    block = free_blocks;
+    free_blocks = *(void **) block;
+    free_block_count--;
+    return (block);
+}
+
+/* Data that wasn't copied was malloc'ed by the caller, and copies
+   larger than the block size by get_data(), so only copies that fit
+   in a block can go back to the pool. */
+void LinkedList::release_data(void *_data, size_t _size, int _copied)
+{
+    if (!_copied || 0 == pool_block_size || _size > pool_block_size
+	|| free_block_count >= pool_max_free) {
+	free(_data);
+	return;
+    }
+    *(void **) _data = free_blocks;
+    free_blocks = _data;
+    free_block_count++;
 }
 
 /*! Sets a sizing mode and the maximum number of nodes allowed on the
@@ -95,14 +215,15 @@ void LinkedList::flush_list()
 	next_node = current_node->next;
 	if ((current_node->copied || delete_data_not_copied)
 	    && (NULL != current_node->data)) {
-	    free(current_node->data);
+	    release_data(current_node->data, current_node->size,
+			 current_node->copied);
 	}
-	delete current_node;
+	release_node(current_node);
 	current_node = next_node;
     }
     if (last_copied_retrieved) {
 	if (last_data_retrieved != NULL) {
-	    free(last_data_retrieved);
+	    release_data(last_data_retrieved, last_size_retrieved, 1);
 	    last_data_retrieved = NULL;
 	    last_size_retrieved = 0;
 	}
@@ -129,7 +250,7 @@ void *LinkedList::retrieve_head()
     if (NULL != head) {
 	if (last_copied_retrieved) {
 	    if (NULL != last_data_retrieved) {
-		free(last_data_retrieved);
+		release_data(last_data_retrieved, last_size_retrieved, 1);
 		last_data_retrieved = NULL;
 		last_size_retrieved = 0;
 	    }
@@ -138,7 +259,7 @@ void *LinkedList::retrieve_head()
 	last_size_retrieved = head->size;
 	last_copied_retrieved = head->copied;
 	next_node = head->next;
-	delete head;
+	release_node(head);
 	head = next_node;
 	if (NULL != head) {
 	    head->last = (LinkedListNode *) NULL;
@@ -158,7 +279,7 @@ void *LinkedList::retrieve_tail()
     if (NULL != tail) {
 	if (last_copied_retrieved) {
 	    if (NULL != last_data_retrieved) {
-		free(last_data_retrieved);
+		release_data(last_data_retrieved, last_size_retrieved, 1);
 		last_data_retrieved = NULL;
 		last_size_retrieved = 0;
 	    }
@@ -167,7 +288,7 @@ void *LinkedList::retrieve_tail()
 	last_size_retrieved = tail->size;
 	last_copied_retrieved = tail->copied;
 	last_node = tail->last;
-	delete tail;
+	release_node(tail);
 	tail = last_node;
 	if (NULL != tail) {
 	    tail->next = (LinkedListNode *) NULL;
@@ -210,11 +331,11 @@ int LinkedList::store_at_head(void *_data, size_t _size, int _copy)
 		    tail->next = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_tail;
+		    release_node(old_tail);
 		    list_size = 0;
 		    break;
 		}
-		delete old_tail;
+		release_node(old_tail);
 		list_size--;
 	    }
 	    break;
@@ -230,14 +351,14 @@ int LinkedList::store_at_head(void *_data, size_t _size, int _copy)
     }
 
     if (_copy) {
-	last_data_stored = malloc(_size);
+	last_data_stored = get_data(_size);
 	memcpy(last_data_stored, _data, _size);
 	last_size_stored = _size;
-	new_head = new LinkedListNode(last_data_stored, _size);
+	new_head = get_node(last_data_stored, _size);
     } else {
 	last_data_stored = _data;
 	last_size_stored = _size;
-	new_head = new LinkedListNode(_data, _size);
+	new_head = get_node(_data, _size);
     }
     if (NULL != new_head) {
 	new_head->copied = _copy;
@@ -291,11 +412,11 @@ int LinkedList::store_at_tail(void *_data, size_t _size, int _copy)
 		    head->last = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_head;
+		    release_node(old_head);
 		    list_size = 0;
 		    break;
 		}
-		delete old_head;
+		release_node(old_head);
 		list_size--;
 	    }
 	    break;
@@ -312,14 +433,14 @@ int LinkedList::store_at_tail(void *_data, size_t _size, int _copy)
     }
 
     if (_copy) {
-	last_data_stored = malloc(_size);
+	last_data_stored = get_data(_size);
 	memcpy(last_data_stored, _data, _size);
 	last_size_stored = _size;
-	new_tail = new LinkedListNode(last_data_stored, _size);
+	new_tail = get_node(last_data_stored, _size);
     } else {
 	last_data_stored = _data;
 	last_size_stored = _size;
-	new_tail = new LinkedListNode(last_data_stored, _size);
+	new_tail = get_node(last_data_stored, _size);
     }
     if (NULL != new_tail) {
 	new_tail->copied = _copy;
@@ -380,11 +501,11 @@ int LinkedList::store_after_current_node(void *_data, size_t _size,
 		    tail->next = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_tail;
+		    release_node(old_tail);
 		    list_size = 0;
 		    break;
 		}
-		delete old_tail;
+		release_node(old_tail);
 		list_size--;
 	    }
 	    break;
@@ -399,11 +520,11 @@ int LinkedList::store_after_current_node(void *_data, size_t _size,
 		    head->last = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_head;
+		    release_node(old_head);
 		    list_size = 0;
 		    break;
 		}
-		delete old_head;
+		release_node(old_head);
 		list_size--;
 	    }
 	    break;
@@ -415,14 +536,14 @@ int LinkedList::store_after_current_node(void *_data, size_t _size,
     }
 
     if (_copy) {
-	last_data_stored = malloc(_size);
+	last_data_stored = get_data(_size);
 	memcpy(last_data_stored, _data, _size);
 	last_size_stored = _size;
-	new_node = new LinkedListNode(last_data_stored, _size);
+	new_node = get_node(last_data_stored, _size);
     } else {
 	last_data_stored = _data;
 	last_size_stored = _size;
-	new_node = new LinkedListNode(last_data_stored, _size);
+	new_node = get_node(last_data_stored, _size);
     }
     if (NULL != new_node) {
 	new_node->copied = _copy;
@@ -499,11 +620,11 @@ int LinkedList::store_before_current_node(void *_data, size_t _size,
 		    tail->next = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_tail;
+		    release_node(old_tail);
 		    list_size = 0;
 		    break;
 		}
-		delete old_tail;
+		release_node(old_tail);
 		list_size--;
 	    }
 	    break;
@@ -518,11 +639,11 @@ int LinkedList::store_before_current_node(void *_data, size_t _size,
 		    head->last = (LinkedListNode *) NULL;
 		} else {
 		    head = (LinkedListNode *) NULL;
-		    delete old_head;
+		    release_node(old_head);
 		    list_size = 0;
 		    break;
 		}
-		delete old_head;
+		release_node(old_head);
 		list_size--;
 	    }
 	    break;
@@ -535,14 +656,14 @@ int LinkedList::store_before_current_node(void *_data, size_t _size,
     }
 
     if (_copy) {
-	last_data_stored = malloc(_size);
+	last_data_stored = get_data(_size);
 	memcpy(last_data_stored, _data, _size);
 	last_size_stored = _size;
-	new_node = new LinkedListNode(last_data_stored, _size);
+	new_node = get_node(last_data_stored, _size);
     } else {
 	last_data_stored = _data;
 	last_size_stored = _size;
-	new_node = new LinkedListNode(last_data_stored, _size);
+	new_node = get_node(last_data_stored, _size);
     }
     if (NULL != new_node) {
 	new_node->copied = _copy;
@@ -726,9 +847,9 @@ void LinkedList::delete_node(int _id)
 	    }
 	    if ((temp->copied || delete_data_not_copied)
 		&& (NULL != temp->data)) {
-		free(temp->data);
+		release_data(temp->data, temp->size, temp->copied);
 	    }
-	    delete temp;
+	    release_node(temp);
 	    break;
 	}
 	temp = temp->next;
@@ -761,9 +882,9 @@ void LinkedList::delete_current_node()
 	}
 	if ((temp->copied || delete_data_not_copied)
 	    && (NULL != temp->data)) {
-	    free(temp->data);
+	    release_data(temp->data, temp->size, temp->copied);
 	}
-	delete temp;
+	release_node(temp);
 	list_size--;
     }
 }
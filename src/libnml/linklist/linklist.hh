@@ -86,12 +86,24 @@ class LinkedList {
     bool is_empty();
     void flush_list();
     void delete_members();
+    int set_pool(size_t _block_size, int _max_free);
 
     LinkedList();
     ~LinkedList();
 
   private:
     LinkedList(LinkedList & list);	// Don't copy me.
+    LinkedListNode *get_node(void *_data, size_t _size);
+    void release_node(LinkedListNode * node);
+    void *get_data(size_t _size);
+    void release_data(void *_data, size_t _size, int _copied);
+    void empty_pool();
+    size_t pool_block_size;	// see set_pool()
+    int pool_max_free;
+    LinkedListNode *free_nodes;
+    int free_node_count;
+    void *free_blocks;		// each starts with a pointer to the next
+    int free_block_count;
 };
 
 #endif /* LINKED_LIST_HH */
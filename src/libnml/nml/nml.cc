@@ -1384,6 +1384,85 @@ NMLTYPE NML::peek()
 
 }
 
+/***********************************************************
+* NML Member Function: borrow(const NMLmsg **msg)
+* Purpose: Like peek(), but for a local raw buffer the message is not
+* copied into the local buffer. *msg points at it in the shared
+* memory, which stays locked until release_borrow() is called.
+* Returns:
+*  0 The data was not updated since the last read; *msg is NULL.
+*  -1 The buffer could not be read; *msg is NULL.
+*  o.w. The type of the new NMLmsg is returned.
+* Notes:
+*   1. release_borrow() must be called after every borrow(), and no
+* other call may be made on this channel in between. Copy out only what
+* is needed and release promptly: writers wait on the lock meanwhile.
+*   2. Buffers that cannot lend out their message (remote, neutrally
+* encoded, queued, ...) fall back to peek() and *msg is get_address().
+* Use NML_BORROWED_READ to pair the calls automatically.
+***********************************************************/
+NMLTYPE NML::borrow(const NMLmsg **msg)
+{
+    const void *borrowed = NULL;
+    NMLTYPE type;
+
+    *msg = NULL;
+    if (NULL == cms || cms->is_phantom || fast_mode) {
+	type = peek();
+	if (type > 0) {
+	    *msg = get_address();
+	}
+	return type;
+    }
+
+    error_type = NML_NO_ERROR;
+    cms->borrow(&borrowed);
+    switch (cms->status) {
+    case CMS_NO_IMPLEMENTATION_ERROR:
+	type = peek();
+	if (type > 0) {
+	    *msg = get_address();
+	}
+	return type;
+    case CMS_READ_OLD:
+	return (0);
+    case CMS_READ_OK:
+	type = ((const NMLmsg *) borrowed)->type;
+	if (type <= 0 && !cms->isserver) {
+	    rcs_print_error
+		("NML: New data recieved but type of %d is invalid.\n",
+		(int) type);
+	    cms->release_borrow();
+	    return -1;
+	}
+	*msg = (const NMLmsg *) borrowed;
+	return type;
+
+    default:
+	set_error();
+	return -1;
+    }
+}
+
+void NML::release_borrow()
+{
+    if (NULL != cms) {
+	cms->release_borrow();
+    }
+}
+
+NML_BORROWED_READ::NML_BORROWED_READ(NML * _nml)
+{
+    nml = _nml;
+    msg = NULL;
+    type = nml->borrow(&msg);
+}
+
+NML_BORROWED_READ::~NML_BORROWED_READ()
+{
+    nml->release_borrow();
+}
+
 /***********************************************************
 * NML Member Function: format_output()
 * Purpose: Formats the data read from a CMS buffer as required
@@ -2441,6 +2520,14 @@ NML_DIAGNOSTICS_INFO *NML::get_diagnostics_info()
     return (NML_DIAGNOSTICS_INFO *) cms->get_diagnostics_info();
 }
 
+const CMS_ACCESS_STATS *NML::get_access_stats()
+{
+    if (NULL == cms) {
+	return NULL;
+    }
+    return cms->get_access_stats();
+}
+
 void nmlSetHostAlias(const char *hostName, const char *hostAlias)
 {
     if (NULL == cmsHostAliases) {
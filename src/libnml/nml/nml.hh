@@ -27,6 +27,7 @@ extern "C" {
 #endif
 #include "cms_user.hh"		/* class CMS_USER */
 class LinkedList;
+struct CMS_ACCESS_STATS;
 /* Generic NML Stuff */
 #include "nml_type.hh"
 
@@ -97,6 +98,8 @@ class NML:public virtual CMS_USER {
     NMLTYPE peek();		/* Read buffer without changing was_read */
     NMLTYPE read(void *, long);
     NMLTYPE peek(void *, long);
+    NMLTYPE borrow(const NMLmsg ** msg);	/* Peek in place, see nml.cc. */
+    void release_borrow();
     int write(NMLmsg & nml_msg);	/* Write a message. (Use reference) */
     int write(NMLmsg * nml_msg);	/* Write a message. (Use pointer) */
     int write_if_read(NMLmsg & nml_msg);	/* Write only if buffer
@@ -167,6 +170,9 @@ class NML:public virtual CMS_USER {
     /* Get Diagnostics Information. */
     NML_DIAGNOSTICS_INFO *get_diagnostics_info();
 
+    /* Get the access counters of a local SHMEM buffer, or NULL. */
+    const CMS_ACCESS_STATS *get_access_stats();
+
     int prefix_format_chain(NML_FORMAT_PTR);
 
     /* Constructors and destructors. */
@@ -210,6 +216,22 @@ class NML:public virtual CMS_USER {
       NML(NML & nml);		// Don't copy me.
 };
 
+/* Scoped NML::borrow(): the buffer is released when this goes out of
+   scope. type is what borrow() returned; msg is only valid when type > 0
+   and only for the lifetime of this object. */
+class NML_BORROWED_READ {
+  public:
+    NML_BORROWED_READ(NML * _nml);
+    ~NML_BORROWED_READ();
+    NMLTYPE type;
+    const NMLmsg *msg;
+
+  private:
+    NML *nml;
+    NML_BORROWED_READ(const NML_BORROWED_READ &);	// Don't copy me.
+    NML_BORROWED_READ & operator=(const NML_BORROWED_READ &);
+};
+
 extern LinkedList *NML_Main_Channel_List;
 extern "C" {
     extern void nml_start();
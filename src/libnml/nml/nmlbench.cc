@@ -0,0 +1,513 @@
+/********************************************************************
+* Description: nmlbench.cc
+*   Measures NML write cost, delivery latency and throughput for each
+*   buffer type, mutex type and encoding, with real EMC messages
+*
+*   syntax: nmlbench [-n count] [-r readers[,readers...]] [-m stat|move]
+*                    [-b buffer[,buffer...]] [-p period] [-t timeout]
+*                    [-P tcp port] [-l]
+*
+*   Writes a .nml file with one buffer for each of the configurations
+*   below, then for each buffer, message and number of readers: writes
+*   count messages, one every period seconds (default 0.0002; 0 to
+*   write flat out), while the readers poll the buffer and note how
+*   long after it was written each message they see arrived.  Readers
+*   are separate processes, except on the process_local buffer where
+*   they have to be threads; on the tcp buffer they read through an
+*   NML server in another process, as a remote GUI would.
+*
+*     shmem-os_sem   SHMEM, raw, the default semaphore
+*     shmem-xdr      SHMEM, stored XDR encoded
+*     shmem-packed   SHMEM, stored in the packed encoding
+*     shmem-lockfree SHMEM, raw, mutex=lockfree
+*     shmem-mao      SHMEM, raw, mutex=mao split
+*     locmem         SHMEM marked process_local
+*     tcp-xdr        readers REMOTE through TCP, XDR on the wire
+*
+*   nmlbench -n 20000 -r 1,4 -m stat > results
+*
+*   prints one line for each run, of name=value fields: the buffer,
+*   message and reader count; the writes/sec the write() calls alone
+*   would allow; the time each write() took and the delivery
+*   latency, in microseconds, as p50, p90, p99 and max; how many of the messages the readers saw between them; and
+*   the CPU time per message of the writer and per message seen of
+*   the readers.  -l lists the buffers and exits.  Latencies are only
+*   comparable between runs on the same machine.
+*
+* License: LGPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "rcs.hh"		// NML
+#include "emc.hh"		// emcFormat
+#include "emc_nml.hh"		// EMC_STAT, EMC_TRAJ_LINEAR_MOVE
+#include "timer.hh"		// etime_monotonic(), esleep()
+#include "nml_srv.hh"		// run_nml_servers()
+#include "rcs_print.hh"
+
+struct bench_buffer {
+    const char *name;
+    const char *options;	// end of its buffer line
+    int neutral;		// stored encoded
+    int remote;			// readers go through the TCP server
+    int threads;		// readers must be in this process
+};
+
+static const bench_buffer buffers[] = {
+    {"shmem-os_sem", "", 0, 0, 0},
+    {"shmem-xdr", "xdr", 1, 0, 0},
+    {"shmem-packed", "packed", 1, 0, 0},
+    {"shmem-lockfree", "mutex=lockfree", 0, 0, 0},
+    {"shmem-mao", "mutex=mao split", 0, 0, 0},
+    {"locmem", "process_local", 0, 0, 1},
+    {"tcp-xdr", "xdr", 0, 1, 0},
+};
+#define NBUFFERS ((int) (sizeof(buffers) / sizeof(buffers[0])))
+#define MAX_READERS 16
+
+static int count = 10000;
+static double period = 0.0002;
+static double timeout = 30.0;
+static int tcp_port = 5095;
+static char nmlfile[] = "/tmp/nmlbenchXXXXXX";
+
+// The writer stamps each message: x is when it was written, y is -1 on
+// the last one.
+static EmcPose *stamp(NMLmsg * msg)
+{
+    if (msg->type == EMC_STAT_TYPE) {
+	return &((EMC_STAT *) msg)->motion.traj.position;
+    }
+    return &((EMC_TRAJ_LINEAR_MOVE *) msg)->end;
+}
+
+static double cpu_time()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	1e-6 * (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+static void write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *) buf;
+    while (len > 0) {
+	ssize_t n = write(fd, p, len);
+	if (n < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (n <= 0) {
+	    return;
+	}
+	p += n;
+	len -= n;
+    }
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+    char *p = (char *) buf;
+    while (len > 0) {
+	ssize_t n = read(fd, p, len);
+	if (n < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (n <= 0) {
+	    return -1;
+	}
+	p += n;
+	len -= n;
+    }
+    return 0;
+}
+
+// Opens a channel, retrying while a master or server is still starting.
+// The errors from those retries are muted, as emcsvr does, except on the
+// last try.
+static NML *open_channel(const char *buf, const char *proc)
+{
+    double give_up = etime_monotonic() + timeout;
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+    for (;;) {
+	int last = etime_monotonic() > give_up;
+	if (last) {
+	    set_rcs_print_destination(RCS_PRINT_TO_STDERR);
+	}
+	NML *nml = new NML(emcFormat, buf, proc, nmlfile);
+	if (nml->valid()) {
+	    set_rcs_print_destination(RCS_PRINT_TO_STDERR);
+	    return nml;
+	}
+	delete nml;
+	if (last) {
+	    return NULL;
+	}
+	esleep(0.05);
+    }
+}
+
+struct reader_args {
+    const char *buf;
+    int index;
+    int fd;
+};
+
+// Polls the buffer until the last message turns up (or timeout), then
+// sends back its CPU time and the latency of every message it saw.
+static void *reader_main(void *arg)
+{
+    reader_args *r = (reader_args *) arg;
+    char proc[32];
+    snprintf(proc, sizeof(proc), "bench_r%d", r->index);
+    NML *nml = open_channel(r->buf, proc);
+    char ready = nml ? 'R' : 'E';
+    write_all(r->fd, &ready, 1);
+    if (NULL == nml) {
+	close(r->fd);
+	return NULL;
+    }
+
+    std::vector < double >latency;
+    latency.reserve(count);
+    double cpu = cpu_time();
+    double give_up = etime_monotonic() + timeout;
+    for (;;) {
+	NMLTYPE type = nml->read();
+	if (type > 0) {
+	    double now = etime_monotonic();
+	    EmcPose *p = stamp(nml->get_address());
+	    if (p->tran.y < 0) {
+		break;
+	    }
+	    latency.push_back(now - p->tran.x);
+	} else if (type < 0 || etime_monotonic() > give_up) {
+	    break;
+	}
+    }
+    cpu = cpu_time() - cpu;
+
+    int n = latency.size();
+    write_all(r->fd, &n, sizeof(n));
+    write_all(r->fd, &cpu, sizeof(cpu));
+    if (n > 0) {
+	write_all(r->fd, &latency[0], n * sizeof(double));
+    }
+    close(r->fd);
+    delete nml;
+    return NULL;
+}
+
+static double percentile(std::vector < double >&v, double p)
+{
+    if (v.empty()) {
+	return 0.0;
+    }
+    size_t i = (size_t) (p * (v.size() - 1) + 0.5);
+    return v[i] * 1e6;
+}
+
+static void print_times(const char *name, std::vector < double >&v)
+{
+    std::sort(v.begin(), v.end());
+    printf(" %s_p50_us=%.2f %s_p90_us=%.2f %s_p99_us=%.2f %s_max_us=%.2f",
+	name, percentile(v, 0.50), name, percentile(v, 0.90),
+	name, percentile(v, 0.99), name, percentile(v, 1.0));
+}
+
+static int run(const bench_buffer * b, int msgtype, int readers)
+{
+    NMLmsg *msg;
+    if (msgtype == EMC_STAT_TYPE) {
+	msg = new EMC_STAT;
+    } else {
+	msg = new EMC_TRAJ_LINEAR_MOVE;
+    }
+
+    // The tcp buffer lives in a server process, as emcsvr's do.
+    pid_t server = 0;
+    if (b->remote) {
+	server = fork();
+	if (server == 0) {
+	    NML *master = new NML(emcFormat, b->name, "bench_svr", nmlfile);
+	    if (!master->valid()) {
+		_exit(1);
+	    }
+	    run_nml_servers();
+	    _exit(0);
+	}
+    }
+    NML *writer = open_channel(b->name, "bench_w");
+    if (NULL == writer) {
+	fprintf(stderr, "nmlbench: can't open %s\n", b->name);
+	if (server > 0) {
+	    kill(server, SIGINT);
+	    waitpid(server, NULL, 0);
+	}
+	delete msg;
+	return -1;
+    }
+
+    int fds[MAX_READERS];
+    pid_t pids[MAX_READERS];
+    pthread_t threads[MAX_READERS];
+    reader_args args[MAX_READERS];
+    for (int i = 0; i < readers; i++) {
+	int p[2];
+	if (pipe(p) < 0) {
+	    perror("nmlbench: pipe");
+	    exit(1);
+	}
+	fds[i] = p[0];
+	args[i].buf = b->name;
+	args[i].index = i;
+	args[i].fd = p[1];
+	if (b->threads) {
+	    pthread_create(&threads[i], NULL, reader_main, &args[i]);
+	} else {
+	    pids[i] = fork();
+	    if (pids[i] == 0) {
+		close(p[0]);
+		reader_main(&args[i]);
+		_exit(0);
+	    }
+	    close(p[1]);
+	}
+    }
+    int ok = 1;
+    for (int i = 0; i < readers; i++) {
+	char ready = 'E';
+	if (read_all(fds[i], &ready, 1) < 0 || ready != 'R') {
+	    ok = 0;
+	}
+    }
+
+    std::vector < double >write_time;
+    write_time.reserve(count);
+    EmcPose *p = stamp(msg);
+    double cpu = cpu_time();
+    double next = etime_monotonic();
+    for (int i = 0; ok && i < count; i++) {
+	if (period > 0) {
+	    next += period;
+	    esleep_until(next);
+	}
+	p->tran.y = 0;
+	p->tran.z = i;
+	double t0 = etime_monotonic();
+	p->tran.x = t0;
+	writer->write(msg);
+	write_time.push_back(etime_monotonic() - t0);
+    }
+    double busy = 0;
+    for (size_t i = 0; i < write_time.size(); i++) {
+	busy += write_time[i];
+    }
+    cpu = cpu_time() - cpu;
+    p->tran.y = -1;
+    writer->write(msg);
+
+    std::vector < double >latency;
+    double reader_cpu = 0;
+    for (int i = 0; i < readers; i++) {
+	int n = 0;
+	double c = 0;
+	if (read_all(fds[i], &n, sizeof(n)) == 0
+	    && read_all(fds[i], &c, sizeof(c)) == 0 && n > 0) {
+	    size_t old = latency.size();
+	    latency.resize(old + n);
+	    if (read_all(fds[i], &latency[old], n * sizeof(double)) < 0) {
+		latency.resize(old);
+	    }
+	}
+	reader_cpu += c;
+	close(fds[i]);
+	if (b->threads) {
+	    pthread_join(threads[i], NULL);
+	} else {
+	    waitpid(pids[i], NULL, 0);
+	}
+    }
+    delete writer;
+    if (server > 0) {
+	kill(server, SIGINT);
+	waitpid(server, NULL, 0);
+    }
+    delete msg;
+    if (!ok) {
+	fprintf(stderr, "nmlbench: a reader could not open %s\n", b->name);
+	return -1;
+    }
+
+    int seen = latency.size();
+    printf("buffer=%s msg=%s readers=%d count=%d writes_per_sec=%.0f",
+	b->name, msgtype == EMC_STAT_TYPE ? "EMC_STAT" :
+	"EMC_TRAJ_LINEAR_MOVE", readers, count,
+	busy > 0 ? count / busy : 0.0);
+    print_times("write", write_time);
+    print_times("latency", latency);
+    printf(" seen=%d cpu_write_us=%.2f cpu_read_us=%.2f\n", seen,
+	1e6 * cpu / count, seen > 0 ? 1e6 * reader_cpu / seen : 0.0);
+    fflush(stdout);
+    return 0;
+}
+
+// One buffer line per configuration, and process lines for the writer,
+// the readers and the tcp buffer's server.
+static int write_nml_file()
+{
+    int fd = mkstemp(nmlfile);
+    if (fd < 0) {
+	perror("nmlbench: mkstemp");
+	return -1;
+    }
+    FILE *f = fdopen(fd, "w");
+    size_t size = std::max(sizeof(EMC_STAT), sizeof(EMC_TRAJ_LINEAR_MOVE));
+    size = (2 * size + 8191) & ~(size_t) 4095;
+
+    for (int i = 0; i < NBUFFERS; i++) {
+	const bench_buffer *b = &buffers[i];
+	char tcp[32] = "";
+	if (b->remote) {
+	    snprintf(tcp, sizeof(tcp), "TCP=%d ", tcp_port);
+	}
+	fprintf(f, "B %-16s SHMEM localhost %lu %d 0 %d %d %d %s%s\n",
+	    b->name, (unsigned long) size, b->neutral, i + 1,
+	    MAX_READERS + 2, 7001 + i, tcp, b->options);
+    }
+    for (int i = 0; i < NBUFFERS; i++) {
+	const bench_buffer *b = &buffers[i];
+	if (b->remote) {
+	    fprintf(f, "P bench_svr %-16s LOCAL localhost RW 1 %.1f 1 0\n",
+		b->name, timeout);
+	    fprintf(f, "P bench_w   %-16s LOCAL localhost W 0 %.1f 0 1\n",
+		b->name, timeout);
+	} else {
+	    fprintf(f, "P bench_w   %-16s LOCAL localhost W 0 %.1f 1 0\n",
+		b->name, timeout);
+	}
+	for (int r = 0; r < MAX_READERS; r++) {
+	    fprintf(f, "P bench_r%-2d %-16s %s localhost R 0 %.1f 0 %d\n",
+		r, b->name, b->remote ? "REMOTE" : "LOCAL", timeout, r + 2);
+	}
+    }
+    fclose(f);
+    return 0;
+}
+
+static int wanted(const char *list, const char *name)
+{
+    if (NULL == list) {
+	return 1;
+    }
+    size_t len = strlen(name);
+    for (const char *s = list; (s = strstr(s, name)) != NULL; s += len) {
+	if ((s == list || s[-1] == ',') && (s[len] == 0 || s[len] == ',')) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+	"usage: nmlbench [-n count] [-r readers[,readers...]] [-m stat|move]\n"
+	"                [-b buffer[,buffer...]] [-p period] [-t timeout]\n"
+	"                [-P tcp port] [-l]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *reader_list = "1,4";
+    const char *buffer_list = NULL;
+    const char *msg_list = "stat,move";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:m:b:p:t:P:l")) != -1) {
+	switch (opt) {
+	case 'n':
+	    count = atoi(optarg);
+	    break;
+	case 'r':
+	    reader_list = optarg;
+	    break;
+	case 'm':
+	    msg_list = optarg;
+	    break;
+	case 'b':
+	    buffer_list = optarg;
+	    break;
+	case 'p':
+	    period = atof(optarg);
+	    break;
+	case 't':
+	    timeout = atof(optarg);
+	    break;
+	case 'P':
+	    tcp_port = atoi(optarg);
+	    break;
+	case 'l':
+	    for (int i = 0; i < NBUFFERS; i++) {
+		printf("%s\n", buffers[i].name);
+	    }
+	    return 0;
+	default:
+	    usage();
+	}
+    }
+    if (optind != argc || count <= 0) {
+	usage();
+    }
+
+    set_rcs_print_destination(RCS_PRINT_TO_STDERR);
+    if (write_nml_file() < 0) {
+	return 1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < NBUFFERS; i++) {
+	if (!wanted(buffer_list, buffers[i].name)) {
+	    continue;
+	}
+	for (int m = 0; m < 2; m++) {
+	    if (!wanted(msg_list, m == 0 ? "stat" : "move")) {
+		continue;
+	    }
+	    for (const char *s = reader_list; *s; s = strchr(s, ',') ?
+		strchr(s, ',') + 1 : s + strlen(s)) {
+		int readers = atoi(s);
+		if (readers < 1 || readers > MAX_READERS) {
+		    fprintf(stderr, "nmlbench: readers must be 1 to %d\n",
+			MAX_READERS);
+		    unlink(nmlfile);
+		    return 1;
+		}
+		if (run(&buffers[i],
+			m == 0 ? EMC_STAT_TYPE : EMC_TRAJ_LINEAR_MOVE_TYPE,
+			readers) < 0) {
+		    failed = 1;
+		}
+	    }
+	}
+    }
+    unlink(nmlfile);
+    return failed;
+}
@@ -0,0 +1,200 @@
+/********************************************************************
+* Description: nmlstat.cc
+*   Prints the access counters every SHMEM buffer keeps, see
+*   CMS_ACCESS_STATS in cmsdiag.hh
+*
+*   syntax: nmlstat [-p process] [-i interval] [-n count] nmlfile
+*                   [buffer ...]
+*
+*   Connects to each buffer given, or to every SHMEM buffer in
+*   nmlfile, as process (default xemc, a plain reader in the shipped
+*   .nml files; it only needs a process line for the buffer) and
+*   prints one line for each buffer, of name=value fields, then one
+*   for each process that has used it.  The first report gives totals
+*   since the buffer was created; with -i it reports again every
+*   interval seconds, count times (0, the default with -i, until
+*   killed), giving rates over the interval for reads, new messages
+*   read, writes and bytes.
+*
+*     wait=a,b,...  lock waits under 1us, 10us, ... 1s, and over 1s
+*     proc=name pid=N accesses=N ago=seconds since its last access
+*
+*   Buffers reached only through a TCP server show up under the server.
+*
+* License: LGPL Version 2
+* System: Linux
+*
+* Copyright (c) 2009 All rights reserved.
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+#include "cms.hh"		// class CMS
+#include "cms_cfg.hh"		// cms_config()
+#include "cmsdiag.hh"		// CMS_ACCESS_STATS
+#include "timer.hh"		// etime(), esleep()
+#include "rcs_print.hh"
+
+struct stat_buffer {
+    std::string name;
+    CMS *cms;
+    CMS_ACCESS_STATS last;
+    double last_time;
+};
+
+// The SHMEM buffers on the B lines of file.
+static int shmem_buffers(const char *file, std::vector<std::string> &names)
+{
+    FILE *f = fopen(file, "r");
+    if (NULL == f) {
+	perror(file);
+	return -1;
+    }
+    char line[512], name[64], type[64];
+    while (fgets(line, sizeof(line), f)) {
+	if (line[0] == 'B' && sscanf(line + 1, "%63s %63s", name, type) == 2
+	    && !strcmp(type, "SHMEM")) {
+	    names.push_back(name);
+	}
+    }
+    fclose(f);
+    return 0;
+}
+
+static void report(stat_buffer &b, int first)
+{
+    const CMS_ACCESS_STATS *s = b.cms->get_access_stats();
+    CMS_ACCESS_STATS now;
+    double now_time = etime();
+
+    memcpy(&now, s, sizeof(now));
+    printf("buffer=%s", b.name.c_str());
+    if (first) {
+	printf(" reads=%lld new=%lld writes=%lld bytes_read=%lld"
+	    " bytes_written=%lld", now.reads, now.new_reads, now.writes,
+	    now.bytes_read, now.bytes_written);
+    } else {
+	double dt = now_time - b.last_time;
+	if (dt <= 0) {
+	    dt = 1e-9;
+	}
+	printf(" reads/s=%.1f new/s=%.1f writes/s=%.1f bytes_read/s=%.0f"
+	    " bytes_written/s=%.0f", (now.reads - b.last.reads) / dt,
+	    (now.new_reads - b.last.new_reads) / dt,
+	    (now.writes - b.last.writes) / dt,
+	    (now.bytes_read - b.last.bytes_read) / dt,
+	    (now.bytes_written - b.last.bytes_written) / dt);
+    }
+    printf(" retries=%lld queue_full=%lld lock_timeouts=%lld"
+	" wait_max_us=%.1f wait=", now.retries, now.queue_full,
+	now.lock_timeouts, now.wait_max_ns / 1e3);
+    for (int i = 0; i < CMS_STATS_WAIT_BUCKETS; i++) {
+	printf("%s%lld", i ? "," : "", now.wait_histogram[i]);
+    }
+    printf("\n");
+    for (int i = 0; i < CMS_STATS_PROCS; i++) {
+	const CMS_STATS_PROC *p = &now.procs[i];
+	if (p->pid == 0) {
+	    continue;
+	}
+	printf("  proc=%.15s pid=%d accesses=%lld", p->name, p->pid,
+	    p->accesses);
+	if (p->last_access_time > 0) {
+	    printf(" ago=%.3f", now_time - p->last_access_time);
+	}
+	printf("\n");
+    }
+    b.last = now;
+    b.last_time = now_time;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+	"usage: nmlstat [-p process] [-i interval] [-n count] nmlfile"
+	" [buffer ...]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *process = "xemc";
+    double interval = 0;
+    int count = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:i:n:")) != -1) {
+	switch (opt) {
+	case 'p':
+	    process = optarg;
+	    break;
+	case 'i':
+	    interval = atof(optarg);
+	    break;
+	case 'n':
+	    count = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (optind >= argc || interval < 0) {
+	usage();
+    }
+    if (count < 0 || (count == 0 && interval <= 0)) {
+	count = interval > 0 ? 0 : 1;
+    }
+    const char *file = argv[optind++];
+
+    std::vector<std::string> names;
+    for (; optind < argc; optind++) {
+	names.push_back(argv[optind]);
+    }
+    if (names.empty() && shmem_buffers(file, names) < 0) {
+	return 1;
+    }
+
+    set_rcs_print_destination(RCS_PRINT_TO_STDERR);
+    std::vector<stat_buffer> buffers;
+    for (size_t i = 0; i < names.size(); i++) {
+	stat_buffer b;
+	b.name = names[i];
+	b.cms = NULL;
+	if (cms_config(&b.cms, b.name.c_str(), process, file) < 0
+	    || NULL == b.cms || b.cms->status < 0) {
+	    fprintf(stderr, "nmlstat: can't open %s as %s\n",
+		b.name.c_str(), process);
+	    delete b.cms;
+	    continue;
+	}
+	if (NULL == b.cms->get_access_stats()) {
+	    fprintf(stderr, "nmlstat: %s is not a local SHMEM buffer\n",
+		b.name.c_str());
+	    delete b.cms;
+	    continue;
+	}
+	buffers.push_back(b);
+    }
+    if (buffers.empty()) {
+	return 1;
+    }
+
+    for (int n = 0; count == 0 || n < count; n++) {
+	if (n > 0) {
+	    esleep(interval);
+	}
+	for (size_t i = 0; i < buffers.size(); i++) {
+	    report(buffers[i], n == 0);
+	}
+	fflush(stdout);
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+	delete buffers[i].cms;
+    }
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <unistd.h>		/* select(), sysconf(), _SC_CLK_TCK */
 #include <sys/time.h>		/* struct timeval, gettimeofday(), struct
 				   itimerval, setitimer(), ITIMER_REAL */
+#include <time.h>		/* clock_gettime(), clock_nanosleep() */
 
 #include <linux/version.h>
 
@@ -65,40 +66,59 @@ double etime()
     return retval;
 }
 
+/* number of seconds on CLOCK_MONOTONIC, which setting the date does not
+   move; only for comparing with other etime_monotonic() values */
+double etime_monotonic()
+{
+    struct timespec ts;
+
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &ts)) {
+	rcs_print_error("etime_monotonic: can't get time\n");
+	return 0.0;
+    }
+    return ((double) ts.tv_sec) + ((double) ts.tv_nsec) / 1000000000.0;
+}
+
+/* sleeps until etime_monotonic() reaches deadline, or a signal arrives */
+void esleep_until(double deadline)
+{
+    struct timespec ts;
+    int err;
+
+    if (deadline <= 0.0) {
+	return;
+    }
+    ts.tv_sec = (time_t) deadline;	/* double->long truncates, ANSI */
+    ts.tv_nsec = (long) ((deadline - (double) ts.tv_sec) * 1000000000.0);
+    if (ts.tv_nsec >= 1000000000) {
+	ts.tv_sec++;
+	ts.tv_nsec -= 1000000000;
+    }
+    err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    if (err != 0 && err != EINTR) {
+	rcs_print_error("esleep_until: clock_nanosleep error %d -- %s\n",
+	    err, strerror(err));
+    }
+}
+
 int esleep_use_yield = 0;
 
 /* sleeps # of seconds */
 void esleep(double seconds_to_sleep)
 {
-    struct timeval tval;
     static double clk_tck_val = 0;
-    double total = seconds_to_sleep;	/* total sleep asked for */
-    double started = etime();	/* time when called */
-    double left = total;
     if (seconds_to_sleep <= 0.0)
 	return;
     if (clk_tck_val <= 0) {
 	clk_tck_val = clk_tck();
     }
-    do {
-	if (left < clk_tck_val && esleep_use_yield) {
-	    sched_yield();
-	} else {
-	    tval.tv_sec = (long) left;	/* double->long truncates, ANSI */
-	    tval.tv_usec = (long) ((left - (double) tval.tv_sec) * 1000000.0);
-	    if (tval.tv_sec == 0 && tval.tv_usec == 0) {
-		tval.tv_usec = 1;
-	    }
-	    if (select(0, NULL, NULL, NULL, &tval) < 0) {
-		if (errno != EINTR) {
-		    break;
-		}
-	    }
-	}
-	left = total - etime() + started;
+    if (seconds_to_sleep < clk_tck_val && esleep_use_yield) {
+	sched_yield();
+	return;
     }
-    while (left > 0 && (left > clk_tck_val && esleep_use_yield));
-    return;
+    /* An absolute deadline, so time lost between computing it and going
+       to sleep is not added on. */
+    esleep_until(etime_monotonic() + seconds_to_sleep);
 }
 
 void print_etime()
@@ -28,6 +28,9 @@ extern "C" {
     extern double etime(void);
 /* sleeps # of seconds, to clock tick resolution */
     extern void esleep(double secs);
+/* seconds on CLOCK_MONOTONIC, and sleeping until such a time */
+    extern double etime_monotonic(void);
+    extern void esleep_until(double deadline);
     void start_timer_server(int priority, int sem_id);
     void kill_timer_server(void);
     extern void print_etime(void);
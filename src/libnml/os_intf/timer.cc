@@ -77,6 +77,11 @@ void RCS_TIMER::zero_timer()
     counts_since_real_sleep = 0;
     clk_tck_val = clk_tck();
     timeout = clk_tck_val;
+    next_deadline = etime_monotonic();
+    overrun_count = 0;
+    jitter_max = 0.0;
+    jitter_total = 0.0;
+    jitter_counts = 0;
 }
 
 void RCS_TIMER::init(double _timeout, int _id)
@@ -111,6 +116,7 @@ void
 {
     last_time = etime();	/* initialize start time and last time called
 				   to current time since epoch */
+    next_deadline = etime_monotonic();
 }
 
 int RCS_TIMER::wait()
@@ -148,16 +154,50 @@ int RCS_TIMER::wait()
 	idle += interval;
 	last_time = time_done;
         remaining = 0.0;
+	esleep(remaining);
     } else {
-	missed = (int) (numcycles); 
-	remaining = timeout * (1.0 - (numcycles - (int) numcycles));
+	/* sleep to the next deadline not already passed */
+	double now = etime_monotonic();
+	next_deadline += timeout;
+	if (now >= next_deadline) {
+	    missed = 1 + (int) ((now - next_deadline) / timeout);
+	    next_deadline += missed * timeout;
+	}
 	idle += interval;
+	esleep_until(next_deadline);
+	double late = etime_monotonic() - next_deadline;
+	if (late > 0.0) {
+	    if (late > jitter_max) {
+		jitter_max = late;
+	    }
+	    jitter_total += late;
+	}
+	jitter_counts++;
+    }
+    if (missed > 0) {
+	overrun_count += missed;
     }
-    esleep(remaining);
     last_time = etime();
     return missed;
 }
 
+int RCS_TIMER::overruns()
+{
+    return overrun_count;
+}
+
+double RCS_TIMER::jitter()
+{
+    return jitter_max;
+}
+
+double RCS_TIMER::mean_jitter()
+{
+    if (jitter_counts > 0)
+	return jitter_total / jitter_counts;
+    return 0.0;
+}
+
 double RCS_TIMER::load()
 {
     if (counts * timeout != 0.0)
@@ -32,6 +32,12 @@ extern "C" {
     /* Go to sleep for _secs seconds. The time will be rounded up to the
        resolution of the system clock or the most precise sleep or delay
        function available for the given platform. */
+
+    /* seconds on CLOCK_MONOTONIC, only for comparing with each other */
+    extern double etime_monotonic(void);
+    /* Sleep until etime_monotonic() reaches _deadline or a signal
+       arrives. */
+    extern void esleep_until(double _deadline);
 }
 class RCS_SEMAPHORE;
 
@@ -115,6 +121,15 @@ difficult */
        average load over all of the previous cycles. */
     void sync();		/* restart the wait interval. */
     /* Restart the wait interval now. */
+
+    int overruns();		/* cycles missed since creation */
+    double jitter();		/* latest wakeup after a deadline, in s */
+    double mean_jitter();	/* average lateness of wakeups, in s */
+    /* Without a user function, wait() sleeps until absolute deadlines
+       timeout apart on CLOCK_MONOTONIC, so the cycle does not drift by
+       however long each wakeup was late.  jitter() and mean_jitter()
+       measure that lateness; a cycle that overruns skips the deadlines it
+       missed rather than trying to catch up. */
     double timeout;		/* copy of timeout */
 
   private:
@@ -135,6 +150,11 @@ difficult */
     int counts_since_real_sleep;
     int counts_per_real_sleep;
     double time_since_real_sleep;
+    double next_deadline;	/* etime_monotonic() of the next wakeup */
+    int overrun_count;
+    double jitter_max;
+    double jitter_total;
+    int jitter_counts;
 #ifdef USE_SEMS_FOR_TIMER
     RCS_SEMAPHORE **sems;
 #endif
@@ -27,13 +27,6 @@ static PM_CARTESIAN *noCart = 0;
 
 // PM_CARTESIAN class
 
-PM_CARTESIAN::PM_CARTESIAN(double _x, double _y, double _z)
-{
-    x = _x;
-    y = _y;
-    z = _z;
-}
-
 PM_CARTESIAN::PM_CARTESIAN(PM_CONST PM_CYLINDRICAL PM_REF c)
 {
     PmCylindrical cyl;
@@ -67,24 +60,6 @@ double &PM_CARTESIAN::operator [] (int n) {
     }
 }
 
-#ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-PM_CARTESIAN::PM_CARTESIAN(PM_CCONST PM_CARTESIAN & v)
-{
-    x = v.x;
-    y = v.y;
-    z = v.z;
-}
-#endif
-
-PM_CARTESIAN PM_CARTESIAN::operator =(PM_CARTESIAN v)
-{
-    x = v.x;
-    y = v.y;
-    z = v.z;
-
-    return v;
-}
-
 // PM_SPHERICAL
 
 PM_SPHERICAL::PM_SPHERICAL(double _theta, double _phi, double _r)
@@ -483,26 +458,6 @@ double &PM_QUATERNION::operator [] (int n) {
     }
 }
 
-PM_QUATERNION PM_QUATERNION::operator =(PM_QUATERNION q)
-{
-    s = q.s;
-    x = q.x;
-    y = q.y;
-    z = q.z;
-
-    return q;
-}
-
-#ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-PM_QUATERNION::PM_QUATERNION(PM_CCONST PM_QUATERNION & q)
-{
-    s = q.s;
-    x = q.x;
-    y = q.y;
-    z = q.z;
-}
-#endif
-
 // PM_EULER_ZYZ class
 
 PM_EULER_ZYZ::PM_EULER_ZYZ(double _z, double _y, double _zp)
@@ -685,17 +640,6 @@ PM_RPY PM_RPY::operator =(PM_RPY rpy)
 
 // PM_POSE class
 
-PM_POSE::PM_POSE(PM_CARTESIAN v, PM_QUATERNION q)
-{
-    tran.x = v.x;
-    tran.y = v.y;
-    tran.z = v.z;
-    rot.s = q.s;
-    rot.x = q.x;
-    rot.y = q.y;
-    rot.z = q.z;
-}
-
 PM_POSE::PM_POSE(double x, double y, double z,
     double s, double sx, double sy, double sz)
 {
@@ -739,22 +683,6 @@ double &PM_POSE::operator [] (int n) {
     }
 }
 
-#ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-PM_POSE::PM_POSE(PM_CCONST PM_POSE & p)
-{
-    tran = p.tran;
-    rot = p.rot;
-}
-#endif
-
-PM_POSE PM_POSE::operator =(PM_POSE p)
-{
-    tran = p.tran;
-    rot = p.rot;
-
-    return p;
-}
-
 // PM_HOMOGENEOUS class
 
 PM_HOMOGENEOUS::PM_HOMOGENEOUS(PM_CARTESIAN v, PM_ROTATION_MATRIX m)
@@ -907,39 +835,8 @@ int PM_CIRCLE::point(double angle, PM_POSE * point)
     return retval;
 }
 
-// overloaded external functions
-
-// dot
-
-double dot(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    double d;
-    PmCartesian _v1, _v2;
-
-    toCart(v1, &_v1);
-    toCart(v2, &_v2);
-
-    pmCartCartDot(_v1, _v2, &d);
-
-    return d;
-}
-
-// cross
-
-PM_CARTESIAN cross(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    PM_CARTESIAN ret;
-    PmCartesian _v1, _v2;
-
-    toCart(v1, &_v1);
-    toCart(v2, &_v2);
-
-    pmCartCartCross(_v1, _v2, &_v1);
-
-    toCart(_v1, &ret);
-
-    return ret;
-}
+// overloaded external functions; dot, cross, mag and disp are
+// inline in posemath.h
 
 //unit
 
@@ -1054,35 +951,6 @@ int isNorm(PM_ROTATION_MATRIX m)
     return pmMatIsNorm(_m);
 }
 
-// mag
-
-double mag(PM_CARTESIAN v)
-{
-    double ret;
-    PmCartesian _v;
-
-    toCart(v, &_v);
-
-    pmCartMag(_v, &ret);
-
-    return ret;
-}
-
-// disp
-
-double disp(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    double ret;
-    PmCartesian _v1, _v2;
-
-    toCart(v1, &_v1);
-    toCart(v2, &_v2);
-
-    pmCartCartDisp(_v1, _v2, &ret);
-
-    return ret;
-}
-
 // inv
 
 PM_CARTESIAN inv(PM_CARTESIAN v)
@@ -1174,22 +1042,6 @@ PM_CARTESIAN proj(PM_CARTESIAN v1, PM_CARTESIAN v2)
 
 // overloaded arithmetic operators
 
-PM_CARTESIAN operator +(PM_CARTESIAN v)
-{
-    return v;
-}
-
-PM_CARTESIAN operator -(PM_CARTESIAN v)
-{
-    PM_CARTESIAN ret;
-
-    ret.x = -v.x;
-    ret.y = -v.y;
-    ret.z = -v.z;
-
-    return ret;
-}
-
 PM_QUATERNION operator +(PM_QUATERNION q)
 {
     return q;
@@ -1228,16 +1080,6 @@ PM_POSE operator -(PM_POSE p)
     return ret;
 }
 
-int operator ==(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    PmCartesian _v1, _v2;
-
-    toCart(v1, &_v1);
-    toCart(v2, &_v2);
-
-    return pmCartCartCompare(_v1, _v2);
-}
-
 int operator ==(PM_QUATERNION q1, PM_QUATERNION q2)
 {
     PmQuaternion _q1, _q2;
@@ -1258,16 +1100,6 @@ int operator ==(PM_POSE p1, PM_POSE p2)
     return pmPosePoseCompare(_p1, _p2);
 }
 
-int operator !=(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    PmCartesian _v1, _v2;
-
-    toCart(v1, &_v1);
-    toCart(v2, &_v2);
-
-    return !pmCartCartCompare(_v1, _v2);
-}
-
 int operator !=(PM_QUATERNION q1, PM_QUATERNION q2)
 {
     PmQuaternion _q1, _q2;
@@ -1288,71 +1120,6 @@ int operator !=(PM_POSE p1, PM_POSE p2)
     return !pmPosePoseCompare(_p1, _p2);
 }
 
-PM_CARTESIAN operator +(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    PM_CARTESIAN ret;
-
-    ret.x = v1.x + v2.x;
-    ret.y = v1.y + v2.y;
-    ret.z = v1.z + v2.z;
-
-    return ret;
-}
-
-PM_CARTESIAN operator -(PM_CARTESIAN v1, PM_CARTESIAN v2)
-{
-    PM_CARTESIAN ret;
-
-    ret.x = v1.x - v2.x;
-    ret.y = v1.y - v2.y;
-    ret.z = v1.z - v2.z;
-
-    return ret;
-}
-
-PM_CARTESIAN operator *(PM_CARTESIAN v, double s)
-{
-    PM_CARTESIAN ret;
-
-    ret.x = v.x * s;
-    ret.y = v.y * s;
-    ret.z = v.z * s;
-
-    return ret;
-}
-
-PM_CARTESIAN operator *(double s, PM_CARTESIAN v)
-{
-    PM_CARTESIAN ret;
-
-    ret.x = v.x * s;
-    ret.y = v.y * s;
-    ret.z = v.z * s;
-
-    return ret;
-}
-
-PM_CARTESIAN operator /(PM_CARTESIAN v, double s)
-{
-    PM_CARTESIAN ret;
-
-#ifdef PM_DEBUG
-    if (s == 0.0) {
-#ifdef PM_PRINT_ERROR
-	pmPrintError("PM_CARTESIAN::operator / : divide by 0\n");
-#endif
-	pmErrno = PM_DIV_ERR;
-	return ret;
-    }
-#endif
-
-    ret.x = v.x / s;
-    ret.y = v.y / s;
-    ret.z = v.z / s;
-
-    return ret;
-}
-
 PM_QUATERNION operator *(double s, PM_QUATERNION q)
 {
     PM_QUATERNION qout;
@@ -1430,37 +1197,6 @@ PM_QUATERNION operator /(PM_QUATERNION q, double s)
     return qout;
 }
 
-PM_CARTESIAN operator *(PM_QUATERNION q, PM_CARTESIAN v)
-{
-    PM_CARTESIAN vout;
-    PmQuaternion _q;
-    PmCartesian _v;
-
-    toQuat(q, &_q);
-    toCart(v, &_v);
-
-    pmQuatCartMult(_q, _v, &_v);
-
-    toCart(_v, &vout);
-
-    return vout;
-}
-
-PM_QUATERNION operator *(PM_QUATERNION q1, PM_QUATERNION q2)
-{
-    PM_QUATERNION ret;
-    PmQuaternion _q1, _q2;
-
-    toQuat(q1, &_q1);
-    toQuat(q2, &_q2);
-
-    pmQuatQuatMult(_q1, _q2, &_q1);
-
-    toQuat(_q1, &ret);
-
-    return ret;
-}
-
 PM_ROTATION_MATRIX operator *(PM_ROTATION_MATRIX m1, PM_ROTATION_MATRIX m2)
 {
     PM_ROTATION_MATRIX ret;
@@ -1476,33 +1212,3 @@ PM_ROTATION_MATRIX operator *(PM_ROTATION_MATRIX m1, PM_ROTATION_MATRIX m2)
     return ret;
 }
 
-PM_POSE operator *(PM_POSE p1, PM_POSE p2)
-{
-    PM_POSE ret;
-    PmPose _p1, _p2;
-
-    toPose(p1, &_p1);
-    toPose(p2, &_p2);
-
-    pmPosePoseMult(_p1, _p2, &_p1);
-
-    toPose(_p1, &ret);
-
-    return ret;
-}
-
-PM_CARTESIAN operator *(PM_POSE p, PM_CARTESIAN v)
-{
-    PM_CARTESIAN ret;
-    PmPose _p;
-    PmCartesian _v;
-
-    toPose(p, &_p);
-    toCart(v, &_v);
-
-    pmPoseCartMult(_p, _v, &_v);
-
-    toCart(_v, &ret);
-
-    return ret;
-}
@@ -124,10 +124,12 @@ struct PM_CARTESIAN {
     /* ctors/dtors */
     PM_CARTESIAN() {
     };
-    PM_CARTESIAN(double _x, double _y, double _z);
+    PM_CARTESIAN(double _x, double _y, double _z) : x(_x), y(_y), z(_z) {
+    };
 #ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-    PM_CARTESIAN(PM_CCONST PM_CARTESIAN & cart);	// added 7-May-1997
-    // by WPS
+    PM_CARTESIAN(PM_CCONST PM_CARTESIAN & cart)	// added 7-May-1997
+	: x(cart.x), y(cart.y), z(cart.z) {	// by WPS
+    };
 #endif
 
     PM_CARTESIAN(PM_CONST PM_CYLINDRICAL PM_REF c);	/* conversion */
@@ -135,7 +137,12 @@ struct PM_CARTESIAN {
 
     /* operators */
     double &operator[] (int n);	/* this[n] */
-    PM_CARTESIAN operator = (PM_CARTESIAN v);	/* this = v */
+    PM_CARTESIAN operator = (PM_CARTESIAN v) {	/* this = v */
+	x = v.x;
+	y = v.y;
+	z = v.z;
+	return v;
+    };
 
     /* data */
     double x, y, z;		/* this.x, etc. */
@@ -245,8 +252,10 @@ struct PM_QUATERNION {
     PM_QUATERNION() {
     };
 #ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-    PM_QUATERNION(PM_CCONST PM_QUATERNION & quat);	/* added 7-May-1997
+    PM_QUATERNION(PM_CCONST PM_QUATERNION & quat)	/* added 7-May-1997
 							   by WPS */
+	: s(quat.s), x(quat.x), y(quat.y), z(quat.z) {
+    };
 #endif
     PM_QUATERNION(double _s, double _x, double _y, double _z);
     PM_QUATERNION(PM_CONST PM_ROTATION_VECTOR PM_REF v);	/* conversion 
@@ -260,7 +269,13 @@ struct PM_QUATERNION {
 
     /* operators */
     double &operator[] (int n);	/* this[n] */
-    PM_QUATERNION operator = (PM_QUATERNION q);	/* this = q */
+    PM_QUATERNION operator = (PM_QUATERNION q) {	/* this = q */
+	s = q.s;
+	x = q.x;
+	y = q.y;
+	z = q.z;
+	return q;
+    };
 
     /* functions */
     void axisAngleMult(PM_AXIS axis, double angle);
@@ -339,16 +354,22 @@ struct PM_POSE {
     PM_POSE() {
     };
 #ifdef INCLUDE_POSEMATH_COPY_CONSTRUCTORS
-    PM_POSE(PM_CCONST PM_POSE & p);
+    PM_POSE(PM_CCONST PM_POSE & p) : tran(p.tran), rot(p.rot) {
+    };
 #endif
-    PM_POSE(PM_CARTESIAN v, PM_QUATERNION q);
+    PM_POSE(PM_CARTESIAN v, PM_QUATERNION q) : tran(v), rot(q) {
+    };
     PM_POSE(double x, double y, double z,
 	double s, double sx, double sy, double sz);
     PM_POSE(PM_CONST PM_HOMOGENEOUS PM_REF h);	/* conversion */
 
     /* operators */
     double &operator[] (int n);	/* this[n] */
-    PM_POSE operator = (PM_POSE p);	/* this = p */
+    PM_POSE operator = (PM_POSE p) {	/* this = p */
+	tran = p.tran;
+	rot = p.rot;
+	return p;
+    };
 
     /* data */
     PM_CARTESIAN tran;
@@ -424,11 +445,15 @@ struct PM_CIRCLE {
 
 /* overloaded external functions */
 
+/* the ones declared inline here are defined at the end of this file,
+   where the C functions they stand in for have been declared; they do
+   the same arithmetic and leave pmErrno as those functions would */
+
 /* dot */
-extern double dot(PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline double dot(PM_CARTESIAN v1, PM_CARTESIAN v2);
 
 /* cross */
-extern PM_CARTESIAN cross(PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline PM_CARTESIAN cross(PM_CARTESIAN v1, PM_CARTESIAN v2);
 
 #if 0
 /* norm */
@@ -451,10 +476,10 @@ extern int isNorm(PM_ROTATION_VECTOR r);
 extern int isNorm(PM_ROTATION_MATRIX m);
 
 /* mag */
-extern double mag(PM_CARTESIAN v);
+inline double mag(PM_CARTESIAN v);
 
 /* disp */
-extern double disp(PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline double disp(PM_CARTESIAN v1, PM_CARTESIAN v2);
 
 /* inv */
 extern PM_CARTESIAN inv(PM_CARTESIAN v);
@@ -469,33 +494,33 @@ extern PM_CARTESIAN proj(PM_CARTESIAN v1, PM_CARTESIAN v2);
 /* overloaded arithmetic functions */
 
 /* unary +, - for translation, rotation, pose */
-extern PM_CARTESIAN operator + (PM_CARTESIAN v);
-extern PM_CARTESIAN operator - (PM_CARTESIAN v);
+inline PM_CARTESIAN operator + (PM_CARTESIAN v);
+inline PM_CARTESIAN operator - (PM_CARTESIAN v);
 extern PM_QUATERNION operator + (PM_QUATERNION q);
 extern PM_QUATERNION operator - (PM_QUATERNION q);
 extern PM_POSE operator + (PM_POSE p);
 extern PM_POSE operator - (PM_POSE p);
 
 /* compare operators */
-extern int operator == (PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline int operator == (PM_CARTESIAN v1, PM_CARTESIAN v2);
 extern int operator == (PM_QUATERNION q1, PM_QUATERNION q2);
 extern int operator == (PM_POSE p1, PM_POSE p2);
-extern int operator != (PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline int operator != (PM_CARTESIAN v1, PM_CARTESIAN v2);
 extern int operator != (PM_QUATERNION q1, PM_QUATERNION q2);
 extern int operator != (PM_POSE p1, PM_POSE p2);
 
 /* translation +, -, scalar *, - */
 
 /* v + v */
-extern PM_CARTESIAN operator + (PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline PM_CARTESIAN operator + (PM_CARTESIAN v1, PM_CARTESIAN v2);
 /* v - v */
-extern PM_CARTESIAN operator - (PM_CARTESIAN v1, PM_CARTESIAN v2);
+inline PM_CARTESIAN operator - (PM_CARTESIAN v1, PM_CARTESIAN v2);
 /* v * s */
-extern PM_CARTESIAN operator *(PM_CARTESIAN v, double s);
+inline PM_CARTESIAN operator *(PM_CARTESIAN v, double s);
 /* s * v */
-extern PM_CARTESIAN operator *(double s, PM_CARTESIAN v);
+inline PM_CARTESIAN operator *(double s, PM_CARTESIAN v);
 /* v / s */
-extern PM_CARTESIAN operator / (PM_CARTESIAN v, double s);
+inline PM_CARTESIAN operator / (PM_CARTESIAN v, double s);
 
 /* rotation * by scalar, translation, and rotation */
 
@@ -506,9 +531,9 @@ extern PM_QUATERNION operator *(PM_QUATERNION q, double s);
 /* q / s */
 extern PM_QUATERNION operator / (PM_QUATERNION q, double s);
 /* q * v */
-extern PM_CARTESIAN operator *(PM_QUATERNION q, PM_CARTESIAN v);
+inline PM_CARTESIAN operator *(PM_QUATERNION q, PM_CARTESIAN v);
 /* q * q */
-extern PM_QUATERNION operator *(PM_QUATERNION q1, PM_QUATERNION q2);
+inline PM_QUATERNION operator *(PM_QUATERNION q1, PM_QUATERNION q2);
 /* m * m */
 extern PM_ROTATION_MATRIX operator *(PM_ROTATION_MATRIX m1,
     PM_ROTATION_MATRIX m2);
@@ -518,9 +543,9 @@ extern PM_ROTATION_MATRIX operator *(PM_ROTATION_MATRIX m1,
 /* q * p */
 extern PM_POSE operator *(PM_QUATERNION q, PM_POSE p);
 /* p * p */
-extern PM_POSE operator *(PM_POSE p1, PM_POSE p2);
+inline PM_POSE operator *(PM_POSE p1, PM_POSE p2);
 /* p * v */
-extern PM_CARTESIAN operator *(PM_POSE p, PM_CARTESIAN v);
+inline PM_CARTESIAN operator *(PM_POSE p, PM_CARTESIAN v);
 
 #endif /* __cplusplus */
 
@@ -951,5 +976,129 @@ extern "C" {
 
 #ifdef __cplusplus
 }				/* matches extern "C" for C++ */
+
+/* inline C++ functions and operators */
+
+inline double dot(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    pmErrno = 0;
+    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+inline PM_CARTESIAN cross(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    pmErrno = 0;
+    return PM_CARTESIAN(v1.y * v2.z - v1.z * v2.y,
+	v1.z * v2.x - v1.x * v2.z,
+	v1.x * v2.y - v1.y * v2.x);
+}
+
+inline double mag(PM_CARTESIAN v)
+{
+    pmErrno = 0;
+    return pmSqrt(pmSq(v.x) + pmSq(v.y) + pmSq(v.z));
+}
+
+inline double disp(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    pmErrno = 0;
+    return pmSqrt(pmSq(v2.x - v1.x) + pmSq(v2.y - v1.y) + pmSq(v2.z - v1.z));
+}
+
+inline PM_CARTESIAN operator +(PM_CARTESIAN v)
+{
+    return v;
+}
+
+inline PM_CARTESIAN operator -(PM_CARTESIAN v)
+{
+    return PM_CARTESIAN(-v.x, -v.y, -v.z);
+}
+
+/* as pmCartCartCompare, which is fabs(difference) < V_FUZZ for each */
+inline int operator ==(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    double dx = v1.x - v2.x, dy = v1.y - v2.y, dz = v1.z - v2.z;
+
+    return !(dx >= V_FUZZ || dx <= -V_FUZZ ||
+	dy >= V_FUZZ || dy <= -V_FUZZ || dz >= V_FUZZ || dz <= -V_FUZZ);
+}
+
+inline int operator !=(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    return !(v1 == v2);
+}
+
+inline PM_CARTESIAN operator +(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    return PM_CARTESIAN(v1.x + v2.x, v1.y + v2.y, v1.z + v2.z);
+}
+
+inline PM_CARTESIAN operator -(PM_CARTESIAN v1, PM_CARTESIAN v2)
+{
+    return PM_CARTESIAN(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z);
+}
+
+inline PM_CARTESIAN operator *(PM_CARTESIAN v, double s)
+{
+    return PM_CARTESIAN(v.x * s, v.y * s, v.z * s);
+}
+
+inline PM_CARTESIAN operator *(double s, PM_CARTESIAN v)
+{
+    return PM_CARTESIAN(v.x * s, v.y * s, v.z * s);
+}
+
+inline PM_CARTESIAN operator /(PM_CARTESIAN v, double s)
+{
+    return PM_CARTESIAN(v.x / s, v.y / s, v.z / s);
+}
+
+/* as pmQuatCartMult */
+inline PM_CARTESIAN operator *(PM_QUATERNION q, PM_CARTESIAN v)
+{
+    double cx = q.y * v.z - q.z * v.y;
+    double cy = q.z * v.x - q.x * v.z;
+    double cz = q.x * v.y - q.y * v.x;
+
+    pmErrno = 0;
+    return PM_CARTESIAN(v.x + 2.0 * (q.s * cx + q.y * cz - q.z * cy),
+	v.y + 2.0 * (q.s * cy + q.z * cx - q.x * cz),
+	v.z + 2.0 * (q.s * cz + q.x * cy - q.y * cx));
+}
+
+/* as pmQuatQuatMult, which keeps s positive; built a member at a time
+   since the (s, x, y, z) constructor normalizes */
+inline PM_QUATERNION operator *(PM_QUATERNION q1, PM_QUATERNION q2)
+{
+    PM_QUATERNION ret;
+
+    ret.s = q1.s * q2.s - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z;
+    ret.x = q1.s * q2.x + q1.x * q2.s + q1.y * q2.z - q1.z * q2.y;
+    ret.y = q1.s * q2.y - q1.x * q2.z + q1.y * q2.s + q1.z * q2.x;
+    ret.z = q1.s * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.s;
+    if (ret.s < 0.0) {
+	ret.s = -ret.s;
+	ret.x = -ret.x;
+	ret.y = -ret.y;
+	ret.z = -ret.z;
+    }
+    pmErrno = 0;
+    return ret;
+}
+
+inline PM_POSE operator *(PM_POSE p1, PM_POSE p2)
+{
+    PM_POSE ret;
+
+    ret.tran = p1.tran + p1.rot * p2.tran;
+    ret.rot = p1.rot * p2.rot;
+    return ret;
+}
+
+inline PM_CARTESIAN operator *(PM_POSE p, PM_CARTESIAN v)
+{
+    return p.tran + p.rot * v;
+}
 #endif
 #endif				/* #ifndef POSEMATH_H */
@@ -24,6 +24,8 @@ extern "C" {
 
 #include <sys/types.h>
 #include <unistd.h>		/* getpid() */
+#include <pthread.h>		/* pthread_create() */
+#include <semaphore.h>		/* sem_post(), sem_wait() */
 
 #ifdef __cplusplus
 }
@@ -294,6 +296,10 @@ int rcs_vprint(const char *_fmt, va_list _args, int save_string)
     if (strlen(_fmt) > 200) {	/* Might overflow temp_string. */
 	return (EOF);
     }
+    /* Nothing will be printed, so only format what must be saved. */
+    if (!save_string && rcs_print_destination == RCS_PRINT_TO_NULL) {
+	return (0);
+    }
     if (EOF == (int) vsnprintf(temp_string, sizeof(temp_string), _fmt, _args)) {
 	return (EOF);
     }
@@ -327,14 +333,192 @@ int rcs_puts(const char *_str)
     return (retval);
 }
 
+/* Asynchronous printing.
+
+   Once set_rcs_print_async(1) has been called, strings headed for stdout,
+   stderr or the print file are copied into a fixed ring and written by a
+   background thread, so the caller never waits on the terminal or the
+   disk.  Any number of threads may add to the ring without taking a lock:
+   each slot carries a sequence number telling whether it is free for the
+   writer at a given position or holds a finished string for the reader.
+   When the ring is full, strings are dropped and counted rather than
+   blocking the caller, and the writer reports how many were lost. */
+#define RCS_PRINT_RING_SIZE 256	/* must be a power of two */
+#define RCS_PRINT_SLOT_SIZE 512
+
+struct RCS_PRINT_SLOT {
+    volatile unsigned long seq;
+    RCS_PRINT_DESTINATION_TYPE dest;	/* as it was when queued */
+    char text[RCS_PRINT_SLOT_SIZE];
+};
+
+static RCS_PRINT_SLOT *rcs_print_ring = NULL;
+static volatile unsigned long rcs_print_ring_head = 0;
+static unsigned long rcs_print_ring_tail = 0;
+static volatile unsigned long rcs_print_ring_dropped = 0;
+static sem_t rcs_print_ring_sem;
+static pthread_t rcs_print_writer;
+static volatile int rcs_print_async_running = 0;
+static volatile int rcs_print_async_exit = 0;
+static int rcs_print_async_atexit = 0;
+
+static int rcs_fputs_now(const char *_str,
+    RCS_PRINT_DESTINATION_TYPE _dest);
+
+static int rcs_print_ring_put(const char *_str, size_t len)
+{
+    unsigned long pos = rcs_print_ring_head;
+    RCS_PRINT_SLOT *slot;
+
+    for (;;) {
+	slot = &rcs_print_ring[pos & (RCS_PRINT_RING_SIZE - 1)];
+	long diff = (long) (slot->seq - pos);
+	if (diff == 0) {
+	    if (__sync_bool_compare_and_swap(&rcs_print_ring_head, pos,
+		    pos + 1)) {
+		break;
+	    }
+	    pos = rcs_print_ring_head;
+	} else if (diff < 0) {
+	    __sync_fetch_and_add(&rcs_print_ring_dropped, 1);
+	    return (EOF);
+	} else {
+	    pos = rcs_print_ring_head;
+	}
+    }
+    slot->dest = rcs_print_destination;
+    memcpy(slot->text, _str, len);
+    slot->text[len] = 0;
+    __sync_synchronize();
+    slot->seq = pos + 1;
+    sem_post(&rcs_print_ring_sem);
+    return ((int) len);
+}
+
+/* Writes out everything the ring holds; only the writer thread, or the
+   thread that stopped it, calls this. */
+static void rcs_print_ring_drain()
+{
+    for (;;) {
+	RCS_PRINT_SLOT *slot =
+	    &rcs_print_ring[rcs_print_ring_tail & (RCS_PRINT_RING_SIZE - 1)];
+	if (slot->seq != rcs_print_ring_tail + 1) {
+	    break;
+	}
+	__sync_synchronize();
+	rcs_fputs_now(slot->text, slot->dest);
+	__sync_synchronize();
+	slot->seq = rcs_print_ring_tail + RCS_PRINT_RING_SIZE;
+	rcs_print_ring_tail++;
+    }
+    unsigned long dropped =
+	__sync_fetch_and_and(&rcs_print_ring_dropped, 0);
+    if (dropped > 0) {
+	char msg[80];
+	snprintf(msg, sizeof(msg),
+	    "rcs_print: %lu messages dropped, print ring full\n", dropped);
+	rcs_fputs_now(msg, rcs_print_destination);
+    }
+}
+
+static void *rcs_print_writer_main(void *)
+{
+    while (!rcs_print_async_exit) {
+	while (sem_wait(&rcs_print_ring_sem) != 0 && errno == EINTR) {
+	}
+	rcs_print_ring_drain();
+    }
+    return (NULL);
+}
+
+static void rcs_print_async_stop()
+{
+    set_rcs_print_async(0);
+}
+
+int set_rcs_print_async(int _enable)
+{
+    if (_enable && !rcs_print_async_running) {
+	if (NULL == rcs_print_ring) {
+	    rcs_print_ring = (RCS_PRINT_SLOT *)
+		malloc(sizeof(RCS_PRINT_SLOT) * RCS_PRINT_RING_SIZE);
+	    if (NULL == rcs_print_ring) {
+		return -1;
+	    }
+	    if (sem_init(&rcs_print_ring_sem, 0, 0) != 0) {
+		free(rcs_print_ring);
+		rcs_print_ring = NULL;
+		return -1;
+	    }
+	}
+	for (unsigned long i = 0; i < RCS_PRINT_RING_SIZE; i++) {
+	    rcs_print_ring[i].seq = rcs_print_ring_head + i;
+	}
+	rcs_print_ring_tail = rcs_print_ring_head;
+	rcs_print_async_exit = 0;
+	if (pthread_create(&rcs_print_writer, NULL, rcs_print_writer_main,
+		NULL) != 0) {
+	    return -1;
+	}
+	__sync_synchronize();
+	rcs_print_async_running = 1;
+	/* Make sure what is still queued at exit gets written. */
+	if (!rcs_print_async_atexit) {
+	    atexit(rcs_print_async_stop);
+	    rcs_print_async_atexit = 1;
+	}
+    } else if (!_enable && rcs_print_async_running) {
+	rcs_print_async_running = 0;
+	__sync_synchronize();
+	rcs_print_async_exit = 1;
+	sem_post(&rcs_print_ring_sem);
+	pthread_join(rcs_print_writer, NULL);
+	rcs_print_ring_drain();
+    }
+    return 0;
+}
+
 int rcs_fputs(const char *_str)
+{
+    if (NULL != _str && rcs_print_async_running && NULL == rcs_print_notify) {
+	switch (rcs_print_destination) {
+	case RCS_PRINT_TO_LOGGER:
+	case RCS_PRINT_TO_STDOUT:
+	case RCS_PRINT_TO_STDERR:
+	case RCS_PRINT_TO_FILE:
+	    {
+		/* Longer strings go through the ring in pieces. */
+		size_t len = strlen(_str);
+		int retval = (int) len;
+		while (len > 0) {
+		    size_t piece = len;
+		    if (piece > RCS_PRINT_SLOT_SIZE - 1) {
+			piece = RCS_PRINT_SLOT_SIZE - 1;
+		    }
+		    if (EOF == rcs_print_ring_put(_str, piece)) {
+			retval = EOF;
+		    }
+		    _str += piece;
+		    len -= piece;
+		}
+		return (retval);
+	    }
+	default:
+	    break;
+	}
+    }
+    return (rcs_fputs_now(_str, rcs_print_destination));
+}
+
+static int rcs_fputs_now(const char *_str,
+    RCS_PRINT_DESTINATION_TYPE _dest)
 {
     int retval = EOF;
     if (NULL != _str) {
 	if (0 == _str[0]) {
 	    return (0);
 	}
-	switch (rcs_print_destination) {
+	switch (_dest) {
 	case RCS_PRINT_TO_LOGGER:
 
 	case RCS_PRINT_TO_STDOUT:
@@ -392,6 +576,7 @@ int rcs_fputs(const char *_str)
 
 void close_rcs_printing()
 {
+    set_rcs_print_async(0);
     switch (rcs_print_destination) {
     case RCS_PRINT_TO_LIST:
 	clean_print_list();
@@ -417,11 +602,17 @@ int set_rcs_print_file(char *_file_name)
     if (strlen(_file_name) > 80) {
 	return -1;
     }
+    /* The writer thread owns the stream while it runs. */
+    int was_async = rcs_print_async_running;
+    set_rcs_print_async(0);
     strcpy(rcs_print_file_name, _file_name);
     if (NULL != rcs_print_file_stream) {
 	fclose(rcs_print_file_stream);
     }
     rcs_print_file_stream = fopen(rcs_print_file_name, "a+");
+    if (was_async) {
+	set_rcs_print_async(1);
+    }
     if (NULL == rcs_print_file_stream) {
 	return -1;
     }
@@ -433,6 +624,9 @@ int rcs_print(const char *_fmt, ...)
     static char temp_buffer[400];
     int retval;
     va_list args;
+    if (rcs_print_destination == RCS_PRINT_TO_NULL) {
+	return (0);
+    }
     va_start(args, _fmt);
     retval = vsnprintf(temp_buffer, sizeof(temp_buffer), _fmt, args);
     va_end(args);
@@ -488,7 +682,8 @@ int rcs_print_debug(long flag_to_check, const char *_fmt, ...)
     va_list args;
     va_start(args, _fmt);
 
-    if (flag_to_check & rcs_print_mode_flags) {
+    if ((flag_to_check & rcs_print_mode_flags)
+	&& rcs_print_destination != RCS_PRINT_TO_NULL) {
 	pid = getpid();
 	rcs_print("(time=%f,pid=%d): ", etime(), pid);
 	retval = rcs_vprint(_fmt, args, 0);
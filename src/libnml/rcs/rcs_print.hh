@@ -99,6 +99,13 @@ extern "C" {
     typedef void (*RCS_PRINT_NOTIFY_FUNC_PTR) (void);
     extern void set_rcs_print_notify(RCS_PRINT_NOTIFY_FUNC_PTR);
     extern int set_rcs_print_file(const char *_file_name);
+    extern int set_rcs_print_async(int _enable);
+    /* With _enable set, output to stdout, stderr or the print file is
+       queued and written by a background thread instead of while the
+       caller waits; messages are dropped, and counted, if the queue
+       fills. Clearing it, or close_rcs_printing(), writes out what is
+       queued and returns to printing directly. Returns -1 if the thread
+       could not be started. */
     extern void close_rcs_printing(void);
 
 #ifdef __cplusplus
@@ -651,6 +651,13 @@ static int rtapi_trap_handler(int vec, int signo, struct pt_regs *regs,
 
 int rtapi_task_new(void (*taskcode) (void *), void *arg,
     int prio, int owner, unsigned long int stacksize, int uses_fp)
+{
+    return rtapi_task_new_cpu(taskcode, arg, prio, owner, stacksize,
+	uses_fp, -1);
+}
+
+int rtapi_task_new_cpu(void (*taskcode) (void *), void *arg,
+    int prio, int owner, unsigned long int stacksize, int uses_fp, int cpu)
 {
     int n;
     long task_id;
@@ -686,6 +693,19 @@ int rtapi_task_new(void (*taskcode) (void *), void *arg,
 	rtapi_mutex_give(&(rtapi_data->mutex));
 	return -EINVAL;
     }
+    /* check requested CPU */
+    if (cpu < 0) {
+	cpu = rtapi_data->rt_cpu;
+    }
+#if LINUX_VERSION_CODE > KERNEL_VERSION(2,6,0)
+    if ((cpu >= NR_CPUS) || !cpu_online(cpu)) {
+#else
+    if (cpu != 0) {
+#endif
+	rtapi_mutex_give(&(rtapi_data->mutex));
+	rtapi_print_msg(RTAPI_MSG_ERR, "RTAPI: CPU %d is not online\n", cpu);
+	return -EINVAL;
+    }
     /* get space for the OS's task data - this is around 900 bytes, */
     /* so we don't want to statically allocate it for unused tasks. */
     ostask_array[task_id] = kmalloc(sizeof(RT_TASK), GFP_USER);
@@ -695,9 +715,9 @@ int rtapi_task_new(void (*taskcode) (void *), void *arg,
     }
     task->taskcode = taskcode;
     task->arg = arg;
-    /* call OS to initialize the task - use predetermined CPU */
+    /* call OS to initialize the task on the chosen CPU */
     retval = rt_task_init_cpuid(ostask_array[task_id], wrapper, task_id,
-	 stacksize, prio, uses_fp, 0 /* signal */, rtapi_data->rt_cpu );
+	 stacksize, prio, uses_fp, 0 /* signal */, cpu );
     if (retval != 0) {
 	/* couldn't create task, free task data memory */
 	kfree(ostask_array[task_id]);
@@ -725,8 +745,8 @@ int rtapi_task_new(void (*taskcode) (void *), void *arg,
     rtapi_data->task_count++;
     /* announce the birth of a brand new baby task */
     rtapi_print_msg(RTAPI_MSG_DBG,
-	"RTAPI: task %02ld installed by module %02d, priority %d, code: %p\n",
-	task_id, task->owner, task->prio, taskcode);
+	"RTAPI: task %02ld installed by module %02d, priority %d, cpu %d, code: %p\n",
+	task_id, task->owner, task->prio, cpu, taskcode);
     /* and return the ID to the proud parent */
     rtapi_mutex_give(&(rtapi_data->mutex));
     return task_id;
@@ -1724,6 +1744,7 @@ EXPORT_SYMBOL(rtapi_prio_lowest);
 EXPORT_SYMBOL(rtapi_prio_next_higher);
 EXPORT_SYMBOL(rtapi_prio_next_lower);
 EXPORT_SYMBOL(rtapi_task_new);
+EXPORT_SYMBOL(rtapi_task_new_cpu);
 EXPORT_SYMBOL(rtapi_task_delete);
 EXPORT_SYMBOL(rtapi_task_start);
 EXPORT_SYMBOL(rtapi_wait);
@@ -208,6 +208,10 @@ RTAPI_BEGIN_DECLS
 #include <linux/sched.h>	/* for blocking when needed */
 #else
 #include <sched.h>		/* for blocking when needed */
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>	/* for sleeping when the mutex is held */
 #endif
 #include "rtapi_bitops.h"	/* atomic bit ops for lightweight mutex */
 
@@ -219,14 +223,36 @@ RTAPI_BEGIN_DECLS
     blocking, and can be used anywhere.  The 'get' function blocks if
     the mutex is already taken, and can only be used in user space or
     the init code of a realtime module, _not_ in realtime code.
+
+    Bit 0 of the mutex word is the mutex itself.  In user space a 'get'
+    that can't have it soon sets bit 1, to say it is waiting, and
+    sleeps in a futex on the word; a user space 'give' that finds bit
+    1 set wakes one waiter.  A kernel 'give' doesn't wake anyone, so
+    waiters only sleep for RTAPI_MUTEX_SLEEP_NS at a time.
 */
 
+#if !defined(RTAPI) || defined(SIM)
+#define RTAPI_MUTEX_SPINS 100		/* tries before sleeping */
+#define RTAPI_MUTEX_SLEEP_NS 10000000	/* longest sleep before a retry */
+
+    /* a futex on the first 32 bits of the word, where bits 0 and 1 are */
+    static __inline__ void rtapi_mutex_futex(unsigned long *mutex,
+	int op, int val, const struct timespec *timeout) {
+	syscall(SYS_futex, (int *) mutex, op, val, timeout, NULL, 0);
+    }
+#endif
+
 /** 'rtapi_mutex_give()' releases the mutex pointed to by 'mutex'.
     The release is unconditional, even if the caller doesn't have
     the mutex, it will be released.
 */
     static __inline__ void rtapi_mutex_give(unsigned long *mutex) {
 	test_and_clear_bit(0, mutex);
+#if !defined(RTAPI) || defined(SIM)
+	if (test_and_clear_bit(1, mutex)) {
+	    rtapi_mutex_futex(mutex, FUTEX_WAKE, 1, NULL);
+	}
+#endif
     }
 /** 'rtapi_mutex_try()' makes a non-blocking attempt to get the
     mutex pointed to by 'mutex'.  If the mutex was available, it
@@ -247,13 +273,30 @@ RTAPI_BEGIN_DECLS
     do.
 */
     static __inline__ void rtapi_mutex_get(unsigned long *mutex) {
-	while (test_and_set_bit(0, mutex)) {
 #if defined(RTAPI) && !defined(SIM)
+	while (test_and_set_bit(0, mutex)) {
 	    schedule();
+	}
 #else
-	    sched_yield();
-#endif
+	struct timespec sleep = { 0, RTAPI_MUTEX_SLEEP_NS };
+	int n;
+
+	for (n = 0; n < RTAPI_MUTEX_SPINS; n++) {
+	    if (!test_and_set_bit(0, mutex)) {
+		return;
+	    }
 	}
+	/* once waiting, the mutex is taken with bit 1 set, since whoever
+	   gave it only woke one of what may be several waiters */
+	while (1) {
+	    test_and_set_bit(1, mutex);
+	    if (!test_and_set_bit(0, mutex)) {
+		return;
+	    }
+	    /* sleeps only if the word is still 'held, waited for' */
+	    rtapi_mutex_futex(mutex, FUTEX_WAIT, 3, &sleep);
+	}
+#endif
     }
 
 /***********************************************************************
@@ -424,6 +467,19 @@ RTAPI_BEGIN_DECLS
     extern int rtapi_task_new(void (*taskcode) (void *), void *arg,
 	int prio, int owner, unsigned long int stacksize, int uses_fp);
 
+/** 'rtapi_task_new_cpu()' is the same as rtapi_task_new(), but runs
+    the task on CPU number 'cpu' instead of the one RTAPI picks for
+    realtime tasks, so a task can be given a core of its own (for
+    example one reserved with the 'isolcpus=' boot option).  A 'cpu'
+    of -1 means the default; rtapi_task_new() is equivalent to passing
+    -1.  Returns -EINVAL if 'cpu' is not an online CPU.  In the
+    simulator all tasks share one process, so 'cpu' sets the affinity
+    of that whole process.
+*/
+    extern int rtapi_task_new_cpu(void (*taskcode) (void *), void *arg,
+	int prio, int owner, unsigned long int stacksize, int uses_fp,
+	int cpu);
+
 /** 'rtapi_task_delete()' deletes a task.  'task_id' is a task ID
     from a previous call to rtapi_task_new().  It frees memory
     associated with 'task', and does any other cleanup needed.  If
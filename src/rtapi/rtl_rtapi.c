@@ -688,6 +688,13 @@ static void *wrapper(void *wrapper_arg)
 
 int rtapi_task_new(void (*taskcode) (void *), void *arg,
     int prio, int owner, unsigned long int stacksize, int uses_fp)
+{
+    return rtapi_task_new_cpu(taskcode, arg, prio, owner, stacksize,
+	uses_fp, -1);
+}
+
+int rtapi_task_new_cpu(void (*taskcode) (void *), void *arg,
+    int prio, int owner, unsigned long int stacksize, int uses_fp, int cpu)
 {
     int n;
     int task_id;
@@ -736,8 +743,11 @@ int rtapi_task_new(void (*taskcode) (void *), void *arg,
     if (retval != 0) {
 	return -EINVAL;
     }
-    /* use pre-determined CPU for RT tasks */
-    pthread_attr_setcpu_np(&attr, rtapi_data->rt_cpu);
+    /* use pre-determined CPU for RT tasks, unless told otherwise */
+    if (cpu < 0) {
+	cpu = rtapi_data->rt_cpu;
+    }
+    pthread_attr_setcpu_np(&attr, cpu);
     pthread_attr_setfp_np(&attr, uses_fp);
     task->taskcode = taskcode;
     task->arg = arg;
@@ -1736,6 +1746,7 @@ unsigned char rtapi_inb(unsigned int port)
 EXPORT_SYMBOL(rtapi_init);
 EXPORT_SYMBOL(rtapi_exit);
 EXPORT_SYMBOL(rtapi_task_new);
+EXPORT_SYMBOL(rtapi_task_new_cpu);
 EXPORT_SYMBOL(rtapi_prio_next_lower);
 EXPORT_SYMBOL(rtapi_prio_highest);
 EXPORT_SYMBOL(rtapi_vsnprintf);
@@ -6,6 +6,12 @@ static int msg_level = RTAPI_MSG_ERR;	/* message printing level */
 
 #include <sys/ipc.h>		/* IPC_* */
 #include <sys/shm.h>		/* shmget() */
+#include <sys/mman.h>		/* mlock() */
+#include <sys/syscall.h>	/* SYS_mbind */
+#include <stdlib.h>		/* getenv() */
+#include <unistd.h>		/* sysconf(), access() */
+#include <errno.h>
+#include <string.h>
 /* These structs hold data associated with objects like tasks, etc. */
 /* Task handles are pointers to these structs.                      */
 
@@ -24,10 +30,125 @@ typedef struct {
 
 static rtapi_shmem_handle shmem_array[MAX_SHM] = {{0},};
 
+/* Segments can be given the memory an RT thread wants before anyone
+   touches them.  With SIM_RTAPI_SHM_HUGE set, those of at least
+   SHM_HUGE_MIN bytes come from huge pages (SHM_HUGETLB), falling back
+   to ordinary pages if none are reserved; with SIM_RTAPI_SHM_CPU=n,
+   new segments are placed on the NUMA node of CPU n.  Either way, the
+   creator faults in every page at once and the RT side locks the
+   segment, so no thread takes a page fault in it later. */
+#define SHM_HUGE_MIN (64 * 1024)
+
+#ifndef SHM_HUGETLB
+#define SHM_HUGETLB 04000
+#endif
+#define SHM_MPOL_PREFERRED 1	/* MPOL_PREFERRED, from linux/mempolicy.h */
+#define SHM_MAX_NODES (8 * sizeof(unsigned long))
+
+static unsigned long huge_page_size(void)
+{
+  FILE *f;
+  char line[80];
+  unsigned long kb = 0;
+
+  f = fopen("/proc/meminfo", "r");
+  if(f) {
+    while(fgets(line, sizeof(line), f)) {
+      if(sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) break;
+    }
+    fclose(f);
+  }
+  return kb ? kb * 1024 : 2 * 1024 * 1024;
+}
+
+/* the node CPU 'cpu' belongs to, or -1 if it can't be found */
+static int cpu_node(int cpu)
+{
+  char path[80];
+  unsigned node;
+
+  for(node = 0; node < SHM_MAX_NODES; node++) {
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%u",
+	    cpu, node);
+    if(access(path, F_OK) == 0) return node;
+  }
+  return -1;
+}
+
+static int shmem_get(int key, unsigned long int size, int *created)
+{
+  static int huge_warned = 0;
+  int id;
+
+  *created = 0;
+  if(size >= SHM_HUGE_MIN && getenv("SIM_RTAPI_SHM_HUGE")) {
+    unsigned long huge = huge_page_size();
+    unsigned long rounded = (size + huge - 1) / huge * huge;
+
+    id = shmget((key_t) key, rounded,
+	    IPC_CREAT | IPC_EXCL | SHM_HUGETLB | 0666);
+    if(id != -1) {
+      *created = 1;
+      return id;
+    }
+    if(errno != EEXIST && !huge_warned) {
+      rtapi_print_msg(RTAPI_MSG_WARN,
+	      "could not get huge pages for shmem: %s; using normal pages\n",
+	      strerror(errno));
+      huge_warned = 1;
+    }
+  }
+  id = shmget((key_t) key, size, IPC_CREAT | IPC_EXCL | 0666);
+  if(id != -1) {
+    *created = 1;
+    return id;
+  }
+  if(errno != EEXIST) return -1;
+  return shmget((key_t) key, size, 0666);
+}
+
+static void shmem_place(void *mem, unsigned long int size, int created)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  const char *cpu = getenv("SIM_RTAPI_SHM_CPU");
+  unsigned long off;
+
+  if(!cpu && !getenv("SIM_RTAPI_SHM_HUGE")) return;
+  if(created) {
+    if(cpu) {
+      int node = cpu_node(atoi(cpu));
+      unsigned long mask;
+
+      if(node < 0) {
+	rtapi_print_msg(RTAPI_MSG_WARN,
+		"SIM_RTAPI_SHM_CPU: no NUMA node found for CPU %s\n", cpu);
+      } else {
+	mask = 1UL << node;
+	if(syscall(SYS_mbind, mem, size, SHM_MPOL_PREFERRED, &mask,
+		SHM_MAX_NODES + 1, 0) < 0) {
+	  rtapi_print_msg(RTAPI_MSG_WARN,
+		  "could not place shmem on node %d: %s\n",
+		  node, strerror(errno));
+	}
+      }
+    }
+    /* fault it in now; reading is enough, and is safe even if another
+       process has already started to use it */
+    for(off = 0; off < size; off += page)
+      (void) ((volatile char *) mem)[off];
+  }
+#ifdef RTAPI
+  if(mlock(mem, size) < 0) {
+    rtapi_print_msg(RTAPI_MSG_WARN,
+	    "could not lock shmem: %s\n", strerror(errno));
+  }
+#endif
+}
+
 int rtapi_shmem_new(int key, int module_id, unsigned long int size)
 {
   rtapi_shmem_handle *shmem;
-  int i;
+  int i, created;
 
   for(i=0 ; i < MAX_SHM; i++) {
     if(shmem_array[i].magic == SHMEM_MAGIC && shmem_array[i].key == key) {
@@ -44,7 +165,7 @@ int rtapi_shmem_new(int key, int module_id, unsigned long int size)
   shmem = &shmem_array[i];
 
   /* now get shared memory block from OS */
-  shmem->id = shmget((key_t) key, (int) size, IPC_CREAT | 0666);
+  shmem->id = shmem_get(key, size, &created);
   if (shmem->id == -1) {
     rtapi_print_msg(RTAPI_MSG_ERR, "rtapi_shmem_new failed due to shmget()\n");
     return -errno;
@@ -55,6 +176,7 @@ int rtapi_shmem_new(int key, int module_id, unsigned long int size)
     rtapi_print_msg(RTAPI_MSG_ERR, "rtapi_shmem_new failed due to shmat()\n");
     return -errno;
   }
+  shmem_place(shmem->mem, size, created);
 
   /* label as a valid shmem structure */
   shmem->magic = SHMEM_MAGIC;
@@ -192,6 +314,9 @@ int rtapi_get_msg_level() {
 
 long long rtapi_get_time(void) {
     struct timeval tv;
+#ifdef SIM_TIME
+    if(SIM_TIME() >= 0) return SIM_TIME();
+#endif
     gettimeofday(&tv, 0);
     return tv.tv_sec * 1000 * 1000 * 1000 + tv.tv_usec * 1000;
 }
@@ -20,6 +20,10 @@
 #include <sys/shm.h>		/* shmget() */
 #include <time.h>               /* gettimeofday */
 #include <sys/time.h>           /* gettimeofday */
+#include <sched.h>		/* sched_setaffinity() */
+#include <pthread.h>		/* pthread_create() */
+#include <sys/mman.h>		/* mlockall() */
+#include <limits.h>		/* PTHREAD_STACK_MIN */
 #include "rtapi.h"		/* these decls */
 #include <errno.h>
 #include <string.h>
@@ -39,13 +43,33 @@ struct rtapi_task {
   int prio;
   int period;
   int ratio;
+  int cpu;			/* CPU to run on, -1 for any */
   void *arg;
   void (*taskcode) (void*);	/* pointer to task function */
+  pthread_t thread;		/* with SIM_RTAPI_POSIX: the task's thread */
+  int running;			/* and whether it has one */
+  volatile int stopping;	/* asks it to exit at its next rtapi_wait() */
+  struct timespec next;		/* when its next period starts */
 };
 
 static struct timeval schedule;
 static int base_periods;
+/* with SIM_RTAPI_FAST set in the environment, base periods run back to
+   back and rtapi_get_time() counts simulated time, so a run does not
+   depend on the host's speed or load */
+static int fast;
+static long long sim_time;
 static pth_uctx_t main_ctx, this_ctx;
+/* with SIM_RTAPI_POSIX set in the environment, each task gets its own
+   pthread instead of a pth context: SCHED_FIFO at a priority mapped
+   from its rtapi priority where the process may use it, on its CPU if
+   it was given one, sleeping to absolute CLOCK_MONOTONIC deadlines,
+   and with the process's memory locked.  Tasks then run in parallel,
+   as they do under a realtime kernel, so HAL code has to be as careful
+   about sharing as it is there */
+static int posix;
+static __thread struct rtapi_task *current_task;
+static void posix_task_stop(struct rtapi_task *task);
 
 #define MODULE_MAGIC  30812
 #define TASK_MAGIC    21979	/* random numbers used as signatures */
@@ -104,12 +128,30 @@ int rtapi_clock_set_period(unsigned long int nsecs)
   }
   period = nsecs;
   gettimeofday(&schedule, NULL);
+  fast = getenv("SIM_RTAPI_FAST") != NULL;
+  posix = getenv("SIM_RTAPI_POSIX") != NULL;
+  if(posix && fast) {
+      rtapi_print_msg(RTAPI_MSG_ERR,
+	      "SIM_RTAPI_FAST does not apply with SIM_RTAPI_POSIX; ignoring it\n");
+      fast = 0;
+  }
+  if(posix && mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+      rtapi_print_msg(RTAPI_MSG_WARN,
+	      "could not lock memory: %s\n", strerror(errno));
+  }
+  sim_time = schedule.tv_sec * 1000000000LL + schedule.tv_usec * 1000LL;
   return period;
 }
 
 
 int rtapi_task_new(void (*taskcode) (void*), void *arg,
     int prio, int owner, unsigned long int stacksize, int uses_fp) {
+  return rtapi_task_new_cpu(taskcode, arg, prio, owner, stacksize,
+	  uses_fp, -1);
+}
+
+int rtapi_task_new_cpu(void (*taskcode) (void*), void *arg,
+    int prio, int owner, unsigned long int stacksize, int uses_fp, int cpu) {
   int n;
   struct rtapi_task *task;
 
@@ -130,6 +172,10 @@ int rtapi_task_new(void (*taskcode) (void*), void *arg,
   if ((prio < rtapi_prio_highest()) || (prio > rtapi_prio_lowest()))
     return -EINVAL;
 
+  /* check requested CPU */
+  if (cpu >= CPU_SETSIZE || cpu >= sysconf(_SC_NPROCESSORS_CONF))
+    return -EINVAL;
+
   /* label as a valid task structure */
   /*! \todo FIXME - end of non-threadsafe window */
   if(stacksize < 16384) stacksize = 16384;
@@ -140,6 +186,9 @@ int rtapi_task_new(void (*taskcode) (void*), void *arg,
   task->stacksize = stacksize;
   task->taskcode = taskcode;
   task->prio = prio;
+  task->cpu = cpu;
+  task->running = 0;
+  task->stopping = 0;
 
   /* and return handle to the caller */
 
@@ -157,7 +206,8 @@ int rtapi_task_delete(int id) {
   if (task->magic != TASK_MAGIC)
     return -EINVAL;
 
-  pth_uctx_destroy(task->ctx);
+  if(posix) posix_task_stop(task);
+  else pth_uctx_destroy(task->ctx);
   
   task->magic = 0;
   return 0;
@@ -182,6 +232,98 @@ static void wrapper(void *arg)
 }
 
 
+static void *posix_wrapper(void *arg)
+{
+  struct rtapi_task *task = (struct rtapi_task*)arg;
+
+  current_task = task;
+  clock_gettime(CLOCK_MONOTONIC, &task->next);
+  wrapper(task);
+  return NULL;
+}
+
+/* SIM priority 0 is the highest, so it gets the top SCHED_FIFO one */
+static int posix_task_start(struct rtapi_task *task)
+{
+  static int warned;
+  pthread_attr_t attr;
+  struct sched_param param;
+  int retval;
+
+  pthread_attr_init(&attr);
+  if(task->stacksize < PTHREAD_STACK_MIN) task->stacksize = PTHREAD_STACK_MIN;
+  pthread_attr_setstacksize(&attr, task->stacksize);
+  if(task->cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(task->cpu, &cpus);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - task->prio;
+  if(param.sched_priority < sched_get_priority_min(SCHED_FIFO))
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  pthread_attr_setschedparam(&attr, &param);
+
+  task->stopping = 0;
+  retval = pthread_create(&task->thread, &attr, posix_wrapper, task);
+  if(retval == EPERM) {
+    /* not allowed realtime priorities: run anyway, as sim does */
+    if(!warned) {
+      rtapi_print_msg(RTAPI_MSG_WARN,
+	      "no permission for SCHED_FIFO, tasks run at normal priority\n");
+      warned = 1;
+    }
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    retval = pthread_create(&task->thread, &attr, posix_wrapper, task);
+  }
+  pthread_attr_destroy(&attr);
+  if(retval != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, "could not start task %d: %s\n",
+	    (int)(task - task_array), strerror(retval));
+    return -retval;
+  }
+  task->running = 1;
+  return 0;
+}
+
+/* the task leaves at its next rtapi_wait(), so this takes up to one of
+   its periods */
+static void posix_task_stop(struct rtapi_task *task)
+{
+  if(!task->running) return;
+  task->stopping = 1;
+  if(!pthread_equal(task->thread, pthread_self()))
+    pthread_join(task->thread, NULL);
+  task->running = 0;
+}
+
+static void posix_wait(void)
+{
+  struct rtapi_task *task = current_task;
+  struct timespec now;
+
+  if(task->stopping) pthread_exit(NULL);
+  task->next.tv_nsec += task->period;
+  while(task->next.tv_nsec >= 1000000000) {
+    task->next.tv_nsec -= 1000000000;
+    task->next.tv_sec ++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if(now.tv_sec - task->next.tv_sec > 10) {
+    // Something happened, like getting stopped in the debugger for a
+    // long time.  Instead of playing catch-up, just forget about it
+    rtapi_print_msg(RTAPI_MSG_DBG, "Long pause, resetting schedule\n");
+    task->next = now;
+  }
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &task->next, NULL)
+	  == EINTR) {
+  }
+  if(task->stopping) pthread_exit(NULL);
+}
+
+
 int rtapi_task_start(int task_id, unsigned long int period_nsec)
 {
   struct rtapi_task *task;
@@ -199,6 +341,22 @@ int rtapi_task_start(int task_id, unsigned long int period_nsec)
   task->period = period_nsec;
   task->ratio = period_nsec / period;
 
+  if(posix) return posix_task_start(task);
+
+  /* all tasks run in this one process, so a CPU choice applies to
+     every task; the last task started with one wins */
+  if(task->cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(task->cpu, &cpus);
+    if(sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR,
+	      "could not run task %d on CPU %d: %s\n",
+	      task_id, task->cpu, strerror(errno));
+      return -EINVAL;
+    }
+  }
+
   /* create the thread - use the wrapper function, pass it a pointer
      to the task structure so it can call the actual task function */
   retval = pth_uctx_create(&task->ctx);
@@ -224,7 +382,8 @@ int rtapi_task_stop(int task_id)
   if (task->magic != TASK_MAGIC)
     return -EINVAL;
 
-  pth_uctx_destroy(task->ctx);
+  if(posix) posix_task_stop(task);
+  else pth_uctx_destroy(task->ctx);
 
   return 0;
 }
@@ -277,7 +436,8 @@ int rtapi_task_set_period(int task_id,
 
 int rtapi_wait(void)
 {
-  pth_uctx_switch(this_ctx, main_ctx);
+  if(posix) posix_wait();
+  else pth_uctx_switch(this_ctx, main_ctx);
   return 0;
 }
 
@@ -302,12 +462,25 @@ static int maybe_sleep(int fd) {
     struct timeval now;
     struct timeval interval;
 
-    if(period == 0) {
+    if(period == 0 || posix) {
+	/* no base period, or the tasks run in threads of their own */
 	fd_set fds;
 	FD_ZERO(&fds);
 	FD_SET(fd, &fds);
 
 	return select(fd+1, &fds, NULL, NULL, NULL);
+    } else if(fast) {
+	fd_set fds;
+
+	sim_time += period;
+	// only look for a new command now and then
+	if(base_periods % MIN_RUNS) return 0;
+	interval.tv_sec = 0;
+	interval.tv_usec = 0;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+
+	return select(fd+1, &fds, NULL, NULL, &interval);
     } else {
 	schedule.tv_usec += period / 1000;
 	if(schedule.tv_usec > 1000000) {
@@ -378,4 +551,5 @@ int sim_rtapi_run_threads(int fd) {
 }
 
 
+#define SIM_TIME() (fast ? sim_time : -1)
 #include "rtapi/sim_common.h"
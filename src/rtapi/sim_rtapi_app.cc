@@ -228,6 +228,48 @@ static int do_load_cmd(string name, vector<string> args) {
     }
 }
 
+/* Load several modules in one command.  The arguments are module
+   names, each followed by its own name=value parameters; a word
+   without '=' starts the next module.  All the files are read ahead
+   together first, so the disk works on them at once instead of on
+   each dlopen in turn; dlopen and rtapi_app_main run in order, as a
+   module may need what an earlier one exports.  A failure does not
+   stop the rest, and every failure is listed at the end.  */
+static int do_loadmany_cmd(vector<string> args) {
+    vector<vector<string> > loads;
+    for(unsigned i=0; i < args.size(); i++) {
+        if(loads.empty() || args[i].find('=') == string::npos)
+            loads.push_back(vector<string>(1, args[i]));
+        else
+            loads.back().push_back(args[i]);
+    }
+
+    for(unsigned i=0; i < loads.size(); i++) {
+        char what[LINELEN+1];
+        snprintf(what, LINELEN, "%s/%s.so", EMC2_RTLIB_DIR,
+                loads[i][0].c_str());
+        int fd = open(what, O_RDONLY);
+        if(fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+
+    string failed;
+    int nfailed = 0;
+    for(unsigned i=0; i < loads.size(); i++) {
+        if(do_load_cmd(loads[i][0], loads[i]) != 0) {
+            failed += " " + loads[i][0];
+            nfailed++;
+        }
+    }
+    if(nfailed) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "%d of %d modules failed to load:%s\n",
+                nfailed, (int)loads.size(), failed.c_str());
+        return -1;
+    }
+    return 0;
+}
+
 static int do_unload_cmd(string name) {
     void *w = modules[name];
     if(w == NULL) {
@@ -304,6 +346,9 @@ static int handle_command(vector<string> args) {
         string name = args[1];
         args.erase(args.begin());
         return do_load_cmd(name, args);
+    } else if(args.size() >= 2 && args[0] == "loadmany") {
+        args.erase(args.begin());
+        return do_loadmany_cmd(args);
     } else if(args.size() == 2 && args[0] == "unload") {
         return do_unload_cmd(args[1]);
     } else if(args.size() == 3 && args[0] == "newinst") {
@@ -333,7 +378,10 @@ static int slave(int fd, vector<string> args) {
 
 static int master(int fd, vector<string> args) {
     dlopen(NULL, RTLD_GLOBAL);
-    do_load_cmd("hal_lib", vector<string>()); instance_count = 0;
+    vector<string> hal_args;
+    if(getenv("HAL_SIZE"))
+        hal_args.push_back(string("hal_size=") + getenv("HAL_SIZE"));
+    do_load_cmd("hal_lib", hal_args); instance_count = 0;
     if(args.size()) { 
         int result = handle_command(args);
         if(result != 0) return result;
@@ -0,0 +1,35 @@
+#!/bin/sh
+TMPDIR=`mktemp -d /tmp/halbench.XXXXXX`
+trap "rm -rf $TMPDIR" 0 1 2 3 9 15
+
+CALLS=1000
+PINS=5000
+STAGES=10
+PER=$(($PINS / $STAGES))
+FIGURES="ns-per-call ns-per-pin ns-per-call-avg ns-per-pin-avg samples"
+
+{
+    echo "loadrt threads name1=bench period1=1000000"
+    echo "loadrt halbench calls=$CALLS pins=$PINS stages=$STAGES"
+    echo "addf halbench.start bench"
+    n=0; while [ $n -lt $CALLS ]; do
+	echo "addf halbench.nop.$n bench"; n=$(($n + 1))
+    done
+    echo "addf halbench.mark bench"
+    n=0; while [ $n -lt $STAGES ]; do
+	echo "addf halbench.stage.$n bench"; n=$(($n + 1))
+    done
+    echo "addf halbench.end bench"
+    n=$PER; while [ $n -lt $PINS ]; do
+	echo "net c$n halbench.out.$(($n - $PER)) halbench.in.$n"
+	n=$(($n + 1))
+    done
+    echo "start"
+    echo "loadusr -w sleep 2"
+    for f in $FIGURES; do echo "getp halbench.$f"; done
+    echo "getp halbench.out.$(($PINS - 1))"
+} > $TMPDIR/test.hal
+
+for f in $FIGURES out; do echo $f; done > $TMPDIR/names
+HAL_SIZE=4000000 halrun -f $TMPDIR/test.hal > $TMPDIR/values
+paste -d' ' $TMPDIR/names $TMPDIR/values
@@ -0,0 +1,30 @@
+#!/bin/sh
+TMPDIR=`mktemp -d /tmp/hm2bench.XXXXXX`
+trap "rm -rf $TMPDIR" 0 1 2 3 9 15
+
+MODULES="other watchdog ioport encoder stepgen"
+BOARD=hm2_test.0
+
+{
+    echo "loadrt hostmot2"
+    echo "loadrt hm2_test test_pattern=15 bus=pci encoders=4 stepgens=4"
+    echo "loadrt threads name1=servo period1=1000000"
+    echo "addf $BOARD.read servo"
+    echo "addf $BOARD.write servo"
+    echo "addf $BOARD.bench servo"
+    echo "start"
+    echo "loadusr -w sleep 2"
+    echo "getp $BOARD.bench.samples"
+    for m in $MODULES; do
+	for f in ns ns-avg reads writes; do echo "getp $BOARD.bench.$m.$f"; done
+    done
+} > $TMPDIR/test.hal
+
+{
+    echo samples
+    for m in $MODULES; do
+	for f in ns ns-avg reads writes; do echo $m.$f; done
+    done
+} > $TMPDIR/names
+halrun -f $TMPDIR/test.hal > $TMPDIR/values
+paste -d' ' $TMPDIR/names $TMPDIR/values
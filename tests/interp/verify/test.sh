@@ -0,0 +1,4 @@
+#!/bin/bash
+rs274 -V -i test.ini test.ngc 2>&1
+echo "exit status $?"
+exit 0
@@ -0,0 +1,2 @@
+#!/bin/sh
+rs274 -B test.ngc 2>&1 >/dev/null
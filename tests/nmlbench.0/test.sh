@@ -0,0 +1,2 @@
+#!/bin/sh
+nmlbench -n 500 -r 1,4
@@ -0,0 +1,222 @@
+#!/usr/bin/env python
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+"""
+The DISPLAY of the soak test: runs the programs over and over for
+SOAK_HOURS, and every SOAK_INTERVAL seconds samples the memory of task,
+io and rtapi_app, how long NML status reads and commands take, and the
+servo thread's latency and execution time.  Each sample is a line of
+name=value fields in soak.log.  At the end it writes soak.report,
+which compares the start of the run with its end; see README.
+"""
+
+import os, sys, time, glob, subprocess
+import linuxcnc
+
+def env(name, default):
+    return type(default)(os.environ.get(name, default))
+
+hours = env("SOAK_HOURS", 1.0)
+interval = env("SOAK_INTERVAL", 60.0)
+max_kb = env("SOAK_MAX_KB", 2048.0)
+max_ratio = env("SOAK_MAX_RATIO", 1.5)
+programs = os.environ.get("SOAK_PROGRAMS", "").split() or \
+    sorted(glob.glob(os.path.abspath("*.ngc")))
+
+inifile = linuxcnc.ini(sys.argv[sys.argv.index("-ini") + 1])
+procs = [inifile.find("TASK", "TASK") or "milltask",
+    inifile.find("EMCIO", "EMCIO") or "io", "rtapi_app"] + \
+    os.environ.get("SOAK_PROCS", "").split()
+
+s = linuxcnc.stat()
+c = linuxcnc.command()
+e = linuxcnc.error_channel()
+
+# what each process is called in /proc is cut to 15 characters
+def pids(name):
+    found = []
+    for pid in os.listdir("/proc"):
+        try:
+            if pid.isdigit() and \
+                    open("/proc/%s/comm" % pid).read().strip() == name[:15]:
+                found.append(pid)
+        except IOError:
+            pass
+    return found
+
+def memory(pid):
+    rss = heap = 0
+    try:
+        for line in open("/proc/%s/status" % pid):
+            if line.startswith("VmRSS:"):
+                rss = int(line.split()[1])
+        in_heap = False
+        for line in open("/proc/%s/smaps" % pid):
+            if not line[0].isupper():
+                in_heap = line.rstrip().endswith("[heap]")
+            elif in_heap and line.startswith("Rss:"):
+                heap += int(line.split()[1])
+    except IOError:
+        pass
+    return rss, heap
+
+def run(*args):
+    return subprocess.Popen(args, stdout=subprocess.PIPE).communicate()[0]
+
+class Sampler:
+    def __init__(self):
+        self.samples = []
+        self.runs = 0
+        self.errors = 0
+        self.start = time.time()
+        self.next = self.start
+        self.polls = []
+        self.last_totals = {}
+        self.log = open("soak.log", "w")
+
+    def poll(self):
+        t = time.time()
+        s.poll()
+        self.polls.append(time.time() - t)
+        m = e.poll()
+        if m:
+            self.errors += 1
+            print >>self.log, "error", m[1]
+        if time.time() >= self.next:
+            self.sample()
+            self.next += interval
+
+    # mean of a timing table since the last sample, in microseconds
+    def mean(self, name, timings):
+        count = sum([t["count"] for t in timings])
+        total = sum([t["total"] for t in timings])
+        was = self.last_totals.get(name)
+        self.last_totals[name] = count, total
+        # the counts halve now and again, which makes a gap in the figures
+        if was is None or count <= was[0] or total < was[1]:
+            return None
+        return 1e6 * (total - was[1]) / (count - was[0])
+
+    def sample(self):
+        v = [("t", int(time.time() - self.start)), ("runs", self.runs)]
+        for name in procs:
+            for n, pid in enumerate(pids(name)):
+                rss, heap = memory(pid)
+                tag = n and "%s.%d" % (name, n) or name
+                v += [(tag + "_rss_kb", rss), (tag + "_heap_kb", heap)]
+        if self.polls:
+            v += [("nml_poll_us", 1e6 * sum(self.polls) / len(self.polls)),
+                ("nml_poll_max_us", 1e6 * max(self.polls))]
+        self.polls = []
+        for name, timings in [
+                ("command_us", s.command_latency.values()),
+                ("task_plan_us", [s.task_timing["plan"]]),
+                ("task_read_us", [s.task_timing["read"]])]:
+            m = self.mean(name, timings)
+            if m is not None:
+                v.append((name, m))
+        tmax = run("halcmd", "getp", "servo-thread.tmax").strip()
+        run("halcmd", "setp", "servo-thread.tmax", "0")
+        if tmax:
+            v.append(("servo_tmax_clocks", int(tmax)))
+        for field in run("hallatency", "-r", "-c", "0").split():
+            if field.startswith("latency_max_ns=") or \
+                    field.startswith("exec_max_ns="):
+                name, value = field.split("=")
+                v.append(("servo_" + name, int(value)))
+        self.samples.append(dict(v))
+        print >>self.log, " ".join(["%s=%s" % (n, round(x, 3))
+            for n, x in v])
+        self.log.flush()
+
+    def wait(self, done, timeout=60):
+        end = time.time() + timeout
+        while time.time() < end:
+            self.poll()
+            if done():
+                return True
+            time.sleep(0.05)
+        return False
+
+def median(l):
+    l = sorted(l)
+    return l[len(l) / 2]
+
+# least squares slope of y over t, per hour
+def slope(points):
+    n = float(len(points))
+    mt = sum([t for t, y in points]) / n
+    my = sum([y for t, y in points]) / n
+    var = sum([(t - mt) ** 2 for t, y in points])
+    if var == 0:
+        return 0.0
+    return 3600 * sum([(t - mt) * (y - my) for t, y in points]) / var
+
+def report(sampler, out):
+    # leave out the first tenth, while things settle, and compare the
+    # first quarter of the rest with the last
+    samples = sampler.samples[max(1, len(sampler.samples) / 10):]
+    q = max(1, len(samples) / 4)
+    names = []
+    for sample in samples:
+        names += [n for n in sample if n not in names and n not in ("t", "runs")]
+    drifting = 0
+    for name in names:
+        points = [(x["t"], x[name]) for x in samples if name in x]
+        if len(points) < 2:
+            continue
+        first = median([y for t, y in points[:q]])
+        last = median([y for t, y in points[-q:]])
+        if name.endswith("_kb"):
+            bad = last - first > max_kb
+        else:
+            bad = last > first * max_ratio and last > first + 1
+        drifting += bad
+        print >>out, "%s first=%.3f last=%.3f per_hour=%.3f %s" % (name,
+            first, last, slope(points), bad and "DRIFT" or "ok")
+    print >>out, "soak: %d samples, %d runs, %d errors, %d drifting" % (
+        len(sampler.samples), sampler.runs, sampler.errors, drifting)
+
+sampler = Sampler()
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.state(linuxcnc.STATE_ON)
+c.mode(linuxcnc.MODE_MANUAL)
+c.wait_complete()
+s.poll()
+for axis in range(len(s.homed)):
+    if s.axis_mask & (1 << axis):
+        c.home(axis)
+sampler.wait(lambda: all([s.homed[a] for a in range(len(s.homed))
+    if s.axis_mask & (1 << a)]))
+
+while time.time() - sampler.start < hours * 3600:
+    for program in programs:
+        c.mode(linuxcnc.MODE_AUTO)
+        c.wait_complete()
+        c.program_open(program)
+        c.auto(linuxcnc.AUTO_RUN, 0)
+        sampler.wait(lambda: s.interp_state != linuxcnc.INTERP_IDLE, 5)
+        if not sampler.wait(lambda: s.interp_state == linuxcnc.INTERP_IDLE,
+                3600):
+            print >>sampler.log, "error", program, "did not finish"
+            sampler.errors += 1
+            c.abort()
+        if s.task_state != linuxcnc.STATE_ON:
+            print >>sampler.log, "error machine went off in", program
+            sampler.errors += 1
+            c.state(linuxcnc.STATE_ESTOP_RESET)
+            c.state(linuxcnc.STATE_ON)
+        sampler.runs += 1
+sampler.sample()
+report(sampler, open("soak.report", "w"))
@@ -0,0 +1,4 @@
+#!/bin/bash
+rm -f soak.log soak.report
+linuxcnc soak.ini > soak.out 2>&1
+cat soak.report
@@ -0,0 +1,2 @@
+#!/bin/sh
+rs274 -g test.ngc | tpbench -v 25 -a 250 -j 5000
@@ -0,0 +1,5 @@
+#!/bin/sh
+rs274 -g test.ngc > canon.out
+tpbench -v 25 -a 250 -j 5000 canon.out | sed 's/^/stop-/'
+tpbench -v 25 -a 250 -j 5000 -r 0.5 canon.out | sed 's/^/rapid-/'
+rm -f canon.out
@@ -0,0 +1,5 @@
+#!/bin/sh
+rs274 -g test.ngc > canon.out
+tpbench -v 25 -a 250 -j 5000 canon.out | sed 's/^/blend-/'
+tpbench -v 25 -a 250 -j 5000 -b canon.out | sed 's/^/arc-/'
+rm -f canon.out